@@ -0,0 +1,112 @@
+#! /bin/sh
+
+# iproutetable-bench.sh -- compare IPRouteTable lookup elements
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, subject to the conditions
+# listed in the Click LICENSE file. These conditions include: you must
+# preserve this copyright notice, and you cannot mention the copyright
+# holders in advertising related to the Software without their permission.
+# The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+# notice is a summary of the Click LICENSE file; the license in that file is
+# legally binding.
+
+# Reproduces the performance table in elements/ip/iproutetable.hh.  ROUTES
+# is a file (optionally gzipped) containing one `ADDR/MASK [GW] OUT' route
+# per line, such as the 167000-route routeviews dump at
+#   http://www.read.cs.ucla.edu/click/routetabletest-167k.click.gz
+# Any other text in the file is ignored.  For each ELEMENT, the script
+# reports the setup time, then cold- and warm-cache lookup rates measured by
+# IPRouteTableBench.  DXRIPLookup is also measured with batched lookups, and
+# its lookup table size is reported.
+#
+# Usage: iproutetable-bench.sh [-n LOOKUPS] [-c CLICK] ROUTES [ELEMENT...]
+
+lookups=10000000
+click=click
+while [ $# -gt 0 ]; do
+    case "$1" in
+    -n) lookups="$2"; shift 2;;
+    -c) click="$2"; shift 2;;
+    -h|--help) sed -n 's/^# Usage: //p' "$0"; exit 0;;
+    -*) echo "iproutetable-bench.sh: unknown option $1" 1>&2; exit 1;;
+    *) break;;
+    esac
+done
+if [ $# -lt 1 ]; then
+    sed -n 's/^# Usage: /usage: /p' "$0" 1>&2
+    exit 1
+fi
+
+routes="$1"; shift
+elements="$@"
+[ -z "$elements" ] && elements="RadixIPLookup DirectIPLookup RangeIPLookup DXRIPLookup"
+
+tmp=`mktemp -d ${TMPDIR:-/tmp}/iprtbench.XXXXXX` || exit 1
+trap 'rm -rf "$tmp"' 0 1 2 15
+
+case "$routes" in
+*.gz) gzip -dc "$routes";;
+*) cat "$routes";;
+esac | tr ',()' '   ' | awk '
+$1 ~ /^[0-9]+\.[0-9]+\.[0-9]+\.[0-9]+\/[0-9.]+$/ && NF >= 2 && NF <= 3 {
+    out = $NF;
+    if (out !~ /^[0-9]+$/)
+	next;
+    if (out > max)
+	max = out;
+    print "\t" $0 "," > "'"$tmp"'/routes";
+    ++n;
+}
+END {
+    print n, max + 1 > "'"$tmp"'/count";
+}'
+
+read nroutes noutputs < "$tmp/count"
+if [ -z "$nroutes" ]; then
+    echo "iproutetable-bench.sh: no routes found in $routes" 1>&2
+    exit 1
+fi
+echo "$nroutes routes, $noutputs outputs, $lookups lookups per trial"
+
+outputs=""
+i=0
+while [ $i -lt $noutputs ]; do
+    outputs="$outputs r[$i] -> d;"
+    i=`expr $i + 1`
+done
+
+now () {
+    date +%s.%N
+}
+
+for e in $elements; do
+    {
+	echo "r :: $e("
+	cat "$tmp/routes"
+	echo ");"
+	echo "Idle -> r; d :: Discard; $outputs"
+    } > "$tmp/table.click"
+
+    # setup time: parse and initialize only
+    t0=`now`
+    $click -q "$tmp/table.click" || continue
+    t1=`now`
+    setup=`echo "$t0 $t1" | awk '{ printf "%.2fs", $2 - $1 }'`
+
+    cp "$tmp/table.click" "$tmp/bench.click"
+    cat >> "$tmp/bench.click" <<EOF
+cold :: IPRouteTableBench(r, LOOKUPS $lookups);
+warm :: IPRouteTableBench(r, LOOKUPS `expr $lookups / 4`, REPEAT 4);
+EOF
+    trials="write cold.run, write warm.run"
+    if [ "$e" = DXRIPLookup ]; then
+	echo "batch :: IPRouteTableBench(r, LOOKUPS $lookups, BATCH 16);" >> "$tmp/bench.click"
+	trials="$trials, write batch.run, print r.stats"
+    fi
+    echo "DriverManager($trials, stop);" >> "$tmp/bench.click"
+
+    echo "== $e: setup $setup"
+    $click "$tmp/bench.click" 2>&1 | grep -v "^While calling" | sed "s/^ */   /"
+done
@@ -46,6 +46,7 @@ class AdjustTimestamp : public Element { public:
     ~AdjustTimestamp();
 
     const char *class_name() const		{ return "AdjustTimestamp"; }
+    const char *flags() const			{ return "T"; }
     const char *port_count() const		{ return PORTS_1_1; }
     int configure(Vector<String> &, ErrorHandler *);
     void add_handlers();
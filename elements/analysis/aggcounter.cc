@@ -23,10 +23,14 @@
 #include <click/packet_anno.hh>
 #include <click/integers.hh>	// for first_bit_set
 #include <click/router.hh>
+#include <click/heap.hh>
+#include <click/ipaddress.hh>
+#include <math.h>
 CLICK_DECLS
 
 AggregateCounter::AggregateCounter()
-    : _root(0), _free(0), _call_nnz_h(0), _call_count_h(0)
+    : _root(0), _free(0), _call_nnz_h(0), _call_count_h(0),
+      _cm(0), _hll(0), _heavy_index(-1)
 {
 }
 
@@ -38,18 +42,31 @@ AggregateCounter::Node *
 AggregateCounter::new_node_block()
 {
     assert(!_free);
-    int block_size = 1024;
-    Node *block = new Node[block_size];
+    Node *block = new Node[NODE_BLOCK];
     if (!block)
 	return 0;
     _blocks.push_back(block);
-    for (int i = 1; i < block_size - 1; i++)
+    for (int i = 1; i < NODE_BLOCK - 1; i++)
 	block[i].child[0] = &block[i+1];
-    block[block_size - 1].child[0] = 0;
+    block[NODE_BLOCK - 1].child[0] = 0;
     _free = &block[1];
     return &block[0];
 }
 
+size_t
+AggregateCounter::memory_usage() const
+{
+    size_t m = (size_t) _blocks.size() * NODE_BLOCK * sizeof(Node)
+	+ _heavy.capacity() * sizeof(HeavyHitter)
+	+ _heavy_index.bucket_count() * sizeof(void *)
+	+ _heavy_index.size() * (2 * sizeof(uint32_t) + sizeof(void *));
+    if (_cm)
+	m += _sketch_width * _sketch_depth * sizeof(uint32_t);
+    if (_hll)
+	m += 1U << _hll_precision;
+    return m;
+}
+
 int
 AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -60,6 +77,11 @@ AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
     uint32_t freeze_nnz, stop_nnz;
     uint64_t freeze_count, stop_count;
     String call_nnz, call_count;
+    bool sketch = false;
+    _sketch_width = 65536;
+    _sketch_depth = 4;
+    _sketch_top = 1024;
+    _hll_precision = 14;
     freeze_nnz = stop_nnz = _call_nnz = (uint32_t)(-1);
     freeze_count = stop_count = _call_count = (uint64_t)(-1);
 
@@ -74,9 +96,26 @@ AggregateCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("COUNT_STOP", stop_count)
 	.read("AGGREGATE_CALL", AnyArg(), call_nnz)
 	.read("COUNT_CALL", AnyArg(), call_count)
-	.read("BANNER", _output_banner).complete() < 0)
+	.read("BANNER", _output_banner)
+	.read("SKETCH", sketch)
+	.read("SKETCH_WIDTH", _sketch_width)
+	.read("SKETCH_DEPTH", _sketch_depth)
+	.read("SKETCH_TOP", _sketch_top)
+	.read("HLL_PRECISION", _hll_precision).complete() < 0)
 	return -1;
 
+    _sketch = sketch;
+    if (_sketch_width == 0 || _sketch_width > 0x10000000)
+	return errh->error("bad SKETCH_WIDTH");
+    while (_sketch_width & (_sketch_width - 1))
+	_sketch_width = (_sketch_width | (_sketch_width - 1)) + 1;
+    if (_sketch_depth == 0 || _sketch_depth > MAX_SKETCH_DEPTH)
+	return errh->error("SKETCH_DEPTH must be between 1 and %d", MAX_SKETCH_DEPTH);
+    if (_sketch_top == 0)
+	return errh->error("bad SKETCH_TOP");
+    if (_hll_precision < 4 || _hll_precision > 18)
+	return errh->error("HLL_PRECISION must be between 4 and 18");
+
     _bytes = bytes;
     _ip_bytes = ip_bytes;
     _use_packet_count = packet_count;
@@ -121,6 +160,12 @@ AggregateCounter::initialize(ErrorHandler *errh)
     if (_call_count_h && _call_count_h->initialize_write(this, errh) < 0)
 	return -1;
 
+    if (_sketch) {
+	_cm = new uint32_t[_sketch_width * _sketch_depth];
+	_hll = new uint8_t[1U << _hll_precision];
+	if (!_cm || !_hll)
+	    return errh->error("out of memory!");
+    }
     if (clear(errh) < 0)
 	return -1;
 
@@ -135,6 +180,10 @@ AggregateCounter::cleanup(CleanupStage)
     for (int i = 0; i < _blocks.size(); i++)
 	delete[] _blocks[i];
     _blocks.clear();
+    delete[] _cm;
+    delete[] _hll;
+    _cm = 0;
+    _hll = 0;
     delete _call_nnz_h;
     delete _call_count_h;
     _call_nnz_h = _call_count_h = 0;
@@ -212,6 +261,20 @@ AggregateCounter::find_node(uint32_t a, bool frozen)
     return 0;
 }
 
+inline uint32_t
+AggregateCounter::packet_amount(Packet *p) const
+{
+    uint32_t amount;
+    if (!_bytes)
+	amount = 1 + (_use_packet_count ? EXTRA_PACKETS_ANNO(p) : 0);
+    else {
+	amount = p->length() + (_use_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
+	if (_ip_bytes && p->has_network_header())
+	    amount -= p->network_header_offset();
+    }
+    return amount;
+}
+
 inline bool
 AggregateCounter::update(Packet *p, bool frozen)
 {
@@ -220,18 +283,13 @@ AggregateCounter::update(Packet *p, bool frozen)
 
     // AGGREGATE_ANNO is already in host byte order!
     uint32_t agg = AGGREGATE_ANNO(p);
+    if (_sketch)
+	return sketch_update(agg, packet_amount(p), frozen);
     Node *n = find_node(agg, frozen);
     if (!n)
 	return false;
 
-    uint32_t amount;
-    if (!_bytes)
-	amount = 1 + (_use_packet_count ? EXTRA_PACKETS_ANNO(p) : 0);
-    else {
-	amount = p->length() + (_use_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
-	if (_ip_bytes && p->has_network_header())
-	    amount -= p->network_header_offset();
-    }
+    uint32_t amount = packet_amount(p);
 
     // update _num_nonzero; possibly call handler
     if (amount && !n->count) {
@@ -270,6 +328,204 @@ AggregateCounter::pull(int port)
 }
 
 
+// SKETCHES
+
+static inline uint64_t
+sketch_hash(uint32_t x, uint32_t seed)
+{
+    // the splitmix64 finalizer
+    uint64_t z = x + (uint64_t) seed * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void
+AggregateCounter::sketch_cells(uint32_t agg, uint32_t **cells) const
+{
+    // Derive the rows' indexes from one hash, as (h1 + i*h2) mod width.
+    uint64_t h = sketch_hash(agg, 1);
+    uint32_t h1 = h, h2 = (h >> 32) | 1;
+    for (uint32_t i = 0; i < _sketch_depth; i++, h1 += h2)
+	cells[i] = &_cm[i * _sketch_width + (h1 & (_sketch_width - 1))];
+}
+
+uint32_t
+AggregateCounter::estimate(uint32_t agg) const
+{
+    if (!_sketch) {
+	// find_node() with frozen never changes the trie
+	Node *n = const_cast<AggregateCounter *>(this)->find_node(agg, true);
+	return n ? n->count : 0;
+    }
+    uint32_t *cells[MAX_SKETCH_DEPTH];
+    sketch_cells(agg, cells);
+    uint32_t est = *cells[0];
+    for (uint32_t i = 1; i < _sketch_depth; i++)
+	if (*cells[i] < est)
+	    est = *cells[i];
+    return est;
+}
+
+double
+AggregateCounter::cardinality() const
+{
+    if (!_sketch)
+	return _num_nonzero;
+    uint32_t m = 1U << _hll_precision, zeros = 0;
+    double sum = 0;
+    for (uint32_t j = 0; j < m; j++) {
+	sum += ldexp(1.0, -_hll[j]);
+	zeros += !_hll[j];
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    // small range correction: linear counting
+    if (e <= 2.5 * m && zeros)
+	e = m * log((double) m / zeros);
+    return e;
+}
+
+void
+AggregateCounter::update_heavy(uint32_t agg, uint32_t count)
+{
+    HeavyHitter *begin = _heavy.begin(), *end = _heavy.end();
+    HashTable<uint32_t, int>::iterator it = _heavy_index.find(agg);
+    if (it != _heavy_index.end()) {
+	// counts only grow, so the entry can only move down the min-heap
+	begin[it.value()].count = count;
+	change_heap(begin, end, begin + it.value(), heavy_less(), heavy_place(&_heavy_index));
+    } else if ((uint32_t) _heavy.size() < _sketch_top) {
+	HeavyHitter hh = { agg, count };
+	_heavy.push_back(hh);
+	push_heap(_heavy.begin(), _heavy.end(), heavy_less(), heavy_place(&_heavy_index));
+    } else if (count > begin[0].count) {
+	_heavy_index.erase(begin[0].aggregate);
+	begin[0].aggregate = agg;
+	begin[0].count = count;
+	change_heap(begin, end, begin, heavy_less(), heavy_place(&_heavy_index));
+    }
+}
+
+bool
+AggregateCounter::sketch_update(uint32_t agg, uint32_t amount, bool frozen)
+{
+    uint32_t *cells[MAX_SKETCH_DEPTH];
+    sketch_cells(agg, cells);
+    uint32_t est = *cells[0];
+    for (uint32_t i = 1; i < _sketch_depth; i++)
+	if (*cells[i] < est)
+	    est = *cells[i];
+    if (frozen && !est)
+	return false;
+
+    if (amount && !est) {
+	if (_num_nonzero >= _call_nnz) {
+	    _call_nnz = (uint32_t)(-1);
+	    _call_nnz_h->call_write();
+	    // handler may have changed our state; reupdate
+	    return _active && sketch_update(agg, amount, frozen || _frozen);
+	}
+	_num_nonzero++;
+    }
+
+    // Conservative update: raise each counter only as far as the new
+    // estimate, which keeps overcounting to a minimum.
+    est += amount;
+    for (uint32_t i = 0; i < _sketch_depth; i++)
+	if (*cells[i] < est)
+	    *cells[i] = est;
+
+    uint64_t h = sketch_hash(agg, 0);
+    uint32_t j = h >> (64 - _hll_precision);
+    uint64_t rest = h << _hll_precision;
+    uint8_t rank = rest ? ffs_msb(rest) : 65 - _hll_precision;
+    if (_hll[j] < rank)
+	_hll[j] = rank;
+
+    if (amount)
+	update_heavy(agg, est);
+
+    _count += amount;
+    if (_count >= _call_count) {
+	_call_count = (uint64_t)(-1);
+	_call_count_h->call_write();
+    }
+    return true;
+}
+
+void
+AggregateCounter::rebuild_heavy(const Vector<uint32_t> &candidates)
+{
+    _heavy.clear();
+    _heavy_index.clear();
+    for (const uint32_t *a = candidates.begin(); a != candidates.end(); ++a)
+	if (_heavy_index.find(*a) == _heavy_index.end())
+	    if (uint32_t est = estimate(*a))
+		update_heavy(*a, est);
+}
+
+void
+AggregateCounter::clear_sketch()
+{
+    memset(_cm, 0, sizeof(uint32_t) * _sketch_width * _sketch_depth);
+    memset(_hll, 0, 1U << _hll_precision);
+    _heavy.clear();
+    _heavy_index.clear();
+}
+
+int
+AggregateCounter::merge(AggregateCounter *ac, ErrorHandler *errh)
+{
+    if (ac == this)
+	return errh->error("cannot merge %<%s%> with itself", name().c_str());
+    if (ac->_sketch != _sketch || ac->_bytes != _bytes)
+	return errh->error("%<%s%> counts differently", ac->name().c_str());
+
+    if (!_sketch) {
+	Vector<Node *> stack;
+	stack.push_back(ac->_root);
+	while (stack.size()) {
+	    Node *x = stack.back();
+	    stack.pop_back();
+	    if (x->child[0]) {
+		stack.push_back(x->child[0]);
+		stack.push_back(x->child[1]);
+	    }
+	    if (!x->count)
+		continue;
+	    Node *n = find_node(x->aggregate);
+	    if (!n)
+		return errh->error("out of memory!");
+	    if (!n->count)
+		_num_nonzero++;
+	    n->count += x->count;
+	}
+	_count += ac->_count;
+	return 0;
+    }
+
+    if (ac->_sketch_width != _sketch_width || ac->_sketch_depth != _sketch_depth
+	|| ac->_hll_precision != _hll_precision)
+	return errh->error("%<%s%> has a different sketch size", ac->name().c_str());
+    for (uint32_t i = 0; i < _sketch_width * _sketch_depth; i++)
+	_cm[i] += ac->_cm[i];
+    for (uint32_t j = 0; j < (1U << _hll_precision); j++)
+	if (_hll[j] < ac->_hll[j])
+	    _hll[j] = ac->_hll[j];
+    _count += ac->_count;
+    _num_nonzero = (uint32_t) (cardinality() + 0.5);
+
+    Vector<uint32_t> candidates;
+    for (const HeavyHitter *hh = _heavy.begin(); hh != _heavy.end(); ++hh)
+	candidates.push_back(hh->aggregate);
+    for (const HeavyHitter *hh = ac->_heavy.begin(); hh != ac->_heavy.end(); ++hh)
+	candidates.push_back(hh->aggregate);
+    rebuild_heavy(candidates);
+    return 0;
+}
+
+
 // CLEAR, REAGGREGATE
 
 void
@@ -285,6 +541,13 @@ AggregateCounter::clear_node(Node *n)
 int
 AggregateCounter::clear(ErrorHandler *errh)
 {
+    if (_sketch) {
+	clear_sketch();
+	_num_nonzero = 0;
+	_count = 0;
+	return 0;
+    }
+
     if (_root)
 	clear_node(_root);
 
@@ -371,6 +634,31 @@ AggregateCounter::write_nodes(Node *n, FILE *f, WriteFormat format,
 	write_nodes(n->child[1], f, format, buffer, pos, len, errh);
 }
 
+static int
+heavy_compar(const void *av, const void *bv, void *)
+{
+    const uint32_t *a = static_cast<const uint32_t *>(av);
+    const uint32_t *b = static_cast<const uint32_t *>(bv);
+    return (a[0] > b[0]) - (a[0] < b[0]);
+}
+
+void
+AggregateCounter::write_heavy(FILE *f, WriteFormat format,
+			      ErrorHandler *errh) const
+{
+    // Write heavy hitters in aggregate order, as write_nodes would, with
+    // current estimates.
+    Vector<uint32_t> buf;
+    for (const HeavyHitter *hh = _heavy.begin(); hh != _heavy.end(); ++hh) {
+	buf.push_back(hh->aggregate);
+	buf.push_back(estimate(hh->aggregate));
+    }
+    if (buf.size()) {
+	click_qsort(buf.begin(), buf.size() / 2, 2 * sizeof(uint32_t), heavy_compar);
+	write_batch(f, format, buf.begin(), buf.size(), _count, errh);
+    }
+}
+
 int
 AggregateCounter::write_file(String where, WriteFormat format,
 			     ErrorHandler *errh) const
@@ -387,7 +675,10 @@ AggregateCounter::write_file(String where, WriteFormat format,
     ignore_result(fwrite(_output_banner.data(), 1, _output_banner.length(), f));
     if (_output_banner.length() && _output_banner.back() != '\n')
 	fputc('\n', f);
-    fprintf(f, "!num_nonzero %u\n", _num_nonzero);
+    if (_sketch)
+	fprintf(f, "!num_nonzero %.0f\n", cardinality());
+    else
+	fprintf(f, "!num_nonzero %u\n", _num_nonzero);
     if (format == WR_BINARY) {
 #if CLICK_BYTE_ORDER == CLICK_BIG_ENDIAN
 	fprintf(f, "!packed_be\n");
@@ -399,11 +690,15 @@ AggregateCounter::write_file(String where, WriteFormat format,
     } else if (format == WR_TEXT_IP)
 	fprintf(f, "!ip\n");
 
-    uint32_t buf[1024];
-    int pos = 0;
-    write_nodes(_root, f, format, buf, pos, 1024, errh);
-    if (pos)
-	write_batch(f, format, buf, pos, _count, errh);
+    if (_sketch)
+	write_heavy(f, format, errh);
+    else {
+	uint32_t buf[1024];
+	int pos = 0;
+	write_nodes(_root, f, format, buf, pos, 1024, errh);
+	if (pos)
+	    write_batch(f, format, buf, pos, _count, errh);
+    }
 
     bool had_err = ferror(f);
     if (f != stdout)
@@ -427,7 +722,7 @@ AggregateCounter::write_file_handler(const String &data, Element *e, void *thunk
 
 enum {
     AC_FROZEN, AC_ACTIVE, AC_BANNER, AC_STOP, AC_REAGGREGATE, AC_CLEAR,
-    AC_AGGREGATE_CALL, AC_COUNT_CALL, AC_NAGG, AC_COUNT
+    AC_AGGREGATE_CALL, AC_COUNT_CALL, AC_NAGG, AC_COUNT, AC_MERGE
 };
 
 String
@@ -450,6 +745,8 @@ AggregateCounter::read_handler(Element *e, void *thunk)
       case AC_COUNT:
 	return String(ac->_count);
       case AC_NAGG:
+	if (ac->_sketch)
+	    return String((uint32_t) (ac->cardinality() + 0.5));
 	return String(ac->_num_nonzero);
       default:
 	return "<error>";
@@ -481,6 +778,8 @@ AggregateCounter::write_handler(const String &data, Element *e, void *thunk, Err
 	ac->router()->please_stop_driver();
 	return 0;
       case AC_REAGGREGATE:
+	if (ac->_sketch)
+	    return errh->error("not supported in sketch mode");
 	ac->reaggregate_counts();
 	return 0;
       case AC_BANNER:
@@ -492,6 +791,18 @@ AggregateCounter::write_handler(const String &data, Element *e, void *thunk, Err
 	return 0;
       case AC_CLEAR:
 	return ac->clear(errh);
+      case AC_MERGE: {
+	  Vector<String> words;
+	  cp_spacevec(s, words);
+	  for (int i = 0; i < words.size(); i++) {
+	      AggregateCounter *other;
+	      if (!ElementCastArg("AggregateCounter").parse(words[i], other, Args(ac, errh)))
+		  return errh->error("argument to 'merge' should be AggregateCounter elements");
+	      if (ac->merge(other, errh) < 0)
+		  return -1;
+	  }
+	  return 0;
+      }
       case AC_AGGREGATE_CALL: {
 	  uint32_t new_nnz = (uint32_t)(-1);
 	  if (s) {
@@ -519,6 +830,23 @@ AggregateCounter::write_handler(const String &data, Element *e, void *thunk, Err
     }
 }
 
+int
+AggregateCounter::estimate_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    AggregateCounter *ac = static_cast<AggregateCounter *>(e);
+    String s = cp_uncomment(str);
+    uint32_t agg;
+    IPAddress addr;
+    if (IntArg().parse(s, agg))
+	/* OK */;
+    else if (IPAddressArg().parse(s, addr, ac))
+	agg = ntohl(addr.addr());
+    else
+	return errh->error("argument should be aggregate");
+    str = String(ac->estimate(agg));
+    return 0;
+}
+
 void
 AggregateCounter::add_handlers()
 {
@@ -543,6 +871,8 @@ AggregateCounter::add_handlers()
     add_write_handler("count_call", write_handler, AC_COUNT_CALL);
     add_read_handler("count", read_handler, AC_COUNT);
     add_read_handler("nagg", read_handler, AC_NAGG);
+    set_handler("estimate", Handler::OP_READ | Handler::READ_PARAM, estimate_handler);
+    add_write_handler("merge", write_handler, AC_MERGE);
 }
 
 ELEMENT_REQUIRES(userlevel int64)
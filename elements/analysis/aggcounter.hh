@@ -1,6 +1,8 @@
 #ifndef CLICK_AGGCOUNTER_HH
 #define CLICK_AGGCOUNTER_HH
 #include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/vector.hh>
 CLICK_DECLS
 class HandlerCall;
 
@@ -20,6 +22,16 @@ each aggregate value. Each aggregate annotation value gets a different count.
 Call its C<write_file> or C<write_text_file> write handler to get a dump of
 the information.
 
+With the SKETCH keyword, AggregateCounter uses a fixed amount of memory
+however many aggregates it sees.  Counts are kept in a Count-Min sketch with
+conservative update, the number of distinct aggregates is estimated with a
+HyperLogLog sketch, and only the SKETCH_TOP aggregates with the largest
+counts are remembered.  Dumps then list those heavy hitters and their
+estimated counts.  Count-Min estimates never undercount; they overcount by
+at most 2/SKETCH_WIDTH of the total count, except with probability about
+2^-SKETCH_DEPTH.  The HyperLogLog estimate's standard error is about
+1.04/sqrt(2^HLL_PRECISION).
+
 The C<freeze> handler, and the C<AGGREGATE_FREEZE> and C<COUNT_FREEZE>
 keyword arguments, can put AggregateCounter in a frozen state. Frozen
 AggregateCounters only update existing counters; they do not create new
@@ -97,6 +109,31 @@ them.
 String. This banner is written to the head of any output file. It should
 probably begin with a comment character, like '!' or '#'. Default is empty.
 
+=item SKETCH
+
+Boolean. If true, then keep counts in fixed-size sketches rather than a trie,
+as described above. In sketch mode, the AGGREGATE keywords count an aggregate
+as new when its estimated count is zero, which can miss some aggregates.
+Default is false.
+
+=item SKETCH_WIDTH
+
+Unsigned. Number of counters in each Count-Min row, rounded up to a power of
+two. Default is 65536.
+
+=item SKETCH_DEPTH
+
+Unsigned. Number of Count-Min rows, at most 16. Default is 4.
+
+=item SKETCH_TOP
+
+Unsigned. Number of heavy hitters to remember. Default is 1024.
+
+=item HLL_PRECISION
+
+Unsigned between 4 and 18. The HyperLogLog sketch has 2^HLL_PRECISION
+registers. Default is 14.
+
 =back
 
 =h write_file write-only
@@ -161,7 +198,23 @@ Returns or sets the COUNT_CALL setting.
 
 =h nagg read-only
 
-Returns the number of aggregates that have been seen so far.
+Returns the number of aggregates that have been seen so far. In sketch mode,
+this is the HyperLogLog estimate.
+
+=h estimate read-only
+
+Takes an aggregate, given as an unsigned integer or an IP address, as a
+parameter, and returns its count. In sketch mode, this is the Count-Min
+estimate.
+
+=h merge write-only
+
+Argument is a space-separated list of other AggregateCounter elements. Adds
+their counts into this element's, so that one element holds the totals of
+several, for example of one AggregateCounter per thread. In sketch mode, all
+the elements must have the same SKETCH_WIDTH, SKETCH_DEPTH, and
+HLL_PRECISION; their heavy hitters are combined and the SKETCH_TOP largest
+kept. Merging does not change the other elements.
 
 =n
 
@@ -185,6 +238,18 @@ form.
   DriverManager(wait_pause,
 	write ac.write_text_file -);
 
+This configuration counts source addresses on two threads in sketch mode,
+then merges the sketches to print the overall heavy hitters:
+
+  fd :: FromDevice(eth0, QUEUES 2);
+  fd[0] -> Strip(14) -> CheckIPHeader -> AggregateIP(ip src)
+	-> ac0 :: AggregateCounter(SKETCH true) -> Discard;
+  fd[1] -> Strip(14) -> CheckIPHeader -> AggregateIP(ip src)
+	-> ac1 :: AggregateCounter(SKETCH true) -> Discard;
+
+  DriverManager(wait 60s, write ac0.merge ac1,
+	write ac0.write_ip_file -);
+
 =a
 
 AggregateIP, AggregatePacketCounter, FromIPSummaryDump, FromDump */
@@ -201,6 +266,7 @@ class AggregateCounter : public Element { public:
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
     void add_handlers();
+    size_t memory_usage() const;
 
     inline bool update(Packet *, bool frozen = false);
     void push(int, Packet *);
@@ -211,6 +277,9 @@ class AggregateCounter : public Element { public:
     enum WriteFormat { WR_TEXT = 0, WR_BINARY = 1, WR_TEXT_IP = 2, WR_TEXT_PDF = 3 };
     int write_file(String, WriteFormat, ErrorHandler *) const;
     void reaggregate_counts();
+    int merge(AggregateCounter *, ErrorHandler *);
+    uint32_t estimate(uint32_t aggregate) const;
+    double cardinality() const;
 
   private:
 
@@ -226,7 +295,9 @@ class AggregateCounter : public Element { public:
     bool _use_extra_length : 1;
     bool _frozen;
     bool _active;
+    bool _sketch;
 
+    enum { NODE_BLOCK = 1024 };
     Node *_root;
     Node *_free;
     Vector<Node *> _blocks;
@@ -240,6 +311,44 @@ class AggregateCounter : public Element { public:
 
     String _output_banner;
 
+    enum { MAX_SKETCH_DEPTH = 16 };
+
+    struct HeavyHitter {
+	uint32_t aggregate;
+	uint32_t count;
+    };
+    struct heavy_less {
+	bool operator()(const HeavyHitter &a, const HeavyHitter &b) const {
+	    return a.count < b.count;
+	}
+    };
+    struct heavy_place {
+	HashTable<uint32_t, int> *index;
+	heavy_place(HashTable<uint32_t, int> *i)
+	    : index(i) {
+	}
+	void operator()(HeavyHitter *begin, HeavyHitter *it) const {
+	    (*index)[it->aggregate] = it - begin;
+	}
+    };
+
+    uint32_t _sketch_width;
+    uint32_t _sketch_depth;
+    uint32_t _sketch_top;
+    uint32_t _hll_precision;
+    uint32_t *_cm;			// _sketch_depth rows of _sketch_width
+    uint8_t *_hll;
+    Vector<HeavyHitter> _heavy;		// min-heap by count
+    HashTable<uint32_t, int> _heavy_index;
+
+    inline uint32_t packet_amount(Packet *) const;
+    bool sketch_update(uint32_t agg, uint32_t amount, bool frozen);
+    void sketch_cells(uint32_t agg, uint32_t **cells) const;
+    void update_heavy(uint32_t agg, uint32_t count);
+    void rebuild_heavy(const Vector<uint32_t> &candidates);
+    void clear_sketch();
+    void write_heavy(FILE *, WriteFormat, ErrorHandler *) const;
+
     Node *new_node();
     Node *new_node_block();
     void free_node(Node *);
@@ -253,6 +362,7 @@ class AggregateCounter : public Element { public:
     static int write_file_handler(const String &, Element *, void *, ErrorHandler *);
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
+    static int estimate_handler(int, String &, Element *, const Handler *, ErrorHandler *);
 
 };
 
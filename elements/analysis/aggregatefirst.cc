@@ -23,7 +23,7 @@
 CLICK_DECLS
 
 AggregateFirst::AggregateFirst()
-    : _agg_notifier(0)
+    : _agg_notifier(0), _memory(0)
 {
     memset(_kills, 0, sizeof(_kills));
     memset(_counts, 0, sizeof(_counts));
@@ -68,6 +68,7 @@ AggregateFirst::cleanup(CleanupStage)
 	}
 	delete[] _counts[i];
     }
+    _memory = 0;
 }
 
 uint32_t *
@@ -84,8 +85,11 @@ AggregateFirst::create_row(uint32_t agg)
 	    delete[] _kills[planeno];
 	    _kills[planeno] = 0;
 	    return 0;
-	} else
+	} else {
 	    memset(_counts[planeno], 0, sizeof(uint32_t) * (NCOL + 1));
+	    _memory += sizeof(uint32_t) * (NCOL + 1);
+	}
+	_memory += sizeof(uint32_t *) * NCOL;
     }
     uint32_t **plane = _kills[planeno];
 
@@ -94,6 +98,7 @@ AggregateFirst::create_row(uint32_t agg)
 	if (!(plane[colno] = new uint32_t[NROW]))
 	    return 0;
 	memset(plane[colno], 0, sizeof(uint32_t) * NROW);
+	_memory += sizeof(uint32_t) * NROW;
     }
 
     return plane[colno];
@@ -151,12 +156,14 @@ AggregateFirst::aggregate_notify(uint32_t agg, AggregateEvent event, const Packe
 	    // get rid of empty row
 	    delete[] _kills[plane][col];
 	    _kills[plane][col] = 0;
+	    _memory -= sizeof(uint32_t) * NROW;
 	    // get rid of empty column
 	    if ((--_counts[plane][NCOL]) == 0) {
 		delete[] _counts[plane];
 		_counts[plane] = 0;
 		delete[] _kills[plane];
 		_kills[plane] = 0;
+		_memory -= sizeof(uint32_t) * (NCOL + 1) + sizeof(uint32_t *) * NCOL;
 	    }
 	}
     }
@@ -55,6 +55,7 @@ class AggregateFirst : public Element, public AggregateListener { public:
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
+    size_t memory_usage() const		{ return _memory; }
 
     inline Packet *smaction(Packet *);
     void push(int, Packet *);
@@ -71,6 +72,7 @@ class AggregateFirst : public Element, public AggregateListener { public:
     uint32_t **_kills[NPLANE];
     AggregateNotifier *_agg_notifier;
     uint32_t *_counts[NPLANE];
+    size_t _memory;		// bytes in _kills and _counts
 
     uint32_t *create_row(uint32_t agg);
     inline uint32_t *row(uint32_t agg);
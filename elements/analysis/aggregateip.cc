@@ -83,11 +83,11 @@ AggregateIP::bad_packet(Packet *p)
     return 0;
 }
 
-Packet *
-AggregateIP::handle_packet(Packet *p)
+inline bool
+AggregateIP::aggregate(Packet *p)
 {
     if (!p->has_network_header())
-	return bad_packet(p);
+	return false;
 
     const click_ip *iph = p->ip_header();
     int offset = p->length();
@@ -120,7 +120,7 @@ AggregateIP::handle_packet(Packet *p)
     offset += _offset;
 
     if (offset + 4 > (int)p->length())
-	return bad_packet(p);
+	return false;
 
     uint32_t udata = *((const uint32_t *)(p->data() + offset));
     uint32_t agg = (ntohl(udata) >> _shift) & _mask;
@@ -130,23 +130,45 @@ AggregateIP::handle_packet(Packet *p)
     else
 	SET_AGGREGATE_ANNO(p, agg);
 
-    return p;
+    return true;
+}
+
+Packet *
+AggregateIP::simple_action(Packet *p)
+{
+    return aggregate(p) ? p : bad_packet(p);
 }
 
 void
-AggregateIP::push(int, Packet *p)
+AggregateIP::simple_action_batch(PacketBatch &batch)
 {
-    if (Packet *q = handle_packet(p))
-	output(0).push(q);
+    PacketBatch out, bad;
+    while (Packet *p = batch.pop_front())
+	if (aggregate(p))
+	    out.push_back(p);
+	else
+	    bad.push_back(p);
+    if (noutputs() == 2)
+	output(1).push_batch(bad);
+    else
+	bad.kill();
+    batch.swap(out);
 }
 
-Packet *
-AggregateIP::pull(int)
+void
+AggregateIP::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+AggregateIP::pull_batch(int port, PacketBatch &batch, int max)
 {
-    Packet *p = input(0).pull();
-    if (p)
-	p = handle_packet(p);
-    return p;
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
 }
 
 String
@@ -143,8 +143,10 @@ class AggregateIP : public Element { public:
     int configure(Vector<String> &, ErrorHandler *);
     void add_handlers();
 
-    void push(int, Packet *);
-    Packet *pull(int);
+    Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &);
+    void push_batch(int, PacketBatch &);
+    void pull_batch(int, PacketBatch &, int);
 
   private:
 
@@ -155,7 +157,7 @@ class AggregateIP : public Element { public:
     bool _unshift_ip_addr;
     IPField _f;
 
-    Packet *handle_packet(Packet *);
+    inline bool aggregate(Packet *);
     Packet *bad_packet(Packet *);
 
     static String read_handler(Element *, void *);
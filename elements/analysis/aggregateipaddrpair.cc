@@ -71,10 +71,12 @@ AggregateIPAddrPair::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _timeout = 0;
     _gc_interval = 20 * 60;
+    _recycle = false;
 
     if (Args(conf, this, errh)
 	.read("TIMEOUT", SecondsArg(), _timeout)
 	.read("REAP", SecondsArg(), _gc_interval)
+	.read("RECYCLE", _recycle)
 	.complete() < 0)
 	return -1;
 
@@ -84,13 +86,21 @@ AggregateIPAddrPair::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AggregateIPAddrPair::initialize(ErrorHandler *)
 {
-    _next = 1;
+    _ids.clear();
     _active_sec = _gc_sec = 0;
     _timestamp_warning = false;
 
     return 0;
 }
 
+inline void
+AggregateIPAddrPair::end_aggregate(uint32_t agg)
+{
+    notify(agg, AggregateListener::DELETE_AGG, 0);
+    if (_recycle)
+	_ids.free(agg);
+}
+
 void
 AggregateIPAddrPair::reap()
 {
@@ -101,7 +111,7 @@ AggregateIPAddrPair::reap()
 	for (Map::iterator iter = _map.begin(); iter.live(); iter++) {
 	    FlowInfo *finfo = &iter.value();
 	    if (SEC_OLDER(finfo->last_timestamp.sec(), timeout)) {
-		notify(finfo->aggregate, AggregateListener::DELETE_AGG, 0);
+		end_aggregate(finfo->aggregate);
 		to_free.push_back(iter.key().a);
 		to_free.push_back(iter.key().b);
 	    }
@@ -113,6 +123,12 @@ AggregateIPAddrPair::reap()
     _gc_sec = _active_sec + _gc_interval;
 }
 
+size_t
+AggregateIPAddrPair::memory_usage() const
+{
+    return _map.bucket_count() * sizeof(void *) + _map.size() * map_entry_size;
+}
+
 // XXX timing when fragments are merged back in?
 
 Packet *
@@ -121,7 +137,12 @@ AggregateIPAddrPair::simple_action(Packet *p)
     if (p->has_network_header()) {
 	const click_ip *iph = p->ip_header();
 	HostPair hosts(iph->ip_src.s_addr, iph->ip_dst.s_addr);
-	FlowInfo *finfo = &_map[hosts];
+	Map::iterator it = _map.find(hosts);
+	if (!it && memory_exceeded(map_entry_size)) {
+	    checked_output_push(1, p);
+	    return 0;
+	}
+	FlowInfo *finfo = (it ? &it.value() : &_map[hosts]);
 
 	if (_timeout > 0) {
 	    // assign timestamp if no timestamp given
@@ -134,16 +155,14 @@ AggregateIPAddrPair::simple_action(Packet *p)
 	    }
 
 	    if (finfo->aggregate && SEC_OLDER(finfo->last_timestamp.sec(), p->timestamp_anno().sec() - _timeout)) {
-		notify(finfo->aggregate, AggregateListener::DELETE_AGG, 0);
+		end_aggregate(finfo->aggregate);
 		finfo->aggregate = 0;
 	    }
 	}
 
 	if (!finfo->aggregate) {
-	    finfo->aggregate = _next;
+	    finfo->aggregate = _ids.alloc();
 	    finfo->reverse = (hosts.a != iph->ip_src.s_addr);
-	    if (++_next == 0)
-		++_next;
 	    notify(finfo->aggregate, AggregateListener::NEW_AGG, p);
 	}
 
@@ -188,6 +207,7 @@ void
 AggregateIPAddrPair::add_handlers()
 {
     add_write_handler("clear", write_handler, H_CLEAR);
+    add_memory_limit_handler();
 }
 
 ELEMENT_REQUIRES(userlevel AggregateNotifier)
@@ -43,6 +43,12 @@ pair occurs again later, it will get a new aggregate annotation.
 
 The garbage collection interval. Default is 20 minutes of packet time.
 
+=item RECYCLE
+
+Boolean. If true, then a new address pair reuses the aggregate annotation of
+an expired one, most recently expired first, so aggregate values stay close
+to the number of live address pairs. Default is false.
+
 =back
 
 AggregateIPAddrPair is an AggregateNotifier, so AggregateListeners can request
@@ -53,6 +59,12 @@ notifications when new aggregates are created and old ones are deleted.
 Clears all flow information.  Future packets will get new aggregate annotation
 values.
 
+=h memory_limit read/write
+
+Returns or sets a soft limit, in bytes, on the C<memory> handler's value; 0,
+the default, means no limit.  Over the limit, packets from address pairs not
+yet in the table are emitted on output 1, if it exists, or dropped.
+
 =a
 
 AggregateIPFlows, AggregateCounter, AggregateIP
@@ -64,6 +76,7 @@ class AggregateIPAddrPair : public Element, public AggregateNotifier { public:
     ~AggregateIPAddrPair();
 
     const char *class_name() const	{ return "AggregateIPAddrPair"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1X2; }
     const char *processing() const	{ return PROCESSING_A_AH; }
     void *cast(const char *);
@@ -71,6 +84,7 @@ class AggregateIPAddrPair : public Element, public AggregateNotifier { public:
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
     void add_handlers();
+    size_t memory_usage() const;
 
     Packet *simple_action(Packet *);
 
@@ -95,6 +109,7 @@ class AggregateIPAddrPair : public Element, public AggregateNotifier { public:
 
     typedef HashTable<HostPair, FlowInfo> Map;
     Map _map;
+    enum { map_entry_size = sizeof(HostPair) + sizeof(FlowInfo) + sizeof(void *) };
 
     unsigned _active_sec;
     unsigned _gc_sec;
@@ -102,9 +117,11 @@ class AggregateIPAddrPair : public Element, public AggregateNotifier { public:
     uint32_t _timeout;
     uint32_t _gc_interval;
     bool _timestamp_warning;
-    uint32_t _next;
+    bool _recycle;
+    AggregateIDAllocator _ids;
 
     void reap();
+    inline void end_aggregate(uint32_t agg);
 
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
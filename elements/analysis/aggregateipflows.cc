@@ -46,35 +46,112 @@ good_ip_header(const Packet *p)
 }
 
 static inline bool
-operator==(const AggregateIPFlows::HostPair &a, const AggregateIPFlows::HostPair &b)
+ports_reverse_order(uint32_t ports)
 {
-    return a.a == b.a && a.b == b.b;
+    return (int32_t) ((ports << 16) - ports) < 0;
 }
 
-inline hashcode_t
-AggregateIPFlows::HostPair::hashcode() const
+static inline uint32_t
+flip_ports(uint32_t ports)
 {
-    return (a << 12) + b + ((a >> 20) & 0x1F);
+    return ((ports >> 16) & 0xFFFF) | (ports << 16);
 }
 
-static inline bool
-ports_reverse_order(uint32_t ports)
+
+// host pair table
+
+inline uint32_t
+AggregateIPFlows::Map::home(const HostPair &hp) const
 {
-    return (int32_t) ((ports << 16) - ports) < 0;
+    uint32_t h = hp.a * 0x9E3779B1U + hp.b;
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    return (h * bucket_size) & _mask;
 }
 
-static inline uint32_t
-flip_ports(uint32_t ports)
+bool
+AggregateIPFlows::Map::resize(uint32_t n)
 {
-    return ((ports >> 16) & 0xFFFF) | (ports << 16);
+    char *mem = new char[n * sizeof(HostPairInfo) + 64];
+    if (!mem)
+	return false;
+    uintptr_t a = reinterpret_cast<uintptr_t>(mem) + 63;
+    HostPairInfo *old = _e;
+    uint32_t old_capacity = capacity();
+    char *old_mem = _mem;
+    _mem = mem;
+    _e = reinterpret_cast<HostPairInfo *>(a - a % 64);
+    _mask = n - 1;
+    for (uint32_t j = 0; j < n; j++)
+	new((void *) &_e[j]) HostPairInfo();
+    for (uint32_t j = 0; j < old_capacity; j++)
+	if (live(&old[j])) {
+	    uint32_t i = home(old[j]._hosts);
+	    while (live(&_e[i]))
+		i = (i + 1) & _mask;
+	    _e[i] = old[j];
+	}
+    delete[] old_mem;
+    return true;
+}
+
+AggregateIPFlows::HostPairInfo *
+AggregateIPFlows::Map::find_insert(const HostPair &hp)
+{
+    uint32_t i = 0;
+    if (_e)
+	for (i = home(hp); live(&_e[i]); i = (i + 1) & _mask)
+	    if (_e[i]._hosts == hp)
+		return &_e[i];
+
+    // keep the table at most 3/4 full
+    if (!_e || _size >= capacity() - capacity() / 4) {
+	if (!resize(_e ? capacity() * 2 : (uint32_t) min_capacity))
+	    return 0;
+	for (i = home(hp); live(&_e[i]); i = (i + 1) & _mask)
+	    /* nada */;
+    }
+    _e[i]._hosts = hp;
+    _e[i]._flows = 0;
+    _e[i]._fragments = 0;
+    ++_size;
+    return &_e[i];
+}
+
+void
+AggregateIPFlows::Map::erase(uint32_t i)
+{
+    // Shift later entries of the probe sequence back into the hole, unless
+    // their home bucket lies cyclically after the hole.
+    for (uint32_t j = (i + 1) & _mask; live(&_e[j]); j = (j + 1) & _mask) {
+	uint32_t k = home(_e[j]._hosts);
+	if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+	    _e[i] = _e[j];
+	    i = j;
+	}
+    }
+    _e[i] = HostPairInfo();
+    --_size;
+}
+
+void
+AggregateIPFlows::Map::clear()
+{
+    delete[] _mem;
+    _mem = 0;
+    _e = 0;
+    _mask = _size = 0;
+    _fragments.clear();
 }
 
 
 // actual AggregateIPFlows operations
 
 AggregateIPFlows::AggregateIPFlows()
+    : _flow_size(sizeof(FlowInfo)), _free_flow(0), _nflows(0)
 #if CLICK_USERLEVEL
-    : _traceinfo_file(0), _packet_source(0), _filepos_h(0)
+    , _traceinfo_file(0), _packet_source(0), _filepos_h(0)
 #endif
 {
 }
@@ -102,10 +179,12 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
     _udp_timeout = 60;
     _fragment_timeout = 30;
     _gc_interval = 20 * 60;
+    _reap_batch = 8;
     _fragments = 2;
     bool handle_icmp_errors = false;
     bool fragments_parsed;
     bool fragments = true;
+    bool recycle = false;
 
     if (Args(conf, this, errh)
 	.read("TCP_TIMEOUT", _tcp_timeout)
@@ -113,7 +192,9 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("UDP_TIMEOUT", SecondsArg(), _udp_timeout)
 	.read("FRAGMENT_TIMEOUT", SecondsArg(), _fragment_timeout)
 	.read("REAP", SecondsArg(), _gc_interval)
+	.read("REAP_BATCH", _reap_batch)
 	.read("ICMP", handle_icmp_errors)
+	.read("RECYCLE", recycle)
 #if CLICK_USERLEVEL
 	.read("TRACEINFO", FilenameArg(), _traceinfo_filename)
 	.read("SOURCE", ElementArg(), _packet_source)
@@ -125,6 +206,7 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
     _smallest_timeout = (_tcp_timeout < _tcp_done_timeout ? _tcp_timeout : _tcp_done_timeout);
     _smallest_timeout = (_smallest_timeout < _udp_timeout ? _smallest_timeout : _udp_timeout);
     _handle_icmp_errors = handle_icmp_errors;
+    _recycle = recycle;
     if (fragments_parsed)
 	_fragments = fragments;
     return 0;
@@ -133,8 +215,10 @@ AggregateIPFlows::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AggregateIPFlows::initialize(ErrorHandler *errh)
 {
-    _next = 1;
+    _ids.clear();
     _active_sec = _gc_sec = 0;
+    _reaping = 0;
+    _reap_pos = 0;
     _timestamp_warning = false;
 
 #if CLICK_USERLEVEL
@@ -151,6 +235,7 @@ AggregateIPFlows::initialize(ErrorHandler *errh)
 	    (void) HandlerCall::reset_read(_filepos_h, _packet_source, "packet_filepos");
 	}
 	fprintf(_traceinfo_file, ">\n");
+	_flow_size = sizeof(StatFlowInfo);
     }
 #endif
 
@@ -167,6 +252,10 @@ AggregateIPFlows::cleanup(CleanupStage)
 {
     clean_map(_tcp_map);
     clean_map(_udp_map);
+    for (int i = 0; i < _flow_blocks.size(); i++)
+	delete[] _flow_blocks[i];
+    _flow_blocks.clear();
+    _free_flow = _nflows = 0;
 #if CLICK_USERLEVEL
     if (_traceinfo_file && _traceinfo_file != stdout) {
 	fprintf(_traceinfo_file, "</trace>\n");
@@ -176,9 +265,33 @@ AggregateIPFlows::cleanup(CleanupStage)
 #endif
 }
 
+uint32_t
+AggregateIPFlows::new_flow()
+{
+    if (!_free_flow) {
+	if (memory_exceeded(FLOW_BLOCK * _flow_size))
+	    return 0;
+	uint32_t base = _flow_blocks.size() << FLOW_BLOCK_SHIFT;
+	char *block = new char[FLOW_BLOCK * _flow_size];
+	if (!block)
+	    return 0;
+	_flow_blocks.push_back(block);
+	// flow 0 is never used
+	for (uint32_t i = base + FLOW_BLOCK - 1; i >= base && i > 0; i--) {
+	    flow(i)->_next = _free_flow;
+	    _free_flow = i;
+	}
+    }
+    uint32_t i = _free_flow;
+    _free_flow = flow(i)->_next;
+    ++_nflows;
+    return i;
+}
+
 inline void
-AggregateIPFlows::delete_flowinfo(const HostPair &hp, FlowInfo *finfo, bool really_delete)
+AggregateIPFlows::delete_flowinfo(const HostPair &hp, uint32_t fi, bool really_delete)
 {
+    FlowInfo *finfo = flow(fi);
 #if CLICK_USERLEVEL
     if (_traceinfo_file) {
 	StatFlowInfo *sinfo = static_cast<StatFlowInfo *>(finfo);
@@ -199,29 +312,41 @@ AggregateIPFlows::delete_flowinfo(const HostPair &hp, FlowInfo *finfo, bool real
   <stream dir='0' packets='%d' /><stream dir='1' packets='%d' />\n\
 </flow>\n",
 		sinfo->_packets[0], sinfo->_packets[1]);
-	if (really_delete)
-	    delete sinfo;
-    } else
+    }
 #endif
-	if (really_delete)
-	    delete finfo;
+    if (really_delete)
+	free_flow(fi);
+}
+
+inline void
+AggregateIPFlows::end_aggregate(uint32_t agg)
+{
+    notify(agg, AggregateListener::DELETE_AGG, 0);
+    if (_recycle)
+	_ids.free(agg);
 }
 
 void
 AggregateIPFlows::clean_map(Map &table)
 {
-    // free completed flows and emit fragments
-    for (Map::iterator iter = table.begin(); iter.live(); iter++) {
-	HostPairInfo *hpinfo = &iter.value();
-	while (Packet *p = hpinfo->_fragment_head) {
-	    hpinfo->_fragment_head = p->next();
-	    p->kill();
+    // free all flows and fragments
+    for (uint32_t i = 0; i < table.capacity(); i++) {
+	HostPairInfo *hpinfo = table.entry(i);
+	if (!Map::live(hpinfo))
+	    continue;
+	if (hpinfo->_fragments) {
+	    FragmentList &fl = table.fragments(hpinfo->_hosts);
+	    while (Packet *p = fl._head) {
+		fl._head = p->next();
+		p->kill();
+	    }
 	}
-	while (FlowInfo *f = hpinfo->_flows) {
-	    hpinfo->_flows = f->_next;
-	    delete_flowinfo(iter.key(), f);
+	while (uint32_t fi = hpinfo->_flows) {
+	    hpinfo->_flows = flow(fi)->_next;
+	    delete_flowinfo(hpinfo->_hosts, fi);
 	}
     }
+    table.clear();
 }
 
 #if CLICK_USERLEVEL
@@ -231,6 +356,8 @@ AggregateIPFlows::stat_new_flow_hook(const Packet *p, FlowInfo *finfo)
     StatFlowInfo *sinfo = static_cast<StatFlowInfo *>(finfo);
     sinfo->_first_timestamp = p->timestamp_anno();
     sinfo->_filepos = 0;
+    // a dead flow may be reused before it is reaped
+    sinfo->_packets[0] = sinfo->_packets[1] = 0;
     if (_filepos_h)
 	(void) IntArg().parse(_filepos_h->call_read().trim_space(), sinfo->_filepos);
 }
@@ -266,54 +393,95 @@ AggregateIPFlows::packet_emit_hook(const Packet *p, const click_ip *iph, FlowInf
 #endif
 }
 
-void
-AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout)
+uint32_t
+AggregateIPFlows::reap_map(Map &table, uint32_t timeout, uint32_t done_timeout,
+			   uint32_t pos, uint32_t n)
 {
     timeout = _active_sec - timeout;
     done_timeout = _active_sec - done_timeout;
     int frag_timeout = _active_sec - _fragment_timeout;
 
-    // free completed flows and emit fragments
-    for (Map::iterator iter = table.begin(); iter.live(); iter++) {
-	HostPairInfo *hpinfo = &iter.value();
-	Packet *head;
-	// fragments
-	while ((head = hpinfo->_fragment_head)
-	       && (head->timestamp_anno().sec() < frag_timeout
-		   || !IP_ISFRAG(good_ip_header(head))))
-	    emit_fragment_head(hpinfo);
-
-	// can't delete any flows if there are fragments
-	if (hpinfo->_fragment_head)
+    // free completed flows and emit fragments in entries [pos, pos + n)
+    uint32_t end = table.capacity();
+    if (n < end - pos)
+	end = pos + n;
+    while (pos < end) {
+	HostPairInfo *hpinfo = table.entry(pos);
+	if (!Map::live(hpinfo)) {
+	    ++pos;
 	    continue;
+	}
+
+	// fragments
+	if (hpinfo->_fragments) {
+	    FragmentList &fl = table.fragments(hpinfo->_hosts);
+	    Packet *head;
+	    while ((head = fl._head)
+		   && (head->timestamp_anno().sec() < frag_timeout
+		       || !IP_ISFRAG(good_ip_header(head))))
+		emit_fragment_head(hpinfo, fl);
+
+	    // can't delete any flows if there are fragments
+	    if (fl._head) {
+		++pos;
+		continue;
+	    }
+	    table.erase_fragments(hpinfo->_hosts);
+	    hpinfo->_fragments = 0;
+	}
 
 	// completed flows
-	FlowInfo **pprev = &hpinfo->_flows;
-	FlowInfo *f = *pprev;
-	while (f) {
+	uint32_t *pprev = &hpinfo->_flows;
+	while (uint32_t fi = *pprev) {
+	    FlowInfo *f = flow(fi);
 	    // circular comparison
 	    if (SEC_OLDER(f->_last_timestamp.sec(), (f->_flow_over == 3 ? done_timeout : timeout))) {
-		notify(f->_aggregate, AggregateListener::DELETE_AGG, 0);
+		end_aggregate(f->_aggregate);
 		*pprev = f->_next;
-		delete_flowinfo(iter.key(), f);
+		delete_flowinfo(hpinfo->_hosts, fi);
 	    } else
 		pprev = &f->_next;
-	    f = *pprev;
 	}
-	// XXX never free host pairs
+
+	// free empty host pairs; erasing may move another entry to pos
+	if (!hpinfo->_flows)
+	    table.erase(pos);
+	else
+	    ++pos;
     }
+    return pos;
 }
 
 void
 AggregateIPFlows::reap()
 {
     if (_gc_sec) {
-	reap_map(_tcp_map, _tcp_timeout, _tcp_done_timeout);
-	reap_map(_udp_map, _udp_timeout, _udp_timeout);
+	if (_reap_batch) {
+	    _reaping = 1;
+	    _reap_pos = 0;
+	} else {
+	    reap_map(_tcp_map, _tcp_timeout, _tcp_done_timeout, 0, _tcp_map.capacity());
+	    reap_map(_udp_map, _udp_timeout, _udp_timeout, 0, _udp_map.capacity());
+	}
     }
     _gc_sec = _active_sec + _gc_interval;
 }
 
+void
+AggregateIPFlows::reap_step()
+{
+    uint32_t n = _reap_batch * Map::bucket_size;
+    if (_reaping == 1) {
+	_reap_pos = reap_map(_tcp_map, _tcp_timeout, _tcp_done_timeout, _reap_pos, n);
+	if (_reap_pos >= _tcp_map.capacity())
+	    _reaping = 2, _reap_pos = 0;
+    } else {
+	_reap_pos = reap_map(_udp_map, _udp_timeout, _udp_timeout, _reap_pos, n);
+	if (_reap_pos >= _udp_map.capacity())
+	    _reaping = 0;
+    }
+}
+
 const click_ip *
 AggregateIPFlows::icmp_encapsulated_header(const Packet *p)
 {
@@ -349,8 +517,9 @@ AggregateIPFlows::relevant_timeout(const FlowInfo *f, const Map &m) const
 AggregateIPFlows::FlowInfo *
 AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, bool flipped, const Packet *p)
 {
-    FlowInfo **pprev = &hpinfo->_flows;
-    for (FlowInfo *finfo = *pprev; finfo; pprev = &finfo->_next, finfo = finfo->_next)
+    uint32_t *pprev = &hpinfo->_flows;
+    for (uint32_t fi = *pprev; fi; pprev = &flow(fi)->_next, fi = *pprev) {
+	FlowInfo *finfo = flow(fi);
 	if (finfo->_ports == ports) {
 	    // if this flow is actually dead (but has not yet been garbage
 	    // collected), then kill it for consistent semantics
@@ -363,14 +532,13 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 		    && p->ip_header()->ip_p == IP_PROTO_TCP
 		    && (p->tcp_header()->th_flags & TH_SYN))) {
 		// old aggregate has died
-		notify(finfo->aggregate(), AggregateListener::DELETE_AGG, 0);
+		end_aggregate(finfo->aggregate());
 		const click_ip *iph = good_ip_header(p);
 		HostPair hp(iph->ip_src.s_addr, iph->ip_dst.s_addr);
-		delete_flowinfo(hp, finfo, false);
+		delete_flowinfo(hp, fi, false);
 
 		// make a new aggregate
-		finfo->_aggregate = _next;
-		_next++;
+		finfo->_aggregate = _ids.alloc();
 		finfo->_reverse = flipped;
 		finfo->_flow_over = 0;
 #if CLICK_USERLEVEL
@@ -383,45 +551,49 @@ AggregateIPFlows::find_flow_info(Map &m, HostPairInfo *hpinfo, uint32_t ports, b
 	    // otherwise, move to the front of the list and return
 	    *pprev = finfo->_next;
 	    finfo->_next = hpinfo->_flows;
-	    hpinfo->_flows = finfo;
+	    hpinfo->_flows = fi;
 	    return finfo;
 	}
+    }
 
     // make and install new FlowInfo pair
+    uint32_t fi = new_flow();
+    if (!fi)
+	return 0;
     FlowInfo *finfo;
+    uint32_t agg = _ids.alloc();
 #if CLICK_USERLEVEL
     if (stats()) {
-	finfo = new StatFlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new((void *) flow(fi)) StatFlowInfo(ports, hpinfo->_flows, agg);
 	stat_new_flow_hook(p, finfo);
     } else
 #endif
-	finfo = new FlowInfo(ports, hpinfo->_flows, _next);
+	finfo = new((void *) flow(fi)) FlowInfo(ports, hpinfo->_flows, agg);
 
     finfo->_reverse = flipped;
-    hpinfo->_flows = finfo;
-    _next++;
+    hpinfo->_flows = fi;
     notify(finfo->aggregate(), AggregateListener::NEW_AGG, p);
     return finfo;
 }
 
 void
-AggregateIPFlows::emit_fragment_head(HostPairInfo *hpinfo)
+AggregateIPFlows::emit_fragment_head(HostPairInfo *hpinfo, FragmentList &fl)
 {
-    Packet *head = hpinfo->_fragment_head;
-    hpinfo->_fragment_head = head->next();
+    Packet *head = fl._head;
+    fl._head = head->next();
 
     const click_ip *iph = good_ip_header(head);
     // XXX multiple linear traversals of entire fragment list!
     // want a faster method that takes up little memory?
 
     if (AGGREGATE_ANNO(head)) {
-	for (Packet *p = hpinfo->_fragment_head; p; p = p->next())
+	for (Packet *p = fl._head; p; p = p->next())
 	    if (good_ip_header(p)->ip_id == iph->ip_id) {
 		SET_AGGREGATE_ANNO(p, AGGREGATE_ANNO(head));
 		SET_PAINT_ANNO(p, PAINT_ANNO(head));
 	    }
     } else {
-	for (Packet *p = hpinfo->_fragment_head; p; p = p->next())
+	for (Packet *p = fl._head; p; p = p->next())
 	    if (good_ip_header(p)->ip_id == iph->ip_id
 		&& AGGREGATE_ANNO(p)) {
 		SET_AGGREGATE_ANNO(head, AGGREGATE_ANNO(p));
@@ -434,14 +606,19 @@ AggregateIPFlows::emit_fragment_head(HostPairInfo *hpinfo)
 
   find_flowinfo:
     // find the packet's FlowInfo
-    FlowInfo *finfo, **pprev = &hpinfo->_flows;
-    for (finfo = *pprev; finfo; pprev = &finfo->_next, finfo = *pprev)
-	if (finfo->_aggregate == AGGREGATE_ANNO(head)) {
-	    *pprev = finfo->_next;
-	    finfo->_next = hpinfo->_flows;
-	    hpinfo->_flows = finfo;
+    FlowInfo *finfo = 0;
+    uint32_t *pprev = &hpinfo->_flows;
+    for (uint32_t fi = *pprev; fi; fi = *pprev) {
+	FlowInfo *f = flow(fi);
+	if (f->_aggregate == AGGREGATE_ANNO(head)) {
+	    *pprev = f->_next;
+	    f->_next = hpinfo->_flows;
+	    hpinfo->_flows = fi;
+	    finfo = f;
 	    break;
 	}
+	pprev = &f->_next;
+    }
 
     assert(finfo);
     packet_emit_hook(head, iph, finfo);
@@ -449,23 +626,29 @@ AggregateIPFlows::emit_fragment_head(HostPairInfo *hpinfo)
 }
 
 int
-AggregateIPFlows::handle_fragment(Packet *p, HostPairInfo *hpinfo)
+AggregateIPFlows::handle_fragment(Packet *p, Map &m, HostPairInfo *hpinfo)
 {
-    if (hpinfo->_fragment_head)
-	hpinfo->_fragment_tail->set_next(p);
+    FragmentList &fl = m.fragments(hpinfo->_hosts);
+    if (fl._head)
+	fl._tail->set_next(p);
     else
-	hpinfo->_fragment_head = p;
-    hpinfo->_fragment_tail = p;
+	fl._head = p;
+    fl._tail = p;
+    hpinfo->_fragments = 1;
     p->set_next(0);
     _active_sec = p->timestamp_anno().sec();
 
     // get rid of old fragments
     int frag_timeout = _active_sec - _fragment_timeout;
     Packet *head;
-    while ((head = hpinfo->_fragment_head)
+    while ((head = fl._head)
 	   && (head->timestamp_anno().sec() < frag_timeout
 	       || !IP_ISFRAG(good_ip_header(head))))
-	emit_fragment_head(hpinfo);
+	emit_fragment_head(hpinfo, fl);
+    if (!fl._head) {
+	m.erase_fragments(hpinfo->_hosts);
+	hpinfo->_fragments = 0;
+    }
 
     return ACT_NONE;
 }
@@ -503,7 +686,11 @@ AggregateIPFlows::handle_packet(Packet *p)
     HostPair hosts(iph->ip_src.s_addr, iph->ip_dst.s_addr);
     if (hosts.a != iph->ip_src.s_addr)
 	paint ^= 1;
-    HostPairInfo *hpinfo = &m[hosts];
+    HostPairInfo *hpinfo = m.find_insert(hosts);
+    if (!hpinfo) {
+	click_chatter("out of memory!");
+	return ACT_DROP;
+    }
 
     // find relevant FlowInfo, if any
     FlowInfo *finfo;
@@ -523,7 +710,8 @@ AggregateIPFlows::handle_packet(Packet *p)
 
 	finfo = find_flow_info(m, hpinfo, ports, paint & 1, p);
 	if (!finfo) {
-	    click_chatter("out of memory!");
+	    if (!memory_exceeded())
+		click_chatter("out of memory!");
 	    return ACT_DROP;
 	}
 	if (finfo->reverse())
@@ -539,8 +727,8 @@ AggregateIPFlows::handle_packet(Packet *p)
     }
 
     // check for fragment
-    if ((_fragments && IP_ISFRAG(iph)) || hpinfo->_fragment_head)
-	return handle_fragment(p, hpinfo);
+    if ((_fragments && IP_ISFRAG(iph)) || hpinfo->_fragments)
+	return handle_fragment(p, m, hpinfo);
     else if (!finfo)
 	return ACT_DROP;
 
@@ -559,6 +747,8 @@ AggregateIPFlows::push(int, Packet *p)
     // GC if necessary
     if (_active_sec >= _gc_sec)
 	reap();
+    if (_reaping)
+	reap_step();
 
     if (action == ACT_EMIT)
 	output(0).push(p);
@@ -575,6 +765,8 @@ AggregateIPFlows::pull(int)
     // GC if necessary
     if (_active_sec >= _gc_sec)
 	reap();
+    if (_reaping)
+	reap_step();
 
     if (action == ACT_EMIT)
 	return p;
@@ -583,7 +775,30 @@ AggregateIPFlows::pull(int)
     return 0;
 }
 
-enum { H_CLEAR };
+enum { H_CLEAR, H_FLOWS, H_HOST_PAIRS, H_MEMORY_PER_FLOW };
+
+size_t
+AggregateIPFlows::memory_usage() const
+{
+    return _tcp_map.memory() + _udp_map.memory()
+	+ (size_t) _flow_blocks.size() * FLOW_BLOCK * _flow_size;
+}
+
+String
+AggregateIPFlows::read_handler(Element *e, void *thunk)
+{
+    AggregateIPFlows *af = static_cast<AggregateIPFlows *>(e);
+    switch ((intptr_t)thunk) {
+      case H_FLOWS:
+	return String(af->_nflows);
+      case H_HOST_PAIRS:
+	return String(af->_tcp_map.size() + af->_udp_map.size());
+      case H_MEMORY_PER_FLOW:
+	return String(af->_nflows ? af->memory_usage() / af->_nflows : 0);
+      default:
+	return String();
+    }
+}
 
 int
 AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
@@ -591,10 +806,11 @@ AggregateIPFlows::write_handler(const String &, Element *e, void *thunk, ErrorHa
     AggregateIPFlows *af = static_cast<AggregateIPFlows *>(e);
     switch ((intptr_t)thunk) {
       case H_CLEAR: {
-	  int active_sec = af->_active_sec, gc_sec = af->_gc_sec;
-	  af->_active_sec = af->_gc_sec = 0x7FFFFFFF;
-	  af->reap();
-	  af->_active_sec = active_sec, af->_gc_sec = gc_sec;
+	  int active_sec = af->_active_sec;
+	  af->_active_sec = 0x7FFFFFFF;
+	  af->reap_map(af->_tcp_map, af->_tcp_timeout, af->_tcp_done_timeout, 0, af->_tcp_map.capacity());
+	  af->reap_map(af->_udp_map, af->_udp_timeout, af->_udp_timeout, 0, af->_udp_map.capacity());
+	  af->_active_sec = active_sec;
 	  return 0;
       }
       default:
@@ -606,6 +822,10 @@ void
 AggregateIPFlows::add_handlers()
 {
     add_write_handler("clear", write_handler, H_CLEAR);
+    add_read_handler("flows", read_handler, H_FLOWS);
+    add_read_handler("host_pairs", read_handler, H_HOST_PAIRS);
+    add_read_handler("memory_per_flow", read_handler, H_MEMORY_PER_FLOW);
+    add_memory_limit_handler();
 }
 
 ELEMENT_REQUIRES(AggregateNotifier)
@@ -97,6 +97,14 @@ The timeout for fragments, in seconds, Default is 30 seconds.
 
 The garbage collection interval. Default is 20 minutes of packet time.
 
+=item REAP_BATCH
+
+Unsigned. Garbage collection is spread out over the packets that follow the
+start of each interval: each packet examines REAP_BATCH buckets of the flow
+table, each holding four host pairs, until the whole table has been examined.
+If 0, the whole table is examined at once, which can pause packet processing
+on large tables. Default is 8.
+
 =item ICMP
 
 Boolean. If true, then mark ICMP errors relating to a connection with an
@@ -110,15 +118,52 @@ Boolean. If true, then try to assign aggregate annotations to all fragments.
 May only be set to true if AggregateIPFlows is running in a push context.
 Default is true in a push context and false in a pull context.
 
+=item RECYCLE
+
+Boolean. If true, then a new flow reuses the aggregate annotation of a flow
+that has been deleted, most recently deleted first, so aggregate values stay
+close to the number of live flows. Downstream elements that do not listen for
+deleted aggregates, such as AggregateCounter, will then merge several flows'
+statistics. Default is false: every flow gets a new value.
+
 =back
 
 AggregateIPFlows is an AggregateNotifier, so AggregateListeners can request
 notifications when new aggregates are created and old ones are deleted.
 
+AggregateIPFlows keeps host pairs in an open-addressed hash table whose
+buckets are one cache line each, and allocates flows in blocks, so each flow
+costs little more than its own state. Host pairs with no remaining flows are
+freed during garbage collection.
+
+=h flows read-only
+
+Returns the number of flows currently stored.
+
+=h host_pairs read-only
+
+Returns the number of host pairs currently stored.
+
+=h memory read-only
+
+Returns the number of bytes used by the flow tables and flows.
+
+=h memory_per_flow read-only
+
+Returns the number of bytes used per stored flow, including the flow tables'
+overhead.
+
+=h memory_limit read/write
+
+Returns or sets a soft limit, in bytes, on C<memory>; 0, the default, means
+no limit. Over the limit, AggregateIPFlows stops allocating flows: packets
+that would start a new flow are dropped, or emitted on output 1, until
+expired flows free space.
+
 =h clear write-only
 
 Clears all flow information. Future packets will get new aggregate annotation
-values. This may cause packets to be emitted if FRAGMENTS is true.
+values (or, with RECYCLE, recycled ones). This may cause packets to be emitted if FRAGMENTS is true.
 
 =e
 
@@ -149,6 +194,7 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     ~AggregateIPFlows();
 
     const char *class_name() const	{ return "AggregateIPFlows"; }
+    const char *flags() const		{ return "T"; }
     void *cast(const char *);
     const char *port_count() const	{ return PORTS_1_1X2; }
     const char *processing() const	{ return PROCESSING_A_AH; }
@@ -157,6 +203,7 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     int initialize(ErrorHandler *);
     void add_handlers();
     void cleanup(CleanupStage);
+    size_t memory_usage() const;
 
 #if CLICK_USERLEVEL
     bool stats() const			{ return _traceinfo_file; }
@@ -177,16 +224,15 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 
   private:
 
+    // Flows live in blocks and are named by index; index 0 means none.
     struct FlowInfo {
 	uint32_t _ports;
 	uint32_t _aggregate;
 	Timestamp _last_timestamp;
+	uint32_t _next;
 	unsigned _flow_over : 2;
 	bool _reverse : 1;
-	FlowInfo *_next;
-	// have 24 bytes; statistics would double
-	// + 8 + 8 = 16 bytes
-	FlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg) : _ports(ports), _aggregate(agg), _flow_over(0), _next(next) { }
+	FlowInfo(uint32_t ports, uint32_t next, uint32_t agg) : _ports(ports), _aggregate(agg), _next(next), _flow_over(0) { }
 	uint32_t aggregate() const { return _aggregate; }
 	bool reverse() const	{ return _reverse; }
     };
@@ -196,23 +242,79 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 	Timestamp _first_timestamp;
 	uint32_t _filepos;
 	uint32_t _packets[2];
-	StatFlowInfo(uint32_t ports, FlowInfo *next, uint32_t agg) : FlowInfo(ports, next, agg) { _packets[0] = _packets[1] = 0; }
+	StatFlowInfo(uint32_t ports, uint32_t next, uint32_t agg) : FlowInfo(ports, next, agg) { _packets[0] = _packets[1] = 0; }
     };
 #endif
 
+    // An entry whose addresses are both 0 is empty.
     struct HostPairInfo {
-	FlowInfo *_flows;
-	Packet *_fragment_head;
-	Packet *_fragment_tail;
-	HostPairInfo() : _flows(0), _fragment_head(0), _fragment_tail(0) { }
-	FlowInfo *find_force(uint32_t ports);
+	HostPair _hosts;
+	uint32_t _flows;
+	uint32_t _fragments;	// nonzero if the Map holds fragments for it
+    };
+
+    struct FragmentList {
+	Packet *_head;
+	Packet *_tail;
+	FragmentList() : _head(0), _tail(0) { }
+    };
+
+    /* An open-addressed table of host pairs.  Each host pair hashes to a
+       bucket of four entries, one cache line, and is stored in the first
+       free entry at or after that bucket's start.  Erasing shifts later
+       entries back, so lookups never see tombstones.  Fragments, which are
+       rare, are kept on the side. */
+    class Map { public:
+
+	enum { bucket_size = 4, min_capacity = 1024 };
+
+	Map() : _mem(0), _e(0), _mask(0), _size(0) { }
+	~Map() { delete[] _mem; }
+
+	uint32_t capacity() const	{ return _e ? _mask + 1 : 0; }
+	uint32_t size() const		{ return _size; }
+	size_t memory() const		{ return _e ? capacity() * sizeof(HostPairInfo) + 64 : 0; }
+
+	HostPairInfo *entry(uint32_t i) const { return &_e[i]; }
+	static bool live(const HostPairInfo *e) { return e->_hosts.a || e->_hosts.b; }
+
+	HostPairInfo *find_insert(const HostPair &hp);
+	void erase(uint32_t i);
+	void clear();
+
+	FragmentList &fragments(const HostPair &hp) { return _fragments[hp]; }
+	void erase_fragments(const HostPair &hp) { _fragments.erase(hp); }
+
+      private:
+
+	char *_mem;
+	HostPairInfo *_e;
+	uint32_t _mask;
+	uint32_t _size;
+	HashTable<HostPair, FragmentList> _fragments;
+
+	inline uint32_t home(const HostPair &hp) const;
+	bool resize(uint32_t capacity);
+
+	Map(const Map &);
+	Map &operator=(const Map &);
+
     };
 
-    typedef HashTable<HostPair, HostPairInfo> Map;
     Map _tcp_map;
     Map _udp_map;
 
-    uint32_t _next;
+    enum { FLOW_BLOCK_SHIFT = 12, FLOW_BLOCK = 1 << FLOW_BLOCK_SHIFT };
+    Vector<char *> _flow_blocks;
+    uint32_t _flow_size;
+    uint32_t _free_flow;
+    uint32_t _nflows;
+
+    inline FlowInfo *flow(uint32_t) const;
+    uint32_t new_flow();
+    inline void free_flow(uint32_t);
+
+    AggregateIDAllocator _ids;
     unsigned _active_sec;
     unsigned _gc_sec;
 
@@ -223,8 +325,12 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
 
     unsigned _gc_interval;
     unsigned _fragment_timeout;
+    unsigned _reap_batch;
+    uint32_t _reap_pos;
+    int _reaping;			// 0: no, 1: TCP map, 2: UDP map
 
     bool _handle_icmp_errors : 1;
+    bool _recycle : 1;
     unsigned _fragments : 2;
     bool _timestamp_warning : 1;
 
@@ -239,27 +345,56 @@ class AggregateIPFlows : public Element, public AggregateNotifier { public:
     static const click_ip *icmp_encapsulated_header(const Packet *);
 
     void clean_map(Map &);
-    void reap_map(Map &, uint32_t, uint32_t);
+    uint32_t reap_map(Map &, uint32_t, uint32_t, uint32_t pos, uint32_t n);
     void reap();
+    void reap_step();
 
     inline int relevant_timeout(const FlowInfo *, const Map &) const;
 #if CLICK_USERLEVEL
     void stat_new_flow_hook(const Packet *, FlowInfo *);
 #endif
     inline void packet_emit_hook(const Packet *, const click_ip *, FlowInfo *);
-    inline void delete_flowinfo(const HostPair &, FlowInfo *, bool really_delete = true);
-    void emit_fragment_head(HostPairInfo *hpinfo);
+    inline void delete_flowinfo(const HostPair &, uint32_t, bool really_delete = true);
+    inline void end_aggregate(uint32_t agg);
+    void emit_fragment_head(HostPairInfo *hpinfo, FragmentList &);
     FlowInfo *find_flow_info(Map &, HostPairInfo *, uint32_t ports, bool flipped, const Packet *);
 
     FlowInfo *uncommon_case(FlowInfo *finfo, const click_ip *iph);
 
     enum { ACT_EMIT, ACT_DROP, ACT_NONE };
-    int handle_fragment(Packet *, HostPairInfo *);
+    int handle_fragment(Packet *, Map &, HostPairInfo *);
     int handle_packet(Packet *);
 
+    static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
 
+inline hashcode_t
+AggregateIPFlows::HostPair::hashcode() const
+{
+    return (a << 12) + b + ((a >> 20) & 0x1F);
+}
+
+inline bool
+operator==(const AggregateIPFlows::HostPair &a, const AggregateIPFlows::HostPair &b)
+{
+    return a.a == b.a && a.b == b.b;
+}
+
+inline AggregateIPFlows::FlowInfo *
+AggregateIPFlows::flow(uint32_t i) const
+{
+    return reinterpret_cast<FlowInfo *>(_flow_blocks[i >> FLOW_BLOCK_SHIFT] + (i & (FLOW_BLOCK - 1)) * _flow_size);
+}
+
+inline void
+AggregateIPFlows::free_flow(uint32_t i)
+{
+    flow(i)->_next = _free_flow;
+    _free_flow = i;
+    --_nflows;
+}
+
 CLICK_ENDDECLS
 #endif
@@ -24,7 +24,7 @@
 CLICK_DECLS
 
 AggregateLast::AggregateLast()
-    : _agg_notifier(0), _clear_task(this), _needs_clear(0)
+    : _agg_notifier(0), _memory(0), _clear_task(this), _needs_clear(0)
 {
     memset(_packets, 0, sizeof(_packets));
     memset(_counts, 0, sizeof(_counts));
@@ -77,6 +77,7 @@ AggregateLast::cleanup(CleanupStage)
 	}
 	delete[] _counts[i];
     }
+    _memory = 0;
 }
 
 Packet **
@@ -93,8 +94,11 @@ AggregateLast::create_row(uint32_t agg)
 	    delete[] _packets[planeno];
 	    _packets[planeno] = 0;
 	    return 0;
-	} else
+	} else {
 	    memset(_counts[planeno], 0, sizeof(uint32_t) * (NCOL + 1));
+	    _memory += sizeof(uint32_t) * (NCOL + 1);
+	}
+	_memory += sizeof(Packet **) * NCOL;
     }
     Packet ***plane = _packets[planeno];
 
@@ -103,6 +107,7 @@ AggregateLast::create_row(uint32_t agg)
 	if (!(plane[colno] = new Packet *[NROW]))
 	    return 0;
 	memset(plane[colno], 0, sizeof(Packet *) * NROW);
+	_memory += sizeof(Packet *) * NROW;
     }
 
     return plane[colno];
@@ -126,10 +131,12 @@ AggregateLast::push(int, Packet *p)
 	    SET_EXTRA_PACKETS_ANNO(p, EXTRA_PACKETS_ANNO(p) + 1 + EXTRA_PACKETS_ANNO(*r));
 	    SET_EXTRA_LENGTH_ANNO(p, EXTRA_LENGTH_ANNO(p) + (*r)->length() + EXTRA_LENGTH_ANNO(*r));
 	    SET_FIRST_TIMESTAMP_ANNO(p, FIRST_TIMESTAMP_ANNO(*r));
+	    _memory -= packet_memory(*r);
 	    checked_output_push(1, *r);
 	} else
 	    SET_FIRST_TIMESTAMP_ANNO(p, p->timestamp_anno());
 	*r = p;
+	_memory += packet_memory(p);
     }
 }
 
@@ -148,18 +155,21 @@ AggregateLast::aggregate_notify(uint32_t agg, AggregateEvent event, const Packet
 	    _counts[plane][NCOL]++;
     } else if (event == DELETE_AGG && *r) {
 	// XXX should we push in a notify function? Well why not.
+	_memory -= packet_memory(*r);
 	output(0).push(*r);
 	*r = 0;
 	if ((--_counts[plane][col]) == 0) {
 	    // get rid of empty row
 	    delete[] _packets[plane][col];
 	    _packets[plane][col] = 0;
+	    _memory -= sizeof(Packet *) * NROW;
 	    // get rid of empty column
 	    if ((--_counts[plane][NCOL]) == 0) {
 		delete[] _counts[plane];
 		_counts[plane] = 0;
 		delete[] _packets[plane];
 		_packets[plane] = 0;
+		_memory -= sizeof(uint32_t) * (NCOL + 1) + sizeof(Packet **) * NCOL;
 	    }
 	}
     }
@@ -189,6 +199,7 @@ AggregateLast::run_task(Task *)
 
     memset(_packets, 0, sizeof(_packets));
     memset(_counts, 0, sizeof(_counts));
+    _memory = 0;
 
     if (_stop_after_clear)
 	router()->please_stop_driver();
@@ -67,12 +67,14 @@ class AggregateLast : public Element, public AggregateListener { public:
     ~AggregateLast();
 
     const char *class_name() const	{ return "AggregateLast"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1X2; }
     const char *processing() const	{ return PUSH; }
 
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
+    size_t memory_usage() const		{ return _memory; }
 
     void push(int, Packet *);
     bool run_task(Task *);
@@ -89,6 +91,7 @@ class AggregateLast : public Element, public AggregateListener { public:
     Packet ***_packets[NPLANE];
     AggregateNotifier *_agg_notifier;
     uint32_t *_counts[NPLANE];
+    size_t _memory;		// bytes in _packets, _counts, and packets
 
     Task _clear_task;
     uint32_t _needs_clear;	// XXX atomic
@@ -96,6 +99,9 @@ class AggregateLast : public Element, public AggregateListener { public:
 
     Packet **create_row(uint32_t agg);
     inline Packet **row(uint32_t agg);
+    static size_t packet_memory(const Packet *p) {
+	return sizeof(WritablePacket) + p->buffer_length();
+    }
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
@@ -37,12 +37,12 @@ AggregateLength::bad_packet(Packet *p)
     return 0;
 }
 
-Packet *
-AggregateLength::handle_packet(Packet *p)
+inline bool
+AggregateLength::aggregate(Packet *p)
 {
     int offset;
     if (_ip && !p->has_network_header())
-	return bad_packet(p);
+	return false;
     else if (_ip)
 	offset = p->network_header_offset();
     else
@@ -51,23 +51,51 @@ AggregateLength::handle_packet(Packet *p)
     uint32_t len = p->length() - offset + EXTRA_LENGTH_ANNO(p);
     SET_AGGREGATE_ANNO(p, len);
 
-    return p;
+    return true;
+}
+
+Packet *
+AggregateLength::simple_action(Packet *p)
+{
+    return aggregate(p) ? p : bad_packet(p);
 }
 
 void
-AggregateLength::push(int, Packet *p)
+AggregateLength::simple_action_batch(PacketBatch &batch)
 {
-    if (Packet *q = handle_packet(p))
-	output(0).push(q);
+    if (!_ip) {
+	// every packet is good
+	for (Packet *p = batch.front(); p; p = p->next())
+	    SET_AGGREGATE_ANNO(p, p->length() + EXTRA_LENGTH_ANNO(p));
+	return;
+    }
+    PacketBatch out, bad;
+    while (Packet *p = batch.pop_front())
+	if (aggregate(p))
+	    out.push_back(p);
+	else
+	    bad.push_back(p);
+    if (noutputs() == 2)
+	output(1).push_batch(bad);
+    else
+	bad.kill();
+    batch.swap(out);
 }
 
-Packet *
-AggregateLength::pull(int)
+void
+AggregateLength::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+AggregateLength::pull_batch(int port, PacketBatch &batch, int max)
 {
-    Packet *p = input(0).pull();
-    if (p)
-	p = handle_packet(p);
-    return p;
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
 }
 
 CLICK_ENDDECLS
@@ -50,14 +50,16 @@ class AggregateLength : public Element { public:
 
     int configure(Vector<String> &, ErrorHandler *);
 
-    void push(int, Packet *);
-    Packet *pull(int);
+    Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &);
+    void push_batch(int, PacketBatch &);
+    void pull_batch(int, PacketBatch &, int);
 
   private:
 
     bool _ip;
 
-    Packet *handle_packet(Packet *);
+    inline bool aggregate(Packet *);
     Packet *bad_packet(Packet *);
 
 };
@@ -38,5 +38,42 @@ AggregateNotifier::notify(uint32_t agg, AggregateListener::AggregateEvent e, con
 	_listeners[i]->aggregate_notify(agg, e, p);
 }
 
+/* Hands out aggregate IDs starting at 1.  If freed IDs are recycled, a new
+   aggregate takes the most recently freed ID, so live IDs stay dense in
+   [1, bound()) and tables indexed by aggregate can stay small and flat. */
+class AggregateIDAllocator { public:
+
+    AggregateIDAllocator()		: _next(1) { }
+
+    uint32_t bound() const		{ return _next; }
+
+    void clear() {
+	_next = 1;
+	_free.clear();
+    }
+
+    uint32_t alloc() {
+	if (_free.size()) {
+	    uint32_t id = _free.back();
+	    _free.pop_back();
+	    return id;
+	}
+	uint32_t id = _next;
+	if (++_next == 0)
+	    ++_next;
+	return id;
+    }
+
+    void free(uint32_t id) {
+	_free.push_back(id);
+    }
+
+  private:
+
+    uint32_t _next;
+    Vector<uint32_t> _free;
+
+};
+
 CLICK_ENDDECLS
 #endif
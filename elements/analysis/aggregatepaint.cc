@@ -58,6 +58,34 @@ AggregatePaint::simple_action(Packet *p)
     return p;
 }
 
+void
+AggregatePaint::simple_action_batch(PacketBatch &batch)
+{
+    uint32_t mask = (1 << _bits) - 1;
+    if (_incremental)
+	for (Packet *p = batch.front(); p; p = p->next())
+	    SET_AGGREGATE_ANNO(p, (AGGREGATE_ANNO(p) << _bits) + (PAINT_ANNO(p) & mask));
+    else
+	for (Packet *p = batch.front(); p; p = p->next())
+	    SET_AGGREGATE_ANNO(p, PAINT_ANNO(p) & mask);
+}
+
+void
+AggregatePaint::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+AggregatePaint::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
 ELEMENT_REQUIRES(userlevel)
 EXPORT_ELEMENT(AggregatePaint)
 CLICK_ENDDECLS
@@ -49,6 +49,9 @@ class AggregatePaint : public Element { public:
     int configure(Vector<String> &, ErrorHandler *);
 
     Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &);
+    void push_batch(int, PacketBatch &);
+    void pull_batch(int, PacketBatch &, int);
 
   private:
 
@@ -30,10 +30,15 @@
 # include <unistd.h>
 # include <time.h>
 #endif
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define HAVE_ANONIPADDR_AESNI 1
+# include <cpuid.h>
+# include <immintrin.h>
+#endif
 CLICK_DECLS
 
 AnonymizeIPAddr::AnonymizeIPAddr()
-    : _root(0), _free(0)
+    : _cryptopan(false), _aesni(true)
 {
 }
 
@@ -41,22 +46,115 @@ AnonymizeIPAddr::~AnonymizeIPAddr()
 {
 }
 
-AnonymizeIPAddr::Node *
-AnonymizeIPAddr::new_node_block()
+/*
+ * AES-128 encryption for Crypto-PAn.  Only the forward cipher is needed.
+ * The ipsec package has faster code, but it is optional, and Crypto-PAn
+ * results must not depend on which packages were built.
+ */
+
+static const uint8_t aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static inline uint8_t
+aes_xtime(uint8_t x)
 {
-    assert(!_free);
-    int block_size = 1024;
-    Node *block = new Node[block_size];
-    if (!block)
-	return 0;
-    _blocks.push_back(block);
-    for (int i = 1; i < block_size - 1; i++)
-	block[i].child[0] = &block[i+1];
-    block[block_size - 1].child[0] = 0;
-    _free = &block[1];
-    return &block[0];
+    return (x << 1) ^ ((x & 0x80) ? 0x1b : 0);
 }
 
+static void
+aes_expand_key(uint8_t *rk, const uint8_t *key)
+{
+    memcpy(rk, key, 16);
+    uint8_t rcon = 1;
+    for (int i = 16; i < 176; i += 4) {
+	uint8_t t[4] = { rk[i-4], rk[i-3], rk[i-2], rk[i-1] };
+	if (i % 16 == 0) {
+	    uint8_t t0 = t[0];
+	    t[0] = aes_sbox[t[1]] ^ rcon;
+	    t[1] = aes_sbox[t[2]];
+	    t[2] = aes_sbox[t[3]];
+	    t[3] = aes_sbox[t0];
+	    rcon = aes_xtime(rcon);
+	}
+	for (int j = 0; j < 4; j++)
+	    rk[i+j] = rk[i+j-16] ^ t[j];
+    }
+}
+
+static void
+aes_encrypt(const uint8_t *rk, const uint8_t *in, uint8_t *out)
+{
+    uint8_t s[16], t[16];
+    for (int i = 0; i < 16; i++)
+	s[i] = in[i] ^ rk[i];
+    for (int round = 1; round <= 10; round++) {
+	// SubBytes and ShiftRows
+	for (int c = 0; c < 4; c++)
+	    for (int r = 0; r < 4; r++)
+		t[4*c + r] = aes_sbox[s[4*((c + r) & 3) + r]];
+	// MixColumns, except in the last round
+	if (round < 10)
+	    for (int c = 0; c < 16; c += 4) {
+		uint8_t a = t[c] ^ t[c+1] ^ t[c+2] ^ t[c+3], t0 = t[c];
+		t[c] ^= a ^ aes_xtime(t[c] ^ t[c+1]);
+		t[c+1] ^= a ^ aes_xtime(t[c+1] ^ t[c+2]);
+		t[c+2] ^= a ^ aes_xtime(t[c+2] ^ t[c+3]);
+		t[c+3] ^= a ^ aes_xtime(t[c+3] ^ t0);
+	    }
+	for (int i = 0; i < 16; i++)
+	    s[i] = t[i] ^ rk[16*round + i];
+    }
+    memcpy(out, s, 16);
+}
+
+#if HAVE_ANONIPADDR_AESNI
+static bool
+aesni_available()
+{
+    static int have = -1;
+    if (have < 0) {
+	unsigned a, b, c, d;
+	have = __get_cpuid(1, &a, &b, &c, &d) && (c & bit_AES);
+    }
+    return have;
+}
+
+// Encrypts 32 blocks, eight at a time so the AES units stay busy.
+__attribute__((target("aes"))) static void
+aesni_encrypt32(const uint8_t *rk, const uint8_t (*in)[16], uint8_t (*out)[16])
+{
+    __m128i k[11];
+    for (int r = 0; r <= 10; r++)
+	k[r] = _mm_loadu_si128((const __m128i *) (rk + 16*r));
+    for (int b = 0; b < 32; b += 8) {
+	__m128i x[8];
+	for (int j = 0; j < 8; j++)
+	    x[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in[b+j]), k[0]);
+	for (int r = 1; r < 10; r++)
+	    for (int j = 0; j < 8; j++)
+		x[j] = _mm_aesenc_si128(x[j], k[r]);
+	for (int j = 0; j < 8; j++)
+	    _mm_storeu_si128((__m128i *) out[b+j], _mm_aesenclast_si128(x[j], k[10]));
+    }
+}
+#endif
+
 static inline uint32_t
 rand32()
 {
@@ -67,16 +165,34 @@ int
 AnonymizeIPAddr::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _preserve_class = 0;
-    String preserve_8;
+    String preserve_8, key;
     bool seed_ignored;
 
     if (Args(conf, this, errh)
 	.read("CLASS", _preserve_class)
 	.read("PRESERVE_8", AnyArg(), preserve_8)
 	.read("SEED", seed_ignored)
+	.read("KEY", key)
+	.read("AESNI", _aesni)
 	.complete() < 0)
 	return -1;
 
+    // check KEY
+    if (key) {
+	if (key.length() != 32)
+	    return errh->error("KEY must be 32 bytes");
+	if (_preserve_class || preserve_8)
+	    return errh->error("CLASS and PRESERVE_8 cannot be used with KEY");
+	aes_expand_key(_round_keys, (const uint8_t *) key.data());
+	aes_encrypt(_round_keys, (const uint8_t *) key.data() + 16, _pad);
+	_cryptopan = true;
+#if HAVE_ANONIPADDR_AESNI
+	_aesni = _aesni && aesni_available();
+#else
+	_aesni = false;
+#endif
+    }
+
     // check CLASS value
     if (_preserve_class == 99)	// allow 99 as synonym for 32
 	_preserve_class = 32;
@@ -101,19 +217,27 @@ AnonymizeIPAddr::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 AnonymizeIPAddr::initialize(ErrorHandler *errh)
 {
-    if (!(_root = new_node()))
+    if (_cryptopan)
+	return 0;
+
+    CacheEntry empty = { 0, 0 };
+    _cache.assign(CACHE_SIZE, empty);
+
+    _nodes.reserve(1024);
+    if (new_node() != 0)
 	return errh->error("out of memory!");
-    _root->input = 1;		// use 1 instead of 0 b/c 0.0.0.0 is special
-    _root->output = rand32();
-    _root->child[0] = _root->child[1] = 0;
+    Node *root = &_nodes[0];
+    root->input = 1;		// use 1 instead of 0 b/c 0.0.0.0 is special
+    root->output = rand32();
+    root->child[0] = root->child[1] = 0;
     bool root_touched = false;
 
     // preserve classes
     if (_preserve_class > 0) {
 	assert((0xFFFFFFFFU >> 1) == 0x7FFFFFFFU);
 	uint32_t class_mask = ~(0xFFFFFFFFU >> _preserve_class);
-	_root->input = class_mask;
-	_root->output |= class_mask;
+	root->input = class_mask;
+	root->output |= class_mask;
 	root_touched = true;
     }
 
@@ -121,29 +245,27 @@ AnonymizeIPAddr::initialize(ErrorHandler *errh)
     for (int i = 0; i < _preserve_8.size(); i++) {
 	uint32_t addr = (_preserve_8[i] << 24);
 	if (!root_touched) {
-	    _root->input = addr;
-	    _root->output = (_root->output & 0x00FFFFFF) | addr;
+	    root->input = addr;
+	    root->output = (root->output & 0x00FFFFFF) | addr;
 	    root_touched = true;
-	} else if (Node *n = find_node(addr))
-	    n->output = (n->output & 0x00FFFFFF) | addr;
-	else
-	    return errh->error("out of memory!");
+	} else if (addr == 0)
+	    /* 0.0.0.0 always maps to itself */;
+	else {
+	    uint32_t n = find_node(addr);
+	    if (n == NONE)
+		return errh->error("out of memory!");
+	    _nodes[n].output = (_nodes[n].output & 0x00FFFFFF) | addr;
+	}
     }
 
-    // prepare special nodes for 0.0.0.0 and 255.255.255.255
-    memset(&_special_nodes[0], 0, sizeof(_special_nodes));
-    _special_nodes[0].input = _special_nodes[0].output = 0;
-    _special_nodes[1].input = _special_nodes[1].output = 0xFFFFFFFF;
-
     return 0;
 }
 
 void
 AnonymizeIPAddr::cleanup(CleanupStage)
 {
-    for (int i = 0; i < _blocks.size(); i++)
-	delete[] _blocks[i];
-    _blocks.clear();
+    _nodes.clear();
+    _cache.clear();
 }
 
 uint32_t
@@ -161,26 +283,22 @@ AnonymizeIPAddr::make_output(uint32_t old_output, int swivel) const
     }
 }
 
-AnonymizeIPAddr::Node *
-AnonymizeIPAddr::make_peer(uint32_t a, Node *n)
+uint32_t
+AnonymizeIPAddr::make_peer(uint32_t a, uint32_t ni)
 {
-    // watch out for special IP addresses, which never make it into the tree
-    if (a == 0 || a == 0xFFFFFFFFU)
-	return &_special_nodes[a & 1];
-
     /*
      * become a peer
      * algo: create two nodes, the two peers.  leave orig node as
      * the parent of the two new ones.
      */
 
-    Node *down[2];
-    if (!(down[0] = new_node()))
-	return 0;
-    if (!(down[1] = new_node())) {
-	free_node(down[0]);
-	return 0;
-    }
+    uint32_t down_i[2];
+    if ((down_i[0] = new_node()) == NONE
+	|| (down_i[1] = new_node()) == NONE)
+	return NONE;
+    // new_node() may have moved the array
+    Node *n = &_nodes[ni];
+    Node *down[2] = { &_nodes[down_i[0]], &_nodes[down_i[1]] };
 
     // swivel is first bit 'a' and 'old->input' differ
     int swivel = ffs_msb(a ^ n->input);
@@ -195,45 +313,91 @@ AnonymizeIPAddr::make_peer(uint32_t a, Node *n)
 
     n->input = down[1]->input;	/* NB: 1s to the right (0s to the left) */
     n->output = down[1]->output;
-    n->child[0] = down[0];	/* point to children */
-    n->child[1] = down[1];
+    n->child[0] = down_i[0];	/* point to children */
+    n->child[1] = down_i[1];
 
-    return down[bitvalue];
+    return down_i[bitvalue];
 }
 
-AnonymizeIPAddr::Node *
+uint32_t
 AnonymizeIPAddr::find_node(uint32_t a)
 {
-    // straight outta tcpdpriv
-    Node *n = _root;
-    while (n) {
-	if (n->input == a)
-	    return n;
-	if (!n->child[0])
-	    n = make_peer(a, n);
+    // straight outta tcpdpriv; special IP addresses never make it into
+    // the tree
+    assert(a != 0 && a != 0xFFFFFFFFU);
+    uint32_t ni = 0;
+    while (ni != NONE) {
+	const Node &n = _nodes[ni];
+	if (n.input == a)
+	    return ni;
+	if (!n.child[0])
+	    ni = make_peer(a, ni);
 	else {
 	    // swivel is the first bit in which the two children differ
-	    int swivel = ffs_msb(n->child[0]->input ^ n->child[1]->input);
-	    if (ffs_msb(a ^ n->input) < swivel) // input differs earlier
-		n = make_peer(a, n);
+	    const Node &c0 = _nodes[n.child[0]], &c1 = _nodes[n.child[1]];
+	    int swivel = ffs_msb(c0.input ^ c1.input);
+	    if (ffs_msb(a ^ n.input) < swivel) // input differs earlier
+		ni = make_peer(a, ni);
 	    else if (a & (1 << (32 - swivel)))
-		n = n->child[1];
+		ni = n.child[1];
 	    else
-		n = n->child[0];
+		ni = n.child[0];
 	}
     }
 
     click_chatter("AnonymizeIPAddr: out of memory!");
-    return 0;
+    return NONE;
+}
+
+uint32_t
+AnonymizeIPAddr::cryptopan(uint32_t a) const
+{
+    // Output bit i is input bit i XORed with the top bit of the
+    // encryption of a block holding the first i input bits, padded with
+    // the rest of _pad.  The 32 encryptions are independent.
+    uint8_t in[32][16], out[32][16];
+    uint32_t pad4 = (_pad[0] << 24) | (_pad[1] << 16) | (_pad[2] << 8) | _pad[3];
+    for (int pos = 0; pos < 32; pos++) {
+	uint32_t mask = pos ? 0xFFFFFFFFU << (32 - pos) : 0;
+	uint32_t x = (a & mask) | (pad4 & ~mask);
+	in[pos][0] = x >> 24;
+	in[pos][1] = x >> 16;
+	in[pos][2] = x >> 8;
+	in[pos][3] = x;
+	memcpy(&in[pos][4], &_pad[4], 12);
+    }
+#if HAVE_ANONIPADDR_AESNI
+    if (_aesni)
+	aesni_encrypt32(_round_keys, in, out);
+    else
+#endif
+    for (int pos = 0; pos < 32; pos++)
+	aes_encrypt(_round_keys, in[pos], out[pos]);
+
+    uint32_t result = 0;
+    for (int pos = 0; pos < 32; pos++)
+	result |= (uint32_t) (out[pos][0] >> 7) << (31 - pos);
+    return a ^ result;
 }
 
 inline uint32_t
 AnonymizeIPAddr::anonymize_addr(uint32_t a)
 {
-    if (Node *n = find_node(ntohl(a)))
-	return htonl(n->output);
-    else
-	return 0;
+    uint32_t ha = ntohl(a);
+    if (ha == 0 || ha == 0xFFFFFFFFU)
+	return a;
+    if (_cryptopan)
+	return htonl(cryptopan(ha));
+
+    CacheEntry &c = _cache[(ha ^ (ha >> 12) ^ (ha >> 24)) & (CACHE_SIZE - 1)];
+    if (c.input != ha) {
+	uint32_t n = find_node(ha);
+	if (n == NONE)
+	    return 0;
+	c.input = ha;
+	c.output = _nodes[n].output;
+    }
+    return htonl(c.output);
 }
 
 void
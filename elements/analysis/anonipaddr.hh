@@ -32,6 +32,17 @@ AnonymizeIPAddr only manipulates the IP header pointed to by the IP header
 annotation. This differs from tcpdpriv, which also anonymizes addresses on
 encapsulated IP headers for protocol 4 (ipip).
 
+By default, AnonymizeIPAddr builds its mapping as it goes, in a trie of the
+addresses seen so far, with random output bits. The mapping therefore depends
+on the order addresses arrive in, and differs from run to run. Given KEY,
+AnonymizeIPAddr instead uses the Crypto-PAn scheme, in which each output bit
+is derived from the corresponding input prefix by AES-128 encryption under
+KEY. That mapping is a fixed function of KEY, so separate runs, or separate
+AnonymizeIPAddr elements on separate threads, anonymize consistently without
+sharing any state. Crypto-PAn costs 32 AES encryptions per address; they are
+independent, and AnonymizeIPAddr runs them eight at a time with the AES-NI
+instructions when the CPU has them.
+
 Keyword arguments are:
 
 =over 8
@@ -44,7 +55,7 @@ if the corresponding input address was in class A. If CLASS is 2, then class B
 is preserved as well. CLASS 3 preserves classes A, B, and C, and CLASS 4
 preserves classes A, B, C, and D. The CLASS flag works by preserving leading
 one bits; higher CLASSes, up to 32, preserve more one bits. Default CLASS is 0
-E<lparen>no preservation).
+E<lparen>no preservation). Not allowed with KEY.
 
 =item PRESERVE_8
 
@@ -70,6 +81,20 @@ to each other. Here is the complete list:
       64-127     ...      64-127
      128-255     ...     128-255
 
+Not allowed with KEY.
+
+=item KEY
+
+String of 32 bytes. If given, use Crypto-PAn: the first 16 bytes are the AES
+key and the last 16 bytes determine the padding. The result is compatible
+with the reference Crypto-PAn implementation, except that 0.0.0.0 and
+255.255.255.255 are still mapped to themselves.
+
+=item AESNI
+
+Boolean. If true, use the AES-NI instructions for KEY when the CPU supports
+them. The result is the same either way. Default is true.
+
 =back
 
 =n
@@ -109,49 +134,54 @@ class AnonymizeIPAddr : public Element { public:
 
   private:
 
+    // Trie nodes live in one array and refer to their children by index.
+    // The root is node 0, which is never a child, so a child index of 0
+    // means the node is a leaf.
     struct Node {
 	uint32_t input;
 	uint32_t output;
-	Node *child[2];
+	uint32_t child[2];
     };
+    enum { NONE = 0xFFFFFFFFU };
+
+    Vector<Node> _nodes;
 
-    Node *_root;
-    Node *_free;
-    Vector<Node *> _blocks;
-    Node _special_nodes[2];
+    // recent trie results, direct-mapped by address; 0.0.0.0 is never
+    // looked up, so an input of 0 marks an empty slot
+    struct CacheEntry {
+	uint32_t input;
+	uint32_t output;
+    };
+    enum { CACHE_SIZE = 4096 };
+    Vector<CacheEntry> _cache;
 
     int _preserve_class;
     Vector<uint32_t> _preserve_8;
 
-    Node *new_node();
-    Node *new_node_block();
-    void free_node(Node *);
+    // Crypto-PAn state, read-only after initialize()
+    bool _cryptopan;
+    bool _aesni;
+    uint8_t _round_keys[176];
+    uint8_t _pad[16];
+
+    uint32_t new_node();
 
     uint32_t make_output(uint32_t, int) const;
-    Node *make_peer(uint32_t, Node *);
-    Node *find_node(uint32_t);
+    uint32_t make_peer(uint32_t, uint32_t);
+    uint32_t find_node(uint32_t);
+    uint32_t cryptopan(uint32_t) const;
     inline uint32_t anonymize_addr(uint32_t);
 
     void handle_icmp(WritablePacket *);
 
 };
 
-inline AnonymizeIPAddr::Node *
+inline uint32_t
 AnonymizeIPAddr::new_node()
 {
-    if (_free) {
-	Node *n = _free;
-	_free = n->child[0];
-	return n;
-    } else
-	return new_node_block();
-}
-
-inline void
-AnonymizeIPAddr::free_node(Node *n)
-{
-    n->child[0] = _free;
-    _free = n;
+    int n = _nodes.size();
+    _nodes.push_back(Node());
+    return _nodes.size() == n ? (uint32_t) NONE : (uint32_t) n;
 }
 
 CLICK_ENDDECLS
@@ -60,12 +60,15 @@ FromDAGDump::configure(Vector<String> &conf, ErrorHandler *errh)
     Timestamp first_time, first_time_off, last_time, last_time_off, interval;
     HandlerCall end_h;
     String encap;
+    Vector<String> merge;
     _sampling_prob = (1 << SAMPLING_SHIFT);
 
+    Vector<String> ff_conf(conf);
     if (_ff.configure_keywords(conf, this, errh) < 0)
 	return -1;
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _ff.filename())
+	.read_all_with("MERGE", AnyArg(), merge)
 	.read("STOP", stop)
 	.read("ACTIVE", active)
 	.read("FORCE_IP", force_ip)
@@ -134,6 +137,26 @@ FromDAGDump::configure(Vector<String> &conf, ErrorHandler *errh)
 		 && _base_linktype != FAKE_DLT_RAW))
 	return errh->error("bad encapsulation type");
 
+    // files to merge
+    if (merge.size()) {
+	Source s;
+	s.ff = &_ff;
+	s.p = 0;
+	s.linktype = FAKE_DLT_NONE;
+	_sources.push_back(s);
+    }
+    for (String *it = merge.begin(); it != merge.end(); ++it) {
+	Source s;
+	s.ff = new FromFile;
+	s.p = 0;
+	s.linktype = FAKE_DLT_NONE;
+	_sources.push_back(s);
+	Vector<String> ffc(ff_conf);
+	if (!FilenameArg().parse(*it, s.ff->filename())
+	    || s.ff->configure_keywords(ffc, this, errh) < 0)
+	    return errh->error("bad MERGE filename");
+    }
+
     // set other variables
     _have_any_times = false;
     _timing = timing;
@@ -157,6 +180,13 @@ FromDAGDump::initialize(ErrorHandler *errh)
     if (_end_h && _end_h->initialize_write(this, errh) < 0)
 	return -1;
 
+    // open the merged files and read the first packet of each
+    for (Source *s = _sources.begin(); s != _sources.end(); ++s) {
+	if (s->ff != &_ff && s->ff->initialize(errh) < 0)
+	    return -1;
+	s->p = read_record(*s->ff, s->linktype, errh);
+    }
+
     // try reading a packet
     if (read_packet(errh))
 	_time_offset = Timestamp::now() - _packet->timestamp_anno();
@@ -173,6 +203,13 @@ FromDAGDump::cleanup(CleanupStage)
     if (_packet)
 	_packet->kill();
     _packet = 0;
+    for (Source *s = _sources.begin(); s != _sources.end(); ++s) {
+	if (s->p)
+	    s->p->kill();
+	if (s->ff != &_ff)
+	    delete s->ff;
+    }
+    _sources.clear();
 }
 
 void
@@ -231,63 +268,34 @@ FromDAGDump::prepare_times(const Timestamp &tv)
     _have_any_times = true;
 }
 
-bool
-FromDAGDump::read_packet(ErrorHandler *errh)
+Packet *
+FromDAGDump::read_record(FromFile &ff, int &linktype, ErrorHandler *errh)
 {
     const DAGCell *cell;
     static DAGCell static_cell;
     Timestamp tv;
     Packet *p;
-    bool more = true;
-    _packet = 0;
-
-  retry:
-    // quit if we sampled or force_ip failed, but we are no longer active
-    if (!more)
-	return false;
 
     // we may need to read bits of the file
-    cell = reinterpret_cast<const DAGCell *>(_ff.get_aligned(DAGCell::HEADER_SIZE, &static_cell, errh));
+    cell = reinterpret_cast<const DAGCell *>(ff.get_aligned(DAGCell::HEADER_SIZE, &static_cell, errh));
     if (!cell)
-	return false;
-
-    // check times
-  check_times:
+	return 0;
     stamp_to_time(swapq(cell->timestamp), tv);
-    if (!_have_any_times)
-	prepare_times(tv);
-    if (_have_first_time) {
-	if (tv < _first_time)
-	    goto retry;
-	else
-	    _have_first_time = false;
-    }
-    if (_have_last_time && tv >= _last_time) {
-	_have_last_time = false;
-	(void) _end_h->call_write(errh);
-	if (!_active)
-	    more = false;
-	// retry _last_time in case someone changed it
-	goto check_times;
-    }
-
-    // checking sampling probability
-    if (_sampling_prob < (1 << SAMPLING_SHIFT)
-	&& (click_random() & ((1<<SAMPLING_SHIFT)-1)) >= _sampling_prob)
-	goto retry;
 
     // determine read length and wire length
     uint32_t wire_length = 0;
+    uint32_t flow = 0;
+    bool have_flow = false;
     if (cell->type == DAGCell::TYPE_LEGACY || _base_linktype >= 0) {
       use_base_linktype:
-	_linktype = _base_linktype;
+	linktype = _base_linktype;
 	switch (_base_linktype) {
 
 	  cell:
 	  case FAKE_DLT_ATM_RFC1483:
 	  case FAKE_DLT_PPP:
 	  case FAKE_DLT_PPP_HDLC:
-	    p = _ff.get_packet(DAGCell::CELL_SIZE - DAGCell::HEADER_SIZE, tv.sec(), tv.subsec(), errh);
+	    p = ff.get_packet(DAGCell::CELL_SIZE - DAGCell::HEADER_SIZE, tv.sec(), tv.subsec(), errh);
 	    break;
 
 	  case FAKE_DLT_C_HDLC:
@@ -295,60 +303,152 @@ FromDAGDump::read_packet(ErrorHandler *errh)
 	    goto cell;
 
 	  case FAKE_DLT_NONE:
-	    _linktype = FAKE_DLT_ATM_RFC1483;
+	    linktype = FAKE_DLT_ATM_RFC1483;
 	    goto cell;
 
 	  case FAKE_DLT_SUNATM:
-	    p = _ff.get_packet_from_data(reinterpret_cast<const uint8_t*>(cell) + 12, 4, DAGCell::CELL_SIZE - 12, tv.sec(), tv.subsec(), errh);
+	    p = ff.get_packet_from_data(reinterpret_cast<const uint8_t*>(cell) + 12, 4, DAGCell::CELL_SIZE - 12, tv.sec(), tv.subsec(), errh);
 	    break;
 
 	  case FAKE_DLT_EN10MB:
 	    wire_length = htons(*(reinterpret_cast<const uint16_t*>(cell) + 4));
-	    p = _ff.get_packet_from_data(reinterpret_cast<const uint8_t*>(cell) + 10, 6, DAGCell::CELL_SIZE - 10, tv.sec(), tv.subsec(), errh);
+	    p = ff.get_packet_from_data(reinterpret_cast<const uint8_t*>(cell) + 10, 6, DAGCell::CELL_SIZE - 10, tv.sec(), tv.subsec(), errh);
 	    break;
 
 	  default:
-	    p = _ff.get_packet_from_data(reinterpret_cast<const uint8_t*>(cell) + 8, 8, DAGCell::CELL_SIZE - 8, tv.sec(), tv.subsec(), errh);
+	    p = ff.get_packet_from_data(reinterpret_cast<const uint8_t*>(cell) + 8, 8, DAGCell::CELL_SIZE - 8, tv.sec(), tv.subsec(), errh);
 	    break;
 	}
 
     } else {
-	int read_length = htons(cell->rlen);
+	int type = cell->type;
+	int read_length = htons(cell->rlen) - DAGCell::HEADER_SIZE;
 	wire_length = htons(cell->wlen);
-	switch (cell->type) {
+	// 'cell' may be invalid once we read further
+	if (type & DAGCell::TYPE_EXT) {
+	    uint8_t ext_buf[EXT_SIZE];
+	    const uint8_t *ext;
+	    do {
+		if (read_length < EXT_SIZE
+		    || !(ext = ff.get_unaligned(EXT_SIZE, ext_buf, errh)))
+		    return 0;
+		read_length -= EXT_SIZE;
+		if ((ext[0] & EXT_TYPE_MASK) == EXT_FLOW_ID) {
+		    flow = (ext[4] << 24) | (ext[5] << 16) | (ext[6] << 8) | ext[7];
+		    have_flow = true;
+		}
+	    } while (ext[0] & EXT_MORE);
+	}
+	switch (type & DAGCell::TYPE_MASK) {
 	  case DAGCell::TYPE_ATM:
 	  case DAGCell::TYPE_AAL5:
-	    _linktype = FAKE_DLT_SUNATM;
+	    linktype = FAKE_DLT_SUNATM;
 	    break;
 	  case DAGCell::TYPE_ETH:
-	    _ff.shift_pos(2);
+	  case DAGCell::TYPE_COLOR_ETH:
+	  case DAGCell::TYPE_DSM_COLOR_ETH:
+	  case DAGCell::TYPE_COLOR_HASH_ETH:
+	    ff.shift_pos(2);
 	    read_length -= 2;
 	    wire_length -= 4;	// XXX DAG 'wlen' includes CRC
-	    _linktype = FAKE_DLT_EN10MB;
+	    linktype = FAKE_DLT_EN10MB;
 	    break;
 	  case DAGCell::TYPE_HDLC_POS:
-	    _linktype = FAKE_DLT_C_HDLC;
+	  case DAGCell::TYPE_COLOR_HDLC_POS:
+	  case DAGCell::TYPE_DSM_COLOR_HDLC_POS:
+	  case DAGCell::TYPE_COLOR_HASH_POS:
+	    linktype = FAKE_DLT_C_HDLC;
+	    break;
+	  case DAGCell::TYPE_IPV4:
+	  case DAGCell::TYPE_IPV6:
+	    linktype = FAKE_DLT_RAW;
 	    break;
 	  default:		// indicates an old-format dump
 	    if (_base_linktype == FAKE_DLT_NONE)
 		_base_linktype = FAKE_DLT_ATM_RFC1483;
 	    if (errh) {
-		errh->warning("odd DAG cell type %d, assuming old-style ATM encapsulation", cell->type);
+		errh->warning("odd DAG cell type %d, assuming old-style ATM encapsulation", type);
 		errh->message("(To avoid this warning, specify an explicit ENCAP.)");
 	    } else
-		click_chatter("%{element}: DAG cell with odd type %d, assuming old-style\n  ATM encapsulation for rest of dump.  Packets may have been read incorrectly!\n  (To avoid this warning, specify an explicit ENCAP.)", this, cell->type);
+		click_chatter("%{element}: DAG cell with odd type %d, assuming old-style\n  ATM encapsulation for rest of dump.  Packets may have been read incorrectly!\n  (To avoid this warning, specify an explicit ENCAP.)", this, type);
 	    goto use_base_linktype;
 	}
-	if (read_length < DAGCell::HEADER_SIZE)
-	    return false;
-	p = _ff.get_packet(read_length - DAGCell::HEADER_SIZE, tv.sec(), tv.subsec(), errh);
+	if (read_length < 0)
+	    return 0;
+	p = ff.get_packet(read_length, tv.sec(), tv.subsec(), errh);
+    }
+
+    if (p) {
+	if (wire_length)
+	    SET_EXTRA_LENGTH_ANNO(p, wire_length - p->length());
+	if (have_flow)
+	    SET_AGGREGATE_ANNO(p, flow);
     }
+    return p;
+}
+
+Packet *
+FromDAGDump::read_merged(ErrorHandler *errh)
+{
+    // a few files at most, so a linear scan beats a heap
+    Source *next = 0;
+    for (Source *s = _sources.begin(); s != _sources.end(); ++s)
+	if (s->p && (!next || s->p->timestamp_anno() < next->p->timestamp_anno()))
+	    next = s;
+    if (!next)
+	return 0;
+    Packet *p = next->p;
+    _linktype = next->linktype;
+    next->p = read_record(*next->ff, next->linktype, errh);
+    return p;
+}
+
+bool
+FromDAGDump::read_packet(ErrorHandler *errh)
+{
+    Packet *p;
+    bool more = true;
+    _packet = 0;
 
-    // check packet
+  retry:
+    // quit if we sampled or force_ip failed, but we are no longer active
+    if (!more)
+	return false;
+
+    if (_sources.size())
+	p = read_merged(errh);
+    else
+	p = read_record(_ff, _linktype, errh);
     if (!p)
 	return false;
-    if (wire_length)
-	SET_EXTRA_LENGTH_ANNO(p, wire_length - p->length());
+
+    // check times
+  check_times:
+    const Timestamp &tv = p->timestamp_anno();
+    if (!_have_any_times)
+	prepare_times(tv);
+    if (_have_first_time) {
+	if (tv < _first_time) {
+	    p->kill();
+	    goto retry;
+	} else
+	    _have_first_time = false;
+    }
+    if (_have_last_time && tv >= _last_time) {
+	_have_last_time = false;
+	(void) _end_h->call_write(errh);
+	if (!_active)
+	    more = false;
+	// retry _last_time in case someone changed it
+	goto check_times;
+    }
+
+    // checking sampling probability
+    if (_sampling_prob < (1 << SAMPLING_SHIFT)
+	&& (click_random() & ((1<<SAMPLING_SHIFT)-1)) >= _sampling_prob) {
+	p->kill();
+	goto retry;
+    }
 
     if (_force_ip && !fake_pcap_force_ip(p, _linktype)) {
 	checked_output_push(1, p);
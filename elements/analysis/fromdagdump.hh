@@ -92,6 +92,12 @@ probability.
 Boolean. If true, then FromDAGDump tries to maintain the inter-packet timing
 of the original packet stream. False by default.
 
+=item MERGE
+
+Filename.  Read this ERF file too, interleaving its packets with the others'
+by timestamp.  Each file must be in timestamp order.  May be given more than
+once.  The MMAP and PREFETCH settings apply to every file.
+
 =item ENCAP
 
 Legacy encapsulation type ("IP", "ATM", "SUNATM", "ETHER", "PPP", or
@@ -109,6 +115,14 @@ FromDAGDump's regular file discipline is pretty optimized, so the difference
 is often small in practice. Default is true on most operating systems, but
 false on Linux.
 
+=item PREFETCH
+
+Unsigned. If nonzero, then FromDAGDump reads the file on a separate thread,
+keeping up to this many 256KB chunks ahead of the data it is processing, so
+that it rarely waits for the disk. Gzip-compressed files are decompressed on
+that thread too, instead of by a zcat(1) process. Setting PREFETCH turns off
+MMAP. Requires multithreading support. Default is 0.
+
 =back
 
 You can supply at most one of START and START_AFTER, and at most one of END,
@@ -121,6 +135,14 @@ Only available in user-level processes.
 FromDAGDump sets packets' extra length annotations to any additional length
 recorded in the dump.
 
+FromDAGDump understands ERF records of the HDLC_POS, ETH, ATM, and AAL5 types,
+their colored variants, and the IPV4 and IPV6 types.  It skips ERF extension
+headers, except that a flow ID extension header's 32-bit flow hash becomes the
+packet's aggregate annotation.
+
+With MMAP, packets point into the mapped file rather than holding copies, so
+they are read-only; elements that modify them will copy them first.
+
 =h sampling_prob read-only
 
 Returns the sampling probability (see the SAMPLE keyword argument).
@@ -135,7 +157,7 @@ Returns the previous packet's encapsulation type.
 
 =h filename read-only
 
-Returns the filename supplied to FromDAGDump.
+Returns the FILENAME supplied to FromDAGDump.
 
 =h filesize read-only
 
@@ -213,6 +235,24 @@ class FromDAGDump : public Element { public:
 	enum { HEADER_SIZE = 16, CELL_SIZE = 64 };
 	enum { TYPE_LEGACY = 0, TYPE_HDLC_POS = 1, TYPE_ETH = 2, TYPE_ATM = 3,
 	       TYPE_AAL5 = 4, TYPE_MAX = TYPE_AAL5 };
+	enum { TYPE_COLOR_HDLC_POS = 10, TYPE_COLOR_ETH = 11,
+	       TYPE_DSM_COLOR_HDLC_POS = 15, TYPE_DSM_COLOR_ETH = 16,
+	       TYPE_COLOR_HASH_POS = 19, TYPE_COLOR_HASH_ETH = 20,
+	       TYPE_IPV4 = 22, TYPE_IPV6 = 23 };
+	enum { TYPE_EXT = 0x80, TYPE_MASK = 0x7F };
+    };
+
+    // ERF extension headers follow the record header when its type has
+    // TYPE_EXT set; each header's first byte has EXT_MORE set if another
+    // follows
+    enum { EXT_SIZE = 8, EXT_MORE = 0x80, EXT_TYPE_MASK = 0x7F,
+	   EXT_FLOW_ID = 16 };
+
+    // another file merged into the output, and its next packet
+    struct Source {
+	FromFile *ff;
+	Packet *p;
+	int linktype;
     };
 
     static const uint32_t BUFFER_SIZE = 32768;
@@ -245,6 +285,10 @@ class FromDAGDump : public Element { public:
 
     Timestamp _time_offset;
 
+    Vector<Source> _sources;	// empty unless MERGE was given
+
+    Packet *read_record(FromFile &ff, int &linktype, ErrorHandler *errh);
+    Packet *read_merged(ErrorHandler *errh);
     bool read_packet(ErrorHandler *);
 
     void stamp_to_time(uint64_t, Timestamp &) const;
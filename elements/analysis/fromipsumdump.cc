@@ -73,8 +73,10 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool stop = false, active = true, zero = true, checksum = false, multipacket = false, timing = false, allow_nonexistent = false;
     uint8_t default_proto = IP_PROTO_TCP;
     _sampling_prob = (1 << SAMPLING_SHIFT);
-    String default_contents, default_flowid;
+    String default_contents, default_flowid, fields;
 
+    if (_ff.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _ff.filename())
 	.read("STOP", stop)
@@ -89,7 +91,11 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("DEFAULT_FLOWID", AnyArg(), default_flowid)
 	.read("CONTENTS", AnyArg(), default_contents)
 	.read("FLOWID", AnyArg(), default_flowid)
+	.read("FIELDS", AnyArg(), fields)
 	.read("ALLOW_NONEXISTENT", allow_nonexistent)
+	.read("START", _start).read_status(_have_start)
+	.read("END", _end).read_status(_have_end)
+	.read("INDEX", FilenameArg(), _index_filename)
 	.complete() < 0)
 	return -1;
     if (_sampling_prob > (1 << SAMPLING_SHIFT)) {
@@ -107,7 +113,24 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _allow_nonexistent = allow_nonexistent;
     _have_timing = false;
     _multipacket = multipacket;
-    _have_flowid = _have_aggregate = _binary = false;
+    _have_flowid = _have_aggregate = _binary = _columnar = false;
+    _block_index = _block_count = 0;
+
+    Vector<String> words;
+    cp_spacevec(fields, words);
+    for (String *w = words.begin(); w != words.end(); ++w) {
+	String word = cp_unquote(*w);
+	if (const IPSummaryDump::FieldReader *f = IPSummaryDump::FieldReader::find(word))
+	    _wanted.push_back(f);
+	else
+	    errh->error("unknown content type '%s'", word.c_str());
+    }
+    // START and END need timestamps
+    if (_wanted.size() && (_have_start || _have_end))
+	_wanted.push_back(IPSummaryDump::FieldReader::find("timestamp"));
+    if (errh->nerrors())
+	return -1;
+
     if (default_contents)
 	bang_data(default_contents, errh);
     if (default_flowid)
@@ -128,6 +151,12 @@ FromIPSummaryDump::read_binary(String &result, ErrorHandler *errh)
     if (record_length < 4)
 	return _ff.error(errh, "binary record too short");
     bool textual = (record[0] & 0x80 ? true : false);
+    if (_columnar && !textual) {
+	// the caller decides whether to decode or skip the block
+	_block_length = record_length;
+	_ff.set_lineno(_ff.lineno() + 1);
+	return 3;
+    }
     result = _ff.get_string(record_length - 4, errh);
     if (!result)
 	return 0;
@@ -184,6 +213,17 @@ FromIPSummaryDump::initialize(ErrorHandler *errh)
 	}
     }
 
+    // use the index to skip to START, or build one; the seek waits until
+    // the header lines are read
+    _index_seek = 0;
+    if (_index_filename) {
+	if (_index.load(_index_filename, _ff.filename(), errh) == 0) {
+	    if (_have_start)
+		_index_seek = _index.seek(_start);
+	} else
+	    _index.start();
+    }
+
     return 0;
 }
 
@@ -194,6 +234,9 @@ FromIPSummaryDump::cleanup(CleanupStage)
     if (_work_packet)
 	_work_packet->kill();
     _work_packet = 0;
+    _block = String();
+    _columns.clear();
+    _block_index = _block_count = 0;
 }
 
 int
@@ -233,16 +276,28 @@ FromIPSummaryDump::bang_data(const String &line, ErrorHandler *errh)
 	    f = &IPSummaryDump::null_reader;
 	}
 	_fields.push_back(f);
-	_field_order.push_back(_fields.size() - 1);
+	if (wanted(f))
+	    _field_order.push_back(_fields.size() - 1);
     }
 
     if (_fields.size() == 0)
 	_ff.error(errh, "no contents specified");
 
-    click_qsort(_field_order.begin(), _fields.size(), sizeof(int),
+    click_qsort(_field_order.begin(), _field_order.size(), sizeof(int),
 		sort_fields_compare, this);
 }
 
+bool
+FromIPSummaryDump::wanted(const IPSummaryDump::FieldReader *f) const
+{
+    if (!_wanted.size())
+	return true;
+    for (const IPSummaryDump::FieldReader * const *w = _wanted.begin(); w != _wanted.end(); ++w)
+	if (*w == f)
+	    return true;
+    return false;
+}
+
 void
 FromIPSummaryDump::bang_proto(const String &line, const char *type,
 			      ErrorHandler *errh)
@@ -310,8 +365,9 @@ FromIPSummaryDump::bang_binary(const String &line, ErrorHandler *errh)
     Vector<String> words;
     cp_spacevec(line, words);
     if (words.size() != 1)
-	_ff.error(errh, "bad !binary specification");
+	_ff.error(errh, "bad %s specification", words[0].c_str());
     _binary = true;
+    _columnar = (words[0] == "!columnar");
     _ff.set_landmark_pattern("%f:record %l");
     _ff.set_lineno(1);
 }
@@ -344,23 +400,42 @@ set_checksums(WritablePacket *q, click_ip *iph)
 }
 
 Packet *
-FromIPSummaryDump::read_packet(ErrorHandler *errh)
+FromIPSummaryDump::parse_packet(ErrorHandler *errh)
 {
     // read non-packet lines
     bool binary;
     String line;
     const char *data;
     const char *end;
+    off_t pos;
 
     while (1) {
+	if (_block_index < _block_count)
+	    return block_packet(errh);
+	pos = _ff.file_pos();
 	if ((binary = _binary)) {
 	    int result = read_binary(line, errh);
 	    if (result <= 0)
 		goto eof;
-	    else
+	    else if (result == 3) {
+		if (_index_seek > pos) {
+		    if (_ff.seek(_index_seek, errh) < 0)
+			goto eof;
+		    _index_seek = 0;
+		} else if ((result = read_block(pos, errh)) < 0)
+		    goto eof;
+		else if (result > 0) {
+		    // reached END
+		    _ff.cleanup();
+		    return 0;
+		}
+		continue;
+	    } else
 		binary = (result == 1);
 	} else if (_ff.read_line(line, errh, true) <= 0) {
 	  eof:
+	    if (_index.building())
+		(void) _index.save(_index_filename, _ff.filename(), errh ? errh : ErrorHandler::default_handler());
 	    _ff.cleanup();
 	    return 0;
 	}
@@ -370,12 +445,21 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 
 	if (data == end)
 	    /* do nothing */;
-	else if (binary || (data[0] != '!' && data[0] != '#'))
+	else if (binary || (data[0] != '!' && data[0] != '#')) {
 	    /* real packet */
+	    if (_index_seek > pos) {
+		if (_ff.seek(_index_seek, errh) < 0)
+		    goto eof;
+		_index_seek = 0;
+		continue;
+	    }
 	    break;
+	}
 
-	// parse bang lines
+	// parse bang lines; seeking would skip those after the first packet
 	if (data[0] == '!') {
+	    if (_index.size())
+		_index.stop();
 	    if (data + 6 <= end && memcmp(data, "!data", 5) == 0 && isspace((unsigned char) data[5]))
 		bang_data(line, errh);
 	    else if (data + 8 <= end && memcmp(data, "!flowid", 7) == 0 && isspace((unsigned char) data[7]))
@@ -386,6 +470,8 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 		bang_aggregate(line, errh);
 	    else if (data + 8 <= end && memcmp(data, "!binary", 7) == 0 && isspace((unsigned char) data[7]))
 		bang_binary(line, errh);
+	    else if (data + 10 <= end && memcmp(data, "!columnar", 9) == 0 && isspace((unsigned char) data[9]))
+		bang_binary(line, errh);
 	    else if (data + 10 <= end && memcmp(data, "!contents", 9) == 0 && isspace((unsigned char) data[9]))
 		bang_data(line, errh);
 	}
@@ -497,10 +583,19 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
 	}
     }
 
+    if (finish_packet(d, nfields, binary || !cp_is_space(line), errh))
+	_index.note(pos, d.p->timestamp_anno());
+    return d.p;
+}
+
+Packet *
+FromIPSummaryDump::finish_packet(IPSummaryDump::PacketOdesc &d, int nfields,
+				 bool complain, ErrorHandler *errh)
+{
     if (!nfields) {	// bad format
 	if (!_format_complaint) {
 	    // don't complain if the line was all blank
-	    if (binary || !cp_is_space(line)) {
+	    if (complain) {
 		if (_fields.size() == 0)
 		    _ff.error(errh, "no '!data' provided");
 		else
@@ -568,6 +663,147 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     return d.p;
 }
 
+static inline const uint8_t *
+get_varint(const uint8_t *s, const uint8_t *end, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; s < end && shift < 64; shift += 7, ++s) {
+	v |= (uint64_t) (*s & 0x7F) << shift;
+	if (!(*s & 0x80))
+	    return s + 1;
+    }
+    return 0;
+}
+
+int
+FromIPSummaryDump::read_block(off_t pos, ErrorHandler *errh)
+{
+    uint8_t header_storage[IPSummaryDump::BLOCK_HEADER_SIZE - 4];
+    if (_block_length < IPSummaryDump::BLOCK_HEADER_SIZE)
+	return _ff.error(errh, "columnar block too short");
+    const uint8_t *h = _ff.get_unaligned(sizeof(header_storage), header_storage, errh);
+    if (!h)
+	return -1;
+    uint32_t count = GET4(h);
+    uint32_t flags = GET4(h + 4);
+    uint32_t ncolumns = GET4(h + 8);
+    uint32_t rest = _block_length - IPSummaryDump::BLOCK_HEADER_SIZE;
+
+    // use the block's time range to skip it without decoding
+    if (flags & IPSummaryDump::BLOCK_HAS_TIMES) {
+	Timestamp first = Timestamp::make_nsec(GET4(h + 12), GET4(h + 16));
+	Timestamp last = Timestamp::make_nsec(GET4(h + 20), GET4(h + 24));
+	_index.note(pos, first);
+	_index.note(pos, last);
+	if (_have_end && first >= _end)
+	    return 1;
+	if (_have_start && last < _start)
+	    return _ff.seek(_ff.file_pos() + rest, errh);
+    }
+
+    _block = _ff.get_string(rest, errh);
+    if ((uint32_t) _block.length() != rest)
+	return -1;
+
+    // parse the dictionary; column data follows it
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(_block.data());
+    const uint8_t *end = s + rest;
+    const uint8_t *dict = s;
+    for (uint32_t i = 0; i < ncolumns; ++i) {
+	if (s >= end || s + s[0] + 6 > end)
+	    return _ff.error(errh, "bad columnar block dictionary");
+	s += s[0] + 6;
+    }
+
+    _columns.clear();
+    for (uint32_t i = 0; i < ncolumns; ++i) {
+	String name(reinterpret_cast<const char *>(dict + 1), dict[0]);
+	int encoding = dict[dict[0] + 1];
+	uint32_t length = GET4(dict + dict[0] + 2);
+	dict += dict[0] + 6;
+	if (length > (uint32_t) (end - s))
+	    return _ff.error(errh, "bad columnar block length");
+
+	const IPSummaryDump::FieldReader *f = IPSummaryDump::FieldReader::find(name);
+	if (f && f->inject && wanted(f)
+	    && (encoding == IPSummaryDump::COLUMN_TIMESTAMP
+		? IPSummaryDump::column_timestamp(f->name)
+		: encoding == IPSummaryDump::COLUMN_RAW && f->inb)) {
+	    Column c;
+	    c.f = f;
+	    c.pos = s;
+	    c.end = s + length;
+	    c.prev = 0;
+	    c.timestamp = (encoding == IPSummaryDump::COLUMN_TIMESTAMP);
+	    // keep columns in injection order
+	    int j = _columns.size();
+	    _columns.push_back(c);
+	    for (; j > 0 && _columns[j - 1].f->order > f->order; --j)
+		_columns[j] = _columns[j - 1];
+	    _columns[j] = c;
+	}
+	s += length;
+    }
+
+    _block_index = 0;
+    _block_count = count;
+    return 0;
+}
+
+Packet *
+FromIPSummaryDump::block_packet(ErrorHandler *errh)
+{
+    ++_block_index;
+
+    WritablePacket *q = Packet::make(16, (const unsigned char *) 0, 0, 1000);
+    if (!q) {
+	_ff.error(errh, strerror(ENOMEM));
+	return 0;
+    }
+    if (_zero)
+	memset(q->buffer(), 0, q->buffer_length());
+
+    IPSummaryDump::PacketOdesc d(this, q, _default_proto, (_have_flowid ? &_flowid : 0), _minor_version);
+    int nfields = 0;
+
+    for (Column *c = _columns.begin(); c != _columns.end() && d.p; ++c) {
+	if (c->pos >= c->end)
+	    continue;
+	d.clear_values();
+	if (c->timestamp) {
+	    uint64_t v;
+	    if (!(c->pos = get_varint(c->pos, c->end, v))) {
+		c->pos = c->end;
+		continue;
+	    }
+	    c->prev += (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+	    d.u32[0] = c->prev / 1000000000;
+	    d.u32[1] = c->prev % 1000000000;
+	} else
+	    c->pos = c->f->inb(d, c->pos, c->end, c->f);
+	c->f->inject(d, c->f);
+	nfields++;
+    }
+
+    return finish_packet(d, nfields, true, errh);
+}
+
+Packet *
+FromIPSummaryDump::read_packet(ErrorHandler *errh)
+{
+    while (Packet *p = parse_packet(errh)) {
+	if (_have_start && p->timestamp_anno() < _start)
+	    p->kill();
+	else if (_have_end && p->timestamp_anno() >= _end) {
+	    p->kill();
+	    _ff.cleanup();
+	    return 0;
+	} else
+	    return p;
+    }
+    return 0;
+}
+
 inline Packet *
 set_packet_lengths(Packet *p, uint32_t extra_length)
 {
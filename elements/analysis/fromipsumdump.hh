@@ -13,7 +13,7 @@ CLICK_DECLS
 /*
 =c
 
-FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID])
+FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID, FIELDS, START, END, INDEX])
 
 =s traces
 
@@ -26,7 +26,8 @@ creates packets containing info from the descriptors and pushes them out the
 output. Optionally stops the driver when there are no more packets.
 
 The file may be compressed with gzip(1) or bzip2(1); FromIPSummaryDump will
-run zcat(1) or bzcat(1) to uncompress it.
+run zcat(1) or bzcat(1) to uncompress it.  FromIPSummaryDump reads ASCII,
+binary, and columnar dumps (see ToIPSummaryDump).
 
 FromIPSummaryDump reads from the file named FILENAME unless FILENAME is a
 single dash 'C<->', in which case it reads from the standard input. It will
@@ -100,12 +101,49 @@ destination address, destination port, and, optionally, protocol). Defines the
 IP addresses and ports used by default. Any flow information in the input file
 will override this setting.
 
+=item FIELDS
+
+String, containing a space-separated list of content names.  If given,
+FromIPSummaryDump sets only these fields on the packets it creates, ignoring
+any other contents in the dump.  In columnar dumps, the other columns are
+not decoded at all, which makes reading much faster.  Timestamps are always
+read if START or END is given.
+
 =item ALLOW_NONEXISTENT
 
 Boolean.  If true, allow nonexistent and empty files: FromIPSummaryDump will
 successfully initialize even if the input file is nonexistent or empty.
 Defaults to false.
 
+=item START
+
+Timestamp. If given, FromIPSummaryDump skips packets with earlier
+timestamps.  In columnar dumps, blocks whose packets all come before START
+are skipped without being decoded.
+
+=item END
+
+Timestamp. If given, FromIPSummaryDump stops at the first packet whose
+timestamp is at or after END, as if the file had ended.
+
+=item INDEX
+
+Filename of a sidecar index that maps timestamps to positions in the
+dump. If the index exists and matches the dump's size and modification
+time, FromIPSummaryDump uses it to seek straight to START rather than
+parsing every earlier line. Otherwise, FromIPSummaryDump builds the index
+as it reads, and writes it once it reaches the end of the dump. Dumps
+whose "!data" or other "!" lines change after the first packet cannot be
+indexed.
+
+=item PREFETCH
+
+Unsigned. If nonzero, then FromIPSummaryDump reads the file on a separate thread,
+keeping up to this many 256KB chunks ahead of the data it is processing, so
+that it rarely waits for the disk. Gzip-compressed files are decompressed on
+that thread too, instead of by a zcat(1) process. Setting PREFETCH turns off
+MMAP. Requires multithreading support. Default is 0.
+
 =back
 
 Only available in user-level processes.
@@ -193,12 +231,37 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _timing : 1;
     bool _have_timing : 1;
     bool _allow_nonexistent : 1;
+    bool _columnar : 1;
     Packet *_work_packet;
     uint32_t _multipacket_length;
     Timestamp _multipacket_timestamp_delta;
     Timestamp _multipacket_end_timestamp;
     Timestamp _timing_offset;
 
+    bool _have_start;
+    bool _have_end;
+    Timestamp _start;
+    Timestamp _end;
+    String _index_filename;
+    TraceIndex _index;
+    off_t _index_seek;
+
+    Vector<const IPSummaryDump::FieldReader *> _wanted;
+
+    // columnar block being decoded
+    struct Column {
+	const IPSummaryDump::FieldReader *f;
+	const uint8_t *pos;
+	const uint8_t *end;
+	int64_t prev;
+	bool timestamp;
+    };
+    String _block;
+    Vector<Column> _columns;
+    uint32_t _block_index;
+    uint32_t _block_count;
+    uint32_t _block_length;
+
     Task _task;
     ActiveNotifier _notifier;
     Timer _timer;
@@ -214,8 +277,14 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     void bang_flowid(const String &, ErrorHandler *);
     void bang_aggregate(const String &, ErrorHandler *);
     void bang_binary(const String &, ErrorHandler *);
+    bool wanted(const IPSummaryDump::FieldReader *f) const;
+    int read_block(off_t pos, ErrorHandler *);
+    Packet *block_packet(ErrorHandler *);
+    Packet *finish_packet(IPSummaryDump::PacketOdesc &d, int nfields,
+			  bool complain, ErrorHandler *errh);
     void check_defaults();
     bool check_timing(Packet *p);
+    Packet *parse_packet(ErrorHandler *);
     Packet *read_packet(ErrorHandler *);
     Packet *handle_multipacket(Packet *);
 
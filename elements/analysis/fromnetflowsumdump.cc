@@ -19,6 +19,7 @@
 #include <click/config.h>
 
 #include "fromnetflowsumdump.hh"
+#include "ipsumdumpinfo.hh"
 #include <click/args.hh>
 #include <click/router.hh>
 #include <click/standard/scheduleinfo.hh>
@@ -118,6 +119,19 @@ FromNetFlowSummaryDump::cleanup(CleanupStage)
     _packet = _work_packet = 0;
 }
 
+static inline bool
+parse_field(const char *s, const char *end, uint32_t &v)
+{
+    return s != end && IPSummaryDump::parse_uint(s, end, &v) == end;
+}
+
+static inline bool
+parse_addr(const String &line, const char *s, const char *end, struct in_addr &a)
+{
+    return IPSummaryDump::parse_ip(s, end, a)
+	|| IPAddressArg().parse(line.substring(s, end), a);
+}
+
 Packet *
 FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
 {
@@ -135,7 +149,7 @@ FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
     iph->ip_off = 0;
 
     String line;
-    String words[15];
+    const char *word[15], *word_end[15];
     uint32_t j;
 
     while (1) {
@@ -145,19 +159,18 @@ FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
 	    return 0;
 	}
 
-	const char *data = line.data();
-	int len = line.length();
+	const char *data = line.begin(), *end = line.end();
 
-	if (len == 0 || data[0] == '!' || data[0] == '#')
+	if (data == end || data[0] == '!' || data[0] == '#')
 	    continue;
 
-	int pos = 0, dpos = 0;
-	while (dpos < len && pos < 15) {
-	    int start = dpos;
-	    while (dpos < len && data[dpos] != '|')
-		dpos++;
-	    words[pos++] = line.substring(start, dpos - start);
-	    dpos++;
+	// fields point into the line, which points into FromFile's buffer
+	int pos = 0;
+	while (data < end && pos < 15) {
+	    const char *bar = (const char *) memchr(data, '|', end - data);
+	    word[pos] = data;
+	    word_end[pos++] = data = (bar ? bar : end);
+	    data++;
 	}
 	if (pos < 15)
 	    break;
@@ -179,23 +192,23 @@ FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
 	int ok = 0;
 
 	// annotations
-	if (IntArg().parse(words[7], j))
+	if (parse_field(word[7], word_end[7], j))
 	    SET_FIRST_TIMESTAMP_ANNO(q, Timestamp(j, 0)), ok++;
-	if (IntArg().parse(words[8], j)) {
+	if (parse_field(word[8], word_end[8], j)) {
 	    if (j)
 		q->timestamp_anno().assign(j, 0);
 	    else
 		q->timestamp_anno() = FIRST_TIMESTAMP_ANNO(q);
 	    ok++;
 	}
-	if (IntArg().parse(words[5], j))
+	if (parse_field(word[5], word_end[5], j))
 	    SET_EXTRA_PACKETS_ANNO(q, j - 1), ok++;
 	uint32_t byte_count = 0;
-	if (IntArg().parse(words[6], byte_count))
+	if (parse_field(word[6], word_end[6], byte_count))
 	    ok++;
 	uint32_t input = 0, output = 0;
-	if ((_link == 1 || IntArg().parse(words[3], input))
-	    && (_link == 0 || IntArg().parse(words[4], output))) {
+	if ((_link == 1 || parse_field(word[3], word_end[3], input))
+	    && (_link == 0 || parse_field(word[4], word_end[4], output))) {
 	    ok++;
 	    uint32_t m = (_link == 2 ? 15 : 255);
 	    input = (input < m ? input : m) << (_link == 2 ? 4 : 0);
@@ -204,19 +217,19 @@ FromNetFlowSummaryDump::read_packet(ErrorHandler *errh)
 	}
 
 	// IP header
-	ok += IPAddressArg().parse(words[0], iph->ip_src);
-	ok += IPAddressArg().parse(words[1], iph->ip_dst);
-	if (IntArg().parse(words[13], j) && j <= 0xFF)
+	ok += parse_addr(line, word[0], word_end[0], iph->ip_src);
+	ok += parse_addr(line, word[1], word_end[1], iph->ip_dst);
+	if (parse_field(word[13], word_end[13], j) && j <= 0xFF)
 	    iph->ip_p = j, ok++;
-	if (IntArg().parse(words[14], j) && j <= 0xFF)
+	if (parse_field(word[14], word_end[14], j) && j <= 0xFF)
 	    iph->ip_tos = j, ok++;
 
 	// TCP header
-	if (IntArg().parse(words[9], j) && j <= 0xFFFF)
+	if (parse_field(word[9], word_end[9], j) && j <= 0xFFFF)
 	    q->udp_header()->uh_sport = htons(j), ok++;
-	if (IntArg().parse(words[10], j) && j <= 0xFFFF)
+	if (parse_field(word[10], word_end[10], j) && j <= 0xFFFF)
 	    q->udp_header()->uh_dport = htons(j), ok++;
-	if (IntArg().parse(words[12], j) && j <= 0xFF)
+	if (parse_field(word[12], word_end[12], j) && j <= 0xFF)
 	    q->tcp_header()->th_flags = j, ok++;
 
 	if (ok < 10)
@@ -379,7 +392,8 @@ FromNetFlowSummaryDump::run_task(Task *)
 	return false;
     } else if (_timing && !check_timing(p))
 	return false;
-    output(0).push(_packet);
+    _packet = 0;
+    output(0).push(p);
     _task.fast_reschedule();
     return true;
 }
@@ -397,6 +411,7 @@ FromNetFlowSummaryDump::pull(int)
 	router()->please_stop_driver();
     else if (p && _timing && !check_timing(p))
 	return 0;
+    _packet = 0;
     _notifier.set_active(p != 0, true);
     return p;
 }
@@ -103,6 +103,14 @@ FromNLANRDump's regular file discipline is pretty optimized, so the difference
 is often small in practice. Default is true on most operating systems, but
 false on Linux.
 
+=item PREFETCH
+
+Unsigned. If nonzero, then FromNLANRDump reads the file on a separate thread,
+keeping up to this many 256KB chunks ahead of the data it is processing, so
+that it rarely waits for the disk. Gzip-compressed files are decompressed on
+that thread too, instead of by a zcat(1) process. Setting PREFETCH turns off
+MMAP. Requires multithreading support. Default is 0.
+
 =item FILEPOS
 
 File offset. If supplied, then FromNLANRDump will start emitting packets from
@@ -119,6 +119,25 @@ append_net_uint32_t(StringAccum &sa, uint32_t u)
     sa << (char)(u >> 24) << (char)(u >> 16) << (char)(u >> 8) << (char)u;
 }
 
+static inline bool
+parse_addr(const String &line, const char *s, const char *end, struct in_addr &a)
+{
+    return IPSummaryDump::parse_ip(s, end, a)
+	|| IPAddressArg().parse(line.substring(s, end), a);
+}
+
+static inline bool
+parse_port(const String &line, const char *s, const char *end, int ip_p, uint16_t &port)
+{
+    // tcpdump prints service names for well-known ports unless given -n
+    uint32_t u;
+    if (s != end && IPSummaryDump::parse_uint(s, end, &u) == end && u <= 65535) {
+	port = u;
+	return true;
+    }
+    return IPPortArg(ip_p).parse(line.substring(s, end), port);
+}
+
 static void
 set_checksums(WritablePacket *q, click_ip *iph)
 {
@@ -174,10 +193,10 @@ FromTcpdump::read_tcp_line(WritablePacket *&q, const char *s, const char *end, i
     // then read sequence numbers
     uint32_t seq = 0, end_seq = 0, ack_seq = 0;
     if (s < end && s[0] != 'a') {
-	const char *eseq = cp_integer(s, end, 0, &seq);
+	const char *eseq = IPSummaryDump::parse_uint(s, end, &seq);
 	if (eseq == s || eseq >= end || *eseq != ':')
 	    return s;
-	const char *eend_seq = cp_integer(eseq + 1, end, 0, &end_seq);
+	const char *eend_seq = IPSummaryDump::parse_uint(eseq + 1, end, &end_seq);
 	if (eend_seq == eseq + 1 || eend_seq >= end || *eend_seq != '(')
 	    return s;
 	// skip parenthesized length
@@ -195,7 +214,7 @@ FromTcpdump::read_tcp_line(WritablePacket *&q, const char *s, const char *end, i
     // check for 'ack'
     if (s + 4 < end && s[0] == 'a' && s[1] == 'c' && s[2] == 'k' && s[3] == ' ' && isdigit((unsigned char) s[4])) {
 	tcph->th_flags |= TH_ACK;
-	s = cp_integer(s + 4, end, 0, &ack_seq);
+	s = IPSummaryDump::parse_uint(s + 4, end, &ack_seq);
 	if (s < end && *s == ' ')
 	    s++;
     }
@@ -239,7 +258,7 @@ FromTcpdump::read_tcp_line(WritablePacket *&q, const char *s, const char *end, i
     // check for 'win'
     uint32_t u;
     if (s + 4 < end && s[0] == 'w' && s[1] == 'i' && s[2] == 'n' && s[3] == ' ' && isdigit((unsigned char) s[4])) {
-	s = cp_integer(s + 4, end, 0, &u); // XXX check u <= 65535
+	s = IPSummaryDump::parse_uint(s + 4, end, &u); // XXX check u <= 65535
 	tcph->th_win = htons(u);
 	if (s < end && *s == ' ')
 	    s++;
@@ -247,7 +266,7 @@ FromTcpdump::read_tcp_line(WritablePacket *&q, const char *s, const char *end, i
 
     // check for 'urg'
     if (s + 4 < end && s[0] == 'u' && s[1] == 'r' && s[2] == 'g' && s[3] == ' ' && isdigit((unsigned char) s[4])) {
-	s = cp_integer(s + 4, end, 0, &u); // XXX check u <= 65535
+	s = IPSummaryDump::parse_uint(s + 4, end, &u); // XXX check u <= 65535
 	tcph->th_urp = htons(u);
 	if (s < end && *s != ' ')
 	    s++;
@@ -265,33 +284,33 @@ FromTcpdump::read_tcp_line(WritablePacket *&q, const char *s, const char *end, i
 		opt << (char)TCPOPT_EOL;
 		s += 3;
 	    } else if (s + 4 < end && s[0] == 'm' && s[1] == 's' && s[2] == 's' && s[3] == ' ' && isdigit((unsigned char) s[4])) {
-		s = cp_integer(s + 4, end, 0, &u); // XXX check u <= 65535
+		s = IPSummaryDump::parse_uint(s + 4, end, &u); // XXX check u <= 65535
 		opt << (char)TCPOPT_MAXSEG << (char)TCPOLEN_MAXSEG << (char)((u >> 8) & 255) << (char)(u & 255);
 	    } else if (s + 7 < end && memcmp(s, "wscale ", 7) == 0 && isdigit((unsigned char) s[7])) {
-		s = cp_integer(s + 7, end, 0, &u); // XXX check u <= 255
+		s = IPSummaryDump::parse_uint(s + 7, end, &u); // XXX check u <= 255
 		opt << (char)TCPOPT_WSCALE << (char)TCPOLEN_WSCALE << (char)u;
 	    } else if (s + 6 <= end && memcmp(s, "sackOK", 6) == 0) {
 		opt << (char)TCPOPT_SACK_PERMITTED << (char)TCPOLEN_SACK_PERMITTED;
 		s += 6;
 	    } else if (s + 10 < end && memcmp(s, "timestamp ", 10) == 0 && isdigit((unsigned char) s[10])) {
-		s = cp_integer(s + 10, end, 0, &u);
+		s = IPSummaryDump::parse_uint(s + 10, end, &u);
 		if (s + 1 < end && *s == ' ' && isdigit((unsigned char) s[1])) {
 		    uint32_t u2;
-		    s = cp_integer(s + 1, end, 0, &u2);
+		    s = IPSummaryDump::parse_uint(s + 1, end, &u2);
 		    opt << (char)TCPOPT_TIMESTAMP << (char)TCPOLEN_TIMESTAMP;
 		    append_net_uint32_t(opt, u);
 		    append_net_uint32_t(opt, u2);
 		}
 	    } else if (s + 10 < end && memcmp(s, "sack sack ", 10) == 0 && isdigit((unsigned char) s[10])) {
 		uint32_t nsack, u2;
-		s = cp_integer(s + 10, end, 0, &nsack);
+		s = IPSummaryDump::parse_uint(s + 10, end, &nsack);
 		opt << (char)TCPOPT_SACK << (char)(nsack * 8 + 2);
 		while (s < end && *s == ' ')
 		    s++;
 		while (s + 1 < end && *s == '{' && isdigit((unsigned char) s[1])) {
-		    s = cp_integer(s + 1, end, 0, &u);
+		    s = IPSummaryDump::parse_uint(s + 1, end, &u);
 		    if (s + 1 < end && *s == ':' && isdigit((unsigned char) s[1])) {
-			s = cp_integer(s + 1, end, 0, &u2);
+			s = IPSummaryDump::parse_uint(s + 1, end, &u2);
 			if (s < end && *s == '}') {
 			    s++;
 			    if (record && !_absolute_seq) {
@@ -342,7 +361,7 @@ FromTcpdump::read_udp_line(WritablePacket *&, const char *s, const char *end, in
     // then check for 'udp LENGTH'
     if (s + 4 < end && s[0] == 'u' && s[1] == 'd' && s[2] == 'p' && s[3] == ' ' && isdigit((unsigned char) s[4])) {
 	uint32_t dl;
-	s = cp_integer(s + 4, end, 0, &dl);
+	s = IPSummaryDump::parse_uint(s + 4, end, &dl);
 	*data_len = dl;
     }
 
@@ -417,12 +436,12 @@ FromTcpdump::read_packet(ErrorHandler *errh)
 	    const char *sm = s2 - 1;
 	    while (sm > s && *sm != '.' && *sm != ':')
 		sm--;
-	    if (!IPAddressArg().parse(line.substring(s, sm), iph->ip_src)
-		|| !IPPortArg(iph->ip_p).parse(line.substring(sm + 1, s2), udph->uh_sport))
+	    if (!parse_addr(line, s, sm, iph->ip_src)
+		|| !parse_port(line, sm + 1, s2, iph->ip_p, udph->uh_sport))
 		break;
 	    else
 		udph->uh_sport = htons(udph->uh_sport);
-	} else if (!IPAddressArg().parse(line.substring(s, s2), iph->ip_src))
+	} else if (!parse_addr(line, s, s2, iph->ip_src))
 	    break;
 	s = s2 + 3;
 
@@ -432,12 +451,12 @@ FromTcpdump::read_packet(ErrorHandler *errh)
 	    const char *sm = s2 - 1;
 	    while (sm > s && *sm != '.' && *sm != ':')
 		sm--;
-	    if (!IPAddressArg().parse(line.substring(s, sm), iph->ip_dst)
-		|| !IPPortArg(iph->ip_p).parse(line.substring(sm + 1, s2), udph->uh_dport))
+	    if (!parse_addr(line, s, sm, iph->ip_dst)
+		|| !parse_port(line, sm + 1, s2, iph->ip_p, udph->uh_dport))
 		break;
 	    else
 		udph->uh_dport = htons(udph->uh_dport);
-	} else if (!IPAddressArg().parse(line.substring(s, s2), iph->ip_dst))
+	} else if (!parse_addr(line, s, s2, iph->ip_dst))
 	    break;
 
 	// then, read protocol data
@@ -485,26 +504,26 @@ FromTcpdump::read_packet(ErrorHandler *errh)
 			iph->ip_off |= htons(IP_DF);
 			item += 2;
 		    } else if (close - item >= 10 && memcmp(item, "frag ", 5) == 0 && isdigit((unsigned char) item[5])) {
-			item = cp_integer(item + 5, close, 0, &u);
+			item = IPSummaryDump::parse_uint(item + 5, close, &u);
 			iph->ip_id = htons(u);
 			if (item > close - 2 || *item != ':' || !isdigit((unsigned char) item[1]))
 			    break;
-			item = cp_integer(item + 1, close, 0, &u);
+			item = IPSummaryDump::parse_uint(item + 1, close, &u);
 			data_len = u;
 			if (item > close - 2 || *item != '@' || !isdigit((unsigned char) item[1]))
 			    break;
-			item = cp_integer(item + 1, close, 0, &u);
+			item = IPSummaryDump::parse_uint(item + 1, close, &u);
 			iph->ip_off = (iph->ip_off & htons(~IP_OFFMASK)) | htons(u);
 			if (item < close && *item == '+')
 			    iph->ip_off |= htons(IP_MF), item++;
 		    } else if (close - item >= 5 && memcmp(item, "ttl ", 4) == 0 && isdigit((unsigned char) item[4])) {
-			item = cp_integer(item + 4, close, 0, &u);
+			item = IPSummaryDump::parse_uint(item + 4, close, &u);
 			iph->ip_ttl = u;
 		    } else if (close - item >= 4 && memcmp(item, "id ", 3) == 0 && isdigit((unsigned char) item[3])) {
-			item = cp_integer(item + 3, close, 0, &u);
+			item = IPSummaryDump::parse_uint(item + 3, close, &u);
 			iph->ip_id = htons(u);
 		    } else if (close - item >= 5 && memcmp(item, "len ", 4) == 0 && isdigit((unsigned char) item[4])) {
-			item = cp_integer(item + 4, close, 0, &u);
+			item = IPSummaryDump::parse_uint(item + 4, close, &u);
 			if (data_len < 0 || u == q->length() + data_len)
 			    data_len = u - q->length();
 			else if (iph->ip_p == IP_PROTO_TCP) {
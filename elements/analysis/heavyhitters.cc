@@ -0,0 +1,198 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * heavyhitters.{cc,hh} -- finds the heaviest keys in fixed memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "heavyhitters.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/ipaddress.hh>
+#include <click/packetbatch.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+HeavyHitters::HeavyHitters()
+{
+}
+
+HeavyHitters::~HeavyHitters()
+{
+}
+
+int
+HeavyHitters::parse_key(const String &str)
+{
+    if (str == "AGGREGATE")
+	return key_aggregate;
+    else if (str == "SRC")
+	return key_src;
+    else if (str == "DST")
+	return key_dst;
+    else
+	return -1;
+}
+
+String
+HeavyHitters::unparse_key(uint32_t k, int key)
+{
+    if (key == key_aggregate)
+	return String(k);
+    else
+	return IPAddress(htonl(k)).unparse();
+}
+
+int
+HeavyHitters::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String key = String::make_stable("AGGREGATE");
+    _capacity = 1024;
+    _top = 10;
+    _bytes = false;
+    if (Args(conf, this, errh)
+	.read("KEY", WordArg(), key)
+	.read("CAPACITY", _capacity)
+	.read("BYTES", _bytes)
+	.read("TOP", _top)
+	.complete() < 0)
+	return -1;
+    if ((_key = parse_key(key)) < 0)
+	return errh->error("KEY must be AGGREGATE, SRC, or DST");
+    if (_capacity < 1 || _capacity > 0x1000000)
+	return errh->error("CAPACITY out of range");
+    return 0;
+}
+
+int
+HeavyHitters::initialize(ErrorHandler *errh)
+{
+    if (_tables.initialize(master()) < 0)
+	return errh->error("out of memory");
+    for (int i = 0; i < _tables.size(); ++i)
+	if (_tables[i].summary.initialize(_capacity) < 0)
+	    return errh->error("out of memory");
+    return 0;
+}
+
+inline void
+HeavyHitters::count(SpaceSaving &summary, Packet *p) const
+{
+    uint32_t k;
+    if (packet_key(p, _key, k))
+	summary.update(k, _bytes ? p->length() + EXTRA_LENGTH_ANNO(p) : 1);
+}
+
+Packet *
+HeavyHitters::simple_action(Packet *p)
+{
+    Table &t = _tables.get();
+    t.lock.acquire();
+    count(t.summary, p);
+    t.lock.release();
+    return p;
+}
+
+void
+HeavyHitters::simple_action_batch(PacketBatch &batch)
+{
+    Table &t = _tables.get();
+    t.lock.acquire();
+    for (Packet *p = batch.front(); p; p = p->next())
+	count(t.summary, p);
+    t.lock.release();
+}
+
+void
+HeavyHitters::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+HeavyHitters::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
+enum { h_total, h_clear };
+
+String
+HeavyHitters::read_handler(Element *e, void *)
+{
+    HeavyHitters *hh = static_cast<HeavyHitters *>(e);
+    uint64_t total = 0;
+    for (int i = 0; i < hh->_tables.size(); ++i) {
+	Table &t = hh->_tables[i];
+	t.lock.acquire();
+	total += t.summary.total();
+	t.lock.release();
+    }
+    return String(total);
+}
+
+int
+HeavyHitters::top_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    HeavyHitters *hh = static_cast<HeavyHitters *>(e);
+    uint32_t n = hh->_top;
+    String s = cp_uncomment(str);
+    if (s && !IntArg().parse(s, n))
+	return errh->error("argument should be a number of keys");
+
+    // Lock every summary, so the merge sees one moment's counts.
+    Vector<const SpaceSaving *> in;
+    for (int i = 0; i < hh->_tables.size(); ++i) {
+	hh->_tables[i].lock.acquire();
+	in.push_back(&hh->_tables[i].summary);
+    }
+    Vector<SpaceSaving::Counter> out;
+    SpaceSaving::merge(in, out, n);
+    for (int i = 0; i < hh->_tables.size(); ++i)
+	hh->_tables[i].lock.release();
+
+    StringAccum sa;
+    for (const SpaceSaving::Counter *c = out.begin(); c != out.end(); ++c)
+	sa << unparse_key(c->key, hh->_key) << ' ' << c->count << ' '
+	   << c->error << '\n';
+    str = sa.take_string();
+    return 0;
+}
+
+int
+HeavyHitters::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    HeavyHitters *hh = static_cast<HeavyHitters *>(e);
+    for (int i = 0; i < hh->_tables.size(); ++i) {
+	Table &t = hh->_tables[i];
+	t.lock.acquire();
+	t.summary.clear();
+	t.lock.release();
+    }
+    return 0;
+}
+
+void
+HeavyHitters::add_handlers()
+{
+    set_handler("top", Handler::OP_READ | Handler::READ_PARAM, top_handler);
+    add_read_handler("total", read_handler, h_total);
+    add_write_handler("clear", write_handler, h_clear, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(SpaceSaving int64)
+EXPORT_ELEMENT(HeavyHitters)
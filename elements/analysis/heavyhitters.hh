@@ -0,0 +1,143 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HEAVYHITTERS_HH
+#define CLICK_HEAVYHITTERS_HH
+#include <click/element.hh>
+#include <click/percpu.hh>
+#include <click/sync.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+#include "spacesaving.hh"
+CLICK_DECLS
+
+/*
+=c
+
+HeavyHitters([I<keywords> KEY, CAPACITY, BYTES, TOP])
+
+=s ipmeasure
+
+finds the heaviest keys in a packet stream in fixed memory
+
+=d
+
+HeavyHitters counts packets, or bytes, by key, and reports the keys with the
+largest counts.  It keeps CAPACITY counters per thread, however many keys it
+sees, using the Space-Saving algorithm: when a new key arrives and every
+counter is taken, the key with the smallest count is forgotten and the new key
+inherits its count.  A reported count is never less than the key's true count,
+and exceeds it by at most the total divided by CAPACITY.  Every key whose true
+count exceeds that bound is reported.
+
+Each thread updates its own summary; the handlers merge the summaries when
+read.  Packets pass through unchanged.
+
+Keyword arguments are:
+
+=over 8
+
+=item KEY
+
+Either C<AGGREGATE>, C<SRC>, or C<DST>.  Count packets by their aggregate
+annotation, or by their IP source or destination address.  With C<SRC> or
+C<DST>, packets without network headers are not counted.  Default is
+C<AGGREGATE>.
+
+=item CAPACITY
+
+Unsigned integer.  Counters per thread.  Default is 1024.
+
+=item BYTES
+
+Boolean.  If true, count bytes, including any extra length annotation, rather
+than packets.  Default is false.
+
+=item TOP
+
+Unsigned integer.  The number of keys the C<top> handler reports by default.
+Default is 10.
+
+=back
+
+=h top read-only
+
+Returns the heaviest keys, largest first, one per line.  Each line has the
+key, its count, and the most by which that count may exceed the true count.
+Takes an optional parameter, the number of keys to report; the default is
+TOP.
+
+=h total read-only
+
+Returns the total count.
+
+=h clear write-only
+
+Clears all counters.
+
+=e
+
+This configuration prints the ten busiest source addresses every second:
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader
+    -> hh :: HeavyHitters(KEY SRC, BYTES true)
+    -> Discard;
+  Script(TYPE ACTIVE, wait 1, print $(hh.top), write hh.clear, loop);
+
+=a
+
+HierarchicalHeavyHitters, AggregateCounter, AggregateIP */
+
+class HeavyHitters : public Element { public:
+
+    HeavyHitters();
+    ~HeavyHitters();
+
+    const char *class_name() const	{ return "HeavyHitters"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    Packet *simple_action(Packet *p);
+    void simple_action_batch(PacketBatch &batch);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
+
+    enum { key_aggregate, key_src, key_dst };
+    static int parse_key(const String &str);
+    static inline bool packet_key(const Packet *p, int key, uint32_t &k) {
+	if (key == key_aggregate)
+	    k = AGGREGATE_ANNO(p);
+	else if (!p->has_network_header())
+	    return false;
+	else if (key == key_src)
+	    k = ntohl(p->ip_header()->ip_src.s_addr);
+	else
+	    k = ntohl(p->ip_header()->ip_dst.s_addr);
+	return true;
+    }
+    static String unparse_key(uint32_t k, int key);
+
+  private:
+
+    struct Table {
+	SpaceSaving summary;
+	Spinlock lock;
+    };
+
+    PerCPU<Table> _tables;
+    uint32_t _capacity;
+    uint32_t _top;
+    int _key;
+    bool _bytes;
+
+    inline void count(SpaceSaving &summary, Packet *p) const;
+
+    static String read_handler(Element *e, void *thunk);
+    static int top_handler(int op, String &str, Element *e, const Handler *h, ErrorHandler *errh);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
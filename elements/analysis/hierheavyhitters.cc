@@ -0,0 +1,254 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hierheavyhitters.{cc,hh} -- finds heavy address prefixes in fixed memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hierheavyhitters.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packetbatch.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+static inline uint32_t
+prefix_mask(int len)
+{
+    return len >= 32 ? 0xFFFFFFFFU : ~(0xFFFFFFFFU >> len);
+}
+
+HierarchicalHeavyHitters::HierarchicalHeavyHitters()
+{
+}
+
+HierarchicalHeavyHitters::~HierarchicalHeavyHitters()
+{
+}
+
+int
+HierarchicalHeavyHitters::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String key = String::make_stable("SRC");
+    _capacity = 1024;
+    _granularity = 8;
+    _bytes = false;
+    _threshold = 0.05;
+    if (Args(conf, this, errh)
+	.read("KEY", WordArg(), key)
+	.read("CAPACITY", _capacity)
+	.read("GRANULARITY", _granularity)
+	.read("BYTES", _bytes)
+	.read("THRESHOLD", _threshold)
+	.complete() < 0)
+	return -1;
+    if ((_key = HeavyHitters::parse_key(key)) < 0)
+	return errh->error("KEY must be SRC, DST, or AGGREGATE");
+    if (_capacity < 1 || _capacity > 0x1000000)
+	return errh->error("CAPACITY out of range");
+    if (_granularity < 1 || _granularity > 32)
+	return errh->error("GRANULARITY must be between 1 and 32");
+    if (_threshold <= 0 || _threshold > 1)
+	return errh->error("THRESHOLD must be between 0 and 1");
+    _nlevels = 31 / _granularity + 1;
+    return 0;
+}
+
+int
+HierarchicalHeavyHitters::initialize(ErrorHandler *errh)
+{
+    if (_tables.initialize(master()) < 0)
+	return errh->error("out of memory");
+    for (int i = 0; i < _tables.size(); ++i) {
+	Table &t = _tables[i];
+	if (!(t.levels = new SpaceSaving[_nlevels]))
+	    return errh->error("out of memory");
+	for (int l = 0; l < _nlevels; ++l)
+	    if (t.levels[l].initialize(_capacity) < 0)
+		return errh->error("out of memory");
+    }
+    return 0;
+}
+
+inline void
+HierarchicalHeavyHitters::count(Table &t, Packet *p) const
+{
+    uint32_t k;
+    if (HeavyHitters::packet_key(p, _key, k)) {
+	uint64_t w = _bytes ? p->length() + EXTRA_LENGTH_ANNO(p) : 1;
+	for (int l = 0; l < _nlevels; ++l)
+	    t.levels[l].update(k & prefix_mask(prefix_length(l)), w);
+    }
+}
+
+Packet *
+HierarchicalHeavyHitters::simple_action(Packet *p)
+{
+    Table &t = _tables.get();
+    t.lock.acquire();
+    count(t, p);
+    t.lock.release();
+    return p;
+}
+
+void
+HierarchicalHeavyHitters::simple_action_batch(PacketBatch &batch)
+{
+    Table &t = _tables.get();
+    t.lock.acquire();
+    for (Packet *p = batch.front(); p; p = p->next())
+	count(t, p);
+    t.lock.release();
+}
+
+void
+HierarchicalHeavyHitters::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+HierarchicalHeavyHitters::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
+void
+HierarchicalHeavyHitters::lock_all()
+{
+    for (int i = 0; i < _tables.size(); ++i)
+	_tables[i].lock.acquire();
+}
+
+void
+HierarchicalHeavyHitters::unlock_all()
+{
+    for (int i = 0; i < _tables.size(); ++i)
+	_tables[i].lock.release();
+}
+
+String
+HierarchicalHeavyHitters::unparse_hhh(double threshold)
+{
+    struct HHH {
+	uint32_t prefix;
+	int len;
+	uint64_t lower;		// count minus error
+    };
+    Vector<HHH> found;
+    StringAccum sa;
+
+    lock_all();
+    uint64_t total = 0;
+    for (int i = 0; i < _tables.size(); ++i)
+	total += _tables[i].levels[0].total();
+    uint64_t min_count = (uint64_t) (threshold * total);
+    if (min_count == 0)
+	min_count = 1;
+
+    // Work from the longest prefixes up.  A prefix's conditioned count
+    // discounts the heavy prefixes it contains that are not themselves
+    // contained in a shorter heavy prefix.  Subtracting their lower bounds
+    // keeps the conditioned count an overestimate.
+    Vector<const SpaceSaving *> in;
+    Vector<SpaceSaving::Counter> out;
+    for (int l = 0; l < _nlevels; ++l) {
+	int len = prefix_length(l);
+	uint32_t mask = prefix_mask(len);
+	in.clear();
+	for (int i = 0; i < _tables.size(); ++i)
+	    in.push_back(&_tables[i].levels[l]);
+	SpaceSaving::merge(in, out, -1);
+	int nfound = found.size();
+	for (const SpaceSaving::Counter *c = out.begin();
+	     c != out.end() && c->count >= min_count; ++c) {
+	    uint64_t cond = c->count;
+	    for (int h = 0; h < nfound; ++h) {
+		if ((found[h].prefix & mask) != c->key)
+		    continue;
+		bool covered = false;
+		for (int g = 0; g < nfound && !covered; ++g)
+		    covered = found[g].len < found[h].len
+			&& (found[g].prefix & mask) == c->key
+			&& (found[h].prefix & prefix_mask(found[g].len)) == found[g].prefix;
+		if (!covered)
+		    cond -= (found[h].lower < cond ? found[h].lower : cond);
+	    }
+	    if (cond >= min_count) {
+		HHH x = {c->key, len, c->count - c->error};
+		found.push_back(x);
+		sa << HeavyHitters::unparse_key(c->key, _key) << '/' << len
+		   << ' ' << c->count << ' ' << cond << '\n';
+	    }
+	}
+    }
+    unlock_all();
+    return sa.take_string();
+}
+
+enum { h_total, h_clear };
+
+String
+HierarchicalHeavyHitters::read_handler(Element *e, void *)
+{
+    HierarchicalHeavyHitters *hh = static_cast<HierarchicalHeavyHitters *>(e);
+    uint64_t total = 0;
+    for (int i = 0; i < hh->_tables.size(); ++i) {
+	Table &t = hh->_tables[i];
+	t.lock.acquire();
+	total += t.levels[0].total();
+	t.lock.release();
+    }
+    return String(total);
+}
+
+int
+HierarchicalHeavyHitters::hhh_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    HierarchicalHeavyHitters *hh = static_cast<HierarchicalHeavyHitters *>(e);
+    double threshold = hh->_threshold;
+    String s = cp_uncomment(str);
+    if (s && (!DoubleArg().parse(s, threshold) || threshold <= 0 || threshold > 1))
+	return errh->error("argument should be a threshold between 0 and 1");
+    str = hh->unparse_hhh(threshold);
+    return 0;
+}
+
+int
+HierarchicalHeavyHitters::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    HierarchicalHeavyHitters *hh = static_cast<HierarchicalHeavyHitters *>(e);
+    for (int i = 0; i < hh->_tables.size(); ++i) {
+	Table &t = hh->_tables[i];
+	t.lock.acquire();
+	for (int l = 0; l < hh->_nlevels; ++l)
+	    t.levels[l].clear();
+	t.lock.release();
+    }
+    return 0;
+}
+
+void
+HierarchicalHeavyHitters::add_handlers()
+{
+    set_handler("hhh", Handler::OP_READ | Handler::READ_PARAM, hhh_handler);
+    add_read_handler("total", read_handler, h_total);
+    add_write_handler("clear", write_handler, h_clear, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel HeavyHitters SpaceSaving int64)
+EXPORT_ELEMENT(HierarchicalHeavyHitters)
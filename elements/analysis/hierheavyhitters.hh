@@ -0,0 +1,141 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HIERHEAVYHITTERS_HH
+#define CLICK_HIERHEAVYHITTERS_HH
+#include "heavyhitters.hh"
+CLICK_DECLS
+
+/*
+=c
+
+HierarchicalHeavyHitters([I<keywords> KEY, CAPACITY, GRANULARITY, BYTES, THRESHOLD])
+
+=s ipmeasure
+
+finds heavy address prefixes in fixed memory
+
+=d
+
+HierarchicalHeavyHitters finds the IP address prefixes that account for at
+least a THRESHOLD fraction of the traffic, in packets or bytes, once traffic
+already credited to more specific heavy prefixes is discounted.  A /8 is
+reported because many hosts within it are busy, even when no single /24 or
+host is; but a /8 whose traffic comes from one busy /24 reports only the /24.
+
+Prefixes are counted at lengths 32, 32 - GRANULARITY, 32 - 2*GRANULARITY, and
+so on down to the shortest positive length.  Each length has a Space-Saving
+summary of CAPACITY counters per thread (see HeavyHitters), so memory is fixed
+however many addresses are seen.  Each thread updates its own summaries; the
+handlers merge them when read.  Packets pass through unchanged.
+
+Keyword arguments are:
+
+=over 8
+
+=item KEY
+
+Either C<SRC>, C<DST>, or C<AGGREGATE>.  Count prefixes of the IP source or
+destination address, or of the aggregate annotation.  With C<SRC> or C<DST>,
+packets without network headers are not counted.  Default is C<SRC>.
+
+=item CAPACITY
+
+Unsigned integer.  Counters per prefix length per thread.  Default is 1024.
+
+=item GRANULARITY
+
+Unsigned integer between 1 and 32.  Bits between prefix lengths.  Default is
+8.
+
+=item BYTES
+
+Boolean.  If true, count bytes, including any extra length annotation, rather
+than packets.  Default is false.
+
+=item THRESHOLD
+
+Real number between 0 and 1.  The fraction of the total a prefix must account
+for to be reported by the C<hhh> handler.  Default is 0.05.
+
+=back
+
+=h hhh read-only
+
+Returns the hierarchical heavy hitters, most specific first, one per line.
+Each line has the prefix, its count, and its count with the heavy prefixes it
+contains discounted.  Takes an optional parameter, the threshold to use
+instead of THRESHOLD.
+
+=h total read-only
+
+Returns the total count.
+
+=h clear write-only
+
+Clears all counters.
+
+=e
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader
+    -> hhh :: HierarchicalHeavyHitters(KEY DST, BYTES true, THRESHOLD 0.1)
+    -> Discard;
+  Script(TYPE ACTIVE, wait 5, print $(hhh.hhh), write hhh.clear, loop);
+
+=a
+
+HeavyHitters, AggregateCounter */
+
+class HierarchicalHeavyHitters : public Element { public:
+
+    HierarchicalHeavyHitters();
+    ~HierarchicalHeavyHitters();
+
+    const char *class_name() const	{ return "HierarchicalHeavyHitters"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    Packet *simple_action(Packet *p);
+    void simple_action_batch(PacketBatch &batch);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
+
+  private:
+
+    // One summary per prefix length, longest first.
+    struct Table {
+	SpaceSaving *levels;
+	Spinlock lock;
+	Table()
+	    : levels(0) {
+	}
+	~Table() {
+	    delete[] levels;
+	}
+    };
+
+    PerCPU<Table> _tables;
+    uint32_t _capacity;
+    int _granularity;
+    int _nlevels;
+    int _key;
+    bool _bytes;
+    double _threshold;
+
+    int prefix_length(int level) const {
+	return 32 - level * _granularity;
+    }
+    inline void count(Table &t, Packet *p) const;
+    void lock_all();
+    void unlock_all();
+    String unparse_hhh(double threshold);
+
+    static String read_handler(Element *e, void *thunk);
+    static int hhh_handler(int op, String &str, Element *e, const Handler *h, ErrorHandler *errh);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
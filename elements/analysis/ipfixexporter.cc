@@ -0,0 +1,474 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipfixexporter.{cc,hh} -- meters IP flows and exports IPFIX or NetFlow v9
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipfixexporter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/ipflowid.hh>
+#include <click/packetbatch.hh>
+#include <clicknet/ip.h>
+#include <clicknet/icmp.h>
+#include <clicknet/tcp.h>
+CLICK_DECLS
+
+// Information elements in each record, as {ID, length}.  NetFlow v9 shares
+// IDs 1-12 with IPFIX, but times flows with FIRST_SWITCHED (22) and
+// LAST_SWITCHED (21) in milliseconds of uptime.
+static const uint16_t ipfix_fields[][2] = {
+    {8, 4}, {12, 4}, {7, 2}, {11, 2}, {4, 1}, {5, 1}, {6, 1},
+    {2, 8}, {1, 8}, {152, 8}, {153, 8}, {136, 1}
+};
+static const uint16_t netflow9_fields[][2] = {
+    {8, 4}, {12, 4}, {7, 2}, {11, 2}, {4, 1}, {5, 1}, {6, 1},
+    {2, 8}, {1, 8}, {22, 4}, {21, 4}
+};
+enum { ipfix_record_size = 48, netflow9_record_size = 39,
+       template_id = 256 };
+
+static inline char *
+put16(char *x, uint16_t v)
+{
+    x[0] = v >> 8;
+    x[1] = v;
+    return x + 2;
+}
+
+static inline char *
+put32(char *x, uint32_t v)
+{
+    put16(x, v >> 16);
+    return put16(x + 2, v);
+}
+
+static inline char *
+put64(char *x, uint64_t v)
+{
+    put32(x, v >> 32);
+    return put32(x + 4, v);
+}
+
+IPFIXExporter::IPFIXExporter()
+    : _nsets(0), _ways(0), _timer(this)
+{
+}
+
+IPFIXExporter::~IPFIXExporter()
+{
+}
+
+int
+IPFIXExporter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t capacity = 65536, ways = 8;
+    _version = 10;
+    _inactive = 15;
+    _active = 1800;
+    _sample = 1;
+    _mtu = 1400;
+    _template_interval = 60;
+    _domain = 0;
+    if (Args(conf, this, errh)
+	.read("VERSION", _version)
+	.read("INACTIVE_TIMEOUT", SecondsArg(), _inactive)
+	.read("ACTIVE_TIMEOUT", SecondsArg(), _active)
+	.read("CAPACITY", capacity)
+	.read("WAYS", ways)
+	.read("SAMPLE", _sample)
+	.read("MTU", _mtu)
+	.read("TEMPLATE_INTERVAL", SecondsArg(), _template_interval)
+	.read("DOMAIN", _domain)
+	.complete() < 0)
+	return -1;
+    if (_version != 9 && _version != 10)
+	return errh->error("VERSION must be 9 or 10");
+    if (_inactive == 0 || _active == 0)
+	return errh->error("timeouts must be at least 1 second");
+    if (ways < 1 || ways > 16)
+	return errh->error("WAYS must be between 1 and 16");
+    if (capacity < ways || capacity > 0x1000000)
+	return errh->error("CAPACITY out of range");
+    if (_sample == 0)
+	_sample = 1;
+
+    _record_size = (_version == 10 ? ipfix_record_size : netflow9_record_size);
+    StringAccum sa;
+    uint32_t min_mtu = (_version == 10 ? 16 : 20) + append_template(sa)
+	+ 4 + _record_size;
+    if (_mtu < min_mtu || _mtu > 65507)
+	return errh->error("MTU must be between %u and 65507", min_mtu);
+
+    _ways = ways;
+    for (_nsets = 1; _nsets * _ways < capacity; _nsets *= 2)
+	/* nada */;
+    return 0;
+}
+
+int
+IPFIXExporter::initialize(ErrorHandler *errh)
+{
+    uint32_t now = Timestamp::recent_steady().sec();
+    if (_tables.initialize(master()) < 0)
+	return errh->error("out of memory");
+    for (int i = 0; i < _tables.size(); ++i) {
+	Table &t = _tables[i];
+	if (!(t.entries = new Entry[_nsets * _ways])
+	    || !(t.wheel = new uint32_t[wheel_size]))
+	    return errh->error("out of memory");
+	for (int s = 0; s < (int) wheel_size; ++s)
+	    t.wheel[s] = none;
+	t.cursor = now;
+    }
+    _boot_msec = Timestamp::now().msecval();
+    _template_due = true;
+    _template_sent = now;
+    _exported = _messages = 0;
+    _timer.initialize(this);
+    _timer.schedule_after_sec(1);
+    return 0;
+}
+
+void
+IPFIXExporter::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _tables.size(); ++i) {
+	delete[] _tables[i].entries;
+	delete[] _tables[i].wheel;
+    }
+    _tables.clear();
+}
+
+inline void
+IPFIXExporter::wheel_link(Table &t, uint32_t i, uint32_t deadline)
+{
+    // a deadline the timer has already passed would wait a whole turn
+    if ((int32_t) (deadline - t.cursor) <= 0)
+	deadline = t.cursor + 1;
+    Entry &e = t.entries[i];
+    uint32_t *slot = &t.wheel[deadline % wheel_size];
+    e.wheel_sec = deadline;
+    e.wheel_prev = none;
+    e.wheel_next = *slot;
+    if (*slot != none)
+	t.entries[*slot].wheel_prev = i;
+    *slot = i;
+}
+
+inline void
+IPFIXExporter::wheel_unlink(Table &t, uint32_t i)
+{
+    Entry &e = t.entries[i];
+    if (e.wheel_prev != none)
+	t.entries[e.wheel_prev].wheel_next = e.wheel_next;
+    else
+	t.wheel[e.wheel_sec % wheel_size] = e.wheel_next;
+    if (e.wheel_next != none)
+	t.entries[e.wheel_next].wheel_prev = e.wheel_prev;
+}
+
+// Called with t.lock held, after the entry leaves the wheel.
+void
+IPFIXExporter::export_entry(Table &t, uint32_t i, int reason)
+{
+    Entry &e = t.entries[i];
+    if (char *x = t.pending.extend(_record_size)) {
+	memcpy(x, &e.src, 4);
+	memcpy(x + 4, &e.dst, 4);
+	memcpy(x + 8, &e.sport, 2);
+	memcpy(x + 10, &e.dport, 2);
+	x[12] = e.proto;
+	x[13] = e.tos;
+	x[14] = e.tcp_flags;
+	x = put64(put64(x + 15, e.packets), e.octets);
+	if (_version == 10) {
+	    x = put64(put64(x, e.first_msec), e.last_msec);
+	    *x = reason;
+	} else
+	    put32(put32(x, e.first_msec - _boot_msec), e.last_msec - _boot_msec);
+    }
+    e.live = 0;
+    --t.nflows;
+}
+
+Packet *
+IPFIXExporter::simple_action(Packet *p)
+{
+    if (!p->has_network_header() || p->network_length() < (int) sizeof(click_ip))
+	return p;
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_v != 4)
+	return p;
+    Table &t = _tables.get();
+    if (_sample > 1) {
+	if (++t.sample_count < _sample)
+	    return p;
+	t.sample_count = 0;
+    }
+
+    uint8_t proto = iph->ip_p, tcp_flags = 0;
+    uint16_t sport = 0, dport = 0;
+    if (IP_FIRSTFRAG(iph)) {
+	const uint8_t *th = p->transport_header();
+	int tlen = p->transport_length();
+	if ((proto == IP_PROTO_TCP || proto == IP_PROTO_UDP
+	     || proto == IP_PROTO_DCCP || proto == IP_PROTO_UDPLITE
+	     || proto == IP_PROTO_SCTP) && tlen >= 4) {
+	    memcpy(&sport, th, 2);
+	    memcpy(&dport, th + 2, 2);
+	    if (proto == IP_PROTO_TCP && tlen >= 14)
+		tcp_flags = reinterpret_cast<const click_tcp *>(th)->th_flags;
+	} else if (proto == IP_PROTO_ICMP && tlen >= 2)
+	    sport = htons((th[0] << 8) | th[1]);
+    }
+
+    IPFlowID flow(iph->ip_src, sport, iph->ip_dst, dport);
+    uint32_t h = flow.hashcode() + (proto | (iph->ip_tos << 8)) * 0x9E3779B1U;
+    h ^= h >> 16;
+    uint32_t now = Timestamp::recent_steady().sec();
+    const Timestamp &ts = p->timestamp_anno();
+    uint64_t msec = (ts ? ts : Timestamp::now()).msecval();
+
+    t.lock.acquire();
+    uint32_t base = (h & (_nsets - 1)) * _ways, i, victim = base;
+    for (i = base; i != base + _ways; ++i) {
+	Entry &e = t.entries[i];
+	if (!e.live) {
+	    if (t.entries[victim].live)
+		victim = i;
+	} else if (e.src == iph->ip_src.s_addr && e.dst == iph->ip_dst.s_addr
+		   && e.sport == sport && e.dport == dport
+		   && e.proto == proto && e.tos == iph->ip_tos)
+	    break;
+	else if (t.entries[victim].live
+		 && (int32_t) (e.last_sec - t.entries[victim].last_sec) < 0)
+	    victim = i;
+    }
+
+    if (i == base + _ways) {
+	i = victim;
+	if (t.entries[i].live) {
+	    wheel_unlink(t, i);
+	    export_entry(t, i, r_room);
+	    ++t.evicted;
+	}
+	Entry &e = t.entries[i];
+	e.src = iph->ip_src.s_addr;
+	e.dst = iph->ip_dst.s_addr;
+	e.sport = sport;
+	e.dport = dport;
+	e.proto = proto;
+	e.tos = iph->ip_tos;
+	e.tcp_flags = 0;
+	e.live = 1;
+	e.start_sec = now;
+	e.packets = e.octets = 0;
+	e.first_msec = msec;
+	++t.nflows;
+	wheel_link(t, i, now + (_inactive < _active ? _inactive : _active));
+    }
+
+    Entry &e = t.entries[i];
+    ++e.packets;
+    e.octets += ntohs(iph->ip_len);
+    e.tcp_flags |= tcp_flags;
+    e.last_sec = now;
+    e.last_msec = msec;
+    if (tcp_flags & (TH_FIN | TH_RST)) {
+	wheel_unlink(t, i);
+	export_entry(t, i, r_end);
+    }
+    t.lock.release();
+    return p;
+}
+
+// Called with t.lock held.  Exports the flows that have timed out by second
+// now, or all flows if all is true.
+void
+IPFIXExporter::expire(Table &t, uint32_t now, bool all)
+{
+    if (all) {
+	for (uint32_t i = 0; i != _nsets * _ways; ++i)
+	    if (t.entries[i].live) {
+		wheel_unlink(t, i);
+		export_entry(t, i, r_forced);
+	    }
+	return;
+    }
+
+    // Entries are not moved when packets arrive, so a slot holds entries
+    // that were due then; check each again and move those still active.
+    uint32_t sec = t.cursor;
+    if (now - sec > wheel_size)
+	sec = now - wheel_size;
+    while ((int32_t) (now - sec) > 0) {
+	++sec;
+	uint32_t *slot = &t.wheel[sec % wheel_size];
+	uint32_t i = *slot;
+	*slot = none;
+	t.cursor = sec;
+	while (i != none) {
+	    Entry &e = t.entries[i];
+	    uint32_t next = e.wheel_next;
+	    uint32_t idle = e.last_sec + _inactive, active = e.start_sec + _active;
+	    if ((int32_t) (idle - now) <= 0)
+		export_entry(t, i, r_idle);
+	    else if ((int32_t) (active - now) <= 0)
+		export_entry(t, i, r_active);
+	    else
+		wheel_link(t, i, (int32_t) (idle - active) < 0 ? idle : active);
+	    i = next;
+	}
+    }
+}
+
+int
+IPFIXExporter::append_template(StringAccum &sa) const
+{
+    const uint16_t (*fields)[2] = (_version == 10 ? ipfix_fields : netflow9_fields);
+    int n = (_version == 10 ? sizeof(ipfix_fields) : sizeof(netflow9_fields))
+	/ sizeof(fields[0]);
+    int len = 8 + 4 * n;
+    if (char *x = sa.extend(len)) {
+	x = put16(x, _version == 10 ? 2 : 0);
+	x = put16(x, len);
+	x = put16(x, template_id);
+	x = put16(x, n);
+	for (int i = 0; i < n; ++i)
+	    x = put16(put16(x, fields[i][0]), fields[i][1]);
+    }
+    return len;
+}
+
+void
+IPFIXExporter::export_pending(bool all)
+{
+    uint32_t now = Timestamp::recent_steady().sec();
+    PacketBatch batch;
+
+    _export_lock.acquire();
+    for (int i = 0; i < _tables.size(); ++i) {
+	Table &t = _tables[i];
+	t.lock.acquire();
+	expire(t, now, all);
+	_records.append(t.pending.data(), t.pending.length());
+	t.pending.clear();
+	t.lock.release();
+    }
+
+    if (now - _template_sent >= _template_interval)
+	_template_due = true;
+    const char *r = _records.data();
+    int left = _records.length() / _record_size;
+    int header_len = (_version == 10 ? 16 : 20);
+    uint32_t export_sec = Timestamp::now().sec();
+    uint32_t uptime = Timestamp::now().msecval() - _boot_msec;
+    while (left > 0 || _template_due) {
+	StringAccum sa(_mtu);
+	sa.extend(header_len);
+	int count = 0;
+	if (_template_due) {
+	    append_template(sa);
+	    _template_due = false;
+	    _template_sent = now;
+	    ++count;
+	}
+	int n = (_mtu - sa.length() - 4) / _record_size;
+	if (n > left)
+	    n = left;
+	if (n > 0) {
+	    char *x = sa.extend(4);
+	    put16(put16(x, template_id), 4 + n * _record_size);
+	    sa.append(r, n * _record_size);
+	    r += n * _record_size;
+	    left -= n;
+	    count += n;
+	}
+	if (sa.out_of_memory())
+	    break;
+
+	char *x = sa.data();
+	if (_version == 10) {
+	    x = put16(put16(x, 10), sa.length());
+	    put32(put32(put32(x, export_sec), _exported), _domain);
+	} else {
+	    x = put16(put16(x, 9), count);
+	    x = put32(put32(x, uptime), export_sec);
+	    put32(put32(x, _messages), _domain);
+	}
+	_exported += n > 0 ? n : 0;
+	++_messages;
+	if (Packet *p = Packet::make(sa.data(), sa.length()))
+	    batch.push_back(p);
+    }
+    _records.clear();
+    _export_lock.release();
+
+    if (!batch.empty())
+	output(1).push_batch(batch);
+}
+
+void
+IPFIXExporter::run_timer(Timer *)
+{
+    export_pending(false);
+    _timer.reschedule_after_sec(1);
+}
+
+enum { h_flows, h_exported, h_evicted, h_messages, h_flush };
+
+String
+IPFIXExporter::read_handler(Element *e, void *thunk)
+{
+    IPFIXExporter *ie = static_cast<IPFIXExporter *>(e);
+    uint32_t Table::*field;
+    switch ((uintptr_t) thunk) {
+    case h_flows:
+	field = &Table::nflows;
+	break;
+    case h_evicted:
+	field = &Table::evicted;
+	break;
+    case h_exported:
+	return String(ie->_exported);
+    case h_messages:
+	return String(ie->_messages);
+    default:
+	return String();
+    }
+    uint32_t sum = 0;
+    for (int i = 0; i < ie->_tables.size(); ++i)
+	sum += ie->_tables[i].*field;
+    return String(sum);
+}
+
+int
+IPFIXExporter::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<IPFIXExporter *>(e)->export_pending(true);
+    return 0;
+}
+
+void
+IPFIXExporter::add_handlers()
+{
+    add_read_handler("flows", read_handler, h_flows);
+    add_read_handler("exported", read_handler, h_exported);
+    add_read_handler("evicted", read_handler, h_evicted);
+    add_read_handler("messages", read_handler, h_messages);
+    add_write_handler("flush", write_handler, h_flush, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPFIXExporter)
@@ -0,0 +1,228 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPFIXEXPORTER_HH
+#define CLICK_IPFIXEXPORTER_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/percpu.hh>
+#include <click/straccum.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IPFIXExporter([I<keywords> VERSION, INACTIVE_TIMEOUT, ACTIVE_TIMEOUT, CAPACITY, WAYS, SAMPLE, MTU, TEMPLATE_INTERVAL, DOMAIN])
+
+=s ipmeasure
+
+meters IP flows and exports them as IPFIX or NetFlow v9 records
+
+=d
+
+IPFIXExporter meters the IPv4 flows passing through it and exports a record
+for each finished flow, in IPFIX (RFC 7011) or NetFlow version 9 (RFC 3954)
+format.  Input 0 takes IP packets with network headers set; they leave,
+unchanged, on output 0.  Export messages leave on output 1.  Each is the
+payload of one UDP datagram, ready for Socket(UDP, ...) or for UDPIPEncap and
+an interface.
+
+A flow is identified by source and destination address, IP protocol, type of
+service, and source and destination port (for ICMP, the source port holds type
+and code).  Its record carries those fields, the flow's packet and byte
+counts, the ORed TCP flags, and its first and last packet times.  Packet times
+come from the timestamp annotation, or from the current time if the annotation
+is zero.
+
+A flow finishes when it has seen no packets for INACTIVE_TIMEOUT, when it has
+lasted ACTIVE_TIMEOUT (a long flow is then exported in pieces), when a TCP FIN
+or RST packet is seen, or when the cache has no room for a new flow.  Each
+thread keeps its own cache of about CAPACITY flows, WAYS flows per set; when a
+set is full, its least recently used flow is exported early to make room.
+Timeouts are checked once a second by a timing wheel per cache, so a flow is
+exported within about a second of finishing.  Finished records are gathered
+into as few messages as MTU allows.
+
+The first message, and then one message every TEMPLATE_INTERVAL, starts with
+the template describing the records.  The template ID is 256.
+
+Keyword arguments are:
+
+=over 8
+
+=item VERSION
+
+Integer, 9 or 10.  Export NetFlow v9 (9) or IPFIX (10) messages.  IPFIX
+records carry flow start and end times in milliseconds since the epoch, and
+the reason the flow finished; NetFlow v9 records carry start and end times in
+milliseconds of exporter uptime.  Default is 10.
+
+=item INACTIVE_TIMEOUT
+
+Time in seconds.  Default is 15.
+
+=item ACTIVE_TIMEOUT
+
+Time in seconds.  Default is 1800.
+
+=item CAPACITY
+
+Unsigned integer.  Flows per thread, rounded up so the number of sets is a
+power of two.  Default is 65536.
+
+=item WAYS
+
+Unsigned integer between 1 and 16.  Flows per set.  Default is 8.
+
+=item SAMPLE
+
+Unsigned integer.  If greater than 1, meter only every SAMPLEth packet on each
+thread.  Counts are not scaled.  Default is 1.
+
+=item MTU
+
+Unsigned integer.  Maximum message length in bytes.  Default is 1400.
+
+=item TEMPLATE_INTERVAL
+
+Time in seconds.  Default is 60.
+
+=item DOMAIN
+
+Unsigned integer.  The observation domain ID (NetFlow v9 source ID) for
+message headers.  Default is 0.
+
+=back
+
+=h flows read-only
+
+Returns the number of flows being metered.
+
+=h exported read-only
+
+Returns the number of flow records exported.
+
+=h evicted read-only
+
+Returns the number of flows exported early to make room for another.
+
+=h messages read-only
+
+Returns the number of export messages emitted.
+
+=h flush write-only
+
+Finishes every flow and exports its record at once.  Use this before the
+router stops, or the records of unfinished flows are lost.
+
+=e
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader
+    -> ipfix :: IPFIXExporter(INACTIVE_TIMEOUT 30)
+    -> Discard;
+  ipfix[1] -> Socket(UDP, 10.0.0.1, 4739, CLIENT true);
+
+=a
+
+AggregateIPFlows, ToIPFlowDumps, FlowCache, Socket, UDPIPEncap */
+
+class IPFIXExporter : public Element { public:
+
+    IPFIXExporter();
+    ~IPFIXExporter();
+
+    const char *class_name() const	{ return "IPFIXExporter"; }
+    const char *flags() const		{ return "T"; }
+    const char *port_count() const	{ return "1/2"; }
+    const char *processing() const	{ return PROCESSING_A_AH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    Packet *simple_action(Packet *p);
+    void run_timer(Timer *timer);
+
+  private:
+
+    enum { wheel_size = 256, none = 0xFFFFFFFFU };
+
+    // flow end reasons, as IPFIX's flowEndReason
+    enum { r_idle = 1, r_active = 2, r_end = 3, r_forced = 4, r_room = 5 };
+
+    struct Entry {
+	uint32_t src;		// network byte order
+	uint32_t dst;
+	uint16_t sport;		// network byte order
+	uint16_t dport;
+	uint8_t proto;
+	uint8_t tos;
+	uint8_t tcp_flags;
+	uint8_t live;
+	uint32_t start_sec;	// Timestamp::recent_steady() seconds
+	uint32_t last_sec;
+	uint32_t wheel_sec;	// second whose timing wheel slot holds us
+	uint32_t wheel_next;	// slot list, as entry indexes
+	uint32_t wheel_prev;
+	uint64_t packets;
+	uint64_t octets;
+	uint64_t first_msec;	// packet times
+	uint64_t last_msec;
+	Entry()
+	    : live(0) {
+	}
+    };
+
+    // One per thread.  The packet path and the timer share a table, so it
+    // has a lock, but the timer takes it only once a second.
+    struct Table {
+	Entry *entries;
+	uint32_t *wheel;
+	uint32_t cursor;	// last wheel second examined
+	uint32_t sample_count;
+	uint32_t nflows;
+	uint32_t evicted;
+	StringAccum pending;	// encoded records awaiting export
+	Spinlock lock;
+	Table()
+	    : entries(0), wheel(0), cursor(0), sample_count(0), nflows(0),
+	      evicted(0) {
+	}
+    };
+
+    PerCPU<Table> _tables;
+    uint32_t _nsets;
+    uint32_t _ways;
+
+    int _version;
+    uint32_t _inactive;
+    uint32_t _active;
+    uint32_t _sample;
+    uint32_t _mtu;
+    uint32_t _template_interval;
+    uint32_t _domain;
+    int _record_size;
+
+    Timer _timer;
+    Spinlock _export_lock;
+    StringAccum _records;
+    uint64_t _boot_msec;
+    uint32_t _template_sent;
+    bool _template_due;
+    uint32_t _exported;
+    uint32_t _messages;
+
+    inline void wheel_link(Table &t, uint32_t i, uint32_t deadline);
+    inline void wheel_unlink(Table &t, uint32_t i);
+    void export_entry(Table &t, uint32_t i, int reason);
+    void expire(Table &t, uint32_t now, bool all);
+    void export_pending(bool all);
+    int append_template(StringAccum &sa) const;
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -4,6 +4,7 @@
 #include <click/string.hh>
 #include <click/straccum.hh>
 #include <click/packet.hh>
+#include <click/confparse.hh>
 CLICK_DECLS
 class Element;
 class IPFlowID;
@@ -153,6 +154,20 @@ struct FieldSynonym {
     static void remove(const FieldSynonym *);
 };
 
+// Columnar blocks, written by ToIPSummaryDump(COLUMNAR true).
+enum { BLOCK_HEADER_SIZE = 32,
+       BLOCK_HAS_TIMES = 1,
+       COLUMN_RAW = 0,
+       COLUMN_TIMESTAMP = 1 };
+
+// Timestamp fields extract and inject sec and nsec in u32[0] and u32[1];
+// columnar blocks store them as nanosecond deltas.
+inline bool column_timestamp(const char *name) {
+    return strcmp(name, "timestamp") == 0 || strcmp(name, "ntimestamp") == 0
+	|| strcmp(name, "first_timestamp") == 0
+	|| strcmp(name, "first_ntimestamp") == 0;
+}
+
 extern const FieldReader null_reader;
 extern const FieldWriter null_writer;
 
@@ -247,6 +262,55 @@ inline bool field_missing(const PacketDesc &d, int proto, int l)
     return (d.bad_sa ? hard_field_missing(d, proto, l) : false);
 }
 
+// Text trace readers spend much of their time converting numbers.  These
+// handle plain decimals and dotted quads without cp_integer's generality.
+
+/** @brief Parse an unsigned integer at [@a s, @a end).
+ *
+ * Equivalent to cp_integer(@a s, @a end, 0, @a result), but handles plain
+ * decimal numbers itself. */
+inline const char *parse_uint(const char *s, const char *end, uint32_t *result)
+{
+    // leading zeros, suffixes, and overflow take the general path
+    if (s < end && *s >= '0' && *s <= '9'
+	&& (*s != '0' || s + 1 == end || !isalnum((unsigned char) s[1]))) {
+	const char *t = s;
+	uint64_t v = 0;
+	while (t < end && *t >= '0' && *t <= '9' && t - s < 10)
+	    v = 10 * v + (*t++ - '0');
+	if (v <= 0xFFFFFFFFU
+	    && (t == end || !(isalnum((unsigned char) *t) || *t == '_'))) {
+	    *result = v;
+	    return t;
+	}
+    }
+    return cp_integer(s, end, 0, result);
+}
+
+/** @brief Parse [@a s, @a end) as a dotted-quad IP address.
+ *
+ * Returns false, leaving @a a unchanged, unless the whole range is four
+ * decimal components; callers fall back to IPAddressArg for other forms. */
+inline bool parse_ip(const char *s, const char *end, struct in_addr &a)
+{
+    uint32_t x = 0;
+    for (int i = 0; i < 4; ++i) {
+	if (i && (s == end || *s++ != '.'))
+	    return false;
+	const char *t = s;
+	uint32_t v = 0;
+	while (s < end && *s >= '0' && *s <= '9' && s - t < 3)
+	    v = 10 * v + (*s++ - '0');
+	if (s == t || v > 255)
+	    return false;
+	x = (x << 8) | v;
+    }
+    if (s != end)
+	return false;
+    a.s_addr = htonl(x);
+    return true;
+}
+
 }
 
 class IPSummaryDumpInfo { public:
@@ -0,0 +1,237 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * latencyhistogram.{cc,hh} -- latency distribution between two points
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "latencyhistogram.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+LatencyHistogram::LatencyHistogram()
+{
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+void
+LatencyHistogram::Shard::clear()
+{
+    count = sum = max = 0;
+    min = ~(uint64_t) 0;
+    memset(bucket, 0, sizeof(bucket));
+}
+
+int
+LatencyHistogram::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _anno = PERFCTR_ANNO_OFFSET;
+    return Args(conf, this, errh)
+	.read("ANNO", AnnoArg(8), _anno)
+	.complete();
+}
+
+int
+LatencyHistogram::initialize(ErrorHandler *errh)
+{
+    if (_shards.initialize(master()) < 0)
+	return errh->error("out of memory");
+    _cal_time = Timestamp::now_steady();
+    _cal_ticks = now_ticks();
+    return 0;
+}
+
+inline Packet *
+LatencyHistogram::handle(int port, Packet *p)
+{
+    uint64_t now = now_ticks();
+    if (port == 0)
+	p->set_anno_u64(_anno, now);
+    else {
+	uint64_t then = p->anno_u64(_anno);
+	_shards.get().record(now > then ? now - then : 0);
+    }
+    return p;
+}
+
+void
+LatencyHistogram::push(int port, Packet *p)
+{
+    output(port).push(handle(port, p));
+}
+
+Packet *
+LatencyHistogram::pull(int port)
+{
+    Packet *p = input(port).pull();
+    return p ? handle(port, p) : 0;
+}
+
+uint64_t
+LatencyHistogram::bucket_low(int i)
+{
+    if (i < 2 * half)
+	return i;
+    int e = i / half - 1;
+    return (uint64_t) (i - e * half) << e;
+}
+
+uint64_t
+LatencyHistogram::bucket_high(int i)
+{
+    if (i < 2 * half)
+	return i;
+    int e = i / half - 1;
+    return (((uint64_t) (i - e * half + 1)) << e) - 1;
+}
+
+void
+LatencyHistogram::merge(Shard &s) const
+{
+    s.clear();
+    for (int t = 0; t < _shards.size(); ++t) {
+	const Shard &x = _shards[t];
+	if (!x.count)
+	    continue;
+	s.count += x.count;
+	s.sum += x.sum;
+	if (x.min < s.min)
+	    s.min = x.min;
+	if (x.max > s.max)
+	    s.max = x.max;
+	for (int i = 0; i < nbuckets; ++i)
+	    s.bucket[i] += x.bucket[i];
+    }
+}
+
+double
+LatencyHistogram::ns_per_tick() const
+{
+#if (CLICK_USERLEVEL || CLICK_LINUXMODULE) && HAVE_INT64_TYPES && (__i386__ || __x86_64__)
+    // Calibrate over at least 10ms; longer runs give a better estimate.
+    Timestamp elapsed;
+    uint64_t ticks;
+    do {
+	elapsed = Timestamp::now_steady() - _cal_time;
+	ticks = now_ticks() - _cal_ticks;
+    } while (elapsed < Timestamp::make_msec(10));
+    return ticks ? (double) elapsed.nsecval() / ticks : 1;
+#else
+    return 1;
+#endif
+}
+
+uint64_t
+LatencyHistogram::percentile(const Shard &s, double pct)
+{
+    if (!s.count)
+	return 0;
+    uint64_t rank = (uint64_t) (pct / 100 * s.count + 0.5);
+    if (rank < 1)
+	rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < nbuckets; ++i)
+	if ((seen += s.bucket[i]) >= rank)
+	    return bucket_high(i) < s.max ? bucket_high(i) : s.max;
+    return s.max;
+}
+
+enum { h_count, h_min, h_max, h_mean, h_p50, h_p99, h_p999, h_histogram };
+
+String
+LatencyHistogram::read_handler(Element *e, void *thunk)
+{
+    LatencyHistogram *lh = static_cast<LatencyHistogram *>(e);
+    int which = reinterpret_cast<intptr_t>(thunk);
+    Shard *s = new Shard;
+    lh->merge(*s);
+    double scale = lh->ns_per_tick();
+    StringAccum sa;
+    switch (which) {
+    case h_count:
+	sa << s->count;
+	break;
+    case h_min:
+	sa << (uint64_t) (s->count ? s->min * scale + 0.5 : 0);
+	break;
+    case h_max:
+	sa << (uint64_t) (s->max * scale + 0.5);
+	break;
+    case h_mean:
+	sa << (s->count ? s->sum * scale / s->count : 0.);
+	break;
+    case h_p50:
+    case h_p99:
+    case h_p999: {
+	static const double pcts[] = { 50, 99, 99.9 };
+	sa << (uint64_t) (percentile(*s, pcts[which - h_p50]) * scale + 0.5);
+	break;
+    }
+    case h_histogram:
+	for (int i = 0; i < nbuckets; ++i)
+	    if (s->bucket[i])
+		sa << (uint64_t) (bucket_low(i) * scale + 0.5) << ' '
+		   << (uint64_t) (bucket_high(i) * scale + 0.5) << ' '
+		   << s->bucket[i] << '\n';
+	break;
+    }
+    delete s;
+    return sa.take_string();
+}
+
+int
+LatencyHistogram::percentile_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    LatencyHistogram *lh = static_cast<LatencyHistogram *>(e);
+    double pct;
+    if (!DoubleArg().parse(cp_uncomment(str), pct) || pct < 0 || pct > 100)
+	return errh->error("argument should be a percentile between 0 and 100");
+    Shard *s = new Shard;
+    lh->merge(*s);
+    str = String((uint64_t) (percentile(*s, pct) * lh->ns_per_tick() + 0.5));
+    delete s;
+    return 0;
+}
+
+int
+LatencyHistogram::reset_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    LatencyHistogram *lh = static_cast<LatencyHistogram *>(e);
+    for (int t = 0; t < lh->_shards.size(); ++t)
+	lh->_shards[t].clear();
+    return 0;
+}
+
+void
+LatencyHistogram::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("min", read_handler, h_min);
+    add_read_handler("max", read_handler, h_max);
+    add_read_handler("mean", read_handler, h_mean);
+    add_read_handler("p50", read_handler, h_p50);
+    add_read_handler("p99", read_handler, h_p99);
+    add_read_handler("p999", read_handler, h_p999);
+    add_read_handler("histogram", read_handler, h_histogram);
+    set_handler("percentile", Handler::OP_READ | Handler::READ_PARAM, percentile_handler);
+    add_write_handler("reset_counts", reset_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(LatencyHistogram)
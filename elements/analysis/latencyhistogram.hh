@@ -0,0 +1,203 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LATENCYHISTOGRAM_HH
+#define CLICK_LATENCYHISTOGRAM_HH
+#include <click/element.hh>
+#include <click/percpu.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+LatencyHistogram([I<keywords> ANNO])
+
+=s timestamps
+
+measures latency distributions between two points
+
+=d
+
+LatencyHistogram measures how long packets take to travel between two points
+in a configuration and keeps the results in a histogram.  Packets arriving on
+input 0 are stamped with the current time and emitted on output 0.  Packets
+arriving on input 1 are checked against that stamp, their latency recorded,
+and then emitted on output 1.  Thus, to measure the path from A to B:
+
+  A -> [0] lh :: LatencyHistogram [0] -> ... -> [1] lh [1] -> B;
+
+The clock is the processor's cycle counter where available (x86), which
+costs a few nanoseconds to read.  Cycle counts are converted to nanoseconds
+when handlers are read, using a rate calibrated against the system's steady
+clock since the element was initialized.  Elsewhere the clock is
+Timestamp::now_steady().  Measurements between threads assume the threads'
+cycle counters are synchronized, as they are on current x86 processors.
+
+The histogram is log-linear, in the style of HdrHistogram: latencies below 128
+ticks have exact buckets; larger latencies are kept with a relative error of at
+most 1/64.  Each thread records into its own histogram, without locks or
+atomic operations; handlers combine those histograms when read, so reading
+them never stalls the data path, though a read concurrent with recording may
+miss a few just-recorded samples.
+
+Keyword arguments are:
+
+=over 8
+
+=item ANNO
+
+Annotation used to store the stamp; 8 bytes.  Defaults to the performance
+counter annotation (offset 40), which SetCycleCount and SetPerfCount also use.
+
+=back
+
+=h count read-only
+
+Returns the number of latencies recorded.
+
+=h min read-only
+
+Returns the smallest latency recorded, in nanoseconds.
+
+=h max read-only
+
+Returns the largest latency recorded, in nanoseconds.
+
+=h mean read-only
+
+Returns the mean latency, in nanoseconds.
+
+=h p50 read-only
+
+Returns the median latency, in nanoseconds.  Like the other percentiles, this
+is the upper bound of the histogram bucket containing the percentile.
+
+=h p99 read-only
+
+Returns the 99th percentile latency, in nanoseconds.
+
+=h p999 read-only
+
+Returns the 99.9th percentile latency, in nanoseconds.
+
+=h percentile "read with parameters"
+
+Takes a percentile between 0 and 100 as a parameter and returns that
+percentile latency, in nanoseconds.  For example, "lh.percentile 99.99".
+
+=h histogram read-only
+
+Returns the non-empty histogram buckets, one per line, as "LOW HIGH COUNT",
+where LOW and HIGH are the bucket's inclusive latency bounds in nanoseconds.
+
+=h reset_counts write-only
+
+Clears the histogram.
+
+=e
+
+  FromDevice(eth0) -> [0] lh :: LatencyHistogram [0]
+      -> Strip(14) -> ... lookup ... -> [1] lh [1] -> Queue -> ToDevice(eth1);
+
+  Script(TYPE ACTIVE, wait 1s, print lh.p50 lh.p99 lh.p999, loop);
+
+=a TimestampAccum, SetCycleCount, CycleCountAccum, StoreTimestamp */
+
+class LatencyHistogram : public Element { public:
+
+    LatencyHistogram();
+    ~LatencyHistogram();
+
+    const char *class_name() const	{ return "LatencyHistogram"; }
+    const char *port_count() const	{ return "2/2"; }
+    const char *flow_code() const	{ return "#/#"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+
+    static inline uint64_t now_ticks();
+
+  private:
+
+    enum {
+	sub_bits = 7,
+	half = 1 << (sub_bits - 1),
+	max_bits = 44,		// larger latencies are clamped
+	nbuckets = (max_bits - sub_bits + 2) * half
+    };
+
+    struct Shard {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t bucket[nbuckets];
+	Shard() {
+	    clear();
+	}
+	void clear();
+	inline void record(uint64_t ticks);
+    };
+
+    PerCPU<Shard> _shards;
+    int _anno;
+    uint64_t _cal_ticks;
+    Timestamp _cal_time;
+
+    static inline int bucket_index(uint64_t ticks);
+    static uint64_t bucket_low(int i);
+    static uint64_t bucket_high(int i);
+
+    inline Packet *handle(int port, Packet *p);
+
+    void merge(Shard &s) const;
+    double ns_per_tick() const;
+    static uint64_t percentile(const Shard &s, double pct);
+
+    static String read_handler(Element *, void *);
+    static int percentile_handler(int, String &, Element *, const Handler *, ErrorHandler *);
+    static int reset_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+inline uint64_t
+LatencyHistogram::now_ticks()
+{
+#if (CLICK_USERLEVEL || CLICK_LINUXMODULE) && HAVE_INT64_TYPES && (__i386__ || __x86_64__)
+    return click_get_cycles();
+#else
+    Timestamp t = Timestamp::now_steady();
+    return (uint64_t) t.sec() * 1000000000 + t.nsec();
+#endif
+}
+
+inline int
+LatencyHistogram::bucket_index(uint64_t ticks)
+{
+    if (ticks < 2 * half)
+	return ticks;
+    if (ticks >> max_bits)
+	ticks = (((uint64_t) 1) << max_bits) - 1;
+    // e is the number of low-order bits dropped; ticks >> e is in
+    // [half, 2*half)
+    int e = 64 - ffs_msb(ticks) - (sub_bits - 1);
+    return e * half + (int) (ticks >> e);
+}
+
+inline void
+LatencyHistogram::Shard::record(uint64_t ticks)
+{
+    ++count;
+    sum += ticks;
+    if (ticks < min)
+	min = ticks;
+    if (ticks > max)
+	max = ticks;
+    ++bucket[bucket_index(ticks)];
+}
+
+CLICK_ENDDECLS
+#endif
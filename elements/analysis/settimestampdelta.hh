@@ -50,6 +50,7 @@ class SetTimestampDelta : public Element { public:
     ~SetTimestampDelta();
 
     const char *class_name() const	{ return "SetTimestampDelta"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1; }
 
     int configure(Vector<String> &, ErrorHandler *);
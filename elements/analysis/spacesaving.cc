@@ -0,0 +1,182 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * spacesaving.{cc,hh} -- Space-Saving heavy hitter summary
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "spacesaving.hh"
+#include <click/glue.hh>
+#include <click/hashtable.hh>
+CLICK_DECLS
+
+SpaceSaving::SpaceSaving()
+    : _heap(0), _table(0), _mask(0), _n(0), _capacity(0), _total(0)
+{
+}
+
+SpaceSaving::~SpaceSaving()
+{
+    delete[] _heap;
+    delete[] _table;
+}
+
+int
+SpaceSaving::initialize(uint32_t capacity)
+{
+    uint32_t tsize = 2;
+    while (tsize < 2 * capacity)
+	tsize *= 2;
+    delete[] _heap;
+    delete[] _table;
+    _heap = new Counter[capacity];
+    _table = new uint32_t[tsize];
+    if (!_heap || !_table)
+	return -ENOMEM;
+    _capacity = capacity;
+    _mask = tsize - 1;
+    clear();
+    return 0;
+}
+
+void
+SpaceSaving::clear()
+{
+    if (_table)
+	memset(_table, 0, (_mask + 1) * sizeof(uint32_t));
+    _n = 0;
+    _total = 0;
+}
+
+inline void
+SpaceSaving::place(uint32_t pos, const Counter &c)
+{
+    _heap[pos] = c;
+    _table[c.slot] = pos + 1;
+}
+
+void
+SpaceSaving::sift_down(uint32_t pos)
+{
+    Counter c = _heap[pos];
+    while (1) {
+	uint32_t child = 2 * pos + 1;
+	if (child >= _n)
+	    break;
+	if (child + 1 < _n && _heap[child + 1].count < _heap[child].count)
+	    ++child;
+	if (c.count <= _heap[child].count)
+	    break;
+	place(pos, _heap[child]);
+	pos = child;
+    }
+    place(pos, c);
+}
+
+void
+SpaceSaving::erase_slot(uint32_t slot)
+{
+    // Linear probing deletion: shift back later entries whose probe
+    // sequences pass through the emptied slot.
+    for (uint32_t j = (slot + 1) & _mask; _table[j]; j = (j + 1) & _mask) {
+	uint32_t home = hash(_heap[_table[j] - 1].key);
+	if (((j - home) & _mask) >= ((j - slot) & _mask)) {
+	    _table[slot] = _table[j];
+	    _heap[_table[slot] - 1].slot = slot;
+	    slot = j;
+	}
+    }
+    _table[slot] = 0;
+}
+
+void
+SpaceSaving::update(uint32_t key, uint64_t weight)
+{
+    _total += weight;
+    uint32_t slot = hash(key);
+    for (; _table[slot]; slot = (slot + 1) & _mask)
+	if (_heap[_table[slot] - 1].key == key) {
+	    uint32_t pos = _table[slot] - 1;
+	    _heap[pos].count += weight;
+	    sift_down(pos);
+	    return;
+	}
+
+    Counter c;
+    c.key = key;
+    if (_n < _capacity) {
+	// The new count may be below its parents' counts; sift it up.
+	c.slot = slot;
+	c.count = weight;
+	c.error = 0;
+	uint32_t pos = _n++;
+	while (pos > 0 && _heap[(pos - 1) / 2].count > c.count) {
+	    place(pos, _heap[(pos - 1) / 2]);
+	    pos = (pos - 1) / 2;
+	}
+	place(pos, c);
+    } else {
+	// Replace the smallest counter.  Deleting its key may move other
+	// keys, so look for an empty slot again afterwards.
+	erase_slot(_heap[0].slot);
+	for (slot = hash(key); _table[slot]; slot = (slot + 1) & _mask)
+	    /* nada */;
+	c.slot = slot;
+	c.error = _heap[0].count;
+	c.count = c.error + weight;
+	place(0, c);
+	sift_down(0);
+    }
+}
+
+static int
+counter_compar(const void *av, const void *bv, void *)
+{
+    const SpaceSaving::Counter *a = (const SpaceSaving::Counter *) av;
+    const SpaceSaving::Counter *b = (const SpaceSaving::Counter *) bv;
+    if (a->count != b->count)
+	return a->count > b->count ? -1 : 1;
+    else
+	return a->key < b->key ? -1 : (a->key > b->key);
+}
+
+void
+SpaceSaving::merge(const Vector<const SpaceSaving *> &in,
+		   Vector<Counter> &out, int max)
+{
+    out.clear();
+    HashTable<uint32_t, int> index;
+    uint64_t floors = 0;
+    for (int i = 0; i < in.size(); ++i)
+	floors += in[i]->floor();
+    for (int i = 0; i < in.size(); ++i)
+	for (const Counter *c = in[i]->begin(); c != in[i]->end(); ++c) {
+	    HashTable<uint32_t, int>::iterator it = index.find_insert(c->key, out.size());
+	    if (it.value() == out.size()) {
+		Counter m;
+		m.key = c->key;
+		m.slot = 0;
+		m.count = m.error = floors;
+		out.push_back(m);
+	    }
+	    Counter &m = out[it.value()];
+	    m.count += c->count - in[i]->floor();
+	    m.error += c->error - in[i]->floor();
+	}
+    if (out.size())
+	click_qsort(out.begin(), out.size(), sizeof(Counter), counter_compar);
+    if (max >= 0 && out.size() > max)
+	out.resize(max);
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(SpaceSaving)
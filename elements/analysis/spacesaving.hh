@@ -0,0 +1,89 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SPACESAVING_HH
+#define CLICK_SPACESAVING_HH
+#include <click/vector.hh>
+CLICK_DECLS
+
+/** @brief Space-Saving summary of the heaviest 32-bit keys in a stream.
+ *
+ * A SpaceSaving summary monitors at most capacity() keys in fixed memory.
+ * An update to a monitored key adds to its count.  An update to another key,
+ * when the summary is full, replaces the key with the smallest count, which
+ * becomes the new key's error; the new key's count is that smallest count
+ * plus the update.  Counts never underestimate, and overestimate by at most
+ * total() / capacity() (Metwally, Agrawal, and El Abbadi, ICDT 2005).
+ *
+ * Counters live in a binary min-heap on count, and an open-addressed table
+ * maps keys to heap positions, so an update costs O(log capacity). */
+class SpaceSaving { public:
+
+    struct Counter {
+	uint32_t key;
+	uint32_t slot;		// position in the key table
+	uint64_t count;
+	uint64_t error;
+    };
+
+    SpaceSaving();
+    ~SpaceSaving();
+
+    /** @brief Allocate room for @a capacity keys, and clear.
+     * @return 0 on success, -ENOMEM on failure */
+    int initialize(uint32_t capacity);
+    void clear();
+
+    uint32_t capacity() const	{ return _capacity; }
+    uint32_t size() const	{ return _n; }
+    uint64_t total() const	{ return _total; }
+    const Counter *begin() const { return _heap; }
+    const Counter *end() const	{ return _heap + _n; }
+
+    /** @brief Return the count a key not in the summary may have had. */
+    uint64_t floor() const {
+	return _n < _capacity ? 0 : _heap[0].count;
+    }
+
+    /** @brief Return the counter for @a key, or null if it is not
+     * monitored. */
+    const Counter *find(uint32_t key) const {
+	for (uint32_t i = hash(key); _table[i]; i = (i + 1) & _mask)
+	    if (_heap[_table[i] - 1].key == key)
+		return &_heap[_table[i] - 1];
+	return 0;
+    }
+
+    void update(uint32_t key, uint64_t weight);
+
+    /** @brief Merge several summaries into a list of counters.
+     *
+     * Each key monitored by any summary gets the sum of its counts, where a
+     * summary not monitoring the key contributes its floor() to both count
+     * and error, so merged counts still never underestimate.  The @a max
+     * largest are returned in @a out, largest first. */
+    static void merge(const Vector<const SpaceSaving *> &in,
+		      Vector<Counter> &out, int max);
+
+  private:
+
+    Counter *_heap;
+    uint32_t *_table;		// heap position + 1, or 0 if empty
+    uint32_t _mask;
+    uint32_t _n;
+    uint32_t _capacity;
+    uint64_t _total;
+
+    uint32_t hash(uint32_t key) const {
+	uint32_t h = key * 0x9E3779B1U;
+	return (h ^ (h >> 16)) & _mask;
+    }
+    inline void place(uint32_t pos, const Counter &c);
+    void sift_down(uint32_t pos);
+    void erase_slot(uint32_t slot);
+
+    SpaceSaving(const SpaceSaving &);
+    SpaceSaving &operator=(const SpaceSaving &);
+
+};
+
+CLICK_ENDDECLS
+#endif
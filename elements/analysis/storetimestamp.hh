@@ -44,6 +44,7 @@ class StoreTimestamp : public Element { public:
     ~StoreTimestamp();
 
     const char *class_name() const	{ return "StoreTimestamp"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1; }
     int configure(Vector<String> &, ErrorHandler *);
 
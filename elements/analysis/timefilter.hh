@@ -104,6 +104,7 @@ class TimeFilter : public Element { public:
     ~TimeFilter();
 
     const char *class_name() const	{ return "TimeFilter"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1X2; }
     const char *processing() const	{ return PROCESSING_A_AH; }
 
@@ -60,6 +60,7 @@ class TimeRange : public Element { public:
     ~TimeRange();
 
     const char *class_name() const	{ return "TimeRange"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1; }
 
     int configure(Vector<String> &, ErrorHandler *);
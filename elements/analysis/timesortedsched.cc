@@ -23,11 +23,11 @@
 #include <click/standard/scheduleinfo.hh>
 #include <click/args.hh>
 #include <click/router.hh>
-#include <click/heap.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 TimeSortedSched::TimeSortedSched()
-    : _pkt(0), _npkt(0), _input(0), _nready(0),
+    : _pkt(0), _input(0), _nready(0), _tree(0), _nleaves(0), _stale(-1),
       _notifier(Notifier::SEARCH_CONTINUE_WAKE), _buffer(1),
       _well_ordered(true)
 {
@@ -64,26 +64,66 @@ TimeSortedSched::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 TimeSortedSched::initialize(ErrorHandler *errh)
 {
-    _pkt = new packet_s[ninputs() * _buffer];
+    for (_nleaves = 1; _nleaves < ninputs(); _nleaves *= 2)
+	/* nada */;
+    _pkt = new Packet *[ninputs() * _buffer];
     _input = new input_s[ninputs()];
-    if (!_pkt || !_input)
+    _tree = new node_s[2 * _nleaves];
+    if (!_pkt || !_input || !_tree)
 	return errh->error("out of memory!");
     for (int i = 0; i < ninputs(); i++) {
 	_input[i].signal = Notifier::upstream_empty_signal(this, i, 0, &_notifier);
 	_input[i].space = _buffer;
 	_input[i].ready = i;
+	_input[i].head = _input[i].count = 0;
     }
     _nready = ninputs();
+    for (int n = 1; n < 2 * _nleaves; ++n)
+	_tree[n].input = -1;
     return 0;
 }
 
 void
 TimeSortedSched::cleanup(CleanupStage)
 {
-    for (int i = 0; i < _npkt; ++i)
-	_pkt[i].p->kill();
+    for (int i = 0; _pkt && i < ninputs(); ++i)
+	for (int j = 0; j < _input[i].count; ++j)
+	    slot(i, j)->kill();
     delete[] _pkt;
     delete[] _input;
+    delete[] _tree;
+}
+
+inline void
+TimeSortedSched::replay(int i)
+{
+    node_s *n = &_tree[_nleaves + i];
+    if (_input[i].count) {
+	n->key = slot(i, 0)->timestamp_anno();
+	n->input = i;
+    } else
+	n->input = -1;
+    // Empty inputs lose; ties go to the lower-numbered input.
+    for (int x = (_nleaves + i) / 2; x > 0; x /= 2) {
+	node_s &l = _tree[2 * x], &r = _tree[2 * x + 1];
+	if (r.input >= 0 && (l.input < 0 || r.key < l.key))
+	    _tree[x] = r;
+	else
+	    _tree[x] = l;
+    }
+}
+
+void
+TimeSortedSched::insert(int i, Packet *p)
+{
+    // Inputs are expected to be sorted, so this is usually an append.
+    input_s &is = _input[i];
+    int j = is.count;
+    for (; j > 0 && p->timestamp_anno() < slot(i, j - 1)->timestamp_anno(); --j)
+	slot(i, j) = slot(i, j - 1);
+    slot(i, j) = p;
+    ++is.count;
+    --is.space;
 }
 
 Packet*
@@ -96,37 +136,54 @@ TimeSortedSched::pull(int)
 	input_s &is = _input[i];
 	if (is.signal) {
 	    signals_on = true;
-	    while ((_pkt[_npkt].p = input(i).pull())) {
-		_pkt[_npkt].input = i;
-		++_npkt;
-		push_heap(_pkt, _pkt + _npkt, heap_less());
-		--is.space;
-		if (!is.space) {
-		    _input[rpos].ready = _input[_nready - 1].ready;
-		    --_nready;
-		    break;
-		}
+	    if (is.space == 1) {
+		Packet *p = input(i).pull();
+		if (!p)
+		    continue;
+		insert(i, p);
+	    } else {
+		PacketBatch batch;
+		input(i).pull_batch(batch, is.space);
+		if (batch.empty())
+		    continue;
+		while (Packet *p = batch.pop_front())
+		    insert(i, p);
+	    }
+	    if (!is.space) {
+		_input[rpos].ready = _input[_nready - 1].ready;
+		--_nready;
 	    }
+	    if (i != _stale)
+		replay(i);
 	}
     }
 
+    // The last emitting input was left stale, since it is most often
+    // refilled just above; one replay covers both changes.
+    if (_stale >= 0) {
+	replay(_stale);
+	_stale = -1;
+    }
+
     // then maybe emit a packet
-    _notifier.set_active(_npkt > 0 || signals_on);
-    if (_npkt > 0) {
-	Packet *p = _pkt[0].p;
+    int w = _tree[1].input;
+    _notifier.set_active(w >= 0 || signals_on);
+    if (w >= 0) {
+	input_s &is = _input[w];
+	Packet *p = slot(w, 0);
 	if (p->timestamp_anno()) {
 	    if (_last_emission && p->timestamp_anno() < _last_emission)
 		_well_ordered = false;
 	    _last_emission = p->timestamp_anno();
 	}
-	input_s &is = _input[_pkt[0].input];
+	is.head = (is.head + 1 < _buffer ? is.head + 1 : 0);
+	--is.count;
 	++is.space;
 	if (is.space == 1) {
-	    _input[_nready].ready = _pkt[0].input;
+	    _input[_nready].ready = w;
 	    ++_nready;
 	}
-	pop_heap(_pkt, _pkt + _npkt, heap_less());
-	--_npkt;
+	_stale = w;
 	return p;
     } else {
 	if (_stop && !signals_on)
@@ -29,7 +29,10 @@ packet streams did not arrive correctly sorted by timestamp, so
 TimeSortedSched emitted some packets out of order.  (But see BUFFER, below.)
 
 TimeSortedSched listens for notification from its inputs to avoid useless
-pulls, and provides notification for its output.
+pulls, and provides notification for its output.  It refills each input's
+buffer with a single batched pull, and finds the next packet with a
+tournament tree over the inputs, so each packet costs time logarithmic in the
+number of inputs.  Packets with equal timestamps are emitted in input order.
 
 Keyword arguments are:
 
@@ -85,7 +88,7 @@ class TimeSortedSched : public Element { public:
     const char *class_name() const	{ return "TimeSortedSched"; }
     const char *port_count() const	{ return "-/1"; }
     const char *processing() const	{ return PULL; }
-    const char *flags() const		{ return "S0"; }
+    const char *flags() const		{ return "S0 T"; }
     void *cast(const char *);
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
@@ -97,26 +100,28 @@ class TimeSortedSched : public Element { public:
 
   private:
 
-    struct packet_s {
-	Packet *p;
-	int input;		// for space, consider using annotation?
-    };
-    struct heap_less {
-	inline bool operator()(packet_s &a, packet_s &b) {
-	    return a.p->timestamp_anno() < b.p->timestamp_anno();
-	}
-    };
+    // Each input buffers up to _buffer packets in a ring, sorted by
+    // timestamp.  _tree is a tournament tree over the inputs' first
+    // packets: _tree[_nleaves + i] is input i, and each internal node holds
+    // the winner of its two children.  Empty inputs have node.input < 0.
     struct input_s {
 	NotifierSignal signal;
 	int space;
 	int ready;
+	int head;
+	int count;
+    };
+    struct node_s {
+	Timestamp key;
+	int input;
     };
 
-    packet_s *_pkt;
-    int _npkt;
-
+    Packet **_pkt;
     input_s *_input;
     int _nready;
+    node_s *_tree;
+    int _nleaves;
+    int _stale;
 
     Notifier _notifier;
     int _buffer;
@@ -124,6 +129,13 @@ class TimeSortedSched : public Element { public:
     bool _stop;
     bool _well_ordered;
 
+    Packet *&slot(int i, int j) const {
+	int x = _input[i].head + j;
+	return _pkt[i * _buffer + (x < _buffer ? x : x - _buffer)];
+    }
+    inline void replay(int i);
+    void insert(int i, Packet *p);
+
 };
 
 CLICK_ENDDECLS
@@ -38,6 +38,7 @@ class TimestampAccum : public Element { public:
     ~TimestampAccum();
 
     const char *class_name() const	{ return "TimestampAccum"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1; }
 
     int initialize(ErrorHandler *);
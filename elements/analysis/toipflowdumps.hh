@@ -148,6 +148,7 @@ class ToIPFlowDumps : public Element, public AggregateListener { public:
     ~ToIPFlowDumps();
 
     const char *class_name() const	{ return "ToIPFlowDumps"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return "1/0-1"; }
 
     enum { CONFIGURE_PHASE = CONFIGURE_PHASE_DEFAULT };
@@ -28,28 +28,236 @@
 #include <clicknet/tcp.h>
 #include <unistd.h>
 #include <time.h>
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+# include <signal.h>
+#endif
 CLICK_DECLS
 
+#if HAVE_USER_MULTITHREAD
+/* With THREADS, the datapath puts packets in a ring of Slots, in arrival
+   order.  Formatting threads claim queued slots in order and format them in
+   parallel.  Whichever thread finds the oldest slot finished writes out the
+   run of finished slots at the head of the ring, so records reach the file
+   in packet order.  When the ring is full, the datapath formats a packet
+   itself instead of waiting. */
+class ToIPSummaryDump::Formatter { public:
+
+    Formatter(ToIPSummaryDump *t, uint32_t nthreads, uint32_t size);
+    ~Formatter();
+
+    int start();
+    void push(Packet *p, int multipacket);
+    void sync();
+
+  private:
+
+    enum { S_FREE, S_QUEUED, S_BUSY, S_DONE };
+    struct Slot {
+	Packet *p;
+	int multipacket;
+	int state;
+	int nrecords;
+	StringAccum sa;
+	StringAccum bad_sa;
+    };
+
+    ToIPSummaryDump *_t;
+    uint32_t _nthreads;
+    uint32_t _size;
+    Slot *_slots;
+
+    // slots [_head, _claim) are being formatted or are finished;
+    // [_claim, _tail) are queued
+    uint32_t _head;
+    uint32_t _claim;
+    uint32_t _tail;
+    bool _writing;
+    bool _stop;
+
+    pthread_mutex_t _lock;
+    pthread_cond_t _work;
+    pthread_cond_t _done;
+    Vector<pthread_t> _threads;
+
+    Slot &slot(uint32_t i) {
+	return _slots[i % _size];
+    }
+    static void *thread_hook(void *);
+    void run();
+    bool format_one();
+    bool write_done();
+
+};
+
+ToIPSummaryDump::Formatter::Formatter(ToIPSummaryDump *t, uint32_t nthreads, uint32_t size)
+    : _t(t), _nthreads(nthreads), _size(size), _slots(new Slot[size]),
+      _head(0), _claim(0), _tail(0), _writing(false), _stop(false)
+{
+    for (uint32_t i = 0; i < _size; ++i) {
+	_slots[i].p = 0;
+	_slots[i].state = S_FREE;
+    }
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_work, 0);
+    pthread_cond_init(&_done, 0);
+}
+
+ToIPSummaryDump::Formatter::~Formatter()
+{
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_broadcast(&_work);
+    pthread_mutex_unlock(&_lock);
+    for (int i = 0; i < _threads.size(); ++i)
+	pthread_join(_threads[i], 0);
+    for (uint32_t i = 0; i < _size; ++i)
+	if (_slots[i].p)
+	    _slots[i].p->kill();
+    delete[] _slots;
+    pthread_cond_destroy(&_done);
+    pthread_cond_destroy(&_work);
+    pthread_mutex_destroy(&_lock);
+}
+
+int
+ToIPSummaryDump::Formatter::start()
+{
+    // leave signals to the driver's threads
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = 0;
+    while (!err && (uint32_t) _threads.size() < _nthreads) {
+	pthread_t thread;
+	if ((err = pthread_create(&thread, 0, thread_hook, this)) == 0)
+	    _threads.push_back(thread);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    return -err;
+}
+
+void *
+ToIPSummaryDump::Formatter::thread_hook(void *thunk)
+{
+    static_cast<Formatter *>(thunk)->run();
+    return 0;
+}
+
+void
+ToIPSummaryDump::Formatter::run()
+{
+    pthread_mutex_lock(&_lock);
+    while (1) {
+	while (_claim == _tail && !_stop)
+	    pthread_cond_wait(&_work, &_lock);
+	if (_claim == _tail)
+	    break;
+	format_one();
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+// Called with _lock held.  Formats the oldest queued slot, if any.
+bool
+ToIPSummaryDump::Formatter::format_one()
+{
+    if (_claim == _tail)
+	return false;
+    Slot &s = slot(_claim++);
+    s.state = S_BUSY;
+    pthread_mutex_unlock(&_lock);
+
+    s.sa.clear();
+    s.nrecords = _t->write_packet(s.p, s.multipacket, s.sa, s.bad_sa);
+    s.p->kill();
+    s.p = 0;
+
+    pthread_mutex_lock(&_lock);
+    s.state = S_DONE;
+    write_done();
+    return true;
+}
+
+// Called with _lock held.  Writes out the finished slots at the head of the
+// ring, unless another thread is already doing so.
+bool
+ToIPSummaryDump::Formatter::write_done()
+{
+    if (_writing)
+	return false;
+    bool wrote = false;
+    _writing = true;
+    while (_head != _claim && slot(_head).state == S_DONE) {
+	Slot &s = slot(_head);
+	pthread_mutex_unlock(&_lock);
+	ignore_result(fwrite(s.sa.data(), 1, s.sa.length(), _t->_f));
+	pthread_mutex_lock(&_lock);
+	_t->_output_count += s.nrecords;
+	s.state = S_FREE;
+	++_head;
+	wrote = true;
+    }
+    _writing = false;
+    if (wrote)
+	pthread_cond_broadcast(&_done);
+    return wrote;
+}
+
+void
+ToIPSummaryDump::Formatter::push(Packet *p, int multipacket)
+{
+    pthread_mutex_lock(&_lock);
+    while (_tail - _head == _size)
+	if (!format_one() && !write_done())
+	    pthread_cond_wait(&_done, &_lock);
+    Slot &s = slot(_tail++);
+    s.p = p;
+    s.multipacket = multipacket;
+    s.state = S_QUEUED;
+    pthread_cond_signal(&_work);
+    pthread_mutex_unlock(&_lock);
+}
+
+void
+ToIPSummaryDump::Formatter::sync()
+{
+    pthread_mutex_lock(&_lock);
+    while (_head != _tail)
+	if (!format_one() && !write_done())
+	    pthread_cond_wait(&_done, &_lock);
+    pthread_mutex_unlock(&_lock);
+}
+#endif
+
 ToIPSummaryDump::ToIPSummaryDump()
-    : _f(0), _task(this)
+    : _f(0), _task(this), _columns(0)
+#if HAVE_USER_MULTITHREAD
+    , _formatter(0)
+#endif
 {
 }
 
 ToIPSummaryDump::~ToIPSummaryDump()
 {
+    delete[] _columns;
 }
 
 int
 ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     String save = "timestamp ip_src";
+    _block_size = 4096;
     bool verbose = false;
     bool bad_packets = false;
     bool careful_trunc = true;
     bool multipacket = false;
     bool binary = false;
+    bool columnar = false;
     bool header = true;
     bool extra_length = true;
+    _nthreads = 0;
+    _queue_size = 1024;
 
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _filename)
@@ -63,8 +271,25 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CAREFUL_TRUNC", careful_trunc)
 	.read("EXTRA_LENGTH", extra_length)
 	.read("BINARY", binary)
+	.read("COLUMNAR", columnar)
+	.read("BLOCK", _block_size)
+	.read("THREADS", _nthreads)
+	.read("QUEUE", _queue_size)
 	.complete() < 0)
 	return -1;
+    if (columnar)
+	binary = true;
+    if (_block_size == 0)
+	_block_size = 1;
+    if (_queue_size == 0)
+	_queue_size = 1;
+#if HAVE_USER_MULTITHREAD
+    if (_nthreads && columnar)
+	errh->error("THREADS cannot be used with COLUMNAR");
+#else
+    if (_nthreads)
+	errh->error("THREADS requires multithreading support");
+#endif
 
     Vector<String> v;
     cp_spacevec(save, v);
@@ -91,7 +316,7 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
       found_prepare:
 	int s = f->binary_size();
 	if ((s < 0 || !f->outb) && binary)
-	    errh->error("cannot use CONTENTS %s with BINARY", word.c_str());
+	    errh->error("cannot use CONTENTS %s with %s", word.c_str(), columnar ? "COLUMNAR" : "BINARY");
 	_binary_size += s;
 
 	// remove _multipacket if packet count specified
@@ -106,6 +331,7 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _careful_trunc = careful_trunc;
     _multipacket = multipacket;
     _binary = binary;
+    _columnar = columnar;
     _header = header;
     _extra_length = extra_length;
 
@@ -161,19 +387,50 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     sa << '\n';
 
     // binary marker
-    if (_binary)
+    if (_columnar)
+	sa << "!columnar\n";
+    else if (_binary)
 	sa << "!binary\n";
 
+    // columnar state; the first timestamp column bounds each block
+    if (_columnar) {
+	_columns = new StringAccum[_fields.size()];
+	_column_prev.assign(_fields.size(), 0);
+	_time_column = -1;
+	for (int i = 0; i < _fields.size() && _time_column < 0; i++)
+	    if (strcmp(_fields[i]->name, "timestamp") == 0
+		|| strcmp(_fields[i]->name, "ntimestamp") == 0)
+		_time_column = i;
+	_block_count = 0;
+    }
+
     // print output
     if (_header)
 	ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
 
+#if HAVE_USER_MULTITHREAD
+    if (_nthreads) {
+	_formatter = new Formatter(this, _nthreads, _queue_size);
+	if (int err = _formatter->start())
+	    return errh->error("cannot start formatting threads: %s", strerror(-err));
+    }
+#endif
+
     return 0;
 }
 
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
+#if HAVE_USER_MULTITHREAD
+    if (_formatter) {
+	_formatter->sync();
+	delete _formatter;
+	_formatter = 0;
+    }
+#endif
+    if (_f && _columnar)
+	flush_block();
     if (_f && _f != stdout)
 	fclose(_f);
     _f = 0;
@@ -188,13 +445,15 @@ ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
 	_prepare_fields[i]->prepare(d, _prepare_fields[i]);
 
     if (_binary) {
+	int start = sa.length();
 	sa.extend(4);
 	for (int i = 0; i < _fields.size(); i++) {
 	    d.clear_values();
 	    bool ok = _fields[i]->extract(d, _fields[i]);
 	    _fields[i]->outb(d, ok, _fields[i]);
 	}
-	*(reinterpret_cast<uint32_t*>(sa.data())) = htonl(sa.length());
+	uint32_t length = htonl(sa.length() - start);
+	memcpy(sa.data() + start, &length, 4);
     } else {
 	for (int i = 0; i < _fields.size(); i++) {
 	    if (i)
@@ -211,8 +470,96 @@ ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
     return true;
 }
 
+static void
+append_varint(StringAccum &sa, uint64_t v)
+{
+    char *x = sa.extend(10);
+    if (!x)
+	return;
+    int n = 0;
+    while (v >= 0x80) {
+	x[n++] = (v & 0x7F) | 0x80;
+	v >>= 7;
+    }
+    x[n++] = v;
+    sa.adjust_length(n - 10);
+}
+
 void
-ToIPSummaryDump::write_packet(Packet* p, int multipacket)
+ToIPSummaryDump::append_columns(Packet *p, StringAccum *bad_sa)
+{
+    IPSummaryDump::PacketDesc d(this, p, 0, bad_sa, _careful_trunc, _extra_length);
+
+    for (int i = 0; i < _prepare_fields.size(); i++)
+	_prepare_fields[i]->prepare(d, _prepare_fields[i]);
+
+    for (int i = 0; i < _fields.size(); i++) {
+	d.clear_values();
+	d.sa = &_columns[i];
+	bool ok = _fields[i]->extract(d, _fields[i]);
+	if (IPSummaryDump::column_timestamp(_fields[i]->name)) {
+	    int64_t ts = (ok ? (int64_t) d.u32[0] * 1000000000 + d.u32[1] : 0);
+	    int64_t delta = ts - _column_prev[i];
+	    append_varint(_columns[i], ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+	    _column_prev[i] = ts;
+	    if (i == _time_column) {
+		Timestamp t = Timestamp::make_nsec(d.u32[0], d.u32[1]);
+		if (_block_count == 0 || t < _block_first)
+		    _block_first = t;
+		if (_block_count == 0 || t > _block_last)
+		    _block_last = t;
+	    }
+	} else
+	    _fields[i]->outb(d, ok, _fields[i]);
+    }
+
+    if (++_block_count >= _block_size)
+	flush_block();
+}
+
+void
+ToIPSummaryDump::flush_block()
+{
+    if (!_block_count)
+	return;
+
+    StringAccum sa;
+    uint32_t *x = reinterpret_cast<uint32_t *>(sa.extend(IPSummaryDump::BLOCK_HEADER_SIZE));
+    if (!x)
+	return;
+    x[1] = htonl(_block_count);
+    x[2] = htonl(_time_column >= 0 ? IPSummaryDump::BLOCK_HAS_TIMES : 0);
+    x[3] = htonl(_fields.size());
+    x[4] = htonl(_block_first.sec());
+    x[5] = htonl(_block_first.nsec());
+    x[6] = htonl(_block_last.sec());
+    x[7] = htonl(_block_last.nsec());
+    uint32_t length = 0;
+    for (int i = 0; i < _fields.size(); i++) {
+	const char *name = _fields[i]->name;
+	uint32_t column_length = htonl(_columns[i].length());
+	sa << (char) strlen(name) << name
+	   << (char) (IPSummaryDump::column_timestamp(name) ? IPSummaryDump::COLUMN_TIMESTAMP : IPSummaryDump::COLUMN_RAW);
+	sa.append(reinterpret_cast<const char *>(&column_length), 4);
+	length += _columns[i].length();
+    }
+    length += sa.length();
+    *(reinterpret_cast<uint32_t *>(sa.data())) = htonl(length);
+
+    ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
+    for (int i = 0; i < _fields.size(); i++) {
+	ignore_result(fwrite(_columns[i].data(), 1, _columns[i].length(), _f));
+	_columns[i].clear();
+	_column_prev[i] = 0;
+    }
+    _block_count = 0;
+}
+
+// Appends p's records to sa, each preceded by its !bad line, if any, and
+// returns the number of records.  Except with COLUMNAR, this touches no
+// element state, so formatting threads may call it concurrently.
+int
+ToIPSummaryDump::write_packet(Packet* p, int multipacket, StringAccum &sa, StringAccum &bad_sa)
 {
     if (multipacket > 0 && EXTRA_PACKETS_ANNO(p) > 0) {
 	uint32_t count = 1 + EXTRA_PACKETS_ANNO(p);
@@ -232,36 +579,80 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 	    timestamp_delta = Timestamp();
 
 	SET_EXTRA_PACKETS_ANNO(p, 0);
+	int n = 0;
 	for (uint32_t i = count; i > 0; i--) {
 	    uint32_t l = total_len / i;
 	    SET_EXTRA_LENGTH_ANNO(p, l - len);
 	    total_len -= l;
-	    write_packet(p, -1);
+	    n += write_packet(p, -1, sa, bad_sa);
 	    if (i == 1)
 		p->timestamp_anno() = end_timestamp;
 	    else
 		p->timestamp_anno() += timestamp_delta;
 	}
+	return n;
+
+    } else if (_columnar) {
+	bad_sa.clear();
+	if (_bad_packets) {
+	    // the !bad line must precede its packet's block
+	    sa.clear();
+	    summary(p, sa, &bad_sa);
+	    if (bad_sa)
+		write_line(bad_sa.take_string());
+	}
+	append_columns(p, 0);
+	return 1;
 
     } else {
-	_sa.clear();
-	_bad_sa.clear();
-
-	summary(p, _sa, (_bad_packets ? &_bad_sa : 0));
-
-	if (_bad_packets && _bad_sa)
-	    write_line(_bad_sa.take_string());
-	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
+	bad_sa.clear();
+	int start = sa.length();
+	summary(p, sa, (_bad_packets ? &bad_sa : 0));
+
+	if (_bad_packets && bad_sa) {
+	    // move the !bad line in front of its record
+	    String record(sa.data() + start, sa.length() - start);
+	    sa.adjust_length(start - sa.length());
+	    if (_binary) {
+		uint32_t marker = htonl(bad_sa.length() | 0x80000000U);
+		sa.append(reinterpret_cast<const char *>(&marker), 4);
+	    }
+	    sa << bad_sa << record;
+	}
+	return 1;
+    }
+}
 
-	_output_count++;
+void
+ToIPSummaryDump::write_packet(Packet* p, int multipacket)
+{
+#if HAVE_USER_MULTITHREAD
+    if (_formatter) {
+	// the formatter kills what it is given, so give it a clone if the
+	// packet continues downstream
+	if (Packet *q = (noutputs() ? p->clone() : p)) {
+	    _formatter->push(q, multipacket);
+	    return;
+	}
+	_formatter->sync();
     }
+#endif
+    _sa.clear();
+    _output_count += write_packet(p, multipacket, _sa, _bad_sa);
+    if (!_columnar)
+	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
 }
 
 void
 ToIPSummaryDump::push(int, Packet *p)
 {
-    if (_active)
+    if (_active) {
 	write_packet(p, _multipacket);
+#if HAVE_USER_MULTITHREAD
+	if (_formatter && !noutputs())
+	    return;
+#endif
+    }
     checked_output_push(0, p);
 }
 
@@ -272,6 +663,9 @@ ToIPSummaryDump::run_task(Task *)
 	return false;
     if (Packet *p = input(0).pull()) {
 	write_packet(p, _multipacket);
+#if HAVE_USER_MULTITHREAD
+	if (!_formatter || noutputs())
+#endif
 	checked_output_push(0, p);
 	_task.fast_reschedule();
 	return true;
@@ -282,11 +676,23 @@ ToIPSummaryDump::run_task(Task *)
 	return false;
 }
 
+void
+ToIPSummaryDump::sync()
+{
+#if HAVE_USER_MULTITHREAD
+    if (_formatter)
+	_formatter->sync();
+#endif
+}
+
 void
 ToIPSummaryDump::write_line(const String& s)
 {
     if (s.length()) {
 	assert(s.back() == '\n');
+	sync();
+	if (_columnar)
+	    flush_block();
 	if (_binary) {
 	    uint32_t marker = htonl(s.length() | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
@@ -300,6 +706,9 @@ ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
 	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	sync();
+	if (_columnar)
+	    flush_block();
 	if (_binary) {
 	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
 	    ignore_result(fwrite(&marker, 4, 1, _f));
@@ -315,6 +724,9 @@ int
 ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
+    tod->sync();
+    if (tod->_f && tod->_columnar)
+	tod->flush_block();
     if (tod->_f)
 	fflush(tod->_f);
     return 0;
@@ -0,0 +1,393 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * dnscache.{cc,hh} -- answers DNS queries from cached responses
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "dnscache.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+DNSCache::DNSCache()
+    : _capacity(65536), _maxttl(3600), _hits(0), _misses(0), _learned(0),
+      _wheel_cursor(0), _timer(this)
+{
+    for (int i = 0; i < wheel_size; i++)
+	_wheel[i] = 0;
+}
+
+DNSCache::~DNSCache()
+{
+}
+
+int
+DNSCache::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("CAPACITY", _capacity)
+	.read("MAXTTL", SecondsArg(), _maxttl)
+	.complete() < 0)
+	return -1;
+    if (_maxttl == 0)
+	return errh->error("MAXTTL must be positive");
+    return 0;
+}
+
+int
+DNSCache::initialize(ErrorHandler *)
+{
+    _timer.initialize(this);
+    _wheel_cursor = click_jiffies() / CLICK_HZ;
+    _timer.schedule_at(Timestamp::make_jiffies((click_jiffies_t) ((_wheel_cursor + 1) * CLICK_HZ)));
+    return 0;
+}
+
+void
+DNSCache::cleanup(CleanupStage)
+{
+    clear();
+}
+
+// Copy the question at offset 12 of @a msg to @a key, with the name
+// lowercased.  Returns the key's length, or -1 if the question is malformed
+// or uses compression.
+int
+DNSCache::parse_question(const unsigned char *msg, int len, unsigned char *key)
+{
+    int off = 12, k = 0;
+    while (1) {
+	if (off >= len)
+	    return -1;
+	int l = msg[off];
+	if (l > 63 || k + l + 1 > 255 || off + l + 1 > len)
+	    return -1;
+	key[k++] = l;
+	off++;
+	for (int i = 0; i < l; ++i, ++off) {
+	    unsigned char c = msg[off];
+	    key[k++] = (c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+	}
+	if (l == 0)
+	    break;
+    }
+    if (off + 4 > len)
+	return -1;
+    memcpy(key + k, msg + off, 4);
+    return k + 4;
+}
+
+// Returns the offset just past the name at @a off, or -1.
+int
+DNSCache::skip_name(const unsigned char *msg, int len, int off)
+{
+    while (off < len) {
+	int l = msg[off];
+	if ((l & 0xC0) == 0xC0)
+	    return off + 2 <= len ? off + 2 : -1;
+	else if (l > 63)
+	    return -1;
+	off += l + 1;
+	if (l == 0)
+	    return off;
+    }
+    return -1;
+}
+
+void
+DNSCache::wheel_link(Entry *e)
+{
+    click_jiffies_t slot = e->_expires / CLICK_HZ;
+    if (click_jiffies_less(slot, _wheel_cursor))
+	slot = _wheel_cursor;
+    Entry **head = &_wheel[slot & (wheel_size - 1)];
+    e->_pprev = head;
+    e->_next = *head;
+    if (*head)
+	(*head)->_pprev = &e->_next;
+    *head = e;
+}
+
+void
+DNSCache::remove(Entry *e)
+{
+    *e->_pprev = e->_next;
+    if (e->_next)
+	e->_next->_pprev = e->_pprev;
+    _map.erase(e->_key);
+    delete e;
+}
+
+void
+DNSCache::clear()
+{
+    for (Map::iterator it = _map.begin(); it != _map.end(); ++it)
+	delete it.value();
+    _map.clear();
+    for (int i = 0; i < wheel_size; i++)
+	_wheel[i] = 0;
+}
+
+void
+DNSCache::run_timer(Timer *)
+{
+    click_jiffies_t now = click_jiffies();
+    click_jiffies_t now_slot = now / CLICK_HZ;
+
+    for (int n = 0; click_jiffies_less(_wheel_cursor, now_slot) && n < wheel_size; n++) {
+	Entry *e = _wheel[_wheel_cursor & (wheel_size - 1)];
+	_wheel[_wheel_cursor & (wheel_size - 1)] = 0;
+	_wheel_cursor++;
+	while (e) {
+	    Entry *next = e->_next;
+	    if (!click_jiffies_less(now, e->_expires)) {
+		_map.erase(e->_key);
+		delete e;
+	    } else
+		wheel_link(e);
+	    e = next;
+	}
+    }
+    _wheel_cursor = now_slot;
+    _timer.schedule_at(Timestamp::make_jiffies((click_jiffies_t) ((now_slot + 1) * CLICK_HZ)));
+}
+
+void
+DNSCache::learn(Packet *p)
+{
+    const click_ip *iph = p->ip_header();
+    if (!p->has_network_header() || iph->ip_p != IP_PROTO_UDP
+	|| IP_ISFRAG(iph) || p->transport_length() < (int) sizeof(click_udp))
+	return;
+    const click_udp *udph = p->udp_header();
+    const unsigned char *msg = p->transport_header() + sizeof(click_udp);
+    // trailing link-layer padding is not part of the message
+    int len = ntohs(udph->uh_ulen) - (int) sizeof(click_udp);
+    if (len > p->end_data() - msg)
+	len = p->end_data() - msg;
+    // a successful, untruncated response to a standard query
+    if (len < 12 || (msg[2] & 0xFA) != 0x80 || (msg[3] & 0x0F) != 0
+	|| msg[4] != 0 || msg[5] != 1 || (msg[6] == 0 && msg[7] == 0))
+	return;
+
+    unsigned char key[max_key];
+    int klen = parse_question(msg, len, key);
+    if (klen < 0)
+	return;
+
+    Vector<uint16_t> ttl_off;
+    Vector<uint32_t> ttl;
+    uint32_t min_ttl = _maxttl;
+    int nrr = (msg[6] << 8) + msg[7] + (msg[8] << 8) + msg[9]
+	+ (msg[10] << 8) + msg[11];
+    int off = 12 + klen;
+    for (int i = 0; i < nrr; ++i) {
+	off = skip_name(msg, len, off);
+	if (off < 0 || off + 10 > len)
+	    return;
+	if (msg[off] != 0 || msg[off + 1] != 41) { // OPT has no TTL
+	    uint32_t t = (msg[off + 4] << 24) | (msg[off + 5] << 16)
+		| (msg[off + 6] << 8) | msg[off + 7];
+	    if (t & 0x80000000U)
+		t = 0;
+	    t = (t < _maxttl ? t : _maxttl);
+	    ttl_off.push_back(off + 4);
+	    ttl.push_back(t);
+	    min_ttl = (t < min_ttl ? t : min_ttl);
+	}
+	off += 10 + (msg[off + 8] << 8) + msg[off + 9];
+	if (off > len)
+	    return;
+    }
+    if (min_ttl == 0 || ttl.size() == 0)
+	return;
+
+    String k((const char *) key, klen);
+    if (Entry *old = _map.get(k))
+	remove(old);
+    else if ((uint32_t) _map.size() >= _capacity)
+	return;
+
+    Entry *e = new Entry;
+    e->_key = k;
+    e->_msg = String((const char *) msg, len);
+    unsigned char *x = (unsigned char *) e->_msg.mutable_data();
+    x[0] = x[1] = 0;
+    e->_qname_len = klen - 4;
+    memset(x + 12, 0, e->_qname_len);
+    for (int i = 0; i < ttl_off.size(); ++i)
+	memset(x + ttl_off[i], 0, 4);
+    e->_ttl_off.swap(ttl_off);
+    e->_ttl.swap(ttl);
+    e->_sum = ~click_in_cksum(x, len) & 0xFFFF;
+    e->_born = click_jiffies();
+    e->_expires = e->_born + min_ttl * CLICK_HZ;
+    _map.set(e->_key, e);
+    wheel_link(e);
+    _learned++;
+}
+
+Packet *
+DNSCache::answer(Packet *p)
+{
+    const click_ip *iph = p->ip_header();
+    if (!p->has_network_header() || iph->ip_p != IP_PROTO_UDP
+	|| IP_ISFRAG(iph) || p->transport_length() < (int) sizeof(click_udp))
+	return 0;
+    const click_udp *udph = p->udp_header();
+    const unsigned char *msg = p->transport_header() + sizeof(click_udp);
+    int len = ntohs(udph->uh_ulen) - (int) sizeof(click_udp);
+    if (len > p->end_data() - msg)
+	len = p->end_data() - msg;
+    // a standard query with one question and at most an OPT record
+    if (len < 12 || (msg[2] & 0xF8) != 0 || msg[4] != 0 || msg[5] != 1
+	|| msg[6] || msg[7] || msg[8] || msg[9] || msg[10] || msg[11] > 1)
+	return 0;
+
+    unsigned char key[max_key];
+    int klen = parse_question(msg, len, key);
+    if (klen < 0)
+	return 0;
+    int max_len = 512;
+    if (msg[11]) {
+	int off = 12 + klen;
+	if (off + 5 <= len && msg[off] == 0 && msg[off + 1] == 0
+	    && msg[off + 2] == 41) {
+	    int size = (msg[off + 3] << 8) + msg[off + 4];
+	    max_len = (size > max_len ? size : max_len);
+	}
+    }
+
+    Entry *e = _map.get(String::make_stable((const char *) key, klen));
+    click_jiffies_t now = click_jiffies();
+    if (!e || !click_jiffies_less(now, e->_expires)
+	|| e->_msg.length() > max_len)
+	return 0;
+
+    int mlen = e->_msg.length();
+    WritablePacket *q = Packet::make(Packet::default_headroom, 0,
+				     sizeof(click_ip) + sizeof(click_udp) + mlen, 0);
+    if (!q)
+	return 0;
+    click_ip *ip = reinterpret_cast<click_ip *>(q->data());
+    click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
+    unsigned char *m = reinterpret_cast<unsigned char *>(udp + 1);
+
+    // patch the query's ID and question name, and aged TTLs, into the
+    // cached response, summing each patched field
+    memcpy(m, e->_msg.data(), mlen);
+    memcpy(m, msg, 2);
+    memcpy(m + 12, msg + 12, e->_qname_len);
+    uint32_t sum = e->_sum;
+    uint16_t w;
+    memcpy(&w, m, 2);
+    sum += w;
+    sum += ~click_in_cksum(m + 12, e->_qname_len) & 0xFFFF;
+    uint32_t age = (now - e->_born) / CLICK_HZ;
+    for (int i = 0; i < e->_ttl.size(); ++i) {
+	int o = e->_ttl_off[i];
+	uint32_t t = htonl(e->_ttl[i] > age ? e->_ttl[i] - age : 0);
+	// a TTL at an odd offset straddles three halfwords
+	unsigned char tb[6] = {0, 0, 0, 0, 0, 0};
+	memcpy(tb + (o & 1), &t, 4);
+	memcpy(m + o, &t, 4);
+	uint16_t tw[3];
+	memcpy(tw, tb, 6);
+	sum += tw[0] + tw[1] + tw[2];
+    }
+
+    memset(ip, 0, sizeof(click_ip));
+    ip->ip_v = 4;
+    ip->ip_hl = sizeof(click_ip) >> 2;
+    ip->ip_len = htons(q->length());
+    ip->ip_ttl = 64;
+    ip->ip_p = IP_PROTO_UDP;
+    ip->ip_src = iph->ip_dst;
+    ip->ip_dst = iph->ip_src;
+    ip->ip_sum = click_in_cksum((unsigned char *) ip, sizeof(click_ip));
+
+    udp->uh_sport = udph->uh_dport;
+    udp->uh_dport = udph->uh_sport;
+    udp->uh_ulen = htons(sizeof(click_udp) + mlen);
+    udp->uh_sum = 0;
+    sum += udp->uh_sport + udp->uh_dport + udp->uh_ulen;
+    while (sum >> 16)
+	sum = (sum & 0xFFFF) + (sum >> 16);
+    udp->uh_sum = click_in_cksum_pseudohdr(~sum & 0xFFFF, ip, sizeof(click_udp) + mlen);
+    if (!udp->uh_sum)
+	udp->uh_sum = 0xFFFF;
+
+    q->set_ip_header(ip, sizeof(click_ip));
+    q->set_dst_ip_anno(ip->ip_dst);
+    p->kill();
+    return q;
+}
+
+void
+DNSCache::push(int port, Packet *p)
+{
+    if (port == 0) {
+	if (Packet *q = answer(p)) {
+	    _hits++;
+	    output(0).push(q);
+	} else {
+	    _misses++;
+	    checked_output_push(1, p);
+	}
+    } else {
+	learn(p);
+	output(0).push(p);
+    }
+}
+
+enum { h_count, h_hits, h_misses, h_learned, h_clear };
+
+String
+DNSCache::read_handler(Element *e, void *thunk)
+{
+    DNSCache *dc = static_cast<DNSCache *>(e);
+    switch ((uintptr_t) thunk) {
+    case h_count:
+	return String(dc->_map.size());
+    case h_hits:
+	return String(dc->_hits);
+    case h_misses:
+	return String(dc->_misses);
+    case h_learned:
+	return String(dc->_learned);
+    default:
+	return String();
+    }
+}
+
+int
+DNSCache::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    DNSCache *dc = static_cast<DNSCache *>(e);
+    dc->clear();
+    return 0;
+}
+
+void
+DNSCache::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("hits", read_handler, h_hits);
+    add_read_handler("misses", read_handler, h_misses);
+    add_read_handler("learned", read_handler, h_learned);
+    add_write_handler("clear", write_handler, h_clear, Handler::h_button);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(DNSCache)
@@ -0,0 +1,171 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_DNSCACHE_HH
+#define CLICK_DNSCACHE_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/timer.hh>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+/*
+=c
+
+DNSCache([I<keywords> CAPACITY, MAXTTL])
+
+=s udp
+
+answers DNS queries from a cache of upstream responses
+
+=d
+
+DNSCache answers DNS queries directly in the datapath, using responses it
+has seen from an upstream resolver.
+
+Input 0 takes DNS queries, and input 1 takes the resolver's responses; both
+are IP/UDP packets with their IP header annotations set, as by
+CheckIPHeader.  Output 0 emits answers for clients, and output 1 emits
+queries that must go upstream.
+
+A query whose question is cached is answered on output 0 with a new packet,
+addressed back to the query's source, and the query is freed.  The cached
+response gets the query's ID and question name (so the name's case matches
+the query) and each TTL is reduced by the response's age.  The UDP checksum
+is finished from a sum of the cached response taken when it was learned,
+so only the patched fields are summed per answer.  Any other query, including
+one DNSCache cannot parse or whose client cannot accept the cached
+response's size, leaves unchanged on output 1.
+
+A response on input 1 is learned and then leaves unchanged on output 0.
+Only successful, untruncated responses to standard queries with one question
+and at least one answer are learned.  A response stays cached for its
+smallest TTL, capped at MAXTTL; a timing wheel removes it after that.  A new
+response for a question replaces the old one.
+
+Questions are compared without regard to case, and EDNS OPT records in
+queries are only read for the client's UDP payload size.  DNSCache does no
+recursion, negative caching, or validation of the responses it learns.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned integer.  The most responses cached at once.  Responses that
+arrive while the cache is full are not learned.  Default is 65536.
+
+=item MAXTTL
+
+Time in seconds.  The longest a response stays cached.  Default is 3600.
+
+=back
+
+=h count read-only
+
+Returns the number of cached responses.
+
+=h hits read-only
+
+Returns the number of queries answered from the cache.
+
+=h misses read-only
+
+Returns the number of queries sent to output 1.
+
+=h learned read-only
+
+Returns the number of responses learned.
+
+=h clear write-only
+
+Removes every cached response.
+
+=e
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader
+    -> c :: IPClassifier(udp dst port 53, udp src port 53, -);
+  c[0] -> [0] dns :: DNSCache;
+  c[1] -> [1] dns;
+  dns[0] -> ... // to clients
+  dns[1] -> ... // to the resolver
+
+=n
+
+DNSCache is not thread safe; run both of its inputs in one thread.
+
+=a
+
+UDPIPEncap, IPRewriter */
+
+class DNSCache : public Element { public:
+
+    DNSCache();
+    ~DNSCache();
+
+    const char *class_name() const	{ return "DNSCache"; }
+    const char *port_count() const	{ return "2/2"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void run_timer(Timer *timer);
+
+  private:
+
+    // A cached response.  The stored message has its ID, question name,
+    // and TTLs zeroed; _sum is its 16-bit one's-complement sum, so an
+    // answer's checksum needs only the values patched into those fields.
+    struct Entry {
+	String _key;		// lowercased question name, type, and class
+	String _msg;
+	Vector<uint16_t> _ttl_off;
+	Vector<uint32_t> _ttl;	// original TTLs, host order
+	uint32_t _sum;
+	int _qname_len;
+	click_jiffies_t _born;
+	click_jiffies_t _expires;
+	Entry **_pprev;		// wheel slot links
+	Entry *_next;
+    };
+
+    typedef HashTable<String, Entry *> Map;
+    Map _map;
+    uint32_t _capacity;
+    uint32_t _maxttl;
+
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _learned;
+
+    // Entries expire through a hashed timing wheel with one-second slots.
+    // An entry sits in the slot of its deadline; when that slot passes, it
+    // expires, or moves on if its deadline is more than a lap away.
+    enum { wheel_order = 8, wheel_size = 1 << wheel_order };
+    Entry *_wheel[wheel_size];
+    click_jiffies_t _wheel_cursor; // slot number; earlier slots have passed
+    Timer _timer;
+
+    enum { max_key = 255 + 4 };
+
+    static int parse_question(const unsigned char *msg, int len, unsigned char *key);
+    static int skip_name(const unsigned char *msg, int len, int off);
+    Packet *answer(Packet *p);
+    void learn(Packet *p);
+    void wheel_link(Entry *e);
+    void remove(Entry *e);
+    void clear();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
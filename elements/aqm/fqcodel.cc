@@ -0,0 +1,378 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fqcodel.{cc,hh} -- element implements FlowQueue-CoDel fair queueing
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fqcodel.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/integers.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+// Counts the bytes that a packet from FromIPSummaryDump and similar sources
+// stands for, as LinkUnqueue does.
+static inline uint32_t
+packet_length(Packet *p)
+{
+    return p->length() + EXTRA_LENGTH_ANNO(p);
+}
+
+FQCoDel::FQCoDel()
+    : _flows(0)
+{
+}
+
+FQCoDel::~FQCoDel()
+{
+}
+
+void *
+FQCoDel::cast(const char *n)
+{
+    if (strcmp(n, "FQCoDel") == 0)
+	return (FQCoDel *)this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+int
+FQCoDel::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _nflows = 1024;
+    _quantum = 1514;
+    _capacity = 10240;
+    _memory = 32 << 20;
+    _target = Timestamp::make_msec(5);
+    _interval = Timestamp::make_msec(100);
+    if (Args(conf, this, errh)
+	.read("FLOWS", _nflows)
+	.read("QUANTUM", _quantum)
+	.read("CAPACITY", _capacity)
+	.read("MEMORY", _memory)
+	.read("TARGET", _target)
+	.read("INTERVAL", _interval)
+	.complete() < 0)
+	return -1;
+    if (_nflows < 1 || _nflows > 0x1000000)
+	return errh->error("FLOWS out of range");
+    if (_quantum < 1)
+	return errh->error("QUANTUM must be positive");
+    if (_capacity < 1 || _memory < 1)
+	return errh->error("CAPACITY and MEMORY must be positive");
+    if (!_interval)
+	return errh->error("INTERVAL must be positive");
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+int
+FQCoDel::initialize(ErrorHandler *errh)
+{
+    if (!(_flows = new Flow[_nflows]))
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < _nflows; ++i) {
+	Flow &f = _flows[i];
+	f.head = f.tail = 0;
+	f.bytes = 0;
+	f.deficit = 0;
+	f.next = 0;
+	f.list = list_none;
+	f.dropping = false;
+	f.count = f.lastcount = 0;
+    }
+    _new.head = _new.tail = _old.head = _old.tail = 0;
+    _perturb = click_random();
+    _length = _bytes = _active_flows = 0;
+    _drops = _overlimit_drops = _new_flow_count = 0;
+    return 0;
+}
+
+void
+FQCoDel::cleanup(CleanupStage)
+{
+    if (_flows)
+	for (uint32_t i = 0; i < _nflows; ++i)
+	    while (Packet *p = _flows[i].head) {
+		_flows[i].head = p->next();
+		p->set_next(0);
+		p->kill();
+	    }
+    delete[] _flows;
+    _flows = 0;
+}
+
+inline uint32_t
+FQCoDel::classify(Packet *p) const
+{
+    if (!p->has_network_header())
+	return 0;
+    const click_ip *iph = p->ip_header();
+    uint32_t ports = 0;
+    if ((iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	&& !IP_ISFRAG(iph) && p->transport_length() >= 4)
+	ports = *reinterpret_cast<const uint32_t *>(p->transport_header());
+    uint32_t h = (iph->ip_src.s_addr ^ _perturb) * 0x9E3779B1U;
+    h ^= iph->ip_dst.s_addr + 0x7F4A7C15U + (h << 6) + (h >> 2);
+    h ^= ports + iph->ip_p + (h << 6) + (h >> 2);
+    h *= 0x85EBCA6BU;
+    h ^= h >> 16;
+    // map h into [0, _nflows) without a division
+    return ((uint64_t) h * _nflows) >> 32;
+}
+
+inline void
+FQCoDel::list_push_back(FlowList &l, Flow *f, int which)
+{
+    f->next = 0;
+    f->list = which;
+    if (l.tail)
+	l.tail->next = f;
+    else
+	l.head = f;
+    l.tail = f;
+}
+
+inline FQCoDel::Flow *
+FQCoDel::list_pop_front(FlowList &l)
+{
+    Flow *f = l.head;
+    if ((l.head = f->next) == 0)
+	l.tail = 0;
+    f->next = 0;
+    f->list = list_none;
+    return f;
+}
+
+void
+FQCoDel::drop(Packet *p)
+{
+    checked_output_push(1, p);
+}
+
+void
+FQCoDel::push(int, Packet *p)
+{
+    Flow *f = &_flows[classify(p)];
+    p->set_timestamp_anno(Timestamp::now_fast());
+    p->set_next(0);
+    if (f->tail)
+	f->tail->set_next(p);
+    else {
+	f->head = p;
+	++_active_flows;
+    }
+    f->tail = p;
+    f->bytes += packet_length(p);
+    ++_length;
+    _bytes += packet_length(p);
+
+    if (f->list == list_none) {
+	f->deficit = _quantum;
+	list_push_back(_new, f, list_new);
+	++_new_flow_count;
+    }
+
+    if (_length > _capacity || _bytes > _memory)
+	drop_from_fattest();
+    _empty_note.wake();
+}
+
+// Drops up to half of the largest flow queue's bytes from its head.
+void
+FQCoDel::drop_from_fattest()
+{
+    Flow *fat = &_flows[0];
+    for (Flow *f = _flows + 1; f != _flows + _nflows; ++f)
+	if (f->bytes > fat->bytes)
+	    fat = f;
+    uint32_t threshold = fat->bytes / 2;
+    do {
+	Packet *p = flow_dequeue(fat);
+	++_overlimit_drops;
+	drop(p);
+    } while (fat->bytes > threshold);
+}
+
+inline Packet *
+FQCoDel::flow_dequeue(Flow *f)
+{
+    Packet *p = f->head;
+    if (p) {
+	if ((f->head = p->next()) == 0) {
+	    f->tail = 0;
+	    --_active_flows;
+	}
+	p->set_next(0);
+	f->bytes -= packet_length(p);
+	--_length;
+	_bytes -= packet_length(p);
+    }
+    return p;
+}
+
+inline bool
+FQCoDel::should_drop(Flow *f, Packet *p, const Timestamp &now)
+{
+    if (!p) {
+	f->first_above_time = Timestamp();
+	return false;
+    }
+    Timestamp sojourn = now - p->timestamp_anno();
+    if (sojourn < _target || f->bytes <= _quantum) {
+	// below target, or too few bytes queued to matter
+	f->first_above_time = Timestamp();
+	return false;
+    }
+    if (!f->first_above_time) {
+	f->first_above_time = now + _interval;
+	return false;
+    }
+    return now >= f->first_above_time;
+}
+
+// Returns t + INTERVAL / sqrt(count).
+inline Timestamp
+FQCoDel::control_law(const Timestamp &t, uint32_t count) const
+{
+    uint64_t sqrt_count = int_sqrt((uint64_t) count << 32);	// 16.16
+    return t + Timestamp::make_nsec(((uint64_t) _interval.nsecval() << 16) / sqrt_count);
+}
+
+// Dequeues a packet from f according to the CoDel control law.
+Packet *
+FQCoDel::codel_dequeue(Flow *f)
+{
+    Packet *p = flow_dequeue(f);
+    Timestamp now = Timestamp::now_fast();
+    bool ok_to_drop = should_drop(f, p, now);
+
+    if (f->dropping) {
+	if (!ok_to_drop)
+	    f->dropping = false;
+	while (f->dropping && now >= f->drop_next) {
+	    drop(p);
+	    ++_drops;
+	    ++f->count;
+	    p = flow_dequeue(f);
+	    if (!should_drop(f, p, now))
+		f->dropping = false;
+	    else
+		f->drop_next = control_law(f->drop_next, f->count);
+	}
+    } else if (ok_to_drop) {
+	drop(p);
+	++_drops;
+	p = flow_dequeue(f);
+	f->dropping = true;
+	// restart near the previous drop rate if we dropped recently
+	uint32_t delta = f->count - f->lastcount;
+	if (delta > 1 && now - f->drop_next < _interval * 16)
+	    f->count = delta;
+	else
+	    f->count = 1;
+	f->drop_next = control_law(now, f->count);
+	f->lastcount = f->count;
+    }
+    return p;
+}
+
+Packet *
+FQCoDel::pull(int)
+{
+    while (1) {
+	FlowList *l;
+	if (_new.head)
+	    l = &_new;
+	else if (_old.head)
+	    l = &_old;
+	else {
+	    _empty_note.sleep();
+	    return 0;
+	}
+
+	Flow *f = l->head;
+	if (f->deficit <= 0) {
+	    f->deficit += _quantum;
+	    list_push_back(_old, list_pop_front(*l), list_old);
+	    continue;
+	}
+
+	Packet *p = codel_dequeue(f);
+	if (!p) {
+	    // a new flow that empties moves to the old list, so that it
+	    // cannot starve old flows by becoming new again
+	    list_pop_front(*l);
+	    if (l == &_new && _old.head)
+		list_push_back(_old, f, list_old);
+	    continue;
+	}
+
+	f->deficit -= packet_length(p);
+	return p;
+    }
+}
+
+enum { h_capacity };
+
+String
+FQCoDel::read_handler(Element *e, void *thunk)
+{
+    FQCoDel *fq = static_cast<FQCoDel *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_capacity:
+	return String(fq->_capacity);
+    default:
+	return String();
+    }
+}
+
+int
+FQCoDel::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    FQCoDel *fq = static_cast<FQCoDel *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_capacity: {
+	uint32_t capacity;
+	if (!IntArg().parse(str, capacity) || capacity < 1)
+	    return errh->error("capacity must be a positive integer");
+	fq->_capacity = capacity;
+	while (fq->_length > fq->_capacity)
+	    fq->drop_from_fattest();
+	return 0;
+    }
+    default:
+	return -1;
+    }
+}
+
+void
+FQCoDel::add_handlers()
+{
+    add_data_handlers("length", Handler::OP_READ, &_length);
+    add_data_handlers("bytes", Handler::OP_READ, &_bytes);
+    add_data_handlers("flows", Handler::OP_READ, &_active_flows);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+    add_data_handlers("overlimit_drops", Handler::OP_READ, &_overlimit_drops);
+    add_data_handlers("new_flows", Handler::OP_READ, &_new_flow_count);
+    add_read_handler("capacity", read_handler, h_capacity);
+    add_write_handler("capacity", write_handler, h_capacity);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(FQCoDel)
@@ -0,0 +1,196 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FQCODEL_HH
+#define CLICK_FQCODEL_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FQCoDel([I<keywords> FLOWS, QUANTUM, CAPACITY, MEMORY, TARGET, INTERVAL])
+
+=s aqm
+
+fair queue with per-flow CoDel active queue management
+
+=d
+
+FQCoDel is a queue that implements the FlowQueue-CoDel algorithm (RFC
+8290).  It hashes each packet pushed on its input to one of FLOWS flow
+queues, and its output schedules the flow queues in deficit round robin
+order, QUANTUM bytes at a time, so that flows share the output fairly.
+Each flow queue is managed by P<CoDel> (RFC 8289), which drops packets from
+the head of a flow queue when its packets have waited longer than TARGET
+for at least INTERVAL.  Flows that have just become active are served
+before older flows, so that sparse flows, such as DNS lookups or TCP
+connection setup, see little delay.
+
+FQCoDel replaces configurations like HashSwitch to many Queues to DRRSched
+with a single element whose work per packet does not depend on the number
+of flows.  Flow queues are linked lists threaded through the packets
+themselves, and active flows are kept on two lists, so enqueue and dequeue
+take constant time.
+
+Packets are hashed on their IP source and destination addresses, protocol,
+and, for unfragmented TCP and UDP packets, ports.  The IP header annotation
+must be set, as by CheckIPHeader or MarkIPHeader; packets without one share
+a single flow queue.  FQCoDel sets each packet's timestamp annotation to its
+enqueue time.
+
+When the queue holds CAPACITY packets or MEMORY bytes, FQCoDel makes room by
+dropping packets from the head of the flow queue with the largest byte
+backlog, up to half of its bytes.  Finding that flow visits every flow
+queue, so CAPACITY and MEMORY should be large enough that this is rare.
+Dropped packets are emitted on output 1 if it exists, and otherwise freed.
+
+FQCoDel notifies downstream pullers when it becomes empty or nonempty.
+
+Keyword arguments are:
+
+=over 8
+
+=item FLOWS
+
+Integer.  Number of flow queues.  Default is 1024.
+
+=item QUANTUM
+
+Integer.  Bytes each flow may send per round.  Default is 1514.
+
+=item CAPACITY
+
+Integer.  Maximum number of packets in all flow queues.  Default is 10240.
+
+=item MEMORY
+
+Integer.  Maximum number of bytes in all flow queues.  Default is 32
+megabytes.
+
+=item TARGET
+
+Time.  Acceptable minimum standing queue delay.  Default is 5ms.
+
+=item INTERVAL
+
+Time.  Period over which the queue delay must stay above TARGET before
+CoDel drops, which should be on the order of a worst-case round-trip
+time.  Default is 100ms.
+
+=back
+
+=h length read-only
+
+Returns the number of packets queued.
+
+=h bytes read-only
+
+Returns the number of bytes queued.
+
+=h flows read-only
+
+Returns the number of flows with queued packets.
+
+=h drops read-only
+
+Returns the number of packets dropped by CoDel.
+
+=h overlimit_drops read-only
+
+Returns the number of packets dropped because the queue was full.
+
+=h new_flows read-only
+
+Returns the number of times a flow became active.
+
+=h capacity read/write
+
+Returns or sets the CAPACITY parameter.
+
+=e
+
+  ... -> CheckIPHeader(14) -> fq :: FQCoDel -> LinkUnqueue(10ms, 100Mbps) -> ...
+
+=a RED, Queue, DRRSched, HashSwitch */
+
+class FQCoDel : public Element { public:
+
+    FQCoDel();
+    ~FQCoDel();
+
+    const char *class_name() const	{ return "FQCoDel"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+
+  private:
+
+    enum { list_none = 0, list_new = 1, list_old = 2 };
+
+    struct Flow {
+	Packet *head;
+	Packet *tail;
+	uint32_t bytes;
+	int deficit;
+	Flow *next;		// in new or old list
+	int list;
+	// CoDel state
+	bool dropping;
+	uint32_t count;
+	uint32_t lastcount;
+	Timestamp first_above_time;
+	Timestamp drop_next;
+    };
+
+    struct FlowList {
+	Flow *head;
+	Flow *tail;
+    };
+
+    Flow *_flows;
+    uint32_t _nflows;
+    uint32_t _perturb;
+    FlowList _new;
+    FlowList _old;
+
+    uint32_t _quantum;
+    uint32_t _capacity;
+    uint32_t _memory;
+    Timestamp _target;
+    Timestamp _interval;
+
+    uint32_t _length;
+    uint32_t _bytes;
+    uint32_t _active_flows;
+    uint32_t _drops;
+    uint32_t _overlimit_drops;
+    uint32_t _new_flow_count;
+
+    ActiveNotifier _empty_note;
+
+    inline uint32_t classify(Packet *p) const;
+    static inline void list_push_back(FlowList &l, Flow *f, int which);
+    static inline Flow *list_pop_front(FlowList &l);
+    inline Packet *flow_dequeue(Flow *f);
+    inline bool should_drop(Flow *f, Packet *p, const Timestamp &now);
+    inline Timestamp control_law(const Timestamp &t, uint32_t count) const;
+    Packet *codel_dequeue(Flow *f);
+    void drop(Packet *p);
+    void drop_from_fattest();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
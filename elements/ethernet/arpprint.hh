@@ -56,6 +56,7 @@ class ARPPrint : public Element { public:
     ~ARPPrint();
 
     const char *class_name() const		{ return "ARPPrint"; }
+    const char *flags() const			{ return _print_timestamp ? "T" : ""; }
     const char *port_count() const		{ return PORTS_1_1; }
 
     int configure(Vector<String> &, ErrorHandler *);
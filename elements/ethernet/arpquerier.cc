@@ -19,6 +19,8 @@
 
 #include <click/config.h>
 #include "arpquerier.hh"
+#include <click/packetbatch.hh>
+#include <click/prefetch.hh>
 #include <clicknet/ether.h>
 #include <click/etheraddress.hh>
 #include <click/ipaddress.hh>
@@ -54,15 +56,18 @@ ARPQuerier::cast(const char *name)
 int
 ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    uint32_t capacity, entry_capacity;
-    Timestamp timeout, poll_timeout(60);
-    bool have_capacity, have_entry_capacity, have_timeout, have_broadcast,
+    uint32_t capacity, entry_capacity, queue_capacity;
+    Timestamp timeout, poll_timeout(60), query_interval;
+    bool have_capacity, have_entry_capacity, have_queue_capacity,
+	have_timeout, have_query_interval, have_broadcast,
 	broadcast_poll = false;
     _arpt = 0;
     if (Args(this, errh).bind(conf)
 	.read("CAPACITY", capacity).read_status(have_capacity)
 	.read("ENTRY_CAPACITY", entry_capacity).read_status(have_entry_capacity)
+	.read("QUEUE_CAPACITY", queue_capacity).read_status(have_queue_capacity)
 	.read("TIMEOUT", timeout).read_status(have_timeout)
+	.read("QUERY_INTERVAL", query_interval).read_status(have_query_interval)
 	.read("BROADCAST", _my_bcast_ip).read_status(have_broadcast)
 	.read("TABLE", ElementCastArg("ARPTable"), _arpt)
 	.read("POLL_TIMEOUT", poll_timeout)
@@ -76,8 +81,12 @@ ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 	    subconf.push_back("CAPACITY " + String(capacity));
 	if (have_entry_capacity)
 	    subconf.push_back("ENTRY_CAPACITY " + String(entry_capacity));
+	if (have_queue_capacity)
+	    subconf.push_back("QUEUE_CAPACITY " + String(queue_capacity));
 	if (have_timeout)
 	    subconf.push_back("TIMEOUT " + timeout.unparse());
+	if (have_query_interval)
+	    subconf.push_back("QUERY_INTERVAL " + query_interval.unparse());
 	_arpt = new ARPTable;
 	_arpt->attach_router(router(), -1);
 	_arpt->configure(subconf, errh);
@@ -111,16 +120,20 @@ ARPQuerier::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 ARPQuerier::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 {
-    uint32_t capacity, entry_capacity;
-    Timestamp timeout, poll_timeout(Timestamp::make_jiffies((click_jiffies_t) _poll_timeout_j));
-    bool have_capacity, have_entry_capacity, have_timeout, have_broadcast,
+    uint32_t capacity, entry_capacity, queue_capacity;
+    Timestamp timeout, poll_timeout(Timestamp::make_jiffies((click_jiffies_t) _poll_timeout_j)),
+	query_interval;
+    bool have_capacity, have_entry_capacity, have_queue_capacity,
+	have_timeout, have_query_interval, have_broadcast,
 	broadcast_poll(_broadcast_poll);
     IPAddress my_bcast_ip;
 
     if (Args(this, errh).bind(conf)
 	.read("CAPACITY", capacity).read_status(have_capacity)
 	.read("ENTRY_CAPACITY", entry_capacity).read_status(have_entry_capacity)
+	.read("QUEUE_CAPACITY", queue_capacity).read_status(have_queue_capacity)
 	.read("TIMEOUT", timeout).read_status(have_timeout)
+	.read("QUERY_INTERVAL", query_interval).read_status(have_query_interval)
 	.read("BROADCAST", my_bcast_ip).read_status(have_broadcast)
 	.read_with("TABLE", AnyArg())
 	.read("POLL_TIMEOUT", poll_timeout)
@@ -153,8 +166,12 @@ ARPQuerier::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 	_arpt->set_capacity(capacity);
     if (_my_arpt && have_entry_capacity)
 	_arpt->set_entry_capacity(entry_capacity);
+    if (_my_arpt && have_queue_capacity)
+	_arpt->set_queue_capacity(queue_capacity);
     if (_my_arpt && have_timeout)
 	_arpt->set_timeout(timeout);
+    if (_my_arpt && have_query_interval)
+	_arpt->set_query_interval(query_interval);
 
     _broadcast_poll = broadcast_poll;
     if ((uint32_t) poll_timeout.sec() >= (uint32_t) 0xFFFFFFFFU / CLICK_HZ)
@@ -247,7 +264,7 @@ ARPQuerier::send_query_for(const Packet *p, bool ether_dhost_valid)
  * May call p->kill().
  */
 void
-ARPQuerier::handle_ip(Packet *p, bool response)
+ARPQuerier::handle_ip(Packet *p, PacketBatch *out)
 {
     // delete packet if we are not configured
     if (!_my_ip) {
@@ -258,10 +275,7 @@ ARPQuerier::handle_ip(Packet *p, bool response)
 
     // make room for Ethernet header
     WritablePacket *q;
-    if (response) {
-	assert(!p->shared());
-	q = p->uniqueify();
-    } else if (!(q = p->push_mac_header(sizeof(click_ether)))) {
+    if (!(q = p->push_mac_header(sizeof(click_ether)))) {
 	++_drops;
 	return;
     } else
@@ -316,7 +330,10 @@ ARPQuerier::handle_ip(Packet *p, bool response)
     // the source address immediately before send in case the user changes the
     // source address while packets are enqueued.)
     memcpy(&q->ether_header()->ether_shost, _my_en.data(), 6);
-    output(0).push(q);
+    if (out)
+	out->push_back(q);
+    else
+	output(0).push(q);
 }
 
 /*
@@ -344,12 +361,24 @@ ARPQuerier::handle_response(Packet *p)
 	Packet *cached_packet;
 	_arpt->insert(ipa, ena, &cached_packet);
 
-	// Send out packets in the order in which they arrived
+	// Send out packets in the order in which they arrived, as one batch.
+	// (Set the source address now in case the user changed it while
+	// packets were enqueued.)
+	PacketBatch batch;
 	while (cached_packet) {
 	    Packet *next = cached_packet->next();
-	    handle_ip(cached_packet, true);
+	    cached_packet->set_next(0);
+	    if (WritablePacket *q = cached_packet->uniqueify()) {
+		click_ether *qeh = q->ether_header();
+		memcpy(qeh->ether_dhost, ena.data(), 6);
+		memcpy(qeh->ether_shost, _my_en.data(), 6);
+		batch.push_back(q);
+	    } else
+		++_drops;
 	    cached_packet = next;
 	}
+	if (!batch.empty())
+	    output(0).push_batch(batch);
     }
 }
 
@@ -357,13 +386,36 @@ void
 ARPQuerier::push(int port, Packet *p)
 {
     if (port == 0)
-	handle_ip(p, false);
+	handle_ip(p);
     else {
 	handle_response(p);
 	p->kill();
     }
 }
 
+void
+ARPQuerier::push_batch(int port, PacketBatch &batch)
+{
+    if (port != 0) {
+	Element::push_batch(port, batch);
+	return;
+    }
+
+    // Prefetch each packet's ARP table bucket a few packets ahead of its
+    // lookup, and send the resolved packets on as one batch.
+    Packet *p[BATCH_LANES];
+    PacketBatch out;
+    IPStages stages = { this, p, &out };
+    while (!batch.empty()) {
+	int n = 0;
+	for (; n < BATCH_LANES && !batch.empty(); ++n)
+	    p[n] = batch.pop_front();
+	click_prefetch_pipeline(stages, n);
+    }
+    if (!out.empty())
+	output(0).push_batch(out);
+}
+
 String
 ARPQuerier::read_handler(Element *e, void *thunk)
 {
@@ -374,11 +426,16 @@ ARPQuerier::read_handler(Element *e, void *thunk)
     case h_stats:
 	return
 	    String(q->_drops.value() + q->_arpt->drops()) + " packets killed\n" +
-	    String(q->_arp_queries.value()) + " ARP queries sent\n";
+	    String(q->_arp_queries.value()) + " ARP queries sent\n" +
+	    String(q->_arpt->coalesced()) + " ARP queries coalesced\n";
     case h_count:
 	return String(q->_arpt->count());
     case h_length:
 	return String(q->_arpt->length());
+    case h_pending:
+	return String(q->_arpt->pending());
+    case h_pending_max:
+	return q->_arpt->read_handler(q->_arpt, (void *) (uintptr_t) ARPTable::h_pending_max);
     default:
 	return String();
     }
@@ -409,6 +466,8 @@ ARPQuerier::add_handlers()
     add_read_handler("stats", read_handler, h_stats);
     add_read_handler("count", read_handler, h_count);
     add_read_handler("length", read_handler, h_length);
+    add_read_handler("pending", read_handler, h_pending);
+    add_read_handler("pending_max", read_handler, h_pending_max);
     add_data_handlers("queries", Handler::OP_READ, &_arp_queries);
     add_data_handlers("responses", Handler::OP_READ, &_arp_responses);
     add_data_handlers("drops", Handler::OP_READ, &_drops);
@@ -55,8 +55,8 @@ Keyword arguments are:
 
 Element.  Names an ARPTable element that holds this element's corresponding
 ARP state.  By default ARPQuerier creates its own internal ARPTable and uses
-that.  If TABLE is specified, CAPACITY, ENTRY_CAPACITY, and TIMEOUT are
-ignored.
+that.  If TABLE is specified, CAPACITY, ENTRY_CAPACITY, QUEUE_CAPACITY,
+TIMEOUT, and QUERY_INTERVAL are ignored.
 
 =item CAPACITY
 
@@ -68,10 +68,23 @@ hold at a time.  Default is 2048.
 Unsigned integer.  The maximum number of ARP entries the table will hold
 at a time.  Default is 0, which means unlimited.
 
+=item QUEUE_CAPACITY
+
+Unsigned integer.  The maximum number of saved IP packets the table will hold
+for any one address.  Default is 0, which means the limit is CAPACITY.  When
+the table is full, each address waiting for resolution also keeps no more
+than an equal share of CAPACITY; see ARPTable.
+
 =item TIMEOUT
 
 Amount of time before an ARP entry expires.  Defaults to 5 minutes.
 
+=item QUERY_INTERVAL
+
+Amount of time.  ARPQuerier sends at most one query per address per
+QUERY_INTERVAL; packets sent to the address in between wait for the same
+reply.  Defaults to 100 milliseconds.
+
 =item POLL_TIMEOUT
 
 Amount of time after which ARPQuerier will start polling for renewal.  0 means
@@ -109,7 +122,10 @@ ARPQuerier uses packets' destination IP address annotations, and can destroy
 their next packet annotations.  Generated ARP queries have VLAN TCI
 annotations set from the corresponding input packets.
 
-ARPQuerier will send at most 10 queries a second for any IP address.
+When a reply arrives, the packets waiting for its address leave as one batch.  A
+batch of IP packets is resolved in a prefetch pipeline, which fetches each
+packet's ARP table bucket a few packets ahead of its lookup, and the resolved
+packets leave as one batch.
 
 =h ipaddr rw
 
@@ -148,6 +164,14 @@ Returns the number of entries in the ARP table.
 
 Returns the number of packets stored in the ARP table.
 
+=h pending r
+
+Returns the number of addresses with packets waiting for resolution.
+
+=h pending_max r
+
+Returns the largest number of packets waiting for one address.
+
 =h insert w
 
 Add an entry to the ARP table.  The input string should have the form "IP ETH".
@@ -187,6 +211,7 @@ class ARPQuerier : public Element { public:
     void take_state(Element *e, ErrorHandler *errh);
 
     void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
 
   private:
 
@@ -207,9 +232,22 @@ class ARPQuerier : public Element { public:
 
     void send_query_for(const Packet *p, bool ether_dhost_valid);
 
-    void handle_ip(Packet *p, bool response);
+    void handle_ip(Packet *p, PacketBatch *out = 0);
     void handle_response(Packet *p);
 
+    enum { BATCH_LANES = 16 };
+    struct IPStages {
+	ARPQuerier *q;
+	Packet **p;
+	PacketBatch *out;
+	void prefetch(int i) {
+	    q->_arpt->prefetch(p[i]->dst_ip_anno());
+	}
+	void execute(int i) {
+	    q->handle_ip(p[i], out);
+	}
+    };
+
     static void expire_hook(Timer *, void *);
     static String read_table(Element *, void *);
     static String read_table_xml(Element *, void *);
@@ -217,7 +255,7 @@ class ARPQuerier : public Element { public:
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
     enum { h_table, h_table_xml, h_stats, h_insert, h_delete, h_clear,
-	   h_count, h_length };
+	   h_count, h_length, h_pending, h_pending_max };
 
 };
 
@@ -31,9 +31,11 @@
 CLICK_DECLS
 
 ARPTable::ARPTable()
-    : _entry_capacity(0), _packet_capacity(2048), _expire_timer(this)
+    : _pending_count(0), _packet_bytes(0), _entry_capacity(0),
+      _packet_capacity(2048),
+      _queue_capacity(0), _query_interval_j(CLICK_HZ / 10), _expire_timer(this)
 {
-    _entry_count = _packet_count = _drops = 0;
+    _entry_count = _packet_count = _drops = _coalesced = 0;
 }
 
 ARPTable::~ARPTable()
@@ -43,14 +45,17 @@ ARPTable::~ARPTable()
 int
 ARPTable::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    Timestamp timeout(300);
+    Timestamp timeout(300), query_interval(Timestamp::make_jiffies((click_jiffies_t) _query_interval_j));
     if (Args(conf, this, errh)
 	.read("CAPACITY", _packet_capacity)
 	.read("ENTRY_CAPACITY", _entry_capacity)
+	.read("QUEUE_CAPACITY", _queue_capacity)
 	.read("TIMEOUT", timeout)
+	.read("QUERY_INTERVAL", query_interval)
 	.complete() < 0)
 	return -1;
     set_timeout(timeout);
+    set_query_interval(query_interval);
     if (_timeout_j) {
 	_expire_timer.initialize(this);
 	_expire_timer.schedule_after_sec(_timeout_j / CLICK_HZ);
@@ -67,6 +72,7 @@ ARPTable::cleanup(CleanupStage)
 void
 ARPTable::clear()
 {
+    _lock.acquire_write();
     // Walk the arp cache table and free any stored packets and arp entries.
     for (Table::iterator it = _table.begin(); it; ) {
 	ARPEntry *ae = _table.erase(it);
@@ -78,7 +84,11 @@ ARPTable::clear()
 	_alloc.deallocate(ae);
     }
     _entry_count = _packet_count = 0;
+    _pending_count = 0;
+    _packet_bytes = 0;
     _age.__clear();
+    _known.clear();
+    _lock.release_write();
 }
 
 void
@@ -93,14 +103,62 @@ ARPTable::take_state(Element *e, ErrorHandler *errh)
     }
 
     _table.swap(arpt->_table);
+    _known.swap(arpt->_known);
     _age.swap(arpt->_age);
     _entry_count = arpt->_entry_count;
     _packet_count = arpt->_packet_count;
+    _pending_count = arpt->_pending_count;
+    _packet_bytes = arpt->_packet_bytes;
     _drops = arpt->_drops;
+    _coalesced = arpt->_coalesced;
     _alloc.swap(arpt->_alloc);
 
     arpt->_entry_count = 0;
     arpt->_packet_count = 0;
+    arpt->_pending_count = 0;
+    arpt->_packet_bytes = 0;
+}
+
+static inline size_t
+packet_memory(const Packet *p)
+{
+    return sizeof(WritablePacket) + p->buffer_length();
+}
+
+// Remove the oldest entry ae, dropping its queued packets.  Returns the
+// number of bytes freed, as locked_memory_usage() counts them.  Call with
+// the write lock held.
+size_t
+ARPTable::remove(ARPEntry *ae)
+{
+    size_t freed = sizeof(ARPEntry);
+    _table.erase(ae->_ip);
+    _known.erase(ae->_ip);
+    _age.erase(ae);
+
+    while (ae->_head) {
+	freed += packet_memory(ae->_head);
+	drop_head(ae);
+    }
+
+    _alloc.deallocate(ae);
+    --_entry_count;
+    return freed;
+}
+
+// Drop ae's oldest queued packet.  Call with the write lock held.
+void
+ARPTable::drop_head(ARPEntry *ae)
+{
+    Packet *p = ae->_head;
+    if (!(ae->_head = p->next()))
+	ae->_tail = 0;
+    _packet_bytes -= packet_memory(p);
+    p->kill();
+    --_packet_count;
+    ++_drops;
+    if (--ae->_qlen == 0)
+	--_pending_count;
 }
 
 void
@@ -111,32 +169,21 @@ ARPTable::slim(click_jiffies_t now)
     // Delete old entries.
     while ((ae = _age.front())
 	   && (ae->expired(now, _timeout_j)
-	       || (_entry_capacity && _entry_count > _entry_capacity))) {
-	_table.erase(ae->_ip);
-	_age.pop_front();
-
-	while (Packet *p = ae->_head) {
-	    ae->_head = p->next();
-	    p->kill();
-	    --_packet_count;
-	    ++_drops;
-	}
-
-	_alloc.deallocate(ae);
-	--_entry_count;
-    }
-
-    // Mark entries for polling, and delete packets to make space.
-    while (_packet_capacity && _packet_count > _packet_capacity) {
-	while (ae->_head && _packet_count > _packet_capacity) {
-	    Packet *p = ae->_head;
-	    if (!(ae->_head = p->next()))
-		ae->_tail = 0;
-	    p->kill();
-	    --_packet_count;
-	    ++_drops;
-	}
-	ae = ae->_age_link.next();
+	       || (_entry_capacity && _entry_count > _entry_capacity)))
+	remove(ae);
+
+    // Delete packets to make space: first from entries holding more than
+    // an equal share of the capacity, then from any entry, oldest first.
+    if (_packet_capacity && _packet_count > _packet_capacity) {
+	uint32_t share = _packet_capacity / (_pending_count ? _pending_count : 1);
+	for (ae = _age.front(); ae && _packet_count > _packet_capacity;
+	     ae = ae->_age_link.next())
+	    while (ae->_qlen > share && _packet_count > _packet_capacity)
+		drop_head(ae);
+	for (ae = _age.front(); ae && _packet_count > _packet_capacity;
+	     ae = ae->_age_link.next())
+	    while (ae->_head && _packet_count > _packet_capacity)
+		drop_head(ae);
     }
 }
 
@@ -147,11 +194,25 @@ ARPTable::run_timer(Timer *timer)
     // packet.
     _lock.acquire_write();
     slim(click_jiffies());
+    _known.reclaim();
     _lock.release_write();
     if (_timeout_j)
 	timer->schedule_after_sec(_timeout_j / CLICK_HZ + 1);
 }
 
+// Delete the oldest entries until the table fits its memory limit.  Call
+// with the write lock held, before the new entry joins the age list.
+void
+ARPTable::slim_memory()
+{
+    size_t mem = locked_memory_usage();
+    while (mem > memory_limit())
+	if (ARPEntry *ae = _age.front())
+	    mem -= remove(ae);
+	else
+	    break;
+}
+
 ARPTable::ARPEntry *
 ARPTable::ensure(IPAddress ip, click_jiffies_t now)
 {
@@ -167,6 +228,8 @@ ARPTable::ensure(IPAddress ip, click_jiffies_t now)
 	++_entry_count;
 	if (_entry_capacity && _entry_count > _entry_capacity)
 	    slim(now);
+	if (memory_limit())
+	    slim_memory();
 
 	ARPEntry *ae = new(x) ARPEntry(ip);
 	ae->_live_at_j = now;
@@ -192,6 +255,14 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
     ae->_live_at_j = now;
     ae->_polled_at_j = ae->_live_at_j - CLICK_HZ;
 
+    if (ae->_known) {
+	KnownEntry k;
+	k.eth = eth;
+	k.live_at_j = now;
+	_known.set(ip, k);
+    } else
+	_known.erase(ip);
+
     if (ae->_age_link.next()) {
 	_age.erase(ae);
 	_age.push_back(ae);
@@ -199,9 +270,13 @@ ARPTable::insert(IPAddress ip, const EtherAddress &eth, Packet **head)
 
     if (head) {
 	*head = ae->_head;
+	for (Packet *p = ae->_head; p; p = p->next())
+	    _packet_bytes -= packet_memory(p);
 	ae->_head = ae->_tail = 0;
-	for (Packet *p = *head; p; p = p->next())
-	    --_packet_count;
+	_packet_count -= ae->_qlen;
+	if (ae->_qlen)
+	    --_pending_count;
+	ae->_qlen = 0;
     }
 
     _table.balance();
@@ -242,9 +317,19 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 	}
     }
 
+    // A destination at its QUEUE_CAPACITY, or holding more than its share
+    // of a full table, drops its own oldest packet.  Otherwise slim() takes packets
+    // from destinations over their share.  A scan of many unresolved
+    // addresses thus cannot push out the packets of a few busy ones.
+    if (_queue_capacity && ae->_qlen >= _queue_capacity)
+	drop_head(ae);
     ++_packet_count;
-    if (_packet_capacity && _packet_count > _packet_capacity)
-	slim(now);
+    if (_packet_capacity && _packet_count > _packet_capacity) {
+	if (ae->_qlen > _packet_capacity / _pending_count)
+	    drop_head(ae);
+	else
+	    slim(now);
+    }
 
     if (ae->_tail)
 	ae->_tail->set_next(p);
@@ -252,19 +337,41 @@ ARPTable::append_query(IPAddress ip, Packet *p)
 	ae->_head = p;
     ae->_tail = p;
     p->set_next(0);
+    _packet_bytes += packet_memory(p);
+    if (ae->_qlen++ == 0)
+	++_pending_count;
 
+    // Coalesce queries for the same address within QUERY_INTERVAL.
     int r;
-    if (!click_jiffies_less(now, ae->_polled_at_j + CLICK_HZ / 10)) {
+    if (!click_jiffies_less(now, ae->_polled_at_j + _query_interval_j)) {
 	ae->_polled_at_j = now;
 	r = 1;
-    } else
+    } else {
+	++_coalesced;
 	r = 0;
+    }
 
     _table.balance();
     _lock.release_write();
     return r;
 }
 
+// Called by lookup() when a known entry is old enough to poll.  Polls are
+// rare, so they take the lock to rate-limit on the entry's poll time.
+int
+ARPTable::poll(IPAddress ip, click_jiffies_t now)
+{
+    int r = 0;
+    _lock.acquire_write();
+    if (Table::iterator it = _table.find(ip))
+	if (!click_jiffies_less(now, it->_polled_at_j + _query_interval_j)) {
+	    it->_polled_at_j = now;
+	    r = 1;
+	}
+    _lock.release_write();
+    return r;
+}
+
 IPAddress
 ARPTable::reverse_lookup(const EtherAddress &eth)
 {
@@ -288,6 +395,15 @@ ARPTable::read_handler(Element *e, void *user_data)
     StringAccum sa;
     click_jiffies_t now = click_jiffies();
     switch (reinterpret_cast<uintptr_t>(user_data)) {
+    case h_pending_max: {
+	uint32_t m = 0;
+	arpt->_lock.acquire_read();
+	for (ARPEntry *ae = arpt->_age.front(); ae; ae = ae->_age_link.next())
+	    if (ae->_qlen > m)
+		m = ae->_qlen;
+	arpt->_lock.release_read();
+	return String(m);
+    }
     case h_table:
 	for (ARPEntry *ae = arpt->_age.front(); ae; ae = ae->_age_link.next()) {
 	    int ok = ae->known(now, arpt->_timeout_j);
@@ -332,6 +448,26 @@ ARPTable::write_handler(const String &str, Element *e, void *user_data, ErrorHan
     }
 }
 
+// Call with the lock held.  Takes constant time, so ensure() can call it
+// for every new entry.
+size_t
+ARPTable::locked_memory_usage() const
+{
+    return _entry_count * sizeof(ARPEntry)
+	+ _table.bucket_count() * sizeof(ARPEntry *) + _known.memory()
+	+ _packet_bytes;
+}
+
+size_t
+ARPTable::memory_usage() const
+{
+    ReadWriteLock &lock = const_cast<ReadWriteLock &>(_lock);
+    lock.acquire_read();
+    size_t m = locked_memory_usage();
+    lock.release_read();
+    return m;
+}
+
 void
 ARPTable::add_handlers()
 {
@@ -339,9 +475,13 @@ ARPTable::add_handlers()
     add_data_handlers("drops", Handler::OP_READ, &_drops);
     add_data_handlers("count", Handler::OP_READ, &_entry_count);
     add_data_handlers("length", Handler::OP_READ, &_packet_count);
+    add_data_handlers("pending", Handler::OP_READ, &_pending_count);
+    add_read_handler("pending_max", read_handler, h_pending_max);
+    add_data_handlers("coalesced", Handler::OP_READ, &_coalesced);
     add_write_handler("insert", write_handler, h_insert);
     add_write_handler("delete", write_handler, h_delete);
     add_write_handler("clear", write_handler, h_clear);
+    add_memory_limit_handler();
 }
 
 CLICK_ENDDECLS
@@ -4,6 +4,7 @@
 #include <click/etheraddress.hh>
 #include <click/hashcontainer.hh>
 #include <click/hashallocator.hh>
+#include <click/rcuhashtable.hh>
 #include <click/sync.hh>
 #include <click/timer.hh>
 #include <click/list.hh>
@@ -40,11 +41,38 @@ hold at a time.  Default is 2048; zero means unlimited.
 Unsigned integer.  The maximum number of ARP entries the ARPTable will hold at
 a time.  Default is zero, which means unlimited.
 
+=item QUEUE_CAPACITY
+
+Unsigned integer.  The maximum number of saved IP packets the ARPTable will
+hold for any one address.  When an address reaches it, its oldest packet is
+dropped.  Default is zero, which means the limit is CAPACITY.
+
 =item TIMEOUT
 
 Time value.  The amount of time after which an ARP entry will expire.  Default
 is 5 minutes.  Zero means ARP entries never expire.
 
+=item QUERY_INTERVAL
+
+Time value.  ARPTable asks for at most one query per address per
+QUERY_INTERVAL; packets sent in between join the address's queue without a
+query of their own.  Default is 100 milliseconds.
+
+=back
+
+When the table holds CAPACITY packets, each unresolved address is entitled to
+an equal share.  A new packet for an address that holds more than its share
+replaces that address's oldest packet.  Otherwise ARPTable drops packets of
+addresses over their share, then, if need be, of the oldest entries.  A scan
+of many unresolved addresses thus cannot push out the packets waiting for a
+few busy addresses.
+
+Lookups take no locks.  Known entries are mirrored in a table of
+sequence-numbered slots that readers copy without writing shared memory, so
+ARPQuerier elements on many threads may share one ARPTable without contention.
+Inserts, queued packets, and aging take a lock.  Expired entries are removed in
+batches by a timer, not by lookups.
+
 =h table r
 
 Return a table of the ARP entries.  The returned string has four
@@ -76,6 +104,26 @@ Return the number of entries in the table.
 
 Return the number of packets stored in the table.
 
+=h pending r
+
+Return the number of addresses with packets waiting for resolution.
+
+=h pending_max r
+
+Return the largest number of packets waiting for one address.
+
+=h coalesced r
+
+Return the number of packets queued without a query of their own, because
+their address was queried within QUERY_INTERVAL.
+
+=h memory_limit rw
+
+Return or set a soft limit, in bytes, on the C<memory> handler's value, which
+counts entries, their hash tables, and queued packets.  Zero, the default,
+means no limit.  While the table is over the limit, each new entry evicts the
+oldest entries, and their queued packets, until it fits.
+
 =a
 
 ARPQuerier
@@ -93,6 +141,7 @@ class ARPTable : public Element { public:
     void take_state(Element *, ErrorHandler *);
     void add_handlers();
     void cleanup(CleanupStage);
+    size_t memory_usage() const;
 
     int lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j);
     EtherAddress lookup(IPAddress ip);
@@ -101,6 +150,13 @@ class ARPTable : public Element { public:
     int append_query(IPAddress ip, Packet *p);
     void clear();
 
+    /** @brief Prefetch the table bucket for @a ip, ahead of lookup(ip).
+     *
+     * A hint; needs no lock. */
+    void prefetch(IPAddress ip) const {
+	_table.prefetch(ip);
+    }
+
     uint32_t capacity() const {
 	return _packet_capacity;
     }
@@ -113,6 +169,18 @@ class ARPTable : public Element { public:
     void set_entry_capacity(uint32_t entry_capacity) {
 	_entry_capacity = entry_capacity;
     }
+    uint32_t queue_capacity() const {
+	return _queue_capacity;
+    }
+    void set_queue_capacity(uint32_t queue_capacity) {
+	_queue_capacity = queue_capacity;
+    }
+    Timestamp query_interval() const {
+	return Timestamp::make_jiffies((click_jiffies_t) _query_interval_j);
+    }
+    void set_query_interval(const Timestamp &interval) {
+	_query_interval_j = interval.jiffies();
+    }
     Timestamp timeout() const {
 	return Timestamp::make_jiffies((click_jiffies_t) _timeout_j);
     }
@@ -132,11 +200,17 @@ class ARPTable : public Element { public:
     uint32_t length() const {
 	return _packet_count;
     }
+    uint32_t pending() const {
+	return _pending_count;
+    }
+    uint32_t coalesced() const {
+	return _coalesced;
+    }
 
     void run_timer(Timer *);
 
     enum {
-	h_table, h_insert, h_delete, h_clear
+	h_table, h_insert, h_delete, h_clear, h_pending_max
     };
     static String read_handler(Element *e, void *user_data);
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
@@ -150,6 +224,7 @@ class ARPTable : public Element { public:
 	click_jiffies_t _polled_at_j;
 	Packet *_head;
 	Packet *_tail;
+	uint32_t _qlen;		// packets from _head to _tail
 	List_member<ARPEntry> _age_link;
 	typedef IPAddress key_type;
 	typedef IPAddress key_const_reference;
@@ -165,13 +240,19 @@ class ARPTable : public Element { public:
 	}
 	ARPEntry(IPAddress ip)
 	    : _ip(ip), _hashnext(), _eth(EtherAddress::make_broadcast()),
-	      _known(false), _head(), _tail() {
+	      _known(false), _head(), _tail(), _qlen(0) {
 	}
     };
 
   private:
 
+    struct KnownEntry {
+	EtherAddress eth;
+	click_jiffies_t live_at_j;
+    };
+
     ReadWriteLock _lock;
+    RCUHashTable<IPAddress, KnownEntry> _known;
 
     typedef HashContainer<ARPEntry> Table;
     Table _table;
@@ -179,38 +260,41 @@ class ARPTable : public Element { public:
     AgeList _age;
     atomic_uint32_t _entry_count;
     atomic_uint32_t _packet_count;
+    uint32_t _pending_count;	// entries with queued packets
+    size_t _packet_bytes;	// memory held by queued packets
     uint32_t _entry_capacity;
     uint32_t _packet_capacity;
+    uint32_t _queue_capacity;
     uint32_t _timeout_j;
+    uint32_t _query_interval_j;
     atomic_uint32_t _drops;
+    atomic_uint32_t _coalesced;
     SizedHashAllocator<sizeof(ARPEntry)> _alloc;
     Timer _expire_timer;
 
     ARPEntry *ensure(IPAddress ip, click_jiffies_t now);
+    size_t remove(ARPEntry *ae);
+    void drop_head(ARPEntry *ae);
     void slim(click_jiffies_t now);
+    void slim_memory();
+    size_t locked_memory_usage() const;
+    int poll(IPAddress ip, click_jiffies_t now);
 
 };
 
 inline int
 ARPTable::lookup(IPAddress ip, EtherAddress *eth, uint32_t poll_timeout_j)
 {
-    _lock.acquire_read();
-    int r = -1;
-    if (Table::iterator it = _table.find(ip)) {
-	click_jiffies_t now = click_jiffies();
-	if (it->known(now, _timeout_j)) {
-	    *eth = it->_eth;
-	    if (poll_timeout_j
-		&& !click_jiffies_less(now, it->_live_at_j + poll_timeout_j)
-		&& !click_jiffies_less(now, it->_polled_at_j + (CLICK_HZ / 10))) {
-		it->_polled_at_j = now;
-		r = 1;
-	    } else
-		r = 0;
-	}
-    }
-    _lock.release_read();
-    return r;
+    KnownEntry k;
+    if (!_known.find(ip, k))
+	return -1;
+    click_jiffies_t now = click_jiffies();
+    if (_timeout_j && click_jiffies_less(k.live_at_j + _timeout_j, now))
+	return -1;
+    *eth = k.eth;
+    if (poll_timeout_j && !click_jiffies_less(now, k.live_at_j + poll_timeout_j))
+	return poll(ip, now);
+    return 0;
 }
 
 inline EtherAddress
@@ -23,6 +23,7 @@
 CLICK_DECLS
 
 EtherEncap::EtherEncap()
+    : _expensive_pushes(0)
 {
 }
 
@@ -49,6 +50,8 @@ EtherEncap::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 EtherEncap::smaction(Packet *p)
 {
+    if (p->headroom() < 14 || p->shared())
+	++_expensive_pushes;
     if (WritablePacket *q = p->push_mac_header(14)) {
 	memcpy(q->data(), &_ethh, 14);
 	return q;
@@ -72,6 +75,26 @@ EtherEncap::pull(int)
 	return 0;
 }
 
+void
+EtherEncap::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if (Packet *q = smaction(p))
+	    out.push_back(q);
+    output(0).push_batch(out);
+}
+
+void
+EtherEncap::pull_batch(int, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(0).pull_batch(b, max);
+    while (Packet *p = b.pop_front())
+	if (Packet *q = smaction(p))
+	    batch.push_back(q);
+}
+
 void
 EtherEncap::add_handlers()
 {
@@ -83,6 +106,7 @@ EtherEncap::add_handlers()
     add_write_handler("ethertype", reconfigure_keyword_handler, "0 ETHERTYPE");
     add_net_order_data_handlers("etht", Handler::h_read | Handler::h_deprecated, &_ethh.ether_type);
     add_write_handler("etht", reconfigure_keyword_handler, "0 ETHERTYPE");
+    add_data_handlers("expensive_pushes", Handler::h_read, &_expensive_pushes);
 }
 
 CLICK_ENDDECLS
@@ -1,6 +1,7 @@
 #ifndef CLICK_ETHERENCAP_HH
 #define CLICK_ETHERENCAP_HH
 #include <click/element.hh>
+#include <click/packetbatch.hh>
 #include <clicknet/ether.h>
 CLICK_DECLS
 
@@ -42,6 +43,12 @@ Return or set the DST parameter.
 
 Return or set the ETHERTYPE parameter.
 
+=h expensive_pushes read-only
+
+Returns the number of packets that lacked headroom for the new header, or
+whose data was shared, so that push() had to copy them.  See also the global
+"packet_expensive" handler.
+
 =a
 
 EtherVLANEncap, ARPQuerier, EnsureEther, StoreEtherAddress */
@@ -56,15 +63,19 @@ class EtherEncap : public Element { public:
 
     int configure(Vector<String> &, ErrorHandler *);
     bool can_live_reconfigure() const	{ return true; }
+    int encap_headroom() const		{ return sizeof(click_ether); }
     void add_handlers();
 
     Packet *smaction(Packet *);
     void push(int, Packet *);
     Packet *pull(int);
+    void push_batch(int, PacketBatch &);
+    void pull_batch(int, PacketBatch &, int);
 
   private:
 
     click_ether _ethh;
+    uint32_t _expensive_pushes;
 
 };
 
@@ -25,6 +25,7 @@
 CLICK_DECLS
 
 EtherVLANEncap::EtherVLANEncap()
+    : _expensive_pushes(0)
 {
 }
 
@@ -69,6 +70,8 @@ EtherVLANEncap::smaction(Packet *p)
     if (_use_anno)
 	_ethh.ether_vlan_tci = VLAN_TCI_ANNO(p);
     if ((_ethh.ether_vlan_tci & htons(0x0FFF)) == _native_vlan) {
+	if (p->headroom() < sizeof(click_ether) || p->shared())
+	    ++_expensive_pushes;
 	if (WritablePacket *q = p->push_mac_header(sizeof(click_ether))) {
 	    memcpy(q->data(), &_ethh, 12);
 	    q->ether_header()->ether_type = _ethh.ether_vlan_encap_proto;
@@ -76,6 +79,8 @@ EtherVLANEncap::smaction(Packet *p)
 	} else
 	    return 0;
     }
+    if (p->headroom() < sizeof(click_ether_vlan) || p->shared())
+	++_expensive_pushes;
     if (WritablePacket *q = p->push_mac_header(sizeof(click_ether_vlan))) {
 	memcpy(q->data(), &_ethh, sizeof(click_ether_vlan));
 	return q;
@@ -99,6 +104,26 @@ EtherVLANEncap::pull(int)
 	return 0;
 }
 
+void
+EtherVLANEncap::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if (Packet *q = smaction(p))
+	    out.push_back(q);
+    output(0).push_batch(out);
+}
+
+void
+EtherVLANEncap::pull_batch(int, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(0).pull_batch(b, max);
+    while (Packet *p = b.pop_front())
+	if (Packet *q = smaction(p))
+	    batch.push_back(q);
+}
+
 String
 EtherVLANEncap::read_handler(Element *e, void *user_data)
 {
@@ -142,6 +167,7 @@ EtherVLANEncap::add_handlers()
     add_write_handler("vlan_pcp", reconfigure_keyword_handler, "VLAN_PCP");
     add_read_handler("native_vlan", read_keyword_handler, "NATIVE_VLAN");
     add_write_handler("native_vlan", reconfigure_keyword_handler, "NATIVE_VLAN");
+    add_data_handlers("expensive_pushes", Handler::h_read, &_expensive_pushes);
 }
 
 CLICK_ENDDECLS
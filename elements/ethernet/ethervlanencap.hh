@@ -1,6 +1,7 @@
 #ifndef CLICK_ETHERVLANENCAP_HH
 #define CLICK_ETHERVLANENCAP_HH
 #include <click/element.hh>
+#include <click/packetbatch.hh>
 #include <clicknet/ether.h>
 CLICK_DECLS
 
@@ -82,6 +83,12 @@ Return or set the VLAN_PCP parameter.
 
 Return or set the NATIVE_VLAN parameter.
 
+=h expensive_pushes read-only
+
+Returns the number of packets that lacked headroom for the new header, or
+whose data was shared, so that push() had to copy them.  See also the global
+"packet_expensive" handler.
+
 =a
 
 VLANEncap, StripEtherVLANHeader, SetVLANAnno, EtherEncap, ARPQuerier,
@@ -97,17 +104,21 @@ class EtherVLANEncap : public Element { public:
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     bool can_live_reconfigure() const	{ return true; }
+    int encap_headroom() const		{ return sizeof(click_ether_vlan); }
     void add_handlers();
 
     Packet *smaction(Packet *p);
     void push(int port, Packet *p);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
   private:
 
     click_ether_vlan _ethh;
     bool _use_anno;
     int _native_vlan;
+    uint32_t _expensive_pushes;
 
     enum { h_config, h_vlan_tci };
     static String read_handler(Element *e, void *user_data);
@@ -25,6 +25,7 @@
 #include <click/bitvector.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 IP6NDSolicitor::IP6NDSolicitor()
@@ -33,8 +34,6 @@ IP6NDSolicitor::IP6NDSolicitor()
     // input 0: IP6 packets
     // input 1: ether/N.Advertisement responses
     // output 0: ether/IP6 and ether/N.Solicitation queries
-  for (int i = 0; i < NMAP; i++)
-    _map[i] = 0;
 }
 
 IP6NDSolicitor::~IP6NDSolicitor()
@@ -63,16 +62,11 @@ IP6NDSolicitor::initialize(ErrorHandler *)
 void
 IP6NDSolicitor::cleanup(CleanupStage)
 {
-  for (int i = 0; i < NMAP; i++) {
-    for (NDEntry *t = _map[i]; t; ) {
-      NDEntry *n = t->next;
-      if (t->p)
-	t->p->kill();
-      delete t;
-      t = n;
-    }
-    _map[i] = 0;
-  }
+  for (HashTable<IP6Address, NDEntry>::iterator it = _table.begin(); it; ++it)
+    if (it.value().p)
+      it.value().p->kill();
+  _table.clear();
+  _known.clear();
 }
 
 void
@@ -82,10 +76,8 @@ IP6NDSolicitor::take_state(Element *e, ErrorHandler *)
   if (!arpq || _my_ip6 != arpq->_my_ip6 || _my_en != arpq->_my_en)
     return;
 
-  NDEntry *save[NMAP];
-  memcpy(save, _map, sizeof(NDEntry *) * NMAP);
-  memcpy(_map, arpq->_map, sizeof(NDEntry *) * NMAP);
-  memcpy(arpq->_map, save, sizeof(NDEntry *) * NMAP);
+  _table.swap(arpq->_table);
+  _known.swap(arpq->_known);
 }
 
 void
@@ -93,28 +85,28 @@ IP6NDSolicitor::expire_hook(Timer *, void *thunk)
 {
   IP6NDSolicitor *arpq = (IP6NDSolicitor *)thunk;
   click_jiffies_t jiff = click_jiffies();
-  for (int i = 0; i < NMAP; i++) {
-    NDEntry *prev = 0;
-    while (1) {
-      NDEntry *e = (prev ? prev->next : arpq->_map[i]);
-      if (!e)
-	break;
-      if (e->ok) {
-	int gap = jiff - e->last_response_jiffies;
-	if (gap > 120*CLICK_HZ) {
-	  // delete entry from map
-	  if (prev) prev->next = e->next;
-	  else arpq->_map[i] = e->next;
-	  if (e->p)
-	    e->p->kill();
-	  delete e;
-	  continue;		// don't change prev
-	} else if (gap > 60*CLICK_HZ)
-	  e->polling = 1;
+  arpq->_lock.acquire();
+  for (HashTable<IP6Address, NDEntry>::iterator it = arpq->_table.begin(); it; ) {
+    NDEntry &e = it.value();
+    if (e.ok) {
+      int gap = jiff - e.last_response_jiffies;
+      if (gap > 120*CLICK_HZ) {
+	// delete entry from map
+	arpq->_known.erase(it.key());
+	if (e.p)
+	  e.p->kill();
+	it = arpq->_table.erase(it);
+	continue;
+      } else if (gap > 60*CLICK_HZ && !e.polling) {
+	// the next packet takes the locked path and sends a query
+	e.polling = 1;
+	arpq->_known.erase(it.key());
       }
-      prev = e;
     }
+    ++it;
   }
+  arpq->_known.reclaim();
+  arpq->_lock.release();
   arpq->_expire_timer.schedule_after_msec(EXPIRE_TIMEOUT_MS);
 }
 
@@ -184,53 +176,65 @@ IP6NDSolicitor::send_query_for(const u_char want_ip6[16])
   output(noutputs()-1).push(q);
 }
 
+inline Packet *
+IP6NDSolicitor::encap(Packet *p, const EtherAddress &en)
+{
+  WritablePacket *q = p->push(sizeof(click_ether));
+  if (q) {
+    click_ether *e = (click_ether *)q->data();
+    memcpy(e->ether_shost, _my_en.data(), 6);
+    memcpy(e->ether_dhost, en.data(), 6);
+    e->ether_type = htons(ETHERTYPE_IP6);
+  }
+  return q;
+}
+
 /*
  * If the packet's IP6 address is in the table, add an ethernet header
- * and push it out.
+ * and push it out, or append it to *out if out is nonnull.
  * Otherwise push out a query packet.
  * May save the packet in the NDEntry table for later sending.
  * May call p->kill().
  */
 void
-IP6NDSolicitor::handle_ip6(Packet *p)
+IP6NDSolicitor::handle_ip6(Packet *p, PacketBatch *out)
 {
   IP6Address ipa = DST_IP6_ANNO(p);
-  int bucket = (ipa.data()[0] + ipa.data()[15]) % NMAP;
-  NDEntry *ae = _map[bucket];
-  while (ae && ae->ip6 != ipa)
-    ae = ae->next;
-
-  if (ae) {
-    if (ae->polling) {
-      send_query_for(ae->ip6.data());
-      ae->polling = 0;
+  EtherAddress en;
+
+  if (!_known.find(ipa, en)) {
+    Packet *killed = 0;
+    _lock.acquire();
+    NDEntry &ae = _table.find_insert(ipa).value();
+    bool ok = ae.ok, query = !ok || ae.polling;
+    if (ae.polling) {
+      ae.polling = 0;
+      _known.set(ipa, ae.en);
     }
-    //find the match IP address, send to output 0
-    if (ae->ok) {
-      Packet *q = p->push(sizeof(click_ether));
-      click_ether *e = (click_ether *)q->data();
-      memcpy(e->ether_shost, _my_en.data(), 6);
-      memcpy(e->ether_dhost, ae->en.data(), 6);
-      e->ether_type = htons(ETHERTYPE_IP6);
-      output(0).push(q);
-    } else {
-      if (ae->p) {
-        ae->p->kill();
-	_pkts_killed++;
-      }
-      ae->p = p;
-      send_query_for(DST_IP6_ANNO(p).data());
+    if (ok)
+      en = ae.en;
+    else {
+      killed = ae.p;
+      ae.p = p;
     }
+    _lock.release();
 
-  } else {
-    NDEntry *ae = new NDEntry;
-    ae->ip6 = ipa;
-    ae->ok = ae->polling = 0;
-    ae->p = p;
-    ae->next = _map[bucket];
-    _map[bucket] = ae;
+    if (killed) {
+      killed->kill();
+      _pkts_killed++;
+    }
+    if (query)
+      send_query_for(ipa.data());
+    if (!ok)
+      return;
+  }
 
-    send_query_for(DST_IP6_ANNO(p).data());
+  //find the match IP address, send to output 0
+  if (Packet *q = encap(p, en)) {
+    if (out)
+      out->push_back(q);
+    else
+      output(0).push(q);
   }
 }
 
@@ -251,28 +255,29 @@ IP6NDSolicitor::handle_response(Packet *p)
 
   IP6Address ipa = IP6Address(eah->nd_tpa);
   EtherAddress ena = EtherAddress(eah->nd_tha);
-    if (ntohs(ethh->ether_type) == ETHERTYPE_IP6
-	&& eah->type == ND_ADV) {
-//        && !ena.is_group()) {
-     int bucket = (ipa.data()[0] + ipa.data()[15]) % NMAP;
-      NDEntry *ae = _map[bucket];
-      while (ae && ae->ip6 != ipa)
-        ae = ae->next;
-      if (!ae)
-        return;
-
-      if (ae->ok && ae->en != ena)
-        click_chatter("IP6NDSolicitor overwriting an entry");
-      ae->en = ena;
-      ae->ok = 1;
-      ae->polling = 0;
-      ae->last_response_jiffies = click_jiffies();
-      Packet *cached_packet = ae->p;
-      ae->p = 0;
-
-      if (cached_packet){
-        handle_ip6(cached_packet);}
+  if (ntohs(ethh->ether_type) == ETHERTYPE_IP6
+      && eah->type == ND_ADV) {
+    _lock.acquire();
+    NDEntry *ae = _table.get_pointer(ipa);
+    if (!ae) {
+      _lock.release();
+      return;
     }
+
+    if (ae->ok && ae->en != ena)
+      click_chatter("IP6NDSolicitor overwriting an entry");
+    ae->en = ena;
+    ae->ok = 1;
+    ae->polling = 0;
+    ae->last_response_jiffies = click_jiffies();
+    _known.set(ipa, ena);
+    Packet *cached_packet = ae->p;
+    ae->p = 0;
+    _lock.release();
+
+    if (cached_packet)
+      handle_ip6(cached_packet);
+  }
 }
 
 void
@@ -286,14 +291,28 @@ IP6NDSolicitor::push(int port, Packet *p)
   }
 }
 
+void
+IP6NDSolicitor::push_batch(int port, PacketBatch &batch)
+{
+  if (port == 0) {
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+      handle_ip6(p, &out);
+    if (!out.empty())
+      output(0).push_batch(out);
+  } else
+    Element::push_batch(port, batch);
+}
+
 String
 IP6NDSolicitor::read_table(Element *e, void *)
 {
     IP6NDSolicitor *q = (IP6NDSolicitor *)e;
     StringAccum sa;
-    for (int i = 0; i < NMAP; i++)
-	for (NDEntry *e = q->_map[i]; e; e = e->next)
-	    sa << e->ip6 << ' ' << (e->ok ? 1 : 0) << ' ' << e->en << '\n';
+    q->_lock.acquire();
+    for (HashTable<IP6Address, NDEntry>::iterator it = q->_table.begin(); it; ++it)
+	sa << it.key() << ' ' << (it.value().ok ? 1 : 0) << ' ' << it.value().en << '\n';
+    q->_lock.release();
     return sa.take_string();
 }
 
@@ -302,8 +321,8 @@ IP6NDSolicitor_read_stats(Element *e, void *)
 {
   IP6NDSolicitor *q = (IP6NDSolicitor *)e;
   return
-    String(q->_pkts_killed) + " packets killed\n" +
-    String(q->_arp_queries) + " ND Solicitation Message sent\n";
+    String(q->_pkts_killed.value()) + " packets killed\n" +
+    String(q->_arp_queries.value()) + " ND Solicitation Message sent\n";
 }
 
 void
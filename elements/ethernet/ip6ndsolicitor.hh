@@ -4,6 +4,10 @@
 #include <click/etheraddress.hh>
 #include <click/ip6address.hh>
 #include <click/timer.hh>
+#include <click/hashtable.hh>
+#include <click/rcuhashtable.hh>
+#include <click/sync.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 
 /*
@@ -33,6 +37,22 @@ CLICK_DECLS
  * IP6NDSolicitor may have one or two outputs. If it has two, then ARP queries
  * are sent to the second output.
  *
+ * Neighbors are kept in a hash table.  Resolved neighbors are mirrored in a
+ * table of sequence-numbered slots that readers copy without locks or writes
+ * to shared memory, so packets for known neighbors are encapsulated without
+ * contention, and a pushed batch leaves output 0 as one batch.  Unresolved
+ * neighbors, responses, and aging take a lock.
+ *
+ * =h table read-only
+ *
+ * Returns one line per neighbor: its IP6 address, whether it is resolved
+ * (1) or not (0), and its Ethernet address.
+ *
+ * =h stats read-only
+ *
+ * Returns the number of packets killed while waiting and of Neighbor
+ * Solicitations sent.
+ *
  * =e
  *    c :: Classifier(12/86dd 20/3aff 54/87,
  *		      12/86dd 20/3aff 54/88,
@@ -66,37 +86,41 @@ class IP6NDSolicitor : public Element {
   void take_state(Element *, ErrorHandler *);
 
   void push(int port, Packet *);
+  void push_batch(int port, PacketBatch &batch);
 
   Packet *make_query(unsigned char tpa[16],
                      unsigned char sha[6], unsigned char spa[16]);
 
   void insert(IP6Address, EtherAddress);
 
-   struct NDEntry {
-    IP6Address ip6;
+  struct NDEntry {
     EtherAddress en;
     click_jiffies_t last_response_jiffies;
     unsigned ok: 1;
     unsigned polling: 1;
     Packet *p;
-    struct NDEntry *next;
+    NDEntry()
+      : last_response_jiffies(0), ok(0), polling(0), p(0) {
+    }
   };
 
   // statistics
-  int _arp_queries;
-  int _pkts_killed;
+  atomic_uint32_t _arp_queries;
+  atomic_uint32_t _pkts_killed;
 
  private:
 
-  enum { NMAP = 256 };
-  NDEntry *_map[NMAP];
+  Spinlock _lock;
+  HashTable<IP6Address, NDEntry> _table;	// protected by _lock
+  RCUHashTable<IP6Address, EtherAddress> _known; // ok, non-polling entries
   EtherAddress _my_en;
   IP6Address _my_ip6;
   Timer _expire_timer;
 
   void send_query_for(const u_char want_ip6[16]);
 
-  void handle_ip6(Packet *);
+  inline Packet *encap(Packet *p, const EtherAddress &en);
+  void handle_ip6(Packet *p, PacketBatch *out = 0);
   void handle_response(Packet *);
 
   enum { EXPIRE_TIMEOUT_MS = 15 * 1000 };
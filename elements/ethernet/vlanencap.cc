@@ -25,6 +25,7 @@
 CLICK_DECLS
 
 VLANEncap::VLANEncap()
+    : _expensive_pushes(0)
 {
 }
 
@@ -65,7 +66,10 @@ VLANEncap::simple_action(Packet *p)
     if ((tci & htons(0xFFF)) == _native_vlan) {
 	p->set_mac_header(p->data(), sizeof(click_ether));
 	return p;
-    } else if (WritablePacket *q = p->push(4)) {
+    }
+    if (p->headroom() < 4 || p->shared())
+	++_expensive_pushes;
+    if (WritablePacket *q = p->push(4)) {
 	memmove(q->data(), q->data() + 4, 12);
 	click_ether_vlan *vlan = reinterpret_cast<click_ether_vlan *>(q->data());
 	vlan->ether_vlan_proto = htons(ETHERTYPE_8021Q);
@@ -76,6 +80,32 @@ VLANEncap::simple_action(Packet *p)
 	return 0;
 }
 
+void
+VLANEncap::simple_action_batch(PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if (Packet *q = simple_action(p))
+	    out.push_back(q);
+    batch.swap(out);
+}
+
+void
+VLANEncap::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+VLANEncap::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
 String
 VLANEncap::read_handler(Element *e, void *user_data)
 {
@@ -113,6 +143,7 @@ VLANEncap::add_handlers()
     add_write_handler("vlan_pcp", reconfigure_keyword_handler, "VLAN_PCP");
     add_read_handler("native_vlan", read_keyword_handler, "NATIVE_VLAN");
     add_write_handler("native_vlan", reconfigure_keyword_handler, "NATIVE_VLAN");
+    add_data_handlers("expensive_pushes", Handler::h_read, &_expensive_pushes);
 }
 
 CLICK_ENDDECLS
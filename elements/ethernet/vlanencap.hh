@@ -1,6 +1,7 @@
 #ifndef CLICK_VLANENCAP_HH
 #define CLICK_VLANENCAP_HH
 #include <click/element.hh>
+#include <click/packetbatch.hh>
 
 CLICK_DECLS
 
@@ -44,6 +45,12 @@ NATIVE_VLAN, then the output packet is encapsulated in a conventional Ethernet
 header, rather than an 802.1Q header (i.e., the shim header is not added).
 Set to -1 for no native VLAN.  Defaults to 0.
 
+=h expensive_pushes read-only
+
+Returns the number of packets that lacked headroom for the new header, or
+whose data was shared, so that push() had to copy them.  See also the global
+"packet_expensive" handler.
+
 =a
 
 EtherVLANEncap, VLANDecap
@@ -59,14 +66,19 @@ class VLANEncap : public Element { public:
     void add_handlers();
 
     int configure(Vector<String> &, ErrorHandler *);
+    int encap_headroom() const		{ return 4; }
 
     Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &batch);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
   private:
 
     uint16_t _vlan_tci;
     bool _use_anno;
     int _native_vlan;
+    uint32_t _expensive_pushes;
 
     enum { h_config, h_vlan_tci };
     static String read_handler(Element *e, void *user_data);
@@ -36,6 +36,7 @@ public:
 	      uint64_t _bridge_id, uint16_t _port_id) const;
 
   String s(String tag = "") const;
+  bool tc() const			{ return _tc; }
 
   CLICK_PACKED_STRUCTURE(
   struct wire {,
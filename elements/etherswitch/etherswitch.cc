@@ -23,70 +23,263 @@
 #include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/error.hh>
+#include "elements/standard/classification.hh"
 CLICK_DECLS
 
 EtherSwitch::EtherSwitch()
-    : _table(AddrInfo(-1, Timestamp())), _timeout(300)
+    : _tick(0), _sweep(0), _timer(this), _port_states(0)
 {
+    set_timeout(300);
 }
 
 EtherSwitch::~EtherSwitch()
 {
-    _table.clear();
+    delete[] _port_states;
+    reclaim_port_states(true);
 }
 
 int
 EtherSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh)
-	.read("TIMEOUT", SecondsArg(), _timeout)
-	.complete();
+    uint32_t timeout = _timeout;
+    if (Args(conf, this, errh)
+	.read("TIMEOUT", SecondsArg(), timeout)
+	.complete() < 0)
+	return -1;
+    set_timeout(timeout);
+    return 0;
 }
 
 void
-EtherSwitch::broadcast(int source, Packet *p)
-{
-  int n = noutputs();
-  assert((unsigned) source < (unsigned) n);
-  int sent = 0;
-  for (int i = 0; i < n; i++)
-    if (i != source) {
-      Packet *pp = (sent < n - 2 ? p->clone() : p);
-      output(i).push(pp);
-      sent++;
+EtherSwitch::set_timeout(uint32_t timeout)
+{
+    // Tick four times per TIMEOUT, but at least once a second.
+    _timeout = timeout;
+    _tick_msec = (timeout < 4 ? timeout * 250 : 1000);
+    _age_ticks = (timeout < 4 ? 4 : timeout);
+}
+
+int
+EtherSwitch::initialize(ErrorHandler *)
+{
+    _flush_tick.assign(noutputs(), _tick - 1);
+    _timer.initialize(this);
+    _timer.schedule_after_msec(_tick_msec ? _tick_msec : 1000);
+    return 0;
+}
+
+void
+EtherSwitch::run_timer(Timer *)
+{
+    uint32_t tick = ++_tick;
+    _lock.acquire();
+    // Remove stale and flushed associations from one slice of the table per
+    // tick, sweeping the whole table once per TIMEOUT.
+    if (_timeout != 0) {
+	EtherAddress addr;
+	AddrInfo info;
+	int nslots = _table.slot_count();
+	for (int n = (nslots + _age_ticks - 1) / _age_ticks; n > 0; --n) {
+	    if (_sweep >= nslots)
+		_sweep = 0;
+	    if (_table.slot(_sweep, addr, info) && !live(info, tick))
+		_table.erase(addr);
+	    ++_sweep;
+	}
+	_table.reclaim();
     }
-  assert(sent == n - 1);
+    reclaim_port_states(false);
+    _lock.release();
+    _timer.reschedule_after_msec(_tick_msec ? _tick_msec : 1000);
 }
 
 void
-EtherSwitch::push(int source, Packet *p)
+EtherSwitch::set_port_states(const Vector<uint8_t> &states)
+{
+    if (states.size() != noutputs())
+	return;
+    uint8_t *x = new uint8_t[states.size()];
+    memcpy(x, states.begin(), states.size());
+    _lock.acquire();
+    if (uint8_t *old = _port_states) {
+	RetiredStates r;
+	r.states = old;
+	r.when = Timestamp::now_steady();
+	_retired_states.push_back(r);
+    }
+    click_fence();
+    _port_states = x;
+    _lock.release();
+}
+
+void
+EtherSwitch::reclaim_port_states(bool all)
+{
+    Timestamp limit = Timestamp::now_steady()
+	- Timestamp::make_msec(Table::grace_msec);
+    int i = 0;
+    for (; i < _retired_states.size()
+	     && (all || _retired_states[i].when <= limit); ++i)
+	delete[] _retired_states[i].states;
+    _retired_states.erase(_retired_states.begin(), _retired_states.begin() + i);
+}
+
+// Make every association learned on port stale.  run_timer() removes them.
+void
+EtherSwitch::flush_port(int port)
+{
+    if (port >= 0 && port < _flush_tick.size())
+	_flush_tick[port] = _tick;
+}
+
+// Send p to every output but source that is forwarding.
+void
+EtherSwitch::broadcast(int source, Packet *p, const uint8_t *states)
+{
+    assert((unsigned) source < (unsigned) noutputs());
+    int last = -1;
+    for (int i = 0; i < noutputs(); ++i)
+	if (i != source && (!states || states[i] == PORT_FORWARD))
+	    last = i;
+    for (int i = 0; i < last; ++i)
+	if (i != source && (!states || states[i] == PORT_FORWARD))
+	    if (Packet *pp = p->clone())
+		output(i).push(pp);
+    if (last >= 0)
+	output(last).push(p);
+    else
+	p->kill();
+}
+
+// Send every output but source that is forwarding one batch holding all n
+// packets.
+void
+EtherSwitch::broadcast_batch(int source, Packet **p, int n, const uint8_t *states)
+{
+    int last = -1;
+    for (int i = 0; i < noutputs(); ++i)
+	if (i != source && (!states || states[i] == PORT_FORWARD))
+	    last = i;
+    if (last < 0)
+	for (int j = 0; j < n; ++j)
+	    p[j]->kill();
+    for (int i = 0; i <= last; ++i)
+	if (i != source && (!states || states[i] == PORT_FORWARD)) {
+	    PacketBatch batch;
+	    for (int j = 0; j < n; ++j)
+		if (i == last)
+		    batch.push_back(p[j]);
+		else if (Packet *pp = p[j]->clone())
+		    batch.push_back(pp);
+	    output(i).push_batch(batch);
+	}
+}
+
+void
+EtherSwitch::learn(int source, const EtherAddress *addr, int n)
 {
-    click_ether* e = (click_ether*) p->data();
-    int outport = -1;		// Broadcast
+    uint32_t tick = _tick;
+    _lock.acquire();
+    for (int i = 0; i < n; ++i)
+	_table.set(addr[i], AddrInfo(source, tick));
+    _lock.release();
+}
 
+// Learn p's source address, or add it to lb to be learned later, and return
+// the output port for its destination, or -1 to broadcast.
+int
+EtherSwitch::route(int source, Packet *p, LearnBuffer *lb)
+{
     // 0 timeout means dumb switch
-    if (_timeout != 0) {
-	_table.set(EtherAddress(e->ether_shost), AddrInfo(source, p->timestamp_anno()));
-
-	// Set outport if dst is unicast, we have info about it, and the
-	// info is still valid.
-	EtherAddress dst(e->ether_dhost);
-	if (!dst.is_group()) {
-	    if (Table::iterator dst_info = _table.find(dst)) {
-		if (p->timestamp_anno() < dst_info.value().stamp + Timestamp(_timeout, 0))
-		    outport = dst_info.value().port;
-		else
-		    _table.erase(dst_info);
+    if (_timeout == 0)
+	return -1;
+
+    const click_ether *e = (const click_ether *) p->data();
+    uint32_t tick = _tick;
+    EtherAddress src(e->ether_shost);
+    AddrInfo info;
+    if (!_table.find(src, info) || info.port != source || info.tick != tick) {
+	if (!lb)
+	    learn(source, &src, 1);
+	else {
+	    int i = 0;
+	    while (i < lb->n && lb->addr[i] != src)
+		++i;
+	    if (i == lb->n) {
+		if (lb->n == LearnBuffer::capacity) {
+		    learn(source, lb->addr, lb->n);
+		    lb->n = 0;
+		}
+		lb->addr[lb->n++] = src;
 	    }
 	}
     }
 
-  if (outport < 0)
-    broadcast(source, p);
-  else if (outport == source)	// Don't send back out on same interface
-    p->kill();
-  else				// forward
-    output(outport).push(p);
+    // Set outport if dst is unicast, we have info about it, and the info is
+    // still valid.  Stale info is left for run_timer() to remove.
+    EtherAddress dst(e->ether_dhost);
+    if (!dst.is_group() && _table.find(dst, info) && live(info, tick))
+	return info.port;
+    return -1;
+}
+
+void
+EtherSwitch::push(int source, Packet *p)
+{
+    const uint8_t *states = _port_states;
+    if (states && states[source] != PORT_FORWARD) {
+	if (states[source] == PORT_LEARN)
+	    route(source, p);
+	p->kill();
+	return;
+    }
+
+    int outport = route(source, p);
+    if (outport < 0)
+	broadcast(source, p, states);
+    else if (outport == source	// Don't send back out on same interface
+	     || (states && states[outport] != PORT_FORWARD))
+	p->kill();
+    else			// forward
+	output(outport).push(p);
+}
+
+void
+EtherSwitch::push_batch(int source, PacketBatch &batch)
+{
+    enum { max_run = 32 };
+    Packet *p[max_run], *flood[max_run];
+    int outputs[max_run];
+    LearnBuffer lb;
+    // One snapshot of the port states serves the whole batch.
+    const uint8_t *states = _port_states;
+    bool forward = !states || states[source] == PORT_FORWARD;
+    if (!forward && states[source] != PORT_LEARN) {
+	batch.kill();
+	return;
+    }
+
+    while (!batch.empty()) {
+	int n = 0, nflood = 0;
+	for (; n < max_run && !batch.empty(); ++n) {
+	    p[n] = batch.pop_front();
+	    outputs[n] = route(source, p[n], &lb);
+	    if (forward && outputs[n] < 0)
+		flood[nflood++] = p[n];
+	    else if (!forward || outputs[n] == source
+		     || (states && states[outputs[n]] != PORT_FORWARD)) {
+		p[n]->kill();
+		outputs[n] = -1;
+	    }
+	}
+	if (lb.n) {
+	    learn(source, lb.addr, lb.n);
+	    lb.n = 0;
+	}
+	if (nflood)
+	    broadcast_batch(source, flood, nflood, states);
+	Classification::push_batch_by_output(this, p, outputs, n);
+    }
 }
 
 String
@@ -96,8 +289,11 @@ EtherSwitch::reader(Element* f, void *thunk)
     switch ((intptr_t) thunk) {
     case 0: {
 	StringAccum sa;
-	for (Table::iterator iter = sw->_table.begin(); iter.live(); iter++)
-	    sa << iter.key() << ' ' << iter.value().port << '\n';
+	EtherAddress addr;
+	AddrInfo info;
+	for (int i = 0; i < sw->_table.slot_count(); ++i)
+	    if (sw->_table.slot(i, addr, info))
+		sa << addr << ' ' << info.port << '\n';
 	return sa.take_string();
     }
     case 1:
@@ -111,8 +307,10 @@ int
 EtherSwitch::writer(const String &s, Element *e, void *, ErrorHandler *errh)
 {
     EtherSwitch *sw = (EtherSwitch *) e;
-    if (!SecondsArg().parse_saturating(s, sw->_timeout))
+    uint32_t timeout;
+    if (!SecondsArg().parse_saturating(s, timeout))
 	return errh->error("expected timeout (integer)");
+    sw->set_timeout(timeout);
     return 0;
 }
 
@@ -124,5 +322,7 @@ EtherSwitch::add_handlers()
     add_write_handler("timeout", writer, 0);
 }
 
+ELEMENT_REQUIRES(Classification)
 EXPORT_ELEMENT(EtherSwitch)
+ELEMENT_MT_SAFE(EtherSwitch)
 CLICK_ENDDECLS
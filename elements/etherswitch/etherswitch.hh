@@ -2,7 +2,10 @@
 #define CLICK_ETHERSWITCH_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/hashtable.hh>
+#include <click/rcuhashtable.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 /*
@@ -41,6 +44,37 @@ of inactivity.  If 0, the element acts like a dumb hub.  Default is 300.
 
 =back
 
+EtherSwitch may run on several threads at once.  Destination lookups take no
+locks and write no shared memory.  Learning a source address takes a lock only
+when the address is new, has moved to another port, or was last refreshed more
+than one aging tick earlier, so steady traffic learns without writes.
+
+Port associations age by a timer rather than by packet timestamps.  The timer
+ticks every quarter of TIMEOUT (at most every second), and each association
+records the tick at which it was last refreshed; one that has gone TIMEOUT
+worth of ticks without refreshing stops being used at once, and stale
+associations are removed a slice at a time, so that each timer tick holds
+the table lock briefly and the whole table is swept once every TIMEOUT.
+
+An EtherSpanTree element controlling the switch publishes its port states
+to it.  The states are kept in an array that EtherSpanTree replaces
+whole, with a single pointer store, whenever a state changes, so the
+forwarding threads read them without locks and see each batch switched
+under one consistent set of states.  Packets arriving on a port that is
+not forwarding are dropped, though a learning port still learns their
+source addresses; no packet is sent to a port that is not forwarding.
+When the topology changes, EtherSpanTree flushes the associations learned
+on the affected ports.  A flush only records the current aging tick for
+the port, which makes the port's older associations stale at once; the
+aging sweep removes them later, so a flush never walks the table.
+
+Batches of packets are switched together.  Destinations are looked up for a
+run of packets, source addresses that need learning are learned under one
+lock acquisition, and packets bound for the same output are pushed there as
+one batch.  Flooded packets are cloned, and clones share the original's
+data, so flooding costs a packet header per output rather than a copy of the
+packet.
+
 =n
 
 The EtherSwitch element has no limit on the memory consumed by cached Ethernet
@@ -70,23 +104,66 @@ class EtherSwitch : public Element { public:
   const char *flow_code() const			{ return "#/[^#]"; }
 
     int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
     void add_handlers();
 
   void push(int port, Packet* p);
+    void push_batch(int port, PacketBatch &batch);
 
     struct AddrInfo {
 	int port;
-	Timestamp stamp;
-	inline AddrInfo(int p, const Timestamp &t);
+	uint32_t tick;		// aging tick when last refreshed
+	inline AddrInfo();
+	inline AddrInfo(int p, uint32_t t);
+    };
+
+    void run_timer(Timer *);
+
+    // Port states as published by EtherSpanTree, in its order.
+    enum { PORT_BLOCK, PORT_LISTEN, PORT_LEARN, PORT_FORWARD };
+    void set_port_states(const Vector<uint8_t> &states);
+    void flush_port(int port);
+
+  protected:
+
+    // Source addresses waiting to be learned under one lock acquisition.
+    struct LearnBuffer {
+	enum { capacity = 32 };
+	EtherAddress addr[capacity];
+	int n;
+	LearnBuffer() : n(0) { }
     };
 
+    int route(int source, Packet *p, LearnBuffer *lb = 0);
+    void learn(int source, const EtherAddress *addr, int n);
+    void broadcast(int source, Packet *p, const uint8_t *states = 0);
+    void broadcast_batch(int source, Packet **p, int n, const uint8_t *states);
+
   private:
 
-    typedef HashTable<EtherAddress, AddrInfo> Table;
+    typedef RCUHashTable<EtherAddress, AddrInfo> Table;
     Table _table;
     uint32_t _timeout;
+    uint32_t _tick;		// current aging tick
+    uint32_t _tick_msec;	// aging tick length
+    uint32_t _age_ticks;	// ticks before an association goes stale
+    int _sweep;			// next slot for run_timer() to check
+    Vector<uint32_t> _flush_tick;	// per port: tick of the last flush
+    Spinlock _lock;
+    Timer _timer;
+
+    // Published port states, or null if no EtherSpanTree controls the
+    // switch.  Replaced arrays are freed after RCUHashTable's grace period.
+    uint8_t * volatile _port_states;
+    struct RetiredStates {
+	uint8_t *states;
+	Timestamp when;
+    };
+    Vector<RetiredStates> _retired_states;
 
-    void broadcast(int source, Packet*);
+    void set_timeout(uint32_t timeout);
+    inline bool live(const AddrInfo &info, uint32_t tick) const;
+    void reclaim_port_states(bool all);
 
     static String reader(Element *, void *);
     static int writer(const String &, Element *, void *, ErrorHandler *);
@@ -95,9 +172,24 @@ class EtherSwitch : public Element { public:
 };
 
 inline
-EtherSwitch::AddrInfo::AddrInfo(int p, const Timestamp& s)
-    : port(p), stamp(s)
+EtherSwitch::AddrInfo::AddrInfo()
+    : port(-1), tick(0)
+{
+}
+
+inline
+EtherSwitch::AddrInfo::AddrInfo(int p, uint32_t t)
+    : port(p), tick(t)
+{
+}
+
+// An association is live if it was refreshed within TIMEOUT and after its
+// port was last flushed.
+inline bool
+EtherSwitch::live(const AddrInfo &info, uint32_t tick) const
 {
+    return tick - info.tick < _age_ticks
+	&& (int32_t) (info.tick - _flush_tick[info.port]) > 0;
 }
 
 CLICK_ENDDECLS
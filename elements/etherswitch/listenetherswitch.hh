@@ -34,6 +34,9 @@ class ListenEtherSwitch : public EtherSwitch { public:
     const char *port_count() const		{ return "-/=+"; }
 
     void push(int port, Packet* p);
+    void push_batch(int port, PacketBatch &batch) {
+	Element::push_batch(port, batch);
+    }
 
 };
 
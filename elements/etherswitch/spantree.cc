@@ -20,15 +20,19 @@
 #include "spantree.hh"
 #include <click/args.hh>
 #include <click/etheraddress.hh>
+#include <click/straccum.hh>
 #include "elements/standard/suppressor.hh"
+#include "etherswitch.hh"
 #include <click/error.hh>
+#include <click/master.hh>
+#include <click/standard/scheduleinfo.hh>
 CLICK_DECLS
 
 EtherSpanTree::EtherSpanTree()
-  : _input_sup(0), _output_sup(0), _topology_change(0),
+  : _input_sup(0), _output_sup(0), _topology_change(0), _send_tc_msg(false),
     _bridge_priority(0xdead),	// Make it very unlikely to be root
-    _long_cache_timeout(5*60),
-    _hello_timer(hello_hook, this)
+    _long_cache_timeout(5*60), _states_changed(false),
+    _hello_timer(hello_hook, this), _thread(-1), _task(this)
 {
 }
 
@@ -46,22 +50,36 @@ EtherSpanTree::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read_mp("INPUT_SUPPRESSOR", ElementCastArg("Suppressor"), _input_sup)
 	.read_mp("OUTPUT_SUPPRESSOR", ElementCastArg("Suppressor"), _output_sup)
 	.read_mp("SWITCH", ElementCastArg("EtherSwitch"), _switch)
+	.read("THREAD", _thread)
 	.complete() < 0)
 	return -1;
 
+    if (_thread >= master()->nthreads())
+	return errh->error("THREAD out of range");
+    if (_switch->noutputs() != noutputs())
+	return errh->error("SWITCH has %d ports, but EtherSpanTree has %d", _switch->noutputs(), noutputs());
     memcpy(&_bridge_id, _addr, 6);
     return 0;
 }
 
 int
-EtherSpanTree::initialize(ErrorHandler *)
+EtherSpanTree::initialize(ErrorHandler *errh)
 {
   for (int i = 0; i < _port.size(); i++) {
     set_state(i, FORWARD);
   }
+  publish();
   _best.reset(((uint64_t)_bridge_priority << 48) | _bridge_id);
   _hello_timer.initialize(this);
-  _hello_timer.schedule_after_msec(_best._hello_time * 1000);
+  if (_thread >= 0) {
+    ScheduleInfo::initialize_task(this, &_task, false, errh);
+    _task.set_stealable(false);
+    _task.move_thread(_thread);
+    _hello_timer.assign(&_task);
+    _next_hello = Timestamp::now_steady() + Timestamp::make_msec(_best._hello_time * 1000);
+    _hello_timer.schedule_at_steady(_next_hello);
+  } else
+    _hello_timer.schedule_after_msec(_best._hello_time * 1000);
   return 0;
 }
 
@@ -76,10 +94,22 @@ EtherSpanTree::read_msgs(Element* f, void *) {
   return s;
 }
 
+String
+EtherSpanTree::read_port_states(Element *f, void *)
+{
+  static const char * const names[] = { "block", "listen", "learn", "forward" };
+  EtherSpanTree *sw = (EtherSpanTree *) f;
+  StringAccum sa;
+  for (int i = 0; i < sw->_port.size(); i++)
+    sa << (i ? " " : "") << names[sw->_port[i].state];
+  return sa.take_string();
+}
+
 void
 EtherSpanTree::add_handlers()
 {
   add_read_handler("msgs", read_msgs, 0);
+  add_read_handler("port_states", read_port_states, 0);
 }
 
 void
@@ -162,11 +192,13 @@ EtherSpanTree::set_state(int i, PortState state)
   if (_port[i].state == state)
     return false;
 
+  bool topology_change = true;
   if (state == FORWARD) {
     if (_port[i].state == BLOCK) {
       click_chatter("Setting send_tc_msg: BLOCK -> FORWARD on %d", i);
       _send_tc_msg = true;
-    }
+    } else
+      topology_change = false;
     // Can't go there directly, just increment
     state = (PortState)(_port[i].state+1);
   } else {
@@ -175,11 +207,14 @@ EtherSpanTree::set_state(int i, PortState state)
     click_chatter("Setting send_tc_msg: FORWARD -> BLOCK on %d", i);
     _send_tc_msg = true;
   }
+  if (topology_change)
+    flush();
 
   click_chatter("Changing port %d from %d to %d", i, _port[i].state, state);
 
   _port[i].state = state;
   _port[i].since = Timestamp::now();
+  _states_changed = true;
 
 
   switch (state) {
@@ -202,8 +237,29 @@ EtherSpanTree::set_state(int i, PortState state)
 }
 
 
+// Flush the switch's address associations on every port.
 void
-EtherSpanTree::push(int source, Packet* p) {
+EtherSpanTree::flush()
+{
+  for (int i = 0; i < _port.size(); i++)
+    _switch->flush_port(i);
+}
+
+// Publish the port states to the switch if any changed.
+void
+EtherSpanTree::publish()
+{
+  if (!_states_changed)
+    return;
+  _states_changed = false;
+  Vector<uint8_t> states(_port.size(), 0);
+  for (int i = 0; i < _port.size(); i++)
+    states[i] = _port[i].state;
+  _switch->set_port_states(states);
+}
+
+void
+EtherSpanTree::receive(int source, Packet* p) {
   const BridgeMessage::wire* msg =
     reinterpret_cast<const BridgeMessage::wire*>(p->data());
 
@@ -212,6 +268,9 @@ EtherSpanTree::push(int source, Packet* p) {
   int cmp = _port[source].msg.compare(msg);
 
   if (cmp <= 0) {
+    // The root announces a topology change; flush once as it begins.
+    if (msg->tc && !_port[source].msg.tc())
+      flush();
     _port[source].msg.from_wire(msg);
     _send_tc_msg &= !msg->tca; // Stop sending tc if this is an ack.
   }
@@ -221,15 +280,62 @@ EtherSpanTree::push(int source, Packet* p) {
   p->kill();
 }
 
+void
+EtherSpanTree::push(int source, Packet* p) {
+  if (_thread < 0) {
+    receive(source, p);
+    publish();
+    return;
+  }
+
+  _inbox_lock.acquire();
+  _inbox.push_back(p);
+  _inbox_port.push_back(source);
+  _inbox_lock.release();
+  _task.reschedule();
+}
+
+bool
+EtherSpanTree::run_task(Task *)
+{
+  Vector<Packet *> inbox;
+  Vector<int> inbox_port;
+  _inbox_lock.acquire();
+  inbox.swap(_inbox);
+  inbox_port.swap(_inbox_port);
+  _inbox_lock.release();
+
+  for (int i = 0; i < inbox.size(); i++)
+    receive(inbox_port[i], inbox[i]);
+
+  Timestamp now = Timestamp::now_steady();
+  bool hello_due = now >= _next_hello;
+  if (hello_due) {
+    hello();
+    _next_hello = now + Timestamp::make_msec(_best._hello_time * 1000);
+    _hello_timer.schedule_at_steady(_next_hello);
+  }
+
+  publish();
+  return inbox.size() || hello_due;
+}
+
+void
+EtherSpanTree::hello()
+{
+  periodic();
+  for (int i = 0; i < noutputs(); i++) {
+    Packet* p = generate_packet(i);
+    if (p) output(i).push(p);
+  }
+}
+
 void
 EtherSpanTree::hello_hook(Timer *, void *thunk)
 {
   EtherSpanTree *e = (EtherSpanTree *)thunk;
-  e->periodic();
-  for (int i = 0; i < e->noutputs(); i++) {
-    Packet* p = e->generate_packet(i);
-    if (p) e->output(i).push(p);
-  }
+  e->hello();
+  e->publish();
   e->_hello_timer.schedule_after_msec(e->_best._hello_time * 1000);
 }
 
@@ -286,4 +392,5 @@ EtherSpanTree::generate_packet(int output)
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(EtherSpanTree)
-ELEMENT_REQUIRES(Suppressor EtherSwitchBridgeMessage)
+ELEMENT_REQUIRES(Suppressor EtherSwitch EtherSwitchBridgeMessage)
+ELEMENT_MT_SAFE(EtherSpanTree)
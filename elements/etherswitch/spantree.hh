@@ -3,6 +3,8 @@
 #include <click/element.hh>
 #include "bridgemessage.hh"
 #include <click/timer.hh>
+#include <click/task.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 class Suppressor;
 class EtherSwitch;
@@ -10,7 +12,7 @@ class EtherSwitch;
 /**
 =c
 
-EtherSpanTree(ADDR, INPUT_SUPPRESSOR, OUTPUT_SUPPRESSOR, SWITCH)
+EtherSpanTree(ADDR, INPUT_SUPPRESSOR, OUTPUT_SUPPRESSOR, SWITCH [, I<keywords> THREAD])
 
 =s ethernet
 
@@ -29,6 +31,31 @@ and downstream of the SWITCH.  The EtherSpanTree, Suppressor, and EtherSwitch
 elements should all have the same numbers of inputs and outputs, equal to the
 number of ports in the switch.
 
+Whenever a port changes state, EtherSpanTree publishes the states of all
+ports to SWITCH, which stops forwarding to and from ports that are not
+forwarding without taking locks (see EtherSwitch).  On a topology change,
+whether found locally or announced by the root, EtherSpanTree flushes
+SWITCH's address associations; the flush costs a few stores, however large
+the table.
+
+By default, EtherSpanTree handles control packets as they are pushed to
+it, and sends its hello messages from a timer, on the thread that pushes
+them and on its home thread.  With THREAD, all spanning tree processing
+moves to that thread: control packets pushed to EtherSpanTree are queued
+and handled there, and hello messages are sent from there, so the
+forwarding threads never run the spanning tree algorithm.
+
+Keyword arguments are:
+
+=over 8
+
+=item THREAD
+
+Integer.  The thread that runs spanning tree processing.  Default is to
+run it inline, as described above.
+
+=back
+
 =e
 
   from_port0, from_port1 :: FromDevice...;
@@ -50,6 +77,16 @@ number of ports in the switch.
   c0 [1] -> [0] in_supp [0] -> [0] switch [0] -> [0] out_supp [0] -> q0;
   c1 [1] -> [1] in_supp [1] -> [1] switch [1] -> [1] out_supp [1] -> q1;
 
+=h msgs read-only
+
+Returns the best message received on each port, and this bridge's best
+message.
+
+=h port_states read-only
+
+Returns the state of each port, separated by spaces: C<block>, C<listen>,
+C<learn>, or C<forward>.
+
 =a
 
 EtherSwitch, Suppressor
@@ -68,16 +105,19 @@ public:
   int initialize(ErrorHandler *);
 
   static String read_msgs(Element* f, void *);
+  static String read_port_states(Element *f, void *);
   void add_handlers();
 
 
   void periodic();
+  void hello();
 
   bool expire();
   void find_best();
   void find_tree();		// Returns true iff there is a change
 
   void push(int port, Packet* p);
+  bool run_task(Task *);
   Packet* generate_packet(int output);
 
 private:
@@ -97,7 +137,8 @@ private:
   BridgeMessage _best;
 
 
-  // Do not change the order of the PortState enum tags.  (see set_state())
+  // Do not change the order of the PortState enum tags.  (see set_state()
+  // and EtherSwitch::PORT_BLOCK)
   enum PortState {BLOCK, LISTEN, LEARN, FORWARD};
   struct PortInfo {
     PortState state;
@@ -108,12 +149,25 @@ private:
   };
 
   bool set_state(int i, PortState state); // Only expects BLOCK or FORWARD
+  void receive(int port, Packet *p);
+  void flush();
+  void publish();
 
   Vector<PortInfo> _port;
+  bool _states_changed;		// If true, publish() has work to do.
 
   Timer _hello_timer;
   static void hello_hook(Timer *, void *);
 
+  // With THREAD, control packets wait in the inbox for _task, which runs
+  // on thread _thread.  _hello_timer then just schedules _task.
+  int _thread;
+  Task _task;
+  Timestamp _next_hello;
+  SimpleSpinlock _inbox_lock;
+  Vector<Packet *> _inbox;
+  Vector<int> _inbox_port;
+
 };
 
 CLICK_ENDDECLS
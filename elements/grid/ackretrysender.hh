@@ -69,6 +69,7 @@ public:
   ~ACKRetrySender();
 
   const char *class_name() const { return "ACKRetrySender"; }
+  const char *flags() const      { return "T"; }
   const char *port_count() const { return "-/-"; }
   const char *processing() const { return "la/hh"; }
   const char *flow_code()  const { return "xy/xx"; }
@@ -99,6 +99,7 @@ public:
   ~ACKRetrySender2();
 
   const char *class_name() const { return "ACKRetrySender2"; }
+  const char *flags() const      { return "T"; }
   const char *port_count() const { return "-/-"; }
   const char *processing() const { return "la/hh"; }
   const char *flow_code()  const { return "xy/xx"; }
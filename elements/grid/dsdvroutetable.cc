@@ -62,24 +62,24 @@ DSDVRouteTable::lookup_route(const IPAddress &dest_ip, RTEntry &entry)
 {
 #if ENABLE_PAUSE
   if (_paused) {
-    RTEntry *r =_snapshot_rtes.findp(dest_ip);
+    RTEntry *r =_snapshot_rtes.get_pointer(dest_ip);
     if (r == 0)
       return false;
 #if USE_OLD_SEQ
     if (use_old_route(dest_ip, _snapshot_jiffies))
-      r = _snapshot_old_rtes.findp(dest_ip);
+      r = _snapshot_old_rtes.get_pointer(dest_ip);
 #endif
     entry = *r;
     return true;
   }
 #endif
 
-  RTEntry *r = _rtes.findp(dest_ip);
+  RTEntry *r = _rtes.get_pointer(dest_ip);
   if (r == 0)
     return false;
 #if USE_OLD_SEQ
   if (use_old_route(dest_ip, dsdv_jiffies()))
-    r = _old_rtes.findp(dest_ip);
+    r = _old_rtes.get_pointer(dest_ip);
 #endif
   entry = *r;
   return true;
@@ -94,7 +94,7 @@ DSDVRouteTable::get_all_entries(Vector<RouteEntry> &vec)
       const RTEntry &rte = iter.value();
 #if USE_OLD_SEQ
       if (use_old_route(rte.dest_ip, _snapshot_jiffies))
-	vec.push_back(_snapshot_old_rtes[rte.dest_ip]);
+	vec.push_back(_snapshot_old_rtes.get(rte.dest_ip));
       else
 	vec.push_back(rte);
 #else
@@ -112,7 +112,7 @@ DSDVRouteTable::get_all_entries(Vector<RouteEntry> &vec)
     const RTEntry &rte = iter.value();
 #if USE_OLD_SEQ
     if (use_old_route(rte.dest_ip, jiff))
-      vec.push_back(_old_rtes[rte.dest_ip]);
+      vec.push_back(_old_rtes.get(rte.dest_ip));
     else
       vec.push_back(rte);
 #else
@@ -138,6 +138,21 @@ DSDVRouteTable::get_number_direct_neigbors()
   return num_nbrs;
 }
 
+const GridLocationIndex *
+DSDVRouteTable::location_index() const
+{
+  // the index follows _rtes, not the snapshot or the old routes
+#if ENABLE_PAUSE
+  if (_paused)
+    return 0;
+#endif
+#if USE_OLD_SEQ
+  if (_use_old_route)
+    return 0;
+#endif
+  return &_loc_index;
+}
+
 
 #if USE_OLD_SEQ
 bool
@@ -146,12 +161,12 @@ DSDVRouteTable::use_old_route(const IPAddress &dst, unsigned jiff)
   if (!_use_old_route)
     return false;
 
-  RTEntry *real = _rtes.findp(dst);
-  RTEntry *old = _old_rtes.findp(dst);
+  RTEntry *real = _rtes.get_pointer(dst);
+  RTEntry *old = _old_rtes.get_pointer(dst);
 #if ENABLE_PAUSE
   if (_paused) {
-    real = _snapshot_rtes.findp(dst);
-    old = _snapshot_old_rtes.findp(dst);
+    real = _snapshot_rtes.get_pointer(dst);
+    old = _snapshot_old_rtes.get_pointer(dst);
   }
 #endif
 #if USE_GOOD_NEW_ROUTES
@@ -170,6 +185,7 @@ DSDVRouteTable::DSDVRouteTable() :
 #if SEQ_METRIC
   _use_seq_metric(false),
 #endif
+  _wheel_cursor(0), _wheel_next(0),
   _gw_info(0), _metric(0), _log(0),
   _seq_no(0), _mtu(2000), _bcast_count(0),
   _max_hops(3), _alpha(88), _wst0(6000),
@@ -178,27 +194,13 @@ DSDVRouteTable::DSDVRouteTable() :
   _ignore_invalid_routes(false),
   _hello_timer(static_hello_hook, this),
   _log_dump_timer(static_log_dump_hook, this),
+  _wheel_timer(static_wheel_hook, this),
   _verbose(true)
 {
 }
 
 DSDVRouteTable::~DSDVRouteTable()
 {
-
-  for (TMIter i = _expire_timers.begin(); i.live(); i++) {
-    if (i.value()->scheduled())
-      i.value()->unschedule();
-    delete i.value();
-  }
-  for (TMIter i = _trigger_timers.begin(); i.live(); i++) {
-    if (i.value()->scheduled())
-      i.value()->unschedule();
-    delete i.value();
-  }
-  for (HMIter i = _expire_hooks.begin(); i.live(); i++)
-    delete i.value();
-  for (HMIter i = _trigger_hooks.begin(); i.live(); i++)
-    delete i.value();
 }
 
 void *
@@ -286,6 +288,8 @@ DSDVRouteTable::initialize(ErrorHandler *)
   _hello_timer.schedule_after_msec(_period);
   _log_dump_timer.initialize(this);
   _log_dump_timer.schedule_after_msec(_log_dump_period);
+  _wheel_timer.initialize(this);
+  _wheel_cursor = dsdv_jiffies();
 
   check_invariants();
 #if ENABLE_PAUSE
@@ -342,50 +346,37 @@ DSDVRouteTable::insert_route(const RTEntry &r, const GridGenericLogger::reason_t
 
   dsdv_assert(!_ignore_invalid_routes || r.metric.good());
 
-  RTEntry *old_r = _rtes.findp(r.dest_ip);
+  RTEntry *old_r = _rtes.get_pointer(r.dest_ip);
 
-  // invariant check: running timers exist for all current good
-  // routes.  no timers or bogus timer entries exist for bad routes.
-  // hook objects exist for each timer.
-  Timer **old = _expire_timers.findp(r.dest_ip);
-  HookPair **oldhp = _expire_hooks.findp(r.dest_ip);
-  if (old_r && old_r->good())
-    dsdv_assert(old && *old && (*old)->scheduled() && oldhp && *oldhp);
-  else {
-    dsdv_assert(old == 0);
-    dsdv_assert(oldhp == 0);
-  }
+  // invariant check: expire deadlines exist for all current good
+  // routes, and not for bad routes.
+  bool old = has_deadline(r.dest_ip, false);
+  dsdv_assert(old == (old_r && old_r->good()));
 
-  // get rid of old expire timer
-  if (old) {
-    (*old)->unschedule();
-    delete *old;
-    delete *oldhp;
-    _expire_timers.remove(r.dest_ip);
-    _expire_hooks.remove(r.dest_ip);
-  }
+  // get rid of old expire deadline
+  if (old)
+    cancel_deadline(r.dest_ip, false);
 
   // Note: ns dsdv only schedules a timeout for the sender of each
   // route ad, relying on the next-hop expiry logic to get all routes
   // via that next hop.  However, that won't work for general metrics,
   // so we install a timeout for *every* newly installed good route.
-  if (r.good()) {
-    HookPair *hp = new HookPair(this, r.dest_ip);
-    Timer *t = new Timer(static_expire_hook, (void *) hp);
-    t->initialize(this);
-    t->schedule_after_msec(GRID_MIN(r.ttl, _timeout));
-
-    _expire_timers.insert(r.dest_ip, t);
-    _expire_hooks.insert(r.dest_ip, hp);
-  }
+  if (r.good())
+    set_deadline(r.dest_ip, false, dsdv_jiffies() + msec_to_jiff(GRID_MIN(r.ttl, _timeout)));
 
 #if USE_OLD_SEQ
   // if we are getting new seqno, save route for old seqno
   if (old_r && old_r->seq_no() < r.seq_no())
-    _old_rtes.insert(r.dest_ip, *old_r);
+    _old_rtes.set(r.dest_ip, *old_r);
 #endif
 
-  _rtes.insert(r.dest_ip, r);
+  _rtes.set(r.dest_ip, r);
+  if (r.need_seq_ad || r.need_metric_ad)
+    _pending_ads.set(r.dest_ip, true);
+  if (r.loc_good)
+    _loc_index.set(r.dest_ip, r.dest_loc);
+  else
+    _loc_index.remove(r.dest_ip);
 
   // note, we don't change any pending triggered update for this
   // updated dest.  ... but shouldn't we postpone it?  -- shouldn't
@@ -404,17 +395,14 @@ DSDVRouteTable::expire_hook(const IPAddress &ip)
 
   // invariant check:
   // 1. route to expire should exist
-  RTEntry *r = _rtes.findp(ip);
+  RTEntry *r = _rtes.get_pointer(ip);
   dsdv_assert(r != 0);
 
   // 2. route to expire should be good
   dsdv_assert(r->good() && (r->seq_no() & 1) == 0);
 
-  // 3. the expire timer for this dest should exist, but should not be
-  // running.
-  Timer **old = _expire_timers.findp(ip);
-  HookPair **oldhp = _expire_hooks.findp(ip);
-  dsdv_assert(old && *old && !(*old)->scheduled() && oldhp && *oldhp);
+  // 3. the expire deadline for this dest should exist.
+  dsdv_assert(has_deadline(ip, false));
 
   if (_log) {
     _log->log_start_expire_handler(Timestamp::now());
@@ -455,33 +443,20 @@ DSDVRouteTable::expire_hook(const IPAddress &ip)
   unsigned int jiff = dsdv_jiffies();
 
   for (int i = 0; i < expired_dests.size(); i++) {
-    RTEntry *r = _rtes.findp(expired_dests[i]);
+    RTEntry *r = _rtes.get_pointer(expired_dests[i]);
     dsdv_assert(r);
 
-    // invariant check:
-    // 1. route to expire must be good, and thus should have existing
-    // expire timer and hook object.
-    Timer **exp_timer = _expire_timers.findp(r->dest_ip);
-    dsdv_assert(exp_timer && *exp_timer);
-    HookPair **hp = _expire_hooks.findp(r->dest_ip);
-    dsdv_assert(hp && *hp);
-
-    // 2. that existing timer should still be scheduled, except for
-    // the timer whose expiry called this hook
-    dsdv_assert(r->dest_ip != ip ? (*exp_timer)->scheduled() : true);
-
-    // cleanup pending timers
-    if ((*exp_timer)->scheduled())
-      (*exp_timer)->unschedule();
-    delete *exp_timer;
-    delete *hp;
-    _expire_timers.remove(r->dest_ip);
-    _expire_hooks.remove(r->dest_ip);
+    // invariant check: route to expire must be good, and thus should
+    // have an expire deadline.
+    dsdv_assert(has_deadline(r->dest_ip, false));
+
+    // cleanup pending deadline
+    cancel_deadline(r->dest_ip, false);
 
     // mark route as broken
     r->invalidate(jiff);
 #if USE_OLD_SEQ
-    RTEntry *old_r = _old_rtes.findp(r->dest_ip);
+    RTEntry *old_r = _old_rtes.get_pointer(r->dest_ip);
     if (old_r && old_r->good())
       old_r->invalidate(jiff);
 #endif
@@ -501,28 +476,130 @@ DSDVRouteTable::expire_hook(const IPAddress &ip)
 }
 
 void
-DSDVRouteTable::schedule_triggered_update(const IPAddress &ip, unsigned int when)
+DSDVRouteTable::set_deadline(const IPAddress &ip, bool trigger, unsigned int when)
 {
-  check_invariants();
+  Deadlines &d = _deadlines.find_insert(ip).value();
+  if (trigger) {
+    d.trigger = true;
+    d.trigger_jiffies = when;
+  } else {
+    d.expire = true;
+    d.expire_jiffies = when;
+  }
+
+  // deadlines that have already passed go in the next slot to be run
+  unsigned int slot = GRID_MAX(when, _wheel_cursor) >> wheel_shift;
+  _wheel[slot & (wheel_size - 1)].push_back(ip);
 
-  // get rid of outstanding triggered request (if any)
-  Timer **old = _trigger_timers.findp(ip);
-  HookPair **oldhp = _trigger_hooks.findp(ip);
-  if (old) {
-    dsdv_assert(*old && (*old)->scheduled() && oldhp && *oldhp);
-    (*old)->unschedule();
-    delete *old;
-    delete *oldhp;
+  if (!_wheel_timer.scheduled() || when < _wheel_next) {
+    _wheel_next = when;
+    _wheel_timer.schedule_at(Timestamp::make_jiffies((click_jiffies_t) when));
   }
+}
+
+void
+DSDVRouteTable::cancel_deadline(const IPAddress &ip, bool trigger)
+{
+  DTable::iterator i = _deadlines.find(ip);
+  if (!i)
+    return;
+  if (trigger)
+    i.value().trigger = false;
+  else
+    i.value().expire = false;
+  if (!i.value().trigger && !i.value().expire)
+    _deadlines.erase(i);
+}
 
-  // set up new timer
-  HookPair *hp = new HookPair(this, ip);
-  Timer *t = new Timer(static_trigger_hook, (void *) hp);
-  t->initialize(this);
+bool
+DSDVRouteTable::has_deadline(const IPAddress &ip, bool trigger) const
+{
+  DTIter i = _deadlines.find(ip);
+  return i && (trigger ? i.value().trigger : i.value().expire);
+}
+
+void
+DSDVRouteTable::wheel_hook()
+{
   unsigned int jiff = dsdv_jiffies();
-  t->schedule_after_msec(jiff_to_msec(jiff > when ? 0 : when - jiff));
-  _trigger_timers.insert(ip, t);
-  _trigger_hooks.insert(ip, hp);
+
+  // collect destinations with deadlines due, running each slot from the
+  // cursor's through the current one; keep entries for later
+  // revolutions in their slots
+  Vector<IPAddress> due;
+  unsigned int slot = _wheel_cursor >> wheel_shift;
+  for (int n = 0; slot <= (jiff >> wheel_shift) && n < wheel_size; slot++, n++) {
+    Vector<IPAddress> &list = _wheel[slot & (wheel_size - 1)];
+    Vector<IPAddress> keep;
+    for (int i = 0; i < list.size(); i++) {
+      DTIter d = _deadlines.find(list[i]);
+      if (!d)
+	continue;
+      const Deadlines &dl = d.value();
+      if ((dl.expire && dl.expire_jiffies <= jiff)
+	  || (dl.trigger && dl.trigger_jiffies <= jiff))
+	due.push_back(list[i]);
+      else if ((dl.expire && ((dl.expire_jiffies >> wheel_shift) & (wheel_size - 1)) == (slot & (wheel_size - 1)))
+	       || (dl.trigger && ((dl.trigger_jiffies >> wheel_shift) & (wheel_size - 1)) == (slot & (wheel_size - 1))))
+	keep.push_back(list[i]);
+    }
+    list.swap(keep);
+  }
+  _wheel_cursor = jiff;
+
+  // run them; a hook may change any destination's deadlines
+  for (int i = 0; i < due.size(); i++) {
+    DTIter d = _deadlines.find(due[i]);
+    if (d && d.value().expire && d.value().expire_jiffies <= jiff)
+      expire_hook(due[i]);
+    d = _deadlines.find(due[i]);
+    if (d && d.value().trigger && d.value().trigger_jiffies <= jiff)
+      trigger_hook(due[i]);
+  }
+
+  // schedule for the earliest deadline within a revolution, or a
+  // revolution ahead if there is none
+  if (_deadlines.empty()) {
+    _wheel_timer.unschedule();
+    return;
+  }
+  jiff = dsdv_jiffies();
+  unsigned int next = 0;
+  bool found = false;
+  slot = _wheel_cursor >> wheel_shift;
+  for (int n = 0; n < wheel_size && !found; slot++, n++) {
+    const Vector<IPAddress> &list = _wheel[slot & (wheel_size - 1)];
+    unsigned int slot_end = (slot + 1) << wheel_shift;
+    for (int i = 0; i < list.size(); i++) {
+      DTIter d = _deadlines.find(list[i]);
+      if (!d)
+	continue;
+      const Deadlines &dl = d.value();
+      if (dl.expire && dl.expire_jiffies < slot_end && (!found || dl.expire_jiffies < next)) {
+	next = dl.expire_jiffies;
+	found = true;
+      }
+      if (dl.trigger && dl.trigger_jiffies < slot_end && (!found || dl.trigger_jiffies < next)) {
+	next = dl.trigger_jiffies;
+	found = true;
+      }
+    }
+  }
+  if (!found)
+    next = _wheel_cursor + (wheel_size << wheel_shift);
+  _wheel_next = GRID_MAX(next, jiff);
+  _wheel_timer.schedule_at(Timestamp::make_jiffies((click_jiffies_t) _wheel_next));
+}
+
+void
+DSDVRouteTable::schedule_triggered_update(const IPAddress &ip, unsigned int when)
+{
+  check_invariants();
+
+  // replace outstanding triggered request (if any)
+  unsigned int jiff = dsdv_jiffies();
+  set_deadline(ip, true, GRID_MAX(when, jiff));
+  _pending_ads.set(ip, true);
 
   check_invariants();
 }
@@ -532,11 +609,8 @@ DSDVRouteTable::trigger_hook(const IPAddress &ip)
 {
   check_invariants(&ip);
 
-  // invariant: the trigger timer must exist for this dest, but must
-  // not be running
-  Timer **old = _trigger_timers.findp(ip);
-  HookPair **oldhp = _trigger_hooks.findp(ip);
-  dsdv_assert(old && *old && !(*old)->scheduled() && oldhp && *oldhp);
+  // invariant: the trigger deadline must exist for this dest
+  dsdv_assert(has_deadline(ip, true));
 
   unsigned int jiff = dsdv_jiffies();
   unsigned int next_trigger_jiff = _last_triggered_update + msec_to_jiff(_min_triggered_update_period);
@@ -546,11 +620,8 @@ DSDVRouteTable::trigger_hook(const IPAddress &ip)
 #endif
 
   if (jiff >= next_trigger_jiff) {
-    // It's ok to send a triggered update now.  Cleanup expired timer.
-    delete *old;
-    delete *oldhp;
-    _trigger_timers.remove(ip);
-    _trigger_hooks.remove(ip);
+    // It's ok to send a triggered update now.  Cleanup expired deadline.
+    cancel_deadline(ip, true);
 
     send_triggered_update(ip);
 #if DBG
@@ -564,34 +635,22 @@ DSDVRouteTable::trigger_hook(const IPAddress &ip)
     // it's too early to send this update, so cancel all oustanding
     // triggered updates that would also be too early
     Vector<IPAddress> remove_list;
-    for (TMIter i = _trigger_timers.begin(); i.live(); i++) {
-      if (i.key() == ip)
-	continue; // don't touch this timer, we'll reschedule it
-
-
-      Timer *old2 = i.value();
-      dsdv_assert(old2 && old2->scheduled());
+    for (DTIter i = _deadlines.begin(); i.live(); i++) {
+      if (i.key() == ip || !i.value().trigger)
+	continue; // don't touch this deadline, we'll reschedule it
 
-      HookPair **oldhp = _trigger_hooks.findp(i.key());
-      dsdv_assert(oldhp && *oldhp);
-
-      RTEntry *r = _rtes.findp(i.key());
-      if (r->advertise_ok_jiffies < next_trigger_jiff) {
-	delete old2;
-	delete *oldhp;
+      RTEntry *r = _rtes.get_pointer(i.key());
+      if (r->advertise_ok_jiffies < next_trigger_jiff)
 	remove_list.push_back(i.key());
-      }
     }
 
-    for (int i = 0; i < remove_list.size(); i++) {
-      _trigger_timers.remove(remove_list[i]);
-      _trigger_hooks.remove(remove_list[i]);
-    }
+    for (int i = 0; i < remove_list.size(); i++)
+      cancel_deadline(remove_list[i], true);
 
-    // reschedule this timer to earliest possible time -- when it
-    // fires, its update will also include updates that would have
-    // fired before then but were cancelled just above.
-    (*old)->schedule_after_msec(jiff_to_msec(next_trigger_jiff - jiff));
+    // reschedule this deadline to earliest possible time -- when it
+    // comes due, its update will also include updates that would have
+    // been due before then but were cancelled just above.
+    set_deadline(ip, true, next_trigger_jiff);
   }
 
   check_invariants();
@@ -606,7 +665,7 @@ DSDVRouteTable::init_metric(RTEntry &r)
 #if SEQ_METRIC
   if (_use_seq_metric) {
     r.metric = metric_t(r.num_hops());
-    Deque<unsigned> *q = _seq_history.findp(r.dest_ip);
+    Deque<unsigned> *q = _seq_history.get_pointer(r.dest_ip);
     if (!q || q->size() < MAX_BCAST_HISTORY)
       r.metric = _bad_metric;
     else {
@@ -671,7 +730,7 @@ DSDVRouteTable::update_metric(RTEntry &r)
 {
   dsdv_assert(r.num_hops() > 1);
 
-  RTEntry *next_hop = _rtes.findp(r.next_hop_ip);
+  RTEntry *next_hop = _rtes.get_pointer(r.next_hop_ip);
   if (!next_hop) {
     click_chatter("DSDVRouteTable %s: ERROR updating metric for %s; no information for next hop %s; invalidating metric",
 		  name().c_str(), r.dest_ip.unparse().c_str(), r.next_hop_ip.unparse().c_str());
@@ -788,7 +847,7 @@ DSDVRouteTable::send_full_update()
 
     ad_routes.push_back(routes[i]);
 
-    RTEntry *r = _rtes.findp(routes[i].dest_ip);
+    RTEntry *r = _rtes.get_pointer(routes[i].dest_ip);
     dsdv_assert(r);
     r->need_seq_ad = false;
     r->need_metric_ad = false;
@@ -818,18 +877,21 @@ DSDVRouteTable::send_triggered_update(const IPAddress &ip)
   // prompted this trigger.  There ought to be since we never actually
   // take entries out of the route table; we only mark them as
   // expired.
-  RTEntry *r = _rtes.findp(ip);
+  RTEntry *r = _rtes.get_pointer(ip);
   dsdv_assert(r);
 
   unsigned int jiff = dsdv_jiffies();
 
   Vector<RTEntry> triggered_routes;
-  for (RTIter i = _rtes.begin(); i.live(); i++) {
-    const RTEntry &r = i.value();
-
-    if ((r.need_seq_ad || r.need_metric_ad) &&
-	r.advertise_ok_jiffies <= jiff)
-      triggered_routes.push_back(r);
+  for (HashTable<IPAddress, bool>::iterator i = _pending_ads.begin(); i.live(); ) {
+    const RTEntry *r = _rtes.get_pointer(i.key());
+    if (!r || !(r->need_seq_ad || r->need_metric_ad))
+      i = _pending_ads.erase(i);
+    else {
+      if (r->advertise_ok_jiffies <= jiff)
+	triggered_routes.push_back(*r);
+      ++i;
+    }
   }
 #if FULL_DUMP_ON_TRIG_UPDATE
   // ns implementation of dsdv has this ``heuristic'' to decide when
@@ -856,7 +918,7 @@ DSDVRouteTable::send_triggered_update(const IPAddress &ip)
 
     ad_routes.push_back(triggered_routes[i]);
 
-    RTEntry *r = _rtes.findp(triggered_routes[i].dest_ip);
+    RTEntry *r = _rtes.get_pointer(triggered_routes[i].dest_ip);
     dsdv_assert(r);
     r->need_seq_ad = false; // XXX why not reset need_metric_ad flag as well?
     r->last_adv_metric = r->metric;
@@ -888,7 +950,7 @@ DSDVRouteTable::handle_update(RTEntry new_r, const bool was_sender, const unsign
     return false; // don't keep routes with invalid metrics
 
 
-  RTEntry *old_r = _rtes.findp(new_r.dest_ip);
+  RTEntry *old_r = _rtes.get_pointer(new_r.dest_ip);
   update_wst(old_r, new_r, jiff);
 
   // If the new route is good, and the old route (if any) was good,
@@ -1036,7 +1098,7 @@ DSDVRouteTable::simple_action(Packet *packet)
   }
 
   // maybe add new route for message transmitter, sanity check existing entry
-  RTEntry *r = _rtes.findp(ipaddr);
+  RTEntry *r = _rtes.get_pointer(ipaddr);
   if (!r)
     click_chatter("DSDVRouteTable %s: new 1-hop nbr %s -- %s",
 		  name().c_str(), ipaddr.unparse().c_str(), ethaddr.unparse().c_str());
@@ -1046,10 +1108,10 @@ DSDVRouteTable::simple_action(Packet *packet)
 
 #if SEQ_METRIC
   // track last few broadcast numbers we heard directly from this node
-  Deque<unsigned> *q = _seq_history.findp(ipaddr);
+  Deque<unsigned> *q = _seq_history.get_pointer(ipaddr);
   if (!q) {
-    _seq_history.insert(ipaddr, Deque<unsigned>());
-    q = _seq_history.findp(ipaddr);
+    _seq_history.set(ipaddr, Deque<unsigned>());
+    q = _seq_history.get_pointer(ipaddr);
   }
   unsigned bcast_num = ntohl(grid_hdr::get_pad_bytes(*gh));
   q->push_back(bcast_num);
@@ -1072,7 +1134,7 @@ DSDVRouteTable::simple_action(Packet *packet)
   }
   new_r.last_seen_jiffies = sender_saw_us ? jiff : 0;
 
-  RTEntry *old = _rtes.findp(new_r.dest_ip);
+  RTEntry *old = _rtes.get_pointer(new_r.dest_ip);
   // If the sending node didn't see us, and has never seen us, or
   // hasn't seen us in a while, mark the sender as `seen' instead of
   // giving it a proper metric.
@@ -1105,7 +1167,7 @@ DSDVRouteTable::simple_action(Packet *packet)
 
   // update this dest's eth, if we inserted it into the route table
   if (inserted_new_r) {
-    r = _rtes.findp(ipaddr);
+    r = _rtes.get_pointer(ipaddr);
     dsdv_assert(r);
     r->dest_eth = ethaddr;
   }
@@ -1170,7 +1232,7 @@ DSDVRouteTable::print_rtes_v(Element *e, void *)
 #if USE_OLD_SEQ
     RTEntry f = i.value();
     if (n->use_old_route(f.dest_ip, jiff))
-      f = n->_old_rtes[f.dest_ip];
+      f = n->_old_rtes.get(f.dest_ip);
 #else
     const RTEntry &f = i.value();
 #endif
@@ -1212,7 +1274,7 @@ DSDVRouteTable::print_rtes(Element *e, void *)
     unsigned jiff = dsdv_jiffies();
     RTEntry f = i.value();
     if (n->use_old_route(f.dest_ip, jiff))
-      f = n->_old_rtes[f.dest_ip];
+      f = n->_old_rtes.get(f.dest_ip);
 #else
     const RTEntry &f = i.value();
 #endif
@@ -1332,11 +1394,11 @@ DSDVRouteTable::write_paused(const String &arg, Element *el,
     rt->_snapshot_jiffies = dsdv_jiffies();
     rt->_snapshot_rtes.clear();
     for (RTIter i = rt->_rtes.begin(); i.live(); i++)
-      rt->_snapshot_rtes.insert(i.key(), i.value());
+      rt->_snapshot_rtes.set(i.key(), i.value());
 #if USE_OLD_SEQ
     rt->_snapshot_old_rtes.clear();
     for (RTIter i = rt->_old_rtes.begin(); i.live(); i++)
-      rt->_snapshot_old_rtes.insert(i.key(), i.value());
+      rt->_snapshot_old_rtes.set(i.key(), i.value());
 #endif
   }
   return 0;
@@ -1620,40 +1682,17 @@ DSDVRouteTable::check_invariants(const IPAddress *ignore) const
     if (ignore && *ignore == i.key())
       continue;
 
-    // check expire timer invariants
-    Timer **t = _expire_timers.findp(r.dest_ip);
-    HookPair **hp = _expire_hooks.findp(r.dest_ip);
-
-    if (r.good()) {
-      dsdv_assert(t);
-      dsdv_assert(*t);
-      dsdv_assert((*t)->scheduled());
-      dsdv_assert(hp);
-      dsdv_assert(*hp);
-      dsdv_assert((*hp)->obj == this);
-      dsdv_assert((*hp)->ip == (unsigned int) r.dest_ip);
-    }
-    else {
-      dsdv_assert(!t);
-      dsdv_assert(!hp);
-    }
+    // check expire deadline invariants
+    dsdv_assert(has_deadline(r.dest_ip, false) == r.good());
 
-    // check trigger timer invariants
-    t = _trigger_timers.findp(r.dest_ip);
-    hp = _trigger_hooks.findp(r.dest_ip);
-    if (t) {
-      dsdv_assert(*t);
-      dsdv_assert((*t)->scheduled());
-      dsdv_assert(hp);
-      dsdv_assert(*hp);
-      dsdv_assert((*hp)->obj == this);
-      dsdv_assert((*hp)->ip == (unsigned int) r.dest_ip);
-      // dsdv_assert(r.need_seq_ad || r.need_metric_ad); // see note for trigger invariants
-    }
-    else {
-      dsdv_assert(!hp);
-    }
+    // check trigger deadline invariants
+    // if (has_deadline(r.dest_ip, true))
+    //   dsdv_assert(r.need_seq_ad || r.need_metric_ad); // see note for trigger invariants
   }
+
+  // cancelled deadlines are removed
+  for (DTIter i = _deadlines.begin(); i.live(); i++)
+    dsdv_assert(i.value().expire || i.value().trigger);
 }
 
 void
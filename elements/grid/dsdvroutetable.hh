@@ -1,6 +1,6 @@
 #ifndef CLICK_DSDVROUTETABLE_HH
 #define CLICK_DSDVROUTETABLE_HH
-#include <click/bighashmap.hh>
+#include <click/hashtable.hh>
 #include <click/etheraddress.hh>
 #include <click/ipaddress.hh>
 #include <clicknet/ether.h>
@@ -198,11 +198,13 @@ public:
   bool get_one_entry(const IPAddress &dest_ip, RouteEntry &entry);
   void get_all_entries(Vector<RouteEntry> &vec);
   unsigned get_number_direct_neigbors();
+  const GridLocationIndex *location_index() const;
 
   DSDVRouteTable();
   ~DSDVRouteTable();
 
   const char *class_name() const		{ return "DSDVRouteTable"; }
+  const char *flags() const			{ return "T"; }
   void *cast(const char *);
   const char *port_count() const		{ return PORTS_1_1; }
   const char *processing() const		{ return "h/h"; }
@@ -221,7 +223,7 @@ private:
 
 #if SEQ_METRIC
   bool _use_seq_metric; // use the `dsdv_seqs' metric
-  HashMap<IPAddress, Deque<unsigned> > _seq_history;
+  HashTable<IPAddress, Deque<unsigned> > _seq_history;
 #endif
 
   typedef GridGenericMetric::metric_t metric_t;
@@ -324,7 +326,7 @@ private:
 
   friend class RTEntry;
 
-  typedef HashMap<IPAddress, RTEntry> RTable;
+  typedef HashTable<IPAddress, RTEntry> RTable;
   typedef RTable::const_iterator RTIter;
 
   /* the route table */
@@ -332,17 +334,26 @@ private:
 
   // 1. every route in the table that is not expired (num_hops > 0) is
   // valid: i.e. its ttl has not run out, nor has it been in the table
-  // past its timeout.  There is an expire timer for this route in
-  // _expire_timers.
+  // past its timeout.  There is an expire deadline for this route in
+  // _deadlines.
 
   // 2. no route in the table that *is* expired (num_hops == 0) has an
-  // entry in _expire_timers.
+  // expire deadline.
 
   // 3. expired routes *are* allowed in the table, since that's what
   // the DSDV description does.
 
   RTable _rtes;
 
+  // destinations whose need_seq_ad or need_metric_ad flag has been
+  // set since they were last advertised, so triggered updates need
+  // not scan all of _rtes.  Entries are dropped lazily once both
+  // flags are clear.
+  HashTable<IPAddress, bool> _pending_ads;
+
+  // locations of the routes in _rtes with good locations
+  GridLocationIndex _loc_index;
+
 #if USE_OLD_SEQ
   RTable _old_rtes;
   bool use_old_route(const IPAddress &dst, unsigned jiff);
@@ -356,43 +367,47 @@ private:
   bool lookup_route(const IPAddress &dest_ip, RTEntry &entry);
 
 
-  typedef HashMap<IPAddress, Timer *> TMap;
-  typedef TMap::iterator TMIter;
-
-  struct HookPair {
-    DSDVRouteTable *obj;
-    unsigned int ip;
-    HookPair(DSDVRouteTable *o, unsigned int _ip) : obj(o), ip(_ip) { }
-  private:
-    HookPair() { }
+  // Route expiry and triggered update deadlines, in jiffies.  Rather
+  // than a Timer per route, one Timer serves them all through a hashed
+  // timing wheel: _wheel[s] lists the destinations with a deadline in
+  // slot s, modulo the wheel's span.  Lists may hold stale entries; a
+  // deadline counts only while it is recorded in _deadlines.
+  struct Deadlines {
+    bool expire;
+    bool trigger;
+    unsigned int expire_jiffies;
+    unsigned int trigger_jiffies;
+    Deadlines() : expire(false), trigger(false), expire_jiffies(0), trigger_jiffies(0) { }
   };
 
-  typedef HashMap<IPAddress, HookPair *> HMap;
-  typedef HMap::iterator HMIter;
-
-  // Expire timer map invariants: every good route (r.good() is true)
-  // has a running timer in _expire_timers.  No broken routes have a
-  // timer.  Every entry in _expire_timers has a corresponding
-  // TimerHook pointer stored in _expire_hooks.
-  TMap _expire_timers;
-  HMap _expire_hooks;
-
-  // Trigger timer invariants: any route may have a timer in this
-  // table.  All timers in the table must be running.  Every entry in
-  // _trigger_timers has a corresponding TimerHook pointer stored in
-  // _trigger_hooks.  Note: a route entry r may have a trigger timer
-  // even if r.need_seq_ad and r.need_metric_ad flags are false.  We
-  // might have sent a full update before r's triggered update timer
-  // expired, but after r.advertise_ok_jiffies: the triggered update
-  // was delayed past r.advertise_ok_jiffies to enforce the minimum
-  // triggered update period.  In that case there may be other
-  // destinations whose triggered updates were cancelled when r's
-  // trigger was delayed, and which should be advertised when r's
-  // triggered update timer finally fires, even if r needn't be.
-  TMap _trigger_timers;
-  HMap _trigger_hooks;
-
-  // check table, timer, and trigger hook invariants
+  typedef HashTable<IPAddress, Deadlines> DTable;
+  typedef DTable::const_iterator DTIter;
+
+  // Expire deadline invariants: every good route (r.good() is true)
+  // has an expire deadline.  No broken routes have one.
+
+  // Trigger deadline invariants: any route may have a trigger
+  // deadline.  Note: a route entry r may have a trigger deadline even
+  // if r.need_seq_ad and r.need_metric_ad flags are false.  We might
+  // have sent a full update before r's triggered update was due, but
+  // after r.advertise_ok_jiffies: the triggered update was delayed
+  // past r.advertise_ok_jiffies to enforce the minimum triggered
+  // update period.  In that case there may be other destinations
+  // whose triggered updates were cancelled when r's trigger was
+  // delayed, and which should be advertised when r's triggered update
+  // finally comes due, even if r needn't be.
+  DTable _deadlines;
+
+  enum { wheel_order = 8, wheel_size = 1 << wheel_order, wheel_shift = 6 };
+  Vector<IPAddress> _wheel[wheel_size];
+  unsigned int _wheel_cursor; // jiffies; earlier deadlines have been run
+  unsigned int _wheel_next;   // jiffies; when _wheel_timer will fire
+
+  void set_deadline(const IPAddress &, bool trigger, unsigned int when);
+  void cancel_deadline(const IPAddress &, bool trigger);
+  bool has_deadline(const IPAddress &, bool trigger) const;
+
+  // check table, expire and trigger deadline invariants
   void check_invariants(const IPAddress *ignore = 0) const;
 
   /* max time to keep an entry in RT */
@@ -441,14 +456,11 @@ private:
   void log_dump_hook(bool reschedule);
 
 
-  static void static_expire_hook(Timer *, void *v)
-  { ((HookPair *) v)->obj->expire_hook(((HookPair *) v)->ip); }
+  Timer _wheel_timer;
+  static void static_wheel_hook(Timer *, void *e) { ((DSDVRouteTable *) e)->wheel_hook(); }
+  void wheel_hook();
 
   void expire_hook(const IPAddress &);
-
-  static void static_trigger_hook(Timer *, void *v)
-  { ((HookPair *) v)->obj->trigger_hook(((HookPair *) v)->ip); }
-
   void trigger_hook(const IPAddress &);
 
   void send_full_update();
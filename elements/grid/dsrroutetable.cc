@@ -320,7 +320,8 @@ DSRRouteTable::sendbuffer_timer_hook()
 
       // search route for destination in the link cache first
       _link_table->dijkstra(false);
-      Vector<IPAddress> route = _link_table->best_route(dst, false);
+      LinkTable::Route route;
+      _link_table->best_route(dst, false, route);
 
       if (route.size() > 1) { // found the route..
 	DEBUG_CHATTER(" * have a route:\n");
@@ -463,7 +464,8 @@ DSRRouteTable::push(int port, Packet *p_in)
     }
 
     _link_table->dijkstra(false);
-    Vector<IPAddress> route = _link_table->best_route(dst_addr, false);
+    LinkTable::Route route;
+    _link_table->best_route(dst_addr, false, route);
     if (route.size() > 1) {
 
       DEBUG_CHATTER(" * have cached route:\n");
@@ -913,7 +915,7 @@ DSRRouteTable::push(int port, Packet *p_in)
 }
 
 Packet *
-DSRRouteTable::add_dsr_header(Packet *p_in, const Vector<IPAddress> &source_route)
+DSRRouteTable::add_dsr_header(Packet *p_in, const LinkTable::Route &source_route)
 {
   int old_len = p_in->length();
   int payload;
@@ -1697,7 +1699,8 @@ DSRRouteTable::rreq_issue_hook()
     // we could find out a route by some other means than a direct
     // RREP.  if this is the case, stop issuing requests.
     _link_table->dijkstra(false);
-    Vector<IPAddress> route = _link_table->best_route(ir._target,false);
+    LinkTable::Route route;
+    _link_table->best_route(ir._target, false, route);
     if (route.size() > 1) { // we have a route
       remove_list.push_back(ir._target);
       continue;
@@ -5,6 +5,7 @@
 #include <click/etheraddress.hh>
 #include <click/vector.hh>
 #include "grid.hh"
+#include "locindex.hh"
 CLICK_DECLS
 
 // public interface class to Grid routetables.  yes, i know, this is
@@ -76,6 +77,11 @@ public:
     return num_nbrs;
   }
 
+  // return an index of the locations of the destinations whose
+  // locations are good, kept up to date as routes change, or null if
+  // there is none.  Destinations found in the index have entries.
+  virtual const GridLocationIndex *location_index() const { return 0; }
+
   virtual ~GridGenericRouteTable() { }
 };
 
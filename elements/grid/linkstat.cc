@@ -21,15 +21,77 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/timer.hh>
+#include <click/router.hh>
 #include <click/straccum.hh>
+#include <click/standard/scheduleinfo.hh>
 #include <elements/grid/grid.hh>
 #include <elements/grid/linkstat.hh>
 #include <elements/grid/timeutils.hh>
 CLICK_DECLS
 
+/*
+ * One timer per router drives every LinkStat.  A tick wakes the
+ * elements due within a tenth of their period, then sleeps until the
+ * next element is due.
+ */
+class LinkStat::Clock {
+public:
+  Clock(Router *r) : _timer(run_hook, this) { _timer.initialize(r); }
+
+  static Clock *join(LinkStat *ls) {
+    void *&a = ls->router()->force_attachment("LinkStat.Clock");
+    if (!a)
+      a = new Clock(ls->router());
+    Clock *c = (Clock *) a;
+    c->_members.push_back(ls);
+    c->_timer.schedule_now();
+    return c;
+  }
+
+  void leave(LinkStat *ls) {
+    for (int i = 0; i < _members.size(); i++)
+      if (_members[i] == ls) {
+	_members[i] = _members.back();
+	_members.pop_back();
+	break;
+      }
+    if (_members.empty()) {
+      ls->router()->set_attachment("LinkStat.Clock", 0);
+      delete this;
+    }
+  }
+
+private:
+  Timer _timer;
+  Vector<LinkStat *> _members;
+
+  static void run_hook(Timer *, void *c) { ((Clock *) c)->run(); }
+
+  void run() {
+    Timestamp now = Timestamp::now();
+    Timestamp next;
+    for (int i = 0; i < _members.size(); i++) {
+      LinkStat *ls = _members[i];
+      unsigned period = ls->_period ? ls->_period : 1000;
+      if (ls->_next_tick <= now + Timestamp::make_msec(period / 10)) {
+	// jitter the next probe by up to a tenth of the period
+	unsigned max_jitter = period / 10;
+	unsigned j = click_random(0, max_jitter * 2);
+	ls->_next_tick = now + Timestamp::make_msec(period + j - max_jitter);
+	ls->_tick = 1;
+	ls->_task.reschedule();
+      }
+      if (!next || ls->_next_tick < next)
+	next = ls->_next_tick;
+    }
+    if (next)
+      _timer.schedule_at(next);
+  }
+};
+
 LinkStat::LinkStat()
   : _window(100), _tau(10000), _period(1000),
-  _probe_size(1000), _seq(0), _send_timer(0),
+  _probe_size(1000), _seq(0), _inbox_count(0), _task(this), _clock(0),
   _use_proto2(false)
 {
 }
@@ -62,7 +124,7 @@ LinkStat::configure(Vector<String> &conf, ErrorHandler *errh)
 }
 
 void
-LinkStat::send_hook()
+LinkStat::send_probe(const Timestamp &now)
 {
   WritablePacket *p = Packet::make(_probe_size + 2); // +2 for alignment
   if (p == 0) {
@@ -73,7 +135,7 @@ LinkStat::send_hook()
   p->pull(2);
   memset(p->data(), 0, p->length());
 
-  p->set_timestamp_anno(Timestamp::now());
+  p->set_timestamp_anno(now);
 
   // fill in ethernet header
   click_ether *eh = (click_ether *) p->data();
@@ -114,10 +176,6 @@ LinkStat::send_hook()
 
   link_probe::update_cksum(p->data() + sizeof(click_ether));
 
-  unsigned max_jitter = _period / 10;
-  unsigned j = click_random(0, max_jitter * 2);
-  _send_timer->reschedule_after_msec(_period + j - max_jitter);
-
   checked_output_push(0, p);
 }
 
@@ -139,39 +197,78 @@ LinkStat::count_rx(const probe_list_t *pl)
   return num;
 }
 
-unsigned int
-LinkStat::count_rx(const EtherAddress &eth)
+int
+LinkStat::initialize(ErrorHandler *errh)
 {
-  probe_list_t *pl = _bcast_stats.findp(eth);
-  if (pl)
-    return count_rx(pl);
-  else
-    return 0;
+  if (noutputs() > 0 && !_eth)
+    return errh->error("Source Ethernet address must be specified to send probes");
+  ScheduleInfo::initialize_task(this, &_task, false, errh);
+  // first probe after a second, as before
+  _next_tick = Timestamp::now() + Timestamp::make_sec(1);
+  _clock = Clock::join(this);
+  return 0;
 }
 
-int
-LinkStat::initialize(ErrorHandler *errh)
+void
+LinkStat::cleanup(CleanupStage)
 {
-  if (noutputs() > 0) {
-    if (!_eth)
-      return errh->error("Source Ethernet address must be specified to send probes");
-    _send_timer = new Timer(static_send_hook, this);
-    _send_timer->initialize(this);
-    _send_timer->schedule_after_sec(1);
+  if (_clock)
+    _clock->leave(this);
+  _clock = 0;
+  _inbox.kill();
+}
+
+Packet *
+LinkStat::simple_action(Packet *p)
+{
+  // Hand the probe to the task.
+  _inbox_lock.acquire();
+  if (_inbox_count < INBOX_CAPACITY) {
+    _inbox.push_back(p);
+    _inbox_count++;
+    p = 0;
   }
+  _inbox_lock.release();
+  if (p)
+    p->kill();
+  else
+    _task.reschedule();
   return 0;
 }
 
+bool
+LinkStat::run_task(Task *)
+{
+  PacketBatch batch;
+  _inbox_lock.acquire();
+  batch.swap(_inbox);
+  _inbox_count = 0;
+  _inbox_lock.release();
 
+  Timestamp now = Timestamp::now();
+  bool worked = !batch.empty();
+  while (Packet *p = batch.pop_front())
+    process_probe(p, now);
+
+  if (_tick.swap(0)) {
+    if (noutputs() > 0)
+      send_probe(now);
+    // expire old probes from every sender
+    update_all_rates(now);
+    worked = true;
+  }
+  _rates.reclaim();
+  return worked;
+}
 
-Packet *
-LinkStat::simple_action(Packet *p)
+void
+LinkStat::process_probe(Packet *p, const Timestamp &now)
 {
   unsigned min_sz = sizeof(click_ether) + link_probe::size;
   if (p->length() < min_sz) {
     click_chatter("LinkStat %s: packet is too small", name().c_str());
     p->kill();
-    return 0;
+    return;
   }
 
   click_ether *eh = (click_ether *) p->data();
@@ -179,24 +276,24 @@ LinkStat::simple_action(Packet *p)
   if (ntohs(eh->ether_type) != (_use_proto2 ? ETHERTYPE_LINKSTAT2 : ETHERTYPE_LINKSTAT)) {
     click_chatter("LinkStat %s: got non-LinkStat packet type", name().c_str());
     p->kill();
-    return 0;
+    return;
   }
 
   link_probe lp(p->data() + sizeof(click_ether));
   if (link_probe::calc_cksum(p->data() + sizeof(click_ether)) != 0) {
     click_chatter("LinkStat %s: bad checksum from %s", name().c_str(), EtherAddress(eh->ether_shost).unparse().c_str());
     p->kill();
-    return 0;
+    return;
   }
 
   if (p->length() < lp.psz)
     click_chatter("LinkStat %s: packet is smaller (%d) than it claims (%u)",
 		  name().c_str(), p->length(), lp.psz);
 
-  add_bcast_stat(EtherAddress(eh->ether_shost), lp);
+  EtherAddress src(eh->ether_shost);
+  add_bcast_stat(src, lp, now);
 
   // look in received packet for info about our outgoing link
-  Timestamp now = Timestamp::now();
   unsigned int max_entries = (p->length() - sizeof(*eh) - link_probe::size) / link_entry::size;
   unsigned int num_entries = lp.num_links;
   if (num_entries > max_entries) {
@@ -209,86 +306,99 @@ LinkStat::simple_action(Packet *p)
   for (unsigned i = 0; i < num_entries; i++, d += link_entry::size) {
     link_entry le(d);
     if (le.eth == _eth) {
-      _rev_bcast_stats.insert(EtherAddress(eh->ether_shost), outgoing_link_entry_t(le, now, lp.tau));
+      _rev_bcast_stats.set(src, outgoing_link_entry_t(le, now, lp.tau));
       break;
     }
   }
 
+  update_rates(src, now);
   p->kill();
-  return 0;
 }
 
-bool
-LinkStat::get_forward_rate(const EtherAddress &eth, unsigned int *r,
-			   unsigned int *tau, Timestamp *t)
+void
+LinkStat::update_rates(const EtherAddress &eth, const Timestamp &now)
 {
-  outgoing_link_entry_t *ol = _rev_bcast_stats.findp(eth);
-  if (!ol)
-    return false;
-
-  if (_period == 0)
-    return false;
+  rates_t r;
+
+  outgoing_link_entry_t *ol = _rev_bcast_stats.get_pointer(eth);
+  // The forward rate needs our send period to be less than the remote
+  // host's averaging period.
+  if (ol && _period && ol->tau / _period) {
+    unsigned pct = 100 * ol->num_rx / (ol->tau / _period);
+    r.fwd_ok = true;
+    r.fwd = (pct > 100 ? 100 : pct);
+    r.fwd_tau = ol->tau;
+    r.fwd_at = ol->received_at;
+  }
 
-  unsigned num_expected = ol->tau / _period;
-  unsigned num_received = ol->num_rx;
+  probe_list_t *pl = _bcast_stats.get_pointer(eth);
+  if (pl) {
+    // drop probes that have left the averaging period, so the rest
+    // can be counted directly
+    Timestamp earliest = now - Timestamp::make_msec(_tau);
+    while (pl->probes.size() && pl->probes.front().when < earliest)
+      pl->probes.pop_front();
+    // The reverse rate needs our averaging period to be greater than
+    // the remote host's sending period.
+    if (pl->period && _tau / pl->period) {
+      unsigned pct = 100 * pl->probes.size() / (_tau / pl->period);
+      r.rev_ok = true;
+      r.rev = (pct > 100 ? 100 : pct);
+      r.rev_tau = _tau;
+    }
+  }
 
-  // will happen if our send period is greater than the the remote
-  // host's averaging period
-  if (num_expected == 0)
-    return false;
+  if (r.fwd_ok || r.rev_ok)
+    _rates.set(eth, r);
+  else
+    _rates.erase(eth);
+}
 
-  unsigned pct = 100 * num_received / num_expected;
-  if (pct > 100)
-    pct = 100;
-  *r = pct;
-  *tau = ol->tau;
-  *t = ol->received_at;
+void
+LinkStat::update_all_rates(const Timestamp &now)
+{
+  for (ProbeMap::iterator i = _bcast_stats.begin(); i.live(); i++)
+    update_rates(i.key(), now);
+  for (ReverseProbeMap::iterator i = _rev_bcast_stats.begin(); i.live(); i++)
+    if (!_bcast_stats.get_pointer(i.key()))
+      update_rates(i.key(), now);
+}
 
+bool
+LinkStat::get_forward_rate(const EtherAddress &eth, unsigned int *r,
+			   unsigned int *tau, Timestamp *t) const
+{
+  rates_t rates;
+  if (!_rates.find(eth, rates) || !rates.fwd_ok)
+    return false;
+  *r = rates.fwd;
+  *tau = rates.fwd_tau;
+  *t = rates.fwd_at;
   return true;
 }
 
 bool
 LinkStat::get_reverse_rate(const EtherAddress &eth, unsigned int *r,
-			   unsigned int *tau)
+			   unsigned int *tau) const
 {
-  probe_list_t *pl = _bcast_stats.findp(eth);
-  if (!pl)
-    return false;
-
-  if (pl->period == 0)
-    return false;
-
-  unsigned num_expected = _tau / pl->period;
-  unsigned num_received = count_rx(eth);
-
-  // will happen if our averaging period is less than the remote
-  // host's sending rate.
-  if (num_expected == 0)
+  rates_t rates;
+  if (!_rates.find(eth, rates) || !rates.rev_ok)
     return false;
-
-  unsigned pct = 100 * num_received / num_expected;
-  if (pct > 100)
-    pct = 100;
-  *r = pct;
-  *tau = _tau;
-
+  *r = rates.rev;
+  *tau = rates.rev_tau;
   return true;
 }
 
 void
-LinkStat::add_bcast_stat(const EtherAddress &eth, const link_probe &lp)
+LinkStat::add_bcast_stat(const EtherAddress &eth, const link_probe &lp, const Timestamp &now)
 {
-  Timestamp now = Timestamp::now();
   probe_t probe(now, lp.seq_no);
 
   unsigned int new_period = lp.period;
 
-  probe_list_t *l = _bcast_stats.findp(eth);
-  if (!l) {
-    probe_list_t l2(eth, new_period, lp.tau);
-    _bcast_stats.insert(eth, l2);
-    l = _bcast_stats.findp(eth);
-  }
+  probe_list_t *l = _bcast_stats.get_pointer(eth);
+  if (!l)
+    l = &_bcast_stats.find_insert(eth, probe_list_t(eth, new_period, lp.tau)).value();
   else if (l->period != new_period) {
     click_chatter("LinkStat %s: %s has changed its link probe period from %u to %u; clearing probe info\n",
 		  name().c_str(), eth.unparse().c_str(), l->period, new_period);
@@ -330,13 +440,13 @@ LinkStat::read_bcast_stats(Element *xf, void *)
 {
   LinkStat *e = (LinkStat *) xf;
 
-  typedef HashMap<EtherAddress, bool> EthMap;
+  typedef HashTable<EtherAddress, bool> EthMap;
   EthMap eth_addrs;
 
   for (ProbeMap::const_iterator i = e->_bcast_stats.begin(); i.live(); i++)
-    eth_addrs.insert(i.key(), true);
+    eth_addrs.set(i.key(), true);
   for (ReverseProbeMap::const_iterator i = e->_rev_bcast_stats.begin(); i.live(); i++)
-    eth_addrs.insert(i.key(), true);
+    eth_addrs.set(i.key(), true);
 
   Timestamp now = Timestamp::now();
 
@@ -344,8 +454,8 @@ LinkStat::read_bcast_stats(Element *xf, void *)
   for (EthMap::const_iterator i = eth_addrs.begin(); i.live(); i++) {
     const EtherAddress &eth = i.key();
 
-    probe_list_t *pl = e->_bcast_stats.findp(eth);
-    outgoing_link_entry_t *ol = e->_rev_bcast_stats.findp(eth);
+    probe_list_t *pl = e->_bcast_stats.get_pointer(eth);
+    outgoing_link_entry_t *ol = e->_rev_bcast_stats.get_pointer(eth);
 
     sa << eth << ' ';
 
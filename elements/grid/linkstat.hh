@@ -17,6 +17,22 @@
  * address ETH must be specified if the second output is
  * connected.
  *
+ * Probe handling stays off the forwarding path.  Arriving probes are
+ * queued and processed later by LinkStat's task, which also sends this
+ * node's probes and recomputes the delivery rates.  The rates are
+ * published in a table that metric elements such as ETXMetric read
+ * without locks, so the task can run on a thread of its own (see
+ * StaticThreadSched) or with few tickets (see ScheduleInfo).  If it
+ * runs on a different thread from the elements downstream of its
+ * output, connect the output to a thread-safe queue.  At most 256
+ * probes wait for the task; more are dropped.
+ *
+ * Every LinkStat in a router is driven by one shared timer.  On each
+ * tick, the elements whose next probe is due within a tenth of their
+ * period send it, so the probes of several interfaces go out in one
+ * batch.  Each tick also refreshes the element's delivery rates, which
+ * are therefore up to PERIOD milliseconds old.
+ *
  * Keyword arguments are:
  *
  * =over 8
@@ -53,17 +69,19 @@
  *
  * =back */
 
-#include <click/bighashmap.hh>
+#include <click/hashtable.hh>
+#include <click/rcuhashtable.hh>
 #include <click/deque.hh>
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <click/etheraddress.hh>
+#include <click/task.hh>
+#include <click/sync.hh>
+#include <click/atomic.hh>
 #include <elements/grid/timeutils.hh>
 
 CLICK_DECLS
 
-class Timer;
-
 class LinkStat : public Element {
 
 public:
@@ -167,7 +185,7 @@ private:
   };
 
   // Per-sender map of received probes.
-  typedef HashMap<EtherAddress, probe_list_t> ProbeMap;
+  typedef HashTable<EtherAddress, probe_list_t> ProbeMap;
   ProbeMap _bcast_stats;
 
   // record delivery rate data about our outgoing links
@@ -182,7 +200,7 @@ private:
   };
 
   // Per-receiver map of delivery rate data
-  typedef HashMap<EtherAddress, outgoing_link_entry_t> ReverseProbeMap;
+  typedef HashTable<EtherAddress, outgoing_link_entry_t> ReverseProbeMap;
   ReverseProbeMap _rev_bcast_stats;
 
   static String read_stats(Element *, void *);
@@ -190,7 +208,6 @@ private:
 
   // count number of probes received from specified host during last
   // _tau msecs.
-  unsigned int count_rx(const EtherAddress &);
   unsigned int count_rx(const probe_list_t *);
 
   // handlers
@@ -201,12 +218,41 @@ private:
   static int write_period(const String &, Element *, void *, ErrorHandler *);
   static int write_tau(const String &, Element *, void *, ErrorHandler *);
 
-  void add_bcast_stat(const EtherAddress &, const link_probe &);
+  void add_bcast_stat(const EtherAddress &, const link_probe &, const Timestamp &);
+
+  // Delivery rates as of the task's last run, for get_forward_rate()
+  // and get_reverse_rate().  Only the task writes the table.
+  struct rates_t {
+    bool fwd_ok;
+    bool rev_ok;
+    unsigned fwd;
+    unsigned fwd_tau;
+    Timestamp fwd_at;
+    unsigned rev;
+    unsigned rev_tau;
+    rates_t() : fwd_ok(false), rev_ok(false), fwd(0), fwd_tau(0), rev(0), rev_tau(0) { }
+  };
+  RCUHashTable<EtherAddress, rates_t> _rates;
+
+  void update_rates(const EtherAddress &, const Timestamp &);
+  void update_all_rates(const Timestamp &);
+
+  // probes waiting for the task
+  enum { INBOX_CAPACITY = 256 };
+  Spinlock _inbox_lock;
+  PacketBatch _inbox;
+  int _inbox_count;
+
+  Task _task;
+  atomic_uint32_t _tick;	// set by the clock, cleared by the task
+  Timestamp _next_tick;
 
-  static void static_send_hook(Timer *, void *e) { ((LinkStat *) e)->send_hook(); }
-  void send_hook();
+  class Clock;
+  friend class Clock;
+  Clock *_clock;
 
-  Timer *_send_timer;
+  void process_probe(Packet *, const Timestamp &);
+  void send_probe(const Timestamp &);
 
   bool _use_proto2;
 
@@ -218,12 +264,13 @@ private:
   // period TAU milliseconds, as recorded at time T.  R is a
   // percentage (0-100).  Return true iff we have data.
   bool get_forward_rate(const EtherAddress &eth, unsigned int *r, unsigned int *tau,
-			Timestamp *t);
+			Timestamp *t) const;
 
   // Get reverse delivery rate R from node ETH to this node over
-  // period TAU milliseconds, as of now.  R is a percentage 0-100.
+  // period TAU milliseconds, as of the last probe from ETH or the last
+  // tick, whichever is later.  R is a percentage 0-100.
   // Return true iff we have good data.
-  bool get_reverse_rate(const EtherAddress &eth, unsigned int *r, unsigned int *tau);
+  bool get_reverse_rate(const EtherAddress &eth, unsigned int *r, unsigned int *tau) const;
 
   unsigned get_probe_size() const { return _probe_size; }
 
@@ -239,8 +286,10 @@ private:
 
   int configure(Vector<String> &, ErrorHandler *);
   int initialize(ErrorHandler *);
+  void cleanup(CleanupStage);
 
   Packet *simple_action(Packet *);
+  bool run_task(Task *);
 };
 
 template <class T> void grid_swap(T &a, T &b) {
@@ -27,6 +27,7 @@ public:
   ~LinkTestReceiver();
 
   const char *class_name() const { return "LinkTestReceiver"; }
+  const char *flags() const      { return "T"; }
   const char *port_count() const { return PORTS_1_1; }
   const char *processing() const { return AGNOSTIC; }
 
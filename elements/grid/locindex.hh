@@ -0,0 +1,174 @@
+#ifndef GRIDLOCINDEX_HH
+#define GRIDLOCINDEX_HH
+#include <click/hashtable.hh>
+#include <click/ipaddress.hh>
+#include <click/vector.hh>
+#include "grid.hh"
+#ifdef CLICK_USERLEVEL
+# include <math.h>
+#endif
+CLICK_DECLS
+
+/*
+ * A uniform grid index over node locations, for finding the node
+ * nearest some location without examining every node.  Nodes are
+ * bucketed into square cells, CELL milliseconds of arc on a side;
+ * updating a node's location costs O(nodes in its cells).  nearest()
+ * searches outward from the location's cell, ring by ring, and stops
+ * once no unexamined cell can hold a nearer node.  If the search would
+ * examine more cells than there are nodes, it scans the nodes instead.
+ *
+ * Cells are in latitude and longitude, so they narrow towards the
+ * poles; the search accounts for that.  Distances are those of
+ * grid_location::calc_range(), so nearest() is user-level only.
+ */
+class GridLocationIndex {
+public:
+
+  enum { DEFAULT_CELL = 10 * 1000 }; // 10 seconds of arc, about 300 metres
+
+  GridLocationIndex(int32_t cell = DEFAULT_CELL) : _cell(cell) { }
+
+  int size() const { return _locs.size(); }
+  bool empty() const { return _locs.empty(); }
+
+  void set(IPAddress ip, const grid_location &loc) {
+    uint64_t k = cell_key(loc);
+    HashTable<IPAddress, grid_location>::iterator it = _locs.find(ip);
+    if (it) {
+      if (cell_key(it.value()) != k) {
+	unlink(ip, cell_key(it.value()));
+	_cells[k].push_back(ip);
+      }
+      it.value() = loc;
+    } else {
+      _locs.set(ip, loc);
+      _cells[k].push_back(ip);
+    }
+  }
+
+  void remove(IPAddress ip) {
+    HashTable<IPAddress, grid_location>::iterator it = _locs.find(ip);
+    if (it) {
+      unlink(ip, cell_key(it.value()));
+      _locs.erase(it);
+    }
+  }
+
+  void clear() {
+    _locs.clear();
+    _cells.clear();
+  }
+
+#ifdef CLICK_USERLEVEL
+  // Find the indexed node nearest loc.  Returns false if the index is
+  // empty.
+  bool nearest(const grid_location &loc, IPAddress &ip, double &dist) const;
+#endif
+
+private:
+
+  int32_t _cell;
+  HashTable<IPAddress, grid_location> _locs;
+  HashTable<uint64_t, Vector<IPAddress> > _cells;
+
+  int32_t cell_of(int32_t ms) const {
+    return ms >= 0 ? ms / _cell : -((-ms - 1) / _cell) - 1;
+  }
+  static uint64_t make_key(int32_t lat_cell, int32_t lon_cell) {
+    return ((uint64_t) (uint32_t) lat_cell << 32) | (uint32_t) lon_cell;
+  }
+  uint64_t cell_key(const grid_location &loc) const {
+    return make_key(cell_of(loc.lat_ms()), cell_of(loc.lon_ms()));
+  }
+
+  void unlink(IPAddress ip, uint64_t k) {
+    HashTable<uint64_t, Vector<IPAddress> >::iterator c = _cells.find(k);
+    Vector<IPAddress> &v = c.value();
+    for (int i = 0; i < v.size(); i++)
+      if (v[i] == ip) {
+	v[i] = v.back();
+	v.pop_back();
+	break;
+      }
+    if (v.empty())
+      _cells.erase(c);
+  }
+
+#ifdef CLICK_USERLEVEL
+  double ring_bound(const grid_location &loc, int32_t ring) const;
+  void consider(const grid_location &loc, IPAddress node, const grid_location &node_loc,
+		bool &found, IPAddress &ip, double &dist) const {
+    double d = grid_location::calc_range(loc, node_loc);
+    if (d >= 0 && (!found || d < dist)) {
+      found = true;
+      ip = node;
+      dist = d;
+    }
+  }
+#endif
+
+};
+
+#ifdef CLICK_USERLEVEL
+// Lower bound on the distance from loc to any point in a cell `ring'
+// cells away from loc's cell.  Such a point is more than (ring - 1)
+// cells away in latitude or in longitude.  A latitude difference of a
+// is at least a*R apart; by the haversine formula, a longitude
+// difference of b, between latitudes no further from the equator than
+// phi, is at least 2*R*asin(cos(phi)*sin(b/2)) apart.
+inline double
+GridLocationIndex::ring_bound(const grid_location &loc, int32_t ring) const
+{
+  if (ring <= 1)
+    return 0;
+  double cell_rad = _cell / (1000.0 * 60 * 60) * GRID_RAD_PER_DEG;
+  double a = (ring - 1) * cell_rad;
+  double phi = fabs(loc.lat() * GRID_RAD_PER_DEG) + (ring + 1) * cell_rad;
+  if (phi >= GRID_PI / 2)
+    return 0;
+  double lon_bound = 2 * asin(cos(phi) * sin((a < GRID_PI ? a : GRID_PI) / 2));
+  return (a < lon_bound ? a : lon_bound) * GRID_EARTH_RADIUS;
+}
+
+inline bool
+GridLocationIndex::nearest(const grid_location &loc, IPAddress &ip, double &dist) const
+{
+  bool found = false;
+  int32_t lat_cell = cell_of(loc.lat_ms());
+  int32_t lon_cell = cell_of(loc.lon_ms());
+  int n = size(), seen = 0, cells = 0;
+
+  for (int32_t ring = 0; seen < n; ring++) {
+    if (found && ring_bound(loc, ring) > dist)
+      return true;
+    cells += ring ? 8 * ring : 1;
+    if (cells > n)
+      break;
+    for (int32_t dlat = -ring; dlat <= ring; dlat++) {
+      int32_t step = (dlat == -ring || dlat == ring) ? 1 : 2 * ring;
+      for (int32_t dlon = -ring; dlon <= ring; dlon += step) {
+	HashTable<uint64_t, Vector<IPAddress> >::const_iterator c =
+	  _cells.find(make_key(lat_cell + dlat, lon_cell + dlon));
+	if (!c)
+	  continue;
+	const Vector<IPAddress> &v = c.value();
+	for (int i = 0; i < v.size(); i++)
+	  consider(loc, v[i], _locs.get(v[i]), found, ip, dist);
+	seen += v.size();
+      }
+    }
+  }
+
+  if (seen < n) {
+    // too sparse for the rings to pay off
+    found = false;
+    for (HashTable<IPAddress, grid_location>::const_iterator it = _locs.begin(); it.live(); it++)
+      consider(loc, it.key(), it.value(), found, ip, dist);
+  }
+  return found;
+}
+#endif
+
+CLICK_ENDDECLS
+#endif
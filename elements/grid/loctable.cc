@@ -48,10 +48,10 @@ LocationTable::read_args(const Vector<String> &conf, ErrorHandler *errh)
       return -1;
 
     grid_location loc((double) lat /  1.0e7, (double) lon /  1.0e7);
-    bool is_new = _locs.insert(ip, entry(loc, err));
-    if (!is_new)
+    if (_locs.get_pointer(ip))
       return errh->error("LocationTable %s: %s already has a location mapping",
 			 name().c_str(), ip.unparse().c_str());
+    set_location(ip, loc, err);
   }
   return 0;
 }
@@ -85,7 +85,7 @@ table_read_handler(Element *f, void *)
 bool
 LocationTable::get_location(IPAddress ip, grid_location &loc, int &err_radius)
 {
-  entry *l2 = _locs.findp(ip);
+  entry *l2 = _locs.get_pointer(ip);
   if (!l2)
     return false;
   loc = l2->loc;
@@ -93,6 +93,22 @@ LocationTable::get_location(IPAddress ip, grid_location &loc, int &err_radius)
   return true;
 }
 
+void
+LocationTable::set_location(IPAddress ip, const grid_location &loc, int err_radius)
+{
+  _locs.set(ip, entry(loc, err_radius));
+  if (err_radius >= 0)
+    _index.set(ip, loc);
+  else
+    _index.remove(ip);
+}
+
+bool
+LocationTable::get_nearest(const grid_location &loc, IPAddress &ip, double &dist) const
+{
+  return _index.nearest(loc, ip, dist);
+}
+
 
 static int
 loc_write_handler(const String &arg, Element *element,
@@ -111,7 +127,30 @@ loc_write_handler(const String &arg, Element *element,
   if (res < 0)
     return -1;
   grid_location loc((double) lat /  1.0e7, (double) lon /  1.0e7);
-  l->_locs.insert(ip, LocationTable::entry(loc, err));
+  l->set_location(ip, loc, err);
+  return 0;
+}
+
+static int
+nearest_read_handler(int, String &s, Element *element,
+		     const Handler *, ErrorHandler *errh)
+{
+  LocationTable *l = (LocationTable *) element;
+  int lat, lon;
+  if (Args(l, errh).push_back_words(s)
+      .read_mp("LATITUDE", DecimalFixedPointArg(7), lat)
+      .read_mp("LONGITUDE", DecimalFixedPointArg(7), lon)
+      .complete() < 0)
+    return -EINVAL;
+  grid_location loc((double) lat /  1.0e7, (double) lon /  1.0e7);
+  IPAddress ip;
+  double dist;
+  if (l->get_nearest(loc, ip, dist)) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), " %.1f\n", dist);
+    s = ip.unparse() + buf;
+  } else
+    s = String();
   return 0;
 }
 
@@ -120,6 +159,7 @@ LocationTable::add_handlers()
 {
   add_write_handler("loc", loc_write_handler, 0);
   add_read_handler("table", table_read_handler, 0);
+  set_handler("nearest", Handler::OP_READ | Handler::READ_PARAM, nearest_read_handler);
 }
 
 
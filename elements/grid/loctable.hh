@@ -23,12 +23,19 @@
  * =h table read
  * Returns the whole table, each line of the form ``ip lat lon error''
  *
+ * =h nearest read with parameter
+ * Takes ``lat lon'' and returns ``ip distance'' for the node, among
+ * those with believable locations, nearest that location, or nothing
+ * if there is none.  Uses a spatial index, so the cost grows with the
+ * number of nearby nodes rather than the size of the table.
+ *
  * =a
  * FixDstLoc */
 
 #include <click/element.hh>
 #include "grid.hh"
-#include <click/bighashmap.hh>
+#include "locindex.hh"
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 class LocationTable : public Element {
@@ -43,6 +50,9 @@ public:
   bool can_live_reconfigure() const { return true; }
 
   bool get_location(IPAddress ip, grid_location &loc, int &err_radius);
+  // find the node nearest loc whose error radius is not negative
+  bool get_nearest(const grid_location &loc, IPAddress &ip, double &dist) const;
+  void set_location(IPAddress ip, const grid_location &loc, int err_radius);
 
   void add_handlers();
   int read_args(const Vector<String> &conf, ErrorHandler *errh);
@@ -55,11 +65,12 @@ public:
     entry(grid_location l, int e) : loc(l), err(e) { }
     entry() : err(-1) { }
   };
-  typedef HashMap<IPAddress, entry> Table;
+  typedef HashTable<IPAddress, entry> Table;
   Table _locs;
 
 private:
 
+  GridLocationIndex _index;
 
 
 };
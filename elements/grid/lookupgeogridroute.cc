@@ -175,18 +175,28 @@ LookupGeographicGridRoute::get_next_geographic_hop(grid_location dest_loc, Ether
    * search through table for all nodes we have routes to and for whom
    * we know the position.  of these, choose the node closest to the
    * destination location to send the packet to.  Our node may be the
-   * closest; in that case, the packet should be dropped.
+   * closest; in that case, the packet should be dropped.  If the
+   * route table keeps a location index, ask it instead of scanning.
    */
 
   assert(_li->loc_good());
   double d = grid_location::calc_range(dest_loc, _li->get_current_location());
   bool found_one = false;
 
-  Vector<GridGenericRouteTable::RouteEntry> rtes;
-  _rt->get_all_entries(rtes);
-
   GridGenericRouteTable::RouteEntry best_nbr_entry;
 
+  if (const GridLocationIndex *index = _rt->location_index()) {
+    IPAddress best_ip;
+    if (!index->nearest(dest_loc, best_ip, d)
+	|| !_rt->get_one_entry(best_ip, best_nbr_entry))
+      return false;
+    found_one = true;
+  }
+
+  Vector<GridGenericRouteTable::RouteEntry> rtes;
+  if (!found_one)
+    _rt->get_all_entries(rtes);
+
   for (int i = 0; i < rtes.size(); i++) {
     const GridGenericRouteTable::RouteEntry &rte = rtes[i];
     if (!rte.loc_good)
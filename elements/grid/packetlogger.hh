@@ -33,6 +33,7 @@ class PacketLogger : public Element { public:
   ~PacketLogger();
 
   const char *class_name() const		{ return "PacketLogger"; }
+  const char *flags() const			{ return "T"; }
   const char *port_count() const		{ return PORTS_1_1; }
   const char *processing() const		{ return AGNOSTIC; }
 
@@ -41,6 +41,7 @@ class PacketLogger2 : public Element { public:
   ~PacketLogger2();
 
   const char *class_name() const		{ return "PacketLogger2"; }
+  const char *flags() const			{ return "T"; }
   const char *port_count() const		{ return PORTS_1_1; }
   const char *processing() const		{ return AGNOSTIC; }
   const char *flow_code() const			{ return "#/#"; }
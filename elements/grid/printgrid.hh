@@ -52,6 +52,7 @@ class PrintGrid : public Element {
   ~PrintGrid();
 
   const char *class_name() const		{ return "PrintGrid"; }
+  const char *flags() const			{ return _timestamp ? "T" : ""; }
   const char *port_count() const		{ return PORTS_1_1; }
   const char *processing() const		{ return AGNOSTIC; }
 
@@ -25,7 +25,7 @@
 CLICK_DECLS
 
 RadioSim::RadioSim()
-  : _task(this), _use_xy(false)
+  : _task(this), _timer(this), _reach_valid(false), _use_xy(false)
 {
 }
 
@@ -50,6 +50,11 @@ RadioSim::configure(Vector<String> &conf, ErrorHandler *errh)
 	      return errh->error("unable to parse boolean arg to USE_XY keyword");
 	  continue;
       }
+      if (kw == "SLOT") {
+	  if (!TimestampArg().parse(rest, _slot))
+	      return errh->error("unable to parse time arg to SLOT keyword");
+	  continue;
+      }
     }
 
     // otherwise it's coordinates
@@ -83,41 +88,78 @@ RadioSim::initialize(ErrorHandler *errh)
     _nodes.push_back(no);
   }
 
-  ScheduleInfo::join_scheduler(this, &_task, errh);
+  if (_slot) {
+    ScheduleInfo::initialize_task(this, &_task, false, errh);
+    _timer.initialize(this);
+    _timer.schedule_after(_slot);
+  } else
+    ScheduleInfo::join_scheduler(this, &_task, errh);
 
   return 0;
 }
 
+void
+RadioSim::rebuild_reach()
+{
+  int n = _nodes.size();
+  _reach.assign(n * n, 0);
+  for (int in = 0; in < n; in++)
+    for (int out = 0; out < n; out++) {
+      double r;
+      if (_use_xy) {
+	double dx = _nodes[in]._lat - _nodes[out]._lat;
+	double dy = _nodes[in]._lon - _nodes[out]._lon;
+	r = sqrt(dx*dx + dy*dy);
+      }
+      else {
+	grid_location g1 = grid_location(_nodes[in]._lat, _nodes[in]._lon);
+	grid_location g2 = grid_location(_nodes[out]._lat, _nodes[out]._lon);
+	r = grid_location::calc_range(g1, g2);
+      }
+      _reach[in * n + out] = (r < 250);
+    }
+  _reach_valid = true;
+}
+
+void
+RadioSim::run_timer(Timer *)
+{
+  _task.reschedule();
+  _timer.reschedule_after(_slot);
+}
+
 bool
 RadioSim::run_task(Task *)
 {
-  int in, out;
-
-  for(in = 0; in < ninputs(); in++){
-    Packet *p = input(in).pull();
-    if(p){
-      for(out = 0; out < noutputs(); out++){
-	double r;
-	if (_use_xy) {
-	  double dx = _nodes[in]._lat - _nodes[out]._lat;
-	  double dy = _nodes[in]._lon - _nodes[out]._lon;
-	  r = sqrt(dx*dx + dy*dy);
-	}
-	else {
-	  grid_location g1 = grid_location(_nodes[in]._lat, _nodes[in]._lon);
-	  grid_location g2 = grid_location(_nodes[out]._lat, _nodes[out]._lon);
-	  r = grid_location::calc_range(g1, g2);
-	}
-        if (r < 250){
-          output(out).push(p->clone());
-        }
-      }
-      p->kill();
+  int in, out, n = noutputs();
+
+  _lock.acquire();
+  if (!_reach_valid)
+    rebuild_reach();
+  _lock.release();
+
+  // pull first, so that nothing delivered this round is sent this round
+  Vector<Packet *> frames;
+  Vector<int> from;
+  for(in = 0; in < ninputs(); in++)
+    while (Packet *p = input(in).pull()) {
+      frames.push_back(p);
+      from.push_back(in);
+      if (!_slot)
+	break;
     }
+
+  for (int i = 0; i < frames.size(); i++) {
+    const unsigned char *reach = _reach.begin() + from[i] * n;
+    for(out = 0; out < n; out++)
+      if (reach[out])
+	output(out).push(frames[i]->clone());
+    frames[i]->kill();
   }
 
-  _task.fast_reschedule();
-  return true;
+  if (!_slot)
+    _task.fast_reschedule();
+  return !frames.empty();
 }
 
 RadioSim::Node
@@ -133,8 +175,11 @@ void
 RadioSim::set_node_loc(int i, double lat, double lon)
 {
   if(i >= 0 && i < _nodes.size()){
+    _lock.acquire();
     _nodes[i]._lat = lat;
     _nodes[i]._lon = lon;
+    _reach_valid = false;
+    _lock.release();
   }
 }
 
@@ -19,9 +19,19 @@
  * within 250 meters of node <i>.
  *
  * Inputs are pull, outputs are push. Services inputs in round
- * robin order.
+ * robin order.  Each round first pulls from every input, then
+ * delivers what it pulled, so a packet sent in response to a delivery
+ * is not seen until the next round.
  *
- * Keyword:
+ * The nodes of a large emulation can run on several threads (see
+ * StaticThreadSched).  RadioSim is then the only point where they
+ * meet: feed its inputs from ThreadSafeQueues, and have each output
+ * lead to a queue that the receiving node's thread drains.  Use SLOT
+ * to make the channel advance in fixed steps, so that the order of
+ * delivery depends on the step in which a packet is sent, not on how
+ * the threads happen to interleave.
+ *
+ * Keywords:
  *
  * =over 8
  *
@@ -31,6 +41,12 @@
  * of lat,lon in degrees.  lat is treated as x, and lon is treated as
  * y.
  *
+ * =item SLOT
+ *
+ * Time.  If nonzero, the channel advances once per SLOT: it pulls every
+ * packet waiting at its inputs, in input order, and then delivers them.
+ * Defaults to 0, which services the inputs continuously.
+ *
  * =back
  *
  * The loc read/write handler format is
@@ -40,6 +56,8 @@
 #include <click/vector.hh>
 #include "grid.hh"
 #include <click/task.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 
 class RadioSim : public Element {
@@ -57,7 +75,7 @@ class RadioSim : public Element {
   void add_handlers();
 
   bool run_task(Task *);
-
+  void run_timer(Timer *);
 
 
 private:
@@ -78,6 +96,15 @@ private:
 
   Vector<Node> _nodes;
   Task _task;
+  Timer _timer;
+  Timestamp _slot;
+
+  // _reach[i*n + j] is true iff node j hears node i.  The loc handler
+  // changes _nodes under _lock; the task then rebuilds _reach.
+  Vector<unsigned char> _reach;
+  bool _reach_valid;
+  Spinlock _lock;
+  void rebuild_reach();
 
   bool _use_xy;
 };
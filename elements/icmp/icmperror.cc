@@ -26,11 +26,13 @@
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
 #include <click/nameinfo.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 ICMPError::ICMPError()
-  : _type(-1), _code(-1)
+  : _type(-1), _code(-1), _prefix_mask(0)
 {
+  _rate_limited = 0;
 }
 
 ICMPError::~ICMPError()
@@ -54,6 +56,9 @@ ICMPError::configure(Vector<String> &conf, ErrorHandler *errh)
     int type, code;
     Vector<IPAddress> bad_addrs;
     bool use_fix_anno = true;
+    uint32_t rate = 0, burst = 0, buckets = 1024;
+    int prefix = 24;
+    bool burst_specified;
 
     if (Args(conf, this, errh)
 	.read_mp("SRC", src_ip)
@@ -63,6 +68,10 @@ ICMPError::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("MTU", mtu)
 	.read("PMTU", pmtu)
 	.read("SET_FIX_ANNO", use_fix_anno)
+	.read("RATE", rate)
+	.read("BURST", burst).read_status(burst_specified)
+	.read("PREFIX", prefix)
+	.read("BUCKETS", buckets)
 	.complete() < 0)
 	return -1;
 
@@ -73,6 +82,16 @@ ICMPError::configure(Vector<String> &conf, ErrorHandler *errh)
     if (!NameInfo::query_int(NameInfo::T_ICMP_CODE + type, this, code_str, &code)
 	|| code < 0 || code > 255)
 	return errh->error("argument 2 takes ICMP code (integer between 0 and 255)");
+    if (prefix < 0 || prefix > 32)
+	return errh->error("PREFIX must be between 0 and 32");
+    if (buckets < 1 || buckets > 0x1000000)
+	return errh->error("BUCKETS out of range");
+    if (!burst_specified)
+	burst = rate;
+    else if (burst < 1)
+	return errh->error("BURST must be at least 1");
+    if (_limiter.assign(rate, burst, buckets) < 0)
+	return errh->error("out of memory");
 
     _src_ip = src_ip;
     _type = type;
@@ -81,9 +100,31 @@ ICMPError::configure(Vector<String> &conf, ErrorHandler *errh)
     _mtu = mtu;
     _pmtu = pmtu;
     _use_fix_anno = use_fix_anno;
+    _prefix_mask = (prefix ? 0xFFFFFFFFU << (32 - prefix) : 0);
+    build_template();
     return 0;
 }
 
+void
+ICMPError::build_template()
+{
+    // The fixed fields of every error's IP and ICMP headers.
+    memset(_template, 0, sizeof(_template));
+    click_ip *nip = reinterpret_cast<click_ip *>(_template);
+    nip->ip_v = 4;
+    nip->ip_hl = sizeof(click_ip) >> 2;
+    nip->ip_tos = 0;		// XXX should be same as incoming datagram?
+    nip->ip_ttl = 200;
+    nip->ip_p = IP_PROTO_ICMP;
+    nip->ip_src = _src_ip.in_addr();
+
+    click_icmp *icp = reinterpret_cast<click_icmp *>(_template + sizeof(click_ip));
+    icp->icmp_type = _type;
+    icp->icmp_code = _code;
+    if (_type == ICMP_UNREACH && _code == ICMP_UNREACH_NEEDFRAG)
+	((click_icmp_needfrag *) icp)->icmp_nextmtu = htons(_pmtu);
+}
+
 /*
  * Is an IP address unicast?
  */
@@ -171,19 +212,19 @@ ICMPError::valid_source_route(const click_ip *iph)
   return 0;
 }
 
-Packet *
-ICMPError::simple_action(Packet *p)
+inline WritablePacket *
+ICMPError::generate(Packet *p, TokenRate::time_point_type now, const Timestamp &ts)
 {
-  WritablePacket *q = 0;
   const click_ip *ipp = p->ip_header();
   const uint8_t *source_route;
+  WritablePacket *q;
   click_ip *nip;
   click_icmp *icp;
-  unsigned hlen, xlen;
+  unsigned hlen, nhlen, xlen;
   static int id = 1;
 
   if (!p->has_network_header())
-    goto out;
+    return 0;
 
   hlen = ipp->ip_hl << 2;
 
@@ -193,30 +234,30 @@ ICMPError::simple_action(Packet *p)
   if(ipp->ip_p == IP_PROTO_ICMP) {
     const click_icmp *icmph = p->icmp_header();
     if(hlen + 4 > p->length() || is_error_type(icmph->icmp_type))
-      goto out;
+      return 0;
   }
 
   /* Don't respond to packets with IP broadcast destinations. */
   if(!unicast(ipp->ip_dst))
-    goto out;
+    return 0;
 
   /* Don't respond to e.g. Ethernet broadcasts or multicasts. */
   if (p->packet_type_anno() == Packet::BROADCAST || p->packet_type_anno() == Packet::MULTICAST)
-    goto out;
+    return 0;
 
   /* Don't respond is src is net 0 or invalid. */
   if(!valid_source(ipp->ip_src))
-    goto out;
+    return 0;
 
   /* Don't respond to fragments other than the first. */
   if(!IP_FIRSTFRAG(ipp))
-    goto out;
+    return 0;
 
   source_route = valid_source_route(ipp);
   if (source_route) {
     /* Don't send a redirect for a source-routed packet. 5.2.7.2 */
     if (_type == ICMP_REDIRECT)
-      goto out;
+      return 0;
 
     /* Ignore source route if ICMP Parameter Problem concerns the source
        route. 4.3.2.6 */
@@ -226,22 +267,29 @@ ICMPError::simple_action(Packet *p)
       source_route = 0;
   }
 
+  /* Limit the error rate per source prefix. 4.3.2.8 */
+  if (!_limiter.allow(ntohl(ipp->ip_src.s_addr) & _prefix_mask, now)) {
+    _rate_limited++;
+    return 0;
+  }
+
   // maximum size of ICMP packet is 576 bytes. 4.3.2.3
-  q = Packet::make(_mtu);	// we made it configurable
+  // (we made it configurable); size the packet exactly
+  nhlen = sizeof(click_ip) + (source_route ? (source_route[2] + 2) & ~3 : 0);
+  xlen = p->network_length();
+  if (nhlen + sizeof(click_icmp) + xlen > _mtu)
+    xlen = (_mtu > nhlen + sizeof(click_icmp) ? _mtu - nhlen - sizeof(click_icmp) : 0);
+  q = Packet::make(nhlen + sizeof(click_icmp) + xlen);
   if (!q)
-    goto out;
+    return 0;
 
-  // prepare IP header; guaranteed that packet data is aligned
+  // prepare IP header from the template; guaranteed that packet data is
+  // aligned
   nip = reinterpret_cast<click_ip *>(q->data());
-
-  nip->ip_v = 4;
-  nip->ip_tos = 0;		// XXX should be same as incoming datagram?
+  icp = reinterpret_cast<click_icmp *>(q->data() + nhlen);
+  memcpy(nip, _template, sizeof(click_ip));
+  memcpy(icp, _template + sizeof(click_ip), sizeof(click_icmp));
   nip->ip_id = htons(id++);
-  nip->ip_off = 0;
-  nip->ip_ttl = 200;
-  nip->ip_p = IP_PROTO_ICMP;
-  nip->ip_sum = 0;
-  nip->ip_src = _src_ip.in_addr();
   nip->ip_dst = ipp->ip_src;
 
   // include reversed source route if appropriate 4.3.2.6
@@ -255,17 +303,9 @@ ICMPError::simple_action(Packet *p)
     o += 3;
     for (const uint8_t *oo = source_route + source_route[2] - 5; oo >= source_route + 3; oo -= 4, o += 4)
       memcpy(o, oo, 4);
-    nip->ip_hl = (sizeof(click_ip) + olen + 3) >> 2;
-  } else
-    nip->ip_hl = sizeof(click_ip) >> 2;
-  q->set_ip_header(nip, nip->ip_hl << 2);
-
-  // now, prepare ICMP header
-  icp = q->icmp_header();
-  icp->icmp_type = _type;
-  icp->icmp_code = _code;
-  icp->icmp_cksum = 0;
-  icp->padding = 0;
+    nip->ip_hl = nhlen >> 2;
+  }
+  q->set_ip_header(nip, nhlen);
 
   // set ICMP particulars
   if (_type == ICMP_PARAMPROB && _code == ICMP_PARAMPROB_ERRATPTR)
@@ -273,41 +313,107 @@ ICMPError::simple_action(Packet *p)
     ((click_icmp_paramprob *) icp)->icmp_pointer = ICMP_PARAMPROB_ANNO(p);
   if (_type == ICMP_REDIRECT)
     ((click_icmp_redirect *) icp)->icmp_gateway = p->dst_ip_anno();
-  if (_type == ICMP_UNREACH && _code == ICMP_UNREACH_NEEDFRAG)
-    ((click_icmp_needfrag *) icp)->icmp_nextmtu = htons(_pmtu);
 
   // copy packet contents
-  xlen = q->end_data() - (uint8_t *)(icp + 1);
-  if ((int)xlen > p->network_length()) {
-    q->take(xlen - p->network_length());
-    xlen = p->network_length();
-  }
   memcpy((uint8_t *)(icp + 1), p->network_header(), xlen);
   icp->icmp_cksum = click_in_cksum((unsigned char *)icp, sizeof(click_icmp) + xlen);
 
   // finish off IP header
   nip->ip_len = htons(q->network_length());
-  nip->ip_sum = click_in_cksum((unsigned char *)nip, nip->ip_hl << 2);
+  nip->ip_sum = click_in_cksum((unsigned char *)nip, nhlen);
 
   // set annotations
   q->set_dst_ip_anno(IPAddress(nip->ip_dst));
   if (_use_fix_anno)
     SET_FIX_IP_SRC_ANNO(q, 1);
-  q->timestamp_anno().assign_now();
+  q->timestamp_anno() = ts;
+  return q;
+}
 
- out:
+Packet *
+ICMPError::simple_action(Packet *p)
+{
+  WritablePacket *q = generate(p, _limiter.now(), Timestamp::now());
   p->kill();
-  return(q);
+  return q;
+}
+
+void
+ICMPError::simple_action_batch(PacketBatch &batch)
+{
+  // A burst of errors shares one clock read.
+  TokenRate::time_point_type now = _limiter.now();
+  Timestamp ts = Timestamp::now();
+  PacketBatch out;
+  while (Packet *p = batch.pop_front()) {
+    if (WritablePacket *q = generate(p, now, ts))
+      out.push_back(q);
+    p->kill();
+  }
+  batch.swap(out);
+}
+
+void
+ICMPError::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+ICMPError::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
+enum { h_src, h_mtu, h_pmtu, h_rate_limited };
+
+String
+ICMPError::read_handler(Element *e, void *)
+{
+  ICMPError *ie = static_cast<ICMPError *>(e);
+  return String(ie->_rate_limited.value());
+}
+
+int
+ICMPError::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+  ICMPError *ie = static_cast<ICMPError *>(e);
+  String s = cp_uncomment(str);
+  switch ((uintptr_t) thunk) {
+  case h_src:
+    if (!IPAddressArg().parse(s, ie->_src_ip))
+      return errh->error("syntax error");
+    break;
+  case h_mtu:
+    if (!IntArg().parse(s, ie->_mtu))
+      return errh->error("syntax error");
+    break;
+  case h_pmtu:
+    if (!IntArg().parse(s, ie->_pmtu))
+      return errh->error("syntax error");
+    break;
+  }
+  ie->build_template();
+  return 0;
 }
 
 void
 ICMPError::add_handlers()
 {
-    add_data_handlers("src", Handler::OP_READ | Handler::OP_WRITE, &_src_ip);
-    add_data_handlers("mtu", Handler::OP_READ | Handler::OP_WRITE, &_mtu);
-    add_data_handlers("pmtu", Handler::OP_READ | Handler::OP_WRITE, &_pmtu);
+    add_data_handlers("src", Handler::OP_READ, &_src_ip);
+    add_write_handler("src", write_handler, h_src);
+    add_data_handlers("mtu", Handler::OP_READ, &_mtu);
+    add_write_handler("mtu", write_handler, h_mtu);
+    add_data_handlers("pmtu", Handler::OP_READ, &_pmtu);
+    add_write_handler("pmtu", write_handler, h_pmtu);
+    add_read_handler("rate_limited", read_handler, h_rate_limited);
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(ICMPErrorLimiter)
 EXPORT_ELEMENT(ICMPError)
 ELEMENT_MT_SAFE(ICMPError)
@@ -1,11 +1,15 @@
 #ifndef CLICK_ICMPERROR_HH
 #define CLICK_ICMPERROR_HH
 #include <click/element.hh>
+#include <click/atomic.hh>
+#include <clicknet/ip.h>
+#include <clicknet/icmp.h>
+#include "icmperrorlimiter.hh"
 CLICK_DECLS
 
 /*
  * =c
- * ICMPError(SRC, TYPE [, CODE, I<keywords> BADADDRS, MTU])
+ * ICMPError(SRC, TYPE [, CODE, I<keywords> BADADDRS, MTU, RATE, BURST, PREFIX, BUCKETS])
  * =s icmp
  * generates ICMP error packets
  * =d
@@ -27,8 +31,12 @@ CLICK_DECLS
  *
  * The intent is that elements that give rise to errors, like DecIPTTL,
  * should have two outputs, one of which is connected to an ICMPError.
- * Perhaps the ICMPError should be followed by a rate limiting
- * element.
+ * A TTL-expiry storm, such as a routing loop after a route flap, can
+ * otherwise make the router spend all its time generating errors, so
+ * ICMPError can limit the rate itself: with RATE set, each source prefix
+ * may receive at most RATE errors per second, and packets over the limit
+ * are dropped before any error is built.  RFC1812 4.3.2.8 asks for such a
+ * limit.
  *
  * ICMPError never generates a packet in response to an ICMP error packet, a
  * fragment, or a link broadcast. The BADADDRS keyword argument supplies an
@@ -60,6 +68,10 @@ CLICK_DECLS
  *
  * Will not generate a packet larger than MTU, which defaults to 576.
  *
+ * The fixed parts of the error's IP and ICMP headers are prepared at
+ * configuration time, and each error is copied from them.  A batch of
+ * packets is turned into a batch of errors with one clock read.
+ *
  * Keyword arguments are:
  *
  * =over 8
@@ -83,16 +95,40 @@ CLICK_DECLS
  * Boolean.  If false, do not set the fix_ip_src annotation on output packets.
  * Defaults to true.
  *
+ * =item RATE
+ *
+ * Unsigned.  The maximum number of errors per second sent to each source
+ * prefix.  0 means unlimited.  Defaults to 0.
+ *
+ * =item BURST
+ *
+ * Unsigned.  The number of errors a prefix may receive at once after a quiet
+ * period.  Defaults to RATE.
+ *
+ * =item PREFIX
+ *
+ * Integer between 0 and 32.  Sources are limited together when their first
+ * PREFIX bits match.  Defaults to 24.
+ *
+ * =item BUCKETS
+ *
+ * Unsigned.  The number of token buckets, rounded up to a power of two.
+ * Prefixes are hashed to buckets, and prefixes that collide share a limit.
+ * Defaults to 1024.
+ *
  * =back
  *
+ * =h rate_limited read-only
+ *
+ * Returns the number of packets dropped by the rate limit.
+ *
  * =e
  * This configuration fragment produces ICMP Time Exceeded error
  * messages in response to TTL expirations, but limits the
- * rate at which such messages can be sent to 10 per second:
+ * rate at which such messages can be sent to each /24 to 10 per second:
  *
  *   dt : DecIPTTL;
- *   dt[1] -> ICMPError(18.26.4.24, timeexceeded) -> m :: RatedSplitter(10) -> ...
- *   m[1] -> Discard;
+ *   dt[1] -> ICMPError(18.26.4.24, timeexceeded, RATE 10) -> ...
  *
  * =n
  *
@@ -100,7 +136,7 @@ CLICK_DECLS
  * IP directed broadcast address; it is supposed to ignore packets with such
  * addresses.
  *
- * =a DecIPTTL, FixIPSrc, IPGWOptions */
+ * =a DecIPTTL, FixIPSrc, IPGWOptions, ICMP6Error */
 
 class ICMPError : public Element { public:
 
@@ -115,6 +151,9 @@ class ICMPError : public Element { public:
     void add_handlers();
 
     Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &batch);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
   private:
 
@@ -125,11 +164,20 @@ class ICMPError : public Element { public:
     unsigned _mtu;
     unsigned _pmtu;
     bool _use_fix_anno;
+    uint32_t _prefix_mask;
+    ICMPErrorLimiter _limiter;
+    atomic_uint32_t _rate_limited;
+    uint8_t _template[sizeof(click_ip) + sizeof(click_icmp)];
 
     static bool is_error_type(int);
     bool unicast(struct in_addr) const;
     bool valid_source(struct in_addr) const;
     static const uint8_t *valid_source_route(const click_ip *ip);
+    void build_template();
+    inline WritablePacket *generate(Packet *p, TokenRate::time_point_type now, const Timestamp &ts);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
 
 };
 
@@ -0,0 +1,56 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * icmperrorlimiter.{cc,hh} -- per-prefix rate limits for ICMP errors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "icmperrorlimiter.hh"
+#include <click/glue.hh>
+CLICK_DECLS
+
+ICMPErrorLimiter::ICMPErrorLimiter()
+    : _buckets(0), _mask(0)
+{
+    _rate.assign(true);
+}
+
+ICMPErrorLimiter::~ICMPErrorLimiter()
+{
+    delete[] _buckets;
+}
+
+int
+ICMPErrorLimiter::assign(uint32_t rate, uint32_t burst, uint32_t nbuckets)
+{
+    TokenCounter *buckets = 0;
+    uint32_t n = 1;
+    if (rate) {
+	while (n < nbuckets)
+	    n *= 2;
+	if (!(buckets = new TokenCounter[n]))
+	    return -ENOMEM;
+	for (uint32_t i = 0; i != n; ++i)
+	    buckets[i].set_full();
+    }
+    if (rate)
+	_rate.assign(rate, burst);
+    else
+	_rate.assign(true);
+    delete[] _buckets;
+    _mask = n - 1;
+    _buckets = buckets;
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(ICMPErrorLimiter)
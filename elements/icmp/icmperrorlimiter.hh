@@ -0,0 +1,65 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ICMPERRORLIMITER_HH
+#define CLICK_ICMPERRORLIMITER_HH
+#include <click/tokenbucket.hh>
+CLICK_DECLS
+
+/** @brief Per-source-prefix token buckets for ICMP error generation.
+ *
+ * An ICMPErrorLimiter keeps a fixed array of token counters sharing one
+ * rate.  A source prefix, folded to 32 bits, hashes to one counter, and an
+ * error is sent only if that counter has a token.  Prefixes that collide
+ * share a counter, so memory stays fixed however many sources are seen; a
+ * flood from one prefix starves at most the few prefixes that share its
+ * counter.
+ *
+ * Counters are not locked.  Threads that race on one counter may let an
+ * extra error through, which is harmless. */
+class ICMPErrorLimiter { public:
+
+    ICMPErrorLimiter();
+    ~ICMPErrorLimiter();
+
+    /** @brief Limit each prefix to @a rate errors per second, with bursts
+     * of up to @a burst, using @a nbuckets counters.
+     * @return 0 on success, -ENOMEM on failure
+     *
+     * @a nbuckets is rounded up to a power of two.  If @a rate is 0, every
+     * error is allowed and no counters are allocated.  Every counter starts
+     * full. */
+    int assign(uint32_t rate, uint32_t burst, uint32_t nbuckets);
+
+    bool limited() const	{ return _buckets; }
+
+    TokenRate::time_point_type now() const {
+	return _rate.now();
+    }
+
+    /** @brief Take a token for prefix @a key at time @a now.
+     * @return true if the error may be sent */
+    bool allow(uint32_t key, TokenRate::time_point_type now) {
+	if (!_buckets)
+	    return true;
+	TokenCounter &c = _buckets[hash(key)];
+	c.refill(_rate, now);
+	return c.remove_if(_rate, 1);
+    }
+
+  private:
+
+    TokenRate _rate;
+    TokenCounter *_buckets;
+    uint32_t _mask;
+
+    uint32_t hash(uint32_t key) const {
+	uint32_t h = key * 0x9E3779B1U;
+	return (h ^ (h >> 16)) & _mask;
+    }
+
+    ICMPErrorLimiter(const ICMPErrorLimiter &);
+    ICMPErrorLimiter &operator=(const ICMPErrorLimiter &);
+
+};
+
+CLICK_ENDDECLS
+#endif
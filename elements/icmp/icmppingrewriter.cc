@@ -140,7 +140,7 @@ ICMPPingRewriter::add_flow(int, const IPFlowID &flowid,
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, _map);
 }
 
 void
@@ -37,7 +37,7 @@ CLICK_CXX_UNPROTECT
 CLICK_DECLS
 
 ICMPPingSource::ICMPPingSource()
-    : _limit(-1), _timer(this), _receiver(0)
+    : _limit(-1), _receiver(0), _pinger(this)
 {
 }
 
@@ -79,9 +79,8 @@ int
 ICMPPingSource::initialize(ErrorHandler *errh)
 {
     _count = 0;
-    _timer.initialize(this);
-    if (_limit != 0 && _active && output_is_push(0))
-	_timer.schedule_after_msec(_interval);
+    if (output_is_push(0))
+	_pinger.initialize(this);
     if (ninputs() == 1) {
 #if CLICK_LINUXMODULE
 	_receiver = (ReceiverInfo *)vmalloc(sizeof(ReceiverInfo));
@@ -98,6 +97,7 @@ ICMPPingSource::initialize(ErrorHandler *errh)
 void
 ICMPPingSource::cleanup(CleanupStage)
 {
+    _pinger.cleanup();
     if (_receiver) {
 	if (_verbose) {
 	    PrefixErrorHandler perrh(ErrorHandler::default_handler(), declaration() + ": ");
@@ -154,15 +154,25 @@ ICMPPingSource::make_packet()
     return q;
 }
 
-void
-ICMPPingSource::run_timer(Timer *)
+bool
+ICMPPingSource::Pinger::run()
 {
-    if (Packet *q = make_packet()) {
-	output(0).push(q);
-	_count++;
-	if (_count < _limit || _limit < 0)
-	    _timer.reschedule_after_msec(_interval);
+    CLICK_CO_BEGIN;
+    _next = Timestamp::now_steady();
+    while (1) {
+	_next += Timestamp::make_msec(_ps->_interval);
+	CLICK_CO_SLEEP_UNTIL(_next);
+	if (!_ps->sending()) {
+	    CLICK_CO_AWAIT(_ps->sending());
+	    // reactivated: ping now, then every INTERVAL from now
+	    _next = Timestamp::now_steady();
+	}
+	if (Packet *q = _ps->make_packet()) {
+	    _ps->output(0).push(q);
+	    _ps->_count++;
+	}
     }
+    CLICK_CO_END;
 }
 
 Packet*
@@ -273,10 +283,8 @@ ICMPPingSource::write_handler(const String &s, Element *e, void *thunk, ErrorHan
     case H_ACTIVE:
 	if (!BoolArg().parse(s, ps->_active))
 	    return errh->error("type mismatch");
-	if (ps->_active && !ps->_timer.scheduled() && ps->output_is_push(0))
-	    ps->_timer.schedule_now();
-	else if (!ps->_active)
-	    ps->_timer.unschedule();
+	if (ps->_active && ps->output_is_push(0))
+	    ps->_pinger.wake();
 	return 0;
     case H_SRC:
 	if (!IPAddressArg().parse(s, ps->_src))
@@ -289,8 +297,8 @@ ICMPPingSource::write_handler(const String &s, Element *e, void *thunk, ErrorHan
       case H_LIMIT:
 	  if (!IntArg().parse(s, ps->_limit))
 	    return errh->error("'limit' should be integer");
-	if ((ps->_count < ps->_limit || ps->_limit < 0) && ps->_active && !ps->_timer.scheduled() && ps->output_is_push(0))
-	    ps->_timer.schedule_after_msec(ps->_interval);
+	if (ps->sending() && !ps->_pinger.sleeping() && ps->output_is_push(0))
+	    ps->_pinger.restart();
 	return 0;
       case H_INTERVAL:
 	  if (!SecondsArg(3).parse_saturating(s, ps->_interval))
@@ -300,8 +308,8 @@ ICMPPingSource::write_handler(const String &s, Element *e, void *thunk, ErrorHan
 	ps->_count = 0;
 	if (ReceiverInfo *ri = ps->_receiver)
 	    memset(ri, 0, sizeof(ReceiverInfo));
-	if (ps->_count < ps->_limit && ps->_active && !ps->_timer.scheduled() && ps->output_is_push(0))
-	    ps->_timer.schedule_after_msec(ps->_interval);
+	if (ps->sending() && !ps->_pinger.sleeping() && ps->output_is_push(0))
+	    ps->_pinger.restart();
 	return 0;
       default:
 	return -1;
@@ -330,4 +338,5 @@ ICMPPingSource::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(Coroutine)
 EXPORT_ELEMENT(ICMPPingSource ICMPPingSource-ICMPSendPings)
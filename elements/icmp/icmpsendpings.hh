@@ -2,8 +2,8 @@
 #ifndef CLICK_ICMPSENDPINGS_HH
 #define CLICK_ICMPSENDPINGS_HH
 #include <click/element.hh>
-#include <click/timer.hh>
 #include <click/ipaddress.hh>
+#include "elements/standard/coroutine.hh"
 CLICK_DECLS
 
 /*
@@ -119,6 +119,7 @@ class ICMPPingSource : public Element { public:
     ~ICMPPingSource();
 
     const char *class_name() const		{ return "ICMPPingSource"; }
+    const char *flags() const			{ return "T"; }
     const char *port_count() const		{ return "0-1/1"; }
     const char *processing() const		{ return "h/a"; }
     int configure(Vector<String> &, ErrorHandler *);
@@ -126,7 +127,6 @@ class ICMPPingSource : public Element { public:
     void cleanup(CleanupStage);
     void add_handlers();
 
-    void run_timer(Timer *);
     void push(int, Packet *);
     Packet* pull(int);
 
@@ -138,7 +138,6 @@ class ICMPPingSource : public Element { public:
     int _limit;
     uint16_t _icmp_id;
     uint32_t _interval;
-    Timer _timer;
     String _data;
     bool _active;
     bool _verbose;
@@ -159,6 +158,22 @@ class ICMPPingSource : public Element { public:
     };
     ReceiverInfo *_receiver;
 
+    class Pinger : public Coroutine { public:
+	Pinger(ICMPPingSource *ps)
+	    : _ps(ps) {
+	}
+      protected:
+	bool run();
+      private:
+	ICMPPingSource *_ps;
+	Timestamp _next;	// steady time of the next ping
+    };
+    Pinger _pinger;
+    friend class Pinger;
+
+    bool sending() const {
+	return _active && (_count < _limit || _limit < 0);
+    }
     Packet* make_packet();
     static String read_handler(Element*, void*);
     static int write_handler(const String&, Element*, void*, ErrorHandler*);
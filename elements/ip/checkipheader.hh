@@ -115,9 +115,13 @@ class CheckIPHeader : public Element { public:
   const char *flags() const			{ return "A"; }
 
   int configure(Vector<String> &, ErrorHandler *);
+  bool input_alignment(int &modulus, int &offset) const;
   void add_handlers();
 
   Packet *simple_action(Packet *);
+  void simple_action_batch(PacketBatch &batch);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, PacketBatch &batch, int max);
 
   struct OldBadSrcArg {
       static bool parse(const String &str, Vector<IPAddress> &result,
@@ -158,7 +162,11 @@ class CheckIPHeader : public Element { public:
   };
   static const char * const reason_texts[NREASONS];
 
+  enum { lanes = 8 };
+
   Packet *drop(Reason, Packet *);
+  inline Packet *accept(Packet *p, const click_ip *ip, unsigned plen);
+  unsigned check_lanes(Packet * const *p, int n) const;
   static String read_handler(Element *, void *);
 
   friend class CheckIPHeader2;
@@ -69,6 +69,18 @@ DirectIPLookup::Table::cleanup()
     _rt_hashtbl = 0;
 }
 
+size_t
+DirectIPLookup::Table::memory() const
+{
+    size_t m = sizeof(Table);
+    if (_tbl_0_23)
+	m += (sizeof(uint16_t) + sizeof(uint8_t)) * ((1 << 24) + _tbl_24_31_capacity)
+	    + sizeof(VirtualPort) * _vport_capacity
+	    + sizeof(CleartextEntry) * _rtable_capacity
+	    + sizeof(int) * PREF_HASHSIZE;
+    return m;
+}
+
 
 inline uint32_t
 DirectIPLookup::Table::prefix_hash(uint32_t prefix, uint32_t len)
@@ -488,27 +500,33 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 // DIRECTIPLOOKUP
 
 DirectIPLookup::DirectIPLookup()
+    : _t(new Table)
 {
 }
 
 DirectIPLookup::~DirectIPLookup()
 {
+    delete _t;
 }
 
 int
 DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     int r;
-    if ((r = _t.initialize()) < 0)
+    if (!_t)
+	return -ENOMEM;
+    if ((r = _t->initialize()) < 0)
 	return r;
-    _t.flush();
+    _t->flush();
     return IPRouteTable::configure(conf, errh);
 }
 
 void
 DirectIPLookup::cleanup(CleanupStage)
 {
-    _t.cleanup();
+    reclaim_tables(true);
+    if (_t)
+	_t->cleanup();
 }
 
 void
@@ -528,26 +546,89 @@ DirectIPLookup::push(int, Packet *p)
 int
 DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const Table *t = _t;
     uint32_t ip_addr = ntohl(dest.addr());
-    uint16_t vport_i = _t._tbl_0_23[ip_addr >> 8];
+    uint16_t vport_i = t->_tbl_0_23[ip_addr >> 8];
 
     if (vport_i & 0x8000)
-        vport_i = _t._tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+        vport_i = t->_tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
 
-    gw = _t._vport[vport_i].gw;
-    return _t._vport[vport_i].port;
+    gw = t->_vport[vport_i].gw;
+    return t->_vport[vport_i].port;
+}
+
+void
+DirectIPLookup::lookup_routes(int n, const IPAddress *addr, IPAddress *gw, int *port) const
+{
+    const Table *t = _t;
+    uint32_t a[BATCH_LANES];
+    uint16_t vport_i[BATCH_LANES];
+    for (; n > 0; n -= BATCH_LANES, addr += BATCH_LANES,
+	     gw += BATCH_LANES, port += BATCH_LANES) {
+	int m = (n < BATCH_LANES ? n : BATCH_LANES);
+	// Start every lane's load from each level before using any of them.
+	for (int i = 0; i < m; ++i) {
+	    a[i] = ntohl(addr[i].addr());
+	    prefetch_entry(&t->_tbl_0_23[a[i] >> 8]);
+	}
+	for (int i = 0; i < m; ++i) {
+	    vport_i[i] = t->_tbl_0_23[a[i] >> 8];
+	    if (vport_i[i] & 0x8000)
+		prefetch_entry(&t->_tbl_24_31[((vport_i[i] & 0x7fff) << 8) | (a[i] & 0xff)]);
+	    else
+		prefetch_entry(&t->_vport[vport_i[i]]);
+	}
+	for (int i = 0; i < m; ++i)
+	    if (vport_i[i] & 0x8000) {
+		vport_i[i] = t->_tbl_24_31[((vport_i[i] & 0x7fff) << 8) | (a[i] & 0xff)];
+		prefetch_entry(&t->_vport[vport_i[i]]);
+	    }
+	for (int i = 0; i < m; ++i) {
+	    gw[i] = t->_vport[vport_i[i]].gw;
+	    port[i] = t->_vport[vport_i[i]].port;
+	}
+    }
 }
 
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.add_route(route, allow_replace, old_route, errh);
+    return _t->add_route(route, allow_replace, old_route, errh);
 }
 
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.remove_route(route, old_route, errh);
+    return _t->remove_route(route, old_route, errh);
+}
+
+static void
+destroy_table(void *t)
+{
+    delete static_cast<DirectIPLookup::Table *>(t);
+}
+
+int
+DirectIPLookup::replace_routes(const Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    // Build the new table off to the side, then publish it with one store.
+    Table *t = new Table;
+    int r = (t ? t->initialize() : -ENOMEM);
+    if (r >= 0) {
+	t->flush();
+	for (const IPRoute *rt = routes.begin(); rt != routes.end() && r >= 0; ++rt)
+	    if ((r = t->add_route(*rt, true, 0, errh)) == -ENOMEM)
+		errh->error("no memory to store route %<%s%>", rt->unparse().c_str());
+    }
+    if (r < 0) {
+	delete t;
+	return r;
+    }
+    click_fence();
+    Table *old_t = _t;
+    _t = t;
+    retire_table(old_t, destroy_table);
+    return 0;
 }
 
 int
@@ -555,14 +636,22 @@ DirectIPLookup::flush_handler(const String &, Element *e, void *,
 				ErrorHandler *)
 {
     DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
-    t->_t.flush();
+    t->_table_lock.acquire();
+    t->_t->flush();
+    t->_table_lock.release();
     return 0;
 }
 
 String
 DirectIPLookup::dump_routes()
 {
-    return _t.dump();
+    return _t->dump();
+}
+
+size_t
+DirectIPLookup::memory_usage() const
+{
+    return _t->memory() + IPRouteTable::memory_usage();
 }
 
 void
@@ -33,6 +33,10 @@ relatively low CPU overhead, allowing for high update rates.
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+When packets arrive in a batch, DirectIPLookup issues the first-level table
+loads for up to 16 destinations before reading any of them, then the
+second-level loads, so their DRAM accesses overlap.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -65,6 +69,25 @@ operation.
 
 Clears the entire routing table in a single atomic operation.
 
+=h load read/write
+
+When written, parses routes, one per line in the `C<ADDR/MASK [GW] OUT>'
+format, and saves them for a later C<commit>; a bad line rejects the whole
+write.  Several writes may be made in a row.  Returns the number of routes
+saved.
+
+=h commit write-only
+
+Replaces the routing table with the routes saved by C<load>.  The new table
+is built in separate memory and installed by a single pointer store, so
+lookups see either the old table or the new one.  The old table is freed at
+a later commit or at cleanup, after a one-second grace period.  A full table
+thus needs twice the usual memory while it is being replaced.
+
+=h abort write-only
+
+Forgets the routes saved by C<load>.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -102,7 +125,10 @@ class DirectIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_routes(int n, const IPAddress *addr, IPAddress *gw, int *port) const;
     String dump_routes();
+    int replace_routes(const Vector<IPRoute> &, ErrorHandler *);
+    size_t memory_usage() const;
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
@@ -166,6 +192,7 @@ class DirectIPLookup : public IPRouteTable { public:
 
 	int initialize();
 	void cleanup();
+	size_t memory() const;
 
 	static inline uint32_t prefix_hash(uint32_t, uint32_t);
 
@@ -183,7 +210,7 @@ class DirectIPLookup : public IPRouteTable { public:
 
   protected:
 
-    Table _t;
+    Table * volatile _t;
 
     friend class RangeIPLookup;
 
@@ -0,0 +1,530 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * dxriplookup.{cc,hh} -- IP routing lookup through binary search in
+ * per-/16 range arrays, with incremental, lock-free updates
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "dxriplookup.hh"
+#include <click/ipaddress.hh>
+#include <click/straccum.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/error.hh>
+#include <click/sync.hh>
+#include "elements/standard/classification.hh"
+CLICK_DECLS
+
+DXRIPLookup::DXRIPLookup()
+    : _direct((uintptr_t *) CLICK_LALLOC(NCHUNKS * sizeof(uintptr_t))),
+      _nexthop((NextHop *) CLICK_LALLOC(16 * sizeof(NextHop))),
+      _nexthop_capacity(16), _route_free(-1), _nroutes(0),
+      _prefix_map(-1), _nexthop_map(-1), _deferred(false),
+      _nranged(0), _nranges(0)
+{
+    if (_direct)
+	for (int c = 0; c < NCHUNKS; ++c)
+	    _direct[c] = 1;
+    if (_nexthop) {
+	_nexthop[0].gw = IPAddress();
+	_nexthop[0].port = -1;
+    }
+    _nexthop_refcount.push_back(1);
+    _chunk_routes.assign(NCHUNKS, -1);
+    _dirty.assign(NCHUNKS, false);
+}
+
+DXRIPLookup::~DXRIPLookup()
+{
+}
+
+int
+DXRIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (!_direct || !_nexthop)
+	return errh->error("out of memory");
+    _deferred = true;
+    int r = IPRouteTable::configure(conf, errh);
+    _deferred = false;
+    commit();
+    return r;
+}
+
+void
+DXRIPLookup::cleanup(CleanupStage)
+{
+    if (_direct) {
+	for (int c = 0; c < NCHUNKS; ++c)
+	    if (!(_direct[c] & 1)) {
+		uint32_t *r = reinterpret_cast<uint32_t *>(_direct[c]);
+		CLICK_LFREE(r, (r[0] + 1) * sizeof(uint32_t));
+	    }
+	CLICK_LFREE(_direct, NCHUNKS * sizeof(uintptr_t));
+	_direct = 0;
+    }
+    reclaim(true);
+    if (_nexthop)
+	CLICK_LFREE(_nexthop, _nexthop_capacity * sizeof(NextHop));
+    _nexthop = 0;
+}
+
+
+bool
+DXRIPLookup::sole_thread() const
+{
+#if HAVE_MULTITHREAD
+    return master()->nthreads() <= 1;
+#else
+    return true;
+#endif
+}
+
+void
+DXRIPLookup::retire(void *p, size_t size, int nexthop)
+{
+    if (sole_thread()) {
+	if (p)
+	    CLICK_LFREE(p, size);
+	else
+	    _nexthop_free.push_back(nexthop);
+    } else {
+	Retired r;
+	r.p = p;
+	r.size = size;
+	r.nexthop = nexthop;
+	r.when = Timestamp::now_steady();
+	_retired.push_back(r);
+    }
+}
+
+void
+DXRIPLookup::reclaim(bool all)
+{
+    // Lookups that started before a chunk was replaced may still be reading
+    // it; free it only once they must have finished.
+    Timestamp limit = Timestamp::now_steady() - Timestamp::make_msec(GRACE_MSEC);
+    int i = 0;
+    for (; i < _retired.size() && (all || _retired[i].when <= limit); ++i)
+	if (_retired[i].p)
+	    CLICK_LFREE(_retired[i].p, _retired[i].size);
+	else
+	    _nexthop_free.push_back(_retired[i].nexthop);
+    _retired.erase(_retired.begin(), _retired.begin() + i);
+}
+
+int
+DXRIPLookup::nexthop_ref(const IPRoute &route)
+{
+    uint64_t key = nexthop_key(route);
+    int nh = _nexthop_map.get(key);
+    if (nh >= 0) {
+	++_nexthop_refcount[nh];
+	return nh;
+    }
+
+    if (_nexthop_free.size()) {
+	nh = _nexthop_free.back();
+	_nexthop_free.pop_back();
+    } else if (_nexthop_refcount.size() < NEXTHOP_MAX) {
+	nh = _nexthop_refcount.size();
+	_nexthop_refcount.push_back(0);
+    } else
+	return -ENOSPC;
+
+    if (nh >= _nexthop_capacity) {
+	NextHop *nt = (NextHop *) CLICK_LALLOC(2 * _nexthop_capacity * sizeof(NextHop));
+	if (!nt) {
+	    _nexthop_free.push_back(nh);
+	    return -ENOMEM;
+	}
+	memcpy(nt, _nexthop, _nexthop_capacity * sizeof(NextHop));
+	NextHop *old = _nexthop;
+	// Publish the larger array before any chunk refers to its new slots.
+	click_fence();
+	_nexthop = nt;
+	retire(old, _nexthop_capacity * sizeof(NextHop), -1);
+	_nexthop_capacity *= 2;
+    }
+
+    _nexthop[nh].gw = route.gw;
+    _nexthop[nh].port = route.port;
+    _nexthop_refcount[nh] = 1;
+    _nexthop_map.set(key, nh);
+    return nh;
+}
+
+void
+DXRIPLookup::nexthop_unref(int nh)
+{
+    if (nh > 0 && --_nexthop_refcount[nh] == 0) {
+	IPRoute r(IPAddress(), IPAddress(), _nexthop[nh].gw, _nexthop[nh].port);
+	_nexthop_map.erase(nexthop_key(r));
+	retire(0, 0, nh);
+    }
+}
+
+
+void
+DXRIPLookup::mark_dirty(uint32_t addr, int plen)
+{
+    int first = addr >> CHUNK_BITS;
+    int n = (plen >= CHUNK_BITS ? 1 : 1 << (CHUNK_BITS - plen));
+    for (int c = first; c < first + n; ++c)
+	if (!_dirty[c]) {
+	    _dirty[c] = true;
+	    _dirty_chunks.push_back(c);
+	}
+    if (!_deferred)
+	commit();
+}
+
+static inline void
+add_range(Vector<uint32_t> &ranges, uint32_t start, int nh)
+{
+    if (start >= (1U << 16))
+	return;
+    if (ranges.size() && (ranges.back() >> 16) == start)
+	ranges.pop_back();
+    if (!ranges.size() || (int) (ranges.back() & 0xFFFF) != nh)
+	ranges.push_back((start << 16) | nh);
+}
+
+void
+DXRIPLookup::build_chunk(int chunk)
+{
+    uint32_t base = (uint32_t) chunk << CHUNK_BITS;
+
+    // The longest route of /16 or shorter covers the whole chunk.
+    int default_nh = 0;
+    for (int plen = CHUNK_BITS; plen >= 0; --plen) {
+	uint32_t mask = (plen ? 0xFFFFFFFFU << (32 - plen) : 0);
+	int ri = _prefix_map.get(prefix_key(base & mask, plen));
+	if (ri >= 0) {
+	    default_nh = _routes[ri].nexthop;
+	    break;
+	}
+    }
+
+    // Sort the longer routes by start, containing routes first, then sweep
+    // them in order, keeping a stack of the routes enclosing the current
+    // position.  Each change of next hop starts a new range.
+    Vector<uint64_t> spans;
+    for (int ri = _chunk_routes[chunk]; ri >= 0; ri = _routes[ri].next) {
+	const IPRoute &r = _routes[ri].route;
+	uint32_t start = ntohl(r.addr.addr()) & (NCHUNKS - 1);
+	spans.push_back(((uint64_t) start << 40)
+			| ((uint64_t) r.prefix_len() << 32) | _routes[ri].nexthop);
+    }
+
+    uintptr_t e = ((uintptr_t) default_nh << 1) | 1;
+    if (spans.size()) {
+	click_qsort(spans.begin(), spans.size());
+
+	Vector<uint32_t> ranges;
+	Vector<uint32_t> stack_end;
+	Vector<int> stack_nh;
+	stack_end.push_back(NCHUNKS);
+	stack_nh.push_back(default_nh);
+	ranges.push_back(default_nh);
+
+	for (int i = 0; i <= spans.size(); ++i) {
+	    uint32_t start = (i < spans.size() ? (uint32_t) (spans[i] >> 40) : (uint32_t) NCHUNKS);
+	    while (stack_end.size() > 1 && stack_end.back() <= start) {
+		uint32_t end = stack_end.back();
+		stack_end.pop_back();
+		stack_nh.pop_back();
+		add_range(ranges, end, stack_nh.back());
+	    }
+	    if (i < spans.size()) {
+		int plen = (spans[i] >> 32) & 0xFF;
+		int nh = spans[i] & 0xFFFF;
+		add_range(ranges, start, nh);
+		stack_end.push_back(start + (1U << (32 - plen)));
+		stack_nh.push_back(nh);
+	    }
+	}
+
+	if (ranges.size() > 1) {
+	    uint32_t *r = (uint32_t *) CLICK_LALLOC((ranges.size() + 1) * sizeof(uint32_t));
+	    if (r) {
+		r[0] = ranges.size();
+		memcpy(r + 1, ranges.begin(), ranges.size() * sizeof(uint32_t));
+		e = reinterpret_cast<uintptr_t>(r);
+	    } else
+		click_chatter("%s: out of memory, routes in %s/16 ignored",
+			      declaration().c_str(), IPAddress(htonl(base)).unparse().c_str());
+	} else
+	    e = ((uintptr_t) (ranges[0] & 0xFFFF) << 1) | 1;
+    }
+
+    uintptr_t old = _direct[chunk];
+    // Fill in the range array before publishing it.
+    click_fence();
+    _direct[chunk] = e;
+    if (!(old & 1)) {
+	uint32_t *r = reinterpret_cast<uint32_t *>(old);
+	--_nranged;
+	_nranges -= r[0];
+	retire(r, (r[0] + 1) * sizeof(uint32_t), -1);
+    }
+    if (!(e & 1)) {
+	++_nranged;
+	_nranges += reinterpret_cast<uint32_t *>(e)[0];
+    }
+}
+
+void
+DXRIPLookup::commit()
+{
+    for (int i = 0; i < _dirty_chunks.size(); ++i) {
+	build_chunk(_dirty_chunks[i]);
+	_dirty[_dirty_chunks[i]] = false;
+    }
+    _dirty_chunks.clear();
+    reclaim(false);
+}
+
+
+int
+DXRIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *errh)
+{
+    int plen = route.prefix_len();
+    if (plen < 0)
+	return errh->error("route %<%s%> mask is not a prefix", route.unparse_addr().c_str());
+    uint32_t addr = ntohl(route.addr.addr());
+    uint64_t key = prefix_key(addr, plen);
+
+    int ri = _prefix_map.get(key);
+    if (ri >= 0) {
+	if (old_route)
+	    *old_route = _routes[ri].route;
+	if (!set)
+	    return -EEXIST;
+	int nh = nexthop_ref(route);
+	if (nh < 0)
+	    return nh;
+	nexthop_unref(_routes[ri].nexthop);
+	_routes[ri].route = route;
+	_routes[ri].nexthop = nh;
+	mark_dirty(addr, plen);
+	return 0;
+    }
+
+    int nh = nexthop_ref(route);
+    if (nh < 0)
+	return nh;
+    if (_route_free >= 0) {
+	ri = _route_free;
+	_route_free = _routes[ri].next;
+    } else {
+	ri = _routes.size();
+	_routes.push_back(Route());
+    }
+    _routes[ri].route = route;
+    _routes[ri].nexthop = nh;
+    _routes[ri].next = -1;
+    if (plen > CHUNK_BITS) {
+	_routes[ri].next = _chunk_routes[addr >> CHUNK_BITS];
+	_chunk_routes[addr >> CHUNK_BITS] = ri;
+    }
+    _prefix_map.set(key, ri);
+    ++_nroutes;
+    mark_dirty(addr, plen);
+    return 0;
+}
+
+int
+DXRIPLookup::remove_route(const IPRoute &route, IPRoute *old_route, ErrorHandler *)
+{
+    int plen = route.prefix_len();
+    uint32_t addr = ntohl(route.addr.addr());
+    int ri = (plen >= 0 ? _prefix_map.get(prefix_key(addr, plen)) : -1);
+    if (ri < 0)
+	return -ENOENT;
+    if (old_route)
+	*old_route = _routes[ri].route;
+    if (!route.match(_routes[ri].route))
+	return -ENOENT;
+
+    if (plen > CHUNK_BITS) {
+	int *pp = &_chunk_routes[addr >> CHUNK_BITS];
+	while (*pp != ri)
+	    pp = &_routes[*pp].next;
+	*pp = _routes[ri].next;
+    }
+    _prefix_map.erase(prefix_key(addr, plen));
+    nexthop_unref(_routes[ri].nexthop);
+    _routes[ri].route.kill();
+    _routes[ri].next = _route_free;
+    _route_free = ri;
+    --_nroutes;
+    mark_dirty(addr, plen);
+    return 0;
+}
+
+void
+DXRIPLookup::flush()
+{
+    _deferred = true;
+    for (int i = 0; i < _routes.size(); ++i)
+	if (_routes[i].route.real()) {
+	    IPRoute r = _routes[i].route;
+	    remove_route(r, 0, 0);
+	}
+    _deferred = false;
+    commit();
+}
+
+
+int
+DXRIPLookup::lookup_route(IPAddress a, IPAddress &gw) const
+{
+    int nh = lookup_nexthop(ntohl(a.addr()));
+    click_compiler_fence();
+    const NextHop *t = _nexthop;
+    gw = t[nh].gw;
+    return t[nh].port;
+}
+
+void
+DXRIPLookup::lookup_routes(int n, const IPAddress *a, IPAddress *gw, int *port) const
+{
+    uintptr_t e[BATCH_LANES];
+    for (; n > 0; n -= BATCH_LANES, a += BATCH_LANES,
+	     gw += BATCH_LANES, port += BATCH_LANES) {
+	int m = (n < BATCH_LANES ? n : BATCH_LANES);
+	// Issue all the direct table loads, then all the range array loads,
+	// before binary searching any of them.
+	for (int i = 0; i < m; ++i)
+	    prefetch_entry(&_direct[ntohl(a[i].addr()) >> CHUNK_BITS]);
+	for (int i = 0; i < m; ++i) {
+	    e[i] = _direct[ntohl(a[i].addr()) >> CHUNK_BITS];
+	    if (!(e[i] & 1))
+		prefetch_entry(reinterpret_cast<const uint32_t *>(e[i]) + 1);
+	}
+	click_compiler_fence();
+	const NextHop *t = _nexthop;
+	for (int i = 0; i < m; ++i) {
+	    int nh;
+	    if (e[i] & 1)
+		nh = e[i] >> 1;
+	    else
+		nh = range_lookup(reinterpret_cast<const uint32_t *>(e[i]),
+				  ntohl(a[i].addr()));
+	    gw[i] = t[nh].gw;
+	    port[i] = t[nh].port;
+	}
+    }
+}
+
+void
+DXRIPLookup::push(int, Packet *p)
+{
+    IPAddress gw;
+    int port = lookup_route(p->dst_ip_anno(), gw);
+    if (port >= 0) {
+	if (gw)
+	    p->set_dst_ip_anno(gw);
+	output(port).push(p);
+    } else
+	p->kill();
+}
+
+void
+DXRIPLookup::push_batch(int, PacketBatch &batch)
+{
+    Packet *p[BATCH_LANES];
+    IPAddress addr[BATCH_LANES], gw[BATCH_LANES];
+    int port[BATCH_LANES];
+
+    while (!batch.empty()) {
+	int n = 0;
+	for (; n < BATCH_LANES && !batch.empty(); ++n) {
+	    p[n] = batch.pop_front();
+	    addr[n] = p[n]->dst_ip_anno();
+	}
+	lookup_routes(n, addr, gw, port);
+	for (int i = 0; i < n; ++i)
+	    if (port[i] < 0)
+		port[i] = noutputs(); // killed by push_batch_by_output
+	    else if (gw[i])
+		p[i]->set_dst_ip_anno(gw[i]);
+	Classification::push_batch_by_output(this, p, port, n);
+    }
+}
+
+
+String
+DXRIPLookup::dump_routes()
+{
+    StringAccum sa;
+    for (int i = 0; i < _routes.size(); ++i)
+	if (_routes[i].route.real())
+	    _routes[i].route.unparse(sa, true) << '\n';
+    return sa.take_string();
+}
+
+size_t
+DXRIPLookup::memory_usage() const
+{
+    // Hash table entries are counted as a key, a value and a next pointer.
+    size_t map_entry = sizeof(uint64_t) + sizeof(int) + sizeof(void *);
+    return NCHUNKS * sizeof(uintptr_t)
+	+ (_nranges + _nranged) * sizeof(uint32_t)
+	+ _nexthop_capacity * sizeof(NextHop)
+	+ _routes.capacity() * sizeof(Route)
+	+ (_prefix_map.bucket_count() + _nexthop_map.bucket_count()) * sizeof(void *)
+	+ (_prefix_map.size() + _nexthop_map.size()) * map_entry
+	+ (_chunk_routes.capacity() + _nexthop_refcount.capacity()
+	   + _nexthop_free.capacity() + _dirty_chunks.capacity()) * sizeof(int)
+	+ IPRouteTable::memory_usage();
+}
+
+String
+DXRIPLookup::read_handler(Element *e, void *)
+{
+    DXRIPLookup *t = static_cast<DXRIPLookup *>(e);
+    size_t bytes = NCHUNKS * sizeof(uintptr_t)
+	+ (t->_nranges + t->_nranged) * sizeof(uint32_t)
+	+ t->_nexthop_capacity * sizeof(NextHop);
+    StringAccum sa;
+    sa << "routes " << t->_nroutes << '\n'
+       << "nexthops " << (t->_nexthop_refcount.size() - 1 - t->_nexthop_free.size()) << '\n'
+       << "ranged_chunks " << t->_nranged << '\n'
+       << "ranges " << t->_nranges << '\n'
+       << "bytes " << bytes << '\n';
+    return sa.take_string();
+}
+
+int
+DXRIPLookup::flush_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    DXRIPLookup *t = static_cast<DXRIPLookup *>(e);
+    t->_table_lock.acquire();
+    t->flush();
+    t->_table_lock.release();
+    return 0;
+}
+
+void
+DXRIPLookup::add_handlers()
+{
+    IPRouteTable::add_handlers();
+    add_read_handler("stats", read_handler, 0);
+    add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable Classification)
+EXPORT_ELEMENT(DXRIPLookup)
+ELEMENT_MT_SAFE(DXRIPLookup)
@@ -0,0 +1,223 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_DXRIPLOOKUP_HH
+#define CLICK_DXRIPLOOKUP_HH
+#include "iproutetable.hh"
+#include <click/hashtable.hh>
+#include <click/bitvector.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+DXRIPLookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+
+=s iproute
+
+IP routing lookup through a compact range table, with lock-free updates
+
+=d
+
+Expects a destination IP address annotation with each packet. Looks up that
+address in its routing table, using longest-prefix-match, sets the destination
+annotation to the corresponding GW (if specified), and emits the packet on the
+indicated OUTput port.
+
+Each argument is a route, specifying a destination and mask, an optional
+gateway IP address, and an output port.  No destination-mask pair should occur
+more than once.
+
+DXRIPLookup implements the I<D16R> variant of the DXR lookup scheme described
+by Zec, Rizzo, and Mikuc in the paper cited below.  The address space is
+split into 65536 chunks, one per /16.  A direct table maps each chunk either
+to a next hop, or to a short sorted array of address ranges within the chunk,
+which is searched by binary search.  A lookup touches the direct table and at
+most one range array, both small enough to stay mostly in cache: a full BGP
+view needs roughly 1.5 MB in all.
+
+Route updates are incremental.  Adding or removing a route longer than /16
+rebuilds the range array of only one chunk; shorter routes rebuild the chunks
+they cover.  Each rebuilt chunk is published by a single pointer store, so
+lookups on other threads never block and never observe a partially updated
+chunk.  Memory from replaced chunks is reclaimed only after a grace period of
+one second.  Routes given in the configuration string are collected first and
+expanded in one pass.
+
+DXRIPLookup also implements batched lookups.  When packets arrive in a batch,
+it looks up all their destinations at once, prefetching table entries for
+later packets while earlier ones are resolved, and forwards one batch per
+output port.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.
+
+=h lookup read-only, requires parameters
+
+Reports the OUTput port and GW corresponding to an address.
+
+=h add write-only
+
+Adds a route to the table. Format should be `C<ADDR/MASK [GW] OUT>'.
+Fails if a route for C<ADDR/MASK> already exists.
+
+=h set write-only
+
+Sets a route, whether or not a route for the same prefix already exists.
+
+=h remove write-only
+
+Removes a route from the table. Format should be `C<ADDR/MASK>'.
+
+=h ctrl write-only
+
+Adds or removes a group of routes. Write `C<add>/C<set ADDR/MASK [GW] OUT>' to
+add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
+multiple commands, one per line; all commands are executed as one atomic
+operation.
+
+=h flush write-only
+
+Clears the entire routing table.
+
+=h stats read-only
+
+Reports the number of routes, next hops, and chunks with range arrays, the
+number of range entries, and the approximate lookup table size in bytes.
+
+=n
+
+See IPRouteTable for a performance comparison of the various IP routing
+elements.  The conf/iproutetable-bench.sh script reproduces that comparison
+for a given route dump.
+
+Masks must be prefixes.  At most 65535 distinct GW/OUT combinations may be
+in use at once.
+
+=a IPRouteTable, DirectIPLookup, RangeIPLookup, RadixIPLookup,
+IPRouteTableBench
+
+Marko Zec, Luigi Rizzo, and Miljenko Mikuc.  "DXR: Towards a Billion Routing
+Lookups per Second in Software".  ACM SIGCOMM Computer Communication Review,
+Vol. 42, No. 5, pp. 29-36, October 2012.
+*/
+
+class DXRIPLookup : public IPRouteTable { public:
+
+    DXRIPLookup();
+    ~DXRIPLookup();
+
+    const char *class_name() const		{ return "DXRIPLookup"; }
+    const char *port_count() const		{ return "1/-"; }
+    const char *processing() const		{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+    int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
+    int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
+    int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_routes(int n, const IPAddress *addr, IPAddress *gw, int *port) const;
+    String dump_routes();
+    size_t memory_usage() const;
+
+  private:
+
+    enum {
+	CHUNK_BITS = 16,
+	NCHUNKS = 1 << CHUNK_BITS,
+	NEXTHOP_MAX = 0xFFFF,
+	GRACE_MSEC = 1000
+    };
+
+    struct NextHop {
+	IPAddress gw;
+	int32_t port;
+    };
+
+    // Lookup structures.  A direct table entry is either (nexthop << 1) | 1,
+    // or a pointer to a range array: a count, followed by that many
+    // (start << 16) | nexthop words sorted by start.  The first range always
+    // starts at 0.  Next hop 0 means "no route".
+    uintptr_t *_direct;
+    NextHop * volatile _nexthop;
+    int _nexthop_capacity;
+
+    // Update structures, touched only by the writer.
+    struct Route {
+	IPRoute route;
+	int next;		// next route in chunk or free list
+	int nexthop;
+    };
+    Vector<Route> _routes;
+    int _route_free;
+    int _nroutes;
+    HashTable<uint64_t, int> _prefix_map;
+    Vector<int> _chunk_routes;	// first route longer than /16 in chunk
+
+    HashTable<uint64_t, int> _nexthop_map;
+    Vector<int> _nexthop_refcount;
+    Vector<int> _nexthop_free;
+
+    Bitvector _dirty;
+    Vector<int> _dirty_chunks;
+    bool _deferred;
+
+    struct Retired {
+	void *p;
+	size_t size;
+	int nexthop;
+	Timestamp when;
+    };
+    Vector<Retired> _retired;
+
+    int _nranged;
+    size_t _nranges;
+
+    static inline uint64_t prefix_key(uint32_t addr, int plen) {
+	return ((uint64_t) plen << 32) | addr;
+    }
+    static inline uint64_t nexthop_key(const IPRoute &r) {
+	return ((uint64_t) r.gw.addr() << 32) | (uint32_t) r.port;
+    }
+    static inline int range_lookup(const uint32_t *r, uint32_t addr) {
+	uint32_t key = (addr << 16) | 0xFFFF;
+	int lo = 1, hi = r[0] + 1;
+	while (hi - lo > 1) {
+	    int mid = (lo + hi) >> 1;
+	    if (r[mid] <= key)
+		lo = mid;
+	    else
+		hi = mid;
+	}
+	return r[lo] & 0xFFFF;
+    }
+    inline int lookup_nexthop(uint32_t addr) const {
+	uintptr_t e = _direct[addr >> CHUNK_BITS];
+	if (e & 1)
+	    return e >> 1;
+	else
+	    return range_lookup(reinterpret_cast<const uint32_t *>(e), addr);
+    }
+
+    bool sole_thread() const;
+    int nexthop_ref(const IPRoute &r);
+    void nexthop_unref(int nh);
+    void mark_dirty(uint32_t addr, int plen);
+    void build_chunk(int chunk);
+    void commit();
+    void retire(void *p, size_t size, int nexthop);
+    void reclaim(bool all);
+    void flush();
+
+    static String read_handler(Element *e, void *thunk);
+    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
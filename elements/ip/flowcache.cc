@@ -0,0 +1,271 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * flowcache.{cc,hh} -- remembers a decision subgraph's output for each flow
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flowcache.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+#include <clicknet/icmp.h>
+#include <clicknet/ip6.h>
+CLICK_DECLS
+
+FlowCache::FlowCache()
+    : _nsets(0), _ways(0)
+{
+}
+
+FlowCache::~FlowCache()
+{
+}
+
+int
+FlowCache::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t capacity = 4096, ways = 4;
+    if (Args(conf, this, errh)
+	.read("CAPACITY", capacity)
+	.read("WAYS", ways)
+	.complete() < 0)
+	return -1;
+    if (ways < 1 || ways > 16)
+	return errh->error("WAYS must be between 1 and 16");
+    if (capacity < ways || capacity > 0x1000000)
+	return errh->error("CAPACITY out of range");
+    _ways = ways;
+    for (_nsets = 1; _nsets * _ways < capacity; _nsets *= 2)
+	/* nada */;
+    return 0;
+}
+
+int
+FlowCache::initialize(ErrorHandler *errh)
+{
+    if (_tables.initialize(master()) < 0)
+	return errh->error("out of memory");
+    for (int i = 0; i < _tables.size(); ++i)
+	if (!(_tables[i].entries = new Entry<Flow4>[_nsets * _ways])
+	    || !(_tables[i].entries6 = new Entry<Flow6>[_nsets * _ways]))
+	    return errh->error("out of memory");
+    return 0;
+}
+
+void
+FlowCache::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _tables.size(); ++i) {
+	delete[] _tables[i].entries;
+	delete[] _tables[i].entries6;
+    }
+    _tables.clear();
+}
+
+static inline bool
+transport_ports(const Packet *p, uint8_t proto, uint16_t &sport, uint16_t &dport)
+{
+    sport = dport = 0;
+    if (proto == IP_PROTO_TCP || proto == IP_PROTO_UDP
+	|| proto == IP_PROTO_DCCP || proto == IP_PROTO_UDPLITE
+	|| proto == IP_PROTO_SCTP) {
+	if (p->transport_length() < 4)
+	    return false;
+	const uint16_t *ports = reinterpret_cast<const uint16_t *>(p->transport_header());
+	sport = ports[0];
+	dport = ports[1];
+    } else if (proto == IP_PROTO_ICMP || proto == IP_PROTO_ICMP6) {
+	if (p->transport_length() < 2)
+	    return false;
+	const uint8_t *h = p->transport_header();
+	sport = (h[0] << 8) | h[1];
+    }
+    return true;
+}
+
+bool
+FlowCache::flow_key(const Packet *p, Flow4 &key)
+{
+    if (p->network_length() < (int) sizeof(click_ip))
+	return false;
+    const click_ip *iph = p->ip_header();
+    if (IP_ISFRAG(iph))
+	return false;
+    uint16_t sport, dport;
+    if (!transport_ports(p, iph->ip_p, sport, dport))
+	return false;
+    key.flow = IPFlowID(iph->ip_src, sport, iph->ip_dst, dport);
+    key.proto = iph->ip_p;
+    return true;
+}
+
+bool
+FlowCache::flow_key(const Packet *p, Flow6 &key)
+{
+    if (p->network_length() < (int) sizeof(click_ip6))
+	return false;
+    const click_ip6 *ip6h = p->ip6_header();
+    uint8_t proto = ip6h->ip6_nxt;
+    if (proto == IP6_NXT_HOPOPTS || proto == IP6_NXT_ROUTING
+	|| proto == IP6_NXT_FRAGMENT || proto == IP6_NXT_DSTOPTS
+	|| p->transport_header() != p->network_header() + sizeof(click_ip6))
+	return false;
+    if (!transport_ports(p, proto, key.sport, key.dport))
+	return false;
+    key.src = IP6Address(ip6h->ip6_src);
+    key.dst = IP6Address(ip6h->ip6_dst);
+    key.proto = proto;
+    return true;
+}
+
+template <typename K>
+inline FlowCache::Entry<K> *
+FlowCache::find_set(Entry<K> *entries, const K &key) const
+{
+    uint32_t h = key.hashcode();
+    h ^= h >> 16;
+    return entries + (h & (_nsets - 1)) * _ways;
+}
+
+template <typename K>
+void
+FlowCache::learn(Table &t, Entry<K> *entries, const K &key, int port, Packet *p)
+{
+    // Entries get the epoch seen when the packet went into the subgraph, so
+    // a decision that straddles an epoch change is never used.
+    uint32_t epoch = t.miss_epoch;
+    if (epoch != router()->forwarding_epoch())
+	return;
+    Entry<K> *set = find_set(entries, key), *victim = set;
+    for (Entry<K> *e = set; e != set + _ways; ++e) {
+	if (e->port && e->epoch == epoch && e->key == key) {
+	    victim = e;
+	    break;
+	} else if (!e->port || e->epoch != epoch) {
+	    victim = e;
+	    break;
+	} else if (e->used - victim->used > 0x80000000U)
+	    victim = e;
+    }
+    victim->key = key;
+    victim->epoch = epoch;
+    victim->used = ++t.tick;
+    victim->port = port;
+    victim->dst_anno = K::anno(p);
+    victim->paint_anno = PAINT_ANNO(p);
+}
+
+template <typename K>
+inline void
+FlowCache::handle(Table &t, Entry<K> *entries, int port, Packet *p)
+{
+    K key;
+    bool cacheable = flow_key(p, key);
+
+    if (port != 0) {
+	if (cacheable)
+	    learn(t, entries, key, port, p);
+	output(port).push(p);
+	return;
+    } else if (!cacheable) {
+	++t.uncacheable;
+	output(0).push(p);
+	return;
+    }
+
+    uint32_t epoch = router()->forwarding_epoch();
+    Entry<K> *set = find_set(entries, key);
+    for (Entry<K> *e = set; e != set + _ways; ++e)
+	if (e->port && e->epoch == epoch && e->key == key) {
+	    e->used = ++t.tick;
+	    ++t.hits;
+	    K::set_anno(p, e->dst_anno);
+	    SET_PAINT_ANNO(p, e->paint_anno);
+	    output(e->port).push(p);
+	    return;
+	}
+
+    ++t.misses;
+    t.miss_epoch = epoch;
+    output(0).push(p);
+}
+
+void
+FlowCache::push(int port, Packet *p)
+{
+    Table &t = _tables.get();
+    if (!p->has_network_header() || p->network_length() < 1) {
+	if (port == 0)
+	    ++t.uncacheable;
+	output(port).push(p);
+    } else if ((p->network_header()[0] >> 4) == 6)
+	handle(t, t.entries6, port, p);
+    else
+	handle(t, t.entries, port, p);
+}
+
+String
+FlowCache::read_handler(Element *e, void *thunk)
+{
+    FlowCache *fc = static_cast<FlowCache *>(e);
+    uint64_t Table::*field;
+    switch ((uintptr_t) thunk) {
+    case h_hits:
+	field = &Table::hits;
+	break;
+    case h_misses:
+	field = &Table::misses;
+	break;
+    case h_uncacheable:
+	field = &Table::uncacheable;
+	break;
+    case h_capacity:
+	return String(fc->_nsets * fc->_ways);
+    default:
+	return String();
+    }
+    uint64_t sum = 0;
+    for (int i = 0; i < fc->_tables.size(); ++i)
+	sum += fc->_tables[i].*field;
+    return String(sum);
+}
+
+int
+FlowCache::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
+{
+    FlowCache *fc = static_cast<FlowCache *>(e);
+    if ((uintptr_t) thunk == h_invalidate)
+	fc->router()->bump_forwarding_epoch();
+    else
+	for (int i = 0; i < fc->_tables.size(); ++i) {
+	    Table &t = fc->_tables[i];
+	    t.hits = t.misses = t.uncacheable = 0;
+	}
+    return 0;
+}
+
+void
+FlowCache::add_handlers()
+{
+    add_read_handler("hits", read_handler, h_hits);
+    add_read_handler("misses", read_handler, h_misses);
+    add_read_handler("uncacheable", read_handler, h_uncacheable);
+    add_read_handler("capacity", read_handler, h_capacity);
+    add_write_handler("invalidate", write_handler, h_invalidate, Handler::BUTTON);
+    add_write_handler("reset_counts", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(FlowCache)
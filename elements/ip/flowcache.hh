@@ -0,0 +1,228 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLOWCACHE_HH
+#define CLICK_FLOWCACHE_HH
+#include <click/element.hh>
+#include <click/ipflowid.hh>
+#include <click/ip6address.hh>
+#include <click/percpu.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FlowCache([I<keywords> CAPACITY, WAYS])
+
+=s ip
+
+remembers a decision subgraph's output for each flow
+
+=d
+
+FlowCache skips an expensive, deterministic decision subgraph, such as
+IPClassifier -> IPFilter -> RadixIPLookup, for packets whose flow has already
+been through it.  Input 0 takes IP packets with network headers set.  Output 0
+leads into the subgraph.  Each of the subgraph's exits leads back to a
+FlowCache input numbered 1 or more, and FlowCache's output with the same
+number continues from that exit.  FlowCache has as many outputs as inputs.
+
+A packet arriving on input 0 is looked up by flow: source and destination
+address, IP protocol, and source and destination port (for ICMP, type and
+code).  If the cache has an entry for the flow, FlowCache restores the
+destination IP and paint annotations recorded with the entry and emits the
+packet on the entry's output, skipping the subgraph.  Otherwise the packet is
+emitted on output 0 unchanged.  When a packet returns on input I, FlowCache
+records that its flow leads to output I, together with the packet's current
+destination IP and paint annotations, and emits it on output I.  Packets the
+subgraph drops are not remembered, so their flows keep taking the slow path.
+
+Fragments and packets without network headers always take the slow path and
+are never remembered.
+
+IPv6 packets are cached too, in a separate table of the same size, keyed by
+the same fields; their destination IP6 annotation is restored on a hit.  An
+IPv6 packet is cacheable only if its transport header follows the IPv6 header
+directly: packets with extension headers take the slow path.
+
+The subgraph's decisions must depend only on the fields FlowCache uses as the
+key, and on the destination IP annotation equalling the destination address,
+as it does after CheckIPHeader.  Rules that test TCP flags, TTL, or payload
+bytes do not fit.  The subgraph must not modify those fields, and should not
+contain queues: FlowCache learns from packets on the thread that sent them into
+the subgraph.
+
+Entries are invalidated when the router's forwarding epoch changes.  The epoch
+advances when any element is reconfigured through a handler and when an
+IPRouteTable or IP6RouteTable element's routes change; write the C<invalidate> handler after
+other changes that affect the subgraph.
+
+Each thread has its own set-associative tables of about CAPACITY entries, WAYS
+entries per set, so lookups take no locks.  When a set is full, its least
+recently used entry is replaced.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Unsigned integer.  Entries per thread and IP version, rounded up so the number of sets is a
+power of two.  Default is 4096.
+
+=item WAYS
+
+Unsigned integer between 1 and 16.  Entries per set.  Default is 4.
+
+=back
+
+=h hits read-only
+
+Returns the number of packets sent around the subgraph.
+
+=h misses read-only
+
+Returns the number of cacheable packets sent into the subgraph.
+
+=h uncacheable read-only
+
+Returns the number of packets that could not be cached.
+
+=h capacity read-only
+
+Returns the number of entries per thread.
+
+=h invalidate write-only
+
+Advances the router's forwarding epoch, invalidating every FlowCache's entries.
+
+=h reset_counts write-only
+
+Resets the counters to zero.
+
+=e
+
+  fc :: FlowCache;
+  ... -> CheckIPHeader -> fc;
+  fc[0] -> filt :: IPFilter(0 tcp, 1 all)
+        -> rt :: RadixIPLookup(10.0.0.0/8 0, 0/0 1.2.3.4 1);
+  filt[1] -> [3]fc[3] -> Discard;
+  rt[0] -> [1]fc[1] -> ... // to 10.0.0.0/8
+  rt[1] -> [2]fc[2] -> ... // default route
+
+=n
+
+Denied packets above return on input 3, so later packets from the same flow
+are dropped without running IPFilter.
+
+=a
+
+IPClassifier, IPFilter, RadixIPLookup, IPRouteTable
+*/
+
+class FlowCache : public Element { public:
+
+    FlowCache();
+    ~FlowCache();
+
+    const char *class_name() const	{ return "FlowCache"; }
+    const char *port_count() const	{ return "2-/="; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+
+  private:
+
+    struct Flow4 {
+	IPFlowID flow;
+	uint8_t proto;
+	typedef IPAddress anno_type;
+	uint32_t hashcode() const {
+	    return flow.hashcode() + proto * 0x9E3779B1U;
+	}
+	bool operator==(const Flow4 &x) const {
+	    return flow == x.flow && proto == x.proto;
+	}
+	static IPAddress anno(Packet *p) {
+	    return p->dst_ip_anno();
+	}
+	static void set_anno(Packet *p, IPAddress a) {
+	    p->set_dst_ip_anno(a);
+	}
+    };
+
+    struct Flow6 {
+	IP6Address src;
+	IP6Address dst;
+	uint16_t sport;
+	uint16_t dport;
+	uint8_t proto;
+	typedef IP6Address anno_type;
+	uint32_t hashcode() const {
+	    return src.hashcode() * 0x9E3779B1U + dst.hashcode()
+		+ ((sport << 16) | dport) + proto * 0x9E3779B1U;
+	}
+	bool operator==(const Flow6 &x) const {
+	    return src == x.src && dst == x.dst && sport == x.sport
+		&& dport == x.dport && proto == x.proto;
+	}
+	static IP6Address anno(Packet *p) {
+	    return DST_IP6_ANNO(p);
+	}
+	static void set_anno(Packet *p, const IP6Address &a) {
+	    SET_DST_IP6_ANNO(p, a);
+	}
+    };
+
+    template <typename K> struct Entry {
+	K key;
+	uint32_t epoch;
+	uint32_t used;
+	typename K::anno_type dst_anno;
+	uint16_t port;		// 0 means empty
+	uint8_t paint_anno;
+	Entry()
+	    : epoch(0), used(0), port(0), paint_anno(0) {
+	}
+    };
+
+    struct Table {
+	Entry<Flow4> *entries;
+	Entry<Flow6> *entries6;
+	uint32_t tick;
+	uint32_t miss_epoch;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t uncacheable;
+	Table()
+	    : entries(0), entries6(0), tick(0), miss_epoch(0), hits(0),
+	      misses(0), uncacheable(0) {
+	}
+    };
+
+    PerCPU<Table> _tables;
+    uint32_t _nsets;
+    uint32_t _ways;
+
+    enum { h_hits, h_misses, h_uncacheable, h_capacity, h_invalidate,
+	   h_reset };
+
+    static bool flow_key(const Packet *p, Flow4 &key);
+    static bool flow_key(const Packet *p, Flow6 &key);
+    template <typename K>
+    inline Entry<K> *find_set(Entry<K> *entries, const K &key) const;
+    template <typename K>
+    void learn(Table &t, Entry<K> *entries, const K &key, int port, Packet *p);
+    template <typename K>
+    inline void handle(Table &t, Entry<K> *entries, int port, Packet *p);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
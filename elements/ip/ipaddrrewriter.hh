@@ -93,6 +93,25 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item TIMING_WHEEL
+
+Boolean. If true, keep mappings in hashed timing wheels, with slots of about
+1/8 second, rather than in heaps ordered by expiration time. Refreshing a
+mapping on each packet then takes constant time, and expired mappings are
+reaped in batches. When the rewriter is full, it evicts one of the mappings
+expiring soonest, to within a slot. Rewriters that share a MAPPING_CAPACITY
+must agree on TIMING_WHEEL. Default is false.
+
+=item HASH
+
+Hash function for the mapping tables: C<default>, C<crc32c>, or C<seeded>,
+optionally followed by C<symmetric>. The default function clusters when many
+flows differ only in nearby ports, as behind a NAT; C<crc32c> spreads them
+well and is fast, using the SSE4.2 crc32 instruction when available; C<seeded>
+is SipHash with a random key, so that remote hosts cannot choose colliding
+flows. C<symmetric> makes a flow and its reverse hash alike. Default is
+C<default>.
+
 =back
 
 =h mappings read-only
@@ -109,6 +128,11 @@ Returns the number of currently installed mapping pairs.
 Returns a human-readable description of the patterns associated with this
 IPAddrRewriter.
 
+=h pools read-only
+
+Returns one line for the flow pool: C<flows>, the number of flows in use,
+the number of free flow objects, and the bytes the pool holds.
+
 =a IPRewriter, IPAddrPairRewriter, TCPRewriter, IPRewriterPatterns,
 RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter,
 StoreIPAddress (for simple uses) */
@@ -153,6 +177,10 @@ class IPAddrRewriter : public IPRewriterBase { public:
     SizedHashAllocator<sizeof(IPAddrFlow)> _allocator;
     unsigned _annos;
 
+    HashAllocator *pool_allocator(int pool) {
+	return pool == pool_flows ? &_allocator : 0;
+    }
+
     static String dump_mappings_handler(Element *, void *);
 
 };
@@ -24,6 +24,7 @@
 CLICK_DECLS
 
 IPEncap::IPEncap()
+  : _expensive_pushes(0)
 {
 }
 
@@ -114,6 +115,15 @@ IPEncap::configure(Vector<String> &conf, ErrorHandler *errh)
   return 0;
 }
 
+bool
+IPEncap::input_alignment(int &modulus, int &offset) const
+{
+  // align the new IP header
+  modulus = 4;
+  offset = 0;
+  return true;
+}
+
 int
 IPEncap::initialize(ErrorHandler *)
 {
@@ -136,9 +146,11 @@ IPEncap::update_cksum(click_ip *ip, int off) const
 #endif
 }
 
-Packet *
-IPEncap::simple_action(Packet *p_in)
+inline WritablePacket *
+IPEncap::encap(Packet *p_in, uint32_t id)
 {
+  if (p_in->headroom() < sizeof(click_ip) || p_in->shared())
+    ++_expensive_pushes;
   WritablePacket *p = p_in->push(sizeof(click_ip));
   if (!p) return 0;
 
@@ -151,7 +163,7 @@ IPEncap::simple_action(Packet *p_in)
   } else
       p->set_dst_ip_anno(IPAddress(ip->ip_dst));
   ip->ip_len = htons(p->length());
-  ip->ip_id = htons(_id.fetch_and_add(1));
+  ip->ip_id = htons(id);
   update_cksum(ip, 2);
   update_cksum(ip, 4);
 
@@ -160,6 +172,40 @@ IPEncap::simple_action(Packet *p_in)
   return p;
 }
 
+Packet *
+IPEncap::simple_action(Packet *p)
+{
+  return encap(p, _id.fetch_and_add(1));
+}
+
+void
+IPEncap::simple_action_batch(PacketBatch &batch)
+{
+  // reserve the whole batch's IP IDs at once
+  uint32_t id = _id.fetch_and_add(batch.count());
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if (WritablePacket *q = encap(p, id++))
+      out.push_back(q);
+  batch.swap(out);
+}
+
+void
+IPEncap::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+IPEncap::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
 String
 IPEncap::read_handler(Element *e, void *thunk)
 {
@@ -184,6 +230,7 @@ IPEncap::add_handlers()
     add_write_handler("src", reconfigure_keyword_handler, "1 SRC");
     add_read_handler("dst", read_handler, 1, Handler::CALM);
     add_write_handler("dst", reconfigure_keyword_handler, "2 DST");
+    add_data_handlers("expensive_pushes", Handler::h_read, &_expensive_pushes);
 }
 
 CLICK_ENDDECLS
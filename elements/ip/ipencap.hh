@@ -3,6 +3,7 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <click/atomic.hh>
+#include <click/packetbatch.hh>
 #include <clicknet/ip.h>
 CLICK_DECLS
 
@@ -25,6 +26,11 @@ Its destination address annotation is also set to DST.
 As a special case, if DST is "DST_ANNO", then the destination address
 is set to the incoming packet's destination address annotation.
 
+The header is built once, with its checksum, when IPEncap is configured;
+each packet gets a copy whose checksum is updated incrementally for its
+length, IP ID, and (with DST_ANNO) destination.  A batch of packets takes
+its IP IDs in one step.
+
 Keyword arguments are:
 
 =over 8
@@ -80,6 +86,12 @@ Returns or sets the SRC parameter.
 
 Returns or sets the DST parameter.
 
+=h expensive_pushes read-only
+
+Returns the number of packets that lacked headroom for the new header, or
+whose data was shared, so that push() had to copy them.  See also the global
+"packet_expensive" handler.
+
 =a UDPIPEncap, StripIPHeader */
 
 class IPEncap : public Element { public:
@@ -93,16 +105,23 @@ class IPEncap : public Element { public:
   int configure(Vector<String> &, ErrorHandler *);
   bool can_live_reconfigure() const		{ return true; }
   int initialize(ErrorHandler *);
+  int encap_headroom() const		{ return sizeof(click_ip); }
+  bool input_alignment(int &modulus, int &offset) const;
   void add_handlers();
 
   Packet *simple_action(Packet *);
+  void simple_action_batch(PacketBatch &);
+  void push_batch(int, PacketBatch &);
+  void pull_batch(int, PacketBatch &, int);
 
  private:
 
   click_ip _iph;
   atomic_uint32_t _id;
+  uint32_t _expensive_pushes;
 
   inline void update_cksum(click_ip *, int) const;
+  inline WritablePacket *encap(Packet *, uint32_t id);
   static String read_handler(Element *, void *);
 
 };
@@ -19,6 +19,7 @@
 
 #include <click/config.h>
 #include "ipfilter.hh"
+#include <click/packetbatch.hh>
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/args.hh>
@@ -783,6 +784,61 @@ IPFilter::Primitive::compile(Classification::Wordwise::Program &p, Vector<int> &
   p.finish_subtree(tree);
 }
 
+// Narrow @a rule by this primitive, which must mean the same thing as the
+// code compile() generates.  Return false if tuple-space search cannot
+// express the primitive.
+bool
+IPFilter::Primitive::restrict_rule(IPTupleSpace::Rule &rule) const
+{
+    // as in add_exprs_for_proto, other pseudo-protocols test nothing
+    if (_transp_proto == IP_PROTO_TCP_OR_UDP
+	|| (_transp_proto >= 0 && _transp_proto < 256))
+	rule.restrict_proto(_transp_proto);
+
+    switch (_type) {
+
+    case TYPE_HOST:
+	if (_op != OP_EQ || _op_negated || _srcdst == SD_OR)
+	    return false;
+	if (_srcdst == SD_SRC || _srcdst == SD_AND)
+	    rule.restrict_addr(false, _u.u, _mask.u);
+	if (_srcdst == SD_DST || _srcdst == SD_AND)
+	    rule.restrict_addr(true, _u.u, _mask.u);
+	return true;
+
+    case TYPE_PROTO:
+	if (_transp_proto >= 256)
+	    return true;
+	if (_op == OP_EQ && _mask.u == 0) {
+	    rule.never = rule.never || _op_negated;
+	    return true;
+	} else if (_op != OP_EQ || _op_negated || _mask.u != 0xFF)
+	    return false;
+	rule.restrict_proto(_u.u);
+	return true;
+
+    case TYPE_PORT: {
+	if (_op == OP_EQ && _mask.u == 0) {
+	    rule.never = rule.never || _op_negated;
+	    return true;
+	} else if (_mask.u != 0xFFFF || _srcdst == SD_OR
+		   || (_op_negated && _srcdst == SD_AND))
+	    return false;
+	uint32_t lo = (_op == OP_EQ ? _u.u : _u.u + 1);
+	uint32_t hi = (_op == OP_EQ ? _u.u : 0xFFFF);
+	if (_srcdst == SD_SRC || _srcdst == SD_AND)
+	    rule.restrict_ports(false, lo, hi, _op_negated);
+	if (_srcdst == SD_DST || _srcdst == SD_AND)
+	    rule.restrict_ports(true, lo, hi, _op_negated);
+	return true;
+    }
+
+    default:
+	return false;
+
+    }
+}
+
 
 static void
 separate_text(const String &text, Vector<String> &words)
@@ -1197,19 +1253,39 @@ IPFilter::Parser::parse_test(int pos, bool negated)
 	prim.compile(_prog, _tree);
 	if (negated)
 	    _prog.negate_subtree(_tree);
+	if (_rule && (negated || !prim.restrict_rule(*_rule)))
+	    _rule->ok = false;
 	_prev_prim = prim;
     }
 
     return pos;
 }
 
+// Return true if the pattern in @a words is a plain conjunction, which
+// tuple-space search might handle.
+static bool
+conjunctive_pattern(const Vector<String> &words)
+{
+    for (int i = 1; i < words.size(); ++i) {
+	const String &w = words[i];
+	if (w == "or" || w == "||" || w == "not" || w == "!" || w == "?"
+	    || w == ":" || w == "true" || w == "false")
+	    return false;
+    }
+    return true;
+}
+
 void
 IPFilter::parse_program(Classification::Wordwise::CompressedProgram &zprog,
 			const Vector<String> &conf, int noutputs,
-			const Element *context, ErrorHandler *errh)
+			const Element *context, ErrorHandler *errh,
+			IPTupleSpace *tuples)
 {
     Classification::Wordwise::Program prog;
     Vector<int> tree = prog.init_subtree();
+    IPTupleSpace::Rule rule;
+    if (tuples)
+	tuples->clear();
 
     // [QUALS] [host|net|port|proto] [data]
     // QUALS ::= src | dst | src and dst | src or dst | \empty
@@ -1249,18 +1325,28 @@ IPFilter::parse_program(Classification::Wordwise::CompressedProgram &zprog,
 
 	prog.start_subtree(tree);
 
+	// collect rules for tuple-space search until one does not fit
+	IPTupleSpace::Rule *rulep = 0;
+	if (tuples && (argno == 0 || rule.ok)) {
+	    rule.clear();
+	    rule.ok = conjunctive_pattern(words);
+	    rulep = &rule;
+	}
+
 	// check for "-"
 	if (words.size() == 1
 	    || (words.size() == 2
 		&& (words[1] == "-" || words[1] == "any" || words[1] == "all")))
 	    prog.add_insn(tree, 0, 0, 0);
 	else {
-	    Parser parser(words, tree, prog, context, &cerrh);
+	    Parser parser(words, tree, prog, context, &cerrh, rulep);
 	    int pos = parser.parse_expr_iterative(1);
 	    if (pos < words.size())
 		cerrh.error("garbage after expression at %<%s%>", words[pos].c_str());
 	}
 
+	if (rulep)
+	    tuples->add(rule, slot);
 	prog.finish_subtree(tree, Classification::c_and, -slot);
     }
 
@@ -1274,7 +1360,13 @@ IPFilter::parse_program(Classification::Wordwise::CompressedProgram &zprog,
     // Compress the program into _zprog.
     // It helps to do another bubblesort for things like ports.
     prog.bubble_sort_and_exprs(offset_map, offset_map + 2, Classification::offset_max);
-    zprog.compile(prog, PERFORM_BINARY_SEARCH, MIN_BINARY_SEARCH);
+    zprog.compile(prog, PERFORM_BINARY_SEARCH, MIN_BINARY_SEARCH, MIN_HASH_SEARCH);
+
+    // A trivial program beats any search.
+    if (tuples && zprog.output_everything() < 0)
+	tuples->build(conf.size(), MIN_TUPLE_SEARCH, -Classification::j_never);
+    else if (tuples)
+	tuples->clear();
 
     // click_chatter("%s", zprog.unparse().c_str());
 }
@@ -1283,9 +1375,12 @@ int
 IPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     IPFilterProgram zprog;
-    parse_program(zprog, conf, noutputs(), this, errh);
+    IPTupleSpace tuples;
+    parse_program(zprog, conf, noutputs(), this, errh, &tuples);
     if (!errh->nerrors()) {
 	_zprog = zprog;
+	_tuples = tuples;
+	_native.compile(_zprog, offset_net, offset_transp, this);
 	return 0;
     } else
 	return -1;
@@ -1298,10 +1393,26 @@ IPFilter::program_string(Element *e, void *)
     return ipf->_zprog.unparse();
 }
 
+String
+IPFilter::tuples_handler(Element *e, void *)
+{
+    IPFilter *ipf = static_cast<IPFilter *>(e);
+    return ipf->_tuples.ok() ? ipf->_tuples.unparse() : String();
+}
+
+String
+IPFilter::jit_handler(Element *e, void *)
+{
+    IPFilter *ipf = static_cast<IPFilter *>(e);
+    return String(ipf->_native.ok());
+}
+
 void
 IPFilter::add_handlers()
 {
     add_read_handler("program", program_string);
+    add_read_handler("tuples", tuples_handler);
+    add_read_handler("jit", jit_handler, 0, Handler::CALM);
 }
 
 
@@ -1310,11 +1421,12 @@ IPFilter::add_handlers()
 //
 
 int
-IPFilter::length_checked_match(const IPFilterProgram &zprog, const Packet *p,
+IPFilter::length_checked_match(const IPFilterProgram &zprog,
+			       const unsigned char *mac_data,
+			       const unsigned char *neth_data,
+			       const unsigned char *transph_data,
 			       int packet_length)
 {
-    const unsigned char *neth_data = p->network_header();
-    const unsigned char *transph_data = p->transport_header();
     const uint32_t *pr = zprog.begin();
     const uint32_t *pp;
     uint32_t data = 0;
@@ -1330,11 +1442,14 @@ IPFilter::length_checked_match(const IPFilterProgram &zprog, const Packet *p,
 	else if (off >= offset_net)
 	    data = *(const uint32_t *)(neth_data + off - offset_net);
 	else
-	    data = *(const uint32_t *)(p->mac_header() - 2 + off);
+	    data = *(const uint32_t *)(mac_data - 2 + off);
 	data &= pr[3];
 	off = pr[0] >> 17;
 	pp = pr + 4;
-	if (!PERFORM_BINARY_SEARCH || off < MIN_BINARY_SEARCH) {
+	if (!off) {
+	    off = pr[1 + IPFilterProgram::hash_contains(pr, data)];
+	    goto gotit;
+	} else if (!PERFORM_BINARY_SEARCH || off < MIN_BINARY_SEARCH) {
 	    for (; off; --off, ++pp)
 		if (*pp == data) {
 		    off = pr[2];
@@ -1377,9 +1492,50 @@ IPFilter::length_checked_match(const IPFilterProgram &zprog, const Packet *p,
 void
 IPFilter::push(int, Packet *p)
 {
-    checked_output_push(match(_zprog, p), p);
+    int output;
+    if (_tuples.ok() && _tuples.classify(p, output))
+	checked_output_push(output, p);
+    else if (_native.ok())
+	checked_output_push(match(_zprog, _native, p), p);
+    else
+	checked_output_push(match(_zprog, p), p);
+}
+
+void
+IPFilter::push_batch(int, PacketBatch &batch)
+{
+    enum { max_lanes = IPFilterProgram::max_lanes };
+    Packet *p[max_lanes];
+    const unsigned char *data[max_lanes], *net_data[max_lanes],
+	*transp_data[max_lanes];
+    int outputs[max_lanes], lane_index[max_lanes], lane_outputs[max_lanes];
+    bool lanes_ok = _zprog.output_everything() < 0;
+    bool tuples_ok = _tuples.ok();
+
+    while (!batch.empty()) {
+	int n = 0, nlanes = 0;
+	for (; n < max_lanes && !batch.empty(); ++n) {
+	    p[n] = batch.pop_front();
+	    if (tuples_ok && _tuples.classify(p[n], outputs[n]))
+		/* decided by tuple-space search */;
+	    else if (lanes_ok && program_length(p[n]) >= (int) _zprog.safe_length()) {
+		data[nlanes] = p[n]->mac_header() - 2;
+		net_data[nlanes] = p[n]->network_header();
+		transp_data[nlanes] = p[n]->transport_header();
+		lane_index[nlanes++] = n;
+	    } else
+		outputs[n] = match(_zprog, p[n]);
+	}
+	if (nlanes) {
+	    _zprog.match_lanes(nlanes, data, net_data, transp_data,
+			       lane_outputs, offset_net, offset_transp);
+	    for (int i = 0; i < nlanes; ++i)
+		outputs[lane_index[i]] = lane_outputs[i];
+	}
+	Classification::push_batch_by_output(this, p, outputs, n);
+    }
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(Classification)
+ELEMENT_REQUIRES(Classification IPTupleSpace)
 EXPORT_ELEMENT(IPFilter)
@@ -1,6 +1,7 @@
 #ifndef CLICK_IPFILTER_HH
 #define CLICK_IPFILTER_HH
 #include "elements/standard/classification.hh"
+#include "elements/ip/iptuplespace.hh"
 #include <click/element.hh>
 CLICK_DECLS
 
@@ -101,12 +102,42 @@ with IPFilter.
            // Default-2:
            deny all);
 
+IPFilter evaluates packets that arrive in a batch together, up to 16 at a
+time, and passes them on in one batch per output port.  Packets following
+the same path through the program are tested with SIMD instructions where
+available.
+
+Large rule sets are also searched by tuple space.  If at least the first 64
+rules each test only a conjunction of source and destination address or
+network, IP protocol, and port equalities, inequalities, or ranges, IPFilter
+groups those rules by which fields and masks they test, with one hash table
+per group.  A packet then costs one hash lookup per group rather than a walk
+through a program that grows with the number of rules.  The result is always
+the first matching rule's.  Packets that match none of the grouped rules, when
+later rules could not be grouped, and non-first fragments use the program.
+Rules that use C<or>, C<not>, C<?:>, or other header fields end the grouped
+prefix.
+
+Long alternations on a single field, such as "dst port 20 or dst port 21 or
+...", become one test.  With 32 or more values the test is a hash set, so it
+costs about one probe however many values it lists.
+
 =h program read-only
 Returns a human-readable definition of the program the IPFilter element
 is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h tuples read-only
+Returns a description of the tuple-space search, if IPFilter uses it: the
+number of rules covered and, for each group, its masks and size.
+
+=h jit read-only
+Returns true if IPFilter translated its program into native machine code.
+This is supported at user level on x86-64.  Short packets always use the
+interpreter.  With the userlevel driver's B<--perf-map> option, the
+generated code appears in profiles under the element's name.
+
 =a
 
 IPClassifier, Classifier, CheckIPHeader, MarkIPHeader, CheckIPHeader2,
@@ -131,12 +162,24 @@ class IPFilter : public Element { public:
     void add_handlers();
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
     typedef Classification::Wordwise::CompressedProgram IPFilterProgram;
     static void parse_program(IPFilterProgram &zprog,
 			      const Vector<String> &conf, int noutputs,
-			      const Element *context, ErrorHandler *errh);
+			      const Element *context, ErrorHandler *errh,
+			      IPTupleSpace *tuples = 0);
     static inline int match(const IPFilterProgram &zprog, const Packet *p);
+    static inline int match(const IPFilterProgram &zprog,
+			    const unsigned char *mac_data,
+			    const unsigned char *neth_data,
+			    const unsigned char *transph_data,
+			    int packet_length);
+    static inline int program_length(int network_length,
+				     int network_header_length);
+    static inline int match(const IPFilterProgram &zprog,
+			    const Classification::Wordwise::NativeProgram &native,
+			    const Packet *p);
 
     enum {
 	TYPE_NONE	= 0,		// data types
@@ -201,7 +244,9 @@ class IPFilter : public Element { public:
 
     enum {
 	PERFORM_BINARY_SEARCH = 1,
-	MIN_BINARY_SEARCH = 7
+	MIN_BINARY_SEARCH = 7,
+	MIN_HASH_SEARCH = 32,
+	MIN_TUPLE_SEARCH = 64
     };
 
     union PrimitiveData {
@@ -238,6 +283,7 @@ class IPFilter : public Element { public:
 		  int mask_dt, const PrimitiveData &mask,
 		  ErrorHandler *errh);
 	void compile(Classification::Wordwise::Program &p, Vector<int> &tree) const;
+	bool restrict_rule(IPTupleSpace::Rule &rule) const;
 
 	bool has_transp_proto() const;
 	bool negation_is_simple() const;
@@ -258,6 +304,8 @@ class IPFilter : public Element { public:
   protected:
 
     IPFilterProgram _zprog;
+    Classification::Wordwise::NativeProgram _native;
+    IPTupleSpace _tuples;
 
   private:
 
@@ -271,12 +319,14 @@ class IPFilter : public Element { public:
 	const Element *_context;
 	ErrorHandler *_errh;
 	Primitive _prev_prim;
+	IPTupleSpace::Rule *_rule;
 
 	Parser(const Vector<String> &words, Vector<int> &tree,
 	       Classification::Wordwise::Program &prog,
-	       const Element *context, ErrorHandler *errh)
+	       const Element *context, ErrorHandler *errh,
+	       IPTupleSpace::Rule *rule = 0)
 	    : _words(words), _tree(tree), _prog(prog), _context(context),
-	      _errh(errh) {
+	      _errh(errh), _rule(rule) {
 	}
 
 	struct parse_state {
@@ -298,10 +348,16 @@ class IPFilter : public Element { public:
 	int parse_test(int pos, bool negated);
     };
 
+    static inline int program_length(const Packet *p);
     static int length_checked_match(const IPFilterProgram &zprog,
-				    const Packet *p, int packet_length);
+				    const unsigned char *mac_data,
+				    const unsigned char *neth_data,
+				    const unsigned char *transph_data,
+				    int packet_length);
 
     static String program_string(Element *e, void *user_data);
+    static String tuples_handler(Element *e, void *user_data);
+    static String jit_handler(Element *e, void *user_data);
 
 };
 
@@ -323,24 +379,49 @@ IPFilter::Primitive::negation_is_simple() const
 	return _type == TYPE_HOST || (_type & TYPE_FIELD) || _type == TYPE_IPFRAG;
 }
 
+/** @brief Return the packet length match() expects for data with
+ * @a network_length bytes from the network header on, of which
+ * @a network_header_length are the network header. */
 inline int
-IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
+IPFilter::program_length(int network_length, int network_header_length)
 {
-    int packet_length = p->network_length(),
-	network_header_length = p->network_header_length();
-    if (packet_length > network_header_length)
-	packet_length += offset_transp - network_header_length;
+    if (network_length > network_header_length)
+	return network_length + offset_transp - network_header_length;
     else
-	packet_length += offset_net;
+	return network_length + offset_net;
+}
+
+inline int
+IPFilter::program_length(const Packet *p)
+{
+    return program_length(p->network_length(), p->network_header_length());
+}
 
+inline int
+IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
+{
+    return match(zprog, p->mac_header(), p->network_header(),
+		 p->transport_header(), program_length(p));
+}
+
+/** @brief Match packet data against @a zprog.
+ * @param mac_data start of the link header
+ * @param neth_data start of the network header
+ * @param transph_data start of the transport header
+ * @param packet_length length of the data, as returned by program_length()
+ *
+ * Lets a caller test data that is not yet in a Packet. */
+inline int
+IPFilter::match(const IPFilterProgram &zprog, const unsigned char *mac_data,
+		const unsigned char *neth_data,
+		const unsigned char *transph_data, int packet_length)
+{
     if (zprog.output_everything() >= 0)
 	return zprog.output_everything();
     else if (packet_length < (int) zprog.safe_length())
 	// common case never checks packet length
-	return length_checked_match(zprog, p, packet_length);
-
-    const unsigned char *neth_data = p->network_header();
-    const unsigned char *transph_data = p->transport_header();
+	return length_checked_match(zprog, mac_data, neth_data, transph_data,
+				    packet_length);
 
     const uint32_t *pr = zprog.begin();
     const uint32_t *pp;
@@ -352,11 +433,14 @@ IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
 	else if (off >= offset_net)
 	    data = *(const uint32_t *)(neth_data + off - offset_net);
 	else
-	    data = *(const uint32_t *)(p->mac_header() - 2 + off);
+	    data = *(const uint32_t *)(mac_data - 2 + off);
 	data &= pr[3];
 	off = pr[0] >> 17;
 	pp = pr + 4;
-	if (!PERFORM_BINARY_SEARCH || off < MIN_BINARY_SEARCH) {
+	if (!off) {
+	    off = pr[1 + IPFilterProgram::hash_contains(pr, data)];
+	    goto gotit;
+	} else if (!PERFORM_BINARY_SEARCH || off < MIN_BINARY_SEARCH) {
 	    for (; off; --off, ++pp)
 		if (*pp == data) {
 		    off = pr[2];
@@ -383,5 +467,22 @@ IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
     }
 }
 
+/** @brief Match @a p using @a native, the compiled form of @a zprog.
+ * @pre @a native.ok() */
+inline int
+IPFilter::match(const IPFilterProgram &zprog,
+		const Classification::Wordwise::NativeProgram &native,
+		const Packet *p)
+{
+    int packet_length = program_length(p);
+
+    if (packet_length < (int) zprog.safe_length())
+	return length_checked_match(zprog, p->mac_header(), p->network_header(),
+				    p->transport_header(), packet_length);
+    else
+	return native.match(p->mac_header() - 2, p->network_header(),
+			    p->transport_header());
+}
+
 CLICK_ENDDECLS
 #endif
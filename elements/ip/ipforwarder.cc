@@ -0,0 +1,208 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipforwarder.{cc,hh} -- fast path for IP forwarding over Ethernet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipforwarder.hh"
+#include <clicknet/ether.h>
+#include <clicknet/ip.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <click/packetbatch.hh>
+#include "elements/ip/checkipheader.hh"
+#include "elements/ip/iproutetable.hh"
+#include "elements/ethernet/arptable.hh"
+#include "elements/standard/classification.hh"
+CLICK_DECLS
+
+IPForwarder::IPForwarder()
+    : _table(0), _arpt(0)
+{
+    _forwarded = 0;
+    _drops = 0;
+}
+
+IPForwarder::~IPForwarder()
+{
+}
+
+int
+IPForwarder::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(this, errh).bind(conf)
+	.read_mp("TABLE", ElementCastArg("IPRouteTable"), _table)
+	.read_mp("ARP", ElementCastArg("ARPTable"), _arpt)
+	.read("INTERFACES", CheckIPHeader::InterfacesArg(), _bad_src, _good_dst)
+	.read("BADSRC", _bad_src)
+	.read("GOODDST", _good_dst)
+	.consume() < 0)
+	return -1;
+
+    _ifaces.clear();
+    for (int i = 0; i < conf.size(); ++i) {
+	Interface iface;
+	iface.fast = (conf[i] != "-");
+	iface.mtu = 1500;
+	if (iface.fast
+	    && Args(this, errh).push_back_words(conf[i])
+	       .read_mp("ETH", iface.eth)
+	       .read_p("MTU", iface.mtu)
+	       .complete() < 0)
+	    return errh->error("bad PORT%d argument", i);
+	_ifaces.push_back(iface);
+    }
+    if (noutputs() != _ifaces.size() + 3)
+	return errh->error("need %d output ports, one per PORT argument plus 3", _ifaces.size() + 3);
+    return 0;
+}
+
+// Check the IP header of Ethernet frame p, as CheckIPHeader would after
+// Strip(14), and set its annotations.  Return false if p should be dropped.
+bool
+IPForwarder::check(Packet *p)
+{
+    if (p->length() < sizeof(click_ether) + sizeof(click_ip)
+	|| p->packet_type_anno() == Packet::BROADCAST
+	|| p->packet_type_anno() == Packet::MULTICAST)
+	return false;
+    const click_ether *e = reinterpret_cast<const click_ether *>(p->data());
+    const click_ip *ip = reinterpret_cast<const click_ip *>(e + 1);
+    unsigned hlen = ip->ip_hl << 2;
+    unsigned len = ntohs(ip->ip_len);
+    if (e->ether_type != htons(ETHERTYPE_IP)
+	|| ip->ip_v != 4 || hlen < sizeof(click_ip)
+	|| len < hlen || len > p->length() - sizeof(click_ether)
+	|| click_in_cksum((const unsigned char *) ip, hlen) != 0)
+	return false;
+    if (_bad_src.size()
+	&& find(_bad_src.begin(), _bad_src.end(), IPAddress(ip->ip_src)) < _bad_src.end()
+	&& find(_good_dst.begin(), _good_dst.end(), IPAddress(ip->ip_dst)) == _good_dst.end())
+	return false;
+
+    p->set_ip_header(ip, hlen);
+    if (p->length() > sizeof(click_ether) + len)
+	p->take(p->length() - sizeof(click_ether) - len);
+    p->set_dst_ip_anno(ip->ip_dst);
+    return true;
+}
+
+// Finish forwarding checked packet p, which TABLE routed to port with
+// gateway gw.  Set out to the output for the result.
+Packet *
+IPForwarder::forward(Packet *p, int port, IPAddress gw, int &out)
+{
+    const click_ip *ip = p->ip_header();
+    if (port < 0 || port >= _ifaces.size() || ip->ip_hl != 5
+	|| IPAddress(ip->ip_dst).is_multicast()) {
+	p->pull(sizeof(click_ether));
+	out = out_exception();
+	return p;
+    }
+
+    const Interface &iface = _ifaces[port];
+    if (!iface.fast || ip->ip_ttl <= 1) {
+	p->pull(sizeof(click_ether));
+	if (iface.fast)
+	    out = out_expired();
+	else {
+	    if (gw)
+		p->set_dst_ip_anno(gw);
+	    out = port;
+	}
+	return p;
+    }
+
+    WritablePacket *q = p->uniqueify();
+    if (!q)
+	return 0;
+    click_ip *wip = q->ip_header();
+    --wip->ip_ttl;
+    // incremental checksum update as in DecIPTTL (RFC1624)
+    unsigned long sum = (~ntohs(wip->ip_sum) & 0xFFFF) + 0xFEFF;
+    wip->ip_sum = ~htons(sum + (sum >> 16));
+
+    if (gw)
+	q->set_dst_ip_anno(gw);
+    EtherAddress eth;
+    if (ntohs(wip->ip_len) > iface.mtu
+	|| _arpt->lookup(q->dst_ip_anno(), &eth, 0) < 0) {
+	q->pull(sizeof(click_ether));
+	SET_PAINT_ANNO(q, port);
+	out = out_slow();
+	return q;
+    }
+
+    click_ether *e = reinterpret_cast<click_ether *>(q->data());
+    memcpy(e->ether_dhost, eth.data(), 6);
+    memcpy(e->ether_shost, iface.eth.data(), 6);
+    _forwarded++;
+    out = port;
+    return q;
+}
+
+void
+IPForwarder::push(int, Packet *p)
+{
+    if (!check(p)) {
+	_drops++;
+	p->kill();
+	return;
+    }
+    IPAddress gw;
+    int port = _table->lookup_route(p->dst_ip_anno(), gw), out;
+    if ((p = forward(p, port, gw, out)))
+	output(out).push(p);
+}
+
+void
+IPForwarder::push_batch(int, PacketBatch &batch)
+{
+    Packet *p[BATCH_LANES];
+    IPAddress addr[BATCH_LANES], gw[BATCH_LANES];
+    int port[BATCH_LANES], out[BATCH_LANES];
+
+    while (!batch.empty()) {
+	int n = 0;
+	while (n < BATCH_LANES && !batch.empty()) {
+	    Packet *q = batch.pop_front();
+	    if (check(q)) {
+		p[n] = q;
+		addr[n] = q->dst_ip_anno();
+		++n;
+	    } else {
+		_drops++;
+		q->kill();
+	    }
+	}
+	_table->lookup_routes(n, addr, gw, port);
+	int m = 0;
+	for (int i = 0; i < n; ++i)
+	    if ((p[m] = forward(p[i], port[i], gw[i], out[m])))
+		++m;
+	Classification::push_batch_by_output(this, p, out, m);
+    }
+}
+
+void
+IPForwarder::add_handlers()
+{
+    add_data_handlers("forwarded", Handler::OP_READ, &_forwarded);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable ARPTable CheckIPHeader Classification)
+EXPORT_ELEMENT(IPForwarder)
+ELEMENT_MT_SAFE(IPForwarder)
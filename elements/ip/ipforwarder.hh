@@ -0,0 +1,177 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPFORWARDER_HH
+#define CLICK_IPFORWARDER_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/etheraddress.hh>
+#include <click/ipaddress.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+class IPRouteTable;
+class ARPTable;
+
+/*
+=c
+
+IPForwarder(TABLE, ARP, PORT0, PORT1, ..., I<keywords> BADSRC, GOODDST, INTERFACES)
+
+=s iproute
+
+fast path for IP forwarding over Ethernet
+
+=d
+
+IPForwarder fuses the common case of an Ethernet IP router's forwarding path
+into one element.  For each Ethernet frame carrying an IPv4 packet, it checks
+the IP header, looks up the destination in the routing table TABLE, which may
+be any IPRouteTable element, decrements the TTL with an incremental checksum
+update, checks the packet against the output's MTU, and rewrites the Ethernet
+header using the neighbor cache ARP, an ARPTable element.  Packets that need
+more than that leave on exception outputs to the ordinary, slower router
+configuration.
+
+When packets arrive in a batch, IPForwarder checks up to 16 headers, looks
+their destinations up with one batched routing table lookup, and forwards one
+batch per output port.
+
+Each PORTI argument describes TABLE's output port I.  It is either
+`C<ETH [MTU]>', meaning the port leads to an Ethernet interface with address
+ETH and maximum transmission unit MTU (default 1500), or `C<->', meaning the
+port does not lead to an interface; for example, it might deliver packets to
+the host.  Say there are N PORT arguments.  IPForwarder then has N + 3 outputs:
+
+=over 8
+
+=item 0 ... N-1
+
+Packets routed to TABLE's output I leave on output I.  If PORTI is an
+interface, they are Ethernet frames ready for transmission: TTL decremented,
+destination Ethernet address taken from ARP, source address set to ETH.
+Otherwise they are IP packets, as TABLE itself would emit them: the Ethernet
+header is stripped and the destination IP address annotation is set to the
+route's gateway, if any.
+
+=item N
+
+IP packets routed to an interface that could not be completed in the fast
+path, because they are larger than the interface's MTU or ARP has no live
+entry for their next hop.  Their TTLs have been decremented, their destination
+IP address annotations are set to the next hop, and their paint annotations
+are set to the output port.  Send them to a PaintSwitch, then to each
+interface's IPFragmenter and ARPQuerier.
+
+=item N+1
+
+IP packets whose TTL expired, unchanged.  Send them to ICMPError.
+
+=item N+2
+
+IP packets that need the full router configuration, unchanged: packets with
+IP options, packets for which TABLE has no route, packets routed to a port
+with no PORT argument, and IP multicast packets.  Their destination IP address
+annotations are set to the destination address.
+
+=back
+
+Packets on outputs N and above have their Ethernet headers stripped and their
+IP header annotations set.  Frames with invalid IP headers, or that arrived
+as link-level broadcasts or multicasts, are dropped, as CheckIPHeader and
+DropBroadcasts would drop them.  IPForwarder does not look at paint
+annotations, so it sends no ICMP redirects.
+
+Keyword arguments are:
+
+=over 8
+
+=item BADSRC
+
+Space-separated list of IP addresses.  Packets with one of these source
+addresses are dropped, as with CheckIPHeader.  Default is empty.
+
+=item GOODDST
+
+Space-separated list of IP addresses.  Exceptions to BADSRC, as with
+CheckIPHeader.  Default is empty.
+
+=item INTERFACES
+
+Space-separated list of IP addresses with network prefixes, meant to
+represent this router's interface addresses.  Sets BADSRC and GOODDST as
+CheckIPHeader does.
+
+=back
+
+=e
+
+Forwarding between two interfaces, with output 0 for the host:
+
+  rt :: RadixIPLookup(18.26.4.24/32 0, 18.26.4.0/24 1, 18.26.7.0/24 2,
+                      0.0.0.0/0 18.26.4.1 1);
+  arpt :: ARPTable;
+  fw :: IPForwarder(rt, arpt, -, 00:00:c0:ae:67:ef, 00:00:c0:4f:71:ef,
+                    INTERFACES 18.26.4.24/24 18.26.7.1/24);
+  c0[2] -> fw;  c1[2] -> fw;
+  fw[0] -> ... host ...;
+  fw[1] -> out0;  fw[2] -> out1;
+  fw[3] -> PaintSwitch -> IPFragmenter(1500) -> ARPQuerier(..., TABLE arpt) -> out0;
+  ...
+  fw[4] -> ICMPError(18.26.4.24, timeexceeded) -> ...;
+  fw[5] -> ... full IP router configuration ...;
+
+=h forwarded read-only
+
+Returns the number of packets forwarded entirely in the fast path.
+
+=h drops read-only
+
+Returns the number of packets dropped for invalid headers or link-level
+broadcast.
+
+=a IPRouteTable, ARPTable, ARPQuerier, IPInputCombo, IPOutputCombo,
+CheckIPHeader, DecIPTTL, IPFragmenter */
+
+class IPForwarder : public Element { public:
+
+    IPForwarder();
+    ~IPForwarder();
+
+    const char *class_name() const	{ return "IPForwarder"; }
+    const char *port_count() const	{ return "1/-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+  private:
+
+    enum { BATCH_LANES = 16 };
+
+    struct Interface {
+	bool fast;
+	unsigned mtu;
+	EtherAddress eth;
+    };
+
+    IPRouteTable *_table;
+    ARPTable *_arpt;
+    Vector<Interface> _ifaces;
+    Vector<IPAddress> _bad_src;
+    Vector<IPAddress> _good_dst;
+
+    atomic_uint32_t _forwarded;
+    atomic_uint32_t _drops;
+
+    int out_slow() const		{ return _ifaces.size(); }
+    int out_expired() const		{ return _ifaces.size() + 1; }
+    int out_exception() const		{ return _ifaces.size() + 2; }
+
+    bool check(Packet *p);
+    Packet *forward(Packet *p, int port, IPAddress gw, int &out);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -23,6 +23,7 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 IPFragmenter::IPFragmenter()
@@ -66,13 +67,14 @@ IPFragmenter::optcopy(const click_ip *ip1, click_ip *ip2)
 	if (opt == IPOPT_NOP)
 	    optlen = 1;
 	else if (opt == IPOPT_EOL || i == opts_len - 1
-		 || i + (optlen = oin[i+1]) > opts_len)
-	    break;
+		 || (optlen = oin[i+1]) < 2 || i + optlen > opts_len)
+	    break;	// end of options, or malformed
 	if (opt & 0x80) {	// copy the option
 	    if (ip2)
 		memcpy(oout + outpos, oin + i, optlen);
 	    outpos += optlen;
 	}
+	i += optlen;
     }
 
     for (; (outpos & 3) != 0; outpos++)
@@ -83,7 +85,7 @@ IPFragmenter::optcopy(const click_ip *ip1, click_ip *ip2)
 }
 
 void
-IPFragmenter::fragment(Packet *p_in)
+IPFragmenter::fragment(Packet *p_in, PacketBatch &out)
 {
     const click_ip *ip_in = p_in->ip_header();
     int hlen = ip_in->ip_hl << 2;
@@ -98,64 +100,82 @@ IPFragmenter::fragment(Packet *p_in)
 	return;
     }
 
-    // make sure we can modify the packet
-    WritablePacket *p = p_in->uniqueify();
-    if (!p)
-	return;
-    click_ip *ip = p->ip_header();
-
-    // output the first fragment
     // If we're cheating the DF bit, we can't trust the ip_id; set to random.
-    if (ip->ip_off & htons(IP_DF)) {
-	ip->ip_id = click_random();
-	ip->ip_off &= ~htons(IP_DF);
+    uint16_t ip_id = ip_in->ip_id, ip_off = ip_in->ip_off;
+    if (ip_off & htons(IP_DF)) {
+	ip_id = click_random();
+	ip_off &= ~htons(IP_DF);
     }
-    bool had_mf = (ip->ip_off & htons(IP_MF)) != 0;
-    ip->ip_len = htons(hlen + first_dlen);
-    ip->ip_off |= htons(IP_MF);
-    ip->ip_sum = 0;
-    ip->ip_sum = click_in_cksum((const unsigned char *)ip, hlen);
-    Packet *first_fragment = p->clone();
-    first_fragment->take(p->length() - p->network_header_offset() - hlen - first_dlen);
-    output(0).push(first_fragment);
-    _fragments++;
-
-    // output the remaining fragments
-    int out_hlen = sizeof(click_ip) + optcopy(ip, 0);
-
+    bool had_mf = (ip_off & htons(IP_MF)) != 0;
+
+    // Build the header for the remaining fragments once: the fixed header
+    // plus the options that are copied into every fragment.
+    union {
+	click_ip ip;
+	uint32_t u[15];
+    } later;
+    memcpy(&later.ip, ip_in, sizeof(click_ip));
+    int out_hlen = sizeof(click_ip) + optcopy(ip_in, &later.ip);
+    later.ip.ip_hl = out_hlen >> 2;
+    later.ip.ip_id = ip_id;
+
+    // Copy out the remaining fragments before the first fragment's header
+    // is rewritten.
+    PacketBatch rest;
+    const unsigned char *payload = p_in->network_header() + hlen;
     for (int off = first_dlen; off < in_dlen; ) {
-	// prepare packet
 	int out_dlen = (_mtu - out_hlen) & ~7;
 	if (out_dlen + off > in_dlen)
 	    out_dlen = in_dlen - off;
 
-	WritablePacket *q = Packet::make(_headroom, 0, out_hlen + out_dlen, 0);
-	if (q) {
+	if (WritablePacket *q = Packet::make(_headroom, 0, out_hlen + out_dlen, 0)) {
 	    q->set_network_header(q->data(), out_hlen);
 	    click_ip *qip = q->ip_header();
-
-	    memcpy(qip, ip, sizeof(click_ip));
-	    optcopy(ip, qip);
-	    memcpy(q->transport_header(), p->transport_header() + off, out_dlen);
-
-	    qip->ip_hl = out_hlen >> 2;
-	    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
+	    memcpy(qip, &later.ip, out_hlen);
+	    memcpy(q->transport_header(), payload + off, out_dlen);
+	    qip->ip_off = htons(ntohs(ip_off | htons(IP_MF)) + (off >> 3));
 	    if (out_dlen + off >= in_dlen && !had_mf)
 		qip->ip_off &= ~htons(IP_MF);
 	    qip->ip_len = htons(out_hlen + out_dlen);
 	    qip->ip_sum = 0;
 	    qip->ip_sum = click_in_cksum((const unsigned char *)qip, out_hlen);
-
-	    q->copy_annotations(p);
-
-	    output(0).push(q);
-	    _fragments++;
+	    q->copy_annotations(p_in);
+	    rest.push_back(q);
 	}
 
 	off += out_dlen;
     }
 
-    p->kill();
+    // The first fragment reuses the input's buffer, truncated.  A shared
+    // input would have to be copied whole to be written, so copy just the
+    // first fragment instead.
+    int first_len = p_in->network_header_offset() + hlen + first_dlen;
+    WritablePacket *p;
+    if (!p_in->shared()) {
+	p = p_in->uniqueify();
+	p->take(p->length() - first_len);
+    } else {
+	p = Packet::make(p_in->headroom(), p_in->data(), first_len, 0);
+	if (p) {
+	    p->set_network_header(p->data() + p_in->network_header_offset(), hlen);
+	    p->copy_annotations(p_in);
+	    if (p_in->mac_header())
+		p->set_mac_header(p->data() + p_in->mac_header_offset());
+	}
+	p_in->kill();
+    }
+    if (p) {
+	click_ip *ip = p->ip_header();
+	ip->ip_id = ip_id;
+	ip->ip_off = ip_off | htons(IP_MF);
+	ip->ip_len = htons(hlen + first_dlen);
+	ip->ip_sum = 0;
+	ip->ip_sum = click_in_cksum((const unsigned char *)ip, hlen);
+	out.push_back(p);
+    }
+
+    _fragments += rest.count() + (p ? 1 : 0);
+    out.append(rest);
 }
 
 void
@@ -163,8 +183,25 @@ IPFragmenter::push(int, Packet *p)
 {
     if (p->network_length() <= (int) _mtu)
 	output(0).push(p);
-    else
-	fragment(p);
+    else {
+	PacketBatch out;
+	fragment(p, out);
+	if (!out.empty())
+	    output(0).push_batch(out);
+    }
+}
+
+void
+IPFragmenter::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if (p->network_length() <= (int) _mtu)
+	    out.push_back(p);
+	else
+	    fragment(p, out);
+    if (!out.empty())
+	output(0).push_batch(out);
 }
 
 void
@@ -22,7 +22,9 @@ CLICK_DECLS
  *
  * Copies all annotations to the fragments.
  *
- * Sends the fragments in order, starting with the first.
+ * Sends the fragments in order, starting with the first, as one batch.  The
+ * first fragment reuses the input packet's buffer unless the buffer is
+ * shared, as after a Tee; then only the first fragment's bytes are copied.
  *
  * It is best to Strip() the MAC header from a packet before sending it to
  * IPFragmenter, since any MAC header is not copied to second and subsequent
@@ -71,6 +73,7 @@ class IPFragmenter : public Element { public:
   void add_handlers();
 
   void push(int, Packet *);
+  void push_batch(int, PacketBatch &);
 
  private:
 
@@ -81,7 +84,7 @@ class IPFragmenter : public Element { public:
   atomic_uint32_t _drops;
   atomic_uint32_t _fragments;
 
-  void fragment(Packet *);
+  void fragment(Packet *, PacketBatch &);
   int optcopy(const click_ip *ip1, click_ip *ip2);
 
 };
@@ -63,6 +63,15 @@ IPInputCombo::configure(Vector<String> &conf, ErrorHandler *errh)
   return 0;
 }
 
+bool
+IPInputCombo::input_alignment(int &modulus, int &offset) const
+{
+  // align the IP header behind the Ethernet header
+  modulus = 4;
+  offset = 2;
+  return true;
+}
+
 inline Packet *
 IPInputCombo::smaction(Packet *p)
 {
@@ -55,6 +55,8 @@ class IPInputCombo : public Element {
   uint32_t drops() const			{ return _drops; }
   void add_handlers();
   int configure(Vector<String> &, ErrorHandler *);
+  int data_shift() const			{ return 14; }
+  bool input_alignment(int &modulus, int &offset) const;
 
   inline Packet *smaction(Packet *);
   void push(int, Packet *p);
@@ -103,6 +103,7 @@ class IPPrint : public Element { public:
   ~IPPrint();
 
   const char *class_name() const		{ return "IPPrint"; }
+  const char *flags() const			{ return _print_timestamp ? "T" : ""; }
   const char *port_count() const		{ return PORTS_1_1; }
 
   int configure(Vector<String> &, ErrorHandler *);
@@ -31,7 +31,8 @@ IPRateMonitor::IPRateMonitor()
   : _count_packets(true), _anno_packets(true),
     _thresh(1), _memmax(0), _ratio(1),
     _lock(0), _base(0), _alloced_mem(0), _first(0),
-    _last(0), _prev_deleted(0)
+    _last(0), _prev_deleted(0), _arena(false), _nodes(0), _nnodes(0),
+    _free_node(-1), _node_bytes(0), _folded(0), _arena_timer(this)
 {
 }
 
@@ -45,12 +46,14 @@ IPRateMonitor::configure(Vector<String> &conf, ErrorHandler *errh)
     String count_what;
     _memmax = 0;
     _anno_packets = true;
+    _arena = false;
     if (Args(conf, this, errh)
 	.read_mp("TYPE", WordArg(), count_what)
 	.read_mp("RATIO", FixedPointArg(16), _ratio)
 	.read_mp("THRESH", _thresh)
 	.read_p("MEMORY", _memmax)
 	.read_p("ANNO", _anno_packets)
+	.read("ARENA", _arena)
 	.complete() < 0)
 	return -1;
   if (count_what.upper() == "PACKETS")
@@ -60,6 +63,8 @@ IPRateMonitor::configure(Vector<String> &conf, ErrorHandler *errh)
   else
     return errh->error("monitor type should be \"PACKETS\" or \"BYTES\"");
 
+  if (_arena && !_memmax)
+    _memmax = 1024;
   if (_memmax && _memmax < MEMMAX_MIN)
     _memmax = MEMMAX_MIN;
   _memmax *= 1024;      // now bytes
@@ -82,6 +87,31 @@ IPRateMonitor::initialize(ErrorHandler *errh)
   if (!_lock)
     return errh->error("cannot create spinlock.");
 
+  if (_arena) {
+    if (_thread_counts.initialize(master()) < 0)
+      return errh->error("out of memory");
+    // Each node carries 256 counters, plus two counts per counter for each
+    // thread and for the folded totals.
+    int ncounts = Stats::MAX_COUNTERS * 2;
+    _node_bytes = sizeof(ArenaNode)
+      + (_thread_counts.size() + 1) * ncounts * sizeof(uint32_t);
+    _nnodes = _memmax / _node_bytes;
+    if (_nnodes < 1)
+      return errh->error("MEMORY too small for ARENA, need %u kilobytes",
+                         (unsigned) ((_node_bytes + 1023) / 1024));
+    if (!(_nodes = new ArenaNode[_nnodes])
+        || !(_folded = new uint32_t[_nnodes * ncounts]()))
+      return errh->error("out of memory");
+    for (int i = 0; i < _thread_counts.size(); i++)
+      if (!(_thread_counts[i].counts = new uint32_t[_nnodes * ncounts]()))
+        return errh->error("out of memory");
+    arena_reset();
+    _arena_fold_epoch = EWMAParameters::epoch();
+    _arena_timer.initialize(this);
+    _arena_timer.schedule_now();
+    return 0;
+  }
+
   // Make _base
   _base = new Stats(this);
   if (!_base)
@@ -95,8 +125,12 @@ IPRateMonitor::cleanup(CleanupStage)
 {
   delete _base;
   delete _lock;
+  delete[] _nodes;
+  delete[] _folded;
   _base = 0;
   _lock = 0;
+  _nodes = 0;
+  _folded = 0;
 }
 
 void
@@ -104,9 +138,13 @@ IPRateMonitor::push(int port, Packet *p)
 {
   // Only inspect 1 in RATIO packets
   bool ewma = ((unsigned) ((click_random() >> 5) & 0xffff) <= _ratio);
-  _lock->acquire();
-  update_rates(p, port == 0, ewma);
-  _lock->release();
+  if (_arena)
+    update_rates(p, port == 0, ewma);
+  else {
+    _lock->acquire();
+    update_rates(p, port == 0, ewma);
+    _lock->release();
+  }
   output(port).push(p);
 }
 
@@ -116,14 +154,175 @@ IPRateMonitor::pull(int port)
   Packet *p = input(port).pull();
   if (p) {
     bool ewma = ((unsigned) ((click_random() >> 5) & 0xffff) <= _ratio);
-    _lock->acquire();
-    update_rates(p, port == 0, ewma);
-    _lock->release();
+    if (_arena)
+      update_rates(p, port == 0, ewma);
+    else {
+      _lock->acquire();
+      update_rates(p, port == 0, ewma);
+      _lock->release();
+    }
   }
   return p;
 }
 
 
+//
+// ARENA mode.  Everything below runs under _lock.
+//
+uint32_t
+IPRateMonitor::arena_total(int index) const
+{
+  uint32_t total = 0;
+  for (int i = 0; i < _thread_counts.size(); i++)
+    total += _thread_counts[i].counts[index];
+  return total;
+}
+
+void
+IPRateMonitor::arena_init_node(int node, int depth, int parent)
+{
+  ArenaNode &n = _nodes[node];
+  for (int i = 0; i < Stats::MAX_COUNTERS; i++) {
+    n.counter[i] = ArenaCounter();
+    for (int dir = 0; dir < 2; dir++) {
+      int index = arena_count_index(node, i, dir);
+      _folded[index] = arena_total(index);
+    }
+  }
+  n.depth = depth;
+  n.parent = parent;
+  _alloced_mem += _node_bytes;
+}
+
+int
+IPRateMonitor::arena_split(int node, int byte)
+{
+  int child = _free_node;
+  if (child < 0)
+    return -1;
+  _free_node = _nodes[child].next_free;
+  arena_init_node(child, _nodes[node].depth + 1, (node << 8) + byte);
+  // Publish the child only once it is ready for packets.
+  click_fence();
+  _nodes[node].counter[byte].child = child;
+  return child;
+}
+
+void
+IPRateMonitor::arena_free(int node)
+{
+  ArenaNode &n = _nodes[node];
+  for (int i = 0; i < Stats::MAX_COUNTERS; i++)
+    if (n.counter[i].child >= 0)
+      arena_free(n.counter[i].child);
+  _nodes[n.parent >> 8].counter[n.parent & 255].child = -1;
+  n.depth = -1;
+  n.next_free = _free_node;
+  _free_node = node;
+  _alloced_mem -= _node_bytes;
+}
+
+//
+// Reclaims subnets whose parent's rates are both below thresh.  Unlike
+// fold(), which stops once enough memory is free, this visits every node:
+// it runs from the timer at most once a second.
+//
+void
+IPRateMonitor::arena_fold(int thresh)
+{
+  for (int node = 1; node < _nnodes; node++) {
+    ArenaNode &n = _nodes[node];
+    if (n.depth < 0)
+      continue;
+    const ArenaCounter &c = _nodes[n.parent >> 8].counter[n.parent & 255];
+    if (arena_rate(c, 0) < thresh && arena_rate(c, 1) < thresh)
+      arena_free(node);
+  }
+}
+
+void
+IPRateMonitor::arena_reset()
+{
+  _free_node = -1;
+  for (int node = _nnodes - 1; node > 0; node--) {
+    ArenaNode &n = _nodes[node];
+    n.depth = -1;
+    n.next_free = _free_node;
+    _free_node = node;
+  }
+  _alloced_mem = 0;
+  // Node 0's counters are reset in place; a packet still walking an old
+  // subtree adds to a free node, whose counts are resnapshotted on reuse.
+  arena_init_node(0, 0, -1);
+}
+
+void
+IPRateMonitor::run_timer(Timer *)
+{
+  unsigned now = EWMAParameters::epoch();
+  _lock->acquire();
+
+  // Fold each counter's new counts into its rates, and split busy counters.
+  // Nodes split in this pass start from a fresh snapshot, so visiting them
+  // again later in the loop is harmless.
+  for (int node = 0; node < _nnodes; node++) {
+    ArenaNode &n = _nodes[node];
+    if (n.depth < 0)
+      continue;
+    for (int i = 0; i < Stats::MAX_COUNTERS; i++) {
+      ArenaCounter &c = n.counter[i];
+      for (int dir = 0; dir < 2; dir++) {
+        int index = arena_count_index(node, i, dir);
+        uint32_t total = arena_total(index);
+        if (uint32_t delta = total - _folded[index]) {
+          _folded[index] = total;
+          c.fwd_and_rev_rate.update(delta, dir);
+        } else if (c.fwd_and_rev_rate.scaled_average(dir))
+          c.fwd_and_rev_rate.update(0, dir);
+      }
+      if (c.child < 0 && n.depth < 3 && c.anno_this < now
+          && (arena_rate(c, 0) >= _thresh || arena_rate(c, 1) >= _thresh))
+        arena_split(node, i);
+    }
+  }
+
+  if (now - _arena_fold_epoch >= EWMAParameters::epoch_frequency()) {
+    arena_fold(_thresh);
+    _arena_fold_epoch = now;
+  }
+
+  _lock->release();
+  _arena_timer.reschedule_after(Timestamp::make_jiffies((click_jiffies_t) (CLICK_HZ / EWMAParameters::epoch_frequency())));
+}
+
+//
+// Returns the node at level (0-3) on the path to addr, or -1 if that level
+// is not open.
+//
+int
+IPRateMonitor::arena_find(unsigned addr, int level) const
+{
+  int node = 0;
+  addr = ntohl(addr);
+  for (int bitshift = 24; level > 0 && node >= 0; bitshift -= 8, level--)
+    node = _nodes[node].counter[(addr >> bitshift) & 255].child;
+  return node;
+}
+
+void
+IPRateMonitor::arena_set_anno_level(unsigned addr, unsigned level,
+                                    unsigned when)
+{
+  int node = arena_find(addr, level);
+  if (node >= 0) {
+    ArenaCounter &c = _nodes[node].counter[(ntohl(addr) >> (24 - 8 * level)) & 255];
+    c.anno_this = when;
+    if (c.child >= 0)
+      arena_free(c.child);
+  }
+}
+
+
 IPRateMonitor::Counter*
 IPRateMonitor::make_counter(Stats *s, unsigned char index, MyEWMA *rate)
 {
@@ -313,6 +512,25 @@ IPRateMonitor::print(Stats *s, String ip)
 }
 
 
+String
+IPRateMonitor::arena_print(int node, String ip)
+{
+  StringAccum sa;
+  for (int i = 0; i < Stats::MAX_COUNTERS; i++) {
+    const ArenaCounter &c = _nodes[node].counter[i];
+    if (c.fwd_and_rev_rate.scaled_average(1) > 0 ||
+	c.fwd_and_rev_rate.scaled_average(0) > 0) {
+      String this_ip = (ip ? ip + "." + String(i) : String(i));
+      sa << this_ip << '\t' << c.fwd_and_rev_rate.unparse_rate(0)
+         << '\t' << c.fwd_and_rev_rate.unparse_rate(1) << '\n';
+      if (c.child >= 0)
+        sa << arena_print(c.child, "\t" + this_ip);
+    }
+  }
+  return sa.take_string();
+}
+
+
 String
 IPRateMonitor::look_read_handler(Element *e, void *)
 {
@@ -321,7 +539,7 @@ IPRateMonitor::look_read_handler(Element *e, void *)
   String ret = String(EWMAParameters::epoch() - me->_resettime) + "\n";
 
   if (me->_lock->attempt()) {
-    ret = ret + me->print(me->_base);
+    ret = ret + (me->_arena ? me->arena_print(0) : me->print(me->_base));
     me->_lock->release();
     return ret;
   } else {
@@ -336,12 +554,16 @@ IPRateMonitor::reset_write_handler
   IPRateMonitor* me = (IPRateMonitor *) e;
 
   me->_lock->acquire();
-  for (int i = 0; i < Stats::MAX_COUNTERS; i++) {
-    if (me->_base->counter[i]) {
-      if (me->_base->counter[i]->next_level)
-        delete me->_base->counter[i]->next_level;
-      delete me->_base->counter[i];
-      me->_base->counter[i] = 0;
+  if (me->_arena)
+    me->arena_reset();
+  else {
+    for (int i = 0; i < Stats::MAX_COUNTERS; i++) {
+      if (me->_base->counter[i]) {
+        if (me->_base->counter[i]->next_level)
+          delete me->_base->counter[i]->next_level;
+        delete me->_base->counter[i];
+        me->_base->counter[i] = 0;
+      }
     }
   }
   me->set_resettime();
@@ -369,6 +591,9 @@ IPRateMonitor::memmax_write_handler
     return -1;
   }
 
+  if (me->_arena)
+    return errh->error("MEMORY cannot change in ARENA mode");
+
   if (memmax && memmax < (int)MEMMAX_MIN)
     memmax = MEMMAX_MIN;
 
@@ -417,8 +642,12 @@ IPRateMonitor::anno_level_write_handler
 
   me->_lock->acquire();
   unsigned addr = a.addr();
-  me->set_anno_level(addr, static_cast<unsigned>(level),
-                     static_cast<unsigned>(when));
+  if (me->_arena)
+    me->arena_set_anno_level(addr, static_cast<unsigned>(level),
+                             static_cast<unsigned>(when));
+  else
+    me->set_anno_level(addr, static_cast<unsigned>(level),
+                       static_cast<unsigned>(when));
   me->_lock->release();
   return 0;
 }
@@ -469,6 +698,24 @@ IPRateMonitor::llrpc(unsigned command, void *data)
 
     _lock->acquire();
 
+    if (_arena) {
+      int node = arena_find(ipaddr, level);
+      if (node < 0) {
+        _lock->release();
+        return -EAGAIN;
+      }
+      for (int i = 0; i < 256; i++) {
+        const ArenaCounter &c = _nodes[node].counter[i];
+        if (c.fwd_and_rev_rate.scaled_average(0) > 0
+            || c.fwd_and_rev_rate.scaled_average(1) > 0)
+          averages[i] = arena_rate(c, which);
+        else
+          averages[i] = -1;
+      }
+      _lock->release();
+      return CLICK_LLRPC_PUT_DATA(data, averages, sizeof(averages));
+    }
+
     // ipaddr is in network order
     Stats *s = _base;
     ipaddr = ntohl(ipaddr);
@@ -519,6 +766,23 @@ IPRateMonitor::llrpc(unsigned command, void *data)
 
     _lock->acquire();
 
+    if (_arena) {
+      int node = 0;
+      for (int bitshift = 24; bitshift >= 0 && node >= 0; bitshift -= 8) {
+        const ArenaCounter &c = _nodes[node].counter[(ntohl(ipaddr) >> bitshift) & 255];
+        if (!c.fwd_and_rev_rate.scaled_average(0)
+            && !c.fwd_and_rev_rate.scaled_average(1))
+          break;
+        averages[n*2+1] = arena_rate(c, 0);
+        averages[n*2+2] = arena_rate(c, 1);
+        n++;
+        node = c.child;
+      }
+      _lock->release();
+      averages[0] = n;
+      return CLICK_LLRPC_PUT_DATA(data, averages, sizeof(averages));
+    }
+
     // ipaddr is in network order
     Stats *s = _base;
     ipaddr = ntohl(ipaddr);
@@ -570,8 +834,12 @@ IPRateMonitor::llrpc(unsigned command, void *data)
     when += EWMAParameters::epoch();
 
     _lock->acquire();
-    set_anno_level(ipaddr, static_cast<unsigned>(level),
-	           static_cast<unsigned>(when));
+    if (_arena)
+      arena_set_anno_level(ipaddr, static_cast<unsigned>(level),
+                           static_cast<unsigned>(when));
+    else
+      set_anno_level(ipaddr, static_cast<unsigned>(level),
+                     static_cast<unsigned>(when));
     _lock->release();
     return 0;
   }
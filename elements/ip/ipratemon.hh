@@ -6,11 +6,13 @@
 #include <click/ewma.hh>
 #include <click/vector.hh>
 #include <click/packet_anno.hh>
+#include <click/percpu.hh>
+#include <click/timer.hh>
 CLICK_DECLS
 
 /*
  * =c
- * IPRateMonitor(TYPE, RATIO, THRESH [, MEMORY, ANNO])
+ * IPRateMonitor(TYPE, RATIO, THRESH [, MEMORY, ANNO, I<keywords> ARENA])
  * =s ipmeasure
  * measures coming and going IP traffic rates
  *
@@ -38,6 +40,17 @@ CLICK_DECLS
  *
  * ANNO: if on (by default, it is), annotate packets with rates.
  *
+ * ARENA: Boolean. If true, IPRateMonitor preallocates all its memory at
+ * initialization, as an arena of nodes of 256 counters each, and never
+ * allocates while running. MEMORY is then the arena's size, default 1024,
+ * and is exact: nodes are reclaimed to make room rather than freed. Packets
+ * are counted in per-thread counters without taking a lock; a timer folds
+ * the counts into the rates once per EWMA epoch, splits busy addresses, and
+ * once a second reclaims subnets whose rates fell below THRESH. A subnet
+ * that is split while the arena is full waits for that reclaim. Packet
+ * annotations therefore lag the traffic by up to one epoch, and a newly
+ * split subnet's rates start from zero. Default is false.
+ *
  * =h look (read)
  * Returns the rate of counted to and from a cluster of IP addresses. The first
  * printed line is the number of 'jiffies' that have past since the last reset.
@@ -46,6 +59,14 @@ CLICK_DECLS
  * =h thresh (read)
  * Returns THRESH.
  *
+ * =h mem (read)
+ * Returns the bytes of memory in use. In ARENA mode, this counts the arena's
+ * nodes in use, including their per-thread counters.
+ *
+ * =h memmax (read/write)
+ * Returns or sets MEMORY, in bytes when read and kilobytes when written.
+ * MEMORY cannot be changed in ARENA mode.
+ *
  * =h reset (write)
  * When written, resets all rates.
  *
@@ -99,11 +120,13 @@ public:
   int configure(Vector<String> &, ErrorHandler *);
   int initialize(ErrorHandler *);
   void cleanup(CleanupStage);
+  void run_timer(Timer *);
 
   void set_resettime() {
       _resettime = EWMAParameters::epoch();
   }
   void set_anno_level(unsigned addr, unsigned level, unsigned when);
+  void arena_set_anno_level(unsigned addr, unsigned level, unsigned when);
 
   void push(int port, Packet *p);
   Packet *pull(int port);
@@ -171,6 +194,61 @@ private:
   // HACK! For interaction between fold() and ~Stats()
   Stats *_prev_deleted, *_next_deleted;
 
+  // ARENA mode.  Node 0 is the top level.  A node's counters are written only
+  // by the timer and handlers, under _lock; packets only read them, and add
+  // to their thread's counts.  A child index may be stale by the time a
+  // packet follows it, which at worst counts a packet toward a reclaimed or
+  // reused node for one epoch.
+  struct ArenaCounter {
+    MyEWMA fwd_and_rev_rate;
+    int child;			// node for the next byte, or -1
+    unsigned anno_this;
+    ArenaCounter()
+      : child(-1), anno_this(0) {
+    }
+  };
+
+  struct ArenaNode {
+    ArenaCounter counter[Stats::MAX_COUNTERS];
+    int parent;			// (node << 8) + byte of parent counter
+    int depth;			// 0-3, or -1 if free
+    int next_free;
+  };
+
+  struct ThreadCounts {
+    uint32_t *counts;		// per node, byte, and direction; never reset
+    ThreadCounts()
+      : counts(0) {
+    }
+    ~ThreadCounts() {
+      delete[] counts;
+    }
+  };
+
+  bool _arena;
+  ArenaNode *_nodes;
+  int _nnodes;
+  int _free_node;		// free list head, or -1
+  size_t _node_bytes;		// node plus its counts, for mem
+  uint32_t *_folded;		// counts already folded into rates
+  PerCPU<ThreadCounts> _thread_counts;
+  unsigned _arena_fold_epoch;
+  Timer _arena_timer;
+
+  static inline int arena_count_index(int node, int byte, int dir) {
+    return (((node << 8) + byte) << 1) + dir;
+  }
+  static inline int arena_rate(const ArenaCounter &c, int dir);
+  inline void arena_update(unsigned, int, Packet *, bool, bool);
+  uint32_t arena_total(int index) const;
+  void arena_init_node(int node, int depth, int parent);
+  int arena_split(int node, int byte);
+  void arena_free(int node);
+  void arena_fold(int thresh);
+  void arena_reset();
+  int arena_find(unsigned addr, int level) const;
+  String arena_print(int node, String ip = "");
+
   void update_rates(Packet *, bool, bool);
   void update(unsigned, int, Packet *, bool, bool);
   void forced_fold();
@@ -317,6 +395,43 @@ IPRateMonitor::update(unsigned addr, int val, Packet *p,
 }
 
 
+inline int
+IPRateMonitor::arena_rate(const ArenaCounter &c, int dir)
+{
+  return (c.fwd_and_rev_rate.scaled_average(dir)
+          * EWMAParameters::epoch_frequency()) >> scale;
+}
+
+//
+// ARENA mode: counts a packet at every opened level of addr, without
+// locking, and annotates it with the deepest level's rates.
+//
+inline void
+IPRateMonitor::arena_update(unsigned addr, int val, Packet *p,
+                            bool forward, bool count)
+{
+  uint32_t *counts = _thread_counts.get().counts;
+  int dir = forward ? 0 : 1;
+  const ArenaCounter *c;
+  int n = 0;
+
+  addr = ntohl(addr);
+  for (int bitshift = 24; ; bitshift -= 8) {
+    unsigned char byte = (addr >> bitshift) & 255;
+    c = &_nodes[n].counter[byte];
+    if (count)
+      counts[arena_count_index(n, byte, dir)] += val;
+    n = c->child;
+    if (n < 0 || bitshift == 0)
+      break;
+  }
+
+  if (_anno_packets) {
+    SET_FWD_RATE_ANNO(p, arena_rate(*c, 0));
+    SET_REV_RATE_ANNO(p, arena_rate(*c, 1));
+  }
+}
+
 // for forward packets (port 0), update based on src IP address;
 // for reverse packets (port 1), update based on dst IP address.
 inline void
@@ -325,7 +440,10 @@ IPRateMonitor::update_rates(Packet *p, bool forward, bool update_ewma)
   const click_ip *ip = p->ip_header();
   int val = _count_packets ? 1 : ntohs(ip->ip_len);
 
-  if (forward)
+  if (_arena)
+    arena_update(forward ? ip->ip_src.s_addr : ip->ip_dst.s_addr,
+                 val, p, forward, update_ewma);
+  else if (forward)
     update(ip->ip_src.s_addr, val, p, true, update_ewma);
   else
     update(ip->ip_dst.s_addr, val, p, false, update_ewma);
@@ -23,7 +23,6 @@
 #include "ipreassembler.hh"
 #include <click/ipaddress.hh>
 #include <click/args.hh>
-#include <click/bitvector.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
@@ -36,10 +35,8 @@ CLICK_DECLS
 #define IP_BYTE_OFF(iph)	((ntohs((iph)->ip_off) & IP_OFFMASK) << 3)
 
 IPReassembler::IPReassembler()
-    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0), _stat_bad_pkts(0)
+    : _shards(0), _nshards(1), _seed(0)
 {
-    for (int i = 0; i < NMAP; i++)
-	_map[i] = 0;
     static_assert(IPREASSEMBLER_ANNO_OFFSET + IPREASSEMBLER_ANNO_SIZE <= Packet::anno_size, "anno too big");
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE, "sizeof(ChunkLink) is expected to equal IPREASSEMBLER_ANNO_SIZE.");
 }
@@ -53,45 +50,113 @@ IPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _mem_high_thresh = 256 * 1024;
     int mtu_anno = -1;
+    _nshards = 1;
     if (Args(conf, this, errh)
 	.read("HIMEM", _mem_high_thresh)
 	.read("MAX_MTU_ANNO", AnnoArg(2), mtu_anno)
+	.read("SHARDS", _nshards)
 	.complete() < 0)
 	return -1;
+    if (_nshards < 1 || _nshards > 256)
+	return errh->error("SHARDS must be between 1 and 256");
     _mtu_anno = mtu_anno;
+    _mem_high_thresh /= _nshards;
     _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
     return 0;
 }
 
 int
-IPReassembler::initialize(ErrorHandler *)
+IPReassembler::initialize(ErrorHandler *errh)
 {
-    _mem_used = 0;
-    _reap_time = 0;
+    _seed = click_random();
+    if (!(_shards = new Shard[_nshards]))
+	return errh->error("out of memory");
+    for (int i = 0; i < _nshards; ++i) {
+	if (!(_shards[i].buckets = new Queue *[64]))
+	    return errh->error("out of memory");
+	memset(_shards[i].buckets, 0, sizeof(Queue *) * 64);
+	_shards[i].mask = 63;
+    }
     return 0;
 }
 
 void
 IPReassembler::cleanup(CleanupStage)
 {
-    for (int i = 0; i < NMAP; i++)
-	while (_map[i]) {
-	    WritablePacket *next = (WritablePacket *)(_map[i]->next());
-	    _map[i]->kill();
-	    _map[i] = next;
+    for (int i = 0; _shards && i < _nshards; ++i) {
+	Shard &s = _shards[i];
+	while (s.lru.lru_next != &s.lru) {
+	    Queue *q = s.lru.lru_next;
+	    lru_remove(q);
+	    kill_queue(q);
 	}
+	delete[] s.buckets;
+    }
+    delete[] _shards;
+    _shards = 0;
+}
+
+size_t
+IPReassembler::memory_usage() const
+{
+    // Read without the shard locks, so the total is approximate while
+    // other threads push fragments.
+    size_t m = 0;
+    for (int i = 0; _shards && i < _nshards; ++i) {
+	const Shard &s = _shards[i];
+	m += sizeof(Shard) + (s.mask + 1) * sizeof(Queue *)
+	    + s.nqueues * sizeof(Queue) + s.mem_used;
+    }
+    return m;
+}
+
+inline uint32_t
+IPReassembler::key_hash(const click_ip *iph) const
+{
+    uint32_t h = _seed ^ iph->ip_src.s_addr;
+    h = h * 0x9E3779B1U ^ iph->ip_dst.s_addr;
+    h = h * 0x9E3779B1U ^ ((uint32_t) iph->ip_id << 8) ^ iph->ip_p;
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+inline IPReassembler::Shard &
+IPReassembler::shard(uint32_t hash) const
+{
+    // buckets use the hash's low bits, shards its high bits
+    return _shards[((uint64_t) hash * _nshards) >> 32];
+}
+
+inline void
+IPReassembler::lru_remove(Queue *q)
+{
+    q->lru_prev->lru_next = q->lru_next;
+    q->lru_next->lru_prev = q->lru_prev;
+}
+
+inline void
+IPReassembler::lru_push(Shard &s, Queue *q)
+{
+    q->lru_prev = &s.lru;
+    q->lru_next = s.lru.lru_next;
+    q->lru_next->lru_prev = q;
+    s.lru.lru_next = q;
 }
 
 void
-IPReassembler::check_error(ErrorHandler *errh, int bucket, const Packet *p, const char *format, ...)
+IPReassembler::check_error(ErrorHandler *errh, const Queue *q, const char *format, ...)
 {
     va_list val;
     va_start(val, format);
     StringAccum sa;
-    sa << "buck " << bucket << ": ";
-    if (p->has_network_header()) {
-	const click_ip *iph = p->ip_header();
-	sa << iph->ip_src << " > " << iph->ip_dst << " [" << ntohs(iph->ip_id) << ':' << PACKET_DLEN(p) << ((iph->ip_off & htons(IP_MF)) ? "+]: " : "]: ");
+    sa << "hash " << q->hash << ": ";
+    if (q->frags && q->frags->has_network_header()) {
+	const click_ip *iph = q->frags->ip_header();
+	sa << iph->ip_src << " > " << iph->ip_dst << " [" << ntohs(iph->ip_id) << ':' << q->have << (q->len ? "]: " : "+]: ");
     }
     sa << format;
     errh->xmessage(ErrorHandler::e_error, sa.c_str(), val);
@@ -103,42 +168,41 @@ IPReassembler::check(ErrorHandler *errh)
 {
     if (!errh)
 	errh = ErrorHandler::default_handler();
-    uint32_t mem_used = 0;
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = _map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (q->has_network_header()) {
-		const click_ip *qip = q->ip_header();
-		if (bucketno(qip) != b)
-		    check_error(errh, b, q, "in wrong bucket");
-		mem_used += IPH_MEM_USED + q->transport_length();
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		int off = 0;
-#if VERBOSE_DEBUG
-		check_error(errh, b, q, "");
-		StringAccum sa;
-		while (chunk && (!off || off < q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
+    for (int i = 0; i < _nshards; ++i) {
+	Shard &s = _shards[i];
+	s.lock.acquire();
+	uint32_t mem_used = 0, nqueues = 0;
+	for (uint32_t b = 0; b <= s.mask; ++b)
+	    for (Queue *q = s.buckets[b]; q; q = q->hnext) {
+		++nqueues;
+		if ((q->hash & s.mask) != b || &shard(q->hash) != &s)
+		    check_error(errh, q, "in wrong bucket");
+		if (!q->frags) {
+		    check_error(errh, q, "no fragments");
+		    continue;
 		}
-		errh->message("  %s", sa.c_str());
-		chunk = &PACKET_CHUNK(q);
-		off = 0;
-#endif
-		while (chunk) {
-		    if (chunk->off >= chunk->lastoff
-			|| chunk->lastoff > q->transport_length()
-			|| (off != 0 && chunk->off < off + 8)) {
-			check_error(errh, b, q, "bad chunk (%d, %d) at %d", chunk->off, chunk->lastoff, off);
-			break;
-		    }
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
+		uint32_t have = 0, mem = 0;
+		int off = 0;
+		for (Packet *x = q->frags; x; x = x->next()) {
+		    const ChunkLink &chunk = PACKET_CHUNK(x);
+		    if (chunk.off >= chunk.lastoff || chunk.off < off
+			|| (q->len && chunk.lastoff > q->len)
+			|| !same_segment(x->ip_header(), q->frags->ip_header()))
+			check_error(errh, q, "bad chunk (%d, %d) at %d", chunk.off, chunk.lastoff, off);
+		    off = chunk.lastoff;
+		    have += chunk.lastoff - chunk.off;
+		    mem += IPH_MEM_USED + chunk.lastoff - chunk.off;
 		}
-	    } else
-		errh->error("buck %d: missing IP header", b);
-    if (mem_used != _mem_used)
-	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
+		if (have != q->have || mem != q->mem)
+		    check_error(errh, q, "bad length: have %u/%u, claim %u/%u", have, mem, q->have, q->mem);
+		mem_used += mem;
+	    }
+	if (mem_used != s.mem_used)
+	    errh->error("bad mem_used: have %u, claim %u", mem_used, s.mem_used);
+	if (nqueues != s.nqueues)
+	    errh->error("bad queue count: have %u, claim %u", nqueues, s.nqueues);
+	s.lock.release();
+    }
     return 0;
 }
 
@@ -147,123 +211,256 @@ IPReassembler::debug_dump(Element *e, void *)
 {
     IPReassembler *r = (IPReassembler *) e;
     r->check();
+    uint32_t stats[4] = {0, 0, 0, 0};
+    StringAccum data;
+    for (int i = 0; i < r->_nshards; ++i) {
+	Shard &s = r->_shards[i];
+	s.lock.acquire();
+	stats[0] += s.stat_frags_seen;
+	stats[1] += s.stat_good_assem;
+	stats[2] += s.stat_failed_assem;
+	stats[3] += s.stat_bad_pkts;
+	for (Queue *q = s.lru.lru_next; q != &s.lru; q = q->lru_next) {
+	    const click_ip *qip = q->frags->ip_header();
+	    if (IP_FIRSTFRAG(qip))
+		data << ' ' << IPFlowID(qip);
+	    else
+		data << ' ' << IPFlowID(IPAddress(qip->ip_src), 0, IPAddress(qip->ip_dst), 0);
+	    data << ' ' << ntohs(qip->ip_id);
+	    for (Packet *x = q->frags; x; x = x->next())
+		data << " (" << PACKET_CHUNK(x).off << ',' << PACKET_CHUNK(x).lastoff << ')';
+	    data << '\n';
+	}
+	s.lock.release();
+    }
     StringAccum sa;
     sa <<
-	"frags seen total:    " << r->_stat_frags_seen << "\n"
-	"good reassemblies:   " << r->_stat_good_assem << "\n"
-	"failed reassemblies: " << r->_stat_failed_assem << "\n"
-	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
-	"cached chunk data:\n";
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = r->_map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (const click_ip *qip = q->ip_header()) {
-		sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		int off = 0;
-		while (chunk &&
-		       (chunk->lastoff > chunk->off) &&
-		       (chunk->lastoff <= q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    off = chunk->lastoff;
-		    chunk = next_chunk(q, chunk);
-		}
-		sa << '\n';
-	    }
-    return sa.take_string();;
+	"frags seen total:    " << stats[0] << "\n"
+	"good reassemblies:   " << stats[1] << "\n"
+	"failed reassemblies: " << stats[2] << "\n"
+	"bad fragments seen:  " << stats[3] << "\n"
+	"cached chunk data:\n" << data;
+    return sa.take_string();
 }
 
-WritablePacket *
-IPReassembler::find_queue(Packet *p, WritablePacket ***store_pprev)
+IPReassembler::Queue *
+IPReassembler::find_queue(Shard &s, const click_ip *iph, uint32_t hash)
 {
-    const click_ip *iph = p->ip_header();
-    int bucket = bucketno(iph);
-    WritablePacket **pprev = &_map[bucket];
-    WritablePacket *q;
-    for (q = *pprev; q; pprev = (WritablePacket **)&q->next(), q = *pprev) {
-	const click_ip *qiph = q->ip_header();
-	if (same_segment(iph, qiph)) {
-	    *store_pprev = pprev;
+    for (Queue *q = s.buckets[hash & s.mask]; q; q = q->hnext)
+	if (q->hash == hash && same_segment(iph, q->frags->ip_header()))
 	    return q;
-	}
-    }
-    *store_pprev = &_map[bucket];
     return 0;
 }
 
-Packet *
-IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
-				 Packet *p_in)
+IPReassembler::Queue *
+IPReassembler::make_queue(Shard &s, const click_ip *, uint32_t hash)
 {
-    ++_stat_good_assem;
-    *q_pprev = (WritablePacket *)q->next();
-
-    click_ip *q_iph = q->ip_header();
-    q_iph->ip_len = htons(q->network_length());
-    q_iph->ip_sum = 0;
-    q_iph->ip_sum = click_in_cksum((const unsigned char *)q_iph, q_iph->ip_hl << 2);
+    Queue *q = new Queue;
+    if (!q)
+	return 0;
+    q->frags = 0;
+    q->hash = hash;
+    q->have = q->len = q->mem = 0;
+    q->active = 0;
+    q->mtu = 0;
+    Queue *&bucket = s.buckets[hash & s.mask];
+    q->hnext = bucket;
+    bucket = q;
+    lru_push(s, q);
+    if (++s.nqueues > s.mask)
+	grow(s);
+    return q;
+}
 
-    // zero out the annotations we used
-    memset(&PACKET_CHUNK(q), 0, sizeof(ChunkLink));
-    q->set_timestamp_anno(p_in->timestamp_anno());
-    q->set_next(0);
+void
+IPReassembler::grow(Shard &s)
+{
+    uint32_t nmask = s.mask * 2 + 1;
+    Queue **nbuckets = new Queue *[nmask + 1];
+    if (!nbuckets)
+	return;
+    memset(nbuckets, 0, sizeof(Queue *) * (nmask + 1));
+    for (uint32_t b = 0; b <= s.mask; ++b)
+	while (Queue *q = s.buckets[b]) {
+	    s.buckets[b] = q->hnext;
+	    q->hnext = nbuckets[q->hash & nmask];
+	    nbuckets[q->hash & nmask] = q;
+	}
+    delete[] s.buckets;
+    s.buckets = nbuckets;
+    s.mask = nmask;
+}
 
-    p_in->kill();
-    _mem_used -= IPH_MEM_USED + q->transport_length();
-    return q;
+void
+IPReassembler::unlink_queue(Shard &s, Queue *q)
+{
+    Queue **pprev = &s.buckets[q->hash & s.mask];
+    while (*pprev != q)
+	pprev = &(*pprev)->hnext;
+    *pprev = q->hnext;
+    lru_remove(q);
+    --s.nqueues;
+    s.mem_used -= q->mem;
 }
 
 void
-IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
+IPReassembler::kill_queue(Queue *q)
 {
-    int p_off = IP_BYTE_OFF(p->ip_header());
-    int p_lastoff = p_off + PACKET_DLEN(p);
-    WritablePacket *q;
+    while (Packet *x = q->frags) {
+	q->frags = x->next();
+	x->kill();
+    }
+    delete q;
+}
 
-    if (p_off == 0) {
-	q = p->uniqueify();
-	if (!q) {
-	    click_chatter("out of memory");
-	    return;
-	}
-    } else {
-	q = Packet::make(p->headroom() + p->ip_header_offset(), 0, 20 + p_lastoff, 0);
-	if (!q) {
+bool
+IPReassembler::add_fragment(Queue *q, Packet *p, int p_off, int p_lastoff,
+			    bool last)
+{
+    // error if the fragment lies past the end, or if two fragments disagree
+    // about where the end is
+    if (q->len && (uint32_t) p_lastoff > q->len) {
+	p->kill();
+	return false;
+    }
+    if (last && !q->len) {
+	Packet *tail = q->frags;
+	while (tail && tail->next())
+	    tail = tail->next();
+	if (tail && PACKET_CHUNK(tail).lastoff > p_lastoff) {
 	    p->kill();
-	    click_chatter("out of memory");
-	    return;
+	    return false;
 	}
-	q->set_ip_header((click_ip *)q->data(), 20);
-	memcpy(q->ip_header(), p->ip_header(), 20);
-	// copy data
-	memcpy(q->transport_header() + p_off, p->transport_header(), PACKET_DLEN(p));
+	q->len = p_lastoff;
+    } else if (last && q->len != (uint32_t) p_lastoff) {
 	p->kill();
+	return false;
     }
 
-    _mem_used += IPH_MEM_USED + p_lastoff;
+    if (q->mtu < p->network_length())
+	q->mtu = p->network_length();
+
+    // Insert p's data into the gaps between the pieces already held.  Older
+    // data wins any overlap.  A fragment that spans several gaps is split
+    // into clones, which share its data.
+    Packet **pprev = &q->frags;
+    int a = p_off;
+    while (p && a < p_lastoff) {
+	Packet *x = *pprev;
+	if (x && PACKET_CHUNK(x).lastoff <= a) {
+	    pprev = &x->next();
+	    continue;
+	}
+	if (x && PACKET_CHUNK(x).off <= a) {
+	    a = PACKET_CHUNK(x).lastoff;
+	    pprev = &x->next();
+	    continue;
+	}
+	int b = (x && PACKET_CHUNK(x).off < p_lastoff ? PACKET_CHUNK(x).off : p_lastoff);
+	Packet *piece;
+	if (b == p_lastoff) {
+	    piece = p;
+	    p = 0;
+	} else if (!(piece = p->clone()))
+	    break;
+	PACKET_CHUNK(piece).off = a;
+	PACKET_CHUNK(piece).lastoff = b;
+	piece->set_next(x);
+	*pprev = piece;
+	pprev = &piece->next();
+	q->have += b - a;
+	q->mem += IPH_MEM_USED + b - a;
+	a = b;
+    }
+    if (p)			// remaining data duplicated older fragments
+	p->kill();
+    return true;
+}
 
-    click_ip *q_iph = q->ip_header();
-    q_iph->ip_off = (q_iph->ip_off & ~htons(IP_OFFMASK)); // leave MF, DF, RF
+Packet *
+IPReassembler::assemble(Queue *q, bool complete)
+{
+    Packet *first = q->frags;
+    Packet *rest;
+    uint32_t len = q->len;
+    if (!complete) {
+	Packet *tail = first;
+	while (tail->next())
+	    tail = tail->next();
+	len = PACKET_CHUNK(tail).lastoff;
+    }
+    q->frags = 0;
+
+    WritablePacket *w;
+    uint32_t pos;
+    if (PACKET_CHUNK(first).off == 0) {
+	// Build the datagram in the offset-0 fragment's buffer, keeping its
+	// MAC and IP headers and annotations.
+	rest = first->next();
+	first->set_next(0);
+	pos = PACKET_CHUNK(first).lastoff;
+	if ((w = first->uniqueify())) {
+	    int extra = len - w->transport_length();
+	    if (extra > 0)
+		w = w->put(extra);
+	    else if (extra < 0)
+		w->take(-extra);
+	}
+    } else {
+	rest = first;
+	pos = 0;
+	if ((w = Packet::make(first->headroom() + first->ip_header_offset(), 0, 20 + len, 0))) {
+	    w->copy_annotations(first);
+	    w->set_ip_header((click_ip *) w->data(), 20);
+	    memcpy(w->ip_header(), first->ip_header(), 20);
+	    w->ip_header()->ip_hl = 5;
+	}
+    }
 
-    if (_mtu_anno >= 0)
-	q->set_anno_u16(_mtu_anno, p->network_length());
+    while (Packet *x = rest) {
+	rest = x->next();
+	if (w) {
+	    const ChunkLink &chunk = PACKET_CHUNK(x);
+	    if (chunk.off > pos)
+		memset(w->transport_header() + pos, 0, chunk.off - pos);
+	    memcpy(w->transport_header() + chunk.off,
+		   x->transport_header() + chunk.off - IP_BYTE_OFF(x->ip_header()),
+		   chunk.lastoff - chunk.off);
+	    pos = chunk.lastoff;
+	}
+	x->kill();
+    }
+    if (!w) {
+	click_chatter("out of memory");
+	delete q;
+	return 0;
+    }
 
-    PACKET_CHUNK(q).off = p_off;
-    PACKET_CHUNK(q).lastoff = p_lastoff;
+    click_ip *iph = w->ip_header();
+    iph->ip_off &= htons(IP_DF | IP_RF);
+    if (!q->len)
+	iph->ip_off |= htons(IP_MF);
+    iph->ip_len = htons(w->network_length() > 0xFFFF ? 0xFFFF : w->network_length());
+    iph->ip_sum = 0;
+    iph->ip_sum = click_in_cksum((const unsigned char *) iph, iph->ip_hl << 2);
 
-    // link it up
-    q->set_next(*q_pprev);
-    *q_pprev = q;
+    // zero out the annotations we used
+    memset(&PACKET_CHUNK(w), 0, sizeof(ChunkLink));
+    w->set_next(0);
+    if (_mtu_anno >= 0)
+	w->set_anno_u16(_mtu_anno, q->mtu);
 
-    check();
+    delete q;
+    return w;
 }
 
-IPReassembler::ChunkLink *
-IPReassembler::next_chunk(WritablePacket *q, ChunkLink *chunk)
+void
+IPReassembler::emit_failed(Queue *q)
 {
-    if (chunk->lastoff >= q->transport_length())
-	return 0;
-    else
-	return (ChunkLink *)(q->transport_header() + chunk->lastoff);
+    if (noutputs() < 2)
+	kill_queue(q);
+    else if (Packet *p = assemble(q, false))
+	output(1).push(p);
 }
 
 Packet *
@@ -275,199 +472,118 @@ IPReassembler::simple_action(Packet *p)
     if (!IP_ISFRAG(iph))
 	return p;
 
-    ++_stat_frags_seen;
-
-    // reap if necessary
     int now = p->timestamp_anno().sec();
     if (!now) {
 	p->timestamp_anno().assign_now();
 	now = p->timestamp_anno().sec();
     }
-    if (now >= _reap_time)
-	reap(now);
+    Timestamp ts = p->timestamp_anno();
 
     // calculate packet edges
     int p_off = IP_BYTE_OFF(iph);
     int p_lastoff = p_off + ntohs(iph->ip_len) - (iph->ip_hl << 2);
+    bool last = !(iph->ip_off & htons(IP_MF));
+
+    uint32_t hash = key_hash(iph);
+    Shard &s = shard(hash);
+    Queue *evicted = 0, *done = 0;
+    s.lock.acquire();
+    ++s.stat_frags_seen;
+
+    // reap if necessary
+    if (now >= s.reap_time)
+	reap(s, now, evicted);
 
     // check uncommon, but annoying, case: bad length, bad length + offset,
     // or middle fragment length not a multiple of 8 bytes
     if (p_lastoff > 0xFFFF || p_lastoff <= p_off
-	|| ((p_lastoff & 7) != 0 && (iph->ip_off & htons(IP_MF)) != 0)
+	|| ((p_lastoff & 7) != 0 && !last)
 	|| PACKET_DLEN(p) < p_lastoff - p_off) {
+	++s.stat_bad_pkts;
 	p->kill();
-	++_stat_bad_pkts;
-	return 0;
-    }
-    p->take(PACKET_DLEN(p) - (p_lastoff - p_off));
-
-    // otherwise, we need to keep the packet
-
-    // clean up memory if necessary
-    if (_mem_used > _mem_high_thresh)
-	reap_overfull(now);
-
-    // get its Packet queue
-    WritablePacket **q_pprev;
-    WritablePacket *q = find_queue(p, &q_pprev);
-    if (!q) {			// make a new queue
-	make_queue(p, q_pprev);
-	return 0;
-    }
-    WritablePacket *q_bucket_next = (WritablePacket *)(q->next());
+    } else {
+	p->take(PACKET_DLEN(p) - (p_lastoff - p_off));
 
-    if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
-	q->set_anno_u16(_mtu_anno, p->network_length());
+	// clean up memory if necessary
+	if (s.mem_used > _mem_high_thresh)
+	    reap_overfull(s, _mem_low_thresh, evicted);
+	else if (memory_exceeded())
+	    reap_overfull(s, s.mem_used - s.mem_used / 4, evicted);
 
-    // extend the packet if necessary
-    if (p_lastoff > q->transport_length()) {
-	// error if packet already completed
-	if (!(q->ip_header()->ip_off & htons(IP_MF))) {
-	    p->kill();
-	    return 0;
-	}
-	// Figure out how much space to request. Add 8 extra bytes to ensure
-	// room for a ChunkLink, and request extra space if this packet has MF
-	// set. XXX This algorithm could result in a number of intermediate
-	// packet copies linear in the final packet length.
-	int old_transport_length = q->transport_length();
-	assert((old_transport_length & 7) == 0);
-	int want_space = p_lastoff - old_transport_length + 8;
-	if (iph->ip_off & htons(IP_MF))
-	    want_space += (p_lastoff - p_off);
-	// request space
-	if (!(q = q->put(want_space))) {
+	Queue *q = find_queue(s, iph, hash);
+	if (!q && !(q = make_queue(s, iph, hash))) {
 	    click_chatter("out of memory");
-	    *q_pprev = q_bucket_next;
-	    _mem_used -= IPH_MEM_USED + old_transport_length;
 	    p->kill();
-	    return 0;
-	}
-	// get rid of extra space
-	q->take(q->transport_length() - p_lastoff);
-	// hook up packet, and add final chunk
-	*q_pprev = q;
-	ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
-	last_chunk->off = last_chunk->lastoff = p_lastoff;
-	_mem_used += p_lastoff - old_transport_length;
-    }
-
-    // find chunks before and after p
-    ChunkLink *chunk = &PACKET_CHUNK(q);
-    while (chunk->lastoff < p_off)
-	chunk = next_chunk(q, chunk);
-    ChunkLink *last = chunk;
-    while (last && last->lastoff < p_lastoff)
-	last = next_chunk(q, last);
-
-    // patch chunks
-    assert(chunk && last);
-    if (p_lastoff < last->off) {
-	ChunkLink *new_chunk = (ChunkLink *)(q->transport_header() + p_lastoff);
-	*new_chunk = *last;
-	chunk->lastoff = p_lastoff;
-    } else
-	chunk->lastoff = last->lastoff;
-    if (p_off < chunk->off)
-	chunk->off = p_off;
-
-    // copy p's data into q
-    memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
-
-    // copy p's annotations and IP header if it is the first packet
-    if (p_off == 0) {
-	uint16_t old_ip_off = q->ip_header()->ip_off;
-	int header_delta = p->ip_header_offset() - q->ip_header_offset();
-	if (header_delta > 0)
-	    q = q->push(header_delta);
-	else if (header_delta < 0)
-	    q->pull(-header_delta);
-	q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
-        if (p->has_mac_header())
-	    q->set_mac_header((q->data() + p->mac_header_offset()), p->mac_header_length());
-	memcpy(q->data(), p->data(), p->ip_header_offset() + p->ip_header_length());
-	q->ip_header()->ip_off = old_ip_off;
-	ChunkLink old_chunk = PACKET_CHUNK(q);
-	if (_mtu_anno >= 0) {
-	    uint16_t old_mtu = q->anno_u16(_mtu_anno);
-	    q->copy_annotations(p);
-	    q->set_anno_u16(_mtu_anno, old_mtu);
 	} else {
-	    q->copy_annotations(p);
+	    uint32_t old_mem = q->mem;
+	    if (!add_fragment(q, p, p_off, p_lastoff, last))
+		++s.stat_bad_pkts;
+	    s.mem_used += q->mem - old_mem;
+	    if (!q->frags) {
+		unlink_queue(s, q);
+		delete q;
+	    } else if (q->len && q->have == q->len) {
+		unlink_queue(s, q);
+		++s.stat_good_assem;
+		done = q;
+	    } else if (s.lru.lru_next != q) {
+		lru_remove(q);
+		lru_push(s, q);
+	    }
+	    if (!done && q->frags)
+		q->active = now;
 	}
-	PACKET_CHUNK(q) = old_chunk;
     }
+    s.lock.release();
 
-    // clear MF if incoming packet has it cleared
-    if (!(iph->ip_off & htons(IP_MF)))
-	q->ip_header()->ip_off &= ~htons(IP_MF);
-
-    // Are we done with this packet?
-    if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
-	&& PACKET_CHUNK(q).off == 0
-	&& PACKET_CHUNK(q).lastoff == q->transport_length())
-	return emit_whole_packet(q, q_pprev, p);
-
-    // Otherwise, done for now
-    //check();
-    p->kill();
+    // Finish outside the lock: removed datagrams belong to this thread.
+    while (Queue *q = evicted) {
+	evicted = q->hnext;
+	emit_failed(q);
+    }
+    if (done && (p = assemble(done, true))) {
+	p->set_timestamp_anno(ts);
+	return p;
+    }
     return 0;
 }
 
 void
-IPReassembler::reap_overfull(int now)
+IPReassembler::reap_overfull(Shard &s, uint32_t low_thresh, Queue *&evicted)
 {
-    check();
-
-    // First throw away fragments at least 10 seconds old, then at least 5
-    // seconds old, then any fragments.
-    for (int delta = 10; delta >= 0; delta -= 5)
-	for (int bucket = 0; bucket < NMAP; bucket++) {
-	    WritablePacket **pprev = &_map[bucket];
-	    for (WritablePacket *q = *pprev; q; q = *pprev)
-		if (!delta || q->timestamp_anno().sec() < now - delta) {
-		    *pprev = (WritablePacket *)q->next();
-		    _mem_used -= IPH_MEM_USED + q->transport_length();
-		    q->set_next(0);
-		    checked_output_push(1, q);
-		    ++_stat_failed_assem;
-		    if (_mem_used <= _mem_low_thresh)
-			return;
-		} else
-		    pprev = (WritablePacket **)&q->next();
-	}
-
-    click_chatter("IPReassembler: cannot free enough memory!");
+    // Throw away the least recently active datagrams first.
+    while (s.mem_used > low_thresh && s.lru.lru_prev != &s.lru) {
+	Queue *q = s.lru.lru_prev;
+	unlink_queue(s, q);
+	q->hnext = evicted;
+	evicted = q;
+	++s.stat_failed_assem;
+    }
+    if (s.mem_used > low_thresh)
+	click_chatter("IPReassembler: cannot free enough memory!");
 }
 
 void
-IPReassembler::reap(int now)
+IPReassembler::reap(Shard &s, int now, Queue *&evicted)
 {
-    // look at all queues. If no activity for 30 seconds, kill that queue
-
+    // If no activity for 30 seconds, kill a datagram.  The activity list is
+    // oldest-last, so the scan stops at the first live datagram.
     int kill_time = now - REAP_TIMEOUT;
-
-    for (int i = 0; i < NMAP; i++) {
-	WritablePacket **q_pprev = &_map[i];
-	for (WritablePacket *q = *q_pprev; q; ) {
-	    if (q->timestamp_anno().sec() < kill_time) {
-		*q_pprev = (WritablePacket *)q->next();
-		q->set_next(0);
-		_mem_used -= IPH_MEM_USED + q->transport_length();
-		checked_output_push(1, q);
-	    } else
-		q_pprev = (WritablePacket **)&q->next();
-	    q = *q_pprev;
-	}
+    while (s.lru.lru_prev != &s.lru && s.lru.lru_prev->active < kill_time) {
+	Queue *q = s.lru.lru_prev;
+	unlink_queue(s, q);
+	q->hnext = evicted;
+	evicted = q;
+	++s.stat_failed_assem;
     }
-
-    _reap_time = now + REAP_INTERVAL;
+    s.reap_time = now + REAP_INTERVAL;
 }
 
 void
 IPReassembler::add_handlers()
 {
     add_read_handler("dump", debug_dump);
+    add_memory_limit_handler();
 }
 
 CLICK_ENDDECLS
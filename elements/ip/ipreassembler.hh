@@ -5,6 +5,7 @@
 #include <click/glue.hh>
 #include <clicknet/ip.h>
 #include <click/timer.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 
 /*
@@ -26,9 +27,17 @@ seconds, the fragments are generally dropped. If IPReassembler has two
 outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
+IPReassembler keeps the fragments of each datagram in a hash table keyed by
+IP source, destination, protocol, and ID.  Each fragment's packet is held as
+it arrived, without copying, in a list sorted by offset; the datagram is
+copied together once, when it is complete.  Overlapping data is resolved in
+favor of the fragment that arrived first.
+
 IPReassembler's memory usage is bounded. When memory consumption rises above
-HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+HIMEM bytes, IPReassembler throws away the least recently active datagrams
+until memory consumption drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+Dormant datagrams and memory evictions are both found in constant time per
+datagram, however many datagrams are in progress.
 
 Output packets have the same MAC header as the fragment that contains
 offset 0.  Other than that, input MAC headers are ignored.
@@ -51,6 +60,15 @@ Optional. A 2 byte annotation that will be filled with the maximum size of any
 one fragment of this packet. If no reassembly is required, then the annotation
 is unchanged.
 
+=item SHARDS I<n>
+
+Integer. Split the fragment table into I<n> shards, each with its own hash
+table, activity list, memory budget, and lock, so that several threads can
+push fragments into one IPReassembler with little contention. A datagram's
+shard is chosen by the hash of its key, so its fragments may arrive on any
+thread. HIMEM is divided evenly among the shards. Typically I<n> is the
+number of threads that push packets into the element. Default is 1.
+
 =back
 
 =n
@@ -60,6 +78,19 @@ second output.
 
 IPReassembler destroys its input packets' "next packet" annotations.
 
+=h dump read-only
+
+Returns reassembly statistics, followed by one line per datagram in
+progress giving its flow, IP ID, and the byte ranges received so far.
+
+=h memory_limit read/write
+
+Returns or sets a soft limit, in bytes, on the C<memory> handler's value,
+which counts held fragments and the hash tables; 0, the default, means no
+limit. While the total is over the limit, each fragment that arrives evicts
+the least recently active datagrams from its shard until that shard's
+fragment memory has dropped by a quarter. HIMEM still applies per shard.
+
 =a IPFragmenter */
 
 class IPReassembler : public Element { public:
@@ -68,12 +99,14 @@ class IPReassembler : public Element { public:
     ~IPReassembler();
 
     const char *class_name() const	{ return "IPReassembler"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1X2; }
     const char *processing() const	{ return PROCESSING_A_AH; }
 
     int configure(Vector<String> &, ErrorHandler *);
     int initialize(ErrorHandler *);
     void cleanup(CleanupStage);
+    size_t memory_usage() const;
 
     int check(ErrorHandler * = 0);
 
@@ -92,42 +125,72 @@ class IPReassembler : public Element { public:
 	   REAP_INTERVAL = 10, // seconds
 	   IPH_MEM_USED = 40 };
 
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
+    // One datagram being reassembled.  Its fragments are kept in
+    // nonoverlapping pieces, sorted by offset and linked through next(); each
+    // piece's PACKET_CHUNK annotation holds its byte range.
+    struct Queue {
+	Queue *hnext;		// hash chain
+	Queue *lru_prev;	// activity list, most recent first
+	Queue *lru_next;
+	Packet *frags;
+	uint32_t hash;
+	uint32_t have;		// bytes received
+	uint32_t len;		// total length; 0 until the last fragment
+	uint32_t mem;
+	int active;		// second of last activity
+	uint16_t mtu;
+    };
 
-    int _reap_time;
+    struct Shard {
+	SimpleSpinlock lock;
+	Queue **buckets;
+	uint32_t mask;
+	uint32_t nqueues;
+	Queue lru;		// activity list sentinel
+	uint32_t mem_used;
+	int reap_time;
+	uint32_t stat_frags_seen;
+	uint32_t stat_good_assem;
+	uint32_t stat_failed_assem;
+	uint32_t stat_bad_pkts;
+	Shard()
+	    : buckets(0), mask(0), nqueues(0), mem_used(0), reap_time(0),
+	      stat_frags_seen(0), stat_good_assem(0), stat_failed_assem(0),
+	      stat_bad_pkts(0) {
+	    lru.lru_prev = lru.lru_next = &lru;
+	}
+    };
 
-    uint32_t _stat_frags_seen;
-    uint32_t _stat_good_assem;
-    uint32_t _stat_failed_assem;
-    uint32_t _stat_bad_pkts;
+    Shard *_shards;
+    int _nshards;
+    uint32_t _seed;
 
-    uint32_t _mem_used;
-    uint32_t _mem_high_thresh;	// defaults to 256K
+    uint32_t _mem_high_thresh;	// per shard; defaults to 256K
     uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
     int8_t _mtu_anno;
 
-    static inline int bucketno(const click_ip *);
+    inline uint32_t key_hash(const click_ip *) const;
+    inline Shard &shard(uint32_t hash) const;
     static inline bool same_segment(const click_ip *, const click_ip *);
     static String debug_dump(Element *e, void *);
 
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
-    static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
-    void reap_overfull(int);
-    void reap(int);
-    static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
+    Queue *find_queue(Shard &, const click_ip *, uint32_t);
+    Queue *make_queue(Shard &, const click_ip *, uint32_t);
+    void grow(Shard &);
+    static inline void lru_remove(Queue *);
+    static inline void lru_push(Shard &, Queue *);
+    void unlink_queue(Shard &, Queue *);
+    bool add_fragment(Queue *, Packet *, int, int, bool);
+    Packet *assemble(Queue *, bool complete);
+    static void kill_queue(Queue *);
+    void reap_overfull(Shard &, uint32_t, Queue *&);
+    void reap(Shard &, int, Queue *&);
+    void emit_failed(Queue *);
+    static void check_error(ErrorHandler *, const Queue *, const char *, ...);
 
 };
 
 
-inline int
-IPReassembler::bucketno(const click_ip *h)
-{
-    return (h->ip_id % NMAP);
-}
-
 inline bool
 IPReassembler::same_segment(const click_ip *h, const click_ip *h2)
 {
@@ -33,6 +33,13 @@
 #include <click/error.hh>
 #include <click/algorithm.hh>
 #include <click/heap.hh>
+#include <click/hashallocator.hh>
+
+#if CLICK_USERLEVEL
+# include <click/userutils.hh>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 #ifdef CLICK_LINUXMODULE
 #include <click/cxxprotect.h>
@@ -68,7 +75,8 @@ IPMapper::rewrite_flowid(IPRewriterInput *, const IPFlowID &, IPFlowID &,
 //
 
 IPRewriterBase::IPRewriterBase()
-    : _map(0), _heap(new IPRewriterHeap), _gc_timer(gc_timer_hook, this)
+    : _map(0), _heap(new IPRewriterHeap), _timing_wheel(false),
+      _gc_timer(gc_timer_hook, this), _nshards(1), _shards(0)
 {
     _timeouts[0] = default_timeout;
     _timeouts[1] = default_guarantee;
@@ -79,6 +87,12 @@ IPRewriterBase::~IPRewriterBase()
 {
     if (_heap)
 	_heap->unuse();
+    for (int s = 0; _shards && s < _nshards; ++s) {
+	_shards[s].heap->unuse();
+	for (int pool = 0; pool < npools; ++pool)
+	    delete _shards[s].allocator[pool];
+    }
+    delete[] _shards;
 }
 
 
@@ -150,6 +164,7 @@ int
 IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     String capacity_word;
+    bool own_heap = true;
 
     if (Args(this, errh).bind(conf)
 	.read("CAPACITY", AnyArg(), capacity_word)
@@ -158,6 +173,8 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("GUARANTEE", SecondsArg(), _timeouts[1])
 	.read("REAP_INTERVAL", SecondsArg(), _gc_interval_sec)
 	.read("REAP_TIME", Args::deprecated, SecondsArg(), _gc_interval_sec)
+	.read("TIMING_WHEEL", _timing_wheel)
+	.read("HASH", FlowHashArg(), _hash)
 	.consume() < 0)
 	return -1;
 
@@ -171,9 +188,13 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	    rwb->_heap->use();
 	    _heap->unuse();
 	    _heap = rwb->_heap;
+	    own_heap = false;
 	} else
 	    return errh->error("bad MAPPING_CAPACITY");
     }
+    // A shared heap's mode is set by its owner and checked in initialize().
+    if (_timing_wheel && own_heap)
+	_heap->set_timing_wheel();
 
     if (conf.size() != ninputs())
 	return errh->error("need %d arguments, one per input port", ninputs());
@@ -187,7 +208,37 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	    _input_specs.push_back(is);
     }
 
-    return _input_specs.size() == ninputs() ? 0 : -1;
+    if (_input_specs.size() != ninputs())
+	return -1;
+    return _nshards != 1 ? configure_shards(errh) : 0;
+}
+
+int
+IPRewriterBase::configure_shards(ErrorHandler *errh)
+{
+    if (_nshards < 1)
+	return errh->error("SHARDS must be positive");
+    else if (_heap->_use_count > 1)
+	return errh->error("SHARDS incompatible with shared MAPPING_CAPACITY");
+    _shards = new Shard[_nshards];
+    for (int s = 0; s < _nshards; ++s) {
+	_shards[s].heap = new IPRewriterHeap;
+	if (_timing_wheel)
+	    _shards[s].heap->set_timing_wheel();
+    }
+    set_shard_capacity();
+    return 0;
+}
+
+void
+IPRewriterBase::set_shard_capacity()
+{
+    // Divide the capacity evenly, leaving "unlimited" unlimited.
+    int32_t capacity = _heap->_capacity;
+    if (capacity != IPRewriterHeap().capacity())
+	capacity = (capacity + _nshards - 1) / _nshards;
+    for (int s = 0; s < _nshards; ++s)
+	_shards[s].heap->_capacity = capacity;
 }
 
 int
@@ -197,9 +248,22 @@ IPRewriterBase::initialize(ErrorHandler *errh)
 	PrefixErrorHandler cerrh(errh, "input spec " + String(i) + ": ");
 	if (_input_specs[i].reply_element->_heap != _heap)
 	    cerrh.error("reply element %<%s%> must share this MAPPING_CAPACITY", i, _input_specs[i].reply_element->name().c_str());
+	if (_shards && _input_specs[i].reply_element != this)
+	    cerrh.error("reply element %<%s%> not allowed with SHARDS", _input_specs[i].reply_element->name().c_str());
 	if (_input_specs[i].kind == IPRewriterInput::i_mapper)
 	    _input_specs[i].u.mapper->notify_rewriter(this, &_input_specs[i], &cerrh);
     }
+    if (_shards && _heap->_use_count > 1)
+	errh->error("SHARDS incompatible with shared MAPPING_CAPACITY");
+    if (_heap->timing_wheel() != _timing_wheel)
+	errh->error("TIMING_WHEEL must match the MAPPING_CAPACITY element");
+    for (int s = 0; _shards && s < _nshards; ++s)
+	_shards[s].input_specs = _input_specs;
+    // Every flow table, including subclasses' and shards', hashes by HASH.
+    int nmapids = IPRewriterInput::mapid_shard + (_shards ? 2 * _nshards : 0);
+    for (int mapid = 0; mapid < nmapids; ++mapid)
+	if (Map *map = get_map(mapid))
+	    map->hasher().set(_hash.method(), _hash.symmetric());
     _gc_timer.initialize(this);
     if (_gc_interval_sec)
 	_gc_timer.schedule_after_sec(_gc_interval_sec);
@@ -219,6 +283,21 @@ IPRewriterBase::cleanup(CleanupStage)
 IPRewriterEntry *
 IPRewriterBase::get_entry(int ip_p, const IPFlowID &flowid, int input)
 {
+    if (_shards) {
+	Shard &s = shard(flowid);
+	s.lock.acquire();
+	IPRewriterEntry *m = s.map[0].get(flowid);
+	if (m && ip_p && m->flow()->ip_p() && m->flow()->ip_p() != ip_p)
+	    m = 0;
+	else if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
+	    IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
+	    if (s.input_specs[input].rewrite_flowid(flowid, rewritten_flowid, 0, shard_mapid(s, 0)) == rw_addmap)
+		m = add_flow(ip_p, flowid, rewritten_flowid, input);
+	}
+	s.lock.release();
+	return m;
+    }
+
     IPRewriterEntry *m = _map.get(flowid);
     if (m && ip_p && m->flow()->ip_p() && m->flow()->ip_p() != ip_p)
 	return 0;
@@ -232,15 +311,25 @@ IPRewriterBase::get_entry(int ip_p, const IPFlowID &flowid, int input)
 }
 
 IPRewriterEntry *
-IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
-			   Map &map, Map *reply_map_ptr)
+IPRewriterBase::store_flow(IPRewriterFlow *flow, Map &map,
+			   Map *reply_map_ptr)
 {
-    IPRewriterBase *reply_element = _input_specs[input].reply_element;
+    IPRewriterInput &is = *flow->owner();
+    IPRewriterBase *reply_element = is.reply_element;
     if ((unsigned) flow->entry(false).output() >= (unsigned) noutputs()
 	|| (unsigned) flow->entry(true).output() >= (unsigned) reply_element->noutputs()) {
 	flow->owner()->owner->destroy_flow(flow);
 	return 0;
     }
+    // Both directions of a sharded flow must live in the same shard.  Only
+    // rewritten flow IDs that leave no choice, such as fixed patterns, fail.
+    if (_shards && flow_shard(flow->entry(true).flowid(), _nshards)
+		   != flow_shard(flow->entry(false).flowid(), _nshards)) {
+	flow->owner()->owner->destroy_flow(flow);
+	++is.failures;
+	return 0;
+    }
+    IPRewriterHeap *heap = heap_of(flow);
 
     IPRewriterEntry *old = map.set(&flow->entry(false));
     assert(!old);
@@ -250,26 +339,24 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
     old = reply_map_ptr->set(&flow->entry(true));
     if (unlikely(old)) {		// Assume every map has the same heap.
 	if (likely(old->flow() != flow))
-	    old->flow()->destroy(_heap);
+	    old->flow()->destroy(heap);
     }
 
-    Vector<IPRewriterFlow *> &myheap = _heap->_heaps[flow->guaranteed()];
-    myheap.push_back(flow);
-    push_heap(myheap.begin(), myheap.end(),
-	      IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
-    ++_input_specs[input].count;
+    heap->insert(flow);
+    ++is.count;
 
-    if (unlikely(_heap->size() > _heap->capacity())) {
+    if (unlikely(heap->size() > heap->capacity()) || unlikely(memory_exceeded())) {
 	// This may destroy the newly added mapping, if it has the lowest
 	// expiration time.  How can we tell?  If (1) flows are added to the
 	// heap one at a time, so the heap was formerly no bigger than the
 	// capacity, and (2) 'flow' expires in the future, then we will only
-	// destroy 'flow' if it's the top of the heap.
+	// destroy 'flow' if it's the top of the heap.  Over the memory
+	// limit, each new flow likewise replaces one old flow.
 	click_jiffies_t now_j = click_jiffies();
 	assert(click_jiffies_less(now_j, flow->expiry())
-	       && _heap->size() == _heap->capacity() + 1);
-	if (shrink_heap_for_new_flow(flow, now_j)) {
-	    ++_input_specs[input].failures;
+	       && heap->size() - 1 <= heap->capacity());
+	if (shrink_heap_for_new_flow(heap, flow, now_j)) {
+	    ++is.failures;
 	    return 0;
 	}
     }
@@ -281,50 +368,121 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
     return &flow->entry(false);
 }
 
+size_t
+IPRewriterBase::memory_usage() const
+{
+    // Takes no shard locks: store_flow() calls it with one held.  The
+    // result is an estimate while other threads add flows.
+    IPRewriterBase *rw = const_cast<IPRewriterBase *>(this);
+    size_t m = _map.bucket_count() * sizeof(IPRewriterEntry *);
+    Map *udp_map = rw->get_map(IPRewriterInput::mapid_iprewriter_udp);
+    if (udp_map && udp_map != &_map)
+	m += udp_map->bucket_count() * sizeof(IPRewriterEntry *);
+    if (_heap)
+	m += _heap->memory();
+    for (int s = 0; s < (_shards ? _nshards : 1); ++s) {
+	IPRewriterHeap *heap = _heap;
+	if (_shards) {
+	    const Shard &sh = _shards[s];
+	    m += (sh.map[0].bucket_count() + sh.map[1].bucket_count())
+		* sizeof(IPRewriterEntry *);
+	    if ((heap = sh.heap))
+		m += heap->memory();
+	}
+	// Count live flows, not pool buffers, which never shrink; otherwise
+	// a rewriter over its limit could never get back under it.
+	bool pooled = false;
+	for (int pool = 0; pool < npools; ++pool)
+	    if (HashAllocator *a = (_shards ? _shards[s].allocator[pool]
+				    : rw->pool_allocator(pool))) {
+		m += a->nallocated() * a->object_size();
+		pooled = true;
+	    }
+	if (!pooled && heap)
+	    m += heap->size() * sizeof(IPRewriterFlow);
+    }
+    return m;
+}
+
 void
-IPRewriterBase::shift_heap_best_effort(click_jiffies_t now_j)
+IPRewriterBase::shift_heap_best_effort(IPRewriterHeap *heap,
+				       click_jiffies_t now_j)
 {
     // Shift flows with expired guarantees to the best-effort heap.
-    Vector<IPRewriterFlow *> &guaranteed_heap = _heap->_heaps[1];
+    if (heap->timing_wheel()) {
+	Vector<IPRewriterFlow *> expired;
+	heap->expire(1, now_j, expired);
+	for (IPRewriterFlow **it = expired.begin(); it != expired.end(); ++it) {
+	    click_jiffies_t new_expiry = (*it)->owner()->owner->best_effort_expiry(*it);
+	    (*it)->change_expiry(heap, false, new_expiry);
+	}
+	return;
+    }
+    Vector<IPRewriterFlow *> &guaranteed_heap = heap->_heaps[1];
     while (guaranteed_heap.size() && guaranteed_heap[0]->expired(now_j)) {
 	IPRewriterFlow *mf = guaranteed_heap[0];
 	click_jiffies_t new_expiry = mf->owner()->owner->best_effort_expiry(mf);
-	mf->change_expiry(_heap, false, new_expiry);
+	mf->change_expiry(heap, false, new_expiry);
     }
 }
 
 bool
-IPRewriterBase::shrink_heap_for_new_flow(IPRewriterFlow *flow,
+IPRewriterBase::shrink_heap_for_new_flow(IPRewriterHeap *heap,
+					 IPRewriterFlow *flow,
 					 click_jiffies_t now_j)
 {
-    shift_heap_best_effort(now_j);
+    shift_heap_best_effort(heap, now_j);
     // At this point, all flows in the guarantee heap expire in the future.
     // So remove the next-to-expire best-effort flow, unless there are none.
     // In that case we always remove the current flow to honor previous
     // guarantees (= admission control).
     IPRewriterFlow *deadf;
-    if (_heap->_heaps[0].empty()) {
+    if (heap->empty(0)) {
 	assert(flow->guaranteed());
 	deadf = flow;
     } else
-	deadf = _heap->_heaps[0][0];
-    deadf->destroy(_heap);
+	deadf = heap->first(0);
+    deadf->destroy(heap);
     return deadf == flow;
 }
 
 void
-IPRewriterBase::shrink_heap(bool clear_all)
+IPRewriterBase::shrink_heap(IPRewriterHeap *heap, int32_t capacity)
 {
     click_jiffies_t now_j = click_jiffies();
-    shift_heap_best_effort(now_j);
-    Vector<IPRewriterFlow *> &best_effort_heap = _heap->_heaps[0];
-    while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
-	best_effort_heap[0]->destroy(_heap);
-
-    int32_t capacity = clear_all ? 0 : _heap->_capacity;
-    while (_heap->size() > capacity) {
-	IPRewriterFlow *deadf = _heap->_heaps[_heap->_heaps[0].empty()][0];
-	deadf->destroy(_heap);
+    shift_heap_best_effort(heap, now_j);
+    if (heap->timing_wheel()) {
+	Vector<IPRewriterFlow *> dead;
+	if (capacity == 0)
+	    heap->all_flows(dead);
+	else
+	    heap->expire(0, now_j, dead);
+	for (IPRewriterFlow **it = dead.begin(); it != dead.end(); ++it)
+	    (*it)->destroy(heap);
+    } else {
+	Vector<IPRewriterFlow *> &best_effort_heap = heap->_heaps[0];
+	while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
+	    best_effort_heap[0]->destroy(heap);
+    }
+
+    while (heap->size() > capacity) {
+	IPRewriterFlow *deadf = heap->first(heap->empty(0));
+	deadf->destroy(heap);
+    }
+}
+
+void
+IPRewriterBase::shrink_heap(bool clear_all)
+{
+    if (!_shards) {
+	shrink_heap(_heap, clear_all ? 0 : _heap->_capacity);
+	return;
+    }
+    for (int s = 0; s < _nshards; ++s) {
+	Shard &sh = _shards[s];
+	sh.lock.acquire();
+	shrink_heap(sh.heap, clear_all ? 0 : sh.heap->_capacity);
+	sh.lock.release();
     }
 }
 
@@ -337,6 +495,22 @@ IPRewriterBase::gc_timer_hook(Timer *t, void *user_data)
 	t->reschedule_after_sec(rw->_gc_interval_sec);
 }
 
+// Add to st the entries, buckets, nonempty buckets, longest chain length,
+// and total comparisons needed to find every entry, over map.
+static void
+accumulate_hash_stats(IPRewriterBase::Map &map, uint64_t st[5])
+{
+    st[0] += map.size();
+    st[1] += map.bucket_count();
+    for (size_t b = 0; b < map.bucket_count(); ++b)
+	if (uint64_t n = map.bucket_size(b)) {
+	    ++st[2];
+	    if (n > st[3])
+		st[3] = n;
+	    st[4] += n * (n + 1) / 2;
+	}
+}
+
 String
 IPRewriterBase::read_handler(Element *e, void *user_data)
 {
@@ -344,27 +518,98 @@ IPRewriterBase::read_handler(Element *e, void *user_data)
     intptr_t what = reinterpret_cast<intptr_t>(user_data);
     StringAccum sa;
 
+    // In sharded mode, statistics are summed over the shards.
+    Vector<uint32_t> counts(rw->_input_specs.size(), 0);
+    Vector<uint32_t> failures(rw->_input_specs.size(), 0);
+    size_t size = 0;
+    for (int s = 0; s < (rw->_shards ? rw->_nshards : 1); ++s) {
+	const Vector<IPRewriterInput> &specs = (rw->_shards ? rw->_shards[s].input_specs : rw->_input_specs);
+	for (int i = 0; i < specs.size(); ++i) {
+	    counts[i] += specs[i].count;
+	    failures[i] += specs[i].failures;
+	}
+	size += (rw->_shards ? rw->_shards[s].heap : rw->_heap)->size();
+    }
+
     switch (what) {
     case h_nmappings: {
 	uint32_t count = 0;
-	for (int i = 0; i < rw->_input_specs.size(); ++i)
-	    count += rw->_input_specs[i].count;
+	for (int i = 0; i < counts.size(); ++i)
+	    count += counts[i];
 	sa << count;
 	break;
     }
     case h_mapping_failures: {
 	uint32_t count = 0;
-	for (int i = 0; i < rw->_input_specs.size(); ++i)
-	    count += rw->_input_specs[i].failures;
+	for (int i = 0; i < failures.size(); ++i)
+	    count += failures[i];
 	sa << count;
 	break;
     }
     case h_size:
-	sa << rw->_heap->size();
+	sa << size;
 	break;
     case h_capacity:
 	sa << rw->_heap->_capacity;
 	break;
+    case h_shards:
+	for (int s = 0; rw->_shards && s < rw->_nshards; ++s)
+	    sa << s << ' ' << rw->_shards[s].heap->size() << '\n';
+	break;
+    case h_hash:
+	sa << rw->_hash.unparse();
+	break;
+    case h_checkpoint_data:
+	rw->save_checkpoint(sa, -1, ErrorHandler::default_handler());
+	break;
+    case h_hash_stats: {
+	uint64_t st[5] = { 0, 0, 0, 0, 0 };
+	for (int mapid = 0; !rw->_shards && mapid < IPRewriterInput::mapid_shard; ++mapid)
+	    if (Map *map = rw->get_map(mapid))
+		accumulate_hash_stats(*map, st);
+	for (int s = 0; rw->_shards && s < rw->_nshards; ++s) {
+	    rw->_shards[s].lock.acquire();
+	    for (int m = 0; m < 2; ++m)
+		accumulate_hash_stats(rw->_shards[s].map[m], st);
+	    rw->_shards[s].lock.release();
+	}
+	sa << "entries " << st[0] << '\n'
+	   << "buckets " << st[1] << '\n'
+	   << "nonempty_buckets " << st[2] << '\n'
+	   << "max_chain " << st[3] << '\n';
+	if (st[0]) {
+	    uint64_t x = (st[4] * 100 + st[0] / 2) / st[0];
+	    sa.snprintf(40, "mean_probes %u.%02u\n", (unsigned) (x / 100), (unsigned) (x % 100));
+	}
+	break;
+    }
+    case h_pools: {
+	// name, objects in use, free objects, buffer bytes
+	static const char * const names[] = { "flows", "udp_flows", "deltas" };
+	for (int pool = 0; pool < npools; ++pool) {
+	    size_t st[3] = { 0, 0, 0 };
+	    bool any = false;
+	    for (int s = 0; s < (rw->_shards ? rw->_nshards : 1); ++s) {
+		if (rw->_shards)
+		    rw->_shards[s].lock.acquire();
+		HashAllocator *a = (rw->_shards ? rw->_shards[s].allocator[pool]
+				    : rw->pool_allocator(pool));
+		if (a) {
+		    size_t n = a->nallocated();
+		    st[0] += n;
+		    st[1] += a->capacity() - n;
+		    st[2] += a->buffer_bytes();
+		    any = true;
+		}
+		if (rw->_shards)
+		    rw->_shards[s].lock.release();
+	    }
+	    if (any)
+		sa << names[pool] << ' ' << st[0] << ' ' << st[1]
+		   << ' ' << st[2] << '\n';
+	}
+	break;
+    }
     default:
 	for (int i = 0; i < rw->_input_specs.size(); ++i) {
 	    if (what != h_patterns && what != i)
@@ -386,8 +631,8 @@ IPRewriterBase::read_handler(Element *e, void *user_data)
 		sa << "<mapper>";
 		break;
 	    }
-	    if (rw->_input_specs[i].count)
-		sa << " [" << rw->_input_specs[i].count << ']';
+	    if (counts[i])
+		sa << " [" << counts[i] << ']';
 	    sa << '\n';
 	}
 	break;
@@ -405,12 +650,50 @@ IPRewriterBase::write_handler(const String &str, Element *e, void *user_data, Er
 	    .read_mp("CAPACITY", rw->_heap->_capacity)
 	    .complete() < 0)
 	    return -1;
+	if (rw->_shards)
+	    rw->set_shard_capacity();
 	rw->shrink_heap(false);
 	return 0;
     } else if (what == h_clear) {
 	rw->shrink_heap(true);
 	return 0;
-    } else
+    } else if (what == h_checkpoint_data)
+	return rw->load_checkpoint(str, errh) < 0 ? -1 : 0;
+#if CLICK_USERLEVEL
+    else if (what == h_checkpoint) {
+	// Write to a temporary file, then rename, so a crash mid-checkpoint
+	// leaves the previous checkpoint intact.
+	String filename;
+	if (Args(e, errh).push_back_words(str)
+	    .read_mp("FILENAME", FilenameArg(), filename)
+	    .complete() < 0)
+	    return -1;
+	String tmpname = filename + ".tmp";
+	int fd = open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+	    return errh->error("%s: %s", tmpname.c_str(), strerror(errno));
+	StringAccum sa;
+	int r = rw->save_checkpoint(sa, fd, errh);
+	if (close(fd) < 0 && r >= 0)
+	    r = errh->error("%s: %s", tmpname.c_str(), strerror(errno));
+	if (r >= 0 && rename(tmpname.c_str(), filename.c_str()) < 0)
+	    r = errh->error("%s: %s", filename.c_str(), strerror(errno));
+	if (r < 0)
+	    unlink(tmpname.c_str());
+	return r < 0 ? -1 : 0;
+    } else if (what == h_restore) {
+	String filename;
+	if (Args(e, errh).push_back_words(str)
+	    .read_mp("FILENAME", FilenameArg(), filename)
+	    .complete() < 0)
+	    return -1;
+	String data = file_string(filename, errh);
+	if (!data && errh->nerrors())
+	    return -1;
+	return rw->load_checkpoint(data, errh) < 0 ? -1 : 0;
+    }
+#endif
+    else
 	return -1;
 }
 
@@ -424,15 +707,14 @@ IPRewriterBase::pattern_write_handler(const String &str, Element *e, void *user_
     if (r >= 0) {
 	IPRewriterInput *spec = &rw->_input_specs[what];
 
-	// remove all existing flows created by this input
-	for (int which_heap = 0; which_heap < 2; ++which_heap) {
-	    Vector<IPRewriterFlow *> &myheap = rw->_heap->_heaps[which_heap];
-	    for (int i = myheap.size() - 1; i >= 0; --i)
-		if (myheap[i]->owner() == spec) {
-		    myheap[i]->destroy(rw->_heap);
-		    if (i < myheap.size())
-			++i;
-		}
+	if (!rw->_shards)
+	    rw->destroy_input_flows(rw->_heap, spec);
+	for (int s = 0; rw->_shards && s < rw->_nshards; ++s) {
+	    Shard &sh = rw->_shards[s];
+	    sh.lock.acquire();
+	    rw->destroy_input_flows(sh.heap, &sh.input_specs[what]);
+	    sh.input_specs[what] = is;
+	    sh.lock.release();
 	}
 
 	// change pattern
@@ -443,6 +725,18 @@ IPRewriterBase::pattern_write_handler(const String &str, Element *e, void *user_
     return 0;
 }
 
+void
+IPRewriterBase::destroy_input_flows(IPRewriterHeap *heap,
+				    IPRewriterInput *spec)
+{
+    // remove all existing flows created by this input
+    Vector<IPRewriterFlow *> flows;
+    heap->all_flows(flows);
+    for (IPRewriterFlow **it = flows.begin(); it != flows.end(); ++it)
+	if ((*it)->owner() == spec)
+	    (*it)->destroy(heap);
+}
+
 void
 IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
 {
@@ -453,6 +747,18 @@ IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
     add_read_handler("capacity", read_handler, h_capacity);
     add_write_handler("capacity", write_handler, h_capacity);
     add_write_handler("clear", write_handler, h_clear);
+    if (_shards)
+	add_read_handler("shards", read_handler, h_shards);
+    add_read_handler("hash", read_handler, h_hash);
+    add_read_handler("hash_stats", read_handler, h_hash_stats);
+    add_read_handler("pools", read_handler, h_pools);
+    add_memory_limit_handler();
+    add_read_handler("checkpoint_data", read_handler, h_checkpoint_data);
+    add_write_handler("checkpoint_data", write_handler, h_checkpoint_data, Handler::RAW);
+#if CLICK_USERLEVEL
+    add_write_handler("checkpoint", write_handler, h_checkpoint);
+    add_write_handler("restore", write_handler, h_restore);
+#endif
     for (int i = 0; i < ninputs(); ++i) {
 	String name = "pattern" + String(i);
 	add_read_handler(name, read_handler, i);
@@ -461,6 +767,231 @@ IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
     }
 }
 
+
+//
+// checkpoints
+//
+
+// A checkpoint is checkpoint_magic followed by one record per flow.  Each
+// record is in network byte order:
+//
+//   0	length of the rest of the record (2 bytes)
+//   2	IP protocol, flags (1 = guaranteed), TCP state flags, reply annotation
+//   6	input port (2 bytes)
+//   8	milliseconds until expiry (4 bytes)
+//  12	flow ID: source address, destination address, source port,
+//	destination port (12 bytes)
+//  24	rewritten flow ID (12 bytes)
+//  36	subclass state, from save_flow_state()
+//
+// Restore skips state it does not understand, using the length, so records
+// may grow.
+
+static const char checkpoint_magic[] = "ClickRW1";
+enum { checkpoint_magic_len = 8, checkpoint_fixed_len = 34,
+       checkpoint_chunk = 65536 };
+
+static inline void
+put16(unsigned char *x, uint16_t v)
+{
+    x[0] = v >> 8;
+    x[1] = v;
+}
+
+static inline void
+put32(unsigned char *x, uint32_t v)
+{
+    put16(x, v >> 16);
+    put16(x + 2, v);
+}
+
+static inline uint16_t
+get16(const unsigned char *x)
+{
+    return (x[0] << 8) | x[1];
+}
+
+static inline uint32_t
+get32(const unsigned char *x)
+{
+    return ((uint32_t) get16(x) << 16) | get16(x + 2);
+}
+
+static inline void
+put_flowid(unsigned char *x, const IPFlowID &flowid)
+{
+    uint32_t a[2] = { flowid.saddr().addr(), flowid.daddr().addr() };
+    uint16_t p[2] = { flowid.sport(), flowid.dport() };
+    memcpy(x, a, 8);
+    memcpy(x + 8, p, 4);
+}
+
+static inline IPFlowID
+get_flowid(const unsigned char *x)
+{
+    uint32_t a[2];
+    uint16_t p[2];
+    memcpy(a, x, 8);
+    memcpy(p, x + 8, 4);
+    return IPFlowID(IPAddress(a[0]), p[0], IPAddress(a[1]), p[1]);
+}
+
+void
+IPRewriterBase::save_flow_state(const IPRewriterFlow *, StringAccum &)
+{
+}
+
+bool
+IPRewriterBase::restore_flow_state(IPRewriterFlow *, const unsigned char *,
+				   int)
+{
+    return true;
+}
+
+void
+IPRewriterBase::save_flow(StringAccum &sa, const IPRewriterFlow *flow,
+			  click_jiffies_t now_j)
+{
+    int start = sa.length();
+    unsigned char *x = reinterpret_cast<unsigned char *>(sa.extend(2 + checkpoint_fixed_len));
+    x[2] = flow->ip_p();
+    x[3] = flow->guaranteed();
+    x[4] = flow->_tflags;
+    x[5] = flow->reply_anno();
+    put16(x + 6, flow->owner()->owner_input);
+    click_jiffies_difference_t left = flow->expiry() - now_j;
+    put32(x + 8, left > 0 ? (uint64_t) left * 1000 / CLICK_HZ : 0);
+    put_flowid(x + 12, flow->entry(false).flowid());
+    put_flowid(x + 24, flow->entry(false).rewritten_flowid());
+    save_flow_state(flow, sa);
+    put16(reinterpret_cast<unsigned char *>(sa.data()) + start,
+	  sa.length() - start - 2);
+}
+
+static int
+checkpoint_flush(StringAccum &sa, int fd, ErrorHandler *errh)
+{
+#if CLICK_USERLEVEL
+    const char *x = sa.data();
+    int left = sa.length();
+    while (left > 0) {
+	ssize_t w = ::write(fd, x, left);
+	if (w < 0 && errno != EINTR)
+	    return errh->error("%s", strerror(errno));
+	else if (w > 0)
+	    x += w, left -= w;
+    }
+    sa.clear();
+#else
+    (void) sa, (void) fd, (void) errh;
+#endif
+    return 0;
+}
+
+/** @brief Append a checkpoint of this element's flows to @a sa.
+ * @param fd if nonnegative, write the checkpoint to @a fd in chunks
+ *
+ * In sharded mode, each shard is locked only while its own flows are
+ * written.  Returns the number of flows saved, or -1 on write error. */
+int
+IPRewriterBase::save_checkpoint(StringAccum &sa, int fd, ErrorHandler *errh)
+{
+    click_jiffies_t now_j = click_jiffies();
+    sa.append(checkpoint_magic, checkpoint_magic_len);
+    int nflows = 0, r = 0;
+    Vector<IPRewriterFlow *> flows;
+    for (int s = 0; s < (_shards ? _nshards : 1) && r >= 0; ++s) {
+	if (_shards)
+	    _shards[s].lock.acquire();
+	flows.clear();
+	(_shards ? _shards[s].heap : _heap)->all_flows(flows);
+	for (IPRewriterFlow **it = flows.begin();
+	     it != flows.end() && r >= 0; ++it)
+	    // A MAPPING_CAPACITY heap may hold other elements' flows.
+	    if ((*it)->owner()->owner == this) {
+		save_flow(sa, *it, now_j);
+		++nflows;
+		if (fd >= 0 && sa.length() >= checkpoint_chunk)
+		    r = checkpoint_flush(sa, fd, errh);
+	    }
+	if (_shards)
+	    _shards[s].lock.release();
+    }
+    if (fd >= 0 && r >= 0)
+	r = checkpoint_flush(sa, fd, errh);
+    return r < 0 ? -1 : nflows;
+}
+
+bool
+IPRewriterBase::restore_flow(const unsigned char *x, int len,
+			     click_jiffies_t now_j)
+{
+    int ip_p = x[0], input = get16(x + 4);
+    if (input >= _input_specs.size())
+	return false;
+    IPFlowID flowid = get_flowid(x + 10);
+    IPFlowID rewritten_flowid = get_flowid(x + 22);
+    click_jiffies_t expiry_j = now_j + (uint64_t) get32(x + 6) * CLICK_HZ / 1000;
+
+    int mapi = flow_map_index(ip_p);
+    Shard *sh = 0;
+    Map *map;
+    if (_shards) {
+	// store_flow() would refuse a flow that spans shards, counting it as
+	// a mapping failure; this is not one.
+	if (flow_shard(flowid, _nshards)
+	    != flow_shard(rewritten_flowid.reverse(), _nshards))
+	    return false;
+	sh = &shard(flowid);
+	sh->lock.acquire();
+	map = &sh->map[mapi];
+    } else
+	map = get_map(mapi ? IPRewriterInput::mapid_iprewriter_udp : IPRewriterInput::mapid_default);
+
+    // Flows the router already has win.
+    IPRewriterEntry *m = 0;
+    if (map && !map->get(flowid)
+	&& (m = add_flow(ip_p, flowid, rewritten_flowid, input))) {
+	IPRewriterFlow *flow = m->flow();
+	flow->_tflags = x[2];
+	flow->set_reply_anno(x[3]);
+	flow->change_expiry(sh ? sh->heap : _heap, x[1] & 1, expiry_j);
+	restore_flow_state(flow, x + checkpoint_fixed_len,
+			   len - checkpoint_fixed_len);
+    }
+    if (sh)
+	sh->lock.release();
+    return m != 0;
+}
+
+/** @brief Restore the flows in checkpoint @a data.
+ *
+ * Flows whose flow IDs are already mapped, or whose inputs no longer
+ * exist, are skipped.  Returns the number of flows restored, or -1 if the
+ * checkpoint is malformed; flows before the error stay restored. */
+int
+IPRewriterBase::load_checkpoint(const String &data, ErrorHandler *errh)
+{
+    const unsigned char *x = reinterpret_cast<const unsigned char *>(data.data());
+    const unsigned char *end = x + data.length();
+    if (data.length() < checkpoint_magic_len
+	|| memcmp(x, checkpoint_magic, checkpoint_magic_len) != 0)
+	return errh->error("not a flow checkpoint");
+    x += checkpoint_magic_len;
+    click_jiffies_t now_j = click_jiffies();
+    int nflows = 0;
+    while (x != end) {
+	int len;
+	if (end - x < 2 + checkpoint_fixed_len
+	    || (len = get16(x)) < checkpoint_fixed_len
+	    || end - x < 2 + len)
+	    return errh->error("flow checkpoint truncated after %d flows", nflows);
+	nflows += restore_flow(x + 2, len, now_j);
+	x += 2 + len;
+    }
+    return nflows;
+}
+
 int
 IPRewriterBase::llrpc(unsigned command, void *data)
 {
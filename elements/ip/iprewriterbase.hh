@@ -4,7 +4,9 @@
 #include <click/timer.hh>
 #include "elements/ip/iprwmapping.hh"
 #include <click/bitvector.hh>
+#include <click/sync.hh>
 CLICK_DECLS
+class HashAllocator;
 class IPMapper;
 class IPRewriterPattern;
 
@@ -31,7 +33,8 @@ class IPRewriterInput { public:
     }
 
     enum {
-	mapid_default = 0, mapid_iprewriter_udp = 1
+	mapid_default = 0, mapid_iprewriter_udp = 1,
+	mapid_shard = 2		// + 2 * shard + map: one of a shard's maps
     };
 
     inline int rewrite_flowid(const IPFlowID &flowid,
@@ -43,9 +46,13 @@ class IPRewriterHeap { public:
 
     IPRewriterHeap()
 	: _capacity(0x7FFFFFFF), _use_count(1) {
+	_wheel[0] = _wheel[1] = 0;
+	_wheel_count[0] = _wheel_count[1] = 0;
     }
     ~IPRewriterHeap() {
 	assert(size() == 0);
+	delete[] _wheel[0];
+	delete[] _wheel[1];
     }
 
     void use() {
@@ -58,11 +65,24 @@ class IPRewriterHeap { public:
     }
 
     Vector<IPRewriterFlow *>::size_type size() const {
-	return _heaps[0].size() + _heaps[1].size();
+	return _heaps[0].size() + _heaps[1].size()
+	    + _wheel_count[0] + _wheel_count[1];
     }
     int32_t capacity() const {
 	return _capacity;
     }
+    /** @brief Return the bytes held by the heaps or timing wheels, not
+     * counting the flows themselves. */
+    size_t memory() const {
+	return (_heaps[0].capacity() + _heaps[1].capacity()) * sizeof(IPRewriterFlow *)
+	    + (_wheel[0] ? 2 * wheel_size * sizeof(IPRewriterFlow *) : 0);
+    }
+
+    /** @brief Test if flows are kept in timing wheels rather than heaps. */
+    bool timing_wheel() const {
+	return _wheel[0] != 0;
+    }
+    void set_timing_wheel();
 
   private:
 
@@ -73,6 +93,34 @@ class IPRewriterHeap { public:
     int32_t _capacity;
     uint32_t _use_count;
 
+    // In timing wheel mode, _heaps are unused.  Each wheel has wheel_size
+    // slots of (1 << _wheel_shift) jiffies.  A flow is linked into the slot
+    // for its expiry time, modulo the wheel's span, so refreshing a flow
+    // costs O(1).  Slots before the cursor have already been reaped.
+    enum {
+	wheel_order = 10, wheel_size = 1 << wheel_order
+    };
+    IPRewriterFlow **_wheel[2];
+    click_jiffies_t _wheel_cursor[2];
+    uint32_t _wheel_count[2];
+    int _wheel_shift;
+
+    bool empty(int which) const {
+	return _wheel[0] ? !_wheel_count[which] : _heaps[which].empty();
+    }
+    void insert(IPRewriterFlow *flow);
+    void remove(IPRewriterFlow *flow);
+    IPRewriterFlow *first(int which) const;
+    void expire(int which, click_jiffies_t now_j,
+		Vector<IPRewriterFlow *> &expired);
+    void all_flows(Vector<IPRewriterFlow *> &flows) const;
+
+    IPRewriterFlow **wheel_slot(click_jiffies_t t, int which) const {
+	return &_wheel[which][(t >> _wheel_shift) & (wheel_size - 1)];
+    }
+    inline void wheel_link(IPRewriterFlow *flow);
+    inline void wheel_unlink(IPRewriterFlow *flow);
+
     friend class IPRewriterBase;
     friend class IPRewriterFlow;
 
@@ -103,6 +151,7 @@ class IPRewriterBase : public Element { public:
     int initialize(ErrorHandler *errh);
     void add_rewriter_handlers(bool writable_patterns);
     void cleanup(CleanupStage);
+    size_t memory_usage() const;
 
     const IPRewriterHeap *flow_heap() const {
 	return _heap;
@@ -111,9 +160,25 @@ class IPRewriterBase : public Element { public:
 	return _input_specs[input].reply_element;
     }
     virtual HashContainer<IPRewriterEntry> *get_map(int mapid) {
-	return likely(mapid == IPRewriterInput::mapid_default) ? &_map : 0;
+	if (likely(mapid == IPRewriterInput::mapid_default))
+	    return &_map;
+	else if (mapid >= IPRewriterInput::mapid_shard)
+	    return &_shards[(mapid - IPRewriterInput::mapid_shard) >> 1].map[mapid & 1];
+	else
+	    return 0;
     }
 
+    /** @brief Return the number of flow table shards (1 if unsharded). */
+    int nshards() const {
+	return _nshards;
+    }
+    /** @brief Return the shard for @a flowid out of @a nshards shards.
+     *
+     * The hash is symmetric, so a flow ID and its reverse map to the same
+     * shard.  Rewritten flow IDs are chosen so that a flow's reply entry
+     * lands on the same shard as its forward entry. */
+    static inline int flow_shard(const IPFlowID &flowid, int nshards);
+
     enum {
 	get_entry_check = -1, get_entry_reply = -2
     };
@@ -129,6 +194,16 @@ class IPRewriterBase : public Element { public:
 
     int llrpc(unsigned command, void *data);
 
+    /** @brief Append @a flow's subclass state to a checkpoint record.
+     *
+     * The default appends nothing.  TCPRewriter appends its sequence number
+     * delta transitions. */
+    virtual void save_flow_state(const IPRewriterFlow *flow, StringAccum &sa);
+    /** @brief Restore @a flow's subclass state from @a len bytes at @a data,
+     * as appended by save_flow_state(). */
+    virtual bool restore_flow_state(IPRewriterFlow *flow,
+				    const unsigned char *data, int len);
+
   protected:
 
     Map _map;
@@ -136,10 +211,38 @@ class IPRewriterBase : public Element { public:
     Vector<IPRewriterInput> _input_specs;
 
     IPRewriterHeap *_heap;
+    bool _timing_wheel;
+    FlowHash _hash;
     uint32_t _timeouts[2];
     uint32_t _gc_interval_sec;
     Timer _gc_timer;
 
+    // In sharded mode (SHARDS > 1), each shard has its own flow tables,
+    // heap, flow allocators, and copy of the input specifications, all
+    // protected by the shard's lock.  _map and _heap hold no flows.
+    struct Shard {
+	SimpleSpinlock lock;
+	Map map[2];		// indexed by map: IPRewriter keeps UDP in map[1]
+	HashAllocator *allocator[3]; // indexed by pool
+	IPRewriterHeap *heap;
+	Vector<IPRewriterInput> input_specs;
+	Shard()
+	    : heap(0) {
+	    allocator[0] = allocator[1] = allocator[2] = 0;
+	}
+    };
+    int _nshards;
+    Shard *_shards;
+
+    Shard &shard(const IPFlowID &flowid) {
+	return _shards[flow_shard(flowid, _nshards)];
+    }
+    int shard_mapid(const Shard &s, int map) const {
+	return IPRewriterInput::mapid_shard + 2 * (&s - _shards) + map;
+    }
+    int configure_shards(ErrorHandler *errh);
+    void set_shard_capacity();
+
     enum {
 	default_timeout = 300,	   // 5 minutes
 	default_guarantee = 5,	   // 5 seconds
@@ -150,8 +253,34 @@ class IPRewriterBase : public Element { public:
 	return timeouts[1] ? timeouts[1] : timeouts[0];
     }
 
-    IPRewriterEntry *store_flow(IPRewriterFlow *flow, int input,
-				Map &map, Map *reply_map_ptr = 0);
+    /** @brief Return which map, 0 or 1, holds flows with protocol @a ip_p.
+     *
+     * Map 1 is mapid_iprewriter_udp, or a shard's map[1]. */
+    virtual int flow_map_index(int ip_p) const {
+	(void) ip_p;
+	return 0;
+    }
+
+    // Object pools.  Each shard has its own allocator per pool; unsharded
+    // rewriters return theirs from pool_allocator().
+    enum { pool_flows = 0, pool_udp_flows = 1, pool_deltas = 2, npools = 3 };
+    virtual HashAllocator *pool_allocator(int pool) {
+	(void) pool;
+	return 0;
+    }
+
+    int save_checkpoint(StringAccum &sa, int fd, ErrorHandler *errh);
+    int load_checkpoint(const String &data, ErrorHandler *errh);
+    void save_flow(StringAccum &sa, const IPRewriterFlow *flow,
+		   click_jiffies_t now_j);
+    bool restore_flow(const unsigned char *data, int len,
+		      click_jiffies_t now_j);
+
+    IPRewriterEntry *store_flow(IPRewriterFlow *flow, Map &map,
+				Map *reply_map_ptr = 0);
+    static void evict_flow(IPRewriterFlow *flow, IPRewriterHeap *heap) {
+	flow->destroy(heap);
+    }
     inline void unmap_flow(IPRewriterFlow *flow,
 			   Map &map, Map *reply_map_ptr = 0);
 
@@ -162,7 +291,9 @@ class IPRewriterBase : public Element { public:
 
     enum {			// < 0 because individual patterns are >= 0
 	h_nmappings = -1, h_mapping_failures = -2, h_patterns = -3,
-	h_size = -4, h_capacity = -5, h_clear = -6
+	h_size = -4, h_capacity = -5, h_clear = -6, h_shards = -7,
+	h_hash = -8, h_hash_stats = -9, h_checkpoint = -10, h_restore = -11,
+	h_checkpoint_data = -12, h_pools = -13
     };
     static String read_handler(Element *e, void *user_data);
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
@@ -173,9 +304,15 @@ class IPRewriterBase : public Element { public:
 
   private:
 
-    void shift_heap_best_effort(click_jiffies_t now_j);
-    bool shrink_heap_for_new_flow(IPRewriterFlow *flow, click_jiffies_t now_j);
+    IPRewriterHeap *heap_of(IPRewriterFlow *flow) {
+	return _shards ? shard(flow->entry(false).flowid()).heap : _heap;
+    }
+    void shift_heap_best_effort(IPRewriterHeap *heap, click_jiffies_t now_j);
+    bool shrink_heap_for_new_flow(IPRewriterHeap *heap, IPRewriterFlow *flow,
+				  click_jiffies_t now_j);
+    void shrink_heap(IPRewriterHeap *heap, int32_t capacity);
     void shrink_heap(bool clear_all);
+    void destroy_input_flows(IPRewriterHeap *heap, IPRewriterInput *spec);
 
     friend class IPRewriterFlow;
 
@@ -215,7 +352,8 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 	    reply_map = &reply_element->_map;
 	else
 	    reply_map = reply_element->get_map(mapid);
-	i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map);
+	i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map,
+				      reply_element->_nshards);
 	goto check_for_failure;
     }
     case i_mapper:
@@ -230,6 +368,17 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
     }
 }
 
+inline int
+IPRewriterBase::flow_shard(const IPFlowID &flowid, int nshards)
+{
+    uint32_t h = (flowid.saddr().addr() ^ flowid.daddr().addr()) * 0x9E3779B1U
+	+ (flowid.sport() ^ flowid.dport());
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    return ((uint64_t) h * nshards) >> 32;
+}
+
 inline void
 IPRewriterBase::unmap_flow(IPRewriterFlow *flow, Map &map,
 			   Map *reply_map_ptr)
@@ -25,7 +25,9 @@
 #include <click/glue.hh>
 #include <click/straccum.hh>
 #include <click/router.hh>
+#include <click/master.hh>
 #include "iproutetable.hh"
+#include "elements/standard/classification.hh"
 CLICK_DECLS
 
 bool
@@ -77,6 +79,81 @@ IPRoute::unparse(StringAccum& sa, bool tabs) const
     return sa;
 }
 
+// Parses a dotted-quad address at [s, end) into host order.  Returns the
+// end of the address, or null if there is none.
+static const char *
+parse_dotted_quad(const char *s, const char *end, uint32_t &a)
+{
+    a = 0;
+    for (int part = 0; part < 4; ++part) {
+	if (part && (s == end || *s++ != '.'))
+	    return 0;
+	if (s == end || *s < '0' || *s > '9')
+	    return 0;
+	uint32_t x = 0;
+	for (int n = 0; s != end && *s >= '0' && *s <= '9'; ++s, ++n)
+	    if (n == 3 || (x = x * 10 + *s - '0') > 255)
+		return 0;
+	a = (a << 8) | x;
+    }
+    return s;
+}
+
+static inline const char *
+skip_blanks(const char *s, const char *end)
+{
+    while (s != end && (*s == ' ' || *s == '\t' || *s == '\r'))
+	++s;
+    return s;
+}
+
+// Parses the line [s, end) as `ADDR/MASK [GW] OUT', where the addresses are
+// dotted quads and the mask is a dotted quad or a prefix length.  Returns
+// false on any other input; the caller then tries cp_ip_route.
+static bool
+parse_route_fast(const char *s, const char *end, IPRoute &r)
+{
+    uint32_t addr, mask, gw = 0, port;
+    s = skip_blanks(s, end);
+    if (!(s = parse_dotted_quad(s, end, addr)) || s == end || *s++ != '/')
+	return false;
+    const char *t = s;
+    for (port = 0; t != end && *t >= '0' && *t <= '9' && port <= 32; ++t)
+	port = port * 10 + *t - '0';
+    if (t != s && t - s <= 2 && (t == end || *t != '.') && port <= 32) {
+	mask = port ? 0xFFFFFFFFU << (32 - port) : 0;
+	s = t;
+    } else if (!(s = parse_dotted_quad(s, end, mask)))
+	return false;
+
+    for (int word = 0; word < 2; ++word) {
+	t = skip_blanks(s, end);
+	if (t == s || t == end)
+	    return false;
+	s = t;
+	if (word == 0 && *s == '-')
+	    ++s;
+	else if (word == 0 && (t = parse_dotted_quad(s, end, gw)))
+	    s = t;
+	else {
+	    if (*s < '0' || *s > '9')
+		return false;
+	    for (port = 0; s != end && *s >= '0' && *s <= '9'; ++s)
+		if ((port = port * 10 + *s - '0') > 0xFFFF)
+		    return false;
+	    word = 2;
+	}
+    }
+    if (skip_blanks(s, end) != end)
+	return false;
+
+    r.addr = IPAddress(htonl(addr & mask));
+    r.mask = IPAddress(htonl(mask));
+    r.gw = IPAddress(htonl(gw));
+    r.port = port;
+    return true;
+}
+
 String
 IPRoute::unparse() const
 {
@@ -139,12 +216,89 @@ IPRouteTable::lookup_route(IPAddress, IPAddress&) const
     return -1;			// by default, route lookups fail
 }
 
+void
+IPRouteTable::lookup_routes(int n, const IPAddress* addr, IPAddress* gw, int* port) const
+{
+    for (int i = 0; i < n; ++i)
+	port[i] = lookup_route(addr[i], gw[i]);
+}
+
 String
 IPRouteTable::dump_routes()
 {
     return String();
 }
 
+size_t
+IPRouteTable::memory_usage() const
+{
+    return _load_routes.capacity() * sizeof(IPRoute);
+}
+
+int
+IPRouteTable::replace_routes(const Vector<IPRoute>& routes, ErrorHandler* errh)
+{
+    Vector<IPRoute> old_routes;
+    String dump = dump_routes();
+    const char* s = dump.begin(), *end = dump.end();
+    IPRoute route;
+    while (s < end) {
+	const char* nl = find(s, end, '\n');
+	if (cp_ip_route(dump.substring(s, nl), &route, false, this)
+	    && route.port >= 0)
+	    old_routes.push_back(route);
+	s = nl + 1;
+    }
+
+    ErrorHandler* silent = ErrorHandler::silent_handler();
+    int i, j, r = 0;
+    for (i = 0; i < old_routes.size(); ++i)
+	if ((r = remove_route(old_routes[i], 0, errh)) < 0)
+	    goto rollback_remove;
+    for (j = 0; j < routes.size(); ++j)
+	if ((r = add_route(routes[j], true, 0, errh)) < 0)
+	    goto rollback_add;
+    return 0;
+
+  rollback_add:
+    if (r == -ENOMEM)
+	errh->error("no memory to store route %<%s%>", routes[j].unparse().c_str());
+    while (j > 0)
+	remove_route(routes[--j], 0, silent);
+  rollback_remove:
+    while (i > 0)
+	add_route(old_routes[--i], true, 0, silent);
+    return r;
+}
+
+void
+IPRouteTable::retire_table(void* table, void (*destroy)(void*))
+{
+#if HAVE_MULTITHREAD
+    if (master()->nthreads() > 1) {
+	Retired r;
+	r.table = table;
+	r.destroy = destroy;
+	r.when = Timestamp::now_steady();
+	_retired.push_back(r);
+	return;
+    }
+#endif
+    destroy(table);
+}
+
+void
+IPRouteTable::reclaim_tables(bool all)
+{
+    // Lookups that started before a table was replaced may still be reading
+    // it; destroy it only once they must have finished.
+    Timestamp limit = Timestamp::now_steady() - Timestamp::make_msec(GRACE_MSEC);
+    int i = 0;
+    for (; i < _retired.size() && (all || _retired[i].when <= limit); ++i)
+	_retired[i].destroy(_retired[i].table);
+    _retired.erase(_retired.begin(), _retired.begin() + i);
+}
+
 
 void
 IPRouteTable::push(int, Packet *p)
@@ -164,6 +318,35 @@ IPRouteTable::push(int, Packet *p)
     }
 }
 
+void
+IPRouteTable::push_batch(int, PacketBatch& batch)
+{
+    Packet* p[BATCH_LANES];
+    IPAddress addr[BATCH_LANES], gw[BATCH_LANES];
+    int port[BATCH_LANES];
+
+    while (!batch.empty()) {
+	int n = 0;
+	for (; n < BATCH_LANES && !batch.empty(); ++n) {
+	    p[n] = batch.pop_front();
+	    addr[n] = p[n]->dst_ip_anno();
+	}
+	lookup_routes(n, addr, gw, port);
+	for (int i = 0; i < n; ++i)
+	    if (port[i] < 0) {
+		static int complained = 0;
+		if (++complained <= 5)
+		    click_chatter("IPRouteTable: no route for %s", addr[i].unparse().c_str());
+		port[i] = noutputs(); // killed by push_batch_by_output
+	    } else {
+		assert(port[i] < noutputs());
+		if (gw[i])
+		    p[i]->set_dst_ip_anno(gw[i]);
+	    }
+	Classification::push_batch_by_output(this, p, port, n);
+    }
+}
+
 
 int
 IPRouteTable::run_command(int command, const String &str, Vector<IPRoute>* old_routes, ErrorHandler *errh)
@@ -176,7 +359,9 @@ IPRouteTable::run_command(int command, const String &str, Vector<IPRoute>* old_r
 	return errh->error("bad OUTPUT");
 
     int r, before = errh->nerrors();
-    if (command == CMD_ADD)
+    if (command == CMD_ADD && memory_exceeded())
+	return errh->error("memory limit reached, route %<%s%> not added", route.unparse().c_str()), -ENOMEM;
+    else if (command == CMD_ADD)
 	r = add_route(route, false, &old_route, errh);
     else if (command == CMD_SET)
 	r = add_route(route, true, &old_route, errh);
@@ -208,14 +393,22 @@ int
 IPRouteTable::add_route_handler(const String &conf, Element *e, void *thunk, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    table->_table_lock.acquire();
+    int r = table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    table->_table_lock.release();
+    table->router()->bump_forwarding_epoch();
+    return r;
 }
 
 int
 IPRouteTable::remove_route_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command(CMD_REMOVE, conf, 0, errh);
+    table->_table_lock.acquire();
+    int r = table->run_command(CMD_REMOVE, conf, 0, errh);
+    table->_table_lock.release();
+    table->router()->bump_forwarding_epoch();
+    return r;
 }
 
 int
@@ -228,6 +421,7 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
     Vector<IPRoute> old_routes;
     int r = 0;
 
+    table->_table_lock.acquire();
     while (s < end) {
 	const char* nl = find(s, end, '\n');
 	String line = conf.substring(s, nl);
@@ -252,6 +446,8 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 
 	s = nl + 1;
     }
+    table->_table_lock.release();
+    table->router()->bump_forwarding_epoch();
     return 0;
 
   rollback:
@@ -265,14 +461,70 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 	    table->add_route(rt, true, 0, errh);
 	old_routes.pop_back();
     }
+    table->_table_lock.release();
+    table->router()->bump_forwarding_epoch();
     return r;
 }
 
+int
+IPRouteTable::load_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
+{
+    IPRouteTable *table = static_cast<IPRouteTable *>(e);
+    const char* s = conf.begin(), *end = conf.end();
+    int old_size = table->_load_routes.size(), lineno = 0;
+    IPRoute route;
+
+    while (s < end) {
+	const char* nl = find(s, end, '\n');
+	const char* t = skip_blanks(s, nl);
+	++lineno;
+	if (t == nl || *t == '#')
+	    /* blank line or comment */;
+	else if (!parse_route_fast(t, nl, route)
+		 && !cp_ip_route(conf.substring(t, nl), &route, false, table)) {
+	    table->_load_routes.resize(old_size);
+	    return errh->error("line %d: expected %<ADDR/MASK [GATEWAY] OUTPUT%>", lineno);
+	} else if (route.port < 0 || route.port >= table->noutputs()) {
+	    table->_load_routes.resize(old_size);
+	    return errh->error("line %d: bad OUTPUT", lineno);
+	} else
+	    table->_load_routes.push_back(route);
+	s = nl + 1;
+    }
+    return 0;
+}
+
+int
+IPRouteTable::commit_handler(const String &, Element *e, void *thunk, ErrorHandler *errh)
+{
+    IPRouteTable *table = static_cast<IPRouteTable *>(e);
+    int r = 0;
+    if (thunk) {
+	table->_table_lock.acquire();
+	table->reclaim_tables(false);
+	r = table->replace_routes(table->_load_routes, errh);
+	table->_table_lock.release();
+	table->router()->bump_forwarding_epoch();
+    }
+    table->_load_routes.clear();
+    return r;
+}
+
+String
+IPRouteTable::load_read_handler(Element *e, void *)
+{
+    IPRouteTable *table = static_cast<IPRouteTable *>(e);
+    return String(table->_load_routes.size());
+}
+
 String
 IPRouteTable::table_handler(Element *e, void *)
 {
     IPRouteTable *r = static_cast<IPRouteTable*>(e);
-    return r->dump_routes();
+    r->_table_lock.acquire();
+    String s = r->dump_routes();
+    r->_table_lock.release();
+    return s;
 }
 
 int
@@ -299,9 +551,15 @@ IPRouteTable::add_handlers()
     add_write_handler("set", add_route_handler, 1);
     add_write_handler("remove", remove_route_handler);
     add_write_handler("ctrl", ctrl_handler);
-    add_read_handler("table", table_handler, 0, Handler::EXPENSIVE);
+    add_write_handler("load", load_handler);
+    add_read_handler("load", load_read_handler);
+    add_write_handler("commit", commit_handler, 1, Handler::BUTTON);
+    add_write_handler("abort", commit_handler, 0, Handler::BUTTON);
+    add_read_handler("table", table_handler, 0, Handler::EXPENSIVE | Handler::CONCURRENT);
     set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
+    add_memory_limit_handler();
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(Classification)
 ELEMENT_PROVIDES(IPRouteTable)
@@ -3,6 +3,9 @@
 #define CLICK_IPROUTETABLE_HH
 #include <click/glue.hh>
 #include <click/element.hh>
+#include <click/prefetch.hh>
+#include <click/sync.hh>
+#include <click/timestamp.hh>
 CLICK_DECLS
 
 /*
@@ -22,6 +25,12 @@ elements. It parses configuration strings -- see LinearIPLookup for an example
 function uses those virtual functions to look up routes and output packets
 accordingly. There are also some functions useful for implementing handlers.
 
+Route tables parse their configurations independently of other elements, so
+when the driver is run with several configure threads (for example, the
+C<--configure-threads> option to userlevel B<click>), large tables are
+configured, and tables like RangeIPLookup that build lookup structures at
+initialization time are initialized, in parallel.
+
 =head1 PERFORMANCE
 
 Click provides several elements that implement all or part of the IPRouteTable
@@ -108,11 +117,30 @@ Looks up the route associated with address C<dst>. Should set C<gw_return> to
 the resulting gateway and return the relevant output port (or negative if
 there is no route). The default implementation returns -1.
 
+=item C<void B<lookup_routes>(int n, const IPAddress *dst, IPAddress *gw_return, int *port_return) const>
+
+Looks up the routes for the C<n> addresses C<dst[0]> through C<dst[n-1]>,
+storing each result in C<gw_return[i]> and C<port_return[i]> as
+B<lookup_route> would.  Elements that process packet batches use this to
+amortize lookup overhead; implementations may, for example, prefetch table
+entries for later addresses while resolving earlier ones.  The default
+implementation calls B<lookup_route> once per address.
+
 =item C<String B<dump_routes>()>
 
 Returns a textual description of the current routing table. The default
 implementation returns an empty string.
 
+=item C<int B<replace_routes>(const VectorE<lt>IPRouteE<gt> &routes, ErrorHandler *errh)>
+
+Replaces the whole table with C<routes>, in which later routes for a prefix
+override earlier ones.  Either every route is installed or the table is left
+unchanged.  Should return 0 on success and negative on failure.  The default
+implementation removes the routes listed by B<dump_routes> one at a time,
+then adds the new ones with B<add_route>, rolling back on failure; lookups
+made meanwhile can see a partly updated table.  Subclasses that can build a
+table off to the side should instead do so and publish it all at once.
+
 =back
 
 The following functions, overridden by IPRouteTable, are available for use by
@@ -132,6 +160,22 @@ The default implementation of B<push> uses B<lookup_route> to perform IP
 routing lookup. Normally, subclasses implement their own B<push> methods,
 avoiding virtual function call overhead.
 
+=item C<void B<push_batch>(int port, PacketBatch &batch)>
+
+The default implementation of B<push_batch> passes the batch's destination
+address annotations to B<lookup_routes> up to 16 at a time, then sends the
+packets on, batched by output port.  A subclass that overrides
+B<lookup_routes> to overlap its table loads therefore speeds up batch routing
+without overriding B<push_batch>.
+
+=item C<size_t B<memory_usage>() const>
+
+The default implementation counts the routes saved by B<load_handler>.
+Subclasses should add the size of their tables and call it.  Every route
+table has a `C<memory_limit>' handler; while B<memory_usage> exceeds a
+nonzero limit, `C<add>' requests, including those in `C<ctrl>', fail with
+C<-ENOMEM>.
+
 =item C<static int B<add_route_handler>(const String &, Element *, void *, ErrorHandler *)>
 
 This write handler callback parses its input as an add-route request
@@ -150,14 +194,55 @@ This write handler callback function parses its input as a route control
 request and calls B<add_route> or B<remove_route> as directed. Normally hooked
 up to the `C<ctrl>' handler.
 
+=item C<static int B<load_handler>(const String &, Element *, void *, ErrorHandler *)>
+
+This write handler callback parses its input as a list of routes, one per
+line, in the `C<address/mask [gateway] output>' format, and saves them for a
+later B<commit_handler>.  Routes written with plain dotted-quad addresses are
+parsed by a fast special-purpose parser; others, such as those naming
+AddressInfo addresses, go through the usual argument parsers.  If any line
+is bad, none of the input is saved.  Normally hooked up to the `C<load>'
+handler, whose read side returns the number of routes saved so far.
+
+=item C<static int B<commit_handler>(const String &, Element *, void *, ErrorHandler *)>
+
+This write handler callback replaces the table with the routes saved by
+B<load_handler>, using B<replace_routes>, and forgets the saved routes
+whether or not it succeeds.  With a null thunk, it forgets them without
+changing the table.  Normally hooked up to the `C<commit>' and `C<abort>'
+handlers.
+
 =item C<static String B<table_handler>(Element *, void *)>
 
 This read handler callback function returns the element's routing table via
 the B<dump_routes> function. Normally hooked up to the `C<table>' handler.
 
+=item C<Spinlock B<_table_lock>>
+
+The handler callbacks above hold this lock while they change or dump the
+table, so the concurrent `C<table>' handler, which ControlSocket may call on
+a separate thread while packets flow, sees each `C<add>', `C<remove>' or
+`C<ctrl>' request completely or not at all.  Subclass handlers that change
+the table, such as `C<flush>', should hold it as well.  Route lookups do not
+take the lock.
+
+=item C<void B<retire_table>(void *table, void (*destroy)(void *))>
+
+Arranges for C<destroy(table)> to be called once lookups that may have
+started before C<table> was replaced must have finished, after a grace
+period of one second when the driver runs several threads, and immediately
+otherwise.  Retired tables are destroyed by B<reclaim_tables>, which the
+commit handler calls before each commit.
+
+=item C<void B<reclaim_tables>(bool all)>
+
+Destroys retired tables whose grace period has passed, or all retired tables
+if C<all> is true.  Subclasses that retire tables should call
+C<reclaim_tables(true)> from their B<cleanup> methods.
+
 =back
 
-=a RadixIPLookup, DirectIPLookup, RangeIPLookup, StaticIPLookup,
+=a RadixIPLookup, DirectIPLookup, RangeIPLookup, DXRIPLookup, StaticIPLookup,
 LinearIPLookup, SortedIPLookup, LinuxIPLookup */
 
 struct IPRoute {
@@ -187,6 +272,7 @@ struct IPRoute {
 
 class IPRouteTable : public Element { public:
 
+    const char *flags() const		{ return "C I"; }
     void* cast(const char*);
     int configure(Vector<String>&, ErrorHandler*);
     void add_handlers();
@@ -194,20 +280,51 @@ class IPRouteTable : public Element { public:
     virtual int add_route(const IPRoute& route, bool allow_replace, IPRoute* replaced_route, ErrorHandler* errh);
     virtual int remove_route(const IPRoute& route, IPRoute* removed_route, ErrorHandler* errh);
     virtual int lookup_route(IPAddress addr, IPAddress& gw) const = 0;
+    virtual void lookup_routes(int n, const IPAddress* addr, IPAddress* gw, int* port) const;
     virtual String dump_routes();
+    virtual int replace_routes(const Vector<IPRoute>& routes, ErrorHandler* errh);
+    size_t memory_usage() const;
 
     void push(int port, Packet* p);
+    void push_batch(int port, PacketBatch& batch);
 
     static int add_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int remove_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int ctrl_handler(const String&, Element*, void*, ErrorHandler*);
+    static int load_handler(const String&, Element*, void*, ErrorHandler*);
+    static int commit_handler(const String&, Element*, void*, ErrorHandler*);
     static int lookup_handler(int operation, String&, Element*, const Handler*, ErrorHandler*);
     static String table_handler(Element*, void*);
 
+  protected:
+
+    enum { BATCH_LANES = 16 };
+
+    Spinlock _table_lock;
+
+    static inline void prefetch_entry(const void* p) {
+	click_prefetch(p);
+    }
+
+    void retire_table(void* table, void (*destroy)(void*));
+    void reclaim_tables(bool all);
+
   private:
 
     enum { CMD_ADD, CMD_SET, CMD_REMOVE };
+    enum { GRACE_MSEC = 1000 };
+
+    struct Retired {
+	void* table;
+	void (*destroy)(void*);
+	Timestamp when;
+    };
+
+    Vector<IPRoute> _load_routes;
+    Vector<Retired> _retired;
+
     int run_command(int command, const String &, Vector<IPRoute>* old_routes, ErrorHandler*);
+    static String load_read_handler(Element*, void*);
 
 };
 
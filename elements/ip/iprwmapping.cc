@@ -89,10 +89,157 @@ IPRewriterFlow::apply(WritablePacket *p, bool direction, unsigned annos)
     }
 }
 
+//
+// IPRewriterHeap
+//
+
+void
+IPRewriterHeap::set_timing_wheel()
+{
+    assert(size() == 0 && !_wheel[0]);
+    // Slots of about 1/8 second: a wheel spans a couple of minutes, and
+    // longer-lived flows are skipped over once per revolution.
+    _wheel_shift = 0;
+    while ((2 << _wheel_shift) <= CLICK_HZ / 8)
+	++_wheel_shift;
+    click_jiffies_t now_j = click_jiffies();
+    for (int which = 0; which < 2; ++which) {
+	_wheel[which] = new IPRewriterFlow *[wheel_size];
+	memset(_wheel[which], 0, sizeof(IPRewriterFlow *) * wheel_size);
+	_wheel_cursor[which] = now_j & ~((1U << _wheel_shift) - 1);
+    }
+}
+
+inline void
+IPRewriterHeap::wheel_link(IPRewriterFlow *flow)
+{
+    int which = flow->_guaranteed;
+    click_jiffies_t t = flow->_expiry_j;
+    if (click_jiffies_less(t, _wheel_cursor[which]))
+	t = _wheel_cursor[which];
+    IPRewriterFlow **slot = wheel_slot(t, which);
+    if ((flow->_wheel_next = *slot))
+	flow->_wheel_next->_wheel_pprev = &flow->_wheel_next;
+    flow->_wheel_pprev = slot;
+    *slot = flow;
+    ++_wheel_count[which];
+}
+
+inline void
+IPRewriterHeap::wheel_unlink(IPRewriterFlow *flow)
+{
+    if ((*flow->_wheel_pprev = flow->_wheel_next))
+	flow->_wheel_next->_wheel_pprev = flow->_wheel_pprev;
+    --_wheel_count[flow->_guaranteed];
+}
+
+void
+IPRewriterHeap::insert(IPRewriterFlow *flow)
+{
+    if (_wheel[0])
+	wheel_link(flow);
+    else {
+	Vector<IPRewriterFlow *> &myheap = _heaps[flow->_guaranteed];
+	myheap.push_back(flow);
+	push_heap(myheap.begin(), myheap.end(),
+		  IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
+    }
+}
+
+void
+IPRewriterHeap::remove(IPRewriterFlow *flow)
+{
+    if (_wheel[0])
+	wheel_unlink(flow);
+    else {
+	Vector<IPRewriterFlow *> &myheap = _heaps[flow->_guaranteed];
+	remove_heap(myheap.begin(), myheap.end(), myheap.begin() + flow->_place,
+		    IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
+	myheap.pop_back();
+    }
+}
+
+IPRewriterFlow *
+IPRewriterHeap::first(int which) const
+{
+    if (!_wheel[0])
+	return _heaps[which].empty() ? 0 : _heaps[which][0];
+    else if (!_wheel_count[which])
+	return 0;
+
+    // Return a flow due in the first nonempty slot, which expires first to
+    // within a slot.  If none is due this revolution, find the minimum.
+    click_jiffies_t t = _wheel_cursor[which], tick = 1U << _wheel_shift;
+    IPRewriterFlow *best = 0;
+    for (int i = 0; i < wheel_size; ++i, t += tick)
+	for (IPRewriterFlow *f = *wheel_slot(t, which); f; f = f->_wheel_next) {
+	    if (click_jiffies_less(f->_expiry_j, t + tick))
+		return f;
+	    else if (!best || click_jiffies_less(f->_expiry_j, best->_expiry_j))
+		best = f;
+	}
+    return best;
+}
+
+void
+IPRewriterHeap::expire(int which, click_jiffies_t now_j,
+		       Vector<IPRewriterFlow *> &expired)
+{
+    // Collect all expired flows in one pass over the slots from the cursor
+    // to now.  The current slot stays under the cursor, since flows that
+    // expire later in its tick are not yet expired.
+    assert(_wheel[0]);
+    click_jiffies_t tick = 1U << _wheel_shift;
+    click_jiffies_t now_t = now_j & ~(tick - 1);
+    click_jiffies_t &cursor = _wheel_cursor[which];
+    for (int i = 0; i < wheel_size && _wheel_count[which]; ++i) {
+	for (IPRewriterFlow *f = *wheel_slot(cursor, which); f; f = f->_wheel_next)
+	    if (f->expired(now_j))
+		expired.push_back(f);
+	if (!click_jiffies_less(cursor, now_t))
+	    return;
+	cursor += tick;
+    }
+    // Every slot has been visited (or the wheel is empty).
+    if (click_jiffies_less(cursor, now_t))
+	cursor = now_t;
+}
+
+void
+IPRewriterHeap::all_flows(Vector<IPRewriterFlow *> &flows) const
+{
+    for (int which = 0; which < 2; ++which) {
+	for (int i = 0; i < _heaps[which].size(); ++i)
+	    flows.push_back(_heaps[which][i]);
+	for (int i = 0; _wheel[which] && i < wheel_size; ++i)
+	    for (IPRewriterFlow *f = _wheel[which][i]; f; f = f->_wheel_next)
+		flows.push_back(f);
+    }
+}
+
+//
+// IPRewriterFlow
+//
+
 void
 IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
 			      click_jiffies_t expiry_j)
 {
+    if (h->_wheel[0]) {
+	// Stay in the same slot if possible.
+	if (_guaranteed == guaranteed
+	    && ((_expiry_j ^ expiry_j) >> h->_wheel_shift) == 0
+	    && !click_jiffies_less(_expiry_j, h->_wheel_cursor[guaranteed]))
+	    _expiry_j = expiry_j;
+	else {
+	    h->wheel_unlink(this);
+	    _expiry_j = expiry_j;
+	    _guaranteed = guaranteed;
+	    h->wheel_link(this);
+	}
+	return;
+    }
+
     Vector<IPRewriterFlow *> &current_heap = h->_heaps[_guaranteed];
     assert(current_heap[_place] == this);
     _expiry_j = expiry_j;
@@ -115,10 +262,7 @@ IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
 void
 IPRewriterFlow::destroy(IPRewriterHeap *heap)
 {
-    Vector<IPRewriterFlow *> &myheap = heap->_heaps[_guaranteed];
-    remove_heap(myheap.begin(), myheap.end(), myheap.begin() + _place,
-		heap_less(), heap_place());
-    myheap.pop_back();
+    heap->remove(this);
     --_owner->count;
     _owner->owner->destroy_flow(this);
 }
@@ -163,9 +163,12 @@ class IPRewriterFlow { public:
     bool _guaranteed;
     uint8_t _reply_anno;
     IPRewriterInput *_owner;
+    IPRewriterFlow *_wheel_next;	// timing wheel slot list
+    IPRewriterFlow **_wheel_pprev;
 
     friend class IPRewriterBase;
     friend class IPRewriterEntry;
+    friend class IPRewriterHeap;
 
   private:
 
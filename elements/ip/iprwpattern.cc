@@ -39,9 +39,10 @@ IPRewriterPattern::IPRewriterPattern(const IPAddress &saddr, int sport,
 		       bool is_napt, bool sequential, bool same_first,
 		       uint32_t variation_top)
     : _saddr(saddr), _sport(sport), _daddr(daddr), _dport(dport),
-      _variation_top(variation_top), _next_variation(0), _is_napt(is_napt),
+      _variation_top(variation_top), _is_napt(is_napt),
       _sequential(sequential), _same_first(same_first), _refcount(0)
 {
+    _next_variation = 0;
 }
 
 namespace {
@@ -219,7 +220,8 @@ IPRewriterPattern::parse_with_ports(const String &conf, IPRewriterInput *input,
 int
 IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 				  IPFlowID &rewritten_flowid,
-				  const HashContainer<IPRewriterEntry> &reply_map)
+				  const HashContainer<IPRewriterEntry> &reply_map,
+				  int nshards)
 {
     rewritten_flowid = flowid;
     if (_saddr)
@@ -234,18 +236,24 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
     if (_variation_top) {
 	IPFlowID lookup = rewritten_flowid.reverse();
 	uint32_t base = (_is_napt ? ntohs(_sport) : ntohl(_saddr.addr()));
+	// A sharded rewriter keeps both directions of a flow in one shard, so
+	// only variations whose reply hashes to the flow's shard are usable.
+	int shard = (nshards > 1 ? IPRewriterBase::flow_shard(flowid, nshards) : 0);
 
 	uint32_t val;
 	if (_same_first
 	    && (val = ntohs(flowid.sport()) - base) <= _variation_top) {
 	    lookup.set_dport(flowid.sport());
-	    if (!reply_map.find(lookup))
+	    if (!reply_map.find(lookup)
+		&& (nshards <= 1 || IPRewriterBase::flow_shard(lookup, nshards) == shard))
 		goto found_variation;
 	}
 
-	if (_sequential)
-	    val = (_next_variation > _variation_top ? 0 : _next_variation);
-	else
+	if (_sequential) {
+	    val = _next_variation;
+	    if (val > _variation_top)
+		val = 0;
+	} else
 	    val = click_random(0, _variation_top);
 
 	for (uint32_t count = 0; count <= _variation_top;
@@ -254,7 +262,8 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 		lookup.set_dport(htons(base + val));
 	    else
 		lookup.set_daddr(htonl(base + val));
-	    if (!reply_map.find(lookup))
+	    if (!reply_map.find(lookup)
+		&& (nshards <= 1 || IPRewriterBase::flow_shard(lookup, nshards) == shard))
 		goto found_variation;
 	}
 
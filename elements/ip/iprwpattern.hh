@@ -2,6 +2,7 @@
 #ifndef CLICK_IPRW_PATTERN_HH
 #define CLICK_IPRW_PATTERN_HH
 #include <click/element.hh>
+#include <click/atomic.hh>
 #include <click/hashcontainer.hh>
 #include <click/ipflowid.hh>
 CLICK_DECLS
@@ -38,7 +39,8 @@ class IPRewriterPattern { public:
     }
 
     int rewrite_flowid(const IPFlowID &flowid, IPFlowID &rewritten_flowid,
-		       const HashContainer<IPRewriterEntry> &reply_map);
+		       const HashContainer<IPRewriterEntry> &reply_map,
+		       int nshards = 1);
 
     String unparse() const;
 
@@ -50,7 +52,7 @@ class IPRewriterPattern { public:
     int _dport;			// net byte order
 
     uint32_t _variation_top;
-    uint32_t _next_variation;
+    atomic_uint32_t _next_variation;	// shared by shards; a starting hint
 
     bool _is_napt;
     bool _sequential;
@@ -0,0 +1,305 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iptuplespace.{cc,hh} -- tuple-space search for IPFilter rule sets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iptuplespace.hh"
+#include <click/straccum.hh>
+CLICK_DECLS
+
+void
+IPTupleSpace::Rule::clear()
+{
+    src = src_mask = dst = dst_mask = 0;
+    proto = -1;
+    sports.clear();
+    dports.clear();
+    sports_set = dports_set = never = false;
+    ok = true;
+}
+
+void
+IPTupleSpace::Rule::restrict_addr(bool is_dst, uint32_t value, uint32_t mask)
+{
+    uint32_t &v = (is_dst ? dst : src), &m = (is_dst ? dst_mask : src_mask);
+    uint32_t common = m & mask;
+    if ((v & common) != (value & common))
+	never = true;
+    v = (v & m) | (value & mask);
+    m |= mask;
+}
+
+void
+IPTupleSpace::Rule::restrict_proto(int p)
+{
+    if (proto == -1 || proto == p)
+	proto = p;
+    else if (proto == IP_PROTO_TCP_OR_UDP
+	     && (p == IP_PROTO_TCP || p == IP_PROTO_UDP))
+	proto = p;
+    else if (p == IP_PROTO_TCP_OR_UDP
+	     && (proto == IP_PROTO_TCP || proto == IP_PROTO_UDP))
+	/* nada */;
+    else
+	never = true;
+}
+
+void
+IPTupleSpace::Rule::restrict_ports(bool is_dst, uint32_t lo, uint32_t hi,
+				   bool complement)
+{
+    Vector<uint32_t> allowed;
+    if (!complement)
+	allowed.push_back((lo << 16) | hi);
+    else {
+	if (lo > 0)
+	    allowed.push_back(lo - 1);
+	if (hi < 0xFFFF)
+	    allowed.push_back(((hi + 1) << 16) | 0xFFFF);
+    }
+
+    Vector<uint32_t> &ranges = (is_dst ? dports : sports);
+    bool &set = (is_dst ? dports_set : sports_set);
+    if (!set) {
+	ranges.swap(allowed);
+	set = true;
+    } else {
+	Vector<uint32_t> result;
+	for (uint32_t *a = ranges.begin(); a != ranges.end(); ++a)
+	    for (uint32_t *b = allowed.begin(); b != allowed.end(); ++b) {
+		uint32_t l = (*a >> 16 > *b >> 16 ? *a >> 16 : *b >> 16);
+		uint32_t h = ((*a & 0xFFFF) < (*b & 0xFFFF) ? *a & 0xFFFF : *b & 0xFFFF);
+		if (l <= h)
+		    result.push_back((l << 16) | h);
+	    }
+	ranges.swap(result);
+    }
+    if (!ranges.size())
+	never = true;
+}
+
+
+// Append the (value << 16) | mask prefixes that exactly cover each range.
+static void
+range_prefixes(const Vector<uint32_t> &ranges, bool set, Vector<uint32_t> &out)
+{
+    if (!set) {
+	out.push_back(0);
+	return;
+    }
+    for (const uint32_t *r = ranges.begin(); r != ranges.end(); ++r) {
+	uint32_t lo = *r >> 16, hi = *r & 0xFFFF;
+	while (lo <= hi) {
+	    // largest aligned block that starts at lo and ends by hi
+	    uint32_t size = (lo ? lo & -lo : 0x10000);
+	    while (lo + size - 1 > hi)
+		size /= 2;
+	    out.push_back((lo << 16) | (0xFFFF & ~(size - 1)));
+	    lo += size;
+	}
+    }
+}
+
+void
+IPTupleSpace::clear()
+{
+    _rules.clear();
+    _outputs.clear();
+    _tuples.clear();
+    _nrules = _nentries = 0;
+    _complete = false;
+}
+
+/** @brief Add @a rule, whose action is @a output, as the next rule. */
+void
+IPTupleSpace::add(const Rule &rule, int output)
+{
+    _rules.push_back(rule);
+    _outputs.push_back(output);
+}
+
+int
+IPTupleSpace::find_tuple(uint32_t src_mask, uint32_t dst_mask,
+			 uint32_t ports_mask, int32_t proto_mask)
+{
+    for (int i = 0; i < _tuples.size(); ++i) {
+	const Tuple &t = _tuples[i];
+	if (t.src_mask == src_mask && t.dst_mask == dst_mask
+	    && t.ports_mask == ports_mask && t.proto_mask == proto_mask)
+	    return i;
+    }
+    Tuple t;
+    t.src_mask = src_mask;
+    t.dst_mask = dst_mask;
+    t.ports_mask = ports_mask;
+    t.proto_mask = proto_mask;
+    t.first_rule = -1;
+    t.count = 0;
+    _tuples.push_back(t);
+    return _tuples.size() - 1;
+}
+
+void
+IPTupleSpace::insert(Tuple &t, const Entry &e)
+{
+    uint32_t m = t.table.size() - 1;
+    for (uint32_t i = hash(e.src, e.dst, e.ports, e.proto) & m; ; i = (i + 1) & m) {
+	Entry &x = t.table[i];
+	if (x.rule < 0) {
+	    x = e;
+	    return;
+	} else if (x.src == e.src && x.dst == e.dst && x.ports == e.ports
+		   && x.proto == e.proto)
+	    // an earlier rule has this key
+	    return;
+    }
+}
+
+/** @brief Build the tuples for the first @a nrules added rules.
+ * @param nrules number of rules in the whole rule set
+ * @param min_rules build nothing unless at least this many rules are covered
+ * @param default_output output for packets that match no rule
+ * @return true iff ok()
+ *
+ * Rules are covered in order until one is not ok, or until the number of
+ * keys would exceed an internal limit. */
+bool
+IPTupleSpace::build(int nrules, int min_rules, int default_output)
+{
+    _tuples.clear();
+    _default_output = default_output;
+    _nentries = 0;
+
+    Vector<Entry> entries;
+    Vector<int> entry_tuple;
+    Vector<uint32_t> sp, dp;
+    int ri;
+    for (ri = 0; ri < _rules.size() && _rules[ri].ok; ++ri) {
+	const Rule &r = _rules[ri];
+	if (r.never)
+	    continue;
+	sp.clear();
+	dp.clear();
+	range_prefixes(r.sports, r.sports_set, sp);
+	range_prefixes(r.dports, r.dports_set, dp);
+	int nproto = (r.proto == IP_PROTO_TCP_OR_UDP ? 2 : 1);
+	if (entries.size() + nproto * sp.size() * dp.size() > max_entries)
+	    break;
+	for (int pi = 0; pi < nproto; ++pi) {
+	    int32_t proto = r.proto, proto_mask = 0xFF;
+	    if (proto == IP_PROTO_TCP_OR_UDP)
+		proto = (pi == 0 ? IP_PROTO_TCP : IP_PROTO_UDP);
+	    else if (proto < 0 || proto > 255)
+		proto = proto_mask = 0;
+	    for (uint32_t *s = sp.begin(); s != sp.end(); ++s)
+		for (uint32_t *d = dp.begin(); d != dp.end(); ++d) {
+		    uint32_t ports_mask = ((*s & 0xFFFF) << 16) | (*d & 0xFFFF);
+		    Entry e;
+		    e.src = r.src & r.src_mask;
+		    e.dst = r.dst & r.dst_mask;
+		    e.ports = (*s & 0xFFFF0000U) | (*d >> 16);
+		    e.proto = proto;
+		    e.rule = ri;
+		    int ti = find_tuple(r.src_mask, r.dst_mask, ports_mask, proto_mask);
+		    if (_tuples[ti].first_rule < 0)
+			_tuples[ti].first_rule = ri;
+		    ++_tuples[ti].count;
+		    entries.push_back(e);
+		    entry_tuple.push_back(ti);
+		}
+	}
+    }
+
+    _nrules = ri;
+    _complete = (ri == nrules);
+    if (_nrules < min_rules) {
+	_tuples.clear();
+	return false;
+    }
+
+    // probe tuples in order of their first rule, so lookup can stop early
+    Vector<int> order, where(_tuples.size(), 0);
+    for (int i = 0; i < _tuples.size(); ++i) {
+	int j = order.size();
+	order.push_back(i);
+	for (; j > 0 && _tuples[order[j - 1]].first_rule > _tuples[i].first_rule; --j)
+	    order[j] = order[j - 1];
+	order[j] = i;
+    }
+    Vector<Tuple> sorted;
+    for (int i = 0; i < order.size(); ++i) {
+	sorted.push_back(_tuples[order[i]]);
+	where[order[i]] = i;
+    }
+    _tuples.swap(sorted);
+
+    for (Tuple *t = _tuples.begin(); t != _tuples.end(); ++t) {
+	int size = 4;
+	while (size < 2 * t->count)
+	    size *= 2;
+	Entry empty;
+	empty.rule = -1;
+	t->table.assign(size, empty);
+    }
+    for (int i = 0; i < entries.size(); ++i)
+	insert(_tuples[where[entry_tuple[i]]], entries[i]);
+    _nentries = entries.size();
+    return ok();
+}
+
+int
+IPTupleSpace::lookup(uint32_t src, uint32_t dst, uint32_t ports,
+		     int32_t proto) const
+{
+    int best = _nrules;
+    for (const Tuple *t = _tuples.begin(); t != _tuples.end(); ++t) {
+	if (t->first_rule >= best)
+	    break;
+	uint32_t ksrc = src & t->src_mask, kdst = dst & t->dst_mask,
+	    kports = ports & t->ports_mask;
+	int32_t kproto = proto & t->proto_mask;
+	uint32_t m = t->table.size() - 1;
+	for (uint32_t i = hash(ksrc, kdst, kports, kproto) & m; ; i = (i + 1) & m) {
+	    const Entry &x = t->table[i];
+	    if (x.rule < 0)
+		break;
+	    else if (x.src == ksrc && x.dst == kdst && x.ports == kports
+		     && x.proto == kproto) {
+		if (x.rule < best)
+		    best = x.rule;
+		break;
+	    }
+	}
+    }
+    return best < _nrules ? best : -1;
+}
+
+/** @brief Return a description of the tuples, one per line. */
+String
+IPTupleSpace::unparse() const
+{
+    StringAccum sa;
+    sa << _nrules << " rules" << (_complete ? "" : " (partial)")
+       << ", " << _tuples.size() << " tuples, " << _nentries << " keys\n";
+    for (const Tuple *t = _tuples.begin(); t != _tuples.end(); ++t) {
+	sa.snprintf(80, "src/%08x dst/%08x ports/%08x proto/%02x: ",
+		    ntohl(t->src_mask), ntohl(t->dst_mask), t->ports_mask,
+		    t->proto_mask);
+	sa << t->count << " keys, first rule " << t->first_rule << '\n';
+    }
+    return sa.take_string();
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IPTupleSpace)
@@ -0,0 +1,158 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPTUPLESPACE_HH
+#define CLICK_IPTUPLESPACE_HH
+#include <click/vector.hh>
+#include <click/string.hh>
+#include <click/packet.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+/** @class IPTupleSpace
+ * @brief Tuple-space search over a prefix of an IPFilter rule set.
+ *
+ * Each Rule is a conjunction of constraints on source and destination
+ * address (value and mask), IP protocol, and source and destination port
+ * (sets of ranges).  build() expands every rule into masked keys, one per
+ * protocol and port prefix, and groups keys with the same masks into a
+ * tuple, which is a hash table from key to the first rule with that key.
+ * classify() probes each tuple in order of its first rule and stops once no
+ * remaining tuple can hold an earlier rule, so it gives the same first-match
+ * result as testing the rules in order.
+ *
+ * IPFilter adds the longest prefix of its rules that fit this form.  When
+ * that prefix is not the whole rule set, classify() can only decide packets
+ * that match one of the prefix rules; it returns false for the rest, and for
+ * packets whose fields it cannot read the way IPFilter's program does, such
+ * as non-first fragments. */
+class IPTupleSpace { public:
+
+    struct Rule {
+	uint32_t src;		// network byte order, masked
+	uint32_t src_mask;
+	uint32_t dst;
+	uint32_t dst_mask;
+	int proto;		// -1 (any), 0-255, or IP_PROTO_TCP_OR_UDP
+	Vector<uint32_t> sports;	// (lo << 16) | hi ranges
+	Vector<uint32_t> dports;
+	bool sports_set;
+	bool dports_set;
+	bool never;
+	bool ok;
+
+	Rule() {
+	    clear();
+	}
+	void clear();
+
+	void restrict_addr(bool dst, uint32_t value, uint32_t mask);
+	void restrict_proto(int p);
+	void restrict_ports(bool dst, uint32_t lo, uint32_t hi, bool complement);
+    };
+
+    IPTupleSpace()
+	: _nrules(0), _complete(false), _nentries(0) {
+    }
+
+    void clear();
+    void add(const Rule &rule, int output);
+    bool build(int nrules, int min_rules, int default_output);
+
+    /** @brief Return true iff classify() can decide any packets. */
+    bool ok() const {
+	return _tuples.size() != 0;
+    }
+    /** @brief Return the number of rules covered. */
+    int nrules() const {
+	return _nrules;
+    }
+    /** @brief Return the number of tuples. */
+    int ntuples() const {
+	return _tuples.size();
+    }
+
+    inline bool classify(const Packet *p, int &output) const;
+
+    String unparse() const;
+
+  private:
+
+    struct Entry {
+	uint32_t src;
+	uint32_t dst;
+	uint32_t ports;
+	int32_t proto;
+	int32_t rule;		// -1 means empty
+    };
+
+    struct Tuple {
+	uint32_t src_mask;
+	uint32_t dst_mask;
+	uint32_t ports_mask;
+	int32_t proto_mask;
+	int first_rule;
+	int count;
+	Vector<Entry> table;
+    };
+
+    Vector<Rule> _rules;
+    Vector<int> _outputs;
+    Vector<Tuple> _tuples;
+    int _nrules;
+    bool _complete;
+    int _default_output;
+    int _nentries;
+
+    enum { max_entries = 1 << 20 };
+
+    static inline uint32_t hash(uint32_t src, uint32_t dst, uint32_t ports,
+				int32_t proto);
+    int find_tuple(uint32_t src_mask, uint32_t dst_mask, uint32_t ports_mask,
+		   int32_t proto_mask);
+    void insert(Tuple &t, const Entry &e);
+    int lookup(uint32_t src, uint32_t dst, uint32_t ports, int32_t proto) const;
+
+};
+
+inline uint32_t
+IPTupleSpace::hash(uint32_t src, uint32_t dst, uint32_t ports, int32_t proto)
+{
+    uint32_t h = src * 0x9E3779B1U;
+    h ^= dst + (h << 6) + (h >> 2);
+    h ^= ports * 0x85EBCA6BU + (h << 6) + (h >> 2);
+    h ^= proto;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6DU;
+    return h ^ (h >> 13);
+}
+
+/** @brief Classify @a p by the covered rules.
+ * @param p packet with network and transport headers set
+ * @param[out] output the first matching rule's output
+ * @return true iff @a output was set
+ *
+ * Returns false if @a p is not a first fragment, if its IP or transport
+ * header is too short, or if no covered rule matches and some rules are not
+ * covered. */
+inline bool
+IPTupleSpace::classify(const Packet *p, int &output) const
+{
+    if (p->network_header_length() < (int) sizeof(click_ip)
+	|| p->transport_length() < 4)
+	return false;
+    const click_ip *iph = p->ip_header();
+    if (!IP_FIRSTFRAG(iph))
+	return false;
+    const uint8_t *th = p->transport_header();
+    uint32_t ports = (th[0] << 24) | (th[1] << 16) | (th[2] << 8) | th[3];
+    int rule = lookup(iph->ip_src.s_addr, iph->ip_dst.s_addr, ports, iph->ip_p);
+    if (rule >= 0)
+	output = _outputs[rule];
+    else if (_complete)
+	output = _default_output;
+    else
+	return false;
+    return true;
+}
+
+CLICK_ENDDECLS
+#endif
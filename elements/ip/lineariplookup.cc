@@ -210,6 +210,12 @@ LinearIPLookup::dump_routes()
     return sa.take_string();
 }
 
+size_t
+LinearIPLookup::memory_usage() const
+{
+    return _t.capacity() * sizeof(IPRoute) + IPRouteTable::memory_usage();
+}
+
 void
 LinearIPLookup::push(int, Packet *p)
 {
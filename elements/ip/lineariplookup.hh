@@ -96,6 +96,7 @@ class LinearIPLookup : public IPRouteTable { public:
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     String dump_routes();
+    size_t memory_usage() const;
 
     bool check() const;
 
@@ -36,6 +36,15 @@ MarkIPHeader::configure(Vector<String> &conf, ErrorHandler *errh)
     return Args(conf, this, errh).read_p("OFFSET", _offset).complete();
 }
 
+bool
+MarkIPHeader::input_alignment(int &modulus, int &offset) const
+{
+  // align the IP header
+  modulus = 4;
+  offset = -_offset & 3;
+  return true;
+}
+
 Packet *
 MarkIPHeader::simple_action(Packet *p)
 {
@@ -31,6 +31,7 @@ class MarkIPHeader : public Element {
   const char *class_name() const		{ return "MarkIPHeader"; }
   const char *port_count() const		{ return PORTS_1_1; }
   int configure(Vector<String> &, ErrorHandler *);
+  bool input_alignment(int &modulus, int &offset) const;
 
   Packet *simple_action(Packet *);
 
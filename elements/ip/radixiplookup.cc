@@ -25,15 +25,16 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/straccum.hh>
+#include <click/router.hh>
 #include "radixiplookup.hh"
 CLICK_DECLS
 
 class RadixIPLookup::Radix { public:
 
-    static Radix *make_radix(int bitshift, int n);
-    static void free_radix(Radix *r);
+    // Nodes come from the router's arena and are freed with the router.
+    static Radix *make_radix(RadixIPLookup *owner, int bitshift, int n);
 
-    int change(uint32_t addr, uint32_t mask, int key, bool set);
+    int change(RadixIPLookup *owner, uint32_t addr, uint32_t mask, int key, bool set);
 
     static inline int lookup(const Radix *r, int cur, uint32_t addr) {
 	while (r) {
@@ -46,11 +47,32 @@ class RadixIPLookup::Radix { public:
 	return cur;
     }
 
+    // Look up n addresses.  Every address's first level is read, and its
+    // second-level entry prefetched, before any descends further; a child's
+    // index depends only on its parent's bit shift, so it is known early.
+    static inline void lookup(const Radix *r, int cur, const uint32_t *addr,
+			      int *key, int n) {
+	const Radix *next[BATCH_LANES];
+	if (!r) {
+	    for (int i = 0; i < n; ++i)
+		key[i] = cur;
+	    return;
+	}
+	for (int i = 0; i < n; ++i) {
+	    const Child &c = r->_children[(addr[i] >> r->_bitshift) & (r->_n - 1)];
+	    key[i] = c.key ? c.key : cur;
+	    if ((next[i] = c.child))
+		prefetch_entry(&c.child->_children[(addr[i] >> (r->_bitshift - 4)) & 15]);
+	}
+	for (int i = 0; i < n; ++i)
+	    if (next[i])
+		key[i] = lookup(next[i], key[i], addr[i]);
+    }
+
   private:
 
     int _bitshift;
     int _n;
-    int _nchildren;
     struct Child {
 	int key;
 	Radix *child;
@@ -74,40 +96,30 @@ class RadixIPLookup::Radix { public:
 };
 
 RadixIPLookup::Radix*
-RadixIPLookup::Radix::make_radix(int bitshift, int n)
+RadixIPLookup::Radix::make_radix(RadixIPLookup *owner, int bitshift, int n)
 {
-    if (Radix* r = (Radix*) new unsigned char[sizeof(Radix) + n * sizeof(Child) + (n - 2) * sizeof(int)]) {
+    size_t size = sizeof(Radix) + n * sizeof(Child) + (n - 2) * sizeof(int);
+    if (Radix* r = (Radix*) owner->router()->arena_allocate(size)) {
+	owner->_radix_bytes += size;
 	r->_bitshift = bitshift;
 	r->_n = n;
-	r->_nchildren = 0;
 	memset(r->_children, 0, n * sizeof(Child) + (n - 2) * sizeof(int));
 	return r;
     } else
 	return 0;
 }
 
-void
-RadixIPLookup::Radix::free_radix(Radix* r)
-{
-    if (r->_nchildren)
-	for (int i = 0; i < r->_n; i++)
-	    if (r->_children[i].child)
-		free_radix(r->_children[i].child);
-    delete[] (unsigned char *)r;
-}
-
 int
-RadixIPLookup::Radix::change(uint32_t addr, uint32_t mask, int key, bool set)
+RadixIPLookup::Radix::change(RadixIPLookup *owner, uint32_t addr, uint32_t mask, int key, bool set)
 {
     int i1 = (addr >> _bitshift) & (_n - 1);
 
     // check if change only affects children
     if (mask & ((1U << _bitshift) - 1)) {
-	if (!_children[i1].child
-	    && (_children[i1].child = make_radix(_bitshift - 4, 16)))
-	    ++_nchildren;
+	if (!_children[i1].child)
+	    _children[i1].child = make_radix(owner, _bitshift - 4, 16);
 	if (_children[i1].child)
-	    return _children[i1].child->change(addr, mask, key, set);
+	    return _children[i1].child->change(owner, addr, mask, key, set);
 	else
 	    return 0;
     }
@@ -135,7 +147,7 @@ RadixIPLookup::Radix::change(uint32_t addr, uint32_t mask, int key, bool set)
 
 
 RadixIPLookup::RadixIPLookup()
-    : _vfree(-1), _default_key(0), _radix(Radix::make_radix(24, 256))
+    : _vfree(-1), _default_key(0), _radix(0), _radix_bytes(0)
 {
 }
 
@@ -144,12 +156,20 @@ RadixIPLookup::~RadixIPLookup()
 }
 
 
+int
+RadixIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (!(_radix = Radix::make_radix(this, 24, 256)))
+	return errh->error("out of memory");
+    return IPRouteTable::configure(conf, errh);
+}
+
 void
 RadixIPLookup::cleanup(CleanupStage)
 {
     _v.clear();
-    Radix::free_radix(_radix);
     _radix = 0;
+    _radix_bytes = 0;
 }
 
 
@@ -165,6 +185,13 @@ RadixIPLookup::dump_routes()
     return sa.take_string();
 }
 
+size_t
+RadixIPLookup::memory_usage() const
+{
+    return _v.capacity() * sizeof(IPRoute) + _radix_bytes
+	+ IPRouteTable::memory_usage();
+}
+
 
 int
 RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *)
@@ -173,7 +200,7 @@ RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, Err
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
-	last_key = _radix->change(addr, mask, found + 1, set);
+	last_key = _radix->change(this, addr, mask, found + 1, set);
     } else {
 	last_key = _default_key;
 	if (!last_key || set)
@@ -209,7 +236,7 @@ RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandl
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	// NB: this will never actually make changes
-	last_key = _radix->change(addr, mask, 0, false);
+	last_key = _radix->change(this, addr, mask, 0, false);
     } else
 	last_key = _default_key;
 
@@ -223,7 +250,7 @@ RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandl
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
-	(void) _radix->change(addr, mask, 0, true);
+	(void) _radix->change(this, addr, mask, 0, true);
     } else
 	_default_key = 0;
     return 0;
@@ -242,6 +269,28 @@ RadixIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
     }
 }
 
+void
+RadixIPLookup::lookup_routes(int n, const IPAddress *addr, IPAddress *gw, int *port) const
+{
+    uint32_t a[BATCH_LANES];
+    int key[BATCH_LANES];
+    for (; n > 0; n -= BATCH_LANES, addr += BATCH_LANES,
+	     gw += BATCH_LANES, port += BATCH_LANES) {
+	int m = (n < BATCH_LANES ? n : BATCH_LANES);
+	for (int i = 0; i < m; ++i)
+	    a[i] = ntohl(addr[i].addr());
+	Radix::lookup(_radix, _default_key, a, key, m);
+	for (int i = 0; i < m; ++i)
+	    if (key[i]) {
+		gw[i] = _v[key[i] - 1].gw;
+		port[i] = _v[key[i] - 1].port;
+	    } else {
+		gw[i] = 0;
+		port[i] = -1;
+	    }
+    }
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(IPRouteTable)
 EXPORT_ELEMENT(RadixIPLookup)
@@ -19,7 +19,9 @@ IP lookup using a radix trie
 
 Performs IP lookup using a radix trie.  The first level of the trie has 256
 buckets; each succeeding level has 16.  The maximum number of levels that will
-be traversed is thus 7.
+be traversed is thus 7.  When packets arrive in a batch, RadixIPLookup
+reads the first level for up to 16 destinations, and prefetches each one's
+second-level entry, before descending further for any of them.
 
 Expects a destination IP address annotation with each packet. Looks up that
 address in its routing table, using longest-prefix-match, sets the destination
@@ -77,12 +79,15 @@ class RadixIPLookup : public IPRouteTable { public:
     const char *port_count() const		{ return "1/-"; }
     const char *processing() const		{ return PUSH; }
 
+    int configure(Vector<String> &conf, ErrorHandler *errh);
     void cleanup(CleanupStage);
 
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_routes(int n, const IPAddress *addr, IPAddress *gw, int *port) const;
     String dump_routes();
+    size_t memory_usage() const;
 
   private:
 
@@ -94,6 +99,7 @@ class RadixIPLookup : public IPRouteTable { public:
 
     int _default_key;
     Radix *_radix;
+    size_t _radix_bytes;	// allocated to _radix
 
 };
 
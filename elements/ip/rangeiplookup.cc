@@ -26,15 +26,16 @@
 #include <click/error.hh>
 CLICK_DECLS
 
-RangeIPLookup::RangeIPLookup()
+// RANGEIPLOOKUP::TABLE
+
+RangeIPLookup::Table::Table()
     : _range_base((uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t))),
       _range_len((uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t))),
-      _range_t((uint32_t *) CLICK_LALLOC(RANGES_MAX * sizeof(uint32_t))),
-      _active(false)
+      _range_t((uint32_t *) CLICK_LALLOC(RANGES_MAX * sizeof(uint32_t)))
 {
 }
 
-RangeIPLookup::~RangeIPLookup()
+RangeIPLookup::Table::~Table()
 {
     CLICK_LFREE(_range_base, (1 << KICKSTART_BITS) * sizeof(uint32_t));
     CLICK_LFREE(_range_len, (1 << KICKSTART_BITS) * sizeof(uint32_t));
@@ -42,19 +43,118 @@ RangeIPLookup::~RangeIPLookup()
 }
 
 int
-RangeIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+RangeIPLookup::Table::initialize()
 {
     int r;
+    if (!_range_base || !_range_len || !_range_t)
+	return -ENOMEM;
     if ((r = _helper.initialize()) < 0)
 	return r;
-    flush_table();
+    flush();
+    return 0;
+}
+
+void
+RangeIPLookup::Table::flush()
+{
+    _helper.flush();
+    memset(_range_base, 0, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memset(_range_len, 0, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memset(_range_t, 0, RANGES_MAX * sizeof(uint32_t));
+}
+
+/*
+ * On each routing table update, we distill the address range based lookup
+ * table from the structures provided by the DirectIPLookup class.
+ * The main cost of this operation is associated with traversing through
+ * 32 + 16 = 48 MBytes of directiplookup tables.  We should implement a
+ * more efficient method for updating range-based lookup structures in
+ * the future, which would not depend on huge directiplookup tables.
+ */
+void
+RangeIPLookup::Table::expand()
+{
+    uint32_t range_t_index = 0;
+    uint32_t tbl_0_23_index = 0;
+    uint32_t range_base;
+    uint32_t range_len;
+
+    for (range_base = 0; range_base < (1 << KICKSTART_BITS); range_base++) {
+	uint16_t vport_i, vport_i1;
+
+	vport_i = 0xffff;       // Duh!
+	_range_base[range_base] = range_t_index;
+
+	for (range_len = 0;
+	  tbl_0_23_index < ((range_base + 1) << (24 - KICKSTART_BITS));
+	  tbl_0_23_index++) {
+	    if (_helper._tbl_0_23[tbl_0_23_index] & 0x8000) {
+		uint32_t tbl_24_31_index, j;
+		tbl_24_31_index =
+			(_helper._tbl_0_23[tbl_0_23_index] & 0x7fff) << 8;
+		for (j = 0; j < 256; j++) {
+		    vport_i1 = _helper._tbl_24_31[tbl_24_31_index + j];
+		    if (vport_i != vport_i1) {
+			vport_i = vport_i1;
+			_range_t[range_t_index] =
+					vport_i << (32 - KICKSTART_BITS) |
+					(((tbl_0_23_index << 8) + j) &
+					(0xffffffff >> KICKSTART_BITS));
+			range_t_index++;
+			range_len++;
+		    }
+		}
+	    } else {
+		vport_i1 = _helper._tbl_0_23[tbl_0_23_index];
+		if (vport_i != vport_i1) {
+		    vport_i = vport_i1;
+		    _range_t[range_t_index] =
+					vport_i << (32 - KICKSTART_BITS) |
+					((tbl_0_23_index << 8) &
+					(0xffffffff >> KICKSTART_BITS));
+		    range_t_index++;
+		    range_len++;
+		}
+	    }
+	}
+	_range_len[range_base] = range_len - 1;
+    }
+
+#ifdef RANGEIPLOOKUP_VERBOSE
+    click_chatter("Range expansion done: %d ranges using %d + %d bytes",
+		  range_t_index, sizeof(_range_base) + sizeof(_range_len),
+		  range_t_index * sizeof(uint32_t));
+#endif
+}
+
+
+// RANGEIPLOOKUP
+
+RangeIPLookup::RangeIPLookup()
+    : _t(new Table), _active(false)
+{
+}
+
+RangeIPLookup::~RangeIPLookup()
+{
+    delete _t;
+}
+
+int
+RangeIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    int r;
+    if (!_t)
+	return -ENOMEM;
+    if ((r = _t->initialize()) < 0)
+	return r;
     return IPRouteTable::configure(conf, errh);
 }
 
 int
 RangeIPLookup::initialize(ErrorHandler *)
 {
-    expand();
+    _t->expand();
     _active = true;
     return 0;
 }
@@ -62,7 +162,9 @@ RangeIPLookup::initialize(ErrorHandler *)
 void
 RangeIPLookup::cleanup(CleanupStage)
 {
-    _helper.cleanup();
+    reclaim_tables(true);
+    if (_t)
+	_t->_helper.cleanup();
 }
 
 void
@@ -74,7 +176,7 @@ RangeIPLookup::push(int, Packet *p)
 #ifdef RANGEIPLOOKUP_VERBOSE
     // Consistency check - does directiplookup yied the same result?
     IPAddress gw1;
-    int port1 = _helper.lookup_route(p->dst_ip_anno(), gw1);
+    int port1 = _t->_helper.lookup_route(p->dst_ip_anno(), gw1);
     if (port != port1 || gw != gw1)
 	click_chatter("RangeIPLookup: consistency check failed!");
 #endif
@@ -90,21 +192,22 @@ RangeIPLookup::push(int, Packet *p)
 int
 RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const Table *t = _t;
     uint32_t ip_addr = ntohl(dest.addr());
     uint32_t lowerbound, upperbound, middle;
     uint32_t i = ip_addr >> RANGE_SHIFT; // kickstart table index = MS bits
     uint16_t vport_i;
 
-    lowerbound = _range_base[i];
-    upperbound = lowerbound + _range_len[i];
+    lowerbound = t->_range_base[i];
+    upperbound = lowerbound + t->_range_len[i];
     i = ip_addr & RANGE_MASK;		// Compare only masked LS bits
 
     // Binary search for a matching range
     while (upperbound > lowerbound) {
 	middle = (upperbound + lowerbound) >> 1;
-	if (i < (_range_t[middle] & RANGE_MASK))
+	if (i < (t->_range_t[middle] & RANGE_MASK))
 	    upperbound = middle;
-	else if (i < (_range_t[middle + 1] & RANGE_MASK)) {
+	else if (i < (t->_range_t[middle + 1] & RANGE_MASK)) {
 	    lowerbound = middle;
 	    break;
 	} else
@@ -112,9 +215,46 @@ RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
     }
 
     // MS bits of the found range contain an index into the output port table
-    vport_i = _range_t[lowerbound] >> RANGE_SHIFT;
-    gw = _helper._vport[vport_i].gw;
-    return _helper._vport[vport_i].port;
+    vport_i = t->_range_t[lowerbound] >> RANGE_SHIFT;
+    gw = t->_helper._vport[vport_i].gw;
+    return t->_helper._vport[vport_i].port;
+}
+
+void
+RangeIPLookup::lookup_routes(int n, const IPAddress *addr, IPAddress *gw, int *port) const
+{
+    const Table *t = _t;
+    const uint32_t *range_t = t->_range_t;
+    uint32_t lowerbound[BATCH_LANES], upperbound[BATCH_LANES];
+    for (; n > 0; n -= BATCH_LANES, addr += BATCH_LANES,
+	     gw += BATCH_LANES, port += BATCH_LANES) {
+	int m = (n < BATCH_LANES ? n : BATCH_LANES);
+	// Fetch every lane's kickstart entry and first probe up front; the
+	// binary searches then run one lane at a time.
+	for (int i = 0; i < m; ++i) {
+	    uint32_t k = ntohl(addr[i].addr()) >> RANGE_SHIFT;
+	    lowerbound[i] = t->_range_base[k];
+	    upperbound[i] = lowerbound[i] + t->_range_len[k];
+	    prefetch_entry(&range_t[(lowerbound[i] + upperbound[i]) >> 1]);
+	}
+	for (int i = 0; i < m; ++i) {
+	    uint32_t key = ntohl(addr[i].addr()) & RANGE_MASK;
+	    uint32_t lo = lowerbound[i], hi = upperbound[i];
+	    while (hi > lo) {
+		uint32_t middle = (hi + lo) >> 1;
+		if (key < (range_t[middle] & RANGE_MASK))
+		    hi = middle;
+		else if (key < (range_t[middle + 1] & RANGE_MASK)) {
+		    lo = middle;
+		    break;
+		} else
+		    lo = middle + 1;
+	    }
+	    uint16_t vport_i = range_t[lo] >> RANGE_SHIFT;
+	    gw[i] = t->_helper._vport[vport_i].gw;
+	    port[i] = t->_helper._vport[vport_i].port;
+	}
+    }
 }
 
 void
@@ -127,92 +267,48 @@ RangeIPLookup::add_handlers()
 int
 RangeIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    int error = _helper.add_route(route, allow_replace, old_route, errh);
+    int error = _t->_helper.add_route(route, allow_replace, old_route, errh);
     if (error == 0 && _active)
-	expand();
+	_t->expand();
     return error;
 }
 
 int
 RangeIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    int error = _helper.remove_route(route, old_route, errh);
+    int error = _t->_helper.remove_route(route, old_route, errh);
     if (error == 0 && _active)
-	expand();
+	_t->expand();
     return error;
 }
 
-/*
- * On each routing table update, we distill the address range based lookup
- * table from the structures provided by the DirectIPLookup class.
- * The main cost of this operation is associated with traversing through
- * 32 + 16 = 48 MBytes of directiplookup tables.  We should implement a
- * more efficient method for updating range-based lookup structures in
- * the future, which would not depend on huge directiplookup tables.
- */
 void
-RangeIPLookup::expand()
+RangeIPLookup::destroy_table(void *t)
 {
-    uint32_t range_t_index = 0;
-    uint32_t tbl_0_23_index = 0;
-    uint32_t range_base;
-    uint32_t range_len;
-
-    for (range_base = 0; range_base < (1 << KICKSTART_BITS); range_base++) {
-	uint16_t vport_i, vport_i1;
-
-	vport_i = 0xffff;       // Duh!
-	_range_base[range_base] = range_t_index;
-
-	for (range_len = 0;
-	  tbl_0_23_index < ((range_base + 1) << (24 - KICKSTART_BITS));
-	  tbl_0_23_index++) {
-	    if (_helper._tbl_0_23[tbl_0_23_index] & 0x8000) {
-		uint32_t tbl_24_31_index, j;
-		tbl_24_31_index =
-			(_helper._tbl_0_23[tbl_0_23_index] & 0x7fff) << 8;
-		for (j = 0; j < 256; j++) {
-		    vport_i1 = _helper._tbl_24_31[tbl_24_31_index + j];
-		    if (vport_i != vport_i1) {
-			vport_i = vport_i1;
-			_range_t[range_t_index] =
-					vport_i << (32 - KICKSTART_BITS) |
-					(((tbl_0_23_index << 8) + j) &
-					(0xffffffff >> KICKSTART_BITS));
-			range_t_index++;
-			range_len++;
-		    }
-		}
-	    } else {
-		vport_i1 = _helper._tbl_0_23[tbl_0_23_index];
-		if (vport_i != vport_i1) {
-		    vport_i = vport_i1;
-		    _range_t[range_t_index] =
-					vport_i << (32 - KICKSTART_BITS) |
-					((tbl_0_23_index << 8) &
-					(0xffffffff >> KICKSTART_BITS));
-		    range_t_index++;
-		    range_len++;
-		}
-	    }
-	}
-	_range_len[range_base] = range_len - 1;
-    }
-
-#ifdef RANGEIPLOOKUP_VERBOSE
-    click_chatter("Range expansion done: %d ranges using %d + %d bytes",
-		  range_t_index, sizeof(_range_base) + sizeof(_range_len),
-		  range_t_index * sizeof(uint32_t));
-#endif
+    delete static_cast<Table *>(t);
 }
 
-void
-RangeIPLookup::flush_table()
+int
+RangeIPLookup::replace_routes(const Vector<IPRoute> &routes, ErrorHandler *errh)
 {
-    _helper.flush();
-    memset(_range_base, 0, sizeof(_range_base));
-    memset(_range_len, 0, sizeof(_range_len));
-    memset(_range_t, 0, sizeof(_range_t));
+    // Fill a new helper table and expand it once, then publish the result
+    // with one store.
+    Table *t = new Table;
+    int r = (t ? t->initialize() : -ENOMEM);
+    for (const IPRoute *rt = routes.begin(); rt != routes.end() && r >= 0; ++rt)
+	if ((r = t->_helper.add_route(*rt, true, 0, errh)) == -ENOMEM)
+	    errh->error("no memory to store route %<%s%>", rt->unparse().c_str());
+    if (r < 0) {
+	delete t;
+	return r;
+    }
+    if (_active)
+	t->expand();
+    click_fence();
+    Table *old_t = _t;
+    _t = t;
+    retire_table(old_t, destroy_table);
+    return 0;
 }
 
 int
@@ -220,14 +316,24 @@ RangeIPLookup::flush_handler(const String &, Element *e, void *,
                                 ErrorHandler *)
 {
     RangeIPLookup *t = static_cast<RangeIPLookup *>(e);
-    t->flush_table();
+    t->_table_lock.acquire();
+    t->_t->flush();
+    t->_table_lock.release();
     return 0;
 }
 
 String
 RangeIPLookup::dump_routes()
 {
-    return _helper.dump();
+    return _t->_helper.dump();
+}
+
+size_t
+RangeIPLookup::memory_usage() const
+{
+    return sizeof(Table) - sizeof(DirectIPLookup::Table)
+	+ (2 * (1 << KICKSTART_BITS) + RANGES_MAX) * sizeof(uint32_t)
+	+ _t->_helper.memory() + IPRouteTable::memory_usage();
 }
 
 CLICK_ENDDECLS
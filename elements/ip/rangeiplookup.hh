@@ -38,6 +38,10 @@ RangeIPLookup maintains a large DirectIPLookup table as well as its own
 tables.  Although this subsidiary table is only accessed during route updates,
 it significantly adds to RangeIPLookup's total memory footprint.
 
+When packets arrive in a batch, RangeIPLookup reads the kickstart entries for
+up to 16 destinations, and prefetches each one's first binary search probe,
+before searching any of them.
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -70,6 +74,26 @@ operation.
 
 Clears the entire routing table in a single atomic operation.
 
+=h load read/write
+
+When written, parses routes, one per line in the `C<ADDR/MASK [GW] OUT>'
+format, and saves them for a later C<commit>; a bad line rejects the whole
+write.  Several writes may be made in a row.  Returns the number of routes
+saved.
+
+=h commit write-only
+
+Replaces the routing table with the routes saved by C<load>.  Whereas each
+C<add> or C<remove> re-expands the lookup structure, C<commit> fills a new
+DirectIPLookup table and expands it once, all in separate memory, and
+installs the result by a single pointer store; lookups see either the old
+table or the new one.  The old table is freed at a later commit or at
+cleanup, after a one-second grace period.
+
+=h abort write-only
+
+Forgets the routes saved by C<load>.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -98,26 +122,39 @@ class RangeIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
+    void lookup_routes(int n, const IPAddress *addr, IPAddress *gw, int *port) const;
     String dump_routes();
+    int replace_routes(const Vector<IPRoute> &, ErrorHandler *);
+    size_t memory_usage() const;
 
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
   protected:
 
-    void flush_table();
-    void expand();
-
     enum { KICKSTART_BITS = 12 };
     enum { RANGES_MAX = 256 * 1024 };
     enum { RANGE_MASK = 0xffffffff >> KICKSTART_BITS };
     enum { RANGE_SHIFT = 32 - KICKSTART_BITS };
 
-    uint32_t *_range_base;
-    uint32_t *_range_len;
-    uint32_t *_range_t;
+    struct Table {
+	uint32_t *_range_base;
+	uint32_t *_range_len;
+	uint32_t *_range_t;
+
+	DirectIPLookup::Table _helper;
+
+	Table();
+	~Table();
+
+	int initialize();
+	void flush();
+	void expand();
+    };
+
+    Table * volatile _t;
     bool _active;
 
-    DirectIPLookup::Table _helper;
+    static void destroy_table(void *);
 
 };
 
@@ -57,6 +57,22 @@ SetIPChecksum::simple_action(Packet *p_in)
     return 0;
 }
 
+void
+SetIPChecksum::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+SetIPChecksum::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(SetIPChecksum)
 ELEMENT_MT_SAFE(SetIPChecksum)
@@ -28,6 +28,8 @@ public:
   const char *port_count() const		{ return PORTS_1_1; }
 
   Packet *simple_action(Packet *);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, PacketBatch &batch, int max);
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,299 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * tunnelendpoint.{cc,hh} -- VXLAN and GRE tunnel endpoint
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tunnelendpoint.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <clicknet/ether.h>
+#include "elements/standard/classification.hh"
+CLICK_DECLS
+
+TunnelEndpoint::TunnelEndpoint()
+    : _drops(0)
+{
+    _id = 0;
+}
+
+TunnelEndpoint::~TunnelEndpoint()
+{
+}
+
+int
+TunnelEndpoint::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String type;
+    Vector<String> tunnels;
+    uint16_t dport = VXLAN_PORT, sport = 0;
+    int ttl = 64;
+    if (Args(conf, this, errh)
+	.read_mp("TYPE", WordArg(), type)
+	.read_mp("SRC", _src)
+	.read_all_with("TUNNEL", AnyArg(), tunnels)
+	.read("DPORT", IPPortArg(IP_PROTO_UDP), dport)
+	.read("SPORT", IPPortArg(IP_PROTO_UDP), sport)
+	.read("TTL", ttl)
+	.complete() < 0)
+	return -1;
+
+    if (type.equals("VXLAN", 5)) {
+	_type = type_vxlan;
+	_hlen = sizeof(VXLANHeader);
+    } else if (type.equals("GRE", 3)) {
+	_type = type_gre;
+	_hlen = sizeof(GREHeader);
+    } else
+	return errh->error("TYPE must be VXLAN or GRE");
+    if (ttl < 1 || ttl > 255)
+	return errh->error("TTL out of range");
+    if (tunnels.size() != noutputs() - 1)
+	return errh->error("need %d TUNNEL arguments, one per port after 0", noutputs() - 1);
+    _dport = htons(dport);
+    _sport = htons(sport);
+
+    _tunnels.clear();
+    _ports.clear();
+    for (int i = 0; i < tunnels.size(); ++i) {
+	Tunnel t;
+	memset(&t.hdr, 0, sizeof(t.hdr));
+	t.sent_packets = t.sent_bytes = t.received_packets = t.received_bytes = 0;
+	if (Args(this, errh).push_back_words(tunnels[i])
+	    .read_mp("ID", t.id)
+	    .read_mp("REMOTE", t.remote)
+	    .complete() < 0)
+	    return -1;
+	if (_type == type_vxlan && t.id >= (1U << 24))
+	    return errh->error("TUNNEL %d: VNI %u out of range", i + 1, t.id);
+	if (_ports.get(t.id))
+	    return errh->error("TUNNEL %d: ID %u already used", i + 1, t.id);
+	_ports.set(t.id, i + 1);
+
+	// build the header template; ip_len and ip_id are filled per packet
+	click_ip &ip = t.hdr.vxlan.ip;
+	ip.ip_v = 4;
+	ip.ip_hl = sizeof(click_ip) >> 2;
+	ip.ip_ttl = ttl;
+	ip.ip_src = _src;
+	ip.ip_dst = t.remote;
+	if (_type == type_vxlan) {
+	    ip.ip_p = IP_PROTO_UDP;
+	    t.hdr.vxlan.udp.uh_sport = _sport;
+	    t.hdr.vxlan.udp.uh_dport = _dport;
+	    t.hdr.vxlan.vxlan.vx_flags = htonl(VXLAN_FLAG_VNI);
+	    t.hdr.vxlan.vxlan.vx_vni = htonl(t.id << 8);
+	} else {
+	    ip.ip_p = IP_PROTO_GRE;
+	    t.hdr.gre.gre.gre_flags = htons(GRE_FLAG_KEY);
+	    t.hdr.gre.gre.gre_proto = htons(GRE_PROTO_TEB);
+	    t.hdr.gre.key = htonl(t.id);
+	}
+	ip.ip_sum = click_in_cksum((unsigned char *) &ip, sizeof(click_ip));
+	_tunnels.push_back(t);
+    }
+    return 0;
+}
+
+inline Packet *
+TunnelEndpoint::encap(Tunnel &t, Packet *p_in, uint32_t id)
+{
+    uint32_t inner_length = p_in->length();
+    WritablePacket *p = p_in->push(_hlen);
+    if (!p)
+	return 0;
+    click_ip *ip = reinterpret_cast<click_ip *>(p->data());
+    memcpy(ip, &t.hdr, _hlen);
+    ip->ip_len = htons(p->length());
+    ip->ip_id = htons(id);
+    click_update_in_cksum(&ip->ip_sum, 0, ip->ip_len);
+    click_update_in_cksum(&ip->ip_sum, 0, ip->ip_id);
+
+    if (_type == type_vxlan) {
+	click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
+	udp->uh_ulen = htons(p->length() - sizeof(click_ip));
+	if (!_sport && inner_length >= 12) {
+	    // hash the inner Ethernet addresses into the dynamic port range
+	    uint32_t a[3];
+	    memcpy(a, p->data() + _hlen, sizeof(a));
+	    uint32_t h = a[0] ^ a[1] ^ a[2];
+	    h ^= h >> 16;
+	    udp->uh_sport = htons(0xC000 | (h & 0x3FFF));
+	}
+    }
+
+    p->set_ip_header(ip, sizeof(click_ip));
+    p->set_dst_ip_anno(t.remote);
+    ++t.sent_packets;
+    t.sent_bytes += inner_length;
+    return p;
+}
+
+// Strips p's outer headers in place.  Returns the tunnel's port, or 0 if
+// p should be dropped.
+inline int
+TunnelEndpoint::decap(Packet *p)
+{
+    const click_ip *ip = reinterpret_cast<const click_ip *>(p->data());
+    if (p->length() < sizeof(click_ip) || ip->ip_v != 4)
+	return 0;
+    unsigned hl = ip->ip_hl << 2;
+    unsigned len = ntohs(ip->ip_len);
+    if (hl < sizeof(click_ip) || len < hl || len > p->length()
+	|| (ip->ip_off & htons(IP_MF | IP_OFFMASK))
+	|| click_in_cksum(p->data(), hl) != 0)
+	return 0;
+
+    const unsigned char *th = p->data() + hl;
+    unsigned tlen = len - hl;
+    uint32_t id;
+    if (_type == type_vxlan) {
+	const click_udp *udp = reinterpret_cast<const click_udp *>(th);
+	const click_vxlan *vx = reinterpret_cast<const click_vxlan *>(udp + 1);
+	if (ip->ip_p != IP_PROTO_UDP
+	    || tlen < sizeof(click_udp) + sizeof(click_vxlan)
+	    || udp->uh_dport != _dport
+	    || !(vx->vx_flags & htonl(VXLAN_FLAG_VNI)))
+	    return 0;
+	id = ntohl(vx->vx_vni) >> 8;
+	hl += sizeof(click_udp) + sizeof(click_vxlan);
+    } else {
+	const click_gre *gre = reinterpret_cast<const click_gre *>(th);
+	if (ip->ip_p != IP_PROTO_GRE || tlen < sizeof(click_gre))
+	    return 0;
+	uint16_t flags = ntohs(gre->gre_flags);
+	if ((flags & (GRE_FLAG_ROUTING | GRE_VERSION_MASK))
+	    || gre->gre_proto != htons(GRE_PROTO_TEB))
+	    return 0;
+	unsigned off = sizeof(click_gre) + (flags & GRE_FLAG_CSUM ? 4 : 0);
+	id = 0;
+	if (flags & GRE_FLAG_KEY) {
+	    if (tlen < off + 4)
+		return 0;
+	    uint32_t key;
+	    memcpy(&key, th + off, 4);
+	    id = ntohl(key);
+	    off += 4;
+	}
+	if (flags & GRE_FLAG_SEQ)
+	    off += 4;
+	if (tlen < off)
+	    return 0;
+	hl += off;
+    }
+
+    int port = _ports.get(id);
+    if (!port || len < hl + sizeof(click_ether))
+	return 0;
+    Tunnel &t = _tunnels[port - 1];
+    if (ip->ip_src.s_addr != t.remote.addr())
+	return 0;
+
+    // the inner frame stays where it is
+    if (len < p->length())
+	p->take(p->length() - len);
+    p->pull(hl);
+    p->set_mac_header(p->data(), sizeof(click_ether));
+    ++t.received_packets;
+    t.received_bytes += p->length();
+    return port;
+}
+
+void
+TunnelEndpoint::push(int port, Packet *p)
+{
+    if (port == 0) {
+	if (int out = decap(p))
+	    output(out).push(p);
+	else {
+	    ++_drops;
+	    p->kill();
+	}
+    } else if (Packet *q = encap(_tunnels[port - 1], p, _id.fetch_and_add(1)))
+	output(0).push(q);
+}
+
+void
+TunnelEndpoint::push_batch(int port, PacketBatch &batch)
+{
+    if (port == 0) {
+	enum { max_run = 64 };
+	Packet *p[max_run];
+	int outputs[max_run];
+	while (!batch.empty()) {
+	    int n = 0;
+	    for (; n < max_run && !batch.empty(); ++n) {
+		p[n] = batch.pop_front();
+		if (!(outputs[n] = decap(p[n]))) {
+		    ++_drops;
+		    outputs[n] = noutputs();	// killed
+		}
+	    }
+	    Classification::push_batch_by_output(this, p, outputs, n);
+	}
+    } else {
+	// reserve the whole batch's IP IDs at once
+	Tunnel &t = _tunnels[port - 1];
+	uint32_t id = _id.fetch_and_add(batch.count());
+	PacketBatch out;
+	while (Packet *p = batch.pop_front())
+	    if (Packet *q = encap(t, p, id++))
+		out.push_back(q);
+	output(0).push_batch(out);
+    }
+}
+
+String
+TunnelEndpoint::read_handler(Element *e, void *thunk)
+{
+    TunnelEndpoint *te = static_cast<TunnelEndpoint *>(e);
+    switch ((uintptr_t) thunk) {
+    case h_stats: {
+	StringAccum sa;
+	for (int i = 0; i < te->_tunnels.size(); ++i) {
+	    const Tunnel &t = te->_tunnels[i];
+	    sa << (i + 1) << ' ' << t.id << ' ' << t.remote << ' '
+	       << t.sent_packets << ' ' << t.sent_bytes << ' '
+	       << t.received_packets << ' ' << t.received_bytes << '\n';
+	}
+	return sa.take_string();
+    }
+    case h_drops:
+	return String(te->_drops);
+    default:
+	return String();
+    }
+}
+
+int
+TunnelEndpoint::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    TunnelEndpoint *te = static_cast<TunnelEndpoint *>(e);
+    for (Tunnel *t = te->_tunnels.begin(); t != te->_tunnels.end(); ++t)
+	t->sent_packets = t->sent_bytes = t->received_packets = t->received_bytes = 0;
+    te->_drops = 0;
+    return 0;
+}
+
+void
+TunnelEndpoint::add_handlers()
+{
+    add_read_handler("stats", read_handler, h_stats);
+    add_read_handler("drops", read_handler, h_drops);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(Classification)
+EXPORT_ELEMENT(TunnelEndpoint)
@@ -0,0 +1,168 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TUNNELENDPOINT_HH
+#define CLICK_TUNNELENDPOINT_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/hashtable.hh>
+#include <click/ipaddress.hh>
+#include <click/packetbatch.hh>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+#include <clicknet/vxlan.h>
+#include <clicknet/gre.h>
+CLICK_DECLS
+
+/*
+=c
+
+TunnelEndpoint(TYPE, SRC, I<keywords> TUNNEL, DPORT, SPORT, TTL)
+
+=s ip
+
+terminates VXLAN or GRE tunnels
+
+=d
+
+Connects several tenant networks to the IP network through Ethernet-in-IP
+tunnels.  TYPE is C<VXLAN> (Ethernet in UDP, RFC 7348) or C<GRE> (Ethernet in
+GRE with a key, RFC 2890).  SRC is the local tunnel address.
+
+Each TUNNEL argument, C<TUNNEL I<id> I<remote>>, defines one tunnel: its VNI
+(VXLAN) or key (GRE), and the address of its remote endpoint.  The I<n>th
+TUNNEL belongs to port I<n>, counting from 1.  TunnelEndpoint has one more
+input and output than it has tunnels.
+
+Input 0 takes IP packets from the network, without link-level headers.
+TunnelEndpoint checks each packet's IP header, finds its tunnel by VNI or key
+in a hash table, and strips the outer headers in place, without copying.  The
+inner Ethernet frame goes to the tunnel's output.  Packets that are malformed,
+fragmented, for an unknown tunnel, or not from the tunnel's remote endpoint
+are dropped and counted.
+
+Input I<n> takes Ethernet frames for tunnel I<n>.  TunnelEndpoint prepends the
+outer headers, copied from a per-tunnel template, updates the IP checksum
+incrementally for the length and IP ID, sets the destination address
+annotation to the remote endpoint, and emits the IP packet on output 0.
+VXLAN packets have no UDP checksum; their source port is a hash of the inner
+Ethernet addresses, unless SPORT is given, so that the network spreads tunnel
+flows over its paths.
+
+Batches are decapsulated and encapsulated as a unit, and decapsulated packets
+for the same tunnel leave in one batch.  This element replaces the
+IPClassifier, Strip, CheckIPHeader, and Classifier elements of a hand-built
+decapsulation path, and the UDPIPEncap or IPEncap of an encapsulation path.
+
+Keyword arguments are:
+
+=over 8
+
+=item TUNNEL
+
+A tunnel, C<I<id> I<remote>>, as above.  May be given more than once.
+
+=item DPORT
+
+VXLAN only.  UDP port for tunnel packets, both sent and received.  Default is
+4789.
+
+=item SPORT
+
+VXLAN only.  UDP source port for sent packets.  Default is 0, which means a
+hash of each packet's inner Ethernet addresses.
+
+=item TTL
+
+Time to live of sent packets.  Default is 64.
+
+=back
+
+=h stats read-only
+
+Returns one line per tunnel: the tunnel's port, ID, and remote endpoint, then
+the number of packets and bytes sent and of packets and bytes received.
+Bytes count the inner frames.
+
+=h drops read-only
+
+Returns the number of received packets dropped.
+
+=h reset_counts write-only
+
+Resets all counts to zero.
+
+=e
+
+  te :: TunnelEndpoint(VXLAN, 10.0.0.1,
+                       TUNNEL 100 10.0.0.2, TUNNEL 200 10.0.0.3);
+  FromDevice(eth0) -> Strip(14) -> [0]te;
+  te[0] -> EtherEncap(0x0800, eth0, 00:11:22:33:44:55) -> Queue -> ToDevice(eth0);
+  FromDevice(tenant1) -> [1]te[1] -> Queue -> ToDevice(tenant1);
+  FromDevice(tenant2) -> [2]te[2] -> Queue -> ToDevice(tenant2);
+
+=a UDPIPEncap, IPEncap, Strip, EtherEncap */
+
+class TunnelEndpoint : public Element { public:
+
+    TunnelEndpoint();
+    ~TunnelEndpoint();
+
+    const char *class_name() const	{ return "TunnelEndpoint"; }
+    const char *port_count() const	{ return "2-/="; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int encap_headroom() const		{ return _hlen; }
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+  private:
+
+    enum { type_vxlan, type_gre };
+
+    struct VXLANHeader {
+	click_ip ip;
+	click_udp udp;
+	click_vxlan vxlan;
+    };
+    struct GREHeader {
+	click_ip ip;
+	click_gre gre;
+	uint32_t key;
+    };
+
+    struct Tunnel {
+	uint32_t id;
+	IPAddress remote;
+	union {
+	    VXLANHeader vxlan;
+	    GREHeader gre;
+	} hdr;			// template; ip_len and ip_id are 0
+	uint64_t sent_packets;
+	uint64_t sent_bytes;
+	uint64_t received_packets;
+	uint64_t received_bytes;
+    };
+
+    int _type;
+    int _hlen;			// bytes of outer header added
+    IPAddress _src;
+    uint16_t _dport;		// network byte order
+    uint16_t _sport;		// network byte order; 0 means hash
+    Vector<Tunnel> _tunnels;	// tunnel for port i is _tunnels[i - 1]
+    HashTable<uint32_t, int> _ports;	// ID -> port
+    atomic_uint32_t _id;
+    uint64_t _drops;
+
+    inline Packet *encap(Tunnel &t, Packet *p, uint32_t id);
+    inline int decap(Packet *p);
+
+    enum { h_stats, h_drops, h_reset_counts };
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
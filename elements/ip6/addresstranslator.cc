@@ -17,6 +17,7 @@
 #include "addresstranslator.hh"
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/packetbatch.hh>
 #include <clicknet/ip.h>
 #include <clicknet/ip6.h>
 #include <clicknet/icmp.h>
@@ -27,12 +28,15 @@ CLICK_DECLS
 
 AddressTranslator::AddressTranslator()
   : _dynamic_mapping_allocation_direction(0),
-    _in_map(0), _out_map(0), _rover(0), _rover2(0), _nmappings(0)
+    _mport_rover(0), _nmappings(0),
+    _timeout(0), _wheel_tick(1), _wheel_cursor(0), _timer(this)
 {
     // input 0: IPv6 arriving outward packets
     // input 1: IPv6 arriving inward packets
     // output 0: IPv6 outgoing outward packets with mapped addresses and port
     // output 1: IPv6 outgoing inward packets with mapped address and port
+    for (int i = 0; i < wheel_size; i++)
+      _wheel[i] = 0;
 }
 
 
@@ -41,119 +45,94 @@ AddressTranslator::~AddressTranslator()
 }
 
 AddressTranslator::Mapping::Mapping()
-  :  _prev(0), _next(0), _free_next(0)
+  : _reverse(0), _prev(0), _next(0), _used(0), _mport(0)
 {
 }
 
 void
 AddressTranslator::cleanup(CleanupStage)
 {
-  if (_dynamic_mapping_allocation_direction==0)
-    {
-      clean_map(_in_map, 1);
-      clean_map(_out_map, 0);
-    }
-  else
-    {
-      clean_map(_in_map, 0);
-      clean_map(_out_map, 1);
-    }
+  clean_map();
 }
 
 void
-AddressTranslator::mapping_freed(Mapping *m, bool major_map)
+AddressTranslator::clean_map()
 {
-  if (major_map)
-  {
-    if (_rover == m) {
-      _rover = m->get_next();
-      if (_rover == m)
-	_rover = 0;
-    }
-
-    _nmappings--;
-    if (_nmappings) {
-      Mapping * m_prev = m->free_next();
-      m_prev->set_next(m->get_next());
-    }
+  for (Map6::iterator iter = _out_map.begin(); iter.live(); iter++) {
+    delete iter.value()->_reverse;
+    delete iter.value();
   }
+  _out_map.clear();
+  _in_map.clear();
+  for (int i = 0; i < wheel_size; i++)
+    _wheel[i] = 0;
+  _nmappings = 0;
+}
 
- else
-   {
-     if(_rover2 == m) {
-       _rover2 = m->get_next();
-       if (_rover2 == m)
-	 _rover2 = 0;
-     }
-     _nmappings2--;
-    if (_nmappings2) {
-      Mapping * m_prev = m->free_next();
-      m_prev->set_next(m->get_next());
+unsigned short
+AddressTranslator::find_mport()
+{
+  // take the next free port after the last one allocated
+  int nports = _mports.size();
+  for (int n = 0; n < nports; n++) {
+    int k = _mport_rover;
+    _mport_rover = (k + 1 == nports ? 0 : k + 1);
+    if (!_mports[k]) {
+      _mports[k] = true;
+      return _mportl + k;
     }
-   }
+  }
+  return 0;
 }
 
 void
-AddressTranslator::clean_map(Map6 &table, bool major_map)
+AddressTranslator::wheel_link(Mapping *m)
 {
+  click_jiffies_t slot = (m->_used + _timeout) / _wheel_tick;
+  if (click_jiffies_less(slot, _wheel_cursor))
+    slot = _wheel_cursor;
+  Mapping **head = &_wheel[slot & (wheel_size - 1)];
+  m->_prev = 0;
+  m->_next = *head;
+  if (*head)
+    (*head)->_prev = m;
+  *head = m;
+}
 
-  Mapping *to_free=0;
-  for (Map6::iterator iter = table.begin(); iter.live(); iter++) {
-    Mapping *m = iter.value();
-    m->set_free_next(to_free);
-    to_free = m;
-  }
-
-  while (to_free) {
-    Mapping *next = to_free->free_next();
-    mapping_freed(to_free, major_map);
-    delete to_free;
-    to_free = next;
-  }
-  table.clear();
+void
+AddressTranslator::expire(Mapping *m)
+{
+  _mports[m->_mport - _mportl] = false;
+  _out_map.erase(m->_key);
+  _in_map.erase(m->_reverse->_key);
+  delete m->_reverse;
+  delete m;
+  _nmappings--;
 }
 
-unsigned short
-AddressTranslator::find_mport( )
+void
+AddressTranslator::run_timer(Timer *)
 {
-  if (_mportl == _mporth || !_rover)
-    return _mportl;
-
-  Mapping * r = _rover;
-  Mapping * r2 = _rover2;
-  unsigned short this_mport = r->sport();
-  //click_chatter("in find_mport(), this_mport is %x", this_mport);
-
-  do {
-    Mapping *next = r->get_next();
-    Mapping *next2 = r2->get_next();
-    unsigned short next_mport = next->sport();
-    if (next_mport > this_mport +1)
-      {
-      goto found;
-     }
-    else if (next_mport <= this_mport) {
-      if (this_mport < _mporth)
-	{
-	  goto found;
-	}
-      else if (next_mport > _mportl) {
-	this_mport = _mportl -1;
-	goto found;
-      }
+  click_jiffies_t now = click_jiffies();
+  click_jiffies_t now_slot = now / _wheel_tick;
+
+  // Visit each slot that has fully passed.  A mapping there is idle past
+  // its deadline unless it was used since it was linked.
+  for (int n = 0; click_jiffies_less(_wheel_cursor, now_slot) && n < wheel_size; n++) {
+    Mapping *m = _wheel[_wheel_cursor & (wheel_size - 1)];
+    _wheel[_wheel_cursor & (wheel_size - 1)] = 0;
+    _wheel_cursor++;
+    while (m) {
+      Mapping *next = m->_next;
+      if (now - m->_used >= _timeout)
+	expire(m);
+      else
+	wheel_link(m);
+      m = next;
     }
-    r = next;
-    r2=next2;
-    this_mport = next_mport;
-  } while (r!=_rover);
-
-  return 0;
-
- found:
-  _rover = r;
-  _rover2 = r2;
-  return this_mport+1;
-
+  }
+  _wheel_cursor = now_slot;
+  _timer.schedule_at(Timestamp::make_jiffies((click_jiffies_t) ((now_slot + 1) * _wheel_tick)));
 }
 
 //add an entry to the mapping table for dynamic mapping
@@ -199,6 +178,25 @@ AddressTranslator::add_map(IP6Address &iai, unsigned short ipi, IP6Address &mai,
  _v.push_back(e);
 }
 
+//index entry i of _v, unless an earlier entry has the same key
+void
+AddressTranslator::index_entry(int i)
+{
+  const EntryMap &e = _v[i];
+  if (e._static)
+    {
+      unsigned short ipi = _static_mapping[1] ? e._ipi : 0;
+      unsigned short mpi = _static_mapping[3] ? e._mpi : 0;
+      _static_inner.find_insert(EntryKey(e._iai, ipi), i + 1);
+      _static_mapped.find_insert(EntryKey(e._mai, mpi), i + 1);
+    }
+  else if (e._binding)
+    {
+      _bound_inner.find_insert(EntryKey(e._iai, 0), i + 1);
+      _bound_mapped.find_insert(EntryKey(e._mai, 0), i + 1);
+    }
+}
+
 int
 AddressTranslator::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -206,7 +204,13 @@ AddressTranslator::configure(Vector<String> &conf, ErrorHandler *errh)
   int s = 0;
   IP6Address ia, ma, ea;
   int ip, mp, ep;
+  Timestamp timeout;
 
+  if (Args(conf, this, errh)
+      .read("TIMEOUT", timeout)
+      .consume() < 0)
+    return -1;
+  _timeout = timeout.jiffies();
 
   //get the static mapping entries for the mapping table
   if (!IntArg().parse(conf[0], _number_of_smap))
@@ -294,7 +298,8 @@ AddressTranslator::configure(Vector<String> &conf, ErrorHandler *errh)
   cp_spacevec(conf[s+i], words1);
 
 
-  if (cp_ip6_address(words1[0], (unsigned char *)&ipa6) && IntArg().parse(words1[1], port_start) && IntArg().parse(words1[2], port_end))
+  if (words1.size() == 3 && cp_ip6_address(words1[0], (unsigned char *)&ipa6) && IntArg().parse(words1[1], port_start) && IntArg().parse(words1[2], port_end)
+      && port_start > 0 && port_start <= port_end && port_end <= 65535)
     {
 	  _maddr = ipa6;
 	  _mportl = port_start;
@@ -307,6 +312,67 @@ AddressTranslator::configure(Vector<String> &conf, ErrorHandler *errh)
   return errh->nerrors() ? -1 : 0;
 }
 
+int
+AddressTranslator::initialize(ErrorHandler *)
+{
+  for (int i = 0; i < _v.size(); i++)
+    if (_v[i]._static)
+      index_entry(i);
+    else if (!_v[i]._binding)
+      _unbound.push_back(i);
+  // _unbound.back() is the first free entry
+  for (int i = 0, j = _unbound.size() - 1; i < j; i++, j--) {
+    int t = _unbound[i];
+    _unbound[i] = _unbound[j];
+    _unbound[j] = t;
+  }
+
+  if (_dynamic_mapping && _dynamic_portmapping) {
+    _mports.assign(_mporth - _mportl + 1, false);
+    _timer.initialize(this);
+    if (_timeout) {
+      _wheel_tick = (_timeout + wheel_span - 1) / wheel_span;
+      _wheel_cursor = click_jiffies() / _wheel_tick;
+      _timer.schedule_at(Timestamp::make_jiffies((click_jiffies_t) ((_wheel_cursor + 1) * _wheel_tick)));
+    }
+  }
+  return 0;
+}
+
+//translate the addresses and ports as static entry i says, if it matches
+inline bool
+AddressTranslator::match_entry(int i, IP6Address &iai, unsigned short &ipi, IP6Address &mai, unsigned short &mpi, bool lookup_direction)
+{
+  bool match = true;
+  if (_static_mapping[0]  && (lookup_direction ==_dynamic_mapping_allocation_direction))
+    match =  match && (_v[i]._iai == iai);
+  if (_static_mapping[1]  && (lookup_direction ==_dynamic_mapping_allocation_direction))
+    match =  match && (_v[i]._ipi == ipi);
+  if (_static_mapping[0] && (lookup_direction != _dynamic_mapping_allocation_direction))
+    match =  match && (_v[i]._mai == mai);
+  if (_static_mapping[1] && (lookup_direction != _dynamic_mapping_allocation_direction))
+    match =  match && (_v[i]._mpi == mpi);
+  if (!match)
+    return false;
+
+  if (_static_mapping[2] && (lookup_direction == _dynamic_mapping_allocation_direction))
+    mai = _v[i]._mai;
+  else if (_static_mapping[2] && (lookup_direction != _dynamic_mapping_allocation_direction))
+    iai = _v[i]._iai;
+  else if (lookup_direction == _dynamic_mapping_allocation_direction)
+    mai = iai;
+  else if (lookup_direction != _dynamic_mapping_allocation_direction)
+    iai = _v[i]._iai;
+
+  if (_static_mapping[3])
+    mpi = _v[i]._mpi;
+  else if (lookup_direction == _dynamic_mapping_allocation_direction)
+    mpi = ipi;
+  else if (lookup_direction !=_dynamic_mapping_allocation_direction)
+    ipi = mpi;
+  return true;
+}
+
 bool
 AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai, unsigned short &mpi, IP6Address &ea, unsigned short &ep, bool lookup_direction)
 {
@@ -314,63 +380,37 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
   if (( _number_of_smap >0 ) || (!_dynamic_portmapping))
     {
       //find the mapped entry in the table
-      for (int i=0; i<_v.size(); i++)
+      if (_number_of_smap > 0)
 	{
-	  bool match = true;
-	  if (_v[i]._static) //this is a static mapping entry
-	    {
+	  int i;
+	  if (lookup_direction == _dynamic_mapping_allocation_direction)
+	    i = _static_inner.get(EntryKey(iai, _static_mapping[1] ? ipi : 0));
+	  else
+	    i = _static_mapped.get(EntryKey(mai, _static_mapping[3] ? mpi : 0));
+	  if (i && match_entry(i - 1, iai, ipi, mai, mpi, lookup_direction))
+	    return true;
+	}
 
-	      if (_static_mapping[0]  && (lookup_direction ==_dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._iai == iai);
-	      if (_static_mapping[1]  && (lookup_direction ==_dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._ipi == ipi);
-	      if (_static_mapping[0] && (lookup_direction != _dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._mai == mai);
-	      if (_static_mapping[1] && (lookup_direction != _dynamic_mapping_allocation_direction))
-		match =  match && (_v[i]._mpi == mpi);
-
-	      if (match)
-		{
-		  if (_static_mapping[2] && (lookup_direction == _dynamic_mapping_allocation_direction))
-		    mai = _v[i]._mai;
-		  else if (_static_mapping[2] && (lookup_direction != _dynamic_mapping_allocation_direction))
-		    iai = _v[i]._iai;
-		  else if (lookup_direction == _dynamic_mapping_allocation_direction)
-		    mai = iai;
-		  else if (lookup_direction != _dynamic_mapping_allocation_direction)
-		    iai = _v[i]._iai;
-
-		  if (_static_mapping[3])
-		    mpi = _v[i]._mpi;
-		  else if (lookup_direction == _dynamic_mapping_allocation_direction)
-		    mpi = ipi;
-		  else if (lookup_direction !=_dynamic_mapping_allocation_direction)
-		    ipi = mpi;
-		  return (true);
-		}
+      //look for a dynamic binding entry
+      int i;
+      if (lookup_direction ==0)
+	i = _bound_inner.get(EntryKey(iai, 0));  //outward, check if the inner address matches
+      else
+	i = _bound_mapped.get(EntryKey(mai, 0)); //inward, check if the map address matches
+      if (i)
+	{
+	  const EntryMap &e = _v[i - 1];
+	  if (lookup_direction==0) //outward packet
+	    {
+	      mai = e._mai;
+	      mpi = ipi;
 	    }
-
-	  else  if (_v[i]._binding) //this is a dynamic bindign entry
+	  else //inward packet
 	    {
-	      if (lookup_direction ==0)
-		match =  (_v[i]._iai == iai);  //outward, check if the inner address matches
-	      else
-		match = (_v[i]._mai == mai); //inward, check if the map address matches
-	      if (match)
-		{
-		  if (lookup_direction==0) //outward packet
-		    {
-		      mai = _v[i]._mai;
-		      mpi = ipi;
-		    }
-		  else //inward packet
-		    {
-		      iai = _v[i]._iai;
-		      ipi = mpi;
-		    }
-		   return (true);
-		}
+	      iai = e._iai;
+	      ipi = mpi;
 	    }
+	  return (true);
 	}
 
       //no match found
@@ -379,33 +419,26 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
       if (_dynamic_mapping_allocation_direction != lookup_direction)
 	return false;
 
-      if (!_dynamic_portmapping) // dynamic address mapping only, try to allocate an address
+      if (!_dynamic_portmapping && _unbound.size()) // dynamic address mapping only, try to allocate an address
 	{
+	  i = _unbound.back();
+	  _unbound.pop_back();
+	  if (lookup_direction == 0) //outward packet
+	    {
+	      _v[i]._iai = iai;
+	      mai = _v[i]._mai;
+	      mpi = ipi;
+	    }
+	  else  //inward packet
+	    {
+	      _v[i]._mai = mai;
+	      iai = _v[i]._iai;
+	      ipi = mpi;
+	    }
 
-	  for (int i=0; i<_v.size(); i++) {
-	    if ((_v[i]._binding == false ) && ((!_v[i]._static)))
-	      {
-		if (lookup_direction == 0) //outward packet
-		  {
-		    _v[i]._iai = iai;
-		    mai = _v[i]._mai;
-		    mpi = ipi;
-		  }
-		else  //inward packet
-		  {
-		    _v[i]._mai = mai;
-		    iai = _v[i]._iai;
-		    ipi = mpi;
-		  }
-
-		_v[i]._binding = true;
-		//_v[i]._t = time(NULL);
-		//_v[i]._t = MyEWMA2::now();
-
-		return (true);
-	      }
-
-	  }
+	  _v[i]._binding = true;
+	  index_entry(i);
+	  return (true);
 	}
       return false;
     }
@@ -417,20 +450,20 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
   if (lookup_direction ==0)  // outward lookup
     {
       fd = IP6FlowID(iai, ipi, ea, ep);
-      Mapping *m = _out_map.find(fd);
-      if (m) {
+      if (Mapping *m = _out_map.get(fd)) {
 	mai = m->flow_id().saddr();
 	mpi = m->flow_id().sport();
+	m->_used = click_jiffies();
 	return true;
       }
     }
   else //inward lookup
     {
       fd = IP6FlowID(ea, ep, mai, mpi);
-      Mapping *m = _in_map.find(fd);
-      if (m) {
+      if (Mapping *m = _in_map.get(fd)) {
 	iai = m->flow_id().daddr();
 	ipi = m->flow_id().dport();
+	m->_reverse->_used = click_jiffies();
 	return true;
       }
     }
@@ -443,9 +476,7 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
   // first find the freeport and its corresponding map address, create new flowid
    // then add to in_map and out_map
 
-  unsigned short new_mport = 0;
-  new_mport = find_mport(); //
-  //click_chatter("***********new port is %x", new_mport);
+  unsigned short new_mport = find_mport();
 
   if (!new_mport) {
       click_chatter("AddressTranslator ran out of ports");
@@ -469,51 +500,20 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
   IP6FlowID new_in_flow  = IP6FlowID(ea, ep, iai, ipi);
   Mapping *out_mapping = new Mapping;
   out_mapping->initialize(new_out_flow);
+  out_mapping->_key = orig_out_flow;
+  out_mapping->_mport = new_mport;
+  out_mapping->_used = click_jiffies();
   Mapping *in_mapping = new Mapping;
   in_mapping->initialize(new_in_flow);
-  if (lookup_direction == 0)
-    {
-      if (mpi==_mportl) //the first port mapping
-	{
-	  _rover = out_mapping;
-	  _rover->set_next(_rover);
-	  _rover2= in_mapping;
-	  _rover2->set_next(_rover2);
-	}
-      else
-	{
-	  out_mapping->set_next(_rover->get_next());
-	  _rover->set_next(out_mapping);
-	  _rover = out_mapping;
-	  in_mapping->set_next(_rover2->get_next());
-	  _rover2->set_next(in_mapping);
-	  _rover2 = in_mapping;
-	}
-    }
-  else
-    {
-      if (ipi == _mportl)
-	{
-	  _rover = in_mapping;
-	  _rover->set_next(_rover);
-	  _rover2 = out_mapping;
-	  _rover2->set_next(_rover2);
-	}
-      else
-	{
-	  in_mapping->set_next(_rover->get_next());
-	  _rover->set_next(in_mapping);
-	  _rover = in_mapping;
-	  out_mapping->set_next(_rover2->get_next());
-	  _rover2->set_next(out_mapping);
-	  _rover2 = out_mapping;
-	}
-    }
-
-  _out_map.insert(orig_out_flow, out_mapping);
-  _in_map.insert(orig_in_flow, in_mapping);
+  in_mapping->_key = orig_in_flow;
+  out_mapping->_reverse = in_mapping;
+  in_mapping->_reverse = out_mapping;
+
+  _out_map.set(orig_out_flow, out_mapping);
+  _in_map.set(orig_in_flow, in_mapping);
+  if (_timeout)
+    wheel_link(out_mapping);
   _nmappings++;
-  _nmappings2++;
   return true;
 
 }
@@ -522,263 +522,170 @@ AddressTranslator::lookup(IP6Address &iai, unsigned short &ipi, IP6Address &mai,
 void
 AddressTranslator::push(int port, Packet *p)
 {
-  if (port == 0)
-    handle_outward(p);
-  else
-    handle_inward(p);
+  if (port == 0) {
+    if ((p = handle_outward(p)))
+      output(0).push(p);
+  } else {
+    if ((p = handle_inward(p)))
+      output(1).push(p);
+  }
 }
 
+void
+AddressTranslator::push_batch(int port, PacketBatch &batch)
+{
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if ((p = (port == 0 ? handle_outward(p) : handle_inward(p))))
+      out.push_back(p);
+  output(port).push_batch(out);
+}
 
 
-void
+//adjust the transport checksum for a changed address and port; icmp6
+//covers only the address, through its pseudoheader
+static void
+update_transport_cksum(click_ip6 *ip6, const IP6Address &old_a, const IP6Address &new_a,
+		       uint16_t *port, uint16_t new_port)
+{
+  uint16_t *sum;
+  if (ip6->ip6_nxt == IP_PROTO_TCP)
+    sum = &((click_tcp *)(ip6+1))->th_sum;
+  else if (ip6->ip6_nxt == IP_PROTO_UDP)
+    sum = &((click_udp *)(ip6+1))->uh_sum;
+  else
+    sum = &((click_icmp6 *)(ip6+1))->icmp6_cksum;
+  click_update_in_cksum_range(sum, old_a.data(), 16, new_a.data(), 16);
+  if (port) {
+    click_update_in_cksum(sum, *port, new_port);
+    *port = new_port;
+  }
+  if (ip6->ip6_nxt == IP_PROTO_UDP && *sum == 0)
+    *sum = 0xFFFF;
+}
+
+Packet *
 AddressTranslator::handle_outward(Packet *p)
 {
-  click_ip6 *ip6 = (click_ip6 *)p->data();
-  unsigned char *start = (unsigned char *)p->data();
+  const click_ip6 *ip6 = (const click_ip6 *)p->data();
   IP6Address ip6_src = IP6Address(ip6->ip6_src);
   IP6Address ip6_msrc;
   IP6Address ip6_dst = IP6Address(ip6->ip6_dst);
-  uint16_t sport;
-  uint16_t dport;
-  uint16_t mport;
-
-  WritablePacket *q= Packet::make(p->length());
-  if (q==0) {
-    click_chatter("can not make packet!");
-    assert(0);
-  }
-
-
-  // create the new packet
-  // replace src IP6, src port, and tcp checksum fields in the packet
-  unsigned char *start_new = (unsigned char *)q->data();
-  memset(q->data(), '\0', q->length());
-  memcpy(start_new, start, p->length());
-  click_ip6 *ip6_new = (click_ip6 * )q->data();
-
-  if (ip6_new->ip6_nxt ==0x3a) //the upper layer is an icmp6 packet
+  uint16_t sport = 0;
+  uint16_t dport = 0;
+  uint16_t mport = 0;
+  bool has_ports;
+
+  if (ip6->ip6_nxt == IP_PROTO_ICMP6) //the upper layer is an icmp6 packet
+    has_ports = false;
+  else if (ip6->ip6_nxt == IP_PROTO_TCP || ip6->ip6_nxt == IP_PROTO_UDP)
+    has_ports = true;
+  else //discard other packets
     {
-
-      unsigned char * icmp6_start = (unsigned char *)(ip6_new +1);
-      if (lookup(ip6_src, dport, ip6_msrc, mport, ip6_dst, sport, 0))
-	{
-
-	  ip6_new->ip6_src = ip6_msrc;
-	  switch (icmp6_start[0])  {
-	  case 1  : ;
-	  case 3  : ;
-	  case 128: ;
-	  case 129: {
-	    click_icmp6_echo * icmp6 = (click_icmp6_echo *) (ip6_new+1);
-	    icmp6->icmp6_cksum=0;
-	    icmp6->icmp6_cksum= htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, 0x3a, 0, (unsigned char *)icmp6, ip6_new->ip6_plen));
-	  }
-	  break;
-	  case 2: {
-	    click_icmp6_pkttoobig * icmp6 = (click_icmp6_pkttoobig *)(ip6_new +1);
-	    icmp6->icmp6_cksum=0;
-	    icmp6->icmp6_cksum= htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, 0x3a, 0, (unsigned char *)icmp6, ip6_new->ip6_plen));
-	  }
-	  break;
-	  case 4: {
-	    click_icmp6_paramprob * icmp6 = (click_icmp6_paramprob *)(ip6_new +1);
-	    icmp6->icmp6_cksum=0;
-	    icmp6->icmp6_cksum= htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, 0x3a, 0, (unsigned char *)icmp6, ip6_new->ip6_plen));
-	  }
-	  break;
-	  default: ; break;
-	  }
-
-	  p->kill();
-	  output(0).push(q);
-	}
-      else
-	{
-	  //click_chatter(" failed for mapping the ip6 address and port for an icmpv6 packet ");
-	  p->kill();
-	}
+      click_chatter(" discard the packet, protocol unrecognized");
+      p->kill();
+      return 0;
     }
 
-
-  else if (ip6_new->ip6_nxt ==0x6) //the upper layer is a tcp packet
+  // tcp and udp ports are at the same offsets
+  const click_udp *udp = (const click_udp *)(ip6+1);
+  if (p->length() < sizeof(click_ip6) + (has_ports ? sizeof(click_udp) : sizeof(click_icmp6)))
     {
-       click_tcp *tcp_new  = (click_tcp *)(ip6_new+1);
-       sport = ntohs(tcp_new->th_sport);
-       dport = ntohs(tcp_new->th_dport);
-
-      if (lookup(ip6_src, sport, ip6_msrc, mport, ip6_dst, dport, 0))
-	{
-	  ip6_new->ip6_src = ip6_msrc;
-	  tcp_new->th_sport = htons(mport);
-	  //recalculate the checksum for TCP, deal with fragment later
-	  tcp_new->th_sum = 0;
-	  tcp_new->th_sum = htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, ip6_new->ip6_nxt, tcp_new->th_sum, (unsigned char *)tcp_new, ip6_new->ip6_plen));
-	  p->kill();
-	  output(0).push(q);
-	}
-      else
-	{
-	  //click_chatter(" failed to map the ip6 address and port for a tcp packet");
-	  p->kill();
-	}
+      p->kill();
+      return 0;
     }
-
-  else if (ip6_new->ip6_nxt ==0x11) //the upper layer is a udp packet
+  if (has_ports)
     {
-      click_udp *udp_new  = (click_udp *)(ip6_new+1);
-      sport = ntohs(udp_new->uh_sport);
-      dport = ntohs(udp_new->uh_dport);
-
-      if (lookup(ip6_src, sport, ip6_msrc, mport, ip6_dst, dport, 0))
-	{
-	  ip6_new->ip6_src = ip6_msrc;
-	  udp_new->uh_sport = htons(mport);
-	  //recalculate the checksum for UDP, deal with fragment later
-	  udp_new->uh_sum = 0;
-	  udp_new->uh_sum = htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, ip6_new->ip6_nxt, udp_new->uh_sum, (unsigned char *)udp_new, ip6_new->ip6_plen));
-	  p->kill();
-	  output(0).push(q);
-	}
-      else
-	{
-	  //click_chatter(" failed to map the ip6 address and port for a udp packet");
-	  p->kill();
-	}
+      sport = ntohs(udp->uh_sport);
+      dport = ntohs(udp->uh_dport);
     }
 
-  else //discard other packets
+  bool ok = (has_ports ? lookup(ip6_src, sport, ip6_msrc, mport, ip6_dst, dport, 0)
+	     : lookup(ip6_src, dport, ip6_msrc, mport, ip6_dst, sport, 0));
+  if (!ok)
     {
-      click_chatter(" discard the packet, protocol unrecognized");
+      //click_chatter(" failed to map the ip6 address and port");
       p->kill();
+      return 0;
     }
 
+  // replace src IP6, src port, and checksum fields in the packet
+  WritablePacket *q = p->uniqueify();
+  if (!q)
+    return 0;
+  click_ip6 *ip6_new = (click_ip6 *)q->data();
+  ip6_new->ip6_src = ip6_msrc;
+  update_transport_cksum(ip6_new, ip6_src, ip6_msrc,
+			 has_ports ? &((click_udp *)(ip6_new+1))->uh_sport : 0,
+			 htons(mport));
+  return q;
 }
 
-void
+Packet *
 AddressTranslator::handle_inward(Packet *p)
 {
-click_ip6 *ip6 = (click_ip6 *)p->data();
-  unsigned char *start = (unsigned char *)p->data();
+  const click_ip6 *ip6 = (const click_ip6 *)p->data();
   IP6Address ip6_src = IP6Address(ip6->ip6_src);
   IP6Address ip6_mdst = IP6Address(ip6->ip6_dst);
   IP6Address ip6_dst ;
-  uint16_t sport;
-  uint16_t mport;
-  uint16_t dport;
-
-
-  WritablePacket *q= Packet::make(p->length());
-  if (q==0) {
-    click_chatter("can not make packet!");
-    assert(0);
-  }
-
-
-  // create the new packet
-  // replace src ip6, src port, and tcp checksum  fields in the packet
-  unsigned char *start_new = (unsigned char *)q->data();
-  memset(q->data(), '\0', q->length());
-  memcpy(start_new, start, p->length());
-  click_ip6 *ip6_new = (click_ip6 * )q->data();
-
-  if (ip6_new->ip6_nxt ==0x3a) //the upper layer is an icmp6 packet
-
-     {
-      unsigned char * icmp6_start = (unsigned char *)(ip6_new +1);
-      //unsigned char *ip6_new2 = 0;
-
-      if (lookup(ip6_dst, dport, ip6_mdst, mport, ip6_src, sport, 1))
-	{
-	   ip6_new->ip6_dst = ip6_dst;
-	   switch (icmp6_start[0])  {
-	   case 1  : ;  //need to change
-	   case 3  : ;  //need to change
-	   case 128: ;
-	   case 129: {
-	     click_icmp6_echo * icmp6 = (click_icmp6_echo *)(ip6_new +1);
-	     icmp6->icmp6_cksum = 0;
-	     icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, 0x3a, 0, (unsigned char *)icmp6, ip6_new->ip6_plen));
-	   }
-	   break;
-	   case 2: {
-	     click_icmp6_pkttoobig * icmp6 = (click_icmp6_pkttoobig *)(ip6_new +1);
-	     icmp6->icmp6_cksum = 0;
-	     icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, 0x3a, 0, (unsigned char *)icmp6, ip6_new->ip6_plen));
-	   }
-	   break;
-	   case 4: {
-	     click_icmp6_paramprob * icmp6 = (click_icmp6_paramprob *)(ip6_new +1);
-	     icmp6->icmp6_cksum = 0;
-	     icmp6->icmp6_cksum = htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, 0x3a, 0, (unsigned char *)icmp6, ip6_new->ip6_plen));
-	   }
-	   break;
-	   default: ;
-	   }
-
-	  p->kill();
-	  output(1).push(q);
-	}
-      else
-	{
-	  //click_chatter(" failed for mapping the dst ip6 address and port for an icmpv6 packet -inward");
-	  p->kill();
-	}
+  uint16_t sport = 0;
+  uint16_t mport = 0;
+  uint16_t dport = 0;
+  bool has_ports;
+
+  if (ip6->ip6_nxt == IP_PROTO_ICMP6) //the upper layer is an icmp6 packet
+    has_ports = false;
+  else if (ip6->ip6_nxt == IP_PROTO_TCP || ip6->ip6_nxt == IP_PROTO_UDP)
+    has_ports = true;
+  else //discard other packets
+    {
+      click_chatter(" discard the packet, protocol unrecognized");
+      p->kill();
+      return 0;
     }
 
-
-  else if (ip6_new->ip6_nxt ==0x6) //the upper layer is a tcp packet
+  const click_udp *udp = (const click_udp *)(ip6+1);
+  if (p->length() < sizeof(click_ip6) + (has_ports ? sizeof(click_udp) : sizeof(click_icmp6)))
     {
-       click_tcp *tcp_new  = (click_tcp *)(ip6_new+1);
-       sport = ntohs(tcp_new->th_sport);
-       mport = ntohs(tcp_new->th_dport);
-      if (lookup(ip6_dst, dport,ip6_mdst, mport, ip6_src, sport, 1))
-	{
-	  ip6_new->ip6_dst = ip6_dst;
-	  tcp_new->th_dport = htons(dport);
-	  //recalculate the checksum for TCP, deal with fragment later
-	  tcp_new->th_sum = 0;
-	  tcp_new->th_sum = htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, ip6_new->ip6_nxt, tcp_new->th_sum, (unsigned char *)tcp_new, ip6_new->ip6_plen));
-
-
-	  p->kill();
-	  output(1).push(q);
-	}
-       else
-	{
-	  //click_chatter(" failed for mapping the dst ip6 address and port for a tcp packet -inward");
-	  p->kill();
-	}
+      p->kill();
+      return 0;
     }
-
-
-  else if (ip6_new->ip6_nxt ==0x11) //the upper layer is a udp packet
+  if (has_ports)
     {
-       click_udp *udp_new  = (click_udp *)(ip6_new+1);
-       sport = ntohs(udp_new->uh_sport);
-       mport = ntohs(udp_new->uh_dport);
-      if (lookup(ip6_dst, dport,ip6_mdst, mport, ip6_src, sport, 1))
-	{
-	  ip6_new->ip6_dst = ip6_dst;
-	  udp_new->uh_dport = htons(dport);
-	  //recalculate the checksum for TCP, deal with fragment later
-	  udp_new->uh_sum = 0;
-	  udp_new->uh_sum = htons(in6_fast_cksum(&ip6_new->ip6_src, &ip6_new->ip6_dst, ip6_new->ip6_plen, ip6_new->ip6_nxt, udp_new->uh_sum, (unsigned char *)udp_new, ip6_new->ip6_plen));
-
-	  p->kill();
-	  output(1).push(q);
-	}
-       else
-	{
-	  //click_chatter(" failed for mapping the dst ip6 address and port for a udp packet - inward");
-	  p->kill();
-	}
+      sport = ntohs(udp->uh_sport);
+      mport = ntohs(udp->uh_dport);
     }
 
-  else //discard other packets
+  if (!lookup(ip6_dst, dport, ip6_mdst, mport, ip6_src, sport, 1))
     {
-      click_chatter(" discard the packet, protocol unrecognized");
+      //click_chatter(" failed for mapping the dst ip6 address and port - inward");
       p->kill();
+      return 0;
     }
+
+  // replace dst ip6, dst port, and checksum fields in the packet
+  WritablePacket *q = p->uniqueify();
+  if (!q)
+    return 0;
+  click_ip6 *ip6_new = (click_ip6 *)q->data();
+  ip6_new->ip6_dst = ip6_dst;
+  update_transport_cksum(ip6_new, ip6_mdst, ip6_dst,
+			 has_ports ? &((click_udp *)(ip6_new+1))->uh_dport : 0,
+			 htons(dport));
+  return q;
+}
+
+String
+AddressTranslator::read_handler(Element *e, void *)
+{
+  AddressTranslator *at = static_cast<AddressTranslator *>(e);
+  return String(at->_nmappings);
+}
+
+void
+AddressTranslator::add_handlers()
+{
+  add_read_handler("mappings", read_handler);
 }
 
 EXPORT_ELEMENT(AddressTranslator)
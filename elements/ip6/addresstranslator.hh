@@ -4,13 +4,12 @@
 #include <click/ipaddress.hh>
 #include <click/vector.hh>
 #include <click/element.hh>
-#include <click/bighashmap.hh>
+#include <click/hashtable.hh>
+#include <click/bitvector.hh>
 #include <click/ip6flowid.hh>
+#include <click/timer.hh>
 CLICK_DECLS
 
-//#include <time.h>
-
-
 /*
  * =c
  * AddressTranslator(number_of_static_Mapping,
@@ -61,7 +60,21 @@ CLICK_DECLS
  * If there is,  use the mapped flowID of that entry for the packet.  Otherwise, it will try to
  * find an unsed port and create a mapped flowID for the flow and insert the entry, if the packet
  * comes from the right direction.
-
+ *
+ * The static and dynamic address entries are indexed by hash tables, and the
+ * address and port mappings are kept in hash tables keyed by flow ID, so
+ * lookups take constant time.  Packets are translated in place, and their
+ * checksums are adjusted incrementally for the changed address and port.
+ *
+ * A keyword argument, TIMEOUT, may follow the other arguments.  It is a time
+ * in seconds: address and port mappings idle for that long are removed, and
+ * their ports reused.  Idle mappings are found with a timing wheel, so
+ * expiry costs constant time per mapping.  The default is 0, which keeps
+ * mappings forever.
+ *
+ * =h mappings read-only
+ *
+ * Returns the number of dynamic address and port mappings.
  *
  * =a ProtocolTranslator64, ProtocolTranslator46 */
 
@@ -76,12 +89,17 @@ class AddressTranslator : public Element {
 
   const char *class_name() const		{ return "AddressTranslator"; }
   const char *port_count() const		{ return "2/2"; }
+  const char *processing() const		{ return PUSH; }
   int configure(Vector<String> &, ErrorHandler *);
+  int initialize(ErrorHandler *);
+  void add_handlers();
   void push(int port, Packet *p);
+  void push_batch(int port, PacketBatch &batch);
+  void run_timer(Timer *);
   void add_map(IP6Address &mai,  bool binding);
   void add_map(IP6Address &iai, unsigned short ipi, IP6Address &mai, unsigned short mpi, IP6Address &ea, unsigned short ep, bool binding);
-  void handle_outward(Packet *p);
-  void handle_inward(Packet *p);
+  Packet *handle_outward(Packet *p);
+  Packet *handle_inward(Packet *p);
 
   bool lookup(IP6Address &, unsigned short &, IP6Address &, unsigned short &, IP6Address &, unsigned short &, bool);
   void cleanup(CleanupStage);
@@ -95,16 +113,30 @@ protected:
     unsigned short _mpi;
     IP6Address _ea;
     unsigned short _ep;
-    //long unsigned int _t;
-     //time_t  _t;  //the last time that the packet passed the address translator
-                 //later: the time when FIN received from both direction for TCP
-                 //the time that the UDP packet has been sent for this session.
-   //unsigned char _state;
     bool _binding;
     bool _static;
 };
   Vector<EntryMap> _v;
 
+  // An address and port, to index _v.
+  struct EntryKey {
+    IP6Address _a;
+    unsigned short _p;
+    EntryKey() : _p(0) { }
+    EntryKey(const IP6Address &a, unsigned short p) : _a(a), _p(p) { }
+    hashcode_t hashcode() const { return _a.hashcode() ^ _p; }
+    bool operator==(const EntryKey &x) const { return _a == x._a && _p == x._p; }
+  };
+  typedef HashTable<EntryKey, int> EntryIndex;
+
+  // Indexes into _v, holding an entry's position plus 1.  Each key maps
+  // to the first matching entry, so lookups find the same entry a scan of
+  // _v would.
+  EntryIndex _static_inner;	// static entries by inner address (and port)
+  EntryIndex _static_mapped;	// static entries by mapped address (and port)
+  EntryIndex _bound_inner;	// bound dynamic entries by inner address
+  EntryIndex _bound_mapped;	// bound dynamic entries by mapped address
+  Vector<int> _unbound;		// unbound dynamic entries, last is first
 
   int _number_of_smap; // number of static-mapping entry
   bool _static_portmapping;
@@ -117,21 +149,39 @@ protected:
   //_iai, _ipi, _mai, _mpi, _ea, _ep
   bool _static_mapping[6];
 
+  inline bool match_entry(int i, IP6Address &, unsigned short &, IP6Address &, unsigned short &, bool);
+  void index_entry(int i);
 
-  //using new approach
-  typedef HashMap<IP6FlowID, Mapping *> Map6;
-  void clean_map(Map6 &, bool);
-  unsigned short find_mport( );
-  void mapping_freed(Mapping *, bool);
+  // Dynamic address and port mappings.  Each flow has a pair of
+  // Mappings, one in each table; the _out_map one is primary, and holds
+  // the mapped port and the time of last use.
+  typedef HashTable<IP6FlowID, Mapping *> Map6;
+  void clean_map();
+  unsigned short find_mport();
+  void expire(Mapping *);
 
   Map6 _in_map;
   Map6 _out_map;
   IP6Address _maddr;
   unsigned short _mportl, _mporth;
-  Mapping *_rover;
-  Mapping *_rover2;
+  Bitvector _mports;		// ports in use, from _mportl
+  int _mport_rover;
   int _nmappings;
-  int _nmappings2;
+
+  // Idle primary mappings expire through a hashed timing wheel.  A
+  // mapping sits in the slot of its deadline as of when it was linked;
+  // when that slot passes, it either expires or moves to the slot of its
+  // current deadline.
+  enum { wheel_order = 8, wheel_size = 1 << wheel_order, wheel_span = 32 };
+  Mapping *_wheel[wheel_size];
+  click_jiffies_t _timeout;	// 0 means never
+  click_jiffies_t _wheel_tick;	// jiffies per slot
+  click_jiffies_t _wheel_cursor; // slot number; earlier slots have passed
+  Timer _timer;
+
+  void wheel_link(Mapping *);
+
+  static String read_handler(Element *, void *);
 
 };
 
@@ -144,21 +194,16 @@ class AddressTranslator::Mapping {
   const IP6FlowID &flow_id() const    {  return _mapto;        }
   unsigned short sport() const        { return _mapto.sport(); }
   unsigned short dport() const        { return _mapto.dport(); }
-  //String s() const                  { return " ";    }
-  Mapping * get_next()                { return _next; }
-  Mapping * get_prev()                { return _prev; }
-  void set_next(Mapping * next)       { _next = next; }
-  void set_prev(Mapping * prev)       { _prev = prev; }
-  Mapping *free_next() const		{ return _free_next; }
-  void set_free_next(Mapping *m)      {_free_next = m;}
 
 
  protected:
-  //long unsigned int _t;
   IP6FlowID _mapto;
-  Mapping *_prev;
+  IP6FlowID _key;		// key in _in_map or _out_map
+  Mapping *_reverse;		// the flow's other Mapping
+  Mapping *_prev;		// wheel slot links (primary only)
   Mapping *_next;
-  Mapping *_free_next;
+  click_jiffies_t _used;	// last use (primary only)
+  unsigned short _mport;	// allocated port (primary only)
 
   friend class AddressTranslator;
 };
@@ -24,6 +24,7 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/standard/alignmentinfo.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 CheckIP6Header::CheckIP6Header()
@@ -130,18 +131,98 @@ CheckIP6Header::simple_action(Packet *p)
    *
    */
 
-  p->set_ip6_header(ip);
-
-  // shorten packet according to IP6 payload length field
-  if(ntohs(ip->ip6_plen) < (plen-40))
-    p->take(plen - 40 - ip->ip6_plen);
-  return(p);
+  return accept(p, ip, plen);
 
  bad:
   drop_it(p);
   return 0;
 }
 
+inline Packet *
+CheckIP6Header::accept(Packet *p, const click_ip6 *ip, unsigned plen)
+{
+  p->set_ip6_header(ip);
+
+  // shorten packet according to IP6 payload length field
+  unsigned len = ntohs(ip->ip6_plen) + sizeof(click_ip6);
+  if (len < plen)
+    p->take(plen - len);
+  return p;
+}
+
+// Return a bitmask of the packets p[0...n-1] that fail a check.  Each check
+// runs on every lane without branching; simple_action() then handles the
+// packets in the mask, counting and reporting their drops.
+unsigned
+CheckIP6Header::check_lanes(Packet * const *p, int n) const
+{
+  static const unsigned char zero_header[sizeof(click_ip6)] = { 0 };
+  const unsigned char *h[lanes];
+  uint32_t plen[lanes];
+  unsigned bad = 0;
+
+  // a packet too short for a header checks a zero header, which fails
+  for (int i = 0; i < n; ++i) {
+    plen[i] = p[i]->length() - _offset;
+    h[i] = ((int) plen[i] >= (int) sizeof(click_ip6)
+	    ? p[i]->data() + _offset : zero_header);
+  }
+
+  for (int i = 0; i < n; ++i) {
+    uint32_t len = (h[i][4] << 8) | h[i][5];
+    unsigned b = ((h[i][0] >> 4) != 6) | (len > plen[i] - sizeof(click_ip6));
+    bad |= b << i;
+  }
+
+  for (int k = 0; k < _n_bad_src; ++k) {
+    const uint32_t *a = _bad_src[k].data32();
+    for (int i = 0; i < n; ++i) {
+      uint32_t src[4];
+      memcpy(src, h[i] + 8, sizeof(src));
+      unsigned b = ((src[0] ^ a[0]) | (src[1] ^ a[1])
+		    | (src[2] ^ a[2]) | (src[3] ^ a[3])) == 0;
+      bad |= b << i;
+    }
+  }
+
+  return bad & ((1U << n) - 1);
+}
+
+void
+CheckIP6Header::simple_action_batch(PacketBatch &batch)
+{
+  Packet *p[lanes];
+  PacketBatch out;
+  while (!batch.empty()) {
+    int n = 0;
+    for (; n < lanes && !batch.empty(); ++n)
+      p[n] = batch.pop_front();
+    unsigned bad = check_lanes(p, n);
+    for (int i = 0; i < n; ++i)
+      if (!(bad & (1U << i))) {
+	const click_ip6 *ip = reinterpret_cast<const click_ip6 *>(p[i]->data() + _offset);
+	out.push_back(accept(p[i], ip, p[i]->length() - _offset));
+      } else if (Packet *q = simple_action(p[i]))
+	out.push_back(q);
+  }
+  batch.swap(out);
+}
+
+void
+CheckIP6Header::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+CheckIP6Header::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
 
 static String
 CheckIP6Header_read_drops(Element *xf, void *)
@@ -2,6 +2,7 @@
 #define CLICK_CHECKIP6HEADER_HH
 #include <click/element.hh>
 #include <click/glue.hh>
+#include <clicknet/ip6.h>
 CLICK_DECLS
 
 /*
@@ -35,6 +36,10 @@ CLICK_DECLS
  *
  * =back
  *
+ * Batches are checked eight packets at a time.  The version, length, and
+ * source address checks run on all eight without branching, and only packets
+ * that fail take the single-packet path, which counts and reports them.
+ *
  * =a MarkIP6Header */
 
 class CheckIP6Header : public Element {
@@ -65,8 +70,18 @@ class CheckIP6Header : public Element {
   void add_handlers();
 
   Packet *simple_action(Packet *);
+  void simple_action_batch(PacketBatch &batch);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, PacketBatch &batch, int max);
   void drop_it(Packet *);
 
+ private:
+
+  enum { lanes = 8 };
+
+  inline Packet *accept(Packet *p, const click_ip6 *ip, unsigned plen);
+  unsigned check_lanes(Packet * const *p, int n) const;
+
 
 };
 
@@ -19,6 +19,7 @@
 #include "decip6hlim.hh"
 #include <clicknet/ip6.h>
 #include <click/glue.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 DecIP6HLIM::DecIP6HLIM()
@@ -57,6 +58,29 @@ DecIP6HLIM::simple_action(Packet *p_in)
   }
 }
 
+void
+DecIP6HLIM::push_batch(int, PacketBatch &batch)
+{
+  PacketBatch out, expired;
+  while (Packet *p = batch.pop_front())
+    if (p->ip6_header()->ip6_hlim <= 1)
+      expired.push_back(p);
+    else if (WritablePacket *q = p->uniqueify()) {
+      q->ip6_header()->ip6_hlim--;
+      out.push_back(q);
+    }
+
+  if (!out.empty())
+    output(0).push_batch(out);
+  if (!expired.empty()) {
+    _drops += expired.count();
+    if (noutputs() == 2)
+      output(1).push_batch(expired);
+    else
+      expired.kill();
+  }
+}
+
 static String
 DecIP6HLIM_read_drops(Element *xf, void *)
 {
@@ -18,6 +18,7 @@ CLICK_DECLS
  * and sends the packet to output 0.
  *
  * Ordinarily output 1 is connected to an ICMP6 error packet generator.
+ * A pushed batch leaves as at most two batches, one per output.
  *
  * =e
  * This is a typical IP6 input processing sequence:
@@ -46,6 +47,7 @@ class DecIP6HLIM : public Element {
   void add_handlers();
 
   Packet *simple_action(Packet *);
+  void push_batch(int port, PacketBatch &batch);
   void drop_it(Packet *);
 
 };
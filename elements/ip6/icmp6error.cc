@@ -25,11 +25,13 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/packet_anno.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 ICMP6Error::ICMP6Error()
 {
   _code = _type = -1;
+  _rate_limited = 0;
 }
 
 ICMP6Error::~ICMP6Error()
@@ -39,11 +41,31 @@ ICMP6Error::~ICMP6Error()
 int
 ICMP6Error::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh)
+    uint32_t rate = 0, burst = 0, buckets = 1024;
+    int prefix = 64;
+    bool burst_specified;
+    if (Args(conf, this, errh)
 	.read_mp("SRC", _src_ip)
 	.read_mp("TYPE", _type)
 	.read_mp("CODE", _code)
-	.complete();
+	.read("RATE", rate)
+	.read("BURST", burst).read_status(burst_specified)
+	.read("PREFIX", prefix)
+	.read("BUCKETS", buckets)
+	.complete() < 0)
+	return -1;
+    if (prefix < 0 || prefix > 128)
+	return errh->error("PREFIX must be between 0 and 128");
+    if (buckets < 1 || buckets > 0x1000000)
+	return errh->error("BUCKETS out of range");
+    if (!burst_specified)
+	burst = rate;
+    else if (burst < 1)
+	return errh->error("BURST must be at least 1");
+    if (_limiter.assign(rate, burst, buckets) < 0)
+	return errh->error("out of memory");
+    _prefix = IP6Address::make_prefix(prefix);
+    return 0;
 }
 
 bool
@@ -68,6 +90,23 @@ ICMP6Error::initialize(ErrorHandler *errh)
     return errh->error("not configured -a");
   if (!is_error_type(_type) && !is_redirect_type(_type))
     return errh->error("ICMP6 type %d is not an error or redirect type", _type);
+
+  // The fixed fields of every error's IP6 and ICMP6 headers.
+  memset(_template, 0, sizeof(_template));
+  click_ip6 *nip = reinterpret_cast<click_ip6 *>(_template);
+  nip->ip6_flow = 0;	/* must set first: overlaps vfc */
+  nip->ip6_v = 6;
+  nip->ip6_nxt = IP_PROTO_ICMP6;  /* next header */
+  nip->ip6_hlim = 0xff; //what hop limit shoud I set?
+  nip->ip6_src = _src_ip;
+
+  click_icmp6 *icp = (click_icmp6 *) (nip + 1);
+  icp->icmp6_type = _type;
+  icp->icmp6_code = _code;
+  if(_type == ICMP6_PKTTOOBIG && _code == 0){
+    /* Set the mtu value. */
+    ((click_icmp6_pkttoobig *)icp)->icmp6_mtusize = 1500;
+  }
   return 0;
 }
 
@@ -110,7 +149,8 @@ ICMP6Error::valid_source(const IP6Address &aa)
   /* I don't know how to detect directed broadcast. */
 
   /* ::1 */
- if(aa == IP6Address("::1"))
+ static const IP6Address loopback("::1");
+ if(aa == loopback)
    return(0);
 
   return(1);
@@ -128,36 +168,48 @@ ICMP6Error::has_route_opt(const click_ip6 *)
 }
 
 
-Packet *
-ICMP6Error::simple_action(Packet *p)
+inline WritablePacket *
+ICMP6Error::generate(Packet *p, TokenRate::time_point_type now)
 {
-  WritablePacket *q = 0;
+  WritablePacket *q;
   const click_ip6 *ipp = p->ip6_header();
   click_ip6 *nip;
   click_icmp6 *icp;
-  unsigned xlen;
+  unsigned hsz, xlen;
 
 
   if (!p->has_network_header())
-    goto out;
+    return 0;
 
 
   /* These "don'ts" are from RFC1885 2.4.e: */
 
   /* Don't reply to ICMP6 error messages. */
   if(ipp->ip6_nxt == IP_PROTO_ICMP6) {
-    icp = (click_icmp6 *) ((char *)ipp);
-    if( is_error_type(icp->icmp6_type))
-      goto out;
+    const click_icmp6 *icmph = (const click_icmp6 *) ((const char *)ipp);
+    if( is_error_type(icmph->icmp6_type))
+      return 0;
   }
 
   /* Don't respond to packets with IPv6 broadcast destinations. */
   if(unicast(IP6Address(ipp->ip6_dst)) == 0)
-    goto out;
+    return 0;
 
   /* Don't respond to e.g. Ethernet broadcasts or multicasts. */
   if (p->packet_type_anno() == Packet::BROADCAST || p->packet_type_anno() == Packet::MULTICAST)
-    goto out;
+    return 0;
+
+  /* Limit the error rate per source prefix. RFC4443 2.4.f */
+  if (_limiter.limited()) {
+    const uint32_t *a = reinterpret_cast<const uint32_t *>(&ipp->ip6_src);
+    const uint32_t *m = _prefix.data32();
+    uint32_t key = (a[0] & m[0]) ^ ((a[1] & m[1]) * 0x85EBCA6BU)
+      ^ ((a[2] & m[2]) * 0xC2B2AE35U) ^ ((a[3] & m[3]) * 0x27D4EB2FU);
+    if (!_limiter.allow(key, now)) {
+      _rate_limited++;
+      return 0;
+    }
+  }
 
 
   /* send back as much of invoding packet as will fit without the ICMPv6 packet exceeding 576 octets , ICMP6 header is 8 octets*/
@@ -167,33 +219,24 @@ ICMP6Error::simple_action(Packet *p)
     xlen = 568;
 
   if (_type != ICMP6_REDIRECT)
-    q = Packet::make(sizeof(struct click_ip6) + sizeof(struct click_icmp6) + xlen);
+    hsz = sizeof(struct click_ip6) + sizeof(struct click_icmp6);
   else
-    q = Packet::make(sizeof(struct click_ip6) + sizeof(struct click_icmp6_redirect) + xlen);
+    hsz = sizeof(struct click_ip6) + sizeof(struct click_icmp6_redirect);
+  q = Packet::make(hsz + xlen);
+  if (!q)
+    return 0;
 
-  // guaranteed that packet data is aligned
-  memset(q->data(), '\0', q->length());
+  // copy the headers from the template; guaranteed that packet data is
+  // aligned
+  memcpy(q->data(), _template, hsz);
 
   //set ip6 header
   nip = (click_ip6 *) q->data();
-  nip->ip6_flow = 0;	/* must set first: overlaps vfc */
-  nip->ip6_v = 6;
   nip->ip6_plen = htons(q->length()-40);
-  nip->ip6_nxt = IP_PROTO_ICMP6;  /* next header */
-  nip->ip6_hlim = 0xff; //what hop limit shoud I set?
-  nip->ip6_src = _src_ip;
   nip->ip6_dst = ipp->ip6_src;
 
   //set icmp6 Message
   icp = (click_icmp6 *) (nip + 1);
-  icp->icmp6_type = _type;
-  icp->icmp6_code = _code;
-
-
-  if(_type == ICMP6_PKTTOOBIG && _code == 0){
-    /* Set the mtu value. */
-    ((click_icmp6_pkttoobig *)icp)->icmp6_mtusize = 1500;
-  }
 
   if(_type == 4 && _code == 0){
     /* Set the Parameter Problem pointer. */
@@ -206,20 +249,67 @@ ICMP6Error::simple_action(Packet *p)
     click_icmp6_redirect *icpr = (click_icmp6_redirect *) (nip + 1);
     icpr->icmp6_target = DST_IP6_ANNO(p);
     icpr->icmp6_dst = ipp->ip6_dst;
-    memcpy((void *)(icpr + 1), p->data(), xlen);
-  } else
-    memcpy((void *)(icp + 1), p->data(), xlen);
+  }
+  memcpy(q->data() + hsz, p->data(), xlen);
 
   icp->icmp6_cksum = htons(in6_fast_cksum(&nip->ip6_src, &nip->ip6_dst, nip->ip6_plen, nip->ip6_nxt, 0, (unsigned char *)icp, nip->ip6_plen));
 
   SET_DST_IP6_ANNO(q, IP6Address(nip->ip6_dst));
   SET_FIX_IP_SRC_ANNO(q, 1); // fix_ip_src: shared flag with IPv4
   q->set_ip6_header(nip, sizeof(click_ip6));
+  return q;
+}
 
- out:
+Packet *
+ICMP6Error::simple_action(Packet *p)
+{
+  WritablePacket *q = generate(p, _limiter.now());
   p->kill();
-  return(q);
+  return q;
+}
+
+void
+ICMP6Error::simple_action_batch(PacketBatch &batch)
+{
+  TokenRate::time_point_type now = _limiter.now();
+  PacketBatch out;
+  while (Packet *p = batch.pop_front()) {
+    if (WritablePacket *q = generate(p, now))
+      out.push_back(q);
+    p->kill();
+  }
+  batch.swap(out);
+}
+
+void
+ICMP6Error::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+ICMP6Error::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
+String
+ICMP6Error::read_handler(Element *e, void *)
+{
+  ICMP6Error *ie = static_cast<ICMP6Error *>(e);
+  return String(ie->_rate_limited.value());
+}
+
+void
+ICMP6Error::add_handlers()
+{
+  add_read_handler("rate_limited", read_handler);
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(ICMPErrorLimiter)
 EXPORT_ELEMENT(ICMP6Error)
@@ -2,11 +2,15 @@
 #define CLICK_ICMP6ERROR_HH
 #include <click/element.hh>
 #include <click/ip6address.hh>
+#include <click/atomic.hh>
+#include <clicknet/ip6.h>
+#include <clicknet/icmp6.h>
+#include "elements/icmp/icmperrorlimiter.hh"
 CLICK_DECLS
 
 /*
  * =c
- * ICMP6Error(IP6ADDR, TYPE, CODE)
+ * ICMP6Error(IP6ADDR, TYPE, CODE [, I<keywords> RATE, BURST, PREFIX, BUCKETS])
  * =s ip6
  *
  * =d
@@ -21,8 +25,10 @@ CLICK_DECLS
  *
  * The intent is that elements that give rise to errors, like DecIP6HLIM,
  * should have two outputs, one of which is connected to an ICMP6Error.
- * Perhaps the ICMP6Error()s should be followed by a rate limiting
- * element.
+ * With RATE set, each source prefix may receive at most RATE errors per
+ * second; packets over the limit are dropped before any error is built.
+ * The fixed parts of the error's headers are prepared at initialization
+ * time, and a batch of packets shares one clock read.
  *
  * ICMP6Error never generates a packet in response to an ICMP6 error packet,
  * a fragment, or a link broadcast.
@@ -30,16 +36,43 @@ CLICK_DECLS
  * The output of ICMPE6rror should be connected to the routing lookup
  * machinery, much as if the ICMP6 errors came from a hardware interface.
  *
+ * Keyword arguments are:
  *
+ * =over 8
+ *
+ * =item RATE
+ *
+ * Unsigned.  The maximum number of errors per second sent to each source
+ * prefix.  0 means unlimited.  Defaults to 0.
+ *
+ * =item BURST
+ *
+ * Unsigned.  The number of errors a prefix may receive at once after a quiet
+ * period.  Defaults to RATE.
+ *
+ * =item PREFIX
+ *
+ * Integer between 0 and 128.  Sources are limited together when their first
+ * PREFIX bits match.  Defaults to 64.
+ *
+ * =item BUCKETS
+ *
+ * Unsigned.  The number of token buckets, rounded up to a power of two.
+ * Defaults to 1024.
+ *
+ * =back
+ *
+ * =h rate_limited read-only
+ *
+ * Returns the number of packets dropped by the rate limit.
  *
  * =e
  * This configuration fragment produces ICMP6 Time Exceeded error
  * messages in response to HLIM expirations, but limits the
- * rate at which such messages can be sent to 10 per second:
+ * rate at which such messages can be sent to each /64 to 10 per second:
  *
  *   dt : DecIP6HLIM();
- *   dt[1] -> ICMP6Error(18.26.4.24, 3, 0) -> m :: RatedSplitter(10) -> ...
- *   m[1] -> Discard;
+ *   dt[1] -> ICMP6Error(3ffe:1ce1:2::1, 3, 0, RATE 10) -> ...
  *
  * =n
  *
@@ -47,7 +80,7 @@ CLICK_DECLS
  * IP6 directed broadcast address; it is supposed to ignore packets with such
  * addresses.
  *
- * =a DecIP6HLIM */
+ * =a DecIP6HLIM, ICMPError */
 
 class ICMP6Error : public Element {
 public:
@@ -58,20 +91,31 @@ public:
   const char *port_count() const		{ return PORTS_1_1; }
   int configure(Vector<String> &, ErrorHandler *);
   int initialize(ErrorHandler *errh);
+  void add_handlers();
 
   Packet *simple_action(Packet *);
+  void simple_action_batch(PacketBatch &batch);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, PacketBatch &batch, int max);
 
 private:
 
   IP6Address _src_ip;
   int _type;
   int _code;
+  IP6Address _prefix;
+  ICMPErrorLimiter _limiter;
+  atomic_uint32_t _rate_limited;
+  uint8_t _template[sizeof(click_ip6) + sizeof(click_icmp6_redirect)];
 
   static bool is_error_type(int);
   static bool is_redirect_type(int);
   bool unicast(const IP6Address &aa);
   bool valid_source(const IP6Address &aa);
   bool has_route_opt(const click_ip6 *ip);
+  inline WritablePacket *generate(Packet *p, TokenRate::time_point_type now);
+
+  static String read_handler(Element *e, void *thunk);
 
 };
 
@@ -21,6 +21,7 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 IP6Fragmenter::IP6Fragmenter()
@@ -38,70 +39,155 @@ IP6Fragmenter::~IP6Fragmenter()
 int
 IP6Fragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh).read_mp("MTU", _mtu).complete();
+  _headroom = Packet::default_headroom;
+  if (Args(conf, this, errh)
+      .read_mp("MTU", _mtu)
+      .read("HEADROOM", _headroom)
+      .complete() < 0)
+    return -1;
+  if (_mtu < sizeof(click_ip6) + sizeof(click_ip6_fragment) + 8)
+    return errh->error("MTU must be at least %d",
+		       (int) (sizeof(click_ip6) + sizeof(click_ip6_fragment) + 8));
+  _id = click_random();
+  return 0;
 }
 
- /*
-int
-IP6Fragmenter::optcopy(click_ip6 *ip1, click_ip6 *ip2)
+void
+IP6Fragmenter::drop_it(Packet *p)
 {
-  int opts = (ip1->ip_hl << 2) - sizeof(click_ip6);
-  u_char *base1 = (u_char *) (ip1 + 1);
-  int i1, optlen;
-  int i2 = 0;
-  u_char *base2 = (u_char *) (ip2 + 1);
-
-  for(i1 = 0; i1 < opts; i1 += optlen){
-    int opt = base1[i1];
-    if(opt == IPOPT_EOL)
-      break;
-    if(opt == IPOPT_NOP){
-      optlen = 1;
-    } else {
-      optlen = base1[i1+1];
+  _drops++;
+  if (noutputs() == 2)
+    output(1).push(p);
+  else
+    p->kill();
+}
+
+void
+IP6Fragmenter::fragment(Packet *p_in, PacketBatch &out)
+{
+  const unsigned char *nh = p_in->network_header();
+  int in_len = p_in->network_length();
+
+  // Find the unfragmentable part: the IP6 header, then extension headers up
+  // to the last Hop-by-Hop or Routing header.  nxt_off is the offset of the
+  // next header field that will name the Fragment header.
+  int unfrag = sizeof(click_ip6), nxt_off = 6;
+  uint8_t nxt = nh[nxt_off];
+  for (int off = unfrag;
+       nxt == IP6_NXT_HOPOPTS || nxt == IP6_NXT_ROUTING || nxt == IP6_NXT_DSTOPTS; ) {
+    if (off + 8 > in_len || off + ((nh[off + 1] + 1) << 3) > in_len) {
+      drop_it(p_in);
+      return;
     }
+    int len = (nh[off + 1] + 1) << 3;
+    if (nxt != IP6_NXT_DSTOPTS) {
+      unfrag = off + len;
+      nxt_off = off;
+    }
+    nxt = nh[off];
+    off += len;
+  }
+  uint8_t frag_nxt = nh[nxt_off];
 
-    if(opt & 0x80){
-    // copy it
-      if(ip2){
-        memcpy(base2 + i2, base1 + i1, optlen);
-      }
-      i2 += optlen;
+  int in_dlen = in_len - unfrag;
+  int chunk = ((int) _mtu - unfrag - (int) sizeof(click_ip6_fragment)) & ~7;
+  if (frag_nxt == IP6_NXT_FRAGMENT || chunk < 8) {
+    drop_it(p_in);
+    return;
+  }
+
+  click_ip6_fragment fh;
+  fh.ip6f_nxt = frag_nxt;
+  fh.ip6f_reserved = 0;
+  fh.ip6f_ident = htonl(_id.fetch_and_add(1));
+  const int fhlen = sizeof(click_ip6_fragment);
+
+  // Copy out the later fragments before the input is rewritten.
+  PacketBatch rest;
+  const unsigned char *payload = nh + unfrag;
+  for (int off = chunk; off < in_dlen; off += chunk) {
+    int out_dlen = (off + chunk < in_dlen ? chunk : in_dlen - off);
+    if (WritablePacket *q = Packet::make(_headroom, 0, unfrag + fhlen + out_dlen, 0)) {
+      unsigned char *d = q->data();
+      memcpy(d, nh, unfrag);
+      d[nxt_off] = IP6_NXT_FRAGMENT;
+      fh.ip6f_offlg = htons(off | (off + out_dlen < in_dlen ? IP6F_MORE_FRAG : 0));
+      memcpy(d + unfrag, &fh, fhlen);
+      memcpy(d + unfrag + fhlen, payload + off, out_dlen);
+      click_ip6 *qip = reinterpret_cast<click_ip6 *>(d);
+      qip->ip6_plen = htons(unfrag + fhlen + out_dlen - sizeof(click_ip6));
+      q->set_ip6_header(qip, unfrag);
+      q->copy_annotations(p_in);
+      rest.push_back(q);
     }
   }
 
-  for( ; i2 & 3; i2++)
-    if(ip2)
-      base2[i2] = IPOPT_EOL;
+  // The first fragment reuses the input's buffer.  The link header and the
+  // unfragmentable part move fhlen bytes into the headroom, opening a gap
+  // for the Fragment header in front of the payload, which stays put.  A
+  // shared input would have to be copied whole to be written, so copy just
+  // the first fragment instead.
+  int nh_off = p_in->network_header_offset();
+  int mac_off = p_in->has_mac_header() ? p_in->mac_header_offset() : -1;
+  int first_len = nh_off + unfrag + fhlen + chunk;
+  WritablePacket *p;
+  if (!p_in->shared()) {
+    p = p_in->uniqueify()->push(fhlen);
+    if (p) {
+      memmove(p->data(), p->data() + fhlen, nh_off + unfrag);
+      p->take(p->length() - first_len);
+    }
+  } else {
+    p = Packet::make(p_in->headroom(), 0, first_len, 0);
+    if (p) {
+      memcpy(p->data(), p_in->data(), nh_off + unfrag);
+      memcpy(p->data() + nh_off + unfrag + fhlen, payload, chunk);
+      p->copy_annotations(p_in);
+    }
+    p_in->kill();
+  }
+  if (p) {
+    unsigned char *d = p->data() + nh_off;
+    d[nxt_off] = IP6_NXT_FRAGMENT;
+    fh.ip6f_offlg = htons(IP6F_MORE_FRAG);
+    memcpy(d + unfrag, &fh, fhlen);
+    click_ip6 *ip = reinterpret_cast<click_ip6 *>(d);
+    ip->ip6_plen = htons(unfrag + fhlen + chunk - sizeof(click_ip6));
+    p->set_ip6_header(ip, unfrag);
+    if (mac_off >= 0)
+      p->set_mac_header(p->data() + mac_off);
+    out.push_back(p);
+  }
 
-  return(i2);
+  _fragments += rest.count() + (p ? 1 : 0);
+  out.append(rest);
 }
 
-*/
 void
-IP6Fragmenter::fragment(Packet *)
-{ }
+IP6Fragmenter::push(int, Packet *p)
+{
+  if (p->network_length() <= (int) _mtu)
+    output(0).push(p);
+  else {
+    PacketBatch out;
+    fragment(p, out);
+    if (!out.empty())
+      output(0).push_batch(out);
+  }
+}
 
-/*
-inline Packet *
-IP6Fragmenter::smaction(Packet *p)
+void
+IP6Fragmenter::push_batch(int, PacketBatch &batch)
 {
-  if (p->length() <= _mtu)
-    {
-      //click_chatter("IP6Fragmenter: length is OK, <= %x \n", _mtu);
-      return(p);
-    }
-  else
-    {
-      click_chatter("IP6Fragmenter: length is not OK, > %x \n", _mtu);
-      if (noutputs() == 2)
-	output(1).push(p);
-      else
-	p->kill();
-      return 0;
-    }
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if (p->network_length() <= (int) _mtu)
+      out.push_back(p);
+    else
+      fragment(p, out);
+  if (!out.empty())
+    output(0).push_batch(out);
 }
-*/
 
 static String
 IP6Fragmenter_read_drops(Element *xf, void *)
@@ -124,22 +210,5 @@ IP6Fragmenter::add_handlers()
   add_read_handler("fragments", IP6Fragmenter_read_fragments, 0);
 }
 
-
-void
-IP6Fragmenter::push(int, Packet *p)
-{
-  // click_chatter("IP6Fragmenter::push, packet length is %x \n", p->length());
-  if (p->length() <= _mtu)
-    {
-      // click_chatter("**********************1");
-    output(0).push(p);
-    }
-  else
-    {
-      // click_chatter("**********************2");
-      // output(0).push(p);
-    }
-}
-
 CLICK_ENDDECLS
 EXPORT_ELEMENT(IP6Fragmenter)
@@ -2,44 +2,71 @@
 #define CLICK_IP6FRAGMENTER_HH
 #include <click/element.hh>
 #include <click/glue.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 
 /*
  * =c
- * IP6Fragmenter(MTU)
+ * IP6Fragmenter(MTU, I<keywords> HEADROOM)
  * =s ip6
  *
  * =d
- * Expects IP6 packets as input.
- * If the IP6 packet size is <= mtu, just emits the packet on output 0.
- * If the size is greater than mtu and DF isn't set, splits into
- * fragments emitted on output 0.
- * If DF is set and size is greater than mtu, sends to output 1.
+ * Expects IP6 packets as input, with their network header annotations set.
+ * If the IP6 packet size is <= MTU, just emits the packet on output 0.
+ * If the size is greater than MTU, splits the packet into fragments, each
+ * with a Fragment extension header, and emits them on output 0 as one batch,
+ * first fragment first.  The IP6 header and any Hop-by-Hop and Routing
+ * headers, the unfragmentable part, are repeated in every fragment.
  *
+ * Packets that cannot be fragmented, because they already carry a Fragment
+ * header, have malformed extension headers, or have an unfragmentable part
+ * too long for MTU, are sent to output 1, or dropped if there is no output 1.
  * Ordinarily output 1 is connected to an ICMP6Error packet generator
- * with type 3 (UNREACH) and code 4 (NEEDFRAG).
+ * with type 2 (Packet Too Big).
  *
- * Only the mac_broadcast annotation is copied into the fragments.
+ * The first fragment reuses the input packet's buffer: the unfragmentable
+ * part moves into the headroom to make room for the Fragment header, and the
+ * payload is not copied.  A shared input has just its first fragment copied.
+ * Later fragments get their own buffers, with one copy of their payload.
  *
- * Sends the first fragment last.
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item HEADROOM
+ *
+ * Unsigned. Headroom for later fragments.  Default is the default packet
+ * headroom.
+ *
+ * =back
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that could not be fragmented.
+ *
+ * =h fragments read-only
+ *
+ * Returns the number of fragments sent.
  *
  * =e
  * Example:
  *
- *   ... -> fr::IP6Fragmenter -> Queue(20) -> ...
- *   fr[1] -> ICMP6Error(18.26.4.24, 3, 4) -> ...
+ *   ... -> fr::IP6Fragmenter(1280) -> Queue(20) -> ...
+ *   fr[1] -> ICMP6Error(3ffe:1ce1:2::1, 2, 0) -> ...
  *
- * =a ICMP6Error, CheckLength
+ * =a ICMP6Error, IPFragmenter, CheckLength
  */
 
 class IP6Fragmenter : public Element {
 
   unsigned _mtu;
+  unsigned _headroom;
+  atomic_uint32_t _id;
   int _drops;
   int _fragments;
 
-  void fragment(Packet *);
-  //int optcopy(const click_ip6 *ip1, click_ip6 *ip2);
+  void fragment(Packet *, PacketBatch &);
+  void drop_it(Packet *);
 
  public:
 
@@ -57,7 +84,7 @@ class IP6Fragmenter : public Element {
   void add_handlers();
 
   void push(int, Packet *p);
-
+  void push_batch(int, PacketBatch &batch);
 
 };
 
@@ -24,13 +24,14 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
+#include <click/router.hh>
 #include "ip6routetable.hh"
 CLICK_DECLS
 
 void *
 IP6RouteTable::cast(const char *name)
 {
-    if (strcmp(name, "IPRouteTable") == 0)
+    if (strcmp(name, "IP6RouteTable") == 0)
 	return (void *)this;
     else
 	return Element::cast(name);
@@ -51,6 +52,19 @@ IP6RouteTable::remove_route(IP6Address, IP6Address, ErrorHandler *errh)
     return errh->error("cannot delete routes from this routing table");
 }
 
+int
+IP6RouteTable::lookup_route(IP6Address, IP6Address &) const
+{
+    return -1;			// by default, route lookups fail
+}
+
+void
+IP6RouteTable::lookup_routes(int n, const IP6Address *addr, IP6Address *gw, int *port) const
+{
+    for (int i = 0; i < n; ++i)
+	port[i] = lookup_route(addr[i], gw[i]);
+}
+
 String
 IP6RouteTable::dump_routes()
 {
@@ -84,6 +98,8 @@ IP6RouteTable::add_route_handler(const String &conf, Element *e, void *, ErrorHa
         ok = errh->error("output port out of range");
     if (ok >= 0)
         ok = r->add_route(dst, mask, gw, port, errh);
+    if (ok >= 0)
+	r->router()->bump_forwarding_epoch();
     return ok;
 }
 
@@ -104,20 +120,36 @@ IP6RouteTable::remove_route_handler(const String &conf, Element *e, void *, Erro
 
     if (ok >= 0)
 	ok = r->remove_route(a, mask, errh);
+    if (ok >= 0)
+	r->router()->bump_forwarding_epoch();
     return ok;
 }
 
 int
 IP6RouteTable::ctrl_handler(const String &conf_in, Element *e, void *thunk, ErrorHandler *errh)
 {
-    String conf = conf_in;
-    String first_word = cp_shift_spacevec(conf);
-    if (first_word == "add")
-	return add_route_handler(conf, e, thunk, errh);
-    else if (first_word == "remove")
-	return remove_route_handler(conf, e, thunk, errh);
-    else
-	return errh->error("bad command, should be `add' or `remove'");
+    String conf = cp_uncomment(conf_in);
+    const char *s = conf.begin(), *end = conf.end();
+
+    while (s < end) {
+	const char *nl = find(s, end, '\n');
+	String line = conf.substring(s, nl);
+	s = nl + 1;
+
+	String first_word = cp_shift_spacevec(line);
+	int r;
+	if (first_word == "add" || first_word == "set")
+	    r = add_route_handler(line, e, thunk, errh);
+	else if (first_word == "remove")
+	    r = remove_route_handler(line, e, thunk, errh);
+	else if (!first_word)
+	    continue;
+	else
+	    r = errh->error("bad command, should be `add' or `remove'");
+	if (r < 0)
+	    return r;
+    }
+    return 0;
 }
 
 String
@@ -127,5 +159,33 @@ IP6RouteTable::table_handler(Element *e, void *)
     return r->dump_routes();
 }
 
+int
+IP6RouteTable::lookup_handler(int, String &s, Element *e, const Handler *, ErrorHandler *errh)
+{
+    IP6RouteTable *table = static_cast<IP6RouteTable *>(e);
+    IP6Address a;
+    if (IP6AddressArg().parse(s, a, table)) {
+	IP6Address gw;
+	int port = table->lookup_route(a, gw);
+	if (gw)
+	    s = String(port) + " " + gw.unparse();
+	else
+	    s = String(port);
+	return 0;
+    } else
+	return errh->error("expected IPv6 address");
+}
+
+void
+IP6RouteTable::add_handlers()
+{
+    add_write_handler("add", add_route_handler, 0);
+    add_write_handler("set", add_route_handler, 0);
+    add_write_handler("remove", remove_route_handler, 0);
+    add_write_handler("ctrl", ctrl_handler, 0);
+    add_read_handler("table", table_handler, 0, Handler::EXPENSIVE);
+    set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
+}
+
 CLICK_ENDDECLS
 ELEMENT_PROVIDES(IP6RouteTable)
@@ -5,17 +5,69 @@
 #include <click/element.hh>
 CLICK_DECLS
 
+/*
+=c
+
+IP6RouteTable
+
+=s ip6
+
+IPv6 routing table superclass
+
+=d
+
+IP6RouteTable defines an interface for IPv6 route lookup elements, analogous
+to IPRouteTable for IPv4.  Subclasses override the virtual functions
+B<add_route>, B<remove_route>, B<lookup_route>, and B<dump_routes>, and call
+B<add_handlers> to provide the handlers below.  Subclasses whose tables can
+overlap several lookups also override B<lookup_routes>, which looks up a
+batch of addresses; by default it calls B<lookup_route> once per address.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.
+
+=h lookup read-only, requires parameters
+
+Reports the OUTput port and GW corresponding to an address.
+
+=h add write-only
+
+Adds a route to the table.  Format should be `C<ADDR/MASK [GW] OUT>'.  An
+existing route for C<ADDR/MASK> is replaced.
+
+=h set write-only
+
+Same as C<add>.
+
+=h remove write-only
+
+Removes a route from the table.  Format should be `C<ADDR/MASK>'.
+
+=h ctrl write-only
+
+Adds or removes a group of routes.  Write `C<add>/C<set ADDR/MASK [GW] OUT>'
+to add a route, and `C<remove ADDR/MASK>' to remove a route.  You can supply
+multiple commands, one per line.  Commands are executed in order; processing
+stops at the first error.
+
+=a IPRouteTable, LookupIP6Route */
+
 class IP6RouteTable : public Element { public:
 
     void* cast(const char*);
+    void add_handlers();
 
     virtual int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
     virtual int remove_route(IP6Address, IP6Address, ErrorHandler *);
+    virtual int lookup_route(IP6Address, IP6Address &) const;
+    virtual void lookup_routes(int n, const IP6Address *addr, IP6Address *gw, int *port) const;
     virtual String dump_routes();
 
     static int add_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int remove_route_handler(const String&, Element*, void*, ErrorHandler*);
     static int ctrl_handler(const String&, Element*, void*, ErrorHandler*);
+    static int lookup_handler(int operation, String&, Element*, const Handler*, ErrorHandler*);
     static String table_handler(Element*, void*);
 
 };
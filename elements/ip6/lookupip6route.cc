@@ -21,6 +21,9 @@
 #include <click/ip6address.hh>
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packetbatch.hh>
+#include "elements/standard/classification.hh"
 CLICK_DECLS
 
 LookupIP6Route::LookupIP6Route()
@@ -80,12 +83,18 @@ LookupIP6Route::configure(Vector<String> &conf, ErrorHandler *errh)
 
 int
 LookupIP6Route::initialize(ErrorHandler *)
+{
+  flush_cache();
+  return 0;
+}
+
+void
+LookupIP6Route::flush_cache()
 {
   _last_addr = IP6Address();
-  #ifdef IP_RT_CACHE2
+#ifdef IP_RT_CACHE2
   _last_addr2 = _last_addr;
 #endif
-  return 0;
 }
 
 void
@@ -133,7 +142,7 @@ LookupIP6Route::push(int, Packet *p)
     _last_addr = a;
     _last_gw = gw;
     _last_output = ifi;
-    if (gw != IP6Address("::0")) {
+    if (gw) {
 	SET_DST_IP6_ANNO(p, IP6Address(gw));
     }
     output(ifi).push(p);
@@ -143,6 +152,29 @@ LookupIP6Route::push(int, Packet *p)
   }
 }
 
+void
+LookupIP6Route::push_batch(int, PacketBatch &batch)
+{
+  Packet *p[BATCH_LANES];
+  IP6Address addr[BATCH_LANES], gw[BATCH_LANES];
+  int port[BATCH_LANES];
+
+  while (!batch.empty()) {
+    int n = 0;
+    for (; n < BATCH_LANES && !batch.empty(); ++n) {
+      p[n] = batch.pop_front();
+      addr[n] = DST_IP6_ANNO(p[n]);
+    }
+    _t.lookup(n, addr, gw, port);
+    for (int i = 0; i < n; ++i)
+      if (port[i] < 0)
+	port[i] = noutputs();	// killed by push_batch_by_output
+      else if (gw[i])
+	SET_DST_IP6_ANNO(p[i], gw[i]);
+    Classification::push_batch_by_output(this, p, port, n);
+  }
+}
+
 int
 LookupIP6Route::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
                           int output, ErrorHandler *errh)
@@ -151,25 +183,56 @@ LookupIP6Route::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
     return errh->error("port number out of range"); // Can't happen...
 
   _t.add(addr, mask, gw, output);
+  flush_cache();
   return 0;
 }
 
 int
 LookupIP6Route::remove_route(IP6Address addr, IP6Address mask,
-			     ErrorHandler *)
+			     ErrorHandler *errh)
 {
+  IP6Address gw;
+  int output;
+  if (!_t.find(addr, mask, gw, output))
+    return errh->error("route %<%s/%d%> not found", addr.unparse().c_str(), mask.mask_to_prefix_len());
   _t.del(addr, mask);
+  flush_cache();
   return 0;
 }
 
+int
+LookupIP6Route::lookup_route(IP6Address addr, IP6Address &gw) const
+{
+  int output;
+  if (_t.lookup(addr, gw, output))
+    return output;
+  gw = IP6Address();
+  return -1;
+}
+
+void
+LookupIP6Route::lookup_routes(int n, const IP6Address *addr, IP6Address *gw, int *port) const
+{
+  _t.lookup(n, addr, gw, port);
+}
+
+String
+LookupIP6Route::read_handler(Element *e, void *)
+{
+  LookupIP6Route *r = static_cast<LookupIP6Route *>(e);
+  StringAccum sa;
+  sa << "routes " << r->_t.size() << '\n'
+     << "nodes " << r->_t.node_count() << '\n';
+  return sa.take_string();
+}
+
 void
 LookupIP6Route::add_handlers()
 {
-    add_write_handler("add", add_route_handler, 0);
-    add_write_handler("remove", remove_route_handler, 0);
-    add_write_handler("ctrl", ctrl_handler, 0);
-    add_read_handler("table", table_handler, 0);
+    IP6RouteTable::add_handlers();
+    add_read_handler("stats", read_handler, 0);
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(Classification)
 EXPORT_ELEMENT(LookupIP6Route)
@@ -37,6 +37,48 @@ CLICK_DECLS
  *   rt[2] -> ... -> ToDevice(eth1);
  *   ...
  *
+ * =n
+ *
+ * Routes are stored in a tree bitmap with 8-bit strides, so a lookup visits
+ * at most one trie node per address byte regardless of the table size.
+ * Routes with non-prefix masks are supported, but are searched linearly.
+ *
+ * Batches are looked up 16 packets at a time.  The 16 trie walks advance
+ * together, one level per round, with each walk's next node prefetched, and
+ * the packets then leave in one batch per output.  Batched lookups bypass
+ * the last-address cache that single packets use.
+ *
+ * =h table read-only
+ *
+ * Outputs a human-readable version of the current routing table.
+ *
+ * =h lookup read-only, requires parameters
+ *
+ * Reports the OUTput port and GW corresponding to an address.
+ *
+ * =h add write-only
+ *
+ * Adds a route to the table.  Format should be `C<ADDR/MASK [GW] OUT>'.
+ * An existing route for the same prefix is replaced.
+ *
+ * =h set write-only
+ *
+ * Same as C<add>.
+ *
+ * =h remove write-only
+ *
+ * Removes a route from the table.  Format should be `C<ADDR/MASK>'.
+ *
+ * =h ctrl write-only
+ *
+ * Adds or removes a group of routes, one `C<add>/C<set ADDR/MASK [GW] OUT>'
+ * or `C<remove ADDR/MASK>' command per line.
+ *
+ * =h stats read-only
+ *
+ * Reports the number of routes and trie nodes.
+ *
+ * =a IP6RouteTable, IPRouteTable
  */
 
 class LookupIP6Route : public IP6RouteTable {
@@ -53,13 +95,18 @@ public:
   void add_handlers();
 
   void push(int port, Packet *p);
+  void push_batch(int port, PacketBatch &batch);
 
   int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
   int remove_route(IP6Address, IP6Address, ErrorHandler *);
+  int lookup_route(IP6Address, IP6Address &) const;
+  void lookup_routes(int n, const IP6Address *addr, IP6Address *gw, int *port) const;
   String dump_routes()				{ return _t.dump(); };
 
 private:
 
+  enum { BATCH_LANES = 16 };
+
   IP6Table _t;
 
   IP6Address _last_addr;
@@ -72,6 +119,9 @@ private:
   int _last_output2;
 #endif
 
+  void flush_cache();
+  static String read_handler(Element *, void *);
+
 };
 
 CLICK_ENDDECLS
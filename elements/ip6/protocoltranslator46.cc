@@ -25,6 +25,7 @@
 #include <clicknet/icmp6.h>
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 ProtocolTranslator46::ProtocolTranslator46()
@@ -69,13 +70,22 @@ ProtocolTranslator46::make_translate46(IP6Address src,
   if (ip->ip_p == 6) //TCP
     {
       ip6->ip6_nxt = ip->ip_p;
-      tcp->th_sum = htons(in6_fast_cksum(&ip6->ip6_src, &ip6->ip6_dst, ip6->ip6_plen, ip6->ip6_nxt, tcp->th_sum, a, ip6->ip6_plen));
+      // only the pseudoheader's addresses change
+      click_update_in_cksum_range(&tcp->th_sum,
+				  (const unsigned char *) &ip->ip_src, 8,
+				  (const unsigned char *) &ip6->ip6_src, 32);
     }
 
   else if (ip->ip_p == 17) //UDP
     {
       ip6->ip6_nxt = ip->ip_p;
-      udp->uh_sum = htons(in6_fast_cksum(&ip6->ip6_src, &ip6->ip6_dst, ip6->ip6_plen, ip6->ip6_nxt, udp->uh_sum, a, ip6->ip6_plen));
+      // an IPv4 UDP checksum is optional, but an IPv6 one is not
+      if (udp->uh_sum)
+	click_update_in_cksum_range(&udp->uh_sum,
+				    (const unsigned char *) &ip->ip_src, 8,
+				    (const unsigned char *) &ip6->ip6_src, 32);
+      else
+	udp->uh_sum = htons(in6_fast_cksum(&ip6->ip6_src, &ip6->ip6_dst, ip6->ip6_plen, ip6->ip6_nxt, udp->uh_sum, a, ip6->ip6_plen));
     }
 
   else if (ip->ip_p == 1)
@@ -271,14 +281,71 @@ ProtocolTranslator46::make_icmp_translate46(IP6Address ip6_src,
 }
 
 
-void
-ProtocolTranslator46::push(int, Packet *p)
+//translate a TCP or UDP packet in place: the IPv6 header takes the
+//IPv4 header's place plus 20 bytes of headroom, and the payload stays
+//where it is
+Packet *
+ProtocolTranslator46::translate46_in_place(IP6Address src,
+					    IP6Address dst,
+					    Packet *p)
 {
-    handle_ip4(p);
+  click_ip ip = *(const click_ip *) p->data();
+  unsigned len = ntohs(ip.ip_len);
+
+  WritablePacket *q = p->push(sizeof(click_ip6) - sizeof(click_ip));
+  if (!q)
+    return 0;
+  if (q->length() > sizeof(click_ip6) - sizeof(click_ip) + len)
+    q->take(q->length() - (sizeof(click_ip6) - sizeof(click_ip) + len));
+  q->clear_annotations(false);
+
+  click_ip6 *ip6 = (click_ip6 *)q->data();
+  ip6->ip6_flow = 0;	/* must set first: overlaps vfc */
+  ip6->ip6_v = 6;
+  ip6->ip6_plen = htons(len - sizeof(click_ip));
+  ip6->ip6_nxt = ip.ip_p;
+  ip6->ip6_hlim = ip.ip_ttl + 0x40-0xff;
+  ip6->ip6_src = src;
+  ip6->ip6_dst = dst;
+
+  // only the pseudoheader's addresses change
+  if (ip.ip_p == IP_PROTO_TCP) {
+    click_tcp *tcp = (click_tcp *)(ip6+1);
+    click_update_in_cksum_range(&tcp->th_sum,
+				(const unsigned char *) &ip.ip_src, 8,
+				(const unsigned char *) &ip6->ip6_src, 32);
+  } else {
+    click_udp *udp = (click_udp *)(ip6+1);
+    // an IPv4 UDP checksum is optional, but an IPv6 one is not
+    if (udp->uh_sum)
+      click_update_in_cksum_range(&udp->uh_sum,
+				  (const unsigned char *) &ip.ip_src, 8,
+				  (const unsigned char *) &ip6->ip6_src, 32);
+    else
+      udp->uh_sum = htons(in6_fast_cksum(&ip6->ip6_src, &ip6->ip6_dst, ip6->ip6_plen, ip6->ip6_nxt, 0, (unsigned char *)udp, ip6->ip6_plen));
+  }
+
+  q->set_ip6_header(ip6);
+  return q;
+}
+
+
+Packet *
+ProtocolTranslator46::simple_action(Packet *p)
+{
+  return handle_ip4(p);
 }
 
 
 void
+ProtocolTranslator46::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+
+Packet *
 ProtocolTranslator46::handle_ip4(Packet *p)
 {
   click_ip *ip = (click_ip *)p->data();
@@ -286,6 +353,19 @@ ProtocolTranslator46::handle_ip4(Packet *p)
   IP6Address ip6a_src = IP6Address(IPAddress(ip->ip_src));
   IP6Address ip6a_dst = IP6Address(IPAddress(ip->ip_dst));
 
+  //TCP and UDP without IP options keep their length, so translate them in
+  //place when there is headroom for the longer header
+  unsigned len = ntohs(ip->ip_len);
+  if (ip->ip_hl == 5 && p->headroom() >= sizeof(click_ip6) - sizeof(click_ip)
+      && ((ip->ip_p == IP_PROTO_TCP && len >= sizeof(click_ip) + sizeof(click_tcp))
+	  || (ip->ip_p == IP_PROTO_UDP && len >= sizeof(click_ip) + sizeof(click_udp))))
+    {
+      if (p->length() >= len)
+	return translate46_in_place(ip6a_src, ip6a_dst, p);
+      p->kill();
+      return 0;
+    }
+
   unsigned char *start_of_p = (unsigned char *)(ip+1);
   Packet *q = 0;
   q=make_translate46(ip6a_src, ip6a_dst, ip, start_of_p);
@@ -296,6 +376,11 @@ ProtocolTranslator46::handle_ip4(Packet *p)
       unsigned char * icmp = (unsigned char *)(ip6+1);
       Packet *q2 = 0;
       q2 = make_icmp_translate46(ip6a_src, ip6a_dst, icmp, (q->length() - sizeof(click_ip6)));
+      if (!q2) {
+	p->kill();
+	q->kill();
+	return 0;
+      }
       WritablePacket *q3 = Packet::make(sizeof(click_ip6)+q2->length());
       memset(q3->data(), '\0', q3->length());
       click_ip6 *start_of_q3 = (click_ip6 *)q3->data();
@@ -308,12 +393,12 @@ ProtocolTranslator46::handle_ip4(Packet *p)
       p->kill();
       q->kill();
       q2->kill();
-      output(0).push(q3);
+      return q3;
     }
   else
     {
       p->kill();
-      output(0).push(q);
+      return q;
     }
 
 }
@@ -23,6 +23,9 @@ CLICK_DECLS
  * IPv4/v6 packets; for instance, translated packets have their IP, ICMP/ICMPv6,
  * TCP and/or UDP checksums updated.
  *
+ * TCP and UDP packets without IP options are translated in place when they
+ * have 20 bytes of headroom, and the transport checksum is adjusted for the
+ * new pseudoheader without summing the payload.  Other packets are rebuilt.
  *
  * =a AddressTranslator ProtocolTranslator64*/
 
@@ -36,11 +39,16 @@ class ProtocolTranslator46 : public Element {
 
   const char *class_name() const		{ return "ProtocolTranslator46"; }
   const char *port_count() const		{ return PORTS_1_1; }
-  void push(int port, Packet *p);
-  void handle_ip4(Packet *);
+  Packet *simple_action(Packet *p);
+  void push_batch(int port, PacketBatch &batch);
+  Packet *handle_ip4(Packet *);
 
 private:
 
+  Packet * translate46_in_place(IP6Address src,
+				IP6Address dst,
+				Packet *p);
+
   Packet * make_icmp_translate46(IP6Address ip6_src,
 				 IP6Address ip6_dst,
 				 unsigned char *a,
@@ -26,6 +26,7 @@
 #include <clicknet/icmp6.h>
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 ProtocolTranslator64::ProtocolTranslator64()
@@ -97,11 +98,11 @@ ProtocolTranslator64::make_translate64(IPAddress src,
 
       //set the ip header checksum
       ip->ip_sum = 0;
-      tcp->th_sum = 0;
 
-      uint16_t tlen = ntohs(ip6->ip6_plen);
-      uint16_t csum = click_in_cksum((unsigned char *) tcp, tlen);
-      tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, tlen);
+      // only the pseudoheader's addresses change
+      click_update_in_cksum_range(&tcp->th_sum,
+				  (const unsigned char *) &ip6->ip6_src, 32,
+				  (const unsigned char *) &ip->ip_src, 8);
       ip->ip_sum = click_in_cksum((unsigned char *)ip, sizeof(click_ip));
 
     }
@@ -111,12 +112,14 @@ ProtocolTranslator64::make_translate64(IPAddress src,
       ip->ip_p = ip6->ip6_nxt;
 
       //set the ip header checksum
-      ip->ip_sum=0;
-      udp->uh_sum = 0;
+      ip->ip_sum = 0;
 
-      uint16_t tlen = ntohs(ip6->ip6_plen);
-      uint16_t csum = click_in_cksum((unsigned char *) udp, tlen);
-      udp->uh_sum = click_in_cksum_pseudohdr(csum, ip, tlen);
+      // only the pseudoheader's addresses change
+      click_update_in_cksum_range(&udp->uh_sum,
+				  (const unsigned char *) &ip6->ip6_src, 32,
+				  (const unsigned char *) &ip->ip_src, 8);
+      if (udp->uh_sum == 0)
+	udp->uh_sum = 0xFFFF;
       ip->ip_sum = click_in_cksum((unsigned char *)ip, sizeof(click_ip));
 
     }
@@ -289,14 +292,74 @@ ProtocolTranslator64::make_icmp_translate64(unsigned char *a,
 
 
 
-void
-ProtocolTranslator64::push(int, Packet *p)
+//translate a TCP or UDP packet in place: the IPv4 header overwrites the
+//last 20 bytes of the IPv6 header, and the payload stays where it is
+Packet *
+ProtocolTranslator64::translate64_in_place(IPAddress src,
+					    IPAddress dst,
+					    Packet *p)
 {
-  handle_ip6(p);
+  click_ip6 ip6 = *(const click_ip6 *) p->data();
+  unsigned plen = ntohs(ip6.ip6_plen);
+
+  WritablePacket *q = p->uniqueify();
+  if (!q)
+    return 0;
+  if (q->length() > sizeof(click_ip6) + plen)
+    q->take(q->length() - sizeof(click_ip6) - plen);
+  q->pull(sizeof(click_ip6) - sizeof(click_ip));
+  q->clear_annotations(false);
+
+  click_ip *ip = (click_ip *)q->data();
+  ip->ip_v = 4;
+  ip->ip_hl = 5;
+  ip->ip_tos = 0;
+  ip->ip_len = htons(sizeof(*ip) + plen);
+  ip->ip_id = htons(0);
+  ip->ip_off = htons(IP_DF);
+  ip->ip_ttl = ip6.ip6_hlim;
+  ip->ip_p = ip6.ip6_nxt;
+  ip->ip_src = src.in_addr();
+  ip->ip_dst = dst.in_addr();
+  ip->ip_sum = 0;
+  ip->ip_sum = click_in_cksum((unsigned char *)ip, sizeof(click_ip));
+
+  // only the pseudoheader's addresses change
+  if (ip->ip_p == IP_PROTO_TCP) {
+    click_tcp *tcp = (click_tcp *)(ip+1);
+    click_update_in_cksum_range(&tcp->th_sum,
+				(const unsigned char *) &ip6.ip6_src, 32,
+				(const unsigned char *) &ip->ip_src, 8);
+  } else {
+    click_udp *udp = (click_udp *)(ip+1);
+    click_update_in_cksum_range(&udp->uh_sum,
+				(const unsigned char *) &ip6.ip6_src, 32,
+				(const unsigned char *) &ip->ip_src, 8);
+    if (udp->uh_sum == 0)
+      udp->uh_sum = 0xFFFF;
+  }
+
+  q->set_ip_header(ip, sizeof(click_ip));
+  return q;
+}
+
+
+Packet *
+ProtocolTranslator64::simple_action(Packet *p)
+{
+  return handle_ip6(p);
 }
 
 
 void
+ProtocolTranslator64::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+
+Packet *
 ProtocolTranslator64::handle_ip6(Packet *p)
 {
   click_ip6 *ip6 = (click_ip6 *) p->data();
@@ -307,6 +370,17 @@ ProtocolTranslator64::handle_ip6(Packet *p)
   if (ip6_dst.ip4_address(ipa_dst) && ip6_src.ip4_address(ipa_src))
     {
 
+       //TCP and UDP keep their length, so translate them in place
+       unsigned plen = ntohs(ip6->ip6_plen);
+       if ((ip6->ip6_nxt == IP_PROTO_TCP && plen >= sizeof(click_tcp))
+	   || (ip6->ip6_nxt == IP_PROTO_UDP && plen >= sizeof(click_udp)))
+	 {
+	   if (p->length() >= sizeof(click_ip6) + plen)
+	     return translate64_in_place(ipa_src, ipa_dst, p);
+	   p->kill();
+	   return 0;
+	 }
+
        //translate protocol according to SIIT
        unsigned char * start_of_p= (unsigned char *)(ip6+1);
        Packet *q = 0;
@@ -320,6 +394,11 @@ ProtocolTranslator64::handle_ip6(Packet *p)
 
 	   Packet *q2 = 0;
 	   q2 = make_icmp_translate64(icmp6, (q->length()-sizeof(click_ip)));
+	   if (!q2) {
+	     p->kill();
+	     q->kill();
+	     return 0;
+	   }
 	   WritablePacket *q3=Packet::make(sizeof(click_ip)+q2->length());
 	   memset(q3->data(), '\0', q3->length());
 	   click_ip *ip = (click_ip *)q3->data();
@@ -333,19 +412,19 @@ ProtocolTranslator64::handle_ip6(Packet *p)
 	   p->kill();
 	   q->kill();
 	   q2->kill();
-	   output(0).push(q3);
+	   return q3;
 	 }
        else
 	 {
 	   p->kill();
-	   output(0).push(q);
+	   return q;
 	 }
     }
 
   else
     {
       p->kill();
-      return;
+      return 0;
     }
 }
 
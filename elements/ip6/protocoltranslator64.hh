@@ -22,6 +22,11 @@ CLICK_DECLS
  * IPv4 packets; for instance, translated packets have their IP, ICMP,
  * TCP and/or UDP checksums updated.
  *
+ * TCP and UDP packets are translated in place: the IPv4 header replaces
+ * the end of the IPv6 header, and the transport checksum is adjusted for
+ * the new pseudoheader without summing the payload.  ICMPv6 packets, whose
+ * headers change size, are rebuilt.
+ *
  *
  * =a AddressTranslator ProtocolTranslator46*/
 
@@ -35,11 +40,16 @@ class ProtocolTranslator64 : public Element {
 
   const char *class_name() const		{ return "ProtocolTranslator64"; }
   const char *port_count() const		{ return PORTS_1_1; }
-  void push(int port, Packet *p);
-  void handle_ip6(Packet *);
+  Packet *simple_action(Packet *p);
+  void push_batch(int port, PacketBatch &batch);
+  Packet *handle_ip6(Packet *);
 
 private:
 
+  Packet * translate64_in_place(IPAddress src,
+				IPAddress dst,
+				Packet *p);
+
   Packet * make_icmp_translate64(unsigned char *a,
 				unsigned char payload_length);
 
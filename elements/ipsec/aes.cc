@@ -35,7 +35,7 @@
 CLICK_DECLS
 
 Aes::Aes()
-  : _op(0)
+  : _op(0), _aesni(true)
 {
 }
 
@@ -44,6 +44,7 @@ Aes::~Aes()
 }
 
 Aes::Aes(int decrypt)
+  : _aesni(true)
 {
   _op = decrypt;
 }
@@ -52,17 +53,23 @@ int
 Aes::configure(Vector<String> &conf, ErrorHandler *errh)
 {
   int dec_int;
+  bool aesni = true;
   _ignore = 12;/*This is the message digest*/
 
-  if (Args(conf, this, errh).read_mp("ENCRYPT", dec_int).complete() < 0)
+  if (Args(conf, this, errh)
+      .read_mp("ENCRYPT", dec_int)
+      .read("AESNI", aesni)
+      .complete() < 0)
     return -1;
   _op = dec_int;
+  _aesni = aesni && AESNI::available();
   return 0;
 }
 
 int
 Aes::initialize(ErrorHandler *)
 {
+ _key.clear();
  return 0;
 }
 
@@ -71,6 +78,8 @@ Aes::simple_action(Packet *p_in)
 {
 
   WritablePacket *p = p_in->uniqueify();
+  if (!p)
+    return 0;
   unsigned char hold[8];
   struct esp_new *esp = (struct esp_new *)p->data();
   SADataTuple * sa_data;
@@ -89,34 +98,45 @@ Aes::simple_action(Packet *p_in)
 
   sa_data =(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
 
-  if (_op == AES_DECRYPT) {
-    memcpy(iv, ivp, 8);
-    if(sa_data==NULL) {
-	click_chatter("AES: No SADataTuple reference annotation. check man page\n");
-        p->kill();
-        return 0;
-    }
-    /*Set the Decrypt key*/
-    AES_set_decrypt_key((const unsigned char *)&sa_data->Encryption_key, 128, &_key);
-  } else {
-    if(sa_data==NULL) {
-	click_chatter("AES: No SADataTuple annotation. This module is not properly placed check man page\n");
-        p->kill();
-        return 0;
-    }
-    AES_set_encrypt_key((const unsigned char *)&sa_data->Encryption_key, 128,&_key);
+  if(sa_data==NULL) {
+    if (_op == AES_DECRYPT)
+      click_chatter("AES: No SADataTuple reference annotation. check man page\n");
+    else
+      click_chatter("AES: No SADataTuple annotation. This module is not properly placed check man page\n");
+    p->kill();
+    return 0;
   }
-
 #ifdef DEBUG
    click_chatter("Key: %x%x%x%x%x%x%x%x",sa_data->Encryption_key[0], sa_data->Encryption_key[1], sa_data->Encryption_key[2], sa_data->Encryption_key[3],sa_data->Encryption_key[4], sa_data->Encryption_key[5], sa_data->Encryption_key[6], sa_data->Encryption_key[7]);
 #endif
 
+  if (_aesni) {
+    // the SA normally holds its key already expanded
+    const AESNI::Key *key = &sa_data->aesni_key;
+    if (!sa_data->aesni_ready) {
+      _key.set(sa_data->Encryption_key, true);
+      key = &_key.aesni();
+    }
+    if (plen > 0) {
+      if (_op == AES_DECRYPT)
+	AESNI::cbc8_decrypt(*key, ivp, idat, plen);
+      else
+	AESNI::cbc8_encrypt(*key, ivp, idat, plen);
+    }
+    return p;
+  }
+
+  _key.set(sa_data->Encryption_key, false, _op == AES_DECRYPT);
+
+  if (_op == AES_DECRYPT)
+    memcpy(iv, ivp, 8);
+
 // de/encrypt the payload
    while (plen > 0) {
 
     if(_op == AES_DECRYPT) {
       memcpy(hold, idat, 8);
-      AES_decrypt((const unsigned char *)idat, (unsigned char *)idat, (const AES_KEY *)&_key);
+      AES_decrypt((const unsigned char *)idat, (unsigned char *)idat, &_key.soft());
       /* CBC: XOR with the IV */
       for (i = 0; i < 8; i++)
 	idat[i] ^= ivp[i];
@@ -125,7 +145,7 @@ Aes::simple_action(Packet *p_in)
       /* CBC: XOR with the IV */
       for (i = 0; i < 8; i++)
 	idat[i] ^= ivp[i];
-      AES_encrypt((const unsigned char *)idat, (unsigned char *)idat,&_key);
+      AES_encrypt((const unsigned char *)idat, (unsigned char *)idat, &_key.soft());
       ivp = idat;
     }
     idat += 16;
@@ -137,6 +157,22 @@ Aes::simple_action(Packet *p_in)
   return(p);
 }
 
+void
+Aes::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+Aes::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
 /***************************AES BELOW********************************/
 
 static const unsigned long Te0[256] = {
@@ -1238,4 +1274,5 @@ void Aes::AES_decrypt(const unsigned char *in, unsigned char *out,
 
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecAESNI)
 EXPORT_ELEMENT(Aes)
@@ -2,22 +2,38 @@
 #define CLICK_IPSECAES_HH
 #include <click/element.hh>
 #include <click/glue.hh>
+#include "aesni.hh"
 CLICK_DECLS
 
 /*
  * =c
- * IPsecAES(ENCRYPT)
+ * IPsecAES(ENCRYPT [, I<keywords> AESNI])
  * =s ipsec
- * encrypt packet using DES-CBC
+ * encrypt packet using AES-CBC
  * =d
  *
- * Encrypts or decrypts packet using DES-CBC. If the first argument is 0,
- * IPsecAES will decrypt. If the first argument is 1, IPsecAES will encrypt.
- * KEY is the DES secret key. Gets IV value from ESP header. IGNORE is the
- * number of bytes at the end of the payload to ignore. By default, IGNORE is
- * 12, which is the number of SHA1 authentication digest bytes for ESP or AH.
+ * Encrypts or decrypts packet using 128-bit AES in CBC mode. If the first
+ * argument is 0, IPsecAES will decrypt. If the first argument is 1, IPsecAES
+ * will encrypt. The key is the Encryption_key of the security association
+ * named by the packet's IPsec annotation (see IPsecRouteTable). Gets IV value
+ * from ESP header. The last 12 bytes of the payload, the SHA1 authentication
+ * digest for ESP or AH, are not encrypted.
  *
- * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthSHA1
+ * The expanded key is kept between packets, so a run of packets for the same
+ * security association pays for key expansion once.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item AESNI
+ *
+ * Boolean. If true, use the AES-NI instructions when the CPU supports them.
+ * The result is the same either way. Default is true.
+ *
+ * =back
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap, IPsecAuthHMACSHA1, IPsecAESGCM
  */
 
 # define GETU32(pt) (((unsigned long)(pt)[0] << 24) ^ ((unsigned long)(pt)[1] << 16) ^ ((unsigned long)(pt)[2] <<  8) ^ ((unsigned long)(pt)[3]))
@@ -36,6 +52,38 @@ typedef struct aes_key_st AES_KEY;
 
 class Address;
 
+/*
+ * A 128-bit AES key schedule, expanded only when the key changes. Most runs
+ * of packets share a security association or station key, so the elements
+ * that encrypt with AES keep one of these and hand it each packet's key. The
+ * schedule is for the AES-NI kernels if set() is told to use them, and for
+ * the table-driven code in aes.cc otherwise.
+ */
+class AESKeyCache { public:
+
+    AESKeyCache() : _valid(false) { }
+
+    void clear() { _valid = false; }
+
+    // Returns true if the schedule was expanded, false if key was already
+    // current.
+    inline bool set(const uint8_t *key, bool aesni, bool decrypt = false);
+
+    const uint8_t *data() const { return _key_data; }
+    const AESNI::Key &aesni() const { return _aesni_key; }
+    const AES_KEY &soft() const { return _soft_key; }
+
+  private:
+
+    bool _valid;
+    bool _aesni;
+    bool _decrypt;
+    uint8_t _key_data[16];
+    AESNI::Key _aesni_key;
+    AES_KEY _soft_key;
+
+};
+
 
 class Aes : public Element {
  public:
@@ -50,18 +98,41 @@ class Aes : public Element {
    int initialize(ErrorHandler *);
 
    Packet *simple_action(Packet *);
+   void push_batch(int port, PacketBatch &batch);
+   void pull_batch(int port, PacketBatch &batch, int max);
 
    enum { AES_DECRYPT = 0, AES_ENCRYPT = 1 };
 
+   static int AES_set_encrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
+   static int AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
+   static void AES_encrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
+   static void AES_decrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
+
  private:
-   int AES_set_encrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   int AES_set_decrypt_key(const unsigned char *userKey, const int bits, AES_KEY *key);
-   void AES_encrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
-   void AES_decrypt(const unsigned char *in, unsigned char *out,const AES_KEY *key);
    unsigned _op;
    int _ignore;
-   AES_KEY _key;
+   bool _aesni;
+   AESKeyCache _key;
 };
 
+inline bool
+AESKeyCache::set(const uint8_t *key, bool aesni, bool decrypt)
+{
+    if (_valid && _aesni == aesni && _decrypt == decrypt
+	&& memcmp(_key_data, key, sizeof(_key_data)) == 0)
+	return false;
+    memcpy(_key_data, key, sizeof(_key_data));
+    if (aesni)
+	AESNI::set_key(_aesni_key, key);
+    else if (decrypt)
+	Aes::AES_set_decrypt_key(key, 128, &_soft_key);
+    else
+	Aes::AES_set_encrypt_key(key, 128, &_soft_key);
+    _valid = true;
+    _aesni = aesni;
+    _decrypt = decrypt;
+    return true;
+}
+
 CLICK_ENDDECLS
 #endif
@@ -0,0 +1,292 @@
+/*
+ * aesgcm.{cc,hh} -- element implements IPsec ESP encryption and
+ * authentication using AES-GCM (RFC 4106)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "aesgcm.hh"
+#include "esp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/packet_anno.hh>
+#include "sadatatuple.hh"
+CLICK_DECLS
+
+IPsecAESGCM::IPsecAESGCM()
+  : _encrypt(false), _aesni(true), _iv(0)
+{
+}
+
+IPsecAESGCM::~IPsecAESGCM()
+{
+}
+
+int
+IPsecAESGCM::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+  bool aesni = true;
+  if (Args(conf, this, errh)
+      .read_mp("ENCRYPT", _encrypt)
+      .read("AESNI", aesni)
+      .complete() < 0)
+    return -1;
+  _aesni = aesni && AESNI::available();
+  return 0;
+}
+
+int
+IPsecAESGCM::initialize(ErrorHandler *)
+{
+  // Start the IV counter at a random point, so that restarting with the
+  // same static keys does not repeat IVs.
+  _iv = ((uint64_t) click_random() << 32) ^ click_random();
+  _drops = 0;
+  _key.clear();
+  return 0;
+}
+
+static inline uint64_t
+load_be64(const uint8_t *p)
+{
+  uint64_t x = 0;
+  for (int i = 0; i < 8; i++)
+    x = (x << 8) | p[i];
+  return x;
+}
+
+static inline void
+store_be64(uint8_t *p, uint64_t x)
+{
+  for (int i = 7; i >= 0; i--, x >>= 8)
+    p[i] = x;
+}
+
+void
+IPsecAESGCM::set_key(const uint8_t *key)
+{
+  if (!_key.set(key, _aesni))
+    return;
+
+  if (_aesni) {
+    AESNI::set_hash_key(_aesni_hkey, _key.aesni());
+    return;
+  }
+
+  // Shoup's 4-bit tables: _soft_hh[i]:_soft_hl[i] is H times the 4-bit
+  // polynomial i, in GCM's reflected bit order.
+  uint8_t h[16];
+  memset(h, 0, sizeof(h));
+  Aes::AES_encrypt(h, h, &_key.soft());
+  uint64_t vh = load_be64(h), vl = load_be64(h + 8);
+  _soft_hh[0] = _soft_hl[0] = 0;
+  _soft_hh[8] = vh;
+  _soft_hl[8] = vl;
+  for (int i = 4; i > 0; i >>= 1) {
+    uint64_t t = (vl & 1) * 0xE100000000000000ULL;
+    vl = (vh << 63) | (vl >> 1);
+    vh = (vh >> 1) ^ t;
+    _soft_hh[i] = vh;
+    _soft_hl[i] = vl;
+  }
+  for (int i = 2; i <= 8; i *= 2)
+    for (int j = 1; j < i; j++) {
+      _soft_hh[i + j] = _soft_hh[i] ^ _soft_hh[j];
+      _soft_hl[i + j] = _soft_hl[i] ^ _soft_hl[j];
+    }
+}
+
+void
+IPsecAESGCM::soft_gfmul(uint8_t *x) const
+{
+  static const uint16_t last4[16] = {
+    0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+    0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0
+  };
+  int lo = x[15] & 0xF;
+  uint64_t zh = _soft_hh[lo], zl = _soft_hl[lo];
+  for (int i = 15; i >= 0; i--) {
+    int hi = x[i] >> 4;
+    lo = x[i] & 0xF;
+    if (i != 15) {
+      int rem = zl & 0xF;
+      zl = (zh << 60) | (zl >> 4);
+      zh = (zh >> 4) ^ ((uint64_t) last4[rem] << 48);
+      zh ^= _soft_hh[lo];
+      zl ^= _soft_hl[lo];
+    }
+    int rem = zl & 0xF;
+    zl = (zh << 60) | (zl >> 4);
+    zh = (zh >> 4) ^ ((uint64_t) last4[rem] << 48);
+    zh ^= _soft_hh[hi];
+    zl ^= _soft_hl[hi];
+  }
+  store_be64(x, zh);
+  store_be64(x + 8, zl);
+}
+
+void
+IPsecAESGCM::soft_ghash(uint8_t *x, const uint8_t *data, int len) const
+{
+  for (; len > 0; data += 16, len -= 16) {
+    int n = (len < 16 ? len : 16);
+    for (int i = 0; i < n; i++)
+      x[i] ^= data[i];
+    soft_gfmul(x);
+  }
+}
+
+void
+IPsecAESGCM::soft_crypt(const uint8_t *j0, const uint8_t *aad, int aad_len,
+			uint8_t *data, int len, bool encrypt, uint8_t *tag) const
+{
+  uint8_t x[16], ctr[16], ks[16];
+  memset(x, 0, sizeof(x));
+  soft_ghash(x, aad, aad_len);
+  if (!encrypt)
+    soft_ghash(x, data, len);
+
+  memcpy(ctr, j0, 16);
+  uint32_t c;
+  memcpy(&c, ctr + 12, 4);
+  c = ntohl(c);
+  for (int pos = 0; pos < len; pos += 16) {
+    uint32_t cn = htonl(++c);
+    memcpy(ctr + 12, &cn, 4);
+    Aes::AES_encrypt(ctr, ks, &_key.soft());
+    int n = (len - pos < 16 ? len - pos : 16);
+    for (int i = 0; i < n; i++)
+      data[pos + i] ^= ks[i];
+  }
+
+  if (encrypt)
+    soft_ghash(x, data, len);
+  uint8_t lb[16];
+  store_be64(lb, (uint64_t) aad_len * 8);
+  store_be64(lb + 8, (uint64_t) len * 8);
+  soft_ghash(x, lb, 16);
+  Aes::AES_encrypt(j0, tag, &_key.soft());
+  for (int i = 0; i < 16; i++)
+    tag[i] ^= x[i];
+}
+
+void
+IPsecAESGCM::crypt(const SADataTuple *sa, const uint8_t *j0, const uint8_t *aad,
+		   uint8_t *data, int len, bool encrypt, uint8_t *tag) const
+{
+  // The additional authenticated data is the SPI and sequence number.
+  if (_aesni && sa->aesni_ready)
+    AESNI::gcm_crypt(sa->aesni_key, sa->gcm_hash_key, j0, aad, 8, data, len, encrypt, tag);
+  else if (_aesni)
+    AESNI::gcm_crypt(_key.aesni(), _aesni_hkey, j0, aad, 8, data, len, encrypt, tag);
+  else
+    soft_crypt(j0, aad, 8, data, len, encrypt, tag);
+}
+
+Packet *
+IPsecAESGCM::simple_action(Packet *p_in)
+{
+  SADataTuple *sa_data = (SADataTuple *) IPSEC_SA_DATA_REFERENCE_ANNO(p_in);
+  if (!sa_data) {
+    click_chatter("IPsecAESGCM: No SADataTuple annotation. check man page");
+    p_in->kill();
+    return 0;
+  }
+  int min_length = sizeof(esp_new) + (_encrypt ? 0 : ICV_SIZE);
+  if ((int) p_in->length() < min_length) {
+    click_chatter("IPsecAESGCM: packet too short");
+    p_in->kill();
+    return 0;
+  }
+
+  WritablePacket *p = (_encrypt ? p_in->put(ICV_SIZE) : p_in->uniqueify());
+  if (!p)
+    return 0;
+  // the SA normally holds its key already expanded
+  if (!_aesni || !sa_data->aesni_ready)
+    set_key(sa_data->Encryption_key);
+
+  struct esp_new *esp = (struct esp_new *) p->data();
+  if (_encrypt)
+    store_be64(esp->esp_iv, _iv++);
+
+  // nonce: salt, explicit IV, then a 32-bit block counter starting at 1
+  uint8_t j0[16];
+  memcpy(j0, sa_data->Authentication_key, SALT_SIZE);
+  memcpy(j0 + SALT_SIZE, esp->esp_iv, 8);
+  j0[12] = j0[13] = j0[14] = 0;
+  j0[15] = 1;
+
+  uint8_t *data = p->data() + sizeof(esp_new);
+  int len = p->length() - sizeof(esp_new) - ICV_SIZE;
+  uint8_t *icv = data + len;
+  uint8_t tag[ICV_SIZE];
+  crypt(sa_data, j0, p->data(), data, len, _encrypt, tag);
+
+  if (_encrypt) {
+    memcpy(icv, tag, ICV_SIZE);
+    return p;
+  }
+
+  uint8_t diff = 0;
+  for (int i = 0; i < ICV_SIZE; i++)
+    diff |= icv[i] ^ tag[i];
+  if (diff) {
+    // Decryption ran alongside verification; run the keystream again so
+    // the rejected packet leaves as it arrived.
+    crypt(sa_data, j0, p->data(), data, len, true, tag);
+    if (_drops == 0)
+      click_chatter("Invalid AES-GCM integrity check value");
+    _drops++;
+    checked_output_push(1, p);
+    return 0;
+  }
+  p->take(ICV_SIZE);
+  return p;
+}
+
+void
+IPsecAESGCM::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+IPsecAESGCM::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
+String
+IPsecAESGCM::drop_handler(Element *e, void *)
+{
+  IPsecAESGCM *a = (IPsecAESGCM *) e;
+  return String(a->_drops.value());
+}
+
+void
+IPsecAESGCM::add_handlers()
+{
+  add_read_handler("drops", drop_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(Aes IPsecAESNI)
+EXPORT_ELEMENT(IPsecAESGCM)
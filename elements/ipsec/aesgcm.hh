@@ -0,0 +1,117 @@
+#ifndef CLICK_IPSECAESGCM_HH
+#define CLICK_IPSECAESGCM_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/glue.hh>
+#include "aes.hh"
+#include "aesni.hh"
+CLICK_DECLS
+class SADataTuple;
+
+/*
+ * =c
+ * IPsecAESGCM(ENCRYPT [, I<keywords> AESNI])
+ * =s ipsec
+ * encrypt and authenticate ESP packets using AES-GCM
+ * =d
+ *
+ * Encrypts and authenticates, or verifies and decrypts, ESP packets using
+ * 128-bit AES in Galois/Counter Mode, as in RFC 4106. One pass over the
+ * payload does the work of both IPsecAuthHMACSHA1 and IPsecAES.
+ *
+ * If the first argument is 1, IPsecAESGCM encrypts. Its input should be an
+ * ESP packet built by IPsecESPEncap. IPsecAESGCM fills in the ESP header's
+ * 8-byte IV from a counter, encrypts everything after the header, and appends
+ * a 16-byte integrity check value. The encrypted packet is the ESP header,
+ * the ciphertext, and the integrity check value, so IPsecEncap can follow.
+ *
+ * If the first argument is 0, IPsecAESGCM decrypts. Its input should be an
+ * ESP packet with its outer IP header removed. IPsecAESGCM verifies and
+ * removes the integrity check value, then decrypts the payload in place,
+ * leaving the ESP header and trailer for IPsecESPUnencap, which checks the
+ * replay window and removes them. Packets that fail verification are sent
+ * to output 1, if it exists, and dropped otherwise.
+ *
+ * The key and salt come from the security association named by the packet's
+ * IPsec annotation (see IPsecRouteTable): the key is the SA's 16-byte
+ * encryption key, and the 4-byte salt is the first four bytes of its
+ * authentication key. The additional authenticated data is the ESP SPI and
+ * sequence number.
+ *
+ * IVs are never reused by one IPsecAESGCM element, but two encrypting
+ * elements sharing a security association could collide. Give each its own.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item AESNI
+ *
+ * Boolean. If true, use the AES-NI and PCLMULQDQ instructions when the CPU
+ * supports them. The result is the same either way, but the table-driven
+ * code is several times slower. Default is true.
+ *
+ * =back
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =e
+ *
+ *   rt :: RadixIPsecLookup(192.168.0.1/32 0,
+ *       10.0.0.0/8 192.168.0.2 1 1234 ENCRYPTIONKEY016 SALTxxxxxxxxxxxx 1 64);
+ *   rt[1] -> IPsecESPEncap -> IPsecAESGCM(1) -> IPsecEncap(50) -> ...
+ *   rt[0] -> StripIPHeader -> IPsecAESGCM(0) -> IPsecESPUnencap -> ...
+ *
+ * =a IPsecESPEncap, IPsecESPUnencap, IPsecAES, IPsecAuthHMACSHA1,
+ * IPsecRouteTable
+ */
+
+class IPsecAESGCM : public Element { public:
+
+    IPsecAESGCM();
+    ~IPsecAESGCM();
+
+    const char *class_name() const	{ return "IPsecAESGCM"; }
+    const char *port_count() const	{ return "1/1-2"; }
+    const char *processing() const	{ return PROCESSING_A_AH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
+
+    enum { ICV_SIZE = 16, SALT_SIZE = 4 };
+
+  private:
+
+    bool _encrypt;
+    bool _aesni;
+    uint64_t _iv;
+    atomic_uint32_t _drops;
+
+    // the key of the last security association seen whose key was not
+    // already expanded
+    AESKeyCache _key;
+    AESNI::HashKey _aesni_hkey;
+    uint64_t _soft_hl[16];
+    uint64_t _soft_hh[16];
+
+    void set_key(const uint8_t *key);
+    void crypt(const SADataTuple *sa, const uint8_t *j0, const uint8_t *aad,
+	       uint8_t *data, int len, bool encrypt, uint8_t *tag) const;
+    void soft_crypt(const uint8_t *j0, const uint8_t *aad, int aad_len,
+		    uint8_t *data, int len, bool encrypt, uint8_t *tag) const;
+    void soft_ghash(uint8_t *x, const uint8_t *data, int len) const;
+    void soft_gfmul(uint8_t *x) const;
+
+    static String drop_handler(Element *e, void *thunk);
+
+};
+
+CLICK_ENDDECLS
+#endif
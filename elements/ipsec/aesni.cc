@@ -0,0 +1,551 @@
+// -*- c-basic-offset: 4; related-file-name: "aesni.hh" -*-
+/*
+ * aesni.{cc,hh} -- AES-NI and PCLMULQDQ kernels for the IPsec and CCMP
+ * elements
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "aesni.hh"
+#if HAVE_IPSEC_AESNI
+# include <cpuid.h>
+# include <immintrin.h>
+#endif
+CLICK_DECLS
+
+#if HAVE_IPSEC_AESNI
+
+#define AESNI_TARGET __attribute__((target("aes,pclmul,ssse3,sse4.1")))
+
+bool
+AESNI::available()
+{
+    static int have = -1;
+    if (have < 0) {
+	unsigned a, b, c, d;
+	have = __get_cpuid(1, &a, &b, &c, &d)
+	    && (c & bit_AES) && (c & bit_PCLMUL)
+	    && (c & bit_SSSE3) && (c & bit_SSE4_1);
+    }
+    return have;
+}
+
+static inline AESNI_TARGET __m128i
+expand_step(__m128i key, __m128i gen)
+{
+    gen = _mm_shuffle_epi32(gen, 0xFF);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, gen);
+}
+
+AESNI_TARGET void
+AESNI::set_key(Key &key, const uint8_t *user_key)
+{
+    __m128i k[ROUNDS + 1];
+    k[0] = _mm_loadu_si128((const __m128i *) user_key);
+#define EXPAND(i, rcon) k[i] = expand_step(k[i - 1], _mm_aeskeygenassist_si128(k[i - 1], rcon))
+    EXPAND(1, 0x01);
+    EXPAND(2, 0x02);
+    EXPAND(3, 0x04);
+    EXPAND(4, 0x08);
+    EXPAND(5, 0x10);
+    EXPAND(6, 0x20);
+    EXPAND(7, 0x40);
+    EXPAND(8, 0x80);
+    EXPAND(9, 0x1B);
+    EXPAND(10, 0x36);
+#undef EXPAND
+    for (int i = 0; i <= ROUNDS; ++i) {
+	_mm_storeu_si128((__m128i *) key.enc[i], k[i]);
+	__m128i d = k[ROUNDS - i];
+	if (i != 0 && i != ROUNDS)
+	    d = _mm_aesimc_si128(d);
+	_mm_storeu_si128((__m128i *) key.dec[i], d);
+    }
+}
+
+static inline AESNI_TARGET void
+load_key(const uint64_t (*sched)[2], __m128i *k)
+{
+    for (int i = 0; i <= AESNI::ROUNDS; ++i)
+	k[i] = _mm_loadu_si128((const __m128i *) sched[i]);
+}
+
+static inline AESNI_TARGET __m128i
+encrypt1(const __m128i *k, __m128i x)
+{
+    x = _mm_xor_si128(x, k[0]);
+    for (int r = 1; r < AESNI::ROUNDS; ++r)
+	x = _mm_aesenc_si128(x, k[r]);
+    return _mm_aesenclast_si128(x, k[AESNI::ROUNDS]);
+}
+
+static inline AESNI_TARGET void
+encrypt4(const __m128i *k, __m128i *x)
+{
+    for (int j = 0; j < 4; ++j)
+	x[j] = _mm_xor_si128(x[j], k[0]);
+    for (int r = 1; r < AESNI::ROUNDS; ++r)
+	for (int j = 0; j < 4; ++j)
+	    x[j] = _mm_aesenc_si128(x[j], k[r]);
+    for (int j = 0; j < 4; ++j)
+	x[j] = _mm_aesenclast_si128(x[j], k[AESNI::ROUNDS]);
+}
+
+static inline AESNI_TARGET __m128i
+decrypt1(const __m128i *k, __m128i x)
+{
+    x = _mm_xor_si128(x, k[0]);
+    for (int r = 1; r < AESNI::ROUNDS; ++r)
+	x = _mm_aesdec_si128(x, k[r]);
+    return _mm_aesdeclast_si128(x, k[AESNI::ROUNDS]);
+}
+
+static inline AESNI_TARGET void
+decrypt4(const __m128i *k, __m128i *x)
+{
+    for (int j = 0; j < 4; ++j)
+	x[j] = _mm_xor_si128(x[j], k[0]);
+    for (int r = 1; r < AESNI::ROUNDS; ++r)
+	for (int j = 0; j < 4; ++j)
+	    x[j] = _mm_aesdec_si128(x[j], k[r]);
+    for (int j = 0; j < 4; ++j)
+	x[j] = _mm_aesdeclast_si128(x[j], k[AESNI::ROUNDS]);
+}
+
+AESNI_TARGET void
+AESNI::encrypt_block(const Key &key, const uint8_t *in, uint8_t *out)
+{
+    __m128i k[ROUNDS + 1];
+    load_key(key.enc, k);
+    __m128i x = encrypt1(k, _mm_loadu_si128((const __m128i *) in));
+    _mm_storeu_si128((__m128i *) out, x);
+}
+
+AESNI_TARGET void
+AESNI::cbc8_encrypt(const Key &key, const uint8_t *iv, uint8_t *data, int len)
+{
+    __m128i k[ROUNDS + 1];
+    load_key(key.enc, k);
+    // _mm_loadl_epi64 and _mm_move_epi64 clear the upper 8 bytes, so only
+    // the first half of each block is chained.
+    __m128i chain = _mm_loadl_epi64((const __m128i *) iv);
+    for (; len >= 16; data += 16, len -= 16) {
+	__m128i x = _mm_loadu_si128((const __m128i *) data);
+	x = encrypt1(k, _mm_xor_si128(x, chain));
+	_mm_storeu_si128((__m128i *) data, x);
+	chain = _mm_move_epi64(x);
+    }
+}
+
+AESNI_TARGET void
+AESNI::cbc8_decrypt(const Key &key, const uint8_t *iv, uint8_t *data, int len)
+{
+    __m128i k[ROUNDS + 1];
+    load_key(key.dec, k);
+    __m128i chain = _mm_loadl_epi64((const __m128i *) iv);
+    // Unlike encryption, decryption blocks are independent, so run four
+    // through the AES pipeline at once.
+    for (; len >= 64; data += 64, len -= 64) {
+	__m128i c[4], x[4];
+	for (int j = 0; j < 4; ++j)
+	    x[j] = c[j] = _mm_loadu_si128((const __m128i *) data + j);
+	decrypt4(k, x);
+	_mm_storeu_si128((__m128i *) data, _mm_xor_si128(x[0], chain));
+	for (int j = 1; j < 4; ++j)
+	    _mm_storeu_si128((__m128i *) data + j, _mm_xor_si128(x[j], _mm_move_epi64(c[j - 1])));
+	chain = _mm_move_epi64(c[3]);
+    }
+    for (; len >= 16; data += 16, len -= 16) {
+	__m128i c = _mm_loadu_si128((const __m128i *) data);
+	_mm_storeu_si128((__m128i *) data, _mm_xor_si128(decrypt1(k, c), chain));
+	chain = _mm_move_epi64(c);
+    }
+}
+
+
+// GHASH works on byte-reflected blocks, as in Gueron and Kounavis, "Intel
+// Carry-Less Multiplication Instruction and its Usage for Computing the GCM
+// Mode".  clmul computes an unreduced 256-bit product; since reduction is
+// linear, several products can be summed before one call to reduce.
+
+static inline AESNI_TARGET __m128i
+bswap128(__m128i x)
+{
+    const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+				      8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(x, mask);
+}
+
+static inline AESNI_TARGET void
+clmul(__m128i a, __m128i b, __m128i &lo, __m128i &hi)
+{
+    __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t1 = _mm_clmulepi64_si128(a, b, 0x10);
+    __m128i t2 = _mm_clmulepi64_si128(a, b, 0x01);
+    __m128i t3 = _mm_clmulepi64_si128(a, b, 0x11);
+    t1 = _mm_xor_si128(t1, t2);
+    lo = _mm_xor_si128(t0, _mm_slli_si128(t1, 8));
+    hi = _mm_xor_si128(t3, _mm_srli_si128(t1, 8));
+}
+
+static inline AESNI_TARGET __m128i
+reduce(__m128i lo, __m128i hi)
+{
+    // shift the 256-bit product left by one bit
+    __m128i t7 = _mm_srli_epi32(lo, 31);
+    __m128i t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+    // reduce modulo x^128 + x^7 + x^2 + x + 1
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+    __m128i t2 = _mm_srli_epi32(lo, 1);
+    __m128i t4 = _mm_srli_epi32(lo, 2);
+    __m128i t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+    return _mm_xor_si128(hi, lo);
+}
+
+static inline AESNI_TARGET __m128i
+gfmul(__m128i a, __m128i b)
+{
+    __m128i lo, hi;
+    clmul(a, b, lo, hi);
+    return reduce(lo, hi);
+}
+
+AESNI_TARGET void
+AESNI::set_hash_key(HashKey &hkey, const Key &key)
+{
+    __m128i k[ROUNDS + 1];
+    load_key(key.enc, k);
+    __m128i h = bswap128(encrypt1(k, _mm_setzero_si128()));
+    __m128i p = h;
+    for (int i = 0; i < 4; ++i) {
+	_mm_storeu_si128((__m128i *) hkey.h[i], p);
+	p = gfmul(p, h);
+    }
+}
+
+static inline AESNI_TARGET __m128i
+ghash_tail(__m128i x, __m128i h, const uint8_t *data, int len)
+{
+    uint8_t buf[16];
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, data, len);
+    __m128i b = bswap128(_mm_loadu_si128((const __m128i *) buf));
+    return gfmul(_mm_xor_si128(x, b), h);
+}
+
+static inline AESNI_TARGET __m128i
+counter_block(__m128i j0, uint32_t c)
+{
+    return _mm_insert_epi32(j0, htonl(c), 3);
+}
+
+AESNI_TARGET void
+AESNI::gcm_crypt(const Key &key, const HashKey &hkey, const uint8_t *j0,
+		 const uint8_t *aad, int aad_len,
+		 uint8_t *data, int len, bool encrypt, uint8_t *tag)
+{
+    __m128i k[ROUNDS + 1], h[4];
+    load_key(key.enc, k);
+    for (int i = 0; i < 4; ++i)
+	h[i] = _mm_loadu_si128((const __m128i *) hkey.h[i]);
+    __m128i x = _mm_setzero_si128();
+    uint64_t aad_bits = (uint64_t) aad_len * 8, data_bits = (uint64_t) len * 8;
+
+    for (; aad_len >= 16; aad += 16, aad_len -= 16) {
+	__m128i b = bswap128(_mm_loadu_si128((const __m128i *) aad));
+	x = gfmul(_mm_xor_si128(x, b), h[0]);
+    }
+    if (aad_len)
+	x = ghash_tail(x, h[0], aad, aad_len);
+
+    __m128i ctr0 = _mm_loadu_si128((const __m128i *) j0);
+    uint32_t c;
+    memcpy(&c, j0 + 12, 4);
+    c = ntohl(c);
+
+    // Four blocks per iteration: the counter blocks go through the AES
+    // pipeline together, and their GHASH products share one reduction.
+    for (; len >= 64; data += 64, len -= 64) {
+	__m128i ks[4], in[4], out[4], lo, hi, tlo, thi;
+	for (int j = 0; j < 4; ++j)
+	    ks[j] = counter_block(ctr0, c + 1 + j);
+	c += 4;
+	encrypt4(k, ks);
+	for (int j = 0; j < 4; ++j) {
+	    in[j] = _mm_loadu_si128((const __m128i *) data + j);
+	    out[j] = _mm_xor_si128(in[j], ks[j]);
+	    _mm_storeu_si128((__m128i *) data + j, out[j]);
+	}
+	const __m128i *ct = encrypt ? out : in;
+	clmul(_mm_xor_si128(x, bswap128(ct[0])), h[3], lo, hi);
+	for (int j = 1; j < 4; ++j) {
+	    clmul(bswap128(ct[j]), h[3 - j], tlo, thi);
+	    lo = _mm_xor_si128(lo, tlo);
+	    hi = _mm_xor_si128(hi, thi);
+	}
+	x = reduce(lo, hi);
+    }
+    for (; len >= 16; data += 16, len -= 16) {
+	__m128i in = _mm_loadu_si128((const __m128i *) data);
+	__m128i out = _mm_xor_si128(in, encrypt1(k, counter_block(ctr0, ++c)));
+	_mm_storeu_si128((__m128i *) data, out);
+	x = gfmul(_mm_xor_si128(x, bswap128(encrypt ? out : in)), h[0]);
+    }
+    if (len) {
+	uint8_t ks[16];
+	_mm_storeu_si128((__m128i *) ks, encrypt1(k, counter_block(ctr0, ++c)));
+	if (!encrypt)
+	    x = ghash_tail(x, h[0], data, len);
+	for (int i = 0; i < len; ++i)
+	    data[i] ^= ks[i];
+	if (encrypt)
+	    x = ghash_tail(x, h[0], data, len);
+    }
+
+    // the length block, already byte-reflected
+    __m128i lb = _mm_set_epi64x(aad_bits, data_bits);
+    x = gfmul(_mm_xor_si128(x, lb), h[0]);
+    __m128i t = _mm_xor_si128(bswap128(x), encrypt1(k, ctr0));
+    _mm_storeu_si128((__m128i *) tag, t);
+}
+
+
+// CCM: CBC-MAC over B0, the length-prefixed associated data, and the
+// zero-padded payload, then CTR mode from counter 1.
+
+static inline AESNI_TARGET __m128i
+ccm_counter(__m128i a0, int c)
+{
+    return _mm_insert_epi16(a0, htons(c), 7);
+}
+
+static inline AESNI_TARGET __m128i
+load_partial(const uint8_t *data, int len)
+{
+    if (len >= 16)
+	return _mm_loadu_si128((const __m128i *) data);
+    uint8_t buf[16];
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, data, len);
+    return _mm_loadu_si128((const __m128i *) buf);
+}
+
+static AESNI_TARGET void
+ccm_ctr(const __m128i *k, const AESNI::CCMJob &job)
+{
+    __m128i a0 = _mm_loadu_si128((const __m128i *) job.a0);
+    uint8_t *data = job.data;
+    int len = job.len, c = 1;
+    for (; len >= 64; data += 64, len -= 64, c += 4) {
+	__m128i ks[4];
+	for (int j = 0; j < 4; ++j)
+	    ks[j] = ccm_counter(a0, c + j);
+	encrypt4(k, ks);
+	for (int j = 0; j < 4; ++j) {
+	    __m128i x = _mm_loadu_si128((const __m128i *) data + j);
+	    _mm_storeu_si128((__m128i *) data + j, _mm_xor_si128(x, ks[j]));
+	}
+    }
+    for (; len > 0; data += 16, len -= 16, ++c) {
+	__m128i ks = encrypt1(k, ccm_counter(a0, c));
+	if (len >= 16) {
+	    __m128i x = _mm_loadu_si128((const __m128i *) data);
+	    _mm_storeu_si128((__m128i *) data, _mm_xor_si128(x, ks));
+	} else {
+	    uint8_t buf[16];
+	    _mm_storeu_si128((__m128i *) buf, ks);
+	    for (int i = 0; i < len; ++i)
+		data[i] ^= buf[i];
+	}
+    }
+}
+
+namespace {
+struct CCMLane {
+    AESNI::CCMJob *job;
+    int block;
+    int nhead;
+    int nblocks;
+    uint8_t head[16 + 2 + AESNI::CCM_MAX_AAD + 15];
+
+    void start(AESNI::CCMJob *j) {
+	job = j;
+	block = 0;
+	memcpy(head, j->b0, 16);
+	int n = 16;
+	if (j->aad_len) {
+	    head[16] = j->aad_len >> 8;
+	    head[17] = j->aad_len;
+	    memcpy(head + 18, j->aad, j->aad_len);
+	    n = 18 + j->aad_len;
+	    for (; n & 15; ++n)
+		head[n] = 0;
+	}
+	nhead = n / 16;
+	nblocks = nhead + (j->len + 15) / 16;
+    }
+};
+}
+
+// CBC-MAC the jobs four at a time.  A lane that finishes its job picks up
+// the next one, so short and long frames can share the pipeline.
+static AESNI_TARGET void
+ccm_mac(const __m128i *k, AESNI::CCMJob *jobs, int njobs)
+{
+    CCMLane lane[4];
+    __m128i x[4];
+    int next = 0, active = 0;
+    for (int j = 0; j < 4; ++j) {
+	x[j] = _mm_setzero_si128();
+	if (next < njobs) {
+	    lane[j].start(&jobs[next++]);
+	    ++active;
+	} else
+	    lane[j].job = 0;
+    }
+
+    while (active) {
+	__m128i in[4];
+	for (int j = 0; j < 4; ++j) {
+	    CCMLane &l = lane[j];
+	    if (!l.job)
+		in[j] = x[j];
+	    else if (l.block < l.nhead)
+		in[j] = _mm_xor_si128(x[j], _mm_loadu_si128((const __m128i *) (l.head + 16 * l.block)));
+	    else {
+		int off = 16 * (l.block - l.nhead);
+		in[j] = _mm_xor_si128(x[j], load_partial(l.job->data + off, l.job->len - off));
+	    }
+	}
+	encrypt4(k, in);
+	for (int j = 0; j < 4; ++j) {
+	    CCMLane &l = lane[j];
+	    if (!l.job)
+		continue;
+	    x[j] = in[j];
+	    if (++l.block == l.nblocks) {
+		_mm_storeu_si128((__m128i *) l.job->tag, x[j]);
+		x[j] = _mm_setzero_si128();
+		if (next < njobs)
+		    l.start(&jobs[next++]);
+		else {
+		    l.job = 0;
+		    --active;
+		}
+	    }
+	}
+    }
+}
+
+AESNI_TARGET void
+AESNI::ccm_crypt(const Key &key, CCMJob *jobs, int njobs, bool encrypt)
+{
+    __m128i k[ROUNDS + 1];
+    load_key(key.enc, k);
+    // The CBC-MAC covers the plaintext.
+    if (encrypt)
+	ccm_mac(k, jobs, njobs);
+    for (int i = 0; i < njobs; ++i)
+	ccm_ctr(k, jobs[i]);
+    if (!encrypt)
+	ccm_mac(k, jobs, njobs);
+    // encrypt the CBC-MACs with counter 0
+    for (int i = 0; i < njobs; i += 4) {
+	int n = (njobs - i < 4 ? njobs - i : 4);
+	__m128i s[4];
+	for (int j = 0; j < 4; ++j)
+	    s[j] = _mm_loadu_si128((const __m128i *) jobs[i + (j < n ? j : 0)].a0);
+	encrypt4(k, s);
+	for (int j = 0; j < n; ++j) {
+	    __m128i *t = (__m128i *) jobs[i + j].tag;
+	    _mm_storeu_si128(t, _mm_xor_si128(_mm_loadu_si128(t), s[j]));
+	}
+    }
+}
+
+#else /* !HAVE_IPSEC_AESNI */
+
+bool
+AESNI::available()
+{
+    return false;
+}
+
+void
+AESNI::set_key(Key &, const uint8_t *)
+{
+    assert(0);
+}
+
+void
+AESNI::encrypt_block(const Key &, const uint8_t *, uint8_t *)
+{
+    assert(0);
+}
+
+void
+AESNI::cbc8_encrypt(const Key &, const uint8_t *, uint8_t *, int)
+{
+    assert(0);
+}
+
+void
+AESNI::cbc8_decrypt(const Key &, const uint8_t *, uint8_t *, int)
+{
+    assert(0);
+}
+
+void
+AESNI::set_hash_key(HashKey &, const Key &)
+{
+    assert(0);
+}
+
+void
+AESNI::gcm_crypt(const Key &, const HashKey &, const uint8_t *,
+		 const uint8_t *, int, uint8_t *, int, bool, uint8_t *)
+{
+    assert(0);
+}
+
+void
+AESNI::ccm_crypt(const Key &, CCMJob *, int, bool)
+{
+    assert(0);
+}
+
+#endif
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IPsecAESNI)
@@ -0,0 +1,77 @@
+// -*- c-basic-offset: 4; related-file-name: "aesni.cc" -*-
+#ifndef CLICK_IPSEC_AESNI_HH
+#define CLICK_IPSEC_AESNI_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * AES-128, GHASH, and CCM kernels for the IPsec and CCMP elements, built on the x86 AES-NI
+ * and PCLMULQDQ instructions.  The kernels are compiled for user-level x86
+ * builds only; AESNI::available() says whether this CPU can run them.
+ * Callers must check it and fall back to the table-driven code in aes.cc.
+ */
+
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define HAVE_IPSEC_AESNI 1
+#endif
+
+class AESNI { public:
+
+    enum { ROUNDS = 10 };
+
+    // Expanded AES-128 key.  dec holds the Equivalent Inverse Cipher round
+    // keys, in decryption order.
+    struct Key {
+	uint64_t enc[ROUNDS + 1][2];
+	uint64_t dec[ROUNDS + 1][2];
+    };
+
+    // GHASH key: the byte-reflected hash key H and its powers H^2..H^4.
+    struct HashKey {
+	uint64_t h[4][2];
+    };
+
+    static bool available();
+
+    static void set_key(Key &key, const uint8_t *user_key);
+    static void encrypt_block(const Key &key, const uint8_t *in, uint8_t *out);
+
+    // IPsecAES's CBC variant: each 16-byte block is chained through its
+    // first 8 bytes only, starting from the 8-byte IV.  len is a multiple
+    // of 16.  Encryption and decryption work in place.
+    static void cbc8_encrypt(const Key &key, const uint8_t *iv, uint8_t *data, int len);
+    static void cbc8_decrypt(const Key &key, const uint8_t *iv, uint8_t *data, int len);
+
+    // AES-GCM (NIST SP 800-38D).  set_hash_key derives the GHASH key from
+    // the cipher key.  gcm_crypt encrypts or decrypts len bytes of data in
+    // place, starting from the pre-counter block j0, and stores the full
+    // 16-byte authentication tag, computed over aad and the ciphertext, in
+    // tag.
+    static void set_hash_key(HashKey &hkey, const Key &key);
+    static void gcm_crypt(const Key &key, const HashKey &hkey, const uint8_t *j0,
+			  const uint8_t *aad, int aad_len,
+			  uint8_t *data, int len, bool encrypt, uint8_t *tag);
+
+    // AES-CCM (NIST SP 800-38C) with a 2-byte length field, as 802.11 CCMP
+    // uses.  A job names the first CBC-MAC block b0, the counter block a0
+    // with its 2-byte counter zero, at most CCM_MAX_AAD bytes of associated
+    // data, and len bytes of data, encrypted or decrypted in place.
+    // ccm_crypt stores each job's full 16-byte encrypted CBC-MAC in its tag;
+    // callers truncate it.  Each CBC-MAC is serial, so ccm_crypt runs four
+    // jobs' CBC-MACs side by side to keep the AES pipeline full.
+    enum { CCM_MAX_AAD = 30 };
+    struct CCMJob {
+	uint8_t b0[16];
+	uint8_t a0[16];
+	uint8_t aad[CCM_MAX_AAD];
+	int aad_len;
+	uint8_t *data;
+	int len;
+	uint8_t tag[16];
+    };
+    static void ccm_crypt(const Key &key, CCMJob *jobs, int njobs, bool encrypt);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -43,37 +43,18 @@ IPsecESPUnencap::~IPsecESPUnencap()
 
 int
 IPsecESPUnencap::checkreplaywindow(SADataTuple * sa_data,unsigned long seq)
-  {
-	unsigned long diff;
-
-	if (seq == 0)
-		return 0;		/* first == 0 or wrapped */
-	/*This logic has been added for the time being to deal with replay rollover*/
-	if((seq == sa_data->replay_start_counter) && (sa_data->lastseq!=sa_data->replay_start_counter)) { sa_data->bitmap=0;sa_data->lastseq=seq;return 1;}
-
-	if (seq > sa_data->lastseq)	/* new larger sequence number */
-	{
-		diff = seq - sa_data->lastseq;
-		if (diff < sa_data->ooowin) /* In win, set bit for this pkt */
-			sa_data->bitmap = (sa_data->bitmap << diff) | 1;
-		else
-			sa_data->bitmap = 1; /* This packet has way larger */
-
-		sa_data->lastseq = seq;
-		return 1;		/* larger is good */
-	}
-	diff = sa_data->lastseq - seq;
-	if (diff >= sa_data->ooowin) {	/* too old or wrapped */
-		click_chatter("Replay protection: This packet is too old to be accepted\n");
-		return 0;
-
-        }
-	if (sa_data->bitmap & (1 << diff)) { /* this packet already seen */
-		click_chatter("Replay protection: This packet is already seen...\n");
-		return 0;
-        }
-	sa_data->bitmap |= (1 << diff);	/* mark as seen */
-	return 1;			/* out of order but good */
+{
+  switch (sa_data->replay.accept(seq)) {
+  case ReplayWindow::OK:
+    return 1;
+  case ReplayWindow::TOO_OLD:
+    if (seq != 0)
+      click_chatter("Replay protection: This packet is too old to be accepted\n");
+    return 0;
+  default:
+    click_chatter("Replay protection: This packet is already seen...\n");
+    return 0;
+  }
 }
 
 Packet *
@@ -13,8 +13,12 @@ CLICK_DECLS
  * removes IPSec encapsulation
  * =d
  *
- * Removes ESP header added by IPsecESPEncap. see RFC 2406. Does not perform
- * the optional anti-replay attack checks.
+ * Removes ESP header added by IPsecESPEncap. see RFC 2406. Drops packets
+ * whose sequence numbers fail the anti-replay check: each security
+ * association accepts every sequence number once, and only if it is at most
+ * its out-of-order window (up to 4096, see IPsecRouteTable) behind the
+ * largest accepted so far. Threads may decapsulate packets of one security
+ * association concurrently.
  *
  * =a IPsecESPUnencap, IPsecDES, IPsecAuthSHA1
  */
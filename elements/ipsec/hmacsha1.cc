@@ -31,12 +31,16 @@
 #include "elements/ipsec/hmac.hh"
 #include "satable.hh"
 #include "sadatatuple.hh"
+#include "shamb.hh"
 CLICK_DECLS
 
-#define SHA_DIGEST_LEN 20
-#define KEY_SIZE 16
-
 IPsecAuthHMACSHA1::IPsecAuthHMACSHA1()
+  : _sha256(false), _icv_len(ICV_SIZE)
+{
+}
+
+IPsecAuthHMACSHA1::IPsecAuthHMACSHA1(bool sha256, int icv_len)
+  : _sha256(sha256), _icv_len(icv_len)
 {
 }
 
@@ -57,44 +61,115 @@ IPsecAuthHMACSHA1::initialize(ErrorHandler *)
   return 0;
 }
 
+void
+IPsecAuthHMACSHA1::drop(Packet *p)
+{
+  if (_drops == 0)
+    click_chatter("Invalid %s authentication digest", _sha256 ? "SHA256" : "SHA1");
+  _drops++;
+  if (noutputs() > 1)
+    output(1).push(p);
+  else
+    p->kill();
+}
 
 Packet *
-IPsecAuthHMACSHA1::simple_action(Packet *p)
+IPsecAuthHMACSHA1::prepare(Packet *p, SHAMB::Job &job)
 {
   SADataTuple * sa_data=(SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(p);
-  unsigned int len;
-  // compute HMAC
-  len = SHA_DIGEST_LEN;
+  if (_sha256)
+    job.set_key(sa_data->sha256_key);
+  else
+    job.set_key(sa_data->sha1_key);
 
   if (_op == COMPUTE_AUTH) {
-    unsigned char digest [SHA_DIGEST_LEN];
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length(),digest,&len);
-    WritablePacket *q = p->put(12);
-    u_char *ah = ((u_char*)q->data())+q->length()-12;
-    memmove(ah, digest, 12);
+    // make room for the digest now, since put() may move the data
+    if (!(p = p->put(_icv_len)))
+      return 0;
+  } else if (p->length() < (unsigned) _icv_len) {
+    drop(p);
+    return 0;
+  }
+  job.data = p->data();
+  job.len = p->length() - _icv_len;
+  return p;
+}
+
+Packet *
+IPsecAuthHMACSHA1::finish(Packet *p, const SHAMB::Job &job)
+{
+  if (_op == COMPUTE_AUTH) {
+    WritablePacket *q = static_cast<WritablePacket *>(p);
+    memcpy(q->data() + job.len, job.digest, _icv_len);
     return q;
   }
   else {
-    const u_char *ah = p->data()+p->length()-12;
-    unsigned char digest [SHA_DIGEST_LEN];
-
-    HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length()-12,digest,&len);
-    if (memcmp(ah, digest, 12)) {
-      if (_drops == 0)
-	click_chatter("Invalid SHA1 authentication digest");
-      _drops++;
-      if (noutputs() > 1)
-	output(1).push(p);
-      else
-	p->kill();
+    if (memcmp(p->data() + job.len, job.digest, _icv_len)) {
+      drop(p);
       return 0;
     }
     //remove digest
-    p->take(12);
+    p->take(_icv_len);
     return p;
   }
 }
 
+void
+IPsecAuthHMACSHA1::hmac(SHAMB::Job *jobs, int njobs) const
+{
+  if (_sha256)
+    SHAMB::hmac_sha256(jobs, njobs);
+  else
+    SHAMB::hmac_sha1(jobs, njobs);
+}
+
+Packet *
+IPsecAuthHMACSHA1::simple_action(Packet *p)
+{
+  SHAMB::Job job;
+  if ((p = prepare(p, job))) {
+    hmac(&job, 1);
+    p = finish(p, job);
+  }
+  return p;
+}
+
+void
+IPsecAuthHMACSHA1::simple_action_batch(PacketBatch &batch)
+{
+  // Prepare up to BATCH packets and hash them together, one per lane.
+  PacketBatch out;
+  while (!batch.empty()) {
+    SHAMB::Job jobs[BATCH];
+    Packet *ps[BATCH];
+    int n = 0;
+    while (n < BATCH && !batch.empty())
+      if ((ps[n] = prepare(batch.pop_front(), jobs[n])))
+	n++;
+    hmac(jobs, n);
+    for (int i = 0; i < n; i++)
+      if (Packet *p = finish(ps[i], jobs[i]))
+	out.push_back(p);
+  }
+  batch.swap(out);
+}
+
+void
+IPsecAuthHMACSHA1::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+IPsecAuthHMACSHA1::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
 String
 IPsecAuthHMACSHA1::drop_handler(Element *e, void *)
 {
@@ -112,5 +187,6 @@ IPsecAuthHMACSHA1::add_handlers()
 #include "hmac.cc"
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecSHAMB)
 EXPORT_ELEMENT(IPsecAuthHMACSHA1)
 ELEMENT_MT_SAFE(IPsecAuthHMACSHA1)
@@ -0,0 +1,40 @@
+#ifndef CLICK_IPSECAUTHHMACSHA256_HH
+#define CLICK_IPSECAUTHHMACSHA256_HH
+#include "hmacsha1.hh"
+CLICK_DECLS
+
+/*
+ * =c
+ * IPsecAuthHMACSHA256(VERIFY)
+ * =s ipsec
+ * compute or verify SHA256 authentication digest.
+ * =d
+ *
+ * Like IPsecAuthHMACSHA1, but uses HMAC-SHA-256-128 per RFC 4868: the
+ * integrity check value is the first 16 bytes of the HMAC-SHA-256 digest. If
+ * first argument is 0, computes and appends the digest. If first argument is
+ * 1, verifies the digest and removes it; packets that fail verification are
+ * sent to output 1, if it exists, and dropped otherwise.
+ *
+ * The key is the security association's 16-byte authentication key, which
+ * is shorter than the 32 bytes RFC 4868 calls for.
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets that failed verification.
+ *
+ * =a IPsecAuthHMACSHA1, IPsecESPEncap
+ */
+
+class IPsecAuthHMACSHA256 : public IPsecAuthHMACSHA1 { public:
+
+  IPsecAuthHMACSHA256();
+
+  const char *class_name() const	{ return "IPsecAuthHMACSHA256"; }
+
+  enum { ICV_SIZE = 16 };
+
+};
+
+CLICK_ENDDECLS
+#endif
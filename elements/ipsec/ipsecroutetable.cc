@@ -46,7 +46,7 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
     IPsecRoute r;
     //Data to initialize the SADataTuple
     unsigned int replay;
-    uint8_t  oowin;
+    uint32_t oowin;
 
     SADataTuple * sa_data;
 
@@ -93,6 +93,10 @@ cp_ipsec_route(String s, IPsecRoute *r_store, bool remove_route, Element *contex
 	click_chatter("key has bad length");
 	return false;
     }
+    if (oowin > ReplayWindow::MAX_SIZE) {
+	click_chatter("OOSIZE must be at most %d", ReplayWindow::MAX_SIZE);
+	return false;
+    }
 
     // Create new Security Association Table entry
     sa_data = new SADataTuple(enc_key.data(), auth_key.data(), replay, oowin);
@@ -387,4 +391,5 @@ IPsecRouteTable::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPsecSHAMB IPsecAESNI)
 ELEMENT_PROVIDES(IPsecRouteTable)
@@ -166,8 +166,14 @@ tunneled traffic accordingly. All the routing table entries that refer to an IPS
 |SPI| |128-BIT ENCRYPTION_KEY| |128-BIT AUTHENTICATION_KEY| |REPLAY PROTECTION COUNTER| |OUT-OF-ORDER REPLAY WINDOW|
 The encryption and authentication keys will generally be specified using
 syntax such as C<\E<lt>0183 A947 1ABE 01FF FA04 103B B102<gt>>.
+The out-of-order replay window is the number of sequence numbers, at most
+4096, behind the largest seen that IPsecESPUnencap still accepts.
  This module uses 4 and 5 annotation space integers to pass Security Association Data between IPsec modules.
 
+Incoming ESP packets find their security association by SPI in a hash table
+whose lookups take no locks. Each association's keys are expanded once, when
+its route is added.
+
 =a RadixIPLookup, RangeIPsecLookup */
 
 
@@ -0,0 +1,94 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSEC_REPLAYWINDOW_HH
+#define CLICK_IPSEC_REPLAYWINDOW_HH
+#include <click/glue.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/*
+ * ESP anti-replay window (RFC 4303 section 3.4.3), kept as a ring of 64-bit
+ * words as in RFC 6479. Sequence number s owns bit s % 64 of word
+ * (s / 64) % nwords. When a larger sequence number moves the window
+ * forward, the words it moves into are cleared; no bits are shifted, so
+ * advancing by any amount costs at most one pass over the ring.
+ *
+ * accept() checks a sequence number and records it in one step, under a
+ * per-window spinlock held for a few instructions, so threads decapsulating
+ * packets of one SA concurrently never both accept the same number.
+ *
+ * A new window is empty, with size 0; init() sets the size.
+ */
+class ReplayWindow { public:
+
+    enum { WORD_BITS = 64, MAX_SIZE = 4096, MAX_WORDS = MAX_SIZE / WORD_BITS + 1 };
+
+    ReplayWindow()
+	: _size(0), _nwords(0), _start(0), _last(0), _bits() {
+    }
+
+    // Accept sequence numbers up to size - 1 behind the largest seen,
+    // starting from start.  size is at most MAX_SIZE.
+    void init(uint32_t size, uint32_t start) {
+	_size = size;
+	_nwords = (size + WORD_BITS - 1) / WORD_BITS + 1;
+	_start = start;
+	_last = start;
+	memset(_bits, 0, sizeof(_bits));
+    }
+
+    uint32_t size() const {
+	return _size;
+    }
+    uint32_t last() const {
+	return _last;
+    }
+
+    enum { OK = 0, TOO_OLD = -1, REPLAYED = -2 };
+    inline int accept(uint32_t seq);
+
+  private:
+
+    uint32_t _size;
+    uint32_t _nwords;
+    uint32_t _start;
+    uint32_t _last;		// largest sequence number accepted
+    SimpleSpinlock _lock;
+    uint64_t _bits[MAX_WORDS];
+
+};
+
+/* Return OK and record seq if it is new and inside the window, or TOO_OLD
+   or REPLAYED otherwise. */
+inline int
+ReplayWindow::accept(uint32_t seq)
+{
+    if (seq == 0)
+	return TOO_OLD;		/* first == 0 or wrapped */
+    _lock.acquire();
+    /* The sender restarts at its start counter when its sequence number
+       wraps; start the window over too. */
+    if (seq == _start && _last != _start) {
+	memset(_bits, 0, _nwords * sizeof(uint64_t));
+	_last = seq;
+    } else if (seq > _last) {
+	uint32_t top = _last / WORD_BITS;
+	uint32_t n = seq / WORD_BITS - top;
+	if (n > _nwords)
+	    n = _nwords;
+	for (uint32_t i = 1; i <= n; ++i)
+	    _bits[(top + i) % _nwords] = 0;
+	_last = seq;
+    } else if (_last - seq >= _size) {
+	_lock.release();
+	return TOO_OLD;
+    }
+    uint64_t &w = _bits[(seq / WORD_BITS) % _nwords];
+    uint64_t bit = (uint64_t) 1 << (seq % WORD_BITS);
+    int r = (w & bit ? REPLAYED : OK);
+    w |= bit;
+    _lock.release();
+    return r;
+}
+
+CLICK_ENDDECLS
+#endif
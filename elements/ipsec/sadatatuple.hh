@@ -5,6 +5,9 @@
 #include <click/etheraddress.hh>
 #include <click/bighashmap.hh>
 #include <click/glue.hh>
+#include "aesni.hh"
+#include "replaywindow.hh"
+#include "shamb.hh"
 CLICK_DECLS
 
 /*
@@ -48,13 +51,13 @@ class SPI {
 		return (_spi != 0);
 	}
 	inline bool
-	operator==(SPI b)
+	operator==(SPI b) const
 	{
 		return (this->_spi == b._spi);
 	}
 
 	inline bool
-	operator!=(SPI b)
+	operator!=(SPI b) const
 	{
 		return (this->_spi != b._spi);
 	}
@@ -77,23 +80,37 @@ class SADataTuple {
     /*These fields below deal with replay protection*/
     uint32_t replay_start_counter;
     uint32_t cur_rpl;
-    uint8_t  ooowin;	/* out-of-order window size */
-    uint32_t bitmap;	/* Support out-of-order receive support */
-    uint32_t lastseq;	/* in host order */
-
-    SADataTuple() {
-	memset(this, 0, sizeof(*this));
+    ReplayWindow replay;	/* out-of-order receive support */
+    /*HMAC pad states for Authentication_key, computed once per SA*/
+    SHAMB::SHA1Key sha1_key;
+    SHAMB::SHA256Key sha256_key;
+    /*Encryption_key expanded for the AES-NI kernels, and its GCM hash key;
+      valid if aesni_ready, which is true when the CPU has AES-NI*/
+    bool aesni_ready;
+    AESNI::Key aesni_key;
+    AESNI::HashKey gcm_hash_key;
+
+    SADataTuple()
+	: Encryption_key(), Authentication_key(), replay_start_counter(0),
+	  cur_rpl(0), sha1_key(), sha256_key(), aesni_ready(false),
+	  aesni_key(), gcm_hash_key() {
     }
 
-    SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin)
+    SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint32_t o_oowin)
+	: sha1_key(), sha256_key(), aesni_ready(false), aesni_key(),
+	  gcm_hash_key()
      {
-		memset(this, 0, sizeof(*this));
 		memcpy(Encryption_key, enc_key, KEY_SIZE);
 		memcpy(Authentication_key, Auth_key, KEY_SIZE);
 		replay_start_counter = counter;
-		ooowin = o_oowin;
-	        bitmap=0;
-		lastseq=cur_rpl=counter;
+		replay.init(o_oowin, counter);
+		cur_rpl=counter;
+		SHAMB::set_key(sha1_key, Authentication_key, KEY_SIZE);
+		SHAMB::set_key(sha256_key, Authentication_key, KEY_SIZE);
+		if ((aesni_ready = AESNI::available())) {
+			AESNI::set_key(aesni_key, Encryption_key);
+			AESNI::set_hash_key(gcm_hash_key, aesni_key);
+		}
      }
 
      operator bool() const
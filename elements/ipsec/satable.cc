@@ -24,6 +24,7 @@
 #include <clicknet/ether.h>
 #include "satable.hh"
 #include "sadatatuple.hh"
+#include <click/timestamp.hh>
 
 CLICK_DECLS
 
@@ -33,34 +34,67 @@ SATable::SATable()
 
 SATable::~SATable()
 {
+  for (int i = 0; i < _table.slot_count(); i++) {
+    SPI spi;
+    SADataTuple *dat;
+    if (_table.slot(i, spi, dat))
+      free_record(dat);
+  }
+  reclaim(true);
 }
 
-/*Get a reference to SA Data*/
+/*Records are cache-line aligned; the raw allocation is stored just before*/
 SADataTuple *
-SATable::lookup(SPI this_spi)
+SATable::new_record(const SADataTuple &sa)
 {
-  if (!this_spi) {
-    click_chatter("%s: lookup called with NULL spi!\n", name().c_str());
+  size_t size = sizeof(void *) + CACHE_LINE - 1 + sizeof(SADataTuple);
+  char *raw = (char *) CLICK_LALLOC(size);
+  if (!raw)
     return NULL;
-  }
-  //retrieve security association
-  SADataTuple  *dat = _table.findp(this_spi);
+  uintptr_t p = ((uintptr_t) raw + sizeof(void *) + CACHE_LINE - 1) & ~(uintptr_t) (CACHE_LINE - 1);
+  SADataTuple *dat = new((void *) p) SADataTuple(sa);
+  reinterpret_cast<void **>(dat)[-1] = raw;
   return dat;
 }
 
+void
+SATable::free_record(SADataTuple *sa)
+{
+  void *raw = reinterpret_cast<void **>(sa)[-1];
+  sa->~SADataTuple();
+  CLICK_LFREE(raw, sizeof(void *) + CACHE_LINE - 1 + sizeof(SADataTuple));
+}
+
+void
+SATable::reclaim(bool all)
+{
+  Timestamp limit = Timestamp::now_steady() - Timestamp::make_msec(GRACE_MSEC);
+  int i = 0;
+  for (; i < _retired.size() && (all || _retired[i].when <= limit); ++i)
+    free_record(_retired[i].sa);
+  _retired.erase(_retired.begin(), _retired.begin() + i);
+}
+
 /*Eventually this will be called from userspace Internet Key Exchange transactions*/
 int
-SATable::insert(SPI spi , SADataTuple SA_data)
+SATable::insert(SPI spi , const SADataTuple &SA_data)
 {
   if ((!spi) || (!SA_data)) {
     click_chatter("SATable %s: Attempt to insert data failed. Invalid arguments\n",name().c_str());
     return -1;
   }
-  SADataTuple * dat = _table.findp(spi);
-  if (!dat) {
-    _table.insert(spi, SA_data);
+  _lock.acquire();
+  SADataTuple *dat;
+  int r = 0;
+  if (!_table.find(spi, dat)) {
+    if ((dat = new_record(SA_data)))
+      _table.set(spi, dat);
+    else
+      r = -ENOMEM;
   }
-  return 0;
+  reclaim(false);
+  _lock.release();
+  return r;
 }
 
 /*Function to Remove Data*/
@@ -71,14 +105,21 @@ SATable::remove(unsigned int spi)
 	click_chatter("Invalid SPI parameter");
 	return -1;
   }
-  SADataTuple  *dat = _table.findp(spi);
-  if(!dat) {
+  _lock.acquire();
+  SADataTuple *dat;
+  if (!_table.find(SPI(spi), dat)) {
+	_lock.release();
 	click_chatter("No such entry");
 	return -1;
   }
-  delete dat;
-  _table.remove(SPI(spi));
-
+  _table.erase(SPI(spi));
+  // packets in flight may still refer to the record
+  Retired r;
+  r.sa = dat;
+  r.when = Timestamp::now_steady();
+  _retired.push_back(r);
+  reclaim(false);
+  _lock.release();
   return 0;
 }
 
@@ -88,8 +129,12 @@ SATable::print_sa_data()
 {
   StringAccum sa;
   int k;
-  for (SIter iter = _table.begin(); iter.live(); iter++) {
-    SADataTuple n = iter.value();
+  for (int i = 0; i < _table.slot_count(); i++) {
+    SPI spi;
+    SADataTuple *dat;
+    if (!_table.slot(i, spi, dat))
+      continue;
+    const SADataTuple &n = *dat;
     sa << "\nNew Entry\n";
     for(k=0; k< 16;k++)
 	{sa << n.Encryption_key[k];}
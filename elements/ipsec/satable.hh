@@ -3,12 +3,21 @@
 #include <click/element.hh>
 #include <click/ipaddress.hh>
 #include <click/etheraddress.hh>
-#include <click/bighashmap.hh>
+#include <click/rcuhashtable.hh>
+#include <click/sync.hh>
 #include <click/glue.hh>
 #include "sadatatuple.hh"
 
 CLICK_DECLS
 
+/*
+ * The Security Association Database: SPI -> SA. Each SA lives in its own
+ * cache-line-aligned record, so the keys expanded when it was created and the
+ * replay window it updates never share a line with another SA. lookup()
+ * takes no locks, so threads can look up SAs for different tunnels at once;
+ * insert() and remove() serialize on a spinlock. Removed records are freed
+ * only after a grace period, since packets in flight may still point at them.
+ */
 class SATable : public Element { public:
 
   SATable();
@@ -16,17 +25,39 @@ class SATable : public Element { public:
 
   const char *class_name() const		{ return "SATable"; }
   String print_sa_data();
-  int insert(SPI this_spi , SADataTuple SA_data) ;
+  int insert(SPI this_spi , const SADataTuple &SA_data) ;
   int remove(unsigned int spi);
-  SADataTuple * lookup(SPI this_spi);
+  inline SADataTuple * lookup(SPI this_spi) const;
+  int size() const				{ return _table.size(); }
+
+  enum { CACHE_LINE = 64, GRACE_MSEC = 1000 };
 
 private:
-  //Defines a click hashmap object the SA table in our case
-  typedef HashMap<SPI,SADataTuple> STable;
-  typedef STable::const_iterator SIter;
-  STable _table;
+  //SPI -> SA record
+  RCUHashTable<SPI, SADataTuple *> _table;
+  Spinlock _lock;
+
+  struct Retired {
+    SADataTuple *sa;
+    Timestamp when;
+  };
+  Vector<Retired> _retired;
+
+  static SADataTuple *new_record(const SADataTuple &sa);
+  static void free_record(SADataTuple *sa);
+  void reclaim(bool all);
 
 };
 
+/*Get a reference to SA Data*/
+inline SADataTuple *
+SATable::lookup(SPI this_spi) const
+{
+  SADataTuple *dat;
+  if (!this_spi || !_table.find(this_spi, dat))
+    return NULL;
+  return dat;
+}
+
 CLICK_ENDDECLS
 #endif
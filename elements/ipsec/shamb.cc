@@ -0,0 +1,406 @@
+// -*- c-basic-offset: 4; related-file-name: "shamb.hh" -*-
+/*
+ * shamb.{cc,hh} -- multi-buffer HMAC-SHA-1 and HMAC-SHA-256 for the IPsec
+ * elements
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "shamb.hh"
+CLICK_DECLS
+
+// The kernels are written once, as templates over a lane type V: uint32_t
+// for one lane, or a GCC vector of 32-bit words for 4 or 8.  Lane l of
+// every V variable belongs to message l.
+
+#if HAVE_IPSEC_SHAMB_VECTOR
+typedef uint32_t v4u __attribute__((vector_size(16)));
+#endif
+#if HAVE_IPSEC_SHAMB_AVX2
+typedef uint32_t v8u __attribute__((vector_size(32)));
+# define SHAMB_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef __GNUC__
+# define SHAMB_INLINE inline __attribute__((always_inline))
+#else
+# define SHAMB_INLINE inline
+#endif
+
+#define ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+namespace {
+
+enum { BLOCK_LEN = SHAMB::BLOCK_LEN };
+
+inline uint32_t
+load_be32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+	| ((uint32_t) p[2] << 8) | p[3];
+}
+
+inline void
+store_be32(uint8_t *p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+// Load one block per lane, lane l's from p[l].
+template <typename V> SHAMB_INLINE void
+load_block(V *w, const uint8_t *const *p)
+{
+    enum { L = sizeof(V) / sizeof(uint32_t) };
+    uint32_t x[16][L];
+    for (int t = 0; t < 16; ++t)
+	for (int l = 0; l < L; ++l)
+	    x[t][l] = load_be32(p[l] + 4 * t);
+    memcpy(w, x, sizeof(x));
+}
+
+// Copy the partial last block of len bytes of data to tail and pad it, as
+// if prefix bytes came before the data.  Return the number of blocks in
+// tail, 1 or 2.
+int
+pad_tail(uint8_t *tail, const uint8_t *data, int len, uint64_t prefix)
+{
+    int full = len & ~(BLOCK_LEN - 1);
+    int rem = len - full;
+    int ntail = (rem + 9 <= BLOCK_LEN ? 1 : 2);
+    memcpy(tail, data + full, rem);
+    tail[rem] = 0x80;
+    memset(tail + rem + 1, 0, ntail * BLOCK_LEN - rem - 9);
+    uint64_t bits = (prefix + len) * 8;
+    store_be32(tail + ntail * BLOCK_LEN - 8, bits >> 32);
+    store_be32(tail + ntail * BLOCK_LEN - 4, bits);
+    return ntail;
+}
+
+struct sha1_hash {
+    enum { H = 5, LEN = SHAMB::SHA1_LEN };
+    static const uint32_t iv[H];
+
+    // FIPS 180-4 section 6.1.2.  w is the block, and is overwritten.
+    template <typename V> static SHAMB_INLINE void
+    compress(V *s, V *w) {
+	V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4];
+#define SHA1_ROUND(t, f, k) do {					\
+	    if ((t) >= 16) {						\
+		V x = w[((t) + 13) & 15] ^ w[((t) + 8) & 15]		\
+		    ^ w[((t) + 2) & 15] ^ w[(t) & 15];			\
+		w[(t) & 15] = ROL(x, 1);				\
+	    }								\
+	    V x = ROL(a, 5) + (f) + e + w[(t) & 15] + (uint32_t) (k);	\
+	    e = d; d = c; c = ROL(b, 30); b = a; a = x;			\
+	} while (0)
+	int t = 0;
+	for (; t < 20; ++t)
+	    SHA1_ROUND(t, d ^ (b & (c ^ d)), 0x5A827999);
+	for (; t < 40; ++t)
+	    SHA1_ROUND(t, b ^ c ^ d, 0x6ED9EBA1);
+	for (; t < 60; ++t)
+	    SHA1_ROUND(t, (b & c) | (d & (b | c)), 0x8F1BBCDC);
+	for (; t < 80; ++t)
+	    SHA1_ROUND(t, b ^ c ^ d, 0xCA62C1D6);
+#undef SHA1_ROUND
+	s[0] += a;
+	s[1] += b;
+	s[2] += c;
+	s[3] += d;
+	s[4] += e;
+    }
+};
+
+const uint32_t sha1_hash::iv[] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+struct sha256_hash {
+    enum { H = 8, LEN = SHAMB::SHA256_LEN };
+    static const uint32_t iv[H];
+    static const uint32_t k[64];
+
+    // FIPS 180-4 section 6.2.2.  w is the block, and is overwritten.
+    template <typename V> static SHAMB_INLINE void
+    compress(V *s, V *w) {
+	V a = s[0], b = s[1], c = s[2], d = s[3];
+	V e = s[4], f = s[5], g = s[6], h = s[7];
+	for (int t = 0; t < 64; ++t) {
+	    if (t >= 16) {
+		V w15 = w[(t + 1) & 15], w2 = w[(t + 14) & 15];
+		w[t & 15] += (ROR(w15, 7) ^ ROR(w15, 18) ^ (w15 >> 3))
+		    + w[(t + 9) & 15]
+		    + (ROR(w2, 17) ^ ROR(w2, 19) ^ (w2 >> 10));
+	    }
+	    V t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25))
+		+ (g ^ (e & (f ^ g))) + w[t & 15] + k[t];
+	    V t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22))
+		+ ((a & b) | (c & (a | b)));
+	    h = g; g = f; f = e; e = d + t1;
+	    d = c; c = b; b = a; a = t1 + t2;
+	}
+	s[0] += a;
+	s[1] += b;
+	s[2] += c;
+	s[3] += d;
+	s[4] += e;
+	s[5] += f;
+	s[6] += g;
+	s[7] += h;
+    }
+};
+
+const uint32_t sha256_hash::iv[] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+const uint32_t sha256_hash::k[] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+    0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+    0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+    0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+    0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+    0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+    0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+    0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+    0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+// Plain hash of len bytes of data, for keys longer than a block.
+template <typename T> void
+hash(const uint8_t *data, int len, uint8_t *digest)
+{
+    uint32_t s[T::H], w[16];
+    uint8_t tail[2 * BLOCK_LEN];
+    memcpy(s, T::iv, sizeof(s));
+    int nfull = len / BLOCK_LEN;
+    int nblocks = nfull + pad_tail(tail, data, len, 0);
+    for (int b = 0; b < nblocks; ++b) {
+	const uint8_t *p = (b < nfull ? data + b * BLOCK_LEN
+			    : tail + (b - nfull) * BLOCK_LEN);
+	load_block(w, &p);
+	T::compress(s, w);
+    }
+    for (int h = 0; h < T::H; ++h)
+	store_be32(digest + 4 * h, s[h]);
+}
+
+template <typename T> void
+hmac_key(uint32_t *inner, uint32_t *outer, const uint8_t *key, int len)
+{
+    uint8_t k[BLOCK_LEN], pad[BLOCK_LEN];
+    const uint8_t *p = pad;
+    uint32_t w[16];
+    memset(k, 0, sizeof(k));
+    if (len > BLOCK_LEN)
+	hash<T>(key, len, k);
+    else
+	memcpy(k, key, len);
+
+    for (int i = 0; i < BLOCK_LEN; ++i)
+	pad[i] = k[i] ^ 0x36;
+    memcpy(inner, T::iv, T::H * sizeof(uint32_t));
+    load_block(w, &p);
+    T::compress(inner, w);
+
+    for (int i = 0; i < BLOCK_LEN; ++i)
+	pad[i] = k[i] ^ 0x5C;
+    memcpy(outer, T::iv, T::H * sizeof(uint32_t));
+    load_block(w, &p);
+    T::compress(outer, w);
+}
+
+// Compute the HMACs of up to one job per lane and return how many.  A
+// lane's last one or two blocks, holding the end of its message and the
+// padding, are built in tail; earlier blocks are read from the message in
+// place.  Lanes with fewer blocks drop out of the state updates early.
+template <typename T, typename V> SHAMB_INLINE int
+hmac_lanes(SHAMB::Job *jobs, int njobs)
+{
+    enum { L = sizeof(V) / sizeof(uint32_t), H = T::H };
+    int n = (njobs < L ? njobs : L);
+    uint8_t tail[L][2 * BLOCK_LEN];
+    int nfull[L], nblocks[L];
+    int maxblocks = 0;
+    uint32_t st[H][L];
+    const uint8_t *p[L];
+    V s[H], w[16];
+
+    for (int l = 0; l < L; ++l) {
+	if (l < n) {
+	    const SHAMB::Job &j = jobs[l];
+	    nfull[l] = j.len / BLOCK_LEN;
+	    nblocks[l] = nfull[l] + pad_tail(tail[l], j.data, j.len, BLOCK_LEN);
+	    if (nblocks[l] > maxblocks)
+		maxblocks = nblocks[l];
+	    for (int h = 0; h < H; ++h)
+		st[h][l] = j.inner[h];
+	} else {
+	    nfull[l] = nblocks[l] = 0;
+	    for (int h = 0; h < H; ++h)
+		st[h][l] = 0;
+	}
+    }
+    memcpy(s, st, sizeof(s));
+
+    for (int b = 0; b < maxblocks; ++b) {
+	uint32_t live[L];
+	bool all = true;
+	for (int l = 0; l < L; ++l) {
+	    live[l] = ~0U;
+	    if (b < nfull[l])
+		p[l] = jobs[l].data + b * BLOCK_LEN;
+	    else if (b < nblocks[l])
+		p[l] = tail[l] + (b - nfull[l]) * BLOCK_LEN;
+	    else {
+		p[l] = tail[0];
+		live[l] = 0;
+		all = false;
+	    }
+	}
+	load_block(w, p);
+	if (all)
+	    T::compress(s, w);
+	else {
+	    V old[H], m;
+	    memcpy(old, s, sizeof(s));
+	    memcpy(&m, live, sizeof(m));
+	    T::compress(s, w);
+	    for (int h = 0; h < H; ++h)
+		s[h] = (s[h] & m) | (old[h] & ~m);
+	}
+    }
+
+    // The outer hash is one block: the inner digest, padded.
+    memcpy(st, s, sizeof(st));
+    uint8_t outer[L][BLOCK_LEN];
+    for (int l = 0; l < L; ++l) {
+	uint8_t d[T::LEN];
+	for (int h = 0; h < H; ++h) {
+	    store_be32(d + 4 * h, st[h][l]);
+	    st[h][l] = jobs[l < n ? l : 0].outer[h];
+	}
+	pad_tail(outer[l], d, T::LEN, BLOCK_LEN);
+	p[l] = outer[l];
+    }
+    memcpy(s, st, sizeof(s));
+    load_block(w, p);
+    T::compress(s, w);
+    memcpy(st, s, sizeof(st));
+    for (int l = 0; l < n; ++l)
+	for (int h = 0; h < H; ++h)
+	    store_be32(jobs[l].digest + 4 * h, st[h][l]);
+    return n;
+}
+
+#if HAVE_IPSEC_SHAMB_AVX2
+bool
+have_avx2()
+{
+    static int have = -1;
+    if (have < 0) {
+	__builtin_cpu_init();
+	have = __builtin_cpu_supports("avx2");
+    }
+    return have;
+}
+
+template <typename T> SHAMB_AVX2 int
+hmac_x8(SHAMB::Job *jobs, int njobs)
+{
+    return hmac_lanes<T, v8u>(jobs, njobs);
+}
+#endif
+
+#if HAVE_IPSEC_SHAMB_VECTOR
+template <typename T> int
+hmac_x4(SHAMB::Job *jobs, int njobs)
+{
+    return hmac_lanes<T, v4u>(jobs, njobs);
+}
+#endif
+
+template <typename T> void
+hmac(SHAMB::Job *jobs, int njobs)
+{
+    while (njobs > 0) {
+	int n;
+#if HAVE_IPSEC_SHAMB_AVX2
+	if (njobs > 4 && have_avx2())
+	    n = hmac_x8<T>(jobs, njobs);
+	else
+#endif
+#if HAVE_IPSEC_SHAMB_VECTOR
+	if (njobs > 1)
+	    n = hmac_x4<T>(jobs, njobs);
+	else
+#endif
+	    n = hmac_lanes<T, uint32_t>(jobs, njobs);
+	jobs += n;
+	njobs -= n;
+    }
+}
+
+}
+
+void
+SHAMB::set_key(SHA1Key &key, const uint8_t *user_key, int len)
+{
+    hmac_key<sha1_hash>(key.inner, key.outer, user_key, len);
+}
+
+void
+SHAMB::set_key(SHA256Key &key, const uint8_t *user_key, int len)
+{
+    hmac_key<sha256_hash>(key.inner, key.outer, user_key, len);
+}
+
+void
+SHAMB::hmac_sha1(Job *jobs, int njobs)
+{
+    hmac<sha1_hash>(jobs, njobs);
+}
+
+void
+SHAMB::hmac_sha256(Job *jobs, int njobs)
+{
+    hmac<sha256_hash>(jobs, njobs);
+}
+
+int
+SHAMB::lanes()
+{
+#if HAVE_IPSEC_SHAMB_AVX2
+    if (have_avx2())
+	return 8;
+#endif
+#if HAVE_IPSEC_SHAMB_VECTOR
+    return 4;
+#else
+    return 1;
+#endif
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(IPsecSHAMB)
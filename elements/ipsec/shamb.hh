@@ -0,0 +1,69 @@
+// -*- c-basic-offset: 4; related-file-name: "shamb.cc" -*-
+#ifndef CLICK_IPSEC_SHAMB_HH
+#define CLICK_IPSEC_SHAMB_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * Multi-buffer HMAC-SHA-1 and HMAC-SHA-256 kernels for the IPsec
+ * authentication elements.  One hash is a serial chain of compression
+ * functions, so the kernels hash several messages at once, one per 32-bit
+ * vector lane: 8 lanes with AVX2, 4 with the generic vector code in other
+ * user-level builds, and a plain scalar loop in the kernel.
+ */
+
+#if CLICK_USERLEVEL && defined(__GNUC__)
+# define HAVE_IPSEC_SHAMB_VECTOR 1
+# if defined(__x86_64__) || defined(__i386__)
+#  define HAVE_IPSEC_SHAMB_AVX2 1
+# endif
+#endif
+
+class SHAMB { public:
+
+    enum { SHA1_LEN = 20, SHA256_LEN = 32, BLOCK_LEN = 64, MAX_LANES = 8 };
+
+    // HMAC keys, precomputed: the hash states after compressing the key
+    // XORed with the inner and outer pads.
+    struct SHA1Key {
+	uint32_t inner[5];
+	uint32_t outer[5];
+    };
+    struct SHA256Key {
+	uint32_t inner[8];
+	uint32_t outer[8];
+    };
+
+    static void set_key(SHA1Key &key, const uint8_t *user_key, int len);
+    static void set_key(SHA256Key &key, const uint8_t *user_key, int len);
+
+    // A job names a precomputed key and len bytes of data.  hmac_sha1 and
+    // hmac_sha256 store each job's full HMAC in its digest; callers
+    // truncate it.  Jobs of similar length share lanes best.
+    struct Job {
+	const uint32_t *inner;
+	const uint32_t *outer;
+	const uint8_t *data;
+	int len;
+	uint8_t digest[SHA256_LEN];
+
+	void set_key(const SHA1Key &key) {
+	    inner = key.inner;
+	    outer = key.outer;
+	}
+	void set_key(const SHA256Key &key) {
+	    inner = key.inner;
+	    outer = key.outer;
+	}
+    };
+
+    static void hmac_sha1(Job *jobs, int njobs);
+    static void hmac_sha256(Job *jobs, int njobs);
+
+    // Return the number of lanes this CPU hashes at once.
+    static int lanes();
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -69,6 +69,15 @@ CLICK_CXX_UNPROTECT
 extern "C" {
 DECLARE_PER_CPU(sk_buff *, click_device_unreceivable_sk_buff);
 }
+// ToHost sets click_device_unreceivable_sk_buff to the sk_buff it is passing
+// to Linux, or to CLICK_DEVICE_UNRECEIVABLE_ALL while it passes a list.
+# define CLICK_DEVICE_UNRECEIVABLE_ALL ((sk_buff *) 1)
+static inline bool
+click_device_unreceivable(const sk_buff *skb)
+{
+    sk_buff *u = __get_cpu_var(click_device_unreceivable_sk_buff);
+    return u == skb || u == CLICK_DEVICE_UNRECEIVABLE_ALL;
+}
 #endif
 
 #if !HAVE_CLICK_KERNEL && LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24) \
@@ -6,7 +6,6 @@
 CPUQueue::CPUQueue()
   : _last(0), _drops(0)
 {
-  memset(&_q, 0, sizeof(_q));
 }
 
 CPUQueue::~CPUQueue()
@@ -29,7 +28,7 @@ int
 CPUQueue::initialize(ErrorHandler *errh)
 {
   for (int i=0; i<NR_CPUS; i++)
-    if (!(_q[i]._q = new Packet*[_capacity+1]))
+    if (!_q[i].initialize(_capacity))
       return errh->error("out of memory!");
   _drops = 0;
   _last = 0;
@@ -39,34 +38,14 @@ CPUQueue::initialize(ErrorHandler *errh)
 void
 CPUQueue::cleanup(CleanupStage)
 {
-  for (int i=0; i<NR_CPUS; i++) {
-    for (int j = _q[i]._head; j != _q[i]._tail; j = next_i(j))
-      _q[i]._q[j]->kill();
-    delete[] _q[i]._q;
-    _q[i]._q = 0;
-  }
-}
-
-inline Packet *
-CPUQueue::deq(int n)
-{
-  if (_q[n]._head != _q[n]._tail) {
-    Packet *p = _q[n]._q[_q[n]._head];
-    _q[n]._head = next_i(_q[n]._head);
-    return p;
-  } else
-    return 0;
+  for (int i=0; i<NR_CPUS; i++)
+    _q[i].clear();
 }
 
 void
 CPUQueue::push(int, Packet *p)
 {
-    int n = click_current_processor();
-    int next = next_i(_q[n]._tail);
-    if (next != _q[n]._head) {
-	_q[n]._q[_q[n]._tail] = p;
-	_q[n]._tail = next;
-    } else {
+    if (!_q[click_current_processor()].push_back(p)) {
 	p->kill();
 	_drops++;
     }
@@ -78,7 +57,7 @@ CPUQueue::pull(int port)
     int n = _last;
     Packet *p = 0;
     for (int i = 0; i < NR_CPUS; i++) {
-	p = deq(n);
+	p = _q[n].pop_front();
 	n++;
 	if (n == NR_CPUS)
 	    n = 0;
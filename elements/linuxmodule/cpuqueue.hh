@@ -14,30 +14,25 @@
  * calling the push method. Drops incoming packets if the queue already holds
  * CAPACITY packets. The default for CAPACITY is 128.
  *
+ * Each queue is a PacketRing, so one CPU can push to it while another pulls
+ * from it without locks.
+ *
  * =a Queue
  */
 
 #include <click/element.hh>
+#include <click/packetring.hh>
 #if NR_CPUS > 256
 # error "too many CPUs for CPUQueue"
 #endif
 
 class CPUQueue : public Element {
-  struct {
-    Packet **_q;
-    unsigned _head;
-    unsigned _tail;
-    unsigned _pad[5];
-  } _q[NR_CPUS];
+  PacketRing _q[NR_CPUS];
 
   unsigned _last;
   unsigned _capacity;
   unsigned _drops;
 
-  int next_i(int i) const { return (i!=_capacity ? i+1 : 0); }
-  int prev_i(int i) const { return (i!=0 ? i-1 : _capacity); }
-  Packet *deq(int);
-
   static String read_handler(Element *, void *);
 
  public:
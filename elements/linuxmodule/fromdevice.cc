@@ -270,7 +270,7 @@ static struct sk_buff *
 click_br_handle_frame_hook(struct net_bridge_port *p, struct sk_buff *skb)
 {
 # if CLICK_DEVICE_UNRECEIVABLE_SK_BUFF
-    if (__get_cpu_var(click_device_unreceivable_sk_buff) == skb)
+    if (click_device_unreceivable(skb))
 	// This packet is being passed to Linux by ToHost.
 	return skb;
 # endif
@@ -296,7 +296,7 @@ struct sk_buff *
 click_fromdevice_rx_handler(struct sk_buff *skb)
 {
 # if CLICK_DEVICE_UNRECEIVABLE_SK_BUFF
-    if (__get_cpu_var(click_device_unreceivable_sk_buff) == skb)
+    if (click_device_unreceivable(skb))
 	// This packet is being passed to Linux by ToHost.
 	return skb;
 # endif
@@ -33,6 +33,13 @@
 #include <click/cxxprotect.h>
 CLICK_CXX_PROTECT
 #include <linux/netdevice.h>
+#if CLICK_POLLDEVICE_NAPI
+# include <linux/rtnetlink.h>
+# if HAVE_LINUX_NAPI_BUSY_LOOP && defined(CONFIG_NET_RX_BUSY_POLL)
+#  include <net/busy_poll.h>
+#  define CLICK_POLLDEVICE_BUSY_POLL 1
+# endif
+#endif
 #if __i386__
 #include <click/perfctr-i586.hh>
 #endif
@@ -46,6 +53,17 @@ extern "C" {
 static int device_notifier_hook(struct notifier_block *nb, unsigned long val, void *v);
 }
 
+#if CLICK_POLLDEVICE_BUSY_POLL
+extern "C" {
+static bool
+click_polldevice_loop_end(void *, unsigned long)
+{
+    // one NAPI poll per call: run_task is the loop
+    return true;
+}
+}
+#endif
+
 void
 PollDevice::static_initialize()
 {
@@ -64,6 +82,11 @@ PollDevice::static_cleanup()
 
 PollDevice::PollDevice()
 {
+    _capacity = 0;
+#if CLICK_POLLDEVICE_NAPI
+    _rx_dev = 0;
+    _napi_id = 0;
+#endif
 }
 
 PollDevice::~PollDevice()
@@ -78,14 +101,18 @@ PollDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     _headroom = 64;
     _length = 0;
     _user_length = false;
+    _rx_queue = -1;
     if (AnyDevice::configure_keywords(conf, errh, true) < 0
 	|| (Args(conf, this, errh)
 	    .read_mp("DEVNAME", _devname)
 	    .read_p("BURST", _burst)
+	    .read("QUEUE", _rx_queue)
 	    .read("HEADROOM", _headroom)
 	    .read("LENGTH", _length).read_status(_user_length)
 	    .complete() < 0))
 	return -1;
+    if (_burst == 0)
+	return errh->error("BURST must be positive");
 
 #if HAVE_LINUX_POLLING
     net_device *dev = lookup_device(errh);
@@ -93,6 +120,15 @@ PollDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 	dev_put(dev);
 	return errh->error("device %<%s%> not pollable, use FromDevice instead", _devname.c_str());
     }
+    if (_rx_queue >= 0)
+	errh->error("QUEUE not supported with the polling extension");
+    set_device(dev, &poll_device_map, 0);
+#elif CLICK_POLLDEVICE_NAPI
+    net_device *dev = lookup_device(errh);
+    if (dev && _rx_queue >= (int) dev->real_num_rx_queues) {
+	dev_put(dev);
+	return errh->error("device %<%s%> has only %u receive queues", _devname.c_str(), dev->real_num_rx_queues);
+    }
     set_device(dev, &poll_device_map, 0);
 #endif
     return errh->nerrors() ? -1 : 0;
@@ -136,6 +172,8 @@ you include a ToDevice for the same device. Try adding\n\
 	errh->warning("device %s requests at least %d bytes of HEADROOM", _devname.c_str(), (int) LL_RESERVED_SPACE(_dev));
 
     ScheduleInfo::initialize_task(this, &_task, _dev != 0, errh);
+    // keep device polling on the thread that owns the device queue
+    _task.set_stealable(false);
 #if HAVE_STRIDE_SCHED
     // user specifies max number of tickets; we start with default
     _max_tickets = _task.tickets();
@@ -144,6 +182,40 @@ you include a ToDevice for the same device. Try adding\n\
 
     reset_counts();
 
+#elif CLICK_POLLDEVICE_NAPI
+    // check for duplicate readers; readers of single queues share the
+    // device with each other, but not with other readers
+    if (ifindex() >= 0) {
+	void *&used = router()->force_attachment("device_reader_" + String(ifindex()));
+	if (used && (_rx_queue < 0 || used != &poll_device_map))
+	    return errh->error("duplicate reader for device '%s'", _devname.c_str());
+	if (_rx_queue < 0)
+	    used = this;
+	else {
+	    used = &poll_device_map;
+	    void *&qused = router()->force_attachment("device_reader_" + String(ifindex()) + "_" + String(_rx_queue));
+	    if (qused)
+		return errh->error("duplicate reader for device '%s' queue %d", _devname.c_str(), _rx_queue);
+	    qused = this;
+	}
+    }
+
+    ScheduleInfo::initialize_task(this, &_task, _dev != 0, errh);
+    // keep device polling on the thread that owns the device queue
+    _task.set_stealable(false);
+# if HAVE_STRIDE_SCHED
+    // user specifies max number of tickets; we start with default
+    _max_tickets = _task.tickets();
+    _task.set_tickets(Task::DEFAULT_TICKETS);
+# endif
+
+    reset_counts();
+
+    // set true queue size (now we can start receiving packets)
+    _capacity = QSIZE;
+    if (_dev && !set_rx_device(_dev, false))
+	return errh->error("device %<%s%> already has an rx_handler", _devname.c_str());
+
 #else
     errh->warning("can't get packets: not compiled with polling extensions");
 #endif
@@ -175,6 +247,10 @@ PollDevice::reset_counts()
   _push_cycles = 0;
 #endif
   _buffers_reused = 0;
+#if CLICK_POLLDEVICE_NAPI
+  _drops = 0;
+  _busy_polls = 0;
+#endif
 }
 
 void
@@ -192,6 +268,13 @@ PollDevice::cleanup(CleanupStage)
     if (had_dev && had_dev->polling > 0 && !poll_device_map.lookup(had_dev, 0))
 	had_dev->poll_off(had_dev);
     poll_device_map.unlock(false, lock_flags);
+#elif CLICK_POLLDEVICE_NAPI
+    // unregistering the rx_handler waits for got_skb() calls to finish
+    set_rx_device(0, false);
+    clear_device(&poll_device_map, 0);
+    for (Storage::index_type i = _head; i != _tail; i = next_i(i))
+	_queue[i]->kill();
+    _head = _tail = _capacity = 0;
 #endif
 }
 
@@ -309,11 +392,123 @@ PollDevice::run_task(Task *)
   adjust_tickets(got);
   _task.fast_reschedule();
   return got > 0;
+#elif CLICK_POLLDEVICE_NAPI
+# if CLICK_POLLDEVICE_BUSY_POLL
+  // Run the driver's NAPI poll ourselves; it hands us packets through
+  // got_skb().  Until a packet names the NAPI context, rely on interrupts.
+  if (unsigned napi_id = _napi_id)
+      if (size() < (int) _burst) {
+	  unsigned budget = (_burst < NAPI_POLL_WEIGHT ? _burst : NAPI_POLL_WEIGHT);
+#  if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+	  napi_busy_loop(napi_id, click_polldevice_loop_end, 0, true, budget);
+#  else
+	  (void) budget;
+	  napi_busy_loop(napi_id, click_polldevice_loop_end, 0);
+#  endif
+	  _busy_polls++;
+      }
+# endif
+
+  int got = 0;
+  while (got < (int) _burst && _head != _tail) {
+      Packet *p = _queue[_head];
+      packet_memory_barrier(_queue[_head], _head);
+      _head = next_i(_head);
+
+# ifndef CLICK_WARP9
+      if (timestamp())
+	  p->timestamp_anno().assign_now();
+# endif
+
+      _npackets++;
+      output(0).push(p);
+      got++;
+  }
+
+  adjust_tickets(got);
+  // while busy polling, poll again even if this poll found nothing
+  if (got > 0 || _napi_id)
+      _task.fast_reschedule();
+  return got > 0;
 #else
   return false;
 #endif /* HAVE_LINUX_POLLING */
 }
 
+#if CLICK_POLLDEVICE_NAPI
+/*
+ * Per-PollDevice packet input routine, called from the device's NAPI poll.
+ */
+int
+PollDevice::got_skb(struct sk_buff *skb)
+{
+    if (_capacity == 0)		// not yet initialized
+	return 0;
+
+    assert(skb_shared(skb) == 0);
+# if CLICK_POLLDEVICE_BUSY_POLL
+    if (skb->napi_id >= MIN_NAPI_ID)
+	_napi_id = skb->napi_id;
+# endif
+
+    // With QUEUE, only the queue's NAPI context calls us, one packet at a
+    // time.  Otherwise several queues' contexts may run at once.
+    bool lock = _rx_queue < 0;
+    if (lock)
+	_lock.acquire();
+
+    unsigned next = next_i(_tail);
+    if (next != _head) {
+	/* Retrieve the MAC header. */
+	skb_push(skb, skb->data - skb_mac_header(skb));
+
+	Packet *p = Packet::make(skb);
+	_queue[_tail] = p; /* hand it to run_task */
+	packet_memory_barrier(_queue[_tail], _tail);
+	_tail = next;
+	if (lock)
+	    _lock.release();
+	_task.reschedule();
+    } else {
+	/* queue full, drop */
+	_drops++;
+	if (lock)
+	    _lock.release();
+	kfree_skb(skb);
+    }
+    return 1;
+}
+
+bool
+PollDevice::set_rx_device(net_device *dev, bool rtnl_held)
+{
+    bool ok = true;
+    if (!rtnl_held)
+	rtnl_lock();
+    // rx_handler_data counts the PollDevices sharing the rx_handler, minus 1
+    if (_rx_dev && _rx_dev != dev) {
+	if (!_rx_dev->rx_handler_data)
+	    netdev_rx_handler_unregister(_rx_dev);
+	else
+	    _rx_dev->rx_handler_data = (void *) ((uintptr_t) _rx_dev->rx_handler_data - 1);
+	_rx_dev = 0;
+    }
+    if (dev && _rx_dev != dev) {
+	if (!dev->rx_handler)
+	    ok = netdev_rx_handler_register(dev, click_polldevice_rx_handler, 0) == 0;
+	else if (dev->rx_handler == click_polldevice_rx_handler)
+	    dev->rx_handler_data = (void *) ((uintptr_t) dev->rx_handler_data + 1);
+	else
+	    ok = false;
+	if (ok)
+	    _rx_dev = dev;
+    }
+    if (!rtnl_held)
+	rtnl_unlock();
+    return ok;
+}
+#endif
+
 void
 PollDevice::change_device(net_device *dev)
 {
@@ -344,12 +539,61 @@ PollDevice::change_device(net_device *dev)
 	if (_dev)
 	    _task.strong_reschedule();
     }
+#elif CLICK_POLLDEVICE_NAPI
+    bool dev_change = _dev != dev;
+
+    // called from the device notifier, which holds the RTNL
+    if (dev_change) {
+	_task.strong_unschedule();
+	if (_capacity)
+	    set_rx_device(0, true);
+	_napi_id = 0;
+    }
+
+    set_device(dev, &poll_device_map, anydev_change);
+
+    if (dev_change && _dev && _capacity) {
+	if (!set_rx_device(_dev, true))
+	    click_chatter("%s: device '%s' already has an rx_handler", declaration().c_str(), _devname.c_str());
+	_task.strong_reschedule();
+    }
 #else
     (void) dev;
 #endif /* HAVE_LINUX_POLLING */
 }
 
 extern "C" {
+#if CLICK_POLLDEVICE_NAPI
+struct sk_buff *
+click_polldevice_rx_handler(struct sk_buff *skb)
+{
+# if CLICK_DEVICE_UNRECEIVABLE_SK_BUFF
+    if (click_device_unreceivable(skb))
+	// This packet is being passed to Linux by ToHost.
+	return skb;
+# endif
+
+    // prefer the PollDevice reading this packet's queue
+    int q = (skb_rx_queue_recorded(skb) ? skb_get_rx_queue(skb) : -1);
+    int stolen = 0;
+    PollDevice *pd = 0, *any = 0;
+    unsigned long lock_flags;
+
+    poll_device_map.lock(false, lock_flags);
+    while ((pd = (PollDevice *)poll_device_map.lookup(skb->dev, pd))
+	   && pd->rx_queue() != q)
+	if (pd->rx_queue() < 0)
+	    any = pd;
+    if (pd || (pd = any))
+	stolen = pd->got_skb(skb);
+    poll_device_map.unlock(false, lock_flags);
+    if (stolen)
+	return 0;
+    else
+	return skb;
+}
+#endif
+
 static int
 device_notifier_hook(struct notifier_block *nb, unsigned long flags, void *v)
 {
@@ -423,6 +667,10 @@ PollDevice::add_handlers()
 #endif
     add_write_handler("reset_counts", PollDevice_write_stats, 0, Handler::BUTTON);
     add_data_handlers("buffers_reused", Handler::OP_READ, &_buffers_reused);
+#if CLICK_POLLDEVICE_NAPI
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+    add_data_handlers("busy_polls", Handler::OP_READ, &_busy_polls);
+#endif
     add_task_handlers(&_task);
 }
 
@@ -4,7 +4,7 @@
 /*
 =c
 
-PollDevice(DEVNAME [, I<keywords> PROMISC, BURST, TIMESTAMP...])
+PollDevice(DEVNAME [, I<keywords> PROMISC, BURST, QUEUE, TIMESTAMP...])
 
 =s netdevices
 
@@ -20,6 +20,20 @@ device with that address.
 Each time PollDevice is scheduled, it emits at most BURST packets. By default,
 BURST is 8.
 
+On kernels without the Click polling extension, PollDevice is built on the
+driver's standard NAPI poll loop.  It takes the packets NAPI receives from the
+device with an rx_handler, before the network stack sees them, and queues them
+for its Task.  When the kernel supports busy polling (CONFIG_NET_RX_BUSY_POLL),
+the Task also runs the driver's NAPI poll function itself, with a budget of
+BURST packets, once the first packet has shown which NAPI context serves the
+device.  The driver keeps allocating receive buffers from its own page pool;
+when Click frees a packet, its pages go back to that pool.  To keep the device
+from raising interrupts while PollDevice polls it, set the device's
+napi_defer_hard_irqs and gro_flush_timeout in sysfs.
+
+Several PollDevice elements can read different receive queues of one device,
+each with its own QUEUE, and run on different threads.
+
 This element is only available in the Linux kernel module.
 
 Keyword arguments are:
@@ -35,6 +49,13 @@ active.  Default is false.
 
 Unsigned integer.  Sets the BURST parameter.
 
+=item QUEUE
+
+Integer.  If nonnegative, PollDevice only receives packets from the device's
+receive queue number QUEUE.  Packets from queues no PollDevice reads are
+passed to Linux.  Not available with the polling extension.  Default is -1,
+meaning all queues.
+
 =item TIMESTAMP
 
 Boolean.  If true, then ensure that received packets have correctly-set
@@ -46,14 +67,15 @@ Boolean.  If true, then suppress device up/down messages.  Default is false.
 
 =item HEADROOM
 
-Unsigned.  Amount of extra headroom to request on each packet.  Default is 64.
+Unsigned.  Amount of extra headroom to request on each packet.  Only used
+with the polling extension.  Default is 64.
 
 =item LENGTH
 
 Unsigned integer.  Sets the minimum size requested for packet buffers.  Should
 be at least as large as your interface's MTU; some cards require even more
-data than that.  Defaults to a number derived from the driver, which is
-usually the right answer.
+data than that.  Only used with the polling extension.  Defaults to a number
+derived from the driver, which is usually the right answer.
 
 =item ALLOW_NONEXISTENT
 
@@ -82,8 +104,11 @@ packets, you should hand them to ToHost. Also, if you would like to send
 packets while using PollDevice, you should also define a ToDevice on the same
 device.
 
-This element can only be used with devices that support the Click polling
-extension. We have written polling patches for the Tulip Ethernet driver.
+With the Click polling extension, which needs patched drivers such as our
+Tulip driver, PollDevice replaces the driver's receive interrupt.  Without
+it, PollDevice works with any NAPI driver, but needs a kernel with
+netdev_rx_handler_register, and a device can't be read by both FromDevice and
+PollDevice.
 
 Linux device drivers, and thus FromDevice, should set packets' timestamp,
 packet-type, and device annotations.
@@ -92,6 +117,16 @@ packet-type, and device annotations.
 
 Returns the number of packets PollDevice has received from the input card.
 
+=h drops read-only
+
+Returns the number of packets dropped because PollDevice's internal queue was
+full.  Not available with the polling extension.
+
+=h busy_polls read-only
+
+Returns the number of times PollDevice ran the driver's NAPI poll function.
+Not available with the polling extension.
+
 =h reset_counts write-only
 
 Resets C<count> counter to zero when written.
@@ -99,8 +134,14 @@ Resets C<count> counter to zero when written.
 =a FromDevice, ToDevice, FromHost, ToHost */
 
 #include "elements/linuxmodule/anydevice.hh"
+#include <click/standard/storage.hh>
+#include <click/sync.hh>
 
-class PollDevice : public AnyTaskDevice { public:
+#if !HAVE_LINUX_POLLING && HAVE_LINUX_NETDEV_RX_HANDLER_REGISTER
+# define CLICK_POLLDEVICE_NAPI 1
+#endif
+
+class PollDevice : public AnyTaskDevice, public Storage { public:
 
   PollDevice();
   ~PollDevice();
@@ -121,6 +162,7 @@ class PollDevice : public AnyTaskDevice { public:
   void change_device(net_device *);
   /* process a packet. return 0 if not wanted after all. */
   int got_skb(struct sk_buff *);
+  int rx_queue() const			{ return _rx_queue; }
 
   bool run_task(Task *);
 
@@ -149,6 +191,10 @@ class PollDevice : public AnyTaskDevice { public:
 #endif
 
   uint32_t _buffers_reused;
+#if CLICK_POLLDEVICE_NAPI
+  uint32_t _drops;
+  uint32_t _busy_polls;
+#endif
 
  private:
 
@@ -156,8 +202,26 @@ class PollDevice : public AnyTaskDevice { public:
     unsigned _headroom;
     uint32_t _length;
     bool _user_length;
+    int _rx_queue;
+
+#if CLICK_POLLDEVICE_NAPI
+    net_device *_rx_dev;	// device whose rx_handler we hold
+    unsigned _napi_id;		// NAPI context seen on received packets
+    Spinlock _lock;		// serializes got_skb() if _rx_queue < 0
+
+    enum { QSIZE = 511 };
+    Packet * volatile _queue[QSIZE+1];
+
+    bool set_rx_device(net_device *dev, bool rtnl_held);
+#endif
 
 };
 
+#if CLICK_POLLDEVICE_NAPI
+extern "C" {
+struct sk_buff *click_polldevice_rx_handler(struct sk_buff *skb);
+}
+#endif
+
 #endif
 
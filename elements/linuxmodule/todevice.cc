@@ -175,6 +175,7 @@ ToDevice::initialize(ErrorHandler *errh)
 #endif
 
     ScheduleInfo::initialize_task(this, &_task, _dev != 0, errh);
+    _task.set_stealable(false);
     _signal = Notifier::upstream_empty_signal(this, 0, &_task);
 
 #if HAVE_STRIDE_SCHED
@@ -200,6 +201,7 @@ ToDevice::reset_counts()
   _drops = 0;
   _holds = 0;
   _pulls = 0;
+  memset(_burst_hist, 0, sizeof(_burst_hist));
 #if CLICK_DEVICE_STATS
   _activations = 0;
   _time_clean = 0;
@@ -229,8 +231,10 @@ ToDevice::cleanup(CleanupStage stage)
 	    unregister_net_tx(&tx_notifier);
     }
 #endif
-    if (_q)
-	_q->kill();
+    while (Packet *p = _q) {
+	_q = p->next();
+	p->kill();
+    }
     clear_device(&to_device_map, 0);
 }
 
@@ -263,6 +267,12 @@ ToDevice::cleanup(CleanupStage stage)
 # define click_netif_needs_lock(dev)		1
 #endif
 
+/* With xmit_more, call the driver directly, telling it when more packets
+ * will follow, so it can put off ringing the doorbell until the last. */
+#if HAVE_NETDEV_GET_TX_QUEUE && LINUX_VERSION_CODE >= KERNEL_VERSION(3, 18, 0)
+# define CLICK_TODEVICE_XMIT_MORE 1
+#endif
+
 #if HAVE_NETDEV_GET_TX_QUEUE
 # define click_netif_lock(dev, txq)		(txq)->_xmit_lock
 # define click_netif_lock_owner(dev, txq)	(txq)->xmit_lock_owner
@@ -296,6 +306,10 @@ ToDevice::run_task(Task *)
 	    return false;
 	}
     }
+#if CLICK_TODEVICE_XMIT_MORE
+    else
+	local_bh_disable();
+#endif
 
 #if CLICK_DEVICE_STATS
     unsigned low00, low10;
@@ -312,7 +326,8 @@ ToDevice::run_task(Task *)
 	clean_skbs = 0;
 #endif
 
-    /* try to send from click */
+    /* try to send from click, a batch at a time: pull the batch, then hand
+       it to the device under one lock */
     while (sent < _burst) {
 
 	busy = click_netif_tx_queue_stopped(dev, txq)
@@ -320,39 +335,59 @@ ToDevice::run_task(Task *)
 	if (busy != 0)
 	    break;
 
+	Packet *batch[max_batch];
+	unsigned n = 0, want = _burst - sent;
+	bool drained = false;
+	if (want > max_batch)
+	    want = max_batch;
+
+	while (n < want) {
 #if CLICK_DEVICE_THESIS_STATS && !CLICK_DEVICE_STATS
-	click_cycles_t before_pull_cycles = click_get_cycles();
+	    click_cycles_t before_pull_cycles = click_get_cycles();
 #endif
 
-	_pulls++;
+	    _pulls++;
 
-	Packet *p;
-	if ((p = _q)) {
-	    _q = 0;
-	    if (click_jiffies_less(_q_expiry_j, click_jiffies())) {
-		p->kill();
-		_drops++;
-		p = 0;
+	    Packet *p = next_packet();
+	    if (!p) {
+		drained = true;
+		break;
 	    }
-	}
-	if (!p && !(p = input(0).pull()))
-	    break;
 
 #if CLICK_DEVICE_THESIS_STATS && !CLICK_DEVICE_STATS
-	_pull_cycles += click_get_cycles() - before_pull_cycles - CLICK_CYCLE_COMPENSATION;
+	    _pull_cycles += click_get_cycles() - before_pull_cycles - CLICK_CYCLE_COMPENSATION;
 #endif
 
-	GET_STATS_RESET(low00, low10, time_now,
-			_perfcnt1_pull, _perfcnt2_pull, _pull_cycles);
+	    GET_STATS_RESET(low00, low10, time_now,
+			    _perfcnt1_pull, _perfcnt2_pull, _pull_cycles);
 
-	busy = queue_packet(p, txq);
+	    if ((p = prepare_packet(p)))
+		batch[n++] = p;
+	}
+	if (n == 0)
+	    break;
+
+	for (unsigned i = 0; i < n; i++) {
+	    busy = queue_packet(batch[i], txq, i + 1 < n);
+	    if (busy) {
+		hold(batch + i, n - i);
+		break;
+	    }
+	    sent++;
+	}
 
 	GET_STATS_RESET(low00, low10, time_now,
 			_perfcnt1_queue, _perfcnt2_queue, _time_queue);
 
-	if (busy)
+	if (busy || drained)
 	    break;
-	sent++;
+    }
+
+    if (sent > 0) {
+	int b = 0;
+	while (b < nburst_hist - 1 && (2U << b) <= (unsigned) sent)
+	    b++;
+	_burst_hist[b]++;
     }
 
 #if HAVE_LINUX_POLLING
@@ -403,6 +438,10 @@ ToDevice::run_task(Task *)
 	spin_unlock_bh(&dev->xmit_lock);
 #endif
     }
+#if CLICK_TODEVICE_XMIT_MORE
+    else
+	local_bh_enable();
+#endif
 
     // If we're polling, never go to sleep! We're relying on ToDevice to clean
     // the transmit ring.
@@ -453,8 +492,37 @@ ToDevice::run_task(Task *)
     return sent > 0;
 }
 
-int
-ToDevice::queue_packet(Packet *p, struct netdev_queue *txq)
+Packet *
+ToDevice::next_packet()
+{
+    // held packets first, unless they have waited too long
+    while (Packet *p = _q) {
+	_q = p->next();
+	p->set_next(0);
+	if (!click_jiffies_less(_q_expiry_j, click_jiffies()))
+	    return p;
+	p->kill();
+	_drops++;
+    }
+    return input(0).pull();
+}
+
+void
+ToDevice::hold(Packet **ps, int n)
+{
+    // the device refused ps[0]; keep ps[0..n) in order, ahead of any
+    // packets still held
+    for (int i = n - 1; i >= 0; i--) {
+	ps[i]->set_next(_q);
+	_q = ps[i];
+    }
+    _q_expiry_j = click_jiffies() + queue_timeout;
+    if (++_holds == 1)
+	printk("<1>ToDevice %s is full, packet delayed\n", _dev->name);
+}
+
+Packet *
+ToDevice::prepare_packet(Packet *p)
 {
     struct sk_buff *skb1 = p->skb();
     struct net_device *dev = _dev;
@@ -472,9 +540,12 @@ ToDevice::queue_packet(Packet *p, struct netdev_queue *txq)
 		printk("<1>ToDevice %s packet too small (len %d, tailroom %d, need %d), had to copy\n", dev->name, skb1->len, skb_tailroom(skb1), need_tail);
 	    struct sk_buff *nskb = skb_copy_expand(skb1, skb_headroom(skb1), skb_tailroom(skb1) + 60 - skb1->len, GFP_ATOMIC);
 	    kfree_skb(skb1);
-	    if (!nskb)
-		return -1;
+	    if (!nskb) {
+		_drops++;
+		return 0;
+	    }
 	    skb1 = nskb;
+	    p = reinterpret_cast<Packet *>(nskb);
 	}
 	// printk("padding %d:%d:%d\n", skb1->truesize, skb1->len, 60-skb1->len);
 	skb_put(skb1, need_tail);
@@ -493,30 +564,63 @@ ToDevice::queue_packet(Packet *p, struct netdev_queue *txq)
 	skb_dst_drop(skb1);
 #endif
 
+    return p;
+}
+
+int
+ToDevice::queue_packet(Packet *p, struct netdev_queue *txq, bool more)
+{
+    struct sk_buff *skb1 = p->skb();
+    struct net_device *dev = _dev;
+
     int ret;
 #if HAVE_LINUX_POLLING
     if (dev->polling > 0) {
 	ret = dev->tx_queue(dev, skb1);
-	goto enqueued;
+	if (ret != 0)
+	    return ret;
+	goto sent;
     }
 #endif
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 30)
+#if CLICK_TODEVICE_XMIT_MORE
+    ret = netdev_start_xmit(skb1, dev, txq, more);
+    ++_hard_start;
+    if (!dev_xmit_complete(ret))
+	return ret;
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 30)
+    (void) txq, (void) more;
+    // dev_queue_xmit consumes the packet even if it fails
     ret = dev_queue_xmit(skb1);
+    ++_hard_start;
 #else
+    (void) txq, (void) more;
     ret = dev->hard_start_xmit(skb1, dev);
-#endif
     ++_hard_start;
+    if (ret != 0)
+	return ret;
+#endif
 
- enqueued:
     if (ret != 0) {
-        _q = p;
-	_q_expiry_j = click_jiffies() + queue_timeout;
-        if (++_holds == 1)
-            printk("<1>ToDevice %s is full, packet delayed\n", dev->name);
-    } else
-        _npackets++;
-    return ret;
+	_drops++;
+	return 0;
+    }
+#if HAVE_LINUX_POLLING
+ sent:
+#endif
+    _npackets++;
+    return 0;
+}
+
+String
+ToDevice::read_burst_histogram(Element *e, void *)
+{
+    ToDevice *td = (ToDevice *)e;
+    StringAccum sa;
+    for (int b = 0; b < nburst_hist; b++)
+	sa << (1U << b) << (b == nburst_hist - 1 ? "+ " : " ")
+	   << td->_burst_hist[b] << '\n';
+    return sa.take_string();
 }
 
 void
@@ -607,6 +711,7 @@ ToDevice::add_handlers()
     add_data_handlers("count", Handler::OP_READ, &_npackets);
     add_data_handlers("drops", Handler::OP_READ, &_drops);
     add_data_handlers("holds", Handler::OP_READ, &_holds);
+    add_read_handler("burst_histogram", read_burst_histogram, 0);
     add_data_handlers("packets", Handler::OP_READ | Handler::DEPRECATED, &_npackets);
 #if CLICK_DEVICE_THESIS_STATS || CLICK_DEVICE_STATS
     add_read_handler("pull_cycles", Handler::OP_READ, &_pull_cycles);
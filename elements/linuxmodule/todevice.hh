@@ -23,6 +23,13 @@ Sends up to BURST packets each time it is scheduled. By default, BURST is 16.
 For good performance, you should set BURST to be 8 times the number of
 elements that could generate packets for this device.
 
+ToDevice pulls packets in batches of up to 32 and hands each batch to the
+device while holding its transmit lock once.  On Linux 3.18 and later,
+ToDevice calls the driver directly and tells it that more packets follow
+for all but the last packet of a batch (xmit_more), so the driver can
+notify the hardware once per batch.  Larger BURSTs send more efficiently,
+but a packet may wait for the rest of its batch.
+
 Packets must have a link header. For Ethernet, ToDevice makes sure every
 packet is at least 60 bytes long (but see NO_PAD).
 
@@ -97,6 +104,17 @@ Returns the number of packets ToDevice has dropped.  ToDevice will drop
 packets because they are too short for the device, or because the device
 explicitly rejected them.
 
+=h holds read-only
+
+Returns the number of times the device refused a packet, so that ToDevice
+held it to try again later.
+
+=h burst_histogram read-only
+
+Returns a histogram of the number of packets sent per scheduling, one line per
+power-of-two bucket.  Each line has the bucket's lower bound followed by the
+number of times ToDevice sent that many packets.
+
 =h reset_counts write-only
 
 Resets counters to zero when written.
@@ -151,7 +169,9 @@ class ToDevice : public AnyTaskDevice { public:
 #else
     enum { _tx_queue = 0 };
 #endif
-    Packet *_q;
+    enum { max_batch = 32, nburst_hist = 8 };
+
+    Packet *_q;			// held packets, linked by next()
     click_jiffies_t _q_expiry_j;
     unsigned _burst;
     int _dev_idle;
@@ -184,10 +204,15 @@ class ToDevice : public AnyTaskDevice { public:
     uint32_t _hard_start;
     uint32_t _busy_returns;
     uint32_t _too_short;
+    uint32_t _burst_hist[nburst_hist];
 
-    int queue_packet(Packet *p, struct netdev_queue *txq);
+    Packet *next_packet();
+    void hold(Packet **ps, int n);
+    Packet *prepare_packet(Packet *p);
+    int queue_packet(Packet *p, struct netdev_queue *txq, bool more);
 
     static String read_calls(Element *e, void *user_data);
+    static String read_burst_histogram(Element *e, void *user_data);
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh);
 
 };
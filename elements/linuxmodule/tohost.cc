@@ -21,6 +21,7 @@
 #include "tohost.hh"
 #include <click/args.hh>
 #include <click/error.hh>
+#include <click/packetbatch.hh>
 
 #include <click/cxxprotect.h>
 CLICK_CXX_PROTECT
@@ -32,6 +33,9 @@ CLICK_CXX_PROTECT
 #if LINUX_VERSION_CODE >= 0x020400 && LINUX_VERSION_CODE < 0x020600
 # include <linux/brlock.h>
 #endif
+#if HAVE_LINUX_GRO_CELLS
+# include <net/gro_cells.h>
+#endif
 CLICK_CXX_UNPROTECT
 #include <click/cxxunprotect.h>
 
@@ -58,9 +62,19 @@ ToHost::static_cleanup()
     unregister_netdevice_notifier(&device_notifier);
 }
 
+// Lists of sk_buffs can be passed to Linux only where ToHost marks
+// deliveries per CPU rather than with the patched receive functions.
+#if HAVE_LINUX_NETIF_RECEIVE_SKB_LIST && CLICK_DEVICE_UNRECEIVABLE_SK_BUFF
+# define CLICK_TOHOST_SKB_LIST 1
+#endif
+
 ToHost::ToHost()
-    : _sniffers(false), _drops(0)
+    : _sniffers(false), _gro(false), _drops(0)
 {
+#if HAVE_LINUX_GRO_CELLS
+    _gro_cells = 0;
+    _gro_dev = 0;
+#endif
 }
 
 ToHost::~ToHost()
@@ -76,8 +90,17 @@ ToHost::configure(Vector<String> &conf, ErrorHandler *errh)
 	    .read_p("DEVNAME", _devname)
 	    .read("SNIFFERS", _sniffers)
 	    .read("TYPE", WordArg(), type)
+	    .read("GRO", _gro)
 	    .complete() < 0))
 	return -1;
+    if (_gro && (!_devname || _sniffers || allow_nonexistent()))
+	return errh->error("GRO requires DEVNAME, without SNIFFERS or ALLOW_NONEXISTENT");
+#if !HAVE_LINUX_GRO_CELLS
+    if (_gro) {
+	errh->warning("GRO not supported by this kernel, ignored");
+	_gro = false;
+    }
+#endif
     if (type == "ETHER" || type == "")
 	_type = ARPHRD_ETHER;
     else if (type == "IP")
@@ -99,6 +122,22 @@ ToHost::initialize(ErrorHandler *errh)
 	net_device *dev = lookup_device(errh);
 	set_device(dev, &to_host_map, 0);
     }
+
+#if HAVE_LINUX_GRO_CELLS
+    if (_gro && _dev) {
+	_gro_cells = new struct gro_cells;
+	if (_gro_cells)
+	    memset(_gro_cells, 0, sizeof(struct gro_cells));
+	if (!_gro_cells || gro_cells_init(_gro_cells, _dev) < 0) {
+	    delete _gro_cells;
+	    _gro_cells = 0;
+	    return errh->error("out of memory");
+	}
+	// The GRO cells' NAPI instances belong to the device.
+	_gro_dev = _dev;
+	dev_hold(_gro_dev);
+    }
+#endif
     return errh->nerrors() ? -1 : 0;
 }
 
@@ -106,6 +145,15 @@ void
 ToHost::cleanup(CleanupStage)
 {
     clear_device(&to_host_map, 0);
+#if HAVE_LINUX_GRO_CELLS
+    if (_gro_cells) {
+	gro_cells_destroy(_gro_cells);
+	delete _gro_cells;
+	_gro_cells = 0;
+	dev_put(_gro_dev);
+	_gro_dev = 0;
+    }
+#endif
 }
 
 extern "C" {
@@ -163,8 +211,10 @@ tohost_eth_type_trans(struct sk_buff *skb, struct net_device *dev)
     return __constant_htons(ETH_P_802_2);
 }
 
-void
-ToHost::push(int port, Packet *p)
+// Make p's sk_buff ready for Linux, and return it, or drop p and return
+// null if it has no device.
+inline struct sk_buff *
+ToHost::prepare(Packet *p)
 {
     p->clear_annotations(false);
 
@@ -179,7 +229,7 @@ ToHost::push(int port, Packet *p)
 	if (++_drops == 1)
 	    click_chatter("%{element}: dropped a packet with null skb->dev", this);
 	p->kill();
-	return;
+	return 0;
     }
 
 #if PACKET_TYPE_MASK
@@ -215,6 +265,31 @@ ToHost::push(int port, Packet *p)
 	skb->protocol = tohost_eth_type_trans(skb, skb->dev);
     }
 
+    return skb;
+}
+
+void
+ToHost::push(int, Packet *p)
+{
+    struct sk_buff *skb = prepare(p);
+    if (!skb)
+	return;
+
+#if HAVE_LINUX_GRO_CELLS
+    if (_gro_cells && skb->dev == _gro_dev) {
+	local_bh_disable();
+	(void) gro_cells_receive(_gro_cells, skb);
+	local_bh_enable();
+	return;
+    }
+#endif
+    deliver(skb);
+}
+
+// Pass one prepared sk_buff to Linux.
+void
+ToHost::deliver(struct sk_buff *skb)
+{
     // get protocol to pass to Linux
     int protocol = (_sniffers ? 0xFFFF : skb->protocol);
 
@@ -280,6 +355,52 @@ ToHost::push(int port, Packet *p)
 #endif
 }
 
+void
+ToHost::push_batch(int port, PacketBatch &batch)
+{
+#if HAVE_LINUX_GRO_CELLS
+    if (_gro_cells) {
+	// One bottom-half section for the whole batch; the GRO cells hand
+	// coalesced packets to the stack from their NAPI poll.
+	local_bh_disable();
+	while (Packet *p = batch.pop_front())
+	    if (struct sk_buff *skb = prepare(p)) {
+		if (skb->dev == _gro_dev)
+		    (void) gro_cells_receive(_gro_cells, skb);
+		else
+		    deliver(skb);
+	    }
+	local_bh_enable();
+	return;
+    }
+#endif
+#if CLICK_TOHOST_SKB_LIST
+    LIST_HEAD(list);
+    bool any = false;
+    while (Packet *p = batch.pop_front())
+	if (struct sk_buff *skb = prepare(p)) {
+	    // As in push(), sniffers see packets addressed elsewhere.
+	    if (_sniffers)
+		skb->pkt_type = PACKET_OTHERHOST;
+	    list_add_tail(&skb->list, &list);
+	    any = true;
+	}
+    if (!any)
+	return;
+    // Disabling bottom halves keeps the packets' devices alive during
+    // delivery, as in a driver's receive path.  Every sk_buff received on
+    // this CPU meanwhile is one of ours, so FromDevice must not take it.
+    local_bh_disable();
+    __get_cpu_var(click_device_unreceivable_sk_buff) = CLICK_DEVICE_UNRECEIVABLE_ALL;
+    netif_receive_skb_list(&list);
+    __get_cpu_var(click_device_unreceivable_sk_buff) = 0;
+    local_bh_enable();
+#else
+    while (Packet *p = batch.pop_front())
+	push(port, p);
+#endif
+}
+
 void
 ToHost::add_handlers()
 {
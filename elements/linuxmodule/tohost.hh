@@ -2,6 +2,7 @@
 #ifndef CLICK_TOHOST_HH
 #define CLICK_TOHOST_HH
 #include "elements/linuxmodule/anydevice.hh"
+struct gro_cells;
 
 /*
  * =c
@@ -43,6 +44,14 @@
  *
  * Type of interface.  Choices are ETHER and IP.  Default is ETHER.
  *
+ * =item GRO
+ *
+ * Boolean.  If true, then pass packets through generic receive offload,
+ * which coalesces TCP segments of the same flow before the stack sees them.
+ * Requires DEVNAME and a kernel with gro_cells; ToHost holds a reference to
+ * the device until the router is uninstalled.  Not allowed with SNIFFERS or
+ * ALLOW_NONEXISTENT.  Default is false.
+ *
  * =item QUIET
  *
  * Boolean.  If true, then suppress device up/down messages.  Default is false.
@@ -88,6 +97,15 @@
  * to DEVNAME, and a routable source address. Otherwise Linux will silently
  * drop the packets.
  *
+ * On kernels with netif_receive_skb_list and without Click's patches, ToHost
+ * passes each packet batch it receives to Linux as one list, so the stack
+ * can process the burst together.  Packets pushed one at a time, and
+ * packets on patched kernels, are passed individually.  With GRO, packets
+ * are passed through the device's GRO cells instead, which deliver them to
+ * the stack in lists from a NAPI context; do not use GRO for a device that a
+ * FromDevice or PollDevice reads, since those elements would receive the
+ * coalesced packets.
+ *
  * =head2 Patchless Installations
  *
  * On patched installations, FromDevice intercepts packets before they are
@@ -130,12 +148,21 @@ class ToHost : public AnyDevice { public:
     void add_handlers();
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
   private:
 
     bool _sniffers;
+    bool _gro;
     int _drops;
     int _type;
+#if HAVE_LINUX_GRO_CELLS
+    struct gro_cells *_gro_cells;
+    net_device *_gro_dev;
+#endif
+
+    inline struct sk_buff *prepare(Packet *p);
+    void deliver(struct sk_buff *skb);
 
     friend class ToHostSniffers;
 
@@ -122,6 +122,7 @@ public:
     static void static_cleanup();
 
     const char *class_name() const      { return "ToUserDevice"; }
+    const char *flags() const           { return _encap_type == type_encap_pcap ? "T" : ""; }
     const char *port_count() const      { return PORTS_1_0; }
     const char *processing() const      { return PUSH; }
 
@@ -1,17 +1,11 @@
 #ifndef CLICK_DUPPATH_HH
 #define CLICK_DUPPATH_HH
 #include <click/element.hh>
+#include <click/packetring.hh>
 CLICK_DECLS
 
 class DupPath : public Element {
-  struct {
-    Packet **_q;
-    unsigned _head;
-    unsigned _tail;
-  } _q;
-
-  int next_i(int i) const { return (i!=128 ? i+1 : 0); }
-  Packet *deq();
+  PacketRing _q;
 
  public:
 
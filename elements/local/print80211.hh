@@ -37,6 +37,7 @@ class Print80211 : public Element { public:
   ~Print80211();
 
   const char *class_name() const		{ return "Print80211"; }
+  const char *flags() const			{ return _timestamp ? "T" : ""; }
   const char *port_count() const		{ return PORTS_1_1; }
 
   int configure(Vector<String> &, ErrorHandler *);
@@ -48,6 +48,7 @@ class PrintAiro : public Element { public:
   ~PrintAiro();
 
   const char *class_name() const		{ return "PrintAiro"; }
+  const char *flags() const			{ return _timestamp ? "T" : ""; }
   const char *port_count() const		{ return PORTS_1_1; }
 
   int configure(Vector<String> &, ErrorHandler *);
@@ -1,5 +1,6 @@
+// -*- c-basic-offset: 4 -*-
 /*
- * WebGen.{cc,hh} -- toy TCP implementation
+ * webgen.{cc,hh} -- stateful HTTP client load generator
  * Robert Morris
  *
  * Copyright (c) 1999-2001 Massachusetts Institute of Technology
@@ -17,30 +18,26 @@
 
 #include <click/config.h>
 #include "webgen.hh"
-#include <clicknet/tcp.h>
-#include <clicknet/ip.h>
-#include <click/ipaddress.hh>
 #include <click/args.hh>
 #include <click/error.hh>
-#include <click/glue.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/straccum.hh>
+#include <click/standard/scheduleinfo.hh>
+#if HAVE_FLOAT_TYPES
+# include <math.h>
+#endif
 CLICK_DECLS
 
-static int
-timestamp_diff(const Timestamp &t1, const Timestamp &t2)
+static inline bool
+seq_lt(uint32_t a, uint32_t b)
 {
-    return (t1.sec() - t2.sec()) * 1000000 + (t1.usec() - t2.usec());
+    return (int32_t) (a - b) < 0;
 }
 
 WebGen::WebGen()
-  : _timer(this)
+    : _shards(0)
 {
-
-  cbfree = NULL;
-  rexmit_head = NULL;
-  rexmit_tail = NULL;
-
-  memset (cbhash, 0, sizeof (cbhash));
-  memset (&perfcnt, 0, sizeof (perfcnt));
 }
 
 WebGen::~WebGen()
@@ -48,504 +45,673 @@ WebGen::~WebGen()
 }
 
 int
-WebGen::configure (Vector<String> &conf, ErrorHandler *errh)
+WebGen::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-  int ret;
-  int cps;
-
-  ret = Args(conf, this, errh)
-      .read_mp("PREFIX", IPPrefixArg(true), _src_prefix, _mask)
-      .read_mp("DST", _dst)
-      .read_mp("RATE", cps)
-      .complete();
-
-  start_interval = 1000000 / cps;
-  return ret;
+    IPAddress prefix, mask;
+    uint16_t dport = 80;
+    String arrival = "fixed";
+    Timestamp think, resend = Timestamp(1, 0);
+    int nconns = -1;
+    Vector<String> requests;
+    _resend_max = 5;
+    _burst = 256;
+    _nshards = master()->nthreads();
+    _stats_interval = Timestamp(5, 0);
+    if (Args(conf, this, errh)
+	.read_mp("PREFIX", IPPrefixArg(true), prefix, mask)
+	.read_mp("DST", _dst)
+	.read_mp("RATE", _rate)
+	.read("DPORT", IPPortArg(IP_PROTO_TCP), dport)
+	.read("ARRIVAL", WordArg(), arrival)
+	.read("THINK", think)
+	.read_all_with("REQUEST", AnyArg(), requests)
+	.read("CONNECTIONS", nconns)
+	.read("THREADS", _nshards)
+	.read("RESEND", resend)
+	.read("RESEND_MAX", _resend_max)
+	.read("BURST", _burst)
+	.read("STATS", _stats_interval)
+	.complete() < 0)
+	return -1;
+
+    if (_rate == 0)
+	return errh->error("RATE must be positive");
+    if (arrival == "fixed")
+	_poisson = false;
+#if HAVE_FLOAT_TYPES
+    else if (arrival == "poisson")
+	_poisson = true;
+#endif
+    else
+	return errh->error("bad ARRIVAL");
+    if (think < Timestamp() || resend <= Timestamp())
+	return errh->error("THINK must be nonnegative and RESEND positive");
+    if (_resend_max > 255)
+	return errh->error("RESEND_MAX must be at most 255");
+    if (_burst < 1)
+	return errh->error("BURST must be positive");
+    if (_nshards < 1 || _nshards > NPORTS)
+	return errh->error("THREADS must be between 1 and %d", NPORTS);
+
+    _src_prefix = prefix.addr() & mask.addr();
+    _mask = mask.addr();
+    _dport = htons(dport);
+    _think_ticks = think.msecval();
+    _resend_ticks = resend.msecval() ? resend.msecval() : 1;
+    _gap = (int64_t) 1000000000 * _nshards / _rate;
+
+    // Enough for RATE connections per second that think, then retransmit
+    // until they time out.
+    uint64_t lifetime = _think_ticks + (uint64_t) _resend_ticks * (_resend_max + 1);
+    uint64_t want = (uint64_t) _rate * lifetime / 1000 + 1;
+    if (nconns < 0)
+	nconns = want < 1024 ? 1024 : (want > 0x7FFFFFFF ? 0x7FFFFFFF : want);
+    uint64_t ntuples = ((uint64_t) ~ntohl(_mask) + 1) * NPORTS;
+    if (nconns < _nshards || (uint64_t) nconns > ntuples)
+	return errh->error("CONNECTIONS must be between THREADS and the number of source address and port pairs, %llu", (unsigned long long) ntuples);
+    _nconns = nconns;
+
+    for (int i = 0; i < requests.size(); ++i)
+	if (!StringArg::parse(requests[i], requests[i]))
+	    return errh->error("REQUEST %d should be a string", i + 1);
+    if (!requests.size()) {
+	// SPECweb-style file sets: directory, class, and file numbers
+	for (int dir = 0; dir < 10; ++dir)
+	    for (int c = 0; c < 3; ++c)
+		for (int file = 0; file < 9; ++file) {
+		    StringAccum sa;
+		    sa << "GET /spec/" << dir << '/' << dir << '-' << c << '-'
+		       << file << " HTTP/1.0\r\n\r\n";
+		    requests.push_back(sa.take_string());
+		}
+    }
+    if (requests.size() > 0x10000)
+	return errh->error("too many REQUESTs");
+    _requests.clear();
+    for (int i = 0; i < requests.size(); ++i) {
+	if (!requests[i].length() || requests[i].length() > 1460)
+	    return errh->error("REQUEST %d must be between 1 and 1460 bytes", i + 1);
+	Request r;
+	r.data = requests[i];
+	r.sum = click_in_cksum(reinterpret_cast<const unsigned char *>(r.data.data()), r.data.length());
+	_requests.push_back(r);
+    }
+    return 0;
 }
 
-IPAddress
-WebGen::pick_src ()
+int
+WebGen::initialize(ErrorHandler *errh)
 {
-  uint32_t x;
-  uint32_t mask = (uint32_t) _mask;
-
-  x = (click_random() & ~mask) | ((uint32_t) _src_prefix & mask);
+    memset(&_header, 0, sizeof(_header));
+    _header.ip.ip_v = 4;
+    _header.ip.ip_hl = sizeof(click_ip) >> 2;
+    _header.ip.ip_ttl = 250;
+    _header.ip.ip_p = IP_PROTO_TCP;
+    _header.ip.ip_dst = _dst;
+    _header.tcp.th_dport = _dport;
+    _header.tcp.th_off = sizeof(click_tcp) >> 2;
+    _header.tcp.th_win = htons(60 * 1024);
+
+    _headroom = 34;
+    uint32_t need = router()->headroom_required(this);
+    if (need > _headroom)
+	_headroom += (need - _headroom + 3) & ~3;
+
+    if (!(_shards = new Shard[_nshards]()))
+	return errh->error("out of memory");
+
+    _epoch = Timestamp::now_steady();
+    int home = router()->home_thread_id(this);
+    int nthreads = master()->nthreads();
+    for (int si = 0; si < _nshards; ++si) {
+	Shard &s = _shards[si];
+	s.nconns = (_nconns + _nshards - 1 - si) / _nshards;
+	s.nports = (NPORTS + _nshards - 1 - si) / _nshards;
+	int nbuckets = 2;
+	for (s.bucket_shift = 31; (uint32_t) nbuckets < s.nconns; --s.bucket_shift)
+	    nbuckets <<= 1;
+	s.conns = new Conn[s.nconns];
+	s.buckets = new uint32_t[nbuckets];
+	s.wheel = new uint32_t[WHEEL_SLOTS];
+	if (!s.conns || !s.buckets || !s.wheel)
+	    return errh->error("out of memory for %u connections", _nconns);
+	memset(s.buckets, 0xFF, sizeof(uint32_t) * nbuckets);
+	memset(s.wheel, 0xFF, sizeof(uint32_t) * WHEEL_SLOTS);
+	for (uint32_t i = 0; i < s.nconns; ++i) {
+	    s.conns[i].state = S_FREE;
+	    s.conns[i].hnext = i + 1 < s.nconns ? i + 1 : NIL;
+	}
+	s.free = 0;
+	s.next_arrival = _poisson ? arrival_gap() : _gap * si / _nshards;
+
+	// Give each shard its own thread, like FromDevice's QUEUES.
+	s.task = new Task(this);
+	s.timer = new Timer(s.task);
+	if (!s.task || !s.timer)
+	    return errh->error("out of memory");
+	ScheduleInfo::initialize_task(this, s.task, true, errh);
+	s.task->set_stealable(false);
+	if (home >= 0)
+	    s.task->move_thread((home + si) % nthreads);
+	s.timer->initialize(this);
+    }
 
-  return IPAddress (x);
+    memset(_stats_last, 0, sizeof(_stats_last));
+    _stats_next = _epoch + _stats_interval;
+    return 0;
 }
 
-int
-WebGen::connhash (unsigned src, unsigned short sport)
+void
+WebGen::cleanup(CleanupStage stage)
 {
-  return (src ^ sport) & htmask;
+    if (stage >= CLEANUP_INITIALIZED && _stats_interval)
+	do_perf_stats();
+    if (_shards)
+	for (int si = 0; si < _nshards; ++si) {
+	    Shard &s = _shards[si];
+	    delete s.timer;
+	    delete s.task;
+	    delete[] s.conns;
+	    delete[] s.buckets;
+	    delete[] s.wheel;
+	}
+    delete[] _shards;
+    _shards = 0;
 }
 
-int
-WebGen::initialize (ErrorHandler *)
+inline uint32_t
+WebGen::now_tick(int64_t now) const
 {
-  _timer.initialize (this);
-  _timer.schedule_now ();
-
-  int ncbs = 2 * (resend_dt / start_interval) * resend_max;
-  for (int i = 0; i < ncbs; i++) {
-    CB *cb = new CB;
-    if (!cb) {
-      click_chatter ("Not enough memory for CBs\n");
-      return ENOMEM;
-    }
-    cb->add_to_list (&cbfree);
-  }
-  click_chatter ("Allocated %d CBs\n", ncbs);
-
-  Timestamp now = Timestamp::now();
-  perf_tv = now;
-  start_tv = now;
-
-  rexmit_head = new CB;
-  rexmit_tail = new CB;
-  if (!rexmit_head || !rexmit_tail) {
-    click_chatter ("Not enough memory for dummy elements\n");
-    return ENOMEM;
-  }
-  rexmit_head->rexmit_next = rexmit_tail;
-  rexmit_head->rexmit_prev = NULL;
-  rexmit_tail->rexmit_next = NULL;
-  rexmit_tail->rexmit_prev = rexmit_head;
-
-  return 0;
+    return now / 1000000;
 }
 
-void
-WebGen::cleanup (CleanupStage stage)
+inline int64_t
+WebGen::arrival_gap() const
 {
-  int i = 0;
-  CB *c = cbfree;
-
-  do {
-    while (c) {
-      CB *tc = c;
-      c = tc->next;
-      delete tc;
+#if HAVE_FLOAT_TYPES
+    if (_poisson) {
+	double u = (click_random() + 1.0) / (CLICK_RAND_MAX + 1.0);
+	return (int64_t) (-log(u) * _gap);
     }
+#endif
+    return _gap;
+}
 
-    c = cbhash[i++];
-  } while (i <= htsize);
-
-  delete rexmit_head;
-  delete rexmit_tail;
+inline uint32_t
+WebGen::find(Shard &s, uint32_t src, uint16_t sport) const
+{
+    uint32_t h = ((src ^ (sport * 0x10001U)) * 0x9E3779B1U) >> s.bucket_shift;
+    uint32_t i = s.buckets[h];
+    while (i != NIL && (s.conns[i].src != src || s.conns[i].sport != sport))
+	i = s.conns[i].hnext;
+    return i;
+}
 
-  if (stage >= CLEANUP_INITIALIZED)
-    do_perf_stats ();
+inline void
+WebGen::wheel_insert(Shard &s, uint32_t i, uint32_t tick)
+{
+    Conn &c = s.conns[i];
+    uint32_t &head = s.wheel[tick & WHEEL_MASK];
+    c.expiry = tick;
+    c.wprev = NIL;
+    c.wnext = head;
+    if (head != NIL)
+	s.conns[head].wprev = i;
+    head = i;
 }
 
-void
-WebGen::recycle (CB *cb)
+inline void
+WebGen::wheel_remove(Shard &s, uint32_t i)
 {
-  cb->rexmit_unlink ();
-  cb->remove_from_list ();
-  cb->add_to_list (&cbfree);
+    Conn &c = s.conns[i];
+    if (c.wprev == NIL)
+	s.wheel[c.expiry & WHEEL_MASK] = c.wnext;
+    else
+	s.conns[c.wprev].wnext = c.wnext;
+    if (c.wnext != NIL)
+	s.conns[c.wnext].wprev = c.wprev;
 }
 
 void
-WebGen::do_perf_stats ()
+WebGen::recycle(Shard &s, uint32_t i)
 {
-  Timestamp now = Timestamp::now();
-
-  //double td = ((double) perf_diff) / 1000000.0;
-  //double ips = perfcnt.initiated / td;
-  //double cps = perfcnt.completed / td;
-  //double tps = perfcnt.timeout / td;
-  //double rps = perfcnt.reset / td;
-  //click_chatter ("Init: %5d  Comp: %5d  Tmo: %5d  RST: %5d\n",
-  //               (int) ips, (int) cps, (int) tps, (int) rps);
-  click_chatter ("init: %d  comp: %5d  tmo: %5d  rst: %5d\n",
-                 perfcnt.initiated, perfcnt.completed,
-                 perfcnt.timeout, perfcnt.reset);
-  perf_tv = now;
-  memset (&perfcnt, 0, sizeof (perfcnt));
+    Conn &c = s.conns[i];
+    wheel_remove(s, i);
+    uint32_t h = ((c.src ^ (c.sport * 0x10001U)) * 0x9E3779B1U) >> s.bucket_shift;
+    uint32_t *pprev = &s.buckets[h];
+    while (*pprev != i)
+	pprev = &s.conns[*pprev].hnext;
+    *pprev = c.hnext;
+    c.state = S_FREE;
+    c.hnext = s.free;
+    s.free = i;
+    --s.nactive;
 }
 
 void
-WebGen::run_timer (Timer *)
+WebGen::start_connection(Shard &s, int si, uint32_t tick, PacketBatch &out)
 {
-  CB *cb;
-  Timestamp now = Timestamp::now();
-
-  while (timestamp_diff(now, start_tv) > start_interval) {
-    start_tv += Timestamp::make_usec(start_interval);
-    cb = cbfree;
-
-    if (cb) {
-      cb->remove_from_list ();
-      cb->reset (pick_src ());
+    if (s.free == NIL) {
+	++s.overflows;
+	return;
+    }
 
-      int hv = connhash (cb->_src, cb->_sport);
-      cb->add_to_list (&cbhash[hv]);
-      tcp_send(cb, 0);
-      perfcnt.initiated++;
-    } else {
-      click_chatter ("out of available CBs\n");
+    // Walk the shard's source address and port pairs, skipping any still in
+    // use.  Addresses vary fastest, spreading load over the prefix.
+    uint64_t nhosts = (uint64_t) ~ntohl(_mask) + 1;
+    uint32_t src = 0, port = 0;
+    int tries;
+    for (tries = 0; tries < 8; ++tries) {
+	uint64_t t = s.tuple++;
+	src = _src_prefix | htonl(t % nhosts);
+	port = FIRST_PORT + si + ((t / nhosts) % s.nports) * _nshards;
+	if (find(s, src, htons(port)) == NIL)
+	    break;
     }
-  }
-
-  CB *lrxcb = rexmit_tail->rexmit_prev;
-  do {
-    cb = rexmit_head->rexmit_next;
-
-    if (cb == rexmit_tail)
-      break;
-
-    if (timestamp_diff(now, cb->last_send) > resend_dt) {
-      if (cb->_resends++ > resend_max) {
-	perfcnt.timeout++;
-	recycle (cb);
-      } else {
-	tcp_send (cb, 0);
-      }
-    } else {
-      break;
+    if (tries == 8) {
+	++s.overflows;
+	return;
     }
-  } while (cb != lrxcb);
-
-  if (timestamp_diff(now, perf_tv) > perf_dt)
-    do_perf_stats ();
 
-  _timer.schedule_after_msec(1);
+    uint32_t i = s.free;
+    Conn &c = s.conns[i];
+    s.free = c.hnext;
+    c.src = src;
+    c.sport = htons(port);
+    uint32_t h = ((c.src ^ (c.sport * 0x10001U)) * 0x9E3779B1U) >> s.bucket_shift;
+    c.hnext = s.buckets[h];
+    s.buckets[h] = i;
+
+    c.state = S_SYN_SENT;
+    c.resends = 0;
+    c.iss = click_random() & 0x0FFFFFFF;
+    c.snd_una = c.iss;
+    c.rcv_nxt = 0;
+    c.got_fin = 0;
+    c.request = _requests.size() > 1 ? click_random(0, _requests.size() - 1) : 0;
+    wheel_insert(s, i, tick + _resend_ticks);
+    ++s.nactive;
+    ++s.initiated;
+    send(s, c, 0, out);
 }
 
-WebGen::CB *
-WebGen::find_cb (unsigned src, unsigned short sport, unsigned short dport)
+// A connection's wheel slot came due.
+void
+WebGen::expire(Shard &s, uint32_t i, uint32_t tick, PacketBatch &out)
 {
-  int hv = connhash (src, sport);
-  CB *cb = cbhash[hv];
-
-  while (cb) {
-    if (sport == cb->_sport &&
-	dport == cb->_dport &&
-	src == (uint32_t) cb->_src)
-      return cb;
-    cb = cb->next;
-  }
-  return NULL;
+    Conn &c = s.conns[i];
+    wheel_remove(s, i);
+    if (c.state == S_THINKING) {
+	c.state = S_REQUEST;
+	c.resends = 0;
+    } else if (++c.resends > _resend_max) {
+	++s.timeouts;
+	wheel_insert(s, i, tick);
+	recycle(s, i);
+	return;
+    }
+    wheel_insert(s, i, tick + _resend_ticks);
+    // While waiting for the response, the timer only bounds idle time.
+    uint32_t sent = c.iss + _requests[c.request].data.length() + 2;
+    if (c.state != S_REQUEST || seq_lt(c.snd_una, sent))
+	send(s, c, 0, out);
 }
 
-Packet *
-WebGen::simple_action (Packet *p)
+// Expire due connections up to tick, at most budget of them.  Returns the
+// remaining budget.  If budget runs out, the current slot is rescanned next
+// time; expired connections have left it.
+uint32_t
+WebGen::run_wheel(Shard &s, uint32_t tick, uint32_t budget, PacketBatch &out)
 {
-  tcp_input (p);
-  return NULL;
+    if ((int32_t) (tick - s.wheel_tick) >= WHEEL_SLOTS)
+	s.wheel_tick = tick - WHEEL_SLOTS + 1;
+    while ((int32_t) (tick - s.wheel_tick) >= 0) {
+	if (!s.nactive) {
+	    s.wheel_tick = tick + 1;
+	    break;
+	}
+	uint32_t i = s.wheel[s.wheel_tick & WHEEL_MASK];
+	while (i != NIL) {
+	    uint32_t next = s.conns[i].wnext;
+	    if ((int32_t) (s.conns[i].expiry - tick) <= 0) {
+		if (!budget)
+		    return 0;
+		expire(s, i, tick, out);
+		--budget;
+	    }
+	    i = next;
+	}
+	++s.wheel_tick;
+    }
+    return budget;
 }
 
-void
-WebGen::tcp_input (Packet *p)
+bool
+WebGen::run_task(Task *task)
 {
-  unsigned seq, ack;
-  unsigned plen = p->length ();
-
-  if (plen < sizeof(click_ip) + sizeof(click_tcp))
-    return;
-
-  click_ip *ip = (click_ip *) p->data();
-  unsigned iplen = ntohs(ip->ip_len);
-  unsigned hlen = ip->ip_hl << 2;
-  if (hlen < sizeof(click_ip) || hlen > iplen || iplen > plen) {
-    p->kill();
-    return;
-  }
-
-  click_tcp *th = (click_tcp *) (((char *)ip) + hlen);
-  unsigned off = th->th_off << 2;
-  int dlen = iplen - hlen - off;
-
-  CB *cb = find_cb(ip->ip_dst.s_addr, th->th_dport, th->th_sport);
-  if (cb == 0) {
-    unsigned plen = sizeof (click_ip) + sizeof (click_tcp);
-
-    WritablePacket *wp = fixup_packet (p, plen);
-    tcp_output (wp,
-		ip->ip_dst, th->th_dport,
-		ip->ip_src, th->th_sport,
-		th->th_ack, th->th_seq, TH_RST,
-		NULL, 0);
-    return;
-  }
-
-  seq = ntohl(th->th_seq);
-  ack = ntohl(th->th_ack);
-
-  if ((th->th_flags & (TH_ACK|TH_RST)) == TH_ACK &&
-     ack == cb->_iss + 1 &&
-     cb->_connected == 0) {
-    cb->_snd_nxt = cb->_iss + 1;
-    cb->_snd_una = cb->_snd_nxt;
-    cb->_irs = seq;
-    cb->_rcv_nxt = cb->_irs + 1;
-    cb->_connected = 1;
-    cb->_do_send = 1;
-    //click_chatter("WebGen connected %d %d",
-    //              ntohs(cb->_sport),
-    //              ntohs(cb->_dport));
-  } else if (dlen > 0) {
-    cb->_do_send = 1;
-    if (seq + dlen > cb->_rcv_nxt) {
-      //click_chatter("_rcv_nxt %d + %d -> %d\n", cb->_rcv_nxt, dlen, seq+dlen);
-      cb->_rcv_nxt = seq + dlen;
+    int si = 0;
+    while (_shards[si].task != task)
+	++si;
+    Shard &s = _shards[si];
+
+    Timestamp now_ts = Timestamp::now_steady();
+    int64_t now = (now_ts - _epoch).nsecval();
+    uint32_t tick = now_tick(now);
+    PacketBatch out;
+
+    s.lock.acquire();
+    uint32_t budget = run_wheel(s, tick, _burst, out);
+    // After a stall, start over rather than bursting to catch up.
+    if (now - s.next_arrival > 1000000000)
+	s.next_arrival = now;
+    while (budget && s.next_arrival <= now) {
+	start_connection(s, si, tick, out);
+	s.next_arrival += arrival_gap();
+	--budget;
     }
-  }
-
-  if (th->th_flags & TH_ACK) {
-    if (ack > cb->_snd_una) {
-      cb->_snd_una = ack;
+    int64_t wake = s.next_arrival;
+    if (s.nactive && (int64_t) (tick + 1) * 1000000 < wake)
+	wake = (int64_t) (tick + 1) * 1000000;
+    s.lock.release();
+
+    bool worked = !out.empty();
+    if (worked)
+	output(0).push_batch(out);
+
+    if (si == 0 && _stats_interval && now_ts >= _stats_next) {
+	do_perf_stats();
+	_stats_next = now_ts + _stats_interval;
     }
-  }
-
-  if ((th->th_flags & TH_FIN) &&
-      seq + dlen == cb->_rcv_nxt &&
-      cb->_got_fin == 0) {
-    cb->_got_fin = 1;
-    cb->_rcv_nxt += 1;
-    cb->_do_send = 1;
-  }
-
-  if (th->th_flags & TH_RST) {
-    // click_chatter("RST %d %d", ntohs (th->th_sport), ntohs (th->th_dport));
-    p->kill ();
-    recycle (cb);
-    perfcnt.reset++;
-    return;
-  }
-
-  tcp_send (cb, p);
-
-  if (cb->_closed)
-    recycle (cb);
-}
 
-WritablePacket *
-WebGen::fixup_packet (Packet *xp, unsigned plen)
-{
-  unsigned int headroom = 34;
-  WritablePacket *p;
-
-  if (xp == 0 ||
-      xp->shared () ||
-      xp->headroom () < headroom ||
-      xp->length () + xp->tailroom() < plen) {
-    if (xp)
-      xp->kill ();
-    p = Packet::make (headroom, NULL, plen, 0);
-  } else {
-    p = xp->uniqueify ();
-    if (p->length () < plen)
-      p = p->put (plen - p->length ());
-    else if (p->length () > plen)
-      p->take (p->length () - plen);
-  }
-
-  return p;
+    if (!budget || wake - now <= 100000)
+	task->fast_reschedule();
+    else
+	s.timer->schedule_at_steady(_epoch + Timestamp::make_nsec(wake));
+    return worked;
 }
 
-// Send a suitable TCP packet.
-// xp is a candidate packet buffer, to be re-used or freed.
 void
-WebGen::tcp_send (CB *cb, Packet *xp)
+WebGen::push(int, Packet *p)
 {
-  int paylen;
-  unsigned int plen;
-  unsigned int seq;
-  WritablePacket *p = 0;
-
-//click_chatter ("connected %d snd_una %d iss %d sndlen %d\n",
-//	cb->_connected, cb->_snd_una, cb->_iss, cb->sndlen);
-  if (cb->_connected && cb->_snd_una - cb->_iss - 1 < cb->sndlen) {
-    paylen = cb->sndlen;
-    seq = cb->_iss + 1;
-    cb->_snd_nxt = seq + paylen;
-  } else {
-    paylen = 0;
-    seq = cb->_snd_nxt + cb->_sent_fin;
-  }
-  plen = sizeof(click_ip) + sizeof(click_tcp) + paylen;
-
-  cb->rexmit_update (rexmit_tail);
-//click_chatter ("dosend %d paylen %d snd_nxt %d seq %d sfin %d\n", cb->_do_send, paylen, plen, cb->_snd_nxt, seq, cb->_sent_fin);
-  if (cb->_connected == 1 && cb->_do_send == 0 && paylen == 0) {
-    if (xp)
-      xp->kill ();
-    return;
-  }
-  cb->_do_send = 0;
-
-  p = fixup_packet (xp, plen);
-
-  char flags = 0;
-  int ack = 0;
-
-  if (cb->_connected == 0) {
-    flags = TH_SYN;
-  } else {
-    flags = TH_ACK;
-    if (paylen)
-      flags |= TH_PUSH | TH_FIN;
-    if (cb->_got_fin)
-      flags |= TH_FIN;
-    ack = cb->_rcv_nxt;
-  }
-
-  if (flags & TH_FIN)
-    cb->_sent_fin = 1;
-
-  if (cb->_sent_fin && cb->_got_fin) {
-    // Other side has sent the FIN too -- we ack and close.
-    cb->_closed = 1;
-    perfcnt.completed++;
-  }
-
-  tcp_output (p, cb->_src, cb->_sport, _dst, cb->_dport,
-	      htonl (seq), htonl (ack), flags,
-	      cb->sndbuf, paylen);
+    const click_ip *ip = reinterpret_cast<const click_ip *>(p->data());
+    uint32_t plen = p->length();
+    if (plen < sizeof(click_ip) + sizeof(click_tcp)
+	|| ip->ip_p != IP_PROTO_TCP) {
+	p->kill();
+	return;
+    }
+    uint32_t hlen = ip->ip_hl << 2;
+    uint32_t iplen = ntohs(ip->ip_len);
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(p->data() + hlen);
+    if (hlen < sizeof(click_ip) || hlen + sizeof(click_tcp) > iplen
+	|| iplen > plen || hlen + (th->th_off << 2) > iplen) {
+	p->kill();
+	return;
+    }
+
+    uint16_t port = ntohs(th->th_dport);
+    if (port < FIRST_PORT || th->th_sport != _dport) {
+	send_reset(p);
+	return;
+    }
+    Shard &s = _shards[(port - FIRST_PORT) % _nshards];
+    uint32_t tick = now_tick((Timestamp::now_steady() - _epoch).nsecval());
+    PacketBatch out;
+
+    s.lock.acquire();
+    uint32_t i = find(s, ip->ip_dst.s_addr, th->th_dport);
+    if (i != NIL)
+	tcp_input(s, i, p, tick, out);
+    s.lock.release();
+
+    if (i == NIL)
+	send_reset(p);
+    else if (!out.empty())
+	output(0).push_batch(out);
 }
 
 void
-WebGen::tcp_output (WritablePacket *p,
-	IPAddress src, unsigned short sport,
-	IPAddress dst, unsigned short dport,
-	int seq, int ack, char tcpflags,
-	char *payload, int paylen)
+WebGen::tcp_input(Shard &s, uint32_t i, Packet *p, uint32_t tick, PacketBatch &out)
 {
-  unsigned plen = p->length ();
-
-  click_ip *ip = (click_ip *) p->data ();
-  ip->ip_v = 4;
-  ip->ip_hl = sizeof (click_ip) >> 2;
-  ip->ip_id = htons (_id.fetch_and_add (1));
-  ip->ip_p = 6;
-  ip->ip_src = src;
-  ip->ip_dst = dst;
-  ip->ip_tos = 0;
-  ip->ip_off = 0;
-  ip->ip_ttl = 250;
-  p->set_dst_ip_anno (IPAddress (ip->ip_dst));
-  p->set_ip_header (ip, sizeof (click_ip));
-
-  click_tcp *th = (click_tcp *) (ip + 1);
-
-  memset (th, '\0', sizeof(*th));
-
-  if (paylen > 0)
-    memcpy (th + 1, payload, paylen);
-
-  th->th_sport = sport;
-  th->th_dport = dport;
-  th->th_seq = seq;
-  th->th_ack = ack;
-  th->th_off = sizeof (click_tcp) >> 2;
-  th->th_flags = tcpflags;
-  th->th_win = htons (60*1024);
-
-  char itmp[9];
-  memcpy (itmp, ip, 9);
-  memset (ip, '\0', 9);
-  ip->ip_sum = 0;
-  ip->ip_len = htons (plen - 20);
-
-  th->th_sum = 0;
-  th->th_sum = click_in_cksum ((unsigned char *) ip, plen);
-
-  memcpy (ip, itmp, 9);
-  ip->ip_len = htons (plen);
-
-  ip->ip_sum = 0;
-  ip->ip_sum = click_in_cksum ((unsigned char *) ip, sizeof (click_ip));
-
-  output (0).push (p);
-}
+    Conn &c = s.conns[i];
+    const click_ip *ip = reinterpret_cast<const click_ip *>(p->data());
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(p->data() + (ip->ip_hl << 2));
+    uint32_t seq = ntohl(th->th_seq);
+    uint32_t ack = ntohl(th->th_ack);
+    uint8_t flags = th->th_flags;
+    uint32_t dlen = ntohs(ip->ip_len) - (ip->ip_hl << 2) - (th->th_off << 2);
+
+    if (flags & TH_RST) {
+	++s.resets;
+	recycle(s, i);
+	p->kill();
+	return;
+    }
 
-WebGen::CB::CB ()
-{
-  next = NULL;
-  pprev = NULL;
+    if (c.state == S_SYN_SENT) {
+	if ((flags & (TH_SYN | TH_ACK)) != (TH_SYN | TH_ACK) || ack != c.iss + 1) {
+	    p->kill();
+	    return;
+	}
+	c.snd_una = ack;
+	c.rcv_nxt = seq + 1;
+	c.resends = 0;
+	wheel_remove(s, i);
+	if (_think_ticks) {
+	    c.state = S_THINKING;
+	    wheel_insert(s, i, tick + _think_ticks);
+	} else {
+	    c.state = S_REQUEST;
+	    wheel_insert(s, i, tick + _resend_ticks);
+	}
+	send(s, c, p, out);
+	return;
+    } else if (c.state == S_THINKING) {
+	// Our handshake ACK was lost if the SYN-ACK comes again.
+	if (flags & TH_SYN)
+	    send(s, c, p, out);
+	else
+	    p->kill();
+	return;
+    }
 
-  rexmit_next = NULL;
-  rexmit_prev = NULL;
+    uint32_t sent = c.iss + _requests[c.request].data.length() + 2;
+    bool progress = false;
+    if ((flags & TH_ACK) && seq_lt(c.snd_una, ack) && !seq_lt(sent, ack)) {
+	c.snd_una = ack;
+	progress = true;
+    }
+    if (dlen && seq == c.rcv_nxt) {
+	c.rcv_nxt += dlen;
+	progress = true;
+    }
+    if ((flags & TH_FIN) && seq + dlen == c.rcv_nxt && !c.got_fin) {
+	c.got_fin = 1;
+	c.rcv_nxt += 1;
+	progress = true;
+    }
+    if (progress) {
+	c.resends = 0;
+	wheel_remove(s, i);
+	wheel_insert(s, i, tick + _resend_ticks);
+    }
 
-  last_send.assign_now();
+    bool closed = c.got_fin && c.snd_una == sent;
+    if (dlen || (flags & TH_FIN))
+	send(s, c, p, out);
+    else
+	p->kill();
+    if (closed) {
+	++s.completed;
+	recycle(s, i);
+    }
 }
 
+// Sends the segment the connection's state calls for: a SYN, the request
+// with a FIN, or an ACK.  xp is a buffer to reuse or free.
 void
-WebGen::CB::reset (IPAddress src)
+WebGen::send(Shard &s, Conn &c, Packet *xp, PacketBatch &out)
 {
-  _src = src;
-  _dport = htons (80);
-  _iss = click_random() & 0x0fffffff;
-  _irs = 0;
-  _snd_nxt = _iss;
-  _snd_una = _iss;
-  _sport = htons (1024 + (click_random() % 60000));
-  _do_send = 0;
-  _connected = 0;
-  _got_fin = 0;
-  _sent_fin = 0;
-  _closed = 0;
-  _resends = 0;
-
-  int dir = click_random(0, 9);
-  int file = click_random(0, 8);	// 0 .. 8 exist
-  int c = click_random(0, 2);		// 0 .. 3 exist
-  sprintf (sndbuf, "GET /spec/%d/%d-%d-%d HTTP/1.0\r\n\r\n",
-           dir, dir, c, file);
-  sndlen = strlen (sndbuf);
+    const Request *req = 0;
+    uint32_t seq, ack = 0;
+    uint8_t flags;
+    if (c.state == S_SYN_SENT) {
+	seq = c.iss;
+	flags = TH_SYN;
+    } else {
+	const Request &r = _requests[c.request];
+	ack = c.rcv_nxt;
+	flags = TH_ACK;
+	if (c.state == S_THINKING)
+	    seq = c.iss + 1;
+	else if (seq_lt(c.snd_una, c.iss + r.data.length() + 2)) {
+	    seq = c.iss + 1;
+	    flags |= TH_PUSH | TH_FIN;
+	    req = &r;
+	} else
+	    seq = c.iss + r.data.length() + 2;
+    }
+    if (WritablePacket *p = make_packet(xp, c.src, c.sport, _dst.addr(), _dport,
+					seq, ack, flags, req, s.ip_id++))
+	out.push_back(p);
 }
 
 void
-WebGen::CB::remove_from_list ()
+WebGen::send_reset(Packet *p)
 {
-  if (next)
-    next->pprev = pprev;
-  if (pprev)
-    *pprev = next;
+    const click_ip *ip = reinterpret_cast<const click_ip *>(p->data());
+    const click_tcp *th = reinterpret_cast<const click_tcp *>(p->data() + (ip->ip_hl << 2));
+    if (th->th_flags & TH_RST) {
+	p->kill();
+	return;
+    }
+    uint32_t src = ip->ip_dst.s_addr, dst = ip->ip_src.s_addr;
+    uint16_t sport = th->th_dport, dport = th->th_sport;
+    uint32_t seq = 0, ack = 0;
+    uint8_t flags = TH_RST;
+    if (th->th_flags & TH_ACK)
+	seq = ntohl(th->th_ack);
+    else {
+	ack = ntohl(th->th_seq) + ntohs(ip->ip_len) - (ip->ip_hl << 2) - (th->th_off << 2)
+	    + ((th->th_flags & TH_SYN) != 0) + ((th->th_flags & TH_FIN) != 0);
+	flags |= TH_ACK;
+    }
+    if (WritablePacket *q = make_packet(p, src, sport, dst, dport, seq, ack, flags, 0, 0))
+	output(0).push(q);
+}
 
-  next = NULL;
-  pprev = NULL;
+WritablePacket *
+WebGen::fixup_packet(Packet *xp, uint32_t plen)
+{
+    if (!xp || xp->shared() || xp->headroom() < _headroom
+	|| xp->length() + xp->tailroom() < plen) {
+	if (xp)
+	    xp->kill();
+	return Packet::make(_headroom, 0, plen, 0);
+    }
+    WritablePacket *p = xp->uniqueify();
+    if (p->length() < plen)
+	p = p->put(plen - p->length());
+    else if (p->length() > plen)
+	p->take(p->length() - plen);
+    return p;
 }
 
-void
-WebGen::CB::add_to_list (CB **phead)
+// Builds a segment from the template header.  Fields are in network byte
+// order except seq and ack.  The request's checksum was computed in
+// configure(), so only the headers are summed here.
+WritablePacket *
+WebGen::make_packet(Packet *xp, uint32_t src, uint16_t sport,
+		    uint32_t dst, uint16_t dport,
+		    uint32_t seq, uint32_t ack, uint8_t flags,
+		    const Request *req, uint16_t ip_id)
 {
-  assert (!next && !pprev);
+    uint32_t paylen = req ? req->data.length() : 0;
+    uint32_t plen = sizeof(_header) + paylen;
+    WritablePacket *p = fixup_packet(xp, plen);
+    if (!p)
+	return 0;
+
+    memcpy(p->data(), &_header, sizeof(_header));
+    click_ip *ip = reinterpret_cast<click_ip *>(p->data());
+    ip->ip_len = htons(plen);
+    ip->ip_id = htons(ip_id);
+    ip->ip_src.s_addr = src;
+    ip->ip_dst.s_addr = dst;
+    ip->ip_sum = click_in_cksum(reinterpret_cast<unsigned char *>(ip), sizeof(click_ip));
+
+    click_tcp *th = reinterpret_cast<click_tcp *>(ip + 1);
+    th->th_sport = sport;
+    th->th_dport = dport;
+    th->th_seq = htonl(seq);
+    th->th_ack = htonl(ack);
+    th->th_flags = flags;
+    uint16_t sum = click_in_cksum(reinterpret_cast<unsigned char *>(th), sizeof(click_tcp));
+    if (paylen) {
+	memcpy(th + 1, req->data.data(), paylen);
+	sum = click_in_cksum_combine(sum, req->sum);
+    }
+    th->th_sum = click_in_cksum_pseudohdr(sum, ip, sizeof(click_tcp) + paylen);
 
-  next = *phead;
-  if (next)
-    next->pprev = &next;
+    p->set_dst_ip_anno(IPAddress(dst));
+    p->set_ip_header(ip, sizeof(click_ip));
+    return p;
+}
 
-  pprev = phead;
-  *phead = this;
+uint64_t
+WebGen::stat(int which) const
+{
+    uint64_t x = 0;
+    for (int si = 0; si < _nshards; ++si) {
+	const Shard &s = _shards[si];
+	switch (which) {
+	case h_active:		x += s.nactive; break;
+	case h_initiated:	x += s.initiated; break;
+	case h_completed:	x += s.completed; break;
+	case h_timeouts:	x += s.timeouts; break;
+	case h_resets:		x += s.resets; break;
+	case h_overflows:	x += s.overflows; break;
+	}
+    }
+    return x;
 }
 
 void
-WebGen::CB::rexmit_unlink ()
+WebGen::do_perf_stats()
 {
-  if (rexmit_next)
-    rexmit_next->rexmit_prev = rexmit_prev;
-  if (rexmit_prev)
-    rexmit_prev->rexmit_next = rexmit_next;
+    if (!_shards)
+	return;
+    uint64_t x[4];
+    for (int k = 0; k < 4; ++k) {
+	x[k] = stat(h_initiated + k);
+	uint64_t delta = x[k] - _stats_last[k];
+	_stats_last[k] = x[k];
+	x[k] = delta;
+    }
+    click_chatter("init: %llu  comp: %5llu  tmo: %5llu  rst: %5llu  active: %llu",
+		  (unsigned long long) x[0], (unsigned long long) x[1],
+		  (unsigned long long) x[2], (unsigned long long) x[3],
+		  (unsigned long long) stat(h_active));
+}
 
-  rexmit_next = NULL;
-  rexmit_prev = NULL;
+String
+WebGen::read_handler(Element *e, void *user_data)
+{
+    WebGen *wg = static_cast<WebGen *>(e);
+    if (!wg->_shards)
+	return String(0);
+    return String(wg->stat((intptr_t) user_data));
 }
 
 void
-WebGen::CB::rexmit_update (CB *tail)
+WebGen::add_handlers()
 {
-  last_send.assign_now();
-
-  rexmit_unlink ();
-
-  rexmit_next = tail;
-  rexmit_prev = tail->rexmit_prev;
-
-  rexmit_prev->rexmit_next = this;
-  rexmit_next->rexmit_prev = this;
+    add_read_handler("active", read_handler, h_active);
+    add_read_handler("initiated", read_handler, h_initiated);
+    add_read_handler("completed", read_handler, h_completed);
+    add_read_handler("timeouts", read_handler, h_timeouts);
+    add_read_handler("resets", read_handler, h_resets);
+    add_read_handler("overflows", read_handler, h_overflows);
 }
 
 CLICK_ENDDECLS
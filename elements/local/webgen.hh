@@ -1,134 +1,291 @@
+// -*- c-basic-offset: 4 -*-
 #ifndef CLICK_WEBGEN_HH
 #define CLICK_WEBGEN_HH
 #include <click/element.hh>
 #include <click/glue.hh>
+#include <click/task.hh>
 #include <click/timer.hh>
+#include <click/sync.hh>
 #include <click/ipaddress.hh>
+#include <click/packetbatch.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
 CLICK_DECLS
 
 /*
- * =c
- * WebGen(PREFIX, DST, RATE)
- * =s app
- * =d
- * Ask for a random web pages over and over with repeated HTTP
- * connections. Generate them with random source IP addresses
- * starting with PREFIX, and destination address DST.
- * =e
- * kt :: KernelTap(11.11.0.0/16);
- * kt -> Strip(14)
- *    -> WebGen(11.11.0.0/16, 10.0.0.1)
- *    -> EtherEncap(0x0800, 1:1:1:1:1:1, 2:2:2:2:2:2)
- *    -> kt;
- */
-
-class WebGen : public Element {
- public:
-
-  WebGen();
-  ~WebGen();
-
-  const char *class_name() const		{ return "WebGen"; }
-  const char *port_count() const		{ return PORTS_1_1; }
-  const char *processing() const		{ return PUSH; }
-  int initialize(ErrorHandler *);
-  void cleanup(CleanupStage);
-  int configure(Vector<String> &conf, ErrorHandler *errh);
-
-  Packet *simple_action(Packet *);
-  void run_timer(Timer *);
-
-private:
-  Timer _timer;
-  IPAddress _src_prefix;
-  IPAddress _mask;
-  IPAddress _dst;
-  atomic_uint32_t _id;
-
-  // TCP Control Block
-  class CB {
-  public:
-    CB();
-
-    IPAddress _src;		// Our IP address.
-    unsigned short _sport;	// network byte order.
-    unsigned short _dport;
-
-    unsigned _iss;
-    unsigned _snd_una;
-    unsigned _snd_nxt;
-    unsigned _irs;
-    unsigned _rcv_nxt;
-
-    unsigned char
-	_connected:1,		// Got SYN+ACK
-	_got_fin:1,		// Got FIN
-	_sent_fin:1,		// Sent FIN
-	_closed:1,		// Got ACK for our FIN
-	_do_send:1,
-	_spare_bits:3;
-    char _resends;
-
-    Timestamp last_send;
-    char sndbuf[64];
-    unsigned sndlen;
-
-    void reset (IPAddress src);
-
-    void remove_from_list ();
-    void add_to_list (CB **phead);
-
-    void rexmit_unlink ();
-    void rexmit_update (CB *tail);
-
-    CB *next;
-    CB **pprev;
-
-    CB *rexmit_next;
-    CB *rexmit_prev;
-  };
-
-  static const int htbits = 10;
-  static const int htsize = 1 << htbits;
-  static const int htmask = htsize - 1;
-  CB *cbhash[htsize];
-  CB *cbfree;
-  CB *rexmit_head, *rexmit_tail;
-
-  // Retransmission
-  static const int resend_dt = 1000000;	// rexmit after 1 sec
-  static const int resend_max = 5;	// rexmit at most 5 times
-
-  // Scheduling new connections
-  int start_interval;			// ms between connections
-  Timestamp start_tv;
-
-  // Performance measurement
-  static const int perf_dt = 5000000;
-  Timestamp perf_tv;
-  struct {
-    int initiated;
-    int completed;
-    int reset;
-    int timeout;
-  } perfcnt;
-
-  void do_perf_stats ();
-
-  void recycle(CB *);
-  CB *find_cb(unsigned src, unsigned short sport, unsigned short dport);
-  IPAddress pick_src();
-  int connhash(unsigned src, unsigned short sport);
-
-  WritablePacket *fixup_packet (Packet *p, unsigned plen);
-
-  void tcp_input(Packet *);
-  void tcp_send(CB *, Packet *);
-  void tcp_output(WritablePacket *p,
-	IPAddress src, unsigned short sport,
-	IPAddress dst, unsigned short dport,
-	int seq, int ack, char tcpflags,
-	char *payload, int paylen);
+=c
+
+WebGen(PREFIX, DST, RATE [, I<keywords>])
+
+=s tcp
+
+stateful HTTP client load generator
+
+=d
+
+Opens RATE TCP connections per second to port DPORT of DST, asks for a web
+page over each, and closes it.  Connections come from source addresses
+within PREFIX and source ports 1024 through 65535; every connection gets a
+source address and port pair that no other open connection is using.  Emits
+IP packets on its output and expects the server's packets on its input.
+
+Each connection sends a SYN, waits for the server's SYN-ACK, thinks for
+THINK, then sends one of the REQUEST payloads, chosen at random, together
+with a FIN.  It acknowledges the server's data and FIN and closes once the
+server has acknowledged the request.  Segments that arrive out of order are
+not reassembled but acknowledged with the next expected sequence number.
+Unacknowledged SYNs and requests are retransmitted every RESEND; a
+connection that is retransmitted more than RESEND_MAX times, or that gets
+no data for that long while waiting for a response, times out.  Packets for
+unknown connections are answered with a reset.
+
+WebGen is built to hold CONNECTIONS concurrent connections, a million or
+more, for capacity tests of firewalls and NATs.  The connections are split
+into THREADS shards by source port.  Each shard has its own connection
+table, its own free list, and its own timing wheel of 1-millisecond slots
+for retransmissions and think times, and runs on its own thread: shard I<i>
+runs on thread I<T>+I<i> modulo the number of threads, where I<T> is
+WebGen's home thread.  Connection state lives in fixed-size arrays allocated
+at initialization, about 48 bytes per connection.  Packets arriving on the
+input find their shard from the destination port, so input that reaches
+WebGen on the shard's thread never contends for the shard's lock.
+
+Packets are built from a template header and the chosen request, whose
+checksum is computed once at initialization; WebGen reuses the buffer of the
+server packet it is responding to when it can.
+
+Keyword arguments are:
+
+=over 8
+
+=item DPORT
+
+Integer.  Server port.  Default is 80.
+
+=item ARRIVAL
+
+Word.  How new connections are spaced: C<fixed> starts them exactly 1/RATE
+seconds apart; C<poisson> draws exponentially distributed gaps with mean
+1/RATE, so that connections arrive as a Poisson process (user-level only).
+Default is C<fixed>.
+
+=item THINK
+
+Time.  How long a connection waits between the handshake and its request.
+Concurrent connections grow to about RATE times THINK.  Default is 0.
+
+=item REQUEST
+
+String.  A request payload, sent in one segment.  May be given more than
+once; each connection picks one at random.  Default is a set of 270
+C<GET /spec/...> HTTP/1.0 requests for SPECweb-style file sets.
+
+=item CONNECTIONS
+
+Integer.  Maximum number of concurrent connections.  New connections are not
+started while all are in use; the C<overflows> handler counts them.
+Default is enough for RATE connections per second that each think for THINK
+and time out: at least 1024.
+
+=item THREADS
+
+Integer.  Number of shards.  Default is the number of threads.
+
+=item RESEND
+
+Time.  Retransmission interval.  Default is 1 second.
+
+=item RESEND_MAX
+
+Integer.  Retransmissions before a connection times out.  Default is 5.
+
+=item BURST
+
+Integer.  Maximum number of new connections and timer expirations a shard
+handles per task call.  Default is 256.
+
+=item STATS
+
+Time.  If nonzero, print connection counts every STATS.  Default is 5
+seconds.
+
+=back
+
+=e
+
+  kt :: KernelTap(11.11.0.0/16);
+  kt -> Strip(14)
+     -> WebGen(11.11.0.0/16, 10.0.0.1, 100)
+     -> EtherEncap(0x0800, 1:1:1:1:1:1, 2:2:2:2:2:2)
+     -> kt;
+
+This configuration, run with C<click -j 4>, keeps about 1,000,000
+connections open through a firewall between eth0 and eth1, each holding its
+request for 100 seconds:
+
+  fd :: FromDevice(eth1, METHOD RING, QUEUES 4, SNIFFER false);
+  wg :: WebGen(16.0.0.0/12, 10.0.0.1, 10000, THINK 100, CONNECTIONS 1200000,
+               ARRIVAL poisson);
+  fd[0], fd[1], fd[2], fd[3] -> Strip(14) -> CheckIPHeader -> wg
+     -> EtherEncap(0x0800, 1:1:1:1:1:1, 2:2:2:2:2:2) -> Queue -> ToDevice(eth0);
+
+=h active read-only
+
+Returns the number of open connections.
+
+=h initiated read-only
+
+Returns the number of connections started.
+
+=h completed read-only
+
+Returns the number of connections that closed normally.
+
+=h timeouts read-only
+
+Returns the number of connections that timed out.
+
+=h resets read-only
+
+Returns the number of connections reset by the server.
+
+=h overflows read-only
+
+Returns the number of connections not started because CONNECTIONS were
+already open or no source address and port pair was free.
+
+=a
+
+TCPReflector, UDPTemplateSource */
+
+class WebGen : public Element { public:
+
+    WebGen();
+    ~WebGen();
+
+    const char *class_name() const	{ return "WebGen"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    bool run_task(Task *task);
+
+  private:
+
+    enum { NIL = 0xFFFFFFFFU };
+    enum { WHEEL_SLOTS = 16384, WHEEL_MASK = WHEEL_SLOTS - 1 };
+    enum { FIRST_PORT = 1024, NPORTS = 65536 - FIRST_PORT };
+
+    enum { S_FREE, S_SYN_SENT, S_THINKING, S_REQUEST };
+
+    // TCP control block.  Connections are linked by index: hnext chains a
+    // hash bucket or the free list, and wnext/wprev a timing wheel slot.
+    // Every open connection is in exactly one wheel slot.
+    struct Conn {
+	uint32_t src;		// network byte order
+	uint16_t sport;		// network byte order
+	uint8_t state;
+	uint8_t resends;
+	uint32_t iss;
+	uint32_t snd_una;
+	uint32_t rcv_nxt;
+	uint32_t expiry;	// wheel tick
+	uint32_t hnext;
+	uint32_t wnext;
+	uint32_t wprev;
+	uint16_t request;
+	uint8_t got_fin;
+    };
+
+    // All of a shard's state is protected by its lock.
+    struct Shard {
+	SimpleSpinlock lock;
+	Conn *conns;
+	uint32_t nconns;
+	uint32_t *buckets;
+	int bucket_shift;
+	uint32_t free;
+	uint32_t nactive;
+	uint32_t *wheel;
+	uint32_t wheel_tick;	// next tick to expire
+	uint32_t nports;	// source ports this shard owns
+	uint64_t tuple;		// next source address and port pair
+	int64_t next_arrival;	// nanoseconds since _epoch
+	uint16_t ip_id;
+	Task *task;
+	Timer *timer;
+
+	uint64_t initiated;
+	uint64_t completed;
+	uint64_t timeouts;
+	uint64_t resets;
+	uint64_t overflows;
+    };
+
+    struct Request {
+	String data;
+	uint16_t sum;		// Internet checksum of data
+    };
+
+    uint32_t _src_prefix;	// network byte order
+    uint32_t _mask;
+    IPAddress _dst;
+    uint16_t _dport;		// network byte order
+    uint32_t _rate;
+    bool _poisson;
+    uint32_t _think_ticks;
+    uint32_t _resend_ticks;
+    uint32_t _resend_max;
+    uint32_t _nconns;
+    uint32_t _burst;
+    int _nshards;
+    uint32_t _headroom;
+    int64_t _gap;		// mean nanoseconds between arrivals per shard
+    Vector<Request> _requests;
+
+    struct {
+	click_ip ip;
+	click_tcp tcp;
+    } _header;
+
+    Shard *_shards;
+    Timestamp _epoch;
+
+    Timestamp _stats_interval;
+    Timestamp _stats_next;
+    uint64_t _stats_last[4];
+
+    enum { h_active, h_initiated, h_completed, h_timeouts, h_resets, h_overflows };
+    uint64_t stat(int which) const;
+    static String read_handler(Element *e, void *user_data);
+
+    inline uint32_t now_tick(int64_t now) const;
+    inline int64_t arrival_gap() const;
+    void do_perf_stats();
+
+    inline uint32_t find(Shard &s, uint32_t src, uint16_t sport) const;
+    inline void wheel_insert(Shard &s, uint32_t i, uint32_t tick);
+    inline void wheel_remove(Shard &s, uint32_t i);
+    void recycle(Shard &s, uint32_t i);
+    uint32_t run_wheel(Shard &s, uint32_t tick, uint32_t budget, PacketBatch &out);
+    void start_connection(Shard &s, int si, uint32_t tick, PacketBatch &out);
+    void expire(Shard &s, uint32_t i, uint32_t tick, PacketBatch &out);
+
+    void tcp_input(Shard &s, uint32_t i, Packet *p, uint32_t tick, PacketBatch &out);
+    void send_reset(Packet *p);
+    void send(Shard &s, Conn &c, Packet *xp, PacketBatch &out);
+
+    WritablePacket *fixup_packet(Packet *xp, uint32_t plen);
+    WritablePacket *make_packet(Packet *xp, uint32_t src, uint16_t sport,
+				uint32_t dst, uint16_t dport,
+				uint32_t seq, uint32_t ack, uint8_t flags,
+				const Request *req, uint16_t ip_id);
+
 };
 
 CLICK_ENDDECLS
@@ -79,14 +79,27 @@ CLICK_DECLS
 
 AddressInfo::AddressInfo()
 {
+    for (int i = 0; i < ndb; i++)
+	_dbs[i] = 0;
 }
 
 AddressInfo::~AddressInfo()
 {
 }
 
-int
-AddressInfo::configure(Vector<String> &conf, ErrorHandler *errh)
+void
+AddressInfo::define(int db, uint32_t type, const String &name, const void *value, size_t value_size)
+{
+    // Large tables define many names in the same few databases, so find
+    // each database once rather than once per name.
+    if (!_dbs[db])
+	_dbs[db] = NameInfo::getdb(type, this, value_size, true);
+    if (_dbs[db])
+	_dbs[db]->define(name, value, value_size);
+}
+
+void
+AddressInfo::add_entry(const String &arg, ErrorHandler *errh)
 {
     enum { t_eth = 1, t_ip4 = 2, t_ip4net = 4, t_ip6 = 8, t_ip6net = 16 };
     struct in_addr ip4[2];
@@ -102,57 +115,72 @@ AddressInfo::configure(Vector<String> &conf, ErrorHandler *errh)
 #endif
     ArgContext context(this);
 
-    for (int i = 0; i < conf.size(); i++) {
-	Vector<String> parts;
-	cp_spacevec(conf[i], parts);
-	if (parts.size() == 0)
-	    // allow empty arguments
-	    continue;
-	if (parts.size() < 2)
-	    errh->error("expected %<NAME [ADDRS]%>");
-	int types = 0;
-
-	for (int j = 1; j < parts.size(); j++) {
-	    int my_types = 0;
-	    if (EtherAddressArg().parse(parts[j], ether, context))
-		my_types |= t_eth;
-	    if (IPAddressArg().parse(parts[j], ip4[0], context))
+    Vector<String> parts;
+    cp_spacevec(arg, parts);
+    if (parts.size() == 0)
+	// allow empty arguments
+	return;
+    if (parts.size() < 2)
+	errh->error("expected %<NAME [ADDRS]%>");
+    int types = 0;
+
+    for (int j = 1; j < parts.size(); j++) {
+	int my_types = 0;
+	if (EtherAddressArg().parse(parts[j], ether, context))
+	    my_types |= t_eth;
+	if (IPAddressArg().parse(parts[j], ip4[0], context))
+	    my_types |= t_ip4;
+	else if (IPPrefixArg().parse(parts[j], ip4[0], ip4[1], context)) {
+	    my_types |= t_ip4net;
+	    if (ip4[0].s_addr & ~ip4[1].s_addr)
 		my_types |= t_ip4;
-	    else if (IPPrefixArg().parse(parts[j], ip4[0], ip4[1], context)) {
-		my_types |= t_ip4net;
-		if (ip4[0].s_addr & ~ip4[1].s_addr)
-		    my_types |= t_ip4;
-	    }
+	}
 #if HAVE_IP6
-	    if (IP6AddressArg().parse(parts[j], ip6.ip6, context))
+	if (IP6AddressArg().parse(parts[j], ip6.ip6, context))
+	    my_types |= t_ip6;
+	else if (IP6PrefixArg().parse(parts[j], ip6.ip6, ip6.plen, context)) {
+	    my_types |= t_ip6net;
+	    if (ip6.ip6 & IP6Address::make_inverted_prefix(ip6.plen))
 		my_types |= t_ip6;
-	    else if (IP6PrefixArg().parse(parts[j], ip6.ip6, ip6.plen, context)) {
-		my_types |= t_ip6net;
-		if (ip6.ip6 & IP6Address::make_inverted_prefix(ip6.plen))
-		    my_types |= t_ip6;
-	    }
+	}
 #endif
 
-	    bool one_type = (my_types & (my_types - 1)) == 0;
-	    if ((my_types & t_eth) && (one_type || !(types & t_eth)))
-		NameInfo::define(NameInfo::T_ETHERNET_ADDR, this, parts[0], ether, 6);
-	    if ((my_types & t_ip4) && (one_type || !(types & t_ip4)))
-		NameInfo::define(NameInfo::T_IP_ADDR, this, parts[0], &ip4[0], 4);
-	    if ((my_types & t_ip4net) && (one_type || !(types & t_ip4net)))
-		NameInfo::define(NameInfo::T_IP_PREFIX, this, parts[0], &ip4[0], 8);
+	bool one_type = (my_types & (my_types - 1)) == 0;
+	if ((my_types & t_eth) && (one_type || !(types & t_eth)))
+	    define(db_eth, NameInfo::T_ETHERNET_ADDR, parts[0], ether, 6);
+	if ((my_types & t_ip4) && (one_type || !(types & t_ip4)))
+	    define(db_ip4, NameInfo::T_IP_ADDR, parts[0], &ip4[0], 4);
+	if ((my_types & t_ip4net) && (one_type || !(types & t_ip4net)))
+	    define(db_ip4net, NameInfo::T_IP_PREFIX, parts[0], &ip4[0], 8);
 #if HAVE_IP6
-	    if ((my_types & t_ip6) && (one_type || !(types & t_ip6)))
-		NameInfo::define(NameInfo::T_IP6_ADDR, this, parts[0], &ip6.ip6, 16);
-	    if ((my_types & t_ip6net) && (one_type || !(types & t_ip6net)))
-		NameInfo::define(NameInfo::T_IP6_PREFIX, this, parts[0], &ip6, 16 + sizeof(int));
+	if ((my_types & t_ip6) && (one_type || !(types & t_ip6)))
+	    define(db_ip6, NameInfo::T_IP6_ADDR, parts[0], &ip6.ip6, 16);
+	if ((my_types & t_ip6net) && (one_type || !(types & t_ip6net)))
+	    define(db_ip6net, NameInfo::T_IP6_PREFIX, parts[0], &ip6, 16 + sizeof(int));
 #endif
 
-	    types |= my_types;
-	    if (!my_types)
-		errh->error("%<%s%> is not a recognizable address", parts[j].c_str());
-	}
+	types |= my_types;
+	if (!my_types)
+	    errh->error("%<%s%> is not a recognizable address", parts[j].c_str());
     }
+}
+
+int
+AddressInfo::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    for (int i = 0; i < conf.size(); i++)
+	add_entry(conf[i], errh);
+    return errh->nerrors() ? -1 : 0;
+}
 
+int
+AddressInfo::configure_stream(ArgvecIterator &args, ErrorHandler *errh)
+{
+    // Large generated tables are common; define each entry as it is
+    // parsed rather than splitting the whole configuration first.
+    String arg;
+    while (args.next(arg))
+	add_entry(arg, errh);
     return errh->nerrors() ? -1 : 0;
 }
 
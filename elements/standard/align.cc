@@ -34,9 +34,11 @@ int
 Align::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     unsigned modulus;
+    bool strict = false;
     if (Args(conf, this, errh)
 	.read_mp("MODULUS", modulus)
 	.read_mp("OFFSET", _offset)
+	.read("STRICT", strict)
 	.complete() < 0)
 	return -1;
     if (modulus != 2 && modulus != 4 && modulus != 8)
@@ -44,12 +46,20 @@ Align::configure(Vector<String> &conf, ErrorHandler *errh)
     if (_offset >= (int)modulus)
 	return errh->error("OFFSET must be smaller than MODULUS");
     _mask = modulus - 1;
+#if HAVE_INDIFFERENT_ALIGNMENT
+    _active = strict;
+#else
+    (void) strict;
+    _active = true;
+#endif
     return 0;
 }
 
 Packet *
 Align::smaction(Packet *p)
 {
+  if (!_active)
+    return p;
   int delta = _offset - (reinterpret_cast<uintptr_t>(p->data()) & _mask);
   if (delta == 0)
     return p;
@@ -4,7 +4,7 @@
 CLICK_DECLS
 
 /* =c
- * Align(MODULUS, OFFSET)
+ * Align(MODULUS, OFFSET [, STRICT])
  * =s basicmod
  * aligns packet data
  * =d
@@ -14,6 +14,25 @@ CLICK_DECLS
  * copy.
  *
  * MODULUS must be 2, 4, or 8.
+ *
+ * Align is a fallback.  The router tells packet sources, such as FromDevice
+ * and InfiniteSource, the alignment that elements downstream want (see
+ * Element::input_alignment), and they place packet data accordingly, so
+ * packets usually reach Align already aligned.  On machines where unaligned
+ * accesses are cheap, such as x86, Align passes packets through unchanged
+ * unless STRICT is true: the copy would cost more than it saves.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item STRICT
+ *
+ * Boolean.  If true, align packets even on machines that tolerate unaligned
+ * accesses.  Default is false.
+ *
+ * =back
+ *
  * =n
  *
  * The click-align(1) tool will insert this element automatically wherever it
@@ -28,6 +47,7 @@ class Align : public Element {
 
   int _offset;
   int _mask;
+  bool _active;
 
  public:
 
@@ -38,6 +58,7 @@ class Align : public Element {
   const char *port_count() const		{ return PORTS_1_1; }
 
   int configure(Vector<String> &, ErrorHandler *);
+  int data_shift() const			{ return DATA_SHIFT_UNKNOWN; }
 
   Packet *smaction(Packet *);
   void push(int, Packet *);
@@ -0,0 +1,174 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * annotationswitch.{cc,hh} -- send packets to outputs chosen by annotation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "annotationswitch.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+AnnotationSwitch::AnnotationSwitch()
+{
+}
+
+AnnotationSwitch::~AnnotationSwitch()
+{
+}
+
+int
+AnnotationSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String anno;
+    Vector<String> maps;
+    int size = 1, dflt = -1;
+    if (Args(conf, this, errh)
+	.read_mp("ANNO", AnyArg(), anno)
+	.read("SIZE", size)
+	.read_all_with("MAP", AnyArg(), maps)
+	.read("DEFAULT", dflt)
+	.complete() < 0)
+	return -1;
+
+    if (size != 1 && size != 2 && size != 4)
+	return errh->error("SIZE must be 1, 2, or 4");
+    if (!AnnoArg(size).parse(anno, _anno, Args(this, errh)))
+	return errh->error("bad ANNO for SIZE %d", size);
+    _size = size;
+    if (noutputs() >= 0xFFFF)
+	return errh->error("too many outputs");
+    _drop = noutputs();
+    if (dflt < -1 || dflt >= noutputs())
+	return errh->error("DEFAULT out of range");
+    _default = (dflt < 0 ? _drop : dflt);
+
+    // Parse the MAPs before building the table, since they set its size.
+    Vector<uint32_t> lo, hi;
+    Vector<uint16_t> port;
+    uint32_t limit = noutputs();
+    for (String *it = maps.begin(); it != maps.end(); ++it) {
+	String range = cp_shift_spacevec(*it);
+	int p = 0;
+	int dash = range.find_left('-');
+	uint32_t l = 0, h = 0;
+	bool ok;
+	if (dash < 0) {
+	    ok = IntArg().parse(range, l);
+	    h = l;
+	} else
+	    ok = IntArg().parse(range.substring(0, dash), l)
+		&& IntArg().parse(range.substring(dash + 1), h) && l <= h;
+	if (!ok)
+	    return errh->error("MAP %<%s%>: bad value range", range.c_str());
+	if (!IntArg().parse(*it, p) || p < -1 || p >= noutputs())
+	    return errh->error("MAP %<%s%>: bad output port", it->c_str());
+	if (size < 4 && h >= (1U << (8 * size)))
+	    return errh->error("MAP %<%s%>: value too large for SIZE %d", range.c_str(), size);
+	if (h >= max_table)
+	    return errh->error("MAP %<%s%>: values past %d need too large a table", range.c_str(), max_table - 1);
+	lo.push_back(l);
+	hi.push_back(h);
+	port.push_back(p < 0 ? _drop : p);
+	if (h >= limit)
+	    limit = h + 1;
+    }
+
+    _table.assign(limit, _default);
+    for (int v = 0; v < noutputs(); ++v)
+	_table[v] = v;
+    for (int i = 0; i < lo.size(); ++i)
+	for (uint32_t v = lo[i]; v <= hi[i]; ++v)
+	    _table[v] = port[i];
+    return 0;
+}
+
+inline uint32_t
+AnnotationSwitch::value(Packet *p) const
+{
+    if (_size == 1)
+	return p->anno_u8(_anno);
+    else if (_size == 2)
+	return p->anno_u16(_anno);
+    else
+	return p->anno_u32(_anno);
+}
+
+inline int
+AnnotationSwitch::lookup(Packet *p) const
+{
+    uint32_t v = value(p);
+    return v < (uint32_t) _table.size() ? _table.unchecked_at(v) : _default;
+}
+
+void
+AnnotationSwitch::push(int, Packet *p)
+{
+    int port = lookup(p);
+    if (port != _drop)
+	output(port).push(p);
+    else
+	p->kill();
+}
+
+void
+AnnotationSwitch::push_batch(int, PacketBatch &batch)
+{
+    enum { max_run = 256 };
+    Packet *pa[max_run], *pb[max_run];
+    uint16_t porta[max_run], portb[max_run];
+
+    while (!batch.empty()) {
+	int n = 0;
+	for (; n < max_run && !batch.empty(); ++n) {
+	    pa[n] = batch.pop_front();
+	    porta[n] = lookup(pa[n]);
+	}
+
+	// Stable LSD radix sort by port, one byte per pass; ports above 255
+	// need a second pass.
+	Packet **p = pa, **xp = pb;
+	uint16_t *port = porta, *xport = portb;
+	for (int shift = 0; shift == 0 || (shift == 8 && _drop > 255); shift += 8) {
+	    int count[257];
+	    memset(count, 0, sizeof(count));
+	    for (int i = 0; i < n; ++i)
+		++count[((port[i] >> shift) & 255) + 1];
+	    for (int d = 1; d < 257; ++d)
+		count[d] += count[d - 1];
+	    for (int i = 0; i < n; ++i) {
+		int j = count[(port[i] >> shift) & 255]++;
+		xp[j] = p[i];
+		xport[j] = port[i];
+	    }
+	    click_swap(p, xp);
+	    click_swap(port, xport);
+	}
+
+	for (int i = 0; i < n; ) {
+	    int o = port[i];
+	    PacketBatch out;
+	    do {
+		out.push_back(p[i]);
+	    } while (++i < n && port[i] == o);
+	    if (o != _drop)
+		output(o).push_batch(out);
+	    else
+		out.kill();
+	}
+    }
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(AnnotationSwitch)
+ELEMENT_MT_SAFE(AnnotationSwitch)
@@ -0,0 +1,97 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ANNOTATIONSWITCH_HH
+#define CLICK_ANNOTATIONSWITCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+AnnotationSwitch(ANNO [, I<keywords> SIZE, MAP, DEFAULT])
+
+=s classification
+
+sends packets to outputs chosen by an annotation, using a jump table
+
+=d
+
+Sends each incoming packet to the output port that its ANNO annotation
+selects.  ANNO is a SIZE-byte annotation; SIZE is 1, 2, or 4.  A 2-byte
+annotation lets one AnnotationSwitch dispatch thousands of colors, for
+instance one per tenant, where a PaintSwitch would be limited to 255 and a
+chain of CheckPaint elements would test each color in turn.
+
+By default, a packet whose annotation is I<K> goes to output I<K>, and a
+packet whose annotation names no output is dropped.  MAP arguments override
+this.  At initialization, AnnotationSwitch builds a dense jump table
+holding the output for every annotation value up to the largest mapped
+value or output number, so each packet costs one annotation read and one
+table lookup.  Values beyond the table go to DEFAULT.
+
+Batches pushed with push_batch are radix-sorted by output port, one pass per
+byte of port number, and each output receives a single batch holding the
+packets bound for it, in their original order.
+
+Keyword arguments are:
+
+=over 8
+
+=item SIZE
+
+Integer.  Size of the ANNO annotation in bytes: 1, 2, or 4.  Default is 1.
+
+=item MAP
+
+Two space-separated arguments, a value or range of values I<LO>-I<HI> and an
+output port, which may be -1 to drop.  Sends packets whose annotation is
+that value, or within that range, to that port.  May be given more than
+once; later MAPs override earlier ones.  The jump table, and so the largest
+mapped value, is limited to 2^20 entries.
+
+=item DEFAULT
+
+Integer.  Output port for annotation values that no MAP mentions and that
+name no output, or -1 to drop them.  Default is -1.
+
+=back
+
+=e
+
+Send aggregates 0 through 999, one per tenant, to outputs 0 through 999, and
+everything else to output 1000:
+
+  sw :: AnnotationSwitch(AGGREGATE, SIZE 4, DEFAULT 1000);
+
+=a PaintSwitch, CheckPaint, HashSwitch, Classifier */
+
+class AnnotationSwitch : public Element { public:
+
+    AnnotationSwitch();
+    ~AnnotationSwitch();
+
+    const char *class_name() const	{ return "AnnotationSwitch"; }
+    const char *port_count() const	{ return "1/-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+  private:
+
+    enum { max_table = 1 << 20 };
+
+    int _anno;
+    int _size;
+    uint16_t _default;
+    uint16_t _drop;		// port number standing for drop, noutputs()
+    Vector<uint16_t> _table;
+
+    inline uint32_t value(Packet *p) const;
+    inline int lookup(Packet *p) const;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -39,21 +39,28 @@ AverageCounter::reset()
   _byte_count = 0;
   _first = 0;
   _last = 0;
+  for (int i = 0; i < _shards.size(); i++)
+    _shards[i].count = _shards[i].byte_count = _shards[i].last = 0;
 }
 
 int
 AverageCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
   _ignore = 0;
-  if (Args(conf, this, errh).read_p("IGNORE", _ignore).complete() < 0)
+  _sharded = false;
+  if (Args(conf, this, errh)
+      .read_p("IGNORE", _ignore)
+      .read("SHARDED", _sharded).complete() < 0)
     return -1;
   _ignore *= CLICK_HZ;
   return 0;
 }
 
 int
-AverageCounter::initialize(ErrorHandler *)
+AverageCounter::initialize(ErrorHandler *errh)
 {
+  if (_sharded && _shards.initialize(master()) < 0)
+    return errh->error("out of memory");
   reset();
   return 0;
 }
@@ -62,6 +69,18 @@ Packet *
 AverageCounter::simple_action(Packet *p)
 {
     uint32_t jpart = click_jiffies();
+    if (_sharded) {
+	// Test _first before writing it, so threads only read its line.
+	if (!_first)
+	    _first.compare_swap(0, jpart);
+	Shard &s = _shards.get();
+	if (jpart - _first >= _ignore) {
+	    s.count++;
+	    s.byte_count += p->length();
+	}
+	s.last = jpart;
+	return p;
+    }
     _first.compare_swap(0, jpart);
     if (jpart - _first >= _ignore) {
 	_count++;
@@ -71,6 +90,39 @@ AverageCounter::simple_action(Packet *p)
     return p;
 }
 
+uint32_t
+AverageCounter::total(uint32_t Shard::*field) const
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < _shards.size(); i++)
+	sum += _shards[i].*field;
+    return sum;
+}
+
+uint32_t
+AverageCounter::count() const
+{
+    return _sharded ? total(&Shard::count) : _count.value();
+}
+
+uint32_t
+AverageCounter::byte_count() const
+{
+    return _sharded ? total(&Shard::byte_count) : _byte_count.value();
+}
+
+uint32_t
+AverageCounter::last() const
+{
+    if (!_sharded)
+	return _last;
+    uint32_t last = _first;
+    for (int i = 0; i < _shards.size(); i++)
+	if (_shards[i].last && click_jiffies_less(last, _shards[i].last))
+	    last = _shards[i].last;
+    return last;
+}
+
 static String
 averagecounter_read_count_handler(Element *e, void *thunk)
 {
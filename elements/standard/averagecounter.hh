@@ -4,11 +4,12 @@
 #include <click/ewma.hh>
 #include <click/atomic.hh>
 #include <click/timer.hh>
+#include <click/percpu.hh>
 CLICK_DECLS
 
 /*
  * =c
- * AverageCounter([IGNORE])
+ * AverageCounter([IGNORE, I<keywords> SHARDED])
  * =s counters
  * measures historical packet count and rate
  * =d
@@ -24,6 +25,12 @@ CLICK_DECLS
  * the first IGNORE number of seconds are ignored in
  * the count.
  *
+ * SHARDED is a boolean, false by default.  If true,
+ * AverageCounter keeps a separate count for each thread,
+ * each on its own cache line, and adds them up when a
+ * handler is read.  Use this when several threads push
+ * packets through the same AverageCounter.
+ *
  * =h count read-only
  * Returns the number of packets that have passed through since the last reset.
  *
@@ -49,10 +56,10 @@ class AverageCounter : public Element { public:
     const char *port_count() const		{ return PORTS_1_1; }
     int configure(Vector<String> &, ErrorHandler *);
 
-    uint32_t count() const			{ return _count; }
-    uint32_t byte_count() const			{ return _byte_count; }
+    uint32_t count() const;
+    uint32_t byte_count() const;
     uint32_t first() const			{ return _first; }
-    uint32_t last() const			{ return _last; }
+    uint32_t last() const;
     uint32_t ignore() const			{ return _ignore; }
     void reset();
 
@@ -69,6 +76,20 @@ class AverageCounter : public Element { public:
     atomic_uint32_t _last;
     atomic_uint32_t _first_count;
     uint32_t _ignore;
+    bool _sharded;
+
+    struct Shard {
+	uint32_t count;
+	uint32_t byte_count;
+	uint32_t last;
+	Shard()
+	    : count(0), byte_count(0), last(0) {
+	}
+    };
+
+    PerCPU<Shard> _shards;
+
+    uint32_t total(uint32_t Shard::*field) const;
 
 };
 
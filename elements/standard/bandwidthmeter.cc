@@ -23,7 +23,7 @@
 CLICK_DECLS
 
 BandwidthMeter::BandwidthMeter()
-  : _meters(0), _nmeters(0)
+  : _sharded(false), _meters(0), _nmeters(0)
 {
 }
 
@@ -39,6 +39,10 @@ BandwidthMeter::configure(Vector<String> &conf, ErrorHandler *errh)
   _meters = 0;
   _nmeters = 0;
 
+  if (Args(this, errh).bind(conf)
+      .read("SHARDED", _sharded)
+      .consume() < 0)
+    return -1;
   if (conf.size() == 0)
     return errh->error("too few arguments to BandwidthMeter(bandwidth, ...)");
 
@@ -73,12 +77,31 @@ BandwidthMeter::configure(Vector<String> &conf, ErrorHandler *errh)
   return 0;
 }
 
+int
+BandwidthMeter::initialize(ErrorHandler *errh)
+{
+  if (_sharded && _shards.initialize(master()) < 0)
+    return errh->error("out of memory");
+  return 0;
+}
+
+unsigned
+BandwidthMeter::sharded_rate() const
+{
+  unsigned sum = 0;
+  for (int i = 0; i < _shards.size(); i++) {
+    // Update a copy; the original belongs to the shard's thread.
+    RateEWMA r = _shards[i].rate;
+    r.update(0);
+    sum += r.scaled_average();
+  }
+  return sum;
+}
+
 void
 BandwidthMeter::push(int, Packet *p)
 {
-  _rate.update(p->length());
-
-  unsigned r = _rate.scaled_average();
+  unsigned r = update_rate(p->length());
   if (_nmeters < 2) {
     int n = (r >= _meter1);
     output(n).push(p);
@@ -112,8 +135,14 @@ String
 BandwidthMeter::read_rate_handler(Element *f, void *)
 {
   BandwidthMeter *c = (BandwidthMeter *)f;
-  c->_rate.update(0);
-  return cp_unparse_real2(c->scaled_rate()*c->rate_freq(), c->rate_scale());
+  unsigned r;
+  if (c->_sharded)
+    r = c->sharded_rate();
+  else {
+    c->_rate.update(0);
+    r = c->scaled_rate();
+  }
+  return cp_unparse_real2(r*c->rate_freq(), c->rate_scale());
 }
 
 void
@@ -2,11 +2,12 @@
 #define CLICK_BANDWIDTHMETER_HH
 #include <click/element.hh>
 #include <click/ewma.hh>
+#include <click/percpu.hh>
 CLICK_DECLS
 
 /*
  * =c
- * BandwidthMeter(RATE1, RATE2, ..., RATEI<n>)
+ * BandwidthMeter(RATE1, RATE2, ..., RATEI<n> [, I<keywords> SHARDED])
  * =s shaping
  * classifies packet stream by arrival rate
  * =d
@@ -25,6 +26,12 @@ CLICK_DECLS
  * sent to output 1; and so on. If it is >= RATEI<n>, packets are sent to
  * output I<n>.
  *
+ * SHARDED is a boolean, false by default.  If true, BandwidthMeter measures
+ * the rate separately on each thread, on separate cache lines, so that
+ * several threads can push packets through it without sharing a cache line.
+ * Packets are classified by the total rate, which each thread adds up once
+ * per jiffy; the classification is therefore approximate.
+ *
  * =e
  *
  * This configuration fragment drops the input stream when it is generating
@@ -39,6 +46,18 @@ class BandwidthMeter : public Element { protected:
 
   RateEWMA _rate;
 
+  struct Shard {
+    RateEWMA rate;
+    unsigned total;
+    click_jiffies_t total_epoch;
+    Shard()
+      : total(0), total_epoch(0) {
+    }
+  };
+
+  bool _sharded;
+  PerCPU<Shard> _shards;
+
   unsigned _meter1;
   unsigned *_meters;
   int _nmeters;
@@ -46,6 +65,9 @@ class BandwidthMeter : public Element { protected:
   static String meters_read_handler(Element *, void *);
   static String read_rate_handler(Element *, void *);
 
+  inline unsigned update_rate(unsigned delta);
+  unsigned sharded_rate() const;
+
  public:
 
   BandwidthMeter();
@@ -60,11 +82,30 @@ class BandwidthMeter : public Element { protected:
   unsigned rate_freq() const		{ return _rate.epoch_frequency(); }
 
   int configure(Vector<String> &, ErrorHandler *);
+  int initialize(ErrorHandler *);
   void add_handlers();
 
   void push(int port, Packet *);
 
 };
 
+/** @brief Add @a delta to the rate and return the current scaled rate. */
+inline unsigned
+BandwidthMeter::update_rate(unsigned delta)
+{
+  if (!_sharded) {
+    _rate.update(delta);
+    return _rate.scaled_average();
+  }
+  Shard &s = _shards.get();
+  s.rate.update(delta);
+  click_jiffies_t now = click_jiffies();
+  if (now != s.total_epoch) {
+    s.total = sharded_rate();
+    s.total_epoch = now;
+  }
+  return s.total;
+}
+
 CLICK_ENDDECLS
 #endif
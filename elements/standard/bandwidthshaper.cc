@@ -34,7 +34,7 @@ Packet *
 BandwidthShaper::pull(int)
 {
     Packet *p = 0;
-    if (_rate.need_update(Timestamp::now())) {
+    if (_rate.need_update(Timestamp::now_fast())) {
 	if ((p = input(0).pull()))
 	    _rate.update_with(p->length());
     }
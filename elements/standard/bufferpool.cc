@@ -0,0 +1,143 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * bufferpool.{cc,hh} -- byte budget shared by several queues
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "bufferpool.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+BufferPool::BufferPool()
+    : _highwater_bytes(0)
+{
+    _bytes = 0;
+}
+
+BufferPool::~BufferPool()
+{
+}
+
+int
+BufferPool::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _alpha = 1 << ALPHA_SHIFT;
+    _ecn = false;
+    return Args(conf, this, errh)
+	.read_mp("CAPACITY", _capacity)
+	.read("ALPHA", FixedPointArg(ALPHA_SHIFT), _alpha)
+	.read("ECN", _ecn)
+	.complete();
+}
+
+int
+BufferPool::add_queue(Element *e)
+{
+    _slots.push_back(Slot(e));
+    return _slots.size() - 1;
+}
+
+bool
+BufferPool::mark(Packet *&p)
+{
+    // a shared packet could be uniqueified only by copying
+    if (!p->has_network_header() || p->shared())
+	return false;
+    const click_ip *iph = p->ip_header();
+    if ((iph->ip_tos & IP_ECNMASK) == IP_ECN_NOT_ECT)
+	return false;
+    else if ((iph->ip_tos & IP_ECNMASK) == IP_ECN_CE)
+	return true;
+
+    WritablePacket *q = p->uniqueify();
+    click_ip *q_iph = q->ip_header();
+    uint16_t old_hw = *(uint16_t *) q_iph;
+    q_iph->ip_tos |= IP_ECN_CE;
+    click_update_in_cksum(&q_iph->ip_sum, old_hw, *(uint16_t *) q_iph);
+    p = q;
+    return true;
+}
+
+enum { h_capacity, h_alpha, h_drops, h_marks, h_queues, h_reset_counts };
+
+String
+BufferPool::read_handler(Element *e, void *thunk)
+{
+    BufferPool *bp = static_cast<BufferPool *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_capacity:
+	return String(bp->_capacity);
+    case h_alpha:
+	return cp_unparse_real2(bp->_alpha, ALPHA_SHIFT);
+    case h_drops:
+    case h_marks: {
+	uint32_t n = 0;
+	for (Slot *s = bp->_slots.begin(); s != bp->_slots.end(); ++s)
+	    n += (thunk == (void *) h_drops ? s->drops : s->marks);
+	return String(n);
+    }
+    case h_queues: {
+	StringAccum sa;
+	uint32_t thresh = bp->threshold(bp->_bytes);
+	for (Slot *s = bp->_slots.begin(); s != bp->_slots.end(); ++s)
+	    sa << s->queue->name() << ' ' << s->bytes << ' ' << thresh
+	       << ' ' << s->drops << ' ' << s->marks << '\n';
+	return sa.take_string();
+    }
+    default:
+	return String();
+    }
+}
+
+int
+BufferPool::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    BufferPool *bp = static_cast<BufferPool *>(e);
+    Args args(e, errh);
+    args.push_back_words(str);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_capacity:
+	return args.read_mp("CAPACITY", bp->_capacity).complete();
+    case h_alpha:
+	return args.read_mp("ALPHA", FixedPointArg(ALPHA_SHIFT), bp->_alpha).complete();
+    case h_reset_counts:
+	for (Slot *s = bp->_slots.begin(); s != bp->_slots.end(); ++s)
+	    s->drops = s->marks = 0;
+	bp->_highwater_bytes = bp->_bytes;
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+BufferPool::add_handlers()
+{
+    add_read_handler("capacity", read_handler, h_capacity);
+    add_write_handler("capacity", write_handler, h_capacity);
+    add_read_handler("alpha", read_handler, h_alpha);
+    add_write_handler("alpha", write_handler, h_alpha);
+    add_data_handlers("bytes", Handler::OP_READ, &_bytes);
+    add_data_handlers("highwater_bytes", Handler::OP_READ, &_highwater_bytes);
+    add_read_handler("drops", read_handler, h_drops);
+    add_read_handler("marks", read_handler, h_marks);
+    add_read_handler("queues", read_handler, h_queues);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(BufferPool)
+ELEMENT_MT_SAFE(BufferPool)
@@ -0,0 +1,211 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_BUFFERPOOL_HH
+#define CLICK_BUFFERPOOL_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+BufferPool(CAPACITY [, I<keywords> ALPHA, ECN])
+
+=s storage
+
+byte budget shared by several queues
+
+=d
+
+BufferPool is an information element that holds a router-wide budget of
+CAPACITY bytes of queued packet data.  Queues join the pool by naming it as
+their BUFFER_POOL keyword argument.  A pooled queue still enforces its own
+CAPACITY in packets, but it also refuses any packet that the pool will not
+admit, dropping it as it would drop a packet that found the queue full.
+
+The pool admits a packet of length L to a queue currently holding Q bytes
+only if the pool has room for it, and if Q + L is at most the queue's
+dynamic threshold, ALPHA times the pool's free space (Choudhury and Hahne's
+dynamic threshold scheme).  A queue may thus take a large share of an idle
+pool, but as the pool fills, every queue's threshold shrinks, so one
+congested queue cannot starve the others of buffer space.  With ALPHA 1, a
+single congested queue is held to half the pool.
+
+If ECN is true, a packet that exceeds its queue's dynamic threshold while
+the pool still has room is admitted with its IP ECN field set to Congestion
+Experienced, rather than dropped, if it is ECN-capable.  Packets that are
+not ECN-capable, and packets whose data is shared with other packets, are
+dropped.  Such packets must have their IP header annotations set.  Packets
+that would exceed the pool's capacity are always dropped.
+
+Accounting uses packet lengths and atomic operations, so pooled queues may
+run on different threads.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Integer.  The pool's capacity in bytes.
+
+=item ALPHA
+
+Real number.  The dynamic threshold multiplier.  Default is 1.
+
+=item ECN
+
+Boolean.  If true, mark ECN-capable packets instead of dropping them when
+they exceed their queue's threshold.  Default is false.
+
+=back
+
+=h capacity read/write
+
+Returns or sets CAPACITY.
+
+=h alpha read/write
+
+Returns or sets ALPHA.
+
+=h bytes read-only
+
+Returns the number of bytes held by all pooled queues.
+
+=h highwater_bytes read-only
+
+Returns the maximum number of bytes ever held by all pooled queues at once.
+
+=h drops read-only
+
+Returns the number of packets the pool has refused.
+
+=h marks read-only
+
+Returns the number of packets the pool has marked.
+
+=h queues read-only
+
+Returns one line per pooled queue, containing the queue's name, the bytes it
+holds, its current dynamic threshold, the packets the pool has refused it,
+and the packets the pool has marked for it.
+
+=h reset_counts write-only
+
+When written, resets the C<drops>, C<marks>, and C<highwater_bytes> counters.
+
+=e
+
+  pool :: BufferPool(1000000, ALPHA 2);
+  c :: Classifier(...);
+  c[0] -> Queue(1000, BUFFER_POOL pool) -> ToDevice(eth0);
+  c[1] -> Queue(1000, BUFFER_POOL pool) -> ToDevice(eth1);
+
+=a Queue, SimpleQueue, ThreadSafeQueue, MarkIPCE */
+
+class BufferPool : public Element { public:
+
+    BufferPool();
+    ~BufferPool();
+
+    const char *class_name() const	{ return "BufferPool"; }
+    int configure_phase() const		{ return CONFIGURE_PHASE_INFO; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    /** @brief Add queue @a e to the pool.
+     * @return the queue's slot number, used in admit() and release() */
+    int add_queue(Element *e);
+
+    /** @brief Decide whether to admit @a p to the queue in @a slot.
+     * @return true if @a p was admitted and charged to the queue
+     *
+     * @a p may be replaced with a marked version. */
+    inline bool admit(int slot, Packet *&p);
+
+    /** @brief Charge @a bytes to the queue in @a slot unconditionally. */
+    inline void charge(int slot, uint32_t bytes);
+
+    /** @brief Release @a bytes held by the queue in @a slot. */
+    inline void release(int slot, uint32_t bytes);
+
+  private:
+
+    enum { ALPHA_SHIFT = 16 };
+
+    struct Slot {
+	Element *queue;
+	atomic_uint32_t bytes;
+	atomic_uint32_t drops;
+	atomic_uint32_t marks;
+	Slot(Element *e)
+	    : queue(e) {
+	    bytes = drops = marks = 0;
+	}
+    };
+
+    atomic_uint32_t _bytes;
+    uint32_t _highwater_bytes;
+    uint32_t _capacity;
+    uint32_t _alpha;			// fixed point, ALPHA_SHIFT bits
+    bool _ecn;
+    Vector<Slot> _slots;
+
+    uint32_t threshold(uint32_t bytes) const {
+	uint32_t free = bytes < _capacity ? _capacity - bytes : 0;
+	uint64_t t = ((uint64_t) free * _alpha) >> ALPHA_SHIFT;
+	return t > 0xFFFFFFFFU ? 0xFFFFFFFFU : t;
+    }
+    static bool mark(Packet *&p);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+inline bool
+BufferPool::admit(int slot, Packet *&p)
+{
+    Slot &s = _slots[slot];
+    uint32_t len = p->length(), bytes = _bytes;
+    bool marked = false;
+    if (s.bytes + len > threshold(bytes)) {
+	if (!_ecn || !(marked = mark(p)))
+	    goto drop;
+    }
+
+    // reserve the bytes, unless the pool is full
+    do {
+	bytes = _bytes;
+	if (bytes >= _capacity || len > _capacity - bytes)
+	    goto drop;
+    } while (_bytes.compare_swap(bytes, bytes + len) != bytes);
+    s.bytes += len;
+    if (marked)
+	++s.marks;
+    if (bytes + len > _highwater_bytes)
+	_highwater_bytes = bytes + len;
+    return true;
+
+  drop:
+    ++s.drops;
+    return false;
+}
+
+inline void
+BufferPool::charge(int slot, uint32_t bytes)
+{
+    _slots[slot].bytes += bytes;
+    _bytes += bytes;
+}
+
+inline void
+BufferPool::release(int slot, uint32_t bytes)
+{
+    _slots[slot].bytes -= bytes;
+    _bytes -= bytes;
+}
+
+CLICK_ENDDECLS
+#endif
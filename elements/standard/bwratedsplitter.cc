@@ -19,6 +19,7 @@
 
 #include <click/config.h>
 #include "bwratedsplitter.hh"
+#include "sharedtokenbucket.hh"
 CLICK_DECLS
 
 BandwidthRatedSplitter::BandwidthRatedSplitter()
@@ -32,8 +33,14 @@ BandwidthRatedSplitter::~BandwidthRatedSplitter()
 void
 BandwidthRatedSplitter::push(int, Packet *p)
 {
-    _tb.refill();
-    if (_tb.remove_if(p->length()))
+    bool ok;
+    if (_shared)
+	ok = _shared->remove_if(p->length());
+    else {
+	_tb.refill();
+	ok = _tb.remove_if(p->length());
+    }
+    if (ok)
 	output(0).push(p);
     else
 	output(1).push(p);
@@ -41,10 +41,18 @@ CLICK_DECLS
  * Integer.  If specified, the capacity of the token bucket is set to this
  * value in bytes.
  *
+ * =item SHARED
+ *
+ * The name of a BandwidthSharedTokenBucket element.  If specified, BandwidthRatedSplitter
+ * takes its tokens from that shared bucket, whose rate may be shared with
+ * rate limiters on other threads, and RATE and the burst options must not be
+ * given.
+ *
  * =h rate read/write
  * rate of splitting
  *
- * =a RatedSplitter, BandwidthMeter, BandwidthShaper, BandwidthRatedUnqueue */
+ * =a RatedSplitter, BandwidthMeter, BandwidthShaper, BandwidthRatedUnqueue,
+ * BandwidthSharedTokenBucket */
 
 class BandwidthRatedSplitter : public RatedSplitter { public:
 
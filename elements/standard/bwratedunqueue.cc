@@ -20,6 +20,7 @@
 
 #include <click/config.h>
 #include "bwratedunqueue.hh"
+#include "sharedtokenbucket.hh"
 CLICK_DECLS
 
 BandwidthRatedUnqueue::BandwidthRatedUnqueue()
@@ -33,34 +34,49 @@ BandwidthRatedUnqueue::~BandwidthRatedUnqueue()
 bool
 BandwidthRatedUnqueue::run_task(Task *)
 {
-    bool worked = false;
     _runs++;
 
     if (!_active)
 	return false;
 
-    _tb.refill();
-
-    if (_tb.contains(tb_bandwidth_thresh)) {
-	if (Packet *p = input(0).pull()) {
-	    _tb.remove(p->length());
-	    _pushes++;
-	    worked = true;
-	    output(0).push(p);
-	} else {
-	    _failed_pulls++;
-	    if (!_signal)
-		return false;	// without rescheduling
-	}
-    } else {
-	_timer.schedule_after(Timestamp::make_jiffies(_tb.time_until_contains(tb_bandwidth_thresh)));
+    if (!_shared)
+	_tb.refill();
+    if (!(_shared ? _shared->contains(1) : _tb.contains(tb_bandwidth_thresh))) {
+	if (_shared)
+	    _timer.schedule_after(_shared->time_until_contains(1));
+	else
+	    _timer.schedule_after(Timestamp::make_jiffies(_tb.time_until_contains(tb_bandwidth_thresh)));
 	_empty_runs++;
 	return false;
     }
-    _task.fast_reschedule();
-    if (!worked)
-	_empty_runs++;
-    return worked;
+
+    // Packet sizes are not known until the packets are pulled, so pull one
+    // at a time while tokens last and push what was pulled as one batch.
+    PacketBatch batch;
+    do {
+	Packet *p = input(0).pull();
+	if (!p)
+	    break;
+	// let the bucket go into debt for the rest of the packet
+	if (_shared)
+	    _shared->remove(p->length());
+	else
+	    _tb.remove(p->length());
+	batch.push_back(p);
+    } while ((uint32_t) batch.count() < _burst
+	     && (_shared ? _shared->contains(1) : _tb.contains(tb_bandwidth_thresh)));
+
+    if (int count = batch.count()) {
+	_pushes += count;
+	output(0).push_batch(batch);
+	_task.fast_reschedule();
+	return true;
+    }
+    _failed_pulls++;
+    _empty_runs++;
+    if (_signal)
+	_task.fast_reschedule();
+    return false;
 }
 
 CLICK_ENDDECLS
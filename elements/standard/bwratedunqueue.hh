@@ -34,9 +34,23 @@ CLICK_DECLS
  * Integer.  If specified, the capacity of the token bucket is set to this
  * value in bytes.
  *
+ * =item BURST
+ *
+ * Integer.  Maximum number of packets to pull per scheduling.  Each time it
+ * runs, BandwidthRatedUnqueue pulls packets while the bucket has tokens, up
+ * to BURST packets, and pushes them downstream as a batch.  Default is 32.
+ *
+ * =item SHARED
+ *
+ * The name of a BandwidthSharedTokenBucket element.  If specified, BandwidthRatedUnqueue
+ * takes its tokens from that shared bucket, whose rate may be shared with
+ * rate limiters on other threads, and RATE and the burst options must not be
+ * given.
+ *
  * =h rate read/write
  *
- * =a RatedUnqueue, Unqueue, BandwidthShaper, BandwidthRatedSplitter */
+ * =a RatedUnqueue, Unqueue, BandwidthShaper, BandwidthRatedSplitter,
+ * BandwidthSharedTokenBucket */
 
 class BandwidthRatedUnqueue : public RatedUnqueue { public:
 
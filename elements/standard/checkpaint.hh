@@ -21,7 +21,7 @@ depending on how many outputs were used.
 CheckPaint uses the packet's PAINT annotation by default, but the ANNO
 argument can specify any one-byte annotation.
 
-=a Paint, PaintTee */
+=a Paint, PaintTee, AnnotationSwitch */
 
 class CheckPaint : public Element { public:
 
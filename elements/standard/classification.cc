@@ -23,6 +23,20 @@
 #include <click/error.hh>
 #include <click/straccum.hh>
 #include <click/standard/alignmentinfo.hh>
+#include <click/element.hh>
+#include <click/packetbatch.hh>
+#if HAVE_CLASSIFICATION_JIT
+# include <click/perfmap.hh>
+# include <sys/mman.h>
+#endif
+#if CLICK_USERLEVEL && defined(__SSE2__)
+# define HAVE_CLASSIFICATION_SSE2 1
+# include <emmintrin.h>
+# if defined(__AVX2__) && defined(__x86_64__)
+#  define HAVE_CLASSIFICATION_AVX2 1
+#  include <immintrin.h>
+# endif
+#endif
 CLICK_DECLS
 namespace Classification {
 namespace Wordwise {
@@ -875,6 +889,65 @@ Program::bubble_sort_and_exprs(const int *offset_map_begin,
     }
 }
 
+/** @brief Reorder chains of tests so that the likeliest exit is tested first.
+ * @param counts counts[2*i + k] is how often step i took branch k; updated
+ *   to follow the steps as they move
+ *
+ * A chain is a step whose branch k leads to a step with no other
+ * predecessors, where both steps share their other branch, as in
+ * bubble_sort_and_exprs().  Such steps compute "A and B" or "A or B", so
+ * they can be tested in either order.  This puts first the step that more
+ * often leaves the chain, which shortens the common path for the traffic
+ * that produced @a counts. */
+void
+Program::reorder_by_profile(Vector<uint64_t> &counts)
+{
+    assert(counts.size() == 2 * _insn.size());
+    // count_inbranches() can't tell step 0 from "several", so count here
+    Vector<int> npred(_insn.size(), 0), pred(_insn.size(), -1);
+    for (int i = 0; i < _insn.size(); i++)
+	for (int k = 0; k < 2; k++)
+	    if (_insn[i].j[k] > 0) {
+		++npred[_insn[i].j[k]];
+		pred[_insn[i].j[k]] = i;
+	    }
+
+    for (int i = 0; i < _insn.size(); i++) {
+	Insn &e1 = _insn[i];
+	for (int k = 0; k < 2; k++) {
+	    int j = e1.j[k];
+	    if (j <= 0 || npred[j] != 1)
+		continue;
+	    Insn &e2 = _insn[j];
+	    if (e1.j[!k] != e2.j[!k])
+		continue;
+	    // compare exit rates, exits2/total2 > exits1/total1, in 64 bits
+	    uint64_t exits1 = counts[2*i + !k], total1 = exits1 + counts[2*i + k],
+		exits2 = counts[2*j + !k], total2 = exits2 + counts[2*j + k];
+	    while ((total1 | total2) >> 32) {
+		exits1 >>= 1, total1 >>= 1;
+		exits2 >>= 1, total2 >>= 1;
+	    }
+	    if (total2 != 0
+		&& (total1 == 0 || exits2 * total1 > exits1 * total2)) {
+		Insn temp(e2);
+		e2 = e1;
+		e2.j[k] = temp.j[k];
+		e1 = temp;
+		e1.j[k] = j;
+		for (int b = 0; b < 2; ++b) {
+		    uint64_t c = counts[2*i + b];
+		    counts[2*i + b] = counts[2*j + b];
+		    counts[2*j + b] = c;
+		}
+		// step backwards to continue the sort
+		i = (npred[i] == 1 ? pred[i] - 1 : i - 1);
+		break;
+	    }
+	}
+    }
+}
+
 void
 Program::optimize(const int *offset_map_begin,
 		  const int *offset_map_end,
@@ -960,7 +1033,7 @@ Program::unparse() const
 
 void
 CompressedProgram::compile(const Program &prog, bool perform_binary_search,
-			   unsigned min_binary_search)
+			   unsigned min_binary_search, unsigned min_hash_search)
 {
     // Compress the program into "zprog."
 
@@ -989,6 +1062,17 @@ CompressedProgram::compile(const Program &prog, bool perform_binary_search,
     // value is <= 0, it is the negative of the relevant IPFilter output port.
     // A positive 'jump' value equals the number of 32-bit words to move the
     // instruction pointer.
+    //
+    // Tests with at least 'min_hash_search' values are instead hash sets,
+    // marked by nval == 0, so that long alternations cost about one probe:
+    //
+    // +----------+--------+--------+--------+--------+--------+-------
+    // |  0 |S|off|   no   |   yes  |  mask  |  bits  |  empty | slot...
+    // +----------+--------+--------+--------+--------+--------+-------
+    // bits (32 bits)  - log2 of the number of slots
+    // empty (32 bits) - a value that is not in the set, marking empty slots
+    // slot (32 bits)  - open-addressed table of 2^bits slots, at most half
+    //                   full; see hash_contains()
 
     // It often helps to do another bubblesort for things like ports.
 
@@ -996,6 +1080,7 @@ CompressedProgram::compile(const Program &prog, bool perform_binary_search,
     _output_everything = prog.output_everything();
     _safe_length = prog.safe_length();
     _align_offset = prog.align_offset();
+    _min_binary_search = (perform_binary_search ? min_binary_search : -1U);
 
     Vector<int> wanted(prog.ninsn() + 1, 0);
     wanted[0] = 1;
@@ -1017,18 +1102,25 @@ CompressedProgram::compile(const Program &prog, bool perform_binary_search,
 	_zprog.push_back(in.yes());
 	_zprog.push_back(in.mask.u);
 	_zprog.push_back(in.value.u);
+	unsigned nval = 1;
 	int no;
 	while ((no = (int32_t) _zprog[off+1]) > 0 && wanted[no] == 1
 	       && prog.insn(no).yes() == in.yes()
 	       && prog.insn(no).offset == in.offset
-	       && prog.insn(no).mask.u == in.mask.u) {
-	    _zprog[off] += 0x20000;
+	       && prog.insn(no).mask.u == in.mask.u
+	       && (nval < max_values || min_hash_search <= max_values)) {
+	    ++nval;
 	    _zprog[off+1] = prog.insn(no).no();
 	    _zprog.push_back(prog.insn(no).value.u);
 	    wanted[no]--;
 	}
-	if (perform_binary_search && (_zprog[off] >> 17) >= min_binary_search)
-	    click_qsort(&_zprog[off+4], _zprog[off] >> 17);
+	if (nval >= min_hash_search)
+	    make_hash_set(off, nval);
+	else {
+	    _zprog[off] += (nval - 1) << 17;
+	    if (perform_binary_search && nval >= min_binary_search)
+		click_qsort(&_zprog[off+4], nval);
+	}
     }
     offsets.push_back(_zprog.size());
 
@@ -1042,6 +1134,44 @@ CompressedProgram::compile(const Program &prog, bool perform_binary_search,
 	}
 }
 
+// Replace the nval values at the end of _zprog, which belong to the test at
+// off, with a hash set.
+void
+CompressedProgram::make_hash_set(int off, unsigned nval)
+{
+    Vector<uint32_t> values;
+    for (int i = off + 4; i < _zprog.size(); ++i)
+	values.push_back(_zprog[i]);
+    click_qsort(values.begin(), values.size());
+    uint32_t mask = _zprog[off+3], empty = ~mask;
+    if (mask == 0xFFFFFFFFU) {
+	// find the smallest value that is not in the set
+	empty = 0;
+	for (uint32_t *v = values.begin(); v != values.end() && *v <= empty; ++v)
+	    if (*v == empty)
+		++empty;
+    }
+
+    unsigned bits = 1;
+    while ((1U << bits) < 2 * nval)
+	++bits;
+    uint32_t tmask = (1U << bits) - 1;
+    _zprog.resize(off + 6 + (1U << bits));
+    _zprog[off] &= 0x1FFFF;	// nval = 0
+    _zprog[off+4] = bits;
+    _zprog[off+5] = empty;
+    uint32_t *table = &_zprog[off+6];
+    for (uint32_t i = 0; i <= tmask; ++i)
+	table[i] = empty;
+    for (uint32_t *v = values.begin(); v != values.end(); ++v)
+	if (v == values.begin() || v[-1] != *v) {
+	    uint32_t i = hash_slot(*v, bits);
+	    while (table[i] != empty)
+		i = (i + 1) & tmask;
+	    table[i] = *v;
+	}
+}
+
 void
 CompressedProgram::warn_unused_outputs(int noutputs, ErrorHandler *errh) const
 {
@@ -1055,7 +1185,7 @@ CompressedProgram::warn_unused_outputs(int noutputs, ErrorHandler *errh) const
 		if (output <= 0 && -output < noutputs)
 		    used[-output] = 1;
 	    }
-	    i += 4 + (_zprog[i] >> 17);
+	    i += insn_words(&_zprog[i]);
 	}
 
     for (int i = 0; i < noutputs; ++i)
@@ -1063,20 +1193,40 @@ CompressedProgram::warn_unused_outputs(int noutputs, ErrorHandler *errh) const
 	    errh->warning("output %d matches no packets", i);
 }
 
+// Set values to the values of the test at pr, sorted if it is a hash set.
+static void
+test_values(const uint32_t *pr, Vector<uint32_t> &values)
+{
+    values.clear();
+    if (unsigned nvalues = pr[0] >> 17) {
+	for (unsigned i = 0; i < nvalues; ++i)
+	    values.push_back(pr[4 + i]);
+    } else {
+	for (unsigned i = 0; i < (1U << pr[4]); ++i)
+	    if (pr[6 + i] != pr[5])
+		values.push_back(pr[6 + i]);
+	click_qsort(values.begin(), values.size());
+    }
+}
+
 String
 CompressedProgram::unparse() const
 {
+    // Hash sets are listed as their sorted values, one step per value.
     Vector<int> stepno(_zprog.size(), 0);
+    Vector<uint32_t> values;
     for (int i = 0; i < _zprog.size(); ) {
-	int nparts = _zprog[i] >> 17;
-	if (i + 4 + nparts < _zprog.size())
-	    stepno[i + 4 + nparts] = stepno[i] + nparts;
-	i += 4 + nparts;
+	test_values(&_zprog[i], values);
+	int next = i + insn_words(&_zprog[i]);
+	if (next < _zprog.size())
+	    stepno[next] = stepno[i] + values.size();
+	i = next;
     }
 
     StringAccum sa;
     for (int i = 0; i < _zprog.size(); ) {
-	int nparts = _zprog[i] >> 17;
+	test_values(&_zprog[i], values);
+	int nparts = values.size();
 	for (int j = 0; j < nparts; ++j) {
 	    int mystep = stepno[i] + j;
 	    int32_t no, yes;
@@ -1087,11 +1237,11 @@ CompressedProgram::unparse() const
 	    if ((yes = _zprog[i + 2]) > 0)
 		yes = stepno[i + yes];
 	    Insn in((uint16_t) _zprog[i] - _align_offset,
-		    _zprog[i + 4 + j], _zprog[i + 3], no, yes,
+		    values[j], _zprog[i + 3], no, yes,
 		    _zprog[i] & 0x10000);
 	    sa << (mystep < 10 ? " " : "") << mystep << ' ' << in << '\n';
 	}
-	i += 4 + nparts;
+	i += insn_words(&_zprog[i]);
     }
     if (_zprog.size() == 0)
 	sa << "all->[" << _output_everything << "]\n";
@@ -1101,6 +1251,287 @@ CompressedProgram::unparse() const
 }
 
 
+//
+// NATIVE CODE
+//
+
+#if HAVE_CLASSIFICATION_JIT
+namespace {
+
+// Generates x86-64 code for a CompressedProgram.  The generated function
+// takes three base pointers in %rdi, %rsi, and %rdx, following the System V
+// calling convention, and returns the output port in %eax.  Each test loads
+// one word into %eax, masks it, and compares it against the test's values,
+// using a binary decision tree for long value lists.  Hash-set tests probe a
+// copy of the test's table, placed after the code, using %ecx, %r8, and %r9.
+
+class X86Assembler { public:
+
+    X86Assembler(const uint32_t *zprog, int nwords)
+	: _zprog(zprog), _nwords(nwords), _label(nwords, -1) {
+    }
+
+    void assemble(int offset_net, int offset_transp);
+
+    const unsigned char *data() const {
+	return _code.begin();
+    }
+    int size() const {
+	return _code.size();
+    }
+
+  private:
+
+    enum { linear_search_max = 4 };
+
+    // Jump targets are word indexes in the program if positive, and
+    // negated output ports otherwise, as in the compressed program.
+    struct Fixup {
+	int pos;
+	int32_t target;
+	Fixup(int pos_, int32_t target_)
+	    : pos(pos_), target(target_) {
+	}
+    };
+
+    const uint32_t *_zprog;
+    int _nwords;
+    Vector<unsigned char> _code;
+    Vector<int> _label;
+    Vector<int32_t> _outputs;
+    Vector<int> _output_label;
+    Vector<Fixup> _fixups;
+    Vector<int> _table_fixups;	// position of each hash-set lea's disp32
+    Vector<const uint32_t *> _tables;
+
+    void emit8(unsigned char x) {
+	_code.push_back(x);
+    }
+    void emit32(uint32_t x) {
+	for (int i = 0; i < 4; ++i, x >>= 8)
+	    _code.push_back(x & 0xFF);
+    }
+    void patch32(int pos, int32_t x) {
+	uint32_t u = x;
+	for (int i = 0; i < 4; ++i, u >>= 8)
+	    _code[pos + i] = u & 0xFF;
+    }
+    // Emit a jump with a 32-bit displacement; return the displacement's
+    // position.
+    int emit_jump(unsigned char op0, unsigned char op1 = 0) {
+	emit8(op0);
+	if (op1)
+	    emit8(op1);
+	emit32(0);
+	return _code.size() - 4;
+    }
+    void emit_jump_to(int32_t target, unsigned char op0, unsigned char op1 = 0) {
+	_fixups.push_back(Fixup(emit_jump(op0, op1), target));
+    }
+    void emit_search(const uint32_t *values, int nvalues, int32_t yes, int32_t no);
+    void emit_hash_search(const uint32_t *pr, int32_t yes, int32_t no);
+
+};
+
+void
+X86Assembler::emit_search(const uint32_t *v, int n, int32_t yes, int32_t no)
+{
+    if (n <= linear_search_max) {
+	for (int i = 0; i < n; ++i) {
+	    emit8(0x3D);		// cmp $v[i], %eax
+	    emit32(v[i]);
+	    emit_jump_to(yes, 0x0F, 0x84); // je yes
+	}
+	return;
+    }
+    // v is sorted: test the middle value, then search one half.
+    int mid = n / 2;
+    emit8(0x3D);		// cmp $v[mid], %eax
+    emit32(v[mid]);
+    emit_jump_to(yes, 0x0F, 0x84); // je yes
+    int below = emit_jump(0x0F, 0x82); // jb below
+    emit_search(v + mid + 1, n - mid - 1, yes, no);
+    emit_jump_to(no, 0xE9);	// jmp no
+    patch32(below, _code.size() - (below + 4));
+    emit_search(v, mid, yes, no);
+}
+
+void
+X86Assembler::emit_hash_search(const uint32_t *pr, int32_t yes, int32_t no)
+{
+    unsigned bits = pr[4];
+    uint32_t empty = pr[5];
+    emit8(0x69);		// imul $K, %eax, %ecx
+    emit8(0xC8);
+    emit32(CompressedProgram::hash_multiplier);
+    emit8(0xC1);		// shr $(32 - bits), %ecx
+    emit8(0xE9);
+    emit8(32 - bits);
+    emit8(0x4C);		// lea table(%rip), %r8
+    emit8(0x8D);
+    emit8(0x05);
+    _table_fixups.push_back(_code.size());
+    _tables.push_back(pr);
+    emit32(0);
+
+    int loop = _code.size();
+    emit8(0x45);		// mov (%r8,%rcx,4), %r9d
+    emit8(0x8B);
+    emit8(0x0C);
+    emit8(0x88);
+    emit8(0x41);		// cmp %eax, %r9d
+    emit8(0x39);
+    emit8(0xC1);
+    emit8(0x75);		// jne notfound
+    emit8(16);
+    emit8(0x3D);		// cmp $empty, %eax
+    emit32(empty);
+    emit_jump_to(yes, 0x0F, 0x85); // jne yes
+    emit_jump_to(no, 0xE9);	// jmp no
+    // notfound:
+    emit8(0x41);		// cmp $empty, %r9d
+    emit8(0x81);
+    emit8(0xF9);
+    emit32(empty);
+    emit_jump_to(no, 0x0F, 0x84); // je no
+    emit8(0xFF);		// inc %ecx
+    emit8(0xC1);
+    emit8(0x81);		// and $(2^bits - 1), %ecx
+    emit8(0xE1);
+    emit32((1U << bits) - 1);
+    emit8(0xEB);		// jmp loop
+    emit8(loop - (int) (_code.size() + 1));
+}
+
+void
+X86Assembler::assemble(int offset_net, int offset_transp)
+{
+    Vector<uint32_t> values;
+    for (int i = 0; i < _nwords; ) {
+	_label[i] = _code.size();
+	int off = (int16_t) _zprog[i];
+	int nvalues = _zprog[i] >> 17;
+	int32_t no = _zprog[i + 1], yes = _zprog[i + 2];
+	uint32_t mask = _zprog[i + 3];
+	int next = i + CompressedProgram::insn_words(_zprog + i);
+
+	// mov disp32(%base), %eax
+	emit8(0x8B);
+	if (off >= offset_transp) {
+	    emit8(0x82);	// %rdx
+	    off -= offset_transp;
+	} else if (off >= offset_net) {
+	    emit8(0x86);	// %rsi
+	    off -= offset_net;
+	} else
+	    emit8(0x87);	// %rdi
+	emit32(off);
+	if (mask != 0xFFFFFFFFU) {
+	    emit8(0x25);	// and $mask, %eax
+	    emit32(mask);
+	}
+
+	if (yes > 0)
+	    yes += i;
+	if (no > 0)
+	    no += i;
+	if (nvalues) {
+	    values.clear();
+	    for (int j = i + 4; j < next; ++j)
+		values.push_back(_zprog[j]);
+	    click_qsort(values.begin(), values.size());
+	    emit_search(values.begin(), values.size(), yes, no);
+	} else
+	    emit_hash_search(_zprog + i, yes, no);
+	if (no != next)
+	    emit_jump_to(no, 0xE9); // jmp no
+	i = next;
+    }
+
+    // Return stubs, one per output.  Output numbers can be very large
+    // (-j_never means "drop"), so look them up linearly.
+    for (const Fixup *f = _fixups.begin(); f != _fixups.end(); ++f) {
+	int dest;
+	if (f->target > 0)
+	    dest = _label[f->target];
+	else {
+	    int k = 0;
+	    while (k < _outputs.size() && _outputs[k] != f->target)
+		++k;
+	    if (k == _outputs.size()) {
+		_outputs.push_back(f->target);
+		_output_label.push_back(_code.size());
+		emit8(0xB8);	// mov $output, %eax
+		emit32(-f->target);
+		emit8(0xC3);	// ret
+	    }
+	    dest = _output_label[k];
+	}
+	assert(dest >= 0);
+	patch32(f->pos, dest - (f->pos + 4));
+    }
+
+    // Hash-set tables, aligned.
+    for (int t = 0; t < _tables.size(); ++t) {
+	while (_code.size() % 4)
+	    emit8(0xCC);	// int3
+	patch32(_table_fixups[t], _code.size() - (_table_fixups[t] + 4));
+	const uint32_t *pr = _tables[t];
+	for (unsigned k = 0; k < (1U << pr[4]); ++k)
+	    emit32(pr[6 + k]);
+    }
+}
+
+}
+#endif
+
+bool
+NativeProgram::compile(const CompressedProgram &zprog,
+		       int offset_net, int offset_transp, const Element *owner)
+{
+    clear();
+#if HAVE_CLASSIFICATION_JIT
+    if (zprog.output_everything() >= 0 || zprog.begin() == zprog.end())
+	return false;
+
+    X86Assembler a(zprog.begin(), zprog.end() - zprog.begin());
+    a.assemble(offset_net, offset_transp);
+
+    size_t size = a.size();
+    void *code = mmap(0, size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+	return false;
+    memcpy(code, a.data(), size);
+    if (mprotect(code, size, PROT_READ | PROT_EXEC) < 0) {
+	munmap(code, size);
+	return false;
+    }
+    _code = code;
+    _code_size = size;
+    _fn = reinterpret_cast<function_type>(code);
+    if (PerfMap::enabled())
+	PerfMap::add(code, size, owner ? owner->declaration() : String::make_stable("classifier program"));
+    return true;
+#else
+    (void) zprog, (void) offset_net, (void) offset_transp, (void) owner;
+    return false;
+#endif
+}
+
+void
+NativeProgram::clear()
+{
+#if HAVE_CLASSIFICATION_JIT
+    if (_code)
+	munmap(_code, _code_size);
+#endif
+    _code = 0;
+    _code_size = 0;
+    _fn = 0;
+}
+
+
 //
 // RUNNING
 //
@@ -1139,6 +1570,176 @@ Program::length_checked_match(const Packet *p)
     return -pos;
 }
 
-}}
+// Load the words at addr[0...n-1] into words[0...n-1].
+static inline void
+load_words(uint32_t *words, const unsigned char * const *addr, int n)
+{
+    int i = 0;
+#if HAVE_CLASSIFICATION_AVX2
+    for (; i + 4 <= n; i += 4) {
+	__m256i a = _mm256_loadu_si256((const __m256i *) (addr + i));
+	_mm_storeu_si128((__m128i *) (words + i),
+			 _mm256_i64gather_epi32((const int *) 0, a, 1));
+    }
+#endif
+    for (; i < n; ++i)
+	words[i] = *(const uint32_t *) addr[i];
+}
+
+// Return a bitmask of the words[0...n-1] that, masked, equal one of the
+// values.  words must have room for CompressedProgram::max_lanes words.
+static inline unsigned
+match_words(const uint32_t *words, int n, uint32_t mask,
+	    const uint32_t *values, int nvalues)
+{
+    unsigned matched = 0;
+#if HAVE_CLASSIFICATION_AVX2
+    __m256i vmask = _mm256_set1_epi32(mask);
+    for (int i = 0; i < n; i += 8) {
+	__m256i d = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (words + i)), vmask);
+	__m256i eq = _mm256_setzero_si256();
+	for (int k = 0; k < nvalues; ++k)
+	    eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(d, _mm256_set1_epi32(values[k])));
+	matched |= (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(eq)) << i;
+    }
+#elif HAVE_CLASSIFICATION_SSE2
+    __m128i vmask = _mm_set1_epi32(mask);
+    for (int i = 0; i < n; i += 4) {
+	__m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i *) (words + i)), vmask);
+	__m128i eq = _mm_setzero_si128();
+	for (int k = 0; k < nvalues; ++k)
+	    eq = _mm_or_si128(eq, _mm_cmpeq_epi32(d, _mm_set1_epi32(values[k])));
+	matched |= (unsigned) _mm_movemask_ps(_mm_castsi128_ps(eq)) << i;
+    }
+#else
+    for (int i = 0; i < n; ++i) {
+	uint32_t d = words[i] & mask;
+	for (int k = 0; k < nvalues; ++k)
+	    if (d == values[k]) {
+		matched |= 1U << i;
+		break;
+	    }
+    }
+#endif
+    return matched & ((1U << n) - 1);
+}
+
+// As match_words, for sorted values.
+static inline unsigned
+search_words(const uint32_t *words, int n, uint32_t mask,
+	     const uint32_t *values, int nvalues)
+{
+    unsigned matched = 0;
+    for (int i = 0; i < n; ++i) {
+	uint32_t d = words[i] & mask;
+	const uint32_t *l = values, *r = values + nvalues;
+	while (l < r) {
+	    const uint32_t *m = l + (r - l) / 2;
+	    if (*m == d) {
+		matched |= 1U << i;
+		break;
+	    } else if (*m < d)
+		l = m + 1;
+	    else
+		r = m;
+	}
+    }
+    return matched;
+}
+
+void
+CompressedProgram::match_lanes(int n, const unsigned char * const *data,
+			       const unsigned char * const *net_data,
+			       const unsigned char * const *transp_data,
+			       int *outputs, int offset_net,
+			       int offset_transp) const
+{
+    assert(n <= max_lanes && _output_everything < 0);
+    const uint32_t *zprog = _zprog.begin();
+    int pc[max_lanes], active[max_lanes], group[max_lanes];
+    const unsigned char *addr[max_lanes];
+    uint32_t words[max_lanes];
+    memset(words, 0, sizeof(words));
+
+    int nactive = n;
+    for (int i = 0; i < n; ++i) {
+	pc[i] = 0;
+	active[i] = i;
+    }
+
+    while (nactive) {
+	// Evaluate together all packets at the first active packet's test.
+	int cur = pc[active[0]], ngroup = 0, nrest = 0;
+	for (int k = 0; k < nactive; ++k) {
+	    int lane = active[k];
+	    if (pc[lane] == cur)
+		group[ngroup++] = lane;
+	    else
+		active[nrest++] = lane;
+	}
+	nactive = nrest;
+
+	const uint32_t *pr = zprog + cur;
+	int off = (int16_t) pr[0];
+	unsigned nvalues = pr[0] >> 17;
+	const unsigned char * const *base;
+	if (off >= offset_transp) {
+	    base = transp_data;
+	    off -= offset_transp;
+	} else if (off >= offset_net) {
+	    base = net_data;
+	    off -= offset_net;
+	} else
+	    base = data;
+	for (int g = 0; g < ngroup; ++g)
+	    addr[g] = base[group[g]] + off;
+	load_words(words, addr, ngroup);
+
+	unsigned matched = 0;
+	if (!nvalues) {
+	    for (int g = 0; g < ngroup; ++g)
+		if (hash_contains(pr, words[g] & pr[3]))
+		    matched |= 1U << g;
+	} else if (nvalues >= _min_binary_search)
+	    matched = search_words(words, ngroup, pr[3], pr + 4, nvalues);
+	else
+	    matched = match_words(words, ngroup, pr[3], pr + 4, nvalues);
+
+	for (int g = 0; g < ngroup; ++g) {
+	    int lane = group[g];
+	    int32_t j = pr[1 + ((matched >> g) & 1)];
+	    if (j <= 0)
+		outputs[lane] = -j;
+	    else {
+		pc[lane] = cur + j;
+		active[nactive++] = lane;
+	    }
+	}
+    }
+}
+
+}
+
+void
+push_batch_by_output(const Element *e, Packet **p, int *outputs, int n)
+{
+    for (int i = 0; i < n; ++i) {
+	int port = outputs[i];
+	if (port < 0)
+	    continue;
+	PacketBatch batch;
+	for (int j = i; j < n; ++j)
+	    if (outputs[j] == port) {
+		batch.push_back(p[j]);
+		outputs[j] = -1;
+	    }
+	if (port < e->noutputs())
+	    e->output(port).push_batch(batch);
+	else
+	    batch.kill();
+    }
+}
+
+}
 CLICK_ENDDECLS
 ELEMENT_PROVIDES(Classification)
@@ -3,8 +3,12 @@
 #define CLICK_CLASSIFICATION_WORDWISE_DOMINATOR_FASTPRED 1
 #include <click/packet.hh>
 #include <click/vector.hh>
+#if CLICK_USERLEVEL && defined(__x86_64__)
+# define HAVE_CLASSIFICATION_JIT 1
+#endif
 CLICK_DECLS
 class ErrorHandler;
+class Element;
 namespace Classification {
 
 enum Jumps {
@@ -23,6 +27,15 @@ enum {
     offset_max = 0x7FFFFFFF
 };
 
+/** @brief Push packets to @a e's outputs, one batch per output port.
+ * @param p packets
+ * @param outputs output port for each packet; clobbered
+ * @param n number of packets
+ *
+ * Packets with the same output stay in order.  Packets with out-of-range
+ * outputs are killed, as with Element::checked_output_push(). */
+void push_batch_by_output(const Element *e, Packet **p, int *outputs, int n);
+
 namespace Wordwise {
 
 class DominatorOptimizer;
@@ -194,6 +207,7 @@ class Program { public:
     void count_inbranches(Vector<int> &inbranches) const;
     void bubble_sort_and_exprs(const int *offset_map_begin, const int *offset_map_end, int last_offset);
     void optimize(const int *offset_map_begin, const int *offset_map_end, int last_offset);
+    void reorder_by_profile(Vector<uint64_t> &counts);
 
     void warn_unused_outputs(int noutputs, ErrorHandler *errh) const;
 
@@ -223,7 +237,7 @@ class CompressedProgram { public:
 
     CompressedProgram()
 	: _output_everything(-j_never), _safe_length((unsigned) -1),
-	  _align_offset(0) {
+	  _align_offset(0), _min_binary_search(-1U) {
     }
 
     unsigned align_offset() const {
@@ -244,10 +258,52 @@ class CompressedProgram { public:
     }
 
     void compile(const Program &prog, bool perform_binary_search,
-		 unsigned min_binary_search);
+		 unsigned min_binary_search, unsigned min_hash_search = -1U);
 
     void warn_unused_outputs(int noutputs, ErrorHandler *errh) const;
 
+    /** @brief Return the number of words in the test at @a pr. */
+    static inline unsigned insn_words(const uint32_t *pr) {
+	unsigned nvalues = pr[0] >> 17;
+	return nvalues ? 4 + nvalues : 6 + (1U << pr[4]);
+    }
+    /** @brief Return true iff @a data is in the hash-set test at @a pr.
+     *
+     * @a data must already be masked.  See compile() for the layout. */
+    static inline bool hash_contains(const uint32_t *pr, uint32_t data) {
+	uint32_t tmask = (1U << pr[4]) - 1, empty = pr[5];
+	for (uint32_t i = hash_slot(data, pr[4]); ; i = (i + 1) & tmask)
+	    if (pr[6 + i] == data)
+		return data != empty;
+	    else if (pr[6 + i] == empty)
+		return false;
+    }
+    /** @brief Return the first slot for @a data in a 2^@a bits table. */
+    static inline uint32_t hash_slot(uint32_t data, unsigned bits) {
+	return (data * hash_multiplier) >> (32 - bits);
+    }
+    static const uint32_t hash_multiplier = 0x9E3779B1U;
+
+    enum { max_lanes = 16 };
+    /** @brief Run the program over @a n packets at once.
+     * @param n number of packets, at most max_lanes
+     * @param data first base pointer for each packet
+     * @param net_data second base pointer for each packet, or null
+     * @param transp_data third base pointer for each packet, or null
+     * @param[out] outputs output port for each packet
+     *
+     * Base pointers are interpreted as described for
+     * NativeProgram::compile(), using @a offset_net and @a offset_transp.
+     * Packets that reach the same test are evaluated together, using SIMD
+     * loads and compares where available.  Like NativeProgram, this does
+     * not check packet lengths: every packet must be at least safe_length()
+     * bytes long, and output_everything() must be negative. */
+    void match_lanes(int n, const unsigned char * const *data,
+		     const unsigned char * const *net_data,
+		     const unsigned char * const *transp_data,
+		     int *outputs, int offset_net = offset_max,
+		     int offset_transp = offset_max) const;
+
     String unparse() const;
 
   private:
@@ -256,6 +312,83 @@ class CompressedProgram { public:
     int _output_everything;
     unsigned _safe_length;
     unsigned _align_offset;
+    unsigned _min_binary_search;
+
+    enum { max_values = 0x7FFF };	// nval is 15 bits
+
+    void make_hash_set(int off, unsigned nval);
+
+};
+
+
+/** @brief A CompressedProgram translated into native machine code.
+ *
+ * NativeProgram generates code for a CompressedProgram when the program is
+ * built, so that matching a packet is a direct call to a decision tree of
+ * compare-and-branch instructions.  Code generation is only supported at
+ * user level on x86-64; elsewhere, and if executable memory cannot be
+ * obtained, compile() returns false and callers should use the interpreter.
+ *
+ * Compiled code does not check packet lengths.  Callers must use the
+ * interpreter for packets shorter than the program's safe_length(), and for
+ * programs with an output_everything() value.
+ */
+class NativeProgram { public:
+
+    NativeProgram()
+	: _code(0), _code_size(0) {
+    }
+    ~NativeProgram() {
+	clear();
+    }
+
+    /** @brief Compile @a zprog into native code.
+     * @param offset_net offset of the first word relative to the second base
+     *   pointer passed to match()
+     * @param offset_transp offset of the first word relative to the third
+     *   base pointer passed to match()
+     * @param owner element whose program this is, if any
+     * @return true if compilation succeeded
+     *
+     * A word at program offset @a off is loaded from the first base pointer
+     * + @a off if @a off < @a offset_net, from the second base pointer + (@a
+     * off - @a offset_net) if @a offset_net <= @a off < @a offset_transp,
+     * and from the third base pointer + (@a off - @a offset_transp)
+     * otherwise.
+     *
+     * The generated code is registered with PerfMap under @a owner's
+     * declaration, so profiles name the element it belongs to. */
+    bool compile(const CompressedProgram &zprog,
+		 int offset_net = offset_max, int offset_transp = offset_max,
+		 const Element *owner = 0);
+    void clear();
+
+    bool ok() const {
+	return _code != 0;
+    }
+    size_t code_size() const {
+	return _code_size;
+    }
+
+    int match(const unsigned char *data) const {
+	return _fn(data, 0, 0);
+    }
+    int match(const unsigned char *data, const unsigned char *net_data,
+	      const unsigned char *transp_data) const {
+	return _fn(data, net_data, transp_data);
+    }
+
+  private:
+
+    typedef int (*function_type)(const unsigned char *, const unsigned char *,
+				 const unsigned char *);
+
+    void *_code;
+    size_t _code_size;
+    function_type _fn;
+
+    NativeProgram(const NativeProgram &);
+    NativeProgram &operator=(const NativeProgram &);
 
 };
 
@@ -20,14 +20,17 @@
 
 #include <click/config.h>
 #include "classifier.hh"
+#include <click/packetbatch.hh>
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/confparse.hh>
+#include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/standard/alignmentinfo.hh>
 CLICK_DECLS
 
 Classifier::Classifier()
+    : _profiling(false)
 {
 }
 
@@ -35,6 +38,14 @@ Classifier::~Classifier()
 {
 }
 
+void
+Classifier::static_initialize()
+{
+#if HAVE_DIRECT_PORT_TRANSFER
+    add_direct_push("Classifier", direct_push<Classifier>);
+#endif
+}
+
 Classification::Wordwise::Program
 Classifier::empty_program(ErrorHandler *errh) const
 {
@@ -222,6 +233,9 @@ Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
     if (!errh->nerrors()) {
 	prog.warn_unused_outputs(noutputs(), errh);
 	_prog = prog;
+	_zprog.compile(_prog, false, 0);
+	_native.compile(_zprog, Classification::offset_max, Classification::offset_max, this);
+	_profile.assign(2 * _prog.ninsn(), 0);
 	return 0;
     } else
 	return -1;
@@ -234,16 +248,121 @@ Classifier::program_string(Element *element, void *)
     return c->_prog.unparse();
 }
 
+String
+Classifier::jit_handler(Element *element, void *)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    return String(c->_native.ok());
+}
+
+String
+Classifier::read_profile_handler(Element *element, void *thunk)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    if ((uintptr_t) thunk == h_profile)
+	return String(c->_profiling);
+    StringAccum sa;
+    for (int i = 0; i < c->_prog.ninsn(); ++i)
+	sa << i << ' ' << c->_profile[2*i] << ' ' << c->_profile[2*i + 1] << '\n';
+    return sa.take_string();
+}
+
+int
+Classifier::write_profile_handler(const String &str, Element *element,
+				  void *thunk, ErrorHandler *errh)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    if ((uintptr_t) thunk == h_profile) {
+	bool profiling;
+	if (!BoolArg().parse(str, profiling))
+	    return errh->error("syntax error");
+	if (profiling && !c->_profiling)
+	    c->_profile.assign(c->_profile.size(), 0);
+	c->_profiling = profiling;
+	return 0;
+    }
+
+    // reoptimize: build the new programs, then install them
+    Classification::Wordwise::Program prog(c->_prog);
+    Vector<uint64_t> counts(c->_profile);
+    prog.reorder_by_profile(counts);
+    Classification::Wordwise::CompressedProgram zprog;
+    zprog.compile(prog, false, 0);
+    c->_prog = prog;
+    c->_zprog = zprog;
+    c->_native.compile(c->_zprog, Classification::offset_max, Classification::offset_max, c);
+    c->_profile.assign(c->_profile.size(), 0);
+    return 0;
+}
+
 void
 Classifier::add_handlers()
 {
     add_read_handler("program", Classifier::program_string, 0, Handler::CALM);
+    add_read_handler("jit", Classifier::jit_handler, 0, Handler::CALM);
+    add_read_handler("profile", read_profile_handler, h_profile);
+    add_write_handler("profile", write_profile_handler, h_profile);
+    add_read_handler("profile_counts", read_profile_handler, h_profile_counts);
+    add_write_handler("reoptimize", write_profile_handler, h_reoptimize, Handler::BUTTON);
+}
+
+// Match p with the interpreter, counting each step's outcome.
+int
+Classifier::profile_match(const Packet *p)
+{
+    if (_prog.output_everything() >= 0 || p->length() < _prog.safe_length())
+	return _prog.match(p);
+    const unsigned char *data = p->data() - _prog.align_offset();
+    const Classification::Wordwise::Insn *ex = _prog.begin();
+    int pos = 0;
+    do {
+	uint32_t word = *(const uint32_t *) (data + ex[pos].offset);
+	bool yes = (word & ex[pos].mask.u) == ex[pos].value.u;
+	++_profile[2*pos + yes];
+	pos = ex[pos].j[yes];
+    } while (pos > 0);
+    return -pos;
 }
 
 void
 Classifier::push(int, Packet *p)
 {
-    checked_output_push(_prog.match(p), p);
+    if (unlikely(_profiling))
+	checked_output_push(profile_match(p), p);
+    else if (_native.ok() && p->length() >= _prog.safe_length())
+	checked_output_push(_native.match(p->data() - _prog.align_offset()), p);
+    else
+	checked_output_push(_prog.match(p), p);
+}
+
+void
+Classifier::push_batch(int, PacketBatch &batch)
+{
+    enum { max_lanes = Classification::Wordwise::CompressedProgram::max_lanes };
+    Packet *p[max_lanes];
+    const unsigned char *data[max_lanes];
+    int outputs[max_lanes], lane_index[max_lanes], lane_outputs[max_lanes];
+    bool lanes_ok = _zprog.output_everything() < 0 && !_profiling;
+
+    while (!batch.empty()) {
+	int n = 0, nlanes = 0;
+	for (; n < max_lanes && !batch.empty(); ++n) {
+	    p[n] = batch.pop_front();
+	    if (unlikely(_profiling))
+		outputs[n] = profile_match(p[n]);
+	    else if (lanes_ok && p[n]->length() >= _zprog.safe_length()) {
+		data[nlanes] = p[n]->data() - _zprog.align_offset();
+		lane_index[nlanes++] = n;
+	    } else
+		outputs[n] = _prog.match(p[n]);
+	}
+	if (nlanes) {
+	    _zprog.match_lanes(nlanes, data, 0, 0, lane_outputs);
+	    for (int i = 0; i < nlanes; ++i)
+		outputs[lane_index[i]] = lane_outputs[i];
+	}
+	Classification::push_batch_by_output(this, p, outputs, n);
+    }
 }
 
 CLICK_ENDDECLS
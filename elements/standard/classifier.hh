@@ -70,6 +70,36 @@ CLICK_DECLS
  *   safe length 22
  *   alignment offset 0
  *
+ * Classifier evaluates packets that arrive in a batch together, up to 16
+ * at a time, and passes them on in one batch per output port.  Packets
+ * following the same path through the program are tested with SIMD
+ * instructions where available.
+ *
+ * =h jit read-only
+ * Returns true if Classifier translated its program into native machine
+ * code.  This is supported at user level on x86-64.  Packets shorter than the
+ * program's safe length always use the interpreter.  With the userlevel
+ * driver's B<--perf-map> option, the generated code appears in profiles under
+ * the element's name.
+ *
+ * =h profile read/write
+ * Boolean.  While true, Classifier counts how often each program step's test
+ * succeeds and fails.  Profiled packets always use the interpreter, one at a
+ * time.  Writing true clears the counts.  Default is false.
+ *
+ * =h profile_counts read-only
+ * Returns one line per program step: the step number and how often its test
+ * failed and succeeded while profiling.
+ *
+ * =h reoptimize write-only
+ * Reorders the program using the profile counts, then clears them.  Where
+ * two steps combine tests with "and" or "or", the test that more often
+ * decides the result moves first, so the most common traffic takes the
+ * fewest steps.  Results do not change.  The new program is built beside the
+ * old one and installed as if by a live reconfiguration.  To reoptimize
+ * periodically, use a Script, for example "Script(write c.profile true,
+ * wait 10s, write c.reoptimize, loop)".
+ *
  * =a IPClassifier, IPFilter */
 
 class Classifier : public Element { public:
@@ -83,11 +113,13 @@ class Classifier : public Element { public:
     // this element needs AlignmentInfo, so supply the "A" flag
     const char *flags() const			{ return "A"; }
     bool can_live_reconfigure() const		{ return true; }
+    static void static_initialize();
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     void add_handlers();
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
     Classification::Wordwise::Program empty_program(ErrorHandler *errh) const;
     static void parse_program(Classification::Wordwise::Program &prog,
@@ -96,8 +128,18 @@ class Classifier : public Element { public:
   protected:
 
     Classification::Wordwise::Program _prog;
+    Classification::Wordwise::CompressedProgram _zprog;
+    Classification::Wordwise::NativeProgram _native;
+    bool _profiling;
+    Vector<uint64_t> _profile;
+
+    int profile_match(const Packet *p);
 
+    enum { h_profile, h_profile_counts, h_reoptimize };
     static String program_string(Element *, void *);
+    static String jit_handler(Element *, void *);
+    static String read_profile_handler(Element *, void *);
+    static int write_profile_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
 
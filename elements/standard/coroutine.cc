@@ -0,0 +1,101 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * coroutine.{cc,hh} -- tasks that run straight-line code between events
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "coroutine.hh"
+CLICK_DECLS
+
+Coroutine::Coroutine()
+    : _co_line(0), _owner(0), _task(task_hook, this), _timer(&_task)
+#if CLICK_USERLEVEL
+    , _co_fd(-1), _co_mask(0)
+#endif
+{
+}
+
+Coroutine::~Coroutine()
+{
+    if (_owner)
+	cancel_waits();
+}
+
+void
+Coroutine::initialize(Element *owner, bool schedule)
+{
+    _owner = owner;
+    _task.initialize(owner, schedule);
+    _timer.initialize(owner, true);
+}
+
+void
+Coroutine::cancel_waits()
+{
+    _timer.unschedule();
+#if CLICK_USERLEVEL
+    if (_co_fd >= 0) {
+	_owner->remove_select(_co_fd, _co_mask);
+	_co_fd = -1;
+    }
+#endif
+}
+
+void
+Coroutine::cleanup()
+{
+    if (_owner) {
+	cancel_waits();
+	_task.unschedule();
+    }
+    _co_line = -1;
+}
+
+void
+Coroutine::restart()
+{
+    cancel_waits();
+    _co_line = 0;
+    _task.reschedule();
+}
+
+#if CLICK_USERLEVEL
+void
+Coroutine::await_fd(int fd, int mask)
+{
+    _co_fd = fd;
+    _co_mask = mask;
+    _owner->add_select(fd, mask);
+}
+
+bool
+Coroutine::selected(int fd, int mask)
+{
+    if (fd != _co_fd || !(mask & _co_mask))
+	return false;
+    // one-shot: later readiness is for the next CLICK_CO_AWAIT_FD
+    _owner->remove_select(_co_fd, _co_mask);
+    _co_fd = -1;
+    _task.reschedule();
+    return true;
+}
+#endif
+
+bool
+Coroutine::task_hook(Task *, void *user_data)
+{
+    return static_cast<Coroutine *>(user_data)->run();
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(Coroutine)
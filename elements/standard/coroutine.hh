@@ -0,0 +1,179 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_COROUTINE_HH
+#define CLICK_COROUTINE_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/** @class Coroutine
+ * @brief A Task that runs straight-line code which waits for events.
+ *
+ * Protocol and control-plane elements often wait: for a timer, for a reply,
+ * for a file descriptor, for a queue to fill.  Written with Tasks and Timers
+ * directly, every wait becomes a state in a hand-written state machine.  A
+ * Coroutine lets the element write the sequence as one function, run(), that
+ * suspends at each wait and resumes at the same place when the event fires.
+ *
+ * Coroutines are stackless.  run() is a subclass method whose body lies
+ * between CLICK_CO_BEGIN and CLICK_CO_END, and the wait macros return from
+ * run() after recording where to resume.  State that must survive a wait
+ * therefore lives in members of the subclass, not in local variables; the
+ * subclass object is the coroutine's frame.  An element with a fixed number
+ * of coroutines makes them members.  One that starts a coroutine per peer or
+ * per query allocates them from a SizedHashAllocator, like other per-flow
+ * state.  This works in every driver and needs no compiler support.
+ *
+ * A Coroutine owns a Task, which runs run(), and a Timer, which reschedules
+ * the Task when it fires.  Waits are:
+ *
+ * <dl>
+ * <dt>CLICK_CO_YIELD()</dt>
+ * <dd>Let the thread's other tasks run, then continue.</dd>
+ * <dt>CLICK_CO_SLEEP(delta), CLICK_CO_SLEEP_UNTIL(when_steady)</dt>
+ * <dd>Continue when the timer fires.</dd>
+ * <dt>CLICK_CO_AWAIT(condition)</dt>
+ * <dd>Continue once @a condition is true.  The condition is tested when the
+ * coroutine is woken, so whatever makes it true must call wake(): a handler,
+ * a push() method, or a notifier, see CLICK_CO_AWAIT_SIGNAL.</dd>
+ * <dt>CLICK_CO_AWAIT_TIMEOUT(condition, delta)</dt>
+ * <dd>Continue once @a condition is true or @a delta has passed.</dd>
+ * <dt>CLICK_CO_AWAIT_SIGNAL(signal)</dt>
+ * <dd>Continue once the NotifierSignal @a signal is active.  Create the
+ * signal with task() as its listener, for instance with
+ * Notifier::upstream_empty_signal(this, 0, co.task()), so the notifier
+ * wakes the coroutine.</dd>
+ * <dt>CLICK_CO_AWAIT_FD(fd, mask)</dt>
+ * <dd>At user level, continue once @a fd is ready for @a mask (SELECT_READ
+ * and/or SELECT_WRITE).  The owner's Element::selected() must pass its
+ * arguments to selected().</dd>
+ * </dl>
+ *
+ * Each wait must be on its own source line, and the body must not use
+ * @c switch statements that span a wait, or @c break outside a loop.
+ *
+ * @code
+ * bool MyElement::Prober::run() {
+ *     CLICK_CO_BEGIN;
+ *     for (_tries = 0; _tries < 3; ++_tries) {
+ *         _e->send_probe();
+ *         CLICK_CO_AWAIT_TIMEOUT(_e->_answered, Timestamp(1));
+ *         if (_e->_answered)
+ *             break;
+ *     }
+ *     CLICK_CO_END;
+ * }
+ * @endcode */
+class Coroutine { public:
+
+    Coroutine();
+    virtual ~Coroutine();
+
+    /** @brief Initialize the coroutine for @a owner, and start it if
+     * @a schedule is true. */
+    void initialize(Element *owner, bool schedule = true);
+    /** @brief Stop the coroutine and release its file descriptor wait.
+     *
+     * Call from the owner's cleanup(). */
+    void cleanup();
+
+    Element *owner() const		{ return _owner; }
+    Task *task()			{ return &_task; }
+    Timer &timer()			{ return _timer; }
+
+    /** @brief Return true if run() reached CLICK_CO_END. */
+    bool finished() const		{ return _co_line < 0; }
+    /** @brief Return true if the coroutine sleeps on its timer. */
+    bool sleeping() const		{ return _timer.scheduled(); }
+
+    /** @brief Run the coroutine soon, so it can retest what it waits for.
+     *
+     * A coroutine that sleeps keeps sleeping until its timer fires. */
+    void wake() {
+	if (_co_line >= 0)
+	    _task.reschedule();
+    }
+    /** @brief Abandon the current wait and start run() from the
+     * beginning. */
+    void restart();
+
+#if CLICK_USERLEVEL
+    /** @brief Handle a selected() call for the owner.
+     *
+     * Returns true if the coroutine waited for @a fd. */
+    bool selected(int fd, int mask);
+#endif
+
+  protected:
+
+    int _co_line;		// where run() resumes; -1 when finished
+
+    /** @brief The coroutine body, between CLICK_CO_BEGIN and CLICK_CO_END.
+     *
+     * Returns true if it did work, like a task callback. */
+    virtual bool run() = 0;
+
+#if CLICK_USERLEVEL
+    void await_fd(int fd, int mask);
+    bool fd_ready() const		{ return _co_fd < 0; }
+#endif
+
+  private:
+
+    Element *_owner;
+    Task _task;
+    Timer _timer;
+#if CLICK_USERLEVEL
+    int _co_fd;
+    int _co_mask;
+#endif
+
+    void cancel_waits();
+    static bool task_hook(Task *, void *user_data);
+
+};
+
+#define CLICK_CO_BEGIN		switch (_co_line) { case 0:
+#define CLICK_CO_END		default: _co_line = -1; } return true
+
+#define CLICK_CO_YIELD()	do {					\
+	_co_line = __LINE__; task()->fast_reschedule(); return true;	\
+	case __LINE__: ;						\
+    } while (0)
+
+#define CLICK_CO_AWAIT(condition) do {					\
+	_co_line = __LINE__;						\
+	case __LINE__: if (!(condition)) return false;			\
+    } while (0)
+
+#define CLICK_CO_AWAIT_TIMER() do {					\
+	_co_line = __LINE__; return true;				\
+	case __LINE__: if (timer().scheduled()) return false;		\
+    } while (0)
+
+#define CLICK_CO_SLEEP(delta) do {					\
+	timer().schedule_after(delta); CLICK_CO_AWAIT_TIMER();		\
+    } while (0)
+
+#define CLICK_CO_SLEEP_UNTIL(when_steady) do {				\
+	timer().schedule_at_steady(when_steady); CLICK_CO_AWAIT_TIMER(); \
+    } while (0)
+
+#define CLICK_CO_AWAIT_TIMEOUT(condition, delta) do {			\
+	timer().schedule_after(delta); _co_line = __LINE__;		\
+	case __LINE__:							\
+	if (!(condition) && timer().scheduled()) return false;		\
+	timer().unschedule();						\
+    } while (0)
+
+#define CLICK_CO_AWAIT_SIGNAL(signal)	CLICK_CO_AWAIT((signal).active())
+
+#if CLICK_USERLEVEL
+# define CLICK_CO_AWAIT_FD(fd, mask) do {				\
+	await_fd((fd), (mask)); _co_line = __LINE__; return true;	\
+	case __LINE__: if (!fd_ready()) return false;			\
+    } while (0)
+#endif
+
+CLICK_ENDDECLS
+#endif
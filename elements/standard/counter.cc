@@ -25,7 +25,7 @@
 CLICK_DECLS
 
 Counter::Counter()
-  : _count_trigger_h(0), _byte_trigger_h(0)
+  : _count_trigger_h(0), _byte_trigger_h(0), _sharded(false)
 {
 }
 
@@ -35,11 +35,22 @@ Counter::~Counter()
   delete _byte_trigger_h;
 }
 
+void
+Counter::static_initialize()
+{
+#if HAVE_DIRECT_PORT_TRANSFER
+  add_direct_push("Counter", direct_simple_action<Counter>);
+#endif
+}
+
 void
 Counter::reset()
 {
   _count = _byte_count = 0;
+  for (int i = 0; i < _shards.size(); i++)
+    _shards[i].count = _shards[i].byte_count = _shards[i].check_count = 0;
   _count_triggered = _byte_triggered = false;
+  _count_claimed = _byte_claimed = 0;
 }
 
 int
@@ -48,7 +59,8 @@ Counter::configure(Vector<String> &conf, ErrorHandler *errh)
   String count_call, byte_count_call;
   if (Args(conf, this, errh)
       .read("COUNT_CALL", AnyArg(), count_call)
-      .read("BYTE_COUNT_CALL", AnyArg(), byte_count_call).complete() < 0)
+      .read("BYTE_COUNT_CALL", AnyArg(), byte_count_call)
+      .read("SHARDED", _sharded).complete() < 0)
     return -1;
 
   if (count_call) {
@@ -81,13 +93,78 @@ Counter::initialize(ErrorHandler *errh)
     return -1;
   if (_byte_trigger_h && _byte_trigger_h->initialize_write(this, errh) < 0)
     return -1;
+  if (_sharded && _shards.initialize(master()) < 0)
+    return errh->error("out of memory");
   reset();
   return 0;
 }
 
+inline void
+Counter::sharded_update(counter_t count, counter_t nbytes)
+{
+    Shard &s = _shards.get();
+    s.count += count;
+    s.byte_count += nbytes;
+    s.rate.update(count);
+    s.byte_rate.update(nbytes);
+    if (s.count - s.check_count >= trigger_check_interval) {
+	s.check_count = s.count;
+	if ((_count_trigger_h && !_count_claimed)
+	    || (_byte_trigger_h && !_byte_claimed))
+	    check_sharded_triggers();
+    }
+}
+
+void
+Counter::check_sharded_triggers()
+{
+    // Each thread adds up the shards now and then, rather than sharing a
+    // global count.  compare_swap ensures only one thread makes the call.
+    if (_count_trigger_h && !_count_claimed
+	&& total(&Counter::_count, &Shard::count) >= _count_trigger
+	&& _count_claimed.compare_swap(0, 1) == 0)
+	(void) _count_trigger_h->call_write();
+    if (_byte_trigger_h && !_byte_claimed
+	&& total(&Counter::_byte_count, &Shard::byte_count) >= _byte_trigger
+	&& _byte_claimed.compare_swap(0, 1) == 0)
+	(void) _byte_trigger_h->call_write();
+}
+
+Counter::counter_t
+Counter::total(counter_t Counter::*field, counter_t Shard::*shard_field) const
+{
+    if (!_sharded)
+	return this->*field;
+    counter_t sum = 0;
+    for (int i = 0; i < _shards.size(); i++)
+	sum += _shards[i].*shard_field;
+    return sum;
+}
+
+template <typename R> typename R::signed_value_type
+Counter::scaled_rate(R Counter::*field, R Shard::*shard_field)
+{
+    if (!_sharded) {
+	(this->*field).update(0);	// drop rate after idle period
+	return (this->*field).scaled_average();
+    }
+    typename R::signed_value_type sum = 0;
+    for (int i = 0; i < _shards.size(); i++) {
+	// Update a copy; the original belongs to the shard's thread.
+	R r = _shards[i].*shard_field;
+	r.update(0);
+	sum += r.scaled_average();
+    }
+    return sum;
+}
+
 Packet *
 Counter::simple_action(Packet *p)
 {
+    if (_sharded) {
+	sharded_update(1, p->length());
+	return p;
+    }
     _count++;
     _byte_count += p->length();
     _rate.update(1);
@@ -107,6 +184,51 @@ Counter::simple_action(Packet *p)
   return p;
 }
 
+void
+Counter::simple_action_batch(PacketBatch &batch)
+{
+    counter_t old_count = _count, nbytes = 0;
+    for (Packet *p = batch.front(); p; p = p->next())
+	nbytes += p->length();
+    if (_sharded) {
+	sharded_update(batch.count(), nbytes);
+	return;
+    }
+    _count += batch.count();
+    _byte_count += nbytes;
+    _rate.update(batch.count());
+    _byte_rate.update(nbytes);
+
+    // Fire COUNT_CALL if the count passed through the trigger value.
+    if (old_count < _count_trigger && _count >= _count_trigger
+	&& !_count_triggered) {
+	_count_triggered = true;
+	if (_count_trigger_h)
+	    (void) _count_trigger_h->call_write();
+    }
+    if (_byte_count >= _byte_trigger && !_byte_triggered) {
+	_byte_triggered = true;
+	if (_byte_trigger_h)
+	    (void) _byte_trigger_h->call_write();
+    }
+}
+
+void
+Counter::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+Counter::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
 
 enum { H_COUNT, H_BYTE_COUNT, H_RATE, H_BIT_RATE, H_BYTE_RATE, H_RESET,
        H_COUNT_CALL, H_BYTE_COUNT_CALL };
@@ -117,23 +239,22 @@ Counter::read_handler(Element *e, void *thunk)
     Counter *c = (Counter *)e;
     switch ((intptr_t)thunk) {
       case H_COUNT:
-	return String(c->_count);
+	return String(c->total(&Counter::_count, &Shard::count));
       case H_BYTE_COUNT:
-	return String(c->_byte_count);
+	return String(c->total(&Counter::_byte_count, &Shard::byte_count));
       case H_RATE:
-	c->_rate.update(0);	// drop rate after idle period
-	return c->_rate.unparse_rate();
-      case H_BIT_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
+	return cp_unparse_real2(c->scaled_rate(&Counter::_rate, &Shard::rate) * c->_rate.epoch_frequency(), c->_rate.scale());
+      case H_BIT_RATE: {
+	byte_rate_t::signed_value_type r = c->scaled_rate(&Counter::_byte_rate, &Shard::byte_rate);
 	// avoid integer overflow by adjusting scale factor instead of
 	// multiplying
 	if (c->_byte_rate.scale() >= 3)
-	    return cp_unparse_real2(c->_byte_rate.scaled_average() * c->_byte_rate.epoch_frequency(), c->_byte_rate.scale() - 3);
+	    return cp_unparse_real2(r * c->_byte_rate.epoch_frequency(), c->_byte_rate.scale() - 3);
 	else
-	    return cp_unparse_real2(c->_byte_rate.scaled_average() * c->_byte_rate.epoch_frequency() * 8, c->_byte_rate.scale());
+	    return cp_unparse_real2(r * c->_byte_rate.epoch_frequency() * 8, c->_byte_rate.scale());
+      }
       case H_BYTE_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
-	return c->_byte_rate.unparse_rate();
+	return cp_unparse_real2(c->scaled_rate(&Counter::_byte_rate, &Shard::byte_rate) * c->_byte_rate.epoch_frequency(), c->_byte_rate.scale());
       case H_COUNT_CALL:
 	if (c->_count_trigger_h)
 	    return String(c->_count_trigger);
@@ -156,6 +277,7 @@ Counter::write_handler(const String &in_str, Element *e, void *thunk, ErrorHandl
 	if (HandlerCall::reset_write(c->_count_trigger_h, str, c, errh) < 0)
 	    return -1;
 	c->_count_triggered = false;
+	c->_count_claimed = 0;
 	return 0;
       case H_BYTE_COUNT_CALL:
 	  if (!IntArg().parse(cp_shift_spacevec(str), c->_byte_trigger))
@@ -163,6 +285,7 @@ Counter::write_handler(const String &in_str, Element *e, void *thunk, ErrorHandl
 	if (HandlerCall::reset_write(c->_byte_trigger_h, str, c, errh) < 0)
 	    return -1;
 	c->_byte_triggered = false;
+	c->_byte_claimed = 0;
 	return 0;
       case H_RESET:
 	c->reset();
@@ -185,6 +308,18 @@ Counter::add_handlers()
     add_read_handler("count_call", read_handler, H_COUNT_CALL);
     add_write_handler("count_call", write_handler, H_COUNT_CALL);
     add_write_handler("byte_count_call", write_handler, H_BYTE_COUNT_CALL);
+    add_stat("count", stat_callback, (void *) H_COUNT);
+    add_stat("byte_count", stat_callback, (void *) H_BYTE_COUNT);
+}
+
+uint64_t
+Counter::stat_callback(const Element *e, void *thunk)
+{
+    const Counter *c = static_cast<const Counter *>(e);
+    if ((intptr_t) thunk == H_COUNT)
+	return c->total(&Counter::_count, &Shard::count);
+    else
+	return c->total(&Counter::_byte_count, &Shard::byte_count);
 }
 
 int
@@ -194,15 +329,17 @@ Counter::llrpc(unsigned command, void *data)
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0)
       return -EINVAL;
-    _rate.update(0);		// drop rate after idle period
-    *val = _rate.rate();
+    *val = (scaled_rate(&Counter::_rate, &Shard::rate) * _rate.epoch_frequency()) >> _rate.scale();
     return 0;
 
   } else if (command == CLICK_LLRPC_GET_COUNT) {
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0 && *val != 1)
       return -EINVAL;
-    *val = (*val == 0 ? _count : _byte_count);
+    if (*val == 0)
+      *val = total(&Counter::_count, &Shard::count);
+    else
+      *val = total(&Counter::_byte_count, &Shard::byte_count);
     return 0;
 
   } else if (command == CLICK_LLRPC_GET_COUNTS) {
@@ -213,9 +350,9 @@ Counter::llrpc(unsigned command, void *data)
       return -EINVAL;
     for (unsigned i = 0; i < cs.n; i++) {
       if (cs.keys[i] == 0)
-	cs.values[i] = _count;
+	cs.values[i] = total(&Counter::_count, &Shard::count);
       else if (cs.keys[i] == 1)
-	cs.values[i] = _byte_count;
+	cs.values[i] = total(&Counter::_byte_count, &Shard::byte_count);
       else
 	return -EINVAL;
     }
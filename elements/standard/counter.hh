@@ -3,6 +3,8 @@
 #define CLICK_COUNTER_HH
 #include <click/element.hh>
 #include <click/ewma.hh>
+#include <click/percpu.hh>
+#include <click/atomic.hh>
 #include <click/llrpc.h>
 CLICK_DECLS
 class HandlerCall;
@@ -10,7 +12,7 @@ class HandlerCall;
 /*
 =c
 
-Counter([I<keywords COUNT_CALL, BYTE_COUNT_CALL>])
+Counter([I<keywords COUNT_CALL, BYTE_COUNT_CALL, SHARDED>])
 
 =s counters
 
@@ -37,6 +39,17 @@ Argument is `I<N> I<HANDLER> [I<VALUE>]'. When the byte count reaches or
 exceeds I<N>, call the write handler I<HANDLER> with value I<VALUE> before
 emitting the packet.
 
+=item SHARDED
+
+Boolean.  If true, Counter keeps a separate set of counts and rates for each
+thread, each on its own cache line, and adds them up when a handler is read.
+Use this when several threads push packets through the same Counter: the
+threads then never share a cache line or wait for one another.  In sharded
+mode, COUNT_CALL and BYTE_COUNT_CALL are approximate.  A thread compares the
+total against the trigger only every 16 packets, so the call may happen up
+to 16 packets per thread late, while emitting a different packet.  Default
+is false.
+
 =back
 
 =h count read-only
@@ -47,6 +60,10 @@ Returns the number of packets that have passed through since the last reset.
 
 Returns the number of bytes that have passed through since the last reset.
 
+The count and byte_count values are also registered as statistics, which
+the global 'stats' handler lists and CLICK_LLRPC_GET_STATS reads in
+binary.
+
 =h rate read-only
 
 Returns the recent arrival rate, measured by exponential
@@ -105,6 +122,7 @@ class Counter : public Element { public:
 
     const char *class_name() const		{ return "Counter"; }
     const char *port_count() const		{ return PORTS_1_1; }
+    static void static_initialize();
 
     void reset();
 
@@ -114,6 +132,9 @@ class Counter : public Element { public:
     int llrpc(unsigned, void *);
 
     Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &batch);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
   private:
 
@@ -141,9 +162,33 @@ class Counter : public Element { public:
 
     bool _count_triggered : 1;
     bool _byte_triggered : 1;
+    bool _sharded;
+
+    enum { trigger_check_interval = 16 };
+
+    struct Shard {
+	counter_t count;
+	counter_t byte_count;
+	counter_t check_count;
+	rate_t rate;
+	byte_rate_t byte_rate;
+	Shard()
+	    : count(0), byte_count(0), check_count(0) {
+	}
+    };
+
+    PerCPU<Shard> _shards;
+    atomic_uint32_t _count_claimed;
+    atomic_uint32_t _byte_claimed;
+
+    inline void sharded_update(counter_t count, counter_t nbytes);
+    void check_sharded_triggers();
+    counter_t total(counter_t Counter::*field, counter_t Shard::*shard_field) const;
+    template <typename R> typename R::signed_value_type scaled_rate(R Counter::*field, R Shard::*shard_field);
 
     static String read_handler(Element *, void *);
     static int write_handler(const String&, Element*, void*, ErrorHandler*);
+    static uint64_t stat_callback(const Element *, void *);
 
 };
 
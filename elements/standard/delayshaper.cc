@@ -73,12 +73,12 @@ DelayShaper::pull(int)
     // read a packet
     if (!_p && (_p = input(0).pull())) {
 	if (!_p->timestamp_anno().sec()) // get timestamp if not set
-	    _p->timestamp_anno().assign_now();
+	    _p->timestamp_anno().assign_now_fast();
 	_p->timestamp_anno() += _delay;
     }
 
     if (_p) {
-	Timestamp now = Timestamp::now();
+	Timestamp now = Timestamp::now_fast();
 	if (_p->timestamp_anno() <= now) {
 	    // packet ready for output
 	    Packet *p = _p;
@@ -41,6 +41,7 @@ class DelayShaper : public Element, public ActiveNotifier { public:
     ~DelayShaper();
 
     const char *class_name() const	{ return "DelayShaper"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1; }
     const char *processing() const	{ return PULL; }
     void *cast(const char *);
@@ -38,6 +38,7 @@ class DelayUnqueue : public Element { public:
     ~DelayUnqueue();
 
     const char *class_name() const	{ return "DelayUnqueue"; }
+    const char *flags() const		{ return "T"; }
     const char *port_count() const	{ return PORTS_1_1; }
     const char *processing() const	{ return PULL_TO_PUSH; }
 
@@ -31,6 +31,14 @@ Discard::~Discard()
 {
 }
 
+void
+Discard::static_initialize()
+{
+#if HAVE_DIRECT_PORT_TRANSFER
+    add_direct_push("Discard", direct_push<Discard>);
+#endif
+}
+
 int
 Discard::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -102,6 +110,7 @@ void
 Discard::add_handlers()
 {
     add_data_handlers("count", Handler::OP_READ, &_count);
+    add_stat("count", &_count);
     add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::BUTTON);
     if (input_is_pull(0)) {
 	add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
@@ -43,7 +43,8 @@ context.
 
 =h count read-only
 
-Returns the number of packets discarded.
+Returns the number of packets discarded.  Also registered as a statistic;
+see the global 'stats' handler.
 
 =h reset_counts write-only
 
@@ -58,6 +59,7 @@ class Discard : public Element { public:
 
     const char *class_name() const		{ return "Discard"; }
     const char *port_count() const		{ return PORTS_1_0; }
+    static void static_initialize();
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     int initialize(ErrorHandler *errh);
@@ -24,7 +24,7 @@
 CLICK_DECLS
 
 DRRSched::DRRSched()
-    : _quantum(500), _pi(0),
+    : _quantum(500), _pi(0), _signals(0), _active(0), _held(0),
       _notifier(Notifier::SEARCH_CONTINUE_WAKE), _next(0)
 {
 }
@@ -56,13 +56,19 @@ DRRSched::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 DRRSched::initialize(ErrorHandler *errh)
 {
-    if (!(_pi = new portinfo[ninputs()]))
+    if (!(_pi = new portinfo[ninputs()])
+	|| !(_signals = new NotifierSignal[ninputs()]))
 	return errh->error("out of memory!");
     for (int i = 0; i < ninputs(); i++) {
 	_pi[i].head = 0;
 	_pi[i].deficit = 0;
-	_pi[i].signal = Notifier::upstream_empty_signal(this, i, 0, &_notifier);
+	_signals[i] = Notifier::upstream_empty_signal(this, i, 0, &_notifier);
     }
+    if (_signal_set.initialize(_signals, ninputs()) < 0
+	|| !(_active = new uint32_t[_signal_set.nwords()])
+	|| !(_held = new uint32_t[_signal_set.nwords()]))
+	return errh->error("out of memory!");
+    memset(_held, 0, _signal_set.nwords() * sizeof(uint32_t));
     _next = 0;
     return 0;
 }
@@ -76,40 +82,69 @@ DRRSched::cleanup(CleanupStage)
 		_pi[j].head->kill();
 	delete[] _pi;
     }
+    delete[] _signals;
+    delete[] _active;
+    delete[] _held;
+}
+
+// Returns the next input in _active after i, wrapping around, or -1.
+inline int
+DRRSched::next_active(int i) const
+{
+    int n = ninputs();
+    int j = NotifierSignalSet::next_bit(_active, n, i + 1);
+    return j >= 0 ? j : NotifierSignalSet::next_bit(_active, n, 0);
 }
 
 Packet *
 DRRSched::pull(int)
 {
-    int n = ninputs();
+    // Consider only inputs that hold a packet or whose signals are active.
     bool signals_on = false;
+    _signal_set.active_bitmap(_active);
+    for (int w = 0; w < _signal_set.nwords(); w++)
+	if ((_active[w] |= _held[w]))
+	    signals_on = true;
+    if (!signals_on) {
+	_notifier.set_active(false);
+	return 0;
+    }
 
-    // Look at each input once, starting at the *same*
+    // An input we leave while it is idle keeps no deficit.
+    if (!(_active[_next >> 5] & (1U << (_next & 31)))) {
+	_pi[_next].deficit = 0;
+	_next = next_active(_next);
+	_pi[_next].deficit += _quantum;
+    }
+
+    // Visit at most ninputs() active inputs, starting at the *same*
     // one we left off on last time.
-    for (int j = 0; j < n; j++) {
+    for (int j = 0; j < ninputs(); j++) {
 	portinfo &pi = _pi[_next];
+	uint32_t bit = 1U << (_next & 31);
 	Packet *p;
 	if ((p = pi.head)) {
 	    pi.head = 0;
-	    signals_on = true;
-	} else if (pi.signal) {
-	    p = input(_next).pull();
-	    signals_on = true;
+	    _held[_next >> 5] &= ~bit;
 	} else
-	    p = 0;
+	    p = input(_next).pull();
 
-	if (p == 0)
+	if (p == 0) {
 	    pi.deficit = 0;
-	else if (p->length() <= pi.deficit) {
+	    _active[_next >> 5] &= ~bit;
+	} else if (p->length() <= pi.deficit) {
 	    pi.deficit -= p->length();
 	    _notifier.set_active(true);
 	    return p;
-	} else
+	} else {
 	    pi.head = p;
+	    _held[_next >> 5] |= bit;
+	}
 
-	_next++;
-	if (_next >= n)
-	    _next = 0;
+	int i = next_active(_next);
+	if (i < 0)
+	    break;
+	_next = i;
 	_pi[_next].deficit += _quantum;
     }
 
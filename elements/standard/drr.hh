@@ -19,6 +19,9 @@ CLICK_DECLS
  *
  * The inputs usually come from Queues or other pull schedulers.
  * DRRSched uses notification to avoid pulling from empty inputs.
+ * It reads its inputs' signals a word at a time and skips inactive inputs
+ * without visiting them, so empty inputs cost little even when there are
+ * hundreds.
  *
  * Keyword arguments are:
  *
@@ -57,14 +60,19 @@ class DRRSched : public Element { public:
 
   private:
 
+    inline int next_active(int i) const;
+
     struct portinfo {
 	Packet *head;
 	unsigned deficit;
-	NotifierSignal signal;
     };
 
     int _quantum;   // Number of bytes to send per round.
     portinfo *_pi;
+    NotifierSignal *_signals;
+    NotifierSignalSet _signal_set;
+    uint32_t *_active;
+    uint32_t *_held;	// inputs with a packet in head
     Notifier _notifier;
     int _next;      // Next input to consider.
 
@@ -0,0 +1,237 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * dupefilter.{cc,hh} -- drops packets whose contents were recently seen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "dupefilter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/ipflowid.hh>
+#include <click/packetbatch.hh>
+CLICK_DECLS
+
+DupeFilter::DupeFilter()
+    : _nsets(0), _ways(0)
+{
+}
+
+DupeFilter::~DupeFilter()
+{
+}
+
+int
+DupeFilter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Vector<String> ranges;
+    uint32_t capacity = 65536, ways = 4;
+    _window = 100;
+    if (Args(conf, this, errh)
+	.read_all_with("RANGE", AnyArg(), ranges)
+	.read("WINDOW", SecondsArg(3), _window)
+	.read("CAPACITY", capacity)
+	.read("WAYS", ways)
+	.complete() < 0)
+	return -1;
+    if (ways < 1 || ways > 16)
+	return errh->error("WAYS must be between 1 and 16");
+    if (capacity < ways || capacity > 0x1000000)
+	return errh->error("CAPACITY out of range");
+    if (_window == 0)
+	return errh->error("WINDOW must be at least 1 millisecond");
+
+    if (!ranges.size())
+	ranges.push_back(String::make_stable("link 0"));
+    _ranges.clear();
+    for (int i = 0; i < ranges.size(); ++i) {
+	Vector<String> words;
+	cp_spacevec(ranges[i], words);
+	Range r;
+	r.base = base_link;
+	r.length = -1;
+	int w = 0;
+	if (words.size() && words[0] == "link")
+	    ++w;
+	else if (words.size() && words[0] == "network")
+	    r.base = base_network, ++w;
+	else if (words.size() && words[0] == "transport")
+	    r.base = base_transport, ++w;
+	if (words.size() < w + 1 || words.size() > w + 2
+	    || !IntArg().parse(words[w], r.offset) || r.offset < 0
+	    || (words.size() == w + 2
+		&& (!IntArg().parse(words[w + 1], r.length) || r.length < 0)))
+	    return errh->error("bad RANGE %<%s%>", ranges[i].c_str());
+	_ranges.push_back(r);
+    }
+
+    _ways = ways;
+    for (_nsets = 1; _nsets * _ways < capacity; _nsets *= 2)
+	/* nada */;
+    return 0;
+}
+
+int
+DupeFilter::initialize(ErrorHandler *errh)
+{
+    if (_tables.initialize(master()) < 0)
+	return errh->error("out of memory");
+    for (int i = 0; i < _tables.size(); ++i)
+	if (!(_tables[i].entries = new Entry[_nsets * _ways]))
+	    return errh->error("out of memory");
+    reset();
+    return 0;
+}
+
+void
+DupeFilter::reset()
+{
+    for (int i = 0; i < _tables.size(); ++i) {
+	Table &t = _tables[i];
+	memset(t.entries, 0, _nsets * _ways * sizeof(Entry));
+	t.count = t.duplicates = 0;
+    }
+}
+
+inline uint64_t
+DupeFilter::fingerprint(const Packet *p) const
+{
+    uint64_t fp = ~(uint64_t) 0;
+    uint32_t hashed = 0;
+    for (const Range *r = _ranges.begin(); r != _ranges.end(); ++r) {
+	const unsigned char *start;
+	if (r->base == base_link)
+	    start = p->data();
+	else if (r->base == base_network && p->has_network_header())
+	    start = p->network_header();
+	else if (r->base == base_transport && p->has_transport_header())
+	    start = p->transport_header();
+	else
+	    continue;
+	int len = p->end_data() - start - r->offset;
+	if (len <= 0)
+	    continue;
+	if (r->length >= 0 && r->length < len)
+	    len = r->length;
+	fp = FlowHash::crc32c64(fp, start + r->offset, len);
+	hashed += len;
+    }
+    return fp ^ (hashed * 0x9E3779B97F4A7C15ULL);
+}
+
+inline bool
+DupeFilter::duplicate(Table &t, const Packet *p, uint32_t now) const
+{
+    uint64_t fp = fingerprint(p);
+    Entry *set = t.entries + ((uint32_t) (fp ^ (fp >> 32)) & (_nsets - 1)) * _ways;
+    Entry *victim = set;
+    ++t.count;
+    for (Entry *e = set; e != set + _ways; ++e) {
+	if (e->fp == fp && now - e->msec < _window) {
+	    ++t.duplicates;
+	    return true;
+	}
+	if (now - e->msec > now - victim->msec)
+	    victim = e;
+    }
+    victim->fp = fp;
+    victim->msec = now;
+    return false;
+}
+
+Packet *
+DupeFilter::simple_action(Packet *p)
+{
+    uint32_t now = Timestamp::recent_steady().msecval();
+    if (duplicate(_tables.get(), p, now)) {
+	checked_output_push(1, p);
+	return 0;
+    } else
+	return p;
+}
+
+void
+DupeFilter::simple_action_batch(PacketBatch &batch)
+{
+    Table &t = _tables.get();
+    uint32_t now = Timestamp::recent_steady().msecval();
+    PacketBatch out, dups;
+    while (Packet *p = batch.pop_front())
+	if (duplicate(t, p, now))
+	    dups.push_back(p);
+	else
+	    out.push_back(p);
+    if (noutputs() == 2)
+	output(1).push_batch(dups);
+    else
+	dups.kill();
+    batch.swap(out);
+}
+
+void
+DupeFilter::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+DupeFilter::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
+enum { h_count, h_duplicates, h_duplicate_ratio, h_reset };
+
+String
+DupeFilter::read_handler(Element *e, void *thunk)
+{
+    DupeFilter *df = static_cast<DupeFilter *>(e);
+    uint64_t count = 0, duplicates = 0;
+    for (int i = 0; i < df->_tables.size(); ++i) {
+	count += df->_tables[i].count;
+	duplicates += df->_tables[i].duplicates;
+    }
+    switch ((uintptr_t) thunk) {
+    case h_count:
+	return String(count);
+    case h_duplicates:
+	return String(duplicates);
+    case h_duplicate_ratio:
+	return cp_unparse_real10((uint32_t) (count ? duplicates * 1000000 / count : 0), 6);
+    default:
+	return String();
+    }
+}
+
+int
+DupeFilter::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<DupeFilter *>(e)->reset();
+    return 0;
+}
+
+void
+DupeFilter::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("duplicates", read_handler, h_duplicates);
+    add_read_handler("duplicate_ratio", read_handler, h_duplicate_ratio);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(DupeFilter)
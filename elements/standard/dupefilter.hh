@@ -0,0 +1,156 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_DUPEFILTER_HH
+#define CLICK_DUPEFILTER_HH
+#include <click/element.hh>
+#include <click/percpu.hh>
+CLICK_DECLS
+
+/*
+=c
+
+DupeFilter([I<keywords> RANGE, WINDOW, CAPACITY, WAYS])
+
+=s classification
+
+drops packets whose contents were recently seen
+
+=d
+
+DupeFilter fingerprints each packet by hashing chosen byte ranges, and drops
+packets whose fingerprint it has seen within the last WINDOW.  Unique packets
+leave on output 0.  Duplicates leave on output 1, if it exists, and are
+dropped otherwise.  This removes the copies a mirror port produces when it
+sees a packet on two interfaces, or the copies a retransmitting link layer
+lets through.
+
+The fingerprint is a 64-bit CRC-32C of the ranges, mixed with their total
+length, computed with the SSE4.2 crc32 instruction at user level when the
+processor has it.  Recent fingerprints are kept in a set-associative table of about
+CAPACITY entries, WAYS per set; a new fingerprint replaces the oldest entry in
+its set.  So memory is fixed, and a duplicate may be missed when its original
+was pushed out by WAYS newer packets in the same set.
+
+Each thread keeps its own table, so duplicates are found among packets handled
+by the same thread.  Copies of a packet have the same headers, so receive-side
+scaling gives them to the same thread.
+
+Keyword arguments are:
+
+=over 8
+
+=item RANGE
+
+A byte range to hash: an optional base, C<link>, C<network>, or
+C<transport>; an offset from that base; and an optional length.  Without a
+length, the range runs to the end of the packet.  Ranges that start past the
+end of the packet, or whose base header is not set, are skipped; ranges that
+run past the end are cut short.  This keyword may be given more than once.
+The default is the whole packet, C<link 0>.
+
+=item WINDOW
+
+Time in seconds, with millisecond precision.  How long a fingerprint is
+remembered.  Default is 0.1.
+
+=item CAPACITY
+
+Unsigned integer.  Fingerprints per thread, rounded up so the number of sets
+is a power of two.  Default is 65536.
+
+=item WAYS
+
+Unsigned integer between 1 and 16.  Fingerprints per set.  Default is 4.
+
+=back
+
+=h count read-only
+
+Returns the number of packets seen.
+
+=h duplicates read-only
+
+Returns the number of duplicates found.
+
+=h duplicate_ratio read-only
+
+Returns the fraction of packets that were duplicates.
+
+=h reset write-only
+
+Resets the counts and forgets every fingerprint.
+
+=e
+
+Remove mirror-port copies whose TTL and checksum differ:
+
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader
+    -> DupeFilter(RANGE network 0 8, RANGE network 12)
+    -> ...
+
+=a
+
+Suppressor, WifiDupeFilter */
+
+class DupeFilter : public Element { public:
+
+    DupeFilter();
+    ~DupeFilter();
+
+    const char *class_name() const	{ return "DupeFilter"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return PROCESSING_A_AH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    Packet *simple_action(Packet *p);
+    void simple_action_batch(PacketBatch &batch);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
+
+  private:
+
+    enum { base_link, base_network, base_transport };
+
+    struct Range {
+	int base;
+	int offset;
+	int length;		// -1 means to the end
+    };
+
+    struct Entry {
+	uint64_t fp;
+	uint32_t msec;		// Timestamp::recent_steady() milliseconds
+	uint32_t pad;
+    };
+
+    struct Table {
+	Entry *entries;
+	uint32_t count;
+	uint32_t duplicates;
+	Table()
+	    : entries(0), count(0), duplicates(0) {
+	}
+	~Table() {
+	    delete[] entries;
+	}
+    };
+
+    Vector<Range> _ranges;
+    PerCPU<Table> _tables;
+    uint32_t _nsets;
+    uint32_t _ways;
+    uint32_t _window;		// milliseconds
+
+    inline uint64_t fingerprint(const Packet *p) const;
+    inline bool duplicate(Table &t, const Packet *p, uint32_t now) const;
+    void reset();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
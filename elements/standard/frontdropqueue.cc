@@ -60,8 +60,10 @@ FrontDropQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
     new_q[--j] = _q[i];
     if (j == 0) break;
   }
-  for (; i != _head; i = prev_i(i))
+  for (; i != _head; i = prev_i(i)) {
+    pool_release(_q[i]);
     _q[i]->kill();
+  }
 
   CLICK_LFREE(_q, sizeof(Packet *) * (_capacity + 1));
   _q = new_q;
@@ -89,6 +91,8 @@ FrontDropQueue::take_state(Element *e, ErrorHandler *errh)
 	i--;
 	j = q->prev_i(j);
 	_q[i] = q->packet(j);
+	if (_pool)
+	    _pool->charge(_pool_slot, _q[i]->length());
     }
     _head = i;
     _highwater_length = size();
@@ -108,6 +112,11 @@ void
 FrontDropQueue::push(int, Packet *p)
 {
     assert(p);
+    if (!pool_admit(p)) {
+	_drops++;
+	checked_output_push(1, p);
+	return;
+    }
 
     // inline Queue::enq() for speed
     Storage::index_type next = next_i(_tail);
@@ -116,6 +125,7 @@ FrontDropQueue::push(int, Packet *p)
     if (next == _head) {
 	if (_drops == 0 && _capacity > 0)
 	    click_chatter("%{element}: overflow", this);
+	pool_release(_q[_head]);
 	checked_output_push(1, _q[_head]);
 	_drops++;
 	_head = next_i(_head);
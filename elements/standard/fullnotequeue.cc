@@ -28,6 +28,14 @@ FullNoteQueue::~FullNoteQueue()
 {
 }
 
+void
+FullNoteQueue::static_initialize()
+{
+#if HAVE_DIRECT_PORT_TRANSFER
+    add_direct_push("Queue", direct_push<FullNoteQueue>);
+#endif
+}
+
 void *
 FullNoteQueue::cast(const char *n)
 {
@@ -62,7 +70,7 @@ FullNoteQueue::push(int, Packet *p)
     // Code taken from SimpleQueue::push().
     Storage::index_type h = _head, t = _tail, nt = next_i(t);
 
-    if (nt != h)
+    if (nt != h && pool_admit(p))
 	push_success(h, t, nt, p);
     else
 	push_failure(p);
@@ -80,6 +88,35 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+void
+FullNoteQueue::push_batch(int, PacketBatch &batch)
+{
+    // Code taken from FullNoteQueue::push_success().
+    if (enq_batch(batch)) {
+	_empty_note.wake();
+	if (size() == capacity()) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    // Work around race condition between push() and pull().
+	    if (size() < capacity())
+		_full_note.wake();
+#endif
+	}
+    }
+    if (!batch.empty())
+	push_batch_failure(batch);
+}
+
+void
+FullNoteQueue::pull_batch(int, PacketBatch &batch, int max)
+{
+    if (deq_batch(batch, max)) {
+	_sleepiness = 0;
+	_full_note.wake();
+    } else
+	pull_failure();
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(NotifierQueue)
 EXPORT_ELEMENT(FullNoteQueue FullNoteQueue-FullNoteQueue)
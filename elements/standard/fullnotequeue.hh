@@ -8,7 +8,7 @@ CLICK_DECLS
 =c
 
 Queue
-Queue(CAPACITY)
+Queue(CAPACITY [, I<keywords> BUFFER_POOL])
 
 =s storage
 
@@ -18,7 +18,9 @@ stores packets in a FIFO queue
 
 Stores incoming packets in a first-in-first-out queue.
 Drops incoming packets if the queue already holds CAPACITY packets.
-The default for CAPACITY is 1000.
+The default for CAPACITY is 1000.  If BUFFER_POOL names a BufferPool
+element, the queue also drops packets that the pool refuses; see
+SimpleQueue.
 
 Queue notifies interested parties when it becomes empty and when a
 formerly-empty queue receives a packet.  The empty notification takes place
@@ -72,12 +74,15 @@ class FullNoteQueue : public NotifierQueue { public:
 
     const char *class_name() const		{ return "Queue"; }
     void *cast(const char *);
+    static void static_initialize();
 
     int configure(Vector<String> &conf, ErrorHandler *);
     int live_reconfigure(Vector<String> &conf, ErrorHandler *errh);
 
     void push(int port, Packet *p);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
   protected:
 
@@ -136,6 +141,7 @@ FullNoteQueue::pull_success(Storage::index_type h,
     Packet *p = _q[h];
     packet_memory_barrier(_q[h], _head);
     _head = nh;
+    pool_release(p);
 
     _sleepiness = 0;
     _full_note.wake();
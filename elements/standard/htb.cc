@@ -0,0 +1,587 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * htb.{cc,hh} -- hierarchical token bucket shaper
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "htb.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/packet_anno.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+
+static inline uint32_t
+packet_length(Packet *p)
+{
+    return p->length() + EXTRA_LENGTH_ANNO(p);
+}
+
+HTB::HTB()
+    : _default(0), _timer(this)
+{
+}
+
+HTB::~HTB()
+{
+}
+
+void *
+HTB::cast(const char *n)
+{
+    if (strcmp(n, "HTB") == 0)
+	return (HTB *)this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+int
+HTB::parse_spec(const String &str, Spec &spec, ErrorHandler *errh) const
+{
+    Vector<String> words;
+    cp_spacevec(str, words);
+    if (words.empty())
+	return errh->error("empty class specification");
+    if (!IntArg().parse(words[0], spec.id) || spec.id == 0)
+	return errh->error("class ID should be a positive integer");
+    if (words.size() % 2 == 0)
+	return errh->error("class %u: missing value for %s", spec.id, words.back().c_str());
+
+    Vector<String> conf;
+    for (int i = 1; i < words.size(); i += 2)
+	conf.push_back(words[i] + " " + words[i + 1]);
+
+    bool ceil_set, burst_set, cburst_set;
+    spec.parent = 0;
+    spec.capacity = 0;
+    PrefixErrorHandler perrh(errh, "class " + String(spec.id) + ": ");
+    if (Args(conf, this, &perrh)
+	.read("PARENT", spec.parent)
+	.read_m("RATE", BandwidthArg(), spec.rate)
+	.read("CEIL", BandwidthArg(), spec.ceil).read_status(ceil_set)
+	.read("BURST", spec.burst).read_status(burst_set)
+	.read("CBURST", spec.cburst).read_status(cburst_set)
+	.read("CAPACITY", spec.capacity)
+	.complete() < 0)
+	return -1;
+
+    if (!ceil_set)
+	spec.ceil = spec.rate;
+    if (spec.rate == 0)
+	return perrh.error("RATE must be positive");
+    if (spec.ceil < spec.rate)
+	return perrh.error("CEIL must be at least RATE");
+    if (spec.parent == spec.id)
+	return perrh.error("class cannot be its own parent");
+    // 10ms of traffic plus a full-sized packet, enough that jiffy-granular
+    // refills can sustain the rate
+    if (!burst_set)
+	spec.burst = spec.rate / 100 + 1514;
+    if (!cburst_set)
+	spec.cburst = spec.ceil / 100 + 1514;
+    if (spec.burst == 0 || spec.cburst == 0)
+	return perrh.error("BURST and CBURST must be positive");
+    return 0;
+}
+
+String
+HTB::unparse_spec(const Spec &spec)
+{
+    StringAccum sa;
+    sa << spec.id;
+    if (spec.parent)
+	sa << " PARENT " << spec.parent;
+    sa << " RATE " << BandwidthArg::unparse(spec.rate)
+       << " CEIL " << BandwidthArg::unparse(spec.ceil)
+       << " BURST " << spec.burst
+       << " CBURST " << spec.cburst;
+    if (spec.capacity)
+	sa << " CAPACITY " << spec.capacity;
+    return sa.take_string();
+}
+
+void
+HTB::apply_spec(Class *c, const Spec &spec)
+{
+    c->spec = spec;
+    c->rate.assign_adjust(spec.rate, spec.burst);
+    c->ceil.assign_adjust(spec.ceil, spec.cburst);
+}
+
+int
+HTB::add_classes(const Vector<Spec> &specs, ErrorHandler *errh)
+{
+    // check everything before changing anything
+    HashTable<uint32_t, int> batch;
+    for (int i = 0; i < specs.size(); ++i) {
+	const Spec &s = specs[i];
+	if (batch.get(s.id))
+	    return errh->error("class %u defined twice", s.id);
+	batch.set(s.id, 1);
+	if (Class *c = _class_map.get(s.id)) {
+	    if (c->spec.parent != s.parent)
+		return errh->error("class %u: cannot change parent", s.id);
+	} else if (s.parent) {
+	    Class *p = _class_map.get(s.parent);
+	    if (!p && !batch.get(s.parent))
+		return errh->error("class %u: no parent class %u", s.id, s.parent);
+	    if (p && p->qlen)
+		return errh->error("class %u: parent class %u has queued packets", s.id, s.parent);
+	}
+    }
+
+    click_jiffies_t now = click_jiffies();
+    for (int i = 0; i < specs.size(); ++i) {
+	const Spec &s = specs[i];
+	if (Class *c = _class_map.get(s.id)) {
+	    apply_spec(c, s);
+	    continue;
+	}
+	Class *c = new Class;
+	c->spec = s;
+	c->parent = s.parent ? _class_map.get(s.parent) : 0;
+	if (c->parent)
+	    ++c->parent->nchildren;
+	c->nchildren = 0;
+	c->rate.assign(s.rate, s.burst);
+	c->rate.set_full();
+	c->rate.set_time_point(now);
+	c->ceil.assign(s.ceil, s.cburst);
+	c->ceil.set_full();
+	c->ceil.set_time_point(now);
+	c->head = c->tail = 0;
+	c->qlen = 0;
+	c->sched = sched_idle;
+	c->rprev = c->rnext = c->wprev = c->wnext = 0;
+	c->in_wheel = false;
+	c->packets = c->drops = c->borrows = 0;
+	c->bytes = 0;
+	_classes.push_back(c);
+	_class_map.set(s.id, c);
+    }
+
+    if (_default_id)
+	_default = _class_map.get(_default_id);
+    return 0;
+}
+
+int
+HTB::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Vector<String> class_specs;
+    _default_id = 0;
+    _anno = AGGREGATE_ANNO_OFFSET;
+    _capacity = 1000;
+    if (Args(conf, this, errh)
+	.read_all_with("CLASS", AnyArg(), class_specs)
+	.read("DEFAULT", _default_id)
+	.read("ANNO", AnnoArg(4), _anno)
+	.read("CAPACITY", _capacity)
+	.complete() < 0)
+	return -1;
+
+    Vector<Spec> specs;
+    for (int i = 0; i < class_specs.size(); ++i) {
+	specs.push_back(Spec());
+	if (parse_spec(class_specs[i], specs.back(), errh) < 0)
+	    return -1;
+    }
+    if (add_classes(specs, errh) < 0)
+	return -1;
+    if (_default_id && !_default)
+	return errh->error("DEFAULT class %u not defined", _default_id);
+
+    memset(_wheel_bits, 0, sizeof(_wheel_bits));
+    _wheel_count = 0;
+    _wheel_jiffy = click_jiffies();
+    _length = _drops = 0;
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+int
+HTB::initialize(ErrorHandler *)
+{
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+HTB::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _classes.size(); ++i) {
+	while (Packet *p = _classes[i]->head) {
+	    _classes[i]->head = p->next();
+	    p->set_next(0);
+	    p->kill();
+	}
+	delete _classes[i];
+    }
+    _classes.clear();
+    _class_map.clear();
+}
+
+inline void
+HTB::list_insert(ClassList &l, Class *c)
+{
+    c->rnext = 0;
+    c->rprev = l.tail;
+    if (l.tail)
+	l.tail->rnext = c;
+    else
+	l.head = c;
+    l.tail = c;
+}
+
+inline void
+HTB::list_remove(ClassList &l, Class *c)
+{
+    if (c->rprev)
+	c->rprev->rnext = c->rnext;
+    else
+	l.head = c->rnext;
+    if (c->rnext)
+	c->rnext->rprev = c->rprev;
+    else
+	l.tail = c->rprev;
+    c->rprev = c->rnext = 0;
+}
+
+void
+HTB::wheel_insert(Class *c, click_jiffies_t due)
+{
+    // a slot at or before the wheel's time would not be visited until the
+    // wheel came around again
+    if (!click_jiffies_less(_wheel_jiffy, due))
+	due = _wheel_jiffy + 1;
+    c->due = due;
+    c->in_wheel = true;
+    unsigned slot = due & (wheel_size - 1);
+    ClassList &l = _wheel[slot];
+    c->wnext = 0;
+    c->wprev = l.tail;
+    if (l.tail)
+	l.tail->wnext = c;
+    else
+	l.head = c;
+    l.tail = c;
+    _wheel_bits[slot >> 5] |= 1U << (slot & 31);
+    ++_wheel_count;
+}
+
+void
+HTB::wheel_remove(Class *c)
+{
+    unsigned slot = c->due & (wheel_size - 1);
+    ClassList &l = _wheel[slot];
+    if (c->wprev)
+	c->wprev->wnext = c->wnext;
+    else
+	l.head = c->wnext;
+    if (c->wnext)
+	c->wnext->wprev = c->wprev;
+    else
+	l.tail = c->wprev;
+    c->wprev = c->wnext = 0;
+    c->in_wheel = false;
+    if (!l.head)
+	_wheel_bits[slot >> 5] &= ~(1U << (slot & 31));
+    --_wheel_count;
+}
+
+// Moves classes whose wheel time has come to the ready lists.
+void
+HTB::wheel_advance(click_jiffies_t now)
+{
+    if (!click_jiffies_less(_wheel_jiffy, now))
+	return;
+    click_jiffies_t steps = now - _wheel_jiffy;
+    if (steps > wheel_size)
+	steps = wheel_size;
+    for (click_jiffies_t i = 1; i <= steps && _wheel_count; ++i) {
+	unsigned slot = (_wheel_jiffy + i) & (wheel_size - 1);
+	if (!(_wheel_bits[slot >> 5] & (1U << (slot & 31))))
+	    continue;
+	Class *next;
+	for (Class *c = _wheel[slot].head; c; c = next) {
+	    next = c->wnext;
+	    if (!click_jiffies_less(now, c->due))
+		reschedule(c, now);
+	}
+    }
+    _wheel_jiffy = now;
+}
+
+void
+HTB::schedule_timer()
+{
+    if (!_wheel_count)
+	return;
+    // find the first nonempty slot after the wheel's time
+    unsigned start = (_wheel_jiffy + 1) & (wheel_size - 1);
+    unsigned offset = 0;
+    while (offset < wheel_size + 32) {
+	unsigned slot = (start + offset) & (wheel_size - 1);
+	if (uint32_t bits = _wheel_bits[slot >> 5] >> (slot & 31)) {
+	    offset += ffs_lsb(bits) - 1;
+	    break;
+	}
+	offset += 32 - (slot & 31);
+    }
+    click_jiffies_t when = _wheel_jiffy + 1 + offset;
+    if (_timer.scheduled() && !click_jiffies_less(when, _timer_jiffy))
+	return;
+    _timer_jiffy = when;
+    click_jiffies_difference_t delta = when - click_jiffies();
+    _timer.schedule_after(Timestamp::make_jiffies(delta > 0 ? (click_jiffies_t) delta : 0));
+}
+
+// Returns whether the head packet of leaf c can be sent at its own rate
+// (sched_green), by borrowing (sched_yellow), or not yet (sched_blocked).
+// Sets due to the time c can next send at its own rate.
+int
+HTB::evaluate(Class *c, click_jiffies_t now, click_jiffies_t &due)
+{
+    typedef TokenBucket::ticks_type ticks_type;
+    uint32_t len = packet_length(c->head);
+    ticks_type ceil_wait = 0, rate_wait = (ticks_type) -1, own_wait = 0;
+    Class *lender = 0;
+
+    for (Class *a = c; a; a = a->parent) {
+	a->rate.refill(now);
+	a->ceil.refill(now);
+	// a packet larger than a bucket waits only for a full bucket
+	uint32_t n = len < a->ceil.capacity() ? len : a->ceil.capacity();
+	if (!a->ceil.contains(n)) {
+	    ticks_type w = a->ceil.time_until_contains(n);
+	    ceil_wait = w > ceil_wait ? w : ceil_wait;
+	}
+	if (!lender) {
+	    n = len < a->rate.capacity() ? len : a->rate.capacity();
+	    if (a->rate.contains(n))
+		lender = a;
+	    else {
+		ticks_type w = a->rate.time_until_contains(n);
+		rate_wait = w < rate_wait ? w : rate_wait;
+		if (a == c)
+		    own_wait = w;
+	    }
+	}
+    }
+
+    ticks_type wait;
+    int result;
+    if (ceil_wait == 0 && lender == c)
+	return sched_green;
+    else if (ceil_wait == 0 && lender) {
+	wait = own_wait;
+	result = sched_yellow;
+    } else {
+	wait = lender || ceil_wait > rate_wait ? ceil_wait : rate_wait;
+	result = sched_blocked;
+    }
+    // revisit hopeless cases once a minute
+    if (wait > (ticks_type) 60 * CLICK_HZ)
+	wait = 60 * CLICK_HZ;
+    due = now + wait;
+    return result;
+}
+
+void
+HTB::unschedule(Class *c)
+{
+    if (c->sched == sched_green)
+	list_remove(_green, c);
+    else if (c->sched == sched_yellow)
+	list_remove(_yellow, c);
+    if (c->in_wheel)
+	wheel_remove(c);
+    c->sched = sched_idle;
+}
+
+// Places backlogged leaf c according to its current eligibility.
+void
+HTB::reschedule(Class *c, click_jiffies_t now)
+{
+    unschedule(c);
+    click_jiffies_t due;
+    c->sched = evaluate(c, now, due);
+    if (c->sched == sched_green)
+	list_insert(_green, c);
+    else if (c->sched == sched_yellow) {
+	list_insert(_yellow, c);
+	wheel_insert(c, due);
+    } else
+	wheel_insert(c, due);
+}
+
+void
+HTB::drop(Class *c, Packet *p)
+{
+    if (c)
+	++c->drops;
+    ++_drops;
+    checked_output_push(1, p);
+}
+
+void
+HTB::push(int, Packet *p)
+{
+    Class *c = _class_map.get(p->anno_u32(_anno));
+    if (!c)
+	c = _default;
+    if (!c || c->nchildren
+	|| c->qlen >= (c->spec.capacity ? c->spec.capacity : _capacity)) {
+	drop(c, p);
+	return;
+    }
+
+    p->set_next(0);
+    if (c->tail)
+	c->tail->set_next(p);
+    else
+	c->head = p;
+    c->tail = p;
+    ++c->qlen;
+    ++_length;
+
+    if (c->sched == sched_idle) {
+	click_jiffies_t now = click_jiffies();
+	wheel_advance(now);
+	reschedule(c, now);
+	if (_green.head || _yellow.head)
+	    _empty_note.wake();
+	else
+	    schedule_timer();
+    }
+}
+
+Packet *
+HTB::pull(int)
+{
+    click_jiffies_t now = click_jiffies();
+    wheel_advance(now);
+
+    while (1) {
+	Class *c = _green.head ? _green.head : _yellow.head;
+	if (!c) {
+	    _empty_note.sleep();
+	    schedule_timer();
+	    return 0;
+	}
+
+	click_jiffies_t due;
+	int s = evaluate(c, now, due);
+	if (s == sched_blocked
+	    || (s == sched_yellow && c->sched == sched_green)) {
+	    // let other green classes go first
+	    reschedule(c, now);
+	    continue;
+	}
+
+	Packet *p = c->head;
+	if (!(c->head = p->next()))
+	    c->tail = 0;
+	p->set_next(0);
+	--c->qlen;
+	--_length;
+
+	uint32_t len = packet_length(p);
+	for (Class *a = c; a; a = a->parent) {
+	    a->rate.remove(len);
+	    a->ceil.remove(len);
+	}
+	++c->packets;
+	c->bytes += len;
+	if (s == sched_yellow)
+	    ++c->borrows;
+
+	// round robin within the class's group
+	if (!c->head)
+	    unschedule(c);
+	else if (s != c->sched)
+	    reschedule(c, now);
+	else if (s == sched_green) {
+	    list_remove(_green, c);
+	    list_insert(_green, c);
+	} else {
+	    list_remove(_yellow, c);
+	    list_insert(_yellow, c);
+	}
+	return p;
+    }
+}
+
+void
+HTB::run_timer(Timer *)
+{
+    wheel_advance(click_jiffies());
+    if (_green.head || _yellow.head)
+	_empty_note.wake();
+    else
+	schedule_timer();
+}
+
+enum { h_classes, h_stats };
+
+String
+HTB::read_handler(Element *e, void *thunk)
+{
+    HTB *htb = static_cast<HTB *>(e);
+    StringAccum sa;
+    for (int i = 0; i < htb->_classes.size(); ++i) {
+	Class *c = htb->_classes[i];
+	if (reinterpret_cast<intptr_t>(thunk) == h_classes)
+	    sa << unparse_spec(c->spec) << '\n';
+	else
+	    sa << c->spec.id << ' ' << c->spec.parent << ' ' << c->qlen << ' '
+	       << c->packets << ' ' << c->bytes << ' ' << c->drops << ' '
+	       << c->borrows << '\n';
+    }
+    return sa.take_string();
+}
+
+int
+HTB::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    HTB *htb = static_cast<HTB *>(e);
+    Vector<Spec> specs;
+    const char *s = str.begin(), *end = str.end();
+    while (s != end) {
+	const char *eol = find(s, end, '\n');
+	String line = cp_uncomment(str.substring(s, eol));
+	if (line) {
+	    specs.push_back(Spec());
+	    if (htb->parse_spec(line, specs.back(), errh) < 0)
+		return -EINVAL;
+	}
+	s = eol + (eol != end);
+    }
+    return htb->add_classes(specs, errh);
+}
+
+void
+HTB::add_handlers()
+{
+    add_read_handler("classes", read_handler, h_classes, Handler::CALM);
+    add_write_handler("classes", write_handler, h_classes);
+    add_read_handler("stats", read_handler, h_stats);
+    add_data_handlers("length", Handler::OP_READ, &_length);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(HTB)
@@ -0,0 +1,251 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HTB_HH
+#define CLICK_HTB_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/timer.hh>
+#include <click/tokenbucket.hh>
+#include <click/hashtable.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HTB([I<keywords> CLASS, DEFAULT, ANNO, CAPACITY])
+
+=s shaping
+
+hierarchical token bucket shaper
+
+=d
+
+HTB shapes traffic for many classes at once, with a class hierarchy like
+that of Linux's HTB queueing discipline.  Packets pushed on its input are
+assigned to a class by a four-byte annotation, by default the aggregate
+annotation, and queued in that class.  Its pull output emits packets in an
+order that gives each class its guaranteed RATE and shares spare bandwidth
+up to each class's CEIL.
+
+Each class is configured with a CLASS keyword argument, which may be
+repeated, of the form "I<id> [PARENT I<parent>] RATE I<rate> [I<options>]".
+I<id> is a positive integer.  A class without a PARENT is a root.  The
+options are:
+
+=over 8
+
+=item RATE
+
+Bandwidth.  The class's guaranteed rate.
+
+=item CEIL
+
+Bandwidth.  The maximum rate the class may reach by borrowing from its
+ancestors.  Default is RATE.
+
+=item BURST
+
+Integer.  Bytes the class may send at once above RATE.  Default is 10
+milliseconds of RATE plus 1514.
+
+=item CBURST
+
+Integer.  Bytes the class may send at once above CEIL.  Default is 10
+milliseconds of CEIL plus 1514.
+
+=item CAPACITY
+
+Integer.  Maximum number of packets queued in the class.  Defaults to
+HTB's CAPACITY.
+
+=back
+
+Only leaf classes, which have no children, hold packets; packets for other
+classes, or for unknown classes when DEFAULT is not set, are dropped.  A
+leaf class may send a packet when it and all its ancestors are within CEIL.
+It sends at its own RATE if it can, and otherwise borrows from the nearest
+ancestor that is within its RATE.  A packet counts against RATE and CEIL for
+the leaf and every ancestor.  Leaves sending at their own RATE are served
+before leaves that borrow, each group in round robin order.
+
+HTB does not poll its classes.  Backlogged leaves that cannot send are kept
+in a calendar queue, a timing wheel with one slot per jiffy, at the time
+their token buckets will allow their next packet.  Pulling a packet
+advances the wheel and takes the first eligible leaf, so the cost of a pull
+does not depend on the number of classes.  A timer wakes downstream pullers
+when a class becomes eligible.  Token buckets use TokenBucket, whose time
+unit is the jiffy, so rates are enforced over intervals of a few jiffies.
+
+Dropped packets are emitted on output 1 if it exists, and otherwise freed.
+
+Keyword arguments are:
+
+=over 8
+
+=item CLASS
+
+A class specification, as above.  May be given any number of times.
+
+=item DEFAULT
+
+Integer.  The class for packets whose annotation names no class.  Default
+is none.
+
+=item ANNO
+
+Annotation offset.  The four-byte annotation holding the class ID, in host
+byte order.  Default is the aggregate annotation.
+
+=item CAPACITY
+
+Integer.  Default maximum number of packets queued per class.  Default is
+1000.
+
+=back
+
+=h classes read/write
+
+Returns the class specifications, one per line.  Writing a list of class
+specifications, one per line, adds those classes, or replaces the options of
+existing classes; omitted options take their defaults.  A class's parent
+cannot be changed, and a leaf holding
+packets cannot gain children.  The write fails without effect if any line
+is invalid.
+
+=h stats read-only
+
+Returns one line per class, containing the class ID, the parent ID (0 for
+roots), the number of packets queued, the number of packets and bytes sent,
+the number of packets dropped, and the number of packets sent by borrowing.
+
+=h length read-only
+
+Returns the total number of packets queued.
+
+=h drops read-only
+
+Returns the total number of packets dropped.
+
+=e
+
+  ... -> AggregateIP(ip dst) -> htb :: HTB(CLASS 1 RATE 100Mbps,
+          CLASS 2 PARENT 1 RATE 60Mbps CEIL 100Mbps,
+          CLASS 3 PARENT 1 RATE 40Mbps CEIL 100Mbps, DEFAULT 3)
+      -> ToDevice(eth0);
+
+With this configuration, htb.classes can later be written with lines like
+"4 PARENT 1 RATE 10Mbps".
+
+=a BandwidthShaper, BandwidthRatedUnqueue, LinkUnqueue, PrioSched,
+StrideSched */
+
+class HTB : public Element { public:
+
+    HTB();
+    ~HTB();
+
+    const char *class_name() const	{ return "HTB"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void run_timer(Timer *timer);
+
+  private:
+
+    enum { sched_idle, sched_green, sched_yellow, sched_blocked };
+    enum { wheel_order = 10, wheel_size = 1 << wheel_order };
+
+    struct Class;
+    struct ClassList {
+	Class *head;
+	Class *tail;
+	ClassList() : head(0), tail(0) {}
+    };
+
+    struct Spec {
+	uint32_t id;
+	uint32_t parent;
+	uint32_t rate;
+	uint32_t ceil;
+	uint32_t burst;
+	uint32_t cburst;
+	uint32_t capacity;
+    };
+
+    struct Class {
+	Spec spec;
+	Class *parent;
+	int nchildren;
+	TokenBucket rate;
+	TokenBucket ceil;
+
+	Packet *head;
+	Packet *tail;
+	uint32_t qlen;
+
+	int sched;
+	Class *rprev;		// in _green or _yellow
+	Class *rnext;
+	Class *wprev;		// in a wheel slot
+	Class *wnext;
+	click_jiffies_t due;
+	bool in_wheel;
+
+	uint32_t packets;
+	uint64_t bytes;
+	uint32_t drops;
+	uint32_t borrows;
+    };
+
+    Vector<Class *> _classes;
+    HashTable<uint32_t, Class *> _class_map;
+    Class *_default;
+    uint32_t _default_id;
+    int _anno;
+    uint32_t _capacity;
+
+    ClassList _green;
+    ClassList _yellow;
+    ClassList _wheel[wheel_size];
+    uint32_t _wheel_bits[wheel_size / 32];
+    uint32_t _wheel_count;
+    click_jiffies_t _wheel_jiffy;
+
+    uint32_t _length;
+    uint32_t _drops;
+
+    ActiveNotifier _empty_note;
+    Timer _timer;
+    click_jiffies_t _timer_jiffy;
+
+    int parse_spec(const String &str, Spec &spec, ErrorHandler *errh) const;
+    static String unparse_spec(const Spec &spec);
+    int add_classes(const Vector<Spec> &specs, ErrorHandler *errh);
+    void apply_spec(Class *c, const Spec &spec);
+
+    static void list_insert(ClassList &l, Class *c);
+    static void list_remove(ClassList &l, Class *c);
+    void wheel_insert(Class *c, click_jiffies_t due);
+    void wheel_remove(Class *c);
+    void wheel_advance(click_jiffies_t now);
+    void schedule_timer();
+
+    int evaluate(Class *c, click_jiffies_t now, click_jiffies_t &due);
+    void reschedule(Class *c, click_jiffies_t now);
+    void unschedule(Class *c);
+    void drop(Class *c, Packet *p);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
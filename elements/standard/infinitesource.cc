@@ -30,7 +30,8 @@
 CLICK_DECLS
 
 InfiniteSource::InfiniteSource()
-    : _packet(0), _task(this), _end_h(0)
+    : _packet(0), _headroom(Packet::default_headroom), _copy(false),
+      _timestamp(true), _timestamp_auto(true), _task(this), _end_h(0)
 {
 }
 
@@ -57,7 +58,7 @@ InfiniteSource::configure(Vector<String> &conf, ErrorHandler *errh)
     counter_t limit = -1;
     int burstsize = 1;
     int datasize = -1;
-    bool active = true, stop = false, timestamp = true;
+    bool active = true, stop = false, timestamp = true, timestamp_set;
     HandlerCall end_h;
 
     if (Args(conf, this, errh)
@@ -65,7 +66,7 @@ InfiniteSource::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read_p("LIMIT", limit)
 	.read_p("BURST", burstsize)
 	.read_p("ACTIVE", active)
-	.read("TIMESTAMP", timestamp)
+	.read("TIMESTAMP", timestamp).read_status(timestamp_set)
 	.read("LENGTH", datasize)
 	.read("DATASIZE", datasize) // deprecated
 	.read("STOP", stop)
@@ -83,7 +84,8 @@ InfiniteSource::configure(Vector<String> &conf, ErrorHandler *errh)
     _burstsize = burstsize;
     _count = 0;
     _active = active;
-    _timestamp = timestamp;
+    _timestamp_auto = !timestamp_set;
+    _timestamp = timestamp_set ? timestamp : router()->timestamp_required(this);
     delete _end_h;
     if (end_h)
 	_end_h = new HandlerCall(end_h);
@@ -106,9 +108,34 @@ InfiniteSource::initialize(ErrorHandler *errh)
     }
     if (_end_h && _end_h->initialize_write(this, errh) < 0)
 	return -1;
+    // Leave room for downstream encapsulations, and start the data where
+    // downstream elements want it aligned.
+    uint32_t need = router()->headroom_required(this);
+    _copy = need > 0;
+    uint32_t headroom = _headroom;
+    if (need > headroom)
+	headroom += (need - headroom + 3) & ~3;
+    headroom = router()->aligned_headroom(this, headroom);
+    if (headroom != _headroom) {
+	_headroom = headroom;
+	if (_packet)
+	    setup_packet();
+    }
+    // Skip the clock unless something downstream reads timestamps.
+    if (_timestamp_auto)
+	_timestamp = router()->timestamp_required(this);
     return 0;
 }
 
+inline Packet *
+InfiniteSource::next_packet()
+{
+    if (_copy)
+	return Packet::make(_headroom, _packet->data(), _packet->length(), 0);
+    else
+	return _packet->clone();
+}
+
 void
 InfiniteSource::cleanup(CleanupStage)
 {
@@ -125,7 +152,7 @@ InfiniteSource::run_task(Task *)
     if (_limit >= 0 && _count + n >= (ucounter_t) _limit)
 	n = (_count > (ucounter_t) _limit ? 0 : _limit - _count);
     for (int i = 0; i < n; i++) {
-	Packet *p = _packet->clone();
+	Packet *p = next_packet();
 	if (_timestamp)
 	    p->timestamp_anno().assign_now();
 	output(0).push(p);
@@ -153,7 +180,7 @@ InfiniteSource::pull(int)
 	goto done;
     }
     _count++;
-    Packet *p = _packet->clone();
+    Packet *p = next_packet();
     if (_timestamp)
 	p->timestamp_anno().assign_now();
     return p;
@@ -166,15 +193,15 @@ InfiniteSource::setup_packet()
 	_packet->kill();
 
     if (_datasize < 0)
-	_packet = Packet::make(_data.data(), _data.length());
+	_packet = Packet::make(_headroom, _data.data(), _data.length(), 0);
     else if (_datasize <= _data.length())
-	_packet = Packet::make(_data.data(), _datasize);
+	_packet = Packet::make(_headroom, _data.data(), _datasize, 0);
     else {
 	// make up some data to fill extra space
 	StringAccum sa;
 	while (sa.length() < _datasize)
 	    sa << _data;
-	_packet = Packet::make(sa.data(), _datasize);
+	_packet = Packet::make(_headroom, sa.data(), _datasize, 0);
     }
 }
 
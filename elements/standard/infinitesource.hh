@@ -60,8 +60,10 @@ STOP are mutually exclusive.
 
 =item TIMESTAMP
 
-Boolean. If false, do not set the timestamp annotation on generated
-packets. Defaults to true.
+Boolean. If true, set the timestamp annotation on generated packets to the
+current time; if false, do not set it. By default, InfiniteSource sets it
+only if some element downstream reads timestamp annotations (see
+Router::timestamp_required).
 
 =back
 
@@ -74,11 +76,16 @@ in conjunction with Script.
 
 =n
 
-Useful for profiling and experiments.  Packets' timestamp annotations are set
-to the current time.
+Useful for profiling and experiments.
 
 InfiniteSource listens for downstream full notification.
 
+InfiniteSource leaves enough headroom in its packets for any encapsulation
+elements downstream, such as EtherEncap or IPEncap (see
+Router::headroom_required).  When such elements exist, it emits a fresh
+copy of DATA for each packet rather than a clone, since pushing a header onto
+a clone's shared data would copy it anyway.
+
 =h count read-only
 Returns the total number of packets that have been generated.
 =h reset write-only
@@ -129,14 +136,18 @@ class InfiniteSource : public Element, public ActiveNotifier { public:
 #endif
 
     void setup_packet();
+    inline Packet *next_packet();
 
     Packet *_packet;
+    uint32_t _headroom;
+    bool _copy;
     int _burstsize;
     counter_t _limit;
     ucounter_t _count;
     int _datasize;
     bool _active;
     bool _timestamp;
+    bool _timestamp_auto;
     Task _task;
     String _data;
     NotifierSignal _nonfull_signal;
@@ -5,7 +5,7 @@ CLICK_DECLS
 
 /*
  * =c
- * Meter(RATE1, RATE2, ..., RATEI<n>)
+ * Meter(RATE1, RATE2, ..., RATEI<n> [, I<keywords> SHARDED])
  * =s shaping
  * classifies packet stream by rate (pkt/s)
  * =d
@@ -22,6 +22,9 @@ CLICK_DECLS
  * are sent to output 0; if it is >= RATE1 but < RATE2, packets are sent to
  * output 1; and so on. If it is >= RATEI<n>, packets are sent to output I<n>.
  *
+ * SHARDED is a boolean, false by default. If true, Meter measures the rate
+ * separately on each thread, as described for BandwidthMeter.
+ *
  * =n
  *
  * The entire packet stream is sent to the output corresponding to the current
@@ -44,7 +44,7 @@ MixedQueue::push(int port, Packet *p)
 
     if (port == 0) {		// FIFO insert, drop new packet if full
 	int h = _head, t = _tail, nt = next_i(t);
-	if (nt == h) {
+	if (nt == h || !pool_admit(p)) {
 	    if (_drops == 0 && _capacity > 0)
 		click_chatter("%{element}: overflow", this);
 	    _drops++;
@@ -54,6 +54,9 @@ MixedQueue::push(int port, Packet *p)
 	    packet_memory_barrier(_q[t], _tail);
 	    _tail = nt;
 	}
+    } else if (!pool_admit(p)) {
+	oldp = p;		// the pool refused the new packet
+	_drops++;
     } else {			// LIFO insert, drop old packet if full
 	int h = _head, t = _tail, ph = prev_i(h);
 	if (ph == t) {
@@ -64,6 +67,7 @@ MixedQueue::push(int port, Packet *p)
 	    oldp = _q[t];
 	    packet_memory_barrier(_q[t], _tail);
 	    _tail = t;
+	    pool_release(oldp);
 	}
 	_q[ph] = p;
 	packet_memory_barrier(_q[ph], _head);
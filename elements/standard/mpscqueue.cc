@@ -0,0 +1,309 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * mpscqueue.{cc,hh} -- queue element with many lock-free pushers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "mpscqueue.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+// The queue is an intrusive multi-producer, single-consumer list in the
+// style of Dmitry Vyukov.  Packets are linked through their next()
+// annotations from _tail (oldest) to _head (newest).  A stub packet keeps
+// the list nonempty, so pushers never touch _tail and the puller touches
+// _head only when the list might be empty.
+
+static inline Packet *
+packet_exchange(Packet * volatile &x, Packet *p)
+{
+#if CLICK_LINUXMODULE
+    return xchg(&x, p);
+#elif HAVE_MULTITHREAD
+    click_fence();
+    return __sync_lock_test_and_set(&x, p);
+#else
+    Packet *old = x;
+    x = p;
+    return old;
+#endif
+}
+
+MPSCQueue::MPSCQueue()
+    : _head(0), _tail(0), _stub(0), _sleepiness(0),
+      _capacity(1000), _highwater_length(0)
+{
+    _size = _drops = 0;
+}
+
+MPSCQueue::~MPSCQueue()
+{
+}
+
+void *
+MPSCQueue::cast(const char *n)
+{
+    if (strcmp(n, "MPSCQueue") == 0)
+	return (MPSCQueue *)this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else if (strcmp(n, Notifier::FULL_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_full_note);
+    else
+	return Element::cast(n);
+}
+
+int
+MPSCQueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    _full_note.initialize(Notifier::FULL_NOTIFIER, router());
+    _full_note.set_active(true, false);
+    return live_reconfigure(conf, errh);
+}
+
+int
+MPSCQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
+{
+    unsigned new_capacity = 1000;
+    if (Args(conf, this, errh).read_p("CAPACITY", new_capacity).complete() < 0)
+	return -1;
+    _capacity = new_capacity;
+    if (size() < capacity())
+	_full_note.wake();
+    return 0;
+}
+
+int
+MPSCQueue::initialize(ErrorHandler *errh)
+{
+    if (!(_stub = Packet::make(0)))
+	return errh->error("out of memory!");
+    _stub->set_next(0);
+    _head = _tail = _stub;
+    return 0;
+}
+
+void
+MPSCQueue::cleanup(CleanupStage)
+{
+    if (_stub) {
+	while (Packet *p = unlink())
+	    p->kill();
+	_stub->kill();
+	_stub = 0;
+    }
+}
+
+size_t
+MPSCQueue::memory_usage() const
+{
+    size_t m = 0;
+    for (Packet *p = _tail; p; p = p->next())
+	if (p != _stub)
+	    m += sizeof(WritablePacket) + p->buffer_length();
+    return m;
+}
+
+inline void
+MPSCQueue::link(Packet *first, Packet *last)
+{
+    last->set_next(0);
+    Packet *prev = packet_exchange(_head, last);
+    // Until this store, the puller cannot see [first, last].
+    prev->set_next(first);
+}
+
+inline Packet *
+MPSCQueue::unlink()
+{
+    Packet *tail = _tail, *next = tail->next();
+    if (tail == _stub) {
+	if (!next)
+	    return 0;
+	_tail = tail = next;
+	next = next->next();
+    }
+    if (!next) {
+	// Either the queue holds one packet, or a pusher has exchanged
+	// _head but not yet linked its packets.  In the latter case, report
+	// empty; the packets appear shortly.
+	if (tail != _head)
+	    return 0;
+	link(_stub, _stub);
+	if (!(next = tail->next()))
+	    return 0;
+    }
+    _tail = next;
+    tail->set_next(0);
+    return tail;
+}
+
+inline void
+MPSCQueue::check_full(uint32_t s)
+{
+    if ((int) s > _highwater_length)
+	_highwater_length = s;
+
+    _empty_note.wake();
+
+    if ((int) s >= _capacity) {
+	_full_note.sleep();
+#if HAVE_MULTITHREAD
+	// Work around race condition between push() and pull().
+	// We might have just undone pull()'s Notifier::wake() call.
+	// Easiest lock-free solution: check whether we should wake again!
+	if (size() < capacity())
+	    _full_note.wake();
+#endif
+    }
+}
+
+inline void
+MPSCQueue::push_failure(Packet *p)
+{
+    if (_drops == 0 && _capacity > 0)
+	click_chatter("%{element}: overflow", this);
+    _drops++;
+    checked_output_push(1, p);
+}
+
+inline void
+MPSCQueue::pull_failure()
+{
+    if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+#if HAVE_MULTITHREAD
+	// Work around race condition between push() and pull().
+	// We might have just undone push()'s Notifier::wake() call.
+	// Easiest lock-free solution: check whether we should wake again!
+	if (size())
+	    _empty_note.wake();
+#endif
+    } else
+	++_sleepiness;
+}
+
+void
+MPSCQueue::push(int, Packet *p)
+{
+    // Reserve space first, so the queue never exceeds its capacity.
+    uint32_t s = _size.fetch_and_add(1) + 1;
+    if ((int) s <= _capacity) {
+	link(p, p);
+	check_full(s);
+    } else {
+	_size -= 1;
+	push_failure(p);
+    }
+}
+
+void
+MPSCQueue::push_batch(int, PacketBatch &batch)
+{
+    int n = batch.count();
+    uint32_t s = _size.fetch_and_add(n) + n;
+    if ((int) s <= _capacity) {
+	Packet *last = batch.back();
+	link(batch.take(), last);
+	check_full(s);
+    } else {
+	// Not enough room for the whole batch; take what fits.
+	_size -= n;
+	while (Packet *p = batch.pop_front())
+	    push(0, p);
+    }
+}
+
+Packet *
+MPSCQueue::pull(int)
+{
+    Packet *p = unlink();
+    if (p) {
+	_size -= 1;
+	_sleepiness = 0;
+	_full_note.wake();
+    } else
+	pull_failure();
+    return p;
+}
+
+void
+MPSCQueue::pull_batch(int, PacketBatch &batch, int max)
+{
+    int n = 0;
+    for (; n < max; ++n)
+	if (Packet *p = unlink())
+	    batch.push_back(p);
+	else
+	    break;
+    if (n) {
+	_size -= n;
+	_sleepiness = 0;
+	_full_note.wake();
+    } else
+	pull_failure();
+}
+
+String
+MPSCQueue::read_handler(Element *e, void *thunk)
+{
+    MPSCQueue *q = static_cast<MPSCQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+      case 0:
+	return String(q->size());
+      case 1:
+	return String(q->highwater_length());
+      case 2:
+	return String(q->capacity());
+      case 3:
+	return String(q->drops());
+      default:
+	return "";
+    }
+}
+
+int
+MPSCQueue::write_handler(const String &, Element *e, void *thunk, ErrorHandler *errh)
+{
+    MPSCQueue *q = static_cast<MPSCQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+      case 0:
+	q->_drops = 0;
+	q->_highwater_length = q->size();
+	return 0;
+      case 1:
+	while (Packet *p = q->pull(0))
+	    q->checked_output_push(1, p);
+	return 0;
+      default:
+	return errh->error("internal error");
+    }
+}
+
+void
+MPSCQueue::add_handlers()
+{
+    add_read_handler("length", read_handler, 0);
+    add_read_handler("highwater_length", read_handler, 1);
+    add_read_handler("capacity", read_handler, 2, Handler::CALM);
+    add_read_handler("drops", read_handler, 3);
+    add_write_handler("capacity", reconfigure_keyword_handler, "0 CAPACITY");
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON | Handler::NONEXCLUSIVE);
+    add_write_handler("reset", write_handler, 1, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(MPSCQueue)
@@ -0,0 +1,130 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MPSCQUEUE_HH
+#define CLICK_MPSCQUEUE_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+MPSCQueue
+MPSCQueue(CAPACITY)
+
+=s storage
+
+stores packets in a FIFO queue with many concurrent pushers
+
+=d
+
+Stores incoming packets in a first-in-first-out queue.
+Drops incoming packets if the queue already holds CAPACITY packets.
+The default for CAPACITY is 1000.
+
+MPSCQueue supports any number of concurrent pushers, but at most one
+concurrent puller.  Rather than reserving slots in a ring, pushers link
+packets onto the queue through their next() annotations with a single atomic
+exchange, so pushers running on different threads never wait for one another.
+A batch pushed with push_batch costs one atomic exchange for the whole batch.
+Use MPSCQueue where several threads feed one output thread; ThreadSafeQueue
+is better when there are also several pullers.
+
+Like Queue, MPSCQueue has non-full and non-empty notifiers.  Unlike Queue,
+reducing the capacity does not drop packets already in the queue.  Dropped packets
+are emitted on output 1, if it is present.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in the queue at once.
+
+=h capacity read/write
+
+Returns or sets the queue's capacity.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h reset_counts write-only
+
+When written, resets the C<drops> and C<highwater_length> counters.
+
+=h reset write-only
+
+When written, drops all packets in the queue.  This handler pulls from the
+queue, so it must not run concurrently with the puller.
+
+=h memory read-only
+
+Returns the number of bytes held by queued packets and their data buffers.
+
+=a Queue, ThreadSafeQueue, SimpleQueue */
+
+class MPSCQueue : public Element { public:
+
+    MPSCQueue();
+    ~MPSCQueue();
+
+    const char *class_name() const		{ return "MPSCQueue"; }
+    const char *port_count() const		{ return PORTS_1_1X2; }
+    const char *processing() const		{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    bool can_live_reconfigure() const		{ return true; }
+    int live_reconfigure(Vector<String> &conf, ErrorHandler *errh);
+    size_t memory_usage() const;
+    void add_handlers();
+
+    int size() const				{ return _size; }
+    int capacity() const			{ return _capacity; }
+    int drops() const				{ return _drops; }
+    int highwater_length() const		{ return _highwater_length; }
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
+
+  private:
+
+    enum { SLEEPINESS_TRIGGER = 9 };
+    enum { CACHE_LINE_SIZE = 64 };
+
+    // Pushers exchange _head; the puller owns _tail.  Keep them on
+    // separate cache lines.
+    Packet * volatile _head;
+    char _head_pad[CACHE_LINE_SIZE - sizeof(Packet *)];
+    Packet *_tail;
+    Packet *_stub;
+    int _sleepiness;
+    char _tail_pad[CACHE_LINE_SIZE - 2 * sizeof(Packet *) - sizeof(int)];
+
+    atomic_uint32_t _size;
+    atomic_uint32_t _drops;
+    int _capacity;
+    int _highwater_length;
+
+    ActiveNotifier _empty_note;
+    ActiveNotifier _full_note;
+
+    inline void link(Packet *first, Packet *last);
+    inline Packet *unlink();
+    inline void push_failure(Packet *p);
+    inline void check_full(uint32_t s);
+    inline void pull_failure();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
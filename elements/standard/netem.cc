@@ -0,0 +1,344 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * netem.{cc,hh} -- element emulates network delay, jitter, loss, and
+ * duplication with a calendar queue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "netem.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+
+NetEm::NetEm()
+    : _buckets(0), _bucket_bits(0), _timer(this)
+{
+}
+
+NetEm::~NetEm()
+{
+}
+
+int
+NetEm::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String dist = "uniform";
+    Timestamp resolution = Timestamp::make_usec(100);
+    _delay = _jitter = Timestamp();
+    _reorder = true;
+    _loss = _duplicate = 0;
+    _rate = 0;
+    _limit = 1000;
+    if (Args(conf, this, errh)
+	.read_p("DELAY", _delay)
+	.read("JITTER", _jitter)
+	.read("DISTRIBUTION", WordArg(), dist)
+	.read("REORDER", _reorder)
+	.read("LOSS", FixedPointArg(PROB_SHIFT), _loss)
+	.read("DUPLICATE", FixedPointArg(PROB_SHIFT), _duplicate)
+	.read("RATE", BandwidthArg(), _rate)
+	.read("LIMIT", _limit)
+	.read("RESOLUTION", resolution)
+	.complete() < 0)
+	return -1;
+
+    if (dist == "uniform")
+	_distribution = dist_uniform;
+    else if (dist == "normal")
+	_distribution = dist_normal;
+    else
+	return errh->error("bad DISTRIBUTION");
+    if (_loss > (1 << PROB_SHIFT) || _duplicate > (1 << PROB_SHIFT))
+	return errh->error("LOSS and DUPLICATE must be between 0 and 1");
+    if (_delay < Timestamp() || _jitter < Timestamp())
+	return errh->error("DELAY and JITTER must be nonnegative");
+    if ((_resolution = resolution.nsecval()) <= 0)
+	return errh->error("RESOLUTION must be positive");
+    return 0;
+}
+
+int
+NetEm::initialize(ErrorHandler *errh)
+{
+    // cover DELAY plus nearly all jitter; later packets use the overflow
+    int64_t span = _delay.nsecval()
+	+ _jitter.nsecval() * (_distribution == dist_normal ? 4 : 1);
+    uint64_t want = span / _resolution + 2;
+    _nbuckets = 256;
+    while (_nbuckets < want && _nbuckets < (1U << 20))
+	_nbuckets <<= 1;
+
+    _buckets = new PacketBatch[_nbuckets];
+    _bucket_bits = new uint32_t[_nbuckets / 32];
+    if (!_buckets || !_bucket_bits)
+	return errh->error("out of memory");
+    memset(_bucket_bits, 0, sizeof(uint32_t) * (_nbuckets / 32));
+
+    _base = Timestamp::now().nsecval() / _resolution;
+    _overflow_min = 0;
+    _link_free = _last_release = Timestamp();
+    _length = _drops = _losses = _duplicates = 0;
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+NetEm::cleanup(CleanupStage)
+{
+    if (_buckets)
+	for (uint32_t i = 0; i < _nbuckets; ++i)
+	    _buckets[i].kill();
+    _overflow.kill();
+    delete[] _buckets;
+    delete[] _bucket_bits;
+    _buckets = 0;
+    _bucket_bits = 0;
+}
+
+Timestamp
+NetEm::jitter()
+{
+    int64_t j = _jitter.nsecval();
+    if (_distribution == dist_uniform) {
+	// uniform in [-j, j]
+	uint64_t r = click_random() & 0x7FFFFFFF;
+	return Timestamp::make_nsec((int64_t) ((r * (2 * j + 1)) >> 31) - j);
+    } else {
+	// Irwin-Hall: the sum of 12 uniforms on [0, 1), less 6, is nearly
+	// standard normal
+	int64_t s = 0;
+	for (int i = 0; i < 6; ++i) {
+	    uint32_t r = click_random();
+	    s += (r & 0x7FFF) + ((r >> 15) & 0x7FFF);
+	}
+	s -= 12 * 0x7FFF / 2;
+	return Timestamp::make_nsec(s * j / 0x8000);
+    }
+}
+
+inline void
+NetEm::insert(Packet *p, uint64_t tick)
+{
+    if (tick < _base)
+	tick = _base;
+    if (tick - _base >= _nbuckets) {
+	if (_overflow.empty() || tick < _overflow_min)
+	    _overflow_min = tick;
+	_overflow.push_back(p);
+    } else {
+	uint32_t b = tick & (_nbuckets - 1);
+	_buckets[b].push_back(p);
+	_bucket_bits[b >> 5] |= 1U << (b & 31);
+    }
+    if (!_timer.scheduled() || tick < _timer_tick) {
+	_timer_tick = tick;
+	_timer.schedule_at(Timestamp::make_nsec(tick * _resolution));
+    }
+}
+
+void
+NetEm::enqueue(Packet *p, const Timestamp &now)
+{
+    Timestamp release = now + _delay;
+    if (_jitter) {
+	release += jitter();
+	if (release < now)
+	    release = now;
+    }
+    if (!_reorder && release < _last_release)
+	release = _last_release;
+    if (_rate) {
+	if (release < _link_free)
+	    release = _link_free;
+	release += Timestamp::make_nsec((int64_t) p->length() * 1000000000 / _rate);
+	_link_free = release;
+    }
+    _last_release = release;
+
+    p->timestamp_anno() = release;
+    ++_length;
+    // round up, so packets are never released early
+    insert(p, (release.nsecval() + _resolution - 1) / _resolution);
+}
+
+void
+NetEm::push(int, Packet *p)
+{
+    if (_loss && (click_random() & PROB_MASK) < _loss) {
+	++_losses;
+	p->kill();
+	return;
+    }
+
+    Timestamp now = Timestamp::now();
+    if (_duplicate && (click_random() & PROB_MASK) < _duplicate)
+	if (Packet *q = p->clone()) {
+	    ++_duplicates;
+	    if (_length < _limit)
+		enqueue(q, now);
+	    else {
+		++_drops;
+		checked_output_push(1, q);
+	    }
+	}
+
+    if (_length < _limit)
+	enqueue(p, now);
+    else {
+	++_drops;
+	checked_output_push(1, p);
+    }
+}
+
+// Moves overflow packets that now fall within the calendar into buckets.
+void
+NetEm::redistribute_overflow()
+{
+    PacketBatch later;
+    later.swap(_overflow);
+    while (Packet *p = later.pop_front())
+	insert(p, (p->timestamp_anno().nsecval() + _resolution - 1) / _resolution);
+}
+
+void
+NetEm::schedule_timer()
+{
+    uint64_t tick = 0;
+    bool found = false;
+    // find the first nonempty bucket at or after _base
+    uint32_t start = _base & (_nbuckets - 1);
+    for (uint32_t offset = 0; offset < _nbuckets + 32; ) {
+	uint32_t b = (start + offset) & (_nbuckets - 1);
+	if (uint32_t bits = _bucket_bits[b >> 5] >> (b & 31)) {
+	    tick = _base + offset + ffs_lsb(bits) - 1;
+	    found = true;
+	    break;
+	}
+	offset += 32 - (b & 31);
+    }
+    if (!_overflow.empty() && (!found || _overflow_min < tick)) {
+	tick = _overflow_min;
+	found = true;
+    }
+    if (found) {
+	_timer_tick = tick;
+	_timer.schedule_at(Timestamp::make_nsec(tick * _resolution));
+    }
+}
+
+void
+NetEm::run_timer(Timer *)
+{
+    uint64_t end = Timestamp::now().nsecval() / _resolution + 1;
+    PacketBatch out;
+    if (end > _base) {
+	uint64_t stop = end - _base > _nbuckets ? _base + _nbuckets : end;
+	if (_length > (uint32_t) _overflow.count())
+	    for (uint64_t tick = _base; tick < stop; ++tick) {
+		uint32_t b = tick & (_nbuckets - 1);
+		if (_bucket_bits[b >> 5] & (1U << (b & 31))) {
+		    out.append(_buckets[b]);
+		    _bucket_bits[b >> 5] &= ~(1U << (b & 31));
+		}
+	    }
+	_base = end;
+	if (!_overflow.empty() && _overflow_min < _base + _nbuckets)
+	    redistribute_overflow();
+    }
+
+    _length -= out.count();
+    if (_length)
+	schedule_timer();
+    output(0).push_batch(out);
+}
+
+enum { h_delay, h_jitter, h_loss, h_duplicate, h_rate, h_limit };
+
+String
+NetEm::read_handler(Element *e, void *thunk)
+{
+    NetEm *ne = static_cast<NetEm *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_delay:
+	return ne->_delay.unparse_interval();
+    case h_jitter:
+	return ne->_jitter.unparse_interval();
+    case h_loss:
+	return cp_unparse_real2(ne->_loss, PROB_SHIFT);
+    case h_duplicate:
+	return cp_unparse_real2(ne->_duplicate, PROB_SHIFT);
+    case h_rate:
+	return BandwidthArg::unparse(ne->_rate);
+    case h_limit:
+	return String(ne->_limit);
+    default:
+	return String();
+    }
+}
+
+int
+NetEm::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    NetEm *ne = static_cast<NetEm *>(e);
+    Args args(e, errh);
+    args.push_back_words(str);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_delay:
+    case h_jitter: {
+	Timestamp t;
+	if (args.read_mp("TIME", t).complete() < 0)
+	    return -1;
+	if (t < Timestamp())
+	    return errh->error("time must be nonnegative");
+	(thunk == (void *) h_delay ? ne->_delay : ne->_jitter) = t;
+	return 0;
+    }
+    case h_loss:
+    case h_duplicate: {
+	uint32_t prob;
+	if (args.read_mp("P", FixedPointArg(PROB_SHIFT), prob).complete() < 0)
+	    return -1;
+	if (prob > (1 << PROB_SHIFT))
+	    return errh->error("probability must be between 0 and 1");
+	(thunk == (void *) h_loss ? ne->_loss : ne->_duplicate) = prob;
+	return 0;
+    }
+    case h_rate:
+	return args.read_mp("RATE", BandwidthArg(), ne->_rate).complete();
+    case h_limit:
+	return args.read_mp("LIMIT", ne->_limit).complete();
+    default:
+	return -1;
+    }
+}
+
+void
+NetEm::add_handlers()
+{
+    static const char * const names[] = {
+	"delay", "jitter", "loss", "duplicate", "rate", "limit"
+    };
+    for (intptr_t h = h_delay; h <= h_limit; ++h) {
+	add_read_handler(names[h], read_handler, h);
+	add_write_handler(names[h], write_handler, h);
+    }
+    add_data_handlers("length", Handler::OP_READ, &_length);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+    add_data_handlers("losses", Handler::OP_READ, &_losses);
+    add_data_handlers("duplicates", Handler::OP_READ, &_duplicates);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(NetEm)
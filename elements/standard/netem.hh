@@ -0,0 +1,200 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_NETEM_HH
+#define CLICK_NETEM_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/packetbatch.hh>
+CLICK_DECLS
+
+/*
+=c
+
+NetEm([DELAY, I<keywords> JITTER, DISTRIBUTION, REORDER, LOSS, DUPLICATE, RATE, LIMIT, RESOLUTION])
+
+=s shaping
+
+emulates wide-area network delay, jitter, loss, and duplication
+
+=d
+
+NetEm emulates a network path in the manner of Linux's netem queueing
+discipline.  It holds each packet pushed on its input until its release
+time, then pushes it to output 0.  A packet's release time is its arrival
+time plus DELAY, plus a random jitter drawn from DISTRIBUTION with spread
+JITTER.  Packets may be lost with probability LOSS, duplicated with
+probability DUPLICATE, and serialized onto a link of bandwidth RATE.
+
+Held packets live in a calendar queue: an array of buckets each covering
+RESOLUTION of time, with enough buckets to cover DELAY plus the likely
+jitter.  A packet is appended to the bucket for its release time in
+constant time, and a single timer releases each bucket, as a packet batch,
+when its time comes.  Packets are therefore released up to RESOLUTION late,
+and packets whose release times fall in the same bucket leave in arrival
+order.  Packets whose release times lie beyond the buckets wait in an
+overflow list until the calendar reaches them.  This lets NetEm model large
+delay-bandwidth products, such as 100ms at 10Gb/s, with per-packet cost
+that does not depend on the number of packets held.
+
+NetEm sets each released packet's timestamp annotation to its release time.
+Packets dropped because LIMIT packets are held are emitted on output 1 if
+it exists, and otherwise freed; lost packets are always freed.
+
+Keyword arguments are:
+
+=over 8
+
+=item DELAY
+
+Time.  The base delay.  Default is 0.
+
+=item JITTER
+
+Time.  The spread of the random delay added to DELAY.  Default is 0.
+
+=item DISTRIBUTION
+
+Either C<uniform>, for jitter uniformly distributed in [-JITTER, JITTER], or
+C<normal>, for jitter normally distributed with standard deviation JITTER.
+Release times are never earlier than arrival.  Default is C<uniform>.
+
+=item REORDER
+
+Boolean.  If false, packets are never released before packets that arrived
+earlier: a packet whose jitter would make it overtake its predecessor waits
+for it.  Default is true.
+
+=item LOSS
+
+Probability between 0 and 1 that a packet is lost.  Default is 0.
+
+=item DUPLICATE
+
+Probability between 0 and 1 that a packet is duplicated.  The duplicate gets
+its own jitter.  Default is 0.
+
+=item RATE
+
+Bandwidth.  If nonzero, packets are serialized at this rate after their
+delay, as if sent on a link of that bandwidth, which also prevents
+reordering.  Default is 0, meaning unlimited.
+
+=item LIMIT
+
+Integer.  Maximum number of packets held.  Default is 1000.
+
+=item RESOLUTION
+
+Time.  The width of a calendar bucket.  Default is 100us.
+
+=back
+
+=h delay read/write
+
+Returns or sets the DELAY parameter.
+
+=h jitter read/write
+
+Returns or sets the JITTER parameter.
+
+=h loss read/write
+
+Returns or sets the LOSS parameter.
+
+=h duplicate read/write
+
+Returns or sets the DUPLICATE parameter.
+
+=h rate read/write
+
+Returns or sets the RATE parameter.
+
+=h limit read/write
+
+Returns or sets the LIMIT parameter.
+
+=h length read-only
+
+Returns the number of packets held.
+
+=h drops read-only
+
+Returns the number of packets dropped because LIMIT was reached.
+
+=h losses read-only
+
+Returns the number of packets lost.
+
+=h duplicates read-only
+
+Returns the number of duplicate packets created.
+
+=e
+
+  FromDevice(eth0) -> NetEm(100ms, JITTER 5ms, LOSS 0.001, RATE 10Gbps,
+                            LIMIT 1500000) -> ToDevice(eth1);
+
+=a DelayShaper, DelayUnqueue, RandomSample, LinkUnqueue */
+
+class NetEm : public Element { public:
+
+    NetEm();
+    ~NetEm();
+
+    const char *class_name() const	{ return "NetEm"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void run_timer(Timer *timer);
+
+  private:
+
+    enum { PROB_SHIFT = 28, PROB_MASK = (1 << PROB_SHIFT) - 1 };
+    enum { dist_uniform, dist_normal };
+
+    Timestamp _delay;
+    Timestamp _jitter;
+    int _distribution;
+    bool _reorder;
+    uint32_t _loss;			// out of (1 << PROB_SHIFT)
+    uint32_t _duplicate;
+    uint32_t _rate;			// bytes per second
+    uint32_t _limit;
+    int64_t _resolution;		// nanoseconds
+
+    PacketBatch *_buckets;
+    uint32_t *_bucket_bits;
+    uint32_t _nbuckets;		// power of two
+    uint64_t _base;			// tick of the next bucket to release
+    PacketBatch _overflow;
+    uint64_t _overflow_min;		// earliest tick in _overflow
+
+    Timestamp _link_free;		// when a RATE-limited link is next idle
+    Timestamp _last_release;	// for REORDER false
+
+    uint32_t _length;
+    uint32_t _drops;
+    uint32_t _losses;
+    uint32_t _duplicates;
+
+    Timer _timer;
+    uint64_t _timer_tick;
+
+    Timestamp jitter();
+    void enqueue(Packet *p, const Timestamp &now);
+    void insert(Packet *p, uint64_t tick);
+    void redistribute_overflow();
+    void schedule_timer();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -54,7 +54,7 @@ NotifierQueue::push(int, Packet *p)
     // Code taken from SimpleQueue::push().
     int h = _head, t = _tail, nt = next_i(t);
 
-    if (nt != h) {
+    if (nt != h && pool_admit(p)) {
 	_q[t] = p;
 	packet_memory_barrier(_q[t], _tail);
 	_tail = nt;
@@ -95,6 +95,32 @@ NotifierQueue::pull(int)
     return p;
 }
 
+void
+NotifierQueue::push_batch(int, PacketBatch &batch)
+{
+    // Code taken from SimpleQueue::push_batch().
+    if (enq_batch(batch))
+	_empty_note.wake();
+    if (!batch.empty())
+	push_batch_failure(batch);
+}
+
+void
+NotifierQueue::pull_batch(int, PacketBatch &batch, int max)
+{
+    if (deq_batch(batch, max))
+	_sleepiness = 0;
+    else if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+#if HAVE_MULTITHREAD
+	// Work around race condition between push() and pull().
+	if (size())
+	    _empty_note.wake();
+#endif
+    } else
+	++_sleepiness;
+}
+
 #if NOTIFIERQUEUE_DEBUG
 #include <click/straccum.hh>
 
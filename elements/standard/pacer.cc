@@ -0,0 +1,191 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * pacer.{cc,hh} -- per-thread loop for precisely timed callbacks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "pacer.hh"
+#include <click/element.hh>
+#include <click/router.hh>
+CLICK_DECLS
+
+static inline void
+relax_cpu()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" : : : "memory");
+#else
+    click_compiler_fence();
+#endif
+}
+
+Pacer::Pacer()
+    : _refs(0), _task(task_hook, this), _timer(&_task), _running(false)
+{
+}
+
+/** @brief Return the Pacer for @a owner's home thread, creating it if
+ * necessary.
+ * @param owner the element that will schedule callbacks
+ * @param spin how long before each deadline to start busy-waiting
+ *
+ * Call close() once for every successful open(), typically in cleanup(). */
+Pacer *
+Pacer::open(Element *owner, const Timestamp &spin)
+{
+    Router *router = owner->router();
+    String name = "Pacer_" + String(router->home_thread_id(owner));
+    void *&attachment = router->force_attachment(name);
+    Pacer *pacer = reinterpret_cast<Pacer *>(attachment);
+    if (!pacer) {
+	pacer = new Pacer;
+	pacer->_name = name;
+	pacer->_task.initialize(owner, false);
+	pacer->_timer.initialize(owner, true);
+	attachment = pacer;
+    }
+    ++pacer->_refs;
+    if (spin > pacer->_spin)
+	pacer->_spin = spin;
+    return pacer;
+}
+
+void
+Pacer::close(Element *owner)
+{
+    if (--_refs > 0)
+	return;
+    owner->router()->set_attachment(_name, 0);
+    _timer.unschedule();
+    _task.unschedule();
+    delete this;
+}
+
+// Return the client with the earliest deadline.  Call with _lock held.
+Pacer::Client *
+Pacer::earliest() const
+{
+    Client *c = 0;
+    for (Client * const *it = _clients.begin(); it != _clients.end(); ++it)
+	if (!c || (*it)->_deadline < c->_deadline)
+	    c = *it;
+    return c;
+}
+
+// Wake up in time for c's deadline: at once if it is within _spin,
+// otherwise by timer.
+void
+Pacer::arm(Client *c)
+{
+    if (!c)
+	return;
+    Timestamp wake = c->_deadline - _spin;
+    if (wake <= Timestamp::now_steady())
+	_task.reschedule();
+    else
+	_timer.schedule_at_steady(wake);
+}
+
+void
+Pacer::schedule(Client *c, const Timestamp &deadline)
+{
+    _lock.acquire();
+    if (!c->_scheduled) {
+	_clients.push_back(c);
+	c->_scheduled = true;
+    }
+    c->_deadline = deadline;
+    // run() arms the Pacer itself once its callbacks return.
+    Client *next = _running ? 0 : earliest();
+    _lock.release();
+    arm(next);
+}
+
+void
+Pacer::unschedule(Client *c)
+{
+    _lock.acquire();
+    if (c->_scheduled) {
+	for (Client **it = _clients.begin(); it != _clients.end(); ++it)
+	    if (*it == c) {
+		*it = _clients.back();
+		_clients.pop_back();
+		break;
+	    }
+	c->_scheduled = false;
+    }
+    _lock.release();
+}
+
+bool
+Pacer::run()
+{
+    _lock.acquire();
+    Client *c = earliest();
+    if (!c) {
+	_lock.release();
+	return false;
+    }
+    Timestamp deadline = c->_deadline;
+    if (deadline - _spin > Timestamp::now_steady()) {
+	// woken early, for instance by a client that has since unscheduled
+	_lock.release();
+	_timer.schedule_at_steady(deadline - _spin);
+	return false;
+    }
+    _running = true;
+    _lock.release();
+
+    Timestamp now;
+    while ((now = Timestamp::now_steady()) < deadline)
+	relax_cpu();
+
+    // Collect every client that is due before running any callback, since
+    // callbacks reschedule their clients.
+    Client *due[16];
+    int ndue = 0;
+    _lock.acquire();
+    for (int i = 0; i < _clients.size() && ndue < 16; )
+	if (_clients[i]->_deadline <= now) {
+	    due[ndue++] = _clients[i];
+	    _clients[i]->_scheduled = false;
+	    _clients[i] = _clients.back();
+	    _clients.pop_back();
+	} else
+	    ++i;
+    _lock.release();
+
+    for (int i = 0; i < ndue; ++i)
+	due[i]->_hook(due[i]->_user_data);
+
+    // Let the thread's other tasks run between deadlines, even when they
+    // are closer together than _spin.
+    _lock.acquire();
+    _running = false;
+    c = earliest();
+    _lock.release();
+    if (c && c->_deadline - _spin <= Timestamp::now_steady())
+	_task.fast_reschedule();
+    else
+	arm(c);
+    return true;
+}
+
+bool
+Pacer::task_hook(Task *, void *user_data)
+{
+    return static_cast<Pacer *>(user_data)->run();
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(Pacer)
@@ -0,0 +1,100 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACER_HH
+#define CLICK_PACER_HH
+#include <click/timer.hh>
+#include <click/task.hh>
+#include <click/sync.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+class Element;
+
+/** @class Pacer
+ * @brief A per-thread loop that runs callbacks at precise deadlines.
+ *
+ * A Timer runs when its thread next checks timers, which, depending on the
+ * thread's timer stride and select() timeouts, can be tens of microseconds
+ * after its expiry.  A Pacer meets deadlines more closely.  It combines one
+ * Timer and one Task: the Timer fires SPIN before the earliest deadline and
+ * schedules the Task, which busy-waits on the steady clock until the deadline
+ * and then runs every callback that is due.  If the next deadline is again
+ * within SPIN, the Task reschedules itself rather than returning to the
+ * Timer.  Spinning keeps the thread's other tasks from running, so SPIN
+ * trades CPU time for precision.
+ *
+ * The elements of a router that run on the same thread share one Pacer
+ * through a router attachment, so the thread spins at most once per
+ * deadline however many pacing elements it runs.  A shared Pacer spins for
+ * the longest SPIN any of its elements asked for.
+ *
+ * Callbacks run on the Pacer's thread, the home thread of the element that
+ * opened it first.  Client::schedule() may be called from any thread. */
+class Pacer { public:
+
+    typedef void (*Hook)(void *user_data);
+
+    static Pacer *open(Element *owner, const Timestamp &spin);
+    void close(Element *owner);
+
+    /** @class Pacer::Client
+     * @brief A callback that a Pacer runs at a deadline. */
+    class Client { public:
+
+	Client(Hook hook, void *user_data)
+	    : _hook(hook), _user_data(user_data), _pacer(0), _scheduled(false) {
+	}
+
+	void attach(Pacer *pacer)	{ _pacer = pacer; }
+	Pacer *pacer() const		{ return _pacer; }
+
+	bool scheduled() const		{ return _scheduled; }
+	/** Return the deadline on the steady clock. */
+	const Timestamp &deadline() const { return _deadline; }
+
+	/** Run the hook at @a deadline on the steady clock.  A deadline in
+	    the past runs the hook as soon as possible. */
+	void schedule_at_steady(const Timestamp &deadline) {
+	    _pacer->schedule(this, deadline);
+	}
+	void unschedule() {
+	    if (_pacer)
+		_pacer->unschedule(this);
+	}
+
+      private:
+
+	Hook _hook;
+	void *_user_data;
+	Pacer *_pacer;
+	Timestamp _deadline;
+	bool _scheduled;
+
+	friend class Pacer;
+
+    };
+
+    void schedule(Client *c, const Timestamp &deadline);
+    void unschedule(Client *c);
+
+  private:
+
+    String _name;
+    int _refs;
+    Timestamp _spin;
+    Task _task;
+    Timer _timer;
+    SimpleSpinlock _lock;
+    Vector<Client *> _clients;	// scheduled clients
+    bool _running;		// true while run() fires callbacks
+
+    Pacer();
+    ~Pacer()				{ }
+
+    Client *earliest() const;
+    void arm(Client *c);
+    bool run();
+    static bool task_hook(Task *, void *user_data);
+
+};
+
+CLICK_ENDDECLS
+#endif
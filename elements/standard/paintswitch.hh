@@ -26,7 +26,7 @@ PaintSwitch uses the PAINT annotation by default, but the ANNO argument can
 specify any one-byte annotation.
 
 =a StaticSwitch, PullSwitch, RoundRobinSwitch, StrideSwitch, HashSwitch,
-RandomSwitch, Paint, PaintTee */
+RandomSwitch, AnnotationSwitch, Paint, PaintTee */
 
 class PaintSwitch : public Element { public:
 
@@ -73,6 +73,7 @@ class Print : public Element { public:
     ~Print();
 
     const char *class_name() const		{ return "Print"; }
+    const char *flags() const			{ return _timestamp ? "T" : ""; }
     const char *port_count() const		{ return PORTS_1_1; }
 
     int configure(Vector<String> &, ErrorHandler *);
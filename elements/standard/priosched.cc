@@ -38,6 +38,8 @@ PrioSched::initialize(ErrorHandler *errh)
 	return errh->error("out of memory!");
     for (int i = 0; i < ninputs(); i++)
 	_signals[i] = Notifier::upstream_empty_signal(this, i, 0);
+    if (_signal_set.initialize(_signals, ninputs()) < 0)
+	return errh->error("out of memory!");
     return 0;
 }
 
@@ -51,8 +53,20 @@ Packet *
 PrioSched::pull(int)
 {
     Packet *p;
-    for (int i = 0; i < ninputs(); i++)
-	if (_signals[i] && (p = input(i).pull()))
+    int n = ninputs();
+    if (_signal_set.nwords() > MAX_BITMAP_WORDS) {
+	for (int i = 0; i < n; i++)
+	    if (_signals[i] && (p = input(i).pull()))
+		return p;
+	return 0;
+    }
+
+    // The bitmap lives on the stack since several threads may pull at once.
+    uint32_t active[MAX_BITMAP_WORDS];
+    _signal_set.active_bitmap(active);
+    for (int i = NotifierSignalSet::next_bit(active, n, 0); i >= 0;
+	 i = NotifierSignalSet::next_bit(active, n, i + 1))
+	if ((p = input(i).pull()))
 	    return p;
     return 0;
 }
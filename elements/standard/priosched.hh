@@ -18,6 +18,9 @@ CLICK_DECLS
  *
  * The inputs usually come from Queues or other pull schedulers.
  * PrioSched uses notification to avoid pulling from empty inputs.
+ * It reads its inputs' signals a word at a time and skips inactive inputs
+ * without visiting them, so empty inputs cost little even when there are
+ * hundreds.
  *
  * =a Queue, RoundRobinSched, StrideSched, DRRSched, SimplePrioSched
  */
@@ -39,7 +42,10 @@ class PrioSched : public Element { public:
 
   private:
 
+    enum { MAX_BITMAP_WORDS = 8 };
+
     NotifierSignal *_signals;
+    NotifierSignalSet _signal_set;
 
 };
 
@@ -47,6 +47,7 @@ QuickNoteQueue::pull(int)
 	p = _q[h];
 	packet_memory_barrier(_q[h], _head);
 	_head = h = next_i(h);
+	pool_release(p);
 	_full_note.wake();
     } else
 	p = 0;
@@ -75,6 +75,9 @@ class QuickNoteQueue : public FullNoteQueue { public:
 
     // FullNoteQueue's push() suffices
     Packet *pull(int port);
+    void pull_batch(int port, PacketBatch &batch, int max) {
+	Element::pull_batch(port, batch, max);
+    }
 
 };
 
@@ -77,6 +77,39 @@ RandomSample::push(int, Packet *p)
     }
 }
 
+void
+RandomSample::push_batch(int, PacketBatch &batch)
+{
+    if (!_active) {
+	output(0).push_batch(batch);
+	return;
+    }
+    // draw the batch's random numbers a chunk at a time
+    enum { chunk = 32 };
+    uint32_t r[chunk];
+    int i = 0, n = 0;
+    PacketBatch out, drops;
+    while (Packet *p = batch.pop_front()) {
+	if (i == n) {
+	    n = (batch.count() < chunk ? batch.count() + 1 : (int) chunk);
+	    click_random_fill(r, n);
+	    i = 0;
+	}
+	if ((r[i++] & SAMPLING_MASK) < _sampling_prob)
+	    out.push_back(p);
+	else
+	    drops.push_back(p);
+    }
+    if (int ndrops = drops.count()) {
+	_drops += ndrops;
+	if (noutputs() == 2)
+	    output(1).push_batch(drops);
+	else
+	    drops.kill();
+    }
+    output(0).push_batch(out);
+}
+
 Packet *
 RandomSample::pull(int)
 {
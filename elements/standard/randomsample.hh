@@ -3,6 +3,7 @@
 #define CLICK_RANDOMSAMPLE_HH
 #include <click/element.hh>
 #include <click/atomic.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
 
 /*
@@ -78,6 +79,7 @@ class RandomSample : public Element { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
 
   private:
 
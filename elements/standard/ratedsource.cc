@@ -29,7 +29,8 @@ CLICK_DECLS
 const unsigned RatedSource::NO_LIMIT;
 
 RatedSource::RatedSource()
-  : _packet(0), _task(this), _timer(&_task)
+  : _timestamp(true), _packet(0), _task(this), _timer(&_task),
+    _pace(pace_hook, this)
 {
 }
 
@@ -57,6 +58,7 @@ RatedSource::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("DATASIZE", datasize) // deprecated
 	.read("STOP", stop)
 	.read("BANDWIDTH", BandwidthArg(), bandwidth)
+	.read("SPIN", _spin)
 	.complete() < 0)
 	return -1;
 
@@ -81,16 +83,25 @@ int
 RatedSource::initialize(ErrorHandler *errh)
 {
     _count = 0;
-    if (output_is_push(0))
+    if (output_is_push(0) && _spin) {
+	_pace.attach(Pacer::open(this, _spin));
+	_pace.schedule_at_steady(Timestamp::now_steady());
+    } else if (output_is_push(0))
 	ScheduleInfo::initialize_task(this, &_task, errh);
     _tb.set(1);
     _timer.initialize(this);
+    _timestamp = router()->timestamp_required(this);
     return 0;
 }
 
 void
 RatedSource::cleanup(CleanupStage)
 {
+    if (Pacer *pacer = _pace.pacer()) {
+	_pace.unschedule();
+	pacer->close(this);
+	_pace.attach(0);
+    }
     if (_packet)
 	_packet->kill();
     _packet = 0;
@@ -110,7 +121,8 @@ RatedSource::run_task(Task *)
     _tb.refill();
     if (_tb.remove_if(1)) {
 	Packet *p = _packet->clone();
-	p->set_timestamp_anno(Timestamp::now());
+	if (_timestamp)
+	    p->set_timestamp_anno(Timestamp::now_fast());
 	output(0).push(p);
 	_count++;
 	_task.fast_reschedule();
@@ -121,6 +133,47 @@ RatedSource::run_task(Task *)
     }
 }
 
+void
+RatedSource::pace_hook(void *user_data)
+{
+    RatedSource *rs = static_cast<RatedSource *>(user_data);
+    if (!rs->_active)
+	return;
+    if (rs->_limit != NO_LIMIT && rs->_count >= rs->_limit) {
+	if (rs->_stop)
+	    rs->router()->please_stop_driver();
+	return;
+    }
+
+    Packet *p = rs->_packet->clone();
+    if (rs->_timestamp)
+	p->set_timestamp_anno(Timestamp::now());
+    rs->output(0).push(p);
+    rs->_count++;
+
+    if (unsigned rate = rs->_tb.rate()) {
+	Timestamp next = rs->_pace.deadline()
+	    + Timestamp::make_nsec(1000000000 / rate);
+	Timestamp now = Timestamp::now_steady();
+	rs->_pace.schedule_at_steady(next < now ? now : next);
+    }
+}
+
+// Start sending again after the element was inactive or its limit reached.
+void
+RatedSource::wake()
+{
+    if (!output_is_push(0))
+	return;
+    if (_pace.pacer()) {
+	if (!_pace.scheduled())
+	    _pace.schedule_at_steady(Timestamp::now_steady());
+    } else if (!_task.scheduled()) {
+	_tb.set(1);
+	_task.reschedule();
+    }
+}
+
 Packet *
 RatedSource::pull(int)
 {
@@ -136,7 +189,8 @@ RatedSource::pull(int)
     if (_tb.remove_if(1)) {
 	_count++;
 	Packet *p = _packet->clone();
-	p->set_timestamp_anno(Timestamp::now());
+	if (_timestamp)
+	    p->set_timestamp_anno(Timestamp::now_fast());
 	return p;
     } else
 	return 0;
@@ -215,18 +269,16 @@ RatedSource::change_param(const String &s, Element *e, void *vparam,
       if (!BoolArg().parse(s, active))
 	  return errh->error("syntax error");
       rs->_active = active;
-      if (rs->output_is_push(0) && !rs->_task.scheduled() && active) {
-	  rs->_tb.set(1);
-	  rs->_task.reschedule();
-      }
+      if (active)
+	  rs->wake();
       break;
   }
 
   case 5: {			// reset
       rs->_count = 0;
       rs->_tb.set(1);
-      if (rs->output_is_push(0) && !rs->_task.scheduled() && rs->_active)
-	  rs->_task.reschedule();
+      if (rs->_active)
+	  rs->wake();
       break;
   }
 
@@ -266,4 +318,5 @@ RatedSource::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(Pacer)
 EXPORT_ELEMENT(RatedSource)
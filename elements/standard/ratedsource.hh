@@ -3,6 +3,7 @@
 #include <click/element.hh>
 #include <click/tokenbucket.hh>
 #include <click/task.hh>
+#include "elements/standard/pacer.hh"
 CLICK_DECLS
 
 /*
@@ -58,8 +59,21 @@ Boolean. Same as the ACTIVE? argument.
 Boolean. If true, then stop the driver once LIMIT packets are sent. Default is
 false.
 
+=item SPIN
+
+Time. If nonzero and the output is push, pace packets precisely with the
+thread's Pacer: packets are due exactly 1/RATE seconds apart, and the thread
+busy-waits for up to SPIN before each one.  Without SPIN, packets leave in
+small bursts when a Timer lets the token bucket refill.  A RatedSource that
+falls more than a packet behind starts again from the current time rather
+than catching up.  Default is 0.
+
 =back
 
+Packets' timestamp annotations are set to the time they are sent, but only if
+some element downstream reads timestamp annotations (see
+Router::timestamp_required).
+
 To generate a particular repeatable traffic pattern, use this element's
 B<rate> and B<active> handlers in conjunction with Script.
 
@@ -113,12 +127,17 @@ class RatedSource : public Element { public:
     int _datasize;
     bool _active;
     bool _stop;
+    bool _timestamp;
     Packet *_packet;
     Task _task;
     Timer _timer;
     String _data;
+    Timestamp _spin;
+    Pacer::Client _pace;
 
     void setup_packet();
+    void wake();
+    static void pace_hook(void *user_data);
 
     static String read_param(Element *, void *);
     static int change_param(const String &, Element *, void *, ErrorHandler *);
@@ -23,9 +23,11 @@
 #include <click/error.hh>
 #include <click/args.hh>
 #include "ratedunqueue.hh"
+#include "sharedtokenbucket.hh"
 CLICK_DECLS
 
 RatedSplitter::RatedSplitter()
+    : _shared(0)
 {
 }
 
@@ -36,14 +38,20 @@ RatedSplitter::~RatedSplitter()
 int
 RatedSplitter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return RatedUnqueue::configure_helper(&_tb, is_bandwidth(), this, conf, errh);
+    return RatedUnqueue::configure_helper(&_tb, &_shared, is_bandwidth(), this, conf, errh);
 }
 
 void
 RatedSplitter::push(int, Packet *p)
 {
-    _tb.refill();
-    if (_tb.remove_if(1))
+    bool ok;
+    if (_shared)
+	ok = _shared->remove_if(1);
+    else {
+	_tb.refill();
+	ok = _tb.remove_if(1);
+    }
+    if (ok)
 	output(0).push(p);
     else
 	checked_output_push(1, p);
@@ -56,10 +64,11 @@ String
 RatedSplitter::read_handler(Element *e, void *)
 {
     RatedSplitter *rs = static_cast<RatedSplitter *>(e);
+    uint32_t rate = rs->_shared ? rs->_shared->rate() : rs->_tb.rate();
     if (rs->is_bandwidth())
-	return BandwidthArg::unparse(rs->_tb.rate());
+	return BandwidthArg::unparse(rate);
     else
-	return String(rs->_tb.rate());
+	return String(rate);
 }
 
 void
@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/tokenbucket.hh>
 CLICK_DECLS
+class SharedTokenBucket;
 
 /*
  * =c
@@ -57,10 +58,18 @@ CLICK_DECLS
  * Integer.  If specified, the capacity of the token bucket is set to this
  * value.
  *
+ * =item SHARED
+ *
+ * The name of a SharedTokenBucket element.  If specified, RatedSplitter takes
+ * its tokens from that shared bucket, whose rate may be shared with rate
+ * limiters on other threads, and RATE and the burst options must not be
+ * given.
+ *
  * =h rate read/write
  * rate of splitting
  *
- * =a BandwidthRatedSplitter, ProbSplitter, Meter, Shaper, RatedUnqueue, Tee */
+ * =a BandwidthRatedSplitter, ProbSplitter, Meter, Shaper, RatedUnqueue, Tee,
+ * SharedTokenBucket */
 
 class RatedSplitter : public Element { public:
 
@@ -81,6 +90,7 @@ class RatedSplitter : public Element { public:
  protected:
 
     TokenBucket _tb;
+    SharedTokenBucket *_shared;
 
     static String read_handler(Element *, void *);
 
@@ -20,6 +20,7 @@
 
 #include <click/config.h>
 #include "ratedunqueue.hh"
+#include "sharedtokenbucket.hh"
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/straccum.hh>
@@ -27,7 +28,7 @@
 CLICK_DECLS
 
 RatedUnqueue::RatedUnqueue()
-    : _task(this), _timer(&_task), _runs(0), _pushes(0), _failed_pulls(0), _empty_runs(0), _active(true)
+    : _shared(0), _task(this), _timer(&_task), _burst(32), _runs(0), _pushes(0), _failed_pulls(0), _empty_runs(0), _active(true)
 {
 }
 
@@ -38,12 +39,34 @@ RatedUnqueue::~RatedUnqueue()
 int
 RatedUnqueue::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return configure_helper(&_tb, is_bandwidth(), this, conf, errh);
+    uint32_t burst = 32;
+    if (Args(this, errh).bind(conf)
+	.read("BURST", burst)
+	.consume() < 0)
+	return -1;
+    if (burst == 0)
+	return errh->error("BURST must be positive");
+    if (configure_helper(&_tb, &_shared, is_bandwidth(), this, conf, errh) < 0)
+	return -1;
+    _burst = burst;
+    return 0;
 }
 
 int
-RatedUnqueue::configure_helper(TokenBucket *tb, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh)
+RatedUnqueue::configure_helper(TokenBucket *tb, SharedTokenBucket **shared, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh)
 {
+    *shared = 0;
+    if (Args(elt, errh).bind(conf)
+	.read("SHARED", ElementCastArg("SharedTokenBucket"), *shared)
+	.consume() < 0)
+	return -1;
+    if (*shared) {
+	if ((*shared)->is_bandwidth() != is_bandwidth)
+	    return errh->error("SHARED %s bucket counts %s", (*shared)->name().c_str(),
+			       is_bandwidth ? "packets, not bytes" : "bytes, not packets");
+	return Args(conf, elt, errh).complete();
+    }
+
     unsigned r;
     unsigned dur_msec = 20;
     unsigned tokens;
@@ -90,31 +113,64 @@ RatedUnqueue::initialize(ErrorHandler *errh)
 bool
 RatedUnqueue::run_task(Task *)
 {
-    bool worked = false;
     _runs++;
     if (!_active)
 	return false;
+    if (_shared)
+	return run_shared_task();
     _tb.refill();
-    if (_tb.contains(1)) {
-	if (Packet *p = input(0).pull()) {
-	    _tb.remove(1);
-	    output(0).push(p);
-            _pushes++;
-	    worked = true;
-	} else { // no Packet available
-            _failed_pulls++;
-	    if (!_signal)
-		return false; // without rescheduling
-        }
-    } else {
+    uint32_t n = _tb.size();
+    if (n == 0) {
 	_timer.schedule_after(Timestamp::make_jiffies(_tb.time_until_contains(1)));
 	_empty_runs++;
 	return false;
     }
-    _task.fast_reschedule();
-    if (!worked)
-        _empty_runs++;
-    return worked;
+    if (n > _burst)
+	n = _burst;
+    PacketBatch batch;
+    input(0).pull_batch(batch, n);
+    if (int count = batch.count()) {
+	_tb.remove(count);
+	_pushes += count;
+	output(0).push_batch(batch);
+	_task.fast_reschedule();
+	return true;
+    }
+    _failed_pulls++;
+    _empty_runs++;
+    if (_signal)
+	_task.fast_reschedule();
+    return false;
+}
+
+bool
+RatedUnqueue::run_shared_task()
+{
+    // Take as many of the BURST tokens as this thread's share of the bucket
+    // holds, then return those the pull didn't use.
+    uint32_t n = _burst;
+    while (!_shared->remove_if(n))
+	if ((n /= 2) == 0) {
+	    _timer.schedule_after(_shared->time_until_contains(1));
+	    _empty_runs++;
+	    return false;
+	}
+    PacketBatch batch;
+    input(0).pull_batch(batch, n);
+    uint32_t count = batch.count();
+    if (count < n)
+	_shared->put_back(n - count);
+    if (count) {
+	_pushes += count;
+	output(0).push_batch(batch);
+	_task.fast_reschedule();
+	return true;
+    }
+    _failed_pulls++;
+    _empty_runs++;
+    if (_signal)
+	_task.fast_reschedule();
+    return false;
 }
 
 String
@@ -122,11 +178,13 @@ RatedUnqueue::read_handler(Element *e, void *thunk)
 {
     RatedUnqueue *ru = (RatedUnqueue *)e;
     switch ((uintptr_t) thunk) {
-      case h_rate:
-	if (ru->is_bandwidth())
-	    return BandwidthArg::unparse(ru->_tb.rate());
-	else
-	    return String(ru->_tb.rate());
+      case h_rate: {
+	  uint32_t rate = ru->_shared ? ru->_shared->rate() : ru->_tb.rate();
+	  if (ru->is_bandwidth())
+	      return BandwidthArg::unparse(rate);
+	  else
+	      return String(rate);
+      }
       case h_calls: {
 	  StringAccum sa;
 	  sa << ru->_runs << " calls to run_task()\n"
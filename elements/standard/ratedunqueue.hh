@@ -7,6 +7,7 @@
 #include <click/timer.hh>
 #include <click/notifier.hh>
 CLICK_DECLS
+class SharedTokenBucket;
 
 /*
  * =c
@@ -38,9 +39,23 @@ CLICK_DECLS
  * Integer.  If specified, the capacity of the token bucket is set to this
  * value.
  *
+ * =item BURST
+ *
+ * Integer.  Maximum number of packets to pull per scheduling.  Each time it
+ * runs, RatedUnqueue pulls as many packets as the bucket has tokens for, up
+ * to BURST, as one batch, and pushes them downstream as a batch.  When the
+ * bucket is empty, it sleeps until the bucket holds a token.  Default is 32.
+ *
+ * =item SHARED
+ *
+ * The name of a SharedTokenBucket element.  If specified, RatedUnqueue takes
+ * its tokens from that shared bucket, whose rate may be shared with rate
+ * limiters on other threads, and RATE and the burst options must not be
+ * given.
+ *
  * =h rate read/write
  *
- * =a BandwidthRatedUnqueue, Unqueue, Shaper, RatedSplitter */
+ * =a BandwidthRatedUnqueue, Unqueue, Shaper, RatedSplitter, SharedTokenBucket */
 
 class RatedUnqueue : public Element { public:
 
@@ -53,7 +68,7 @@ class RatedUnqueue : public Element { public:
     bool is_bandwidth() const		{ return class_name()[0] == 'B'; }
 
     int configure(Vector<String> &, ErrorHandler *);
-    static int configure_helper(TokenBucket *tb, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh);
+    static int configure_helper(TokenBucket *tb, SharedTokenBucket **shared, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh);
 
     bool can_live_reconfigure() const	{ return true; }
     int initialize(ErrorHandler *);
@@ -63,10 +78,15 @@ class RatedUnqueue : public Element { public:
 
   protected:
 
+    bool run_shared_task();
+
+
     TokenBucket _tb;
+    SharedTokenBucket *_shared;
     Task _task;
     Timer _timer;
     NotifierSignal _signal;
+    uint32_t _burst;
     uint32_t _runs;
     uint32_t _pushes;
     uint32_t _failed_pulls;
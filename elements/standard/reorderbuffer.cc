@@ -0,0 +1,260 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * reorderbuffer.{cc,hh} -- restore sequence-number order
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "reorderbuffer.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+// Packets live in a power-of-two ring indexed by sequence number, so the
+// packet numbered _next is at head().  _arrival records when each arrived.
+// While packets wait behind a missing head, _gap_start is the arrival time
+// of the first of them in sequence order.
+//
+// Timer callbacks run with the timer lock held, and run_timer() takes
+// _lock, so never schedule _timer while holding _lock.
+
+ReorderBuffer::ReorderBuffer()
+    : _ring(0), _arrival(0), _mask(0), _next(0), _count(0), _timer(this),
+      _highwater_length(0), _reorder_depth(0), _skipped(0)
+{
+    _late = _drops = 0;
+}
+
+ReorderBuffer::~ReorderBuffer()
+{
+}
+
+void *
+ReorderBuffer::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+int
+ReorderBuffer::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _capacity = 1024;
+    _timeout = Timestamp::make_msec(10);
+    _anno = SEQUENCE_NUMBER_ANNO_OFFSET;
+    if (Args(conf, this, errh)
+	.read_p("CAPACITY", _capacity)
+	.read("TIMEOUT", _timeout)
+	.read("ANNO", AnnoArg(4), _anno)
+	.complete() < 0)
+	return -1;
+    if (_capacity < 1 || _capacity > (1 << 24))
+	return errh->error("CAPACITY out of range");
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+int
+ReorderBuffer::initialize(ErrorHandler *errh)
+{
+    uint32_t size = 1;
+    while (size < (uint32_t) _capacity)
+	size <<= 1;
+    _ring = new Packet *[size];
+    _arrival = new Timestamp[size];
+    if (!_ring || !_arrival)
+	return errh->error("out of memory!");
+    memset(_ring, 0, size * sizeof(Packet *));
+    _mask = size - 1;
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+ReorderBuffer::cleanup(CleanupStage)
+{
+    if (_ring) {
+	for (uint32_t i = 0; i <= _mask; ++i)
+	    if (_ring[i])
+		_ring[i]->kill();
+	delete[] _ring;
+	_ring = 0;
+    }
+    delete[] _arrival;
+    _arrival = 0;
+}
+
+void
+ReorderBuffer::drop(Packet *p, bool late)
+{
+    if (late)
+	_late++;
+    if (_drops == 0)
+	click_chatter("%{element}: %s", this, late ? "late packet" : "overflow");
+    _drops++;
+    checked_output_push(1, p);
+}
+
+void
+ReorderBuffer::skip_gap()
+{
+    while (!head()) {
+	++_next;
+	++_skipped;
+    }
+    _gap_start = Timestamp();
+}
+
+bool
+ReorderBuffer::update_gap()
+{
+    if (!_count || head()) {
+	_gap_start = Timestamp();
+	return false;
+    }
+    if (!_gap_start) {
+	uint32_t i = _next + 1;
+	while (!_ring[i & _mask])
+	    ++i;
+	_gap_start = _arrival[i & _mask];
+    }
+    return true;
+}
+
+void
+ReorderBuffer::push(int, Packet *p)
+{
+    uint32_t seq = p->anno_u32(_anno);
+    _lock.acquire();
+    int32_t d = seq - _next;
+    if (d < 0 || d >= _capacity || _ring[seq & _mask]) {
+	_lock.release();
+	drop(p, d < 0);
+	return;
+    }
+
+    _ring[seq & _mask] = p;
+    _arrival[seq & _mask] = Timestamp::recent_steady();
+    if (++_count > _highwater_length)
+	_highwater_length = _count;
+    if ((uint32_t) d > _reorder_depth)
+	_reorder_depth = d;
+    bool gap = update_gap();
+    Timestamp expiry = _gap_start + _timeout;
+    if (d == 0)
+	_empty_note.wake();
+    _lock.release();
+
+    if (gap && !_timer.scheduled())
+	_timer.schedule_at_steady(expiry);
+}
+
+Packet *
+ReorderBuffer::pull(int)
+{
+    _lock.acquire();
+    Timestamp now = Timestamp::recent_steady();
+    Packet *p = head();
+    if (!p && _gap_start && now - _gap_start >= _timeout) {
+	skip_gap();
+	p = head();
+    }
+    if (p) {
+	head() = 0;
+	++_next;
+	--_count;
+    }
+    bool gap = update_gap();
+    Timestamp expiry = _gap_start + _timeout;
+    // Sleep unless the next packet is ready, or will be on the next pull.
+    if (!head() && !(gap && expiry <= now))
+	_empty_note.sleep();
+    _lock.release();
+
+    if (gap && !_timer.scheduled())
+	_timer.schedule_at_steady(expiry);
+    return p;
+}
+
+void
+ReorderBuffer::run_timer(Timer *)
+{
+    _lock.acquire();
+    Timestamp now = Timestamp::now_steady();
+    if (update_gap() && now - _gap_start >= _timeout) {
+	skip_gap();
+	_empty_note.wake();
+    }
+    bool gap = update_gap();
+    Timestamp expiry = _gap_start + _timeout;
+    _lock.release();
+
+    // a newer gap opened after this timer was scheduled
+    if (gap)
+	_timer.schedule_at_steady(expiry);
+}
+
+String
+ReorderBuffer::read_handler(Element *e, void *thunk)
+{
+    ReorderBuffer *rb = static_cast<ReorderBuffer *>(e);
+    switch ((intptr_t) thunk) {
+    case h_length:
+	return String(rb->_count);
+    case h_highwater:
+	return String(rb->_highwater_length);
+    case h_reorder_depth:
+	return String(rb->_reorder_depth);
+    case h_next:
+	return String(rb->_next);
+    case h_skipped:
+	return String(rb->_skipped);
+    case h_late:
+	return String(rb->_late.value());
+    case h_drops:
+	return String(rb->_drops.value());
+    default:
+	return String();
+    }
+}
+
+int
+ReorderBuffer::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ReorderBuffer *rb = static_cast<ReorderBuffer *>(e);
+    rb->_lock.acquire();
+    rb->_highwater_length = rb->_count;
+    rb->_reorder_depth = rb->_skipped = 0;
+    rb->_late = rb->_drops = 0;
+    rb->_lock.release();
+    return 0;
+}
+
+void
+ReorderBuffer::add_handlers()
+{
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("highwater_length", read_handler, h_highwater);
+    add_read_handler("reorder_depth", read_handler, h_reorder_depth);
+    add_read_handler("next", read_handler, h_next);
+    add_read_handler("skipped", read_handler, h_skipped);
+    add_read_handler("late", read_handler, h_late);
+    add_read_handler("drops", read_handler, h_drops);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(ReorderBuffer)
+ELEMENT_MT_SAFE(ReorderBuffer)
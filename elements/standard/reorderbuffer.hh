@@ -0,0 +1,159 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_REORDERBUFFER_HH
+#define CLICK_REORDERBUFFER_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/atomic.hh>
+#include <click/sync.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/*
+=c
+
+ReorderBuffer([CAPACITY, I<keywords> TIMEOUT, ANNO])
+
+=s storage
+
+restores sequence-number order
+
+=d
+
+Stores packets numbered by SequenceSwitch and emits them, on pull, in
+sequence number order.  Packets may arrive in any order and from any number
+of threads; the buffer holds each until every packet numbered before it has
+been emitted.  Numbering is expected to start at 0.
+
+A missing packet, such as one dropped on the way, holds up every packet
+after it.  Once the next packet waiting behind the gap has been in the buffer
+for TIMEOUT, ReorderBuffer gives up on the missing sequence numbers and
+resumes emitting.  A packet that arrives after its sequence number was
+skipped is late, and is dropped.
+
+ReorderBuffer holds packets numbered less than CAPACITY after the next
+sequence number it expects.  Packets numbered beyond that are dropped.
+Dropped packets are emitted on output 1, if it is present.
+
+ReorderBuffer supports any number of concurrent pushers, but at most one
+concurrent puller.  Like Queue, it has a non-empty notifier, which is active
+while the next packet in order is available.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Integer.  Reorder window size.  Default is 1024.
+
+=item TIMEOUT
+
+Timestamp.  How long to wait for a missing packet.  Default is 10
+milliseconds.
+
+=item ANNO
+
+Annotation offset.  The sequence number is a 4-byte annotation at this
+offset.  Default is the SEQUENCE_NUMBER annotation, as for SequenceSwitch.
+
+=back
+
+=h length read-only
+
+Returns the number of packets in the buffer.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in the buffer at
+once.
+
+=h reorder_depth read-only
+
+Returns the largest distance, in sequence numbers, between an arriving packet
+and the next packet in order.  In-order traffic has reorder depth 0.
+
+=h next read-only
+
+Returns the next sequence number in order.
+
+=h skipped read-only
+
+Returns the number of sequence numbers given up on after TIMEOUT.
+
+=h late read-only
+
+Returns the number of late packets dropped.
+
+=h drops read-only
+
+Returns the number of packets dropped, including late packets.
+
+=h reset_counts write-only
+
+When written, resets the C<drops>, C<late>, C<skipped>, C<highwater_length>,
+and C<reorder_depth> counters.
+
+=e
+
+  src -> ss :: SequenceSwitch;
+  ss[0] -> ThreadSafeQueue -> Unqueue -> IPsecAESGCM(1) -> rb;
+  ss[1] -> ThreadSafeQueue -> Unqueue -> IPsecAESGCM(1) -> rb;
+  rb :: ReorderBuffer(TIMEOUT 1ms) -> ToDevice(eth0);
+
+=a SequenceSwitch, MPSCQueue, ThreadSafeQueue */
+
+class ReorderBuffer : public Element { public:
+
+    ReorderBuffer();
+    ~ReorderBuffer();
+
+    const char *class_name() const	{ return "ReorderBuffer"; }
+    const char *port_count() const	{ return PORTS_1_1X2; }
+    const char *processing() const	{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void run_timer(Timer *t);
+
+  private:
+
+    Packet **_ring;
+    Timestamp *_arrival;
+    uint32_t _mask;
+    uint32_t _next;
+    int _count;
+    Timestamp _gap_start;
+    Spinlock _lock;
+
+    int _capacity;
+    Timestamp _timeout;
+    int _anno;
+    Timer _timer;
+    ActiveNotifier _empty_note;
+
+    int _highwater_length;
+    uint32_t _reorder_depth;
+    uint32_t _skipped;
+    atomic_uint32_t _late;
+    atomic_uint32_t _drops;
+
+    Packet *&head()			{ return _ring[_next & _mask]; }
+    void drop(Packet *p, bool late);
+    void skip_gap();
+    bool update_gap();
+
+    enum { h_length, h_highwater, h_reorder_depth, h_next, h_skipped,
+	   h_late, h_drops };
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
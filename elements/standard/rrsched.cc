@@ -22,7 +22,7 @@
 CLICK_DECLS
 
 RRSched::RRSched()
-    : _next(0), _signals(0)
+    : _next(0), _signals(0), _active(0)
 {
 }
 
@@ -37,6 +37,9 @@ RRSched::initialize(ErrorHandler *errh)
 	return errh->error("out of memory!");
     for (int i = 0; i < ninputs(); i++)
 	_signals[i] = Notifier::upstream_empty_signal(this, i, 0);
+    if (_signal_set.initialize(_signals, ninputs()) < 0
+	|| !(_active = new uint32_t[_signal_set.nwords()]))
+	return errh->error("out of memory!");
     return 0;
 }
 
@@ -44,22 +47,26 @@ void
 RRSched::cleanup(CleanupStage)
 {
     delete[] _signals;
+    delete[] _active;
 }
 
 Packet *
 RRSched::pull(int)
 {
+    // try active inputs only, starting at _next and wrapping around
     int n = ninputs();
-    int i = _next;
-    for (int j = 0; j < n; j++) {
-	Packet *p = (_signals[i] ? input(i).pull() : 0);
-	i++;
-	if (i >= n)
-	    i = 0;
-	if (p) {
-	    _next = i;
+    _signal_set.active_bitmap(_active);
+    int i = NotifierSignalSet::next_bit(_active, n, _next);
+    if (i < 0)
+	i = NotifierSignalSet::next_bit(_active, n, 0);
+    while (i >= 0) {
+	if (Packet *p = input(i).pull()) {
+	    _next = (i + 1 < n ? i + 1 : 0);
 	    return p;
 	}
+	_active[i >> 5] &= ~(1U << (i & 31));
+	int j = NotifierSignalSet::next_bit(_active, n, i + 1);
+	i = (j >= 0 ? j : NotifierSignalSet::next_bit(_active, n, 0));
     }
     return 0;
 }
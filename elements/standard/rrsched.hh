@@ -21,6 +21,9 @@ CLICK_DECLS
  *
  * The inputs usually come from Queues or other pull schedulers.
  * RoundRobinSched uses notification to avoid pulling from empty inputs.
+ * It reads its inputs' signals a word at a time and skips inactive inputs
+ * without visiting them, so empty inputs cost little even when there are
+ * hundreds.
  *
  * =a PrioSched, StrideSched, DRRSched, RoundRobinSwitch, SimpleRoundRobinSched
  */
@@ -44,6 +47,8 @@ class RRSched : public Element { public:
 
     int _next;
     NotifierSignal *_signals;
+    NotifierSignalSet _signal_set;
+    uint32_t *_active;
 
 };
 
@@ -164,6 +164,370 @@ Script::find_variable(const String &name, bool add)
     return i;
 }
 
+// Instruction text is compiled once, at initialize time, into a list of
+// pieces: literal text, script variable references, and `$(HANDLER ARGS)'
+// calls whose handler is resolved in advance.  Calls to pure arithmetic
+// handlers with constant arguments are folded into literal text.  Names that
+// cannot be resolved in advance, such as `$?' and `$args', are expanded
+// through Expander at run time, exactly as cp_expand would.
+
+static const char * const pure_handlers[] = {
+    "abs", "add", "and", "div", "eq", "first", "ge", "gt", "idiv", "if",
+    "in", "le", "length", "lt", "mod", "mul", "nand", "ne", "neg", "nor",
+    "not", "or", "rem", "sprintf", "sub", "unquote"
+};
+
+static bool
+is_special_variable(const String &vname)
+{
+    if (vname.length() == 1)
+	return vname[0] == '?' || vname[0] == '$' || vname[0] == '#'
+	    || (vname[0] >= '0' && vname[0] <= '9');
+    else if (vname.length() > 1 && vname[0] >= '1' && vname[0] <= '9')
+	return true;
+    else
+	return vname.equals("args", 4) || vname.equals("write", 5)
+	    || vname.equals("input", 5); // "input" is added by push and pull
+}
+
+void
+Script::compile()
+{
+    _pieces.clear();
+    _expr.clear();
+    for (int i = 0; i < _insns.size(); ++i) {
+	_expr.push_back(_pieces.size());
+	switch (_insns[i]) {
+	case INSN_PRINT:
+	case INSN_PRINTN: {
+	    String text = _args3[i];
+	    if (text.length() && text[0] == '>') {
+		text = text.substring(1 + (text.length() > 1 && text[1] == '>'));
+		(void) cp_shift_spacevec(text);
+	    }
+	    if (text && (isalpha((unsigned char) text[0]) || text[0] == '@' || text[0] == '_'))
+		compile(text, false, 0);
+	    else
+		compile(text, true, 0);
+	    break;
+	}
+	case INSN_WAIT_TIME:
+	case INSN_READ:
+	case INSN_READQ:
+	case INSN_WRITE:
+	case INSN_WRITEQ:
+	case INSN_RETURN:
+	case insn_returnq:
+	case INSN_SET:
+	case insn_setq:
+	case INSN_GOTO:
+	case insn_error:
+	case insn_errorq:
+	    compile(_args3[i], false, 0);
+	    break;
+	}
+    }
+    _expr.push_back(_pieces.size());
+}
+
+void
+Script::compile(const String &config, bool expand_quote, int depth)
+{
+    // This loop follows cp_expand().
+    const char *s = config.begin();
+    const char *end = config.end();
+    const char *uninterpolated = s;
+    int quote = 0;
+
+    if (find(config, '$') == end)
+	goto done;
+
+    for (; s < end; s++)
+	switch (*s) {
+
+	case '\\':
+	    if (s + 1 < end && quote == '\"')
+		s++;
+	    break;
+
+	case '\'':
+	case '\"':
+	    if (quote == 0)
+		quote = *s;
+	    else if (quote == *s)
+		quote = 0;
+	    break;
+
+	case '/':
+	    if (s + 1 < end && (s[1] == '/' || s[1] == '*') && quote == 0)
+		s = cp_skip_comment_space(s, end) - 1;
+	    break;
+
+	case '$': {
+	    if (s + 1 >= end || quote == '\'' || depth > 10)
+		break;
+
+	    const char *beforedollar = s, *cstart;
+	    String vname;
+	    int vtype, expand_vname = 0;
+
+	    if (s[1] == '{') {
+		vtype = '{';
+		s += 2;
+		for (cstart = s; s < end && *s != '}'; s++)
+		    if (*s == '$')
+			expand_vname = 1;
+		if (s == end)
+		    goto done;
+		vname = config.substring(cstart, s++);
+
+	    } else if (s[1] == '(') {
+		int level = 1, nquote = 0;
+		vtype = '(';
+		s += 2;
+		for (cstart = s; s < end && level; s++)
+		    switch (*s) {
+		      case '(':
+			if (nquote == 0)
+			    level++;
+			break;
+		      case ')':
+			if (nquote == 0)
+			    level--;
+			break;
+		      case '\"':
+		      case '\'':
+			if (nquote == 0)
+			    nquote = *s;
+			else if (nquote == *s)
+			    nquote = 0;
+			break;
+		      case '\\':
+			if (s + 1 < end && nquote != '\'')
+			    s++;
+			break;
+		      case '$':
+			if (nquote != '\'')
+			    expand_vname = 1;
+			break;
+		    }
+
+		if (s == cstart || s[-1] != ')')
+		    goto done;
+		vname = config.substring(cstart, s - 1);
+
+	    } else if (isalnum((unsigned char) s[1]) || s[1] == '_') {
+		vtype = 'a';
+		s++;
+		for (cstart = s; s < end && (isalnum((unsigned char) *s) || *s == '_'); s++)
+		    /* nada */;
+		vname = config.substring(cstart, s);
+
+	    } else if (s[1] == '?' || s[1] == '#' || s[1] == '$') {
+		vtype = 'a';
+		s++;
+		vname = config.substring(s, s + 1);
+		s++;
+
+	    } else
+		break;
+
+	    if (uninterpolated != beforedollar) {
+		Piece p;
+		p.text = config.substring(uninterpolated, beforedollar);
+		_pieces.push_back(p);
+	    }
+	    if (quote == '\"')
+		compile_lookup(vname, vtype, expand_vname, '\"', depth);
+	    else
+		compile_lookup(vname, vtype, expand_vname,
+			       expand_quote && quote == 0 ? 'q' : 0, depth);
+	    uninterpolated = s;
+	    s--;
+	    break;
+	}
+	}
+
+  done:
+    if (uninterpolated != end) {
+	Piece p;
+	p.text = config.substring(uninterpolated, end);
+	_pieces.push_back(p);
+    }
+}
+
+void
+Script::compile_lookup(const String &vname, int vtype, bool expand_vname,
+		       int quote, int depth)
+{
+    int pos = _pieces.size();
+    Piece p;
+    p.type = piece_lookup;
+    p.quote = quote;
+    p.vtype = vtype;
+    _pieces.push_back(p);
+
+    int x;
+    if (!expand_vname && (x = find_variable(vname, false)) < _vars.size()) {
+	_pieces[pos].type = piece_var;
+	_pieces[pos].var = x + 1;
+    } else if (vtype == '(' && compile_call(vname, expand_vname, depth))
+	_pieces[pos].type = piece_call;
+    else if (expand_vname)
+	compile(vname, false, depth + 1);
+    else
+	_pieces[pos].text = vname;
+    _pieces[pos].nsub = _pieces.size() - pos - 1;
+
+    // fold calls to pure arithmetic handlers with constant arguments
+    Piece &c = _pieces[pos];
+    if (c.type != piece_call || c.e != this || _type == type_proxy)
+	return;
+    StringAccum args;
+    for (int i = pos + 1; i < _pieces.size(); ++i)
+	if (_pieces[i].type != piece_text)
+	    return;
+	else
+	    args << _pieces[i].text;
+    String hname = c.h->name();
+    for (size_t i = 0; i < sizeof(pure_handlers) / sizeof(pure_handlers[0]); ++i)
+	if (hname == pure_handlers[i]) {
+	    SilentErrorHandler serrh;
+	    String value = args.take_string();
+	    value = value.substring(cp_skip_comment_space(value.begin(), value.end()), value.end());
+	    String text = c.h->call_read(this, value, &serrh);
+	    if (serrh.nerrors())
+		return;
+	    if (quote) {
+		text = cp_quote(text);
+		if (text[0] == '\"')
+		    text = text.substring(text.begin() + 1, text.end() - 1);
+		if (quote == 'q')
+		    text = "\"" + text + "\"";
+	    }
+	    _pieces.resize(pos + 1);
+	    c.type = piece_text;
+	    c.nsub = 0;
+	    c.text = text;
+	    return;
+	}
+}
+
+bool
+Script::compile_call(const String &vname, bool expand_vname, int depth)
+{
+    // Split VNAME into a constant handler name and the rest.
+    const char *s = vname.begin(), *end = vname.end();
+    for (; s != end && !isspace((unsigned char) *s); ++s)
+	if (*s == '$' || *s == '\"' || *s == '\'' || *s == '\\'
+	    || (*s == '/' && s + 1 != end && (s[1] == '/' || s[1] == '*')))
+	    return false;
+    String hname = vname.substring(vname.begin(), s);
+    if (!hname || is_special_variable(hname))
+	return false;
+    // a variable name with spaces could match VNAME as a whole
+    for (int i = 0; i < _vars.size(); i += 2)
+	for (const char *x = _vars[i].begin(); x != _vars[i].end(); ++x)
+	    if (isspace((unsigned char) *x))
+		return false;
+
+    HandlerCall hc(hname);
+    if (hc.initialize_read(this, 0) < 0)
+	return false;
+    while (s != end && isspace((unsigned char) *s))
+	++s;
+
+    Piece &p = _pieces.back();
+    p.e = hc.element();
+    p.h = hc.handler();
+    p.generation = Router::handler_generation();
+    p.text = vname.substring(vname.begin(), s);
+    if (s != end && expand_vname)
+	compile(vname.substring(s, end), false, depth + 1);
+    else if (s != end) {
+	Piece a;
+	a.text = vname.substring(s, end);
+	_pieces.push_back(a);
+    }
+    return true;
+}
+
+String
+Script::expand(int ipos, Expander &expander) const
+{
+    int p = _expr[ipos], end_p = _expr[ipos + 1];
+    if (p == end_p)
+	return String();
+    else if (p + 1 == end_p && _pieces[p].type == piece_text)
+	return _pieces[p].text;
+    else if (p + 1 == end_p && _pieces[p].type == piece_var
+	     && !_pieces[p].quote)
+	return _vars[_pieces[p].var];
+    StringAccum sa;
+    expand(p, end_p, expander, sa);
+    return sa.take_string();
+}
+
+void
+Script::expand(int p, int end_p, Expander &expander, StringAccum &sa) const
+{
+    while (p < end_p) {
+	const Piece &x = _pieces[p];
+	int next_p = p + 1 + x.nsub;
+	String text;
+
+	if (x.type == piece_text) {
+	    sa << x.text;
+	    p = next_p;
+	    continue;
+	} else if (x.type == piece_var)
+	    text = _vars[x.var];
+	else {
+	    String vname;
+	    if (x.nsub) {
+		StringAccum vsa;
+		vsa << x.text;
+		expand(p + 1, next_p, expander, vsa);
+		vname = vsa.take_string();
+	    } else
+		vname = x.text;
+
+	    bool ok = false;
+	    if (x.type == piece_call
+		&& x.generation == Router::handler_generation()) {
+		const char *s = cp_skip_comment_space(vname.begin() + x.text.length(), vname.end());
+		String value = vname.substring(s, vname.end());
+		if (!value || x.h->read_param()) {
+		    text = x.h->call_read(x.e, value, expander.errh);
+		    ok = true;
+		}
+	    }
+	    if (!ok && !expander.expand(vname, text, x.vtype, 0)) {
+		sa << '$';
+		if (x.vtype != 'a')
+		    sa << (char) x.vtype;
+		sa << vname;
+		if (x.vtype != 'a')
+		    sa << (x.vtype == '(' ? ')' : '}');
+		p = next_p;
+		continue;
+	    }
+	}
+
+	if (x.quote) {
+	    text = cp_quote(text);
+	    if (text[0] == '\"')
+		text = text.substring(text.begin() + 1, text.end() - 1);
+	    if (x.quote == '\"')
+		sa << text;
+	    else
+		sa << '\"' << text << '\"';
+	} else
+	    sa << text;
+	p = next_p;
+    }
+}
+
 int
 Script::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -325,6 +689,7 @@ Script::initialize(ErrorHandler *errh)
     _insn_pos = 0;
     _step_count = 0;
     _timer.initialize(this);
+    compile();
 
     Expander expander;
     expander.script = this;
@@ -342,7 +707,7 @@ Script::initialize(ErrorHandler *errh)
 	/* passive, do nothing */;
     else if (insn == INSN_WAIT_TIME) {
 	Timestamp ts;
-	if (cp_time(cp_expand(_args3[_insn_pos], expander), &ts))
+	if (cp_time(expand(_insn_pos, expander), &ts))
 	    _timer.schedule_after(ts);
 	else
 	    errh->error("syntax error at %<wait%>");
@@ -404,7 +769,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 	case INSN_WAIT_TIME:
 	    if (_step_count == nsteps) {
 		Timestamp ts;
-		if (cp_time(cp_expand(_args3[ipos], expander), &ts)) {
+		if (cp_time(expand(ipos, expander), &ts)) {
 		    _timer.schedule_after(ts);
 		    _insn_pos--;
 		} else
@@ -456,11 +821,17 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	    int before = errh->nerrors();
 	    String result;
-	    if (text && (isalpha((unsigned char) text[0]) || text[0] == '@' || text[0] == '_')) {
-		result = cp_expand(text, expander);
+	    bool is_handler = text && (isalpha((unsigned char) text[0]) || text[0] == '@' || text[0] == '_');
+#if CLICK_USERLEVEL
+	    if (insn == insn_save || insn == insn_append)
+		result = cp_expand(text, expander, !is_handler);
+	    else
+#endif
+		result = expand(ipos, expander);
+	    if (is_handler)
 		result = HandlerCall::call_read(result, this, errh);
-	    } else
-		result = cp_unquote(cp_expand(text, expander, true));
+	    else
+		result = cp_unquote(result);
 	    if (errh->nerrors() == before
 		&& (!result || result.back() != '\n')
 		&& insn != INSN_PRINTN)
@@ -480,7 +851,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_READ:
 	case INSN_READQ: {
-	    HandlerCall hc(cp_expand(_args3[ipos], expander));
+	    HandlerCall hc(expand(ipos, expander));
 	    int flags = HandlerCall::OP_READ + (insn == INSN_READQ ? HandlerCall::UNQUOTE_PARAM : 0);
 	    if (hc.initialize(flags, this, errh) >= 0) {
 		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", hc.unparse().c_str());
@@ -493,7 +864,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_WRITE:
 	case INSN_WRITEQ: {
-	    HandlerCall hc(cp_expand(_args3[ipos], expander));
+	    HandlerCall hc(expand(ipos, expander));
 	    int flags = HandlerCall::OP_WRITE + (insn == INSN_WRITEQ ? HandlerCall::UNQUOTE_PARAM : 0);
 	    if (hc.initialize(flags, this, errh) >= 0) {
 		ContextErrorHandler c_errh(errh, "While calling %<%s%>:", hc.unparse().c_str());
@@ -507,7 +878,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 	case INSN_SET:
 	case insn_setq: {
 	    expander.errh = errh;
-	    _vars[_args[ipos] + 1] = cp_expand(_args3[ipos], expander);
+	    _vars[_args[ipos] + 1] = expand(ipos, expander);
 	    if (insn == insn_setq || insn == insn_returnq)
 		_vars[_args[ipos] + 1] = cp_unquote(_vars[_args[ipos] + 1]);
 	    if ((insn == INSN_RETURN || insn == insn_returnq)
@@ -520,7 +891,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case INSN_GOTO: {
 	    // reset intervening instructions
-	    String cond_text = cp_expand(_args3[ipos], expander);
+	    String cond_text = expand(ipos, expander);
 	    bool cond;
 	    if (cond_text && !BoolArg().parse(cond_text, cond))
 		errh->error("bad condition %<%s%>", cond_text.c_str());
@@ -537,7 +908,7 @@ Script::step(int nsteps, int step_type, int njumps, ErrorHandler *errh)
 
 	case insn_error:
 	case insn_errorq: {
-	    String msg = cp_expand(_args3[ipos], expander);
+	    String msg = expand(ipos, expander);
 	    if (insn == insn_errorq)
 		msg = cp_unquote(msg);
 	    if (msg)
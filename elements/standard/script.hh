@@ -457,6 +457,29 @@ class Script : public Element { public:
     Vector<int> _args2;
     Vector<String> _args3;
 
+    // Compiled instruction text.  The pieces for instruction i are
+    // _pieces[_expr[i]] up to _pieces[_expr[i+1]].
+    struct Piece {
+	int type;
+	int quote;		// 0, '\"' (inside quotes), or 'q' (add quotes)
+	int vtype;
+	int var;
+	int nsub;		// number of following pieces in the name/args
+	String text;
+	Element *e;
+	const Handler *h;
+	unsigned generation;
+	Piece()
+	    : type(piece_text), quote(0), vtype(0), var(0), nsub(0),
+	      e(0), h(0), generation(0) {
+	}
+    };
+    enum {
+	piece_text, piece_var, piece_lookup, piece_call
+    };
+    Vector<Piece> _pieces;
+    Vector<int> _expr;
+
     Vector<String> _vars;
     String _run_handler_name;
     String _run_args;
@@ -495,6 +518,14 @@ class Script : public Element { public:
     int find_label(const String &) const;
     int find_variable(const String &name, bool add);
 
+    void compile();
+    void compile(const String &text, bool expand_quote, int depth);
+    void compile_lookup(const String &vname, int vtype, bool expand_vname,
+			int quote, int depth);
+    bool compile_call(const String &vname, bool expand_vname, int depth);
+    String expand(int ipos, Expander &expander) const;
+    void expand(int p, int end_p, Expander &expander, StringAccum &sa) const;
+
     static int step_handler(int, String&, Element*, const Handler*, ErrorHandler*);
     static int arithmetic_handler(int, String&, Element*, const Handler*, ErrorHandler*);
     static String read_export_handler(Element*, void*);
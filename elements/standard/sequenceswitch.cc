@@ -0,0 +1,75 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * sequenceswitch.{cc,hh} -- number packets and spread them over outputs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "sequenceswitch.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+SequenceSwitch::SequenceSwitch()
+{
+    _seq = 0;
+    _next = 0;
+}
+
+SequenceSwitch::~SequenceSwitch()
+{
+}
+
+int
+SequenceSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _anno = SEQUENCE_NUMBER_ANNO_OFFSET;
+    return Args(conf, this, errh)
+	.read("ANNO", AnnoArg(4), _anno)
+	.complete();
+}
+
+void
+SequenceSwitch::push(int, Packet *p)
+{
+    p->set_anno_u32(_anno, _seq.fetch_and_add(1));
+    int port = _next.fetch_and_add(1) % noutputs();
+    output(port).push(p);
+}
+
+void
+SequenceSwitch::push_batch(int, PacketBatch &batch)
+{
+    uint32_t seq = _seq.fetch_and_add(batch.count());
+    for (Packet *p = batch.front(); p; p = p->next())
+	p->set_anno_u32(_anno, seq++);
+    int port = _next.fetch_and_add(1) % noutputs();
+    output(port).push_batch(batch);
+}
+
+String
+SequenceSwitch::read_handler(Element *e, void *)
+{
+    SequenceSwitch *ss = static_cast<SequenceSwitch *>(e);
+    return String(ss->_seq.value());
+}
+
+void
+SequenceSwitch::add_handlers()
+{
+    add_read_handler("count", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(SequenceSwitch)
+ELEMENT_MT_SAFE(SequenceSwitch)
@@ -0,0 +1,80 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SEQUENCESWITCH_HH
+#define CLICK_SEQUENCESWITCH_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SequenceSwitch([I<keywords> ANNO])
+
+=s classification
+
+numbers packets, then sends them to round-robin outputs
+
+=d
+
+Stamps each arriving packet with a 32-bit sequence number, counting up from
+0, then pushes it to one of its outputs in round-robin order.  Batches pushed
+with push_batch are numbered consecutively and sent to a single output.
+
+SequenceSwitch and ReorderBuffer spread work that must stay in order over
+several threads.  Each output typically feeds a queue drained by a different
+thread; the threads' outputs meet at a ReorderBuffer, which restores the
+original order.
+
+Keyword arguments are:
+
+=over 8
+
+=item ANNO
+
+Annotation offset.  The sequence number is a 4-byte annotation at this
+offset.  Default is the SEQUENCE_NUMBER annotation.
+
+=back
+
+=h count read-only
+
+Returns the number of packets numbered so far, which is also the next
+sequence number, modulo 2^32.
+
+=e
+
+  src -> ss :: SequenceSwitch;
+  ss[0] -> ThreadSafeQueue -> Unqueue -> IPsecAESGCM(1) -> rb;
+  ss[1] -> ThreadSafeQueue -> Unqueue -> IPsecAESGCM(1) -> rb;
+  rb :: ReorderBuffer -> ToDevice(eth0);
+  StaticThreadSched(...);
+
+=a ReorderBuffer, RoundRobinSwitch */
+
+class SequenceSwitch : public Element { public:
+
+    SequenceSwitch();
+    ~SequenceSwitch();
+
+    const char *class_name() const	{ return "SequenceSwitch"; }
+    const char *port_count() const	{ return "1/1-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+  private:
+
+    atomic_uint32_t _seq;
+    atomic_uint32_t _next;
+    int _anno;
+
+    static String read_handler(Element *e, void *thunk);
+
+};
+
+CLICK_ENDDECLS
+#endif
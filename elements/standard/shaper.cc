@@ -52,7 +52,7 @@ Packet *
 Shaper::pull(int)
 {
     Packet *p = 0;
-    if (_rate.need_update(Timestamp::now())) {
+    if (_rate.need_update(Timestamp::now_fast())) {
 	if ((p = input(0).pull()))
 	    _rate.update();
     }
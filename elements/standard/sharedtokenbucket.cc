@@ -0,0 +1,221 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * sharedtokenbucket.{cc,hh} -- token bucket shared across threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "sharedtokenbucket.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+CLICK_DECLS
+
+static inline uint64_t
+compare_swap64(volatile uint64_t &x, uint64_t expected, uint64_t desired)
+{
+#if CLICK_LINUXMODULE
+    return cmpxchg64(&x, expected, desired);
+#elif HAVE_MULTITHREAD
+    return __sync_val_compare_and_swap(&x, expected, desired);
+#else
+    uint64_t actual = x;
+    if (actual == expected)
+	x = desired;
+    return actual;
+#endif
+}
+
+SharedTokenBucket::SharedTokenBucket()
+{
+}
+
+SharedTokenBucket::~SharedTokenBucket()
+{
+}
+
+void *
+SharedTokenBucket::cast(const char *n)
+{
+    if (strcmp(n, "SharedTokenBucket") == 0)
+	return static_cast<SharedTokenBucket *>(this);
+    else
+	return Element::cast(n);
+}
+
+int
+SharedTokenBucket::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t dur_msec = 20, capacity, batch;
+    bool dur_specified, capacity_specified, batch_specified;
+    const char *burst_size = is_bandwidth() ? "BURST_BYTES" : "BURST_SIZE";
+
+    Args args(conf, this, errh);
+    if (is_bandwidth())
+	args.read_mp("RATE", BandwidthArg(), _rate);
+    else
+	args.read_mp("RATE", _rate);
+    if (args.read("BURST_DURATION", SecondsArg(3), dur_msec).read_status(dur_specified)
+	.read(burst_size, capacity).read_status(capacity_specified)
+	.read("BATCH", batch).read_status(batch_specified)
+	.complete() < 0)
+	return -1;
+
+    if (_rate == 0)
+	return errh->error("RATE must be positive");
+    if (dur_specified && capacity_specified)
+	return errh->error("cannot specify both BURST_DURATION and %s", burst_size);
+    else if (!capacity_specified) {
+	uint64_t c = (uint64_t) _rate * dur_msec / 1000;
+	capacity = c > 0xFFFFFFFFU ? 0xFFFFFFFFU : c;
+    }
+    _capacity = capacity ? capacity : 1;
+
+    if (!batch_specified) {
+	batch = _rate / 10000;
+	if (batch > _capacity / 8)
+	    batch = _capacity / 8;
+    }
+    _batch = batch ? batch : 1;
+
+    // round the cost of a token to the nearest time unit
+    _cost = ((uint64_t) 256000000000ULL + _rate / 2) / _rate;
+    if (_cost == 0)
+	_cost = 1;
+    if (_capacity > ((uint64_t) 1 << 62) / _cost)
+	return errh->error("burst too large");
+    _tau = _cost * _capacity;
+    return 0;
+}
+
+int
+SharedTokenBucket::initialize(ErrorHandler *errh)
+{
+    if (_local.initialize(master()) < 0)
+	return errh->error("out of memory");
+    // start with a full bucket
+    _epoch = Timestamp::now_steady();
+    _empty = 0;
+    return 0;
+}
+
+// Time units since the epoch, offset so that the bucket starts full.
+inline uint64_t
+SharedTokenBucket::now_units() const
+{
+    return (uint64_t) (Timestamp::now_steady() - _epoch).nsecval() * 256 + _tau;
+}
+
+// Removes n tokens from the shared bucket.  Unless force is true, fails
+// without removing anything if the bucket has fewer than n tokens.
+bool
+SharedTokenBucket::acquire(uint64_t n, bool force)
+{
+    uint64_t now = now_units(), cost = n * _cost;
+    uint64_t empty = _empty;
+    while (1) {
+	// a full bucket holds no more than capacity tokens
+	uint64_t base = empty + _tau < now ? now - _tau : empty;
+	uint64_t next = base + cost;
+	if (next > now && !force)
+	    return false;
+	uint64_t actual = compare_swap64(_empty, empty, next);
+	if (actual == empty)
+	    return true;
+	empty = actual;
+    }
+}
+
+// Gives this thread enough tokens to spend n, borrowing a batch from the
+// shared bucket if there is one.
+bool
+SharedTokenBucket::refill_local(Local &l, uint32_t n)
+{
+    uint32_t need = n - l.tokens;
+    if (need < _batch && acquire(_batch, false)) {
+	l.tokens += _batch - n;
+	return true;
+    } else if (acquire(need, false)) {
+	l.tokens = 0;
+	return true;
+    } else
+	return false;
+}
+
+bool
+SharedTokenBucket::contains(uint32_t n)
+{
+    Local &l = _local.get();
+    if (l.tokens >= n)
+	return true;
+    uint64_t now = now_units(), empty = _empty;
+    uint64_t base = empty + _tau < now ? now - _tau : empty;
+    return base + (n - l.tokens) * _cost <= now;
+}
+
+Timestamp
+SharedTokenBucket::time_until_contains(uint32_t n)
+{
+    Local &l = _local.get();
+    if (l.tokens >= n)
+	return Timestamp();
+    uint64_t now = now_units(), empty = _empty;
+    uint64_t base = empty + _tau < now ? now - _tau : empty;
+    uint64_t when = base + (n - l.tokens) * _cost;
+    if (when <= now)
+	return Timestamp();
+    return Timestamp::make_nsec((when - now + 255) / 256);
+}
+
+enum { h_rate, h_burst, h_tokens };
+
+String
+SharedTokenBucket::read_handler(Element *e, void *thunk)
+{
+    SharedTokenBucket *stb = static_cast<SharedTokenBucket *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_rate:
+	if (stb->is_bandwidth())
+	    return BandwidthArg::unparse(stb->_rate);
+	else
+	    return String(stb->_rate);
+    case h_burst:
+	return String(stb->_capacity);
+    case h_tokens: {
+	uint64_t now = stb->now_units(), empty = stb->_empty;
+	if (empty >= now)
+	    return String(0);
+	uint64_t t = (now - empty) / stb->_cost;
+	return String(t > stb->_capacity ? stb->_capacity : (uint32_t) t);
+    }
+    default:
+	return String();
+    }
+}
+
+void
+SharedTokenBucket::add_handlers()
+{
+    add_read_handler("rate", read_handler, h_rate);
+    add_read_handler("burst", read_handler, h_burst);
+    add_read_handler("tokens", read_handler, h_tokens);
+}
+
+BandwidthSharedTokenBucket::BandwidthSharedTokenBucket()
+{
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(SharedTokenBucket)
+EXPORT_ELEMENT(BandwidthSharedTokenBucket)
+ELEMENT_MT_SAFE(SharedTokenBucket)
@@ -0,0 +1,182 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SHAREDTOKENBUCKET_HH
+#define CLICK_SHAREDTOKENBUCKET_HH
+#include <click/element.hh>
+#include <click/percpu.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SharedTokenBucket(RATE [, I<keywords> BURST_DURATION, BURST_SIZE, BATCH])
+BandwidthSharedTokenBucket(RATE [, I<keywords> BURST_DURATION, BURST_BYTES, BATCH])
+
+=s shaping
+
+token bucket shared by rate limiters on several threads
+
+=d
+
+SharedTokenBucket is an information element holding one token bucket that
+can be shared by rate-limiting elements running on different threads, so
+that together they stay within a single RATE.  Rate limiters such as
+RatedSplitter, RatedUnqueue, BandwidthRatedSplitter, and
+BandwidthRatedUnqueue use it when given its name as their SHARED keyword
+argument.  SharedTokenBucket's tokens are packets;
+BandwidthSharedTokenBucket's are bytes, so its RATE is a bandwidth, and it
+may be used only by the bandwidth rate limiters.
+
+The bucket is kept as one 64-bit fixed-point time, the time at which it
+was last empty, which threads update with compare-and-swap; the bucket
+takes no locks.  To avoid contending for that word on every packet, each
+thread borrows up to BATCH tokens at a time and spends them locally.  Local
+tokens are taken out of the shared bucket when borrowed, so the limiters
+never send more than RATE allows over the long run, but a thread that
+stops sending may strand its unspent tokens, and a limiter may reject a
+packet while another thread holds idle tokens.  Smaller BATCH values
+improve accuracy at the cost of more shared updates.
+
+Keyword arguments are:
+
+=over 8
+
+=item RATE
+
+Integer (bandwidth for BandwidthSharedTokenBucket).  Tokens per second.
+
+=item BURST_DURATION
+
+Time.  If specified, the bucket's capacity is RATE * BURST_DURATION.
+Default is 20 milliseconds.
+
+=item BURST_SIZE, BURST_BYTES
+
+Integer.  If specified, the bucket's capacity in tokens.
+
+=item BATCH
+
+Integer.  Tokens each thread borrows at a time.  Default is 100 microseconds
+of RATE, but at most an eighth of the bucket's capacity, and at least 1.
+
+=back
+
+=h rate read-only
+
+Returns RATE.
+
+=h burst read-only
+
+Returns the capacity of the bucket.
+
+=h tokens read-only
+
+Returns the number of tokens in the shared bucket, not counting tokens
+that threads have borrowed.
+
+=e
+
+  rate :: BandwidthSharedTokenBucket(1Gbps);
+  FromDevice(eth0) -> BandwidthRatedSplitter(SHARED rate) -> ...
+  FromDevice(eth1) -> BandwidthRatedSplitter(SHARED rate) -> ...
+  StaticThreadSched(...)
+
+=a RatedSplitter, RatedUnqueue, BandwidthRatedSplitter,
+BandwidthRatedUnqueue */
+
+class SharedTokenBucket : public Element { public:
+
+    SharedTokenBucket();
+    ~SharedTokenBucket();
+
+    const char *class_name() const	{ return "SharedTokenBucket"; }
+    bool is_bandwidth() const		{ return class_name()[0] == 'B'; }
+    void *cast(const char *);
+    int configure_phase() const		{ return CONFIGURE_PHASE_INFO; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    /** @brief Remove @a n tokens if the bucket contains them.
+     * @return true if the tokens were removed */
+    inline bool remove_if(uint32_t n);
+
+    /** @brief Remove @a n tokens, letting the bucket go into debt. */
+    inline void remove(uint32_t n);
+
+    /** @brief Return @a n tokens just removed by this thread. */
+    inline void put_back(uint32_t n);
+
+    /** @brief Return true iff @a n tokens are available to this thread. */
+    bool contains(uint32_t n);
+
+    /** @brief Return the time until @a n tokens are available. */
+    Timestamp time_until_contains(uint32_t n);
+
+    uint32_t rate() const		{ return _rate; }
+
+  private:
+
+    struct Local {
+	uint32_t tokens;
+	Local() : tokens(0) {}
+    };
+
+    // The bucket holds min(capacity, (now - _empty) / _cost) tokens, where
+    // times are in units of 1/256 nanosecond.
+    volatile uint64_t _empty;
+    uint64_t _cost;			// time units per token
+    uint64_t _tau;			// _cost * capacity
+    Timestamp _epoch;
+    uint32_t _rate;
+    uint32_t _capacity;
+    uint32_t _batch;
+    PerCPU<Local> _local;
+
+    inline uint64_t now_units() const;
+    bool acquire(uint64_t n, bool force);
+    bool refill_local(Local &l, uint32_t n);
+
+    static String read_handler(Element *e, void *thunk);
+
+};
+
+class BandwidthSharedTokenBucket : public SharedTokenBucket { public:
+
+    BandwidthSharedTokenBucket();
+    const char *class_name() const	{ return "BandwidthSharedTokenBucket"; }
+
+};
+
+inline bool
+SharedTokenBucket::remove_if(uint32_t n)
+{
+    Local &l = _local.get();
+    if (likely(l.tokens >= n)) {
+	l.tokens -= n;
+	return true;
+    } else
+	return refill_local(l, n);
+}
+
+inline void
+SharedTokenBucket::remove(uint32_t n)
+{
+    Local &l = _local.get();
+    if (likely(l.tokens >= n))
+	l.tokens -= n;
+    else if (!refill_local(l, n)) {
+	acquire(n - l.tokens, true);
+	l.tokens = 0;
+    }
+}
+
+inline void
+SharedTokenBucket::put_back(uint32_t n)
+{
+    _local.get().tokens += n;
+}
+
+CLICK_ENDDECLS
+#endif
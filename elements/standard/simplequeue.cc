@@ -23,7 +23,7 @@
 CLICK_DECLS
 
 SimpleQueue::SimpleQueue()
-    : _q(0)
+    : _q(0), _pool(0)
 {
 }
 
@@ -47,9 +47,16 @@ int
 SimpleQueue::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     unsigned new_capacity = 1000;
-    if (Args(conf, this, errh).read_p("CAPACITY", new_capacity).complete() < 0)
+    BufferPool *pool = 0;
+    if (Args(conf, this, errh)
+	.read_p("CAPACITY", new_capacity)
+	.read("BUFFER_POOL", ElementCastArg("BufferPool"), pool)
+	.complete() < 0)
 	return -1;
+    if (_q && pool != _pool)
+	return errh->error("cannot change BUFFER_POOL");
     _capacity = new_capacity;
+    _pool = pool;
     return 0;
 }
 
@@ -62,6 +69,8 @@ SimpleQueue::initialize(ErrorHandler *errh)
 	return errh->error("out of memory");
     _drops = 0;
     _highwater_length = 0;
+    if (_pool)
+	_pool_slot = _pool->add_queue(this);
     return 0;
 }
 
@@ -85,8 +94,10 @@ SimpleQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
     Storage::index_type i, j;
     for (i = _head, j = 0; i != _tail && j != new_capacity; i = next_i(i))
 	new_q[j++] = _q[i];
-    for (; i != _tail; i = next_i(i))
+    for (; i != _tail; i = next_i(i)) {
+	pool_release(_q[i]);
 	_q[i]->kill();
+    }
 
     CLICK_LFREE(_q, sizeof(Packet *) * (_capacity + 1));
     _q = new_q;
@@ -112,6 +123,8 @@ SimpleQueue::take_state(Element *e, ErrorHandler *errh)
     Storage::index_type i = 0, j = q->_head;
     while (i < _capacity && j != q->_tail) {
 	_q[i] = q->_q[j];
+	if (_pool)
+	    _pool->charge(_pool_slot, _q[i]->length());
 	i++;
 	j = q->next_i(j);
     }
@@ -129,11 +142,24 @@ SimpleQueue::take_state(Element *e, ErrorHandler *errh)
     q->set_tail(0);
 }
 
+size_t
+SimpleQueue::memory_usage() const
+{
+    if (!_q)
+	return 0;
+    size_t m = sizeof(Packet *) * (_capacity + 1);
+    for (Storage::index_type i = _head; i != _tail; i = next_i(i))
+	m += sizeof(WritablePacket) + _q[i]->buffer_length();
+    return m;
+}
+
 void
 SimpleQueue::cleanup(CleanupStage)
 {
-    for (Storage::index_type i = _head; i != _tail; i = next_i(i))
+    for (Storage::index_type i = _head; i != _tail; i = next_i(i)) {
+	pool_release(_q[i]);
 	_q[i]->kill();
+    }
     CLICK_LFREE(_q, sizeof(Packet *) * (_capacity + 1));
     _q = 0;
 }
@@ -146,7 +172,7 @@ SimpleQueue::push(int, Packet *p)
     Storage::index_type h = _head, t = _tail, nt = next_i(t);
 
     // should this stuff be in SimpleQueue::enq?
-    if (nt != h) {
+    if (nt != h && pool_admit(p)) {
 	_q[t] = p;
 	packet_memory_barrier(_q[t], _tail);
 	_tail = nt;
@@ -170,6 +196,34 @@ SimpleQueue::pull(int)
     return deq();
 }
 
+void
+SimpleQueue::push_batch_failure(PacketBatch &batch)
+{
+    if (_drops == 0 && _capacity > 0)
+	click_chatter("%{element}: overflow", this);
+    _drops += batch.count();
+    if (noutputs() > 1)
+	output(1).push_batch(batch);
+    else
+	batch.kill();
+}
+
+void
+SimpleQueue::push_batch(int, PacketBatch &batch)
+{
+    // If you change this code, also change NotifierQueue::push_batch()
+    // and FullNoteQueue::push_batch().
+    enq_batch(batch);
+    if (!batch.empty())
+	push_batch_failure(batch);
+}
+
+void
+SimpleQueue::pull_batch(int, PacketBatch &batch, int max)
+{
+    deq_batch(batch, max);
+}
+
 
 String
 SimpleQueue::read_handler(Element *e, void *thunk)
@@ -225,8 +279,26 @@ SimpleQueue::add_handlers()
     add_write_handler("capacity", reconfigure_keyword_handler, "0 CAPACITY");
     add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON | Handler::NONEXCLUSIVE);
     add_write_handler("reset", write_handler, 1, Handler::BUTTON);
+    add_stat("length", stat_callback, (void *) 0);
+    add_stat("highwater_length", stat_callback, (void *) 1);
+    add_stat("drops", stat_callback, (void *) 3);
+}
+
+uint64_t
+SimpleQueue::stat_callback(const Element *e, void *thunk)
+{
+    const SimpleQueue *q = static_cast<const SimpleQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+      case 0:
+	return q->size();
+      case 1:
+	return q->highwater_length();
+      default:
+	return q->drops();
+    }
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(BufferPool)
 ELEMENT_PROVIDES(Storage)
 EXPORT_ELEMENT(SimpleQueue)
@@ -3,13 +3,15 @@
 #define CLICK_SIMPLEQUEUE_HH
 #include <click/element.hh>
 #include <click/standard/storage.hh>
+#include <click/prefetch.hh>
+#include "elements/standard/bufferpool.hh"
 CLICK_DECLS
 
 /*
 =c
 
 SimpleQueue
-SimpleQueue(CAPACITY)
+SimpleQueue(CAPACITY [, I<keywords> BUFFER_POOL])
 
 =s storage
 
@@ -21,6 +23,11 @@ Stores incoming packets in a first-in-first-out queue.
 Drops incoming packets if the queue already holds CAPACITY packets.
 The default for CAPACITY is 1000.
 
+If BUFFER_POOL names a BufferPool element, the queue also drops incoming
+packets that the pool refuses, so that a byte budget is shared among all
+queues using the pool.  Queue, ThreadSafeQueue, and the other queue elements
+derived from SimpleQueue accept the same keyword.
+
 B<Multithreaded Click note:> SimpleQueue is designed to be used in an
 environment with at most one concurrent pusher and at most one concurrent
 puller.  Thus, at most one thread pushes to the SimpleQueue at a time and at
@@ -52,6 +59,9 @@ Returns or sets the queue's capacity.
 Returns the number of packets dropped by the queue so far.  Dropped packets
 are emitted on output 1 if output 1 exists.
 
+The length, highwater_length, and drops values are also registered as
+statistics; see the global 'stats' handler.
+
 =h reset_counts write-only
 
 When written, resets the C<drops> and C<highwater_length> counters.
@@ -60,7 +70,13 @@ When written, resets the C<drops> and C<highwater_length> counters.
 
 When written, drops all packets in the queue.
 
-=a Queue, NotifierQueue, MixedQueue, RED, FrontDropQueue, ThreadSafeQueue */
+=h memory read-only
+
+Returns the number of bytes held by the queue: its slot array plus the
+queued packets and their data buffers.
+
+=a Queue, NotifierQueue, MixedQueue, RED, FrontDropQueue, ThreadSafeQueue,
+BufferPool */
 
 class SimpleQueue : public Element, public Storage { public:
 
@@ -73,6 +89,8 @@ class SimpleQueue : public Element, public Storage { public:
     inline bool enq(Packet*);
     inline void lifo_enq(Packet*);
     inline Packet* deq();
+    inline int enq_batch(PacketBatch &batch);
+    inline int deq_batch(PacketBatch &batch, int max);
 
     // to be used with care
     Packet* packet(int i) const			{ return _q[i]; }
@@ -93,16 +111,30 @@ class SimpleQueue : public Element, public Storage { public:
     bool can_live_reconfigure() const		{ return true; }
     int live_reconfigure(Vector<String>&, ErrorHandler*);
     void take_state(Element*, ErrorHandler*);
+    size_t memory_usage() const;
     void add_handlers();
 
     void push(int port, Packet*);
     Packet* pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
   protected:
 
     Packet* volatile * _q;
     volatile int _drops;
     int _highwater_length;
+    BufferPool *_pool;
+    int _pool_slot;
+
+    inline bool pool_admit(Packet *&p) {
+	return !_pool || _pool->admit(_pool_slot, p);
+    }
+    inline void pool_release(Packet *p) {
+	if (_pool)
+	    _pool->release(_pool_slot, p->length());
+    }
+    void push_batch_failure(PacketBatch &batch);
 
     friend class MixedQueue;
     friend class TokenQueue;
@@ -111,6 +143,7 @@ class SimpleQueue : public Element, public Storage { public:
 
     static String read_handler(Element*, void*);
     static int write_handler(const String&, Element*, void*, ErrorHandler*);
+    static uint64_t stat_callback(const Element*, void*);
 
 };
 
@@ -120,7 +153,7 @@ SimpleQueue::enq(Packet *p)
 {
     assert(p);
     Storage::index_type h = _head, t = _tail, nt = next_i(t);
-    if (nt != h) {
+    if (nt != h && pool_admit(p)) {
 	_q[t] = p;
 	packet_memory_barrier(_q[t], _tail);
 	_tail = nt;
@@ -142,8 +175,14 @@ SimpleQueue::lifo_enq(Packet *p)
     // than plain (FIFO) enq().
     assert(p);
     Storage::index_type h = _head, t = _tail, ph = prev_i(h);
+    if (!pool_admit(p)) {
+	p->kill();
+	_drops++;
+	return;
+    }
     if (ph == t) {
 	t = prev_i(t);
+	pool_release(_q[t]);
 	_q[t]->kill();
 	_tail = t;
     }
@@ -161,11 +200,73 @@ SimpleQueue::deq()
 	packet_memory_barrier(_q[h], _head);
 	_head = next_i(h);
 	assert(p);
+	pool_release(p);
 	return p;
     } else
 	return 0;
 }
 
+/** @brief Enqueue packets from the front of @a batch.
+ * @return the number of packets enqueued
+ *
+ * Moves packets until the queue is full or its buffer pool refuses one,
+ * then publishes them all with a single tail update.  Packets that were
+ * not enqueued are left in @a batch. */
+inline int
+SimpleQueue::enq_batch(PacketBatch &batch)
+{
+    Storage::index_type h = _head, t = _tail, nt;
+    int n = 0;
+    while (Packet *p = batch.pop_front()) {
+	nt = next_i(t);
+	if (nt == h || !pool_admit(p)) {
+	    batch.push_front(p);
+	    break;
+	}
+	_q[t] = p;
+	t = nt;
+	++n;
+    }
+    if (n) {
+	packet_memory_barrier(_q[prev_i(t)], _tail);
+	_tail = t;
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+    }
+    return n;
+}
+
+/** @brief Dequeue up to @a max packets onto the end of @a batch.
+ * @return the number of packets dequeued
+ *
+ * The packets are released with a single head update. */
+inline int
+SimpleQueue::deq_batch(PacketBatch &batch, int max)
+{
+    Storage::index_type h = _head, t = _tail;
+    // Prefetch packets, whose next() annotations push_back() writes, a few
+    // slots ahead of the dequeue.
+    Storage::index_type ph = h;
+    for (int i = 0; i < CLICK_PREFETCH_DISTANCE && i < max && ph != t; ++i, ph = next_i(ph))
+	click_prefetch_write(_q[ph]);
+    int n = 0;
+    for (; h != t && n < max; h = next_i(h), ++n) {
+	if (ph != t && n + CLICK_PREFETCH_DISTANCE < max) {
+	    click_prefetch_write(_q[ph]);
+	    ph = next_i(ph);
+	}
+	Packet *p = _q[h];
+	pool_release(p);
+	batch.push_back(p);
+    }
+    if (n) {
+	packet_memory_barrier(_q[prev_i(h)], _head);
+	_head = h;
+    }
+    return n;
+}
+
 template <typename Filter>
 Packet *
 SimpleQueue::yank1(Filter filter)
@@ -183,6 +284,7 @@ SimpleQueue::yank1(Filter filter)
 		prev = prev_i(prev);
 	    }
 	    _head = next_i(_head);
+	    pool_release(p);
 	    return p;
 	}
     return 0;
@@ -217,6 +319,7 @@ SimpleQueue::yank(Filter filter, Vector<Packet *> &yank_vec)
     for (Storage::index_type trav = _tail; trav != _head; ) {
 	trav = prev_i(trav);
 	if (filter(_q[trav])) {
+	    pool_release(_q[trav]);
 	    yank_vec.push_back(_q[trav]);
 	    nyanked++;
 	} else {
@@ -0,0 +1,225 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * stathistory.{cc,hh} -- keeps recent samples of registered statistics
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "stathistory.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+StatHistory::StatHistory()
+    : _ring(0), _last(0), _nsamples(0), _begun(0), _timer(this)
+{
+}
+
+StatHistory::~StatHistory()
+{
+    delete[] _ring;
+    delete[] _last;
+}
+
+int
+StatHistory::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _interval = Timestamp(1);
+    _size = 300;
+    _delta = true;
+    if (Args(conf, this, errh)
+	.read_all_with("STAT", AnyArg(), _selectors)
+	.read("INTERVAL", _interval)
+	.read("SIZE", _size)
+	.read("DELTA", _delta)
+	.complete() < 0)
+	return -1;
+    if (_size < 1 || _size > 0x100000)
+	return errh->error("SIZE out of range");
+    return 0;
+}
+
+bool
+StatHistory::selects(const String &selector, const String &stat_name)
+{
+    // "e" selects "e.count"; "e.count" selects only itself.
+    return stat_name.starts_with(selector)
+	&& (stat_name.length() == selector.length()
+	    || stat_name[selector.length()] == '.');
+}
+
+int
+StatHistory::initialize(ErrorHandler *errh)
+{
+    // Every element has registered its statistics by now, in add_handlers().
+    Router *r = router();
+    for (int id = 0; id < r->nstats(); ++id) {
+	String name = r->stat_name(id);
+	bool ok = !_selectors.size();
+	for (int i = 0; i < _selectors.size() && !ok; ++i)
+	    ok = selects(_selectors[i], name);
+	if (ok)
+	    _ids.push_back(id);
+    }
+    for (int i = 0; i < _selectors.size(); ++i) {
+	int id = 0;
+	while (id < r->nstats() && !selects(_selectors[i], r->stat_name(id)))
+	    ++id;
+	if (id == r->nstats())
+	    errh->warning("no statistics match %<%s%>", _selectors[i].c_str());
+    }
+
+    if (_ids.size()) {
+	_ring = new uint64_t[_ids.size() * _size];
+	_last = new uint64_t[_ids.size()];
+	if (!_ring || !_last)
+	    return errh->error("out of memory");
+    }
+    reset();
+    _timer.initialize(this);
+    if (_interval)
+	_timer.schedule_after(_interval);
+    return 0;
+}
+
+void
+StatHistory::reset()
+{
+    _lock.acquire();
+    _nsamples = _begun = 0;
+    click_fence();
+    for (int i = 0; i < _ids.size(); ++i)
+	_last[i] = _delta ? router()->stat_value(_ids[i]) : 0;
+    _lock.release();
+}
+
+void
+StatHistory::sample()
+{
+    // The timer and the sample handler both write, so writers take _lock;
+    // readers never do.
+    _lock.acquire();
+    uint32_t n = _nsamples;
+    _begun = n + 1;
+    click_fence();
+    uint64_t *slot = _ring + n % _size;
+    for (int i = 0; i < _ids.size(); ++i, slot += _size) {
+	uint64_t v = router()->stat_value(_ids[i]);
+	if (_delta) {
+	    *slot = (v >= _last[i] ? v - _last[i] : v);
+	    _last[i] = v;
+	} else
+	    *slot = v;
+    }
+    click_fence();
+    _nsamples = n + 1;
+    _lock.release();
+}
+
+void
+StatHistory::run_timer(Timer *)
+{
+    sample();
+    _timer.reschedule_after(_interval);
+}
+
+String
+StatHistory::unparse_history(const Vector<String> &selectors) const
+{
+    Router *r = router();
+    uint32_t n1 = _nsamples;
+    click_read_fence();
+    uint32_t count = (n1 < _size ? n1 : _size), start = n1 - count;
+
+    Vector<int> rows;
+    Vector<uint64_t> copy;
+    for (int i = 0; i < _ids.size(); ++i) {
+	String name = r->stat_name(_ids[i]);
+	bool ok = !selectors.size();
+	for (int j = 0; j < selectors.size() && !ok; ++j)
+	    ok = selects(selectors[j], name);
+	if (!ok)
+	    continue;
+	rows.push_back(i);
+	const uint64_t *row = _ring + i * _size;
+	for (uint32_t k = start; k != n1; ++k)
+	    copy.push_back(row[k % _size]);
+    }
+
+    // Drop samples a writer may have overwritten while we copied: writing
+    // sample b - 1 overwrites sample b - 1 - _size.
+    click_read_fence();
+    uint32_t b = _begun, skip;
+    if (b < n1)			// reset
+	skip = count;
+    else if (b > start + _size)
+	skip = b - _size - start;
+    else
+	skip = 0;
+    if (skip > count)
+	skip = count;
+
+    StringAccum sa;
+    for (int i = 0; i < rows.size(); ++i) {
+	sa << r->stat_name(_ids[rows[i]]);
+	for (uint32_t k = skip; k < count; ++k)
+	    sa << ' ' << copy[i * count + k];
+	sa << '\n';
+    }
+    return sa.take_string();
+}
+
+enum { h_samples, h_sample, h_reset };
+
+String
+StatHistory::read_handler(Element *e, void *)
+{
+    StatHistory *sh = static_cast<StatHistory *>(e);
+    uint32_t n = sh->_nsamples;
+    return String(n < sh->_size ? n : sh->_size);
+}
+
+int
+StatHistory::history_handler(int, String &str, Element *e, const Handler *, ErrorHandler *)
+{
+    StatHistory *sh = static_cast<StatHistory *>(e);
+    Vector<String> selectors;
+    cp_spacevec(cp_uncomment(str), selectors);
+    str = sh->unparse_history(selectors);
+    return 0;
+}
+
+int
+StatHistory::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
+{
+    StatHistory *sh = static_cast<StatHistory *>(e);
+    if ((uintptr_t) thunk == h_sample)
+	sh->sample();
+    else
+	sh->reset();
+    return 0;
+}
+
+void
+StatHistory::add_handlers()
+{
+    set_handler("history", Handler::OP_READ | Handler::READ_PARAM, history_handler);
+    add_read_handler("samples", read_handler, h_samples);
+    add_write_handler("sample", write_handler, h_sample, Handler::BUTTON);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(StatHistory)
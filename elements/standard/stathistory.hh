@@ -0,0 +1,131 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_STATHISTORY_HH
+#define CLICK_STATHISTORY_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/*
+=c
+
+StatHistory([I<keywords> STAT, INTERVAL, SIZE, DELTA])
+
+=s counters
+
+keeps recent samples of registered statistics
+
+=d
+
+StatHistory samples registered statistics (see the global C<stats> handler)
+every INTERVAL, and keeps the last SIZE samples of each in a ring buffer.
+One timer samples every statistic, so hundreds of counters can be graphed
+with one history read per refresh, rather than a handler read per counter or
+a timer per element.
+
+By default StatHistory samples every statistic the router has.  The STAT
+keyword chooses some instead: either a statistic's full name, like
+C<c.count>, or an element name, which chooses all of that element's
+statistics.
+
+Samples are written by the timer and read by handlers without locks.  A
+reader that races with the timer sees either the old or the new sample,
+never a torn one; it drops any samples the timer overwrote while it was
+copying.
+
+Keyword arguments are:
+
+=over 8
+
+=item STAT
+
+A statistic or element name.  May be given more than once.
+
+=item INTERVAL
+
+Time in seconds.  The sampling interval.  If 0, the timer is off, and
+samples are taken only by the C<sample> handler.  Default is 1.
+
+=item SIZE
+
+Unsigned integer.  Samples kept per statistic.  Default is 300.
+
+=item DELTA
+
+Boolean.  If true, each sample is the statistic's increase since the
+previous sample (or its value, if it decreased, as after a reset), so
+counters become per-interval rates.  If false, each sample is the
+statistic's value, which suits lengths and other gauges.  Default is true.
+
+=back
+
+=h history read-only
+
+Returns one line per statistic: the statistic's name followed by its
+samples, oldest first.  Takes an optional parameter, a space-separated list
+of statistic or element names, to report only some.
+
+=h samples read-only
+
+Returns the number of samples held per statistic.
+
+=h sample write-only
+
+Takes a sample now.
+
+=h reset write-only
+
+Forgets every sample.
+
+=e
+
+  InfiniteSource -> c :: Counter -> Discard;
+  sh :: StatHistory(STAT c, SIZE 60);
+
+Then C<sh.history> returns the packets and bytes per second over the last
+minute.
+
+=a
+
+Counter, AverageCounter */
+
+class StatHistory : public Element { public:
+
+    StatHistory();
+    ~StatHistory();
+
+    const char *class_name() const	{ return "StatHistory"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    void run_timer(Timer *timer);
+
+  private:
+
+    Vector<String> _selectors;
+    Vector<int> _ids;		// sampled statistic ids
+    uint64_t *_ring;		// _ids.size() rows of _size samples
+    uint64_t *_last;		// previous values, for DELTA
+    uint32_t _size;
+    bool _delta;
+    volatile uint32_t _nsamples;	// samples ever taken
+    volatile uint32_t _begun;	// samples ever started
+    Timestamp _interval;
+    Timer _timer;
+    Spinlock _lock;
+
+    static bool selects(const String &selector, const String &stat_name);
+    void sample();
+    void reset();
+    String unparse_history(const Vector<String> &selectors) const;
+
+    static String read_handler(Element *e, void *thunk);
+    static int history_handler(int op, String &str, Element *e, const Handler *h, ErrorHandler *errh);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -22,10 +22,11 @@
 #include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/error.hh>
+#include <click/heap.hh>
 CLICK_DECLS
 
 StrideSched::StrideSched()
-    : _all(0), _list(0)
+    : _all(0), _vpass(0), _signals(0), _active(0), _waiting(0)
 {
 }
 
@@ -61,21 +62,33 @@ StrideSched::configure(Vector<String> &conf, ErrorHandler *errh)
 	}
     }
 
-    // insert into reverse order so they're run in forward order on ties
-    _list = 0;
-    for (int i = nclients() - 1; i >= 0; i--)
+    // idle clients rejoin the heap when pull() finds them active
+    _heap.clear();
+    for (int i = 0; i < nclients(); i++) {
+	_all[i]._heap_index = -1;
 	if (_all[i]._tickets)
-	    _all[i].insert(&_list);
+	    heap_insert(&_all[i]);
+    }
+    if (_waiting)
+	memset(_waiting, 0, _signal_set.nwords() * sizeof(uint32_t));
 
     return errh->nerrors() ? -1 : 0;
 }
 
 int
-StrideSched::initialize(ErrorHandler *)
+StrideSched::initialize(ErrorHandler *errh)
 {
-    if (input_is_push(0))
+    if (input_is_pull(0)) {
+	if (!(_signals = new NotifierSignal[nclients()]))
+	    return errh->error("out of memory");
 	for (int i = 0; i < nclients(); ++i)
-	    _all[i]._signal = Notifier::upstream_empty_signal(this, i, 0);
+	    _signals[i] = Notifier::upstream_empty_signal(this, i, 0);
+	if (_signal_set.initialize(_signals, nclients()) < 0
+	    || !(_active = new uint32_t[_signal_set.nwords()])
+	    || !(_waiting = new uint32_t[_signal_set.nwords()]))
+	    return errh->error("out of memory");
+	memset(_waiting, 0, _signal_set.nwords() * sizeof(uint32_t));
+    }
     return 0;
 }
 
@@ -83,32 +96,66 @@ void
 StrideSched::cleanup(CleanupStage)
 {
     delete[] _all;
+    delete[] _signals;
+    delete[] _active;
+    delete[] _waiting;
+}
+
+void
+StrideSched::heap_insert(Client *c)
+{
+    _heap.push_back(c);
+    push_heap(_heap.begin(), _heap.end(), heap_less(), heap_place());
+}
+
+void
+StrideSched::heap_remove(Client *c)
+{
+    remove_heap(_heap.begin(), _heap.end(), _heap.begin() + c->_heap_index,
+		heap_less(), heap_place());
+    _heap.pop_back();
+    c->_heap_index = -1;
+}
+
+void
+StrideSched::heap_stride_top()
+{
+    _vpass = _heap[0]->_pass;
+    _heap[0]->stride();
+    change_heap(_heap.begin(), _heap.end(), _heap.begin(),
+		heap_less(), heap_place());
 }
 
 Packet *
 StrideSched::pull(int)
 {
-    // go over list until we find a packet, striding as we go
-    Client *stridden = _list, *c;
-    Packet *p = 0;
-    for (c = _list; c && !p; c = c->_next) {
-	if (c->_signal)
-	    p = input(c - _all).pull();
-	c->stride();
-    }
-
-    // remove stridden portion from list
-    if ((_list = c))
-	c->_pprev = &_list;
+    // return newly active clients to the heap; a client does not bank
+    // passes while it is idle
+    _signal_set.active_bitmap(_active);
+    for (int w = 0; w < _signal_set.nwords(); w++)
+	if (uint32_t x = _active[w] & _waiting[w]) {
+	    _waiting[w] &= ~x;
+	    for (; x; x &= x - 1) {
+		Client *c = &_all[(w << 5) + ffs_lsb(x) - 1];
+		if (PASS_GT(_vpass, c->_pass))
+		    c->_pass = _vpass;
+		heap_insert(c);
+	    }
+	}
 
-    // reinsert stridden portion into list
-    while (stridden != c) {
-	Client *next = stridden->_next;
-	stridden->insert(&_list);
-	stridden = next;
+    // pull in stride order, setting aside clients that have no packet
+    while (!_heap.empty()) {
+	Client *c = _heap[0];
+	int i = c - _all;
+	if (_active[i >> 5] & (1U << (i & 31)))
+	    if (Packet *p = input(i).pull()) {
+		heap_stride_top();
+		return p;
+	    }
+	heap_remove(c);
+	_waiting[i >> 5] |= 1U << (i & 31);
     }
-
-    return p;
+    return 0;
 }
 
 int
@@ -135,11 +182,15 @@ StrideSched::set_tickets(int port, int tickets, ErrorHandler *errh)
     int old_tickets = _all[port]._tickets;
     _all[port].set_tickets(tickets);
 
-    if (tickets == 0 && old_tickets != 0)
-	_all[port].remove();
-    else if (tickets != 0 && old_tickets == 0) {
-	_all[port]._pass = (_list ? _list->_pass + _all[port]._stride : 0);
-	_all[port].insert(&_list);
+    if (tickets == 0 && old_tickets != 0) {
+	if (_all[port]._heap_index >= 0)
+	    heap_remove(&_all[port]);
+	if (_waiting)
+	    _waiting[port >> 5] &= ~(1U << (port & 31));
+    } else if (tickets != 0 && old_tickets == 0) {
+	_all[port]._pass = (_heap.empty() ? _vpass : _heap[0]->_pass)
+	    + _all[port]._stride;
+	heap_insert(&_all[port]);
     }
     return 0;
 }
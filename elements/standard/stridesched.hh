@@ -25,6 +25,11 @@ CLICK_DECLS
  *
  * The inputs usually come from Queues or other pull schedulers.
  * StrideSched uses notification to avoid pulling from empty inputs.
+ * It reads its inputs' signals a word at a time and skips inactive inputs
+ * without visiting them, so empty inputs cost little even when there are
+ * hundreds.  Inputs without packets leave the stride
+ * scheduling queue, which is a heap, and rejoin it at the current pass when
+ * they have packets again, so idle inputs do not bank service.
  *
  * =h tickets0...ticketsI<N-1> read/write
  * Returns or sets the number of tickets for each input port.
@@ -57,15 +62,13 @@ class StrideSched : public Element { public:
   protected:
 
     struct Client {
-	Client **_pprev;
-	Client *_next;
 	unsigned _pass;
 	unsigned _stride;
 	int _tickets;
-	NotifierSignal _signal;
+	int _heap_index;
 
 	Client()
-	    : _pprev(0), _next(0), _pass(0), _stride(0), _tickets(-1) {
+	    : _pass(0), _stride(0), _tickets(-1), _heap_index(-1) {
 	}
 
 	void set_tickets(int t) {
@@ -75,23 +78,32 @@ class StrideSched : public Element { public:
 	void stride() {
 	    _pass += _stride;
 	}
+    };
 
-	void insert(Client **list) {
-	    _pprev = list;
-	    while ((_next = *_pprev) && PASS_GT(_pass, _next->_pass))
-		_pprev = &_next->_next;
-	    *_pprev = this;
-	    if (_next)
-		_next->_pprev = &_next;
+    struct heap_less {
+	bool operator()(const Client *a, const Client *b) const {
+	    // run lower-numbered clients first on ties
+	    return PASS_GT(b->_pass, a->_pass)
+		|| (a->_pass == b->_pass && a < b);
 	}
-	void remove() {
-	    if ((*_pprev = _next))
-		_next->_pprev = _pprev;
+    };
+    struct heap_place {
+	void operator()(Client **begin, Client **it) const {
+	    (*it)->_heap_index = it - begin;
 	}
     };
 
     Client *_all;
-    Client *_list;
+    Vector<Client *> _heap;		// clients with tickets, by pass
+    unsigned _vpass;			// pass of the last client scheduled
+    NotifierSignal *_signals;
+    NotifierSignalSet _signal_set;
+    uint32_t *_active;
+    uint32_t *_waiting;		// clients with tickets not in _heap
+
+    void heap_insert(Client *c);
+    void heap_remove(Client *c);
+    void heap_stride_top();
 
     int nclients() const {
 	return input_is_pull(0) ? ninputs() : noutputs();
@@ -33,13 +33,10 @@ StrideSwitch::~StrideSwitch()
 void
 StrideSwitch::push(int, Packet *p)
 {
-    if (_list) {
-	Client *stridden = _list;
-	if ((_list = stridden->_next))
-	    _list->_pprev = &_list;
-	stridden->stride();
-	stridden->insert(&_list);
-	output(stridden - _all).push(p);
+    if (!_heap.empty()) {
+	int port = _heap[0] - _all;
+	heap_stride_top();
+	output(port).push(p);
     } else
 	p->kill();
 }
@@ -44,6 +44,22 @@ Strip::simple_action(Packet *p)
     return p;
 }
 
+void
+Strip::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+Strip::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(Strip)
 ELEMENT_MT_SAFE(Strip)
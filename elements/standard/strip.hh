@@ -11,6 +11,10 @@ CLICK_DECLS
  * strips bytes from front of packets
  * =d
  * Deletes the first LENGTH bytes from each packet.
+ *
+ * Strip never copies packet data.  It changes only this packet's view of
+ * the data, so packets shared with other branches, for example by Tee, are
+ * stripped without being copied.
  * =e
  * Use this to get rid of the Ethernet header:
  *
@@ -27,8 +31,11 @@ class Strip : public Element { public:
     const char *port_count() const		{ return PORTS_1_1; }
 
     int configure(Vector<String> &, ErrorHandler *);
+    int data_shift() const			{ return _nbytes; }
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
   private:
 
@@ -22,6 +22,9 @@ CLICK_DECLS
  * packet data, then StripToNetworkHeader will move the packet data pointer
  * back, to point at the network header.
  *
+ * StripToNetworkHeader never copies a shared packet to move its data
+ * pointer, in either direction.
+ *
  * =a Strip
  */
 
@@ -32,6 +35,7 @@ class StripToNetworkHeader : public Element { public:
 
     const char *class_name() const	{ return "StripToNetworkHeader"; }
     const char *port_count() const	{ return PORTS_1_1; }
+    int data_shift() const		{ return DATA_SHIFT_UNKNOWN; }
 
     Packet *simple_action(Packet *);
 
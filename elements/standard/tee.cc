@@ -29,6 +29,14 @@ Tee::~Tee()
 {
 }
 
+void
+Tee::static_initialize()
+{
+#if HAVE_DIRECT_PORT_TRANSFER
+    add_direct_push("Tee", direct_push<Tee>);
+#endif
+}
+
 int
 Tee::configure(Vector<String> &conf, ErrorHandler *errh)
 {
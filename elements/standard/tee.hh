@@ -32,6 +32,7 @@ class Tee : public Element {
   const char *class_name() const		{ return "Tee"; }
   const char *port_count() const		{ return "1/1-"; }
   const char *processing() const		{ return PUSH; }
+  static void static_initialize();
 
   int configure(Vector<String> &, ErrorHandler *);
 
@@ -63,7 +63,7 @@ ThreadSafeQueue::push(int, Packet *p)
     // Other pushers spin until _tail := nt (or _xtail := t)
 
     Storage::index_type h = _head;
-    if (nt != h)
+    if (nt != h && pool_admit(p))
 	push_success(h, t, nt, p);
     else {
 	_xtail = t;
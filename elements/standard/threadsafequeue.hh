@@ -8,7 +8,7 @@ CLICK_DECLS
 =c
 
 ThreadSafeQueue
-ThreadSafeQueue(CAPACITY)
+ThreadSafeQueue(CAPACITY [, I<keywords> BUFFER_POOL])
 
 =s storage
 
@@ -18,7 +18,9 @@ stores packets in a FIFO queue
 
 Stores incoming packets in a first-in-first-out queue.
 Drops incoming packets if the queue already holds CAPACITY packets.
-The default for CAPACITY is 1000.
+The default for CAPACITY is 1000.  If BUFFER_POOL names a BufferPool
+element, the queue also drops packets that the pool refuses; see
+SimpleQueue.
 
 This variant of the default Queue is (should be) completely thread safe, in
 that it supports multiple concurrent pushers and pullers.  In all respects
@@ -63,6 +65,13 @@ class ThreadSafeQueue : public FullNoteQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    // The batch fast path assumes one pusher and one puller.
+    void push_batch(int port, PacketBatch &batch) {
+	Element::push_batch(port, batch);
+    }
+    void pull_batch(int port, PacketBatch &batch, int max) {
+	Element::pull_batch(port, batch, max);
+    }
 
   private:
 
@@ -26,7 +26,7 @@ CLICK_DECLS
 TimedSource::TimedSource()
     : _packet(0), _interval(0, Timestamp::subsec_per_sec / 2), _limit(-1),
       _count(0), _active(true), _stop(false), _timer(this),
-      _headroom(Packet::default_headroom)
+      _headroom(Packet::default_headroom), _pace(pace_hook, this)
 {
 }
 
@@ -46,6 +46,7 @@ TimedSource::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ACTIVE", _active)
 	.read("STOP", _stop)
 	.read("HEADROOM", _headroom)
+	.read("SPIN", _spin)
 	.complete() < 0)
 	return -1;
 
@@ -60,7 +61,11 @@ int
 TimedSource::initialize(ErrorHandler *)
 {
   _timer.initialize(this);
-  if (_active)
+  if (_spin) {
+    _pace.attach(Pacer::open(this, _spin));
+    if (_active)
+      _pace.schedule_at_steady(Timestamp::now_steady() + _interval);
+  } else if (_active)
     _timer.schedule_after(_interval);
   return 0;
 }
@@ -68,11 +73,31 @@ TimedSource::initialize(ErrorHandler *)
 void
 TimedSource::cleanup(CleanupStage)
 {
+  if (Pacer *pacer = _pace.pacer()) {
+    _pace.unschedule();
+    pacer->close(this);
+    _pace.attach(0);
+  }
   if (_packet)
     _packet->kill();
   _packet = 0;
 }
 
+bool
+TimedSource::scheduled() const
+{
+    return _pace.pacer() ? _pace.scheduled() : _timer.scheduled();
+}
+
+void
+TimedSource::schedule_now()
+{
+    if (_pace.pacer())
+	_pace.schedule_at_steady(Timestamp::now_steady());
+    else
+	_timer.schedule_now();
+}
+
 void
 TimedSource::run_timer(Timer *)
 {
@@ -80,14 +105,28 @@ TimedSource::run_timer(Timer *)
 	return;
     if (_limit < 0 || _count < _limit) {
 	Packet *p = _packet->clone();
-	p->timestamp_anno().assign_now();
+	if (_pace.pacer())
+	    p->timestamp_anno().assign_now();
+	else
+	    p->timestamp_anno().assign_now_fast();
 	output(0).push(p);
 	_count++;
-	_timer.reschedule_after(_interval);
+	if (_pace.pacer()) {
+	    Timestamp next = _pace.deadline() + _interval;
+	    Timestamp now = Timestamp::now_steady();
+	    _pace.schedule_at_steady(next < now ? now : next);
+	} else
+	    _timer.reschedule_after(_interval);
     } else if (_stop)
 	router()->please_stop_driver();
 }
 
+void
+TimedSource::pace_hook(void *user_data)
+{
+    static_cast<TimedSource *>(user_data)->run_timer(0);
+}
+
 String
 TimedSource::read_param(Element *e, void *vparam)
 {
@@ -137,15 +176,15 @@ TimedSource::change_param(const String &s, Element *e, void *vparam,
    case h_active: {
        if (!BoolArg().parse(s, ts->_active))
        return errh->error("bad active");
-     if (!ts->_timer.scheduled() && ts->_active)
-       ts->_timer.schedule_now();
+     if (!ts->scheduled() && ts->_active)
+       ts->schedule_now();
      break;
    }
 
    case h_reset: {
      ts->_count = 0;
-     if (!ts->_timer.scheduled() && ts->_active)
-       ts->_timer.schedule_now();
+     if (!ts->scheduled() && ts->_active)
+       ts->schedule_now();
      break;
    }
 
@@ -170,5 +209,6 @@ TimedSource::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(Pacer)
 EXPORT_ELEMENT(TimedSource)
 ELEMENT_MT_SAFE(TimedSource)
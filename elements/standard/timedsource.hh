@@ -2,6 +2,7 @@
 #define CLICK_TIMEDSOURCE_HH
 #include <click/element.hh>
 #include <click/timer.hh>
+#include "elements/standard/pacer.hh"
 CLICK_DECLS
 
 /*
@@ -46,6 +47,15 @@ the default packet headroom.
 Boolean. If true, then stop the driver once LIMIT packets are sent. Default is
 false.
 
+=item SPIN
+
+Time. If nonzero, pace packets precisely with the thread's Pacer rather than a
+Timer: the thread busy-waits for up to SPIN before each packet is due, then
+sends it and sets its timestamp annotation to the current time.  Packets are
+due exactly INTERVAL apart; a TimedSource that falls more than INTERVAL
+behind starts again from the current time rather than catching up.  Default
+is 0, which uses a Timer and sends packets about every INTERVAL.
+
 =back
 
 =e
@@ -89,6 +99,12 @@ class TimedSource : public Element { public:
     Timer _timer;
     String _data;
     uint32_t _headroom;
+    Timestamp _spin;
+    Pacer::Client _pace;
+
+    bool scheduled() const;
+    void schedule_now();
+    static void pace_hook(void *user_data);
 
     enum { h_data, h_interval, h_active, h_reset, h_headroom };
     static String read_param(Element *, void *);
@@ -25,7 +25,7 @@
 CLICK_DECLS
 
 TimedUnqueue::TimedUnqueue()
-    : _burst(1), _task(this), _timer(&_task)
+    : _burst(1), _task(this), _timer(&_task), _pace(pace_hook, this)
 {
 }
 
@@ -37,7 +37,7 @@ int
 TimedUnqueue::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     if (Args(conf, this, errh).read_mp("INTERVAL", SecondsArg(3), _interval)
-	.read_p("BURST", _burst).complete() < 0)
+	.read_p("BURST", _burst).read("SPIN", _spin).complete() < 0)
 	return -1;
     if (_burst <= 0)
 	return errh->error("bad BURST");
@@ -47,15 +47,56 @@ TimedUnqueue::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 TimedUnqueue::initialize(ErrorHandler *errh)
 {
-    ScheduleInfo::initialize_task(this, &_task, true, errh);
+    ScheduleInfo::initialize_task(this, &_task, !_spin, errh);
     _timer.initialize(this);
     _signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    if (_spin) {
+	_pace.attach(Pacer::open(this, _spin));
+	_pace.schedule_at_steady(Timestamp::now_steady());
+    }
     return 0;
 }
 
+void
+TimedUnqueue::cleanup(CleanupStage)
+{
+    if (Pacer *pacer = _pace.pacer()) {
+	_pace.unschedule();
+	pacer->close(this);
+	_pace.attach(0);
+    }
+}
+
+void
+TimedUnqueue::pace_hook(void *user_data)
+{
+    TimedUnqueue *tu = static_cast<TimedUnqueue *>(user_data);
+    int i;
+    for (i = 0; i < tu->_burst; i++) {
+	Packet *p = tu->input(0).pull();
+	if (!p)
+	    break;
+	tu->output(0).push(p);
+    }
+    // Wait for the upstream signal to wake the task if there was nothing.
+    if (i == 0 && use_signal && !tu->_signal)
+	return;
+
+    Timestamp next = tu->_pace.deadline() + Timestamp::make_msec(tu->_interval);
+    Timestamp now = Timestamp::now_steady();
+    tu->_pace.schedule_at_steady(next < now ? now : next);
+}
+
 bool
 TimedUnqueue::run_task(Task *)
 {
+    // With SPIN, the task only restarts pacing once upstream has packets.
+    if (_pace.pacer()) {
+	if (!_pace.scheduled())
+	    _pace.schedule_at_steady(Timestamp::now_steady());
+	return false;
+    }
+
     // don't run if the timer is scheduled (an upstream queue went nonempty
     // but we don't care)
     if (_timer.scheduled())
@@ -82,4 +123,5 @@ TimedUnqueue::run_task(Task *)
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(Pacer)
 EXPORT_ELEMENT(TimedUnqueue)
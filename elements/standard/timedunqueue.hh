@@ -4,11 +4,12 @@
 #include <click/task.hh>
 #include <click/timer.hh>
 #include <click/notifier.hh>
+#include "elements/standard/pacer.hh"
 CLICK_DECLS
 
 /*
  * =c
- * TimedUnqueue(INTERVAL [, BURST])
+ * TimedUnqueue(INTERVAL [, BURST, I<keywords> SPIN])
  * =s shaping
  * pull-to-push converter
  * =d
@@ -25,10 +26,15 @@ CLICK_DECLS
  *
  * There is usually a Queue upstream of each TimedUnqueue element.
  *
+ * With SPIN, a time, TimedUnqueue pulls on the thread's Pacer rather than a
+ * Timer: pulls are due exactly INTERVAL apart, and the thread busy-waits for
+ * up to SPIN before each one.  Pacing stops while the upstream queue is
+ * empty and resumes when it fills.
+ *
  * =n
  * The UNIX and Linux timers have granularity of about 10
- * milliseconds, so this TimedUnqueue can only produce high packet
- * rates by being bursty.
+ * milliseconds, so without SPIN this TimedUnqueue can only produce high
+ * packet rates by being bursty.
  *
  * =a RatedUnqueue, Unqueue, Burster
  */
@@ -44,6 +50,7 @@ class TimedUnqueue : public Element { public:
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
 
     bool run_task(Task *task);
 
@@ -55,6 +62,10 @@ class TimedUnqueue : public Element { public:
     unsigned _interval;
     enum { use_signal = 1 };
     NotifierSignal _signal;
+    Timestamp _spin;
+    Pacer::Client _pace;
+
+    static void pace_hook(void *user_data);
 
 };
 
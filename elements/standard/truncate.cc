@@ -53,6 +53,22 @@ Truncate::simple_action(Packet *p)
     return p;
 }
 
+void
+Truncate::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+Truncate::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
+}
+
 void
 Truncate::add_handlers()
 {
@@ -12,6 +12,9 @@ CLICK_DECLS
  * =d
  * Shorten packets to at most LENGTH bytes.
  *
+ * Like Strip, Truncate changes only this packet's view of the data, so
+ * shared packets are truncated without being copied.
+ *
  * The EXTRA_LENGTH keyword argument determines whether packets' extra length
  * annotations are updated to account for any dropped bytes.  Default is true.
  * =a Strip
@@ -29,6 +32,8 @@ class Truncate : public Element { public:
     bool can_live_reconfigure() const		{ return true; }
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
+    void pull_batch(int port, PacketBatch &batch, int max);
 
     void add_handlers();
 
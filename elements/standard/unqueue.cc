@@ -40,10 +40,19 @@ Unqueue::configure(Vector<String> &conf, ErrorHandler *errh)
     _burst = 1;
     _limit = -1;
     _active = true;
-    return Args(conf, this, errh)
-	.read_p("BURST", _burst)
+    _batch = false;
+    _adaptive = false;
+    bool burst_specified;
+    if (Args(conf, this, errh)
+	.read_p("BURST", _burst).read_status(burst_specified)
 	.read("ACTIVE", _active)
-	.read("LIMIT", _limit).complete();
+	.read("LIMIT", _limit)
+	.read("BATCH", _batch)
+	.read("ADAPTIVE", _adaptive).complete() < 0)
+	return -1;
+    if (_adaptive && !burst_specified)
+	_burst = 256;
+    return 0;
 }
 
 int
@@ -56,6 +65,7 @@ Unqueue::initialize(ErrorHandler *errh)
 	_burst = 0x7FFFFFFFU;
     else if (_burst == 0)
 	errh->warning("BURST size 0, no packets will be pulled");
+    _cur_burst = _adaptive && _burst > 0 ? 1 : _burst;
     return 0;
 }
 
@@ -65,29 +75,54 @@ Unqueue::run_task(Task *)
     if (!_active)
 	return false;
 
-    int worked = 0, limit = _burst;
+    int worked = 0, limit = _cur_burst;
     if (_limit >= 0 && _count + limit >= (uint32_t) _limit) {
 	limit = _limit - _count;
 	if (limit <= 0)
 	    return false;
     }
 
-    while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
-	    ++worked;
-	    ++_count;
-	    output(0).push(p);
+    if (_batch) {
+	PacketBatch batch;
+	input(0).pull_batch(batch, limit);
+	if ((worked = batch.count())) {
+	    _count += worked;
+	    output(0).push_batch(batch);
 	} else if (!_signal)
 	    goto out;
-	else
-	    break;
-    }
+    } else
+	while (worked < limit && _active) {
+	    if (Packet *p = input(0).pull()) {
+		++worked;
+		++_count;
+		output(0).push(p);
+	    } else if (!_signal)
+		goto out;
+	    else
+		break;
+	}
 
     _task.fast_reschedule();
   out:
+    if (_adaptive)
+	adapt_burst(worked, limit);
     return worked > 0;
 }
 
+void
+Unqueue::adapt_burst(int worked, int asked)
+{
+    // A pull that comes back full saw a queue at least that deep; one that
+    // comes back mostly empty saw a nearly drained queue.
+    if (worked == asked && asked == _cur_burst) {
+	if (_cur_burst <= _burst / 2)
+	    _cur_burst *= 2;
+	else
+	    _cur_burst = _burst;
+    } else if (_cur_burst > 1 && worked <= (_cur_burst - 1) / 4)
+	_cur_burst /= 2;
+}
+
 #if 0 && defined(CLICK_LINUXMODULE)
 #if __i386__ && HAVE_INTEL_CPU
 /* Old prefetching code from run_task(). */
@@ -121,6 +156,8 @@ Unqueue::write_param(const String &conf, Element *e, void *user_data,
 	    return errh->error("syntax error");
 	if (u->_burst < 0)
 	    u->_burst = 0x7FFFFFFF;
+	if (!u->_adaptive || u->_cur_burst > u->_burst || u->_cur_burst == 0)
+	    u->_cur_burst = u->_burst;
 	break;
     }
     if (u->_active && !u->_task.scheduled()
@@ -135,6 +172,7 @@ Unqueue::add_handlers()
     add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
     add_data_handlers("count", Handler::OP_READ, &_count);
     add_data_handlers("burst", Handler::OP_READ, &_burst);
+    add_data_handlers("current_burst", Handler::OP_READ, &_cur_burst);
     add_data_handlers("limit", Handler::OP_READ, &_limit);
     add_write_handler("active", write_param, h_active);
     add_write_handler("reset", write_param, h_reset, Handler::BUTTON);
@@ -8,7 +8,7 @@ CLICK_DECLS
 /*
 =c
 
-Unqueue([I<keywords> ACTIVE, LIMIT, BURST])
+Unqueue([I<keywords> ACTIVE, LIMIT, BURST, BATCH, ADAPTIVE])
 
 =s shaping
 
@@ -37,6 +37,23 @@ The default value is true.
 If positive, then at most LIMIT packets are pulled.  The default is -1, which
 means there is no limit.
 
+=item BATCH
+
+Boolean.  If true, then pull up to BURST packets as a batch and push them
+downstream as a batch, so that batch-aware elements can process them
+together.  The default is false.
+
+=item ADAPTIVE
+
+Boolean.  If true, then size each pull from the depth of the queue upstream,
+as observed by previous pulls, using BURST as the maximum.  The pull size
+doubles whenever a pull returns as many packets as it asked for, since the
+queue held at least that many, and halves whenever a pull returns fewer than
+a quarter of them.  A lightly loaded Unqueue thus moves packets one at a
+time, for low latency, while a backed-up one moves large bursts, for low
+Task overhead.  If ADAPTIVE is true, BURST defaults to 256.  The default is
+false.
+
 =back
 
 =h count read-only
@@ -60,6 +77,11 @@ Same as the LIMIT keyword.
 
 Same as the BURST keyword.
 
+=h current_burst read-only
+
+Returns the number of packets Unqueue will try to pull when next scheduled.
+Equals BURST unless ADAPTIVE is true.
+
 =a RatedUnqueue, BandwidthRatedUnqueue
 */
 
@@ -81,7 +103,10 @@ class Unqueue : public Element { public:
   private:
 
     bool _active;
+    bool _batch;
+    bool _adaptive;
     int32_t _burst;
+    int32_t _cur_burst;
     int32_t _limit;
     uint32_t _count;
     Task _task;
@@ -91,6 +116,7 @@ class Unqueue : public Element { public:
 	h_active, h_reset, h_burst, h_limit
     };
     static int write_param(const String &, Element *, void *, ErrorHandler *);
+    void adapt_burst(int worked, int asked);
 
 };
 
@@ -40,7 +40,23 @@ Unstrip::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 Unstrip::simple_action(Packet *p)
 {
-  return p->push(_nbytes);
+  return p->nonunique_push(_nbytes);
+}
+
+void
+Unstrip::push_batch(int port, PacketBatch &batch)
+{
+    simple_action_batch(batch);
+    output(port).push_batch(batch);
+}
+
+void
+Unstrip::pull_batch(int port, PacketBatch &batch, int max)
+{
+    PacketBatch b;
+    input(port).pull_batch(b, max);
+    simple_action_batch(b);
+    batch.append(b);
 }
 
 CLICK_ENDDECLS
@@ -11,6 +11,12 @@ CLICK_DECLS
  * =d
  * Put LENGTH bytes at the front of the packet. These LENGTH bytes may be bytes
  * previously removed by Strip.
+ *
+ * Unstrip does not write the bytes it restores, so a packet shared with
+ * other branches, for example by Tee, is not copied; its data pointer just
+ * moves back.  Only a packet with less than LENGTH bytes of headroom is
+ * copied.  Elements downstream that modify the restored header make the
+ * packet writable themselves, which copies it then if it is still shared.
  * =e
  * Use this to get rid of the Ethernet header and put it back on:
  *
@@ -31,8 +37,11 @@ class Unstrip : public Element {
   const char *port_count() const	{ return PORTS_1_1; }
 
   int configure(Vector<String> &, ErrorHandler *);
+  int data_shift() const		{ return -(int) _nbytes; }
 
   Packet *simple_action(Packet *);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, PacketBatch &batch, int max);
 
 };
 
@@ -26,6 +26,8 @@
 #include <click/error.hh>
 #include <click/timer.hh>
 #include <click/router.hh>
+#include <click/packetbatch.hh>
+#include <click/prefetch.hh>
 CLICK_DECLS
 
 IPRewriter::IPRewriter()
@@ -70,7 +72,11 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
     _udp_timeouts[1] *= CLICK_HZ;
     _udp_streaming_timeout *= CLICK_HZ; // IPRewriterBase handles the others
 
-    return TCPRewriter::configure(conf, errh);
+    if (TCPRewriter::configure(conf, errh) < 0)
+	return -1;
+    for (int s = 0; _shards && s < _nshards; ++s)
+	_shards[s].allocator[pool_udp_flows] = new HashAllocator(sizeof(UDPFlow));
+    return 0;
 }
 
 inline IPRewriterEntry *
@@ -80,13 +86,26 @@ IPRewriter::get_entry(int ip_p, const IPFlowID &flowid, int input)
 	return TCPRewriter::get_entry(ip_p, flowid, input);
     if (ip_p != IP_PROTO_UDP)
 	return 0;
-    IPRewriterEntry *m = _udp_map.get(flowid);
+    Shard *sh = 0;
+    Map *map = &_udp_map;
+    Vector<IPRewriterInput> *specs = &_input_specs;
+    int mapid = IPRewriterInput::mapid_iprewriter_udp;
+    if (_shards) {
+	sh = &shard(flowid);
+	sh->lock.acquire();
+	map = &sh->map[1];
+	specs = &sh->input_specs;
+	mapid = shard_mapid(*sh, 1);
+    }
+    IPRewriterEntry *m = map->get(flowid);
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
-	IPRewriterInput &is = _input_specs[input];
+	IPRewriterInput &is = (*specs)[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
-	if (is.rewrite_flowid(flowid, rewritten_flowid, 0, IPRewriterInput::mapid_iprewriter_udp) == rw_addmap)
+	if (is.rewrite_flowid(flowid, rewritten_flowid, 0, mapid) == rw_addmap)
 	    m = IPRewriter::add_flow(0, flowid, rewritten_flowid, input);
     }
+    if (sh)
+	sh->lock.release();
     return m;
 }
 
@@ -97,16 +116,37 @@ IPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
     if (ip_p == IP_PROTO_TCP)
 	return TCPRewriter::add_flow(ip_p, flowid, rewritten_flowid, input);
 
+    Shard *sh = (_shards ? &shard(flowid) : 0);
     void *data;
-    if (!(data = _udp_allocator.allocate()))
+    if (!(data = (sh ? sh->allocator[1]->allocate() : _udp_allocator.allocate())))
 	return 0;
 
-    IPRewriterInput *rwinput = &_input_specs[input];
+    IPRewriterInput *rwinput = (sh ? &sh->input_specs[input] : &_input_specs[input]);
     IPRewriterFlow *flow = new(data) IPRewriterFlow
 	(rwinput, flowid, rewritten_flowid, ip_p,
 	 !!_udp_timeouts[1], click_jiffies() + relevant_timeout(_udp_timeouts));
 
-    return store_flow(flow, input, _udp_map, &reply_udp_map(rwinput));
+    if (sh)
+	return store_flow(flow, sh->map[1], &sh->map[1]);
+    else
+	return store_flow(flow, _udp_map, &reply_udp_map(rwinput));
+}
+
+// Prefetch the map bucket push() will search for p's flow.
+inline void
+IPRewriter::prefetch_flow(const Packet *p) const
+{
+    const click_ip *iph = p->ip_header();
+    if ((iph->ip_p != IP_PROTO_TCP && iph->ip_p != IP_PROTO_UDP)
+	|| !IP_FIRSTFRAG(iph)
+	|| p->transport_length() < 8)
+	return;
+    IPFlowID flowid(p);
+    int udp = iph->ip_p != IP_PROTO_TCP;
+    if (_shards)
+	_shards[flow_shard(flowid, _nshards)].map[udp].prefetch(flowid);
+    else
+	(udp ? _udp_map : _map).prefetch(flowid);
 }
 
 void
@@ -129,15 +169,34 @@ IPRewriter::push(int port, Packet *p_in)
 
     IPFlowID flowid(p);
     HashContainer<IPRewriterEntry> *map = (iph->ip_p == IP_PROTO_TCP ? &_map : &_udp_map);
+    IPRewriterHeap *heap = _heap;
+    Vector<IPRewriterInput> *specs = &_input_specs;
+    int mapid = (iph->ip_p == IP_PROTO_TCP ? 0 : IPRewriterInput::mapid_iprewriter_udp);
+    Shard *sh = 0;
+    if (_shards) {
+	sh = &shard(flowid);
+	sh->lock.acquire();
+	map = &sh->map[iph->ip_p != IP_PROTO_TCP];
+	heap = sh->heap;
+	specs = &sh->input_specs;
+	mapid = shard_mapid(*sh, iph->ip_p != IP_PROTO_TCP);
+    }
     IPRewriterEntry *m = map->get(flowid);
 
     if (!m) {			// create new mapping
-	IPRewriterInput &is = _input_specs.unchecked_at(port);
+	IPRewriterInput &is = specs->unchecked_at(port);
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
-	int result = is.rewrite_flowid(flowid, rewritten_flowid, p, iph->ip_p == IP_PROTO_TCP ? 0 : IPRewriterInput::mapid_iprewriter_udp);
-	if (result == rw_addmap)
+	int result = is.rewrite_flowid(flowid, rewritten_flowid, p, mapid);
+	if (result != rw_addmap)
+	    /* nada */;
+	else if (iph->ip_p == IP_PROTO_TCP)
+	    m = add_tcp_flow(flowid, rewritten_flowid, port,
+			     _half_open && half_open_syn(p));
+	else
 	    m = IPRewriter::add_flow(iph->ip_p, flowid, rewritten_flowid, port);
 	if (!m) {
+	    if (sh)
+		sh->lock.release();
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -149,20 +208,35 @@ IPRewriter::push(int port, Packet *p_in)
     if (iph->ip_p == IP_PROTO_TCP) {
 	TCPFlow *tcpmf = static_cast<TCPFlow *>(mf);
 	tcpmf->apply(p, m->direction(), _annos);
-	if (_timeouts[1])
-	    tcpmf->change_expiry(_heap, true, now_j + _timeouts[1]);
-	else
-	    tcpmf->change_expiry(_heap, false, now_j + tcp_flow_timeout(tcpmf));
+	refresh_flow(tcpmf, p, m->direction(), heap, now_j);
     } else {
 	UDPFlow *udpmf = static_cast<UDPFlow *>(mf);
 	udpmf->apply(p, m->direction(), _annos);
 	if (_udp_timeouts[1])
-	    udpmf->change_expiry(_heap, true, now_j + _udp_timeouts[1]);
+	    udpmf->change_expiry(heap, true, now_j + _udp_timeouts[1]);
 	else
-	    udpmf->change_expiry(_heap, false, now_j + udp_flow_timeout(udpmf));
+	    udpmf->change_expiry(heap, false, now_j + udp_flow_timeout(udpmf));
     }
 
-    output(m->output()).push(p);
+    int out = m->output();
+    if (sh)
+	sh->lock.release();
+    output(out).push(p);
+}
+
+void
+IPRewriter::push_batch(int port, PacketBatch &batch)
+{
+    Packet *p[BATCH_LANES];
+    FlowStages stages = { this, port, p };
+    while (!batch.empty()) {
+	int n = 0;
+	for (; n < BATCH_LANES && !batch.empty(); ++n) {
+	    p[n] = batch.pop_front();
+	    click_prefetch(p[n]->network_header());
+	}
+	click_prefetch_pipeline(stages, n);
+    }
 }
 
 String
@@ -171,9 +245,16 @@ IPRewriter::udp_mappings_handler(Element *e, void *)
     IPRewriter *rw = (IPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_udp_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < (rw->_shards ? rw->_nshards : 1); ++s) {
+	Map &map = (rw->_shards ? rw->_shards[s].map[1] : rw->_udp_map);
+	if (rw->_shards)
+	    rw->_shards[s].lock.acquire();
+	for (Map::iterator iter = map.begin(); iter.live(); ++iter) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	if (rw->_shards)
+	    rw->_shards[s].lock.release();
     }
     return sa.take_string();
 }
@@ -183,6 +264,10 @@ IPRewriter::add_handlers()
 {
     add_read_handler("tcp_mappings", tcp_mappings_handler);
     add_read_handler("udp_mappings", udp_mappings_handler);
+    if (_half_open) {
+	add_read_handler("half_open", half_open_handler, 0);
+	add_read_handler("half_open_evictions", half_open_handler, 1);
+    }
     add_rewriter_handlers(true);
 }
 
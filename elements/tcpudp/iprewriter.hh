@@ -139,6 +139,16 @@ Preserve each TCP connection mapping for at least I<time> seconds after each
 successfully processed packet. Defaults to 5 seconds. Incoming flows are
 dropped if an IPRewriter's mapping table is full of guaranteed flows.
 
+=item HALF_OPEN_CAPACITY I<n>
+
+Integer. If positive, admit TCP flows in stages, to protect established
+flows from SYN floods; see TCPRewriter. Default is 0.
+
+=item HALF_OPEN_TIMEOUT I<time>
+
+Time out half-open TCP flows after I<time> seconds without a packet. Default
+is 5 seconds.
+
 =item UDP_TIMEOUT I<time>
 
 Time out UDP connections every I<time> seconds. Default is 5 minutes.
@@ -164,13 +174,49 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item TIMING_WHEEL
+
+Boolean. If true, keep mappings in hashed timing wheels, with slots of about
+1/8 second, rather than in heaps ordered by expiration time. Refreshing a
+mapping on each packet then takes constant time, and expired mappings are
+reaped in batches. When the rewriter is full, it evicts one of the mappings
+expiring soonest, to within a slot. Rewriters that share a MAPPING_CAPACITY
+must agree on TIMING_WHEEL. Default is false.
+
+=item HASH
+
+Hash function for the mapping tables: C<default>, C<crc32c>, or C<seeded>,
+optionally followed by C<symmetric>. The default function clusters when many
+flows differ only in nearby ports, as behind a NAT; C<crc32c> spreads them
+well and is fast, using the SSE4.2 crc32 instruction when available; C<seeded>
+is SipHash with a random key, so that remote hosts cannot choose colliding
+flows. C<symmetric> makes a flow and its reverse hash alike. Default is
+C<default>.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
 packets to the rewritten destination address. Default is true.
 
+=item SHARDS I<n>
+
+Integer. Split the mapping table into I<n> shards, each with its own flow
+table, expiration heap, and lock, so that several threads can run one
+rewriter with little contention. Typically I<n> is the number of threads
+that push packets into the rewriter. A flow and its reply are always kept in
+the same shard: the shard is chosen by a symmetric hash of the flow ID, and
+patterns pick only source ports (or addresses) whose reply flow hashes to
+that shard. Patterns that leave no choice of port or address may therefore
+fail to map some flows. With SHARDS, MAPPING_CAPACITY must be an integer,
+and is divided evenly among the shards; and every input's reply element must
+be this rewriter. Default is 1, meaning one unsharded table.
+
 =back
 
+IPRewriter handles a batch of packets in a prefetch pipeline: it prefetches
+every packet's IP header, then each packet's flow table bucket a few packets
+ahead of its rewrite, so that cache misses on the table overlap.
+
 =h nmappings r
 
 Returns the number of mappings in this IPRewriter's mapping table.
@@ -204,6 +250,69 @@ relevant output port is starred.
 Returns a human-readable description of the IPRewriter's current set of
 UDP mappings.
 
+=h shards read-only
+
+Only present if SHARDS is greater than 1. Returns one line per shard, giving
+the shard number and the number of flows in that shard. The 'nmappings',
+'mapping_failures', and 'size' handlers report totals over all shards.
+
+=h hash_stats read-only
+
+Returns mapping table statistics: the number of entries, buckets, and nonempty
+buckets, the longest chain, and the mean number of entries compared to find
+an entry. Useful for choosing HASH.
+
+=h pools read-only
+
+Returns one line per object pool: its name, the number of objects in use,
+the number of free objects, and the bytes the pool holds. Pools are
+C<flows>, for flows, C<udp_flows>, for IPRewriter's UDP flows, and C<deltas>,
+for TCP sequence number delta transitions. Each shard has its own pools; the
+counts are totals. Pools never return memory, so free objects are the
+difference between the peak and current load.
+
+=h memory_limit read/write
+
+Returns or sets a soft limit, in bytes, on the C<memory> handler's value; 0,
+the default, means no limit. The C<memory> handler counts the rewriter's
+tables and its live flows, not free pool objects. Once it exceeds the limit,
+each new flow evicts the flow nearest expiry, as if the table were at
+CAPACITY, so the flow count stops growing; flows that expire or are cleared
+bring the rewriter back under the limit. Lowering the limit does not shrink
+the table at once. Every rewriter element has this handler.
+
+=h half_open read-only
+
+Only present if HALF_OPEN_CAPACITY is positive. Returns the number of
+half-open TCP flows.
+
+=h half_open_evictions read-only
+
+Only present if HALF_OPEN_CAPACITY is positive. Returns the number of
+half-open TCP flows evicted for newer ones.
+
+=h checkpoint write-only
+
+User-level only. Takes a filename, and writes every flow this element owns
+to that file: its flow IDs, input, remaining lifetime, and, for TCP, its
+sequence number deltas. The file is written under a temporary name, in
+chunks, and renamed into place when complete. See 'restore'.
+
+=h restore write-only
+
+User-level only. Takes a filename written by 'checkpoint', and installs its
+flows, so a standby router can take over established connections. Flows
+that are already mapped, and flows for inputs that no longer exist, are
+skipped. So are flows whose two directions fall in different shards, so a
+sharded rewriter can take every flow only from a rewriter with as many
+shards.
+
+=h checkpoint_data read/write
+
+Reading returns a checkpoint, as written by 'checkpoint'; writing installs
+one, like 'restore'. A standby can poll one router's checkpoint_data
+through a ControlSocket and write it to its own.
+
 =a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter */
 
@@ -226,7 +335,7 @@ class IPRewriter : public TCPRewriter { public:
 	else if (mapid == IPRewriterInput::mapid_iprewriter_udp)
 	    return &_udp_map;
 	else
-	    return 0;
+	    return IPRewriterBase::get_map(mapid);
     }
     IPRewriterEntry *add_flow(int ip_p, const IPFlowID &flowid,
 			      const IPFlowID &rewritten_flowid, int input);
@@ -239,6 +348,7 @@ class IPRewriter : public TCPRewriter { public:
     }
 
     void push(int, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
     void add_handlers();
 
@@ -249,6 +359,29 @@ class IPRewriter : public TCPRewriter { public:
     uint32_t _udp_timeouts[2];
     uint32_t _udp_streaming_timeout;
 
+    int flow_map_index(int ip_p) const {
+	return ip_p == IP_PROTO_UDP;
+    }
+
+    enum { BATCH_LANES = 16 };
+    struct FlowStages {
+	IPRewriter *rw;
+	int port;
+	Packet **p;
+	void prefetch(int i) {
+	    rw->prefetch_flow(p[i]);
+	}
+	void execute(int i) {
+	    rw->IPRewriter::push(port, p[i]);
+	}
+    };
+    inline void prefetch_flow(const Packet *p) const;
+    HashAllocator *pool_allocator(int pool) {
+	if (pool == pool_udp_flows)
+	    return &_udp_allocator;
+	else
+	    return TCPRewriter::pool_allocator(pool);
+    }
     int udp_flow_timeout(const UDPFlow *mf) const {
 	if (mf->streaming())
 	    return _udp_streaming_timeout;
@@ -270,7 +403,12 @@ IPRewriter::destroy_flow(IPRewriterFlow *flow)
 {
     if (flow->ip_p() == IP_PROTO_TCP)
 	TCPRewriter::destroy_flow(flow);
-    else {
+    else if (_shards) {
+	Shard &sh = shard(flow->entry(false).flowid());
+	unmap_flow(flow, sh.map[1], &sh.map[1]);
+	flow->~IPRewriterFlow();
+	sh.allocator[1]->deallocate(flow);
+    } else {
 	unmap_flow(flow, _udp_map, &reply_udp_map(flow->owner()));
 	flow->~IPRewriterFlow();
 	_udp_allocator.deallocate(flow);
@@ -81,8 +81,12 @@ TCPFragmenter::push(int, Packet *p)
         click_tcp *tcp = q->tcp_header();
         uint8_t *tcp_data = ((uint8_t *)tcp) + (tcp->th_off<<2);
         int this_len = tcp_len - offset > _mtu ? _mtu : tcp_len - offset;
-        if (offset != 0)
-            memcpy(tcp_data, tcp_data + offset, this_len);
+        uint16_t data_csum = 0;
+        if (offset != 0) {
+            // the ranges overlap, which click_in_cksum_copy does not allow
+            memmove(tcp_data, tcp_data + offset, this_len);
+            data_csum = click_in_cksum(tcp_data, this_len);
+        }
         q->take(tcp_len - this_len);
         ip->ip_len = htons(q->end_data() - q->network_header());
         ip->ip_sum = 0;
@@ -96,8 +100,13 @@ TCPFragmenter::push(int, Packet *p)
         tcp->th_sum = 0;
 
         // now calculate tcp header cksum
+        // (payloads after the first were checksummed after they were moved)
         int plen = q->end_data() - (uint8_t*)tcp;
-        unsigned csum = click_in_cksum((unsigned char *)tcp, plen);
+        unsigned csum;
+        if (offset != 0)
+            csum = click_in_cksum_combine(click_in_cksum((unsigned char *)tcp, tcp_data - (uint8_t *)tcp), data_csum);
+        else
+            csum = click_in_cksum((unsigned char *)tcp, plen);
         tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, plen);
         output(0).push(q);
     }
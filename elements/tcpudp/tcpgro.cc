@@ -0,0 +1,204 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tcpgro.{cc,hh} -- coalesces in-order TCP segments within a batch
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tcpgro.hh"
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packetbatch.hh>
+CLICK_DECLS
+
+TCPGRO::TCPGRO()
+    : _max_length(65535)
+{
+    _coalesced = 0;
+    _aggregates = 0;
+}
+
+TCPGRO::~TCPGRO()
+{
+}
+
+int
+TCPGRO::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    unsigned max_length = 65535;
+    if (Args(conf, this, errh)
+	.read("MAXLENGTH", max_length)
+	.complete() < 0)
+	return -1;
+    if (max_length < 68 || max_length > 65535)
+	return errh->error("MAXLENGTH must be between 68 and 65535");
+    _max_length = max_length;
+    return 0;
+}
+
+// Return the TCP payload length of p if it may be coalesced, 0 if it is a
+// TCP segment that may not, and -1 if it is not TCP.
+static int
+segment_info(const Packet *p, IPFlowID &flow, uint32_t &seq)
+{
+    if (!p->has_network_header() || p->network_length() < (int) sizeof(click_ip))
+	return -1;
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_v != 4 || iph->ip_p != IP_PROTO_TCP || !IP_FIRSTFRAG(iph)
+	|| p->transport_length() < (int) sizeof(click_tcp))
+	return -1;
+    const click_tcp *tcph = p->tcp_header();
+    flow = IPFlowID(p);
+    seq = ntohl(tcph->th_seq);
+    int hlen = (iph->ip_hl << 2) + (tcph->th_off << 2);
+    int len = ntohs(iph->ip_len) - hlen;
+    if (iph->ip_hl != 5 || IP_ISFRAG(iph) || ntohs(iph->ip_len) != p->network_length()
+	|| tcph->th_off < 5 || len <= 0
+	|| (tcph->th_flags & ~(TH_ACK | TH_PUSH)) || !(tcph->th_flags & TH_ACK))
+	return 0;
+    return len;
+}
+
+bool
+TCPGRO::merge(Agg &a, Packet *p, uint32_t seq, int payload_len)
+{
+    const click_ip *aip = a.p->ip_header(), *pip = p->ip_header();
+    const click_tcp *atcp = a.p->tcp_header(), *ptcp = p->tcp_header();
+    int thlen = atcp->th_off << 2;
+    if (!a.open || seq != a.next_seq
+	|| (a.payload_len & 1)
+	|| ntohs(aip->ip_len) + (unsigned) payload_len > _max_length
+	|| aip->ip_tos != pip->ip_tos || aip->ip_ttl != pip->ip_ttl
+	|| ((aip->ip_off ^ pip->ip_off) & htons(IP_DF))
+	|| atcp->th_off != ptcp->th_off
+	|| atcp->th_ack != ptcp->th_ack || atcp->th_win != ptcp->th_win
+	|| memcmp(atcp + 1, ptcp + 1, thlen - sizeof(click_tcp)) != 0)
+	return false;
+
+    const unsigned char *payload = p->transport_header() + thlen;
+    if (a.nsegs == 1) {
+	// Move the first segment into a buffer with room for the aggregate,
+	// so the rest are appended without reallocating.
+	Packet *first = a.p;
+	WritablePacket *q = Packet::make(first->headroom(), first->data(), first->length(),
+					 _max_length - first->network_length());
+	if (!q)
+	    return false;
+	q->set_network_header(q->data() + first->network_header_offset(),
+			      first->network_header_length());
+	if (first->mac_header())
+	    q->set_mac_header(q->data() + first->mac_header_offset());
+	q->copy_annotations(first);
+	first->kill();
+	a.p = q;
+	a.payload_sum = click_in_cksum(q->transport_header() + thlen, a.payload_len);
+    }
+
+    WritablePacket *q = a.p->put(payload_len);
+    if (!q)
+	return false;
+    a.p = q;
+    uint16_t sum = click_in_cksum_copy(q->end_data() - payload_len, payload, payload_len);
+    a.payload_sum = click_in_cksum_combine(a.payload_sum, sum);
+    a.payload_len += payload_len;
+    a.next_seq += payload_len;
+    ++a.nsegs;
+    if (ptcp->th_flags & TH_PUSH) {
+	q->tcp_header()->th_flags |= TH_PUSH;
+	a.open = false;
+    }
+    p->kill();
+    _coalesced++;
+    return true;
+}
+
+void
+TCPGRO::flush(Agg *aggs, int n, PacketBatch &out)
+{
+    for (Agg *a = aggs; a != aggs + n; ++a) {
+	if (a->nsegs > 1) {
+	    // merge() made a->p writable
+	    WritablePacket *q = static_cast<WritablePacket *>(a->p);
+	    click_ip *iph = q->ip_header();
+	    click_tcp *tcph = q->tcp_header();
+	    int thlen = tcph->th_off << 2;
+	    iph->ip_len = htons(q->network_length());
+	    iph->ip_sum = 0;
+	    iph->ip_sum = click_in_cksum((const unsigned char *) iph, sizeof(click_ip));
+	    tcph->th_sum = 0;
+	    uint16_t sum = click_in_cksum((const unsigned char *) tcph, thlen);
+	    tcph->th_sum = click_in_cksum_pseudohdr(click_in_cksum_combine(sum, a->payload_sum),
+						    iph, thlen + a->payload_len);
+	    _aggregates++;
+	}
+	out.push_back(a->p);
+    }
+}
+
+void
+TCPGRO::push(int, Packet *p)
+{
+    output(0).push(p);
+}
+
+void
+TCPGRO::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    Agg aggs[max_open];
+    int n = 0;
+
+    while (Packet *p = batch.pop_front()) {
+	IPFlowID flow;
+	uint32_t seq = 0;
+	int len = segment_info(p, flow, seq);
+	int i = n - 1;
+	if (len >= 0)
+	    while (i >= 0 && !(aggs[i].flow == flow && aggs[i].p))
+		--i;
+	if (len > 0 && i >= 0 && merge(aggs[i], p, seq, len))
+	    continue;
+	// a later packet of this flow must not join an earlier aggregate
+	if (len >= 0 && i >= 0)
+	    aggs[i].open = false;
+
+	if (n == max_open) {
+	    flush(aggs, n, out);
+	    n = 0;
+	}
+	Agg &a = aggs[n++];
+	a.p = p;
+	a.flow = (len >= 0 ? flow : IPFlowID());
+	a.next_seq = seq + (len > 0 ? len : 0);
+	a.payload_sum = 0;
+	a.payload_len = (len > 0 ? len : 0);
+	a.nsegs = 1;
+	a.open = len > 0 && !(p->tcp_header()->th_flags & TH_PUSH);
+    }
+
+    flush(aggs, n, out);
+    if (!out.empty())
+	output(0).push_batch(out);
+}
+
+void
+TCPGRO::add_handlers()
+{
+    add_data_handlers("coalesced", Handler::OP_READ, &_coalesced);
+    add_data_handlers("aggregates", Handler::OP_READ, &_aggregates);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TCPGRO)
+ELEMENT_MT_SAFE(TCPGRO)
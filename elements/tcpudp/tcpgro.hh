@@ -0,0 +1,105 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TCPGRO_HH
+#define CLICK_TCPGRO_HH
+#include <click/element.hh>
+#include <click/ipflowid.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TCPGRO([I<keywords> MAXLENGTH])
+
+=s tcp
+
+coalesces in-order TCP segments within a batch
+
+=d
+
+TCPGRO merges consecutive segments of the same TCP connection that arrive in
+one batch into a single large packet, so that elements downstream do their
+per-packet work once per aggregate.  Use TCPGSO to split aggregates back into
+segments before they leave the router.
+
+Expects IP packets with network headers set.  A segment joins the previous
+packet of its flow in the batch when both are IPv4 without options or
+fragmentation, the segment's sequence number follows directly, the segments
+carry data, only ACK and PSH flags are set, and the IP TOS, TTL and DF bit and
+the TCP acknowledgement, window and options are the same.  A PSH flag ends an
+aggregate.  Segments of one flow are never reordered; packets of different
+flows may be, since each aggregate leaves at the position of its first
+segment.  The merged packet keeps the first segment's link header and
+annotations, and gets new IP and TCP checksums.
+
+TCPGRO trusts the segments' TCP checksums; use CheckTCPHeader first if they
+may be wrong.  Packets pushed one at a time pass through unchanged.
+
+Keyword arguments are:
+
+=over 8
+
+=item MAXLENGTH
+
+Unsigned integer.  The largest IP length of an aggregate, at most 65535.
+Default is 65535.
+
+=back
+
+=h coalesced read-only
+
+Returns the number of segments merged into an earlier packet.
+
+=h aggregates read-only
+
+Returns the number of packets built from more than one segment.
+
+=e
+
+  FromDevice(eth0, BURST 32) -> Strip(14) -> CheckIPHeader
+    -> TCPGRO -> ... -> TCPGSO(1448) -> ...
+
+=a TCPGSO, TCPFragmenter, CheckTCPHeader
+*/
+
+class TCPGRO : public Element { public:
+
+    TCPGRO();
+    ~TCPGRO();
+
+    const char *class_name() const	{ return "TCPGRO"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+    bool can_live_reconfigure() const	{ return true; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+  private:
+
+    struct Agg {
+	Packet *p;
+	IPFlowID flow;
+	uint32_t next_seq;
+	uint16_t payload_sum;
+	uint16_t payload_len;
+	int nsegs;
+	bool open;
+    };
+
+    enum { max_open = 64 };
+
+    unsigned _max_length;
+    atomic_uint32_t _coalesced;
+    atomic_uint32_t _aggregates;
+
+    bool merge(Agg &a, Packet *p, uint32_t seq, int payload_len);
+    void flush(Agg *aggs, int n, PacketBatch &out);
+
+};
+
+CLICK_ENDDECLS
+#endif
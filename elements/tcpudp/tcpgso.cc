@@ -0,0 +1,174 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tcpgso.{cc,hh} -- splits large TCP packets into segments
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tcpgso.hh"
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packetbatch.hh>
+CLICK_DECLS
+
+TCPGSO::TCPGSO()
+    : _mss(0)
+{
+    _segments = 0;
+}
+
+TCPGSO::~TCPGSO()
+{
+}
+
+int
+TCPGSO::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    unsigned mss;
+    if (Args(conf, this, errh)
+	.read_mp("MSS", mss)
+	.complete() < 0)
+	return -1;
+    if (mss < 8 || mss > 65535)
+	return errh->error("MSS must be between 8 and 65535");
+    _mss = mss;
+    return 0;
+}
+
+// Fix the headers of segment k of nseg, which was copied from the original
+// packet's headers and carries len bytes starting at payload offset offset.
+void
+TCPGSO::finish(WritablePacket *q, int k, int nseg, uint32_t offset,
+	       int len, uint16_t payload_sum)
+{
+    click_ip *iph = q->ip_header();
+    click_tcp *tcph = q->tcp_header();
+    int thlen = tcph->th_off << 2;
+
+    iph->ip_len = htons((iph->ip_hl << 2) + thlen + len);
+    iph->ip_id = htons(ntohs(iph->ip_id) + k);
+    iph->ip_sum = 0;
+    iph->ip_sum = click_in_cksum((const unsigned char *) iph, iph->ip_hl << 2);
+
+    tcph->th_seq = htonl(ntohl(tcph->th_seq) + offset);
+    if (k != 0)
+	tcph->th_flags &= ~TH_CWR;
+    if (k != nseg - 1)
+	tcph->th_flags &= ~(TH_FIN | TH_PUSH);
+    tcph->th_sum = 0;
+    uint16_t sum = click_in_cksum((const unsigned char *) tcph, thlen);
+    tcph->th_sum = click_in_cksum_pseudohdr(click_in_cksum_combine(sum, payload_sum),
+					    iph, thlen + len);
+}
+
+void
+TCPGSO::segment(Packet *p, PacketBatch &out)
+{
+    if (!p->has_network_header() || p->network_length() < (int) sizeof(click_ip)) {
+	out.push_back(p);
+	return;
+    }
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_v != 4 || iph->ip_p != IP_PROTO_TCP || IP_ISFRAG(iph)
+	|| p->transport_length() < (int) sizeof(click_tcp)) {
+	out.push_back(p);
+	return;
+    }
+    const click_tcp *tcph = p->tcp_header();
+    int thlen = tcph->th_off << 2;
+    int payload_len = ntohs(iph->ip_len) - (iph->ip_hl << 2) - thlen;
+    if (payload_len <= (int) _mss || thlen < (int) sizeof(click_tcp)
+	|| ntohs(iph->ip_len) > p->network_length()) {
+	out.push_back(p);
+	return;
+    }
+
+    // Copy out the later segments while the headers are intact.
+    int hdr_len = p->transport_header_offset() + thlen;
+    int nseg = (payload_len + _mss - 1) / _mss;
+    const unsigned char *payload = p->data() + hdr_len;
+    PacketBatch rest;
+    for (int k = 1; k < nseg; ++k) {
+	uint32_t offset = k * _mss;
+	int len = (k == nseg - 1 ? payload_len - offset : _mss);
+	WritablePacket *q = Packet::make(p->headroom(), 0, hdr_len + len, 0);
+	if (!q)
+	    continue;
+	memcpy(q->data(), p->data(), hdr_len);
+	uint16_t sum = click_in_cksum_copy(q->data() + hdr_len, payload + offset, len);
+	q->set_network_header(q->data() + p->network_header_offset(),
+			      p->network_header_length());
+	if (p->mac_header())
+	    q->set_mac_header(q->data() + p->mac_header_offset());
+	q->copy_annotations(p);
+	finish(q, k, nseg, offset, len, sum);
+	rest.push_back(q);
+    }
+
+    // The first segment is the packet itself, truncated, unless its buffer
+    // is shared; then copying one segment beats copying the whole packet.
+    WritablePacket *q;
+    if (!p->shared()) {
+	q = p->uniqueify();
+	q->take(q->length() - hdr_len - _mss);
+    } else {
+	q = Packet::make(p->headroom(), p->data(), hdr_len + _mss, 0);
+	if (q) {
+	    q->set_network_header(q->data() + p->network_header_offset(),
+				  p->network_header_length());
+	    if (p->mac_header())
+		q->set_mac_header(q->data() + p->mac_header_offset());
+	    q->copy_annotations(p);
+	}
+	p->kill();
+    }
+    if (q) {
+	finish(q, 0, nseg, 0, _mss, click_in_cksum(q->data() + hdr_len, _mss));
+	out.push_back(q);
+    }
+
+    _segments += rest.count() + (q ? 1 : 0);
+    out.append(rest);
+}
+
+void
+TCPGSO::push(int, Packet *p)
+{
+    PacketBatch out;
+    segment(p, out);
+    if (out.count() == 1)
+	output(0).push(out.pop_front());
+    else if (!out.empty())
+	output(0).push_batch(out);
+}
+
+void
+TCPGSO::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	segment(p, out);
+    if (!out.empty())
+	output(0).push_batch(out);
+}
+
+void
+TCPGSO::add_handlers()
+{
+    add_data_handlers("segments", Handler::OP_READ, &_segments);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TCPGSO)
+ELEMENT_MT_SAFE(TCPGSO)
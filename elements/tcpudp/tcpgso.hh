@@ -0,0 +1,69 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TCPGSO_HH
+#define CLICK_TCPGSO_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TCPGSO(MSS)
+
+=s tcp
+
+splits large TCP packets into segments
+
+=d
+
+TCPGSO splits each IPv4 TCP packet with more than MSS bytes of payload into
+segments of at most MSS bytes, as a sender's segmentation offload would.
+Each segment copies the packet's link, IP and TCP headers and annotations,
+with the IP length and checksum, IP ID, TCP sequence number and TCP checksum
+updated.  IP IDs increase by one per segment.  FIN and PSH are kept only on
+the last segment and CWR only on the first.  TCP checksums are computed as the
+payload is copied.
+
+The first segment reuses the packet's buffer unless the buffer is shared.
+A packet's segments leave together as one batch.  Other packets, including
+IP fragments, pass through unchanged.
+
+Unlike TCPFragmenter, which clones and copies the whole packet for every
+piece, TCPGSO copies each payload byte at most once.
+
+=h segments read-only
+
+Returns the number of segments produced.
+
+=a TCPGRO, TCPFragmenter, IPFragmenter
+*/
+
+class TCPGSO : public Element { public:
+
+    TCPGSO();
+    ~TCPGSO();
+
+    const char *class_name() const	{ return "TCPGSO"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+    bool can_live_reconfigure() const	{ return true; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+
+  private:
+
+    unsigned _mss;
+    atomic_uint32_t _segments;
+
+    void segment(Packet *p, PacketBatch &out);
+    void finish(WritablePacket *q, int k, int nseg, uint32_t offset,
+		int len, uint16_t payload_sum);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -43,7 +43,7 @@ TCPRewriter::TCPFlow::update_seqno_delta(bool direction,
     if (!_dt || (_dt->nextptr & (1 << direction)
 		 ? trigger != _dt->trigger[direction]
 		 : _dt->delta[direction])) {
-	delta_transition *ndt = new delta_transition;
+	delta_transition *ndt = new_delta();
 	if (!ndt)
 	    return -1;
 	ndt->nextptr = reinterpret_cast<uintptr_t>(_dt);
@@ -76,7 +76,7 @@ TCPRewriter::TCPFlow::update_seqno_delta(bool direction,
 	if (!(ndt->nextptr & 3))
 	    while (delta_transition *x = ndt->next()) {
 		ndt->nextptr = x->nextptr - (x->nextptr & 3);
-		delete x;
+		free_delta(x);
 	    }
     }
 
@@ -197,7 +197,7 @@ TCPRewriter::TCPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 	if (!(_dt->nextptr & 3))
 	    while (delta_transition *ndt = _dt->next()) {
 		_dt->nextptr = ndt->nextptr - (ndt->nextptr & 3);
-		delete ndt;
+		free_delta(ndt);
 	    }
     }
 
@@ -231,15 +231,67 @@ TCPRewriter::TCPFlow::unparse(StringAccum &sa, bool direction, click_jiffies_t n
     unparse_ports(sa, direction, now);
 }
 
+void
+TCPRewriter::TCPFlow::save_deltas(StringAccum &sa) const
+{
+    // A count, then each transition, newest first: both deltas, both
+    // triggers, and the has_trigger bits.
+    uint16_t n = 0;
+    for (delta_transition *x = _dt; x; x = x->next())
+	++n;
+    n = htons(n);
+    sa.append(reinterpret_cast<const char *>(&n), 2);
+    for (delta_transition *x = _dt; x; x = x->next()) {
+	uint32_t w[4] = { htonl(x->delta[0]), htonl(x->delta[1]),
+			  htonl(x->trigger[0]), htonl(x->trigger[1]) };
+	sa.append(reinterpret_cast<const char *>(w), 16);
+	sa << (char) (x->nextptr & 3);
+    }
+}
+
+bool
+TCPRewriter::TCPFlow::restore_deltas(const unsigned char *data, int len)
+{
+    uint16_t n;
+    if (len < 2)
+	return false;
+    memcpy(&n, data, 2);
+    n = ntohs(n);
+    if (len < 2 + 17 * n)
+	return false;
+    data += 2;
+    delta_transition *last = 0;
+    for (; n; --n, data += 17) {
+	delta_transition *x = new_delta();
+	if (!x)
+	    return false;
+	uint32_t w[4];
+	memcpy(w, data, 16);
+	x->delta[0] = ntohl(w[0]);
+	x->delta[1] = ntohl(w[1]);
+	x->trigger[0] = ntohl(w[2]);
+	x->trigger[1] = ntohl(w[3]);
+	x->nextptr = data[16] & 3;
+	if (last)
+	    last->nextptr |= reinterpret_cast<uintptr_t>(x);
+	else
+	    _dt = x;
+	last = x;
+    }
+    return true;
+}
+
 
 // TCPRewriter
 
 TCPRewriter::TCPRewriter()
+    : _half_open(0), _half_open_capacity(0)
 {
 }
 
 TCPRewriter::~TCPRewriter()
 {
+    delete[] _half_open;
 }
 
 void *
@@ -260,6 +312,7 @@ TCPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
     _timeouts[0] = 300;		// nodata: 5 minutes (should be > TCP_DONE)
     _tcp_data_timeout = 86400;	// 24 hours
     _tcp_done_timeout = 240;	// 4 minutes
+    _half_open_timeout = 5;
     bool dst_anno = true, has_reply_anno = false;
     int reply_anno;
 
@@ -269,31 +322,98 @@ TCPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("TIMEOUT", SecondsArg(), _tcp_data_timeout)
 	.read("TCP_TIMEOUT", SecondsArg(), _tcp_data_timeout)
 	.read("TCP_DONE_TIMEOUT", SecondsArg(), _tcp_done_timeout)
+	.read("HALF_OPEN_CAPACITY", _half_open_capacity)
+	.read("HALF_OPEN_TIMEOUT", SecondsArg(), _half_open_timeout)
 	.read("DST_ANNO", dst_anno)
 	.read("REPLY_ANNO", AnnoArg(1), reply_anno).read_status(has_reply_anno)
+	.read("SHARDS", _nshards)
 	.consume() < 0)
 	return -1;
 
     _annos = (dst_anno ? 1 : 0) + (has_reply_anno ? 2 + (reply_anno << 2) : 0);
     _tcp_data_timeout *= CLICK_HZ; // IPRewriterBase handles the others
     _tcp_done_timeout *= CLICK_HZ;
+    _half_open_timeout *= CLICK_HZ;
 
-    return IPRewriterBase::configure(conf, errh);
+    if (IPRewriterBase::configure(conf, errh) < 0)
+	return -1;
+    if (_half_open_capacity) {
+	int n = (_shards ? _nshards : 1);
+	_half_open = new HalfOpenList[n];
+	_half_open_capacity = (_half_open_capacity + n - 1) / n;
+    }
+    for (int s = 0; _shards && s < _nshards; ++s) {
+	_shards[s].allocator[pool_flows] = new HashAllocator(sizeof(TCPFlow));
+	_shards[s].allocator[pool_deltas] = new HashAllocator(sizeof(TCPFlow::delta_transition));
+    }
+    return 0;
 }
 
 IPRewriterEntry *
 TCPRewriter::add_flow(int /*ip_p*/, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
+    return add_tcp_flow(flowid, rewritten_flowid, input, false);
+}
+
+/** @brief Create and store a TCP flow.
+ *
+ * If @a half_open, the flow is half-open: best-effort, expiring after
+ * HALF_OPEN_TIMEOUT, and evicting the oldest half-open flow if there are
+ * already HALF_OPEN_CAPACITY. */
+IPRewriterEntry *
+TCPRewriter::add_tcp_flow(const IPFlowID &flowid,
+			  const IPFlowID &rewritten_flowid, int input,
+			  bool half_open)
+{
+    Shard *sh = (_shards ? &shard(flowid) : 0);
+    HalfOpenList *hol = 0;
+    if (half_open) {
+	hol = &_half_open[sh ? sh - _shards : 0];
+	if (hol->count >= _half_open_capacity) {
+	    ++hol->evictions;
+	    evict_flow(hol->head, sh ? sh->heap : _heap);
+	}
+    }
+
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = (sh ? sh->allocator[0]->allocate() : _allocator.allocate())))
 	return 0;
 
     TCPFlow *flow = new(data) TCPFlow
-	(&_input_specs[input], flowid, rewritten_flowid,
-	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
+	(sh ? &sh->input_specs[input] : &_input_specs[input],
+	 flowid, rewritten_flowid, half_open ? false : !!_timeouts[1],
+	 click_jiffies() + (half_open ? _half_open_timeout : relevant_timeout(_timeouts)));
+    if (hol) {
+	flow->_tflags |= TCPFlow::s_half_open;
+	flow->_half_open_pprev = hol->tailp;
+	*hol->tailp = flow;
+	hol->tailp = &flow->_half_open_next;
+	++hol->count;
+    }
+
+    if (sh)
+	return store_flow(flow, sh->map[0], &sh->map[0]);
+    else
+	return store_flow(flow, _map);
+}
+
+void
+TCPRewriter::save_flow_state(const IPRewriterFlow *flow, StringAccum &sa)
+{
+    if (flow->ip_p() == IP_PROTO_TCP)
+	static_cast<const TCPFlow *>(flow)->save_deltas(sa);
+}
 
-    return store_flow(flow, input, _map);
+bool
+TCPRewriter::restore_flow_state(IPRewriterFlow *flow, const unsigned char *data, int len)
+{
+    if (flow->ip_p() != IP_PROTO_TCP)
+	return true;
+    // Restored flows are admitted in full.
+    TCPFlow *tflow = static_cast<TCPFlow *>(flow);
+    tflow->_tflags &= ~(TCPFlow::s_half_open | TCPFlow::s_half_open_reply_syn);
+    return tflow->restore_deltas(data, len);
 }
 
 void
@@ -315,15 +435,31 @@ TCPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    Map *map = &_map;
+    IPRewriterHeap *heap = _heap;
+    Vector<IPRewriterInput> *specs = &_input_specs;
+    int mapid = IPRewriterInput::mapid_default;
+    Shard *sh = 0;
+    if (_shards) {
+	sh = &shard(flowid);
+	sh->lock.acquire();
+	map = &sh->map[0];
+	heap = sh->heap;
+	specs = &sh->input_specs;
+	mapid = shard_mapid(*sh, 0);
+    }
+    IPRewriterEntry *m = map->get(flowid);
 
     if (!m) {			// create new mapping
-	IPRewriterInput &is = _input_specs.unchecked_at(port);
+	IPRewriterInput &is = specs->unchecked_at(port);
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
-	int result = is.rewrite_flowid(flowid, rewritten_flowid, p);
+	int result = is.rewrite_flowid(flowid, rewritten_flowid, p, mapid);
 	if (result == rw_addmap)
-	    m = TCPRewriter::add_flow(IP_PROTO_TCP, flowid, rewritten_flowid, port);
+	    m = add_tcp_flow(flowid, rewritten_flowid, port,
+			     _half_open && half_open_syn(p));
 	if (!m) {
+	    if (sh)
+		sh->lock.release();
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -332,14 +468,12 @@ TCPRewriter::push(int port, Packet *p_in)
 
     TCPFlow *mf = static_cast<TCPFlow *>(m->flow());
     mf->apply(p, m->direction(), _annos);
+    refresh_flow(mf, p, m->direction(), heap, click_jiffies());
 
-    click_jiffies_t now_j = click_jiffies();
-    if (_timeouts[1])
-	mf->change_expiry(_heap, true, now_j + _timeouts[1]);
-    else
-	mf->change_expiry(_heap, false, now_j + tcp_flow_timeout(mf));
-
-    output(m->output()).push(p);
+    int out = m->output();
+    if (sh)
+	sh->lock.release();
+    output(out).push(p);
 }
 
 
@@ -349,18 +483,39 @@ TCPRewriter::tcp_mappings_handler(Element *e, void *)
     TCPRewriter *rw = (TCPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < (rw->_shards ? rw->_nshards : 1); ++s) {
+	Map &map = (rw->_shards ? rw->_shards[s].map[0] : rw->_map);
+	if (rw->_shards)
+	    rw->_shards[s].lock.acquire();
+	for (Map::iterator iter = map.begin(); iter.live(); ++iter) {
+	    TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	if (rw->_shards)
+	    rw->_shards[s].lock.release();
     }
     return sa.take_string();
 }
 
+String
+TCPRewriter::half_open_handler(Element *e, void *thunk)
+{
+    TCPRewriter *rw = static_cast<TCPRewriter *>(e);
+    uint32_t n = 0;
+    for (int s = 0; s < (rw->_shards ? rw->_nshards : 1); ++s)
+	n += (thunk ? rw->_half_open[s].evictions : rw->_half_open[s].count);
+    return String(n);
+}
+
 void
 TCPRewriter::add_handlers()
 {
     add_read_handler("mappings", tcp_mappings_handler, 0);
+    if (_half_open) {
+	add_read_handler("half_open", half_open_handler, 0);
+	add_read_handler("half_open_evictions", half_open_handler, 1);
+    }
     add_rewriter_handlers(true);
 }
 
@@ -58,6 +58,22 @@ Preserve each TCP connection mapping for at least I<time> seconds after each
 successfully processed packet. Defaults to 5 seconds. Incoming flows are
 dropped if an TCPRewriter's mapping table is full of guaranteed flows.
 
+=item HALF_OPEN_CAPACITY I<n>
+
+Integer. If positive, admit flows in stages, to protect established flows
+from SYN floods. A flow created by a SYN without ACK is I<half-open> until
+its initiator acknowledges the reply's SYN. Half-open flows are never
+guaranteed and expire after HALF_OPEN_TIMEOUT. At most I<n> of them exist
+at once (per shard, I<n> divided evenly among the shards); a new one evicts
+the oldest. Established flows, then, are evicted for SYNs only when the
+table is full of flows that completed a handshake. Default is 0, meaning
+every flow is admitted at once.
+
+=item HALF_OPEN_TIMEOUT I<time>
+
+Time out half-open flows after I<time> seconds without a packet. Default is
+5 seconds.
+
 =item REAP_INTERVAL I<time>
 
 Reap timed-out connections every I<time> seconds. Default is 15 minutes.
@@ -68,11 +84,43 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item TIMING_WHEEL
+
+Boolean. If true, keep mappings in hashed timing wheels, with slots of about
+1/8 second, rather than in heaps ordered by expiration time. Refreshing a
+mapping on each packet then takes constant time, and expired mappings are
+reaped in batches. When the rewriter is full, it evicts one of the mappings
+expiring soonest, to within a slot. Rewriters that share a MAPPING_CAPACITY
+must agree on TIMING_WHEEL. Default is false.
+
+=item HASH
+
+Hash function for the mapping tables: C<default>, C<crc32c>, or C<seeded>,
+optionally followed by C<symmetric>. The default function clusters when many
+flows differ only in nearby ports, as behind a NAT; C<crc32c> spreads them
+well and is fast, using the SSE4.2 crc32 instruction when available; C<seeded>
+is SipHash with a random key, so that remote hosts cannot choose colliding
+flows. C<symmetric> makes a flow and its reverse hash alike. Default is
+C<default>.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
 packets to the rewritten destination address. Default is true.
 
+=item SHARDS I<n>
+
+Integer. Split the mapping table into I<n> shards, each with its own flow
+table, expiration heap, and lock, so that several threads can run one
+rewriter with little contention. Typically I<n> is the number of threads
+that push packets into the rewriter. A flow and its reply are always kept in
+the same shard: the shard is chosen by a symmetric hash of the flow ID, and
+patterns pick only source ports (or addresses) whose reply flow hashes to
+that shard. Patterns that leave no choice of port or address may therefore
+fail to map some flows. With SHARDS, MAPPING_CAPACITY must be an integer,
+and is divided evenly among the shards; and every input's reply element must
+be this rewriter. Default is 1, meaning one unsharded table.
+
 =back
 
 =h mappings read-only
@@ -80,6 +128,59 @@ packets to the rewritten destination address. Default is true.
 Returns a human-readable description of the TCPRewriter's current set of
 mappings.
 
+=h shards read-only
+
+Only present if SHARDS is greater than 1. Returns one line per shard, giving
+the shard number and the number of flows in that shard. The 'nmappings',
+'mapping_failures', and 'size' handlers report totals over all shards.
+
+=h hash_stats read-only
+
+Returns mapping table statistics: the number of entries, buckets, and nonempty
+buckets, the longest chain, and the mean number of entries compared to find
+an entry. Useful for choosing HASH.
+
+=h pools read-only
+
+Returns one line per object pool: its name, the number of objects in use,
+the number of free objects, and the bytes the pool holds. Pools are
+C<flows>, for flows, C<udp_flows>, for IPRewriter's UDP flows, and C<deltas>,
+for TCP sequence number delta transitions. Each shard has its own pools; the
+counts are totals. Pools never return memory, so free objects are the
+difference between the peak and current load.
+
+=h half_open read-only
+
+Only present if HALF_OPEN_CAPACITY is positive. Returns the number of
+half-open flows.
+
+=h half_open_evictions read-only
+
+Only present if HALF_OPEN_CAPACITY is positive. Returns the number of
+half-open flows evicted for newer ones.
+
+=h checkpoint write-only
+
+User-level only. Takes a filename, and writes every flow this element owns
+to that file: its flow IDs, input, remaining lifetime, and, for TCP, its
+sequence number deltas. The file is written under a temporary name, in
+chunks, and renamed into place when complete. See 'restore'.
+
+=h restore write-only
+
+User-level only. Takes a filename written by 'checkpoint', and installs its
+flows, so a standby router can take over established connections. Flows
+that are already mapped, and flows for inputs that no longer exist, are
+skipped. So are flows whose two directions fall in different shards, so a
+sharded rewriter can take every flow only from a rewriter with as many
+shards.
+
+=h checkpoint_data read/write
+
+Reading returns a checkpoint, as written by 'checkpoint'; writing installs
+one, like 'restore'. A standby can poll one router's checkpoint_data
+through a ControlSocket and write it to its own.
+
 =a IPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 FTPPortMapper */
 
@@ -91,13 +192,14 @@ class TCPRewriter : public IPRewriterBase { public:
 		const IPFlowID &rewritten_flowid,
 		bool guaranteed, click_jiffies_t expiry_j)
 	    : IPRewriterFlow(owner, flowid, rewritten_flowid,
-			     IP_PROTO_TCP, guaranteed, expiry_j), _dt(0) {
+			     IP_PROTO_TCP, guaranteed, expiry_j), _dt(0),
+	      _half_open_next(0), _half_open_pprev(0) {
 	}
 
 	~TCPFlow() {
 	    while (delta_transition *x = _dt) {
 		_dt = x->next();
-		delete x;
+		free_delta(x);
 	    }
 	}
 
@@ -105,7 +207,8 @@ class TCPRewriter : public IPRewriterBase { public:
 	    s_forward_done = 1, s_reply_done = 2,
 	    s_both_done = (s_forward_done | s_reply_done),
 	    s_forward_data = 4, s_reply_data = 8,
-	    s_both_data = (s_forward_data | s_reply_data)
+	    s_both_data = (s_forward_data | s_reply_data),
+	    s_half_open = 16, s_half_open_reply_syn = 32
 	};
 	bool both_done() const {
 	    return (_tflags & s_both_done) == s_both_done;
@@ -113,6 +216,9 @@ class TCPRewriter : public IPRewriterBase { public:
 	bool both_data() const {
 	    return (_tflags & s_both_data) == s_both_data;
 	}
+	bool half_open() const {
+	    return _tflags & s_half_open;
+	}
 
 	int update_seqno_delta(bool direction, tcp_seq_t old_seqno, int32_t delta);
 	tcp_seq_t new_seq(bool direction, tcp_seq_t seqno) const;
@@ -122,6 +228,9 @@ class TCPRewriter : public IPRewriterBase { public:
 
 	void unparse(StringAccum &sa, bool direction, click_jiffies_t now) const;
 
+	void save_deltas(StringAccum &sa) const;
+	bool restore_deltas(const unsigned char *data, int len);
+
       private:
 
 	struct delta_transition {
@@ -140,9 +249,18 @@ class TCPRewriter : public IPRewriterBase { public:
 	};
 
 	delta_transition *_dt;
+	TCPFlow *_half_open_next;	// half-open list, oldest first
+	TCPFlow **_half_open_pprev;
+
+	// Delta transitions come from the owning rewriter's pool.
+	inline HashAllocator &delta_allocator() const;
+	inline delta_transition *new_delta() const;
+	inline void free_delta(delta_transition *x) const;
 
 	void apply_sack(bool direction, click_tcp *tcp, int transport_len);
 
+	friend class TCPRewriter;
+
     };
 
     TCPRewriter();
@@ -162,15 +280,45 @@ class TCPRewriter : public IPRewriterBase { public:
 
     void push(int, Packet *);
 
+    IPRewriterEntry *add_tcp_flow(const IPFlowID &flowid,
+				  const IPFlowID &rewritten_flowid, int input,
+				  bool half_open);
+
+    void save_flow_state(const IPRewriterFlow *flow, StringAccum &sa);
+    bool restore_flow_state(IPRewriterFlow *flow, const unsigned char *data, int len);
+
     void add_handlers();
 
  protected:
 
     SizedHashAllocator<sizeof(TCPFlow)> _allocator;
+    SizedHashAllocator<sizeof(TCPFlow::delta_transition)> _delta_allocator;
     unsigned _annos;
     uint32_t _tcp_data_timeout;
     uint32_t _tcp_done_timeout;
 
+    // Half-open flows, per shard.
+    struct HalfOpenList {
+	TCPFlow *head;
+	TCPFlow **tailp;
+	uint32_t count;
+	uint32_t evictions;
+	HalfOpenList()
+	    : head(0), tailp(&head), count(0), evictions(0) {
+	}
+    };
+    HalfOpenList *_half_open;
+    uint32_t _half_open_capacity;
+    uint32_t _half_open_timeout;
+
+    HalfOpenList &half_open_list(const TCPFlow *flow) {
+	return _half_open[_shards ? &shard(flow->entry(false).flowid()) - _shards : 0];
+    }
+    static inline bool half_open_syn(Packet *p);
+    inline void unlink_half_open(TCPFlow *flow);
+    inline void refresh_flow(TCPFlow *flow, Packet *p, bool direction,
+			     IPRewriterHeap *heap, click_jiffies_t now_j);
+
     int tcp_flow_timeout(const TCPFlow *mf) const {
 	if (mf->both_done())
 	    return _tcp_done_timeout;
@@ -180,18 +328,108 @@ class TCPRewriter : public IPRewriterBase { public:
 	    return _timeouts[0];
     }
 
+    HashAllocator *pool_allocator(int pool) {
+	if (pool == pool_flows)
+	    return &_allocator;
+	else if (pool == pool_deltas)
+	    return &_delta_allocator;
+	else
+	    return 0;
+    }
+
     static String tcp_mappings_handler(Element *, void *);
+    static String half_open_handler(Element *, void *);
 
 };
 
+inline void
+TCPRewriter::unlink_half_open(TCPFlow *flow)
+{
+    HalfOpenList &hol = half_open_list(flow);
+    if ((*flow->_half_open_pprev = flow->_half_open_next))
+	flow->_half_open_next->_half_open_pprev = flow->_half_open_pprev;
+    else
+	hol.tailp = flow->_half_open_pprev;
+    --hol.count;
+    flow->_tflags &= ~(TCPFlow::s_half_open | TCPFlow::s_half_open_reply_syn);
+}
+
 inline void
 TCPRewriter::destroy_flow(IPRewriterFlow *flow)
 {
+    if (static_cast<TCPFlow *>(flow)->half_open())
+	unlink_half_open(static_cast<TCPFlow *>(flow));
+    if (_shards) {
+	Shard &sh = shard(flow->entry(false).flowid());
+	unmap_flow(flow, sh.map[0], &sh.map[0]);
+	static_cast<TCPFlow *>(flow)->~TCPFlow();
+	sh.allocator[0]->deallocate(flow);
+	return;
+    }
     unmap_flow(flow, _map);
     static_cast<TCPFlow *>(flow)->~TCPFlow();
     _allocator.deallocate(flow);
 }
 
+inline bool
+TCPRewriter::half_open_syn(Packet *p)
+{
+    return IP_FIRSTFRAG(p->ip_header()) && p->transport_length() >= 14
+	&& (p->tcp_header()->th_flags & (TH_SYN | TH_ACK)) == TH_SYN;
+}
+
+/** @brief Update @a flow's expiry after a packet, @a p, in @a direction.
+ *
+ * A half-open flow is established once its initiator acknowledges the
+ * reply's SYN; until then it keeps the half-open timeout. */
+inline void
+TCPRewriter::refresh_flow(TCPFlow *flow, Packet *p, bool direction,
+			  IPRewriterHeap *heap, click_jiffies_t now_j)
+{
+    if (flow->half_open()) {
+	int flags = 0;
+	if (IP_FIRSTFRAG(p->ip_header()) && p->transport_length() >= 14)
+	    flags = p->tcp_header()->th_flags & (TH_SYN | TH_ACK | TH_RST);
+	if (direction && (flags & TH_SYN))
+	    flow->_tflags |= TCPFlow::s_half_open_reply_syn;
+	if (direction || flags != TH_ACK
+	    || !(flow->_tflags & TCPFlow::s_half_open_reply_syn)) {
+	    flow->change_expiry(heap, false, now_j + _half_open_timeout);
+	    return;
+	}
+	unlink_half_open(flow);
+    }
+    if (_timeouts[1])
+	flow->change_expiry(heap, true, now_j + _timeouts[1]);
+    else
+	flow->change_expiry(heap, false, now_j + tcp_flow_timeout(flow));
+}
+
+inline HashAllocator &
+TCPRewriter::TCPFlow::delta_allocator() const
+{
+    TCPRewriter *rw = static_cast<TCPRewriter *>(owner()->owner);
+    if (rw->_shards)
+	return *rw->shard(entry(false).flowid()).allocator[pool_deltas];
+    else
+	return rw->_delta_allocator;
+}
+
+inline TCPRewriter::TCPFlow::delta_transition *
+TCPRewriter::TCPFlow::new_delta() const
+{
+    if (void *data = delta_allocator().allocate())
+	return new(data) delta_transition;
+    else
+	return 0;
+}
+
+inline void
+TCPRewriter::TCPFlow::free_delta(delta_transition *x) const
+{
+    delta_allocator().deallocate(x);
+}
+
 inline tcp_seq_t
 TCPRewriter::TCPFlow::new_seq(bool direction, tcp_seq_t seqno) const
 {
@@ -22,16 +22,12 @@
 #include <click/args.hh>
 #include <click/error.hh>
 #include <click/glue.hh>
-#include <click/standard/alignmentinfo.hh>
 CLICK_DECLS
 
 UDPIPEncap::UDPIPEncap()
-    : _cksum(true), _use_dst_anno(false)
+    : _cksum(true), _use_dst_anno(false), _expensive_pushes(0)
 {
     _id = 0;
-#if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
-    _checked_aligned = false;
-#endif
 }
 
 UDPIPEncap::~UDPIPEncap()
@@ -67,69 +63,53 @@ UDPIPEncap::configure(Vector<String> &conf, ErrorHandler *errh)
     _sport = htons(sport);
     _dport = htons(dport);
 
-#if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
-    if (!_checked_aligned) {
-	int ans, c, o;
-	ans = AlignmentInfo::query(this, 0, c, o);
-	_aligned = (ans && c == 4 && o == 0);
-	if (!_aligned)
-	    errh->warning("IP header unaligned, cannot use fast IP checksum");
-	if (!ans)
-	    errh->message("(Try passing the configuration through %<click-align%>.)");
-	_checked_aligned = true;
-    }
-#endif
+    // build the header template; ip_len and ip_id are filled per packet
+    memset(&_hdr, 0, sizeof(_hdr));
+    _hdr.ip.ip_v = 4;
+    _hdr.ip.ip_hl = sizeof(click_ip) >> 2;
+    _hdr.ip.ip_ttl = 250;
+    _hdr.ip.ip_p = IP_PROTO_UDP;
+    _hdr.ip.ip_src = _saddr;
+    _hdr.ip.ip_dst = _daddr;
+    _hdr.ip.ip_sum = click_in_cksum((unsigned char *) &_hdr.ip, sizeof(click_ip));
+    _hdr.udp.uh_sport = _sport;
+    _hdr.udp.uh_dport = _dport;
 
     return 0;
 }
 
-Packet *
-UDPIPEncap::simple_action(Packet *p_in)
+inline WritablePacket *
+UDPIPEncap::encap(Packet *p_in, uint32_t id)
 {
+  if (p_in->headroom() < sizeof(click_udp) + sizeof(click_ip) || p_in->shared())
+    ++_expensive_pushes;
   WritablePacket *p = p_in->push(sizeof(click_udp) + sizeof(click_ip));
+  if (!p)
+    return 0;
   click_ip *ip = reinterpret_cast<click_ip *>(p->data());
   click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
 
 #if !HAVE_INDIFFERENT_ALIGNMENT
   assert((uintptr_t)ip % 4 == 0);
 #endif
-  // set up IP header
-  ip->ip_v = 4;
-  ip->ip_hl = sizeof(click_ip) >> 2;
-  ip->ip_len = htons(p->length());
-  ip->ip_id = htons(_id.fetch_and_add(1));
-  ip->ip_p = IP_PROTO_UDP;
-  ip->ip_src = _saddr;
-  if (_use_dst_anno)
+  // set up IP header from the template, then fix its checksum for the
+  // fields that vary
+  memcpy(ip, &_hdr, sizeof(click_ip) + sizeof(click_udp));
+  if (_use_dst_anno) {
       ip->ip_dst = p->dst_ip_anno();
-  else {
-      ip->ip_dst = _daddr;
+      click_update_in_cksum32(&ip->ip_sum, 0, ip->ip_dst.s_addr);
+  } else
       p->set_dst_ip_anno(IPAddress(_daddr));
-  }
-  ip->ip_tos = 0;
-  ip->ip_off = 0;
-  ip->ip_ttl = 250;
-
-  ip->ip_sum = 0;
-#if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
-  if (_aligned)
-    ip->ip_sum = ip_fast_csum((unsigned char *)ip, sizeof(click_ip) >> 2);
-  else
-    ip->ip_sum = click_in_cksum((unsigned char *)ip, sizeof(click_ip));
-#elif HAVE_FAST_CHECKSUM
-  ip->ip_sum = ip_fast_csum((unsigned char *)ip, sizeof(click_ip) >> 2);
-#else
-  ip->ip_sum = click_in_cksum((unsigned char *)ip, sizeof(click_ip));
-#endif
+  ip->ip_len = htons(p->length());
+  ip->ip_id = htons(id);
+  click_update_in_cksum(&ip->ip_sum, 0, ip->ip_len);
+  click_update_in_cksum(&ip->ip_sum, 0, ip->ip_id);
 
   p->set_ip_header(ip, sizeof(click_ip));
 
   // set up UDP header
-  udp->uh_sport = _sport;
-  udp->uh_dport = _dport;
   uint16_t len = p->length() - sizeof(click_ip);
   udp->uh_ulen = htons(len);
-  udp->uh_sum = 0;
   if (_cksum) {
     unsigned csum = click_in_cksum((unsigned char *)udp, len);
     udp->uh_sum = click_in_cksum_pseudohdr(csum, ip, len);
@@ -138,6 +118,49 @@ UDPIPEncap::simple_action(Packet *p_in)
   return p;
 }
 
+bool
+UDPIPEncap::input_alignment(int &modulus, int &offset) const
+{
+    // align the new IP header
+    modulus = 4;
+    offset = 0;
+    return true;
+}
+
+Packet *
+UDPIPEncap::simple_action(Packet *p)
+{
+  return encap(p, _id.fetch_and_add(1));
+}
+
+void
+UDPIPEncap::simple_action_batch(PacketBatch &batch)
+{
+  // reserve the whole batch's IP IDs at once
+  uint32_t id = _id.fetch_and_add(batch.count());
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if (WritablePacket *q = encap(p, id++))
+      out.push_back(q);
+  batch.swap(out);
+}
+
+void
+UDPIPEncap::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+UDPIPEncap::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
 String UDPIPEncap::read_handler(Element *e, void *thunk)
 {
     UDPIPEncap *u = static_cast<UDPIPEncap *>(e);
@@ -165,6 +188,7 @@ void UDPIPEncap::add_handlers()
     add_write_handler("dst", reconfigure_keyword_handler, "2 DST");
     add_read_handler("dport", read_handler, 3);
     add_write_handler("dport", reconfigure_keyword_handler, "3 DPORT");
+    add_data_handlers("expensive_pushes", Handler::h_read, &_expensive_pushes);
 }
 
 CLICK_ENDDECLS
@@ -3,6 +3,8 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <click/atomic.hh>
+#include <click/packetbatch.hh>
+#include <clicknet/ip.h>
 #include <clicknet/udp.h>
 CLICK_DECLS
 
@@ -25,7 +27,11 @@ default.
 As a special case, if DST is "DST_ANNO", then the destination address
 is set to the incoming packet's destination address annotation.
 
-The UDPIPEncap element adds both a UDP header and an IP header.
+The UDPIPEncap element adds both a UDP header and an IP header.  The headers
+are built once, with the IP checksum, when UDPIPEncap is configured; each
+packet gets a copy whose IP checksum is updated incrementally for its
+length, IP ID, and (with DST_ANNO) destination.  A batch of packets takes
+its IP IDs in one step.
 
 The Strip element can be used by the receiver to get rid of the
 encapsulation header.
@@ -49,6 +55,12 @@ Returns or sets the DST destination address argument.
 
 Returns or sets the DPORT destination port argument.
 
+=h expensive_pushes read-only
+
+Returns the number of packets that lacked headroom for the new header, or
+whose data was shared, so that push() had to copy them.  See also the global
+"packet_expensive" handler.
+
 =a Strip, IPEncap
 */
 
@@ -63,9 +75,14 @@ class UDPIPEncap : public Element { public:
 
     int configure(Vector<String> &, ErrorHandler *);
     bool can_live_reconfigure() const	{ return true; }
+    int encap_headroom() const		{ return sizeof(click_udp) + sizeof(click_ip); }
+    bool input_alignment(int &modulus, int &offset) const;
     void add_handlers();
 
     Packet *simple_action(Packet *);
+    void simple_action_batch(PacketBatch &);
+    void push_batch(int, PacketBatch &);
+    void pull_batch(int, PacketBatch &, int);
 
   private:
 
@@ -75,12 +92,14 @@ class UDPIPEncap : public Element { public:
     uint16_t _dport;
     bool _cksum;
     bool _use_dst_anno;
-#if HAVE_FAST_CHECKSUM && FAST_CHECKSUM_ALIGNED
-    bool _aligned;
-    bool _checked_aligned;
-#endif
+    struct {
+	click_ip ip;
+	click_udp udp;
+    } _hdr;			// template; ip_len and ip_id are 0
     atomic_uint32_t _id;
+    uint32_t _expensive_pushes;
 
+    inline WritablePacket *encap(Packet *, uint32_t id);
     static String read_handler(Element *, void *);
 
 };
@@ -101,6 +101,7 @@ UDPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("UDP_STREAMING_TIMEOUT", SecondsArg(), _udp_streaming_timeout).read_status(has_udp_streaming_timeout)
 	.read("STREAMING_TIMEOUT", SecondsArg(), _udp_streaming_timeout).read_status(has_streaming_timeout)
 	.read("UDP_GUARANTEE", SecondsArg(), _timeouts[1])
+	.read("SHARDS", _nshards)
 	.consume() < 0)
 	return -1;
 
@@ -109,22 +110,31 @@ UDPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 	_udp_streaming_timeout = _timeouts[0];
     _udp_streaming_timeout *= CLICK_HZ; // IPRewriterBase handles the others
 
-    return IPRewriterBase::configure(conf, errh);
+    if (IPRewriterBase::configure(conf, errh) < 0)
+	return -1;
+    for (int s = 0; _shards && s < _nshards; ++s)
+	_shards[s].allocator[pool_flows] = new HashAllocator(sizeof(UDPFlow));
+    return 0;
 }
 
 IPRewriterEntry *
 UDPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
+    Shard *sh = (_shards ? &shard(flowid) : 0);
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = (sh ? sh->allocator[0]->allocate() : _allocator.allocate())))
 	return 0;
 
     UDPFlow *flow = new(data) UDPFlow
-	(&_input_specs[input], flowid, rewritten_flowid, ip_p,
+	(sh ? &sh->input_specs[input] : &_input_specs[input],
+	 flowid, rewritten_flowid, ip_p,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    if (sh)
+	return store_flow(flow, sh->map[0], &sh->map[0]);
+    else
+	return store_flow(flow, _map);
 }
 
 void
@@ -149,15 +159,30 @@ UDPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    Map *map = &_map;
+    IPRewriterHeap *heap = _heap;
+    Vector<IPRewriterInput> *specs = &_input_specs;
+    int mapid = IPRewriterInput::mapid_default;
+    Shard *sh = 0;
+    if (_shards) {
+	sh = &shard(flowid);
+	sh->lock.acquire();
+	map = &sh->map[0];
+	heap = sh->heap;
+	specs = &sh->input_specs;
+	mapid = shard_mapid(*sh, 0);
+    }
+    IPRewriterEntry *m = map->get(flowid);
 
     if (!m) {			// create new mapping
-	IPRewriterInput &is = _input_specs.unchecked_at(port);
+	IPRewriterInput &is = specs->unchecked_at(port);
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
-	int result = is.rewrite_flowid(flowid, rewritten_flowid, p);
+	int result = is.rewrite_flowid(flowid, rewritten_flowid, p, mapid);
 	if (result == rw_addmap)
 	    m = UDPRewriter::add_flow(ip_p, flowid, rewritten_flowid, port);
 	if (!m) {
+	    if (sh)
+		sh->lock.release();
 	    checked_output_push(result, p);
 	    return;
 	} else if (_annos & 2)
@@ -169,11 +194,14 @@ UDPRewriter::push(int port, Packet *p_in)
 
     click_jiffies_t now_j = click_jiffies();
     if (_timeouts[1])
-	mf->change_expiry(_heap, true, now_j + _timeouts[1]);
+	mf->change_expiry(heap, true, now_j + _timeouts[1]);
     else
-	mf->change_expiry(_heap, false, now_j + udp_flow_timeout(mf));
+	mf->change_expiry(heap, false, now_j + udp_flow_timeout(mf));
 
-    output(m->output()).push(p);
+    int out = m->output();
+    if (sh)
+	sh->lock.release();
+    output(out).push(p);
 }
 
 
@@ -183,9 +211,16 @@ UDPRewriter::dump_mappings_handler(Element *e, void *)
     UDPRewriter *rw = (UDPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
+    for (int s = 0; s < (rw->_shards ? rw->_nshards : 1); ++s) {
+	Map &map = (rw->_shards ? rw->_shards[s].map[0] : rw->_map);
+	if (rw->_shards)
+	    rw->_shards[s].lock.acquire();
+	for (Map::iterator iter = map.begin(); iter.live(); ++iter) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
+	if (rw->_shards)
+	    rw->_shards[s].lock.release();
     }
     return sa.take_string();
 }
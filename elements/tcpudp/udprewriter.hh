@@ -145,11 +145,43 @@ Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item TIMING_WHEEL
+
+Boolean. If true, keep mappings in hashed timing wheels, with slots of about
+1/8 second, rather than in heaps ordered by expiration time. Refreshing a
+mapping on each packet then takes constant time, and expired mappings are
+reaped in batches. When the rewriter is full, it evicts one of the mappings
+expiring soonest, to within a slot. Rewriters that share a MAPPING_CAPACITY
+must agree on TIMING_WHEEL. Default is false.
+
+=item HASH
+
+Hash function for the mapping tables: C<default>, C<crc32c>, or C<seeded>,
+optionally followed by C<symmetric>. The default function clusters when many
+flows differ only in nearby ports, as behind a NAT; C<crc32c> spreads them
+well and is fast, using the SSE4.2 crc32 instruction when available; C<seeded>
+is SipHash with a random key, so that remote hosts cannot choose colliding
+flows. C<symmetric> makes a flow and its reverse hash alike. Default is
+C<default>.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
 packets to the rewritten destination address. Default is true.
 
+=item SHARDS I<n>
+
+Integer. Split the mapping table into I<n> shards, each with its own flow
+table, expiration heap, and lock, so that several threads can run one
+rewriter with little contention. Typically I<n> is the number of threads
+that push packets into the rewriter. A flow and its reply are always kept in
+the same shard: the shard is chosen by a symmetric hash of the flow ID, and
+patterns pick only source ports (or addresses) whose reply flow hashes to
+that shard. Patterns that leave no choice of port or address may therefore
+fail to map some flows. With SHARDS, MAPPING_CAPACITY must be an integer,
+and is divided evenly among the shards; and every input's reply element must
+be this rewriter. Default is 1, meaning one unsharded table.
+
 =back
 
 =h mappings read-only
@@ -157,6 +189,48 @@ packets to the rewritten destination address. Default is true.
 Returns a human-readable description of the UDPRewriter's current set of
 mappings.
 
+=h shards read-only
+
+Only present if SHARDS is greater than 1. Returns one line per shard, giving
+the shard number and the number of flows in that shard. The 'nmappings',
+'mapping_failures', and 'size' handlers report totals over all shards.
+
+=h hash_stats read-only
+
+Returns mapping table statistics: the number of entries, buckets, and nonempty
+buckets, the longest chain, and the mean number of entries compared to find
+an entry. Useful for choosing HASH.
+
+=h pools read-only
+
+Returns one line per object pool: its name, the number of objects in use,
+the number of free objects, and the bytes the pool holds. UDPRewriter has
+one pool, C<flows>. Each shard has its own pools; the counts are totals.
+Pools never return memory, so free objects are the difference between the
+peak and current load.
+
+=h checkpoint write-only
+
+User-level only. Takes a filename, and writes every flow this element owns
+to that file: its flow IDs, input, remaining lifetime, and, for TCP, its
+sequence number deltas. The file is written under a temporary name, in
+chunks, and renamed into place when complete. See 'restore'.
+
+=h restore write-only
+
+User-level only. Takes a filename written by 'checkpoint', and installs its
+flows, so a standby router can take over established connections. Flows
+that are already mapped, and flows for inputs that no longer exist, are
+skipped. So are flows whose two directions fall in different shards, so a
+sharded rewriter can take every flow only from a rewriter with as many
+shards.
+
+=h checkpoint_data read/write
+
+Reading returns a checkpoint, as written by 'checkpoint'; writing installs
+one, like 'restore'. A standby can poll one router's checkpoint_data
+through a ControlSocket and write it to its own.
+
 =a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter */
 
@@ -204,6 +278,10 @@ class UDPRewriter : public IPRewriterBase { public:
     unsigned _annos;
     uint32_t _udp_streaming_timeout;
 
+    HashAllocator *pool_allocator(int pool) {
+	return pool == pool_flows ? &_allocator : 0;
+    }
+
     int udp_flow_timeout(const UDPFlow *mf) const {
 	if (mf->streaming())
 	    return _udp_streaming_timeout;
@@ -221,6 +299,13 @@ class UDPRewriter : public IPRewriterBase { public:
 inline void
 UDPRewriter::destroy_flow(IPRewriterFlow *flow)
 {
+    if (_shards) {
+	Shard &sh = shard(flow->entry(false).flowid());
+	unmap_flow(flow, sh.map[0], &sh.map[0]);
+	flow->~IPRewriterFlow();
+	sh.allocator[0]->deallocate(flow);
+	return;
+    }
     unmap_flow(flow, _map);
     flow->~IPRewriterFlow();
     _allocator.deallocate(flow);
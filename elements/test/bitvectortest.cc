@@ -0,0 +1,99 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * bitvectortest.{cc,hh} -- regression test element for Bitvector
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "bitvectortest.hh"
+#include <click/bitvector.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+BitvectorTest::BitvectorTest()
+{
+}
+
+BitvectorTest::~BitvectorTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+int
+BitvectorTest::initialize(ErrorHandler *errh)
+{
+    Bitvector e;
+    CHECK(e.size() == 0 && e.zero() && e.count() == 0);
+    CHECK(e.find_first() == -1);
+
+    // sizes on both sides of the inline and word boundaries
+    static const int sizes[] = { 1, 31, 32, 33, 63, 64, 65, 127, 128, 129, 200, 1000 };
+    for (unsigned si = 0; si < sizeof(sizes) / sizeof(sizes[0]); ++si) {
+	int n = sizes[si];
+	Bitvector a(n, false), b(n, true);
+	CHECK(a.zero() && a.count() == 0 && a.find_first() == -1);
+	CHECK(!b.zero() && b.count() == n);
+	CHECK(b.find_first() == 0 && b.find_next(n - 1) == -1);
+	CHECK(~a == b && ~b == a);
+
+	for (int i = 0; i < n; i += 3)
+	    a[i] = true;
+	CHECK(a.count() == (n + 2) / 3);
+	int expect = 0, found = 0;
+	for (int i = a.find_first(); i >= 0; i = a.find_next(i), ++found) {
+	    CHECK(i == expect);
+	    expect += 3;
+	}
+	CHECK(found == a.count());
+
+	Bitvector c = a;
+	c.negate();
+	CHECK(c.count() == n - a.count());
+	CHECK((a | c) == b && (a & c).zero() && (a ^ c) == b);
+	CHECK(!a.nonzero_intersection(c) && a.nonzero_intersection(b));
+	CHECK((b - a) == c);
+
+	Bitvector d(n, false), diff;
+	d[n - 1] = true;
+	Bitvector old_d = d;
+	d.or_with_difference(a, diff);
+	CHECK(d == (a | old_d));
+	CHECK(diff == (a - old_d));
+
+	Bitvector f(n + 70, false);
+	f.offset_or(a, 70);
+	CHECK(f.count() == a.count() && f.find_first() == 70);
+	CHECK(f.find_next(70) == (n > 3 ? 73 : -1));
+
+	click_swap(a, f);
+	CHECK(f.size() == n && a.size() == n + 70 && a.find_first() == 70);
+    }
+
+    // find_next and count ignore bits left past the end by resize()
+    Bitvector g(100, true);
+    g.resize(40);
+    CHECK(g.count() == 40 && g.find_next(39) == -1);
+    g.resize(10);
+    CHECK(g.count() == 10 && g.find_next(9) == -1);
+
+    Bitvector h;
+    h.force_bit(300) = true;
+    CHECK(h.size() == 301 && h.count() == 1);
+    CHECK(h.find_first() == 300 && h.find_next(300) == -1);
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(BitvectorTest)
@@ -0,0 +1,145 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * checksumtest.{cc,hh} -- regression test element for Internet checksums
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "checksumtest.hh"
+#include <clicknet/ip.h>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+ChecksumTest::ChecksumTest()
+    : _benchmark(0)
+{
+}
+
+ChecksumTest::~ChecksumTest()
+{
+}
+
+int
+ChecksumTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh).read("BENCHMARK", _benchmark).complete();
+}
+
+// the original 16-bit loop
+static uint16_t
+reference_cksum(const unsigned char *data, int len)
+{
+    uint32_t sum = 0;
+    uint16_t w;
+    for (; len > 1; data += 2, len -= 2) {
+	memcpy(&w, data, 2);
+	sum += w;
+    }
+    if (len == 1) {
+	w = 0;
+	*(unsigned char *)(&w) = *data;
+	sum += w;
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum += (sum >> 16);
+    return ~sum;
+}
+
+int
+ChecksumTest::initialize(ErrorHandler *errh)
+{
+    // 65536 + slack, filled with all-ones words and pseudorandom bytes so
+    // that the vector kernels' per-lane sums get as large as they can
+    enum { size = 65536 + 64 };
+    unsigned char *data = new unsigned char[size], *copy = new unsigned char[size];
+    for (int i = 0; i < size; ++i)
+	data[i] = (i < 4096 ? 0xFF : click_random(0, 255));
+
+    int lengths[] = { 65535, 65534, 40000, 4097, 1500, 1499 };
+    int result = 0;
+    for (int off = 0; off < 8 && result == 0; off += 2)
+	for (int len = 0; len < 600 + (int) (sizeof(lengths) / sizeof(lengths[0])); ++len) {
+	    int l = len < 600 ? len : lengths[len - 600];
+	    uint16_t expected = reference_cksum(data + off, l);
+	    uint16_t got = click_in_cksum(data + off, l);
+	    if (got != expected) {
+		result = errh->error("click_in_cksum(data + %d, %d) = %#x, expected %#x", off, l, got, expected);
+		break;
+	    }
+	    memset(copy, 0xA5, size);
+	    got = click_in_cksum_copy(copy + 2, data + off, l);
+	    if (got != expected || memcmp(copy + 2, data + off, l) != 0
+		|| copy[1] != 0xA5 || copy[l + 2] != 0xA5) {
+		result = errh->error("click_in_cksum_copy(copy, data + %d, %d) = %#x, expected %#x", off, l, got, expected);
+		break;
+	    }
+	    if (l > 20 && !(l & 1)) {
+		got = click_in_cksum_combine(click_in_cksum(data + off, 20),
+					      click_in_cksum(data + off + 20, l - 20));
+		if (got != expected) {
+		    result = errh->error("click_in_cksum_combine at length %d = %#x, expected %#x", l, got, expected);
+		    break;
+		}
+	    }
+	}
+
+    // incremental updates: change a word, or swap a 32-byte pseudoheader
+    // for an 8-byte one, and compare with the recomputed checksum
+    for (int off = 0; off <= 596 && result == 0; off += 2) {
+	unsigned char *x = copy + 64;
+	memcpy(x, data + 4096 + off, 600);
+	uint16_t csum = click_in_cksum(x, 600);
+	uint32_t old_w, new_w = click_random();
+	memcpy(&old_w, x + off, 4);
+	memcpy(x + off, &new_w, 4);
+	click_update_in_cksum32(&csum, old_w, new_w);
+	uint16_t expected = click_in_cksum(x, 600);
+	if (csum != expected) {
+	    result = errh->error("click_update_in_cksum32 at offset %d = %#x, expected %#x", off, csum, expected);
+	    break;
+	}
+
+	memcpy(x - 32, data + 4096 + off, 32);
+	csum = click_in_cksum(x - 32, 632);
+	memcpy(x - 8, data + 5000 + off, 8);
+	click_update_in_cksum_range(&csum, data + 4096 + off, 32, x - 8, 8);
+	expected = click_in_cksum(x - 8, 608);
+	if (csum != expected) {
+	    result = errh->error("click_update_in_cksum_range at offset %d = %#x, expected %#x", off, csum, expected);
+	    break;
+	}
+    }
+
+    if (result == 0 && _benchmark > 0) {
+	uint32_t x = 0;
+	click_cycles_t c0 = click_get_cycles();
+	for (int i = 0; i < _benchmark; ++i)
+	    x += click_in_cksum(data + (i & 6), 1500);
+	click_cycles_t c1 = click_get_cycles();
+	for (int i = 0; i < _benchmark; ++i)
+	    x += reference_cksum(data + (i & 6), 1500);
+	click_cycles_t c2 = click_get_cycles();
+	errh->message("1500-byte checksums: %.1f cycles (reference %.1f cycles) [%u]",
+		      (double) (c1 - c0) / _benchmark, (double) (c2 - c1) / _benchmark, x & 1);
+    }
+
+    delete[] data;
+    delete[] copy;
+    if (result == 0)
+	errh->message("All tests pass!");
+    return result;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(ChecksumTest)
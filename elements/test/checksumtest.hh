@@ -0,0 +1,54 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CHECKSUMTEST_HH
+#define CLICK_CHECKSUMTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+ChecksumTest([I<keywords>])
+
+=s test
+
+runs regression tests for Internet checksum functions
+
+=d
+
+ChecksumTest runs regression tests for click_in_cksum and click_in_cksum_copy
+at initialization time, comparing them with a simple reference
+implementation over many lengths and alignments. It does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Integer.  If set to a positive number, then ChecksumTest also times
+BENCHMARK checksums of a 1500-byte buffer with click_in_cksum and with the
+reference implementation, and reports the results.  Default is 0 (don't
+benchmark).
+
+=back
+
+*/
+
+class ChecksumTest : public Element { public:
+
+    ChecksumTest();
+    ~ChecksumTest();
+
+    const char *class_name() const		{ return "ChecksumTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+  private:
+
+    int _benchmark;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -401,6 +401,44 @@ ConfParseTest::initialize(ErrorHandler *errh)
 	CHECK(((uintptr_t) s3.data() & 3) != ((uintptr_t) s4.data() & 3));
     }
 
+    // single-character Strings
+    CHECK(String('a') == "a");
+    CHECK(String('\0').length() == 1 && String('\0')[0] == '\0');
+    CHECK(String((unsigned char) 200)[0] == (char) 200);
+    CHECK(strcmp(String('x').c_str(), "x") == 0);
+    {
+	String s('a');
+	s += 'b';
+	CHECK(s == "ab" && String('a') == "a");
+    }
+
+#if HAVE_STRING_ARENA
+    // arena-backed Strings
+    {
+	String::Arena *arena = new String::Arena(1024);
+	String a, b, c;
+	{
+	    String::ArenaScope scope(*arena);
+	    CHECK(String::Arena::current() == arena);
+	    a = String("arena string");
+	    b = a + " and more";
+	    c = String::make_garbage(400);
+	}
+	CHECK(String::Arena::current() != arena);
+	CHECK(arena->nmemos() == 2 && arena->nchunks() == 1);
+	String d("not arena");
+	CHECK(arena->nmemos() == 2);
+	delete arena;
+	CHECK(a == "arena string" && b == "arena string and more");
+	b.append(" still");
+	CHECK(b == "arena string and more still");
+	CHECK(strcmp(a.c_str(), "arena string") == 0);
+	String e = a;
+	a = String();
+	CHECK(e == "arena string");
+    }
+#endif
+
 #if CLICK_USERLEVEL
     // click_strcmp
     CHECK(click_strcmp("a", "b") < 0);
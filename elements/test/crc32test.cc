@@ -0,0 +1,116 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * crc32test.{cc,hh} -- regression test element for CRC-32
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "crc32test.hh"
+#include <click/crc32.h>
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+CRC32Test::CRC32Test()
+    : _benchmark(0), _length(1500)
+{
+}
+
+CRC32Test::~CRC32Test()
+{
+}
+
+int
+CRC32Test::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("BENCHMARK", _benchmark)
+	.read("LENGTH", _length)
+	.complete() < 0)
+	return -1;
+    if (_length < 0)
+	return errh->error("LENGTH must be nonnegative");
+    return 0;
+}
+
+// the original byte-at-a-time code
+static uint32_t
+reference_crc(uint32_t crc, const unsigned char *data, int len)
+{
+    static uint32_t table[256];
+    if (!table[1])
+	for (int i = 0; i < 256; ++i) {
+	    uint32_t c = (uint32_t) i << 24;
+	    for (int j = 0; j < 8; ++j)
+		c = (c & 0x80000000 ? (c << 1) ^ 0x04C11DB7 : c << 1);
+	    table[i] = c;
+	}
+    for (; len > 0; ++data, --len)
+	crc = (crc << 8) ^ table[(crc >> 24) ^ *data];
+    return crc;
+}
+
+int
+CRC32Test::initialize(ErrorHandler *errh)
+{
+    enum { size = 16384 + 16 };
+    unsigned char *data = new unsigned char[(size > _length ? size : _length) + 8];
+    for (int i = 0; i < size; ++i)
+	data[i] = click_random(0, 255);
+
+    int lengths[] = { 16384, 9000, 4099, 1518, 1500, 1024 };
+    int result = 0;
+    for (int off = 0; off < 8 && result == 0; ++off)
+	for (int i = 0; i < 400 + (int) (sizeof(lengths) / sizeof(lengths[0])); ++i) {
+	    int len = i < 400 ? i : lengths[i - 400];
+	    uint32_t init = (i & 1 ? 0xFFFFFFFFU : click_random());
+	    uint32_t expected = reference_crc(init, data + off, len);
+	    uint32_t got = update_crc(init, (const char *) data + off, len);
+	    if (got != expected) {
+		result = errh->error("update_crc(%#x, data + %d, %d) = %#x, expected %#x", init, off, len, got, expected);
+		break;
+	    }
+	    // a CRC computed in two pieces should match
+	    if (len > 100) {
+		got = update_crc(update_crc(init, (const char *) data + off, 37),
+				 (const char *) data + off + 37, len - 37);
+		if (got != expected) {
+		    result = errh->error("split update_crc at length %d = %#x, expected %#x", len, got, expected);
+		    break;
+		}
+	    }
+	}
+
+    if (result == 0 && _benchmark > 0) {
+	for (int i = size; i < _length + 8; ++i)
+	    data[i] = click_random(0, 255);
+	uint32_t x = 0;
+	click_cycles_t c0 = click_get_cycles();
+	for (int i = 0; i < _benchmark; ++i)
+	    x += update_crc(0xFFFFFFFFU, (const char *) data + (i & 7), _length);
+	click_cycles_t c1 = click_get_cycles();
+	for (int i = 0; i < _benchmark; ++i)
+	    x += reference_crc(0xFFFFFFFFU, data + (i & 7), _length);
+	click_cycles_t c2 = click_get_cycles();
+	errh->message("%d-byte CRCs: %.1f cycles (reference %.1f cycles) [%u]",
+		      _length, (double) (c1 - c0) / _benchmark,
+		      (double) (c2 - c1) / _benchmark, x & 1);
+    }
+
+    delete[] data;
+    if (result == 0)
+	errh->message("All tests pass!");
+    return result;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(CRC32Test)
@@ -0,0 +1,59 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CRC32TEST_HH
+#define CLICK_CRC32TEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+CRC32Test([I<keywords>])
+
+=s test
+
+runs regression tests and benchmarks for update_crc
+
+=d
+
+CRC32Test runs regression tests for update_crc, the CRC-32 function used by
+CheckCRC32 and SetCRC32, at initialization time.  It compares update_crc
+with a byte-at-a-time reference implementation over many lengths and
+alignments. It does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Integer.  If set to a positive number, then CRC32Test also times BENCHMARK
+CRCs of a LENGTH-byte buffer with update_crc and with the reference
+implementation, and reports the results.  Default is 0 (don't benchmark).
+
+=item LENGTH
+
+Integer.  Buffer length for BENCHMARK.  Default is 1500.
+
+=back
+
+=a CheckCRC32, SetCRC32 */
+
+class CRC32Test : public Element { public:
+
+    CRC32Test();
+    ~CRC32Test();
+
+    const char *class_name() const		{ return "CRC32Test"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+  private:
+
+    int _benchmark;
+    int _length;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,137 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hashtablebench.{cc,hh} -- benchmark HashTable and FlatHashTable
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "hashtablebench.hh"
+#include <click/hashtable.hh>
+#include <click/flathashtable.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+HashTableBench::HashTableBench()
+{
+}
+
+HashTableBench::~HashTableBench()
+{
+}
+
+int
+HashTableBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _min_size = 1000;
+    _max_size = 100000000;
+    _seed = 1;
+    String table = "both";
+    if (Args(conf, this, errh)
+	.read("MIN_SIZE", _min_size)
+	.read("MAX_SIZE", _max_size)
+	.read("TABLE", WordArg(), table)
+	.read("SEED", _seed)
+	.complete() < 0)
+	return -1;
+    _flat = (table == "flat" || table == "both");
+    _chained = (table == "chained" || table == "both");
+    if (!_flat && !_chained)
+	return errh->error("TABLE must be %<flat%>, %<chained%>, or %<both%>");
+    if (_min_size < 1 || _max_size < _min_size)
+	return errh->error("bad MIN_SIZE or MAX_SIZE");
+    return 0;
+}
+
+// Keys are i * an odd constant, plus the seed: distinct for distinct i.
+static inline uint32_t
+bench_key(uint32_t i, uint32_t seed)
+{
+    return i * 2654435761U + seed;
+}
+
+static inline double
+per_op(const Timestamp &elapsed, uint32_t n)
+{
+    return elapsed.doubleval() * 1e9 / n;
+}
+
+template <typename T> int
+HashTableBench::run_trial(const char *name, uint32_t n, ErrorHandler *errh)
+{
+    // Look keys up in a different order than they were inserted, so that
+    // finds do not simply walk memory in allocation order.
+    uint32_t stride = 40503;
+    while (n % stride == 0 || stride % n == 0)
+	stride += 2;
+    T table;
+    uint32_t found = 0;
+
+    Timestamp t0 = Timestamp::now_steady();
+    for (uint32_t i = 0; i < n; ++i)
+	table.set(bench_key(i, _seed), i);
+    Timestamp t1 = Timestamp::now_steady();
+    for (uint32_t i = 0, j = 0; i < n; ++i, j = (j + stride) % n)
+	found += (table.get(bench_key(j, _seed)) == j);
+    Timestamp t2 = Timestamp::now_steady();
+    for (uint32_t i = 0; i < n; ++i)
+	found += (table.get_pointer(bench_key(n + i, _seed)) != 0);
+    Timestamp t3 = Timestamp::now_steady();
+    for (uint32_t i = 0, j = 0; i < n; ++i, j = (j + stride) % n)
+	table.erase(bench_key(j, _seed));
+    Timestamp t4 = Timestamp::now_steady();
+
+    if (found != n || !table.empty())
+	return errh->error("%s: %s table with %u keys: lookups failed", declaration().c_str(), name, n);
+    double insert = per_op(t1 - t0, n), hit = per_op(t2 - t1, n),
+	miss = per_op(t3 - t2, n), erase = per_op(t4 - t3, n);
+    errh->message("%s: %s %u: %.1f ns/insert, %.1f ns/find, %.1f ns/miss, %.1f ns/erase",
+		  declaration().c_str(), name, n, insert, hit, miss, erase);
+    StringAccum sa;
+    sa << name << ' ' << n << ' ' << insert << ' ' << hit << ' ' << miss
+       << ' ' << erase << '\n';
+    _results += sa.take_string();
+    return 0;
+}
+
+String
+HashTableBench::read_handler(Element *e, void *)
+{
+    HashTableBench *b = static_cast<HashTableBench *>(e);
+    return b->_results;
+}
+
+int
+HashTableBench::write_handler(const String &, Element *e, void *, ErrorHandler *errh)
+{
+    HashTableBench *b = static_cast<HashTableBench *>(e);
+    int ret = 0;
+    for (uint64_t n = b->_min_size; n <= b->_max_size; n *= 10) {
+	if (b->_chained && b->run_trial<HashTable<uint32_t, uint32_t> >("chained", n, errh) < 0)
+	    ret = -1;
+	if (b->_flat && b->run_trial<FlatHashTable<uint32_t, uint32_t> >("flat", n, errh) < 0)
+	    ret = -1;
+    }
+    return ret;
+}
+
+void
+HashTableBench::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+    add_write_handler("run", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(HashTableBench)
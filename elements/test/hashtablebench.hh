@@ -0,0 +1,92 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HASHTABLEBENCH_HH
+#define CLICK_HASHTABLEBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HashTableBench([I<keywords> MIN_SIZE, MAX_SIZE, TABLE, SEED])
+
+=s test
+
+measures HashTable and FlatHashTable speed
+
+=d
+
+Measures insert, find, and erase speed for HashTable<uint32_t, uint32_t> and
+FlatHashTable<uint32_t, uint32_t>.  Each trial fills an empty table with N
+distinct pseudorandom keys, looks every key up in a different order, looks
+up N keys that are not present, and finally erases every key, reporting the
+nanoseconds per operation of each phase.  Table sizes N run from MIN_SIZE to
+MAX_SIZE by factors of ten.  Trials run when the C<run> handler is written.
+
+Keyword arguments are:
+
+=over 8
+
+=item MIN_SIZE
+
+Integer.  Smallest table size.  Default is 1000.
+
+=item MAX_SIZE
+
+Integer.  Largest table size.  Default is 100000000.  The largest chained
+tables need several gigabytes of memory.
+
+=item TABLE
+
+Either C<flat>, C<chained>, or C<both>.  Which tables to measure.  Default
+is C<both>.
+
+=item SEED
+
+Integer.  Seed for the key sequence.  Default is 1.
+
+=back
+
+=h run write-only
+
+Runs the trials.
+
+=h results read-only
+
+Returns one line per successful trial: the table type, N, and the
+nanoseconds per insert, successful find, unsuccessful find, and erase.
+
+=e
+
+  b :: HashTableBench(MAX_SIZE 1000000);
+  DriverManager(write b.run, print b.results);
+
+=a HashTableTest */
+
+class HashTableBench : public Element { public:
+
+    HashTableBench();
+    ~HashTableBench();
+
+    const char *class_name() const		{ return "HashTableBench"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+  private:
+
+    uint32_t _min_size;
+    uint32_t _max_size;
+    bool _flat;
+    bool _chained;
+    uint32_t _seed;
+    String _results;
+
+    template <typename T> int run_trial(const char *name, uint32_t n, ErrorHandler *errh);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
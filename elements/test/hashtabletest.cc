@@ -1,6 +1,7 @@
 // -*- c-basic-offset: 4 -*-
 /*
  * hashtabletest.{cc,hh} -- regression test element for HashTable<K, V>
+ * FlatHashTable<K, V>, and RCUHashTable<K, V>
  * Eddie Kohler
  *
  * Copyright (c) 2008 Meraki, Inc.
@@ -19,6 +20,8 @@
 #include <click/config.h>
 #include "hashtabletest.hh"
 #include <click/hashtable.hh>
+#include <click/flathashtable.hh>
+#include <click/rcuhashtable.hh>
 #include <click/error.hh>
 #if CLICK_USERLEVEL
 # include <sys/time.h>
@@ -447,6 +450,103 @@ struct MyHashContainerEntry {
 
 typedef HashContainer<MyHashContainerEntry> MyHashContainer;
 
+static int
+check_flat(ErrorHandler *errh)
+{
+    // FlatHashTable<K, V> supports the interface tested above
+    FlatHashTable<String, int> f;
+    f.set("Foo", 1);
+    f.set("bar", 2);
+    f["facker"] = 3;
+    CHECK(f.find_insert("Anne Elizabeth Dudfield", 4).value() == 4);
+    CHECK(f.size() == 4);
+    {
+	FlatHashTable<String, int> ff(f);
+	ff.set("crap", 5);
+	CHECK(ff.size() == 5 && f.size() == 4);
+    }
+    int n = 0, sum = 0;
+    for (FlatHashTable<String, int>::iterator it = f.begin(); it; ++it) {
+	++n;
+	sum += it.value();
+	CHECK(f.get(it.key()) == it.value());
+    }
+    CHECK(n == 4 && sum == 10);
+    CHECK(f.erase("Foo") == 1 && f.erase("Foo") == 0);
+    CHECK(f.find("Foo") == f.end() && f.get("Foo") == 0);
+    CHECK(!f.set("bar", 20) && f["bar"] == 20);
+    for (FlatHashTable<String, int>::iterator it = f.begin(); it; )
+	it = f.erase(it);
+    CHECK(f.empty() && f.begin() == f.end());
+
+    // Compare against HashTable under a pseudorandom mix of insertions and
+    // removals, which exercises growth, tombstones, and wraparound.
+    FlatHashTable<uint32_t, uint32_t> flat;
+    HashTable<uint32_t, uint32_t> chained;
+    uint32_t x = 1;
+    for (int i = 0; i < 200000; ++i) {
+	x = x * 1664525 + 1013904223;
+	uint32_t key = (x >> 8) % 5000;
+	if (x & 1) {
+	    CHECK(flat.set(key, i) == chained.set(key, i));
+	} else
+	    CHECK(flat.erase(key) == chained.erase(key));
+	if (i % 10000 == 0)
+	    for (uint32_t k = 0; k < 5000; ++k)
+		CHECK(flat.get(k) == chained.get(k));
+    }
+    CHECK(flat.size() == chained.size());
+    n = 0;
+    for (FlatHashTable<uint32_t, uint32_t>::const_iterator it = flat.begin(); it; ++it, ++n)
+	CHECK(chained.get(it.key()) == it.value());
+    CHECK(n == (int) flat.size());
+    flat.rehash(100000);
+    CHECK(flat.bucket_count() >= 100000 && flat.size() == chained.size());
+    FlatHashTable<uint32_t, uint32_t> other;
+    other.swap(flat);
+    CHECK(flat.empty() && other.size() == chained.size());
+    other.clear();
+    CHECK(other.empty() && other.find(1) == other.end());
+    return 0;
+}
+
+static int
+check_rcu(ErrorHandler *errh)
+{
+    // RCUHashTable keeps erased keys as tombstones and rebuilds to drop them
+    RCUHashTable<uint32_t, uint32_t> rcu;
+    HashTable<uint32_t, uint32_t> chained;
+    uint32_t x = 1, v;
+    for (int i = 0; i < 100000; ++i) {
+	x = x * 1664525 + 1013904223;
+	uint32_t key = (x >> 8) % 3000;
+	if (x & 1) {
+	    rcu.set(key, i);
+	    chained.set(key, i);
+	} else
+	    CHECK(rcu.erase(key) == chained.erase(key));
+	if (i % 10000 == 0)
+	    for (uint32_t k = 0; k < 3000; ++k)
+		CHECK(rcu.find(k, v) ? chained.get(k) == v : !chained.get_pointer(k));
+    }
+    CHECK((size_t) rcu.size() == chained.size());
+    int n = 0;
+    uint32_t k;
+    for (int i = 0; i < rcu.slot_count(); ++i)
+	if (rcu.slot(i, k, v)) {
+	    CHECK(chained.get(k) == v);
+	    ++n;
+	}
+    CHECK(n == rcu.size());
+    RCUHashTable<uint32_t, uint32_t> other;
+    other.swap(rcu);
+    CHECK(rcu.size() == 0 && !rcu.find(1, v) && other.size() == n);
+    other.clear();
+    CHECK(other.size() == 0 && !other.find(1, v));
+    other.reclaim(true);
+    return 0;
+}
+
 int
 HashTableTest::initialize(ErrorHandler *errh)
 {
@@ -577,6 +677,9 @@ HashTableTest::initialize(ErrorHandler *errh)
 	CHECK(htx["Goodbye"] == 2);
     }
 
+    if (check_flat(errh) < 0 || check_rcu(errh) < 0)
+	return -1;
+
     errh->message("All tests pass!");
     return 0;
 }
@@ -15,8 +15,8 @@ runs regression tests for HashTable<K, V>
 
 =d
 
-HashTableTest runs HashTable regression tests at initialization time. It
-does not route packets.
+HashTableTest runs HashTable, FlatHashTable, and RCUHashTable regression tests at
+initialization time. It does not route packets.
 
 */
 
@@ -0,0 +1,198 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6tabletest.{cc,hh} -- regression test element for IP6Table
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6tabletest.hh"
+#include <click/ip6table.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+IP6TableTest::IP6TableTest()
+{
+}
+
+IP6TableTest::~IP6TableTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+namespace {
+
+struct Route {
+    IP6Address dst;
+    IP6Address mask;
+    IP6Address gw;
+    int index;
+};
+
+class Random { public:
+    Random(uint32_t seed) : _x(seed) { }
+    uint32_t operator()() {
+	_x ^= _x << 13;
+	_x ^= _x >> 17;
+	_x ^= _x << 5;
+	return _x;
+    }
+  private:
+    uint32_t _x;
+};
+
+// Addresses are drawn from a few /32s so routes nest and collide.
+IP6Address
+random_address(Random &r)
+{
+    IP6Address a;
+    uint32_t *d = a.data32();
+    d[0] = htonl(0x20010DB8 + (r() & 3));
+    d[1] = (r() & 1 ? htonl(r() & 0xFFFF0000) : r());
+    d[2] = r();
+    d[3] = r();
+    return a;
+}
+
+bool
+reference_lookup(const Vector<Route> &v, const IP6Address &a, IP6Address &gw, int &index)
+{
+    int best = -1;
+    for (int i = 0; i < v.size(); ++i)
+	if (a.matches_prefix(v[i].dst, v[i].mask)
+	    && (best < 0 || v[i].mask.mask_as_specific(v[best].mask)))
+	    best = i;
+    if (best < 0)
+	return false;
+    gw = v[best].gw;
+    index = v[best].index;
+    return true;
+}
+
+int
+find_route(const Vector<Route> &v, const IP6Address &dst, const IP6Address &mask)
+{
+    for (int i = 0; i < v.size(); ++i)
+	if (v[i].dst == dst && v[i].mask == mask)
+	    return i;
+    return -1;
+}
+
+}
+
+static int
+check_lookups(const IP6Table &t, const Vector<Route> &v, Random &r, ErrorHandler *errh)
+{
+    enum { nbatch = 20 };	// more than one batch lookup round
+    IP6Address batch[nbatch], batch_gw[nbatch];
+    int batch_index[nbatch];
+    for (int i = 0; i < 2000; ++i) {
+	// Look up route addresses themselves, and random neighbors.
+	IP6Address a = (v.size() && (i & 1) ? v[r() % v.size()].dst : random_address(r));
+	if (i % 3 == 0)
+	    a.data()[15] ^= r() & 0xFF;
+	IP6Address gw1, gw2;
+	int index1 = -1, index2 = -1;
+	bool ok1 = t.lookup(a, gw1, index1);
+	bool ok2 = reference_lookup(v, a, gw2, index2);
+	CHECK(ok1 == ok2);
+	CHECK(!ok1 || (gw1 == gw2 && index1 == index2));
+
+	// The batch lookup agrees with single lookups.
+	batch[i % nbatch] = a;
+	if (i % nbatch == nbatch - 1) {
+	    t.lookup(nbatch, batch, batch_gw, batch_index);
+	    for (int j = 0; j < nbatch; ++j) {
+		ok1 = t.lookup(batch[j], gw1, index1);
+		CHECK(ok1 ? batch_index[j] == index1 && batch_gw[j] == gw1 : batch_index[j] == -1);
+	    }
+	}
+    }
+    return 0;
+}
+
+int
+IP6TableTest::initialize(ErrorHandler *errh)
+{
+    IP6Table t;
+    Vector<Route> v;
+    Random r(1);
+    IP6Address gw;
+    int index;
+
+    // empty table
+    CHECK(!t.lookup(IP6Address(), gw, index));
+
+    // default route and host route
+    t.add(IP6Address(), IP6Address(), IP6Address("2001:db8::1"), 1);
+    t.add(IP6Address("2001:db8::5"), IP6Address::make_prefix(128), IP6Address(), 2);
+    CHECK(t.lookup(IP6Address("2001:db8::5"), gw, index) && index == 2 && !gw);
+    CHECK(t.lookup(IP6Address("2001:db8::6"), gw, index) && index == 1 && gw == IP6Address("2001:db8::1"));
+    CHECK(t.size() == 2);
+    t.del(IP6Address("2001:db8::5"), IP6Address::make_prefix(128));
+    CHECK(t.lookup(IP6Address("2001:db8::5"), gw, index) && index == 1);
+    CHECK(!t.find(IP6Address("2001:db8::5"), IP6Address::make_prefix(128), gw, index));
+    t.clear();
+    CHECK(t.size() == 0 && t.node_count() == 1);
+    CHECK(!t.lookup(IP6Address("2001:db8::5"), gw, index));
+
+    // random routes of all lengths, replacements, and a non-prefix mask
+    for (int i = 0; i < 3000; ++i) {
+	Route rt;
+	int plen = (i % 5 ? 16 + r() % 49 : r() % 129);
+	rt.mask = IP6Address::make_prefix(plen);
+	rt.dst = random_address(r) & rt.mask;
+	rt.gw = (r() & 1 ? random_address(r) : IP6Address());
+	rt.index = r() % 8;
+	int j = find_route(v, rt.dst, rt.mask);
+	if (j >= 0)
+	    v[j] = rt;
+	else
+	    v.push_back(rt);
+	t.add(rt.dst, rt.mask, rt.gw, rt.index);
+    }
+    {
+	Route rt;
+	rt.dst = IP6Address("2001:db8:1::ff");
+	rt.mask = IP6Address("ffff:ffff:ffff::ff");
+	rt.index = 9;
+	v.push_back(rt);
+	t.add(rt.dst, rt.mask, rt.gw, rt.index);
+    }
+    CHECK(t.size() == v.size());
+    CHECK(t.find(v[7].dst, v[7].mask, gw, index) && gw == v[7].gw && index == v[7].index);
+    if (check_lookups(t, v, r, errh) < 0)
+	return -1;
+
+    // remove about half the routes, then the rest
+    for (int i = v.size() - 1; i >= 0; i -= 1 + (r() & 1)) {
+	t.del(v[i].dst, v[i].mask);
+	v[i] = v.back();
+	v.pop_back();
+    }
+    CHECK(t.size() == v.size());
+    if (check_lookups(t, v, r, errh) < 0)
+	return -1;
+    while (v.size()) {
+	t.del(v.back().dst, v.back().mask);
+	v.pop_back();
+    }
+    CHECK(t.size() == 0);
+    CHECK(t.node_count() == 1);
+    CHECK(!t.lookup(random_address(r), gw, index));
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IP6TableTest)
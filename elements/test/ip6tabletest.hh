@@ -0,0 +1,37 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IP6TABLETEST_HH
+#define CLICK_IP6TABLETEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IP6TableTest()
+
+=s test
+
+runs regression tests for IP6Table
+
+=d
+
+IP6TableTest runs IP6Table regression tests at initialization time.  It
+checks longest-prefix lookups against a linear search over a reference list
+of routes while routes are added, replaced, and removed.  It does not route
+packets.
+
+*/
+
+class IP6TableTest : public Element { public:
+
+    IP6TableTest();
+    ~IP6TableTest();
+
+    const char *class_name() const		{ return "IP6TableTest"; }
+
+    int initialize(ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,134 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iproutetablebench.{cc,hh} -- benchmark IPRouteTable lookups
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iproutetablebench.hh"
+#include "elements/ip/iproutetable.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+IPRouteTableBench::IPRouteTableBench()
+    : _table(0), _check(0)
+{
+}
+
+IPRouteTableBench::~IPRouteTableBench()
+{
+}
+
+int
+IPRouteTableBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _lookups = 1000000;
+    _batch = 0;
+    _repeat = 1;
+    _seed = 1;
+    if (Args(conf, this, errh)
+	.read_mp("TABLE", ElementCastArg("IPRouteTable"), _table)
+	.read("LOOKUPS", _lookups)
+	.read("BATCH", _batch)
+	.read("REPEAT", _repeat)
+	.read("SEED", _seed)
+	.read("CHECK", ElementCastArg("IPRouteTable"), _check)
+	.complete() < 0)
+	return -1;
+    if (_lookups < 1 || _repeat < 1)
+	return errh->error("LOOKUPS and REPEAT must be positive");
+    return 0;
+}
+
+int
+IPRouteTableBench::run_trial(ErrorHandler *errh)
+{
+    // xorshift32, so that trials are repeatable across platforms
+    Vector<IPAddress> addr(_lookups, IPAddress());
+    uint32_t x = _seed ? _seed : 1;
+    for (uint32_t i = 0; i < _lookups; ++i) {
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	addr[i] = IPAddress(htonl(x));
+    }
+    Vector<IPAddress> gw(_lookups, IPAddress());
+    Vector<int> port(_lookups, -1);
+
+    click_cycles_t c0 = click_get_cycles();
+    Timestamp t0 = Timestamp::now_steady();
+    if (_batch > 0) {
+	for (uint32_t i = 0; i < _lookups; i += _batch) {
+	    int n = (_lookups - i < (uint32_t) _batch ? _lookups - i : _batch);
+	    for (int r = 0; r < _repeat; ++r)
+		_table->lookup_routes(n, &addr[i], &gw[i], &port[i]);
+	}
+    } else {
+	for (uint32_t i = 0; i < _lookups; ++i)
+	    for (int r = 0; r < _repeat; ++r)
+		port[i] = _table->lookup_route(addr[i], gw[i]);
+    }
+    Timestamp elapsed = Timestamp::now_steady() - t0;
+    click_cycles_t cycles = click_get_cycles() - c0;
+
+    uint32_t mismatches = 0;
+    if (_check)
+	for (uint32_t i = 0; i < _lookups; ++i) {
+	    IPAddress cgw;
+	    int cport = _check->lookup_route(addr[i], cgw);
+	    if (cport != port[i] || (cport >= 0 && cgw != gw[i])) {
+		if (++mismatches <= 5)
+		    errh->error("%s: %s: got %d %s, expected %d %s",
+				declaration().c_str(), addr[i].unparse().c_str(),
+				port[i], gw[i].unparse().c_str(),
+				cport, cgw.unparse().c_str());
+	    }
+	}
+
+    double per_lookup = (double) cycles / ((double) _lookups * _repeat);
+    double rate = _lookups * _repeat / (elapsed.doubleval() ? elapsed.doubleval() : 1e-9);
+    errh->message("%s: %u lookups, %.0f cycles/lookup, %.2fM lookups/s",
+		  declaration().c_str(), _lookups, per_lookup, rate / 1e6);
+    StringAccum sa;
+    sa << _lookups << ' ' << (uint64_t) per_lookup << ' ' << (uint64_t) rate
+       << ' ' << mismatches << '\n';
+    _results += sa.take_string();
+    return mismatches ? -1 : 0;
+}
+
+String
+IPRouteTableBench::read_handler(Element *e, void *)
+{
+    IPRouteTableBench *b = static_cast<IPRouteTableBench *>(e);
+    return b->_results;
+}
+
+int
+IPRouteTableBench::write_handler(const String &, Element *e, void *, ErrorHandler *errh)
+{
+    IPRouteTableBench *b = static_cast<IPRouteTableBench *>(e);
+    return b->run_trial(errh);
+}
+
+void
+IPRouteTableBench::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+    add_write_handler("run", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRouteTable)
+EXPORT_ELEMENT(IPRouteTableBench)
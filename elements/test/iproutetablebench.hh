@@ -0,0 +1,102 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPROUTETABLEBENCH_HH
+#define CLICK_IPROUTETABLEBENCH_HH
+#include <click/element.hh>
+#include <click/ipaddress.hh>
+CLICK_DECLS
+class IPRouteTable;
+
+/*
+=c
+
+IPRouteTableBench(TABLE [, I<keywords>])
+
+=s test
+
+measures IP routing table lookup speed
+
+=d
+
+Measures how fast the IPRouteTable element TABLE looks up routes.  Each
+trial looks up LOOKUPS pseudorandom destination addresses, drawn uniformly
+from the IPv4 address space, and reports the cycles per lookup and lookups per
+second.  Trials run when the C<run> handler is written.
+
+Keyword arguments are:
+
+=over 8
+
+=item LOOKUPS
+
+Integer.  Number of addresses looked up per trial.  Default is 1000000.
+
+=item BATCH
+
+Integer.  If positive, look addresses up BATCH at a time through TABLE's
+batched C<lookup_routes> interface.  Default is 0, meaning look up one address
+at a time with C<lookup_route>.
+
+=item REPEAT
+
+Integer.  Look up each address REPEAT times in a row, so that most lookups
+hit in cache.  Values greater than 1 measure "warm cache" performance.
+Default is 1.
+
+=item SEED
+
+Integer.  Seed for the address sequence.  Default is 1.
+
+=item CHECK
+
+Element.  An IPRouteTable with the same routes as TABLE.  After each trial,
+every address is also looked up in CHECK, and any differences are reported.
+
+=back
+
+=h run write-only
+
+Runs a trial.
+
+=h results read-only
+
+Returns one line per completed trial: the number of lookups, cycles per
+lookup, lookups per second, and the number of results that differed from
+CHECK.
+
+=e
+
+  r :: DXRIPLookup(...);
+  b :: IPRouteTableBench(r, BATCH 16);
+  DriverManager(write b.run, print b.results);
+
+=a IPRouteTable, DXRIPLookup */
+
+class IPRouteTableBench : public Element { public:
+
+    IPRouteTableBench();
+    ~IPRouteTableBench();
+
+    const char *class_name() const		{ return "IPRouteTableBench"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+  private:
+
+    IPRouteTable *_table;
+    IPRouteTable *_check;
+    uint32_t _lookups;
+    int _batch;
+    int _repeat;
+    uint32_t _seed;
+    String _results;
+
+    int run_trial(ErrorHandler *errh);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,96 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * packetbatchtest.{cc,hh} -- regression test element for PacketBatch
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "packetbatchtest.hh"
+#include <click/packetbatch.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+PacketBatchTest::PacketBatchTest()
+{
+}
+
+PacketBatchTest::~PacketBatchTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+int
+PacketBatchTest::initialize(ErrorHandler *errh)
+{
+    const unsigned char *lowers = (const unsigned char *)"abcdefghijklmnopqrstuvwxyz";
+    PacketBatch batch;
+    Packet *p;
+    int n;
+
+    CHECK(batch.empty() && batch.count() == 0);
+    CHECK(!batch.front() && !batch.back() && !batch.pop_front());
+
+    for (int i = 0; i < 4; ++i)
+	batch.push_back(Packet::make(0, lowers + i, 1, 0));
+    batch.push_front(Packet::make(0, lowers + 25, 1, 0));
+    CHECK(batch.count() == 5);
+    CHECK(batch.front()->data()[0] == 'z' && batch.back()->data()[0] == 'd');
+    CHECK(!batch.back()->next());
+    n = 0;
+    for (p = batch.front(); p; p = p->next())
+	++n;
+    CHECK(n == 5);
+
+    PacketBatch other;
+    other.push_back(Packet::make(0, lowers + 4, 1, 0));
+    batch.append(other);
+    CHECK(other.empty() && other.count() == 0 && !other.back());
+    CHECK(batch.count() == 6 && batch.back()->data()[0] == 'e');
+    batch.append(other);
+    CHECK(batch.count() == 6);
+
+    p = batch.pop_front();
+    CHECK(p->data()[0] == 'z' && !p->next() && batch.count() == 5);
+    p->kill();
+
+    batch.swap(other);
+    CHECK(batch.empty() && other.count() == 5);
+    CHECK(other.front()->data()[0] == 'a' && other.back()->data()[0] == 'e');
+
+    p = other.take();
+    CHECK(other.empty() && !other.front() && !other.back());
+    for (n = 0; p; ++n) {
+	Packet *next = p->next();
+	CHECK(p->data()[0] == 'a' + n);
+	p->kill();
+	p = next;
+    }
+    CHECK(n == 5);
+
+    // a single-packet batch can be drained and refilled
+    batch.push_back(Packet::make(0, lowers, 1, 0));
+    p = batch.pop_front();
+    CHECK(batch.empty() && !batch.back());
+    batch.push_back(p);
+    CHECK(batch.front() == p && batch.back() == p && batch.count() == 1);
+
+    batch.push_back(Packet::make(0, lowers, 1, 0));
+    batch.kill();
+    CHECK(batch.empty() && batch.count() == 0 && !batch.front());
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(PacketBatchTest)
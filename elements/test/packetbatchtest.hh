@@ -0,0 +1,37 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETBATCHTEST_HH
+#define CLICK_PACKETBATCHTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+PacketBatchTest()
+
+=s test
+
+runs regression tests for PacketBatch
+
+=d
+
+PacketBatchTest runs PacketBatch regression tests at initialization time. It
+does not route packets.
+
+=a
+
+PacketTest */
+
+class PacketBatchTest : public Element { public:
+
+    PacketBatchTest();
+    ~PacketBatchTest();
+
+    const char *class_name() const		{ return "PacketBatchTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
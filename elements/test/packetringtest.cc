@@ -0,0 +1,90 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * packetringtest.{cc,hh} -- regression test element for PacketRing
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "packetringtest.hh"
+#include <click/packetring.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+PacketRingTest::PacketRingTest()
+{
+}
+
+PacketRingTest::~PacketRingTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+int
+PacketRingTest::initialize(ErrorHandler *errh)
+{
+    const unsigned char *lowers = (const unsigned char *)"abcdefghijklmnopqrstuvwxyz";
+    PacketRing ring;
+    Packet *p;
+
+    CHECK(ring.capacity() == 0 && ring.empty() && ring.full());
+    p = Packet::make(0, lowers, 1, 0);
+    CHECK(!ring.push_back(p) && !ring.pop_front());
+    p->kill();
+
+    // capacity need not be a power of two
+    CHECK(ring.initialize(5));
+    CHECK(ring.capacity() == 5 && ring.size() == 0 && !ring.front());
+    for (int i = 0; i < 5; ++i)
+	CHECK(ring.push_back(Packet::make(0, lowers + i, 1, 0)));
+    CHECK(ring.full() && ring.size() == 5);
+    p = Packet::make(0, lowers + 5, 1, 0);
+    CHECK(!ring.push_back(p));
+    CHECK(ring.front()->data()[0] == 'a' && ring[4]->data()[0] == 'e');
+
+    // wrap around the slot array many times
+    for (int i = 0; i < 100; ++i) {
+	Packet *q = ring.pop_front();
+	CHECK(q && q->data()[0] == 'a' + i % 6);
+	CHECK(ring.push_back(p));
+	p = q;
+    }
+    CHECK(ring.size() == 5 && ring.front()->data()[0] == 'a' + 100 % 6);
+    p->kill();
+
+    PacketBatch batch;
+    CHECK(ring.pop_batch(batch, 0) == 0 && ring.pop_batch(batch, -1) == 0);
+    CHECK(ring.pop_batch(batch, 3) == 3 && ring.size() == 2);
+    CHECK(batch.count() == 3 && batch.front()->data()[0] == 'a' + 100 % 6);
+    for (int i = 0; i < 4; ++i)
+	batch.push_back(Packet::make(0, lowers + 10 + i, 1, 0));
+    CHECK(ring.push_batch(batch) == 3 && ring.full() && batch.count() == 4);
+    CHECK(ring.pop_batch(batch, 10) == 5 && ring.empty() && batch.count() == 9);
+    CHECK(batch.back()->data()[0] == 'a' + 102 % 6);
+    CHECK(ring.push_batch(batch) == 5 && batch.count() == 4);
+    batch.kill();
+
+    // clear kills; reinitializing an empty ring changes its capacity
+    ring.clear();
+    CHECK(ring.empty() && !ring.pop_front());
+    CHECK(ring.initialize(64) && ring.capacity() == 64);
+    for (int i = 0; i < 64; ++i)
+	CHECK(ring.push_back(Packet::make(0, lowers + i % 26, 1, 0)));
+    CHECK(ring.full() && ring[63]->data()[0] == 'a' + 63 % 26);
+    // the destructor kills the rest
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(PacketRingTest)
@@ -0,0 +1,37 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETRINGTEST_HH
+#define CLICK_PACKETRINGTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+PacketRingTest()
+
+=s test
+
+runs regression tests for PacketRing
+
+=d
+
+PacketRingTest runs PacketRing regression tests at initialization time. It
+does not route packets.
+
+=a
+
+PacketBatchTest */
+
+class PacketRingTest : public Element { public:
+
+    PacketRingTest();
+    ~PacketRingTest();
+
+    const char *class_name() const		{ return "PacketRingTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
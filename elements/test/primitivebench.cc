@@ -0,0 +1,491 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * primitivebench.{cc,hh} -- benchmark core containers and primitives
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "primitivebench.hh"
+#include <click/hashtable.hh>
+#include <click/hashmap.hh>
+#include <click/vector.hh>
+#include <click/deque.hh>
+#include <click/heap.hh>
+#include <click/ipflowid.hh>
+#include <click/packet.hh>
+#include <click/timer.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+const PrimitiveBench::Group PrimitiveBench::groups[] = {
+    { "hashtable", &PrimitiveBench::bench_hashtable },
+    { "hashmap", &PrimitiveBench::bench_hashmap },
+    { "vector", &PrimitiveBench::bench_vector },
+    { "deque", &PrimitiveBench::bench_deque },
+    { "string", &PrimitiveBench::bench_string },
+    { "straccum", &PrimitiveBench::bench_straccum },
+    { "heap", &PrimitiveBench::bench_heap },
+    { "timer", &PrimitiveBench::bench_timer },
+    { "ipflowid", &PrimitiveBench::bench_ipflowid },
+    { "packet", &PrimitiveBench::bench_packet },
+    { 0, 0 }
+};
+
+PrimitiveBench::PrimitiveBench()
+    : _sink(0), _errh(0)
+{
+}
+
+PrimitiveBench::~PrimitiveBench()
+{
+}
+
+int
+PrimitiveBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String bench;
+    _size = 10000;
+    _rounds = 100;
+    _seed = 1;
+    if (Args(conf, this, errh)
+	.read("BENCH", AnyArg(), bench)
+	.read("SIZE", _size)
+	.read("ROUNDS", _rounds)
+	.read("SEED", _seed)
+	.complete() < 0)
+	return -1;
+    if (_size < 1 || _rounds < 1)
+	return errh->error("SIZE and ROUNDS must be positive");
+
+    if (!bench) {
+	_groups = ~0U;
+	return 0;
+    }
+    _groups = 0;
+    Vector<String> words;
+    cp_spacevec(bench, words);
+    for (String *w = words.begin(); w != words.end(); ++w) {
+	int g;
+	for (g = 0; groups[g].name && *w != groups[g].name; ++g)
+	    /* nada */;
+	if (!groups[g].name)
+	    return errh->error("unknown benchmark %<%s%>", w->c_str());
+	_groups |= 1U << g;
+    }
+    return 0;
+}
+
+// Keys are i * an odd constant, plus the seed: distinct for distinct i.
+inline uint32_t
+PrimitiveBench::key(uint32_t i) const
+{
+    return i * 2654435761U + _seed;
+}
+
+// A stride relatively prime to _size, so that (j + stride) % _size visits
+// every index in an order unrelated to insertion order.
+inline uint32_t
+PrimitiveBench::stride() const
+{
+    uint32_t stride = 40503;
+    while (_size % stride == 0 || stride % _size == 0)
+	stride += 2;
+    return stride % _size ? stride % _size : 1;
+}
+
+void
+PrimitiveBench::record(const char *name, const Timestamp &elapsed)
+{
+    double ns = elapsed.doubleval() * 1e9 / ((double) _size * _rounds);
+    _errh->message("%s: %s: %.2f ns/op", declaration().c_str(), name, ns);
+    StringAccum sa;
+    sa << name << ' ' << ns << '\n';
+    _results += sa.take_string();
+}
+
+template <typename T> void
+PrimitiveBench::bench_map(const char *prefix)
+{
+    uint32_t s = stride(), found = 0;
+    Timestamp insert, find, miss, erase;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	T table;
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    table.set(key(i), i);
+	Timestamp t1 = Timestamp::now_steady();
+	for (uint32_t i = 0, j = 0; i < _size; ++i, j = (j + s) % _size)
+	    found += table.get(key(j)) == j;
+	Timestamp t2 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    found += table.get(key(_size + i)) != 0;
+	Timestamp t3 = Timestamp::now_steady();
+	for (uint32_t i = 0, j = 0; i < _size; ++i, j = (j + s) % _size)
+	    table.erase(key(j));
+	Timestamp t4 = Timestamp::now_steady();
+	insert += t1 - t0;
+	find += t2 - t1;
+	miss += t3 - t2;
+	erase += t4 - t3;
+	if (!table.empty())
+	    found = 0;
+    }
+    if (found != _size * _rounds)
+	_errh->error("%s: %s lookups failed", declaration().c_str(), prefix);
+    String p(prefix);
+    record((p + "_insert").c_str(), insert);
+    record((p + "_find").c_str(), find);
+    record((p + "_miss").c_str(), miss);
+    record((p + "_erase").c_str(), erase);
+}
+
+void
+PrimitiveBench::bench_hashtable()
+{
+    bench_map<HashTable<uint32_t, uint32_t> >("hashtable");
+}
+
+namespace {
+// Adapts HashMap to the HashTable interface bench_map uses.
+struct BenchHashMap : public HashMap<uint32_t, uint32_t> {
+    void set(uint32_t k, uint32_t v) {
+	insert(k, v);
+    }
+    uint32_t get(uint32_t k) const {
+	return find(k);
+    }
+};
+}
+
+void
+PrimitiveBench::bench_hashmap()
+{
+    bench_map<BenchHashMap>("hashmap");
+}
+
+void
+PrimitiveBench::bench_vector()
+{
+    Timestamp push, index, pop;
+    uint32_t sum = 0;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Vector<uint32_t> v;
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    v.push_back(i);
+	Timestamp t1 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    sum += v[i];
+	Timestamp t2 = Timestamp::now_steady();
+	while (v.size()) {
+	    sum += v.back();
+	    v.pop_back();
+	}
+	Timestamp t3 = Timestamp::now_steady();
+	push += t1 - t0;
+	index += t2 - t1;
+	pop += t3 - t2;
+    }
+    _sink += sum;
+    record("vector_push_back", push);
+    record("vector_index", index);
+    record("vector_pop_back", pop);
+}
+
+void
+PrimitiveBench::bench_deque()
+{
+    Timestamp push, index, pop;
+    uint32_t sum = 0;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Deque<uint32_t> q;
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    q.push_back(i);
+	Timestamp t1 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    sum += q[i];
+	Timestamp t2 = Timestamp::now_steady();
+	while (q.size()) {
+	    sum += q.front();
+	    q.pop_front();
+	}
+	Timestamp t3 = Timestamp::now_steady();
+	push += t1 - t0;
+	index += t2 - t1;
+	pop += t3 - t2;
+    }
+    _sink += sum;
+    record("deque_push_back", push);
+    record("deque_index", index);
+    record("deque_pop_front", pop);
+}
+
+void
+PrimitiveBench::bench_string()
+{
+    static const char text[] = "The quick brown fox jumps over the lazy dog";
+    Timestamp make, copy, append, compare, hash;
+    uint32_t sum = 0;
+    Vector<String> v(_size, String());
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    v[i] = String(text + (key(i) % 16), 24);
+	Timestamp t1 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i) {
+	    String s(v[i]);
+	    sum += s.length();
+	}
+	Timestamp t2 = Timestamp::now_steady();
+	String a;
+	for (uint32_t i = 0; i < _size; ++i)
+	    a += "abcdefgh";
+	Timestamp t3 = Timestamp::now_steady();
+	for (uint32_t i = 1; i < _size; ++i)
+	    sum += v[i] == v[i - 1];
+	Timestamp t4 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    sum += v[i].hashcode();
+	Timestamp t5 = Timestamp::now_steady();
+	sum += a.length();
+	make += t1 - t0;
+	copy += t2 - t1;
+	append += t3 - t2;
+	compare += t4 - t3;
+	hash += t5 - t4;
+    }
+    _sink += sum;
+    record("string_make", make);
+    record("string_copy", copy);
+    record("string_append", append);
+    record("string_compare", compare);
+    record("string_hash", hash);
+}
+
+void
+PrimitiveBench::bench_straccum()
+{
+    Timestamp chars, strings, numbers;
+    uint32_t sum = 0;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	StringAccum sa;
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    sa << (char) ('a' + (i & 15));
+	Timestamp t1 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    sa << "abcdefgh";
+	Timestamp t2 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    sa << key(i);
+	Timestamp t3 = Timestamp::now_steady();
+	sum += sa.length();
+	chars += t1 - t0;
+	strings += t2 - t1;
+	numbers += t3 - t2;
+    }
+    _sink += sum;
+    record("straccum_char", chars);
+    record("straccum_string", strings);
+    record("straccum_number", numbers);
+}
+
+// heap.hh's binary heap functions are not templated on arity.
+template <int arity> static inline void
+bench_push_heap(uint32_t *begin, uint32_t *end, less<uint32_t> comp)
+{
+    push_heap<arity>(begin, end, comp);
+}
+
+template <> inline void
+bench_push_heap<2>(uint32_t *begin, uint32_t *end, less<uint32_t> comp)
+{
+    push_heap(begin, end, comp);
+}
+
+template <int arity> static inline void
+bench_pop_heap(uint32_t *begin, uint32_t *end, less<uint32_t> comp)
+{
+    pop_heap<arity>(begin, end, comp);
+}
+
+template <> inline void
+bench_pop_heap<2>(uint32_t *begin, uint32_t *end, less<uint32_t> comp)
+{
+    pop_heap(begin, end, comp);
+}
+
+template <int arity> void
+PrimitiveBench::bench_heap_arity(const char *push, const char *pop)
+{
+    Timestamp tpush, tpop;
+    uint32_t sum = 0;
+    less<uint32_t> comp;
+    Vector<uint32_t> v;
+    v.reserve(_size);
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i) {
+	    v.push_back(key(i + r));
+	    bench_push_heap<arity>(v.begin(), v.end(), comp);
+	}
+	Timestamp t1 = Timestamp::now_steady();
+	while (v.size()) {
+	    sum += v[0];
+	    bench_pop_heap<arity>(v.begin(), v.end(), comp);
+	    v.pop_back();
+	}
+	Timestamp t2 = Timestamp::now_steady();
+	tpush += t1 - t0;
+	tpop += t2 - t1;
+    }
+    _sink += sum;
+    record(push, tpush);
+    record(pop, tpop);
+}
+
+void
+PrimitiveBench::bench_heap()
+{
+    bench_heap_arity<2>("heap2_push", "heap2_pop");
+    bench_heap_arity<4>("heap4_push", "heap4_pop");
+    bench_heap_arity<8>("heap8_push", "heap8_pop");
+}
+
+void
+PrimitiveBench::bench_timer()
+{
+    Timer *timers = new Timer[_size];
+    for (uint32_t i = 0; i < _size; ++i) {
+	timers[i].assign();
+	timers[i].initialize(this);
+    }
+    Timestamp schedule, reschedule, unschedule;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Timestamp base = Timestamp::now_steady() + Timestamp(3600);
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    timers[i].schedule_at_steady(base + Timestamp::make_usec(key(i + r) & 0xFFFFFF));
+	Timestamp t1 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    timers[i].schedule_at_steady(base + Timestamp::make_usec(key(i + r + 1) & 0xFFFFFF));
+	Timestamp t2 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    timers[i].unschedule();
+	Timestamp t3 = Timestamp::now_steady();
+	schedule += t1 - t0;
+	reschedule += t2 - t1;
+	unschedule += t3 - t2;
+    }
+    delete[] timers;
+    record("timer_schedule", schedule);
+    record("timer_reschedule", reschedule);
+    record("timer_unschedule", unschedule);
+}
+
+void
+PrimitiveBench::bench_ipflowid()
+{
+    Vector<IPFlowID> flows;
+    flows.reserve(_size);
+    for (uint32_t i = 0; i < _size; ++i)
+	flows.push_back(IPFlowID(IPAddress(key(4 * i)), key(4 * i + 1),
+				 IPAddress(key(4 * i + 2)), key(4 * i + 3)));
+    Timestamp hash;
+    uint32_t sum = 0;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Timestamp t0 = Timestamp::now_steady();
+	for (const IPFlowID *f = flows.begin(); f != flows.end(); ++f)
+	    sum += f->hashcode();
+	hash += Timestamp::now_steady() - t0;
+    }
+    _sink += sum;
+    record("ipflowid_hash", hash);
+}
+
+void
+PrimitiveBench::bench_packet()
+{
+    Packet **p = new Packet *[_size];
+    Packet **q = new Packet *[_size];
+    Timestamp make, clone, uniqueify, kill;
+    uint32_t made = 0;
+    for (uint32_t r = 0; r < _rounds; ++r) {
+	Timestamp t0 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    p[i] = Packet::make(64);
+	Timestamp t1 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    q[i] = p[i] ? p[i]->clone() : 0;
+	Timestamp t2 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i)
+	    if (q[i])
+		q[i] = q[i]->uniqueify();
+	Timestamp t3 = Timestamp::now_steady();
+	for (uint32_t i = 0; i < _size; ++i) {
+	    if (p[i])
+		p[i]->kill();
+	    if (q[i]) {
+		q[i]->kill();
+		++made;
+	    }
+	}
+	Timestamp t4 = Timestamp::now_steady();
+	make += t1 - t0;
+	clone += t2 - t1;
+	uniqueify += t3 - t2;
+	// Each round kills two packets per operation.
+	kill += (t4 - t3) / 2;
+    }
+    delete[] p;
+    delete[] q;
+    if (made != _size * _rounds)
+	_errh->error("%s: out of memory", declaration().c_str());
+    record("packet_make", make);
+    record("packet_clone", clone);
+    record("packet_uniqueify", uniqueify);
+    record("packet_kill", kill);
+}
+
+String
+PrimitiveBench::read_handler(Element *e, void *)
+{
+    PrimitiveBench *b = static_cast<PrimitiveBench *>(e);
+    return b->_results;
+}
+
+int
+PrimitiveBench::write_handler(const String &, Element *e, void *, ErrorHandler *errh)
+{
+    PrimitiveBench *b = static_cast<PrimitiveBench *>(e);
+    int before = errh->nerrors();
+    b->_errh = errh;
+    for (int g = 0; groups[g].name; ++g)
+	if (b->_groups & (1U << g))
+	    (b->*groups[g].run)();
+    b->_errh = 0;
+    return errh->nerrors() == before ? 0 : -1;
+}
+
+void
+PrimitiveBench::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+    add_write_handler("run", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(PrimitiveBench)
@@ -0,0 +1,167 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PRIMITIVEBENCH_HH
+#define CLICK_PRIMITIVEBENCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+PrimitiveBench([I<keywords> BENCH, SIZE, ROUNDS, SEED])
+
+=s test
+
+measures the speed of core library containers and primitives
+
+=d
+
+Measures the time per operation of Click's core containers and primitives, so
+that changes to them can be evaluated.  Each benchmark runs ROUNDS rounds of
+SIZE operations and reports the average nanoseconds per operation.  Benchmarks
+are grouped as follows:
+
+=over 8
+
+=item hashtable
+
+HashTable<uint32_t, uint32_t>: insert SIZE distinct pseudorandom keys, find
+them in a different order, find SIZE absent keys, and erase them.
+
+=item hashmap
+
+The same for HashMap<uint32_t, uint32_t>.  (BigHashMap is another name for
+HashMap.)
+
+=item vector
+
+Vector<uint32_t>: push_back onto an empty vector, including growth, indexed
+reads, and pop_back.
+
+=item deque
+
+Deque<uint32_t>: push_back, indexed reads, and pop_front, as a FIFO queue.
+
+=item string
+
+String: construction from a C string, copying (a reference count update),
+appending a short string, comparison, and hashing.
+
+=item straccum
+
+StringAccum: appending characters, short strings, and decimal integers.
+
+=item heap
+
+Binary, 4-ary, and 8-ary heaps from E<lt>click/heap.hhE<gt>: push_heap of pseudorandom
+values, then pop_heap until empty.
+
+=item timer
+
+Timers in the current thread's TimerSet: schedule SIZE timers at pseudorandom
+times at least an hour away, schedule each one again at a new time, then
+unschedule them.
+
+=item ipflowid
+
+IPFlowID::hashcode() of pseudorandom flow IDs.
+
+=item packet
+
+Packet::make of 64-byte packets, Packet::clone, uniqueify of a clone (which
+copies the data), and Packet::kill.
+
+=back
+
+Benchmarks run when the C<run> handler is written, on the writing thread.
+Run times are measured with Timestamp::now_steady(), so ROUNDS * SIZE should be
+large enough that each benchmark takes at least a millisecond or so.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCH
+
+Space-separated list of benchmark groups to run.  Default is all of them.
+
+=item SIZE
+
+Integer.  Number of elements per round; for example, the size of each
+hash table.  Default is 10000.
+
+=item ROUNDS
+
+Integer.  Number of rounds.  Default is 100.
+
+=item SEED
+
+Integer.  Seed for pseudorandom values.  Default is 1.
+
+=back
+
+=h run write-only
+
+Runs the benchmarks.
+
+=h results read-only
+
+Returns one line per benchmark run so far: the benchmark name, for example
+C<hashtable_find>, and the nanoseconds per operation.
+
+=e
+
+  b :: PrimitiveBench(BENCH hashtable heap, SIZE 100000, ROUNDS 10);
+  DriverManager(write b.run, print b.results);
+
+=a HashTableBench */
+
+class PrimitiveBench : public Element { public:
+
+    PrimitiveBench();
+    ~PrimitiveBench();
+
+    const char *class_name() const		{ return "PrimitiveBench"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+  private:
+
+    uint32_t _groups;
+    uint32_t _size;
+    uint32_t _rounds;
+    uint32_t _seed;
+    uint32_t _sink;
+    ErrorHandler *_errh;
+    String _results;
+
+    struct Group {
+	const char *name;
+	void (PrimitiveBench::*run)();
+    };
+    static const Group groups[];
+
+    inline uint32_t key(uint32_t i) const;
+    inline uint32_t stride() const;
+    void record(const char *name, const Timestamp &elapsed);
+
+    template <typename T> void bench_map(const char *prefix);
+    void bench_hashtable();
+    void bench_hashmap();
+    void bench_vector();
+    void bench_deque();
+    void bench_string();
+    void bench_straccum();
+    template <int arity> void bench_heap_arity(const char *push, const char *pop);
+    void bench_heap();
+    void bench_timer();
+    void bench_ipflowid();
+    void bench_packet();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,188 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * queuethreadbench.{cc,hh} -- benchmark queues with concurrent pushers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "queuethreadbench.hh"
+#include "elements/standard/simplequeue.hh"
+#include "elements/standard/mpscqueue.hh"
+#include <click/args.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <sched.h>
+CLICK_DECLS
+
+QueueThreadBench::QueueThreadBench()
+    : _task(this), _queue(0), _go(false)
+{
+}
+
+QueueThreadBench::~QueueThreadBench()
+{
+}
+
+int
+QueueThreadBench::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _producers = 16;
+    _packets = 1000000;
+    _stop = false;
+    if (Args(conf, this, errh)
+	.read_mp("QUEUE", _queue)
+	.read("PRODUCERS", _producers)
+	.read("PACKETS", _packets)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (!_queue->cast("SimpleQueue") && !_queue->cast("MPSCQueue"))
+	return errh->error("%<%s%> is not a SimpleQueue or MPSCQueue", _queue->name().c_str());
+    if (_producers < 1)
+	return errh->error("PRODUCERS must be positive");
+    return 0;
+}
+
+int
+QueueThreadBench::initialize(ErrorHandler *)
+{
+    _task.initialize(this, true);
+    return 0;
+}
+
+int
+QueueThreadBench::queue_size() const
+{
+    if (SimpleQueue *q = static_cast<SimpleQueue *>(_queue->cast("SimpleQueue")))
+	return q->size();
+    else
+	return static_cast<MPSCQueue *>(_queue)->size();
+}
+
+int
+QueueThreadBench::queue_capacity() const
+{
+    if (SimpleQueue *q = static_cast<SimpleQueue *>(_queue->cast("SimpleQueue")))
+	return q->capacity();
+    else
+	return static_cast<MPSCQueue *>(_queue)->capacity();
+}
+
+int
+QueueThreadBench::queue_drops() const
+{
+    if (SimpleQueue *q = static_cast<SimpleQueue *>(_queue->cast("SimpleQueue")))
+	return q->drops();
+    else
+	return static_cast<MPSCQueue *>(_queue)->drops();
+}
+
+void *
+QueueThreadBench::producer_thread(void *arg)
+{
+    Producer *pr = static_cast<Producer *>(arg);
+    QueueThreadBench *b = pr->bench;
+    int capacity = b->queue_capacity();
+    Packet *p = Packet::make(64);
+
+    while (!b->_go)
+	sched_yield();
+
+    for (uint32_t i = 0; i < pr->count; ++i) {
+	while (b->queue_size() >= capacity)
+	    sched_yield();
+	b->_queue->push(0, p->clone());
+    }
+
+    p->kill();
+    return 0;
+}
+
+void
+QueueThreadBench::run_trial(int nproducers, ErrorHandler *errh)
+{
+    Vector<Producer> producers(nproducers, Producer());
+    _go = false;
+    for (int i = 0; i < nproducers; ++i) {
+	producers[i].bench = this;
+	producers[i].count = _packets / nproducers
+	    + (i < (int) (_packets % nproducers));
+	int err = pthread_create(&producers[i].thread, 0, producer_thread, &producers[i]);
+	if (err != 0) {
+	    errh->error("cannot start thread: %s", strerror(err));
+	    nproducers = i;
+	    break;
+	}
+    }
+
+    uint32_t total = 0;
+    for (int i = 0; i < nproducers; ++i)
+	total += producers[i].count;
+    int drops0 = queue_drops();
+    uint32_t npulled = 0, ndropped = 0;
+
+    Timestamp start = Timestamp::now_steady();
+    _go = true;
+    while (npulled + ndropped < total) {
+	if (Packet *p = _queue->pull(0)) {
+	    p->kill();
+	    ++npulled;
+	} else {
+	    ndropped = queue_drops() - drops0;
+	    sched_yield();
+	}
+    }
+    Timestamp elapsed = Timestamp::now_steady() - start;
+
+    for (int i = 0; i < nproducers; ++i)
+	pthread_join(producers[i].thread, 0);
+
+    double rate = npulled / (elapsed.doubleval() ? elapsed.doubleval() : 1e-9);
+    errh->message("%s: %d producers: %u packets, %u drops, %.0f packets/s",
+		  declaration().c_str(), nproducers, npulled, ndropped, rate);
+    StringAccum sa;
+    sa << nproducers << ' ' << npulled << ' ' << ndropped << ' '
+       << (uint64_t) rate << '\n';
+    _results += sa.take_string();
+}
+
+bool
+QueueThreadBench::run_task(Task *)
+{
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    for (int n = 1; n <= _producers; n *= 2) {
+	run_trial(n, errh);
+	if (n < _producers && n * 2 > _producers)
+	    run_trial(_producers, errh);
+    }
+    if (_stop)
+	router()->please_stop_driver();
+    return true;
+}
+
+String
+QueueThreadBench::read_handler(Element *e, void *)
+{
+    QueueThreadBench *b = static_cast<QueueThreadBench *>(e);
+    return b->_results;
+}
+
+void
+QueueThreadBench::add_handlers()
+{
+    add_read_handler("results", read_handler, 0);
+}
+
+ELEMENT_REQUIRES(userlevel umultithread)
+EXPORT_ELEMENT(QueueThreadBench)
+CLICK_ENDDECLS
@@ -0,0 +1,101 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_QUEUETHREADBENCH_HH
+#define CLICK_QUEUETHREADBENCH_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <pthread.h>
+CLICK_DECLS
+
+/*
+=c
+
+QueueThreadBench(QUEUE [, I<keywords>])
+
+=s test
+
+measures queue throughput with concurrent pushers
+
+=d
+
+Measures how many packets per second the Queue-like element QUEUE passes
+from several concurrent pushing threads to a single puller.  QueueThreadBench
+runs one trial each with 1, 2, 4, ... producer threads, up to PRODUCERS.  In
+each trial the producers push a total of PACKETS packets directly into QUEUE,
+while QueueThreadBench pulls them out on its home thread.  Producers back off
+while QUEUE is full, so a trial measures transfer rate rather than drops.
+QUEUE should be a SimpleQueue variant, such as ThreadSafeQueue, or
+MPSCQueue.
+
+Keyword arguments are:
+
+=over 8
+
+=item PRODUCERS
+
+Integer.  Maximum number of producer threads.  Default is 16.
+
+=item PACKETS
+
+Integer.  Number of packets per trial.  Default is 1000000.
+
+=item STOP
+
+Boolean.  If true, stop the driver after the last trial.  Default is false.
+
+=back
+
+Results are printed as each trial completes.
+
+=h results read-only
+
+Returns one line per completed trial: the number of producers, the number of
+packets pulled, the number dropped, and the rate in packets per second.
+
+=e
+
+  Idle -> q :: MPSCQueue -> Idle;
+  QueueThreadBench(q, PRODUCERS 16, STOP true);
+
+=a QueueThreadTest1, MPSCQueue, ThreadSafeQueue */
+
+class QueueThreadBench : public Element { public:
+
+    QueueThreadBench();
+    ~QueueThreadBench();
+
+    const char *class_name() const		{ return "QueueThreadBench"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    bool run_task(Task *task);
+
+  private:
+
+    Task _task;
+    Element *_queue;
+    int _producers;
+    uint32_t _packets;
+    bool _stop;
+    String _results;
+
+    struct Producer {
+	QueueThreadBench *bench;
+	pthread_t thread;
+	uint32_t count;
+    };
+    volatile bool _go;
+
+    int queue_size() const;
+    int queue_capacity() const;
+    int queue_drops() const;
+    void run_trial(int nproducers, ErrorHandler *errh);
+    static void *producer_thread(void *arg);
+
+    static String read_handler(Element *e, void *thunk);
+
+};
+
+CLICK_ENDDECLS
+#endif
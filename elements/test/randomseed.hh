@@ -20,6 +20,10 @@ random seed is set to a "truly random" value.  (This is not generally useful
 since Click resets the random seed to a "truly random" value whenever a router
 is configured.)
 
+Each thread draws from its own generator.  Setting the seed reseeds every
+thread's generator from SEED and the thread's number, so with a given SEED,
+each thread draws the same sequence from run to run.
+
 =h seed write-only
 
 Write this handler to reset the random seed, either to a particular value or
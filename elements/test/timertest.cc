@@ -37,13 +37,16 @@ int
 TimerTest::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     Timestamp delay;
-    bool schedule = false;
+    bool schedule = false, wheel = false, wheel_set;
     if (Args(conf, this, errh)
 	.read("BENCHMARK", _benchmark)
 	.read("DELAY", delay)
 	.read("SCHEDULE", schedule)
+	.read("WHEEL", wheel).read_status(wheel_set)
 	.complete() < 0)
 	return -1;
+    if (wheel_set)
+	master()->thread(router()->home_thread_id(this))->timer_set().set_timer_wheel(wheel);
     _timer.initialize(this);
     if (schedule || delay)
 	_timer.schedule_after(delay);
@@ -70,9 +73,20 @@ TimerTest::initialize(ErrorHandler *)
 	    ts[i].assign();
 	    ts[i].initialize(this);
 	}
+	Timestamp t0 = Timestamp::now_steady();
 	benchmark_schedules(ts, _benchmark, now);
+	Timestamp t1 = Timestamp::now_steady();
 	benchmark_changes(ts, _benchmark, now);
+	Timestamp t2 = Timestamp::now_steady();
 	benchmark_fires(ts, _benchmark, now);
+	Timestamp t3 = Timestamp::now_steady();
+	t3 -= t2;
+	t2 -= t1;
+	t1 -= t0;
+	click_chatter("%{element}: %d timers (%s): schedule %{timestamp}s, change %{timestamp}s, fire %{timestamp}s",
+		      this, _benchmark,
+		      ts->thread()->timer_set().timer_wheel() ? "wheel" : "heap",
+		      &t1, &t2, &t3);
 	delete[] ts;
     }
 
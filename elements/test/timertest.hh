@@ -39,7 +39,16 @@ is printed to standard error.
 
 Integer.  If set to a positive number, then TimerTest runs a timer
 manipulation benchmark at installation time involving BENCHMARK total
-timers.  Default is 0 (don't benchmark).
+timers.  The benchmark schedules BENCHMARK timers, reschedules them 6
+times as often, then unschedules them in expiry order, and reports the time
+each phase took.  Default is 0 (don't benchmark).
+
+=item WHEEL
+
+Boolean.  If set, TimerTest switches its home thread's timers to a
+hierarchical timing wheel (true) or a heap (false), as the B<click>
+C<--timer-wheel> option does for every thread.  The default leaves the
+thread's mode alone.
 
 =back
 
@@ -59,6 +68,13 @@ Schedule the TimerTest's timer to fire after a given time.
 
 Unschedule the TimerTest's timer.
 
+=e
+
+Compare timer heap and timing wheel performance with 1M timers:
+
+  click -qe 'TimerTest(BENCHMARK 1000000, WHEEL false)'
+  click -qe 'TimerTest(BENCHMARK 1000000, WHEEL true)'
+
 */
 
 class TimerTest : public Element { public:
@@ -19,6 +19,8 @@
 #include <click/config.h>
 #include "vectortest.hh"
 #include <click/vector.hh>
+#include <click/smallvector.hh>
+#include <click/string.hh>
 #include <click/error.hh>
 #if CLICK_USERLEVEL
 # include <sys/time.h>
@@ -66,6 +68,56 @@ VectorTest::initialize(ErrorHandler *errh)
     for (int i = 0; i < 10000; i++)
 	v = v2;
 
+    // SmallVector stays inline up to N elements, then spills to the heap
+    SmallVector<int, 4> sv;
+    CHECK(sv.size() == 0 && sv.capacity() == 4 && sv.is_inline());
+    for (int i = 0; i < 4; i++)
+	sv.push_back(i);
+    CHECK(sv.is_inline() && sv.size() == 4 && sv.back() == 3);
+    sv.push_back(sv[0]);
+    CHECK(!sv.is_inline() && sv.size() == 5 && sv[4] == 0 && sv[3] == 3);
+    sv.insert(sv.begin(), 9);
+    CHECK(sv.size() == 6 && sv[0] == 9 && sv[1] == 0 && sv[5] == 0);
+    sv.erase(sv.begin(), sv.begin() + 2);
+    CHECK(sv.size() == 4 && sv[0] == 1 && sv[3] == 0);
+    sv.resize(2);
+    CHECK(sv.size() == 2 && sv[1] == 2);
+
+    SmallVector<int, 4> sv2(sv);
+    CHECK(sv2.is_inline() && sv2.size() == 2 && sv2[0] == 1 && sv2[1] == 2);
+    sv2.swap(sv);
+    CHECK(sv.size() == 2 && sv2.size() == 2 && sv2[1] == 2);
+
+    v.clear();
+    for (int i = 0; i < 6; i++)
+	v.push_back(i * i);
+    sv = v;
+    CHECK(sv.size() == 6 && sv[5] == 25);
+    v2 = sv.vector();
+    CHECK(v2.size() == 6 && v2[0] == 0 && v2[5] == 25);
+    SmallVector<int, 8> sv3(v2);
+    CHECK(sv3.is_inline() && sv3.size() == 6 && sv3[4] == 16);
+    sv3.assign(3, 7);
+    CHECK(sv3.size() == 3 && sv3[0] == 7 && sv3[2] == 7);
+
+    // SmallVector of a type with constructors and destructors
+    {
+	SmallVector<String, 2> ss;
+	ss.push_back("a");
+	ss.push_back("b");
+	ss.push_back(ss[0] + "c");
+	ss.insert(ss.begin() + 1, "d");
+	CHECK(ss.size() == 4 && ss[0] == "a" && ss[1] == "d" && ss[2] == "b" && ss[3] == "ac");
+	SmallVector<String, 2> ss2;
+	ss2.push_back("x");
+	ss2.swap(ss);
+	CHECK(ss.size() == 1 && ss[0] == "x" && ss2.size() == 4 && ss2[3] == "ac");
+	ss2.erase(ss2.begin());
+	CHECK(ss2.size() == 3 && ss2[0] == "d");
+	ss2.clear();
+	CHECK(ss2.empty());
+    }
+
     errh->message("All tests pass!");
     return 0;
 }
@@ -0,0 +1,391 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * autothreadsched.{cc,hh} -- partition tasks over threads by profile
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <click/config.h>
+#include "autothreadsched.hh"
+#include <click/task.hh>
+#include <click/master.hh>
+#include <click/routerthread.hh>
+#include <click/router.hh>
+#include <click/routervisitor.hh>
+#include <click/bitvector.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+CLICK_DECLS
+
+AutoThreadSched::AutoThreadSched()
+    : _total_cost(0), _handoffs(0), _moves(0), _timer(this)
+{
+}
+
+AutoThreadSched::~AutoThreadSched()
+{
+}
+
+int
+AutoThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _interval_msec = 0;
+    return Args(conf, this, errh)
+	.read("INTERVAL", SecondsArg(3), _interval_msec)
+	.complete();
+}
+
+int
+AutoThreadSched::initialize(ErrorHandler *)
+{
+    _last_profile.assign(router()->nelements(), 0);
+    _timer.initialize(this);
+    if (_interval_msec)
+	_timer.schedule_after_msec(_interval_msec);
+    return 0;
+}
+
+namespace {
+// Collects the elements a task runs.  Downstream traversal visits input
+// ports and stops at elements that store pushed packets for pulling;
+// upstream traversal visits output ports and stops at elements that pull
+// stored packets.  Both include the stopping element, which is what the
+// task shares with the task on the queue's other side.
+class SegmentVisitor : public RouterVisitor { public:
+    SegmentVisitor(Vector<int> &segment, Bitvector &seen)
+	: _segment(segment), _seen(seen) {
+    }
+    bool visit(Element *e, bool isoutput, int, Element *, int, int) {
+	if (!_seen[e->eindex()]) {
+	    _seen[e->eindex()] = true;
+	    _segment.push_back(e->eindex());
+	}
+	if (isoutput) {
+	    for (int p = 0; p < e->ninputs(); ++p)
+		if (e->input_is_push(p))
+		    return false;
+	} else {
+	    for (int p = 0; p < e->noutputs(); ++p)
+		if (e->output_is_pull(p))
+		    return false;
+	}
+	return true;
+    }
+  private:
+    Vector<int> &_segment;
+    Bitvector &_seen;
+};
+}
+
+void
+AutoThreadSched::find_segment(TaskInfo &ti)
+{
+    Element *e = ti.task->element();
+    Bitvector seen(router()->nelements());
+    ti.segment.push_back(e->eindex());
+    seen[e->eindex()] = true;
+    SegmentVisitor v(ti.segment, seen);
+    for (int p = 0; p < e->noutputs(); ++p)
+	if (e->output_is_push(p))
+	    router()->visit_downstream(e, p, &v);
+    for (int p = 0; p < e->ninputs(); ++p)
+	if (e->input_is_pull(p))
+	    router()->visit_upstream(e, p, &v);
+}
+
+void
+AutoThreadSched::discover_tasks()
+{
+    Master *m = master();
+    Vector<Task *> tasks;
+    for (int tid = 0; tid < m->nthreads(); ++tid)
+	m->thread(tid)->scheduled_tasks(router(), tasks);
+    for (Task **tp = tasks.begin(); tp != tasks.end(); ++tp)
+	if (!_task_index.find(*tp)) {
+	    _task_index.set(*tp, _tasks.size());
+	    _tasks.push_back(TaskInfo());
+	    _tasks.back().task = *tp;
+	    find_segment(_tasks.back());
+	}
+}
+
+// Set each task's cost to the cycles it used since the last call.
+void
+AutoThreadSched::measure()
+{
+    for (TaskInfo *ti = _tasks.begin(); ti != _tasks.end(); ++ti) {
+	unsigned runs = ti->task->cycle_runs();
+	ti->cost = (uint64_t) ti->task->cycles() * (runs - ti->last_runs);
+	ti->last_runs = runs;
+    }
+
+#if HAVE_ELEMENT_PROFILE
+    if (!Element::profiling())
+	return;
+    Vector<uint64_t> delta(router()->nelements(), 0);
+    Vector<int> nusers(router()->nelements(), 0);
+    uint64_t total = 0;
+    for (int ei = 0; ei < router()->nelements(); ++ei) {
+	uint64_t c = router()->element(ei)->profile_cycles();
+	// profiling restarts from zero on "reset"
+	delta[ei] = c >= _last_profile[ei] ? c - _last_profile[ei] : c;
+	_last_profile[ei] = c;
+	total += delta[ei];
+    }
+    if (!total)
+	return;
+    for (TaskInfo *ti = _tasks.begin(); ti != _tasks.end(); ++ti)
+	for (int *ep = ti->segment.begin(); ep != ti->segment.end(); ++ep)
+	    ++nusers[*ep];
+    for (TaskInfo *ti = _tasks.begin(); ti != _tasks.end(); ++ti) {
+	ti->cost = 0;
+	for (int *ep = ti->segment.begin(); ep != ti->segment.end(); ++ep)
+	    ti->cost += delta[*ep] / nusers[*ep];
+    }
+#endif
+}
+
+// Count the elements whose users run on more than one thread.
+int
+AutoThreadSched::count_handoffs(const Vector<Vector<int> > &users,
+				const Vector<int> &thread) const
+{
+    int n = 0;
+    for (int ei = 0; ei < users.size(); ++ei)
+	for (int j = 1; j < users[ei].size(); ++j)
+	    if (thread[users[ei][j]] != thread[users[ei][0]]) {
+		++n;
+		break;
+	    }
+    return n;
+}
+
+namespace {
+struct OrderKeys {
+    const uint64_t *cost;
+    const uint64_t *group_cost;
+    const int *group;
+};
+
+// Orders tasks by decreasing group cost, keeping groups together, then by
+// decreasing task cost.
+int
+order_sorter(const void *va, const void *vb, void *user_data)
+{
+    const OrderKeys *k = static_cast<const OrderKeys *>(user_data);
+    int a = *static_cast<const int *>(va), b = *static_cast<const int *>(vb);
+    int ga = k->group[a], gb = k->group[b];
+    if (k->group_cost[ga] != k->group_cost[gb])
+	return k->group_cost[ga] > k->group_cost[gb] ? -1 : 1;
+    if (ga != gb)
+	return ga - gb;
+    if (k->cost[a] != k->cost[b])
+	return k->cost[a] > k->cost[b] ? -1 : 1;
+    return a - b;
+}
+
+int
+group_root(Vector<int> &group, int i)
+{
+    while (group[i] != i)
+	i = group[i] = group[group[i]];
+    return i;
+}
+}
+
+void
+AutoThreadSched::rebalance()
+{
+    discover_tasks();
+    measure();
+
+    int nthreads = master()->nthreads(), ntasks = _tasks.size();
+    Vector<Vector<int> > users(router()->nelements(), Vector<int>());
+    Vector<int> home(ntasks, -1), thread(ntasks, -1);
+    Vector<uint64_t> cost(ntasks, 0);
+    Vector<uint64_t> old_load(nthreads, 0), load(nthreads, 0);
+    Vector<int> order;
+    _total_cost = 0;
+    for (int i = 0; i < ntasks; ++i) {
+	TaskInfo &ti = _tasks[i];
+	for (int *ep = ti.segment.begin(); ep != ti.segment.end(); ++ep)
+	    users[*ep].push_back(i);
+	home[i] = ti.task->home_thread_id();
+	cost[i] = ti.cost;
+	_total_cost += cost[i];
+	if (home[i] >= 0 && home[i] < nthreads)
+	    old_load[home[i]] += cost[i];
+	// Pinned tasks, and tasks that did nothing, stay where they are.
+	if (home[i] < 0 || home[i] >= nthreads || !ti.task->stealable()
+	    || !cost[i]) {
+	    thread[i] = home[i];
+	    if (home[i] >= 0 && home[i] < nthreads)
+		load[home[i]] += cost[i];
+	} else
+	    order.push_back(i);
+    }
+
+    // Neighbors form groups, which are placed whole when they fit.
+    Vector<int> group(ntasks, 0);
+    Vector<uint64_t> group_cost(ntasks, 0);
+    for (int i = 0; i < ntasks; ++i)
+	group[i] = i;
+    for (int ei = 0; ei < users.size(); ++ei)
+	for (int j = 1; j < users[ei].size(); ++j)
+	    group[group_root(group, users[ei][j])] = group_root(group, users[ei][0]);
+    for (int i = 0; i < ntasks; ++i)
+	group[i] = group_root(group, i);
+    for (int *ip = order.begin(); ip != order.end(); ++ip)
+	group_cost[group[*ip]] += cost[*ip];
+    OrderKeys keys = { cost.begin(), group_cost.begin(), group.begin() };
+    if (order.size())
+	click_qsort(order.begin(), order.size(), sizeof(int),
+		    order_sorter, &keys);
+
+    uint64_t avg = _total_cost / nthreads, cap = avg + (avg >> 3);
+    Vector<int> near(nthreads, 0), group_thread(ntasks, -1);
+    for (int *ip = order.begin(); ip != order.end(); ++ip) {
+	int i = *ip, g = group[i];
+	if (ip == order.begin() || group[ip[-1]] != g) {
+	    // First task of its group: join a pinned member, or take the
+	    // least loaded thread, if the whole group fits.
+	    int t = -1;
+	    for (int j = 0; j < ntasks && t < 0; ++j)
+		if (group[j] == g && !_tasks[j].task->stealable()
+		    && thread[j] >= 0 && thread[j] < nthreads)
+		    t = thread[j];
+	    if (t < 0) {
+		t = home[i];
+		for (int u = 0; u < nthreads; ++u)
+		    if (load[u] < load[t])
+			t = u;
+	    }
+	    if (!load[t] || load[t] + group_cost[g] <= cap)
+		group_thread[g] = t;
+	}
+	if (group_thread[g] >= 0) {
+	    thread[i] = group_thread[g];
+	    load[thread[i]] += cost[i];
+	    continue;
+	}
+
+	// Otherwise place the group's tasks one by one, near neighbors if
+	// load allows.
+	const Vector<int> &segment = _tasks[i].segment;
+	for (const int *ep = segment.begin(); ep != segment.end(); ++ep)
+	    for (int *jp = users[*ep].begin(); jp != users[*ep].end(); ++jp)
+		if (thread[*jp] >= 0 && thread[*jp] < nthreads)
+		    near[thread[*jp]] = i + 1;
+	int best = -1;
+	for (int t = 0; t < nthreads; ++t)
+	    if (near[t] == i + 1 && (!load[t] || load[t] + cost[i] <= cap)
+		&& (best < 0 || load[t] < load[best]))
+		best = t;
+	if (best < 0) {
+	    best = home[i];
+	    for (int t = 0; t < nthreads; ++t)
+		if (load[t] < load[best])
+		    best = t;
+	}
+	thread[i] = best;
+	load[best] += cost[i];
+    }
+
+    uint64_t old_max = 0, new_max = 0;
+    for (int t = 0; t < nthreads; ++t) {
+	old_max = old_load[t] > old_max ? old_load[t] : old_max;
+	new_max = load[t] > new_max ? load[t] : new_max;
+    }
+    int old_handoffs = count_handoffs(users, home),
+	new_handoffs = count_handoffs(users, thread);
+    bool apply = new_max + (old_max >> 3) <= old_max
+	|| (new_max <= old_max && new_handoffs < old_handoffs);
+
+    for (int i = 0; i < ntasks; ++i)
+	if (apply && thread[i] != home[i]) {
+	    _tasks[i].task->move_thread(thread[i]);
+	    _tasks[i].thread = thread[i];
+	    ++_moves;
+	} else
+	    _tasks[i].thread = home[i];
+    _handoffs = apply ? new_handoffs : old_handoffs;
+}
+
+void
+AutoThreadSched::run_timer(Timer *)
+{
+    rebalance();
+    _timer.reschedule_after_msec(_interval_msec);
+}
+
+String
+AutoThreadSched::read_handler(Element *e, void *thunk)
+{
+    AutoThreadSched *ats = static_cast<AutoThreadSched *>(e);
+    switch ((intptr_t) thunk) {
+    case h_partition: {
+	Router *r = ats->router();
+	int nthreads = ats->master()->nthreads();
+	Vector<Vector<int> > users(r->nelements(), Vector<int>());
+	for (int i = 0; i < ats->_tasks.size(); ++i) {
+	    const Vector<int> &segment = ats->_tasks[i].segment;
+	    for (const int *ep = segment.begin(); ep != segment.end(); ++ep)
+		users[*ep].push_back(i);
+	}
+	StringAccum sa;
+	Bitvector neighbor(ats->_tasks.size());
+	for (int i = 0; i < ats->_tasks.size(); ++i) {
+	    const TaskInfo &ti = ats->_tasks[i];
+	    uint64_t pct = ats->_total_cost ? ti.cost * 100 / ats->_total_cost : 0;
+	    sa << ti.task->element()->name() << " thread " << ti.thread
+	       << " cost " << pct << '%';
+	    uint64_t avg = ats->_total_cost / nthreads;
+	    if (nthreads > 1 && ti.cost > avg + (avg >> 3))
+		sa << " split";
+	    neighbor.clear();
+	    for (const int *ep = ti.segment.begin(); ep != ti.segment.end(); ++ep)
+		for (const int *jp = users[*ep].begin(); jp != users[*ep].end(); ++jp)
+		    if (*jp != i && !neighbor[*jp]) {
+			neighbor[*jp] = true;
+			sa << " neighbor " << ats->_tasks[*jp].task->element()->name();
+		    }
+	    sa << '\n';
+	}
+	return sa.take_string();
+    }
+    case h_handoffs:
+	return String(ats->_handoffs);
+    case h_moves:
+	return String(ats->_moves);
+    default:
+	return String();
+    }
+}
+
+int
+AutoThreadSched::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    static_cast<AutoThreadSched *>(e)->rebalance();
+    return 0;
+}
+
+void
+AutoThreadSched::add_handlers()
+{
+    add_write_handler("rebalance", write_handler, 0, Handler::BUTTON);
+    add_read_handler("partition", read_handler, h_partition);
+    add_read_handler("handoffs", read_handler, h_handoffs);
+    add_read_handler("moves", read_handler, h_moves);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(multithread)
+EXPORT_ELEMENT(AutoThreadSched)
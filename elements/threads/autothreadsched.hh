@@ -0,0 +1,138 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_AUTOTHREADSCHED_HH
+#define CLICK_AUTOTHREADSCHED_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/hashtable.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * AutoThreadSched([I<keywords> INTERVAL])
+ * =s threads
+ * partitions tasks over threads by profile and graph structure
+ * =d
+ *
+ * Assigns the router's tasks to threads automatically.  Each task runs a
+ * segment of the configuration: the elements it reaches by pushing
+ * downstream and pulling upstream, up to the queues where packets are
+ * stored (elements with pull outputs, or push inputs).  The cost of a task
+ * is the cycles its segment used since the last evaluation: from element
+ * profiling, when it is on (see the global C<profile> handler), and from the
+ * task's own cycle counts otherwise.  An element in several segments is
+ * split among them.
+ *
+ * Two tasks are neighbors when their segments share an element, typically
+ * the queue one fills and the other drains, and neighbors form groups.
+ * AutoThreadSched places groups in decreasing order of cost.  A group goes
+ * whole to the least loaded thread, or to the thread of a member that cannot
+ * move, if that keeps the thread within an eighth of the average load.
+ * Otherwise its tasks are placed one by one in decreasing order of cost,
+ * each on the least loaded thread that holds a neighbor and has room, or on
+ * the least loaded thread if none does.  The new partition is applied only
+ * when it lowers the busiest thread's load by an eighth, or keeps it and
+ * hands fewer packets between threads, so a good partition stays put.
+ *
+ * Unlike BalancedThreadSched, which moves single tasks between the busiest
+ * and the idlest thread, AutoThreadSched keeps producers and consumers of a
+ * queue together when load allows.  It cannot add queues to a running
+ * configuration; the C<partition> handler marks segments that are too
+ * expensive for one thread, where a queue would let the segment be split.
+ *
+ * Tasks that are not stealable (see WorkStealingThreadSched), including
+ * those of elements bound by StaticThreadSched, stay on their threads but
+ * count towards their load.  Only tasks that have been scheduled at least
+ * once are partitioned.
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item INTERVAL
+ *
+ * Time.  How often to re-evaluate the partition.  Zero means only when
+ * the C<rebalance> handler is written.  Default is 0.
+ *
+ * =back
+ *
+ * =h rebalance write-only
+ *
+ * Re-evaluates the partition now, using the costs since the last
+ * evaluation.
+ *
+ * =h partition read-only
+ *
+ * Returns the last evaluation, one line per task: the element that owns it,
+ * its thread, its share of the total cost in percent, and its neighbors.  A
+ * task costing more than an eighth over the average thread load is marked
+ * C<split>.
+ *
+ * =h handoffs read-only
+ *
+ * Returns the number of elements shared by tasks on different threads in
+ * the last evaluation.
+ *
+ * =h moves read-only
+ *
+ * Returns the number of tasks moved.
+ *
+ * =e
+ *
+ *   click --threads=2 -e '
+ *     AutoThreadSched(INTERVAL 1s);
+ *     FromDevice(eth0) -> q0 :: Queue -> ToDevice(eth1);
+ *     FromDevice(eth1) -> q1 :: Queue -> ToDevice(eth0);'
+ *
+ * =a BalancedThreadSched, StaticThreadSched, WorkStealingThreadSched
+ */
+
+class AutoThreadSched : public Element { public:
+
+    AutoThreadSched();
+    ~AutoThreadSched();
+
+    const char *class_name() const	{ return "AutoThreadSched"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    void run_timer(Timer *);
+
+  private:
+
+    struct TaskInfo {
+	Task *task;
+	Vector<int> segment;	// element indexes the task runs
+	unsigned last_runs;
+	uint64_t cost;
+	int thread;
+	TaskInfo()
+	    : task(0), last_runs(0), cost(0), thread(0) {
+	}
+    };
+
+    Vector<TaskInfo> _tasks;
+    HashTable<Task *, int> _task_index;
+    Vector<uint64_t> _last_profile;
+    uint64_t _total_cost;
+    int _handoffs;
+    uint32_t _moves;
+    Timer _timer;
+    uint32_t _interval_msec;
+
+    void discover_tasks();
+    void find_segment(TaskInfo &ti);
+    void measure();
+    int count_handoffs(const Vector<Vector<int> > &users,
+		       const Vector<int> &thread) const;
+    void rebalance();
+
+    enum { h_partition, h_handoffs, h_moves };
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
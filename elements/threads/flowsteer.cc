@@ -0,0 +1,407 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * flowsteer.{cc,hh} -- element steers flows to per-thread packet rings
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flowsteer.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/sync.hh>
+#include <click/crc32.h>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+// The Toeplitz hash of a flow XORs together one 32-bit window of the key for
+// every set bit of the input, where the window for input bit i starts at key
+// bit i.  The default key is the one the Microsoft RSS specification gives;
+// a key that repeats every 16 bits makes the hash symmetric.
+static const uint8_t rss_key[16] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0
+};
+static const uint8_t symmetric_key[16] = {
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a
+};
+enum { hash_input_size = 12 };	// saddr, daddr, sport, dport
+
+FlowSteer::FlowSteer()
+    : _rings(0), _nrings(0), _toeplitz(0)
+{
+}
+
+FlowSteer::~FlowSteer()
+{
+}
+
+void *
+FlowSteer::port_cast(bool isoutput, int port, const char *name)
+{
+    if (isoutput && port >= 0 && port < _nrings
+	&& strcmp(name, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_rings[port].empty_note);
+    return Element::port_cast(isoutput, port, name);
+}
+
+int
+FlowSteer::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String hash = "TOEPLITZ";
+    _symmetric = true;
+    _anno = -1;
+    _capacity = 1024;
+    if (Args(conf, this, errh)
+	.read("HASH", WordArg(), hash)
+	.read("SYMMETRIC", _symmetric)
+	.read("ANNO", AnnoArg(4), _anno)
+	.read("CAPACITY", _capacity)
+	.complete() < 0)
+	return -1;
+    if (hash == "TOEPLITZ")
+	_crc = false;
+    else if (hash == "CRC")
+	_crc = true;
+    else
+	return errh->error("bad HASH");
+    if (_capacity == 0 || _capacity > 0x10000000)
+	return errh->error("CAPACITY out of range");
+    uint32_t capacity = 1;
+    while (capacity < _capacity)
+	capacity <<= 1;
+    _capacity = capacity;
+
+    _nrings = noutputs();
+    _rings = new Ring[_nrings];
+    for (int i = 0; i < _nrings; ++i) {
+	_rings[i].slots = 0;
+	_rings[i].empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    }
+    return 0;
+}
+
+void
+FlowSteer::make_toeplitz_table()
+{
+    const uint8_t *key = (_symmetric ? symmetric_key : rss_key);
+    for (int i = 0; i < hash_input_size; ++i)
+	for (int v = 0; v < 256; ++v) {
+	    uint32_t h = 0;
+	    for (int b = 0; b < 8; ++b)
+		if (v & (0x80 >> b)) {
+		    int bit = i * 8 + b, k = bit >> 3, shift = bit & 7;
+		    uint32_t window = ((uint32_t) key[k] << 24) | (key[k + 1] << 16)
+			| (key[k + 2] << 8) | key[k + 3];
+		    if (shift)
+			window = (window << shift) | (key[k + 4] >> (8 - shift));
+		    h ^= window;
+		}
+	    _toeplitz[i][v] = h;
+	}
+}
+
+int
+FlowSteer::initialize(ErrorHandler *errh)
+{
+    for (int i = 0; i < _nrings; ++i) {
+	Ring &r = _rings[i];
+	if (!(r.slots = new Slot[_capacity]))
+	    return errh->error("out of memory!");
+	for (uint32_t j = 0; j < _capacity; ++j) {
+	    r.slots[j].packet = 0;
+	    r.slots[j].seq = 0;
+	}
+	r.mask = _capacity - 1;
+	r.tail = r.drops = r.count = 0;
+	r.head = 0;
+	r.sleepiness = 0;
+    }
+    if (!_crc) {
+	if (!(_toeplitz = new uint32_t[hash_input_size][256]))
+	    return errh->error("out of memory!");
+	make_toeplitz_table();
+    }
+    return 0;
+}
+
+void
+FlowSteer::cleanup(CleanupStage)
+{
+    if (_rings) {
+	for (int i = 0; i < _nrings; ++i)
+	    if (_rings[i].slots) {
+		while (Packet *p = dequeue(_rings[i]))
+		    p->kill();
+		delete[] _rings[i].slots;
+	    }
+	delete[] _rings;
+	_rings = 0;
+    }
+    delete[] _toeplitz;
+    _toeplitz = 0;
+}
+
+uint32_t
+FlowSteer::flow_hash(IPFlowID flow) const
+{
+    if (_symmetric && _crc
+	&& (flow.saddr().addr() > flow.daddr().addr()
+	    || (flow.saddr() == flow.daddr() && flow.sport() > flow.dport())))
+	flow = flow.reverse();
+
+    uint8_t data[hash_input_size];
+    uint32_t x = flow.saddr().addr();
+    memcpy(&data[0], &x, 4);
+    x = flow.daddr().addr();
+    memcpy(&data[4], &x, 4);
+    uint16_t port = flow.sport();
+    memcpy(&data[8], &port, 2);
+    port = flow.dport();
+    memcpy(&data[10], &port, 2);
+
+    if (_crc)
+	return update_crc(0xFFFFFFFFU, reinterpret_cast<const char *>(data), hash_input_size);
+    uint32_t h = 0;
+    for (int i = 0; i < hash_input_size; ++i)
+	h ^= _toeplitz[i][data[i]];
+    return h;
+}
+
+uint32_t
+FlowSteer::packet_hash(const Packet *p) const
+{
+    if (_anno >= 0)
+	if (uint32_t h = p->anno_u32(_anno))
+	    return h;
+    if (!p->has_network_header() || p->network_length() < (int) sizeof(click_ip))
+	return 0;
+    const click_ip *iph = p->ip_header();
+    uint16_t sport = 0, dport = 0;
+    if (!IP_ISFRAG(iph)
+	&& (iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP
+	    || iph->ip_p == IP_PROTO_DCCP || iph->ip_p == IP_PROTO_SCTP)
+	&& p->transport_length() >= 4) {
+	const uint16_t *ports = reinterpret_cast<const uint16_t *>(p->transport_header());
+	sport = ports[0];
+	dport = ports[1];
+    }
+    return flow_hash(IPFlowID(iph->ip_src, sport, iph->ip_dst, dport));
+}
+
+/* Each ring is a bounded multi-producer, single-consumer queue.  A pusher
+   claims n consecutive positions by advancing tail with one compare-and-swap,
+   stores its packets, and publishes each one by setting its slot's sequence
+   number to the position plus one.  The puller takes packets in position
+   order as they are published, then advances head, which frees their
+   slots.  Pushers check for room against head, so they never overwrite a
+   packet the puller has not taken. */
+int
+FlowSteer::enqueue(Ring &r, Packet **p, int n)
+{
+    uint32_t pos, room;
+    do {
+	pos = r.tail;
+	room = _capacity - (pos - r.head);
+	if (room == 0)
+	    return 0;
+	if ((uint32_t) n > room)
+	    n = room;
+    } while (r.tail.compare_swap(pos, pos + n) != pos);
+
+    for (int i = 0; i < n; ++i) {
+	Slot &s = r.slots[(pos + i) & r.mask];
+	s.packet = p[i];
+	click_fence();
+	s.seq = pos + i + 1;
+    }
+    r.count += n;
+    r.empty_note.wake();
+    return n;
+}
+
+inline Packet *
+FlowSteer::dequeue(Ring &r)
+{
+    uint32_t pos = r.head;
+    Slot &s = r.slots[pos & r.mask];
+    if (s.seq != pos + 1)
+	return 0;
+    click_fence();
+    Packet *p = s.packet;
+    s.packet = 0;
+    click_fence();
+    r.head = pos + 1;
+    return p;
+}
+
+void
+FlowSteer::push(int, Packet *p)
+{
+    Ring &r = _rings[hash_output(packet_hash(p))];
+    if (!enqueue(r, &p, 1)) {
+	r.drops += 1;
+	p->kill();
+    }
+}
+
+void
+FlowSteer::push_batch(int, PacketBatch &batch)
+{
+    Packet *chunk[CHUNK], *same[CHUNK];
+    int out[CHUNK];
+
+    while (!batch.empty()) {
+	int n = 0;
+	for (; n < CHUNK && !batch.empty(); ++n) {
+	    chunk[n] = batch.pop_front();
+	    out[n] = hash_output(packet_hash(chunk[n]));
+	}
+
+	// Give each output its packets, in order, in one enqueue.
+	for (int i = 0; i < n; ++i)
+	    if (chunk[i]) {
+		int port = out[i], m = 0;
+		for (int j = i; j < n; ++j)
+		    if (chunk[j] && out[j] == port) {
+			same[m++] = chunk[j];
+			chunk[j] = 0;
+		    }
+		Ring &r = _rings[port];
+		int k = enqueue(r, same, m);
+		if (k < m) {
+		    r.drops += m - k;
+		    for (; k < m; ++k)
+			same[k]->kill();
+		}
+	    }
+    }
+}
+
+inline void
+FlowSteer::pull_success(Ring &r, int)
+{
+    r.sleepiness = 0;
+}
+
+inline void
+FlowSteer::pull_failure(Ring &r)
+{
+    if (r.sleepiness >= SLEEPINESS_TRIGGER) {
+	r.empty_note.sleep();
+#if HAVE_MULTITHREAD
+	// Work around race condition between push() and pull().
+	// We might have just undone push()'s Notifier::wake() call.
+	// Easiest lock-free solution: check whether we should wake again!
+	if (r.slots[r.head & r.mask].seq == r.head + 1)
+	    r.empty_note.wake();
+#endif
+    } else
+	++r.sleepiness;
+}
+
+Packet *
+FlowSteer::pull(int port)
+{
+    Ring &r = _rings[port];
+    Packet *p = dequeue(r);
+    if (p)
+	pull_success(r, 1);
+    else
+	pull_failure(r);
+    return p;
+}
+
+void
+FlowSteer::pull_batch(int port, PacketBatch &batch, int max)
+{
+    Ring &r = _rings[port];
+    int n = 0;
+    for (; n < max; ++n)
+	if (Packet *p = dequeue(r))
+	    batch.push_back(p);
+	else
+	    break;
+    if (n)
+	pull_success(r, n);
+    else
+	pull_failure(r);
+}
+
+String
+FlowSteer::read_handler(Element *e, void *thunk)
+{
+    FlowSteer *fs = static_cast<FlowSteer *>(e);
+    StringAccum sa;
+    uint32_t drops = 0;
+    for (int i = 0; i < fs->_nrings; ++i) {
+	Ring &r = fs->_rings[i];
+	switch (reinterpret_cast<intptr_t>(thunk)) {
+	  case 0:
+	    sa << (i ? " " : "") << r.count.value();
+	    break;
+	  case 1:
+	    sa << (i ? " " : "") << (r.tail - r.head);
+	    break;
+	  case 2:
+	    drops += r.drops;
+	    break;
+	}
+    }
+    if (reinterpret_cast<intptr_t>(thunk) == 2)
+	sa << drops;
+    return sa.take_string();
+}
+
+int
+FlowSteer::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    FlowSteer *fs = static_cast<FlowSteer *>(e);
+    for (int i = 0; i < fs->_nrings; ++i)
+	fs->_rings[i].count = fs->_rings[i].drops = 0;
+    return 0;
+}
+
+int
+FlowSteer::hash_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    FlowSteer *fs = static_cast<FlowSteer *>(e);
+    IPAddress saddr, daddr;
+    uint16_t sport, dport;
+    if (Args(e, errh).push_back_words(str)
+	.read_mp("SADDR", saddr)
+	.read_mp("SPORT", sport)
+	.read_mp("DADDR", daddr)
+	.read_mp("DPORT", dport)
+	.complete() < 0)
+	return -1;
+    uint32_t h = fs->flow_hash(IPFlowID(saddr, htons(sport), daddr, htons(dport)));
+    StringAccum sa;
+    sa.snprintf(16, "%08x", h) << ' ' << fs->hash_output(h);
+    str = sa.take_string();
+    return 0;
+}
+
+void
+FlowSteer::add_handlers()
+{
+    add_read_handler("counts", read_handler, 0);
+    add_read_handler("lengths", read_handler, 1);
+    add_read_handler("drops", read_handler, 2);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+    set_handler("hash", Handler::OP_READ | Handler::READ_PARAM, hash_handler);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(FlowSteer)
+ELEMENT_MT_SAFE(FlowSteer)
@@ -0,0 +1,194 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLOWSTEER_HH
+#define CLICK_FLOWSTEER_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/atomic.hh>
+#include <click/ipflowid.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FlowSteer([I<keywords> HASH, SYMMETRIC, ANNO, CAPACITY])
+
+=s threads
+
+steers flows to per-thread queues
+
+=d
+
+FlowSteer spreads a stream of IP packets over several threads the way a
+network card's receive-side scaling does.  It hashes each packet's flow, maps
+the hash to one of its outputs, and stores the packet in that output's
+queue.  Every output is a pull port with its own queue; connect each output
+to a puller (for example, an Unqueue or a ToDevice input) running on a
+different thread.  All packets of one flow use the same output, so flows stay
+in order.
+
+FlowSteer's queues are lock-free rings.  Any number of threads may push to
+FlowSteer at once, but each output should be pulled by only one thread.  A
+batch pushed with push_batch is split by output and each part is added to
+its ring with a single atomic operation.  Each output has its own empty
+notifier, so idle pullers sleep.  Packets that arrive when their output's
+ring is full are dropped.
+
+The flow hash covers the IP source and destination addresses, plus the
+source and destination ports of unfragmented TCP, UDP, DCCP, and SCTP
+packets, as in an IPFlowID.  Packets must have their IP header annotations
+set; packets that lack them all hash to the same output.
+
+Keyword arguments are:
+
+=over 8
+
+=item HASH
+
+Either C<TOEPLITZ> or C<CRC>.  C<TOEPLITZ> computes the Toeplitz hash that
+network cards use for receive-side scaling; C<CRC> computes a CRC-32 of the
+flow, which is cheaper in software.  Default is C<TOEPLITZ>.
+
+=item SYMMETRIC
+
+Boolean.  If true, a flow and its reverse hash to the same value, so both
+directions of a connection reach the same thread.  For C<TOEPLITZ>, a
+symmetric hash uses the repeating key 0x6D5A; otherwise the hash uses the
+standard Microsoft key, matching the hash most network cards compute by
+default.  Default is true.
+
+=item ANNO
+
+Annotation name.  If given, FlowSteer uses the 4-byte value of this
+annotation as the flow hash when it is nonzero, computing a hash only for
+packets whose annotation is zero.  This saves the hash computation when an
+earlier element, such as FromDevice with HASH_ANNO, has stored the hash the
+network card computed.
+
+=item CAPACITY
+
+Unsigned.  Size of each output's ring, rounded up to a power of two.
+Default is 1024.
+
+=back
+
+=e
+
+This configuration spreads packets over four threads:
+
+  FromDevice(eth0, METHOD RING) -> Strip(14) -> CheckIPHeader
+      -> fs :: FlowSteer;
+  fs[0] -> u0 :: Unqueue -> ...;
+  fs[1] -> u1 :: Unqueue -> ...;
+  fs[2] -> u2 :: Unqueue -> ...;
+  fs[3] -> u3 :: Unqueue -> ...;
+  StaticThreadSched(u0 0, u1 1, u2 2, u3 3);
+
+=h counts read-only
+
+Returns the number of packets steered to each output, separated by spaces.
+
+=h lengths read-only
+
+Returns the number of packets in each output's ring, separated by spaces.
+
+=h drops read-only
+
+Returns the number of packets dropped because their ring was full.
+
+=h hash read-only
+
+Takes a flow C<SADDR SPORT DADDR DPORT> as a parameter and returns its flow
+hash, in hexadecimal, followed by the output it maps to.
+
+=h reset_counts write-only
+
+Resets "counts" and "drops" to zero.
+
+=n
+
+FlowSteer is FromDevice's QUEUES option done in software: use QUEUES when
+the device can spread flows in hardware, and FlowSteer when it cannot, or
+when packets must be steered after some processing.
+
+=a HashSwitch, MPSCQueue, CPUSwitch, CPUQueue, StaticThreadSched,
+FromDevice.u */
+
+class FlowSteer : public Element { public:
+
+    FlowSteer();
+    ~FlowSteer();
+
+    const char *class_name() const	{ return "FlowSteer"; }
+    const char *port_count() const	{ return "1/1-"; }
+    const char *processing() const	{ return "h/l"; }
+    void *port_cast(bool isoutput, int port, const char *name);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void push_batch(int port, PacketBatch &batch);
+    Packet *pull(int port);
+    void pull_batch(int port, PacketBatch &batch, int max);
+
+    uint32_t flow_hash(IPFlowID flow) const;
+    inline int hash_output(uint32_t hash) const;
+    uint32_t packet_hash(const Packet *p) const;
+
+  private:
+
+    enum { CACHE_LINE_SIZE = 64 };
+    enum { SLEEPINESS_TRIGGER = 9 };
+    enum { CHUNK = 64 };
+
+    struct Slot {
+	Packet *packet;
+	volatile uint32_t seq;	// position + 1 once packet is stored
+    };
+
+    // Pushers claim positions by advancing tail; the output's puller owns
+    // head.  Keep them on separate cache lines.
+    struct Ring {
+	atomic_uint32_t tail;
+	atomic_uint32_t drops;
+	atomic_uint32_t count;
+	char tail_pad[CACHE_LINE_SIZE - 3 * sizeof(atomic_uint32_t)];
+	volatile uint32_t head;
+	int sleepiness;
+	char head_pad[CACHE_LINE_SIZE - sizeof(uint32_t) - sizeof(int)];
+	Slot *slots;
+	uint32_t mask;
+	ActiveNotifier empty_note;
+    };
+
+    Ring *_rings;
+    int _nrings;
+    uint32_t _capacity;
+    bool _symmetric;
+    bool _crc;
+    int _anno;
+    uint32_t (*_toeplitz)[256];
+
+    void make_toeplitz_table();
+    int enqueue(Ring &r, Packet **p, int n);
+    inline Packet *dequeue(Ring &r);
+    inline void pull_success(Ring &r, int n);
+    inline void pull_failure(Ring &r);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+    static int hash_handler(int op, String &str, Element *e, const Handler *h, ErrorHandler *errh);
+
+};
+
+inline int
+FlowSteer::hash_output(uint32_t hash) const
+{
+    // Use the hash's high bits, as with a network card's indirection table.
+    return (int) (((uint64_t) hash * _nrings) >> 32);
+}
+
+CLICK_ENDDECLS
+#endif
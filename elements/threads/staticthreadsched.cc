@@ -36,13 +36,25 @@ int
 StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     Element *e;
+    String thread;
     int preference;
+    Vector<int> node_next;
     for (int i = 0; i < conf.size(); i++) {
 	if (Args(this, errh).push_back_words(conf[i])
 	    .read_mp("ELEMENT", e)
-	    .read_mp("THREAD", preference)
+	    .read_mp("THREAD", WordArg(), thread)
 	    .complete() < 0)
 	    return -1;
+	if (thread.starts_with("numa:")) {
+	    int node;
+	    if (!IntArg().parse(thread.substring(5), node) || node < 0)
+		return errh->error("bad NUMA node %<%s%>", thread.c_str());
+	    if ((preference = numa_thread(node, node_next)) == THREAD_UNKNOWN) {
+		errh->warning("no thread runs on NUMA node %d", node);
+		continue;
+	    }
+	} else if (!IntArg().parse(thread, preference))
+	    return errh->error("THREAD should be a thread number or %<numa:NODE%>");
 	if (e->eindex() >= _thread_preferences.size())
 	    _thread_preferences.resize(e->eindex() + 1, THREAD_UNKNOWN);
 	if (preference < -1 || preference >= master()->nthreads()) {
@@ -56,6 +68,27 @@ StaticThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
     return 0;
 }
 
+// Returns the next thread, in rotation, that runs on NUMA node node.
+int
+StaticThreadSched::numa_thread(int node, Vector<int> &node_next)
+{
+    Master *m = master();
+    if (node >= node_next.size())
+	node_next.resize(node + 1, 0);
+    for (int i = 0; i < m->nthreads(); ++i) {
+	int tid = (node_next[node] + i) % m->nthreads();
+#if CLICK_USERLEVEL
+	if (m->thread(tid)->numa_node() == node) {
+	    node_next[node] = tid + 1;
+	    return tid;
+	}
+#else
+	(void) tid;
+#endif
+    }
+    return THREAD_UNKNOWN;
+}
+
 int
 StaticThreadSched::initial_home_thread_id(const Element *e)
 {
@@ -69,5 +102,18 @@ StaticThreadSched::initial_home_thread_id(const Element *e)
 	return THREAD_UNKNOWN;
 }
 
+bool
+StaticThreadSched::initial_task_stealable(const Element *e)
+{
+    int eidx = e->eindex();
+    if (eidx >= 0 && eidx < _thread_preferences.size()
+	&& _thread_preferences[eidx] != THREAD_UNKNOWN)
+	return false;
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_task_stealable(e);
+    else
+	return true;
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(StaticThreadSched)
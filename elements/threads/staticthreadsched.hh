@@ -14,8 +14,23 @@ CLICK_DECLS
  * Statically binds elements to threads. If more than one StaticThreadSched
  * is specified, they will all run. The one that runs later may override an
  * earlier run.
+ *
+ * THREAD is either a thread number or C<numa:NODE>.  An element bound to
+ * C<numa:NODE> goes to a thread running on that NUMA node; elements bound to
+ * the same node are spread over its threads in turn.  Threads have NUMA
+ * nodes only at user level, when pinned to processors with the B<click>
+ * driver's B<--affinity> option.  Memory that elements allocate while
+ * initializing, such as queue storage and hash tables, is then placed on
+ * their home threads' nodes.
+ *
+ * Tasks belonging to elements bound by StaticThreadSched are never moved by
+ * work stealing (see WorkStealingThreadSched).
+ * =e
+ *   click -j 4 --affinity=0,1,8,9 -e '
+ *     StaticThreadSched(fd0 numa:0, td0 numa:0, fd1 numa:1, td1 numa:1);
+ *     ...'
  * =a
- * ThreadMonitor, BalancedThreadSched
+ * ThreadMonitor, BalancedThreadSched, WorkStealingThreadSched
  */
 
 class StaticThreadSched : public Element, public ThreadSched { public:
@@ -28,12 +43,15 @@ class StaticThreadSched : public Element, public ThreadSched { public:
     int configure(Vector<String> &, ErrorHandler *);
 
     int initial_home_thread_id(const Element *e);
+    bool initial_task_stealable(const Element *e);
 
   private:
 
     Vector<int> _thread_preferences;
     ThreadSched *_next_thread_sched;
 
+    int numa_thread(int node, Vector<int> &node_next);
+
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,141 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * workstealingthreadsched.{cc,hh} -- element enables task work stealing
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <click/config.h>
+#include "workstealingthreadsched.hh"
+#include <click/task.hh>
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+CLICK_DECLS
+
+WorkStealingThreadSched::WorkStealingThreadSched()
+    : _next_thread_sched(0), _active(true), _using(false)
+{
+}
+
+WorkStealingThreadSched::~WorkStealingThreadSched()
+{
+}
+
+int
+WorkStealingThreadSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _active = true;
+    if (Args(this, errh).bind(conf)
+	.read("ACTIVE", _active)
+	.consume() < 0)
+	return -1;
+    for (int i = 0; i < conf.size(); i++) {
+	Element *e;
+	if (Args(this, errh).push_back(conf[i])
+	    .read_mp("ELEMENT", e)
+	    .complete() < 0)
+	    return -1;
+	_pinned.force_bit(e->eindex()) = true;
+    }
+    _next_thread_sched = router()->thread_sched();
+    router()->set_thread_sched(this);
+    return 0;
+}
+
+int
+WorkStealingThreadSched::initialize(ErrorHandler *)
+{
+    set_active(_active);
+    return 0;
+}
+
+void
+WorkStealingThreadSched::cleanup(CleanupStage)
+{
+    set_active(false);
+}
+
+void
+WorkStealingThreadSched::set_active(bool active)
+{
+    _active = active;
+    if (active && !_using)
+	master()->use_work_stealing();
+    else if (!active && _using)
+	master()->unuse_work_stealing();
+    _using = active;
+}
+
+int
+WorkStealingThreadSched::initial_home_thread_id(const Element *e)
+{
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_home_thread_id(e);
+    else
+	return THREAD_UNKNOWN;
+}
+
+bool
+WorkStealingThreadSched::initial_task_stealable(const Element *e)
+{
+    int eidx = e->eindex();
+    if (eidx >= 0 && eidx < _pinned.size() && _pinned[eidx])
+	return false;
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_task_stealable(e);
+    else
+	return true;
+}
+
+enum { h_active, h_steals };
+
+String
+WorkStealingThreadSched::read_handler(Element *e, void *thunk)
+{
+    WorkStealingThreadSched *wts = static_cast<WorkStealingThreadSched *>(e);
+    switch ((intptr_t) thunk) {
+    case h_active:
+	return String(wts->_active);
+    case h_steals: {
+	Master *m = wts->master();
+	unsigned steals = 0;
+	for (int tid = 0; tid < m->nthreads(); tid++)
+	    steals += m->thread(tid)->task_steals();
+	return String(steals);
+    }
+    default:
+	return String();
+    }
+}
+
+int
+WorkStealingThreadSched::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    WorkStealingThreadSched *wts = static_cast<WorkStealingThreadSched *>(e);
+    bool active;
+    if (!BoolArg().parse(str, active))
+	return errh->error("syntax error");
+    wts->set_active(active);
+    return 0;
+}
+
+void
+WorkStealingThreadSched::add_handlers()
+{
+    add_read_handler("active", read_handler, h_active, Handler::CHECKBOX);
+    add_write_handler("active", write_handler, h_active);
+    add_read_handler("steals", read_handler, h_steals);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(multithread)
+EXPORT_ELEMENT(WorkStealingThreadSched)
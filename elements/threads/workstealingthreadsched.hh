@@ -0,0 +1,79 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_WORKSTEALINGTHREADSCHED_HH
+#define CLICK_WORKSTEALINGTHREADSCHED_HH
+#include <click/element.hh>
+#include <click/standard/threadsched.hh>
+#include <click/bitvector.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * WorkStealingThreadSched([ELEMENT, ..., I<keywords> ACTIVE])
+ * =s threads
+ * lets idle threads steal tasks from busy threads
+ * =d
+ *
+ * Turns on work stealing.  Whenever a thread runs out of scheduled tasks, it
+ * asks another thread to hand over a task.  A thread with at least two
+ * scheduled tasks gives up the stealable task that would run last.  Unlike
+ * BalancedThreadSched, which moves tasks periodically based on cycle counts,
+ * work stealing reacts as soon as a thread goes idle.
+ *
+ * Tasks belonging to the ELEMENT arguments are never stolen, which keeps
+ * device-polling tasks near their devices.  Neither are tasks of elements
+ * bound to a thread by StaticThreadSched, or tasks that their elements mark
+ * as not stealable (see Task::set_stealable).
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item ACTIVE
+ *
+ * Boolean.  If false, do not steal tasks until the C<active> handler is set
+ * to true.  Default is true.
+ *
+ * =back
+ *
+ * =h active read/write
+ *
+ * Returns or sets the ACTIVE setting.
+ *
+ * =h steals read-only
+ *
+ * Returns the number of tasks moved by work stealing on all threads.
+ *
+ * =a StaticThreadSched, BalancedThreadSched, AutoThreadSched
+ */
+
+class WorkStealingThreadSched : public Element, public ThreadSched { public:
+
+    WorkStealingThreadSched();
+    ~WorkStealingThreadSched();
+
+    const char *class_name() const	{ return "WorkStealingThreadSched"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    int initial_home_thread_id(const Element *e);
+    bool initial_task_stealable(const Element *e);
+
+  private:
+
+    Bitvector _pinned;
+    ThreadSched *_next_thread_sched;
+    bool _active;
+    bool _using;
+
+    void set_active(bool active);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,171 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * adaptivepoll.{cc,hh} -- element backs off idle polling threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+#include <click/config.h>
+#include "adaptivepoll.hh"
+#include <click/task.hh>
+#include <click/master.hh>
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+AdaptivePoll::AdaptivePoll()
+    : _applied(false)
+{
+}
+
+AdaptivePoll::~AdaptivePoll()
+{
+}
+
+int
+AdaptivePoll::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _thread = -1;
+    _spin = 1000;
+    _pause = 1000;
+    _yield = 100;
+    _sleep = Timestamp::make_msec(1);
+    if (Args(conf, this, errh)
+	.read_p("THREAD", _thread)
+	.read("SPIN", _spin)
+	.read("PAUSE", _pause)
+	.read("YIELD", _yield)
+	.read("SLEEP", _sleep)
+	.complete() < 0)
+	return -1;
+    if (_thread < -1 || _thread >= master()->nthreads())
+	return errh->error("no thread %d", _thread);
+    if (_sleep < Timestamp())
+	return errh->error("SLEEP must be nonnegative");
+    return 0;
+}
+
+void
+AdaptivePoll::apply(bool on)
+{
+    Master *m = master();
+    int tid = _thread < 0 ? 0 : _thread;
+    int end = _thread < 0 ? m->nthreads() : _thread + 1;
+    for (; tid < end; ++tid)
+	if (on)
+	    m->thread(tid)->set_idle_poll(_spin, _pause, _yield, _sleep);
+	else
+	    m->thread(tid)->clear_idle_poll();
+    _applied = on;
+}
+
+int
+AdaptivePoll::initialize(ErrorHandler *)
+{
+    apply(true);
+    return 0;
+}
+
+void
+AdaptivePoll::cleanup(CleanupStage)
+{
+    if (_applied)
+	apply(false);
+}
+
+enum { h_spin, h_pause, h_yield, h_sleep, h_pauses, h_yields, h_sleeps };
+
+String
+AdaptivePoll::read_handler(Element *e, void *thunk)
+{
+    AdaptivePoll *ap = static_cast<AdaptivePoll *>(e);
+    switch ((intptr_t) thunk) {
+    case h_spin:
+	return String(ap->_spin);
+    case h_pause:
+	return String(ap->_pause);
+    case h_yield:
+	return String(ap->_yield);
+    case h_sleep:
+	return ap->_sleep.unparse_interval();
+    case h_pauses:
+    case h_yields:
+    case h_sleeps: {
+	Master *m = ap->master();
+	int tid = ap->_thread < 0 ? 0 : ap->_thread;
+	int end = ap->_thread < 0 ? m->nthreads() : ap->_thread + 1;
+	unsigned count = 0;
+	for (; tid < end; ++tid) {
+	    RouterThread *t = m->thread(tid);
+	    if ((intptr_t) thunk == h_pauses)
+		count += t->idle_pauses();
+	    else if ((intptr_t) thunk == h_yields)
+		count += t->idle_yields();
+	    else
+		count += t->idle_sleeps();
+	}
+	return String(count);
+    }
+    default:
+	return String();
+    }
+}
+
+int
+AdaptivePoll::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    AdaptivePoll *ap = static_cast<AdaptivePoll *>(e);
+    switch ((intptr_t) thunk) {
+    case h_spin:
+    case h_pause:
+    case h_yield: {
+	unsigned x;
+	if (!IntArg().parse(str, x))
+	    return errh->error("syntax error");
+	if ((intptr_t) thunk == h_spin)
+	    ap->_spin = x;
+	else if ((intptr_t) thunk == h_pause)
+	    ap->_pause = x;
+	else
+	    ap->_yield = x;
+	break;
+    }
+    case h_sleep: {
+	Timestamp t;
+	if (!cp_time(str, &t) || t < Timestamp())
+	    return errh->error("syntax error");
+	ap->_sleep = t;
+	break;
+    }
+    default:
+	return -1;
+    }
+    if (ap->_applied)
+	ap->apply(true);
+    return 0;
+}
+
+void
+AdaptivePoll::add_handlers()
+{
+    static const char * const names[] = {
+	"spin", "pause", "yield", "sleep", "pauses", "yields", "sleeps"
+    };
+    for (intptr_t h = h_spin; h <= h_sleep; ++h) {
+	add_read_handler(names[h], read_handler, h);
+	add_write_handler(names[h], write_handler, h);
+    }
+    for (intptr_t h = h_pauses; h <= h_sleeps; ++h)
+	add_read_handler(names[h], read_handler, h);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(AdaptivePoll)
@@ -0,0 +1,132 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ADAPTIVEPOLL_HH
+#define CLICK_ADAPTIVEPOLL_HH
+#include <click/element.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+=c
+
+AdaptivePoll([THREAD, I<keywords> SPIN, PAUSE, YIELD, SLEEP])
+
+=s threads
+
+backs off idle polling threads
+
+=d
+
+Turns on adaptive idle polling for driver thread THREAD, or for every thread
+if THREAD is not given.  Polling tasks, such as those of FromNetmapDevice or
+Unqueue, stay scheduled even when they find no packets, so a thread running
+them normally spins at full CPU however light the load.  Under adaptive
+idle polling, the thread counts consecutive driver iterations in which its
+scheduled tasks do no work, and backs off in stages: for the first SPIN
+empty iterations it keeps spinning; for the next PAUSE it executes a CPU
+pause instruction each time; for the next YIELD it yields the CPU to the
+operating system each time; and after that, each empty iteration sleeps in
+the thread's select() for up to SLEEP.  The first iteration in which a task
+does work resets the count.
+
+A sleeping thread wakes as soon as one of its file descriptors is ready, a
+timer comes due, or another thread reschedules one of its tasks, so only
+work that makes no such signal, such as packets arriving at a polled
+device, waits out the sleep.  Larger thresholds thus trade CPU time and
+power for latency.  The poll and epoll selectors wait in whole
+milliseconds, so SLEEP values below 1ms act as yields there.
+
+Use one AdaptivePoll element per thread to tune threads separately.
+
+Keyword arguments are:
+
+=over 8
+
+=item SPIN
+
+Integer.  Empty iterations spent spinning.  Default is 1000.
+
+=item PAUSE
+
+Integer.  Further empty iterations that each pause.  Default is 1000.
+
+=item YIELD
+
+Integer.  Further empty iterations that each yield.  Default is 100.
+
+=item SLEEP
+
+Time.  Longest sleep.  If 0, the thread never sleeps, but keeps yielding.
+Default is 1ms.
+
+=back
+
+=h spin read/write
+
+Returns or sets SPIN.
+
+=h pause read/write
+
+Returns or sets PAUSE.
+
+=h yield read/write
+
+Returns or sets YIELD.
+
+=h sleep read/write
+
+Returns or sets SLEEP.
+
+=h pauses read-only
+
+Returns the number of empty iterations that paused.
+
+=h yields read-only
+
+Returns the number of empty iterations that yielded.
+
+=h sleeps read-only
+
+Returns the number of empty iterations that slept.
+
+=n
+
+Statistics count all use of the thread, including that by other
+AdaptivePoll elements or earlier configurations.
+
+=e
+
+  FromNetmapDevice(netmap:eth0) -> ... -> ToNetmapDevice(netmap:eth1);
+  AdaptivePoll(SPIN 10000, PAUSE 10000, YIELD 100, SLEEP 2ms);
+
+=a StaticThreadSched, WorkStealingThreadSched */
+
+class AdaptivePoll : public Element { public:
+
+    AdaptivePoll();
+    ~AdaptivePoll();
+
+    const char *class_name() const	{ return "AdaptivePoll"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+  private:
+
+    int _thread;			// -1 means all threads
+    unsigned _spin;
+    unsigned _pause;
+    unsigned _yield;
+    Timestamp _sleep;
+    bool _applied;
+
+    void apply(bool on);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
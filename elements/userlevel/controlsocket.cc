@@ -31,9 +31,12 @@
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#if HAVE_USER_MULTITHREAD
+# include <signal.h>
+#endif
 CLICK_DECLS
 
-const char ControlSocket::protocol_version[] = "1.3";
+const char ControlSocket::protocol_version[] = "1.4";
 
 class ControlSocketErrorHandler : public ErrorHandler { public:
 
@@ -83,8 +86,12 @@ ControlSocketErrorHandler::account(int level)
 
 
 ControlSocket::ControlSocket()
-  : _socket_fd(-1), _proxy(0), _full_proxy(0), _retry_timer(0)
+  : _socket_fd(-1), _proxy(0), _full_proxy(0),
+    _handler_cache_generation(Router::handler_generation()), _retry_timer(0)
 {
+#if HAVE_USER_MULTITHREAD
+    _job_pipe[0] = _job_pipe[1] = -1;
+#endif
 }
 
 ControlSocket::~ControlSocket()
@@ -296,6 +303,10 @@ ControlSocket::take_state(Element *e, ErrorHandler *errh)
 	errh->error("already initialized, can't take state");
 	return;
     }
+#if HAVE_USER_MULTITHREAD
+    // outstanding reads refer to the old router's elements
+    cs->finish_read_jobs(true);
+#endif
 
     _socket_fd = cs->_socket_fd;
     _unix_pathname = cs->_unix_pathname; // in case _unix_pathname == "41930+"
@@ -309,6 +320,19 @@ ControlSocket::take_state(Element *e, ErrorHandler *errh)
 	    add_select((*it)->fd, SELECT_READ);
 	if (*it && !(*it)->out_closed)
 	    add_select((*it)->fd, SELECT_WRITE);
+	// move subscription timers to this router
+	if (*it)
+	    for (subscription **sp = (*it)->subscriptions.begin();
+		 sp != (*it)->subscriptions.end(); ++sp) {
+		subscription *old = *sp;
+		*sp = new subscription(this, *it, old->id, old->interval_msec);
+		(*sp)->seq = old->seq;
+		(*sp)->handlers.swap(old->handlers);
+		(*sp)->values.swap(old->values);
+		(*sp)->timer.initialize(this);
+		(*sp)->timer.schedule_after_msec(old->interval_msec);
+		delete old;
+	    }
     }
 }
 
@@ -329,6 +353,14 @@ ControlSocket::cleanup(CleanupStage)
 	    unlink(_unix_pathname.c_str());
 	_socket_fd = -1;
     }
+#if HAVE_USER_MULTITHREAD
+    finish_read_jobs(true);
+    if (_job_pipe[0] >= 0) {
+	close(_job_pipe[0]);
+	close(_job_pipe[1]);
+	_job_pipe[0] = _job_pipe[1] = -1;
+    }
+#endif
     for (connection **it = _conns.begin(); it != _conns.end(); ++it)
 	if (*it) {
 	    (*it)->flush_write(this, false);	// try one last time to emit all data
@@ -341,6 +373,12 @@ ControlSocket::cleanup(CleanupStage)
     }
 }
 
+ControlSocket::connection::~connection()
+{
+    for (subscription **it = subscriptions.begin(); it != subscriptions.end(); ++it)
+	delete *it;
+}
+
 int
 ControlSocket::connection::message(int code, const String &msg, bool continuation)
 {
@@ -474,6 +512,16 @@ ControlSocket::parse_handler(connection &conn, const String &full_name, Element
     }
   }
 
+  // Check for a handler resolved earlier.
+  if (_handler_cache_generation != Router::handler_generation()) {
+    _handler_cache.clear();
+    _handler_cache_generation = Router::handler_generation();
+  }
+  if (HashTable<String, cached_handler>::iterator it = _handler_cache.find(full_name)) {
+    *es = it.value().e;
+    return Router::handler(router(), it.value().hindex);
+  }
+
   // Otherwise, find element.
   Element *e;
   const char *dot = find(canonical_name, '.');
@@ -498,8 +546,14 @@ ControlSocket::parse_handler(connection &conn, const String &full_name, Element
   }
 
   // Then find handler.
-  const Handler* h = Router::handler(e, hname);
+  int hi = Router::hindex(e, hname);
+  const Handler* h = Router::handler(router(), hi);
   if (h && h->visible()) {
+    if (_handler_cache_generation == Router::handler_generation()) {
+      if (_handler_cache.size() >= HANDLER_CACHE_SIZE)
+	_handler_cache.clear();
+      _handler_cache.set(full_name, cached_handler(e, hi));
+    }
     *es = e;
     return h;
   } else {
@@ -508,8 +562,10 @@ ControlSocket::parse_handler(connection &conn, const String &full_name, Element
   }
 }
 
+// Calls a read handler.  On error, reports messages to conn and returns
+// ANY_ERR; otherwise stores the results in data and returns 0.
 int
-ControlSocket::read_command(connection &conn, const String &handlername, String param)
+ControlSocket::call_read(connection &conn, const String &handlername, const String &param, String &data)
 {
   Element *e;
   const Handler* h = parse_handler(conn, handlername, &e);
@@ -522,18 +578,231 @@ ControlSocket::read_command(connection &conn, const String &handlername, String
   ControlSocketErrorHandler errh;
   _proxied_handler = h->name();
   _proxied_errh = &errh;
-  String data = h->call_read(e, param, &errh);
+  data = h->call_read(e, param, &errh);
   _proxied_errh = 0;
 
   // did we get an error message?
   if (errh.nerrors() > 0)
     return conn.transfer_messages(CSERR_UNSPECIFIED, "Read handler '" + handlername + "' error", &errh);
+  return 0;
+}
 
+int
+ControlSocket::read_command(connection &conn, const String &handlername, String param)
+{
+#if HAVE_USER_MULTITHREAD
+  // Concurrent handlers run on their own thread; finish_read_job responds.
+  if (!_proxy) {
+    Element *e;
+    const Handler *h = parse_handler(conn, handlername, &e);
+    if (!h)
+      return ANY_ERR;
+    else if (h->read_visible() && h->concurrent()
+	     && start_read_job(conn, h, e, handlername, param))
+      return 0;
+  }
+#endif
+  String data;
+  if (call_read(conn, handlername, param, data) < 0)
+    return ANY_ERR;
   conn.message(CSERR_OK, "Read handler '" + handlername + "' OK");
   conn.out_text << "DATA " << data.length() << '\r' << '\n' << data;
   return 0;
 }
 
+#if HAVE_USER_MULTITHREAD
+// Starts a thread that calls h's read handler.  Returns false if the thread
+// could not be started, in which case the caller should call it directly.
+bool
+ControlSocket::start_read_job(connection &conn, const Handler *h, Element *e,
+			      const String &handlername, const String &param)
+{
+  if (_job_pipe[0] < 0) {
+    if (pipe(_job_pipe) < 0)
+      return false;
+    for (int i = 0; i < 2; ++i) {
+      fcntl(_job_pipe[i], F_SETFL, O_NONBLOCK);
+      fcntl(_job_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    add_select(_job_pipe[0], SELECT_READ);
+  }
+
+  read_job *job = new read_job;
+  job->cs = this;
+  job->h = h;
+  job->e = e;
+  job->handlername = handlername;
+  job->param = param;
+  job->errh = new ControlSocketErrorHandler;
+  job->done = 0;
+
+  // leave signals to the driver's threads
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  int err = pthread_create(&job->thread, 0, read_job_thread, job);
+  pthread_sigmask(SIG_SETMASK, &old, 0);
+  if (err != 0) {
+    delete job->errh;
+    delete job;
+    return false;
+  }
+  conn.job = job;
+  return true;
+}
+
+void *
+ControlSocket::read_job_thread(void *thunk)
+{
+  read_job *job = static_cast<read_job *>(thunk);
+  job->data = job->h->call_read(job->e, job->param, job->errh);
+  job->done = 1;
+  // wake up the router thread; if the pipe is full, it is already awake
+  char c = 0;
+  ssize_t w = write(job->cs->_job_pipe[1], &c, 1);
+  (void) w;
+  return 0;
+}
+
+// Waits for conn's read job and reports its results to conn.
+void
+ControlSocket::finish_read_job(connection &conn)
+{
+  read_job *job = conn.job;
+  pthread_join(job->thread, 0);
+  conn.job = 0;
+  if (job->errh->nerrors() > 0)
+    conn.transfer_messages(CSERR_UNSPECIFIED, "Read handler '" + job->handlername + "' error", job->errh);
+  else {
+    conn.message(CSERR_OK, "Read handler '" + job->handlername + "' OK");
+    conn.out_text << "DATA " << job->data.length() << '\r' << '\n' << job->data;
+  }
+  delete job->errh;
+  delete job;
+}
+
+// Finishes finished read jobs, or, if wait is true, all read jobs.
+void
+ControlSocket::finish_read_jobs(bool wait)
+{
+  for (connection **it = _conns.begin(); it != _conns.end(); ++it)
+    if (*it && (*it)->job && (wait || (*it)->job->done)) {
+      finish_read_job(**it);
+      // selected() sends the response and processes later commands
+      if (!wait)
+	add_select((*it)->fd, SELECT_WRITE);
+    }
+}
+#endif
+
+// Reads each handler and appends an entry for it to body, in the format
+// READMANY documents.  If values is nonnull, it holds each handler's
+// previous entry, and unchanged handlers are left out.  Returns the number
+// of entries appended.
+int
+ControlSocket::read_many(connection &conn, const Vector<String> &handlers,
+			 StringAccum &body, Vector<String> *values)
+{
+  int n = 0;
+  for (int i = 0; i < handlers.size(); ++i) {
+    // errors go to a scratch connection, whose output becomes the entry
+    connection scratch(conn.fd);
+    String data;
+    int code = CSERR_OK;
+    if (call_read(scratch, handlers[i], String(), data) < 0) {
+      data = scratch.out_text.take_string();
+      if (!IntArg().parse(data.substring(0, 3), code))
+	code = CSERR_UNSPECIFIED;
+    }
+    StringAccum entry;
+    entry << code << ' ' << handlers[i] << ' ' << data.length() << '\r' << '\n' << data;
+    if (values) {
+      String s = entry.take_string();
+      if ((*values)[i] == s)
+	continue;
+      body << s;
+      (*values)[i] = s;
+    } else
+      body << entry;
+    ++n;
+  }
+  return n;
+}
+
+int
+ControlSocket::readmany_command(connection &conn, const Vector<String> &words)
+{
+  Vector<String> handlers;
+  for (const String *it = words.begin() + 1; it != words.end(); ++it)
+    handlers.push_back(*it);
+  StringAccum body;
+  read_many(conn, handlers, body, 0);
+  conn.message(CSERR_OK, "Read " + String(handlers.size()) + " handlers OK");
+  conn.out_text << "DATA " << body.length() << '\r' << '\n' << body;
+  return 0;
+}
+
+int
+ControlSocket::subscribe_command(connection &conn, const Vector<String> &words)
+{
+  uint32_t interval_msec;
+  if (!SecondsArg(3).parse(words[1], interval_msec) || interval_msec == 0)
+    return conn.message(CSERR_SYNTAX, "Syntax error in interval '" + words[1] + "'");
+  for (const String *it = words.begin() + 2; it != words.end(); ++it) {
+    Element *e;
+    const Handler *h = parse_handler(conn, *it, &e);
+    if (!h)
+      return ANY_ERR;
+    else if (!h->read_visible())
+      return conn.message(CSERR_PERMISSION, "Handler '" + *it + "' write-only");
+  }
+
+  subscription *sub = new subscription(this, &conn, conn.next_subscription_id++, interval_msec);
+  for (const String *it = words.begin() + 2; it != words.end(); ++it)
+    sub->handlers.push_back(*it);
+  sub->values.resize(sub->handlers.size());
+  sub->timer.initialize(this);
+  sub->timer.schedule_after_msec(interval_msec);
+  conn.subscriptions.push_back(sub);
+  return conn.message(CSERR_OK, "Subscription " + String(sub->id));
+}
+
+int
+ControlSocket::unsubscribe_command(connection &conn, const String &idstr)
+{
+  int id;
+  if (!IntArg().parse(idstr, id))
+    return conn.message(CSERR_SYNTAX, "Syntax error in subscription '" + idstr + "'");
+  for (subscription **it = conn.subscriptions.begin(); it != conn.subscriptions.end(); ++it)
+    if ((*it)->id == id) {
+      delete *it;
+      conn.subscriptions.erase(it);
+      return conn.message(CSERR_OK, "Unsubscribed");
+    }
+  return conn.message(CSERR_SYNTAX, "No subscription '" + idstr + "'");
+}
+
+void
+ControlSocket::subscription_hook(Timer *, void *thunk)
+{
+  subscription *sub = static_cast<subscription *>(thunk);
+  connection *conn = sub->conn;
+  if (conn->out_closed)
+    return;
+  // Commands are handled whole in selected(), so out_text now ends between
+  // responses.  Don't let a client that stopped reading consume memory.
+  if (conn->out_text.length() - conn->outpos <= 1048576) {
+    StringAccum body;
+    if (sub->cs->read_many(*conn, sub->handlers, body, &sub->values) > 0) {
+      ++sub->seq;
+      conn->message(CSERR_UPDATE, "Update " + String(sub->id) + " " + String(sub->seq));
+      conn->out_text << "DATA " << body.length() << '\r' << '\n' << body;
+      conn->flush_write(sub->cs, false);
+    }
+  }
+  sub->timer.reschedule_after_msec(sub->interval_msec);
+}
+
 int
 ControlSocket::write_command(connection &conn, const String &handlername, String data)
 {
@@ -709,6 +978,21 @@ ControlSocket::parse_command(connection &conn, const String &line)
       else
 	  return write_command(conn, words[1], data);
 
+  } else if (command == "READMANY") {
+      if (words.size() < 2)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      return readmany_command(conn, words);
+
+  } else if (command == "SUBSCRIBE") {
+      if (words.size() < 3)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      return subscribe_command(conn, words);
+
+  } else if (command == "UNSUBSCRIBE") {
+      if (words.size() != 2)
+	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
+      return unsubscribe_command(conn, words[1]);
+
   } else if (command == "READDATA" || command == "WRITEDATA"
 	     || command == "SETDATA") {
       if (words.size() != 3)
@@ -782,6 +1066,7 @@ ControlSocket::parse_command(connection &conn, const String &line)
   } else if (command == "HELP") {
     conn.message(CSERR_OK, "Commands supported:", true);
     conn.message(CSERR_OK, "READ handler [arg...]   call read handler, return DATA", true);
+    conn.message(CSERR_OK, "READMANY handler...     call read handlers, return DATA", true);
     conn.message(CSERR_OK, "READDATA handler len    call read handler with len data bytes, return DATA", true);
     conn.message(CSERR_OK, "READUNTIL handler term  call read handler, take data until term, return DATA", true);
     conn.message(CSERR_OK, "WRITE handler [arg...]  call write handler", true);
@@ -790,6 +1075,8 @@ ControlSocket::parse_command(connection &conn, const String &line)
     conn.message(CSERR_OK, "CHECKREAD handler       check if read handler is valid", true);
     conn.message(CSERR_OK, "CHECKWRITE handler      check if write handler is valid", true);
     conn.message(CSERR_OK, "LLRPC elt#number [len]  call LLRPC, pass len data bytes, return DATA", true);
+    conn.message(CSERR_OK, "SUBSCRIBE int handler... send changed handler values every int seconds", true);
+    conn.message(CSERR_OK, "UNSUBSCRIBE id          cancel subscription", true);
     conn.message(CSERR_OK, "QUIT                    close connection");
     return 0;
 
@@ -839,6 +1126,16 @@ ControlSocket::selected(int fd, int)
 	fd = new_fd;
     }
 
+#if HAVE_USER_MULTITHREAD
+    if (fd == _job_pipe[0]) {
+	char buf[64];
+	while (read(_job_pipe[0], buf, sizeof(buf)) > 0)
+	    /* do nothing */;
+	finish_read_jobs(false);
+	return;
+    }
+#endif
+
     // find file descriptor
     if (fd >= _conns.size() || !_conns[fd])
 	return;
@@ -857,6 +1154,12 @@ ControlSocket::selected(int fd, int)
     // parse commands
     // 16.Jun.2004: process only one command each time through
     bool blocked = false;
+#if HAVE_USER_MULTITHREAD
+    // wait for an outstanding read before processing the next command
+    if (conn->job)
+	blocked = true;
+    else
+#endif
     if (conn->in_text.length()) {
 	const char *in_text = conn->in_text.begin() + conn->inpos;
 	const char *in_end = conn->in_text.end();
@@ -895,6 +1198,16 @@ ControlSocket::selected(int fd, int)
     conn->flush_write(this, conn->in_text.length() && !blocked);
 
     // maybe close out
+#if HAVE_USER_MULTITHREAD
+    if (conn->job) {
+	// don't spin on a closed socket; finish_read_jobs selects it again
+	if (conn->out_closed)
+	    remove_select(conn->fd, SELECT_READ | SELECT_WRITE);
+	else if (conn->in_closed)
+	    remove_select(conn->fd, SELECT_READ);
+	return;
+    }
+#endif
     if ((conn->in_closed && !conn->in_text.length() && !conn->out_text.length())
 	|| conn->out_closed) {
 	remove_select(conn->fd, SELECT_READ | SELECT_WRITE);
@@ -2,9 +2,14 @@
 #define CLICK_CONTROLSOCKET_HH
 #include "elements/userlevel/handlerproxy.hh"
 #include <click/straccum.hh>
+#include <click/hashtable.hh>
+#include <click/timer.hh>
+#if HAVE_USER_MULTITHREAD
+# include <click/atomic.hh>
+# include <pthread.h>
+#endif
 CLICK_DECLS
 class ControlSocketErrorHandler;
-class Timer;
 class Handler;
 
 /*
@@ -39,8 +44,8 @@ The server will accept lines terminated by CR, LF, or CRLF. Its response
 lines are always terminated by CRLF.
 
 When a connection is opened, the server responds by stating its protocol
-version number with a line like "Click::ControlSocket/1.3". The current
-version number is 1.3. Changes in minor version number will only add commands
+version number with a line like "Click::ControlSocket/1.4". The current
+version number is 1.4. Changes in minor version number will only add commands
 and functionality to this specification, not change existing functionality.
 
 ControlSocket supports hot-swapping, meaning you can change configurations
@@ -119,6 +124,26 @@ decimal integer indicating the length of the read handler data. The I<n>
 bytes immediately following (the CRLF that terminates) the DATA line are
 the handler's results.
 
+Some expensive read handlers, such as the C<table> handlers of large
+routing tables, are marked concurrent: they are safe to call while packets
+flow and other handlers run.  In multithreaded drivers, ControlSocket calls
+these handlers for READ, READDATA and READUNTIL on a separate thread, so the
+router thread running ControlSocket keeps processing packets, timers, and
+other connections' commands meanwhile.  The connection that issued the
+command receives the response, and has its later commands processed, once
+the handler returns.
+
+=item READMANY I<handler> [I<handler>...]
+
+Call several read I<handler>s, without parameters, and return all their
+results in one "DATA I<n>" block, as in the READ command. The block holds one
+entry per I<handler>, in order. Each entry is a line "I<code> I<handler>
+I<len>", terminated by CRLF, followed by I<len> bytes: the handler's results
+if I<code> is 200, or the error message lines READ would have returned if
+I<code> is an error code. The response code for the command itself is 200
+even if some handlers fail. Introduced in version 1.4 of the ControlSocket
+protocol.
+
 =item READDATA I<handler> I<n>
 
 Call a read I<handler>, passing the I<n> bytes immediately following (the CRLF
@@ -175,6 +200,30 @@ ControlSocket will not call an LLRPC unless it can determine (from the command
 number) how much data the LLRPC expects and returns. (Only "flat" LLRPCs may
 be called; they are declared using the _CLICK_IOC_[RWS]F macros.)
 
+=item SUBSCRIBE I<interval> I<handler> [I<handler>...]
+
+Subscribe to periodic updates of several read I<handler>s. Every
+I<interval> (a time in seconds, such as "1" or "250ms"), ControlSocket
+reads every I<handler> and sends an update message:
+
+  300 Update I<id> I<seq>
+  DATA I<n>
+
+followed by I<n> bytes in the READMANY format. To keep updates small, each
+update contains only the handlers whose results changed since the previous
+update (the first update has all of them), and ControlSocket sends no update
+when nothing changed. I<Id> is the subscription's ID and I<seq> counts
+updates, starting from 1. Updates are sent only between responses to
+commands, never inside one, and are skipped while the client has more
+than a megabyte of output waiting. The SUBSCRIBE response is "200
+Subscription I<id>". Introduced in version 1.4 of the ControlSocket
+protocol.
+
+=item UNSUBSCRIBE I<id>
+
+Cancel subscription I<id>. Subscriptions also end when the connection
+closes. Introduced in version 1.4 of the ControlSocket protocol.
+
 =item QUIT
 
 Close the connection.
@@ -188,6 +237,9 @@ The server's response codes follow this pattern.
 =item 2xy
 The command succeeded.
 
+=item 3xy
+A subscription update, sent independently of any command.
+
 =item 5xy
 The command failed.
 
@@ -197,6 +249,7 @@ Here are some of the particular error messages:
 
   200 OK.
   220 OK, but the handler reported some warnings.
+  300 Subscription update.
   500 Syntax error.
   501 Unimplemented command.
   510 No such element.
@@ -205,6 +258,9 @@ Here are some of the particular error messages:
   530 Permission denied.
   540 No router installed.
 
+ControlSocket remembers the handlers named by recent commands, so
+repeated requests for the same handler skip element and handler lookup.
+
 ControlSocket is only available in user-level processes.
 
 =e
@@ -228,6 +284,7 @@ class ControlSocket : public Element { public:
     ~ControlSocket();
 
     const char *class_name() const	{ return "ControlSocket"; }
+    int configure_phase() const		{ return CONFIGURE_PHASE_LAST; }
 
     int configure(Vector<String> &conf, ErrorHandler *);
     int initialize(ErrorHandler *);
@@ -241,6 +298,7 @@ class ControlSocket : public Element { public:
     enum {
 	CSERR_OK			= HandlerProxy::CSERR_OK,	       // 200
 	CSERR_OK_HANDLER_WARNING	= 220,
+	CSERR_UPDATE			= 300,
 	CSERR_SYNTAX			= HandlerProxy::CSERR_SYNTAX,          // 500
 	CSERR_UNIMPLEMENTED		= 501,
 	CSERR_NO_SUCH_ELEMENT		= HandlerProxy::CSERR_NO_SUCH_ELEMENT, // 510
@@ -267,6 +325,36 @@ class ControlSocket : public Element { public:
     Element *_proxy;
     HandlerProxy *_full_proxy;
 
+    struct connection;
+    struct subscription {
+	ControlSocket *cs;
+	connection *conn;
+	int id;
+	uint32_t seq;
+	uint32_t interval_msec;
+	Vector<String> handlers;
+	Vector<String> values;
+	Timer timer;
+	subscription(ControlSocket *cs_, connection *conn_, int id_, uint32_t interval_msec_)
+	    : cs(cs_), conn(conn_), id(id_), seq(0),
+	      interval_msec(interval_msec_), timer(subscription_hook, this) {
+	}
+    };
+
+#if HAVE_USER_MULTITHREAD
+    struct read_job {
+	ControlSocket *cs;
+	const Handler *h;
+	Element *e;
+	String handlername;
+	String param;
+	String data;
+	ControlSocketErrorHandler *errh;
+	pthread_t thread;
+	atomic_uint32_t done;
+    };
+#endif
+
     struct connection {
 	int fd;
 	StringAccum in_text;
@@ -275,10 +363,19 @@ class ControlSocket : public Element { public:
 	int outpos;
 	bool in_closed;
 	bool out_closed;
+	int next_subscription_id;
+	Vector<subscription *> subscriptions;
+#if HAVE_USER_MULTITHREAD
+	read_job *job;
+#endif
 	connection(int fd_)
 	    : fd(fd_), inpos(0), outpos(0),
-	      in_closed(false), out_closed(false) {
+	      in_closed(false), out_closed(false), next_subscription_id(1) {
+#if HAVE_USER_MULTITHREAD
+	    job = 0;
+#endif
 	}
+	~connection();
 	int message(int code, const String &msg, bool continuation = false);
 	int transfer_messages(int default_code, const String &msg, ControlSocketErrorHandler *);
 	static void contract(StringAccum &sa, int &pos);
@@ -291,9 +388,29 @@ class ControlSocket : public Element { public:
     String _proxied_handler;
     ErrorHandler *_proxied_errh;
 
+    // handlers resolved by earlier requests, valid while
+    // Router::handler_generation() is unchanged
+    struct cached_handler {
+	Element *e;
+	int hindex;
+	cached_handler()
+	    : e(0), hindex(-1) {
+	}
+	cached_handler(Element *e_, int hindex_)
+	    : e(e_), hindex(hindex_) {
+	}
+    };
+    enum { HANDLER_CACHE_SIZE = 1024 };
+    HashTable<String, cached_handler> _handler_cache;
+    unsigned _handler_cache_generation;
+
     int _retries;
     Timer *_retry_timer;
 
+#if HAVE_USER_MULTITHREAD
+    int _job_pipe[2];
+#endif
+
     enum { READ_CLOSED = 1, WRITE_CLOSED = 2, ANY_ERR = -1 };
 
     static const char protocol_version[];
@@ -305,7 +422,21 @@ class ControlSocket : public Element { public:
 
     String proxied_handler_name(const String &) const;
     const Handler* parse_handler(connection &conn, const String &, Element **);
+    int call_read(connection &conn, const String &, const String &, String &);
     int read_command(connection &conn, const String &, String);
+#if HAVE_USER_MULTITHREAD
+    bool start_read_job(connection &conn, const Handler *, Element *,
+			const String &, const String &);
+    static void *read_job_thread(void *);
+    void finish_read_job(connection &conn);
+    void finish_read_jobs(bool wait);
+#endif
+    int read_many(connection &conn, const Vector<String> &, StringAccum &,
+		  Vector<String> *);
+    int readmany_command(connection &conn, const Vector<String> &);
+    int subscribe_command(connection &conn, const Vector<String> &);
+    int unsubscribe_command(connection &conn, const String &);
+    static void subscription_hook(Timer *, void *);
     int write_command(connection &conn, const String &, String);
     int check_command(connection &conn, const String &, bool write);
     int llrpc_command(connection &conn, const String &, String);
@@ -116,13 +116,12 @@ unaligned_net_short(const void *v)
 #define IP_ETHERTYPE(et)	(UNALIGNED_NET_SHORT_EQ((et), ETHERTYPE_IP) || UNALIGNED_NET_SHORT_EQ((et), ETHERTYPE_IP6))
 
 
-// NB: May change 'p', but will never free it.
-bool
-fake_pcap_force_ip(Packet *&p, int dlt)
+// Returns the IP header of the 'dlt' frame in [data, end_data), or null.
+// The header is not checked and may be unaligned.
+const click_ip *
+fake_pcap_find_ip(const uint8_t *data, const uint8_t *end_data, int dlt)
 {
     const click_ip *iph = 0;
-    const uint8_t *data = p->data();
-    const uint8_t *end_data = p->end_data();
 
     switch (dlt) {
 
@@ -294,6 +293,15 @@ fake_pcap_force_ip(Packet *&p, int dlt)
 
     }
 
+    return iph;
+}
+
+// NB: May change 'p', but will never free it.
+bool
+fake_pcap_force_ip(Packet *&p, int dlt)
+{
+    const uint8_t *end_data = p->end_data();
+    const click_ip *iph = fake_pcap_find_ip(p->data(), end_data, dlt);
     if (!iph)
 	return false;
 
@@ -85,6 +85,7 @@ int fake_pcap_canonical_dlt(int, bool from_file);
 
 // Handling FORCE_IP.
 bool fake_pcap_dlt_force_ipable(int);
+const click_ip *fake_pcap_find_ip(const uint8_t *data, const uint8_t *end_data, int dlt);
 bool fake_pcap_force_ip(Packet*&, int);
 bool fake_pcap_force_ip(WritablePacket*&, int);
 
@@ -0,0 +1,271 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * flightrecorder.{cc,hh} -- record the paths of sampled packets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flightrecorder.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/router.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+FlightRecorder *FlightRecorder::the_recorder;
+
+FlightRecorder::FlightRecorder()
+    : _active(false)
+{
+    _next_id = 0;
+}
+
+FlightRecorder::~FlightRecorder()
+{
+}
+
+int
+FlightRecorder::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _sample = 1000;
+    _capacity = 4096;
+    _anno = TRACE_ANNO_OFFSET;
+    bool active = true;
+    if (Args(conf, this, errh)
+	.read("SAMPLE", _sample)
+	.read("CAPACITY", _capacity)
+	.read("ANNO", AnnoArg(4), _anno)
+	.read("ACTIVE", active)
+	.complete() < 0)
+	return -1;
+#if !HAVE_ELEMENT_PROFILE
+    return errh->error("not supported in this driver (requires user level without CLICK_STATS)");
+#endif
+    if (_sample < 1)
+	return errh->error("SAMPLE must be positive");
+    if (_capacity < 1 || _capacity > 0x1000000)
+	return errh->error("CAPACITY out of range");
+    uint32_t c = 1;
+    while (c < _capacity)
+	c <<= 1;
+    _capacity = c;
+    _active = active;
+    return 0;
+}
+
+int
+FlightRecorder::initialize(ErrorHandler *errh)
+{
+    if (_rings.initialize(master()) < 0)
+	return errh->error("out of memory");
+    for (int t = 0; t < _rings.size(); ++t) {
+	Ring &ring = _rings[t];
+	if (!(ring.r = new Record[_capacity]))
+	    return errh->error("out of memory");
+	memset(ring.r, 0, sizeof(Record) * _capacity);
+	ring.countdown = 1;
+    }
+    if (_active) {
+	_active = false;
+	return set_active(true, errh);
+    }
+    return 0;
+}
+
+void
+FlightRecorder::cleanup(CleanupStage)
+{
+    set_active(false, 0);
+    if (_rings.initialized())
+	for (int t = 0; t < _rings.size(); ++t)
+	    delete[] _rings[t].r;
+}
+
+int
+FlightRecorder::set_active(bool active, ErrorHandler *errh)
+{
+#if HAVE_ELEMENT_PROFILE
+    if (active && !_active) {
+	if (the_recorder)
+	    return errh->error("%s is already active", the_recorder->declaration().c_str());
+	the_recorder = this;
+	Element::set_packet_tracer(trace);
+    } else if (!active && _active) {
+	Element::set_packet_tracer(0);
+	the_recorder = 0;
+    }
+    _active = active;
+#else
+    (void) active, (void) errh;
+#endif
+    return 0;
+}
+
+void
+FlightRecorder::trace(Packet *p, Element *from, int from_port,
+		      Element *to, int to_port)
+{
+    FlightRecorder *fr = the_recorder;
+    uint32_t id = p->anno_u32(fr->_anno);
+    if (id == untraced)
+	return;
+    Ring &ring = fr->_rings.get();
+    if (id == 0) {
+	// First transfer of a new packet: sample it or mark it untraced.
+	if (ring.countdown > 1) {
+	    --ring.countdown;
+	    p->set_anno_u32(fr->_anno, untraced);
+	    return;
+	}
+	ring.countdown = fr->_sample;
+	do {
+	    id = fr->_next_id.fetch_and_add(1) + 1;
+	} while (id == 0 || id == untraced);
+	p->set_anno_u32(fr->_anno, id);
+    }
+    Record &r = ring.r[ring.head & (fr->_capacity - 1)];
+    r.cycles = click_get_cycles();
+    r.id = id;
+    r.from = from->eindex();
+    r.to = to->eindex();
+    r.from_port = from_port;
+    r.to_port = to_port;
+    ++ring.head;
+}
+
+int
+FlightRecorder::record_compar(const void *a, const void *b, void *)
+{
+    const Record *ra = static_cast<const Record *>(a),
+	*rb = static_cast<const Record *>(b);
+    if (ra->id != rb->id)
+	return ra->id < rb->id ? -1 : 1;
+    if (ra->cycles != rb->cycles)
+	return ra->cycles < rb->cycles ? -1 : 1;
+    return 0;
+}
+
+// Returns every valid record, grouped by trace ID in increasing order and
+// sorted by time within each trace.
+void
+FlightRecorder::collect(Vector<Record> &records) const
+{
+    int n = router()->nelements();
+    for (int t = 0; t < _rings.size(); ++t) {
+	const Ring &ring = _rings[t];
+	uint32_t count = ring.head < _capacity ? ring.head : _capacity;
+	for (uint32_t i = ring.head - count; i != ring.head; ++i) {
+	    const Record &r = ring.r[i & (_capacity - 1)];
+	    if (r.id && r.from >= 0 && r.from < n && r.to >= 0 && r.to < n)
+		records.push_back(r);
+	}
+    }
+    if (records.size())
+	click_qsort(records.begin(), records.size(), sizeof(Record), record_compar);
+}
+
+enum { h_active, h_sample, h_traces, h_ends, h_drops, h_clear };
+
+String
+FlightRecorder::read_handler(Element *e, void *thunk)
+{
+    FlightRecorder *fr = static_cast<FlightRecorder *>(e);
+    Router *router = fr->router();
+    int which = reinterpret_cast<intptr_t>(thunk);
+    if (which == h_active)
+	return BoolArg::unparse(fr->_active);
+    else if (which == h_sample)
+	return String(fr->_sample);
+
+    Vector<Record> records;
+    fr->collect(records);
+    StringAccum sa;
+    if (which == h_traces) {
+	click_cycles_t start = 0;
+	for (int i = 0; i < records.size(); ++i) {
+	    const Record &r = records[i];
+	    if (i == 0 || records[i - 1].id != r.id)
+		start = r.cycles;
+	    sa << r.id << ' ' << (r.cycles - start) << ' '
+	       << router->element(r.from)->name() << '[' << r.from_port
+	       << "] -> [" << r.to_port << ']'
+	       << router->element(r.to)->name() << '\n';
+	}
+	return sa.take_string();
+    }
+
+    Vector<int> ends(router->nelements(), 0);
+    for (int i = 0; i < records.size(); ++i)
+	if (i == records.size() - 1 || records[i + 1].id != records[i].id)
+	    ++ends[records[i].to];
+    while (1) {
+	int best = -1;
+	for (int i = 0; i < ends.size(); ++i)
+	    if (ends[i] > 0 && (best < 0 || ends[i] > ends[best]))
+		best = i;
+	if (best < 0)
+	    break;
+	Element *elt = router->element(best);
+	if (which == h_ends || elt->noutputs() > 0)
+	    sa << elt->name() << ' ' << ends[best] << '\n';
+	ends[best] = 0;
+    }
+    return sa.take_string();
+}
+
+int
+FlightRecorder::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    FlightRecorder *fr = static_cast<FlightRecorder *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_active: {
+	bool active;
+	if (!BoolArg().parse(str, active))
+	    return errh->error("syntax error");
+	return fr->set_active(active, errh);
+    }
+    case h_sample: {
+	uint32_t sample;
+	if (!IntArg().parse(str, sample) || sample < 1)
+	    return errh->error("sample must be a positive integer");
+	fr->_sample = sample;
+	return 0;
+    }
+    case h_clear:
+	for (int t = 0; t < fr->_rings.size(); ++t) {
+	    Ring &ring = fr->_rings[t];
+	    memset(ring.r, 0, sizeof(Record) * fr->_capacity);
+	    ring.head = 0;
+	}
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+FlightRecorder::add_handlers()
+{
+    add_read_handler("active", read_handler, h_active, Handler::CHECKBOX);
+    add_write_handler("active", write_handler, h_active);
+    add_read_handler("sample", read_handler, h_sample);
+    add_write_handler("sample", write_handler, h_sample);
+    add_read_handler("traces", read_handler, h_traces);
+    add_read_handler("ends", read_handler, h_ends);
+    add_read_handler("drops", read_handler, h_drops);
+    add_write_handler("clear", write_handler, h_clear, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(FlightRecorder)
@@ -0,0 +1,171 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLIGHTRECORDER_HH
+#define CLICK_FLIGHTRECORDER_HH
+#include <click/element.hh>
+#include <click/percpu.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FlightRecorder([I<keywords> SAMPLE, CAPACITY, ANNO, ACTIVE])
+
+=s debugging
+
+records the paths of sampled packets through the configuration
+
+=d
+
+FlightRecorder follows one in every SAMPLE packets through the router
+configuration, recording each connection the packet crosses, without adding
+elements to the configuration.  It is a low-overhead alternative to
+sprinkling Print elements around a large configuration to find where packets
+go or where they are dropped.
+
+While FlightRecorder is active, the router calls it on every push and pull
+transfer.  The first time it sees a packet, it decides whether to trace that
+packet and marks the decision in the packet's trace annotation: traced
+packets get a nonzero trace ID, others the value 0xFFFFFFFF.  Packets from
+Packet::clone() inherit the ID, so traces follow both copies.  For each
+transfer of a traced packet, FlightRecorder stores the connection (source
+element and output port, destination element and input port), the trace
+ID, and the cycle counter in a per-thread ring buffer of CAPACITY
+records, overwriting the oldest.  Recording takes no locks.
+
+While FlightRecorder is inactive, the only cost is one predictable test per
+transfer, the same test that guards run-time profiling (C<click --profile>).
+At most one FlightRecorder can be active at a time.
+
+FlightRecorder is available only in user-level drivers built without
+CLICK_STATS cycle accounting.
+
+Keyword arguments are:
+
+=over 8
+
+=item SAMPLE
+
+Integer.  Trace one in every SAMPLE packets.  Default is 1000.
+
+=item CAPACITY
+
+Integer.  Number of records in each thread's ring buffer, rounded up to a
+power of two.  Default is 4096.
+
+=item ANNO
+
+Annotation holding the trace ID; 4 bytes.  Default is the trace annotation
+(offset 44), which overlaps the second half of the performance counter
+annotation used by SetCycleCount, SetPerfCount and LatencyHistogram.
+Elements that change this annotation break traces.
+
+=item ACTIVE
+
+Boolean.  If false, FlightRecorder starts inactive.  Default is true.
+
+=back
+
+=h active read/write
+
+Returns or sets whether FlightRecorder is active.
+
+=h sample read/write
+
+Returns or sets the SAMPLE parameter.
+
+=h traces read-only
+
+Returns the recorded traces, oldest first, one transfer per line:
+
+   ID CYCLES FROM[OUTPORT] -> [INPORT]TO
+
+where CYCLES counts from the trace's first recorded transfer.  Traces whose
+oldest transfers have been overwritten appear without them.
+
+=h ends read-only
+
+Returns where traced packets were last seen, one "ELEMENT COUNT" line for
+each element at which one or more recorded traces end, most common first.
+For a sink like ToDevice or Discard, this counts packets delivered to it.
+
+=h drops read-only
+
+Like C<ends>, but lists only elements with output ports.  A packet whose
+trace ends at such an element was usually dropped there, as by a full Queue
+or a Classifier with no matching pattern, or is still stored there, as in a
+Queue.
+
+=h clear write-only
+
+Clears the recorded traces.
+
+Handlers read the ring buffers while other threads may be writing them, so
+a read concurrent with traffic may show a few partially written records.
+
+=e
+
+  fr :: FlightRecorder(SAMPLE 100);
+
+Reading C<fr.drops>, for instance through ControlSocket, shows the elements
+where sampled packets stopped.
+
+=a Print, LatencyHistogram */
+
+class FlightRecorder : public Element { public:
+
+    FlightRecorder();
+    ~FlightRecorder();
+
+    const char *class_name() const	{ return "FlightRecorder"; }
+    int configure_phase() const		{ return CONFIGURE_PHASE_INFO; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+  private:
+
+    enum { untraced = 0xFFFFFFFFU };
+
+    struct Record {
+	click_cycles_t cycles;
+	uint32_t id;
+	int from;
+	int to;
+	uint16_t from_port;
+	uint16_t to_port;
+    };
+
+    struct Ring {
+	Record *r;
+	uint32_t head;
+	uint32_t countdown;
+	Ring()
+	    : r(0), head(0), countdown(0) {
+	}
+    };
+
+    PerCPU<Ring> _rings;
+    uint32_t _capacity;
+    uint32_t _sample;
+    int _anno;
+    bool _active;
+    atomic_uint32_t _next_id;
+
+    static FlightRecorder *the_recorder;
+
+    int set_active(bool active, ErrorHandler *errh);
+    static void trace(Packet *p, Element *from, int from_port,
+		      Element *to, int to_port);
+    static int record_compar(const void *a, const void *b, void *);
+    void collect(Vector<Record> &records) const;
+
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
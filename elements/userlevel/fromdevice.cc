@@ -39,15 +39,23 @@
 #include <click/packet_anno.hh>
 #include <click/standard/scheduleinfo.hh>
 #include <click/userutils.hh>
+#include <click/master.hh>
 #include <unistd.h>
 #include <fcntl.h>
 #include "fakepcap.hh"
 
 #if FROMDEVICE_LINUX
 # include <sys/socket.h>
+# include <sys/mman.h>
 # include <net/if.h>
 # include <features.h>
-# if __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 1
+# include <linux/version.h>
+# if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 2, 0)
+/* <netpacket/packet.h> lacks the TPACKET_V3 definitions, and conflicts with
+   <linux/if_packet.h>, which has them. */
+#  include <linux/if_packet.h>
+#  include <net/ethernet.h>
+# elif __GLIBC__ >= 2 && __GLIBC_MINOR__ >= 1
 #  include <netpacket/packet.h>
 #  include <net/ethernet.h>
 # else
@@ -55,6 +63,12 @@
 #  include <linux/if_packet.h>
 #  include <linux/if_ether.h>
 # endif
+# if defined(TPACKET3_HDRLEN) && defined(PACKET_RX_RING)
+#  define FROMDEVICE_LINUX_RING 1
+# endif
+# if defined(PACKET_FANOUT_QM) && defined(PACKET_FANOUT_FLAG_UNIQUEID)
+#  define FROMDEVICE_LINUX_FANOUT 1
+# endif
 #endif
 
 CLICK_DECLS
@@ -64,7 +78,7 @@ FromDevice::FromDevice()
 #if FROMDEVICE_PCAP
       _pcap(0), _pcap_task(this), _pcap_complaints(0),
 #endif
-      _datalink(-1), _count(0), _promisc(0), _snaplen(0)
+      _nqueues(1), _datalink(-1), _count(0), _promisc(0), _snaplen(0)
 {
 #if FROMDEVICE_LINUX || FROMDEVICE_PCAP
     _fd = -1;
@@ -84,8 +98,14 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     _headroom += (4 - (_headroom + 2) % 4) % 4; // default 4/2 alignment
     _force_ip = false;
     _burst = 1;
+    _nqueues = 1;
+    _hash_anno = -1;
+#if FROMDEVICE_LINUX
+    _ring_block_size = 1 << 18;
+    _ring_nblocks = 64;
+#endif
     String bpf_filter, capture, encap_type;
-    bool has_encap;
+    bool has_encap, headroom_set;
     if (Args(conf, this, errh)
 	.read_mp("DEVNAME", _ifname)
 	.read_p("PROMISC", promisc)
@@ -96,17 +116,28 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CAPTURE", WordArg(), capture) // deprecated
 	.read("BPF_FILTER", bpf_filter)
 	.read("OUTBOUND", outbound)
-	.read("HEADROOM", _headroom)
+	.read("HEADROOM", _headroom).read_status(headroom_set)
 	.read("ENCAP", WordArg(), encap_type).read_status(has_encap)
 	.read("BURST", _burst)
+	.read("QUEUES", _nqueues)
+#if FROMDEVICE_LINUX
+	.read("RING_BLOCK_SIZE", _ring_block_size)
+	.read("RING_BLOCKS", _ring_nblocks)
+	.read("HASH_ANNO", AnnoArg(4), _hash_anno)
+#endif
 	.complete() < 0)
 	return -1;
     if (_snaplen > 8190 || _snaplen < 14)
 	return errh->error("SNAPLEN out of range");
     if (_headroom > 8190)
 	return errh->error("HEADROOM out of range");
+    _headroom_set = headroom_set;
     if (_burst <= 0)
 	return errh->error("BURST out of range");
+    if (_nqueues <= 0 || _nqueues > 1024)
+	return errh->error("QUEUES out of range");
+    if (noutputs() < _nqueues || noutputs() > _nqueues + 1)
+	return errh->error("QUEUES %d requires %d or %d outputs", _nqueues, _nqueues, _nqueues + 1);
 
 #if FROMDEVICE_PCAP
     _bpf_filter = bpf_filter;
@@ -132,6 +163,19 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 #if FROMDEVICE_LINUX
     else if (capture == "LINUX")
 	_capture = CAPTURE_LINUX;
+    else if (capture == "RING") {
+# if FROMDEVICE_LINUX_RING
+	_capture = CAPTURE_RING;
+	if (_ring_block_size < (uint32_t) getpagesize()
+	    || (_ring_block_size & (_ring_block_size - 1))
+	    || _ring_block_size > (1U << 30))
+	    return errh->error("RING_BLOCK_SIZE must be a power of two at least the page size");
+	if (_ring_nblocks == 0)
+	    return errh->error("RING_BLOCKS out of range");
+# else
+	return errh->error("METHOD RING requires TPACKET_V3 support");
+# endif
+    }
 #endif
 #if FROMDEVICE_PCAP
     else if (capture == "PCAP")
@@ -142,6 +186,15 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 
     if (bpf_filter && _capture != CAPTURE_PCAP)
 	errh->warning("not using METHOD PCAP, BPF filter ignored");
+    if (_hash_anno >= 0 && _capture != CAPTURE_RING)
+	errh->warning("not using METHOD RING, HASH_ANNO ignored");
+    if (_nqueues > 1) {
+	if (_capture != CAPTURE_LINUX && _capture != CAPTURE_RING)
+	    return errh->error("QUEUES requires METHOD LINUX or RING");
+#if !FROMDEVICE_LINUX_FANOUT
+	return errh->error("QUEUES requires PACKET_FANOUT support");
+#endif
+    }
 
     _sniffer = sniffer;
     _promisc = promisc;
@@ -221,6 +274,189 @@ FromDevice::set_promiscuous(int fd, String ifname, bool promisc)
 }
 #endif /* FROMDEVICE_LINUX */
 
+#if FROMDEVICE_LINUX_RING
+/* A TPACKET_V3 receive ring.  Packets emitted in RING mode point into ring
+   blocks.  Each block counts the packets that still refer to it, plus one
+   while FromDevice is reading it; when the count reaches zero, the block is
+   returned to the kernel.  The Ring itself lives until FromDevice closes it
+   and every block has been returned, so packets may outlive the element. */
+struct FromDevice::Ring {
+    struct Block {		// stored in the block's private area
+	Ring *ring;
+	tpacket_block_desc *desc;
+	atomic_uint32_t refs;
+    };
+
+    unsigned char *map;
+    size_t map_size;
+    uint32_t block_size;
+    uint32_t nblocks;
+    uint32_t cur;		// index of the block being read
+    uint32_t npending;		// frames left to read in block cur
+    unsigned char *frame;	// next frame in block cur
+    Block *block;		// private area of block cur, if open
+    atomic_uint32_t live;	// 1 while open, plus 1 per block held
+
+    tpacket_block_desc *desc(uint32_t i) const {
+	return reinterpret_cast<tpacket_block_desc *>(map + (size_t) i * block_size);
+    }
+    static inline void fence() {
+# if HAVE___SYNC_SYNCHRONIZE
+	__sync_synchronize();
+# else
+	click_compiler_fence();
+# endif
+    }
+    static void release(Block *b) {
+	Ring *r = b->ring;
+	fence();
+	b->desc->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	if (r->live.dec_and_test()) {
+	    munmap(r->map, r->map_size);
+	    delete r;
+	}
+    }
+};
+
+/* A packet's buffer starts TPACKET_ALIGNMENT bytes into its frame.  The
+   frame's first bytes, which held the consumed tpacket3_hdr, point to the
+   frame's Block. */
+void
+FromDevice::ring_destructor(unsigned char *head, size_t)
+{
+    Ring::Block *b = *reinterpret_cast<Ring::Block **>(head - TPACKET_ALIGNMENT);
+    if (b->refs.dec_and_test())
+	Ring::release(b);
+}
+
+int
+FromDevice::open_ring(Queue &q, ErrorHandler *errh)
+{
+    int version = TPACKET_V3;
+    if (setsockopt(q.fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+	return errh->error("%s: PACKET_VERSION: %s", _ifname.c_str(), strerror(errno));
+    // Reserve headroom in front of each frame's link header.
+    unsigned reserve = _headroom;
+    if (setsockopt(q.fd, SOL_PACKET, PACKET_RESERVE, &reserve, sizeof(reserve)) < 0)
+	return errh->error("%s: PACKET_RESERVE: %s", _ifname.c_str(), strerror(errno));
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = _ring_block_size;
+    req.tp_block_nr = _ring_nblocks;
+    req.tp_frame_size = TPACKET_ALIGN(TPACKET3_HDRLEN + _headroom + _snaplen);
+    if (req.tp_frame_size > _ring_block_size / 2)
+	return errh->error("RING_BLOCK_SIZE too small for SNAPLEN and HEADROOM");
+    req.tp_frame_nr = (_ring_block_size / req.tp_frame_size) * _ring_nblocks;
+    req.tp_retire_blk_tov = 1;	// msec before a partially full block is passed up
+    req.tp_sizeof_priv = sizeof(Ring::Block);
+    if (_hash_anno >= 0)
+	req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+    if (setsockopt(q.fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+	return errh->error("%s: PACKET_RX_RING: %s", _ifname.c_str(), strerror(errno));
+
+    size_t map_size = (size_t) _ring_block_size * _ring_nblocks;
+    void *map = mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, q.fd, 0);
+    if (map == MAP_FAILED)
+	return errh->error("%s: mmap: %s", _ifname.c_str(), strerror(errno));
+
+    Ring *r = q.ring = new Ring;
+    r->map = reinterpret_cast<unsigned char *>(map);
+    r->map_size = map_size;
+    r->block_size = _ring_block_size;
+    r->nblocks = _ring_nblocks;
+    r->cur = r->npending = 0;
+    r->frame = 0;
+    r->block = 0;
+    r->live = 1;
+    return 0;
+}
+
+void
+FromDevice::close_ring(Queue &q)
+{
+    // Packets may still refer to the ring; the last one frees it.
+    Ring *r = q.ring;
+    q.ring = 0;
+    if (r->block && r->block->refs.dec_and_test())
+	Ring::release(r->block);
+    if (r->live.dec_and_test()) {
+	munmap(r->map, r->map_size);
+	delete r;
+    }
+}
+
+int
+FromDevice::ring_dispatch(int qi, int max)
+{
+    Queue &q = _queues[qi];
+    Ring *r = q.ring;
+    PacketBatch batch;
+    int n = 0;
+
+    while (n < max) {
+	if (!r->block) {
+	    tpacket_block_desc *bd = r->desc(r->cur);
+	    if (!(bd->hdr.bh1.block_status & TP_STATUS_USER))
+		break;
+	    Ring::fence();
+	    unsigned char *base = reinterpret_cast<unsigned char *>(bd);
+	    r->block = reinterpret_cast<Ring::Block *>(base + bd->offset_to_priv);
+	    r->block->ring = r;
+	    r->block->desc = bd;
+	    r->block->refs = 1;
+	    ++r->live;
+	    r->frame = base + bd->hdr.bh1.offset_to_first_pkt;
+	    r->npending = bd->hdr.bh1.num_pkts;
+	}
+
+	if (r->npending) {
+	    unsigned char *frame = r->frame;
+	    const tpacket3_hdr *h = reinterpret_cast<const tpacket3_hdr *>(frame);
+	    const sockaddr_ll *sll = reinterpret_cast<const sockaddr_ll *>(frame + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+	    r->frame += h->tp_next_offset;
+	    --r->npending;
+
+	    uint32_t mac = h->tp_mac, caplen = h->tp_snaplen, len = h->tp_len;
+	    Timestamp ts = Timestamp::make_nsec(h->tp_sec, h->tp_nsec);
+	    int pkttype = sll->sll_pkttype;
+	    WritablePacket *p;
+	    if ((pkttype != PACKET_OUTGOING || _outbound)
+		&& (p = Packet::make(frame + TPACKET_ALIGNMENT,
+				     mac - TPACKET_ALIGNMENT + caplen,
+				     ring_destructor))) {
+		*reinterpret_cast<Ring::Block **>(frame) = r->block;
+		++r->block->refs;
+		p->pull(mac - TPACKET_ALIGNMENT);
+		if (len > caplen)
+		    SET_EXTRA_LENGTH_ANNO(p, len - caplen);
+		p->set_packet_type_anno((Packet::PacketType) pkttype);
+		p->set_timestamp_anno(ts);
+		p->set_mac_header(p->data());
+		if (_hash_anno >= 0)
+		    p->set_anno_u32(_hash_anno, h->hv1.tp_rxhash);
+		++n;
+		if (!_force_ip || fake_pcap_force_ip(p, _datalink))
+		    batch.push_back(p);
+		else
+		    checked_output_push(_nqueues, p);
+	    }
+	}
+
+	if (!r->npending) {
+	    if (r->block->refs.dec_and_test())
+		Ring::release(r->block);
+	    r->block = 0;
+	    r->cur = (r->cur + 1 == r->nblocks ? 0 : r->cur + 1);
+	}
+    }
+
+    q.count += n;
+    output(qi).push_batch(batch);
+    return n;
+}
+#endif /* FROMDEVICE_LINUX_RING */
+
 #if FROMDEVICE_PCAP
 const char *
 FromDevice::pcap_error(pcap_t *pcap, const char *ebuf)
@@ -264,12 +500,84 @@ FromDevice::open_pcap(String ifname, int snaplen, bool promisc,
 }
 #endif
 
+#if FROMDEVICE_LINUX
+/* Open one packet socket per queue.  With several queues, the sockets join
+   a fanout group that splits packets by receive queue, and queue i's socket
+   is polled on the i-th thread after FromDevice's home thread. */
+int
+FromDevice::open_queues(ErrorHandler *errh)
+{
+    int home = router()->home_thread_id(this);
+    int nthreads = master()->nthreads();
+# if FROMDEVICE_LINUX_FANOUT
+    int fanout = (PACKET_FANOUT_QM | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+# endif
+
+    for (int qi = 0; qi < _nqueues; ++qi) {
+	Queue nq;
+	nq.fd = open_packet_socket(_ifname, errh);
+	nq.ring = 0;
+	nq.task = 0;
+	nq.count = 0;
+	if (nq.fd < 0)
+	    return -1;
+	_queues.push_back(nq);
+	Queue &q = _queues.back();
+
+# if FROMDEVICE_LINUX_RING
+	if (_capture == CAPTURE_RING && open_ring(q, errh) < 0)
+	    return -1;
+# endif
+# if FROMDEVICE_LINUX_FANOUT
+	if (_nqueues > 1) {
+	    if (setsockopt(q.fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0)
+		return errh->error("%s: PACKET_FANOUT: %s", _ifname.c_str(), strerror(errno));
+	    if (qi == 0) {
+		// The first socket picked a group ID; the rest join that group.
+		socklen_t len = sizeof(fanout);
+		if (getsockopt(q.fd, SOL_PACKET, PACKET_FANOUT, &fanout, &len) < 0)
+		    return errh->error("%s: PACKET_FANOUT: %s", _ifname.c_str(), strerror(errno));
+		fanout = (fanout & 0xFFFF) | (PACKET_FANOUT_QM << 16);
+	    }
+	}
+# endif
+
+	int tid = (home < 0 ? home : (home + qi) % nthreads);
+	master()->thread(tid)->select_set().add_select(q.fd, this, SELECT_READ);
+	if (_capture == CAPTURE_RING) {
+	    q.task = new Task(this);
+	    ScheduleInfo::initialize_task(this, q.task, false, errh);
+	    q.task->set_stealable(false);
+	    q.task->move_thread(tid);
+	}
+    }
+
+    _fd = _queues[0].fd;
+    return 0;
+}
+#endif
+
 int
 FromDevice::initialize(ErrorHandler *errh)
 {
     if (!_ifname)
 	return errh->error("interface not set");
 
+    // Leave room for downstream encapsulations, keeping 4/2 alignment or
+    // whatever alignment downstream elements want.
+    unsigned need = router()->headroom_required(this);
+    if (!_headroom_set) {
+	if (need > _headroom) {
+	    _headroom += (need - _headroom + 3) & ~3;
+	    if (_headroom > 8190)
+		_headroom -= (_headroom - 8190 + 3) & ~3;
+	}
+	_headroom = router()->aligned_headroom(this, _headroom);
+    }
+    // The socket method asks the kernel for each packet's timestamp with a
+    // system call; skip it unless something downstream reads timestamps.
+    _timestamp = router()->timestamp_required(this);
+
 #if FROMDEVICE_PCAP
     if (_capture == CAPTURE_PCAP) {
 	assert(!_pcap);
@@ -333,13 +641,13 @@ FromDevice::initialize(ErrorHandler *errh)
 	    errh->warning("%s: strange data link type %d, FORCE_IP will not work", ifname, _datalink);
 
 	ScheduleInfo::initialize_task(this, &_pcap_task, false, errh);
+	_pcap_task.set_stealable(false);
     }
 #endif
 
 #if FROMDEVICE_LINUX
-    if (_capture == CAPTURE_LINUX) {
-	_fd = open_packet_socket(_ifname, errh);
-	if (_fd < 0)
+    if (_capture == CAPTURE_LINUX || _capture == CAPTURE_RING) {
+	if (open_queues(errh) < 0)
 	    return -1;
 
 	int promisc_ok = set_promiscuous(_fd, _ifname, _promisc);
@@ -350,8 +658,6 @@ FromDevice::initialize(ErrorHandler *errh)
 	} else
 	    _was_promisc = promisc_ok;
 
-	add_select(_fd, SELECT_READ);
-
 	_datalink = FAKE_DLT_EN10MB;
     }
 #endif
@@ -369,11 +675,18 @@ FromDevice::cleanup(CleanupStage stage)
     if (stage >= CLEANUP_INITIALIZED && !_sniffer)
 	KernelFilter::device_filter(_ifname, false, ErrorHandler::default_handler());
 #if FROMDEVICE_LINUX
-    if (_fd >= 0 && _capture == CAPTURE_LINUX) {
-	if (_was_promisc >= 0)
-	    set_promiscuous(_fd, _ifname, _was_promisc);
-	close(_fd);
+    if (_fd >= 0 && (_capture == CAPTURE_LINUX || _capture == CAPTURE_RING)
+	&& _was_promisc >= 0)
+	set_promiscuous(_fd, _ifname, _was_promisc);
+    for (Queue *q = _queues.begin(); q != _queues.end(); ++q) {
+	delete q->task;
+	close(q->fd);
+# if FROMDEVICE_LINUX_RING
+	if (q->ring)
+	    close_ring(*q);
+# endif
     }
+    _queues.clear();
 #endif
 #if FROMDEVICE_PCAP
     if (_pcap)
@@ -421,27 +734,17 @@ FromDevice_get_packet(u_char* clientdata,
 CLICK_DECLS
 #endif
 
-void
-FromDevice::selected(int, int)
-{
-#if FROMDEVICE_PCAP
-    if (_capture == CAPTURE_PCAP) {
-	// Read and push() at most one packet.
-	int r = pcap_dispatch(_pcap, _burst, FromDevice_get_packet, (u_char *) this);
-	if (r > 0) {
-	    _count += r;
-	    _pcap_task.reschedule();
-	} else if (r < 0 && ++_pcap_complaints < 5)
-	    ErrorHandler::default_handler()->error("%{element}: %s", this, pcap_geterr(_pcap));
-    }
-#endif
 #if FROMDEVICE_LINUX
-    int nlinux = 0;
-    while (_capture == CAPTURE_LINUX && nlinux < _burst) {
+int
+FromDevice::linux_dispatch(int qi, int max)
+{
+    Queue &q = _queues[qi];
+    int n = 0;
+    while (n < max) {
 	struct sockaddr_ll sa;
 	socklen_t fromlen = sizeof(sa);
 	WritablePacket *p = Packet::make(_headroom, 0, _snaplen, 0);
-	int len = recvfrom(_fd, p->data(), p->length(), MSG_TRUNC, (sockaddr *)&sa, &fromlen);
+	int len = recvfrom(q.fd, p->data(), p->length(), MSG_TRUNC, (sockaddr *)&sa, &fromlen);
 	if (len > 0 && (sa.sll_pkttype != PACKET_OUTGOING || _outbound)) {
 	    if (len > _snaplen) {
 		assert(p->length() == (uint32_t)_snaplen);
@@ -449,14 +752,15 @@ FromDevice::selected(int, int)
 	    } else
 		p->take(_snaplen - len);
 	    p->set_packet_type_anno((Packet::PacketType)sa.sll_pkttype);
-	    p->timestamp_anno().set_timeval_ioctl(_fd, SIOCGSTAMP);
+	    if (_timestamp)
+		p->timestamp_anno().set_timeval_ioctl(q.fd, SIOCGSTAMP);
 	    p->set_mac_header(p->data());
-	    ++nlinux;
-	    ++_count;
+	    ++n;
+	    ++q.count;
 	    if (!_force_ip || fake_pcap_force_ip(p, _datalink))
-		output(0).push(p);
+		output(qi).push(p);
 	    else
-		checked_output_push(1, p);
+		checked_output_push(_nqueues, p);
 	} else {
 	    p->kill();
 	    if (len <= 0 && errno != EAGAIN)
@@ -464,13 +768,60 @@ FromDevice::selected(int, int)
 	    break;
 	}
     }
-#endif
+    return n;
 }
+#endif
 
+void
+FromDevice::selected(int fd, int)
+{
 #if FROMDEVICE_PCAP
+    if (_capture == CAPTURE_PCAP) {
+	// Read and push() at most one packet.
+	int r = pcap_dispatch(_pcap, _burst, FromDevice_get_packet, (u_char *) this);
+	if (r > 0) {
+	    _count += r;
+	    _pcap_task.reschedule();
+	} else if (r < 0 && ++_pcap_complaints < 5)
+	    ErrorHandler::default_handler()->error("%{element}: %s", this, pcap_geterr(_pcap));
+    }
+#endif
+#if FROMDEVICE_LINUX
+    if (_capture == CAPTURE_LINUX || _capture == CAPTURE_RING) {
+	int qi = 0;
+	while (_queues[qi].fd != fd)
+	    ++qi;
+	if (_capture == CAPTURE_LINUX)
+	    linux_dispatch(qi, _burst);
+# if FROMDEVICE_LINUX_RING
+	else if (ring_dispatch(qi, _burst) == _burst)
+	    _queues[qi].task->reschedule();
+# endif
+    }
+#else
+    (void) fd;
+#endif
+}
+
+#if FROMDEVICE_PCAP || FROMDEVICE_LINUX
 bool
-FromDevice::run_task(Task *)
+FromDevice::run_task(Task *task)
 {
+# if FROMDEVICE_LINUX_RING
+    if (_capture == CAPTURE_RING) {
+	int qi = 0;
+	while (_queues[qi].task != task)
+	    ++qi;
+	// Keep reading while the ring has a full burst ready.
+	int n = ring_dispatch(qi, _burst);
+	if (n == _burst)
+	    task->fast_reschedule();
+	return n > 0;
+    }
+# else
+    (void) task;
+# endif
+# if FROMDEVICE_PCAP
     // Read and push() at most one packet.
     int r = pcap_dispatch(_pcap, _burst, FromDevice_get_packet, (u_char *) this);
     if (r > 0) {
@@ -479,6 +830,9 @@ FromDevice::run_task(Task *)
     } else if (r < 0 && ++_pcap_complaints < 5)
 	ErrorHandler::default_handler()->error("%{element}: %s", this, pcap_geterr(_pcap));
     return r > 0;
+# else
+    return false;
+# endif
 }
 #endif
 
@@ -515,8 +869,23 @@ FromDevice::read_handler(Element* e, void *thunk)
 	    return "??";
     } else if (thunk == (void *) 1)
 	return String(fake_pcap_unparse_dlt(fd->_datalink));
-    else
-	return String(fd->_count);
+    else if (thunk == (void *) 2) {
+	counter_t count = fd->_count;
+#if FROMDEVICE_LINUX
+	for (const Queue *q = fd->_queues.begin(); q != fd->_queues.end(); ++q)
+	    count += q->count;
+#endif
+	return String(count);
+    } else {
+	StringAccum sa;
+#if FROMDEVICE_LINUX
+	for (const Queue *q = fd->_queues.begin(); q != fd->_queues.end(); ++q)
+	    sa << (sa ? " " : "") << q->count;
+#endif
+	if (!sa)
+	    sa << fd->_count;
+	return sa.take_string();
+    }
 }
 
 int
@@ -524,6 +893,10 @@ FromDevice::write_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     FromDevice* fd = static_cast<FromDevice*>(e);
     fd->_count = 0;
+#if FROMDEVICE_LINUX
+    for (Queue *q = fd->_queues.begin(); q != fd->_queues.end(); ++q)
+	q->count = 0;
+#endif
     return 0;
 }
 
@@ -533,6 +906,7 @@ FromDevice::add_handlers()
     add_read_handler("kernel_drops", read_handler, 0);
     add_read_handler("encap", read_handler, 1);
     add_read_handler("count", read_handler, 2);
+    add_read_handler("queue_counts", read_handler, 3);
     add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
 }
 
@@ -4,6 +4,7 @@
 #include "elements/userlevel/kernelfilter.hh"
 #ifdef __linux__
 # define FROMDEVICE_LINUX 1
+# include <click/task.hh>
 #endif
 #if HAVE_PCAP
 # define FROMDEVICE_PCAP 1
@@ -24,7 +25,7 @@ CLICK_DECLS
 
 =c
 
-FromDevice(DEVNAME [, I<keywords> SNIFFER, PROMISC, FORCE_IP, etc.])
+FromDevice(DEVNAME [, I<keywords> SNIFFER, PROMISC, FORCE_IP, QUEUES, etc.])
 
 =s netdevices
 
@@ -51,7 +52,26 @@ ToDevice element for the same device. Under other operating systems, your
 mileage may vary.
 
 Sets the packet type annotation appropriately. Also sets the timestamp
-annotation to the time the kernel reports that the packet was received.
+annotation to the time the kernel reports that the packet was received.  With
+METHOD LINUX, fetching that time costs a system call per packet, so FromDevice
+does it only if some element downstream reads timestamp annotations (see
+Router::timestamp_required).
+
+Packets are emitted on output 0.  If FORCE_IP is true, non-IP packets are
+emitted on output 1, if it exists, and dropped otherwise.
+
+With QUEUES I<N> and METHOD LINUX or RING, FromDevice reads the device's
+receive queues separately.  It opens I<N> packet sockets in one
+C<PACKET_FANOUT_QM> fanout group, so that the kernel hands each socket the
+packets that arrived on one receive queue: socket I<i> reads receive queue
+I<i> modulo I<N>.  Each socket is read on its own thread.  Queue I<i> runs on
+thread I<T>+I<i> modulo the number of threads, where I<T> is FromDevice's home
+thread (set, for example, with StaticThreadSched), and emits its packets on
+output I<i>; non-IP packets from every queue are emitted on output I<N>, if it
+exists.  Give I<N> as the device's number of receive queues (see C<ethtool
+-l>) so that the device's receive-side scaling spreads flows over the
+threads, and pair FromDevice with a ToDevice using the same QUEUES and home
+thread to keep each flow on one thread end to end.
 
 Keyword arguments are:
 
@@ -82,8 +102,37 @@ but the IP header annotation has been set appropriately.) Default is false.
 =item METHOD
 
 Word.  Defines the capture method FromDevice will use to read packets from the
-device.  Linux targets generally support PCAP and LINUX; other targets support
-only PCAP.  Defaults to PCAP.
+device.  Linux targets generally support PCAP, LINUX, and RING; other targets
+support only PCAP.  Defaults to PCAP.
+
+The RING method maps a TPACKET_V3 receive ring shared with the kernel and
+emits packets whose data points directly into the ring, avoiding a copy and a
+system call per packet.  A ring block is returned to the kernel once every
+packet read from it has been killed, so elements that hold packets for a long
+time (a large Queue, for example) can exhaust the ring and cause kernel drops.
+Packets that are modified in place are changed in the ring; headers can be
+prepended within HEADROOM without a copy.
+
+=item QUEUES
+
+Unsigned.  Number of receive queues to read separately, as described above.
+Requires METHOD LINUX or RING.  Default is 1.
+
+=item RING_BLOCK_SIZE
+
+Unsigned.  Size of each ring block in bytes when METHOD is RING.  Must be a
+power of two and a multiple of the page size.  Defaults to 262144.
+
+=item RING_BLOCKS
+
+Unsigned.  Number of ring blocks when METHOD is RING.  Defaults to 64.
+
+=item HASH_ANNO
+
+Annotation name.  If given and METHOD is RING, FromDevice stores each
+packet's flow hash, as computed by the network card or the kernel, in this
+4-byte annotation.  FlowSteer can use the stored hash rather than computing
+its own.
 
 =item BPF_FILTER
 
@@ -105,11 +154,16 @@ false.
 =item HEADROOM
 
 Integer. Amount of bytes of headroom to leave before the packet data. Defaults
-to roughly 28.
+to roughly 28, or more if downstream elements push headers onto each packet
+(see Router::headroom_required), so that EtherEncap and its relatives need
+not copy.  The default also places packet data at the alignment downstream
+elements want (see Router::alignment_required), so that Align need not copy.
 
 =item BURST
 
 Integer. Maximum number of packets to read per scheduling. Defaults to 1.
+When METHOD is RING, up to BURST packets are emitted together using
+push_batch().
 
 =back
 
@@ -117,6 +171,17 @@ Integer. Maximum number of packets to read per scheduling. Defaults to 1.
 
   FromDevice(eth0) -> ...
 
+This configuration reads eth0's four receive queues on four threads (run it
+with C<click -j 4>) and sends each queue's packets back out on the same
+thread:
+
+  fd :: FromDevice(eth0, METHOD RING, QUEUES 4, SNIFFER false);
+  td :: ToDevice(eth0, METHOD LINUX, QUEUES 4);
+  fd[0] -> EtherMirror -> Queue -> [0]td;
+  fd[1] -> EtherMirror -> Queue -> [1]td;
+  fd[2] -> EtherMirror -> Queue -> [2]td;
+  fd[3] -> EtherMirror -> Queue -> [3]td;
+
 =n
 
 FromDevice sets packets' extra length annotations as appropriate.
@@ -125,6 +190,10 @@ FromDevice sets packets' extra length annotations as appropriate.
 
 Returns the number of packets read by the device.
 
+=h queue_counts read-only
+
+Returns the number of packets read from each queue, separated by spaces.
+
 =h reset_counts write-only
 
 Resets "count" to zero.
@@ -149,7 +218,7 @@ class FromDevice : public Element { public:
     ~FromDevice();
 
     const char *class_name() const	{ return "FromDevice"; }
-    const char *port_count() const	{ return "0/1-2"; }
+    const char *port_count() const	{ return "0/1-"; }
     const char *processing() const	{ return PUSH; }
 
     enum { default_snaplen = 2046 };
@@ -161,17 +230,25 @@ class FromDevice : public Element { public:
 
     inline String ifname() const	{ return _ifname; }
     inline int fd() const		{ return _fd; }
+    int nqueues() const			{ return _nqueues; }
 
     void selected(int fd, int mask);
+#if FROMDEVICE_PCAP || FROMDEVICE_LINUX
+    bool run_task(Task *);
+#endif
 #if FROMDEVICE_PCAP
     pcap_t *pcap() const		{ return _pcap; }
-    bool run_task(Task *);
     static const char *pcap_error(pcap_t *pcap, const char *ebuf);
     static pcap_t *open_pcap(String ifname, int snaplen, bool promisc, ErrorHandler *errh);
 #endif
 
 #if FROMDEVICE_LINUX
-    int linux_fd() const		{ return _capture == CAPTURE_LINUX ? _fd : -1; }
+    int linux_fd(int queue = 0) const {
+	if ((_capture == CAPTURE_LINUX || _capture == CAPTURE_RING)
+	    && queue >= 0 && queue < _queues.size())
+	    return _queues[queue].fd;
+	return -1;
+    }
     static int open_packet_socket(String, ErrorHandler *);
     static int set_promiscuous(int, String, bool);
 #endif
@@ -180,11 +257,33 @@ class FromDevice : public Element { public:
 
   private:
 
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+
 #if FROMDEVICE_LINUX || FROMDEVICE_PCAP
     int _fd;
 #endif
 #if FROMDEVICE_LINUX
     unsigned char *_linux_packetbuf;
+    struct Ring;
+    struct Queue {		// one packet socket
+	int fd;
+	Ring *ring;
+	Task *task;		// RING only
+	counter_t count;
+    };
+    Vector<Queue> _queues;
+    uint32_t _ring_block_size;
+    uint32_t _ring_nblocks;
+    int open_queues(ErrorHandler *errh);
+    int open_ring(Queue &q, ErrorHandler *errh);
+    static void close_ring(Queue &q);
+    int linux_dispatch(int qi, int max);
+    int ring_dispatch(int qi, int max);
+    static void ring_destructor(unsigned char *head, size_t length);
 #endif
 #if FROMDEVICE_PCAP
     pcap_t *_pcap;
@@ -198,23 +297,22 @@ class FromDevice : public Element { public:
 #endif
     bool _force_ip;
     int _burst;
+    int _nqueues;
+    int _hash_anno;
     int _datalink;
 
-#if HAVE_INT64_TYPES
-    typedef uint64_t counter_t;
-#else
-    typedef uint32_t counter_t;
-#endif
     counter_t _count;
 
     String _ifname;
     bool _sniffer : 1;
     bool _promisc : 1;
     bool _outbound : 1;
+    bool _headroom_set : 1;
+    bool _timestamp : 1;
     int _was_promisc : 2;
     int _snaplen;
     unsigned _headroom;
-    enum { CAPTURE_PCAP, CAPTURE_LINUX };
+    enum { CAPTURE_PCAP, CAPTURE_LINUX, CAPTURE_RING };
     int _capture;
 #if FROMDEVICE_PCAP
     String _bpf_filter;
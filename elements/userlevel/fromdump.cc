@@ -28,10 +28,16 @@
 #include <click/handlercall.hh>
 #include <click/packet_anno.hh>
 #include <click/userutils.hh>
+#include <click/packetbatch.hh>
+#include <click/sync.hh>
+#include <clicknet/ip.h>
+#include <clicknet/ip6.h>
+#include <clicknet/tcp.h>
 #if CLICK_NS
 # include <click/master.hh>
 #endif
 #include "fakepcap.hh"
+#include "elements/ip/ipfilter.hh"
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -46,8 +52,34 @@ CLICK_DECLS
 #define	SWAPSHORT(y) \
 	( (((y)&0xff)<<8) | ((u_short)((y)&0xff00)>>8) )
 
+/* A preloaded dump, shared by the FromDumps in a router that read the same
+   file.  The packets are private copies; replaying FromDumps emit clones of
+   them. */
+struct FromDump::Trace {
+    Vector<Packet *> packets;
+    Vector<uint32_t> hashes;
+    int linktype;
+    Timestamp first;		// timestamp of the first packet
+    Timestamp period;		// time between the starts of two passes
+    int refs;
+    String name;
+    Spinlock lock;
+    bool started;
+    Timestamp start;		// steady time the first packet was due
+
+    Trace()
+	: refs(1), started(false) {
+    }
+    ~Trace() {
+	for (int i = 0; i < packets.size(); ++i)
+	    packets[i]->kill();
+    }
+};
+
 FromDump::FromDump()
-    : _packet(0), _end_h(0), _count(0), _timer(this), _task(this)
+    : _packet(0), _end_h(0), _count(0), _timer(this), _task(this),
+      _trace(0), _replay_pos(0), _loop(1), _passes(0), _burst(32),
+      _shard(0), _nshards(1), _index_next_pos(0)
 {
 }
 
@@ -79,8 +111,10 @@ int
 FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     bool timing = false, stop = false, active = true, force_ip = false;
+    bool preload = false;
     Timestamp first_time, first_time_off, last_time, last_time_off, interval;
     HandlerCall end_h;
+    String filter;
     _sampling_prob = (1 << SAMPLING_SHIFT);
 #if CLICK_NS
     bool per_node = false;
@@ -96,6 +130,7 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ACTIVE", active)
 	.read("SAMPLE", FixedPointArg(SAMPLING_SHIFT), _sampling_prob)
 	.read("FORCE_IP", force_ip)
+	.read("FILTER", AnyArg(), filter)
 	.read("START", first_time)
 	.read("START_AFTER", first_time_off)
 	.read("END", last_time)
@@ -106,9 +141,25 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("PER_NODE", per_node)
 #endif
 	.read("FILEPOS", _packet_filepos)
+	.read("INDEX", FilenameArg(), _index_filename)
+	.read("PRELOAD", preload)
+	.read("LOOP", _loop)
+	.read("BURST", _burst)
+	.read("SHARD", _shard)
+	.read("NSHARDS", _nshards)
 	.complete() < 0)
 	return -1;
 
+    // check replay settings
+    if (_burst == 0)
+	return errh->error("BURST must be positive");
+    if (_nshards == 0)
+	return errh->error("NSHARDS must be positive");
+    if (_shard >= _nshards)
+	return errh->error("SHARD must be less than NSHARDS");
+    _preload = preload || _loop != 1 || _nshards > 1;
+    _preloading = _have_replay_start = false;
+
     // check sampling rate
     if (_sampling_prob > (1 << SAMPLING_SHIFT)) {
 	errh->warning("SAMPLE probability reduced to 1");
@@ -116,6 +167,17 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
     } else if (_sampling_prob == 0)
 	errh->warning("SAMPLE probability is 0; emitting no packets");
 
+    // compile filter
+    _have_filter = (bool) filter;
+    if (_have_filter) {
+	Vector<String> fconf;
+	fconf.push_back("allow " + filter);
+	int before = errh->nerrors();
+	IPFilter::parse_program(_filter, fconf, 1, this, errh);
+	if (errh->nerrors() != before)
+	    return -1;
+    }
+
     // check times
     _have_first_time = _have_last_time = true;
     _first_time_relative = _last_time_relative = _last_time_interval = false;
@@ -216,6 +278,10 @@ FromDump::initialize(ErrorHandler *errh)
     if (hotswap_element())
 	return 0;
 
+    // another FromDump may have loaded this file already
+    if (_preload && router()->attachment("FromDump_" + _ff.filename()))
+	return share_trace(errh);
+
     // open file
     if (_ff.initialize(errh) < 0)
 	return -1;
@@ -252,15 +318,139 @@ FromDump::initialize(ErrorHandler *errh)
 	// force FORCE_IP.
 	_force_ip = true;
 
+    // use the index to skip to the start time, or build one
+    if (_index_filename && _packet_filepos == 0) {
+	if (_index.load(_index_filename, _ff.filename(), errh) == 0) {
+	    if (_have_first_time) {
+		Timestamp first = _index.first_timestamp();
+		off_t pos = _index.seek(_first_time_relative ? _first_time + first : _first_time);
+		// later relative times count from the dump's first packet
+		prepare_times(first);
+		if (pos > _ff.file_pos())
+		    _packet_filepos = pos;
+	    }
+	} else {
+	    _index.start();
+	    _index_next_pos = _ff.file_pos();
+	}
+    }
+
     // maybe skip ahead in the file
     if (_packet_filepos != 0) {
 	int result = _ff.seek(_packet_filepos, errh);
 	_packet_filepos = 0;
-	return result;
-    } else
+	if (result < 0)
+	    return result;
+    }
+
+    if (_preload)
+	return load_trace(errh);
+    else
 	return 0;
 }
 
+static uint32_t
+replay_flow_hash(const Packet *p)
+{
+    // Combine the endpoints with XOR, so both directions of a flow match.
+    uint32_t h = 0;
+    const click_ip *iph = p->ip_header();
+    if (iph->ip_v == 4) {
+	h = iph->ip_src.s_addr ^ iph->ip_dst.s_addr;
+	if (!IP_ISFRAG(iph)
+	    && (iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP
+		|| iph->ip_p == IP_PROTO_DCCP || iph->ip_p == IP_PROTO_SCTP)
+	    && p->transport_length() >= 4) {
+	    const uint16_t *ports = reinterpret_cast<const uint16_t *>(p->transport_header());
+	    h ^= ports[0] ^ ports[1];
+	}
+    } else if (iph->ip_v == 6) {
+	const click_ip6 *ip6h = p->ip6_header();
+	for (int i = 0; i < 4; ++i)
+	    h ^= ip6h->ip6_src.s6_addr32[i] ^ ip6h->ip6_dst.s6_addr32[i];
+    }
+    // finish with MurmurHash3's mixer
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+int
+FromDump::load_trace(ErrorHandler *errh)
+{
+    Trace *t = new Trace;
+    t->linktype = _linktype;
+    t->name = "FromDump_" + _ff.filename();
+
+    _preloading = true;
+    while (read_packet(errh))
+	if (Packet *p = _packet) {
+	    _packet = 0;
+	    // make a private copy so that replaying clones nothing else
+	    WritablePacket *q = p->uniqueify();
+	    if (!q) {
+		delete t;
+		return errh->error("out of memory");
+	    }
+	    uint32_t hash = 0;
+	    if (Packet *c = q->clone()) {
+		if (fake_pcap_force_ip(c, _linktype))
+		    hash = replay_flow_hash(c);
+		c->kill();
+	    }
+	    if (!t->packets.size())
+		t->first = q->timestamp_anno();
+	    t->packets.push_back(q);
+	    t->hashes.push_back(hash);
+	}
+    _preloading = false;
+    _ff.cleanup();
+
+    int n = t->packets.size();
+    if (n > 1) {
+	Timestamp d = t->packets[n - 1]->timestamp_anno() - t->first;
+	t->period = d + d / (n - 1);
+    }
+
+    router()->set_attachment(t->name, t);
+    _trace = t;
+    return share_trace(errh);
+}
+
+int
+FromDump::share_trace(ErrorHandler *)
+{
+    if (!_trace) {
+	_trace = static_cast<Trace *>(router()->attachment("FromDump_" + _ff.filename()));
+	_trace->refs++;
+    }
+    _linktype = _trace->linktype;
+    if (_linktype == FAKE_DLT_RAW)
+	_force_ip = true;
+
+    Trace *t = _trace;
+    for (int i = 0; i < t->packets.size(); ++i)
+	if ((((uint64_t) t->hashes[i] * _nshards) >> 32) == _shard)
+	    _replay.push_back(t->packets[i]);
+    _replay_pos = 0;
+    _passes = 0;
+    return 0;
+}
+
+void
+FromDump::release_trace()
+{
+    if (_trace && --_trace->refs == 0) {
+	router()->set_attachment(_trace->name, 0);
+	delete _trace;
+    }
+    _trace = 0;
+    _replay.clear();
+}
+
 void
 FromDump::take_state(Element *e, ErrorHandler *errh)
 {
@@ -283,11 +473,22 @@ FromDump::take_state(Element *e, ErrorHandler *errh)
 
     _timing_offset = o->_timing_offset;
     _packet_filepos = o->_packet_filepos;
+
+    if (o->_trace && _preload) {
+	_trace = o->_trace;
+	o->_trace = 0;
+	_replay.swap(o->_replay);
+	_replay_pos = o->_replay_pos;
+	_passes = o->_passes;
+	_have_replay_start = o->_have_replay_start;
+	_replay_start = o->_replay_start;
+    }
 }
 
 void
 FromDump::cleanup(CleanupStage)
 {
+    release_trace();
     _ff.cleanup();
     if (_packet)
 	_packet->kill();
@@ -334,8 +535,11 @@ FromDump::read_packet(ErrorHandler *errh)
     _packet_filepos = _ff.file_pos();
 
     // read the packet header
-    if (!(ph = reinterpret_cast<const fake_pcap_pkthdr *>(_ff.get_aligned(sizeof(*ph), &swapped_ph))))
+    if (!(ph = reinterpret_cast<const fake_pcap_pkthdr *>(_ff.get_aligned(sizeof(*ph), &swapped_ph)))) {
+	if (_index.building())
+	    (void) _index.save(_index_filename, _ff.filename(), errh ? errh : ErrorHandler::default_handler());
 	return false;
+    }
     if (_swapped) {
 	swap_packet_header(ph, &swapped_ph);
 	ph = &swapped_ph;
@@ -357,6 +561,7 @@ FromDump::read_packet(ErrorHandler *errh)
     // tcpdump itself.
     if (caplen > 65535) {
 	_ff.error(errh, "bad packet header; giving up");
+	_index.stop();
 	return false;
     } else if (caplen > len) {
 	skiplen = caplen - len;
@@ -366,9 +571,19 @@ FromDump::read_packet(ErrorHandler *errh)
     // compensate for modified pcap versions
     _ff.shift_pos(_extra_pkthdr_crap);
 
+    // record the packet in the index, unless someone moved the file
+    // position since the last packet
+    ts = fake_bpf_timeval_union::make_timestamp(&ph->ts);
+    if (_index.building()) {
+	if (_packet_filepos == _index_next_pos) {
+	    _index.note(_packet_filepos, ts);
+	    _index_next_pos = _ff.file_pos() + caplen + skiplen;
+	} else
+	    _index.stop();
+    }
+
     // check times
   check_times:
-    ts = fake_bpf_timeval_union::make_timestamp(&ph->ts);
     if (!_have_any_times)
 	prepare_times(ts);
     if (_have_first_time) {
@@ -378,6 +593,11 @@ FromDump::read_packet(ErrorHandler *errh)
 	} else
 	    _have_first_time = false;
     }
+    if (_have_last_time && ts >= _last_time && _preloading) {
+	// the replay calls END_CALL once it has emitted every packet
+	_ff.shift_pos(caplen + skiplen);
+	return false;
+    }
     if (_have_last_time && ts >= _last_time) {
 	_have_last_time = false;
 	(void) _end_h->call_write(errh);
@@ -396,18 +616,55 @@ FromDump::read_packet(ErrorHandler *errh)
 	return true;
     }
 
+    // check the filter against the file data, if the record is all there
+    bool filter_checked = false;
+    if (_have_filter)
+	if (const uint8_t *data = _ff.peek(caplen)) {
+	    if (!filter_match(data, caplen)) {
+		_ff.shift_pos(caplen + skiplen);
+		return true;
+	    }
+	    filter_checked = true;
+	}
+
     // create packet
     p = _ff.get_packet(caplen, ts.sec(), ts.subsec(), errh);
     if (!p)
 	return false;
     SET_EXTRA_LENGTH_ANNO(p, len - caplen);
     _ff.shift_pos(skiplen);
+    if (_have_filter && !filter_checked
+	&& !filter_match(p->data(), p->length())) {
+	p->kill();
+	return true;
+    }
 
     p->set_mac_header(p->data());
     _packet = p;
     return true;
 }
 
+bool
+FromDump::filter_match(const uint8_t *data, uint32_t length) const
+{
+    const uint8_t *end_data = data + length;
+    const uint8_t *nh = reinterpret_cast<const uint8_t *>(fake_pcap_find_ip(data, end_data, _linktype));
+    if (!nh || nh >= end_data)
+	return false;
+    const click_ip *iph = reinterpret_cast<const click_ip *>(nh);
+    int hlen;
+    if (iph->ip_v == 4 && iph->ip_hl >= 5)
+	hlen = iph->ip_hl << 2;
+    else if (iph->ip_v == 6)
+	hlen = sizeof(click_ip6);
+    else
+	return false;
+    if (nh + hlen > end_data)
+	return false;
+    return IPFilter::match(_filter, data, nh, nh + hlen,
+			   IPFilter::program_length(end_data - nh, hlen)) == 0;
+}
+
 bool
 FromDump::check_timing(Packet *p)
 {
@@ -439,11 +696,113 @@ FromDump::run_timer(Timer *)
     }
 }
 
+bool
+FromDump::replay_due(Packet *p)
+{
+    if (!_have_replay_start) {
+	// all the shards of a trace follow the clock of the first to start
+	Timestamp now_s = Timestamp::now_steady();
+	_trace->lock.acquire();
+	if (!_trace->started) {
+	    _trace->start = now_s;
+	    _trace->started = true;
+	}
+	_replay_start = _trace->start - _trace->first;
+	_trace->lock.release();
+	_have_replay_start = true;
+    }
+    Timestamp now_s = Timestamp::now_steady();
+    Timestamp t = p->timestamp_anno() + _replay_start + _trace->period * _passes;
+    if (now_s < t) {
+	t -= Timer::adjustment();
+	if (now_s < t) {
+	    _timer.schedule_at_steady(t);
+	    if (output_is_pull(0))
+		_notifier.sleep();
+	} else if (output_is_push(0))
+	    _task.fast_reschedule();
+	return false;
+    }
+    return true;
+}
+
+bool
+FromDump::replay_task()
+{
+    PacketBatch batch;
+    unsigned n = 0;
+    bool more = true;
+    while (n < _burst) {
+	if (_replay_pos == _replay.size()) {
+	    ++_passes;
+	    if (!_replay.size() || _passes == _loop) {
+		more = false;
+		break;
+	    }
+	    _replay_pos = 0;
+	}
+	Packet *r = _replay[_replay_pos];
+	if (_timing && !replay_due(r))
+	    break;
+	Packet *p = r->clone();
+	if (!p)
+	    break;
+	++_replay_pos;
+	++n;
+	if (_force_ip && !fake_pcap_force_ip(p, _linktype))
+	    checked_output_push(1, p);
+	else
+	    batch.push_back(p);
+    }
+
+    if (more && (!_timing || n == _burst))
+	_task.fast_reschedule();
+    if (!batch.empty()) {
+	_count += batch.count();
+	output(0).push_batch(batch);
+    }
+    if (!more && _end_h)
+	_end_h->call_write(ErrorHandler::default_handler());
+    return n > 0;
+}
+
+Packet *
+FromDump::replay_pull()
+{
+    while (1) {
+	if (_replay_pos == _replay.size()) {
+	    ++_passes;
+	    if (!_replay.size() || _passes == _loop) {
+		_notifier.set_active(false, true);
+		if (_end_h)
+		    _end_h->call_write(ErrorHandler::default_handler());
+		return 0;
+	    }
+	    _replay_pos = 0;
+	}
+	Packet *r = _replay[_replay_pos];
+	if (_timing && !replay_due(r))
+	    return 0;
+	Packet *p = r->clone();
+	if (!p)
+	    return 0;
+	++_replay_pos;
+	if (_force_ip && !fake_pcap_force_ip(p, _linktype))
+	    checked_output_push(1, p);
+	else {
+	    _count++;
+	    return p;
+	}
+    }
+}
+
 bool
 FromDump::run_task(Task *)
 {
     if (!_active)
 	return false;
+    if (_trace)
+	return replay_task();
 
     int retry_count = 0;
   again:
@@ -478,6 +837,8 @@ FromDump::pull(int)
 	_notifier.sleep();
 	return 0;
     }
+    if (_trace)
+	return replay_pull();
 
     bool more = true;
     if (!_packet)
@@ -556,6 +917,12 @@ FromDump::write_handler(const String &s_in, Element *e, void *thunk, ErrorHandle
 	fd->_first_time_relative = false;
 	fd->_last_time_relative = fd->_last_time_interval = false;
 	fd->_have_any_times = false;
+	if (Trace *t = fd->_trace) {
+	    t->lock.acquire();
+	    t->started = false;
+	    t->lock.release();
+	    fd->_have_replay_start = false;
+	}
 	return 0;
       default:
 	return -EINVAL;
@@ -581,5 +948,5 @@ FromDump::add_handlers()
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel|ns FakePcap)
+ELEMENT_REQUIRES(userlevel|ns FakePcap IPFilter)
 EXPORT_ELEMENT(FromDump)
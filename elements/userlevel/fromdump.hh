@@ -6,13 +6,15 @@
 #include <click/timer.hh>
 #include <click/notifier.hh>
 #include <click/fromfile.hh>
+#include <click/vector.hh>
+#include "elements/standard/classification.hh"
 CLICK_DECLS
 class HandlerCall;
 
 /*
 =c
 
-FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP])
+FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, FILTER, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP, INDEX, PRELOAD, LOOP, BURST, SHARD, NSHARDS])
 
 =s traces
 
@@ -56,6 +58,14 @@ Boolean. If true, then FromDump will emit only IP packets with their IP header
 annotations correctly set. (If FromDump has two outputs, non-IP packets are
 pushed out on output 1; otherwise, they are dropped.) Default is false.
 
+=item FILTER
+
+String. An IPFilter expression, such as "tcp port 80". FromDump will emit
+only packets that match it, and skip the rest without making Packets for
+them. Packets whose IP header cannot be found never match. Faster than an
+IPFilter element after FromDump when most packets are dropped. Default is
+no filter.
+
 =item START
 
 Absolute time in seconds since the epoch. FromDump will output packets with
@@ -108,11 +118,74 @@ This can result in slightly better performance on some machines. FromDump's
 regular file discipline is pretty optimized, so the difference is often small
 in practice. Default is true on most operating systems, but false on Linux.
 
+=item PREFETCH
+
+Unsigned. If nonzero, then FromDump reads the file on a separate thread,
+keeping up to this many 256KB chunks ahead of the data it is processing, so
+that it rarely waits for the disk. Gzip-compressed files are decompressed on
+that thread too, instead of by a zcat(1) process. Setting PREFETCH turns off
+MMAP. Requires multithreading support. Default is 0.
+
+=item INDEX
+
+Filename of a sidecar index that maps timestamps to positions in the
+dump. If the index exists and matches the dump's size and modification
+time, FromDump uses it to seek straight to the START or START_AFTER time
+rather than reading every earlier packet. Otherwise, FromDump builds the
+index as it reads, and writes it once it reaches the end of the dump. To
+build an index ahead of time, read the whole dump once, for example with
+C<click -e 'FromDump(FILE, INDEX FILE.idx, STOP true) -E<gt> Discard'>. The
+index is ignored if FILEPOS is given.
+
+=item PRELOAD
+
+Boolean. If true, then FromDump reads the whole dump into memory during
+initialization, copying each packet into its own buffer, and then replays
+it from memory: each emitted packet is a clone of the stored one, so no
+data is copied while replaying. START, END, and SAMPLE apply while loading.
+Default is false.
+
+=item LOOP
+
+Unsigned. Number of times to replay the dump; 0 means replay it forever.
+Each pass emits the same stored packets, with their original timestamps.
+With TIMING, a pass starts one average packet gap after the previous pass
+ended. Any value other than 1 implies PRELOAD. Default is 1.
+
+=item BURST
+
+Unsigned. In PRELOAD mode, the maximum number of packets FromDump emits
+each time its task runs, as one batch. With TIMING, FromDump emits every
+packet that is due, up to BURST, and so keeps up with the trace's timing
+even when packets are due faster than the task can run. Default is 32.
+
+=item NSHARDS
+
+Unsigned. Split the dump among this many FromDump elements, which share
+one preloaded copy. Each packet is assigned to a shard by a hash of its
+IP addresses and ports, so every packet of a flow, in both directions,
+goes to the same shard. Schedule each shard on its own thread with
+StaticThreadSched to replay a trace faster than one thread can. With
+TIMING, all the shards follow one clock, so together they reproduce the
+trace's timing. Any value greater than 1 implies PRELOAD. Default is 1.
+
+=item SHARD
+
+Unsigned. The shard this element emits, between 0 and NSHARDS - 1.
+Default is 0.
+
 =back
 
 You can supply at most one of START and START_AFTER, and at most one of END,
 END_AFTER, and INTERVAL.
 
+Indexed FromDumps with disjoint START and END times can read different
+parts of one large dump in parallel, each on its own thread.
+
+Preloaded FromDumps in a router that read the same FILENAME share the data
+loaded by the first of them to initialize. That element's START, END, and
+SAMPLE settings determine which packets are loaded.
+
 Only available in user-level processes.
 
 =n
@@ -130,6 +203,18 @@ contains more packets.
 If FromDump uses mmap, then a corrupt file might cause Click to crash with a
 segmentation violation.
 
+=e
+
+This configuration replays a trace ten times at its original rate, split
+between two threads:
+
+  td :: ToDevice(eth0, QUEUES 2);
+  fd0 :: FromDump(trace.pcap, TIMING true, LOOP 10, NSHARDS 2, SHARD 0)
+      -> Queue -> [0] td;
+  fd1 :: FromDump(trace.pcap, TIMING true, LOOP 10, NSHARDS 2, SHARD 1)
+      -> Queue -> [1] td;
+  StaticThreadSched(fd0 0, fd1 1, td 0);
+
 =h count read-only
 
 Returns the number of packets output so far.
@@ -184,7 +269,7 @@ the file by writing C<filepos>.
 =a
 
 ToDump, FromDevice.u, ToDevice.u, tcpdump(1), mmap(2), AggregateIPFlows,
-FromTcpdump */
+FromTcpdump, IPFilter */
 
 class FromDump : public Element { public:
 
@@ -227,6 +312,10 @@ class FromDump : public Element { public:
     bool _first_time_relative : 1;
     bool _last_time_relative : 1;
     bool _last_time_interval : 1;
+    bool _preload : 1;
+    bool _preloading : 1;
+    bool _have_replay_start : 1;
+    bool _have_filter : 1;
     bool _active;
     unsigned _extra_pkthdr_crap;
     unsigned _sampling_prob;
@@ -237,6 +326,8 @@ class FromDump : public Element { public:
     Timestamp _last_time;
     HandlerCall *_end_h;
 
+    Classification::Wordwise::CompressedProgram _filter;
+
 #if HAVE_INT64_TYPES
     typedef uint64_t counter_t;
 #else
@@ -251,7 +342,29 @@ class FromDump : public Element { public:
     Timestamp _timing_offset;
     off_t _packet_filepos;
 
+    struct Trace;
+    Trace *_trace;
+    Vector<Packet *> _replay;
+    int _replay_pos;
+    unsigned _loop;
+    unsigned _passes;
+    unsigned _burst;
+    unsigned _shard;
+    unsigned _nshards;
+    Timestamp _replay_start;
+
+    String _index_filename;
+    TraceIndex _index;
+    off_t _index_next_pos;
+
     bool read_packet(ErrorHandler *);
+    bool filter_match(const uint8_t *data, uint32_t length) const;
+    int load_trace(ErrorHandler *);
+    int share_trace(ErrorHandler *);
+    void release_trace();
+    bool replay_due(Packet *p);
+    bool replay_task();
+    Packet *replay_pull();
 
     void prepare_times(const Timestamp &);
     bool check_timing(Packet *p);
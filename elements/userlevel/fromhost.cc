@@ -22,6 +22,7 @@
 #include <click/error.hh>
 #include <click/bitvector.hh>
 #include <click/args.hh>
+#include <click/router.hh>
 #include <click/straccum.hh>
 #include <click/glue.hh>
 #include <clicknet/ether.h>
@@ -40,7 +41,7 @@
 CLICK_DECLS
 
 FromHost::FromHost()
-    : _fd(-1), _task(this)
+    : _fd(-1), _timestamp(true), _task(this)
 {
 #if HAVE_IP6
     _prefix6 = 0;
@@ -203,6 +204,7 @@ FromHost::initialize(ErrorHandler *errh)
 
     ScheduleInfo::join_scheduler(this, &_task, errh);
     _nonfull_signal = Notifier::downstream_full_signal(this, 0, &_task);
+    _timestamp = router()->timestamp_required(this);
 
     add_select(_fd, SELECT_READ);
     return 0;
@@ -238,7 +240,8 @@ FromHost::selected(int fd, int)
 	const click_ip *ip = reinterpret_cast<const click_ip *>(p->data() + sizeof(click_ether));
 	p->set_dst_ip_anno(IPAddress(ip->ip_dst));
 	p->set_ip_header(ip, ip->ip_hl << 2);
-	p->timestamp_anno().assign_now();
+	if (_timestamp)
+	    p->timestamp_anno().assign_now();
 	output(0).push(p);
     } else {
 	p->kill();
@@ -139,6 +139,7 @@ class FromHost : public Element { public:
 #endif
 
     unsigned _headroom;
+    bool _timestamp;
     Task _task;
     NotifierSignal _nonfull_signal;
 
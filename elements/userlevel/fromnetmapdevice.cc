@@ -0,0 +1,144 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fromnetmapdevice.{cc,hh} -- element reads packets from a device via netmap
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fromnetmapdevice.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <sys/ioctl.h>
+CLICK_DECLS
+
+FromNetmapDevice::FromNetmapDevice()
+    : _port(0), _task(this), _count(0)
+{
+}
+
+FromNetmapDevice::~FromNetmapDevice()
+{
+}
+
+int
+FromNetmapDevice::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _queue = -1;
+    _host = false;
+    _burst = 32;
+    _headroom = Packet::default_headroom;
+    _nspare = NetmapPort::default_spare;
+    if (Args(conf, this, errh)
+	.read_mp("DEVNAME", _ifname)
+	.read_p("QUEUE", _queue)
+	.read("HOST", _host)
+	.read("BURST", _burst)
+	.read("HEADROOM", _headroom)
+	.read("SPARE_BUFFERS", _nspare)
+	.complete() < 0)
+	return -1;
+    if (_burst <= 0)
+	return errh->error("bad BURST");
+    if (_nspare < 0)
+	return errh->error("bad SPARE_BUFFERS");
+    return 0;
+}
+
+int
+FromNetmapDevice::initialize(ErrorHandler *errh)
+{
+    _port = NetmapPort::open(router(), _ifname, _queue, _host, _nspare, errh);
+    if (!_port)
+	return -1;
+    ScheduleInfo::initialize_task(this, &_task, false, errh);
+    add_select(_port->fd(), SELECT_READ);
+    return 0;
+}
+
+void
+FromNetmapDevice::cleanup(CleanupStage)
+{
+    if (_port)
+	_port->close(router());
+    _port = 0;
+}
+
+int
+FromNetmapDevice::dispatch(int max)
+{
+    struct nm_desc *d = _port->desc();
+    PacketBatch batch;
+    int n = 0;
+    for (int ri = d->first_rx_ring; ri <= d->last_rx_ring && n < max; ++ri) {
+	struct netmap_ring *ring = NETMAP_RXRING(d->nifp, ri);
+	Timestamp ts = Timestamp::make_usec(ring->ts.tv_sec, ring->ts.tv_usec);
+	uint32_t cur = ring->cur;
+	for (; n < max && cur != ring->tail; ++n, cur = nm_ring_next(ring, cur))
+	    if (Packet *p = _port->make_packet(ring, &ring->slot[cur], _headroom)) {
+		p->set_timestamp_anno(ts);
+		p->set_mac_header(p->data());
+		batch.push_back(p);
+	    }
+	ring->head = ring->cur = cur;
+    }
+    _count += batch.count();
+    output(0).push_batch(batch);
+    return n;
+}
+
+void
+FromNetmapDevice::selected(int, int)
+{
+    // poll() has already synchronized the receive rings.
+    if (dispatch(_burst) == _burst)
+	_task.reschedule();
+}
+
+bool
+FromNetmapDevice::run_task(Task *)
+{
+    // Keep reading while the rings have a full burst ready.
+    ioctl(_port->fd(), NIOCRXSYNC, 0);
+    int n = dispatch(_burst);
+    if (n == _burst)
+	_task.fast_reschedule();
+    return n > 0;
+}
+
+String
+FromNetmapDevice::read_handler(Element *e, void *)
+{
+    FromNetmapDevice *fd = static_cast<FromNetmapDevice *>(e);
+    return String(fd->_count);
+}
+
+int
+FromNetmapDevice::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    FromNetmapDevice *fd = static_cast<FromNetmapDevice *>(e);
+    fd->_count = 0;
+    return 0;
+}
+
+void
+FromNetmapDevice::add_handlers()
+{
+    add_read_handler("count", read_handler, 0);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel netmap NetmapPort)
+EXPORT_ELEMENT(FromNetmapDevice)
+ELEMENT_MT_SAFE(FromNetmapDevice)
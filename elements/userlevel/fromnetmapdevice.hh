@@ -0,0 +1,131 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FROMNETMAPDEVICE_HH
+#define CLICK_FROMNETMAPDEVICE_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include "netmapport.hh"
+CLICK_DECLS
+
+/*
+=c
+
+FromNetmapDevice(DEVNAME [, QUEUE, I<keywords> HOST, BURST, HEADROOM, SPARE_BUFFERS])
+
+=s netdevices
+
+reads packets from a network device via netmap (user-level)
+
+=d
+
+Reads packets received on the network device named DEVNAME, using netmap.
+Netmap takes the device away from the kernel's network stack: while
+FromNetmapDevice runs, the kernel does not see the device's packets unless
+Click passes them on, for example with ToNetmapDevice's HOST option.  If
+QUEUE is given, FromNetmapDevice reads only that hardware ring; otherwise it
+reads them all.  Packets are emitted in batches of up to BURST using
+push_batch().
+
+FromNetmapDevice does not copy packets.  Each emitted packet's data is the
+netmap buffer the device received it into, and a spare buffer takes the
+packet's place in the ring.  The buffer returns to the spare pool when the
+packet is killed, or is swapped into a transmit ring by ToNetmapDevice.  If
+the spare pool runs out, because too many packets are held (a large Queue,
+for example), received packets are copied until buffers return.  Netmap
+buffers have no headroom, so prepending a header to a packet copies it.
+
+Keyword arguments are:
+
+=over 8
+
+=item HOST
+
+Boolean.  If true, read the packets the kernel's network stack sends to
+DEVNAME, from the device's host rings, instead of the packets received by
+the device.  This replaces FromHost for devices Click takes over with netmap.
+QUEUE is ignored.  Default is false.
+
+=item BURST
+
+Integer.  Maximum number of packets to read per scheduling.  Default is 32.
+
+=item HEADROOM
+
+Unsigned.  Headroom of copied packets.  Default is Packet::default_headroom.
+
+=item SPARE_BUFFERS
+
+Unsigned.  Number of spare netmap buffers to request, if this is the first
+netmap port in its memory region.  Default is 4096.
+
+=back
+
+=e
+
+This configuration forwards between a device and the host stack, passing
+ARP to the host and everything else through a router:
+
+  nic :: FromNetmapDevice(em0) -> c :: Classifier(12/0806, -);
+  c[0] -> ToNetmapDevice(em0, HOST true);
+  c[1] -> ... -> Queue -> ToNetmapDevice(em0);
+  FromNetmapDevice(em0, HOST true) -> Queue -> ToNetmapDevice(em0);
+
+=n
+
+FromNetmapDevice requires netmap, which is part of FreeBSD and is available
+as a module for Linux.
+
+=h count read-only
+
+Returns the number of packets read.
+
+=h reset_counts write-only
+
+Resets "count" to zero.
+
+=a ToNetmapDevice, FromDevice.u, FromXDP */
+
+class FromNetmapDevice : public Element { public:
+
+    FromNetmapDevice();
+    ~FromNetmapDevice();
+
+    const char *class_name() const	{ return "FromNetmapDevice"; }
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void selected(int fd, int mask);
+    bool run_task(Task *);
+
+  private:
+
+    NetmapPort *_port;
+    Task _task;
+
+    String _ifname;
+    int _queue;
+    bool _host;
+    int _burst;
+    unsigned _headroom;
+    int _nspare;
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t _count;
+
+    int dispatch(int max);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,128 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fromshm.{cc,hh} -- element receives packets through shared memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fromshm.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/standard/scheduleinfo.hh>
+CLICK_DECLS
+
+FromShm::FromShm()
+    : _chan(0), _task(this), _count(0)
+{
+}
+
+FromShm::~FromShm()
+{
+}
+
+int
+FromShm::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _burst = 32;
+    _nslots = 1024;
+    _slot_size = 2048;
+    if (Args(conf, this, errh)
+	.read_mp("PATH", FilenameArg(), _path)
+	.read("BURST", _burst)
+	.read("SLOTS", _nslots)
+	.read("SLOT_SIZE", _slot_size)
+	.complete() < 0)
+	return -1;
+    if (_burst <= 0)
+	return errh->error("bad BURST");
+    if (_nslots < 2 || (_nslots & (_nslots - 1)) || _nslots > 0x1000000)
+	return errh->error("SLOTS must be a power of two");
+    if (_slot_size < 128 || (_slot_size & 7))
+	return errh->error("SLOT_SIZE must be a multiple of 8, at least 128");
+    return 0;
+}
+
+int
+FromShm::initialize(ErrorHandler *errh)
+{
+    if (!(_chan = ShmChannel::open(this, _path, _nslots, _slot_size, errh)))
+	return -1;
+    ScheduleInfo::initialize_task(this, &_task, true, errh);
+    add_select(_chan->wake_fd(), SELECT_READ);
+    return 0;
+}
+
+void
+FromShm::cleanup(CleanupStage)
+{
+    if (_chan) {
+	remove_select(_chan->wake_fd(), SELECT_READ);
+	_chan->close(this);
+    }
+    _chan = 0;
+}
+
+int
+FromShm::dispatch()
+{
+    PacketBatch batch;
+    for (int i = 0; i < _burst; ++i)
+	if (WritablePacket *p = _chan->receive())
+	    batch.push_back(p);
+	else
+	    break;
+    _chan->receive_done();
+    int n = batch.count();
+    _count += n;
+    if (n)
+	output(0).push_batch(batch);
+    return n;
+}
+
+void
+FromShm::selected(int, int)
+{
+    _chan->clear_doorbell();
+    _task.reschedule();
+}
+
+bool
+FromShm::run_task(Task *)
+{
+    int n = dispatch();
+    // Keep polling while packets arrive; otherwise wait for the doorbell.
+    if (n == _burst || !_chan->prepare_sleep())
+	_task.fast_reschedule();
+    return n > 0;
+}
+
+int
+FromShm::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    FromShm *fs = static_cast<FromShm *>(e);
+    fs->_count = 0;
+    return 0;
+}
+
+void
+FromShm::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+    add_task_handlers(&_task);
+    add_stat("count", &_count);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel ShmChannel)
+EXPORT_ELEMENT(FromShm)
+ELEMENT_MT_SAFE(FromShm)
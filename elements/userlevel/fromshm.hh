@@ -0,0 +1,128 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FROMSHM_HH
+#define CLICK_FROMSHM_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include "shmchannel.hh"
+CLICK_DECLS
+
+/*
+=c
+
+FromShm(PATH [, I<keywords> BURST, SLOTS, SLOT_SIZE])
+
+=s comm
+
+receives packets from another Click process through shared memory (user-level)
+
+=d
+
+Emits packets that another Click process sent with ToShm through the
+shared-memory channel PATH.  Packets are emitted in batches of up to BURST
+using push_batch().
+
+A channel connects exactly two Click processes, each of which may both send
+(with ToShm) and receive (with FromShm) on it.  PATH names a file, normally
+on a tmpfs such as /dev/shm, that both processes map into memory; it holds
+a pool of packet buffers, called slots, and lock-free single-producer,
+single-consumer rings that pass slots between the processes.  The first
+process to open PATH creates the channel and removes it when it exits.  A
+FIFO named PATH.wake0 or PATH.wake1 wakes up a receiver that has gone idle;
+a sender writes to it only when the receiver is waiting, so a busy channel
+makes no system calls.
+
+FromShm emits packets whose data stays in their slots: receiving copies
+nothing.  A slot returns to the sender once its packet is killed, so
+elements that hold packets for a long time can use up the sender's slots.
+A packet FromShm emitted that is sent back through the same channel with
+ToShm, without being cloned, passes on its slot without a copy.  Packet
+annotations are not carried across the channel.
+
+Keyword arguments are:
+
+=over 8
+
+=item BURST
+
+Integer.  Maximum number of packets to emit per scheduling.  Default is 32.
+
+=item SLOTS
+
+Unsigned.  Number of slots in the channel, half for each side's sending.
+Must be a power of two.  Used only by the process that creates the channel.
+Default is 1024.
+
+=item SLOT_SIZE
+
+Unsigned.  Size of each slot in bytes.  Packets longer than SLOT_SIZE less
+8 bytes cannot be sent.  Used only by the process that creates the channel.
+Default is 2048.
+
+=back
+
+=e
+
+A pipeline split across two processes:
+
+  // process 1
+  FromDevice(eth0) -> Strip(14) -> CheckIPHeader -> ToShm(/dev/shm/click0);
+  FromShm(/dev/shm/click0) -> Queue -> ToDevice(eth0);
+
+  // process 2
+  FromShm(/dev/shm/click0) -> IPFilter(allow udp, deny all)
+      -> EtherEncap(0x0800, 1:1:1:1:1:1, 2:2:2:2:2:2)
+      -> Queue -> ToShm(/dev/shm/click0);
+
+Packets process 2 sends back are not copied.
+
+=h count read-only
+
+Returns the number of packets received.
+
+=h reset_counts write-only
+
+Resets "count" to zero.
+
+=a ToShm, Socket */
+
+class FromShm : public Element { public:
+
+    FromShm();
+    ~FromShm();
+
+    const char *class_name() const	{ return "FromShm"; }
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void selected(int fd, int mask);
+    bool run_task(Task *);
+
+  private:
+
+    ShmChannel *_chan;
+    Task _task;
+    String _path;
+    int _burst;
+    uint32_t _nslots;
+    uint32_t _slot_size;
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t _count;
+
+    int dispatch();
+
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,641 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fromxdp.{cc,hh} -- element reads packets from a device queue via AF_XDP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fromxdp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <linux/if_link.h>
+#include <linux/bpf.h>
+#ifndef AF_XDP
+# define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+# define SOL_XDP 283
+#endif
+CLICK_DECLS
+
+/* The UMEM is an array of frames.  A frame that holds a packet emitted by
+   FromXDP starts with a pointer to its Umem, followed by the packet buffer;
+   the kernel leaves the first UMEM_HEADROOM bytes of each frame alone.
+   Frames not owned by the kernel or by a packet sit on the free list, which
+   is shared by FromXDP (receive), ToXDP (transmit), and packet destructors
+   (any thread), and so is locked.  The Umem itself lives until FromXDP
+   closes it and every packet referring to it is killed. */
+struct FromXDP::Umem {
+    unsigned char *area;
+    size_t area_size;
+    uint32_t frame_size;
+    uint32_t *free;
+    uint32_t nfree;
+    unsigned char *sending;	// frame is queued for transmission
+    Spinlock lock;
+    atomic_uint32_t live;	// 1 while open, plus 1 per packet
+
+    enum { UMEM_HEADROOM = sizeof(Umem *) };
+
+    uint32_t frame(const unsigned char *x) const {
+	return (x - area) / frame_size;
+    }
+    bool contains(const unsigned char *x) const {
+	return x >= area && x < area + area_size;
+    }
+    uint32_t get(uint32_t *frames, uint32_t n) {
+	lock.acquire();
+	if (n > nfree)
+	    n = nfree;
+	nfree -= n;
+	memcpy(frames, free + nfree, n * sizeof(uint32_t));
+	lock.release();
+	return n;
+    }
+    void put(uint32_t f) {
+	lock.acquire();
+	free[nfree++] = f;
+	lock.release();
+    }
+    void release() {
+	if (live.dec_and_test()) {
+	    munmap(area, area_size);
+	    delete[] free;
+	    delete[] sending;
+	    delete this;
+	}
+    }
+};
+
+/* The XDP program and XSKMAP attached to a device, shared by every FromXDP
+   on that device through a router attachment. */
+struct FromXDP::Program {
+    int map_fd;
+    int link_fd;
+    int refs;
+    enum { default_map_size = 256 };
+};
+
+static inline void
+xdp_fence()
+{
+#if HAVE___SYNC_SYNCHRONIZE
+    __sync_synchronize();
+#else
+    click_compiler_fence();
+#endif
+}
+
+static int
+bpf_call(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+FromXDP::FromXDP()
+    : _fd(-1), _umem(0), _program(0), _task(this), _zerocopy(false),
+      _timestamp(true), _tx_pending(0), _count(0)
+{
+    memset(&_rx, 0, sizeof(_rx));
+    memset(&_fill, 0, sizeof(_fill));
+    memset(&_tx, 0, sizeof(_tx));
+    memset(&_comp, 0, sizeof(_comp));
+}
+
+FromXDP::~FromXDP()
+{
+}
+
+int
+FromXDP::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _queue = 0;
+    _nframes = 4096;
+    _frame_size = 2048;
+    _ring_size = 2048;
+    _burst = 32;
+    String xdp_mode = "AUTO";
+    bool zerocopy, zerocopy_set;
+    if (Args(conf, this, errh)
+	.read_mp("DEVNAME", _ifname)
+	.read_p("QUEUE", _queue)
+	.read("FRAMES", _nframes)
+	.read("FRAME_SIZE", _frame_size)
+	.read("RING_SIZE", _ring_size)
+	.read("BURST", _burst)
+	.read("ZEROCOPY", zerocopy).read_status(zerocopy_set)
+	.read("XDP_MODE", WordArg(), xdp_mode)
+	.read("PROGRAM", FilenameArg(), _program_path)
+	.read("XSKMAP", FilenameArg(), _xskmap_path)
+	.complete() < 0)
+	return -1;
+
+    if (!_ifname)
+	return errh->error("interface not set");
+    if (_queue < 0)
+	return errh->error("bad QUEUE");
+    if (_frame_size != 2048 && _frame_size != 4096)
+	return errh->error("FRAME_SIZE must be 2048 or 4096");
+    if (_ring_size < 2 || (_ring_size & (_ring_size - 1)))
+	return errh->error("RING_SIZE must be a power of two");
+    if (_nframes < 2 || (uint64_t) _nframes * _frame_size > ((uint64_t) 1 << 32))
+	return errh->error("FRAMES out of range");
+    if (_burst <= 0)
+	return errh->error("bad BURST");
+    if (_program_path && !_xskmap_path)
+	return errh->error("PROGRAM requires XSKMAP");
+
+    _bind_flags = XDP_USE_NEED_WAKEUP;
+    if (zerocopy_set)
+	_bind_flags |= (zerocopy ? XDP_ZEROCOPY : XDP_COPY);
+    xdp_mode = xdp_mode.upper();
+    if (xdp_mode == "AUTO")
+	_xdp_flags = 0;
+    else if (xdp_mode == "SKB")
+	_xdp_flags = XDP_FLAGS_SKB_MODE;
+    else if (xdp_mode == "NATIVE")
+	_xdp_flags = XDP_FLAGS_DRV_MODE;
+    else
+	return errh->error("bad XDP_MODE");
+    return 0;
+}
+
+int
+FromXDP::open_ring(Ring &ring, int opt, const struct xdp_ring_offset &off,
+		   size_t desc_size, uint64_t pgoff, ErrorHandler *errh)
+{
+    size_t map_size = off.desc + _ring_size * desc_size;
+    void *map = mmap(0, map_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, _fd, pgoff);
+    if (map == MAP_FAILED)
+	return errh->error("%s: mmap ring %d: %s", _ifname.c_str(), opt, strerror(errno));
+    unsigned char *base = reinterpret_cast<unsigned char *>(map);
+    ring.producer = reinterpret_cast<uint32_t *>(base + off.producer);
+    ring.consumer = reinterpret_cast<uint32_t *>(base + off.consumer);
+    ring.flags = reinterpret_cast<uint32_t *>(base + off.flags);
+    ring.desc = base + off.desc;
+    ring.mask = _ring_size - 1;
+    ring.next = 0;
+    ring.cached = _ring_size;
+    ring.map = map;
+    ring.map_size = map_size;
+    return 0;
+}
+
+void
+FromXDP::close_ring(Ring &ring)
+{
+    if (ring.map)
+	munmap(ring.map, ring.map_size);
+    ring.map = 0;
+}
+
+int
+FromXDP::attach_program(ErrorHandler *errh)
+{
+    void *&attachment = router()->force_attachment("FromXDP_program_" + _ifname);
+    _program = reinterpret_cast<Program *>(attachment);
+    union bpf_attr attr;
+
+    if (!_program) {
+	int map_fd, prog_fd = -1;
+	if (_xskmap_path) {
+	    memset(&attr, 0, sizeof(attr));
+	    attr.pathname = (uintptr_t) _xskmap_path.c_str();
+	    if ((map_fd = bpf_call(BPF_OBJ_GET, &attr)) < 0)
+		return errh->error("%s: %s", _xskmap_path.c_str(), strerror(errno));
+	} else {
+	    memset(&attr, 0, sizeof(attr));
+	    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+	    attr.key_size = attr.value_size = sizeof(int);
+	    attr.max_entries = Program::default_map_size;
+	    if ((map_fd = bpf_call(BPF_MAP_CREATE, &attr)) < 0)
+		return errh->error("%s: cannot create XSKMAP: %s", _ifname.c_str(), strerror(errno));
+	}
+
+	if (_program_path) {
+	    memset(&attr, 0, sizeof(attr));
+	    attr.pathname = (uintptr_t) _program_path.c_str();
+	    prog_fd = bpf_call(BPF_OBJ_GET, &attr);
+	    if (prog_fd < 0)
+		errh->error("%s: %s", _program_path.c_str(), strerror(errno));
+	} else if (!_xskmap_path) {
+	    // return bpf_redirect_map(&xskmap, ctx->rx_queue_index, XDP_PASS);
+	    struct bpf_insn insns[6];
+	    memset(insns, 0, sizeof(insns));
+	    insns[0].code = BPF_LDX | BPF_W | BPF_MEM;
+	    insns[0].dst_reg = BPF_REG_2;
+	    insns[0].src_reg = BPF_REG_1;
+	    insns[0].off = offsetof(struct xdp_md, rx_queue_index);
+	    insns[1].code = BPF_LD | BPF_DW | BPF_IMM;
+	    insns[1].dst_reg = BPF_REG_1;
+	    insns[1].src_reg = BPF_PSEUDO_MAP_FD;
+	    insns[1].imm = map_fd;
+	    insns[3].code = BPF_ALU64 | BPF_MOV | BPF_K;
+	    insns[3].dst_reg = BPF_REG_3;
+	    insns[3].imm = XDP_PASS;
+	    insns[4].code = BPF_JMP | BPF_CALL;
+	    insns[4].imm = BPF_FUNC_redirect_map;
+	    insns[5].code = BPF_JMP | BPF_EXIT;
+	    memset(&attr, 0, sizeof(attr));
+	    attr.prog_type = BPF_PROG_TYPE_XDP;
+	    attr.insn_cnt = sizeof(insns) / sizeof(insns[0]);
+	    attr.insns = (uintptr_t) insns;
+	    attr.license = (uintptr_t) "Dual BSD/GPL";
+	    prog_fd = bpf_call(BPF_PROG_LOAD, &attr);
+	    if (prog_fd < 0)
+		errh->error("%s: cannot load XDP program: %s", _ifname.c_str(), strerror(errno));
+	}
+
+	int link_fd = -1;
+	if (prog_fd >= 0) {
+	    memset(&attr, 0, sizeof(attr));
+	    attr.link_create.prog_fd = prog_fd;
+	    attr.link_create.target_ifindex = _ifindex;
+	    attr.link_create.attach_type = BPF_XDP;
+	    attr.link_create.flags = _xdp_flags;
+	    link_fd = bpf_call(BPF_LINK_CREATE, &attr);
+	    if (link_fd < 0)
+		errh->error("%s: cannot attach XDP program: %s", _ifname.c_str(), strerror(errno));
+	    close(prog_fd);
+	}
+	if (link_fd < 0 && (_program_path || !_xskmap_path)) {
+	    close(map_fd);
+	    return -1;
+	}
+
+	_program = new Program;
+	_program->map_fd = map_fd;
+	_program->link_fd = link_fd;
+	_program->refs = 0;
+	attachment = _program;
+    }
+
+    ++_program->refs;
+    memset(&attr, 0, sizeof(attr));
+    uint32_t key = _queue;
+    attr.map_fd = _program->map_fd;
+    attr.key = (uintptr_t) &key;
+    attr.value = (uintptr_t) &_fd;
+    if (bpf_call(BPF_MAP_UPDATE_ELEM, &attr) < 0)
+	return errh->error("%s: cannot add queue %d to XSKMAP: %s", _ifname.c_str(), _queue, strerror(errno));
+    return 0;
+}
+
+void
+FromXDP::detach_program()
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    uint32_t key = _queue;
+    attr.map_fd = _program->map_fd;
+    attr.key = (uintptr_t) &key;
+    bpf_call(BPF_MAP_DELETE_ELEM, &attr);
+    if (--_program->refs == 0) {
+	if (_program->link_fd >= 0)
+	    close(_program->link_fd);
+	close(_program->map_fd);
+	router()->set_attachment("FromXDP_program_" + _ifname, 0);
+	delete _program;
+    }
+    _program = 0;
+}
+
+int
+FromXDP::initialize(ErrorHandler *errh)
+{
+    _ifindex = if_nametoindex(_ifname.c_str());
+    if (!_ifindex)
+	return errh->error("%s: unknown device", _ifname.c_str());
+    _fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (_fd < 0)
+	return errh->error("%s: socket: %s", _ifname.c_str(), strerror(errno));
+
+    size_t area_size = (size_t) _nframes * _frame_size;
+    void *area = mmap(0, area_size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (area == MAP_FAILED)
+	return errh->error("%s: UMEM: %s", _ifname.c_str(), strerror(errno));
+    _umem = new Umem;
+    _umem->area = reinterpret_cast<unsigned char *>(area);
+    _umem->area_size = area_size;
+    _umem->frame_size = _frame_size;
+    _umem->free = new uint32_t[_nframes];
+    _umem->sending = new unsigned char[_nframes];
+    memset(_umem->sending, 0, _nframes);
+    _umem->nfree = 0;
+    for (uint32_t f = _nframes; f > 0; --f)
+	_umem->free[_umem->nfree++] = f - 1;
+    _umem->live = 1;
+
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uintptr_t) area;
+    reg.len = area_size;
+    reg.chunk_size = _frame_size;
+    reg.headroom = Umem::UMEM_HEADROOM;
+    if (setsockopt(_fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0)
+	return errh->error("%s: XDP_UMEM_REG: %s", _ifname.c_str(), strerror(errno));
+    if (setsockopt(_fd, SOL_XDP, XDP_UMEM_FILL_RING, &_ring_size, sizeof(_ring_size)) < 0
+	|| setsockopt(_fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &_ring_size, sizeof(_ring_size)) < 0
+	|| setsockopt(_fd, SOL_XDP, XDP_RX_RING, &_ring_size, sizeof(_ring_size)) < 0
+	|| setsockopt(_fd, SOL_XDP, XDP_TX_RING, &_ring_size, sizeof(_ring_size)) < 0)
+	return errh->error("%s: ring setup: %s", _ifname.c_str(), strerror(errno));
+
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(_fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0)
+	return errh->error("%s: XDP_MMAP_OFFSETS: %s", _ifname.c_str(), strerror(errno));
+    if (open_ring(_rx, XDP_RX_RING, off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING, errh) < 0
+	|| open_ring(_tx, XDP_TX_RING, off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING, errh) < 0
+	|| open_ring(_fill, XDP_UMEM_FILL_RING, off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING, errh) < 0
+	|| open_ring(_comp, XDP_UMEM_COMPLETION_RING, off.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING, errh) < 0)
+	return -1;
+
+    // Give the kernel up to half the frames for receiving.
+    uint32_t nfill = _nframes / 2;
+    if (nfill > _ring_size)
+	nfill = _ring_size;
+    uint32_t *frames = new uint32_t[nfill];
+    nfill = _umem->get(frames, nfill);
+    uint64_t *fdesc = reinterpret_cast<uint64_t *>(_fill.desc);
+    for (uint32_t i = 0; i < nfill; ++i)
+	fdesc[i] = (uint64_t) frames[i] * _frame_size;
+    delete[] frames;
+    xdp_fence();
+    *_fill.producer = nfill;
+
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_flags = _bind_flags;
+    sxdp.sxdp_ifindex = _ifindex;
+    sxdp.sxdp_queue_id = _queue;
+    if (bind(_fd, (struct sockaddr *) &sxdp, sizeof(sxdp)) < 0)
+	return errh->error("%s: bind queue %d: %s", _ifname.c_str(), _queue, strerror(errno));
+
+    struct xdp_options opts;
+    optlen = sizeof(opts);
+    _zerocopy = getsockopt(_fd, SOL_XDP, XDP_OPTIONS, &opts, &optlen) >= 0
+	&& (opts.flags & XDP_OPTIONS_ZEROCOPY);
+
+    if (attach_program(errh) < 0)
+	return -1;
+
+    _timestamp = router()->timestamp_required(this);
+    ScheduleInfo::initialize_task(this, &_task, false, errh);
+    add_select(_fd, SELECT_READ);
+    return 0;
+}
+
+void
+FromXDP::cleanup(CleanupStage)
+{
+    if (_program)
+	detach_program();
+    close_ring(_rx);
+    close_ring(_tx);
+    close_ring(_fill);
+    close_ring(_comp);
+    if (_fd >= 0)
+	close(_fd);
+    _fd = -1;
+    if (_umem)
+	_umem->release();
+    _umem = 0;
+}
+
+/* A packet's buffer starts after the frame's Umem pointer. */
+void
+FromXDP::umem_destructor(unsigned char *buf, size_t)
+{
+    unsigned char *frame = buf - Umem::UMEM_HEADROOM;
+    Umem *u = *reinterpret_cast<Umem **>(frame);
+    uint32_t f = u->frame(frame);
+    // A frame handed to ToXDP without a copy returns through the
+    // completion ring.
+    if (!u->sending[f])
+	u->put(f);
+    u->release();
+}
+
+void
+FromXDP::refill()
+{
+    uint32_t prod = *_fill.producer;
+    uint32_t space = _ring_size - (prod - *(volatile uint32_t *) _fill.consumer);
+    uint32_t frames[64];
+    uint64_t *fdesc = reinterpret_cast<uint64_t *>(_fill.desc);
+    while (space) {
+	uint32_t n = _umem->get(frames, space < 64 ? space : 64);
+	if (!n)
+	    break;
+	for (uint32_t i = 0; i < n; ++i, ++prod)
+	    fdesc[prod & _fill.mask] = (uint64_t) frames[i] * _frame_size;
+	space -= n;
+    }
+    if (prod != *_fill.producer) {
+	xdp_fence();
+	*_fill.producer = prod;
+	if (*(volatile uint32_t *) _fill.flags & XDP_RING_NEED_WAKEUP)
+	    recvfrom(_fd, 0, 0, MSG_DONTWAIT, 0, 0);
+    }
+}
+
+int
+FromXDP::dispatch(int max)
+{
+    uint32_t cons = *_rx.consumer;
+    uint32_t avail = *(volatile uint32_t *) _rx.producer - cons;
+    if (avail > (uint32_t) max)
+	avail = max;
+    if (avail)
+	xdp_fence();
+
+    Umem *u = _umem;
+    const struct xdp_desc *desc = reinterpret_cast<const struct xdp_desc *>(_rx.desc);
+    Timestamp now = _timestamp ? Timestamp::now() : Timestamp();
+    PacketBatch batch;
+    for (uint32_t i = 0; i < avail; ++i, ++cons) {
+	const struct xdp_desc &d = desc[cons & _rx.mask];
+	unsigned char *frame = u->area + (d.addr & ~(uint64_t) (_frame_size - 1));
+	unsigned char *data = u->area + d.addr;
+	WritablePacket *p = Packet::make(frame + Umem::UMEM_HEADROOM, _frame_size - Umem::UMEM_HEADROOM, umem_destructor);
+	if (!p) {
+	    u->put(u->frame(frame));
+	    continue;
+	}
+	*reinterpret_cast<Umem **>(frame) = u;
+	++u->live;
+	p->pull(data - p->data());
+	p->take(p->length() - d.len);
+	p->set_timestamp_anno(now);
+	p->set_mac_header(p->data());
+	batch.push_back(p);
+    }
+    if (avail) {
+	xdp_fence();
+	*_rx.consumer = cons;
+    }
+
+    refill();
+    _count += batch.count();
+    int n = batch.count();
+    output(0).push_batch(batch);
+    return n;
+}
+
+void
+FromXDP::selected(int, int)
+{
+    if (dispatch(_burst) == _burst)
+	_task.reschedule();
+}
+
+bool
+FromXDP::run_task(Task *)
+{
+    // Keep reading while the ring has a full burst ready.
+    int n = dispatch(_burst);
+    if (n == _burst)
+	_task.fast_reschedule();
+    return n > 0;
+}
+
+/** Queue @a p on the transmit ring.  Returns 1 if @a p was queued and is
+    consumed, 0 if the ring or the UMEM is full, or -1 if @a p is too long.
+    Sets @a zerocopy to true if @a p was queued without a copy. */
+int
+FromXDP::transmit(Packet *p, bool &zerocopy)
+{
+    Umem *u = _umem;
+    uint32_t prod = _tx.next;
+    if (prod == _tx.cached) {
+	_tx.cached = *(volatile uint32_t *) _tx.consumer + _ring_size;
+	if (prod == _tx.cached)
+	    return 0;
+    }
+
+    uint64_t addr;
+    uint32_t f;
+    if (u->contains(p->buffer()) && !p->shared()) {
+	// send the packet's own frame
+	addr = p->data() - u->area;
+	f = u->frame(p->data());
+	u->sending[f] = 1;
+	zerocopy = true;
+    } else if (p->length() > _frame_size)
+	return -1;
+    else if (!u->get(&f, 1))
+	return 0;
+    else {
+	addr = (uint64_t) f * _frame_size;
+	memcpy(u->area + addr, p->data(), p->length());
+	u->sending[f] = 1;
+	zerocopy = false;
+    }
+
+    struct xdp_desc *desc = reinterpret_cast<struct xdp_desc *>(_tx.desc);
+    desc[prod & _tx.mask].addr = addr;
+    desc[prod & _tx.mask].len = p->length();
+    desc[prod & _tx.mask].options = 0;
+    _tx.next = prod + 1;
+    _tx_pending++;
+    p->kill();
+    return 1;
+}
+
+void
+FromXDP::transmit_flush()
+{
+    if (_tx.next == *_tx.producer)
+	return;
+    xdp_fence();
+    *(volatile uint32_t *) _tx.producer = _tx.next;
+    if (*(volatile uint32_t *) _tx.flags & XDP_RING_NEED_WAKEUP)
+	sendto(_fd, 0, 0, MSG_DONTWAIT, 0, 0);
+}
+
+/** Return sent frames to the free list.  Returns the number of frames
+    reclaimed. */
+uint32_t
+FromXDP::reclaim()
+{
+    uint32_t cons = *_comp.consumer;
+    uint32_t avail = *(volatile uint32_t *) _comp.producer - cons;
+    if (!avail)
+	return 0;
+    xdp_fence();
+    const uint64_t *cdesc = reinterpret_cast<const uint64_t *>(_comp.desc);
+    Umem *u = _umem;
+    for (uint32_t i = 0; i < avail; ++i, ++cons) {
+	uint32_t f = cdesc[cons & _comp.mask] / _frame_size;
+	u->sending[f] = 0;
+	u->put(f);
+    }
+    xdp_fence();
+    *_comp.consumer = cons;
+    _tx_pending -= avail;
+    return avail;
+}
+
+String
+FromXDP::read_handler(Element *e, void *thunk)
+{
+    FromXDP *fx = static_cast<FromXDP *>(e);
+    switch ((intptr_t) thunk) {
+    case 0:
+	return String(fx->_count);
+    case 1: {
+	struct xdp_statistics stats;
+	socklen_t optlen = sizeof(stats);
+	if (fx->_fd < 0 || getsockopt(fx->_fd, SOL_XDP, XDP_STATISTICS, &stats, &optlen) < 0)
+	    return "??";
+	return String(stats.rx_dropped + stats.rx_ring_full + stats.rx_fill_ring_empty_descs);
+    }
+    case 2:
+	return String(fx->_zerocopy);
+    default:
+	return String();
+    }
+}
+
+int
+FromXDP::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    FromXDP *fx = static_cast<FromXDP *>(e);
+    fx->_count = 0;
+    return 0;
+}
+
+void
+FromXDP::add_handlers()
+{
+    add_read_handler("count", read_handler, 0);
+    add_read_handler("kernel_drops", read_handler, 1);
+    add_read_handler("zerocopy", read_handler, 2);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel afxdp)
+EXPORT_ELEMENT(FromXDP)
+ELEMENT_MT_SAFE(FromXDP)
@@ -0,0 +1,230 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FROMXDP_HH
+#define CLICK_FROMXDP_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/atomic.hh>
+#include <click/sync.hh>
+#include <linux/if_xdp.h>
+CLICK_DECLS
+
+/*
+=c
+
+FromXDP(DEVNAME [, QUEUE, I<keywords> FRAMES, RING_SIZE, BURST, ZEROCOPY, etc.])
+
+=s netdevices
+
+reads packets from a network device queue via AF_XDP (user-level)
+
+=d
+
+Reads packets received on queue QUEUE of the network device named DEVNAME,
+using an AF_XDP socket.  QUEUE defaults to 0.  AF_XDP packets bypass the
+kernel's network stack: an XDP program attached to the device redirects them
+into a packet memory area (the UMEM) shared by the kernel and Click, and
+FromXDP emits packets whose data points directly into that area.  Packets
+are emitted in batches of up to BURST using push_batch().
+
+Unless XSKMAP is given, FromXDP attaches a small XDP program to DEVNAME that
+redirects every packet arriving on a queue with a FromXDP to Click.  Other
+queues' packets are passed to the kernel as usual, so on a multiqueue NIC,
+flow steering rules (for example, C<ethtool -N>) can choose which flows
+reach Click.  Several FromXDP elements on different queues of one device
+share the program.  The program is removed when the router is cleaned up.
+
+A FromXDP shares its UMEM with the ToXDP element for the same device and
+queue, if any.  ToXDP sends packets that FromXDP emitted, and that have not
+been cloned, without copying them.
+
+Each UMEM frame is returned to the kernel once the packet that refers to it
+is killed, so elements that hold packets for a long time (a large Queue, for
+example) can exhaust the UMEM and cause kernel drops.  Packets modified in
+place are changed in the UMEM; headers of up to 256 bytes can be prepended
+without a copy.
+
+Keyword arguments are:
+
+=over 8
+
+=item FRAMES
+
+Unsigned.  Number of UMEM frames.  Half are initially given to the kernel
+for receiving packets; the rest are used for sending copied packets.
+Default is 4096.
+
+=item FRAME_SIZE
+
+Unsigned.  Size of each UMEM frame in bytes, either 2048 or 4096.  Packets
+longer than FRAME_SIZE less 264 bytes of headroom cannot be received.
+Default is 2048.
+
+=item RING_SIZE
+
+Unsigned.  Number of entries in each of the socket's rings.  Must be a power
+of two.  Default is 2048.
+
+=item BURST
+
+Integer.  Maximum number of packets to read per scheduling.  Default is 32.
+
+=item ZEROCOPY
+
+Boolean.  If true, require the device driver to support zero-copy AF_XDP,
+in which the device writes packets directly into the UMEM.  If false, always
+use copy mode, in which the kernel copies packets into the UMEM.  By
+default, zero-copy mode is used when the driver supports it.  Either way,
+Click itself does not copy packets.
+
+=item XDP_MODE
+
+Word.  How to attach the XDP program: C<SKB> for generic XDP, which works
+with any device; C<NATIVE> for driver XDP; or C<AUTO> to let the kernel
+choose.  Default is C<AUTO>.
+
+=item PROGRAM
+
+Filename.  A pinned XDP program, in a BPF filesystem, to attach instead of
+the default program.  The program should redirect the packets Click should
+receive with C<bpf_redirect_map()> into the XSKMAP map, keyed by receive
+queue index.  Requires XSKMAP.
+
+=item XSKMAP
+
+Filename.  A pinned BPF_MAP_TYPE_XSKMAP map.  FromXDP registers its socket
+in the map at key QUEUE.  If PROGRAM is not given, FromXDP assumes that the
+program using XSKMAP is already attached to DEVNAME, and attaches nothing.
+
+=back
+
+=e
+
+  FromXDP(eth1, 0) -> EtherMirror -> Queue -> ToXDP(eth1, 0);
+
+=n
+
+FromXDP requires a kernel that supports AF_XDP sockets and XDP links (Linux
+5.9 or later), and generally requires root privileges.
+
+=h count read-only
+
+Returns the number of packets read.
+
+=h kernel_drops read-only
+
+Returns the number of packets the kernel dropped before FromXDP could read
+them, because the receive ring was full or no UMEM frame was free.
+
+=h zerocopy read-only
+
+Returns true if the socket is in zero-copy mode.
+
+=h reset_counts write-only
+
+Resets "count" to zero.
+
+=a ToXDP, FromDevice.u, ToDevice.u */
+
+class FromXDP : public Element { public:
+
+    FromXDP();
+    ~FromXDP();
+
+    const char *class_name() const	{ return "FromXDP"; }
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return PUSH; }
+
+    enum { CONFIGURE_PHASE_FROMXDP = CONFIGURE_PHASE_DEFAULT,
+	   CONFIGURE_PHASE_TOXDP = CONFIGURE_PHASE_DEFAULT + 1 };
+    int configure_phase() const		{ return CONFIGURE_PHASE_FROMXDP; }
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void selected(int fd, int mask);
+    bool run_task(Task *);
+
+    String ifname() const		{ return _ifname; }
+    int queue() const			{ return _queue; }
+    int fd() const			{ return _fd; }
+
+    // Transmit interface for ToXDP.  These functions touch only the
+    // transmit and completion rings, so they may run on a different thread
+    // than FromXDP's own.
+    inline uint32_t transmit_space() const;
+    int transmit(Packet *p, bool &zerocopy);
+    void transmit_flush();
+    uint32_t reclaim();
+    uint32_t transmit_pending() const	{ return _tx_pending; }
+
+  private:
+
+    struct Ring {
+	uint32_t *producer;
+	uint32_t *consumer;
+	uint32_t *flags;
+	void *desc;
+	uint32_t mask;
+	uint32_t next;		// producer rings: next entry to fill
+	uint32_t cached;	// producer rings: consumer plus ring size
+	void *map;
+	size_t map_size;
+    };
+    struct Umem;
+    struct Program;
+
+    int _fd;
+    Umem *_umem;
+    Program *_program;
+    Ring _rx;
+    Ring _fill;
+    Ring _tx;
+    Ring _comp;
+    Task _task;
+
+    String _ifname;
+    int _ifindex;
+    int _queue;
+    uint32_t _nframes;
+    uint32_t _frame_size;
+    uint32_t _ring_size;
+    int _burst;
+    int _bind_flags;
+    int _xdp_flags;
+    String _program_path;
+    String _xskmap_path;
+    bool _zerocopy;
+    bool _timestamp;
+
+    uint32_t _tx_pending;
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t _count;
+
+    int open_ring(Ring &ring, int opt, const struct xdp_ring_offset &off,
+		  size_t desc_size, uint64_t pgoff, ErrorHandler *errh);
+    static void close_ring(Ring &ring);
+    int attach_program(ErrorHandler *errh);
+    void detach_program();
+    void refill();
+    int dispatch(int max);
+    static void umem_destructor(unsigned char *buf, size_t length);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+inline uint32_t
+FromXDP::transmit_space() const
+{
+    uint32_t cons = *(volatile uint32_t *) _tx.consumer;
+    return _ring_size - (_tx.next - cons);
+}
+
+CLICK_ENDDECLS
+#endif
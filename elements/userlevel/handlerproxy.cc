@@ -21,7 +21,7 @@
 CLICK_DECLS
 
 HandlerProxy::HandlerProxy()
-    : _err_rcvs(0), _nerr_rcvs(0)
+    : _err_rcvs(0), _nerr_rcvs(0), _cache_hits(0), _cache_misses(0)
 {
 }
 
@@ -62,6 +62,59 @@ HandlerProxy::check_handler(const String &hname, bool, ErrorHandler *errh)
     return -1;
 }
 
+bool
+HandlerProxy::cache_lookup(const String &hname, String &value)
+{
+    if (!_cache_staleness)
+	return false;
+    if (CachedRead *c = _cache.get_pointer(hname))
+	if (Timestamp::now_steady() - c->read_at <= _cache_staleness) {
+	    value = c->value;
+	    ++_cache_hits;
+	    return true;
+	}
+    ++_cache_misses;
+    return false;
+}
+
+void
+HandlerProxy::cache_store(const String &hname, const String &value)
+{
+    if (_cache_staleness) {
+	CachedRead &c = _cache[hname];
+	c.value = value;
+	c.read_at = Timestamp::now_steady();
+    }
+}
+
+enum { h_cache_hits, h_cache_misses, h_flush_cache };
+
+String
+HandlerProxy::cache_read_handler(Element *e, void *thunk)
+{
+    HandlerProxy *hp = static_cast<HandlerProxy *>(e->cast("HandlerProxy"));
+    if ((uintptr_t) thunk == h_cache_hits)
+	return String(hp->_cache_hits);
+    else
+	return String(hp->_cache_misses);
+}
+
+int
+HandlerProxy::cache_write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    HandlerProxy *hp = static_cast<HandlerProxy *>(e->cast("HandlerProxy"));
+    hp->cache_clear();
+    return 0;
+}
+
+void
+HandlerProxy::add_cache_handlers()
+{
+    add_read_handler("cache_hits", cache_read_handler, h_cache_hits);
+    add_read_handler("cache_misses", cache_read_handler, h_cache_misses);
+    add_write_handler("flush_cache", cache_write_handler, h_flush_cache, Handler::BUTTON);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(userlevel)
 ELEMENT_PROVIDES(HandlerProxy)
@@ -1,6 +1,8 @@
 #ifndef CLICK_HANDLERPROXY_HH
 #define CLICK_HANDLERPROXY_HH
 #include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/timestamp.hh>
 CLICK_DECLS
 
 class HandlerProxy : public Element { public:
@@ -36,6 +38,26 @@ class HandlerProxy : public Element { public:
     ErrorReceiver* _err_rcvs;
     int _nerr_rcvs;
 
+    // Proxied read results, reused while younger than _cache_staleness, so
+    // READMANY and SUBSCRIBE clients polling the same handlers share reads.
+    struct CachedRead {
+	String value;
+	Timestamp read_at;	// steady clock
+    };
+    HashTable<String, CachedRead> _cache;
+    Timestamp _cache_staleness;	// zero means no caching
+    uint32_t _cache_hits;
+    uint32_t _cache_misses;
+
+    bool cache_lookup(const String &hname, String &value);
+    void cache_store(const String &hname, const String &value);
+    void cache_clear() {
+	_cache.clear();
+    }
+    void add_cache_handlers();
+    static String cache_read_handler(Element *, void *);
+    static int cache_write_handler(const String &, Element *, void *, ErrorHandler *);
+
 };
 
 CLICK_ENDDECLS
@@ -41,6 +41,9 @@ extern "C" {
 
 #include "fakepcap.hh"
 #include <clicknet/udp.h>
+#ifdef __linux__
+# include <linux/filter.h>
+#endif
 
 CLICK_DECLS
 
@@ -93,10 +96,23 @@ IPFlowRawSockets::Flow::initialize(ErrorHandler *errh, int snaplen, bool usepcap
     fcntl(_wd, F_SETFL, O_NONBLOCK);
     fcntl(_wd, F_SETFD, FD_CLOEXEC);
 
+    // build the BPF filter
+    StringAccum ss;
+    ss << "ip src host ";
+    ss << _flowid.daddr().unparse().c_str();
+    ss << " and ";
+    ss << (_ip_p == IP_PROTO_TCP ? "tcp" : "udp");
+    ss << " src port ";
+    ss << ntohs(_flowid.dport());
+    ss << " and ";
+    ss << (_ip_p == IP_PROTO_TCP ? "tcp" : "udp");
+    ss << " dst port ";
+    ss << ntohs(_flowid.sport());
+
     // don't use libpcap to capture
     if (!usepcap) {
 	_rd = _wd;
-	return 0;
+	return attach_socket_filter(ss.take_string(), snaplen, errh);
     }
 
     char ebuf[PCAP_ERRBUF_SIZE];
@@ -107,7 +123,7 @@ IPFlowRawSockets::Flow::initialize(ErrorHandler *errh, int snaplen, bool usepcap
     if (!_pcap) {
 	errh->warning("pcap_open_live: %s", ebuf);
 	_rd = _wd;
-	return 0;
+	return attach_socket_filter(ss.take_string(), snaplen, errh);
     }
 
     // nonblocking I/O on the packet socket so we can poll
@@ -122,19 +138,6 @@ IPFlowRawSockets::Flow::initialize(ErrorHandler *errh, int snaplen, bool usepcap
     }
 #endif
 
-    // build the BPF filter
-    StringAccum ss;
-    ss << "ip src host ";
-    ss << _flowid.daddr().unparse().c_str();
-    ss << " and ";
-    ss << (_ip_p == IP_PROTO_TCP ? "tcp" : "udp");
-    ss << " src port ";
-    ss << ntohs(_flowid.dport());
-    ss << " and ";
-    ss << (_ip_p == IP_PROTO_TCP ? "tcp" : "udp");
-    ss << " dst port ";
-    ss << ntohs(_flowid.sport());
-
     // compile the BPF filter
     struct bpf_program fcode;
     if (pcap_compile(_pcap, &fcode, (char *)ss.c_str(), 0, 0) < 0)
@@ -149,6 +152,30 @@ IPFlowRawSockets::Flow::initialize(ErrorHandler *errh, int snaplen, bool usepcap
     return 0;
 }
 
+// Attach the BPF filter to the raw socket itself, so that the kernel hands
+// it only this flow's packets, not every packet for the protocol.
+int
+IPFlowRawSockets::Flow::attach_socket_filter(const String &filter, int snaplen, ErrorHandler *errh)
+{
+#ifdef SO_ATTACH_FILTER
+    // raw IP sockets deliver packets starting with the IP header
+    struct bpf_program fcode;
+    if (pcap_compile_nopcap(snaplen, DLT_RAW, &fcode, (char *)filter.c_str(), 1, 0) < 0)
+	return errh->error("pcap_compile: cannot compile %s", filter.c_str());
+
+    struct sock_fprog fprog;
+    fprog.len = fcode.bf_len;
+    fprog.filter = reinterpret_cast<struct sock_filter *>(fcode.bf_insns);
+    int r = setsockopt(_rd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+    pcap_freecode(&fcode);
+    if (r < 0)
+	return errh->error("SO_ATTACH_FILTER: %s", strerror(errno));
+#else
+    (void) filter, (void) snaplen, (void) errh;
+#endif
+    return 0;
+}
+
 void
 IPFlowRawSockets::Flow::send_pkt(Packet *p, ErrorHandler *errh)
 {
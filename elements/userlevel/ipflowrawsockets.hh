@@ -85,6 +85,9 @@ truncated.
 
 Boolean. Whether to use libpcap for packet capture. Libpcap is
 unnecessary for capturing packets on PlanetLab Linux. Default is true.
+Without libpcap, each flow's raw socket receives packets directly. On Linux,
+IPFlowRawSockets then attaches a BPF filter to the socket, so that the kernel
+delivers only the flow's own packets to it.
 
 =item HEADROOM
 
@@ -183,6 +186,8 @@ class IPFlowRawSockets : public Element, public AggregateListener { public:
 	pcap_t *_pcap;
 	int _datalink;
 
+	int attach_socket_filter(const String &, int snaplen, ErrorHandler *);
+
     };
 
     enum { FLOWMAP_BITS = 10, NFLOWMAP = 1 << FLOWMAP_BITS };
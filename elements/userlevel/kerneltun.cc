@@ -25,7 +25,11 @@
 #include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/glue.hh>
+#include <click/master.hh>
+#include <click/packet_anno.hh>
 #include <clicknet/ether.h>
+#include <clicknet/ip6.h>
+#include <clicknet/udp.h>
 #include <click/standard/scheduleinfo.hh>
 #include <unistd.h>
 #include <fcntl.h>
@@ -67,10 +71,21 @@
 
 CLICK_DECLS
 
+// struct virtio_net_hdr, in host byte order
+struct click_vnet_hdr {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+};
+
 KernelTun::KernelTun()
-    : _fd(-1), _tap(false), _task(this), _ignore_q_errs(false),
+    : _fd(-1), _tap(false), _nqueues(1), _vnet_hdr(false),
+      _task(this), _ignore_q_errs(false),
       _printed_write_err(false), _printed_read_err(false),
-      _selected_calls(0), _packets(0)
+      _timestamp(true), _selected_calls(0), _packets(0)
 {
 }
 
@@ -108,6 +123,8 @@ KernelTun::configure(Vector<String> &conf, ErrorHandler *errh)
 #if KERNELTUN_LINUX
 	.read("DEV_NAME", Args::deprecated, _dev_name)
 	.read("DEVNAME", _dev_name)
+	.read("QUEUES", _nqueues)
+	.read("VNET_HDR", _vnet_hdr)
 #endif
 	.complete() < 0)
 	return -1;
@@ -116,6 +133,16 @@ KernelTun::configure(Vector<String> &conf, ErrorHandler *errh)
 	return errh->error("bad GATEWAY");
     if (_burst < 1)
 	return errh->error("BURST must be >= 1");
+    if (_nqueues < 1)
+	return errh->error("QUEUES must be >= 1");
+#ifndef IFF_MULTI_QUEUE
+    if (_nqueues > 1)
+	return errh->error("QUEUES not supported on this system");
+#endif
+#if !defined(IFF_VNET_HDR) || !defined(TUNSETOFFLOAD)
+    if (_vnet_hdr)
+	return errh->error("VNET_HDR not supported on this system");
+#endif
     if (_mtu_out < (int) sizeof(click_ip))
 	return errh->error("MTU must be greater than %d", sizeof(click_ip));
     if (_headroom > 8192)
@@ -135,15 +162,45 @@ KernelTun::try_linux_universal()
     struct ifreq ifr;
     memset(&ifr, 0, sizeof(ifr));
     ifr.ifr_flags = (_tap ? IFF_TAP : IFF_TUN);
+#ifdef IFF_MULTI_QUEUE
+    if (_nqueues > 1)
+	ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#endif
+#ifdef IFF_VNET_HDR
+    if (_vnet_hdr)
+	ifr.ifr_flags |= IFF_VNET_HDR;
+#endif
     if (_dev_name)
 	// Setting ifr_name allows us to select an arbitrary interface name.
 	strncpy(ifr.ifr_name, _dev_name.c_str(), sizeof(ifr.ifr_name));
     int err = ioctl(fd, TUNSETIFF, (void *)&ifr);
+#if defined(TUNSETOFFLOAD) && defined(TUN_F_TSO4)
+    // accept unchecksummed and unsegmented TCP packets
+    if (err >= 0 && _vnet_hdr)
+	err = ioctl(fd, TUNSETOFFLOAD, TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN);
+#endif
     if (err < 0) {
 	close(fd);
 	return -errno;
     }
 
+    // attach the other queues to the device just created
+    _fds.clear();
+    _fds.push_back(fd);
+    while (_fds.size() < _nqueues) {
+	int qfd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (qfd < 0 || ioctl(qfd, TUNSETIFF, (void *)&ifr) < 0) {
+	    err = -errno;
+	    if (qfd >= 0)
+		close(qfd);
+	    for (int qi = 0; qi < _fds.size(); ++qi)
+		close(_fds[qi]);
+	    _fds.clear();
+	    return err;
+	}
+	_fds.push_back(qfd);
+    }
+
     _dev_name = ifr.ifr_name;
     _fd = fd;
     _type = LINUX_UNIVERSAL;
@@ -183,6 +240,8 @@ KernelTun::alloc_tun(ErrorHandler *errh)
 #if KERNELTUN_LINUX
     if ((error = try_linux_universal()) >= 0)
 	return error;
+    else if (_nqueues > 1 || _vnet_hdr)
+	return errh->error("/dev/net/tun: %s\n(QUEUES and VNET_HDR require the Linux Universal TUN/TAP driver.)", strerror(-error));
     else if (!saved_error || error != -ENOENT) {
 	saved_error = error, saved_device = "net/tun";
 	if (error == -ENODEV)
@@ -455,6 +514,11 @@ KernelTun::setup_tun(ErrorHandler *errh)
     else /* _type == LINUX_ETHERTAP */
 	_mtu_in = _mtu_out + 16;
 
+    // the virtio-net header follows the packet information; with
+    // segmentation offload, packets can be as large as IP allows
+    if (_vnet_hdr)
+	_mtu_in = 65535 + (_tap ? 18 : 4) + sizeof(click_vnet_hdr);
+
     return 0;
 }
 
@@ -463,6 +527,8 @@ KernelTun::initialize(ErrorHandler *errh)
 {
     if (alloc_tun(errh) < 0)
 	return -1;
+    if (_fds.empty())
+	_fds.push_back(_fd);
     if (setup_tun(errh) < 0)
 	return -1;
     if (input_is_pull(0)) {
@@ -470,12 +536,21 @@ KernelTun::initialize(ErrorHandler *errh)
 	_signal = Notifier::upstream_empty_signal(this, 0, &_task);
     }
     if (_adjust_headroom) {
-	if (_tap && _type == LINUX_UNIVERSAL)
+	// a virtio-net header, 10 bytes, changes the alignment
+	if ((_tap && _type == LINUX_UNIVERSAL) != _vnet_hdr)
 	    _headroom += (4 - (_headroom + 2) % 4) % 4; // default 4/2 alignment
 	else
 	    _headroom += (4 - _headroom % 4) % 4; // default 4/0 alignment
     }
-    add_select(_fd, SELECT_READ);
+    _timestamp = router()->timestamp_required(this);
+
+    // read queue I on thread (home + I) % nthreads
+    int home = router()->home_thread_id(this);
+    int nthreads = master()->nthreads();
+    for (int qi = 0; qi < _fds.size(); ++qi) {
+	_fd_threads.push_back(home < 0 ? home : (home + qi) % nthreads);
+	master()->thread(_fd_threads[qi])->select_set().add_select(_fds[qi], this, SELECT_READ);
+    }
     return 0;
 }
 
@@ -485,25 +560,75 @@ KernelTun::cleanup(CleanupStage)
     if (_fd >= 0) {
 	if (_type != LINUX_UNIVERSAL && _type != NETBSD_TAP)
 	    updown(0, ~0, ErrorHandler::default_handler());
-	close(_fd);
-	remove_select(_fd, SELECT_READ);
+	for (int qi = 0; qi < _fds.size(); ++qi) {
+	    if (qi < _fd_threads.size())
+		master()->thread(_fd_threads[qi])->select_set().remove_select(_fds[qi], this, SELECT_READ);
+	    close(_fds[qi]);
+	}
     }
 }
 
 void
 KernelTun::selected(int fd, int)
 {
-    Timestamp now = Timestamp::now();
-    if (fd != _fd)
-	return;
+    Timestamp now = _timestamp ? Timestamp::now() : Timestamp();
     ++_selected_calls;
     unsigned n = _burst;
-    while (n > 0 && one_selected(now))
+    while (n > 0 && one_selected(fd, now))
 	--n;
 }
 
+void
+KernelTun::pull_vnet_hdr(WritablePacket *p)
+{
+    click_vnet_hdr h;
+    if (p->length() < sizeof(h))
+	return;
+    memcpy(&h, p->data(), sizeof(h));
+    p->pull(sizeof(h));
+    SET_GSO_SIZE_ANNO(p, h.gso_type != GSO_TYPE_NONE ? h.gso_size : 0);
+    SET_GSO_TYPE_ANNO(p, h.gso_type);
+    SET_CSUM_FLAGS_ANNO(p, h.flags);
+}
+
+// Build the virtio-net header for p, whose IP header starts at offset l3,
+// from its GSO_SIZE, GSO_TYPE and CSUM_FLAGS annotations.
+void
+KernelTun::fill_vnet_hdr(const Packet *p, int l3, unsigned char *hp) const
+{
+    click_vnet_hdr h;
+    memset(&h, 0, sizeof(h));
+    uint8_t flags = CSUM_FLAGS_ANNO(p), gso_type = GSO_TYPE_ANNO(p);
+
+    if ((flags & CSUM_FLAG_NEEDED) || gso_type != GSO_TYPE_NONE) {
+	const unsigned char *data = p->data() + l3;
+	int len = p->length() - l3, hlen = -1, proto = 0;
+	if (len >= (int) sizeof(click_ip) && (data[0] >> 4) == 4) {
+	    hlen = (data[0] & 0xF) << 2;
+	    proto = reinterpret_cast<const click_ip *>(data)->ip_p;
+	} else if (len >= (int) sizeof(click_ip6) && (data[0] >> 4) == 6) {
+	    hlen = sizeof(click_ip6);
+	    proto = reinterpret_cast<const click_ip6 *>(data)->ip6_nxt;
+	}
+	int csum_offset = (proto == IP_PROTO_TCP ? 16 : proto == IP_PROTO_UDP ? 6 : -1);
+	if (hlen >= 0 && csum_offset >= 0 && hlen + csum_offset + 2 <= len) {
+	    h.flags = flags & CSUM_FLAG_NEEDED;
+	    h.csum_start = l3 + hlen;
+	    h.csum_offset = csum_offset;
+	    if (gso_type != GSO_TYPE_NONE && GSO_SIZE_ANNO(p)) {
+		h.gso_type = gso_type;
+		h.gso_size = GSO_SIZE_ANNO(p);
+		h.hdr_len = h.csum_start
+		    + (proto == IP_PROTO_TCP ? (data[hlen + 12] >> 4) << 2 : sizeof(click_udp));
+	    }
+	}
+    }
+
+    memcpy(hp, &h, sizeof(h));
+}
+
 bool
-KernelTun::one_selected(const Timestamp &now)
+KernelTun::one_selected(int fd, const Timestamp &now)
 {
     WritablePacket *p = Packet::make(_headroom, 0, _mtu_in, 0);
     if (!p) {
@@ -511,17 +636,19 @@ KernelTun::one_selected(const Timestamp &now)
 	return false;
     }
 
-    int cc = read(_fd, p->data(), _mtu_in);
+    int cc = read(fd, p->data(), _mtu_in);
     if (cc > 0) {
 	++_packets;
 	p->take(_mtu_in - cc);
 	bool ok = false;
 
 	if (_tap) {
-	    if (_type == LINUX_UNIVERSAL)
+	    if (_type == LINUX_UNIVERSAL) {
 		// 2-byte padding, 2-byte Ethernet type, then Ethernet header
 		p->pull(4);
-	    else if (_type == LINUX_ETHERTAP)
+		if (_vnet_hdr)
+		    pull_vnet_hdr(p);
+	    } else if (_type == LINUX_ETHERTAP)
 		// 2-byte padding, then Ethernet header
 		p->pull(2);
 	    ok = true;
@@ -529,6 +656,8 @@ KernelTun::one_selected(const Timestamp &now)
 	    // 2-byte padding followed by an Ethernet type
 	    uint16_t etype = *(uint16_t *)(p->data() + 2);
 	    p->pull(4);
+	    if (_vnet_hdr)
+		pull_vnet_hdr(p);
 	    if (etype != htons(ETHERTYPE_IP) && etype != htons(ETHERTYPE_IP6))
 		checked_output_push(1, p->clone());
 	    else
@@ -616,19 +745,29 @@ KernelTun::push(int, Packet *p)
 	check_length = p->length();
     }
 
-    // check MTU
-    if (check_length > _mtu_out) {
+    // check MTU; the kernel segments GSO packets
+    if (check_length > _mtu_out && !(_vnet_hdr && GSO_TYPE_ANNO(p))) {
 	click_chatter("%s(%s): packet larger than MTU (%d)", class_name(), _dev_name.c_str(), _mtu_out);
 	goto kill;
     }
 
     WritablePacket *q;
+    unsigned char vnet_hdr[sizeof(click_vnet_hdr)];
+    int vnet_len = 0;
+    if (_vnet_hdr) {
+	fill_vnet_hdr(p, _tap ? sizeof(click_ether) : 0, vnet_hdr);
+	vnet_len = sizeof(vnet_hdr);
+    }
+
     if (_tap) {
 	if (_type == LINUX_UNIVERSAL) {
-	    // 2-byte padding, 2-byte Ethernet type, then Ethernet header
+	    // 2-byte padding, 2-byte Ethernet type, virtio-net header if
+	    // any, then Ethernet header
 	    uint16_t ethertype = ((const click_ether *) p->data())->ether_type;
-	    if ((q = p->push(4)))
+	    if ((q = p->push(4 + vnet_len))) {
 		((uint16_t *) q->data())[1] = ethertype;
+		memcpy(q->data() + 4, vnet_hdr, vnet_len);
+	    }
 	    p = q;
 	} else if (_type == LINUX_ETHERTAP) {
 	    // 2-byte padding, then Ethernet header
@@ -637,10 +776,13 @@ KernelTun::push(int, Packet *p)
 	    /* existing packet is OK */;
 	}
     } else if (_type == LINUX_UNIVERSAL) {
-	// 2-byte padding followed by an Ethernet type
+	// 2-byte padding followed by an Ethernet type, then the virtio-net
+	// header if any
 	uint32_t ethertype = (iph->ip_v == 4 ? htonl(ETHERTYPE_IP) : htonl(ETHERTYPE_IP6));
-	if ((q = p->push(4)))
+	if ((q = p->push(4 + vnet_len))) {
 	    *(uint32_t *)(q->data()) = ethertype;
+	    memcpy(q->data() + 4, vnet_hdr, vnet_len);
+	}
 	p = q;
     } else if (_type == BSD_TUN) {
 	uint32_t af = (iph->ip_v == 4 ? htonl(AF_INET) : htonl(AF_INET6));
@@ -663,7 +805,16 @@ KernelTun::push(int, Packet *p)
     }
 
     if (p) {
-	int w = write(_fd, p->data(), p->length());
+	// write to the current thread's queue
+	int fd = _fd;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+	for (int qi = 1; qi < _fds.size(); ++qi)
+	    if (_fd_threads[qi] == click_current_thread_id) {
+		fd = _fds[qi];
+		break;
+	    }
+#endif
+	int w = write(fd, p->data(), p->length());
 	if (w != (int) p->length() && (errno != ENOBUFS || !_ignore_q_errs || !_printed_write_err)) {
 	    _printed_write_err = true;
 	    click_chatter("%s(%s): write failed: %s", class_name(), _dev_name.c_str(), strerror(errno));
@@ -5,12 +5,13 @@
 #include <click/etheraddress.hh>
 #include <click/task.hh>
 #include <click/notifier.hh>
+#include <click/vector.hh>
 CLICK_DECLS
 
 /*
 =c
 
-KernelTun(ADDR/MASK [, GATEWAY, I<keywords> HEADROOM, ETHER, MTU, IGNORE_QUEUE_OVERFLOWS])
+KernelTun(ADDR/MASK [, GATEWAY, I<keywords> HEADROOM, ETHER, MTU, IGNORE_QUEUE_OVERFLOWS, QUEUES, VNET_HDR])
 
 =s comm
 
@@ -73,6 +74,31 @@ String. If specified, try to alloc a tun device with name DEVNAME.
 Otherwise, we'll just take the first virtual device we find. This option
 only works with the Linux Universal TUN/TAP driver.
 
+=item QUEUES
+
+Integer. The number of queues to open on a multi-queue device
+(IFF_MULTI_QUEUE), each with its own file descriptor. The kernel spreads
+flows across the queues. Queue I is read on thread (H + I) mod T, where
+H is KernelTun's home thread and T the number of threads, so with
+QUEUES set to T every thread reads its own queue. Pushed or pulled
+packets are written to the queue that belongs to the current thread.
+Only works with the Linux Universal TUN/TAP driver. Default is 1.
+
+=item VNET_HDR
+
+Boolean. If true, exchange a virtio-net header with the kernel
+(IFF_VNET_HDR) and enable checksum and TCP segmentation offload on the
+device. The kernel may then pass up TCP packets of up to 64KB that it
+has not segmented, and packets whose transport checksums are not yet
+complete. KernelTun records the header in the GSO_SIZE, GSO_TYPE and
+CSUM_FLAGS annotations of each packet it emits, and builds the header
+from those annotations for each packet it writes, so such packets can
+cross the device unsegmented in both directions; packets larger than
+MTU are accepted if their GSO_TYPE annotation is nonzero. These
+annotations share space with EXTRA_PACKETS. KernelTun reads into 64KB
+buffers. Only works with the Linux Universal TUN/TAP driver. Default is
+false.
+
 =back
 
 =n
@@ -100,6 +126,12 @@ and C<ping> should print Click's responses.
 This element differs from KernelTap in that it produces and expects IP
 packets, not IP-in-Ethernet packets.
 
+With VNET_HDR, a packet whose CSUM_FLAGS annotation has bit 0 set carries
+only a pseudo-header sum in its transport checksum field.  Writing it back
+to a VNET_HDR KernelTun, or to the kernel through a device that offloads
+checksums, completes it; other consumers must compute the checksum first,
+for example with SetTCPChecksum.
+
 =a
 
 FromDevice.u, ToDevice.u, KernelTap, ifconfig(8) */
@@ -134,6 +166,8 @@ class KernelTun : public Element { public:
 		NETBSD_TUN, NETBSD_TAP };
 
     int _fd;
+    Vector<int> _fds;		// one per queue; _fds[0] == _fd
+    Vector<int> _fd_threads;	// thread that reads each queue
     int _mtu_in;
     int _mtu_out;
     Type _type;
@@ -145,6 +179,8 @@ class KernelTun : public Element { public:
     EtherAddress _macaddr;
     unsigned _headroom;
     unsigned _burst;
+    int _nqueues;
+    bool _vnet_hdr;
     Task _task;
     NotifierSignal _signal;
 
@@ -152,6 +188,7 @@ class KernelTun : public Element { public:
     bool _printed_write_err;
     bool _printed_read_err;
     bool _adjust_headroom;
+    bool _timestamp;
 
     click_uint_large_t _selected_calls;
     click_uint_large_t _packets;
@@ -163,7 +200,9 @@ class KernelTun : public Element { public:
     int alloc_tun(ErrorHandler *);
     int setup_tun(ErrorHandler *);
     int updown(IPAddress, IPAddress, ErrorHandler *);
-    bool one_selected(const Timestamp &now);
+    bool one_selected(int fd, const Timestamp &now);
+    void pull_vnet_hdr(WritablePacket *p);
+    void fill_vnet_hdr(const Packet *p, int l3, unsigned char *h) const;
 
     friend class KernelTap;
 
@@ -53,13 +53,17 @@ int
 KernelHandlerProxy::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _verbose = false;
-    return Args(conf, this, errh).read("VERBOSE", _verbose).complete();
+    return Args(conf, this, errh)
+	.read("VERBOSE", _verbose)
+	.read("CACHE", _cache_staleness)
+	.complete();
 }
 
 void
 KernelHandlerProxy::add_handlers()
 {
   add_write_handler("*", star_write_handler, 0);
+  add_cache_handlers();
 }
 
 
@@ -191,6 +195,8 @@ KernelHandlerProxy::handler_hook(int op, String& str, Element* e, const Handler*
     String fn = khp->handler_name_to_file_name(hname);
 
     if (op == Handler::OP_READ) {
+	if (khp->cache_lookup(hname, str))
+	    return 0;
 	errno = 0;
 	str = file_string(fn, 0);
 	int err = errno;
@@ -199,10 +205,13 @@ KernelHandlerProxy::handler_hook(int op, String& str, Element* e, const Handler*
 		khp->complain_about_open(ErrorHandler::default_handler(), hname, err);
 	    // complain to error receivers
 	    khp->complain_about_open(0, hname, err);
-	}
+	} else
+	    khp->cache_store(hname, str);
 	return -err;
 
     } else if (op == Handler::OP_WRITE) {
+	// a write can change any handler's value
+	khp->cache_clear();
 	int fd = open(fn.c_str(), O_WRONLY | O_TRUNC);
 	if (fd < 0)
 	    return khp->complain_about_open(errh, hname, errno);
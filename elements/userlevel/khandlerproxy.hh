@@ -31,8 +31,30 @@ Boolean. If true, print chatter messages when read handlers fail. (Errors with
 write handlers are reported to the supplied ErrorHandler, but read handlers
 don't take an ErrorHandler argument.) Default is false.
 
+=item CACHE
+
+Time. If nonzero, KernelHandlerProxy remembers each successful read and
+answers later reads of the same handler from memory, without entering the
+kernel, until the value is older than CACHE. Many controllers polling the same
+handlers, with ControlSocket's READMANY or SUBSCRIBE commands, then cost one
+kernel read per handler per CACHE interval. Any write through the proxy
+empties the cache, but changes made in the kernel by other means can go
+unnoticed for up to CACHE. Default is 0 (no caching).
+
 =back
 
+=h cache_hits read-only
+
+Returns the number of reads answered from the cache.
+
+=h cache_misses read-only
+
+Returns the number of reads that entered the kernel while CACHE was set.
+
+=h flush_cache write-only
+
+Empties the cache.
+
 =n
 
 KernelHandlerProxy does not decide ahead of time whether a given handler is
@@ -0,0 +1,256 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * netmapport.{cc,hh} -- netmap ports shared by the netmap device elements
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "netmapport.hh"
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/* A netmap memory region mapped into Click, with its spare buffers.  The
+   region's first port is its parent: its nm_desc owns the mapping and the
+   spare buffers, which go back to the kernel on its nm_desc's ni_bufs_head
+   list when the region is closed.  Buffers move freely between the rings
+   of ports in the region, the spare list, and packets; since the kernel
+   frees every buffer found in a ring or on that list, the total is
+   conserved.
+
+   The region lives until every port using it is closed and every packet
+   referring to one of its buffers is killed.  Packet destructors may run on
+   any thread and find their region by address, so the list of regions is
+   locked. */
+struct NetmapPort::Mem {
+    struct nm_desc *parent;
+    unsigned char *base;
+    size_t size;
+    unsigned char *buf_base;	// address of buffer 0
+    uint32_t buf_size;
+    Vector<uint32_t> spare;
+    unsigned char *sending;	// buffer was swapped into a transmit ring
+    Spinlock lock;
+    atomic_uint32_t live;	// ports plus packets
+    Mem *next;
+
+    bool contains(const unsigned char *x) const {
+	return x >= buf_base && x < base + size;
+    }
+    uint32_t index(const unsigned char *x) const {
+	return (x - buf_base) / buf_size;
+    }
+    unsigned char *buffer(uint32_t idx) const {
+	return buf_base + (size_t) idx * buf_size;
+    }
+    void put(uint32_t idx) {
+	lock.acquire();
+	spare.push_back(idx);
+	lock.release();
+    }
+    inline void release();
+};
+
+NetmapPort::Mem *NetmapPort::mems;
+Spinlock NetmapPort::mems_lock;
+
+inline void
+NetmapPort::Mem::release()
+{
+    if (!live.dec_and_test())
+	return;
+    mems_lock.acquire();
+    Mem **pprev = &mems;
+    while (*pprev != this)
+	pprev = &(*pprev)->next;
+    *pprev = next;
+    mems_lock.release();
+
+    // return the spare buffers to the kernel
+    uint32_t head = 0;
+    for (int i = spare.size() - 1; i >= 0; --i) {
+	*reinterpret_cast<uint32_t *>(buffer(spare[i])) = head;
+	head = spare[i];
+    }
+    parent->nifp->ni_bufs_head = head;
+    nm_close(parent);
+    delete[] sending;
+    delete this;
+}
+
+NetmapPort *
+NetmapPort::open(Router *router, const String &ifname, int queue, bool host,
+		 int nspare, ErrorHandler *errh)
+{
+    StringAccum sa;
+    sa << "netmap:" << ifname;
+    if (host)
+	sa << '^';
+    else if (queue >= 0)
+	sa << '-' << queue;
+    String name = sa.take_string();
+
+    void *&attachment = router->force_attachment("NetmapPort_" + name);
+    if (NetmapPort *port = reinterpret_cast<NetmapPort *>(attachment)) {
+	++port->_refs;
+	return port;
+    }
+
+    // Join an existing region if the port's rings live there.
+    mems_lock.acquire();
+    struct nm_desc *d = 0;
+    Mem *m;
+    for (m = mems; m; m = m->next) {
+	d = nm_open(name.c_str(), 0, NM_OPEN_NO_MMAP, m->parent);
+	if (!d || d->mem == m->base)
+	    break;
+	nm_close(d);
+	d = 0;
+    }
+    if (m && d)
+	++m->live;
+    mems_lock.release();
+
+    if (!m) {
+	struct nmreq req;
+	memset(&req, 0, sizeof(req));
+	req.nr_arg3 = nspare;
+	d = nm_open(name.c_str(), &req, 0, 0);
+    }
+    if (!d) {
+	errh->error("%s: %s", name.c_str(), strerror(errno));
+	return 0;
+    }
+
+    if (!m) {
+	struct netmap_ring *ring = NETMAP_TXRING(d->nifp, d->first_tx_ring);
+	m = new Mem;
+	m->parent = d;
+	m->base = reinterpret_cast<unsigned char *>(d->mem);
+	m->size = d->memsize;
+	m->buf_base = reinterpret_cast<unsigned char *>(NETMAP_BUF(ring, 0));
+	m->buf_size = ring->nr_buf_size;
+	uint32_t nbufs = (m->base + m->size - m->buf_base) / m->buf_size;
+	m->sending = new unsigned char[nbufs];
+	memset(m->sending, 0, nbufs);
+	uint32_t idx = d->nifp->ni_bufs_head;
+	for (uint32_t i = 0; i < d->req.nr_arg3 && idx; ++i) {
+	    m->spare.push_back(idx);
+	    idx = *reinterpret_cast<uint32_t *>(m->buffer(idx));
+	}
+	d->nifp->ni_bufs_head = 0;
+	if (m->spare.size() < nspare)
+	    errh->warning("%s: only %d spare buffers, packets will be copied", name.c_str(), m->spare.size());
+	m->live = 1;
+	mems_lock.acquire();
+	m->next = mems;
+	mems = m;
+	mems_lock.release();
+    }
+
+    NetmapPort *port = new NetmapPort;
+    port->_desc = d;
+    port->_mem = m;
+    port->_name = name;
+    port->_refs = 1;
+    attachment = port;
+    return port;
+}
+
+void
+NetmapPort::close(Router *router)
+{
+    if (--_refs > 0)
+	return;
+    router->set_attachment("NetmapPort_" + _name, 0);
+    // The parent's nm_desc stays open until its region is closed.
+    if (_desc != _mem->parent)
+	nm_close(_desc);
+    _mem->release();
+    delete this;
+}
+
+void
+NetmapPort::buffer_destructor(unsigned char *buf, size_t)
+{
+    mems_lock.acquire();
+    Mem *m = mems;
+    while (!m->contains(buf))
+	m = m->next;
+    mems_lock.release();
+    uint32_t idx = m->index(buf);
+    // A buffer swapped into a transmit ring now belongs to the ring.
+    if (m->sending[idx])
+	m->sending[idx] = 0;
+    else
+	m->put(idx);
+    m->release();
+}
+
+Packet *
+NetmapPort::make_packet(struct netmap_ring *ring, struct netmap_slot *slot,
+			unsigned headroom)
+{
+    Mem *m = _mem;
+    unsigned char *buf = reinterpret_cast<unsigned char *>(NETMAP_BUF(ring, slot->buf_idx));
+    uint32_t spare = 0;		// netmap never hands out buffer 0
+    m->lock.acquire();
+    if (m->spare.size()) {
+	spare = m->spare.back();
+	m->spare.pop_back();
+    }
+    m->lock.release();
+
+    if (!spare)
+	return Packet::make(headroom, buf, slot->len, 0);
+    WritablePacket *p = Packet::make(buf, m->buf_size, buffer_destructor);
+    if (!p) {
+	m->put(spare);
+	return 0;
+    }
+    ++m->live;
+    p->take(m->buf_size - slot->len);
+    slot->buf_idx = spare;
+    slot->flags |= NS_BUF_CHANGED;
+    return p;
+}
+
+bool
+NetmapPort::send_packet(struct netmap_ring *ring, struct netmap_slot *slot,
+			Packet *p, bool &zerocopy)
+{
+    Mem *m = _mem;
+    if (p->length() > m->buf_size)
+	return false;
+    // Netmap slots have no data offset, so only packets whose data starts
+    // their buffer can be sent in place.
+    if (m->contains(p->buffer()) && p->data() == p->buffer() && !p->shared()) {
+	uint32_t idx = m->index(p->buffer());
+	m->put(slot->buf_idx);
+	m->sending[idx] = 1;
+	slot->buf_idx = idx;
+	slot->flags |= NS_BUF_CHANGED;
+	zerocopy = true;
+    } else {
+	memcpy(NETMAP_BUF(ring, slot->buf_idx), p->data(), p->length());
+	zerocopy = false;
+    }
+    slot->len = p->length();
+    p->kill();
+    return true;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel netmap)
+ELEMENT_PROVIDES(NetmapPort)
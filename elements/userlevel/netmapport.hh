@@ -0,0 +1,69 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_NETMAPPORT_HH
+#define CLICK_NETMAPPORT_HH
+#include <click/string.hh>
+#include <click/sync.hh>
+#include <click/atomic.hh>
+#include <click/packet.hh>
+#ifndef NETMAP_WITH_LIBS
+# define NETMAP_WITH_LIBS 1
+#endif
+#include <net/netmap_user.h>
+CLICK_DECLS
+class Router;
+class ErrorHandler;
+
+/** @class NetmapPort
+ * @brief A netmap port shared by FromNetmapDevice and ToNetmapDevice.
+ *
+ * A NetmapPort is one nm_desc: the hardware rings of a device, one ring
+ * pair, or the device's host-stack rings.  The From and To elements for the
+ * same port share it through a router attachment.
+ *
+ * Ports whose rings live in the same netmap memory region share one mapping
+ * and one pool of spare buffers.  Received packets take their slot's buffer,
+ * and a spare buffer takes its place in the ring; transmitted packets whose
+ * buffer lives in the port's region trade places with the transmit slot's
+ * buffer.  Either way no data is copied.  When no spare buffer is available,
+ * or a packet's data does not start at the beginning of its netmap buffer,
+ * the packet is copied instead. */
+class NetmapPort { public:
+
+    enum { default_spare = 4096 };
+
+    static NetmapPort *open(Router *router, const String &ifname, int queue,
+			    bool host, int nspare, ErrorHandler *errh);
+    void close(Router *router);
+
+    int fd() const			{ return _desc->fd; }
+    struct nm_desc *desc() const	{ return _desc; }
+
+    /** Return a packet for the buffer in @a slot of @a ring.  The slot is
+	given a spare buffer if possible. */
+    Packet *make_packet(struct netmap_ring *ring, struct netmap_slot *slot,
+			unsigned headroom);
+    /** Put @a p in @a slot of @a ring and kill it.  Returns false if @a p
+	is too long, leaving @a p alone.  Sets @a zerocopy to true if the
+	packet's buffer was placed in the ring. */
+    bool send_packet(struct netmap_ring *ring, struct netmap_slot *slot,
+		     Packet *p, bool &zerocopy);
+
+  private:
+
+    struct Mem;
+    static Mem *mems;
+    static Spinlock mems_lock;
+
+    struct nm_desc *_desc;
+    Mem *_mem;
+    String _name;
+    int _refs;
+
+    NetmapPort()			{ }
+    ~NetmapPort()			{ }
+    static void buffer_destructor(unsigned char *buf, size_t length);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,99 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * perfcountaccum.{cc,hh} -- accumulate performance counter deltas
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "perfcountaccum.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+PerfCountAccum::PerfCountAccum()
+    : _accum(0), _count(0)
+{
+}
+
+PerfCountAccum::~PerfCountAccum()
+{
+}
+
+void *
+PerfCountAccum::cast(const char *n)
+{
+    if (strcmp(n, "PerfCountUser") == 0)
+	return static_cast<PerfCountUser *>(this);
+    else if (strcmp(n, "PerfCountAccum") == 0)
+	return static_cast<Element *>(this);
+    else
+	return 0;
+}
+
+int
+PerfCountAccum::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String metric_name;
+    if (Args(conf, this, errh)
+	.read_mp("METRIC", WordArg(), metric_name)
+	.complete() < 0)
+	return -1;
+    _which = PerfCountUser::prepare(metric_name, errh);
+    return (_which < 0 ? -1 : 0);
+}
+
+Packet *
+PerfCountAccum::simple_action(Packet *p)
+{
+    _accum += read_counter(_which) - PERFCTR_ANNO(p);
+    _count++;
+    return p;
+}
+
+String
+PerfCountAccum::read_handler(Element *e, void *thunk)
+{
+    PerfCountAccum *pca = static_cast<PerfCountAccum *>(e);
+    switch (reinterpret_cast<uintptr_t>(thunk)) {
+    case h_count:
+	return String(pca->_count);
+    case h_accum:
+	return String(pca->_accum);
+    case h_average:
+	return String(pca->_count ? pca->_accum / pca->_count : 0);
+    default:
+	return String();
+    }
+}
+
+int
+PerfCountAccum::reset_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    PerfCountAccum *pca = static_cast<PerfCountAccum *>(e);
+    pca->_count = 0;
+    pca->_accum = 0;
+    return 0;
+}
+
+void
+PerfCountAccum::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("accum", read_handler, h_accum);
+    add_read_handler("average", read_handler, h_average);
+    add_write_handler("reset_counts", reset_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel linux int64 PerfCountUser)
+EXPORT_ELEMENT(PerfCountAccum)
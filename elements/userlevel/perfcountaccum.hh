@@ -0,0 +1,73 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PERFCOUNTACCUM_USERLEVEL_HH
+#define CLICK_PERFCOUNTACCUM_USERLEVEL_HH
+#include "elements/userlevel/perfcountuser.hh"
+CLICK_DECLS
+
+/*
+=c
+
+PerfCountAccum(METRIC)
+
+=s counters
+
+collects differences in performance counter values
+
+=d
+
+Expects incoming packets to have their performance counter annotation set
+by SetPerfCount with the same METRIC.  Reads the current thread's count for
+METRIC, and keeps track of the total accumulated difference.  See
+SetPerfCount for valid metric names.
+
+=n
+
+A packet has room for either exactly one cycle count or exactly one
+performance metric.
+
+=h count read-only
+
+Returns the number of packets that have passed.
+
+=h accum read-only
+
+Returns the accumulated changes in METRIC for all passing packets.
+
+=h average read-only
+
+Returns the average change in METRIC per packet.
+
+=h reset_counts write-only
+
+Resets C<count> and C<accum> counters to zero when written.
+
+=a SetPerfCount, PerfCountInfo, SetCycleCount, CycleCountAccum */
+
+class PerfCountAccum : public PerfCountUser { public:
+
+    PerfCountAccum();
+    ~PerfCountAccum();
+
+    const char *class_name() const	{ return "PerfCountAccum"; }
+    void *cast(const char *);
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void add_handlers();
+
+    Packet *simple_action(Packet *);
+
+  private:
+
+    int _which;
+    uint64_t _accum;
+    uint64_t _count;
+
+    enum { h_count, h_accum, h_average };
+    static String read_handler(Element *, void *);
+    static int reset_handler(const String &, Element *, void *, ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
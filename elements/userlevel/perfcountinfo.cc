@@ -0,0 +1,153 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * perfcountinfo.{cc,hh} -- per-thread and per-element performance counters
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "perfcountinfo.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/master.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+int PerfCountInfo::the_profile_metric = -1;
+
+PerfCountInfo::PerfCountInfo()
+    : _profile_metric(-1)
+{
+}
+
+PerfCountInfo::~PerfCountInfo()
+{
+}
+
+void *
+PerfCountInfo::cast(const char *n)
+{
+    if (strcmp(n, "PerfCountUser") == 0)
+	return static_cast<PerfCountUser *>(this);
+    else if (strcmp(n, "PerfCountInfo") == 0)
+	return static_cast<Element *>(this);
+    else
+	return 0;
+}
+
+int
+PerfCountInfo::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String metrics, profile;
+    if (Args(conf, this, errh)
+	.read_p("METRICS", AnyArg(), metrics)
+	.read("PROFILE", WordArg(), profile)
+	.complete() < 0)
+	return -1;
+
+    _metrics.clear();
+    Vector<String> words;
+    cp_spacevec(metrics, words);
+    for (String *it = words.begin(); it != words.end(); ++it) {
+	int metric = prepare(*it, errh);
+	if (metric < 0)
+	    return -1;
+	_metrics.push_back(metric);
+    }
+
+    _profile_metric = -1;
+    if (profile) {
+	if ((_profile_metric = prepare(profile, errh)) < 0)
+	    return -1;
+	if (the_profile_metric >= 0)
+	    return errh->error("another PerfCountInfo sets PROFILE");
+    }
+    return 0;
+}
+
+uint64_t
+PerfCountInfo::read_profile_counter()
+{
+    return read_counter(the_profile_metric);
+}
+
+int
+PerfCountInfo::initialize(ErrorHandler *)
+{
+    int nthreads = master()->nthreads();
+    _fds.assign(nthreads * _metrics.size(), -1);
+    _base.assign(nthreads * _metrics.size(), 0);
+
+    // Each thread must open its own counters, so run a task once on each.
+    if (_metrics.size() || _profile_metric >= 0)
+	for (int t = 0; t < nthreads; ++t) {
+	    Task *task = new Task(this);
+	    task->initialize(this, false);
+	    task->move_thread(t);
+	    task->reschedule();
+	    _tasks.push_back(task);
+	}
+
+    if (_profile_metric >= 0) {
+	the_profile_metric = _profile_metric;
+	Element::set_profile_counter(read_profile_counter,
+				     metric_name(_profile_metric));
+    }
+    return 0;
+}
+
+void
+PerfCountInfo::cleanup(CleanupStage)
+{
+    if (_profile_metric >= 0 && the_profile_metric == _profile_metric) {
+	Element::set_profile_counter(0, 0);
+	the_profile_metric = -1;
+    }
+    for (Task **it = _tasks.begin(); it != _tasks.end(); ++it)
+	delete *it;
+    _tasks.clear();
+}
+
+bool
+PerfCountInfo::run_task(Task *task)
+{
+    int t = task->home_thread_id(), n = _metrics.size();
+    for (int i = 0; i < n; ++i) {
+	_fds[t * n + i] = counter_fd(_metrics[i]);
+	_base[t * n + i] = read_counter(_metrics[i]);
+    }
+    if (_profile_metric >= 0)
+	(void) read_counter(_profile_metric);
+    return true;
+}
+
+String
+PerfCountInfo::read_counts(Element *e, void *)
+{
+    PerfCountInfo *pci = static_cast<PerfCountInfo *>(e);
+    StringAccum sa;
+    int n = pci->_metrics.size();
+    for (int i = 0; i < pci->_fds.size(); ++i)
+	if (pci->_fds[i] >= 0)
+	    sa << (i / n) << ' ' << metric_name(pci->_metrics[i % n]) << ' '
+	       << (read_fd(pci->_fds[i]) - pci->_base[i]) << '\n';
+    return sa.take_string();
+}
+
+void
+PerfCountInfo::add_handlers()
+{
+    add_read_handler("counts", read_counts, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel linux int64 PerfCountUser)
+EXPORT_ELEMENT(PerfCountInfo)
@@ -0,0 +1,85 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PERFCOUNTINFO_USERLEVEL_HH
+#define CLICK_PERFCOUNTINFO_USERLEVEL_HH
+#include "elements/userlevel/perfcountuser.hh"
+#include <click/task.hh>
+CLICK_DECLS
+
+/*
+=c
+
+PerfCountInfo([METRICS, I<keywords> PROFILE])
+
+=s counters
+
+counts performance metrics per thread and per element
+
+=d
+
+Opens a performance counter for each metric in the space-separated METRICS
+list on every RouterThread, and reports each thread's counts through the
+C<counts> handler.  See SetPerfCount for valid metric names.
+
+Keyword arguments are:
+
+=over 8
+
+=item METRICS
+
+Space-separated list of metric names.  Same as the METRICS argument.
+
+=item PROFILE
+
+Metric name.  If set, the router's run-time profile (see C<click
+--profile> and the global C<profile> handler) also samples this metric
+around every push, pull and task call, and attributes the differences to
+elements in an extra column and in each element's C<events> handler.  For
+example, C<PROFILE LLC_LOAD_MISSES> shows which lookup table elements miss
+in the last-level cache.  At most one PerfCountInfo may set PROFILE.
+
+=back
+
+=h counts read-only
+
+Returns one line per thread and metric, "THREAD METRIC COUNT", where COUNT
+is the number of events the thread has counted since the router started.
+
+=e
+
+  PerfCountInfo(INSTRUCTIONS CYCLES, PROFILE LLC_LOAD_MISSES);
+
+=a SetPerfCount, PerfCountAccum */
+
+class PerfCountInfo : public PerfCountUser { public:
+
+    PerfCountInfo();
+    ~PerfCountInfo();
+
+    const char *class_name() const	{ return "PerfCountInfo"; }
+    void *cast(const char *);
+    int configure_phase() const		{ return CONFIGURE_PHASE_INFO; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    Vector<int> _metrics;
+    int _profile_metric;
+    Vector<Task *> _tasks;
+    Vector<int> _fds;		// per thread, per metric
+    Vector<uint64_t> _base;
+
+    static int the_profile_metric;
+    static uint64_t read_profile_counter();
+
+    static String read_counts(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,157 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * perfcountuser.{cc,hh} -- userlevel performance counter support
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "perfcountuser.hh"
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+CLICK_DECLS
+
+#if HAVE___THREAD_STORAGE_CLASS
+__thread PerfCountUser::Counter PerfCountUser::the_counters[NMETRICS];
+#else
+PerfCountUser::Counter PerfCountUser::the_counters[NMETRICS];
+#endif
+
+#define HW_CACHE(cache, op, result) \
+    (PERF_COUNT_HW_CACHE_##cache | (PERF_COUNT_HW_CACHE_OP_##op << 8) \
+     | (PERF_COUNT_HW_CACHE_RESULT_##result << 16))
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} metrics[] = {
+    { "CYCLES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "INSTRUCTIONS", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "CACHE_REFERENCES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { "CACHE_MISSES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "BRANCHES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+    { "BRANCH_MISSES", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1D_LOAD_MISSES", PERF_TYPE_HW_CACHE, HW_CACHE(L1D, READ, MISS) },
+    { "LLC_LOADS", PERF_TYPE_HW_CACHE, HW_CACHE(LL, READ, ACCESS) },
+    { "LLC_LOAD_MISSES", PERF_TYPE_HW_CACHE, HW_CACHE(LL, READ, MISS) },
+    { "DTLB_LOAD_MISSES", PERF_TYPE_HW_CACHE, HW_CACHE(DTLB, READ, MISS) },
+    { "TASK_CLOCK", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { "PAGE_FAULTS", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { "CONTEXT_SWITCHES", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES }
+};
+
+PerfCountUser::PerfCountUser()
+{
+    static_assert(sizeof(metrics) / sizeof(metrics[0]) == NMETRICS,
+		  "metric table out of date");
+}
+
+PerfCountUser::~PerfCountUser()
+{
+}
+
+/** @brief Return the metric named @a name, or -1 if there is none.
+ *
+ * Names are case-insensitive. */
+int
+PerfCountUser::parse_metric(const String &name)
+{
+    String uname = name.upper();
+    for (int i = 0; i < NMETRICS; ++i)
+	if (uname == metrics[i].name)
+	    return i;
+    return -1;
+}
+
+const char *
+PerfCountUser::metric_name(int metric)
+{
+    return metrics[metric].name;
+}
+
+/** @brief Parse metric @a name and check that the calling thread can
+ * count it.
+ * @return the metric, or a negative error code */
+int
+PerfCountUser::prepare(const String &name, ErrorHandler *errh)
+{
+    int metric = parse_metric(name);
+    if (metric < 0)
+	return errh->error("unknown performance metric %<%s%>", name.c_str());
+    Counter &c = the_counters[metric];
+    if (c.fd1 == 0 && open_counter(metric, c, errh) < 0)
+	return -1;
+    else if (c.fd1 < 0)
+	return errh->error("%s: cannot open performance counter", metrics[metric].name);
+    return metric;
+}
+
+int
+PerfCountUser::open_counter(int metric, Counter &c, ErrorHandler *errh)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = metrics[metric].type;
+    attr.config = metrics[metric].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+	c.fd1 = -1;
+	if (errh)
+	    errh->error("%s: perf_event_open: %s", metrics[metric].name, strerror(errno));
+	return -1;
+    }
+    c.fd1 = fd + 1;
+    c.page = 0;
+    void *page = mmap(0, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+    if (page != MAP_FAILED) {
+	if (static_cast<struct perf_event_mmap_page *>(page)->cap_user_rdpmc)
+	    c.page = static_cast<struct perf_event_mmap_page *>(page);
+	else
+	    munmap(page, sysconf(_SC_PAGESIZE));
+    }
+    return 0;
+}
+
+/** @brief Return the count of the counter open on @a fd, or 0 on error. */
+uint64_t
+PerfCountUser::read_fd(int fd)
+{
+    uint64_t value;
+    if (fd >= 0 && read(fd, &value, sizeof(value)) == sizeof(value))
+	return value;
+    else
+	return 0;
+}
+
+/** @brief Return the calling thread's file descriptor for @a metric, or -1.
+ *
+ * Opens the counter if necessary.  Other threads may read(2) the descriptor
+ * to learn this thread's count. */
+int
+PerfCountUser::counter_fd(int metric)
+{
+    Counter &c = the_counters[metric];
+    if (c.fd1 == 0)
+	open_counter(metric, c, 0);
+    return c.fd1 > 0 ? c.fd1 - 1 : -1;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel linux int64)
+ELEMENT_PROVIDES(PerfCountUser)
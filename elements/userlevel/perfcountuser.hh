@@ -0,0 +1,90 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PERFCOUNTUSER_USERLEVEL_HH
+#define CLICK_PERFCOUNTUSER_USERLEVEL_HH
+#include <click/element.hh>
+#include <click/sync.hh>
+#include <linux/perf_event.h>
+CLICK_DECLS
+
+/*
+ * Base class for the userlevel performance counter elements.  Counters are
+ * Linux perf_event_open(2) events that count only the calling thread, in
+ * user mode.  Each thread opens its own counter the first time it reads a
+ * metric; reads use the rdpmc instruction when the kernel allows it, and
+ * read(2) on the counter's file descriptor otherwise.
+ */
+
+class PerfCountUser : public Element { public:
+
+    PerfCountUser();
+    ~PerfCountUser();
+
+    enum {
+	CYCLES, INSTRUCTIONS, CACHE_REFERENCES, CACHE_MISSES,
+	BRANCHES, BRANCH_MISSES, L1D_LOAD_MISSES, LLC_LOADS,
+	LLC_LOAD_MISSES, DTLB_LOAD_MISSES, TASK_CLOCK, PAGE_FAULTS,
+	CONTEXT_SWITCHES, NMETRICS
+    };
+
+    static int parse_metric(const String &name);
+    static const char *metric_name(int metric);
+
+    int prepare(const String &name, ErrorHandler *errh);
+
+    static inline uint64_t read_counter(int metric);
+    static int counter_fd(int metric);
+    static uint64_t read_fd(int fd);
+
+  private:
+
+    struct Counter {
+	int fd1;		// fd + 1; 0 means not opened, -1 failed
+	struct perf_event_mmap_page *page;
+    };
+
+#if HAVE___THREAD_STORAGE_CLASS
+    static __thread Counter the_counters[NMETRICS];
+#else
+    static Counter the_counters[NMETRICS];
+#endif
+
+    static int open_counter(int metric, Counter &c, ErrorHandler *errh);
+
+};
+
+/** @brief Return the calling thread's current count for @a metric.
+ *
+ * Opens the thread's counter on first use.  Returns 0 if the counter
+ * cannot be opened. */
+inline uint64_t
+PerfCountUser::read_counter(int metric)
+{
+    Counter &c = the_counters[metric];
+    if (unlikely(c.fd1 == 0))
+	open_counter(metric, c, 0);
+#if defined(__x86_64__) || defined(__i386__)
+    if (volatile struct perf_event_mmap_page *pc = c.page) {
+	uint32_t seq, idx;
+	uint64_t count;
+	do {
+	    seq = pc->lock;
+	    click_compiler_fence();
+	    idx = pc->index;
+	    count = pc->offset;
+	    if (idx) {
+		uint32_t lo, hi;
+		__asm__ __volatile__("rdpmc" : "=a" (lo), "=d" (hi) : "c" (idx - 1));
+		int shift = 64 - pc->pmc_width;
+		count += (int64_t) (((uint64_t) hi << 32 | lo) << shift) >> shift;
+	    }
+	    click_compiler_fence();
+	} while (pc->lock != seq);
+	if (idx)
+	    return count;
+    }
+#endif
+    return read_fd(c.fd1 - 1);
+}
+
+CLICK_ENDDECLS
+#endif
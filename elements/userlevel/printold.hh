@@ -34,6 +34,7 @@ class PrintOld : public Element { public:
   ~PrintOld();
 
   const char *class_name() const		{ return "PrintOld"; }
+  const char *flags() const			{ return "T"; }
   const char *port_count() const		{ return PORTS_1_1; }
 
   int configure(Vector<String> &, ErrorHandler *);
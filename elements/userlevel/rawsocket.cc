@@ -41,13 +41,23 @@
 #endif
 
 #include "fakepcap.hh"
+#include "socketfilter.hh"
 
 CLICK_DECLS
 
+#if RAWSOCKET_ALLOW_MMSG
+static const size_t control_len = CMSG_SPACE(sizeof(struct timeval));
+#endif
+
 RawSocket::RawSocket()
   : _task(this), _timer(this),
     _fd(-1), _port_register_socket(-1), _port(0), _snaplen(2048),
-    _headroom(Packet::default_headroom), _rq(0), _wq(0)
+    _headroom(Packet::default_headroom), _rq(0), _wq(0), _burst(1),
+    _recv_calls(0), _recv_packets(0), _send_calls(0), _send_packets(0)
+#if RAWSOCKET_ALLOW_MMSG
+    , _rbufs(0), _rmsgs(0), _riovs(0), _rcontrol(0),
+    _wmsgs(0), _wiovs(0), _wto(0)
+#endif
 {
 }
 
@@ -64,7 +74,7 @@ RawSocket::configure(Vector<String> &conf, ErrorHandler *errh)
   else if (conf.size() && conf[0].upper() == "UDP")
     parsecmd = cpUDPPort;
 
-  String socktype;
+  String socktype, filter;
   Args args(conf, this, errh);
   if (args.read_mp("TYPE", socktype).execute() < 0)
     return -1;
@@ -76,8 +86,12 @@ RawSocket::configure(Vector<String> &conf, ErrorHandler *errh)
     args.read_p("PORT", _port);
   if (args.read("SNAPLEN", _snaplen)
       .read("HEADROOM", _headroom)
+      .read("BURST", _burst)
+      .read("FILTER", filter)
       .complete() < 0)
     return -1;
+  if (_burst < 1)
+    return errh->error("BURST must be at least 1");
 
   socktype = socktype.upper();
   if (socktype == "TCP")
@@ -91,6 +105,10 @@ RawSocket::configure(Vector<String> &conf, ErrorHandler *errh)
   else
     return errh->error("unknown socket type `%s'", socktype.c_str());
 
+  _filter.clear();
+  if (filter && socket_filter_compile(filter, _filter, this, errh) < 0)
+    return -1;
+
   return 0;
 }
 
@@ -155,6 +173,40 @@ RawSocket::initialize(ErrorHandler *errh)
   if (setsockopt(_fd, 0, IP_HDRINCL, &one, sizeof(one)) < 0)
     return initialize_socket_error(errh, "IP_HDRINCL");
 
+  // let the kernel drop packets FILTER rejects
+  if (_filter.size() && noutputs()
+      && socket_filter_attach(_fd, _filter) < 0)
+    return initialize_socket_error(errh, "SO_ATTACH_FILTER");
+
+#if RAWSOCKET_ALLOW_MMSG
+  // message arrays for recvmmsg() and sendmmsg()
+  if (_burst > 1) {
+    if (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) < 0)
+      return initialize_socket_error(errh, "SO_TIMESTAMP");
+    _rbufs = new WritablePacket *[_burst];
+    _rmsgs = new struct mmsghdr[_burst];
+    _riovs = new struct iovec[_burst];
+    _rcontrol = new char[_burst * control_len];
+    _wmsgs = new struct mmsghdr[_burst];
+    _wiovs = new struct iovec[_burst];
+    _wto = new struct sockaddr_in[_burst];
+    memset(_rmsgs, 0, sizeof(struct mmsghdr) * _burst);
+    memset(_wmsgs, 0, sizeof(struct mmsghdr) * _burst);
+    memset(_wto, 0, sizeof(struct sockaddr_in) * _burst);
+    for (int i = 0; i < _burst; ++i) {
+      _rbufs[i] = 0;
+      _rmsgs[i].msg_hdr.msg_iov = &_riovs[i];
+      _rmsgs[i].msg_hdr.msg_iovlen = 1;
+      _rmsgs[i].msg_hdr.msg_control = &_rcontrol[i * control_len];
+      _wto[i].sin_family = AF_INET;
+      _wmsgs[i].msg_hdr.msg_name = &_wto[i];
+      _wmsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      _wmsgs[i].msg_hdr.msg_iov = &_wiovs[i];
+      _wmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+#endif
+
   if (noutputs())
     add_select(_fd, SELECT_READ);
 
@@ -174,6 +226,22 @@ RawSocket::cleanup(CleanupStage)
     _rq->kill();
   if (_wq)
     _wq->kill();
+#if RAWSOCKET_ALLOW_MMSG
+  if (_rbufs)
+    for (int i = 0; i < _burst; ++i)
+      if (_rbufs[i])
+	_rbufs[i]->kill();
+  _wpending.kill();
+  delete[] _rbufs;
+  delete[] _rmsgs;
+  delete[] _riovs;
+  delete[] _rcontrol;
+  delete[] _wmsgs;
+  delete[] _wiovs;
+  delete[] _wto;
+  _rbufs = 0;
+  _rmsgs = _wmsgs = 0;
+#endif
   if (_fd >= 0) {
     close(_fd);
     remove_select(_fd, SELECT_READ | SELECT_WRITE);
@@ -187,6 +255,11 @@ RawSocket::selected(int fd, int)
   ErrorHandler *errh = ErrorHandler::default_handler();
   int len;
 
+#if RAWSOCKET_ALLOW_MMSG
+  if (noutputs() && _rmsgs)
+    recv_burst(errh);
+  else
+#endif
   if (noutputs()) {
     // read data from socket
     if (!_rq)
@@ -216,6 +289,18 @@ RawSocket::selected(int fd, int)
     }
   }
 
+#if RAWSOCKET_ALLOW_MMSG
+  if (ninputs() && _wmsgs) {
+    // nothing to write, wait for upstream signal
+    if (send_burst(errh) && _wpending.empty() && !_signal
+	&& (_events & SELECT_WRITE)) {
+      remove_select(_fd, SELECT_WRITE);
+      _events &= ~SELECT_WRITE;
+    }
+    return;
+  }
+#endif
+
   if (ninputs()) {
     // write data to socket
     Packet *p;
@@ -277,10 +362,128 @@ RawSocket::selected(int fd, int)
   }
 }
 
+#if RAWSOCKET_ALLOW_MMSG
+void
+RawSocket::recv_burst(ErrorHandler *errh)
+{
+  // refill the buffers the last call used
+  int n;
+  for (n = 0; n < _burst; ++n) {
+    if (!_rbufs[n] && !(_rbufs[n] = Packet::make(_headroom, 0, _snaplen, 0)))
+      break;
+    _riovs[n].iov_base = _rbufs[n]->data();
+    _riovs[n].iov_len = _rbufs[n]->length();
+    _rmsgs[n].msg_hdr.msg_controllen = control_len;
+  }
+  if (n == 0)
+    return;
+
+  int r = recvmmsg(_fd, _rmsgs, n, MSG_DONTWAIT | MSG_TRUNC, 0);
+  if (r <= 0) {
+    if (r < 0 && errno != EAGAIN && errno != EINTR)
+      errh->error("recvmmsg: %s", strerror(errno));
+    return;
+  }
+  ++_recv_calls;
+  _recv_packets += r;
+
+  PacketBatch batch;
+  for (int i = 0; i < r; ++i) {
+    WritablePacket *p = _rbufs[i];
+    _rbufs[i] = 0;
+    struct msghdr *mh = &_rmsgs[i].msg_hdr;
+
+    int len = _rmsgs[i].msg_len;
+    if (len > _snaplen)
+      SET_EXTRA_LENGTH_ANNO(p, len - _snaplen);
+    else
+      p->take(_snaplen - len);
+
+    // set timestamp
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(mh); c; c = CMSG_NXTHDR(mh, c))
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP) {
+	struct timeval tv;
+	memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+	p->timestamp_anno() = Timestamp(tv);
+      }
+
+    // set IP annotations
+    if (fake_pcap_force_ip(p, FAKE_DLT_RAW))
+      batch.push_back(p);
+    else
+      p->kill();
+  }
+
+  if (!batch.empty())
+    output(0).push_batch(batch);
+}
+
+// Pull up to BURST packets and send them with one sendmmsg().  Returns false
+// if the socket queue was full and the timer will try again.
+bool
+RawSocket::send_burst(ErrorHandler *errh)
+{
+  if (_wpending.count() < _burst)
+    input(0).pull_batch(_wpending, _burst - _wpending.count());
+
+  // cast to int so very large plen is interpreted as negative
+  while (!_wpending.empty()
+	 && (int)_wpending.front()->length() < (int)sizeof(click_ip)) {
+    Packet *p = _wpending.pop_front();
+    errh->error("runt IP packet (%d bytes)", p->length());
+    p->kill();
+  }
+
+  // set up destinations
+  int m = 0;
+  for (Packet *p = _wpending.front(); p && m < _burst; p = p->next(), ++m) {
+    _wto[m].sin_addr = ((const click_ip *) p->data())->ip_dst;
+    _wiovs[m].iov_base = const_cast<unsigned char *>(p->data());
+    _wiovs[m].iov_len = p->length();
+  }
+  if (!m)
+    return true;
+
+  int r = sendmmsg(_fd, _wmsgs, m, 0);
+  if (r < 0) {
+    if (errno == ENOBUFS || errno == EAGAIN) {
+      // socket queue full, try again later
+      remove_select(_fd, SELECT_WRITE);
+      _events &= ~SELECT_WRITE;
+      _backoff = (!_backoff) ? 1 : _backoff*2;
+      _timer.schedule_after(Timestamp::make_usec(_backoff));
+      return false;
+    } else if (errno != EINTR) {
+      // unexpected error: drop packet
+      errh->error("sendmmsg: %s", strerror(errno));
+      _wpending.pop_front()->kill();
+    }
+    return true;
+  }
+
+  ++_send_calls;
+  _send_packets += r;
+  _backoff = 0;
+  for (int i = 0; i < r; ++i)
+    _wpending.pop_front()->kill();
+  return true;
+}
+#endif
+
+bool
+RawSocket::write_pending() const
+{
+#if RAWSOCKET_ALLOW_MMSG
+  if (!_wpending.empty())
+    return true;
+#endif
+  return _wq != 0;
+}
+
 void
 RawSocket::run_timer(Timer *)
 {
-  if ((_wq || _signal) && !(_events & SELECT_WRITE) && _fd >= 0) {
+  if ((write_pending() || _signal) && !(_events & SELECT_WRITE) && _fd >= 0) {
     add_select(_fd, SELECT_WRITE);
     _events |= SELECT_WRITE;
     selected(_fd, 0);
@@ -290,7 +493,7 @@ RawSocket::run_timer(Timer *)
 bool
 RawSocket::run_task(Task *)
 {
-  if (!_wq && !(_events & SELECT_WRITE) && _fd >= 0) {
+  if (!write_pending() && !(_events & SELECT_WRITE) && _fd >= 0) {
     add_select(_fd, SELECT_WRITE);
     _events |= SELECT_WRITE;
     selected(_fd, 0);
@@ -299,12 +502,24 @@ RawSocket::run_task(Task *)
     return false;
 }
 
+String
+RawSocket::read_handler(Element *e, void *)
+{
+  RawSocket *rs = static_cast<RawSocket *>(e);
+  return socket_filter_unparse(rs->_filter);
+}
+
 void
 RawSocket::add_handlers()
 {
   add_task_handlers(&_task);
+  add_read_handler("filter", read_handler, 0);
+  add_data_handlers("recv_calls", Handler::OP_READ, &_recv_calls);
+  add_data_handlers("recv_packets", Handler::OP_READ, &_recv_packets);
+  add_data_handlers("send_calls", Handler::OP_READ, &_send_calls);
+  add_data_handlers("send_packets", Handler::OP_READ, &_send_packets);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel linux)
+ELEMENT_REQUIRES(userlevel linux SocketFilter)
 EXPORT_ELEMENT(RawSocket)
@@ -5,6 +5,11 @@
 #include <click/task.hh>
 #include <click/timer.hh>
 #include <click/notifier.hh>
+#include <click/packetbatch.hh>
+#include <click/vector.hh>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/filter.h>
 CLICK_DECLS
 
 /*
@@ -47,13 +52,60 @@ by this element. This could be useful for encapsulation protocols
 which add headers to the packet, and can avoid expensive push
 operations later in the packet's life.
 
+=item BURST
+
+Integer. If greater than 1, RawSocket receives up to BURST packets with
+one recvmmsg() call, into packet buffers it keeps allocated between
+calls, and emits them as one batch; it likewise pulls up to BURST
+packets at a time and sends them with one sendmmsg() call. Requires
+glibc 2.14 or later; elsewhere BURST is ignored. Default is 1.
+
+=item FILTER
+
+String. An IPFilter expression, such as "src host 10.0.0.1 && udp dst port
+53". RawSocket compiles it into a classic BPF program and attaches it to the
+socket, so the kernel discards packets that do not match before copying
+them to Click. Tests on link-level headers are not allowed, and, unlike
+IPFilter, the filter discards packets too short for a test it makes.
+Default is to receive every packet for the protocol.
+
 =back
 
 =e
 
   RawSocket(UDP, 53) -> ...
 
-=a Socket */
+  // Only DNS queries from one host, 32 packets per system call
+  RawSocket(UDP, FILTER "src host 10.0.0.1 && dst port 53", BURST 32) -> ...
+
+=h filter read-only
+
+Returns the compiled FILTER program, one BPF instruction per line.
+
+=h recv_calls read-only
+
+Returns the number of recvmmsg() calls that returned packets, with BURST
+set.
+
+=h recv_packets read-only
+
+Returns the number of packets received by those calls.
+
+=h send_calls read-only
+
+Returns the number of successful sendmmsg() calls, with BURST set.
+
+=h send_packets read-only
+
+Returns the number of packets sent by those calls.
+
+=a Socket, IPFilter */
+
+#if defined(__linux__) && defined(__USE_GNU) && defined(__GLIBC_PREREQ)
+# if __GLIBC_PREREQ(2, 14)
+#  define RAWSOCKET_ALLOW_MMSG 1
+# endif
+#endif
 
 class RawSocket : public Element { public:
 
@@ -93,7 +145,30 @@ private:
   Packet *_wq;			// queue to store pulled packet for when sendto() blocks
   int _events;			// keeps track of the events for which select() is waiting
 
+  int _burst;			// packets per recvmmsg()/sendmmsg()
+  Vector<struct sock_filter> _filter;	// compiled FILTER
+  uint32_t _recv_calls;		// recvmmsg() calls
+  uint32_t _recv_packets;	// packets received by recvmmsg()
+  uint32_t _send_calls;		// sendmmsg() calls
+  uint32_t _send_packets;	// packets sent by sendmmsg()
+
+#if RAWSOCKET_ALLOW_MMSG
+  WritablePacket **_rbufs;	// preallocated receive buffers
+  struct mmsghdr *_rmsgs;
+  struct iovec *_riovs;
+  char *_rcontrol;		// SO_TIMESTAMP messages
+  struct mmsghdr *_wmsgs;
+  struct iovec *_wiovs;
+  struct sockaddr_in *_wto;	// packet destinations
+  PacketBatch _wpending;	// pulled packets not yet sent
+
+  void recv_burst(ErrorHandler *);
+  bool send_burst(ErrorHandler *);
+#endif
+
+  bool write_pending() const;
   int initialize_socket_error(ErrorHandler *, const char *);
+  static String read_handler(Element *, void *);
 
 };
 
@@ -0,0 +1,63 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * setperfcount.{cc,hh} -- set performance counter annotations
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "setperfcount.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+SetPerfCount::SetPerfCount()
+{
+}
+
+SetPerfCount::~SetPerfCount()
+{
+}
+
+void *
+SetPerfCount::cast(const char *n)
+{
+    if (strcmp(n, "PerfCountUser") == 0)
+	return static_cast<PerfCountUser *>(this);
+    else if (strcmp(n, "SetPerfCount") == 0)
+	return static_cast<Element *>(this);
+    else
+	return 0;
+}
+
+int
+SetPerfCount::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String metric_name;
+    if (Args(conf, this, errh)
+	.read_mp("METRIC", WordArg(), metric_name)
+	.complete() < 0)
+	return -1;
+    _which = PerfCountUser::prepare(metric_name, errh);
+    return (_which < 0 ? -1 : 0);
+}
+
+Packet *
+SetPerfCount::simple_action(Packet *p)
+{
+    SET_PERFCTR_ANNO(p, read_counter(_which));
+    return p;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel linux int64 PerfCountUser)
+EXPORT_ELEMENT(SetPerfCount)
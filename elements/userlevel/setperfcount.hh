@@ -0,0 +1,59 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SETPERFCOUNT_USERLEVEL_HH
+#define CLICK_SETPERFCOUNT_USERLEVEL_HH
+#include "elements/userlevel/perfcountuser.hh"
+CLICK_DECLS
+
+/*
+=c
+
+SetPerfCount(METRIC)
+
+=s counters
+
+stores a performance counter value in an annotation
+
+=d
+
+Stores the current thread's count for performance metric METRIC in each
+packet's performance counter annotation.  In combination with PerfCountAccum,
+this lets you measure how the metric changes over part of the packet's
+lifetime.  Counters are Linux perf_event_open(2) events limited to user-mode
+activity of the counting thread, so SetPerfCount and its PerfCountAccum
+should run on the same thread.
+
+Valid METRIC names are C<CYCLES>, C<INSTRUCTIONS>, C<CACHE_REFERENCES>,
+C<CACHE_MISSES>, C<BRANCHES>, C<BRANCH_MISSES>, C<L1D_LOAD_MISSES>,
+C<LLC_LOADS>, C<LLC_LOAD_MISSES>, C<DTLB_LOAD_MISSES>, and the software
+metrics C<TASK_CLOCK> (nanoseconds), C<PAGE_FAULTS>, and
+C<CONTEXT_SWITCHES>.  Hardware metrics may be unavailable in virtual
+machines, or if the kernel.perf_event_paranoid sysctl forbids them.
+
+=n
+
+A packet has room for either exactly one cycle count or exactly one
+performance metric.
+
+=a PerfCountAccum, PerfCountInfo, SetCycleCount, CycleCountAccum */
+
+class SetPerfCount : public PerfCountUser { public:
+
+    SetPerfCount();
+    ~SetPerfCount();
+
+    const char *class_name() const	{ return "SetPerfCount"; }
+    void *cast(const char *);
+    const char *port_count() const	{ return PORTS_1_1; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+
+    Packet *simple_action(Packet *);
+
+  private:
+
+    int _which;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,435 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * shmchannel.{cc,hh} -- shared-memory packet channel between processes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "shmchannel.hh"
+#include <click/element.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+CLICK_DECLS
+
+struct ShmChannel::Ring {
+    volatile uint32_t producer;
+    char pad0[60];
+    volatile uint32_t consumer;
+    volatile uint32_t need_wakeup;
+    char pad1[56];
+};
+
+struct ShmChannel::Shared {
+    volatile uint32_t magic;	// written last by the creator
+    uint32_t nslots;
+    uint32_t slot_size;
+    volatile uint32_t pid[2];	// 0 until the side attaches
+    char pad[44];
+    Ring tx[2];
+    Ring free[2];
+
+    enum { MAGIC = 0x436C5348 };	// "ClSH"
+};
+
+static inline void
+shm_fence()
+{
+#if HAVE___SYNC_SYNCHRONIZE
+    __sync_synchronize();
+#else
+    click_compiler_fence();
+#endif
+}
+
+static inline size_t
+round_page(size_t x)
+{
+    return (x + 4095) & ~(size_t) 4095;
+}
+
+ShmChannel::ShmChannel()
+    : _side(-1), _users(0), _map(0), _map_size(0), _shared(0), _slots(0),
+      _nslots(0), _slot_size(0), _tx_next(0), _rx_next(0), _local_free(0),
+      _nlocal_free(0), _peer_free_next(0), _sending(0)
+{
+    _wake_fd[0] = _wake_fd[1] = -1;
+    _live = 1;
+}
+
+ShmChannel::~ShmChannel()
+{
+    unmap();
+    for (int d = 0; d < 2; ++d)
+	if (_wake_fd[d] >= 0)
+	    ::close(_wake_fd[d]);
+    delete[] _local_free;
+    delete[] _sending;
+}
+
+inline unsigned char *
+ShmChannel::slot(uint32_t s) const
+{
+    return _slots + (size_t) s * _slot_size;
+}
+
+inline int
+ShmChannel::owner(uint32_t s) const
+{
+    return s >= _nslots / 2;
+}
+
+int
+ShmChannel::map(int fd, bool create, ErrorHandler *errh)
+{
+    size_t desc_off = sizeof(Shared);
+    size_t free_off = desc_off + 2 * _nslots * sizeof(Desc);
+    size_t slots_off = round_page(free_off + 2 * _nslots * sizeof(uint32_t));
+    _map_size = slots_off + (size_t) _nslots * _slot_size;
+    if (create && ftruncate(fd, _map_size) < 0)
+	return errh->error("%s: %s", _path.c_str(), strerror(errno));
+    void *m = mmap(0, _map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (m == MAP_FAILED) {
+	_map_size = 0;
+	return errh->error("%s: mmap: %s", _path.c_str(), strerror(errno));
+    }
+    _map = reinterpret_cast<unsigned char *>(m);
+    _shared = reinterpret_cast<Shared *>(_map);
+    for (int d = 0; d < 2; ++d) {
+	_tx[d] = &_shared->tx[d];
+	_free[d] = &_shared->free[d];
+	_tx_desc[d] = reinterpret_cast<Desc *>(_map + desc_off) + d * _nslots;
+	_free_desc[d] = reinterpret_cast<uint32_t *>(_map + free_off) + d * _nslots;
+    }
+    _slots = _map + slots_off;
+    _mask = _nslots - 1;
+    return 0;
+}
+
+void
+ShmChannel::unmap()
+{
+    if (_map)
+	munmap(_map, _map_size);
+    _map = 0;
+}
+
+int
+ShmChannel::attach(uint32_t nslots, uint32_t slot_size, ErrorHandler *errh)
+{
+    String wake[2] = { _path + ".wake0", _path + ".wake1" };
+    int fd = -1;
+    bool created = false;
+    for (int attempt = 0; attempt < 3 && _side < 0; ++attempt) {
+	if ((fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) >= 0) {
+	    // We create the channel.  The lock keeps the peer out until the
+	    // header is complete.
+	    flock(fd, LOCK_EX);
+	    created = true;
+	    _nslots = nslots;
+	    _slot_size = slot_size;
+	    for (int d = 0; d < 2; ++d) {
+		unlink(wake[d].c_str());
+		if (mkfifo(wake[d].c_str(), 0600) < 0) {
+		    errh->error("%s: %s", wake[d].c_str(), strerror(errno));
+		    goto fail;
+		}
+	    }
+	    if (map(fd, true, errh) < 0)
+		goto fail;
+	    _shared->nslots = nslots;
+	    _shared->slot_size = slot_size;
+	    _shared->pid[0] = getpid();
+	    shm_fence();
+	    _shared->magic = Shared::MAGIC;
+	    _side = 0;
+	    break;
+	} else if (errno != EEXIST)
+	    return errh->error("%s: %s", _path.c_str(), strerror(errno));
+
+	// Attach to an existing channel, waiting up to a second for its
+	// creator to set it up.
+	if ((fd = ::open(_path.c_str(), O_RDWR | O_CLOEXEC)) < 0)
+	    return errh->error("%s: %s", _path.c_str(), strerror(errno));
+	Shared h;
+	for (int wait = 0; wait < 100; ++wait) {
+	    flock(fd, LOCK_EX);
+	    if (pread(fd, &h, sizeof(h), 0) == (ssize_t) sizeof(h)
+		&& h.magic == Shared::MAGIC)
+		break;
+	    flock(fd, LOCK_UN);
+	    h.magic = 0;
+	    usleep(10000);
+	}
+	if (h.magic == Shared::MAGIC && h.pid[1] == 0
+	    && (kill(h.pid[0], 0) == 0 || errno != ESRCH)) {
+	    _nslots = h.nslots;
+	    _slot_size = h.slot_size;
+	    if (map(fd, false, errh) < 0)
+		goto fail;
+	    _shared->pid[1] = getpid();
+	    _side = 1;
+	} else if (h.magic == Shared::MAGIC && h.pid[1] != 0
+		   && (kill(h.pid[0], 0) == 0 || errno != ESRCH)) {
+	    errh->error("%s: channel already connects two processes", _path.c_str());
+	    goto fail;
+	} else if (attempt < 2) {
+	    // The creator is gone or never finished: remove the stale
+	    // channel, unless someone already replaced it, and start over.
+	    struct stat fst, pst;
+	    if (fstat(fd, &fst) == 0 && stat(_path.c_str(), &pst) == 0
+		&& fst.st_dev == pst.st_dev && fst.st_ino == pst.st_ino)
+		unlink(_path.c_str());
+	    ::close(fd);
+	    fd = -1;
+	} else {
+	    errh->error("%s: bad channel file", _path.c_str());
+	    goto fail;
+	}
+    }
+    flock(fd, LOCK_UN);
+    ::close(fd);
+
+    for (int d = 0; d < 2; ++d)
+	if ((_wake_fd[d] = ::open(wake[d].c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC)) < 0)
+	    return errh->error("%s: %s", wake[d].c_str(), strerror(errno));
+
+    _local_free = new uint32_t[_nslots / 2];
+    _sending = new unsigned char[_nslots];
+    memset(_sending, 0, _nslots);
+    for (uint32_t s = _nslots / 2; s > 0; --s)
+	_local_free[_nlocal_free++] = _side * (_nslots / 2) + s - 1;
+    _tx_next = _tx[_side]->producer;
+    _rx_next = _tx[!_side]->consumer;
+    _peer_free_next = _free[!_side]->producer;
+    return 0;
+
+  fail:
+    if (created)
+	unlink(_path.c_str());
+    if (fd >= 0)
+	::close(fd);
+    return -1;
+}
+
+ShmChannel *
+ShmChannel::open(Element *e, const String &path, uint32_t nslots,
+		 uint32_t slot_size, ErrorHandler *errh)
+{
+    void *&attachment = e->router()->force_attachment("ShmChannel_" + path);
+    ShmChannel *c = reinterpret_cast<ShmChannel *>(attachment);
+    if (!c) {
+	c = new ShmChannel;
+	c->_path = path;
+	if (c->attach(nslots, slot_size, errh) < 0) {
+	    c->release();
+	    return 0;
+	}
+	attachment = c;
+    }
+    ++c->_users;
+    return c;
+}
+
+void
+ShmChannel::close(Element *e)
+{
+    if (--_users > 0)
+	return;
+    e->router()->set_attachment("ShmChannel_" + _path, 0);
+    // The peer keeps its mappings; removing the names lets the next pair
+    // of processes start a fresh channel.
+    if (_side == 0) {
+	unlink(_path.c_str());
+	unlink((_path + ".wake0").c_str());
+	unlink((_path + ".wake1").c_str());
+    }
+    release();
+}
+
+void
+ShmChannel::release()
+{
+    if (_live.dec_and_test())
+	delete this;
+}
+
+/* Take a free slot owned by this side, collecting slots the peer has
+   returned if the local list is empty. */
+bool
+ShmChannel::get_slot(uint32_t &s)
+{
+    _lock.acquire();
+    if (_nlocal_free == 0) {
+	Ring *r = _free[_side];
+	uint32_t cons = r->consumer, prod = r->producer;
+	shm_fence();
+	for (; cons != prod; ++cons)
+	    _local_free[_nlocal_free++] = _free_desc[_side][cons & _mask];
+	shm_fence();
+	r->consumer = cons;
+    }
+    bool ok = _nlocal_free > 0;
+    if (ok)
+	s = _local_free[--_nlocal_free];
+    _lock.release();
+    return ok;
+}
+
+void
+ShmChannel::slot_done(uint32_t s)
+{
+    _lock.acquire();
+    if (_sending[s])
+	// passed to the peer without a copy
+	_sending[s] = 0;
+    else if (owner(s) == _side)
+	_local_free[_nlocal_free++] = s;
+    else {
+	_free_desc[!_side][_peer_free_next & _mask] = s;
+	++_peer_free_next;
+	shm_fence();
+	_free[!_side]->producer = _peer_free_next;
+    }
+    _lock.release();
+}
+
+int
+ShmChannel::send(Packet *p, bool &zerocopy)
+{
+    if (_tx_next - _tx[_side]->consumer == _nslots)
+	return 0;
+
+    uint32_t s;
+    Desc d;
+    const unsigned char *buf = p->buffer();
+    if (buf >= _slots && buf < _slots + (size_t) _nslots * _slot_size
+	&& !p->shared()) {
+	// p lives in one of our slots: pass the slot on
+	s = (buf - _slots) / _slot_size;
+	d.offset = p->data() - slot(s);
+	_sending[s] = 1;
+	zerocopy = true;
+    } else if (p->length() > _slot_size - SLOT_HEADER)
+	return -1;
+    else if (!get_slot(s))
+	return 0;
+    else {
+	uint32_t room = _slot_size - SLOT_HEADER - p->length();
+	if (room > SLOT_HEADROOM)
+	    room = SLOT_HEADROOM;
+	d.offset = SLOT_HEADER + room;
+	memcpy(slot(s) + d.offset, p->data(), p->length());
+	zerocopy = false;
+    }
+    d.slot = s;
+    d.length = p->length();
+    d.reserved = 0;
+    _tx_desc[_side][_tx_next & _mask] = d;
+    ++_tx_next;
+    p->kill();
+    return 1;
+}
+
+void
+ShmChannel::flush()
+{
+    Ring *r = _tx[_side];
+    if (r->producer == _tx_next)
+	return;
+    shm_fence();
+    r->producer = _tx_next;
+    shm_fence();
+    if (r->need_wakeup) {
+	char c = 0;
+	(void) write(_wake_fd[!_side], &c, 1);
+    }
+}
+
+WritablePacket *
+ShmChannel::receive()
+{
+    Ring *r = _tx[!_side];
+    while (r->producer != _rx_next) {
+	shm_fence();
+	Desc d = _tx_desc[!_side][_rx_next & _mask];
+	++_rx_next;
+	if (d.slot >= _nslots || d.offset < SLOT_HEADER
+	    || d.offset > _slot_size || d.length > _slot_size - d.offset)
+	    continue;		// corrupt descriptor; drop the slot
+	unsigned char *sl = slot(d.slot);
+	WritablePacket *p = Packet::make(sl + SLOT_HEADER, _slot_size - SLOT_HEADER, packet_destructor);
+	if (!p) {
+	    slot_done(d.slot);
+	    continue;
+	}
+	*reinterpret_cast<ShmChannel **>(sl) = this;
+	++_live;
+	p->pull(d.offset - SLOT_HEADER);
+	p->take(p->length() - d.length);
+	return p;
+    }
+    return 0;
+}
+
+/* Let the peer reuse the descriptors read since the last call. */
+void
+ShmChannel::receive_done()
+{
+    Ring *r = _tx[!_side];
+    if (r->consumer != _rx_next) {
+	shm_fence();
+	r->consumer = _rx_next;
+    }
+}
+
+bool
+ShmChannel::prepare_sleep()
+{
+    Ring *r = _tx[!_side];
+    r->need_wakeup = 1;
+    shm_fence();
+    if (r->producer != _rx_next) {
+	r->need_wakeup = 0;
+	return false;
+    }
+    return true;
+}
+
+void
+ShmChannel::clear_doorbell()
+{
+    char buf[64];
+    while (read(_wake_fd[_side], buf, sizeof(buf)) > 0)
+	/* nada */;
+    _tx[!_side]->need_wakeup = 0;
+}
+
+/* A packet's buffer starts after its slot's ShmChannel pointer. */
+void
+ShmChannel::packet_destructor(unsigned char *buf, size_t)
+{
+    unsigned char *sl = buf - SLOT_HEADER;
+    ShmChannel *c = *reinterpret_cast<ShmChannel **>(sl);
+    c->slot_done((sl - c->_slots) / c->_slot_size);
+    c->release();
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel linux)
+ELEMENT_PROVIDES(ShmChannel)
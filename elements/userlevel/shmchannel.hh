@@ -0,0 +1,117 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_SHMCHANNEL_HH
+#define CLICK_SHMCHANNEL_HH
+#include <click/string.hh>
+#include <click/atomic.hh>
+#include <click/sync.hh>
+#include <click/packet.hh>
+CLICK_DECLS
+class Element;
+class ErrorHandler;
+
+/* A packet channel between two Click processes, used by FromShm and ToShm.
+
+   The channel is a file, normally on a tmpfs such as /dev/shm, that both
+   processes map.  It holds an array of packet slots and four single-producer,
+   single-consumer rings of slot indexes.  The process that creates the file
+   is side 0, the one that attaches to it side 1.  Each side owns half the
+   slots.  Ring tx[d] carries slots holding packets from side d to the other
+   side; ring free[d] returns slots owned by side d once the other side's
+   packets in them die.  Ring indexes are free-running 32-bit counters, and
+   each ring has room for every slot, so no ring can overflow.
+
+   A packet received from the channel points into its slot.  When such a
+   packet is sent back through the same channel, its slot is passed on
+   without a copy.  Other packets are copied into a free slot.
+
+   A side that finds no packets to receive sets its ring's need_wakeup flag
+   and waits for a byte on its doorbell, a FIFO next to the channel file
+   (PATH.wake0 or PATH.wake1).  A sender writes to the peer's doorbell only
+   when that flag is set.
+
+   Within one router, FromShm and ToShm elements with the same PATH share
+   one ShmChannel, found through a router attachment.  Receiving and sending
+   each must happen on a single thread, though not necessarily the same one;
+   packets may die on any thread. */
+class ShmChannel { public:
+
+    static ShmChannel *open(Element *e, const String &path, uint32_t nslots,
+			    uint32_t slot_size, ErrorHandler *errh);
+    void close(Element *e);
+
+    const String &path() const		{ return _path; }
+    int side() const			{ return _side; }
+    int wake_fd() const			{ return _wake_fd[_side]; }
+
+    // Sending.  send() returns 1 if p was queued and is consumed, 0 if
+    // there is no free slot, or -1 if p is too long; flush() makes queued
+    // packets visible to the peer.
+    int send(Packet *p, bool &zerocopy);
+    void flush();
+
+    // Receiving.  receive() returns 0 if no packet is ready; receive_done()
+    // hands the descriptors read back to the peer.  prepare_sleep() asks the
+    // peer to ring the doorbell; it returns false, and cancels the request,
+    // if packets arrived meanwhile.
+    WritablePacket *receive();
+    void receive_done();
+    bool prepare_sleep();
+    void clear_doorbell();
+
+  private:
+
+    struct Shared;
+    struct Ring;
+    struct Desc {
+	uint32_t slot;
+	uint32_t offset;
+	uint32_t length;
+	uint32_t reserved;
+    };
+    enum { SLOT_HEADER = sizeof(ShmChannel *), SLOT_HEADROOM = 64 };
+
+    String _path;
+    int _side;
+    int _wake_fd[2];
+    int _users;
+    atomic_uint32_t _live;	// 1 while open, plus 1 per packet
+
+    unsigned char *_map;
+    size_t _map_size;
+    Shared *_shared;
+    Ring *_tx[2];
+    Ring *_free[2];
+    Desc *_tx_desc[2];
+    uint32_t *_free_desc[2];
+    unsigned char *_slots;
+    uint32_t _nslots;
+    uint32_t _slot_size;
+    uint32_t _mask;
+
+    uint32_t _tx_next;		// next tx[_side] entry to fill
+    uint32_t _rx_next;		// next tx[peer] entry to read
+
+    // Free slots owned by this side, and the producer end of the peer's
+    // free ring; both are used by packet destructors on any thread.
+    Spinlock _lock;
+    uint32_t *_local_free;
+    uint32_t _nlocal_free;
+    uint32_t _peer_free_next;
+    unsigned char *_sending;	// slot passed on without a copy
+
+    ShmChannel();
+    ~ShmChannel();
+    int attach(uint32_t nslots, uint32_t slot_size, ErrorHandler *errh);
+    int map(int fd, bool create, ErrorHandler *errh);
+    void unmap();
+    void release();
+    inline unsigned char *slot(uint32_t s) const;
+    inline int owner(uint32_t s) const;
+    bool get_slot(uint32_t &s);
+    void slot_done(uint32_t s);
+    static void packet_destructor(unsigned char *buf, size_t length);
+
+};
+
+CLICK_ENDDECLS
+#endif
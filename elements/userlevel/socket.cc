@@ -24,28 +24,69 @@
 #include <click/standard/scheduleinfo.hh>
 #include <click/packet_anno.hh>
 #include <click/packet.hh>
+#include <click/router.hh>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <fcntl.h>
+#include <poll.h>
 #include "socket.hh"
 
 #ifdef HAVE_PROPER
 #include <proper/prop.h>
 #endif
 
+// older C libraries lack the Linux UDP offload options
+#if defined(__linux__) && !defined(UDP_SEGMENT)
+# define UDP_SEGMENT 103
+#endif
+#if defined(__linux__) && !defined(UDP_GRO)
+# define UDP_GRO 104
+#endif
+#ifdef __linux__
+# include <linux/errqueue.h>
+# ifndef SO_ZEROCOPY
+#  define SO_ZEROCOPY 60
+# endif
+# ifndef MSG_ZEROCOPY
+#  define MSG_ZEROCOPY 0x4000000
+# endif
+# ifndef SO_EE_ORIGIN_ZEROCOPY
+#  define SO_EE_ORIGIN_ZEROCOPY 5
+# endif
+# ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#  define SO_EE_CODE_ZEROCOPY_COPIED 1
+# endif
+#endif
+
 CLICK_DECLS
 
+#if SOCKET_ALLOW_MMSG
+enum {
+  max_gso_segments = 64,	// UDP_MAX_SEGMENTS
+  max_udp_payload = 65507,
+  control_len = CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct timeval))
+};
+#endif
+
 Socket::Socket()
   : _task(this), _timer(this),
     _fd(-1), _active(-1), _rq(0), _wq(0),
     _local_port(0), _local_pathname(""),
-    _timestamp(true), _sndbuf(-1), _rcvbuf(-1),
+    _timestamp(true), _timestamp_auto(true), _sndbuf(-1), _rcvbuf(-1),
     _snaplen(2048), _headroom(Packet::default_headroom), _nodelay(1),
-    _verbose(false), _client(false), _proper(false), _allow(0), _deny(0)
+    _verbose(false), _client(false), _proper(false), _allow(0), _deny(0),
+    _burst(1), _gso(0), _gro(false),
+    _recv_calls(0), _recv_packets(0), _send_calls(0), _send_packets(0),
+    _zerocopy(false), _zc_sends(0), _zc_done(0), _zc_copied(0)
+#if SOCKET_ALLOW_MMSG
+    , _rbufs(0), _rmsgs(0), _riovs(0), _rfrom(0), _rcontrol(0),
+    _wmsgs(0), _wiovs(0), _wto(0), _wcount(0)
+#endif
 {
 }
 
@@ -65,10 +106,11 @@ Socket::configure(Vector<String> &conf, ErrorHandler *errh)
 
   // remove keyword arguments
   Element *allow = 0, *deny = 0;
+  bool timestamp_set;
   if (args.read("VERBOSE", _verbose)
       .read("SNAPLEN", _snaplen)
       .read("HEADROOM", _headroom)
-      .read("TIMESTAMP", _timestamp)
+      .read("TIMESTAMP", _timestamp).read_status(timestamp_set)
       .read("RCVBUF", _rcvbuf)
       .read("SNDBUF", _sndbuf)
       .read("NODELAY", _nodelay)
@@ -76,8 +118,30 @@ Socket::configure(Vector<String> &conf, ErrorHandler *errh)
       .read("PROPER", _proper)
       .read("ALLOW", allow)
       .read("DENY", deny)
+      .read("BURST", _burst)
+      .read("GSO", _gso)
+      .read("GRO", _gro)
+      .read("ZEROCOPY", _zerocopy)
       .consume() < 0)
     return -1;
+  _timestamp_auto = !timestamp_set;
+
+  if (_burst < 1)
+    return errh->error("BURST must be at least 1");
+  if ((_gso || _gro) && socktype != "UDP")
+    return errh->error("GSO and GRO require a UDP socket");
+  if (_zerocopy && socktype != "TCP")
+    return errh->error("ZEROCOPY requires a TCP socket");
+#ifndef __linux__
+  if (_gso || _gro)
+    return errh->error("GSO and GRO not supported on this platform");
+  if (_zerocopy)
+    return errh->error("ZEROCOPY not supported on this platform");
+#endif
+  if (_gso > 65507)
+    return errh->error("GSO too large");
+  if (_gro && _snaplen < 65535)
+    _snaplen = 65535;
 
   if (allow && !(_allow = (IPRouteTable *)allow->cast("IPRouteTable")))
     return errh->error("%s is not an IPRouteTable", allow->name().c_str());
@@ -140,6 +204,9 @@ Socket::initialize_socket_error(ErrorHandler *errh, const char *syscall)
 int
 Socket::initialize(ErrorHandler *errh)
 {
+  if (_timestamp_auto)
+    _timestamp = router()->timestamp_required(this);
+
   // open socket, set options
   _fd = socket(_family, _socktype, _protocol);
   if (_fd < 0)
@@ -200,6 +267,27 @@ Socket::initialize(ErrorHandler *errh)
     if (setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &_rcvbuf, sizeof(_rcvbuf)) < 0)
       return initialize_socket_error(errh, "setsockopt(SO_RCVBUF)");
 
+#ifdef __linux__
+  // let the kernel segment and coalesce UDP datagrams
+  if (_gso) {
+    int gso = _gso;
+    if (setsockopt(_fd, IPPROTO_UDP, UDP_SEGMENT, &gso, sizeof(gso)) < 0)
+      return initialize_socket_error(errh, "setsockopt(UDP_SEGMENT)");
+  }
+  if (_gro) {
+    int one = 1;
+    if (setsockopt(_fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0)
+      return initialize_socket_error(errh, "setsockopt(UDP_GRO)");
+  }
+
+  // send from packet data
+  if (_zerocopy) {
+    int one = 1;
+    if (setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)
+      return initialize_socket_error(errh, "setsockopt(SO_ZEROCOPY)");
+  }
+#endif
+
   // if a server, then the first arguments should be interpreted as
   // the address/port/file to bind() to, not to connect() to
   if (!_client) {
@@ -252,6 +340,33 @@ Socket::initialize(ErrorHandler *errh)
   fcntl(_fd, F_SETFL, O_NONBLOCK);
   fcntl(_fd, F_SETFD, FD_CLOEXEC);
 
+#if SOCKET_ALLOW_MMSG
+  // message arrays for recvmmsg() and sendmmsg()
+  if (_socktype == SOCK_DGRAM && (_burst > 1 || _gso || _gro)) {
+    _rbufs = new WritablePacket *[_burst];
+    _rmsgs = new struct mmsghdr[_burst];
+    _riovs = new struct iovec[_burst];
+    _rfrom = new sockaddr_union[_burst];
+    _rcontrol = (_timestamp || _gro ? new char[_burst * control_len] : 0);
+    _wmsgs = new struct mmsghdr[_burst];
+    _wiovs = new struct iovec[_burst];
+    _wto = new sockaddr_union[_burst];
+    _wcount = new int[_burst];
+    memset(_rmsgs, 0, sizeof(struct mmsghdr) * _burst);
+    memset(_wmsgs, 0, sizeof(struct mmsghdr) * _burst);
+    for (int i = 0; i < _burst; ++i) {
+      _rbufs[i] = 0;
+      _rmsgs[i].msg_hdr.msg_iov = &_riovs[i];
+      _rmsgs[i].msg_hdr.msg_iovlen = 1;
+      if (!_client)
+	_rmsgs[i].msg_hdr.msg_name = &_rfrom[i];
+      if (_rcontrol)
+	_rmsgs[i].msg_hdr.msg_control = &_rcontrol[i * control_len];
+      _wmsgs[i].msg_hdr.msg_name = &_wto[i];
+    }
+  }
+#endif
+
   if (noutputs())
     add_select(_fd, SELECT_READ);
 
@@ -260,7 +375,8 @@ Socket::initialize(ErrorHandler *errh)
     _signal = Notifier::upstream_empty_signal(this, 0, &_task);
     add_select(_fd, SELECT_WRITE);
     _timer.initialize(this);
-  }
+  } else if (_zerocopy)
+    _timer.initialize(this);
 
   return 0;
 }
@@ -276,6 +392,25 @@ Socket::cleanup(CleanupStage)
     _rq->kill();
   if (_wq)
     _wq->kill();
+  zerocopy_release();
+#if SOCKET_ALLOW_MMSG
+  if (_rbufs)
+    for (int i = 0; i < _burst; ++i)
+      if (_rbufs[i])
+	_rbufs[i]->kill();
+  _wpending.kill();
+  delete[] _rbufs;
+  delete[] _rmsgs;
+  delete[] _riovs;
+  delete[] _rfrom;
+  delete[] _rcontrol;
+  delete[] _wmsgs;
+  delete[] _wiovs;
+  delete[] _wto;
+  delete[] _wcount;
+  _rbufs = 0;
+  _rmsgs = _wmsgs = 0;
+#endif
   if (_fd >= 0) {
     // shut down the listening socket in case we forked
 #ifdef SHUT_RDWR
@@ -313,6 +448,51 @@ Socket::close_active(void)
       click_chatter("%s: closed connection %d", declaration().c_str(), _active);
     _active = -1;
   }
+  zerocopy_release();
+}
+
+// Read MSG_ZEROCOPY completion notifications from the socket's error queue
+// and release the packets whose sends are complete.  TCP completes sends in
+// order, so each notification's range extends the completed prefix.
+void
+Socket::zerocopy_reap()
+{
+#ifdef __linux__
+  while (_active >= 0 && _zc_done != _zc_sends) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_control = control;
+    mh.msg_controllen = sizeof(control);
+    if (recvmsg(_active, &mh, MSG_ERRQUEUE) < 0)
+      break;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+      struct sock_extended_err ee;
+      memcpy(&ee, CMSG_DATA(c), sizeof(ee));
+      if (ee.ee_errno != 0 || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+	continue;
+      if ((int32_t) (ee.ee_data + 1 - _zc_done) > 0)
+	_zc_done = ee.ee_data + 1;
+      if (ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+	_zc_copied += ee.ee_data - ee.ee_info + 1;
+    }
+  }
+#endif
+  while (!_zc_held.empty() && (int32_t) (_zc_held.front().send - _zc_done) < 0) {
+    _zc_held.front().p->kill();
+    _zc_held.pop_front();
+  }
+}
+
+// Release all held packets when their connection goes away.
+void
+Socket::zerocopy_release()
+{
+  while (!_zc_held.empty()) {
+    _zc_held.front().p->kill();
+    _zc_held.pop_front();
+  }
+  _zc_sends = _zc_done = 0;
 }
 
 void
@@ -354,15 +534,29 @@ Socket::selected(int fd, int)
 
       fcntl(_active, F_SETFL, O_NONBLOCK);
       fcntl(_active, F_SETFD, FD_CLOEXEC);
+#ifdef __linux__
+      if (_zerocopy) {
+	int one = 1;
+	(void) setsockopt(_active, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+      }
+#endif
 
       add_select(_active, SELECT_READ | SELECT_WRITE);
       _events = SELECT_READ | SELECT_WRITE;
     }
 
     // read data from socket
-    if (!_rq)
-      _rq = Packet::make(_headroom, 0, _snaplen, 0);
-    if (_rq) {
+#if SOCKET_ALLOW_MMSG
+    if (_rmsgs) {
+      if (recv_burst() < 0 && errno != EAGAIN) {
+	if (_verbose)
+	  click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+	close_active();
+	return;
+      }
+    } else
+#endif
+    if (_rq || (_rq = Packet::make(_headroom, 0, _snaplen, 0))) {
       if (_socktype == SOCK_STREAM)
 	len = read(_active, _rq->data(), _rq->length());
       else if (_client)
@@ -417,6 +611,151 @@ Socket::selected(int fd, int)
     run_task(0);
 }
 
+#if SOCKET_ALLOW_MMSG
+int
+Socket::recv_burst()
+{
+  // refill the buffers the last call used
+  int n;
+  for (n = 0; n < _burst; ++n) {
+    if (!_rbufs[n] && !(_rbufs[n] = Packet::make(_headroom, 0, _snaplen, 0)))
+      break;
+    _riovs[n].iov_base = _rbufs[n]->data();
+    _riovs[n].iov_len = _rbufs[n]->length();
+    _rmsgs[n].msg_hdr.msg_namelen = (_client ? 0 : sizeof(sockaddr_union));
+    _rmsgs[n].msg_hdr.msg_controllen = (_rcontrol ? control_len : 0);
+  }
+  if (n == 0) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  int r = recvmmsg(_active, _rmsgs, n, MSG_DONTWAIT, 0);
+  if (r <= 0)
+    return r;
+  ++_recv_calls;
+
+  PacketBatch batch;
+  for (int i = 0; i < r; ++i) {
+    WritablePacket *p = _rbufs[i];
+    _rbufs[i] = 0;
+    struct msghdr *mh = &_rmsgs[i].msg_hdr;
+
+    if (!_client) {
+      // datagram server, find out who we are talking to
+      if (_family == AF_INET && !allowed(IPAddress(_rfrom[i].in.sin_addr))) {
+	if (_verbose)
+	  click_chatter("%s: dropped datagram from %s:%d", declaration().c_str(),
+			IPAddress(_rfrom[i].in.sin_addr).unparse().c_str(), ntohs(_rfrom[i].in.sin_port));
+	p->kill();
+	continue;
+      }
+      memcpy(&_remote, &_rfrom[i], mh->msg_namelen);
+      _remote_len = mh->msg_namelen;
+    }
+
+    // trim packet to actual length
+    p->take(p->length() - _rmsgs[i].msg_len);
+
+    // the kernel's timestamp, and segment size if it coalesced datagrams
+    int segment = 0;
+    Timestamp ts;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(mh); c; c = CMSG_NXTHDR(mh, c)) {
+#ifdef __linux__
+      if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO)
+	memcpy(&segment, CMSG_DATA(c), sizeof(segment));
+#endif
+#ifdef SCM_TIMESTAMP
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP) {
+	struct timeval tv;
+	memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+	ts = Timestamp(tv);
+      }
+#endif
+    }
+    if (_timestamp && !ts)
+      ts.assign_now();
+
+    // split coalesced datagrams; the pieces share p's buffer
+    while (segment > 0 && p->length() > (uint32_t) segment) {
+      Packet *q = p->clone();
+      if (!q)
+	break;
+      q->take(q->length() - segment);
+      p->pull(segment);
+      if (_timestamp)
+	q->timestamp_anno() = ts;
+      batch.push_back(q);
+    }
+    if (_timestamp)
+      p->timestamp_anno() = ts;
+    batch.push_back(p);
+  }
+
+  _recv_packets += batch.count();
+  if (!batch.empty())
+    output(0).push_batch(batch);
+  return r;
+}
+
+// Send packets from the front of batch with one sendmmsg(). Returns the
+// number of packets sent, or -1 with errno set.
+int
+Socket::send_burst(PacketBatch &batch)
+{
+  bool anno_dst = !IPAddress(_remote_ip) && _client && _family == AF_INET;
+  int m = 0, k = 0;
+  Packet *p = batch.front();
+
+  while (p && k < _burst) {
+    struct msghdr *mh = &_wmsgs[m].msg_hdr;
+    memcpy(&_wto[m], &_remote, _remote_len);
+    if (anno_dst)
+      // send to the packet's IP destination annotation address
+      _wto[m].in.sin_addr = p->dst_ip_anno();
+    mh->msg_namelen = _remote_len;
+    mh->msg_iov = &_wiovs[k];
+
+    // with GSO, gather a run of full segments, and one last shorter one,
+    // for the same destination into one datagram
+    int count = 0;
+    uint32_t length = 0;
+    while (1) {
+      _wiovs[k].iov_base = const_cast<unsigned char *>(p->data());
+      _wiovs[k].iov_len = p->length();
+      length += p->length();
+      ++k, ++count;
+      Packet *next = p->next();
+      bool gather = _gso && p->length() == _gso && next
+	&& next->length() <= _gso && k < _burst && count < max_gso_segments
+	&& length + next->length() <= max_udp_payload
+	&& (!anno_dst || next->dst_ip_anno() == p->dst_ip_anno());
+      p = next;
+      if (!gather)
+	break;
+    }
+    mh->msg_iovlen = count;
+    _wcount[m] = count;
+    ++m;
+  }
+
+  if (!m)
+    return 0;
+  int r = sendmmsg(_active, _wmsgs, m, 0);
+  if (r < 0)
+    return -1;
+  ++_send_calls;
+
+  int sent = 0;
+  for (int i = 0; i < r; ++i)
+    sent += _wcount[i];
+  _send_packets += sent;
+  for (int i = 0; i < sent; ++i)
+    batch.pop_front()->kill();
+  return sent;
+}
+#endif
+
 int
 Socket::write_packet(Packet *p)
 {
@@ -432,7 +771,11 @@ Socket::write_packet(Packet *p)
     }
 
     // write segment
-    if (_socktype == SOCK_STREAM)
+    if (_socktype == SOCK_STREAM && _zerocopy) {
+      len = send(_active, p->data(), p->length(), MSG_ZEROCOPY);
+      if (len > 0)
+	++_zc_sends;
+    } else if (_socktype == SOCK_STREAM)
       len = write(_active, p->data(), p->length());
     else
       len = sendto(_active, p->data(), p->length(), 0,
@@ -460,7 +803,14 @@ Socket::write_packet(Packet *p)
       p->pull(len);
   }
 
-  p->kill();
+  if (_zerocopy && _active >= 0) {
+    // the kernel may still read p's data
+    ZeroCopyHeld h;
+    h.p = p;
+    h.send = _zc_sends - 1;
+    _zc_held.push_back(h);
+  } else
+    p->kill();
   return 0;
 }
 
@@ -470,6 +820,21 @@ Socket::push(int, Packet *p)
   fd_set fds;
   int err;
 
+  if (_active >= 0 && _zerocopy) {
+    // wait for the kernel to release held packets
+    zerocopy_reap();
+    while (_active >= 0 && _zc_held.size() >= max_zerocopy_held) {
+      struct pollfd pfd;
+      pfd.fd = _active;
+      pfd.events = 0;
+      if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+	break;
+      zerocopy_reap();
+    }
+    if (!_timer.scheduled())
+      _timer.schedule_after_msec(1);
+  }
+
   if (_active >= 0) {
     // block
     do {
@@ -494,12 +859,83 @@ Socket::push(int, Packet *p)
     p->kill();
 }
 
+void
+Socket::push_batch(int port, PacketBatch &batch)
+{
+#if SOCKET_ALLOW_MMSG
+  if (_wmsgs) {
+    fd_set fds;
+    int err = 0;
+
+    while (_active >= 0 && !batch.empty()) {
+      // block
+      FD_ZERO(&fds);
+      FD_SET(_active, &fds);
+      err = select(_active + 1, NULL, &fds, NULL, NULL);
+
+      if (err >= 0)
+	err = send_burst(batch);
+
+      // connection probably terminated or other fatal error
+      if (err < 0 && errno != ENOBUFS && errno != EAGAIN && errno != EINTR) {
+	if (_verbose)
+	  click_chatter("%s: %s, dropping packets", declaration().c_str(), strerror(errno));
+	close_active();
+      }
+    }
+
+    batch.kill();
+    return;
+  }
+#endif
+
+  while (Packet *p = batch.pop_front())
+    push(port, p);
+}
+
 bool
 Socket::run_task(Task *)
 {
   assert(ninputs() && input_is_pull(0));
   bool any = false;
 
+#if SOCKET_ALLOW_MMSG
+  if (_wmsgs) {
+    if (_active < 0)
+      return false;
+
+    if (_wpending.count() < _burst)
+      input(0).pull_batch(_wpending, _burst - _wpending.count());
+    int r = 0;
+    if (!_wpending.empty() && (r = send_burst(_wpending)) < 0
+	&& errno != ENOBUFS && errno != EAGAIN && errno != EINTR) {
+      // connection probably terminated or other fatal error
+      if (_verbose)
+	click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+      close_active();
+      return false;
+    }
+
+    if (r < 0)
+      // send the pending packets when socket becomes available
+      add_select(_active, SELECT_WRITE);
+    else if (!_wpending.empty() || _signal)
+      _task.reschedule();
+    else
+      remove_select(_active, SELECT_WRITE);
+    return r > 0;
+  }
+#endif
+
+  if (_active >= 0 && _zerocopy) {
+    zerocopy_reap();
+    if (!_zc_held.empty() && !_timer.scheduled())
+      _timer.schedule_after_msec(1);
+    // run_timer() reschedules us when the kernel releases packets
+    if (_zc_held.size() >= max_zerocopy_held)
+      return false;
+  }
+
   if (_active >= 0) {
     Packet *p = 0;
     int err = 0;
@@ -512,9 +948,14 @@ Socket::run_task(Task *)
 	any = true;
 	err = write_packet(p);
       }
-    } while (p && err >= 0);
+    } while (p && err >= 0 && _zc_held.size() < max_zerocopy_held);
 
-    if (err < 0) {
+    if (_zc_held.size() >= max_zerocopy_held) {
+      // wait for completions
+      if (!_timer.scheduled())
+	_timer.schedule_after_msec(1);
+      remove_select(_active, SELECT_WRITE);
+    } else if (err < 0) {
       // queue packet for writing when socket becomes available
       _wq = p;
       p = 0;
@@ -532,10 +973,43 @@ Socket::run_task(Task *)
   return any;
 }
 
+void
+Socket::run_timer(Timer *)
+{
+  zerocopy_reap();
+  if (!_zc_held.empty())
+    _timer.schedule_after_msec(1);
+  if (ninputs() && input_is_pull(0) && _zc_held.size() < max_zerocopy_held
+      && _active >= 0)
+    _task.reschedule();
+}
+
+String
+Socket::read_handler(Element *e, void *thunk)
+{
+  Socket *s = static_cast<Socket *>(e);
+  switch ((intptr_t) thunk) {
+  case h_zc_pending:
+    return String(s->_zc_sends - s->_zc_done);
+  case h_zc_held:
+    return String(s->_zc_held.size());
+  default:
+    return String();
+  }
+}
+
 void
 Socket::add_handlers()
 {
   add_task_handlers(&_task);
+  add_data_handlers("recv_calls", Handler::OP_READ, &_recv_calls);
+  add_data_handlers("recv_packets", Handler::OP_READ, &_recv_packets);
+  add_data_handlers("send_calls", Handler::OP_READ, &_send_calls);
+  add_data_handlers("send_packets", Handler::OP_READ, &_send_packets);
+  add_data_handlers("zerocopy_sends", Handler::OP_READ, &_zc_sends);
+  add_read_handler("zerocopy_pending", read_handler, h_zc_pending);
+  add_read_handler("zerocopy_held", read_handler, h_zc_held);
+  add_data_handlers("zerocopy_copied", Handler::OP_READ, &_zc_copied);
 }
 
 CLICK_ENDDECLS
@@ -2,12 +2,15 @@
 #ifndef CLICK_SOCKET_HH
 #define CLICK_SOCKET_HH
 #include <click/element.hh>
+#include <click/deque.hh>
 #include <click/string.hh>
 #include <click/task.hh>
 #include <click/timer.hh>
 #include <click/notifier.hh>
+#include <click/packetbatch.hh>
 #include "../ip/iproutetable.hh"
 #include <sys/un.h>
+#include <sys/socket.h>
 CLICK_DECLS
 
 /*
@@ -103,8 +106,10 @@ sysctl and the maximum allowed value is set by the rmem_max sysctl.
 
 =item TIMESTAMP
 
-Boolean. If set, sets the timestamp field on received packets to the
-current time. Default is true.
+Boolean. If true, sets the timestamp field on received packets to the
+current time; if false, leaves it unset. By default, Socket sets it only if
+some element downstream reads timestamp annotations (see
+Router::timestamp_required).
 
 =item ALLOW
 
@@ -142,6 +147,42 @@ Boolean. PlanetLab specific. If true and Click has been configured
 
 Integer. Per-packet headroom. Defaults to 28.
 
+=item BURST
+
+Integer. Applies to datagram sockets only. If greater than 1, Socket
+receives up to BURST datagrams with one recvmmsg() call, into packet
+buffers it keeps allocated between calls, and emits them as one batch;
+it likewise sends up to BURST packets with one sendmmsg() call. A
+pull Socket pulls BURST packets at a time, and a push Socket sends
+pushed batches whole. Requires Linux with glibc 2.14 or later; elsewhere
+BURST is ignored. Default is 1.
+
+=item GSO
+
+Unsigned integer. Applies to UDP sockets on Linux only. If nonzero, sets
+the UDP_SEGMENT socket option, so the kernel splits each datagram sent
+into segments of GSO bytes. With BURST, Socket also gathers runs of up
+to 64 consecutive GSO-byte packets bound for the same destination
+(the last may be shorter) into one datagram of at most 65507 bytes, so
+one system call can send many segments. Default is 0.
+
+=item GRO
+
+Boolean. Applies to UDP sockets on Linux only. If true, sets the UDP_GRO
+socket option, so the kernel may coalesce datagrams from the same flow
+into one receive buffer; Socket splits them back into separate packets,
+which share the buffer. SNAPLEN is raised to 65535. Default is false.
+
+=item ZEROCOPY
+
+Boolean. Applies to TCP sockets on Linux only. If true, Socket sends with
+MSG_ZEROCOPY, so the kernel transmits straight from packet data instead
+of copying it into the socket buffer. Socket then holds each sent packet
+until the kernel's completion notification says it is done with the data,
+and stops taking new packets while 1024 are held. Packets are released
+when the connection closes. Zero-copy pays off for large packets; the
+kernel copies small sends anyway. Default is false.
+
 =back
 
 =e
@@ -167,8 +208,53 @@ Integer. Per-packet headroom. Defaults to 28.
   allow -> deny -> allow; // (makes the configuration valid)
   Socket(TCP, 0.0.0.0, 80, ALLOW allow, DENY deny) -> ...
 
+  // A UDP tunnel endpoint moving up to 32 datagrams per system call
+  ... -> Socket(UDP, 0.0.0.0, 4789, BURST 32, GRO true) -> ...
+
+=h recv_calls read-only
+
+Returns the number of recvmmsg() calls that returned datagrams, on a
+datagram socket with BURST, GSO or GRO set.
+
+=h recv_packets read-only
+
+Returns the number of packets emitted from those receive calls. Divide
+by recv_calls for the mean batch size.
+
+=h send_calls read-only
+
+Returns the number of successful sendmmsg() calls, on a datagram socket
+with BURST, GSO or GRO set.
+
+=h send_packets read-only
+
+Returns the number of packets sent by those send calls.
+
+=h zerocopy_sends read-only
+
+Returns the number of MSG_ZEROCOPY sends on the current connection.
+
+=h zerocopy_pending read-only
+
+Returns the number of those sends whose completions have not arrived yet.
+
+=h zerocopy_held read-only
+
+Returns the number of packets held until the kernel completes their sends.
+
+=h zerocopy_copied read-only
+
+Returns the number of completed sends for which the kernel copied the data
+after all.
+
 =a RawSocket */
 
+#if defined(__linux__) && defined(__USE_GNU) && defined(__GLIBC_PREREQ)
+# if __GLIBC_PREREQ(2, 14)
+#  define SOCKET_ALLOW_MMSG 1
+# endif
+#endif
+
 class Socket : public Element { public:
 
   Socket();
@@ -189,6 +275,8 @@ class Socket : public Element { public:
   bool run_task(Task *);
   void selected(int fd, int mask);
   void push(int port, Packet*);
+  void push_batch(int port, PacketBatch &batch);
+  void run_timer(Timer *);
 
   bool allowed(IPAddress);
   void close_active(void);
@@ -228,6 +316,7 @@ private:
   String _remote_pathname;	// for AF_UNIX, file to sendto()
 
   bool _timestamp;		// set the timestamp on received packets
+  bool _timestamp_auto;		// TIMESTAMP unset: decide in initialize()
   int _sndbuf;			// maximum socket send buffer in bytes
   int _rcvbuf;			// maximum socket receive buffer in bytes
   int _snaplen;			// maximum received packet length
@@ -239,6 +328,49 @@ private:
   IPRouteTable *_allow;		// lookup table of good hosts
   IPRouteTable *_deny;		// lookup table of bad hosts
 
+  int _burst;			// datagrams per recvmmsg()/sendmmsg()
+  unsigned _gso;		// UDP_SEGMENT size, or 0
+  bool _gro;			// set UDP_GRO
+  uint32_t _recv_calls;		// recvmmsg() calls
+  uint32_t _recv_packets;	// packets received by recvmmsg()
+  uint32_t _send_calls;		// sendmmsg() calls
+  uint32_t _send_packets;	// packets sent by sendmmsg()
+
+  struct ZeroCopyHeld {
+    Packet *p;
+    uint32_t send;		// last MSG_ZEROCOPY send that used p
+  };
+  enum { max_zerocopy_held = 1024 };
+  bool _zerocopy;		// send with MSG_ZEROCOPY
+  uint32_t _zc_sends;		// MSG_ZEROCOPY sends on _active
+  uint32_t _zc_done;		// sends before this are complete
+  uint32_t _zc_copied;		// completions the kernel copied
+  Deque<ZeroCopyHeld> _zc_held;	// packets the kernel may still read
+
+  enum { h_zc_pending, h_zc_held };
+
+  void zerocopy_reap();
+  void zerocopy_release();
+  static String read_handler(Element *, void *);
+
+#if SOCKET_ALLOW_MMSG
+  typedef union { struct sockaddr_in in; struct sockaddr_un un; } sockaddr_union;
+
+  WritablePacket **_rbufs;	// preallocated receive buffers
+  struct mmsghdr *_rmsgs;
+  struct iovec *_riovs;
+  sockaddr_union *_rfrom;	// datagram sources
+  char *_rcontrol;		// UDP_GRO and SO_TIMESTAMP messages
+  struct mmsghdr *_wmsgs;
+  struct iovec *_wiovs;
+  sockaddr_union *_wto;		// datagram destinations
+  int *_wcount;			// packets gathered into each datagram
+  PacketBatch _wpending;	// pulled packets not yet sent
+
+  int recv_burst();
+  int send_burst(PacketBatch &batch);
+#endif
+
   int initialize_socket_error(ErrorHandler *, const char *);
 
 };
@@ -0,0 +1,218 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * socketfilter.{cc,hh} -- compile IPFilter expressions to socket filters
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "socketfilter.hh"
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include "elements/ip/ipfilter.hh"
+#include <sys/socket.h>
+CLICK_DECLS
+
+namespace {
+
+enum { accept_length = 0xFFFF };
+
+struct sock_filter
+make_insn(uint16_t code, uint32_t k, uint8_t jt = 0, uint8_t jf = 0)
+{
+    struct sock_filter insn;
+    insn.code = code;
+    insn.jt = jt;
+    insn.jf = jf;
+    insn.k = k;
+    return insn;
+}
+
+// Collect the values a compressed IPFilter test compares against.
+void
+test_values(const uint32_t *pr, Vector<uint32_t> &values)
+{
+    values.clear();
+    unsigned nvalues = pr[0] >> 17;
+    if (nvalues)
+	for (unsigned i = 0; i < nvalues; ++i)
+	    values.push_back(pr[4 + i]);
+    else
+	for (uint32_t i = 0; i < (1U << pr[4]); ++i)
+	    if (pr[6 + i] != pr[5])
+		values.push_back(pr[6 + i]);
+}
+
+}
+
+int
+socket_filter_compile(const String &expr, Vector<struct sock_filter> &prog,
+		      const Element *context, ErrorHandler *errh)
+{
+    typedef IPFilter::IPFilterProgram IPFilterProgram;
+    Vector<String> conf;
+    conf.push_back("allow " + expr);
+    IPFilterProgram zprog;
+    int before = errh->nerrors();
+    IPFilter::parse_program(zprog, conf, 1, context, errh);
+    if (errh->nerrors() != before)
+	return -1;
+
+    prog.clear();
+    if (zprog.output_everything() >= 0) {
+	prog.push_back(make_insn(BPF_RET | BPF_K, zprog.output_everything() == 0 ? accept_length : 0));
+	return 0;
+    }
+
+    // Each test becomes: load the word; mask it; one jeq per value, whose
+    // jt goes to the test's "yes" target and whose jf falls through to the
+    // next jeq, or, for the last jeq, goes to the "no" target.  jt and jf
+    // reach at most 255 instructions, so a target further away is reached
+    // through a "ja" trampoline after the jeqs.  IPFilter jumps only
+    // forward, so the tests are laid out from the last to the first, each
+    // test's position counted back from the end of the program.
+    const uint32_t *zbegin = zprog.begin(), *zend = zprog.end();
+    Vector<const uint32_t *> tests;
+    for (const uint32_t *pr = zbegin; pr < zend; pr += IPFilterProgram::insn_words(pr)) {
+	if ((int16_t) pr[0] < IPFilter::offset_net)
+	    return errh->error("filter cannot test link-level headers");
+	tests.push_back(pr);
+    }
+
+    // rpos[i]: test i's first instruction, counted back from the end; the
+    // program ends with "ret accept" (rpos 2) and "ret reject" (rpos 1)
+    Vector<int> rpos(zend - zbegin + 1, 0);
+    Vector<int> tramp(tests.size(), 0);
+    Vector<uint32_t> values;
+    int end = 2;
+    for (int t = tests.size() - 1; t >= 0; --t) {
+	const uint32_t *pr = tests[t];
+	test_values(pr, values);
+	if (values.size() > 250)
+	    return errh->error("filter test has too many values");
+	int target[2];
+	for (int j = 0; j < 2; ++j) {
+	    int32_t jump = pr[1 + j];
+	    target[j] = (jump <= 0 ? (jump == 0 ? 2 : 1) : rpos[pr - zbegin + jump]);
+	}
+	// bit 0: "ja no" trampoline; bit 1: "ja yes" trampoline
+	int tr = values.size() ? 0 : 1;
+	for (int round = 0; round < 2; ++round) {
+	    int ntr = (tr & 1) + (tr >> 1), last = end + ntr + 1;
+	    if (values.size() && !(tr & 2) && last + values.size() - 2 - target[1] > 255)
+		tr |= 2;
+	    if (values.size() && !(tr & 1) && last - 1 - target[0] > 255)
+		tr |= 1;
+	}
+	tramp[t] = tr;
+	int off = (int16_t) pr[0];
+	end += (off >= IPFilter::offset_transp ? 2 : 1) + (pr[3] != 0xFFFFFFFFU)
+	    + values.size() + (tr & 1) + (tr >> 1);
+	rpos[pr - zbegin] = end;
+	if (end > BPF_MAXINSNS)
+	    return errh->error("filter too large");
+    }
+    int ninsn = end;
+
+    for (int t = 0; t < tests.size(); ++t) {
+	const uint32_t *pr = tests[t];
+	int off = (int16_t) pr[0];
+	int target[2];
+	for (int j = 0; j < 2; ++j) {
+	    int32_t jump = pr[1 + j];
+	    int r = (jump <= 0 ? (jump == 0 ? 2 : 1) : rpos[pr - zbegin + jump]);
+	    target[j] = ninsn - r;
+	}
+
+	if (off >= IPFilter::offset_transp) {
+	    // X = IP header length
+	    prog.push_back(make_insn(BPF_LDX | BPF_B | BPF_MSH, 0));
+	    prog.push_back(make_insn(BPF_LD | BPF_W | BPF_IND, off - IPFilter::offset_transp));
+	} else
+	    prog.push_back(make_insn(BPF_LD | BPF_W | BPF_ABS, off - IPFilter::offset_net));
+	// BPF loads words in network byte order
+	if (pr[3] != 0xFFFFFFFFU)
+	    prog.push_back(make_insn(BPF_ALU | BPF_AND | BPF_K, ntohl(pr[3])));
+
+	test_values(pr, values);
+	int tramp_no = prog.size() + values.size();
+	int tramp_yes = tramp_no + (tramp[t] & 1);
+	int yes = (tramp[t] & 2 ? tramp_yes : target[1]);
+	int no = (tramp[t] & 1 ? tramp_no : target[0]);
+	for (int i = 0; i < values.size(); ++i) {
+	    int here = prog.size();
+	    prog.push_back(make_insn(BPF_JMP | BPF_JEQ | BPF_K, ntohl(values[i]),
+				     yes - here - 1,
+				     i == values.size() - 1 ? no - here - 1 : 0));
+	}
+	if (tramp[t] & 1)
+	    prog.push_back(make_insn(BPF_JMP | BPF_JA, target[0] - tramp_no - 1));
+	if (tramp[t] & 2)
+	    prog.push_back(make_insn(BPF_JMP | BPF_JA, target[1] - tramp_yes - 1));
+    }
+    assert(prog.size() == ninsn - 2);
+
+    prog.push_back(make_insn(BPF_RET | BPF_K, accept_length));
+    prog.push_back(make_insn(BPF_RET | BPF_K, 0));
+    return 0;
+}
+
+int
+socket_filter_attach(int fd, const Vector<struct sock_filter> &prog)
+{
+    struct sock_fprog fprog;
+    fprog.len = prog.size();
+    fprog.filter = const_cast<struct sock_filter *>(prog.begin());
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+}
+
+String
+socket_filter_unparse(const Vector<struct sock_filter> &prog)
+{
+    StringAccum sa;
+    for (int i = 0; i < prog.size(); ++i) {
+	const struct sock_filter &insn = prog[i];
+	sa.snprintf(16, "(%03d) ", i);
+	switch (insn.code) {
+	case BPF_LD | BPF_W | BPF_ABS:
+	    sa << "ld       [" << insn.k << "]";
+	    break;
+	case BPF_LD | BPF_W | BPF_IND:
+	    sa << "ld       [x + " << insn.k << "]";
+	    break;
+	case BPF_LDX | BPF_B | BPF_MSH:
+	    sa << "ldxb     4*([" << insn.k << "]&0xf)";
+	    break;
+	case BPF_ALU | BPF_AND | BPF_K:
+	    sa.snprintf(32, "and      #0x%x", insn.k);
+	    break;
+	case BPF_JMP | BPF_JEQ | BPF_K:
+	    sa.snprintf(64, "jeq      #0x%x           jt %d\tjf %d", insn.k,
+			i + 1 + insn.jt, i + 1 + insn.jf);
+	    break;
+	case BPF_JMP | BPF_JA:
+	    sa << "ja       " << (i + 1 + insn.k);
+	    break;
+	case BPF_RET | BPF_K:
+	    sa << "ret      #" << insn.k;
+	    break;
+	default:
+	    sa.snprintf(32, "code 0x%x k %u", insn.code, insn.k);
+	    break;
+	}
+	sa << '\n';
+    }
+    return sa.take_string();
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel linux IPFilter)
+ELEMENT_PROVIDES(SocketFilter)
@@ -0,0 +1,27 @@
+#ifndef CLICK_SOCKETFILTER_HH
+#define CLICK_SOCKETFILTER_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <linux/filter.h>
+CLICK_DECLS
+class Element;
+class ErrorHandler;
+
+/* Compile the IPFilter expression expr, such as "udp dst port 53", into a
+ * classic BPF program for a raw IPv4 socket, whose packets start with the
+ * IP header.  The program accepts packets that match expr.  Tests on
+ * link-level headers are errors.  Unlike IPFilter, the program rejects
+ * packets too short for a test it makes.  Returns 0 on success, or -1 after
+ * reporting errors to errh in context. */
+int socket_filter_compile(const String &expr, Vector<struct sock_filter> &prog,
+			  const Element *context, ErrorHandler *errh);
+
+/* Attach prog to socket fd with SO_ATTACH_FILTER.  Returns 0 on success,
+ * or -1 with errno set. */
+int socket_filter_attach(int fd, const Vector<struct sock_filter> &prog);
+
+/* Return prog as text, one instruction per line, as tcpdump -d would. */
+String socket_filter_unparse(const Vector<struct sock_filter> &prog);
+
+CLICK_ENDDECLS
+#endif
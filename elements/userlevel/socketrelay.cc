@@ -0,0 +1,321 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * socketrelay.{cc,hh} -- relays TCP connections with splice()
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "socketrelay.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+CLICK_DECLS
+
+SocketRelay::SocketRelay()
+    : _fd(-1), _port(0), _remote_port(0), _pipe_size(0), _maxconn(256),
+      _verbose(false), _accepting(false), _nactive(0), _connections(0),
+      _bytes(0), _pipe_bytes(0)
+{
+}
+
+SocketRelay::~SocketRelay()
+{
+}
+
+int
+SocketRelay::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read_mp("ADDR", _addr)
+	.read_mp("PORT", IPPortArg(IP_PROTO_TCP), _port)
+	.read_mp("REMOTE_ADDR", _remote_addr)
+	.read_mp("REMOTE_PORT", IPPortArg(IP_PROTO_TCP), _remote_port)
+	.read("PIPE_SIZE", _pipe_size)
+	.read("MAXCONN", _maxconn)
+	.read("VERBOSE", _verbose)
+	.complete() < 0)
+	return -1;
+    if (_maxconn == 0)
+	return errh->error("MAXCONN must be positive");
+    return 0;
+}
+
+int
+SocketRelay::initialize(ErrorHandler *errh)
+{
+    _fd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (_fd < 0)
+	return errh->error("socket: %s", strerror(errno));
+    int one = 1;
+    (void) setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(_port);
+    sin.sin_addr = _addr.in_addr();
+    if (bind(_fd, (struct sockaddr *) &sin, sizeof(sin)) < 0)
+	return errh->error("bind: %s", strerror(errno));
+    if (listen(_fd, 128) < 0)
+	return errh->error("listen: %s", strerror(errno));
+
+    fcntl(_fd, F_SETFL, O_NONBLOCK);
+    fcntl(_fd, F_SETFD, FD_CLOEXEC);
+    add_select(_fd, SELECT_READ);
+    _accepting = true;
+    return 0;
+}
+
+void
+SocketRelay::cleanup(CleanupStage)
+{
+    for (int fd = 0; fd < _relays.size(); ++fd)
+	if (Relay *r = _relays[fd])
+	    close_relay(r);
+    if (_fd >= 0) {
+	remove_select(_fd, SELECT_READ);
+	close(_fd);
+	_fd = -1;
+    }
+}
+
+SocketRelay::Relay *
+SocketRelay::open_relay(int fd)
+{
+    Relay *r = new Relay;
+    r->fd[0] = fd;
+    r->fd[1] = -1;
+    for (int d = 0; d < 2; ++d) {
+	r->pipe[d][0] = r->pipe[d][1] = -1;
+	r->inpipe[d] = 0;
+	r->eof[d] = r->shut[d] = false;
+	r->mask[d] = 0;
+    }
+    r->connecting = true;
+
+    const char *syscall = "socket";
+    if ((r->fd[1] = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+	goto error;
+    fcntl(r->fd[1], F_SETFL, O_NONBLOCK);
+    fcntl(r->fd[1], F_SETFD, FD_CLOEXEC);
+
+    syscall = "pipe";
+    for (int d = 0; d < 2; ++d)
+	if (pipe2(r->pipe[d], O_NONBLOCK | O_CLOEXEC) < 0)
+	    goto error;
+    if (_pipe_size)
+	for (int d = 0; d < 2; ++d)
+	    (void) fcntl(r->pipe[d][1], F_SETPIPE_SZ, (int) _pipe_size);
+    {
+	int capacity = fcntl(r->pipe[0][1], F_GETPIPE_SZ);
+	r->capacity = (capacity > 0 ? capacity : 65536);
+    }
+
+    {
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(_remote_port);
+	sin.sin_addr = _remote_addr.in_addr();
+	syscall = "connect";
+	if (connect(r->fd[1], (struct sockaddr *) &sin, sizeof(sin)) < 0
+	    && errno != EINPROGRESS)
+	    goto error;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+	if (r->fd[i] >= _relays.size())
+	    _relays.resize(r->fd[i] + 1, 0);
+	_relays[r->fd[i]] = r;
+    }
+    ++_nactive;
+    // wait for the connection to REMOTE
+    set_mask(r, 1, SELECT_WRITE);
+    return r;
+
+  error:
+    click_chatter("%s: %s: %s", declaration().c_str(), syscall, strerror(errno));
+    for (int d = 0; d < 2; ++d) {
+	if (r->fd[d] >= 0)
+	    close(r->fd[d]);
+	if (r->pipe[d][0] >= 0) {
+	    close(r->pipe[d][0]);
+	    close(r->pipe[d][1]);
+	}
+    }
+    delete r;
+    return 0;
+}
+
+void
+SocketRelay::close_relay(Relay *r)
+{
+    for (int i = 0; i < 2; ++i) {
+	set_mask(r, i, 0);
+	_relays[r->fd[i]] = 0;
+	close(r->fd[i]);
+	_pipe_bytes -= r->inpipe[i];
+	close(r->pipe[i][0]);
+	close(r->pipe[i][1]);
+    }
+    if (_verbose)
+	click_chatter("%s: closed connection %d", declaration().c_str(), r->fd[0]);
+    delete r;
+    --_nactive;
+    if (!_accepting && _fd >= 0) {
+	add_select(_fd, SELECT_READ);
+	_accepting = true;
+    }
+}
+
+void
+SocketRelay::set_mask(Relay *r, int i, int mask)
+{
+    if (mask & ~r->mask[i])
+	add_select(r->fd[i], mask & ~r->mask[i]);
+    if (r->mask[i] & ~mask)
+	remove_select(r->fd[i], r->mask[i] & ~mask);
+    r->mask[i] = mask;
+}
+
+void
+SocketRelay::accept_connections()
+{
+    while (_nactive < _maxconn) {
+	struct sockaddr_in from;
+	socklen_t from_len = sizeof(from);
+	int fd = accept(_fd, (struct sockaddr *) &from, &from_len);
+	if (fd < 0) {
+	    if (errno != EAGAIN && errno != EINTR)
+		click_chatter("%s: accept: %s", declaration().c_str(), strerror(errno));
+	    return;
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	++_connections;
+	if (_verbose)
+	    click_chatter("%s: opened connection %d from %s:%d", declaration().c_str(),
+			  fd, IPAddress(from.sin_addr).unparse().c_str(), ntohs(from.sin_port));
+	open_relay(fd);
+    }
+
+    // stop accepting until a connection closes
+    remove_select(_fd, SELECT_READ);
+    _accepting = false;
+}
+
+// Move what data we can in direction d.  Returns false on a fatal error.
+bool
+SocketRelay::move(Relay *r, int d)
+{
+    const unsigned flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+    while (1) {
+	bool progress = false;
+	if (!r->eof[d] && r->inpipe[d] < r->capacity) {
+	    ssize_t n = splice(r->fd[d], 0, r->pipe[d][1], 0,
+			       r->capacity - r->inpipe[d], flags);
+	    if (n > 0) {
+		r->inpipe[d] += n;
+		_pipe_bytes += n;
+		progress = true;
+	    } else if (n == 0)
+		r->eof[d] = true;
+	    else if (errno != EAGAIN && errno != EINTR)
+		return false;
+	}
+	if (r->inpipe[d] > 0) {
+	    ssize_t n = splice(r->pipe[d][0], 0, r->fd[1 - d], 0,
+			       r->inpipe[d], flags);
+	    if (n > 0) {
+		r->inpipe[d] -= n;
+		_pipe_bytes -= n;
+		_bytes += n;
+		progress = true;
+	    } else if (n < 0 && errno != EAGAIN && errno != EINTR)
+		return false;
+	}
+	if (!progress)
+	    break;
+    }
+
+    // pass on the end of the data
+    if (r->eof[d] && r->inpipe[d] == 0 && !r->shut[d]) {
+	shutdown(r->fd[1 - d], SHUT_WR);
+	r->shut[d] = true;
+    }
+    return true;
+}
+
+void
+SocketRelay::pump(Relay *r)
+{
+    if (!move(r, 0) || !move(r, 1) || (r->shut[0] && r->shut[1])) {
+	close_relay(r);
+	return;
+    }
+
+    // read from a side while its pipe has room, write to a side while the
+    // other side's pipe has data
+    for (int i = 0; i < 2; ++i) {
+	int mask = 0;
+	if (!r->eof[i] && r->inpipe[i] < r->capacity)
+	    mask |= SELECT_READ;
+	if (r->inpipe[1 - i] > 0)
+	    mask |= SELECT_WRITE;
+	set_mask(r, i, mask);
+    }
+}
+
+void
+SocketRelay::selected(int fd, int)
+{
+    if (fd == _fd) {
+	accept_connections();
+	return;
+    }
+    Relay *r = (fd < _relays.size() ? _relays[fd] : 0);
+    if (!r)
+	return;
+
+    if (r->connecting) {
+	int err = 0;
+	socklen_t len = sizeof(err);
+	if (getsockopt(r->fd[1], SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+	    err = errno;
+	if (err == EINPROGRESS || err == EALREADY)
+	    return;
+	if (err) {
+	    click_chatter("%s: connect: %s", declaration().c_str(), strerror(err));
+	    close_relay(r);
+	    return;
+	}
+	r->connecting = false;
+    }
+
+    pump(r);
+}
+
+void
+SocketRelay::add_handlers()
+{
+    add_data_handlers("connections", Handler::OP_READ, &_connections);
+    add_data_handlers("active", Handler::OP_READ, &_nactive);
+    add_data_handlers("bytes", Handler::OP_READ, &_bytes);
+    add_data_handlers("pipe_bytes", Handler::OP_READ, &_pipe_bytes);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel linux)
+EXPORT_ELEMENT(SocketRelay)
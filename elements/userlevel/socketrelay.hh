@@ -0,0 +1,135 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SOCKETRELAY_HH
+#define CLICK_SOCKETRELAY_HH
+#include <click/element.hh>
+#include <click/ipaddress.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SocketRelay(ADDR, PORT, REMOTE_ADDR, REMOTE_PORT [, I<keywords> PIPE_SIZE, MAXCONN, VERBOSE])
+
+=s comm
+
+relays TCP connections with splice() (user-level)
+
+=d
+
+Accepts TCP connections on ADDR and PORT, connects each one to REMOTE_ADDR and
+REMOTE_PORT, and relays the data in both directions until both sides have
+closed.  SocketRelay moves the data with splice() through a pair of pipes per
+connection, so the kernel hands socket buffers from one connection to the
+other without copying them into Click; no packets are created.  This suits
+forwarding proxies that do not look at the data.  When one side shuts down
+its half of the connection, SocketRelay shuts down the other side's half
+after relaying the rest of its data.
+
+SocketRelay has no ports.  Linux only.
+
+Keyword arguments are:
+
+=over 8
+
+=item PIPE_SIZE
+
+Unsigned integer.  Capacity of each pipe in bytes, set with F_SETPIPE_SZ; the
+kernel may round it up.  At most this many bytes are in flight in each
+direction of a connection.  Default is the system's pipe capacity, usually
+65536.
+
+=item MAXCONN
+
+Unsigned integer.  The maximum number of connections relayed at once.  While
+that many are open, SocketRelay accepts no more.  Default is 256.
+
+=item VERBOSE
+
+Boolean.  If true, print a message when a connection opens or closes.
+Default is false.
+
+=back
+
+=e
+
+  // A transparent proxy in front of a web server
+  SocketRelay(0.0.0.0, 8080, 10.0.0.2, 80, MAXCONN 1024);
+
+=h connections read-only
+
+Returns the number of connections accepted.
+
+=h active read-only
+
+Returns the number of connections being relayed.
+
+=h bytes read-only
+
+Returns the number of bytes relayed, in both directions.
+
+=h pipe_bytes read-only
+
+Returns the number of bytes spliced into the pipes but not yet out of them,
+summed over all connections: data read from one side that the other side's
+socket buffer has not yet accepted.
+
+=a Socket */
+
+class SocketRelay : public Element { public:
+
+    SocketRelay();
+    ~SocketRelay();
+
+    const char *class_name() const	{ return "SocketRelay"; }
+    const char *port_count() const	{ return PORTS_0_0; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void selected(int fd, int mask);
+
+  private:
+
+    // Direction d carries data from fd[d] through pipe[d] to fd[1 - d];
+    // fd[0] is the accepted connection, fd[1] the one to REMOTE.
+    struct Relay {
+	int fd[2];
+	int pipe[2][2];
+	uint32_t capacity;	// pipe capacity
+	uint32_t inpipe[2];	// bytes in pipe[d]
+	bool eof[2];		// fd[d] has no more data
+	bool shut[2];		// fd[1 - d] shut down for writing
+	int mask[2];		// select mask registered for fd[d]
+	bool connecting;	// fd[1]'s connect() in progress
+    };
+
+    int _fd;
+    IPAddress _addr;
+    uint16_t _port;
+    IPAddress _remote_addr;
+    uint16_t _remote_port;
+    uint32_t _pipe_size;
+    uint32_t _maxconn;
+    bool _verbose;
+    bool _accepting;
+
+    Vector<Relay *> _relays;	// indexed by file descriptor
+    uint32_t _nactive;
+    uint32_t _connections;
+    uint64_t _bytes;
+    uint64_t _pipe_bytes;
+
+    void accept_connections();
+    Relay *open_relay(int fd);
+    void close_relay(Relay *r);
+    bool move(Relay *r, int d);
+    void pump(Relay *r);
+    void set_mask(Relay *r, int i, int mask);
+
+};
+
+CLICK_ENDDECLS
+#endif
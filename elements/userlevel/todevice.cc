@@ -32,6 +32,7 @@
 #include <click/standard/scheduleinfo.hh>
 #include <click/packet_anno.hh>
 #include <click/straccum.hh>
+#include <click/master.hh>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -58,7 +59,7 @@
 CLICK_DECLS
 
 ToDevice::ToDevice()
-    : _task(this), _timer(&_task), _q(0), _pulls(0)
+    : _task(this), _timer(&_task), _nqueues(1)
 {
 #if TODEVICE_ALLOW_PCAP
     _pcap = 0;
@@ -66,7 +67,6 @@ ToDevice::ToDevice()
 #endif
 #if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD
     _fd = -1;
-    _my_fd = false;
 #endif
 }
 
@@ -79,17 +79,27 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     String method;
     _burst = 1;
+    _nqueues = 1;
     if (Args(conf, this, errh)
 	.read_mp("DEVNAME", _ifname)
 	.read("DEBUG", _debug)
 	.read("METHOD", WordArg(), method)
 	.read("BURST", _burst)
+	.read("QUEUES", _nqueues)
 	.complete() < 0)
 	return -1;
     if (!_ifname)
 	return errh->error("interface not set");
     if (_burst <= 0)
 	return errh->error("bad BURST");
+#if TODEVICE_ALLOW_LINUX
+    if (method == "" && _nqueues > 1)
+	method = "LINUX";
+#endif
+    if (_nqueues <= 0 || _nqueues > 1024)
+	return errh->error("bad QUEUES");
+    if (ninputs() != _nqueues)
+	return errh->error("QUEUES %d requires %d inputs", _nqueues, _nqueues);
 
     if (method == "") {
 #if TODEVICE_ALLOW_PCAP && TODEVICE_ALLOW_LINUX
@@ -128,6 +138,8 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     else
 	return errh->error("bad METHOD");
 
+    if (_nqueues > 1 && _method != method_linux)
+	return errh->error("QUEUES requires METHOD LINUX");
     return 0;
 }
 
@@ -160,21 +172,53 @@ ToDevice::initialize(ErrorHandler *errh)
 	    _my_pcap = true;
 	}
 	_fd = pcap_fileno(_pcap);
-	/* _my_fd = false by default */
     }
 #endif
 
+    int home = router()->home_thread_id(this);
+    int nthreads = master()->nthreads();
+    for (int qi = 0; qi < _nqueues; ++qi) {
+	Queue *q = new Queue;
+	_queues.push_back(q);
+	if (qi == 0) {
+	    q->task = &_task;
+	    q->timer = &_timer;
+	} else {
+	    q->task = new Task(this);
+	    q->timer = new Timer(q->task);
+	    q->timer->initialize(this);
+	}
+	q->thread_id = (home < 0 ? home : (home + qi) % nthreads);
+	q->fd = -1;
+	q->my_fd = false;
+	q->q = 0;
+	q->backoff = 0;
+	q->pulls = 0;
+#if TODEVICE_ALLOW_SENDMMSG
+	q->msgs = 0;
+	q->iovs = 0;
+	q->bursts = q->burst_packets = q->partial_bursts = 0;
+#endif
+    }
+    Queue &q0 = *_queues[0];
+
+#if TODEVICE_ALLOW_PCAP
+    if (_method == method_pcap)
+	q0.fd = _fd;
+#endif
+
 #if TODEVICE_ALLOW_DEVBPF
     if (_method == method_devbpf) {
 	/* pcap_open_live() doesn't open for writing. */
-	for (int i = 0; i < 16 && _fd < 0; i++) {
+	for (int i = 0; i < 16 && q0.fd < 0; i++) {
 	    char tmp[64];
 	    sprintf(tmp, "/dev/bpf%d", i);
-	    _fd = open(tmp, 1);
+	    q0.fd = open(tmp, 1);
 	}
-	if (_fd < 0)
+	if (q0.fd < 0)
 	    return(errh->error("open /dev/bpf* for write: %s", strerror(errno)));
-	_my_fd = true;
+	q0.my_fd = true;
+	_fd = q0.fd;
 
 	struct ifreq ifr;
 	strncpy(ifr.ifr_name, _ifname.c_str(), sizeof(ifr.ifr_name));
@@ -192,14 +236,18 @@ ToDevice::initialize(ErrorHandler *errh)
 #if TODEVICE_ALLOW_LINUX
     if (_method == method_linux) {
 	FromDevice *fd = find_fromdevice();
-	if (fd && fd->linux_fd() >= 0)
-	    _fd = fd->linux_fd();
-	else {
-	    _fd = FromDevice::open_packet_socket(_ifname, errh);
-	    if (_fd < 0)
-		return -1;
-	    _my_fd = true;
+	for (int qi = 0; qi < _nqueues; ++qi) {
+	    Queue &q = *_queues[qi];
+	    if (fd && fd->linux_fd(qi) >= 0)
+		q.fd = fd->linux_fd(qi);
+	    else {
+		q.fd = FromDevice::open_packet_socket(_ifname, errh);
+		if (q.fd < 0)
+		    return -1;
+		q.my_fd = true;
+	    }
 	}
+	_fd = q0.fd;
     }
 #endif
 
@@ -207,7 +255,7 @@ ToDevice::initialize(ErrorHandler *errh)
     if (_method == method_pcapfd) {
 	FromDevice *fd = find_fromdevice();
 	if (fd && fd->pcap())
-	    _fd = fd->fd();
+	    _fd = q0.fd = fd->fd();
 	else
 	    return errh->error("initialized FromDevice required on this platform");
     }
@@ -219,8 +267,24 @@ ToDevice::initialize(ErrorHandler *errh)
 	return errh->error("duplicate writer for device %<%s%>", _ifname.c_str());
     used = this;
 
-    ScheduleInfo::join_scheduler(this, &_task, errh);
-    _signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    for (int qi = 0; qi < _nqueues; ++qi) {
+	Queue &q = *_queues[qi];
+#if TODEVICE_ALLOW_SENDMMSG
+	if (_method == method_linux && _burst > 1) {
+	    q.msgs = new struct mmsghdr[_burst];
+	    q.iovs = new struct iovec[_burst];
+	    memset(q.msgs, 0, sizeof(struct mmsghdr) * _burst);
+	    for (int i = 0; i < _burst; ++i) {
+		q.msgs[i].msg_hdr.msg_iov = &q.iovs[i];
+		q.msgs[i].msg_hdr.msg_iovlen = 1;
+	    }
+	}
+#endif
+	ScheduleInfo::join_scheduler(this, q.task, errh);
+	if (qi > 0)
+	    q.task->move_thread(q.thread_id);
+	q.signal = Notifier::upstream_empty_signal(this, qi, q.task);
+    }
     return 0;
 }
 
@@ -232,9 +296,25 @@ ToDevice::cleanup(CleanupStage)
 	pcap_close(_pcap);
     _pcap = 0;
 #endif
+    for (int qi = 0; qi < _queues.size(); ++qi) {
+	Queue *q = _queues[qi];
+	if (q->fd >= 0 && q->my_fd)
+	    close(q->fd);
+	if (q->q)
+	    q->q->kill();
+#if TODEVICE_ALLOW_SENDMMSG
+	q->pending.kill();
+	delete[] q->msgs;
+	delete[] q->iovs;
+#endif
+	if (qi > 0) {
+	    delete q->timer;
+	    delete q->task;
+	}
+	delete q;
+    }
+    _queues.clear();
 #if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD
-    if (_fd >= 0 && _my_fd)
-	close(_fd);
     _fd = -1;
 #endif
 }
@@ -251,7 +331,7 @@ ToDevice::cleanup(CleanupStage)
  * --jbicket
  */
 int
-ToDevice::send_packet(Packet *p)
+ToDevice::send_packet(Queue &q, Packet *p)
 {
     int r = 0;
     errno = 0;
@@ -268,42 +348,119 @@ ToDevice::send_packet(Packet *p)
 
 #if TODEVICE_ALLOW_LINUX
     if (_method == method_linux)
-	r = send(_fd, p->data(), p->length(), 0);
+	r = send(q.fd, p->data(), p->length(), 0);
 #endif
 
 #if TODEVICE_ALLOW_DEVBPF
     if (_method == method_devbpf)
-	if (write(_fd, p->data(), p->length()) != (ssize_t) p->length())
+	if (write(q.fd, p->data(), p->length()) != (ssize_t) p->length())
 	    r = -1;
 #endif
 
 #if TODEVICE_ALLOW_PCAPFD
     if (_method == method_pcapfd)
-	if (write(_fd, p->data(), p->length()) != (ssize_t) p->length())
+	if (write(q.fd, p->data(), p->length()) != (ssize_t) p->length())
 	    r = -1;
 #endif
 
+    (void) q;
     if (r >= 0)
 	return 0;
     else
 	return errno ? -errno : -EINVAL;
 }
 
+void
+ToDevice::backoff(Queue &q)
+{
+    if (!q.backoff) {
+	q.backoff = 1;
+	master()->thread(q.thread_id)->select_set().add_select(q.fd, this, SELECT_WRITE);
+    } else {
+	q.timer->schedule_after(Timestamp::make_usec(q.backoff));
+	if (q.backoff < 256)
+	    q.backoff *= 2;
+	if (_debug) {
+	    Timestamp now = Timestamp::now();
+	    click_chatter("%{element} backing off for %d at %{timestamp}\n", this, q.backoff, &now);
+	}
+    }
+}
+
+#if TODEVICE_ALLOW_SENDMMSG
 bool
-ToDevice::run_task(Task *)
+ToDevice::run_batch(int qi)
 {
-    Packet *p = _q;
-    _q = 0;
+    Queue &q = *_queues[qi];
+    if (q.pending.count() < _burst) {
+	++q.pulls;
+	input(qi).pull_batch(q.pending, _burst - q.pending.count());
+    }
+
+    int n = 0, r = 0;
+    for (Packet *p = q.pending.front(); p; p = p->next(), ++n) {
+	q.iovs[n].iov_base = const_cast<unsigned char *>(p->data());
+	q.iovs[n].iov_len = p->length();
+    }
+    if (n) {
+	++q.bursts;
+	if ((r = sendmmsg(q.fd, q.msgs, n, 0)) < 0)
+	    r = -errno;
+	if (r < n)
+	    ++q.partial_bursts;
+    }
+
+    if (r > 0) {
+	q.backoff = 0;
+	q.burst_packets += r;
+	PacketBatch sent;
+	for (int i = 0; i < r; ++i)
+	    sent.push_back(q.pending.pop_front());
+	if (noutputs())
+	    output(0).push_batch(sent);
+	else
+	    sent.kill();
+	// A short send usually means the socket buffer filled; the next
+	// sendmmsg() will report the error, if any.
+    } else if (r == -ENOBUFS || r == -EAGAIN) {
+	backoff(q);
+	return false;
+    } else if (r < 0) {
+	click_chatter("ToDevice(%s): %s", _ifname.c_str(), strerror(-r));
+	checked_output_push(1, q.pending.pop_front());
+    }
+
+    if (!q.pending.empty() || q.signal)
+	q.task->fast_reschedule();
+    return r > 0;
+}
+#endif
+
+bool
+ToDevice::run_task(Task *task)
+{
+    int qi = 0;
+    while (_queues[qi]->task != task)
+	++qi;
+    Queue &q = *_queues[qi];
+
+#if TODEVICE_ALLOW_SENDMMSG
+    if (q.msgs)
+	return run_batch(qi);
+#endif
+
+    Packet *p = q.q;
+    q.q = 0;
     int count = 0, r = 0;
 
     do {
 	if (!p) {
-	    ++_pulls;
-	    if (!(p = input(0).pull()))
+	    ++q.pulls;
+	    if (!(p = input(qi).pull()))
 		break;
 	}
-	if ((r = send_packet(p)) >= 0) {
-	    _backoff = 0;
+	if ((r = send_packet(q, p)) >= 0) {
+	    q.backoff = 0;
 	    checked_output_push(0, p);
 	    ++count;
 	} else
@@ -311,53 +468,68 @@ ToDevice::run_task(Task *)
     } while (count < _burst);
 
     if (r == -ENOBUFS || r == -EAGAIN) {
-	assert(!_q);
-	_q = p;
-
-	if (!_backoff) {
-	    _backoff = 1;
-	    add_select(_fd, SELECT_WRITE);
-	} else {
-	    _timer.schedule_after(Timestamp::make_usec(_backoff));
-	    if (_backoff < 256)
-		_backoff *= 2;
-	    if (_debug) {
-		Timestamp now = Timestamp::now();
-		click_chatter("%{element} backing off for %d at %{timestamp}\n", this, _backoff, &now);
-	    }
-	}
+	assert(!q.q);
+	q.q = p;
+	backoff(q);
 	return count > 0;
     } else if (r < 0) {
 	click_chatter("ToDevice(%s): %s", _ifname.c_str(), strerror(-r));
 	checked_output_push(1, p);
     }
 
-    if (p || _signal)
-	_task.fast_reschedule();
+    if (p || q.signal)
+	task->fast_reschedule();
     return count > 0;
 }
 
 void
-ToDevice::selected(int, int)
+ToDevice::selected(int fd, int)
 {
-    _task.reschedule();
-    remove_select(_fd, SELECT_WRITE);
+    for (Queue **qp = _queues.begin(); qp != _queues.end(); ++qp)
+	if ((*qp)->fd == fd) {
+	    (*qp)->task->reschedule();
+	    master()->thread((*qp)->thread_id)->select_set().remove_select(fd, this, SELECT_WRITE);
+	    break;
+	}
 }
 
-
 String
 ToDevice::read_param(Element *e, void *thunk)
 {
     ToDevice *td = (ToDevice *)e;
-    switch((uintptr_t) thunk) {
-    case h_debug:
+    if ((uintptr_t) thunk == h_debug)
 	return String(td->_debug);
+
+    // Other handlers combine every input's state.
+    NotifierSignal signal = NotifierSignal::idle_signal();
+    uint32_t pulls = 0, bursts = 0, burst_packets = 0, partial_bursts = 0;
+    bool q = false;
+    for (Queue **qp = td->_queues.begin(); qp != td->_queues.end(); ++qp) {
+	signal += (*qp)->signal;
+	pulls += (*qp)->pulls;
+	q = q || (*qp)->q;
+#if TODEVICE_ALLOW_SENDMMSG
+	q = q || !(*qp)->pending.empty();
+	bursts += (*qp)->bursts;
+	burst_packets += (*qp)->burst_packets;
+	partial_bursts += (*qp)->partial_bursts;
+#endif
+    }
+    switch((uintptr_t) thunk) {
     case h_signal:
-	return String(td->_signal);
+	return String(signal);
     case h_pulls:
-	return String(td->_pulls);
+	return String(pulls);
     case h_q:
-	return String((bool) td->_q);
+	return String(q);
+#if TODEVICE_ALLOW_SENDMMSG
+    case h_bursts:
+	return String(bursts);
+    case h_burst_packets:
+	return String(burst_packets);
+    case h_partial_bursts:
+	return String(partial_bursts);
+#endif
     default:
 	return String();
     }
@@ -389,6 +561,11 @@ ToDevice::add_handlers()
     add_read_handler("pulls", read_param, h_pulls);
     add_read_handler("signal", read_param, h_signal);
     add_read_handler("q", read_param, h_q);
+#if TODEVICE_ALLOW_SENDMMSG
+    add_read_handler("bursts", read_param, h_bursts);
+    add_read_handler("burst_packets", read_param, h_burst_packets);
+    add_read_handler("partial_bursts", read_param, h_partial_bursts);
+#endif
     add_write_handler("debug", write_param, h_debug);
 }
 
@@ -6,6 +6,9 @@
 #include <click/timer.hh>
 #include <click/notifier.hh>
 #include "elements/userlevel/fromdevice.hh"
+#if defined(__linux__)
+# include <sys/socket.h>
+#endif
 CLICK_DECLS
 
 /*
@@ -29,6 +32,9 @@ CLICK_DECLS
  * =item BURST
  *
  * Integer. Maximum number of packets to pull per scheduling. Defaults to 1.
+ * With METHOD LINUX and BURST greater than 1, ToDevice pulls packets with
+ * pull_batch() and submits up to BURST packets per sendmmsg() system call,
+ * where the C library supports it.
  *
  * =item METHOD
  *
@@ -36,12 +42,26 @@ CLICK_DECLS
  * device. Linux targets generally support PCAP and LINUX; other targets
  * support PCAP or, occasionally, other methods. Generally defaults to PCAP.
  *
+ * =item QUEUES
+ *
+ * Unsigned.  Number of inputs, each sent on its own thread.  Requires METHOD
+ * LINUX.  Default is 1.  See below.
+ *
  * =item DEBUG
  *
  * Boolean.  If true, print out debug messages.
  *
  * =back
  *
+ * With QUEUES I<N>, ToDevice has I<N> inputs, each with its own packet
+ * socket and task.  Input I<i>'s task runs on thread I<T>+I<i> modulo the
+ * number of threads, where I<T> is ToDevice's home thread, matching the
+ * threads of a FromDevice with the same QUEUES and home thread; if such a
+ * FromDevice exists, input I<i> sends on the socket FromDevice reads queue
+ * I<i> from.  The kernel picks each packet's transmit queue; with transmit
+ * packet steering (XPS) configured, that follows the CPU the sending thread
+ * runs on, so the threads' packets use separate transmit queues.
+ *
  * This element is only available at user level.
  *
  * =n
@@ -56,6 +76,19 @@ CLICK_DECLS
  *
  * Packets that are written successfully are sent on output 0, if it exists.
  * Packets that fail to be written are pushed out output 1, if it exists.
+ *
+ * =h bursts read-only
+ *
+ * Returns the number of sendmmsg() calls ToDevice has made.
+ *
+ * =h burst_packets read-only
+ *
+ * Returns the number of packets sent by sendmmsg() calls.
+ *
+ * =h partial_bursts read-only
+ *
+ * Returns the number of sendmmsg() calls that failed or sent fewer packets
+ * than requested, usually because the socket buffer was full.
 
  * KernelTun lets you send IP packets to the host kernel's IP processing code,
  * sort of like the kernel module's ToHost element.
@@ -65,6 +98,11 @@ CLICK_DECLS
 
 #if defined(__linux__)
 # define TODEVICE_ALLOW_LINUX 1
+# if defined(__USE_GNU) && defined(__GLIBC_PREREQ)
+#  if __GLIBC_PREREQ(2, 14)
+#   define TODEVICE_ALLOW_SENDMMSG 1
+#  endif
+# endif
 #endif
 #if HAVE_PCAP && (HAVE_PCAP_INJECT || HAVE_PCAP_SENDPACKET)
 extern "C" {
@@ -85,7 +123,7 @@ class ToDevice : public Element { public:
     ~ToDevice();
 
     const char *class_name() const		{ return "ToDevice"; }
-    const char *port_count() const		{ return "1/0-2"; }
+    const char *port_count() const		{ return "1-/0-2"; }
     const char *processing() const		{ return "l/h"; }
     const char *flags() const			{ return "S2"; }
 
@@ -103,7 +141,27 @@ class ToDevice : public Element { public:
 
   protected:
 
-    Task _task;
+    struct Queue {		// one input
+	Task *task;
+	Timer *timer;
+	int thread_id;
+	int fd;
+	bool my_fd;
+	NotifierSignal signal;
+	Packet *q;
+	int backoff;
+	uint32_t pulls;
+#if TODEVICE_ALLOW_SENDMMSG
+	PacketBatch pending;
+	struct mmsghdr *msgs;
+	struct iovec *iovs;
+	uint32_t bursts;
+	uint32_t burst_packets;
+	uint32_t partial_bursts;
+#endif
+    };
+
+    Task _task;			// input 0's
     Timer _timer;
 
     String _ifname;
@@ -115,24 +173,24 @@ class ToDevice : public Element { public:
 #endif
     enum { method_linux, method_pcap, method_devbpf, method_pcapfd };
     int _method;
-    NotifierSignal _signal;
+    Vector<Queue *> _queues;
 
-    Packet *_q;
     int _burst;
+    int _nqueues;
 
     bool _debug;
 #if TODEVICE_ALLOW_PCAP
     bool _my_pcap;
 #endif
-#if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD
-    bool _my_fd;
-#endif
-    int _backoff;
-    int _pulls;
 
-    enum { h_debug, h_signal, h_pulls, h_q };
+    enum { h_debug, h_signal, h_pulls, h_q,
+	   h_bursts, h_burst_packets, h_partial_bursts };
     FromDevice *find_fromdevice() const;
-    int send_packet(Packet *p);
+    int send_packet(Queue &q, Packet *p);
+    void backoff(Queue &q);
+#if TODEVICE_ALLOW_SENDMMSG
+    bool run_batch(int qi);
+#endif
     static int write_param(const String &in_s, Element *e, void *vparam, ErrorHandler *errh);
     static String read_param(Element *e, void *thunk);
 
@@ -31,10 +31,302 @@
 #include <click/packet_anno.hh>
 #include "fakepcap.hh"
 #include <click/userutils.hh>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+# include <signal.h>
+#endif
 CLICK_DECLS
 
+#if HAVE_USER_MULTITHREAD
+/* In ASYNC mode, the datapath copies records into page-aligned Buffers and
+   passes full ones to a Writer, whose thread writes them out in order.  A
+   Buffer with a filename starts a new file.  The Writer owns a fixed number
+   of Buffers; when none is free, the datapath drops packets rather than
+   wait. */
+struct ToDump::Buffer {
+    unsigned char *data;
+    uint32_t len;
+    String filename;
+    Buffer *next;
+};
+
+class ToDump::Writer { public:
+
+    Writer(uint32_t nbuffers, uint32_t size, bool direct);
+    ~Writer();
+
+    int initialize();
+    int start();
+
+    Buffer *get();
+    void put(Buffer *b);
+
+    bool failed() const {
+	return _error != 0;
+    }
+    String error_string();
+
+  private:
+
+    uint32_t _nbuffers;
+    uint32_t _size;
+    bool _direct;
+    Buffer *_buffers;
+
+    pthread_mutex_t _lock;
+    pthread_cond_t _nonempty;
+    pthread_t _thread;
+    bool _running;
+    bool _stop;
+
+    Buffer *_free;
+    Buffer *_head;
+    Buffer **_tail;
+
+    String _filename;
+    FILE *_fp;
+    int _fd;
+    bool _pipe;
+    bool _direct_fd;
+    volatile int _error;
+
+    static void *thread_hook(void *);
+    void run();
+    void write_buffer(Buffer *b);
+    int write_data(const unsigned char *data, uint32_t len);
+    bool open_file(const String &filename);
+    void close_file();
+
+};
+
+ToDump::Writer::Writer(uint32_t nbuffers, uint32_t size, bool direct)
+    : _nbuffers(nbuffers), _size(size), _direct(direct), _buffers(0),
+      _running(false), _stop(false), _free(0), _head(0), _tail(&_head),
+      _fp(0), _fd(-1), _pipe(false), _direct_fd(false), _error(0)
+{
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_nonempty, 0);
+}
+
+ToDump::Writer::~Writer()
+{
+    // the thread writes out every queued buffer before exiting
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_signal(&_nonempty);
+    pthread_mutex_unlock(&_lock);
+    if (_running)
+	pthread_join(_thread, 0);
+    close_file();
+    if (_buffers)
+	for (uint32_t i = 0; i < _nbuffers; ++i)
+	    free(_buffers[i].data);
+    delete[] _buffers;
+    pthread_cond_destroy(&_nonempty);
+    pthread_mutex_destroy(&_lock);
+}
+
+int
+ToDump::Writer::initialize()
+{
+    if (!(_buffers = new Buffer[_nbuffers]))
+	return -ENOMEM;
+    size_t page_size = getpagesize();
+    for (uint32_t i = 0; i < _nbuffers; ++i)
+	_buffers[i].data = 0;
+    for (uint32_t i = 0; i < _nbuffers; ++i) {
+	void *data;
+	if (posix_memalign(&data, page_size, _size) != 0)
+	    return -ENOMEM;
+	_buffers[i].data = (unsigned char *) data;
+	_buffers[i].len = 0;
+	_buffers[i].next = _free;
+	_free = &_buffers[i];
+    }
+    return 0;
+}
+
+int
+ToDump::Writer::start()
+{
+    // leave signals to the driver's threads
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&_thread, 0, thread_hook, this);
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    _running = (err == 0);
+    return -err;
+}
+
+ToDump::Buffer *
+ToDump::Writer::get()
+{
+    pthread_mutex_lock(&_lock);
+    Buffer *b = _free;
+    if (b)
+	_free = b->next;
+    pthread_mutex_unlock(&_lock);
+    return b;
+}
+
+void
+ToDump::Writer::put(Buffer *b)
+{
+    b->next = 0;
+    pthread_mutex_lock(&_lock);
+    *_tail = b;
+    _tail = &b->next;
+    pthread_cond_signal(&_nonempty);
+    pthread_mutex_unlock(&_lock);
+}
+
+String
+ToDump::Writer::error_string()
+{
+    pthread_mutex_lock(&_lock);
+    String s = _filename + ": " + strerror(_error);
+    pthread_mutex_unlock(&_lock);
+    return s;
+}
+
+void *
+ToDump::Writer::thread_hook(void *thunk)
+{
+    static_cast<Writer *>(thunk)->run();
+    return 0;
+}
+
+void
+ToDump::Writer::run()
+{
+    pthread_mutex_lock(&_lock);
+    while (1) {
+	while (!_head && !_stop)
+	    pthread_cond_wait(&_nonempty, &_lock);
+	Buffer *b = _head;
+	if (!b)
+	    break;
+	if (!(_head = b->next))
+	    _tail = &_head;
+	pthread_mutex_unlock(&_lock);
+
+	write_buffer(b);
+
+	pthread_mutex_lock(&_lock);
+	b->len = 0;
+	b->filename = String();
+	b->next = _free;
+	_free = b;
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+void
+ToDump::Writer::write_buffer(Buffer *b)
+{
+    if (b->filename) {
+	close_file();
+	if (!open_file(b->filename))
+	    return;
+    }
+    if (_error || (_fd < 0 && !_fp))
+	return;
+    if (write_data(b->data, b->len) < 0) {
+	pthread_mutex_lock(&_lock);
+	_error = errno;
+	pthread_mutex_unlock(&_lock);
+    }
+}
+
+int
+ToDump::Writer::write_data(const unsigned char *data, uint32_t len)
+{
+    int fd = _fp ? fileno(_fp) : _fd;
+    uint32_t pos = 0;
+    while (pos < len) {
+	uint32_t n = len - pos;
+	if (_direct_fd && (n % getpagesize()) != 0) {
+	    // O_DIRECT needs whole blocks; this is a file's last buffer
+	    if ((n -= n % getpagesize()) == 0) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+		_direct_fd = false;
+		n = len - pos;
+	    }
+	}
+	ssize_t w = ::write(fd, data + pos, n);
+	if (w < 0 && errno != EINTR)
+	    return -1;
+	else if (w > 0)
+	    pos += w;
+    }
+    return 0;
+}
+
+bool
+ToDump::Writer::open_file(const String &filename)
+{
+    pthread_mutex_lock(&_lock);
+    _filename = filename;
+    pthread_mutex_unlock(&_lock);
+
+    if (filename == "<stdout>")
+	_fd = STDOUT_FILENO;
+    else if (compressed_filename(filename) > 0) {
+	_fp = open_compress_pipe(filename, ErrorHandler::silent_handler());
+	_pipe = true;
+    } else {
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+	if (_direct) {
+	    _fd = ::open(filename.c_str(), flags | O_DIRECT, 0666);
+	    if (_fd >= 0)
+		_direct_fd = true;
+	    else if (errno == EINVAL) {
+		click_chatter("ToDump(%s): O_DIRECT not supported, writing normally", filename.c_str());
+		_direct = false;
+	    }
+	}
+#endif
+	if (_fd < 0)
+	    _fd = ::open(filename.c_str(), flags, 0666);
+    }
+
+    if (_fd < 0 && !_fp) {
+	pthread_mutex_lock(&_lock);
+	_error = errno;
+	pthread_mutex_unlock(&_lock);
+	return false;
+    }
+    return true;
+}
+
+void
+ToDump::Writer::close_file()
+{
+    if (_fp) {
+	if (_pipe)
+	    pclose(_fp);
+	else
+	    fclose(_fp);
+    } else if (_fd >= 0 && _fd != STDOUT_FILENO)
+	close(_fd);
+    _fp = 0;
+    _fd = -1;
+    _pipe = _direct_fd = false;
+}
+#endif
+
+
 ToDump::ToDump()
-    : _fp(0), _count(0), _task(this), _use_encap_from(0)
+    : _fp(0), _pipe(false), _count(0), _drops(0), _rotate_now(false),
+#if HAVE_USER_MULTITHREAD
+      _writer(0), _buf(0), _file_pending(false),
+#endif
+      _timer(this), _task(this), _use_encap_from(0)
 {
 }
 
@@ -50,6 +342,12 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _snaplen = 2000;
     _extra_length = true;
     _unbuffered = false;
+    _async = _direct = false;
+    _nbuffers = 8;
+    _buffer_size = 1 << 20;
+    _flush_interval = Timestamp(1);
+    _rotate_size = 0;
+    _rotate_interval = 0;
 #if CLICK_NS
     bool per_node = false;
 #endif
@@ -61,6 +359,13 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("USE_ENCAP_FROM", AnyArg(), use_encap_from)
 	.read("EXTRA_LENGTH", _extra_length)
 	.read("UNBUFFERED", _unbuffered)
+	.read("ASYNC", _async)
+	.read("BUFFERS", _nbuffers)
+	.read("BUFFER_SIZE", _buffer_size)
+	.read("FLUSH_INTERVAL", _flush_interval)
+	.read("DIRECT", _direct)
+	.read("ROTATE_SIZE", _rotate_size)
+	.read("ROTATE_INTERVAL", SecondsArg(), _rotate_interval)
 #if CLICK_NS
 	.read("PER_NODE", per_node)
 #endif
@@ -70,6 +375,26 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     if (_snaplen == 0)
 	_snaplen = 0xFFFFFFFFU;
 
+    if ((_rotate_size || _rotate_interval) && _filename == "-")
+	return errh->error("cannot rotate the standard output");
+    if (_rotate_size && _rotate_size <= sizeof(fake_pcap_file_header))
+	return errh->error("'ROTATE_SIZE' too small");
+#if HAVE_USER_MULTITHREAD
+    if (_async) {
+	if (_nbuffers < 2)
+	    return errh->error("'BUFFERS' must be at least 2");
+	if (_buffer_size < 65536)
+	    _buffer_size = 65536;
+	size_t page_size = getpagesize();
+	_buffer_size = ((_buffer_size + page_size - 1) / page_size) * page_size;
+    }
+#else
+    if (_async) {
+	errh->warning("'ASYNC' requires multithreading support");
+	_async = false;
+    }
+#endif
+
     if (use_encap_from && encap_type)
 	return errh->error("specify at most one of 'ENCAP' and 'USE_ENCAP_FROM'");
     else if (use_encap_from) {
@@ -105,7 +430,9 @@ ToDump::hotswap_element() const
     if (Element *e = Element::hotswap_element())
 	if (ToDump *td = (ToDump *)e->cast("ToDump"))
 	    if (td->_filename == _filename
-		&& td->_linktype == _linktype)
+		&& td->_linktype == _linktype
+		&& td->_async == _async
+		&& td->_buffer_size == _buffer_size)
 		return td;
     return 0;
 }
@@ -144,36 +471,34 @@ ToDump::initialize(ErrorHandler *errh)
 
 	// prepare files
 	assert(!_fp);
-	if (_filename != "-") {
-	    if (compressed_filename(_filename) > 0)
-		_fp = open_compress_pipe(_filename, errh);
-	    else
-		_fp = fopen(_filename.c_str(), "wb");
-	    if (!_fp)
-		return errh->error("%s: %s", _filename.c_str(), strerror(errno));
-	} else {
-	    _fp = stdout;
-	    _filename = "<stdout>";
-	}
-
-	if (_unbuffered)
-	    setvbuf(_fp, (char *) 0, _IONBF, 0);
-
-	struct fake_pcap_file_header h;
-
-	h.magic = FAKE_PCAP_MAGIC;
-	h.version_major = FAKE_PCAP_VERSION_MAJOR;
-	h.version_minor = FAKE_PCAP_VERSION_MINOR;
-
-	h.thiszone = 0;		// timestamps are in GMT
-	h.sigfigs = 0;		// XXX accuracy of timestamps?
-	h.snaplen = _snaplen;
-	h.linktype = _linktype;
+	String filename = _filename;
+	if (_filename == "-")
+	    _filename = filename = "<stdout>";
+	else
+	    filename = next_filename(Timestamp::now());
+
+#if HAVE_USER_MULTITHREAD
+	if (_async) {
+	    _writer = new Writer(_nbuffers, _buffer_size, _direct);
+	    if (_writer->initialize() < 0)
+		return errh->error("out of memory");
+	    if (int err = _writer->start())
+		return errh->error("cannot start writer thread: %s", strerror(-err));
+	    _file_name = filename;
+	    _file_pending = true;
+	    _file_bytes = sizeof(fake_pcap_file_header);
+	} else
+#endif
+	if (open_file(filename, errh) < 0)
+	    return -1;
+    }
 
-	size_t wrote_header = fwrite(&h, sizeof(h), 1, _fp);
-	if (wrote_header != 1)
-	    return errh->error("%s: unable to write file header", _filename.c_str());
+#if HAVE_USER_MULTITHREAD
+    if (_async && _flush_interval && !_direct) {
+	_timer.initialize(this);
+	_timer.schedule_after(_flush_interval);
     }
+#endif
 
     if (input_is_pull(0) && noutputs() == 0) {
 	ScheduleInfo::join_scheduler(this, &_task, errh);
@@ -188,47 +513,297 @@ ToDump::take_state(Element *e, ErrorHandler *)
 {
     ToDump *td = static_cast<ToDump *>(e); // result of hotswap_element()
     _fp = td->_fp;
+    _pipe = td->_pipe;
     td->_fp = 0;
+    _file_name = td->_file_name;
+    _file_base = td->_file_base;
+    _file_index = td->_file_index;
+    _file_bytes = td->_file_bytes;
+    _file_end = td->_file_end;
+#if HAVE_USER_MULTITHREAD
+    _writer = td->_writer;
+    _buf = td->_buf;
+    _file_pending = td->_file_pending;
+    td->_writer = 0;
+    td->_buf = 0;
+#endif
 }
 
 void
 ToDump::cleanup(CleanupStage)
 {
-    if (_fp && _fp != stdout)
-	fclose(_fp);
+#if HAVE_USER_MULTITHREAD
+    if (_writer) {
+	if (_buf && _buf->len)
+	    _writer->put(_buf);
+	_buf = 0;
+	if (_writer->failed() && _active)
+	    click_chatter("%p{element}: %s", this, _writer->error_string().c_str());
+	delete _writer;	// waits for queued buffers to be written
+	_writer = 0;
+    }
+#endif
+    close_file();
+}
+
+void
+ToDump::make_file_header(struct fake_pcap_file_header &h) const
+{
+    h.magic = FAKE_PCAP_MAGIC;
+    h.version_major = FAKE_PCAP_VERSION_MAJOR;
+    h.version_minor = FAKE_PCAP_VERSION_MINOR;
+
+    h.thiszone = 0;		// timestamps are in GMT
+    h.sigfigs = 0;		// XXX accuracy of timestamps?
+    h.snaplen = _snaplen;
+    h.linktype = _linktype;
+}
+
+int
+ToDump::open_file(const String &filename, ErrorHandler *errh)
+{
+    if (filename == "<stdout>")
+	_fp = stdout;
+    else if (compressed_filename(filename) > 0) {
+	_fp = open_compress_pipe(filename, errh);
+	_pipe = true;
+    } else
+	_fp = fopen(filename.c_str(), "wb");
+    if (!_fp)
+	return errh->error("%s: %s", filename.c_str(), strerror(errno));
+    _file_name = filename;
+
+    if (_unbuffered)
+	setvbuf(_fp, (char *) 0, _IONBF, 0);
+
+    struct fake_pcap_file_header h;
+    make_file_header(h);
+    size_t wrote_header = fwrite(&h, sizeof(h), 1, _fp);
+    if (wrote_header != 1)
+	return errh->error("%s: unable to write file header", filename.c_str());
+    _file_bytes = sizeof(h);
+    return 0;
+}
+
+void
+ToDump::close_file()
+{
+    if (_fp && _fp != stdout) {
+	if (_pipe)
+	    pclose(_fp);
+	else
+	    fclose(_fp);
+    }
     _fp = 0;
+    _pipe = false;
+}
+
+String
+ToDump::next_filename(const Timestamp &ts)
+{
+    String base = _filename;
+    if ((_rotate_size || _rotate_interval) && _filename.find_left('%') >= 0) {
+	char buf[BUFSIZ];
+	time_t sec = ts.sec();
+	struct tm *tm = localtime(&sec);
+	size_t n = tm ? strftime(buf, sizeof(buf), _filename.c_str(), tm) : 0;
+	if (n > 0)
+	    base = String(buf, n);
+    }
+
+    if (base == _file_base)
+	++_file_index;
+    else {
+	_file_base = base;
+	_file_index = 0;
+    }
+    if (_file_index == 0)
+	return base;
+
+    // put the number before any compression extension
+    int ext = base.length();
+    switch (compressed_filename(base)) {
+    case 0:
+	break;
+    default:
+	ext = base.find_right('.');
+	break;
+    }
+    return base.substring(0, ext) + "." + String(_file_index) + base.substring(ext);
 }
 
+void
+ToDump::set_file_end(const Timestamp &ts)
+{
+    if (_rotate_interval)
+	_file_end = Timestamp((ts.sec() / _rotate_interval + 1) * _rotate_interval, 0);
+}
+
+inline bool
+ToDump::rotate_due(const Timestamp &ts, uint32_t len)
+{
+    // the first file ends at the interval after its first packet
+    if (_rotate_interval && !_file_end)
+	set_file_end(ts);
+    if (_rotate_now)
+	return true;
+    if (_rotate_size && _file_bytes + len > _rotate_size
+	&& _file_bytes > sizeof(fake_pcap_file_header))
+	return true;
+    if (_rotate_interval && ts >= _file_end)
+	return true;
+    return false;
+}
+
+void
+ToDump::rotate(const Timestamp &ts)
+{
+    _rotate_now = false;
+    Timestamp start = ts;
+    if (_rotate_interval && ts >= _file_end)
+	start = Timestamp((ts.sec() / _rotate_interval) * _rotate_interval, 0);
+    String filename = next_filename(start);
+    set_file_end(ts);
+
+#if HAVE_USER_MULTITHREAD
+    if (_writer) {
+	_file_name = filename;
+	_file_pending = true;
+	_file_bytes = sizeof(fake_pcap_file_header);
+	return;
+    }
+#endif
+    close_file();
+    if (open_file(filename, ErrorHandler::default_handler()) < 0)
+	_active = false;
+}
+
+#if HAVE_USER_MULTITHREAD
+inline void
+ToDump::async_append(Buffer *&next, const void *data, uint32_t len)
+{
+    const unsigned char *d = reinterpret_cast<const unsigned char *>(data);
+    uint32_t n = _buffer_size - _buf->len;
+    if (len >= n) {
+	// a record may straddle two buffers, so buffers are always full
+	memcpy(_buf->data + _buf->len, d, n);
+	_buf->len += n;
+	d += n;
+	len -= n;
+	_writer->put(_buf);
+	_buf = next;
+	next = 0;
+    }
+    memcpy(_buf->data + _buf->len, d, len);
+    _buf->len += len;
+}
+
+bool
+ToDump::async_write(const void *hdr, uint32_t hlen, const void *data, uint32_t dlen)
+{
+    if (_file_pending) {
+	if (_buf && _buf->len) {
+	    _writer->put(_buf);
+	    _buf = 0;
+	}
+	if (!_buf && !(_buf = _writer->get()))
+	    return false;
+	_buf->filename = _file_name;
+	struct fake_pcap_file_header h;
+	make_file_header(h);
+	memcpy(_buf->data, &h, sizeof(h));
+	_buf->len = sizeof(h);
+	_file_pending = false;
+    } else if (!_buf && !(_buf = _writer->get()))
+	return false;
+
+    Buffer *next = 0;
+    if (_buf->len + hlen + dlen >= _buffer_size
+	&& !(next = _writer->get()))
+	return false;
+    async_append(next, hdr, hlen);
+    async_append(next, data, dlen);
+    return true;
+}
+
+void
+ToDump::run_timer(Timer *)
+{
+    _lock.acquire();
+    if (_buf && _buf->len) {
+	_writer->put(_buf);
+	_buf = 0;
+    }
+    _lock.release();
+    _timer.reschedule_after(_flush_interval);
+}
+#else
+void
+ToDump::run_timer(Timer *)
+{
+}
+#endif
+
 void
 ToDump::write_packet(Packet *p)
 {
     struct fake_pcap_pkthdr ph;
 
-    const Timestamp& ts = p->timestamp_anno();
-    if (!ts) {
-	Timestamp now = Timestamp::now();
-	ph.ts.tv.tv_sec = now.sec();
-	ph.ts.tv.tv_usec = now.usec();
-    } else {
-	ph.ts.tv.tv_sec = ts.sec();
-	ph.ts.tv.tv_usec = ts.usec();
-    }
+    Timestamp ts = p->timestamp_anno();
+    if (!ts)
+	ts = Timestamp::now();
+    ph.ts.tv.tv_sec = ts.sec();
+    ph.ts.tv.tv_usec = ts.usec();
 
     unsigned to_write = p->length();
     ph.len = to_write + (_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
     if (_snaplen && to_write > _snaplen)
 	to_write = _snaplen;
+
+#if HAVE_USER_MULTITHREAD
+    if (_writer) {
+	uint32_t max_write = _buffer_size - sizeof(fake_pcap_file_header) - sizeof(ph);
+	if (to_write > max_write)
+	    to_write = max_write;
+	ph.caplen = to_write;
+
+	_lock.acquire();
+	if (_writer->failed()) {
+	    click_chatter("%p{element}: %s", this, _writer->error_string().c_str());
+	    _active = false;
+	}
+	if (_active && rotate_due(ts, sizeof(ph) + to_write))
+	    rotate(ts);
+	if (_active && async_write(&ph, sizeof(ph), p->data(), to_write)) {
+	    _file_bytes += sizeof(ph) + to_write;
+	    _count++;
+	} else
+	    _drops++;
+	_lock.release();
+	return;
+    }
+#endif
+
     ph.caplen = to_write;
+    if ((_rotate_size || _rotate_interval || _rotate_now)
+	&& rotate_due(ts, sizeof(ph) + to_write)) {
+	rotate(ts);
+	if (!_active)
+	    return;
+    }
 
     // XXX writing to pipe?
     if (fwrite(&ph, sizeof(ph), 1, _fp) == 0
 	|| fwrite(p->data(), 1, to_write, _fp) == 0) {
 	if (errno != EAGAIN) {
 	    _active = false;
-	    click_chatter("ToDump(%s): %s", _filename.c_str(), strerror(errno));
+	    click_chatter("ToDump(%s): %s", _file_name.c_str(), strerror(errno));
 	}
-    } else
+	_drops++;
+    } else {
+	_file_bytes += sizeof(ph) + to_write;
 	_count++;
+    }
 }
 
 void
@@ -263,7 +838,7 @@ ToDump::run_task(Task *)
     return p != 0;
 }
 
-enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2 };
+enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2, H_DROPS, H_CURRENT_FILENAME, H_ROTATE };
 
 String
 ToDump::read_handler(Element *e, void *thunk)
@@ -274,17 +849,31 @@ ToDump::read_handler(Element *e, void *thunk)
 	return td->_filename;
     case H_COUNT:
 	return String(td->_count);
+    case H_DROPS:
+	return String(td->_drops);
+    case H_CURRENT_FILENAME:
+	return td->_file_name;
     default:
 	return "<error>";
     }
 }
 
 int
-ToDump::write_handler(const String &, Element *e, void *, ErrorHandler *)
+ToDump::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
 {
     ToDump *td = static_cast<ToDump *>(e);
-    td->_count = 0;
-    return 0;
+    switch ((uintptr_t) thunk) {
+    case H_RESET_COUNTS:
+	td->_count = td->_drops = 0;
+	return 0;
+    case H_ROTATE:
+	if (td->_filename == "<stdout>")
+	    return -EINVAL;
+	td->_rotate_now = true;
+	return 0;
+    default:
+	return 0;
+    }
 }
 
 void
@@ -292,7 +881,10 @@ ToDump::add_handlers()
 {
     add_read_handler("filename", read_handler, H_FILENAME);
     add_read_handler("count", read_handler, H_COUNT);
+    add_read_handler("drops", read_handler, H_DROPS);
+    add_read_handler("current_filename", read_handler, H_CURRENT_FILENAME);
     add_write_handler("reset_counts", write_handler, H_RESET_COUNTS, Handler::BUTTON);
+    add_write_handler("rotate", write_handler, H_ROTATE, Handler::BUTTON);
     if (input_is_pull(0) && noutputs() == 0)
 	add_task_handlers(&_task);
 }
@@ -5,13 +5,15 @@
 #include <click/element.hh>
 #include <click/task.hh>
 #include <click/notifier.hh>
+#include <click/sync.hh>
 #include <stdio.h>
 CLICK_DECLS
 
 /*
 =c
 
-ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH])
+ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH,
+ASYNC, ROTATE_SIZE, ROTATE_INTERVAL, ...])
 
 =s traces
 
@@ -66,8 +68,59 @@ Boolean. Set to true if you want ToDump to use unbuffered IO when saving data to
 a file.  This is unlikely to work with compressed dump formats. Default is
 false.
 
+=item ASYNC
+
+Boolean.  If true, ToDump copies packets into large page-aligned buffers and
+hands each full buffer to a writer thread, so a slow disk or compressor never
+stalls the thread that pushes packets.  When every buffer is in use, ToDump
+drops packets instead of waiting, and counts them in "drops".  Requires
+multithreading support.  Default is false.
+
+=item BUFFERS
+
+Unsigned.  In ASYNC mode, the number of buffers ToDump may allocate; together
+with BUFFER_SIZE, this bounds the memory that can queue up behind a slow
+disk.  Default is 8.
+
+=item BUFFER_SIZE
+
+Unsigned.  In ASYNC mode, the size of each buffer in bytes, rounded up to a
+multiple of the page size.  At least 64 kB.  Packets longer than a buffer are
+truncated.  Default is 1 MB.
+
+=item FLUSH_INTERVAL
+
+Time in seconds.  In ASYNC mode, ToDump hands partially filled buffers to the
+writer thread at this interval, so packets reach the file even when traffic
+is light.  0 means only full buffers are written.  Default is 1.
+
+=item DIRECT
+
+Boolean.  In ASYNC mode, open files with O_DIRECT, bypassing the operating
+system's page cache.  Partial buffers are then written only when a file is
+closed, and FLUSH_INTERVAL is ignored.  If the file system does not support
+O_DIRECT, ToDump warns and writes normally.  Default is false.
+
+=item ROTATE_SIZE
+
+Unsigned.  If nonzero, start a new file before a file would grow beyond this
+many bytes.  Default is 0.
+
+=item ROTATE_INTERVAL
+
+Time in seconds.  If nonzero, start a new file whenever a packet's timestamp
+crosses a multiple of this interval; for example, 3600 starts a file every
+hour, on the hour.  Default is 0.
+
 =back
 
+With ROTATE_SIZE or ROTATE_INTERVAL, FILENAME may contain strftime(3) conversions such
+as C<%Y%m%d-%H%M>, which are expanded with each file's start time in local
+time.  Later files with the same expanded name get a numeric suffix, as in
+F<FILENAME.1>, F<FILENAME.2>, and so forth; the suffix goes before any
+compression extension.  Each file starts with its own tcpdump header.
+Rotation is not available when writing to the standard output.
+
 This element is only available at user level.
 
 =n
@@ -78,14 +131,36 @@ ToDump stores packets' true length annotations when available.
 
 Returns the number of packets emitted so far.
 
+=h drops read-only
+
+Returns the number of packets dropped because every ASYNC buffer was in use,
+or because a write failed.
+
 =h reset_counts write-only
 
-Resets "count" to 0.
+Resets "count" and "drops" to 0.
 
 =h filename read-only
 
 Returns the filename.
 
+=h current_filename read-only
+
+Returns the name of the file ToDump is currently writing.
+
+=h rotate write-only
+
+Starts a new file before the next packet, whether or not ROTATE_SIZE or
+ROTATE_INTERVAL is set.  This is useful for external log rotation.
+
+=e
+
+This configuration records a tap continuously into hourly files such as
+F<tap-20100314-1500.pcap>, writing from a separate thread:
+
+  FromDevice(eth1, SNIFFER true)
+      -> ToDump(tap-%Y%m%d-%H%M.pcap, ASYNC true, ROTATE_INTERVAL 3600);
+
 =a
 
 FromDump, FromDevice.u, ToDevice.u, tcpdump(1) */
@@ -97,7 +172,7 @@ class ToDump : public Element { public:
 
     const char *class_name() const	{ return "ToDump"; }
     const char *port_count() const	{ return "1/0-1"; }
-    const char *flags() const		{ return "S2"; }
+    const char *flags() const		{ return "S2 T"; }
 
     // configure after FromDevice and FromDump
     int configure_phase() const		{ return CONFIGURE_PHASE_DEFAULT+100; }
@@ -111,11 +186,13 @@ class ToDump : public Element { public:
     void push(int, Packet *);
     Packet *pull(int);
     bool run_task(Task *);
+    void run_timer(Timer *);
 
   private:
 
     String _filename;
     FILE *_fp;
+    bool _pipe;
     unsigned _snaplen;
     int _linktype;
     bool _active;
@@ -128,6 +205,33 @@ class ToDump : public Element { public:
     typedef uint32_t counter_t;
 #endif
     counter_t _count;
+    counter_t _drops;
+
+    // rotation
+    counter_t _rotate_size;
+    uint32_t _rotate_interval;
+    counter_t _file_bytes;
+    Timestamp _file_end;
+    String _file_base;
+    int _file_index;
+    String _file_name;
+    volatile bool _rotate_now;
+
+    // asynchronous writing
+    bool _async;
+    bool _direct;
+    uint32_t _nbuffers;
+    uint32_t _buffer_size;
+    Timestamp _flush_interval;
+#if HAVE_USER_MULTITHREAD
+    struct Buffer;
+    class Writer;
+    Writer *_writer;
+    Buffer *_buf;
+    bool _file_pending;
+    Spinlock _lock;
+#endif
+    Timer _timer;
 
     Task _task;
     NotifierSignal _signal;
@@ -136,6 +240,18 @@ class ToDump : public Element { public:
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
     void write_packet(Packet *);
+    inline bool rotate_due(const Timestamp &ts, uint32_t len);
+    String next_filename(const Timestamp &ts);
+    void set_file_end(const Timestamp &ts);
+    void make_file_header(struct fake_pcap_file_header &h) const;
+    int open_file(const String &filename, ErrorHandler *errh);
+    void close_file();
+    void rotate(const Timestamp &ts);
+#if HAVE_USER_MULTITHREAD
+    bool async_write(const void *hdr, uint32_t hlen, const void *data, uint32_t dlen);
+    inline void async_append(Buffer *&next, const void *data, uint32_t len);
+    void async_submit();
+#endif
 
 };
 
@@ -0,0 +1,162 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * tonetmapdevice.{cc,hh} -- element sends packets to a device via netmap
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tonetmapdevice.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <sys/ioctl.h>
+CLICK_DECLS
+
+ToNetmapDevice::ToNetmapDevice()
+    : _port(0), _task(this), _count(0), _zerocopy_count(0), _drops(0)
+{
+}
+
+ToNetmapDevice::~ToNetmapDevice()
+{
+}
+
+int
+ToNetmapDevice::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _queue = -1;
+    _host = false;
+    _burst = 32;
+    _nspare = NetmapPort::default_spare;
+    if (Args(conf, this, errh)
+	.read_mp("DEVNAME", _ifname)
+	.read_p("QUEUE", _queue)
+	.read("HOST", _host)
+	.read("BURST", _burst)
+	.read("SPARE_BUFFERS", _nspare)
+	.complete() < 0)
+	return -1;
+    if (_burst <= 0)
+	return errh->error("bad BURST");
+    if (_nspare < 0)
+	return errh->error("bad SPARE_BUFFERS");
+    return 0;
+}
+
+int
+ToNetmapDevice::initialize(ErrorHandler *errh)
+{
+    _port = NetmapPort::open(router(), _ifname, _queue, _host, _nspare, errh);
+    if (!_port)
+	return -1;
+
+    // check for duplicate writers
+    StringAccum sa;
+    sa << "device_writer_" << _ifname << (_host ? "^" : "") << "_" << _queue;
+    void *&used = router()->force_attachment(sa.take_string());
+    if (used)
+	return errh->error("duplicate writer for device %<%s%>", _ifname.c_str());
+    used = this;
+
+    ScheduleInfo::join_scheduler(this, &_task, errh);
+    _signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    return 0;
+}
+
+void
+ToNetmapDevice::cleanup(CleanupStage)
+{
+    _pending.kill();
+    if (_port)
+	_port->close(router());
+    _port = 0;
+}
+
+bool
+ToNetmapDevice::run_task(Task *)
+{
+    struct nm_desc *d = _port->desc();
+    int space = 0;
+    for (int ri = d->first_tx_ring; ri <= d->last_tx_ring; ++ri)
+	space += nm_ring_space(NETMAP_TXRING(d->nifp, ri));
+    if (_pending.empty() && space)
+	input(0).pull_batch(_pending, space < _burst ? space : _burst);
+
+    int sent = 0;
+    for (int ri = d->first_tx_ring; ri <= d->last_tx_ring && !_pending.empty(); ++ri) {
+	struct netmap_ring *ring = NETMAP_TXRING(d->nifp, ri);
+	uint32_t cur = ring->cur;
+	for (; cur != ring->tail && !_pending.empty(); ) {
+	    Packet *p = _pending.pop_front();
+	    bool zerocopy;
+	    if (_port->send_packet(ring, &ring->slot[cur], p, zerocopy)) {
+		cur = nm_ring_next(ring, cur);
+		++sent;
+		if (zerocopy)
+		    ++_zerocopy_count;
+	    } else {
+		p->kill();
+		++_drops;
+	    }
+	}
+	ring->head = ring->cur = cur;
+    }
+
+    // Let the kernel see new slots and reclaim sent ones.
+    if (sent || !_pending.empty() || !space)
+	ioctl(_port->fd(), NIOCTXSYNC, 0);
+    _count += sent;
+    if (sent || !_pending.empty() || _signal)
+	_task.fast_reschedule();
+    return sent > 0;
+}
+
+String
+ToNetmapDevice::read_handler(Element *e, void *thunk)
+{
+    ToNetmapDevice *td = static_cast<ToNetmapDevice *>(e);
+    switch ((intptr_t) thunk) {
+    case 0:
+	return String(td->_count);
+    case 1:
+	return String(td->_zerocopy_count);
+    case 2:
+	return String(td->_drops);
+    default:
+	return String();
+    }
+}
+
+int
+ToNetmapDevice::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ToNetmapDevice *td = static_cast<ToNetmapDevice *>(e);
+    td->_count = td->_zerocopy_count = td->_drops = 0;
+    return 0;
+}
+
+void
+ToNetmapDevice::add_handlers()
+{
+    add_read_handler("count", read_handler, 0);
+    add_read_handler("zerocopy_count", read_handler, 1);
+    add_read_handler("drops", read_handler, 2);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel netmap NetmapPort)
+EXPORT_ELEMENT(ToNetmapDevice)
+ELEMENT_MT_SAFE(ToNetmapDevice)
@@ -0,0 +1,117 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_TONETMAPDEVICE_HH
+#define CLICK_TONETMAPDEVICE_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/notifier.hh>
+#include "netmapport.hh"
+CLICK_DECLS
+
+/*
+=c
+
+ToNetmapDevice(DEVNAME [, QUEUE, I<keywords> HOST, BURST, SPARE_BUFFERS])
+
+=s netdevices
+
+sends packets to a network device via netmap (user-level)
+
+=d
+
+Pulls packets and sends them on the network device named DEVNAME, using
+netmap.  If QUEUE is given, ToNetmapDevice sends only on that hardware ring;
+otherwise it uses them all.  ToNetmapDevice pulls up to BURST packets per
+scheduling, and tells the kernel about them with one system call.
+
+A packet whose data starts a netmap buffer in the same netmap memory region
+as DEVNAME, such as an unmodified or modified-in-place packet from
+FromNetmapDevice, is sent without a copy: its buffer is swapped into the
+transmit ring.  Other packets are copied.  Packets longer than a netmap
+buffer are dropped.
+
+ToNetmapDevice shares the netmap port of a FromNetmapDevice with the same
+DEVNAME, QUEUE, and HOST, if there is one.
+
+Keyword arguments are:
+
+=over 8
+
+=item HOST
+
+Boolean.  If true, pass packets to the kernel's network stack, as if DEVNAME
+had received them, through the device's host rings.  This replaces ToHost
+for devices Click takes over with netmap.  QUEUE is ignored.  Default is
+false.
+
+=item BURST
+
+Integer.  Maximum number of packets to send per scheduling.  Default is 32.
+
+=item SPARE_BUFFERS
+
+Unsigned.  As for FromNetmapDevice.  Default is 4096.
+
+=back
+
+=e
+
+  FromNetmapDevice(em0) -> EtherMirror -> Queue -> ToNetmapDevice(em0);
+
+=h count read-only
+
+Returns the number of packets sent.
+
+=h zerocopy_count read-only
+
+Returns the number of packets sent without a copy.
+
+=h drops read-only
+
+Returns the number of packets dropped because they were too long.
+
+=h reset_counts write-only
+
+Resets "count", "zerocopy_count", and "drops" to zero.
+
+=a FromNetmapDevice, ToDevice.u, ToXDP */
+
+class ToNetmapDevice : public Element { public:
+
+    ToNetmapDevice();
+    ~ToNetmapDevice();
+
+    const char *class_name() const	{ return "ToNetmapDevice"; }
+    const char *port_count() const	{ return PORTS_1_0; }
+    const char *processing() const	{ return PULL; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    NetmapPort *_port;
+    Task _task;
+    NotifierSignal _signal;
+    PacketBatch _pending;	// pulled packets waiting for ring space
+
+    String _ifname;
+    int _queue;
+    bool _host;
+    int _burst;
+    int _nspare;
+
+    uint64_t _count;
+    uint64_t _zerocopy_count;
+    uint64_t _drops;
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,150 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * toshm.{cc,hh} -- element sends packets through shared memory
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "toshm.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+CLICK_DECLS
+
+ToShm::ToShm()
+    : _chan(0), _task(this), _timer(this), _count(0), _zerocopy_count(0),
+      _drops(0)
+{
+}
+
+ToShm::~ToShm()
+{
+}
+
+int
+ToShm::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _burst = 32;
+    _nslots = 1024;
+    _slot_size = 2048;
+    if (Args(conf, this, errh)
+	.read_mp("PATH", FilenameArg(), _path)
+	.read("BURST", _burst)
+	.read("SLOTS", _nslots)
+	.read("SLOT_SIZE", _slot_size)
+	.complete() < 0)
+	return -1;
+    if (_burst <= 0)
+	return errh->error("bad BURST");
+    if (_nslots < 2 || (_nslots & (_nslots - 1)) || _nslots > 0x1000000)
+	return errh->error("SLOTS must be a power of two");
+    if (_slot_size < 128 || (_slot_size & 7))
+	return errh->error("SLOT_SIZE must be a multiple of 8, at least 128");
+    return 0;
+}
+
+int
+ToShm::initialize(ErrorHandler *errh)
+{
+    // check for duplicate writers
+    void *&used = router()->force_attachment("ToShm_" + _path);
+    if (used)
+	return errh->error("duplicate writer for %<%s%>", _path.c_str());
+    used = this;
+
+    if (!(_chan = ShmChannel::open(this, _path, _nslots, _slot_size, errh)))
+	return -1;
+    ScheduleInfo::join_scheduler(this, &_task, errh);
+    _timer.initialize(this);
+    _signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    return 0;
+}
+
+void
+ToShm::cleanup(CleanupStage)
+{
+    _pending.kill();
+    if (_chan)
+	_chan->close(this);
+    _chan = 0;
+}
+
+bool
+ToShm::run_task(Task *)
+{
+    if (_pending.empty())
+	input(0).pull_batch(_pending, _burst);
+
+    int sent = 0;
+    while (Packet *p = _pending.pop_front()) {
+	bool zerocopy;
+	int r = _chan->send(p, zerocopy);
+	if (r == 0) {
+	    _pending.push_front(p);
+	    break;
+	} else if (r < 0) {
+	    p->kill();
+	    ++_drops;
+	} else {
+	    ++sent;
+	    if (zerocopy)
+		++_zerocopy_count;
+	}
+    }
+    if (sent) {
+	_chan->flush();
+	_count += sent;
+    }
+
+    // Out of slots: poll while the peer makes progress, otherwise back off
+    // (the peer may not be running yet).
+    if (!_pending.empty()) {
+	if (sent)
+	    _task.fast_reschedule();
+	else
+	    _timer.schedule_after_msec(1);
+    } else if (_signal)
+	_task.fast_reschedule();
+    return sent > 0;
+}
+
+void
+ToShm::run_timer(Timer *)
+{
+    _task.reschedule();
+}
+
+int
+ToShm::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ToShm *ts = static_cast<ToShm *>(e);
+    ts->_count = ts->_zerocopy_count = ts->_drops = 0;
+    return 0;
+}
+
+void
+ToShm::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_data_handlers("zerocopy_count", Handler::OP_READ, &_zerocopy_count);
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+    add_task_handlers(&_task);
+    add_stat("count", &_count);
+    add_stat("drops", &_drops);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel ShmChannel)
+EXPORT_ELEMENT(ToShm)
+ELEMENT_MT_SAFE(ToShm)
@@ -0,0 +1,111 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_TOSHM_HH
+#define CLICK_TOSHM_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+#include <click/notifier.hh>
+#include "shmchannel.hh"
+CLICK_DECLS
+
+/*
+=c
+
+ToShm(PATH [, I<keywords> BURST, SLOTS, SLOT_SIZE])
+
+=s comm
+
+sends packets to another Click process through shared memory (user-level)
+
+=d
+
+Pulls packets and sends them to the other Click process on the
+shared-memory channel PATH, where a FromShm element emits them.  See
+FromShm for how channels work.  The peer process need not be running yet;
+packets wait in the channel until it attaches.
+
+Packets that a FromShm on the same channel emitted, and that have not been
+cloned, are sent without a copy.  Other packets are copied into a free
+slot.  When every slot is in use, ToShm stops pulling until the peer
+returns some.  Packets longer than SLOT_SIZE less 8 bytes are dropped.
+
+Keyword arguments are:
+
+=over 8
+
+=item BURST
+
+Integer.  Maximum number of packets to send per scheduling.  Default is 32.
+
+=item SLOTS, SLOT_SIZE
+
+As for FromShm.
+
+=back
+
+=e
+
+  InfiniteSource(LENGTH 64) -> Queue -> ToShm(/dev/shm/click0);
+
+=h count read-only
+
+Returns the number of packets sent.
+
+=h zerocopy_count read-only
+
+Returns the number of packets sent without a copy.
+
+=h drops read-only
+
+Returns the number of packets dropped because they were too long.
+
+=h reset_counts write-only
+
+Resets the counts to zero.
+
+=a FromShm, Socket */
+
+class ToShm : public Element { public:
+
+    ToShm();
+    ~ToShm();
+
+    const char *class_name() const	{ return "ToShm"; }
+    const char *port_count() const	{ return PORTS_1_0; }
+    const char *processing() const	{ return PULL; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    bool run_task(Task *);
+    void run_timer(Timer *);
+
+  private:
+
+    ShmChannel *_chan;
+    Task _task;
+    Timer _timer;
+    NotifierSignal _signal;
+    PacketBatch _pending;
+    String _path;
+    int _burst;
+    uint32_t _nslots;
+    uint32_t _slot_size;
+
+#if HAVE_INT64_TYPES
+    typedef uint64_t counter_t;
+#else
+    typedef uint32_t counter_t;
+#endif
+    counter_t _count;
+    counter_t _zerocopy_count;
+    counter_t _drops;
+
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,154 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * toxdp.{cc,hh} -- element sends packets to a device queue via AF_XDP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "toxdp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/standard/scheduleinfo.hh>
+CLICK_DECLS
+
+ToXDP::ToXDP()
+    : _task(this), _fx(0), _count(0), _zerocopy_count(0), _drops(0)
+{
+}
+
+ToXDP::~ToXDP()
+{
+}
+
+int
+ToXDP::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _queue = 0;
+    _burst = 32;
+    if (Args(conf, this, errh)
+	.read_mp("DEVNAME", _ifname)
+	.read_p("QUEUE", _queue)
+	.read("BURST", _burst)
+	.complete() < 0)
+	return -1;
+    if (_burst <= 0)
+	return errh->error("bad BURST");
+    return 0;
+}
+
+int
+ToXDP::initialize(ErrorHandler *errh)
+{
+    Router *r = router();
+    for (int ei = 0; ei < r->nelements() && !_fx; ++ei) {
+	FromXDP *fx = (FromXDP *) r->element(ei)->cast("FromXDP");
+	if (fx && fx->ifname() == _ifname && fx->queue() == _queue && fx->fd() >= 0)
+	    _fx = fx;
+    }
+    if (!_fx)
+	return errh->error("no FromXDP for %<%s%> queue %d", _ifname.c_str(), _queue);
+
+    // check for duplicate writers
+    void *&used = router()->force_attachment("device_writer_" + _ifname + "_" + String(_queue));
+    if (used)
+	return errh->error("duplicate writer for device %<%s%> queue %d", _ifname.c_str(), _queue);
+    used = this;
+
+    ScheduleInfo::join_scheduler(this, &_task, errh);
+    _signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    return 0;
+}
+
+void
+ToXDP::cleanup(CleanupStage)
+{
+    _pending.kill();
+}
+
+bool
+ToXDP::run_task(Task *)
+{
+    _fx->reclaim();
+    if (_pending.empty()) {
+	uint32_t space = _fx->transmit_space();
+	if (space > (uint32_t) _burst)
+	    space = _burst;
+	if (space)
+	    input(0).pull_batch(_pending, space);
+    }
+
+    int sent = 0;
+    while (Packet *p = _pending.pop_front()) {
+	bool zerocopy;
+	int r = _fx->transmit(p, zerocopy);
+	if (r == 0) {
+	    _pending.push_front(p);
+	    break;
+	} else if (r < 0) {
+	    p->kill();
+	    ++_drops;
+	} else {
+	    ++sent;
+	    if (zerocopy)
+		++_zerocopy_count;
+	}
+    }
+    if (sent) {
+	_fx->transmit_flush();
+	_count += sent;
+    }
+
+    // Poll until the kernel returns every frame we sent.
+    if (sent || !_pending.empty() || _fx->transmit_pending() || _signal)
+	_task.fast_reschedule();
+    return sent > 0;
+}
+
+String
+ToXDP::read_handler(Element *e, void *thunk)
+{
+    ToXDP *tx = static_cast<ToXDP *>(e);
+    switch ((intptr_t) thunk) {
+    case 0:
+	return String(tx->_count);
+    case 1:
+	return String(tx->_zerocopy_count);
+    case 2:
+	return String(tx->_drops);
+    default:
+	return String();
+    }
+}
+
+int
+ToXDP::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    ToXDP *tx = static_cast<ToXDP *>(e);
+    tx->_count = tx->_zerocopy_count = tx->_drops = 0;
+    return 0;
+}
+
+void
+ToXDP::add_handlers()
+{
+    add_read_handler("count", read_handler, 0);
+    add_read_handler("zerocopy_count", read_handler, 1);
+    add_read_handler("drops", read_handler, 2);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel afxdp FromXDP)
+EXPORT_ELEMENT(ToXDP)
+ELEMENT_MT_SAFE(ToXDP)
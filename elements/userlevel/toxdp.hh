@@ -0,0 +1,101 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_TOXDP_HH
+#define CLICK_TOXDP_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/notifier.hh>
+#include "fromxdp.hh"
+CLICK_DECLS
+
+/*
+=c
+
+ToXDP(DEVNAME [, QUEUE, I<keywords> BURST])
+
+=s netdevices
+
+sends packets to a network device queue via AF_XDP (user-level)
+
+=d
+
+Pulls packets and sends them on queue QUEUE of the network device named
+DEVNAME, using the AF_XDP socket of the FromXDP element for the same device
+and queue.  That FromXDP is required.  QUEUE defaults to 0.
+
+Packets that FromXDP emitted, and that have not been cloned or moved out of
+their UMEM frame, are sent without a copy.  Other packets are copied into a
+free UMEM frame.  ToXDP pulls up to BURST packets per scheduling, and tells
+the kernel about them with at most one system call.  Packets longer than
+FromXDP's FRAME_SIZE are dropped.
+
+Keyword arguments are:
+
+=over 8
+
+=item BURST
+
+Integer.  Maximum number of packets to send per scheduling.  Default is 32.
+
+=back
+
+=e
+
+  FromXDP(eth1) -> EtherMirror -> Queue -> ToXDP(eth1);
+
+=h count read-only
+
+Returns the number of packets sent.
+
+=h zerocopy_count read-only
+
+Returns the number of packets sent without a copy.
+
+=h drops read-only
+
+Returns the number of packets dropped because they were too long.
+
+=h reset_counts write-only
+
+Resets "count", "zerocopy_count", and "drops" to zero.
+
+=a FromXDP, ToDevice.u */
+
+class ToXDP : public Element { public:
+
+    ToXDP();
+    ~ToXDP();
+
+    const char *class_name() const	{ return "ToXDP"; }
+    const char *port_count() const	{ return PORTS_1_0; }
+    const char *processing() const	{ return PULL; }
+
+    int configure_phase() const		{ return FromXDP::CONFIGURE_PHASE_TOXDP; }
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    Task _task;
+    NotifierSignal _signal;
+    FromXDP *_fx;
+    PacketBatch _pending;	// pulled packets waiting for ring space
+
+    String _ifname;
+    int _queue;
+    int _burst;
+
+    uint64_t _count;
+    uint64_t _zerocopy_count;
+    uint64_t _drops;
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
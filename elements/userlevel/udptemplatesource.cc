@@ -0,0 +1,360 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * udptemplatesource.{cc,hh} -- generates UDP packets from a template ring
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "udptemplatesource.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/packetbatch.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <clicknet/ether.h>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+UDPTemplateSource::UDPTemplateSource()
+    : _templates(0), _pos(0), _count(0), _seq(0), _copies(0),
+      _task(this), _timer(&_task)
+{
+}
+
+UDPTemplateSource::~UDPTemplateSource()
+{
+}
+
+int
+UDPTemplateSource::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    IPAddress srcip, dstip;
+    uint32_t rate = 0;
+    int limit = -1;
+    _len = 60;
+    _burst = 32;
+    _ntemplates = 1024;
+    _nsrcip = _ndstip = _nsport = _ndport = 1;
+    _stamp = _cksum = _active = true;
+    _stop = false;
+    if (Args(conf, this, errh)
+	.read_mp("SRCETH", _srceth)
+	.read_mp("SRCIP", srcip)
+	.read_mp("SPORT", IPPortArg(IP_PROTO_UDP), _sport)
+	.read_mp("DSTETH", _dsteth)
+	.read_mp("DSTIP", dstip)
+	.read_mp("DPORT", IPPortArg(IP_PROTO_UDP), _dport)
+	.read("LENGTH", _len)
+	.read("RATE", rate)
+	.read("LIMIT", limit)
+	.read("BURST", _burst)
+	.read("TEMPLATES", _ntemplates)
+	.read("SRCIPS", _nsrcip)
+	.read("DSTIPS", _ndstip)
+	.read("SPORTS", _nsport)
+	.read("DPORTS", _ndport)
+	.read("STAMP", _stamp)
+	.read("CHECKSUM", _cksum)
+	.read("ACTIVE", _active)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+
+    uint32_t min_len = sizeof(click_ether) + sizeof(click_ip) + sizeof(click_udp) + (_stamp ? 4 : 0);
+    if (_len < min_len || _len > 0xFFFF)
+	return errh->error("LENGTH must be between %u and 65535", min_len);
+    if (_burst < 1)
+	return errh->error("BURST must be positive");
+    if (_ntemplates < 1)
+	return errh->error("TEMPLATES must be positive");
+    if (_nsrcip < 1 || _ndstip < 1 || _nsport < 1 || _ndport < 1)
+	return errh->error("SRCIPS, DSTIPS, SPORTS and DPORTS must be positive");
+    _srcip = ntohl(srcip.addr());
+    _dstip = ntohl(dstip.addr());
+    _rate.set_rate(rate, errh);
+    _rate_limited = rate != 0;
+    _limit = (limit >= 0 ? unsigned(limit) : NO_LIMIT);
+    return 0;
+}
+
+WritablePacket *
+UDPTemplateSource::make_template() const
+{
+    // align the IP header
+    uint32_t headroom = ((Packet::default_headroom + sizeof(click_ether) + 3) & ~3)
+	- sizeof(click_ether);
+    WritablePacket *q = Packet::make(headroom, 0, _len, 0);
+    if (!q)
+	return 0;
+    memset(q->data(), 0, _len);
+
+    click_ether *ethh = reinterpret_cast<click_ether *>(q->data());
+    memcpy(ethh->ether_shost, _srceth.data(), 6);
+    memcpy(ethh->ether_dhost, _dsteth.data(), 6);
+    ethh->ether_type = htons(ETHERTYPE_IP);
+
+    click_ip *ip = reinterpret_cast<click_ip *>(ethh + 1);
+    ip->ip_v = 4;
+    ip->ip_hl = sizeof(click_ip) >> 2;
+    ip->ip_len = htons(_len - sizeof(click_ether));
+    ip->ip_ttl = 64;
+    ip->ip_p = IP_PROTO_UDP;
+    ip->ip_src.s_addr = htonl(_srcip);
+    ip->ip_dst.s_addr = htonl(_dstip);
+    ip->ip_sum = click_in_cksum(reinterpret_cast<unsigned char *>(ip), sizeof(click_ip));
+
+    click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
+    uint32_t ulen = _len - sizeof(click_ether) - sizeof(click_ip);
+    udp->uh_sport = htons(_sport);
+    udp->uh_dport = htons(_dport);
+    udp->uh_ulen = htons(ulen);
+    if (_cksum) {
+	unsigned csum = click_in_cksum(reinterpret_cast<unsigned char *>(udp), ulen);
+	udp->uh_sum = click_in_cksum_pseudohdr(csum, ip, ulen);
+	if (udp->uh_sum == 0)
+	    udp->uh_sum = 0xFFFF;
+    }
+
+    q->set_mac_header(q->data(), sizeof(click_ether));
+    q->set_ip_header(ip, sizeof(click_ip));
+    q->set_dst_ip_anno(IPAddress(ip->ip_dst));
+    return q;
+}
+
+int
+UDPTemplateSource::initialize(ErrorHandler *errh)
+{
+    if (!(_templates = new WritablePacket *[_ntemplates]))
+	return errh->error("out of memory");
+    for (uint32_t i = 0; i < _ntemplates; ++i)
+	if (!(_templates[i] = make_template())) {
+	    while (i > 0)
+		_templates[--i]->kill();
+	    delete[] _templates;
+	    _templates = 0;
+	    return errh->error("out of memory");
+	}
+    _isrcip = _idstip = _isport = _idport = 0;
+    ScheduleInfo::initialize_task(this, &_task, _active, errh);
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+UDPTemplateSource::cleanup(CleanupStage)
+{
+    if (_templates)
+	for (uint32_t i = 0; i < _ntemplates; ++i)
+	    if (_templates[i])
+		_templates[i]->kill();
+    delete[] _templates;
+    _templates = 0;
+}
+
+// Stores new_hw in *field, updating the checksums that cover it.
+static inline void
+update_halfword(uint16_t *field, uint16_t new_hw, uint16_t *sum1, uint16_t *sum2)
+{
+    uint16_t old_hw = *field;
+    if (old_hw != new_hw) {
+	*field = new_hw;
+	if (sum1)
+	    click_update_in_cksum(sum1, old_hw, new_hw);
+	if (sum2)
+	    click_update_in_cksum(sum2, old_hw, new_hw);
+    }
+}
+
+static inline void
+update_word(uint16_t *field, uint32_t new_w, uint16_t *sum1, uint16_t *sum2)
+{
+    // new_w is in network byte order
+    const uint16_t *hw = reinterpret_cast<const uint16_t *>(&new_w);
+    update_halfword(field, hw[0], sum1, sum2);
+    update_halfword(field + 1, hw[1], sum1, sum2);
+}
+
+inline Packet *
+UDPTemplateSource::next_packet()
+{
+    WritablePacket *&t = _templates[_pos];
+    if (++_pos == _ntemplates)
+	_pos = 0;
+    if (!t) {
+	if (!(t = make_template()))
+	    return 0;
+    } else if (t->shared()) {
+	// the last clone of this template is still in use
+	++_copies;
+	if (!(t = t->uniqueify()))
+	    return 0;
+    }
+
+    click_ip *ip = reinterpret_cast<click_ip *>(t->data() + sizeof(click_ether));
+    click_udp *udp = reinterpret_cast<click_udp *>(ip + 1);
+    uint16_t *udpsum = _cksum ? &udp->uh_sum : 0;
+
+    if (_nsrcip > 1)
+	update_word(reinterpret_cast<uint16_t *>(&ip->ip_src), htonl(_srcip + _isrcip), &ip->ip_sum, udpsum);
+    if (_ndstip > 1) {
+	update_word(reinterpret_cast<uint16_t *>(&ip->ip_dst), htonl(_dstip + _idstip), &ip->ip_sum, udpsum);
+	t->set_dst_ip_anno(IPAddress(ip->ip_dst));
+    }
+    if (_nsport > 1)
+	update_halfword(&udp->uh_sport, htons(_sport + _isport), udpsum, 0);
+    if (_ndport > 1)
+	update_halfword(&udp->uh_dport, htons(_dport + _idport), udpsum, 0);
+    if (_stamp)
+	update_word(reinterpret_cast<uint16_t *>(udp + 1), htonl(_seq), udpsum, 0);
+    if (_cksum && udp->uh_sum == 0)
+	udp->uh_sum = 0xFFFF;
+
+    if (++_isrcip == _nsrcip)
+	_isrcip = 0;
+    if (++_idstip == _ndstip)
+	_idstip = 0;
+    if (++_isport == _nsport)
+	_isport = 0;
+    if (++_idport == _ndport)
+	_idport = 0;
+    ++_seq;
+    return t->clone();
+}
+
+bool
+UDPTemplateSource::run_task(Task *)
+{
+    if (!_active)
+	return false;
+
+    uint32_t n = _burst;
+    if (_limit != NO_LIMIT) {
+	if (_count >= _limit) {
+	    if (_stop)
+		router()->please_stop_driver();
+	    return false;
+	}
+	if (_limit - _count < n)
+	    n = _limit - _count;
+    }
+
+    if (_rate_limited) {
+	// read the clock once per burst
+	Timestamp now = Timestamp::now_steady_fast();
+	uint32_t allowed = 0;
+	while (allowed < n && _rate.need_update(now)) {
+	    _rate.update();
+	    ++allowed;
+	}
+	if (allowed == 0) {
+	    Timestamp expiry = _rate.expiry();
+	    if (expiry - now > Timestamp::make_usec(100)) {
+		_timer.schedule_at_steady(expiry);
+		return false;
+	    }
+	    _task.fast_reschedule();
+	    return false;
+	}
+	n = allowed;
+    }
+
+    PacketBatch batch;
+    for (uint32_t i = 0; i < n; ++i)
+	if (Packet *p = next_packet())
+	    batch.push_back(p);
+	else
+	    break;
+    _count += batch.count();
+    bool worked = !batch.empty();
+    if (worked)
+	output(0).push_batch(batch);
+    _task.fast_reschedule();
+    return worked;
+}
+
+enum { h_count, h_copies, h_rate, h_limit, h_active, h_reset };
+
+String
+UDPTemplateSource::read_handler(Element *e, void *thunk)
+{
+    UDPTemplateSource *s = static_cast<UDPTemplateSource *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_count:
+	return String(s->_count);
+    case h_copies:
+	return String(s->_copies);
+    case h_rate:
+	return String(s->_rate_limited ? s->_rate.rate() : 0);
+    case h_limit:
+	return s->_limit != NO_LIMIT ? String(s->_limit) : String("-1");
+    case h_active:
+	return BoolArg::unparse(s->_active);
+    default:
+	return String();
+    }
+}
+
+int
+UDPTemplateSource::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    UDPTemplateSource *s = static_cast<UDPTemplateSource *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_rate: {
+	uint32_t rate;
+	if (!IntArg().parse(str, rate))
+	    return errh->error("syntax error");
+	s->_rate.set_rate(rate, errh);
+	s->_rate.reset();
+	s->_rate_limited = rate != 0;
+	break;
+    }
+    case h_limit: {
+	int limit;
+	if (!IntArg().parse(str, limit))
+	    return errh->error("syntax error");
+	s->_limit = (limit >= 0 ? unsigned(limit) : NO_LIMIT);
+	break;
+    }
+    case h_active:
+	if (!BoolArg().parse(str, s->_active))
+	    return errh->error("syntax error");
+	break;
+    case h_reset:
+	s->_count = s->_seq = 0;
+	s->_rate.reset();
+	break;
+    }
+    if (s->_active && !s->_task.scheduled()) {
+	s->_timer.unschedule();
+	s->_task.reschedule();
+    }
+    return 0;
+}
+
+void
+UDPTemplateSource::add_handlers()
+{
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("copies", read_handler, h_copies);
+    add_read_handler("rate", read_handler, h_rate);
+    add_write_handler("rate", write_handler, h_rate);
+    add_read_handler("limit", read_handler, h_limit, Handler::CALM);
+    add_write_handler("limit", write_handler, h_limit);
+    add_read_handler("active", read_handler, h_active, Handler::CHECKBOX);
+    add_write_handler("active", write_handler, h_active);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(UDPTemplateSource)
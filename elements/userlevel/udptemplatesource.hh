@@ -0,0 +1,228 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_UDPTEMPLATESOURCE_HH
+#define CLICK_UDPTEMPLATESOURCE_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+#include <click/gaprate.hh>
+#include <click/etheraddress.hh>
+#include <click/ipaddress.hh>
+CLICK_DECLS
+
+/*
+=c
+
+UDPTemplateSource(SRCETH, SRCIP, SPORT, DSTETH, DSTIP, DPORT [, I<keywords>])
+
+=s udp
+
+generates UDP/IP/Ethernet packets at high rates
+
+=d
+
+UDPTemplateSource is a traffic generator for load testing.  It emits
+Ethernet-encapsulated UDP packets of LENGTH bytes out its single push output
+in bursts of up to BURST packets, as fast as possible or at RATE packets per
+second, aiming for millions of packets per second from a single thread.
+
+At initialization, UDPTemplateSource builds a ring of TEMPLATES complete
+packets.  To emit a packet, it takes the next template, rewrites the fields
+that vary, updates the IP and UDP checksums incrementally, and emits a clone
+of the template, so no packet data is allocated or copied.  Once the clone
+is freed downstream, the template's buffer is free to be rewritten the next
+time around the ring.  If a clone is still alive then, for instance because
+it sits in a Queue, UDPTemplateSource copies the template to a new buffer
+and counts the copy in the C<copies> handler.  To avoid copies, choose
+TEMPLATES at least BURST plus the number of packets that can be in flight
+downstream.
+
+Because they share data with the templates, emitted packets must not be
+modified in place.  (Elements that modify packets, like EtherRewrite, copy
+shared packets automatically, which costs performance.)
+
+The following fields vary from packet to packet.  Each cycles through its
+range independently, so the number of distinct flows is the least common
+multiple of the ranges.
+
+=over 8
+
+=item *
+
+The source IP address steps through SRCIPS consecutive addresses starting at
+SRCIP, and the destination address through DSTIPS addresses starting at
+DSTIP.
+
+=item *
+
+The source and destination UDP ports step through SPORTS ports starting at
+SPORT and DPORTS ports starting at DPORT.
+
+=item *
+
+If STAMP is true, the first four bytes of the UDP payload hold the packet's
+sequence number, counting from 0, in network byte order.
+
+=back
+
+For pacing, UDPTemplateSource reads the clock, which the user-level driver
+computes from the processor's cycle counter where possible, once per burst,
+and sends however many packets the rate allows, up to BURST.  Its task stays
+scheduled while it is at most 100 microseconds ahead of RATE; otherwise it
+sleeps on a timer.
+
+Keyword arguments are:
+
+=over 8
+
+=item LENGTH
+
+Integer.  Frame length in bytes, including the Ethernet header.  At least 42,
+or 46 if STAMP is true.  Default is 60.
+
+=item RATE
+
+Integer.  Packets per second.  0 means as fast as possible.  Default is 0.
+
+=item LIMIT
+
+Integer.  Total number of packets to send; negative means no limit.  Default
+is -1.
+
+=item BURST
+
+Integer.  Maximum number of packets emitted per task call, as one packet
+batch.  Default is 32.
+
+=item TEMPLATES
+
+Integer.  Number of template packets in the ring.  Default is 1024.
+
+=item SRCIPS, DSTIPS, SPORTS, DPORTS
+
+Integers.  Sizes of the source and destination address and port ranges.
+Defaults are 1.
+
+=item STAMP
+
+Boolean.  If true, stamp sequence numbers into the payloads.  Default is
+true.
+
+=item CHECKSUM
+
+Boolean.  If true, packets carry UDP checksums.  Default is true.
+
+=item ACTIVE
+
+Boolean.  If false, UDPTemplateSource does not send packets until it is
+activated.  Default is true.
+
+=item STOP
+
+Boolean.  If true, stop the driver once LIMIT packets are sent.  Default is
+false.
+
+=back
+
+=h count read-only
+
+Returns the number of packets sent.
+
+=h copies read-only
+
+Returns the number of times a template was still in use and had to be
+copied.
+
+=h rate read/write
+
+Returns or sets the RATE parameter.
+
+=h limit read/write
+
+Returns or sets the LIMIT parameter.
+
+=h active read/write
+
+Makes the element active or inactive.
+
+=h reset write-only
+
+Resets the count and sequence number, so that another LIMIT packets are
+sent.
+
+=e
+
+  UDPTemplateSource(0:0:0:0:0:1, 10.0.0.1, 1000, 0:0:0:0:0:2, 10.1.0.0, 2000,
+                    DSTIPS 256, SPORTS 100, LENGTH 64)
+    -> ToDevice(eth0);
+
+=a
+
+RatedSource, InfiniteSource, FastUDPFlows, FastUDPSource */
+
+class UDPTemplateSource : public Element { public:
+
+    UDPTemplateSource();
+    ~UDPTemplateSource();
+
+    const char *class_name() const	{ return "UDPTemplateSource"; }
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    bool run_task(Task *task);
+
+  private:
+
+    enum { NO_LIMIT = 0xFFFFFFFFU };
+
+    EtherAddress _srceth;
+    EtherAddress _dsteth;
+    uint32_t _srcip;		// host byte order
+    uint32_t _dstip;
+    uint16_t _sport;
+    uint16_t _dport;
+    uint32_t _nsrcip;
+    uint32_t _ndstip;
+    uint32_t _nsport;
+    uint32_t _ndport;
+    uint32_t _len;
+    uint32_t _burst;
+    uint32_t _ntemplates;
+    bool _stamp;
+    bool _cksum;
+    bool _active;
+    bool _stop;
+
+    // index of each varying field within its range
+    uint32_t _isrcip;
+    uint32_t _idstip;
+    uint32_t _isport;
+    uint32_t _idport;
+
+    WritablePacket **_templates;
+    uint32_t _pos;
+
+    uint32_t _count;
+    uint32_t _limit;
+    uint32_t _seq;
+    uint32_t _copies;
+    GapRate _rate;
+    bool _rate_limited;
+
+    Task _task;
+    Timer _timer;
+
+    WritablePacket *make_template() const;
+    inline Packet *next_packet();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
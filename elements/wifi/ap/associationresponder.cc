@@ -242,7 +242,7 @@ void
 AssociationResponder::send_association_response(EtherAddress dst, uint16_t status, uint16_t associd)
 {
   EtherAddress bssid = _winfo ? _winfo->_bssid : EtherAddress();
-  Vector<int> rates = _rtable->lookup(bssid);
+  const Vector<int> &rates = _rtable->lookup(bssid);
   int max_len = sizeof (struct click_wifi) +
     2 +                  /* cap_info */
     2 +                  /* status  */
@@ -84,7 +84,7 @@ BeaconSource::send_beacon(EtherAddress dst, bool probe)
 {
   EtherAddress bssid = _winfo ? _winfo->_bssid : EtherAddress();
   String my_ssid = _winfo ? _winfo->_ssid : "";
-  Vector<int> rates = _rtable->lookup(bssid);
+  const Vector<int> &rates = _rtable->lookup(bssid);
 
   /* order elements by standard
    * needed by sloppy 802.11b driver implementations
@@ -184,7 +184,7 @@ void
 ProbeResponder::send_probe_response(EtherAddress dst)
 {
 
-  Vector<int> rates = _rtable->lookup(_bssid);
+  const Vector<int> &rates = _rtable->lookup(_bssid);
   int len = sizeof (struct click_wifi) +
     8 +                  /* timestamp */
     2 +                  /* beacon interval */
@@ -24,6 +24,7 @@
 #include <clicknet/ether.h>
 #include <clicknet/wifi.h>
 #include <elements/wifi/availablerates.hh>
+#include <elements/wifi/bitrate.hh>
 #include "autoratefallback.hh"
 
 CLICK_DECLS
@@ -91,16 +92,20 @@ AutoRateFallback::process_feedback(Packet *p_in)
     return;
   }
 
-  DstInfo *nfo = _neighbors.findp(dst);
+  DstInfo *nfo = _neighbors.get_pointer(dst);
   if (!nfo) {
     return;
   }
 
 
-  if (nfo->_rates[nfo->_current_index] != rate) {
+  if (nfo->_stats.rate(nfo->_current_index) != rate) {
     return;
   }
 
+  nfo->_stats.update(rate, Timestamp::recent(), success && !used_alt_rate,
+		     calc_usecs_wifi_packet(1500, rate, eh->retries),
+		     eh->retries + 1);
+
 
   if (used_alt_rate || !success) {
     /* step down 1 or 2 rates */
@@ -113,8 +118,8 @@ AutoRateFallback::process_feedback(Packet *p_in)
       click_chatter("%{element} stepping down for %s from %d to %d\n",
 		    this,
 		    nfo->_eth.unparse().c_str(),
-		    nfo->_rates[nfo->_current_index],
-		    nfo->_rates[next_index]);
+		    nfo->_stats.rate(nfo->_current_index),
+		    nfo->_stats.rate(next_index));
     }
 
     if (nfo->_wentup && _adaptive_stepup) {
@@ -145,16 +150,16 @@ AutoRateFallback::process_feedback(Packet *p_in)
 
   if (nfo->_successes > nfo->_stepup &&
 
-      nfo->_current_index != nfo->_rates.size() - 1) {
+      nfo->_current_index != nfo->_stats.size() - 1) {
     if (_debug) {
       click_chatter("%{element} steping up for %s from %d to %d\n",
 		    this,
 		    nfo->_eth.unparse().c_str(),
-		    nfo->_rates[nfo->_current_index],
-		    nfo->_rates[WIFI_MIN(nfo->_rates.size() - 1,
-					 nfo->_current_index + 1)]);
+		    nfo->_stats.rate(nfo->_current_index),
+		    nfo->_stats.rate(WIFI_MIN(nfo->_stats.size() - 1,
+					 nfo->_current_index + 1)));
     }
-    nfo->_current_index = WIFI_MIN(nfo->_current_index + 1, nfo->_rates.size() - 1);
+    nfo->_current_index = WIFI_MIN(nfo->_current_index + 1, nfo->_stats.size() - 1);
     nfo->_successes = 0;
     nfo->_wentup = true;
   }
@@ -178,7 +183,7 @@ AutoRateFallback::assign_rate(Packet *p_in)
   eh->magic = WIFI_EXTRA_MAGIC;
 
   if (dst.is_group()) {
-    Vector<int> rates = _rtable->lookup(_bcast);
+    const Vector<int> &rates = _rtable->lookup(_bcast);
     if (rates.size()) {
       eh->rate = rates[0];
     } else {
@@ -186,31 +191,31 @@ AutoRateFallback::assign_rate(Packet *p_in)
     }
     return;
   }
-  DstInfo *nfo = _neighbors.findp(dst);
-  if (!nfo || !nfo->_rates.size()) {
-    _neighbors.insert(dst, DstInfo(dst));
-    nfo = _neighbors.findp(dst);
-    nfo->_rates = _rtable->lookup(dst);
+  DstInfo *nfo = _neighbors.get_pointer(dst);
+  if (!nfo || !nfo->_stats.size()) {
+    _neighbors.set(dst, DstInfo(dst));
+    nfo = _neighbors.get_pointer(dst);
+    nfo->_stats.assign(_rtable->lookup(dst));
     nfo->_successes = 0;
     nfo->_wentup = false;
     nfo->_stepup = _stepup;
     /* start at the highest rate */
-    nfo->_current_index = nfo->_rates.size() - 1;
+    nfo->_current_index = nfo->_stats.size() - 1;
     if (_debug) {
       click_chatter("%{element} initial rate for %s is %d\n",
 		    this,
 		    nfo->_eth.unparse().c_str(),
-		    nfo->_rates[nfo->_current_index]);
+		    nfo->_stats.rate(nfo->_current_index));
     }
   }
 
 
 
   int ndx = nfo->_current_index;
-  eh->rate = nfo->_rates[ndx];
-  eh->rate1 = (ndx - 1 >= 0) ? nfo->_rates[WIFI_MAX(ndx - 1, 0)] : 0;
-  eh->rate2 = (ndx - 2 >= 0) ? nfo->_rates[WIFI_MAX(ndx - 2, 0)] : 0;
-  eh->rate3 = (ndx - 3 >= 0) ? nfo->_rates[WIFI_MAX(ndx - 3, 0)] : 0;
+  eh->rate = nfo->_stats.rate(ndx);
+  eh->rate1 = (ndx - 1 >= 0) ? nfo->_stats.rate(WIFI_MAX(ndx - 1, 0)) : 0;
+  eh->rate2 = (ndx - 2 >= 0) ? nfo->_stats.rate(WIFI_MAX(ndx - 2, 0)) : 0;
+  eh->rate3 = (ndx - 3 >= 0) ? nfo->_stats.rate(WIFI_MAX(ndx - 3, 0)) : 0;
 
   eh->max_tries = 4;
   eh->max_tries1 = (ndx - 1 >= 0) ? 2 : 0;
@@ -253,17 +258,30 @@ AutoRateFallback::print_rates()
 {
     StringAccum sa;
   for (NIter iter = _neighbors.begin(); iter.live(); iter++) {
-    DstInfo nfo = iter.value();
+    const DstInfo &nfo = iter.value();
     sa << nfo._eth << " ";
-    sa << nfo._rates[nfo._current_index] << " ";
+    sa << nfo._stats.rate(nfo._current_index) << " ";
     sa << nfo._successes << "\n";
   }
   return sa.take_string();
 }
 
 
+String
+AutoRateFallback::print_stats()
+{
+  StringAccum sa;
+  for (NIter iter = _neighbors.begin(); iter.live(); iter++) {
+    const DstInfo &nfo = iter.value();
+    sa << nfo._eth << "\n";
+    nfo._stats.unparse(sa);
+  }
+  return sa.take_string();
+}
+
+
 enum {H_DEBUG, H_STEPUP, H_STEPDOWN, H_THRESHOLD, H_RATES, H_RESET,
-      H_OFFSET, H_ACTIVE};
+      H_OFFSET, H_ACTIVE, H_STATS};
 
 
 static String
@@ -284,6 +302,8 @@ AutoRateFallback_read_param(Element *e, void *thunk)
   case H_RATES: {
     return td->print_rates();
   }
+  case H_STATS:
+    return td->print_stats();
   case H_ACTIVE:
     return String(td->_active) + "\n";
   default:
@@ -352,6 +372,7 @@ AutoRateFallback::add_handlers()
 {
   add_read_handler("debug", AutoRateFallback_read_param, H_DEBUG);
   add_read_handler("rates", AutoRateFallback_read_param, H_RATES);
+  add_read_handler("stats", AutoRateFallback_read_param, H_STATS);
   add_read_handler("threshold", AutoRateFallback_read_param, H_THRESHOLD);
   add_read_handler("stepup", AutoRateFallback_read_param, H_STEPUP);
   add_read_handler("stepdown", AutoRateFallback_read_param, H_STEPDOWN);
@@ -368,5 +389,6 @@ AutoRateFallback::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(bitrate)
 EXPORT_ELEMENT(AutoRateFallback)
 
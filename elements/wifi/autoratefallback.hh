@@ -2,9 +2,11 @@
 #define CLICK_AUTORATEFALLBACK_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/bighashmap.hh>
+#include <click/hashtable.hh>
 #include <click/glue.hh>
+#include <elements/wifi/ratestats.hh>
 CLICK_DECLS
+class AvailableRates;
 
 /*
 =c
@@ -21,6 +23,10 @@ AutoRateFallback is based on the algorithm presented in
 Unliscensed Band" by Ad Kamerman and Leo Monteban
 Automatically determine the txrate for a give ethernet address.
 
+=h stats read-only
+Per-rate delivery ratio and airtime averages, and counts, for each
+neighbor.
+
 =a SetTXRate, FilterTX
 */
 
@@ -46,6 +52,7 @@ class AutoRateFallback : public Element { public:
   void add_handlers();
   static String static_print_stats(Element *e, void *);
   String print_rates();
+  String print_stats();
 
 
   EtherAddress _bcast;
@@ -63,7 +70,7 @@ class AutoRateFallback : public Element { public:
   public:
 
     EtherAddress _eth;
-    Vector<int> _rates;
+    RateStats _stats;
 
 
     int _current_index;
@@ -79,42 +86,31 @@ class AutoRateFallback : public Element { public:
       _eth = eth;
     }
 
-    int rate_index(int rate) {
-      int ndx = 0;
-      for (int x = 0; x < _rates.size(); x++) {
-	if (rate == _rates[x]) {
-	  ndx = x;
-	  break;
-	}
-      }
-      return (ndx == _rates.size()) ? -1 : ndx;
-    }
-
     int pick_rate() {
-      if (_rates.size() == 0) {
+      if (_stats.size() == 0) {
 	click_chatter("no rates to pick from for %s\n",
 		      _eth.unparse().c_str());
 	return 2;
       }
 
-      if (_current_index > 0 && _current_index < _rates.size()) {
-	return _rates[_current_index];
+      if (_current_index > 0 && _current_index < _stats.size()) {
+	return _stats.rate(_current_index);
       }
-      return _rates[0];
+      return _stats.rate(0);
     }
 
     int pick_alt_rate() {
-      if (_rates.size() == 0) {
+      if (_stats.size() == 0) {
 	click_chatter("no rates to pick from for %s\n",
 		      _eth.unparse().c_str());
 	return 2;
       }
-      return _rates[_current_index <= 0 ? 0 : _current_index - 1];
+      return _stats.rate(_current_index <= 0 ? 0 : _current_index - 1);
     }
   };
 
 
-  typedef HashMap<EtherAddress, DstInfo> NeighborTable;
+  typedef HashTable<EtherAddress, DstInfo> NeighborTable;
   typedef NeighborTable::const_iterator NIter;
 
   NeighborTable _neighbors;
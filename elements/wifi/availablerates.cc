@@ -110,24 +110,20 @@ AvailableRates::take_state(Element *e, ErrorHandler *)
 
 }
 
-Vector<int>
-AvailableRates::lookup(EtherAddress eth)
+const Vector<int> &
+AvailableRates::lookup(EtherAddress eth) const
 {
   if (!eth) {
     click_chatter("%s: lookup called with NULL eth!\n", name().c_str());
-    return Vector<int>();
+    return _no_rates;
   }
 
-  DstInfo *dst = _rtable.findp(eth);
+  const DstInfo *dst = _rtable.findp(eth);
   if (dst) {
     return dst->_rates;
   }
 
-  if (_default_rates.size()) {
-    return _default_rates;
-  }
-
-  return Vector<int>();
+  return _default_rates;
 }
 
 int
@@ -48,7 +48,7 @@ class AvailableRates : public Element { public:
   void add_handlers();
   void take_state(Element *e, ErrorHandler *);
 
-  Vector<int> lookup(EtherAddress eth);
+  const Vector<int> &lookup(EtherAddress eth) const;
   int insert(EtherAddress eth, Vector<int>);
 
   EtherAddress _bcast;
@@ -76,6 +76,7 @@ class AvailableRates : public Element { public:
   RTable _rtable;
   Vector<int> _default_rates;
 private:
+  Vector<int> _no_rates;
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,143 @@
+/*
+ * ccmp.{cc,hh} -- AES-CCM for the 802.11 CCMP elements
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ccmp.hh"
+CLICK_DECLS
+
+int
+CCMP::header_length(const uint8_t *frame, int len)
+{
+  if (len < (int) sizeof(click_wifi))
+    return 0;
+  const click_wifi *w = (const click_wifi *) frame;
+  if ((w->i_fc[0] & WIFI_FC0_TYPE_MASK) != WIFI_FC0_TYPE_DATA
+      || (w->i_fc[0] & WIFI_FC0_SUBTYPE_NODATA))
+    return 0;
+  int hdrlen = sizeof(click_wifi);
+  if ((w->i_fc[1] & WIFI_FC1_DIR_MASK) == WIFI_FC1_DIR_DSTODS)
+    hdrlen += WIFI_ADDR_LEN;
+  if (WIFI_QOS_HAS_SEQ(w))
+    hdrlen += 2;
+  return (len >= hdrlen ? hdrlen : 0);
+}
+
+void
+CCMP::prepare(AESNI::CCMJob &job, uint8_t *frame, int hdrlen, int len)
+{
+  const click_wifi *w = (const click_wifi *) frame;
+  const uint8_t *ccmp = frame + hdrlen;
+  bool four = (w->i_fc[1] & WIFI_FC1_DIR_MASK) == WIFI_FC1_DIR_DSTODS;
+  bool qos = WIFI_QOS_HAS_SEQ(w);
+
+  // nonce: priority, transmitter address, packet number (big endian)
+  uint8_t *nonce = job.b0 + 1;
+  nonce[0] = (qos ? frame[hdrlen - 2] & 0x0F : 0);
+  memcpy(nonce + 1, w->i_addr2, WIFI_ADDR_LEN);
+  nonce[7] = ccmp[7];
+  nonce[8] = ccmp[6];
+  nonce[9] = ccmp[5];
+  nonce[10] = ccmp[4];
+  nonce[11] = ccmp[1];
+  nonce[12] = ccmp[0];
+  // 8-byte MIC, 2-byte length field
+  job.b0[0] = 0x59;
+  job.b0[14] = len >> 8;
+  job.b0[15] = len;
+  memcpy(job.a0, job.b0, 14);
+  job.a0[0] = 0x01;
+  job.a0[14] = job.a0[15] = 0;
+
+  // AAD: the header with the fields that may change in transit masked
+  uint8_t *aad = job.aad;
+  aad[0] = w->i_fc[0] & ~(WIFI_FC0_SUBTYPE_MASK & ~WIFI_FC0_SUBTYPE_QOS);
+  aad[1] = (w->i_fc[1] & ~(WIFI_FC1_RETRY | WIFI_FC1_PWR_MGT | WIFI_FC1_MORE_DATA))
+    | WIFI_FC1_WEP;
+  memcpy(aad + 2, w->i_addr1, 3 * WIFI_ADDR_LEN);
+  aad[20] = frame[22] & WIFI_SEQ_FRAG_MASK;
+  aad[21] = 0;
+  int n = 22;
+  if (four) {
+    memcpy(aad + n, frame + sizeof(click_wifi), WIFI_ADDR_LEN);
+    n += WIFI_ADDR_LEN;
+  }
+  if (qos) {
+    aad[n] = frame[hdrlen - 2] & 0x0F;
+    aad[n + 1] = 0;
+    n += 2;
+  }
+  job.aad_len = n;
+  job.data = frame + hdrlen + WIFI_CCMP_HEADERSIZE;
+  job.len = len;
+}
+
+static void
+soft_mac(uint8_t *x, const uint8_t *data, int len, const AES_KEY *key)
+{
+  for (; len > 0; data += 16, len -= 16) {
+    int n = (len < 16 ? len : 16);
+    for (int i = 0; i < n; i++)
+      x[i] ^= data[i];
+    Aes::AES_encrypt(x, x, key);
+  }
+}
+
+static void
+soft_ctr(const uint8_t *a0, uint8_t *data, int len, const AES_KEY *key)
+{
+  uint8_t ctr[16], ks[16];
+  memcpy(ctr, a0, 16);
+  for (int c = 1; len > 0; c++, data += 16, len -= 16) {
+    ctr[14] = c >> 8;
+    ctr[15] = c;
+    Aes::AES_encrypt(ctr, ks, key);
+    int n = (len < 16 ? len : 16);
+    for (int i = 0; i < n; i++)
+      data[i] ^= ks[i];
+  }
+}
+
+void
+CCMP::soft_crypt(AESNI::CCMJob &job, bool encrypt) const
+{
+  const AES_KEY *key = &_key.soft();
+  uint8_t x[16], head[2 + AESNI::CCM_MAX_AAD];
+  Aes::AES_encrypt(job.b0, x, key);
+  head[0] = job.aad_len >> 8;
+  head[1] = job.aad_len;
+  memcpy(head + 2, job.aad, job.aad_len);
+  soft_mac(x, head, 2 + job.aad_len, key);
+  if (!encrypt)
+    soft_ctr(job.a0, job.data, job.len, key);
+  soft_mac(x, job.data, job.len, key);
+  if (encrypt)
+    soft_ctr(job.a0, job.data, job.len, key);
+  Aes::AES_encrypt(job.a0, job.tag, key);
+  for (int i = 0; i < 16; i++)
+    job.tag[i] ^= x[i];
+}
+
+void
+CCMP::crypt(AESNI::CCMJob *jobs, int njobs, bool encrypt) const
+{
+  if (_aesni)
+    AESNI::ccm_crypt(_key.aesni(), jobs, njobs, encrypt);
+  else
+    for (int i = 0; i < njobs; i++)
+      soft_crypt(jobs[i], encrypt);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(Aes IPsecAESNI)
+ELEMENT_PROVIDES(CCMP)
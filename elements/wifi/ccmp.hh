@@ -0,0 +1,66 @@
+#ifndef CLICK_CCMP_HH
+#define CLICK_CCMP_HH
+#include <click/glue.hh>
+#include <clicknet/wifi.h>
+#include <elements/ipsec/aes.hh>
+CLICK_DECLS
+
+/*
+ * AES-CCM for CCMPEncap and CCMPDecap, as in IEEE 802.11i CCMP.
+ * prepare() builds a frame's CCM nonce and additional authenticated data
+ * from its 802.11 and CCMP headers; crypt() then encrypts or decrypts a
+ * batch of prepared frames.  crypt() uses the AES-NI kernel, which works
+ * on several frames at once, when the CPU has it, and the table-driven
+ * AES code otherwise.
+ */
+class CCMP { public:
+
+  enum { KEYLEN = 16, BATCH = 16 };
+
+  CCMP() : _aesni(false) { }
+
+  void set_key(const uint8_t *key, bool aesni) {
+    _aesni = aesni && AESNI::available();
+    _key.set(key, _aesni);
+  }
+  bool aesni() const		{ return _aesni; }
+
+  // Length of the 802.11 header of the len-byte frame, or 0 if the frame
+  // is not a data frame that CCMP protects.
+  static int header_length(const uint8_t *frame, int len);
+
+  static uint64_t packet_number(const uint8_t *ccmp) {
+    return ccmp[0] | (ccmp[1] << 8) | ((uint64_t) ccmp[4] << 16)
+      | ((uint64_t) ccmp[5] << 24) | ((uint64_t) ccmp[6] << 32)
+      | ((uint64_t) ccmp[7] << 40);
+  }
+  static void set_header(uint8_t *ccmp, uint64_t pn, int keyid) {
+    ccmp[0] = pn;
+    ccmp[1] = pn >> 8;
+    ccmp[2] = 0;
+    ccmp[3] = WIFI_CCMP_EXTIV | (keyid << 6);
+    ccmp[4] = pn >> 16;
+    ccmp[5] = pn >> 24;
+    ccmp[6] = pn >> 32;
+    ccmp[7] = pn >> 40;
+  }
+
+  // Prepare job for frame, whose hdrlen-byte 802.11 header is followed by
+  // the CCMP header, len bytes of data, and room for the MIC.
+  static void prepare(AESNI::CCMJob &job, uint8_t *frame, int hdrlen, int len);
+
+  // Encrypt or decrypt the prepared jobs in place, leaving each one's MIC
+  // in the first WIFI_CCMP_MICLEN bytes of its tag.
+  void crypt(AESNI::CCMJob *jobs, int njobs, bool encrypt) const;
+
+ private:
+
+  bool _aesni;
+  AESKeyCache _key;
+
+  void soft_crypt(AESNI::CCMJob &job, bool encrypt) const;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,213 @@
+/*
+ * ccmpdecap.{cc,hh} -- decrypts 802.11 frames protected with CCMP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ccmpdecap.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+CCMPDecap::CCMPDecap()
+{
+  _drops = 0;
+}
+
+CCMPDecap::~CCMPDecap()
+{
+}
+
+int
+CCMPDecap::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+  String key;
+  _keyid = 0;
+  _aesni = true;
+  _debug = false;
+  if (Args(conf, this, errh)
+      .read_mp("KEY", key)
+      .read("KEYID", _keyid)
+      .read("AESNI", _aesni)
+      .read("DEBUG", _debug)
+      .complete() < 0)
+    return -1;
+  if (key.length() != CCMP::KEYLEN)
+    return errh->error("KEY must be %d bytes", CCMP::KEYLEN);
+  if (_keyid < 0 || _keyid > 3)
+    return errh->error("KEYID must be between 0 and 3");
+  _ccmp.set_key((const uint8_t *) key.data(), _aesni);
+  return 0;
+}
+
+Packet *
+CCMPDecap::prepare(Packet *p_in, AESNI::CCMJob &job, bool &queued)
+{
+  queued = false;
+  const click_wifi *w = (const click_wifi *) p_in->data();
+  int hdrlen = CCMP::header_length(p_in->data(), p_in->length());
+  if (!hdrlen || !(w->i_fc[1] & WIFI_FC1_WEP))
+    return p_in;
+  int len = p_in->length() - hdrlen - WIFI_CCMP_HEADERSIZE - WIFI_CCMP_MICLEN;
+  if (len < 0) {
+    _drops++;
+    p_in->kill();
+    return 0;
+  }
+  const uint8_t *ccmp = p_in->data() + hdrlen;
+  if (!(ccmp[3] & WIFI_CCMP_EXTIV) || (ccmp[3] >> 6) != _keyid)
+    return p_in;
+
+  WritablePacket *p = p_in->uniqueify();
+  if (!p)
+    return 0;
+  CCMP::prepare(job, p->data(), hdrlen, len);
+  queued = true;
+  return p;
+}
+
+WritablePacket *
+CCMPDecap::finish(WritablePacket *p, const AESNI::CCMJob &job)
+{
+  uint8_t diff = 0;
+  for (int i = 0; i < WIFI_CCMP_MICLEN; i++)
+    diff |= job.data[job.len + i] ^ job.tag[i];
+  if (diff) {
+    if (_debug) {
+      const uint8_t *ccmp = job.data - WIFI_CCMP_HEADERSIZE;
+      click_chatter("%p{element}: MIC failed keyid %d pn %llu", this,
+		    ccmp[3] >> 6, (unsigned long long) CCMP::packet_number(ccmp));
+    }
+    _drops++;
+    p->kill();
+    return 0;
+  }
+
+  int hdrlen = job.data - WIFI_CCMP_HEADERSIZE - p->data();
+  memmove(p->data() + WIFI_CCMP_HEADERSIZE, p->data(), hdrlen);
+  p->pull(WIFI_CCMP_HEADERSIZE);
+  p->take(WIFI_CCMP_MICLEN);
+  struct click_wifi *w = (struct click_wifi *) p->data();
+  w->i_fc[1] &= ~WIFI_FC1_WEP;
+  return p;
+}
+
+Packet *
+CCMPDecap::simple_action(Packet *p)
+{
+  AESNI::CCMJob job;
+  bool queued;
+  if ((p = prepare(p, job, queued)) && queued) {
+    _ccmp.crypt(&job, 1, false);
+    p = finish(static_cast<WritablePacket *>(p), job);
+  }
+  return p;
+}
+
+void
+CCMPDecap::simple_action_batch(PacketBatch &batch)
+{
+  // Prepare up to BATCH frames, decrypt them together, then verify each.
+  PacketBatch out;
+  while (!batch.empty()) {
+    AESNI::CCMJob jobs[CCMP::BATCH];
+    Packet *ps[CCMP::BATCH];
+    bool queued[CCMP::BATCH];
+    int np = 0, njobs = 0;
+    while (np < CCMP::BATCH && !batch.empty())
+      if ((ps[np] = prepare(batch.pop_front(), jobs[njobs], queued[np]))) {
+	njobs += queued[np];
+	np++;
+      }
+    if (njobs)
+      _ccmp.crypt(jobs, njobs, false);
+    for (int i = 0, j = 0; i < np; i++) {
+      Packet *p = ps[i];
+      if (queued[i])
+	p = finish(static_cast<WritablePacket *>(p), jobs[j++]);
+      if (p)
+	out.push_back(p);
+    }
+  }
+  batch.swap(out);
+}
+
+void
+CCMPDecap::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+CCMPDecap::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
+enum { H_KEYID, H_KEY, H_DROPS };
+
+String
+CCMPDecap::read_param(Element *e, void *thunk)
+{
+  CCMPDecap *cd = (CCMPDecap *) e;
+  switch ((uintptr_t) thunk) {
+  case H_KEYID:
+    return String(cd->_keyid);
+  case H_DROPS:
+    return String(cd->_drops.value());
+  default:
+    return String();
+  }
+}
+
+int
+CCMPDecap::write_param(const String &in_s, Element *e, void *thunk,
+		       ErrorHandler *errh)
+{
+  CCMPDecap *cd = (CCMPDecap *) e;
+  String s = cp_uncomment(in_s);
+  switch ((uintptr_t) thunk) {
+  case H_KEYID: {
+    int keyid;
+    if (!IntArg().parse(s, keyid) || keyid < 0 || keyid > 3)
+      return errh->error("keyid parameter must be between 0 and 3");
+    cd->_keyid = keyid;
+    break;
+  }
+  case H_KEY: {
+    String key;
+    if (!cp_string(s, &key) || key.length() != CCMP::KEYLEN)
+      return errh->error("key parameter must be %d bytes", CCMP::KEYLEN);
+    cd->_ccmp.set_key((const uint8_t *) key.data(), cd->_aesni);
+    break;
+  }
+  }
+  return 0;
+}
+
+void
+CCMPDecap::add_handlers()
+{
+  add_read_handler("keyid", read_param, H_KEYID);
+  add_read_handler("drops", read_param, H_DROPS);
+  add_write_handler("keyid", write_param, H_KEYID);
+  add_write_handler("key", write_param, H_KEY);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(CCMP)
+EXPORT_ELEMENT(CCMPDecap)
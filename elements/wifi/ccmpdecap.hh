@@ -0,0 +1,110 @@
+#ifndef CLICK_CCMPDECAP_HH
+#define CLICK_CCMPDECAP_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <clicknet/wifi.h>
+#include "ccmp.hh"
+CLICK_DECLS
+
+/*
+=c
+
+CCMPDecap(KEY [, I<keywords> KEYID, AESNI, DEBUG])
+
+=s Wifi
+
+decrypts 802.11 frames protected with CCMP (AES-CCM)
+
+=d
+
+Verifies and decrypts 802.11 data frames that CCMPEncap, or another
+802.11i implementation, protected with CCMP under the 16-byte temporal
+key KEY.  The CCMP header and MIC are removed and the Protected Frame bit
+is cleared, leaving a plain 802.11 frame.  Frames whose MIC does not
+verify, and protected frames too short to hold a CCMP header and MIC, are
+dropped.  Unprotected frames, WEP frames, and frames for other key IDs
+pass through unchanged.
+
+CCMPDecap does not check packet numbers for replays.
+
+Frames that arrive in a batch are decrypted together; with AES-NI, the
+serial CBC-MAC computations of several frames proceed side by side.
+
+Keyword arguments are:
+
+=over 8
+
+=item KEYID
+
+Integer between 0 and 3.  Only frames with this key ID are decrypted.
+Default is 0.
+
+=item AESNI
+
+Boolean.  If true, use the AES-NI instructions when the CPU supports them.
+The result is the same either way.  Default is true.
+
+=item DEBUG
+
+Boolean.  If true, report frames that fail verification.  Default is false.
+
+=back
+
+This element requires the ipsec package.
+
+=h keyid read/write
+
+The key ID.
+
+=h key write-only
+
+Sets a new 16-byte temporal key.
+
+=h drops read-only
+
+Returns the number of frames dropped.
+
+=e
+
+  ... -> CCMPDecap(KEY \<000102030405060708090a0b0c0d0e0f>)
+      -> WifiDecap -> ...
+
+=a CCMPEncap, WepDecap, IPsecAESGCM
+ */
+
+class CCMPDecap : public Element { public:
+
+  CCMPDecap();
+  ~CCMPDecap();
+
+  const char *class_name() const	{ return "CCMPDecap"; }
+  const char *port_count() const	{ return PORTS_1_1; }
+  const char *processing() const	{ return AGNOSTIC; }
+
+  int configure(Vector<String> &, ErrorHandler *);
+  bool can_live_reconfigure() const	{ return true; }
+  void add_handlers();
+
+  Packet *simple_action(Packet *);
+  void simple_action_batch(PacketBatch &);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, PacketBatch &batch, int max);
+
+ private:
+
+  CCMP _ccmp;
+  int _keyid;
+  bool _aesni;
+  bool _debug;
+  atomic_uint32_t _drops;
+
+  Packet *prepare(Packet *p, AESNI::CCMJob &job, bool &queued);
+  WritablePacket *finish(WritablePacket *p, const AESNI::CCMJob &job);
+
+  static String read_param(Element *e, void *thunk);
+  static int write_param(const String &in_s, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
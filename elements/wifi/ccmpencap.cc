@@ -0,0 +1,200 @@
+/*
+ * ccmpencap.{cc,hh} -- encrypts 802.11 data frames with CCMP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ccmpencap.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+CCMPEncap::CCMPEncap()
+  : _pn(1)
+{
+}
+
+CCMPEncap::~CCMPEncap()
+{
+}
+
+int
+CCMPEncap::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+  String key;
+  _keyid = 0;
+  _active = true;
+  _aesni = true;
+  if (Args(conf, this, errh)
+      .read_mp("KEY", key)
+      .read("KEYID", _keyid)
+      .read("ACTIVE", _active)
+      .read("AESNI", _aesni)
+      .complete() < 0)
+    return -1;
+  if (key.length() != CCMP::KEYLEN)
+    return errh->error("KEY must be %d bytes", CCMP::KEYLEN);
+  if (_keyid < 0 || _keyid > 3)
+    return errh->error("KEYID must be between 0 and 3");
+  _ccmp.set_key((const uint8_t *) key.data(), _aesni);
+  return 0;
+}
+
+Packet *
+CCMPEncap::prepare(Packet *p_in, AESNI::CCMJob &job, bool &queued)
+{
+  queued = false;
+  int hdrlen = CCMP::header_length(p_in->data(), p_in->length());
+  if (!_active || !hdrlen)
+    return p_in;
+
+  WritablePacket *p = p_in->push(WIFI_CCMP_HEADERSIZE);
+  if (!p)
+    return 0;
+  memmove(p->data(), p->data() + WIFI_CCMP_HEADERSIZE, hdrlen);
+  if (!(p = p->put(WIFI_CCMP_MICLEN)))
+    return 0;
+
+  struct click_wifi *w = (struct click_wifi *) p->data();
+  w->i_fc[1] |= WIFI_FC1_WEP;
+  CCMP::set_header(p->data() + hdrlen, _pn, _keyid);
+  _pn++;
+  int len = p->length() - hdrlen - WIFI_CCMP_HEADERSIZE - WIFI_CCMP_MICLEN;
+  CCMP::prepare(job, p->data(), hdrlen, len);
+  queued = true;
+  return p;
+}
+
+inline void
+CCMPEncap::finish(AESNI::CCMJob &job)
+{
+  memcpy(job.data + job.len, job.tag, WIFI_CCMP_MICLEN);
+}
+
+Packet *
+CCMPEncap::simple_action(Packet *p)
+{
+  AESNI::CCMJob job;
+  bool queued;
+  if ((p = prepare(p, job, queued)) && queued) {
+    _ccmp.crypt(&job, 1, true);
+    finish(job);
+  }
+  return p;
+}
+
+void
+CCMPEncap::simple_action_batch(PacketBatch &batch)
+{
+  // Prepare up to BATCH frames, then encrypt them together.
+  PacketBatch out;
+  while (!batch.empty()) {
+    AESNI::CCMJob jobs[CCMP::BATCH];
+    int njobs = 0;
+    PacketBatch chunk;
+    while (njobs < CCMP::BATCH && !batch.empty()) {
+      bool queued;
+      if (Packet *p = prepare(batch.pop_front(), jobs[njobs], queued)) {
+	chunk.push_back(p);
+	njobs += queued;
+      }
+    }
+    if (njobs) {
+      _ccmp.crypt(jobs, njobs, true);
+      for (int i = 0; i < njobs; i++)
+	finish(jobs[i]);
+    }
+    out.append(chunk);
+  }
+  batch.swap(out);
+}
+
+void
+CCMPEncap::push_batch(int port, PacketBatch &batch)
+{
+  simple_action_batch(batch);
+  output(port).push_batch(batch);
+}
+
+void
+CCMPEncap::pull_batch(int port, PacketBatch &batch, int max)
+{
+  PacketBatch b;
+  input(port).pull_batch(b, max);
+  simple_action_batch(b);
+  batch.append(b);
+}
+
+enum { H_ACTIVE, H_KEYID, H_KEY, H_PN };
+
+String
+CCMPEncap::read_param(Element *e, void *thunk)
+{
+  CCMPEncap *ce = (CCMPEncap *) e;
+  switch ((uintptr_t) thunk) {
+  case H_ACTIVE:
+    return String(ce->_active);
+  case H_KEYID:
+    return String(ce->_keyid);
+  case H_PN:
+    return String(ce->_pn);
+  default:
+    return String();
+  }
+}
+
+int
+CCMPEncap::write_param(const String &in_s, Element *e, void *thunk,
+		       ErrorHandler *errh)
+{
+  CCMPEncap *ce = (CCMPEncap *) e;
+  String s = cp_uncomment(in_s);
+  switch ((uintptr_t) thunk) {
+  case H_ACTIVE:
+    if (!BoolArg().parse(s, ce->_active))
+      return errh->error("active parameter must be boolean");
+    break;
+  case H_KEYID: {
+    int keyid;
+    if (!IntArg().parse(s, keyid) || keyid < 0 || keyid > 3)
+      return errh->error("keyid parameter must be between 0 and 3");
+    ce->_keyid = keyid;
+    break;
+  }
+  case H_KEY: {
+    String key;
+    if (!cp_string(s, &key) || key.length() != CCMP::KEYLEN)
+      return errh->error("key parameter must be %d bytes", CCMP::KEYLEN);
+    // packet numbers count per key
+    ce->_ccmp.set_key((const uint8_t *) key.data(), ce->_aesni);
+    ce->_pn = 1;
+    break;
+  }
+  }
+  return 0;
+}
+
+void
+CCMPEncap::add_handlers()
+{
+  add_read_handler("active", read_param, H_ACTIVE);
+  add_read_handler("keyid", read_param, H_KEYID);
+  add_read_handler("pn", read_param, H_PN);
+  add_write_handler("active", write_param, H_ACTIVE);
+  add_write_handler("keyid", write_param, H_KEYID);
+  add_write_handler("key", write_param, H_KEY);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(CCMP)
+EXPORT_ELEMENT(CCMPEncap)
@@ -0,0 +1,116 @@
+#ifndef CLICK_CCMPENCAP_HH
+#define CLICK_CCMPENCAP_HH
+#include <click/element.hh>
+#include <clicknet/wifi.h>
+#include "ccmp.hh"
+CLICK_DECLS
+
+/*
+=c
+
+CCMPEncap(KEY [, I<keywords> KEYID, ACTIVE, AESNI])
+
+=s Wifi
+
+encrypts 802.11 data frames with CCMP (AES-CCM)
+
+=d
+
+Encrypts and authenticates 802.11 data frames with the 802.11i CCMP
+cipher, using the 16-byte temporal key KEY.  Each frame gets an 8-byte
+CCMP header, holding a 48-bit packet number and the key ID, after its
+802.11 header, and an 8-byte MIC at its end, and its Protected Frame bit
+is set.  The MIC covers the payload and the parts of the 802.11 header
+that do not change in transit.  Three- and four-address frames and QoS
+data frames are handled; frames other than data frames, and data frames
+without a payload, pass through unchanged.
+
+Packet numbers start at 1 and are never reused by one CCMPEncap element,
+so do not let two elements encrypt with the same key.
+
+Frames that arrive in a batch are encrypted together; with AES-NI, the
+serial CBC-MAC computations of several frames proceed side by side.
+
+Keyword arguments are:
+
+=over 8
+
+=item KEYID
+
+Integer between 0 and 3.  The key ID to put in the CCMP header.  Default
+is 0.
+
+=item ACTIVE
+
+Boolean.  If false, pass all frames through unchanged.  Default is true.
+
+=item AESNI
+
+Boolean.  If true, use the AES-NI instructions when the CPU supports them.
+The result is the same either way.  Default is true.
+
+=back
+
+This element requires the ipsec package.
+
+=h active read/write
+
+Whether the element encrypts frames.
+
+=h keyid read/write
+
+The key ID.
+
+=h key write-only
+
+Sets a new 16-byte temporal key and restarts the packet numbers at 1.
+
+=h pn read-only
+
+Returns the packet number the next frame will use.
+
+=e
+
+  ... -> WifiEncap(0x00, 00:00:00:00:00:00)
+      -> CCMPEncap(KEY \<000102030405060708090a0b0c0d0e0f>)
+      -> ...
+
+=a CCMPDecap, WepEncap, IPsecAESGCM
+ */
+
+class CCMPEncap : public Element { public:
+
+  CCMPEncap();
+  ~CCMPEncap();
+
+  const char *class_name() const	{ return "CCMPEncap"; }
+  const char *port_count() const	{ return PORTS_1_1; }
+  const char *processing() const	{ return AGNOSTIC; }
+
+  int configure(Vector<String> &, ErrorHandler *);
+  bool can_live_reconfigure() const	{ return true; }
+  void add_handlers();
+
+  Packet *simple_action(Packet *);
+  void simple_action_batch(PacketBatch &);
+  void push_batch(int port, PacketBatch &batch);
+  void pull_batch(int port, PacketBatch &batch, int max);
+
+ private:
+
+  CCMP _ccmp;
+  uint64_t _pn;
+  int _keyid;
+  bool _active;
+  bool _aesni;
+
+  Packet *prepare(Packet *p, AESNI::CCMJob &job, bool &queued);
+  static void finish(AESNI::CCMJob &job);
+
+  static String read_param(Element *e, void *thunk);
+  static int write_param(const String &in_s, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
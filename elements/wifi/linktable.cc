@@ -23,10 +23,11 @@
 #include <click/glue.hh>
 #include <elements/wifi/path.hh>
 #include <click/straccum.hh>
+#include <click/heap.hh>
 CLICK_DECLS
 
 LinkTable::LinkTable()
-  : _timer(this)
+  : _graph_valid(false), _timer(this)
 {
 }
 
@@ -88,6 +89,7 @@ LinkTable::take_state(Element *e, ErrorHandler *) {
 
   _hosts = q->_hosts;
   _links = q->_links;
+  _graph_valid = false;
   dijkstra(true);
   dijkstra(false);
 }
@@ -137,7 +139,7 @@ LinkTable::clear()
 {
   _hosts.clear();
   _links.clear();
-
+  _graph_valid = false;
 }
 bool
 LinkTable::update_link(IPAddress from, IPAddress to,
@@ -152,12 +154,16 @@ LinkTable::update_link(IPAddress from, IPAddress to,
 
   /* make sure both the hosts exist */
   HostInfo *nfrom = _hosts.findp(from);
+  HostInfo *nto = _hosts.findp(to);
+  if (memory_limit() && (!nfrom || !nto || !_links.findp(IPPair(from, to)))
+      && memory_exceeded()) {
+    return false;
+  }
   if (!nfrom) {
     HostInfo foo = HostInfo(from);
     _hosts.insert(from, foo);
     nfrom = _hosts.findp(from);
   }
-  HostInfo *nto = _hosts.findp(to);
   if (!nto) {
     _hosts.insert(to, HostInfo(to));
     nto = _hosts.findp(to);
@@ -168,15 +174,50 @@ LinkTable::update_link(IPAddress from, IPAddress to,
 
   IPPair p = IPPair(from, to);
   LinkInfo *lnfo = _links.findp(p);
+  uint32_t old_metric = 0;
   if (!lnfo) {
     _links.insert(p, LinkInfo(from, to, seq, age, metric));
   } else {
+    old_metric = lnfo->_metric;
     lnfo->update(seq, age, metric);
+    metric = lnfo->_metric;
+  }
+
+  if (_graph_valid && metric != old_metric) {
+    int f = graph_host(from);
+    int t = graph_host(to);
+    set_edge(f, t, metric);
+    repair(true, f, t, old_metric, metric);
+    repair(false, f, t, old_metric, metric);
   }
   return true;
 }
 
 
+template <typename K, typename V>
+static size_t
+hashmap_memory(const HashMap<K, V> &m)
+{
+  return m.nbuckets() * sizeof(void *)
+    + m.size() * (sizeof(typename HashMap<K, V>::Pair) + sizeof(void *));
+}
+
+size_t
+LinkTable::memory_usage() const
+{
+  size_t m = hashmap_memory(_hosts) + hashmap_memory(_links)
+    + hashmap_memory(_host_index) + _host_ip.capacity() * sizeof(IPAddress)
+    + (_out.capacity() + _in.capacity()) * sizeof(Vector<Edge>);
+  for (int i = 0; i < _out.size(); i++)
+    m += _out[i].capacity() * sizeof(Edge);
+  for (int i = 0; i < _in.size(); i++)
+    m += _in[i].capacity() * sizeof(Edge);
+  for (int i = 0; i < 2; i++)
+    m += _tree[i]._metric.capacity() * sizeof(uint32_t)
+      + _tree[i]._prev.capacity() * sizeof(int);
+  return m;
+}
+
 LinkTable::Link
 LinkTable::random_link()
 {
@@ -210,11 +251,12 @@ LinkTable::get_host_metric_to_me(IPAddress s)
   if (!s) {
     return 0;
   }
-  HostInfo *nfo = _hosts.findp(s);
-  if (!nfo) {
+  dijkstra(false);
+  int *h = _host_index.findp(s);
+  if (!h || _tree[false]._prev[*h] < 0) {
     return 0;
   }
-  return nfo->_metric_to_me;
+  return _tree[false]._metric[*h];
 }
 
 uint32_t
@@ -223,11 +265,12 @@ LinkTable::get_host_metric_from_me(IPAddress s)
   if (!s) {
     return 0;
   }
-  HostInfo *nfo = _hosts.findp(s);
-  if (!nfo) {
+  dijkstra(true);
+  int *h = _host_index.findp(s);
+  if (!h || _tree[true]._prev[*h] < 0) {
     return 0;
   }
-  return nfo->_metric_from_me;
+  return _tree[true]._metric[*h];
 }
 
 uint32_t
@@ -340,41 +383,39 @@ LinkTable::valid_route(const Vector<IPAddress> &route)
 Vector<IPAddress>
 LinkTable::best_route(IPAddress dst, bool from_me)
 {
-  Vector<IPAddress> reverse_route;
+  Route route;
+  best_route(dst, from_me, route);
+  return route.vector();
+}
+
+void
+LinkTable::best_route(IPAddress dst, bool from_me, Route &route)
+{
+  route.clear();
   if (!dst) {
-    return reverse_route;
+    return;
+  }
+  dijkstra(from_me);
+  int *h = _host_index.findp(dst);
+  if (!h) {
+    return;
   }
-  HostInfo *nfo = _hosts.findp(dst);
 
-  if (from_me) {
-    while (nfo && nfo->_metric_from_me != 0) {
-      reverse_route.push_back(nfo->_ip);
-      nfo = _hosts.findp(nfo->_prev_from_me);
-    }
-    if (nfo && nfo->_metric_from_me == 0) {
-    reverse_route.push_back(nfo->_ip);
-    }
-  } else {
-    while (nfo && nfo->_metric_to_me != 0) {
-      reverse_route.push_back(nfo->_ip);
-      nfo = _hosts.findp(nfo->_prev_to_me);
-    }
-    if (nfo && nfo->_metric_to_me == 0) {
-      reverse_route.push_back(nfo->_ip);
+  const Tree &t = _tree[from_me];
+  int x = *h;
+  route.push_back(dst);
+  if (t._prev[x] >= 0) {
+    for (; t._prev[x] != x; x = t._prev[x]) {
+      route.push_back(_host_ip[t._prev[x]]);
     }
   }
 
-
   if (from_me) {
-	  Vector<IPAddress> route;
-	  /* why isn't there just push? */
-	  for (int i=reverse_route.size() - 1; i >= 0; i--) {
-		  route.push_back(reverse_route[i]);
-	  }
-	  return route;
+    /* the walk produced the route backwards */
+    for (int i = 0, j = route.size() - 1; i < j; i++, j--) {
+      click_swap(route[i], route[j]);
+    }
   }
-
-  return reverse_route;
 }
 
 String
@@ -398,6 +439,49 @@ static int ipaddr_sorter(const void *va, const void *vb, void *) {
     return (ntohl(a->addr()) < ntohl(b->addr())) ? -1 : 1;
 }
 
+Vector< Vector<IPAddress> >
+LinkTable::top_n_routes(IPAddress dst, int n)
+{
+  Vector< Vector<IPAddress> > routes;
+  if (!dst || dst == _ip) {
+    return routes;
+  }
+  dijkstra(true);
+  int *h = _host_index.findp(dst);
+  if (!h) {
+    return routes;
+  }
+
+  /* the best route through each last hop, cheapest first */
+  const Tree &t = _tree[true];
+  const Vector<Edge> &last = _in[*h];
+  Vector<Reach> heap;
+  for (int i = 0; i < last.size(); i++) {
+    int hop = last[i]._host;
+    if (t._prev[hop] >= 0) {
+      heap.push_back(Reach(t._metric[hop] + last[i]._metric, hop));
+      push_heap(heap.begin(), heap.end(), less<Reach>());
+    }
+  }
+
+  Route route;
+  while (heap.size() && routes.size() < n) {
+    int hop = heap[0]._host;
+    pop_heap(heap.begin(), heap.end(), less<Reach>());
+    heap.pop_back();
+    best_route(_host_ip[hop], true, route);
+    bool loop = false;
+    for (int i = 0; i < route.size(); i++) {
+      loop = loop || route[i] == dst;
+    }
+    if (!loop) {
+      route.push_back(dst);
+      routes.push_back(route.vector());
+    }
+  }
+  return routes;
+}
+
 
 String
 LinkTable::print_routes(bool from_me, bool pretty)
@@ -476,6 +560,9 @@ LinkTable::clear_stale() {
       }
     }
   }
+  if (links.size() != _links.size()) {
+    _graph_valid = false;
+  }
   _links.clear();
 
   for (LTIter iter = links.begin(); iter.live(); iter++) {
@@ -511,116 +598,205 @@ LinkTable::get_neighbors(IPAddress ip)
 
   return neighbors;
 }
+int
+LinkTable::graph_host(IPAddress ip)
+{
+  int *h = _host_index.findp(ip);
+  if (h) {
+    return *h;
+  }
+  int n = _host_ip.size();
+  _host_index.insert(ip, n);
+  _host_ip.push_back(ip);
+  _out.push_back(Vector<Edge>());
+  _in.push_back(Vector<Edge>());
+  for (int d = 0; d < 2; d++) {
+    if (_tree[d]._valid) {
+      _tree[d]._metric.push_back(0);
+      _tree[d]._prev.push_back(-1);
+    }
+  }
+  return n;
+}
+
 void
-LinkTable::dijkstra(bool from_me)
+LinkTable::set_edge(int from, int to, uint32_t metric)
 {
-  Timestamp start = Timestamp::now();
-  IPAddress src = _ip;
+  Vector<Edge> &out = _out[from];
+  Vector<Edge> &in = _in[to];
+  int i;
+  for (i = 0; i < out.size() && out[i]._host != to; i++)
+    /* nada */;
+  if (i == out.size()) {
+    out.push_back(Edge(to, metric));
+    in.push_back(Edge(from, metric));
+    return;
+  }
+  out[i]._metric = metric;
+  for (i = 0; in[i]._host != from; i++)
+    /* nada */;
+  in[i]._metric = metric;
+}
 
-  typedef HashMap<IPAddress, bool> IPMap;
-  IPMap ip_addrs;
+void
+LinkTable::build_graph()
+{
+  _host_index.clear();
+  _host_ip.clear();
+  _out.clear();
+  _in.clear();
+  _tree[false]._valid = _tree[true]._valid = false;
 
+  graph_host(_ip);
   for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    ip_addrs.insert(iter.value()._ip, true);
+    graph_host(iter.key());
   }
-
-  for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-    /* clear them all initially */
-    HostInfo *n = _hosts.findp(i.key());
-    n->clear(from_me);
+  for (LTIter iter = _links.begin(); iter.live(); iter++) {
+    const LinkInfo &nfo = iter.value();
+    if (nfo._metric) {
+      set_edge(graph_host(nfo._from), graph_host(nfo._to), nfo._metric);
+    }
   }
-  HostInfo *root_info = _hosts.findp(src);
-
+  _graph_valid = true;
+}
 
-  assert(root_info);
+/* Dijkstra's algorithm from the hosts on heap, whose metrics in t are set.
+ * Stale heap entries are skipped rather than removed. */
+void
+LinkTable::spread(Tree &t, bool from_me, Vector<Reach> &heap)
+{
+  const Vector<Vector<Edge> > &next = from_me ? _out : _in;
+  while (heap.size()) {
+    Reach r = heap[0];
+    pop_heap(heap.begin(), heap.end(), less<Reach>());
+    heap.pop_back();
+    if (r._metric != t._metric[r._host]) {
+      continue;
+    }
 
-  if (from_me) {
-    root_info->_prev_from_me = root_info->_ip;
-    root_info->_metric_from_me = 0;
-  } else {
-    root_info->_prev_to_me = root_info->_ip;
-    root_info->_metric_to_me = 0;
+    const Vector<Edge> &edges = next[r._host];
+    for (int i = 0; i < edges.size(); i++) {
+      int h = edges[i]._host;
+      uint32_t metric = r._metric + edges[i]._metric;
+      if (t._prev[h] < 0 || metric < t._metric[h]) {
+	t._metric[h] = metric;
+	t._prev[h] = r._host;
+	heap.push_back(Reach(metric, h));
+	push_heap(heap.begin(), heap.end(), less<Reach>());
+      }
+    }
   }
+}
 
-  IPAddress current_min_ip = root_info->_ip;
-
-  while (current_min_ip) {
-    HostInfo *current_min = _hosts.findp(current_min_ip);
-    assert(current_min);
-    if (from_me) {
-      current_min->_marked_from_me = true;
-    } else {
-      current_min->_marked_to_me = true;
+void
+LinkTable::repair(bool from_me, int from, int to,
+		  uint32_t old_metric, uint32_t new_metric)
+{
+  Tree &t = _tree[from_me];
+  /* the link's end nearer the root in this tree, and the other end */
+  int parent = from_me ? from : to;
+  int child = from_me ? to : from;
+  if (!t._valid || parent == child) {
+    return;
+  }
+  Vector<Reach> heap;
+
+  if (!old_metric || new_metric < old_metric) {
+    /* a cheaper link can only shorten routes through it */
+    if (t._prev[parent] < 0) {
+      return;
+    }
+    uint32_t metric = t._metric[parent] + new_metric;
+    if (t._prev[child] >= 0 && metric >= t._metric[child]) {
+      return;
+    }
+    t._metric[child] = metric;
+    t._prev[child] = parent;
+    heap.push_back(Reach(metric, child));
+  } else {
+    /* a dearer link only affects the subtree hanging from it, if it is
+     * in the tree at all */
+    if (t._prev[child] != parent) {
+      return;
     }
 
-
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *neighbor = _hosts.findp(i.key());
-      assert(neighbor);
-      bool marked = neighbor->_marked_to_me;
-      if (from_me) {
-	marked = neighbor->_marked_from_me;
+    /* find the subtree: below[h] is 1 inside it, 2 outside */
+    int n = _host_ip.size();
+    Vector<int> below(n, 0);
+    Vector<int> path;
+    below[child] = 1;
+    for (int h = 0; h < n; h++) {
+      int x = h;
+      while (!below[x] && t._prev[x] >= 0 && t._prev[x] != x) {
+	path.push_back(x);
+	x = t._prev[x];
       }
-
-      if (marked) {
-	continue;
+      if (!below[x]) {
+	below[x] = 2;
       }
+      while (path.size()) {
+	below[path.back()] = below[x];
+	path.pop_back();
+      }
+    }
 
-      IPPair pair = IPPair(neighbor->_ip, current_min_ip);
-      if (from_me) {
-	pair = IPPair(current_min_ip, neighbor->_ip);
+    /* detach it, then reattach each host by its best link from outside */
+    for (int h = 0; h < n; h++) {
+      if (below[h] == 1) {
+	t._prev[h] = -1;
+	t._metric[h] = 0;
       }
-      LinkInfo *lnfo = _links.findp(pair);
-      if (!lnfo || !lnfo->_metric) {
+    }
+    const Vector<Vector<Edge> > &prev = from_me ? _in : _out;
+    for (int h = 0; h < n; h++) {
+      if (below[h] != 1) {
 	continue;
       }
-      uint32_t neighbor_metric = neighbor->_metric_to_me;
-      uint32_t current_metric = current_min->_metric_to_me;
-
-      if (from_me) {
-	neighbor_metric = neighbor->_metric_from_me;
-	current_metric = current_min->_metric_from_me;
-      }
-
-
-      uint32_t adjusted_metric = current_metric + lnfo->_metric;
-      if (!neighbor_metric ||
-	  adjusted_metric < neighbor_metric) {
-	if (from_me) {
-	  neighbor->_metric_from_me = adjusted_metric;
-	  neighbor->_prev_from_me = current_min_ip;
-	} else {
-	  neighbor->_metric_to_me = adjusted_metric;
-	  neighbor->_prev_to_me = current_min_ip;
+      const Vector<Edge> &edges = prev[h];
+      for (int i = 0; i < edges.size(); i++) {
+	int p = edges[i]._host;
+	if (below[p] == 1 || t._prev[p] < 0) {
+	  continue;
+	}
+	uint32_t metric = t._metric[p] + edges[i]._metric;
+	if (t._prev[h] < 0 || metric < t._metric[h]) {
+	  t._metric[h] = metric;
+	  t._prev[h] = p;
 	}
-
-      }
-    }
-
-    current_min_ip = IPAddress();
-    uint32_t  min_metric = ~0;
-    for (IPMap::const_iterator i = ip_addrs.begin(); i.live(); i++) {
-      HostInfo *nfo = _hosts.findp(i.key());
-      uint32_t metric = nfo->_metric_to_me;
-      bool marked = nfo->_marked_to_me;
-      if (from_me) {
-	metric = nfo->_metric_from_me;
-	marked = nfo->_marked_from_me;
       }
-      if (!marked && metric &&
-	  metric < min_metric) {
-        current_min_ip = nfo->_ip;
-        min_metric = metric;
+      if (t._prev[h] >= 0) {
+	heap.push_back(Reach(t._metric[h], h));
+	push_heap(heap.begin(), heap.end(), less<Reach>());
       }
     }
+  }
 
+  spread(t, from_me, heap);
+}
 
+void
+LinkTable::dijkstra(bool from_me)
+{
+  if (!_graph_valid) {
+    build_graph();
+  }
+  Tree &t = _tree[from_me];
+  if (t._valid) {
+    return;
   }
 
+  Timestamp start = Timestamp::now();
+  int root = graph_host(_ip);
+  t._metric.assign(_host_ip.size(), 0);
+  t._prev.assign(_host_ip.size(), -1);
+  t._prev[root] = root;
+
+  Vector<Reach> heap;
+  heap.push_back(Reach(0, root));
+  spread(t, from_me, heap);
+  t._valid = true;
+
   dijkstra_time = Timestamp::now() - start;
-  //StringAccum sa;
-  //sa << "dijstra took " << finish - start;
-  //click_chatter("%s: %s\n", name().c_str(), sa.take_string().c_str());
 }
 
 
@@ -718,6 +894,7 @@ LinkTable::add_handlers() {
 
 
   add_write_handler("update_link", static_update_link, 0);
+  add_memory_limit_handler();
 
 
 }
@@ -6,6 +6,7 @@
 #include <click/element.hh>
 #include <click/bighashmap.hh>
 #include <click/hashmap.hh>
+#include <click/smallvector.hh>
 #include "path.hh"
 CLICK_DECLS
 
@@ -16,7 +17,14 @@ CLICK_DECLS
  * Keeps a Link state database and calculates Weighted Shortest Path
  * for other elements
  * =d
- * Runs dijkstra's algorithm occasionally.
+ * Runs dijkstra's algorithm occasionally.  The shortest-path trees are
+ * cached between runs and repaired incrementally as link metrics change,
+ * so best_route() is cheap.
+ * =h memory_limit read/write
+ * A soft limit, in bytes, on the memory handler's value, which counts the
+ * host and link tables and the cached graph.  0, the default, means no
+ * limit.  Over the limit, update_link refuses links to or from unknown
+ * hosts and new links; known links are still updated.
  * =a ARPTable
  *
  */
@@ -66,6 +74,7 @@ public:
   int configure(Vector<String> &conf, ErrorHandler *errh);
   void take_state(Element *, ErrorHandler *);
   void *cast(const char *n);
+  size_t memory_usage() const;
   /* read/write handlers */
   String print_routes(bool, bool);
   String print_links();
@@ -97,6 +106,10 @@ public:
   void clear_stale();
   Vector<IPAddress> best_route(IPAddress dst, bool from_me);
 
+  /* a route as built on the packet path; holds typical routes inline */
+  typedef SmallVector<IPAddress, 16> Route;
+  void best_route(IPAddress dst, bool from_me, Route &route);
+
   Vector< Vector<IPAddress> > top_n_routes(IPAddress dst, int n);
   uint32_t get_host_metric_to_me(IPAddress s);
   uint32_t get_host_metric_from_me(IPAddress s);
@@ -179,47 +192,45 @@ protected:
   class HostInfo {
   public:
     IPAddress _ip;
-    uint32_t _metric_from_me;
-    uint32_t _metric_to_me;
-
-    IPAddress _prev_from_me;
-    IPAddress _prev_to_me;
-
-    bool _marked_from_me;
-    bool _marked_to_me;
 
     HostInfo(IPAddress p = IPAddress()) {
       _ip = p;
-      _metric_from_me = 0;
-      _metric_to_me = 0;
-      _prev_from_me = IPAddress();
-      _prev_to_me = IPAddress();
-      _marked_from_me = false;
-      _marked_to_me = false;
     }
 
     HostInfo(const HostInfo &p) :
-      _ip(p._ip),
-      _metric_from_me(p._metric_from_me),
-      _metric_to_me(p._metric_to_me),
-      _prev_from_me(p._prev_from_me),
-      _prev_to_me(p._prev_to_me),
-      _marked_from_me(p._marked_from_me),
-      _marked_to_me(p._marked_to_me)
+      _ip(p._ip)
     { }
 
-    void clear(bool from_me) {
-      if (from_me ) {
-	_prev_from_me = IPAddress();
-	_metric_from_me = 0;
-	_marked_from_me = false;
-      } else {
-	_prev_to_me = IPAddress();
-	_metric_to_me = 0;
-	_marked_to_me = false;
-      }
+  };
+
+  /* The link graph as adjacency lists over host numbers (_host_index), and
+   * the two shortest-path trees rooted at _ip: _tree[true] holds routes
+   * from me, following links forward; _tree[false] holds routes to me,
+   * following them backward, so each host's _prev is its next hop.  A
+   * tree's _prev is -1 for unreachable hosts and the root itself for the
+   * root.  update_link() repairs valid trees in place. */
+  class Edge {
+  public:
+    int _host;
+    uint32_t _metric;
+    Edge(int host = -1, uint32_t metric = 0)
+      : _host(host), _metric(metric) {
     }
+  };
 
+  class Tree {
+  public:
+    Vector<uint32_t> _metric;
+    Vector<int> _prev;
+    bool _valid;
+    Tree() : _valid(false) { }
+  };
+
+  struct Reach {
+    uint32_t _metric;
+    int _host;
+    Reach(uint32_t metric, int host) : _metric(metric), _host(host) { }
+    bool operator<(const Reach &x) const { return _metric < x._metric; }
   };
 
   typedef HashMap<IPAddress, HostInfo> HTable;
@@ -232,6 +243,20 @@ protected:
   HTable _hosts;
   LTable _links;
 
+  HashMap<IPAddress, int> _host_index;
+  Vector<IPAddress> _host_ip;
+  Vector<Vector<Edge> > _out;
+  Vector<Vector<Edge> > _in;
+  bool _graph_valid;
+  Tree _tree[2];
+
+  void build_graph();
+  int graph_host(IPAddress ip);
+  void set_edge(int from, int to, uint32_t metric);
+  void spread(Tree &t, bool from_me, Vector<Reach> &heap);
+  void repair(bool from_me, int from, int to,
+	      uint32_t old_metric, uint32_t new_metric);
+
 
   IPAddress _ip;
   Timestamp _stale_timeout;
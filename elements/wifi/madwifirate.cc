@@ -24,6 +24,7 @@
 #include <clicknet/ether.h>
 #include <clicknet/wifi.h>
 #include <elements/wifi/availablerates.hh>
+#include <elements/wifi/bitrate.hh>
 #include "madwifirate.hh"
 CLICK_DECLS
 
@@ -82,14 +83,8 @@ MadwifiRate::configure(Vector<String> &conf, ErrorHandler *errh)
 void
 MadwifiRate::adjust_all()
 {
-  Vector<EtherAddress> n;
   for (NIter iter = _neighbors.begin(); iter.live(); iter++) {
-    DstInfo nfo = iter.value();
-    n.push_back(nfo._eth);
-  }
-
-  for (int x =0; x < n.size(); x++) {
-    adjust(n[x]);
+    adjust(iter.key());
   }
 
 }
@@ -97,7 +92,7 @@ MadwifiRate::adjust_all()
 void
 MadwifiRate::adjust(EtherAddress dst)
 {
-  DstInfo *nfo = _neighbors.findp(dst);
+  DstInfo *nfo = _neighbors.get_pointer(dst);
     bool stepup = false;
   bool stepdown = false;
   if (nfo->_failures > 0 && nfo->_successes == 0) {
@@ -120,8 +115,8 @@ MadwifiRate::adjust(EtherAddress dst)
       click_chatter("%{element} stepping down for %s from %d to %d\n",
 		    this,
 		    nfo->_eth.unparse().c_str(),
-		    nfo->_rates[nfo->_current_index],
-		    nfo->_rates[WIFI_MAX(0, nfo->_current_index - 1)]);
+		    nfo->_stats.rate(nfo->_current_index),
+		    nfo->_stats.rate(WIFI_MAX(0, nfo->_current_index - 1)));
     }
     nfo->_current_index = WIFI_MAX(nfo->_current_index - 1, 0);
     nfo->_credits = 0;
@@ -132,11 +127,11 @@ MadwifiRate::adjust(EtherAddress dst)
 	click_chatter("%{element} steping up for %s from %d to %d\n",
 		      this,
 		      nfo->_eth.unparse().c_str(),
-		      nfo->_rates[nfo->_current_index],
-		      nfo->_rates[WIFI_MIN(nfo->_rates.size() - 1,
-					   nfo->_current_index + 1)]);
+		      nfo->_stats.rate(nfo->_current_index),
+		      nfo->_stats.rate(WIFI_MIN(nfo->_stats.size() - 1,
+					   nfo->_current_index + 1)));
       }
-      nfo->_current_index = WIFI_MIN(nfo->_current_index + 1, nfo->_rates.size() - 1);
+      nfo->_current_index = WIFI_MIN(nfo->_current_index + 1, nfo->_stats.size() - 1);
       nfo->_credits = 0;
     }
   } else {
@@ -174,11 +169,15 @@ MadwifiRate::process_feedback(Packet *p_in)
     return;
   }
 
-  DstInfo *nfo = _neighbors.findp(dst);
+  DstInfo *nfo = _neighbors.get_pointer(dst);
   if (!nfo || nfo->pick_rate() != ceh->rate) {
     return;
   }
 
+  nfo->_stats.update(ceh->rate, Timestamp::recent(), success && !used_alt_rate,
+		     calc_usecs_wifi_packet(1500, ceh->rate, ceh->retries),
+		     ceh->retries + 1);
+
   if (!success && _debug) {
     click_chatter("%{element} packet failed %s success %d rate %d alt %d\n",
 		  this,
@@ -217,7 +216,7 @@ MadwifiRate::assign_rate(Packet *p_in)
 
 
   if (dst.is_group()) {
-    Vector<int> rates = _rtable->lookup(_bcast);
+    const Vector<int> &rates = _rtable->lookup(_bcast);
     if (rates.size()) {
       ceh->rate = rates[0];
     } else {
@@ -225,21 +224,21 @@ MadwifiRate::assign_rate(Packet *p_in)
     }
     return;
   }
-  DstInfo *nfo = _neighbors.findp(dst);
-  if (!nfo || !nfo->_rates.size()) {
-    Vector<int> rates = _rtable->lookup(dst);
+  DstInfo *nfo = _neighbors.get_pointer(dst);
+  if (!nfo || !nfo->_stats.size()) {
+    const Vector<int> &rates = _rtable->lookup(dst);
     if (!rates.size()) {
       return;
     }
-    _neighbors.insert(dst, DstInfo(dst));
-    nfo = _neighbors.findp(dst);
-    nfo->_rates = rates;
+    _neighbors.set(dst, DstInfo(dst));
+    nfo = _neighbors.get_pointer(dst);
+    nfo->_stats.assign(rates);
     nfo->_successes = 0;
     nfo->_retries = 0;
     nfo->_failures = 0;
     /* initial to 24 in g/a, 11 in b */
-    int ndx = nfo->rate_index(48);
-    ndx = ndx > 0 ? ndx : nfo->rate_index(22);
+    int ndx = nfo->_stats.index(48);
+    ndx = ndx > 0 ? ndx : nfo->_stats.index(22);
     ndx = WIFI_MAX(ndx, 0);
     nfo->_current_index = ndx;
     nfo->_credits = 0;
@@ -247,16 +246,16 @@ MadwifiRate::assign_rate(Packet *p_in)
       click_chatter("%{element} initial rate for %s is %d\n",
 		    this,
 		    nfo->_eth.unparse().c_str(),
-		    nfo->_rates[nfo->_current_index]);
+		    nfo->_stats.rate(nfo->_current_index));
     }
   }
 
   ceh->magic = WIFI_EXTRA_MAGIC;
   int ndx = nfo->_current_index;
-  ceh->rate = nfo->_rates[ndx];
-  ceh->rate1 = (ndx - 1 >= 0) ? nfo->_rates[WIFI_MAX(ndx - 1, 0)] : 0;
-  ceh->rate2 = (ndx - 2 >= 0) ? nfo->_rates[WIFI_MAX(ndx - 2, 0)] : 0;
-  ceh->rate3 = (ndx - 3 >= 0) ? nfo->_rates[WIFI_MAX(ndx - 3, 0)] : 0;
+  ceh->rate = nfo->_stats.rate(ndx);
+  ceh->rate1 = (ndx - 1 >= 0) ? nfo->_stats.rate(WIFI_MAX(ndx - 1, 0)) : 0;
+  ceh->rate2 = (ndx - 2 >= 0) ? nfo->_stats.rate(WIFI_MAX(ndx - 2, 0)) : 0;
+  ceh->rate3 = (ndx - 3 >= 0) ? nfo->_stats.rate(WIFI_MAX(ndx - 3, 0)) : 0;
 
   ceh->max_tries = 4;
   ceh->max_tries1 = (ndx - 1 >= 0) ? 2 : 0;
@@ -301,10 +300,10 @@ MadwifiRate::print_rates()
 {
     StringAccum sa;
   for (NIter iter = _neighbors.begin(); iter.live(); iter++) {
-    DstInfo nfo = iter.value();
+    const DstInfo &nfo = iter.value();
     sa << nfo._eth << " ";
-    if (nfo._rates.size()) {
-      sa << nfo._rates[nfo._current_index];
+    if (nfo._stats.size()) {
+      sa << nfo._stats.rate(nfo._current_index);
       sa << " successes " << nfo._successes;
       sa << " failures " << nfo._failures;
       sa << " retries " << nfo._retries;
@@ -317,9 +316,22 @@ MadwifiRate::print_rates()
 }
 
 
+String
+MadwifiRate::print_stats()
+{
+  StringAccum sa;
+  for (NIter iter = _neighbors.begin(); iter.live(); iter++) {
+    const DstInfo &nfo = iter.value();
+    sa << nfo._eth << "\n";
+    nfo._stats.unparse(sa);
+  }
+  return sa.take_string();
+}
+
+
 enum {H_DEBUG, H_STEPUP, H_STEPDOWN, H_THRESHOLD, H_RATES, H_RESET,
       H_OFFSET, H_ACTIVE, H_PERIOD,
-      H_ALT_RATE};
+      H_ALT_RATE, H_STATS};
 
 
 static String
@@ -342,6 +354,8 @@ MadwifiRate_read_param(Element *e, void *thunk)
   case H_RATES: {
     return td->print_rates();
   }
+  case H_STATS:
+    return td->print_stats();
   case H_ACTIVE:
     return String(td->_active) + "\n";
   case H_PERIOD:
@@ -427,6 +441,7 @@ MadwifiRate::add_handlers()
 {
   add_read_handler("debug", MadwifiRate_read_param, H_DEBUG);
   add_read_handler("rates", MadwifiRate_read_param, H_RATES);
+  add_read_handler("stats", MadwifiRate_read_param, H_STATS);
   add_read_handler("threshold", MadwifiRate_read_param, H_THRESHOLD);
   add_read_handler("stepup", MadwifiRate_read_param, H_STEPUP);
   add_read_handler("stepdown", MadwifiRate_read_param, H_STEPDOWN);
@@ -446,5 +461,6 @@ MadwifiRate::add_handlers()
 }
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(bitrate)
 EXPORT_ELEMENT(MadwifiRate)
 
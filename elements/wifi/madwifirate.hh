@@ -2,8 +2,9 @@
 #define CLICK_MADWIFIRATE_HH
 #include <click/element.hh>
 #include <click/etheraddress.hh>
-#include <click/bighashmap.hh>
+#include <click/hashtable.hh>
 #include <click/glue.hh>
+#include <elements/wifi/ratestats.hh>
 #include <click/timer.hh>
 #include <elements/wifi/availablerates.hh>
 CLICK_DECLS
@@ -21,6 +22,10 @@ Madwifi wireless bit-rate selection algorithm
 Rate Control present in the Madwifi driver
 (http://sourceforge.net/project/madwifi).
 
+=h stats read-only
+Per-rate delivery ratio and airtime averages, and counts, for each
+neighbor.
+
 =a
 SetTXRate, FilterTX, AutoRateFallback
 */
@@ -51,6 +56,7 @@ class MadwifiRate : public Element { public:
   void add_handlers();
   static String static_print_stats(Element *e, void *);
   String print_rates();
+  String print_stats();
 
 
   EtherAddress _bcast;
@@ -70,7 +76,7 @@ class MadwifiRate : public Element { public:
   public:
 
     EtherAddress _eth;
-    Vector<int> _rates;
+    RateStats _stats;
 
     int _credits;
 
@@ -87,40 +93,29 @@ class MadwifiRate : public Element { public:
       _eth = eth;
     }
 
-    int rate_index(int rate) {
-      int ndx = 0;
-      for (int x = 0; x < _rates.size(); x++) {
-	if (rate == _rates[x]) {
-	  ndx = x;
-	  break;
-	}
-      }
-      return (ndx == _rates.size()) ? -1 : ndx;
-    }
-
     int pick_rate() {
-      if (_rates.size() == 0) {
+      if (_stats.size() == 0) {
 	click_chatter("no rates to pick from for %s\n",
 		      _eth.unparse().c_str());
 	return 2;
       }
-      if (_current_index > 0 && _current_index < _rates.size()) {
-	return _rates[_current_index];
+      if (_current_index > 0 && _current_index < _stats.size()) {
+	return _stats.rate(_current_index);
       }
-      return _rates[0];
+      return _stats.rate(0);
     }
 
     int pick_alt_rate() {
-      if (_rates.size() == 0) {
+      if (_stats.size() == 0) {
 	click_chatter("no rates to pick from for %s\n",
 		      _eth.unparse().c_str());
 	return 2;
       }
-      return _rates[0];
+      return _stats.rate(0);
     }
   };
 
-  typedef HashMap<EtherAddress, DstInfo> NeighborTable;
+  typedef HashTable<EtherAddress, DstInfo> NeighborTable;
   typedef NeighborTable::const_iterator NIter;
 
   NeighborTable _neighbors;
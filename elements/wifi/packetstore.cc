@@ -50,6 +50,7 @@ PacketStore::simple_action(Packet *p_in)
 	store s;
 	s.timestamp = p_in->timestamp_anno();
 	s.len = WIFI_MIN(p_in->length(), 80);
+	s.wire_len = p_in->length();
 	memcpy(s.data, p_in->data(), s.len);
 	_packets.push_back(s);
 	return p_in;
@@ -60,7 +61,53 @@ PacketStore::run_task(Task *)
 {
 	return false;
 }
-enum {H_RESET, H_LEN, H_POP, H_DIRTY};
+enum {H_RESET, H_LEN, H_POP, H_DIRTY, H_LOG, H_DUMP};
+
+static void
+unparse_store(StringAccum &sa, const PacketStore::store &s)
+{
+	static const char hex[] = "0123456789abcdef";
+	sa << s.timestamp << " | ";
+	if (char *buf = sa.extend(s.len * 2))
+		for (int x = 0; x < s.len; x++) {
+			buf[2*x] = hex[(s.data[x] >> 4) & 0xf];
+			buf[2*x + 1] = hex[s.data[x] & 0xf];
+		}
+	sa << "\n";
+}
+
+static void
+write_store(StringAccum &sa, const PacketStore::store &s)
+{
+	// libpcap record header
+	uint32_t hdr[4];
+	hdr[0] = s.timestamp.sec();
+	hdr[1] = s.timestamp.usec();
+	hdr[2] = s.len;
+	hdr[3] = s.wire_len;
+	sa.append((const char *) hdr, sizeof(hdr));
+	sa.append(s.data, s.len);
+}
+
+static int
+log_handler(int, String &str, Element *e, const Handler *h, ErrorHandler *errh)
+{
+	PacketStore *td = (PacketStore *)e;
+	int n = PacketStore::DEFAULT_CHUNK;
+	if (str && (!IntArg().parse(cp_uncomment(str), n) || n < 0))
+		return errh->error("count must be a nonnegative integer");
+
+	StringAccum sa;
+	for (; n > 0 && td->_packets.size(); n--) {
+		if ((uintptr_t) h->read_user_data() == H_DUMP)
+			write_store(sa, td->_packets.front());
+		else
+			unparse_store(sa, td->_packets.front());
+		td->_packets.pop_front();
+	}
+	str = sa.take_string();
+	return 0;
+}
 
 static String
 read_param(Element *e, void *thunk)
@@ -73,17 +120,8 @@ read_param(Element *e, void *thunk)
 		if( !td->_packets.size()) {
 			return String();
 		}
-		PacketStore::store s = td->_packets[0];
-		StringAccum sap(s.len*2 + 20);
-
-		sap << s.timestamp << " | ";
-
-		char *buf = sap.data() + sap.length();
-		for (int x = 0; x < s.len; x++) {
-			sprintf(buf + 2*x, "%02x", s.data[x] & 0xff);
-		}
-		sap.adjust_length(s.len *2);
-		sap << "\n";
+		StringAccum sap;
+		unparse_store(sap, td->_packets.front());
 		td->_packets.pop_front();
 		return sap.take_string();
 	}
@@ -120,6 +158,8 @@ PacketStore::add_handlers()
 	add_read_handler("length", read_param, H_LEN);
 	add_read_handler("pop", read_param, H_POP, Handler::RAW);
 	add_read_handler("dirty", read_param, H_DIRTY);
+	set_handler("log", Handler::OP_READ | Handler::READ_PARAM, log_handler, H_LOG);
+	set_handler("dump", Handler::OP_READ | Handler::READ_PARAM | Handler::RAW, log_handler, H_DUMP);
 	add_write_handler("reset", write_param, H_RESET);
 	add_task_handlers(&_task);
 }
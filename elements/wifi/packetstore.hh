@@ -19,12 +19,26 @@ CLICK_DECLS
  * PacketStore records the size, timestamp, and other infor for
  * each packet that passed through.  The list of
  * recorded data can be dumped (and cleared) by repeated calls to the
- * read handler 'log'.
+ * read handlers 'log' or 'dump'.
+ *
+ * Each read removes at most a bounded number of records, so reading a
+ * large log does not hold up packet processing for long.  Read
+ * repeatedly, until the result is empty, to drain the log.
  *
  * =h log read-only
- * Print as much of the list of logged packets as possible, clearing
- * printed packets from the log.
- * =h more read-only
+ * Takes an optional count N, default 64.  Prints up to N logged packets,
+ * oldest first, one per line as "TIMESTAMP | HEXDATA", and clears them
+ * from the log.
+ * =h dump read-only
+ * Like 'log', but returns the records in binary, in the format of
+ * libpcap packet records: a 16-byte header of seconds, microseconds,
+ * captured length, and original length, as 32-bit integers in host byte
+ * order, followed by the captured bytes.  Prefixing the concatenated
+ * results with a libpcap file header gives a trace file.
+ * =h pop read-only
+ * Returns the oldest logged packet in the 'log' format, and clears it
+ * from the log.
+ * =h length read-only
  * Returns how many entries are left to be read.
  * =h reset write-only
  * Clears the log.
@@ -37,6 +51,7 @@ class PacketStore : public Element { public:
   ~PacketStore();
 
   const char *class_name() const		{ return "PacketStore"; }
+  const char *flags() const			{ return "T"; }
   const char *port_count() const		{ return PORTS_1_1; }
   const char* processing() const		{ return AGNOSTIC; }
   int initialize(ErrorHandler *);
@@ -55,9 +70,12 @@ class PacketStore : public Element { public:
 	  Timestamp timestamp;
 	  char data[80];
 	  int len;
+	  uint32_t wire_len;
   };
   Deque <store> _packets;
 
+  enum { DEFAULT_CHUNK = 64 };
+
   int _dirty;
   bool run_task(Task *);
 
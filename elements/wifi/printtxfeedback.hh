@@ -30,6 +30,7 @@ class PrintTXFeedback : public Element {
   ~PrintTXFeedback();
 
   const char *class_name() const		{ return "PrintTXFeedback"; }
+  const char *flags() const			{ return "T"; }
   const char *port_count() const		{ return PORTS_1_1; }
   const char *processing() const		{ return AGNOSTIC; }
 
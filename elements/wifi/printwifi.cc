@@ -24,6 +24,7 @@
 #include <click/packet_anno.hh>
 #include <clicknet/wifi.h>
 #include <click/etheraddress.hh>
+#include <click/smallvector.hh>
 #include "printwifi.hh"
 CLICK_DECLS
 
@@ -264,18 +265,19 @@ String get_ssid(u_int8_t *ptr) {
   return String((char *) ptr + 2, WIFI_MIN((int)ptr[1], WIFI_NWID_MAXSIZE));
 }
 
-Vector<int> get_rates(u_int8_t *ptr) {
-  Vector<int> rates;
+typedef SmallVector<int, WIFI_RATES_MAXSIZE> RateVector;
+
+void get_rates(u_int8_t *ptr, RateVector &rates) {
+  rates.clear();
   for (int x = 0; x < WIFI_MIN((int)ptr[1], WIFI_RATES_MAXSIZE); x++) {
     uint8_t rate = ptr[x + 2];
     rates.push_back(rate);
   }
-  return rates;
 }
 
-String rates_string(Vector<int> rates) {
-  Vector<int> basic_rates;
-  Vector<int> other_rates;
+String rates_string(const RateVector &rates) {
+  RateVector basic_rates;
+  RateVector other_rates;
   StringAccum sa;
   for (int x = 0; x < rates.size(); x++) {
     if (rates[x] & WIFI_RATE_BASIC) {
@@ -384,7 +386,8 @@ PrintWifi::simple_action(Packet *p)
       String ssid = get_ssid(ptr);
       ptr += ptr[1] + 2;
 
-      Vector<int> rates = get_rates(ptr);
+      RateVector rates;
+      get_rates(ptr, rates);
       String rates_s = rates_string(rates);
 
       sa << "assoc_req ";
@@ -418,7 +421,8 @@ PrintWifi::simple_action(Packet *p)
       String ssid = get_ssid(ptr);
       ptr += ptr[1] + 2;
 
-      Vector<int> rates = get_rates(ptr);
+      RateVector rates;
+      get_rates(ptr, rates);
       String rates_s = rates_string(rates);
       sa << "ssid " << ssid;
       sa << " " << rates_s << " ";
@@ -30,6 +30,7 @@ class PrintWifi : public Element {
   ~PrintWifi();
 
   const char *class_name() const		{ return "PrintWifi"; }
+  const char *flags() const			{ return _timestamp ? "T" : ""; }
   const char *port_count() const		{ return PORTS_1_1; }
   const char *processing() const		{ return AGNOSTIC; }
 
@@ -85,7 +85,7 @@ ProbeTXRate::assign_rate(Packet *p_in) {
   struct click_wifi_extra *ceh = WIFI_EXTRA_ANNO(p_in);
 
   if (dst.is_group() || !dst) {
-    Vector<int> rates = _rtable->lookup(_bcast);
+    const Vector<int> &rates = _rtable->lookup(_bcast);
     if (rates.size()) {
       ceh->rate = rates[0];
     } else {
@@ -94,36 +94,40 @@ ProbeTXRate::assign_rate(Packet *p_in) {
     return;
   }
 
-  DstInfo *nfo = _neighbors.findp(dst);
-  if (!nfo || !nfo->_rates.size()) {
-    _neighbors.insert(dst, DstInfo(dst, _rtable->lookup(dst)));
-    nfo = _neighbors.findp(dst);
+  DstInfo *nfo = _neighbors.get_pointer(dst);
+  if (!nfo || !nfo->_stats.size()) {
+    _neighbors.set(dst, DstInfo(dst, _rtable->lookup(dst)));
+    nfo = _neighbors.get_pointer(dst);
+    if (!nfo->_stats.size()) {
+      ceh->rate = 2;
+      return;
+    }
   }
 
-  nfo->trim(Timestamp::now() - _rate_window);
-  //nfo->check();
+  nfo->_stats.expire(Timestamp::now() - _rate_window);
 
 
   int best_ndx = nfo->best_rate_ndx();
   if (nfo->_count++ % 10) {
     // pick the best bit-rate
-    ceh->rate = nfo->_rates[best_ndx];
+    ceh->rate = nfo->_stats.rate(best_ndx);
     ceh->max_tries = 4;
   } else {
     //pick a random rate.
-    Vector<int> possible = nfo->pick_rate();
+    SmallVector<int, 16> possible;
+    nfo->pick_rate(possible);
     if (possible.size()) {
       ceh->rate = possible[click_random(0, possible.size() - 1)];
       ceh->max_tries = 2;
     } else {
       // no rates to sample from
-      ceh->rate = nfo->_rates[best_ndx];
+      ceh->rate = nfo->_stats.rate(best_ndx);
       ceh->max_tries = 4;
     }
   }
 
 
-  ceh->rate1 = nfo->_rates[best_ndx];
+  ceh->rate1 = nfo->_stats.rate(best_ndx);
   ceh->max_tries1 = 2;
 
   ceh->rate2 = 0;
@@ -184,7 +188,7 @@ ProbeTXRate::process_feedback(Packet *p_in) {
     return;
   }
 
-  DstInfo *nfo = _neighbors.findp(dst);
+  DstInfo *nfo = _neighbors.get_pointer(dst);
   if (!nfo) {
     if (_debug) {
           click_chatter("%{element} no info for %s\n",
@@ -212,10 +216,7 @@ ProbeTXRate::process_feedback(Packet *p_in) {
 	  click_chatter("%{element}::%s() rate %d tries %d (retries %d) time %d\n",
 			this, __func__, ceh->rate, tries, retries, time);
   }
-  nfo->add_result(now, ceh->rate, tries,
-		  success, time);
-  //nfo->check();
-  return ;
+  nfo->_stats.update(ceh->rate, now, success, time, tries);
 }
 
 Packet *
@@ -251,21 +252,22 @@ ProbeTXRate::print_rates()
 {
   StringAccum sa;
   for (NIter iter = _neighbors.begin(); iter.live(); iter++) {
-    DstInfo nfo = iter.value();
+    const DstInfo &nfo = iter.value();
     sa << nfo._eth << "\n";
-    for (int x = 0; x < nfo._rates.size(); x++) {
-	sa << " " << nfo._rates[x];
-	sa << " success " << nfo._total_success[x];
-	sa << " fail " << nfo._total_fail[x];
-	sa << " tries " << nfo._total_tries[x];
+    for (int x = 0; x < nfo._stats.size(); x++) {
+	const RateStats::Rate &r = nfo._stats[x];
+	sa << " " << nfo._stats.rate(x);
+	sa << " success " << r._successes;
+	sa << " fail " << r._failures;
+	sa << " tries " << r._tries;
 	sa << " perfect_usecs " << nfo._perfect_time[x];
-	sa << " total_usecs " << nfo._total_time[x];
+	sa << " delivery " << r._delivery.unparse();
 	sa << " average_usecs " << nfo.average(x);
 
 	sa << " average_tries ";
 
-	if (nfo._packets[x]) {
-	  Timestamp average_tries = Timestamp::make_msec(nfo._total_tries[x] * 1000 / nfo._packets[x]);
+	if (r._packets) {
+	  Timestamp average_tries = Timestamp::make_msec(r._tries * 1000 / r._packets);
 	  sa << average_tries;
 	} else {
 	  sa << "0";
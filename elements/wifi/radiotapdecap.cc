@@ -27,77 +27,77 @@
 #include <clicknet/llc.h>
 CLICK_DECLS
 
-#define NUM_RADIOTAP_ELEMENTS 18
-
-static const int radiotap_elem_to_bytes[NUM_RADIOTAP_ELEMENTS] =
-	{8, /* IEEE80211_RADIOTAP_TSFT */
-	 1, /* IEEE80211_RADIOTAP_FLAGS */
-	 1, /* IEEE80211_RADIOTAP_RATE */
-	 4, /* IEEE80211_RADIOTAP_CHANNEL */
-	 2, /* IEEE80211_RADIOTAP_FHSS */
-	 1, /* IEEE80211_RADIOTAP_DBM_ANTSIGNAL */
-	 1, /* IEEE80211_RADIOTAP_DBM_ANTNOISE */
-	 2, /* IEEE80211_RADIOTAP_LOCK_QUALITY */
-	 2, /* IEEE80211_RADIOTAP_TX_ATTENUATION */
-	 2, /* IEEE80211_RADIOTAP_DB_TX_ATTENUATION */
-	 1, /* IEEE80211_RADIOTAP_DBM_TX_POWER */
-	 1, /* IEEE80211_RADIOTAP_ANTENNA */
-	 1, /* IEEE80211_RADIOTAP_DB_ANTSIGNAL */
-	 1, /* IEEE80211_RADIOTAP_DB_ANTNOISE */
-	 2, /* IEEE80211_RADIOTAP_RX_FLAGS */
-	 2, /* IEEE80211_RADIOTAP_TX_FLAGS */
-	 1, /* IEEE80211_RADIOTAP_RTS_RETRIES */
-	 1, /* IEEE80211_RADIOTAP_DATA_RETRIES */
+/*
+ * Size and alignment of each radiotap field we know, indexed by
+ * presence bit.  Fields appear in bit order, each aligned to its
+ * natural boundary relative to the start of the header, so one table
+ * lookup per present field locates them all.
+ */
+static const struct {
+	u_int8_t size;
+	u_int8_t align;
+} radiotap_fields[RadiotapDecap::NFIELDS] = {
+	{8, 8}, /* IEEE80211_RADIOTAP_TSFT */
+	{1, 1}, /* IEEE80211_RADIOTAP_FLAGS */
+	{1, 1}, /* IEEE80211_RADIOTAP_RATE */
+	{4, 2}, /* IEEE80211_RADIOTAP_CHANNEL */
+	{2, 2}, /* IEEE80211_RADIOTAP_FHSS */
+	{1, 1}, /* IEEE80211_RADIOTAP_DBM_ANTSIGNAL */
+	{1, 1}, /* IEEE80211_RADIOTAP_DBM_ANTNOISE */
+	{2, 2}, /* IEEE80211_RADIOTAP_LOCK_QUALITY */
+	{2, 2}, /* IEEE80211_RADIOTAP_TX_ATTENUATION */
+	{2, 2}, /* IEEE80211_RADIOTAP_DB_TX_ATTENUATION */
+	{1, 1}, /* IEEE80211_RADIOTAP_DBM_TX_POWER */
+	{1, 1}, /* IEEE80211_RADIOTAP_ANTENNA */
+	{1, 1}, /* IEEE80211_RADIOTAP_DB_ANTSIGNAL */
+	{1, 1}, /* IEEE80211_RADIOTAP_DB_ANTNOISE */
+	{2, 2}, /* IEEE80211_RADIOTAP_RX_FLAGS */
+	{2, 2}, /* IEEE80211_RADIOTAP_TX_FLAGS */
+	{1, 1}, /* IEEE80211_RADIOTAP_RTS_RETRIES */
+	{1, 1}, /* IEEE80211_RADIOTAP_DATA_RETRIES */
 	};
 
-static int rt_el_present(struct ieee80211_radiotap_header *th, u_int32_t element)
-{
-	if (element > NUM_RADIOTAP_ELEMENTS)
-		return 0;
-	return le32_to_cpu(th->it_present) & (1 << element);
-}
-
-static int rt_check_header(struct ieee80211_radiotap_header *th, int len)
+/*
+ * Compute where the known fields of th lie, in one pass over its
+ * presence bits.  Every known field precedes any field we don't know,
+ * so the unknown ones can be ignored.  Returns false if the header is
+ * too short for its presence words.
+ */
+static bool rt_layout(const struct ieee80211_radiotap_header *th, unsigned len,
+		      RadiotapDecap::Layout &l)
 {
-	int bytes = 0;
-	int x = 0;
-	if (th->it_version != 0) {
-		return 0;
-	}
-
-	if (le16_to_cpu(th->it_len) < sizeof(struct ieee80211_radiotap_header)) {
-		return 0;
-	}
-
-	for (x = 0; x < NUM_RADIOTAP_ELEMENTS; x++) {
-		if (rt_el_present(th, x))
-		    bytes += radiotap_elem_to_bytes[x];
-	}
-
-	if (le16_to_cpu(th->it_len) < sizeof(struct ieee80211_radiotap_header) + bytes) {
-		return 0;
-	}
-
-	if (le16_to_cpu(th->it_len) > len) {
-		return 0;
+	const u_int8_t *base = (const u_int8_t *) th;
+	l.present = le32_to_cpu(th->it_present);
+
+	/* field data follows the last presence word */
+	unsigned offset = sizeof(struct ieee80211_radiotap_header);
+	u_int32_t word = l.present;
+	while (word & (1U << IEEE80211_RADIOTAP_EXT)) {
+		if (offset + 4 > len)
+			return false;
+		word = le32_to_cpu(*(const u_int32_t *) (base + offset));
+		offset += 4;
 	}
 
-	return 1;
-}
-
-static u_int8_t *rt_el_offset(struct ieee80211_radiotap_header *th, u_int32_t element) {
-	unsigned int x = 0;
-	u_int8_t *offset = ((u_int8_t *) th) + sizeof(ieee80211_radiotap_header);
-	for (x = 0; x < NUM_RADIOTAP_ELEMENTS && x < element; x++) {
-		if (rt_el_present(th, x))
-			offset += radiotap_elem_to_bytes[x];
+	u_int32_t known = l.present & ((1U << RadiotapDecap::NFIELDS) - 1);
+	for (int x = 0; x < RadiotapDecap::NFIELDS; x++) {
+		if (!(known & (1U << x))) {
+			l.offset[x] = 0;
+			continue;
+		}
+		unsigned align = radiotap_fields[x].align;
+		offset = (offset + align - 1) & ~(align - 1);
+		l.offset[x] = offset;
+		offset += radiotap_fields[x].size;
 	}
-
-	return offset;
+	l.end = offset;
+	return true;
 }
 
 RadiotapDecap::RadiotapDecap()
 {
+	// no layout cached yet: bitmaps with EXT set are never cached
+	_layout.present = 1U << IEEE80211_RADIOTAP_EXT;
 }
 
 RadiotapDecap::~RadiotapDecap()
@@ -114,58 +114,77 @@ RadiotapDecap::configure(Vector<String> &conf, ErrorHandler *errh)
 Packet *
 RadiotapDecap::simple_action(Packet *p)
 {
-	struct ieee80211_radiotap_header *th = (struct ieee80211_radiotap_header *) p->data();
+	const struct ieee80211_radiotap_header *th = (const struct ieee80211_radiotap_header *) p->data();
+	if (p->length() < sizeof(struct ieee80211_radiotap_header) || th->it_version != 0)
+		return p;
+	unsigned len = le16_to_cpu(th->it_len);
+	if (len < sizeof(struct ieee80211_radiotap_header) || len > p->length())
+		return p;
+
+	/* drivers send the same presence bitmap on every frame, so reuse
+	 * the last layout when we can */
+	u_int32_t present = le32_to_cpu(th->it_present);
+	Layout scratch;
+	const Layout *l = &_layout;
+	if (present != _layout.present) {
+		if (!rt_layout(th, len, scratch))
+			return p;
+		if (!(present & (1U << IEEE80211_RADIOTAP_EXT)))
+			_layout = scratch;
+		l = &scratch;
+	}
+	if (l->end > len)
+		return p;
+
+	const u_int8_t *base = (const u_int8_t *) th;
 	struct click_wifi_extra *ceh = WIFI_EXTRA_ANNO(p);
-	if (rt_check_header(th, p->length())) {
-		memset((void*)ceh, 0, sizeof(struct click_wifi_extra));
-		ceh->magic = WIFI_EXTRA_MAGIC;
-
-		if (rt_el_present(th, IEEE80211_RADIOTAP_FLAGS)) {
-			u_int8_t flags = *((u_int8_t *) rt_el_offset(th, IEEE80211_RADIOTAP_FLAGS));
-			if (flags & IEEE80211_RADIOTAP_F_DATAPAD) {
-				ceh->pad = 1;
-			}
-			if (flags & IEEE80211_RADIOTAP_F_FCS) {
-				p->take(4);
-			}
-		}
+	memset((void*)ceh, 0, sizeof(struct click_wifi_extra));
+	ceh->magic = WIFI_EXTRA_MAGIC;
 
-		if (rt_el_present(th, IEEE80211_RADIOTAP_RATE)) {
-			ceh->rate = *((u_int8_t *) rt_el_offset(th, IEEE80211_RADIOTAP_RATE));
+	if (l->has(IEEE80211_RADIOTAP_FLAGS)) {
+		u_int8_t flags = base[l->offset[IEEE80211_RADIOTAP_FLAGS]];
+		if (flags & IEEE80211_RADIOTAP_F_DATAPAD) {
+			ceh->pad = 1;
 		}
+		if (flags & IEEE80211_RADIOTAP_F_FCS) {
+			p->take(4);
+		}
+	}
 
-		if (rt_el_present(th, IEEE80211_RADIOTAP_DBM_ANTSIGNAL))
-			ceh->rssi = *((u_int8_t *) rt_el_offset(th, IEEE80211_RADIOTAP_DBM_ANTSIGNAL));
-
-		if (rt_el_present(th, IEEE80211_RADIOTAP_DBM_ANTNOISE))
-			ceh->silence = *((u_int8_t *) rt_el_offset(th, IEEE80211_RADIOTAP_DBM_ANTNOISE));
+	if (l->has(IEEE80211_RADIOTAP_RATE))
+		ceh->rate = base[l->offset[IEEE80211_RADIOTAP_RATE]];
 
-		if (rt_el_present(th, IEEE80211_RADIOTAP_DB_ANTSIGNAL))
-			ceh->rssi = *((u_int8_t *) rt_el_offset(th, IEEE80211_RADIOTAP_DB_ANTSIGNAL));
+	if (l->has(IEEE80211_RADIOTAP_DBM_ANTSIGNAL))
+		ceh->rssi = base[l->offset[IEEE80211_RADIOTAP_DBM_ANTSIGNAL]];
 
-		if (rt_el_present(th, IEEE80211_RADIOTAP_DB_ANTNOISE))
-			ceh->silence = *((u_int8_t *) rt_el_offset(th, IEEE80211_RADIOTAP_DB_ANTNOISE));
+	if (l->has(IEEE80211_RADIOTAP_DBM_ANTNOISE))
+		ceh->silence = base[l->offset[IEEE80211_RADIOTAP_DBM_ANTNOISE]];
 
-		if (rt_el_present(th, IEEE80211_RADIOTAP_RX_FLAGS)) {
-			u_int16_t flags = le16_to_cpu(*((u_int16_t *) rt_el_offset(th, IEEE80211_RADIOTAP_RX_FLAGS)));
-			if (flags & IEEE80211_RADIOTAP_F_RX_BADFCS)
-				ceh->flags |= WIFI_EXTRA_RX_ERR;
-		}
+	if (l->has(IEEE80211_RADIOTAP_DB_ANTSIGNAL))
+		ceh->rssi = base[l->offset[IEEE80211_RADIOTAP_DB_ANTSIGNAL]];
 
-		if (rt_el_present(th, IEEE80211_RADIOTAP_TX_FLAGS)) {
-			u_int16_t flags = le16_to_cpu(*((u_int16_t *) rt_el_offset(th, IEEE80211_RADIOTAP_TX_FLAGS)));
-			ceh->flags |= WIFI_EXTRA_TX;
-			if (flags & IEEE80211_RADIOTAP_F_TX_FAIL)
-				ceh->flags |= WIFI_EXTRA_TX_FAIL;
-		}
+	if (l->has(IEEE80211_RADIOTAP_DB_ANTNOISE))
+		ceh->silence = base[l->offset[IEEE80211_RADIOTAP_DB_ANTNOISE]];
 
-		if (rt_el_present(th, IEEE80211_RADIOTAP_DATA_RETRIES))
-			ceh->retries = *((u_int8_t *) rt_el_offset(th, IEEE80211_RADIOTAP_DATA_RETRIES));
+	if (l->has(IEEE80211_RADIOTAP_RX_FLAGS)) {
+		u_int16_t flags = le16_to_cpu(*((const u_int16_t *) (base + l->offset[IEEE80211_RADIOTAP_RX_FLAGS])));
+		if (flags & IEEE80211_RADIOTAP_F_RX_BADFCS)
+			ceh->flags |= WIFI_EXTRA_RX_ERR;
+	}
 
-		p->pull(le16_to_cpu(th->it_len));
-		p->set_mac_header(p->data());  // reset mac-header pointer
+	if (l->has(IEEE80211_RADIOTAP_TX_FLAGS)) {
+		u_int16_t flags = le16_to_cpu(*((const u_int16_t *) (base + l->offset[IEEE80211_RADIOTAP_TX_FLAGS])));
+		ceh->flags |= WIFI_EXTRA_TX;
+		if (flags & IEEE80211_RADIOTAP_F_TX_FAIL)
+			ceh->flags |= WIFI_EXTRA_TX_FAIL;
 	}
 
+	if (l->has(IEEE80211_RADIOTAP_DATA_RETRIES))
+		ceh->retries = base[l->offset[IEEE80211_RADIOTAP_DATA_RETRIES]];
+
+	p->pull(len);
+	p->set_mac_header(p->data());  // reset mac-header pointer
+
   return p;
 }
 
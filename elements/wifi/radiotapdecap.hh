@@ -16,6 +16,11 @@ Pulls the click_wifi_radiotap header from a packet and stores it in Packet::anno
 Removes the radiotap header and copies to to Packet->anno(). This contains
 informatino such as rssi, noise, bitrate, etc.
 
+The header is decoded in one pass using a table of field sizes and
+alignments.  The field layout for the last presence bitmap seen is
+cached, so frames from the same driver are decoded without walking
+the bitmap.
+
 =a RadiotapEncap
 */
 
@@ -38,8 +43,21 @@ class RadiotapDecap : public Element { public:
 
 
   bool _debug;
+
+  enum { NFIELDS = 18 };	// fields through IEEE80211_RADIOTAP_DATA_RETRIES
+
+  // where each known field lies in a header with a given bitmap
+  struct Layout {
+    uint32_t present;		// first presence word
+    uint16_t end;		// bytes needed for the known fields
+    uint16_t offset[NFIELDS];	// of each present field
+    bool has(int field) const	{ return offset[field] != 0; }
+  };
+
  private:
 
+  Layout _layout;
+
 };
 
 CLICK_ENDDECLS
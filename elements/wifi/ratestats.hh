@@ -0,0 +1,143 @@
+#ifndef CLICK_RATESTATS_HH
+#define CLICK_RATESTATS_HH
+#include <click/ewma.hh>
+#include <click/timestamp.hh>
+#include <click/vector.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+/*
+ * Per-rate transmit statistics for one neighbor, shared by the wifi
+ * rate control elements.  The neighbor's rates are kept inline, in
+ * the order AvailableRates gave them, so recording feedback and
+ * picking rates never allocate.  For each rate we keep exponentially
+ * weighted moving averages of the delivery ratio and of the airtime
+ * per packet, updated in constant time, and counts since the rate's
+ * statistics were last cleared.  Rates beyond MAX_RATES are ignored.
+ */
+class RateStats { public:
+
+  enum { MAX_RATES = 16, MAX_USECS = 1 << 19 };
+
+  // alpha 1/8, 12 bits of fraction
+  typedef DirectEWMAX<FixedEWMAXParameters<3, 12> > EWMA;
+
+  struct Rate {
+    EWMA _delivery;		// fraction of packets delivered
+    EWMA _usecs;		// airtime per packet, in microseconds
+    uint32_t _packets;
+    uint32_t _successes;
+    uint32_t _failures;
+    uint32_t _tries;
+    uint32_t _fail_run;		// failures since the last success
+    Timestamp _last;		// time of the last update
+
+    Rate() { clear(); }
+
+    void clear() {
+      _delivery.clear();
+      _usecs.clear();
+      _packets = _successes = _failures = _tries = _fail_run = 0;
+      _last = Timestamp();
+    }
+
+    // Expected airtime per delivered packet, or 0 if no packet has
+    // been delivered.
+    unsigned usecs_per_success() const {
+      uint32_t d = _delivery.scaled_average();
+      if (!_successes || !d)
+	return 0;
+      return _usecs.scaled_average() / d;
+    }
+
+    void update(const Timestamp &now, bool success, unsigned usecs, int tries) {
+      if (usecs > MAX_USECS)
+	usecs = MAX_USECS;
+      if (_packets) {
+	_delivery.update(success);
+	_usecs.update(usecs);
+      } else {
+	// start the averages at the first observation
+	_delivery.assign(EWMA::scaled_one() * success);
+	_usecs.assign(usecs << EWMA::scale());
+      }
+      _packets++;
+      _tries += tries;
+      if (success) {
+	_successes++;
+	_fail_run = 0;
+      } else {
+	_failures++;
+	_fail_run++;
+      }
+      _last = now;
+    }
+  };
+
+  RateStats() : _nrates(0) { }
+  explicit RateStats(const Vector<int> &rates) { assign(rates); }
+
+  void assign(const Vector<int> &rates) {
+    _nrates = (rates.size() < MAX_RATES ? rates.size() : (int) MAX_RATES);
+    for (int i = 0; i < _nrates; i++) {
+      _rate[i] = rates[i];
+      _stats[i].clear();
+    }
+  }
+
+  int size() const		{ return _nrates; }
+  int rate(int i) const		{ return _rate[i]; }
+  Rate &operator[](int i)	{ return _stats[i]; }
+  const Rate &operator[](int i) const { return _stats[i]; }
+
+  // Index of rate, or -1 if the neighbor doesn't use it.
+  int index(int rate) const {
+    for (int i = 0; i < _nrates; i++)
+      if (_rate[i] == rate)
+	return i;
+    return -1;
+  }
+
+  // Record a transmission at rate, if the neighbor uses it.
+  int update(int rate, const Timestamp &now, bool success, unsigned usecs, int tries) {
+    int i = index(rate);
+    if (i >= 0)
+      _stats[i].update(now, success, usecs, tries);
+    return i;
+  }
+
+  // Forget the statistics of rates not used since before.
+  void expire(const Timestamp &before) {
+    for (int i = 0; i < _nrates; i++)
+      if (_stats[i]._packets && _stats[i]._last < before)
+	_stats[i].clear();
+  }
+
+  void clear() {
+    for (int i = 0; i < _nrates; i++)
+      _stats[i].clear();
+  }
+
+  // One line per rate: "RATE delivery D usecs U tries T success S fail F".
+  void unparse(StringAccum &sa) const {
+    for (int i = 0; i < _nrates; i++) {
+      const Rate &r = _stats[i];
+      sa << ' ' << _rate[i]
+	 << " delivery " << r._delivery.unparse()
+	 << " usecs " << r._usecs.unparse()
+	 << " tries " << r._tries
+	 << " success " << r._successes
+	 << " fail " << r._failures << '\n';
+    }
+  }
+
+ private:
+
+  int _nrates;
+  int _rate[MAX_RATES];
+  Rate _stats[MAX_RATES];
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -47,6 +47,7 @@ RXStats::simple_action(Packet *p_in)
   if (!nfo) {
     DstInfo foo = DstInfo(src);
     _neighbors.insert(src, foo);
+    _order.push_back(src);
     nfo = _neighbors.findp(src);
   }
 
@@ -64,42 +65,53 @@ RXStats::simple_action(Packet *p_in)
 
 enum {H_STATS, H_RESET};
 
-static String
-RXStats_read_param(Element *e, void *thunk)
+static void
+RXStats_unparse(StringAccum &sa, const RXStats::DstInfo &n, const Timestamp &now)
 {
-  RXStats *td = (RXStats *)e;
-  switch ((uintptr_t) thunk) {
-  case H_STATS: {
-    Timestamp now = Timestamp::now();
-
-    StringAccum sa;
-    for (RXStats::NIter iter = td->_neighbors.begin(); iter.live(); iter++) {
-      RXStats::DstInfo n = iter.value();
-      Timestamp age = now - n._last_received;
-      Timestamp avg_signal;
-      Timestamp avg_noise;
-      if (n._packets) {
-	      avg_signal = Timestamp::make_msec(1000*n._sum_signal / n._packets);
-	      avg_noise = Timestamp::make_msec(1000*n._sum_noise / n._packets);
-      }
-      sa << n._eth.unparse();
-      sa << " rate " << n._rate;
-      sa << " signal " << n._signal;
-      sa << " noise " << n._noise;
-      sa << " avg_signal " << avg_signal;
-      sa << " avg_noise " << avg_noise;
-      sa << " total_signal " << n._sum_signal;
-      sa << " total_noise " << n._sum_noise;
-      sa << " packets " << n._packets;
-      sa << " last_received " << age << "\n";
-    }
-    return sa.take_string();
+  Timestamp age = now - n._last_received;
+  Timestamp avg_signal;
+  Timestamp avg_noise;
+  if (n._packets) {
+    avg_signal = Timestamp::make_msec(1000*n._sum_signal / n._packets);
+    avg_noise = Timestamp::make_msec(1000*n._sum_noise / n._packets);
   }
+  sa << n._eth.unparse();
+  sa << " rate " << n._rate;
+  sa << " signal " << n._signal;
+  sa << " noise " << n._noise;
+  sa << " avg_signal " << avg_signal;
+  sa << " avg_noise " << avg_noise;
+  sa << " total_signal " << n._sum_signal;
+  sa << " total_noise " << n._sum_noise;
+  sa << " packets " << n._packets;
+  sa << " last_received " << age << "\n";
+}
 
-  default:
-    return String();
+static int
+RXStats_stats_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+  RXStats *td = (RXStats *)e;
+  Timestamp now = Timestamp::now();
+  StringAccum sa;
+
+  if (!str) {
+    for (RXStats::NIter iter = td->_neighbors.begin(); iter.live(); iter++)
+      RXStats_unparse(sa, iter.value(), now);
+  } else {
+    int cursor, count = 64;
+    if (Args(e, errh).push_back_words(str)
+	.read_mp("CURSOR", cursor)
+	.read_p("COUNT", count)
+	.complete() < 0)
+      return -1;
+    if (cursor < 0 || count < 0)
+      return errh->error("CURSOR and COUNT must be nonnegative");
+    for (int i = cursor; i < td->_order.size() && i - cursor < count; i++)
+      RXStats_unparse(sa, td->_neighbors[td->_order[i]], now);
   }
 
+  str = sa.take_string();
+  return 0;
 }
 
 static int
@@ -109,7 +121,10 @@ RXStats_write_param(const String &in_s, Element *e, void *vparam,
   RXStats *f = (RXStats *)e;
   String s = cp_uncomment(in_s);
   switch((intptr_t)vparam) {
-  case H_RESET: f->_neighbors.clear(); return 0;
+  case H_RESET:
+    f->_neighbors.clear();
+    f->_order.clear();
+    return 0;
   }
   return 0;
 }
@@ -117,7 +132,7 @@ RXStats_write_param(const String &in_s, Element *e, void *vparam,
 void
 RXStats::add_handlers()
 {
-  add_read_handler("stats", RXStats_read_param, H_STATS);
+  set_handler("stats", Handler::OP_READ | Handler::READ_PARAM, RXStats_stats_handler, H_STATS);
   add_write_handler("reset", RXStats_write_param, H_RESET, Handler::BUTTON);
 
 }
@@ -20,7 +20,12 @@ Accumulate RSSI, noise for each ethernet source you hear a packet from.
 
 
 =h stats
-Print information accumulated for each source
+Print information accumulated for each source, one source per line.
+Takes optional CURSOR and COUNT arguments: with them, only the COUNT
+sources (default 64) starting at position CURSOR are printed.  Sources
+keep their positions until reset, in the order they were first heard,
+so a reader can page through a large table by advancing CURSOR by the
+number of lines returned, without a long read stalling the router.
 
 =h reset
 Clear all information for each source
@@ -69,6 +74,7 @@ class RXStats : public Element { public:
   typedef NeighborTable::const_iterator NIter;
 
   NeighborTable _neighbors;
+  Vector<EtherAddress> _order;	// sources in the order first heard
   EtherAddress _bcast;
   int _tau;
 
@@ -64,7 +64,7 @@ AssociationRequester::send_assoc_req()
   EtherAddress bssid = _winfo ? _winfo->_bssid : EtherAddress();
   String ssid = _winfo ? _winfo->_ssid : "";
   int linterval = _winfo ? _winfo->_interval : 1;
-  Vector<int> rates = _rtable->lookup(bssid);
+  const Vector<int> &rates = _rtable->lookup(bssid);
   int max_len = sizeof (struct click_wifi) +
     2 + /* cap_info */
     2 + /* listen_int */
@@ -32,6 +32,7 @@ class BeaconTracker : public Element { public:
   ~BeaconTracker();
 
   const char *class_name() const	{ return "BeaconTracker"; }
+  const char *flags() const		{ return "T"; }
   const char *port_count() const	{ return PORTS_1_1; }
   const char *processing() const	{ return AGNOSTIC; }
 
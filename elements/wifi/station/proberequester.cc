@@ -61,7 +61,7 @@ ProbeRequester::configure(Vector<String> &conf, ErrorHandler *errh)
 void
 ProbeRequester::send_probe_request()
 {
-  Vector<int> rates = _rtable->lookup(_eth);
+  const Vector<int> &rates = _rtable->lookup(_eth);
   int max_len = sizeof (struct click_wifi) +
     2 + (_winfo ? _winfo->_ssid.length() : 0) + /* ssid */
     2 + WIFI_RATE_SIZE + /* rates */
@@ -62,14 +62,13 @@ WifiDupeFilter::simple_action(Packet *p_in)
 
   bool is_frag = frag || more_frag;
 
-  DstInfo *nfo = _table.findp(src);
+  DstInfo *nfo = _table.get_pointer(src);
 
   if (w->i_fc[0] & WIFI_FC0_TYPE_CTL || dst.is_group()) {
     return p_in;
   }
   if (!nfo) {
-    _table.insert(src, DstInfo(src));
-    nfo = _table.findp(src);
+    nfo = &_table.find_insert(src, DstInfo(src)).value();
     nfo->clear();
   }
 
@@ -2,7 +2,7 @@
 #define CLICK_WIFIDUPEFILTER_HH
 #include <click/element.hh>
 #include <click/string.hh>
-#include <click/hashmap.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 /*
@@ -62,7 +62,7 @@ class WifiDupeFilter : public Element {
     }
   };
 
-  typedef HashMap <EtherAddress, DstInfo> DstTable;
+  typedef HashTable<EtherAddress, DstInfo> DstTable;
   typedef DstTable::const_iterator DstIter;
 
   DstTable _table;
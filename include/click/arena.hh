@@ -0,0 +1,99 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/arena.cc" -*-
+#ifndef CLICK_ARENA_HH
+#define CLICK_ARENA_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/** @class Arena
+ * @brief Memory for many objects that share one lifetime.
+ *
+ * An Arena hands out memory from large chunks and frees all of it at once,
+ * when it is destroyed or clear()ed; there is no way to free a single
+ * allocation.  Allocating is usually a pointer bump, and freeing N objects
+ * takes one free per chunk rather than N.  This suits objects built while a
+ * router is configured and kept until it dies, such as route table nodes:
+ * see Router::arena_allocate().
+ *
+ * An Arena runs no destructors, so objects placed in one should not own other
+ * resources.  Arena is not thread safe. */
+class Arena { public:
+
+    enum {
+#if CLICK_LINUXMODULE
+	default_chunk_size = 8192,
+#else
+	default_chunk_size = 65536,
+#endif
+	alignment = 16
+    };
+
+    /** @brief Construct an Arena that allocates @a chunk_size-byte chunks.
+     *
+     * No memory is allocated until the first call to allocate(). */
+    explicit Arena(size_t chunk_size = default_chunk_size);
+
+    /** @brief Destroy the Arena, freeing all its memory. */
+    ~Arena() {
+	clear();
+    }
+
+    /** @brief Return @a size bytes of uninitialized memory, or null if out
+     * of memory.
+     *
+     * The memory is aligned to a multiple of @a alignment bytes.
+     * Allocations larger than a quarter chunk get chunks of their own. */
+    inline void *allocate(size_t size);
+
+    /** @brief Free all the Arena's memory.
+     *
+     * Every pointer the Arena returned becomes invalid. */
+    void clear();
+
+    /** @brief Return the number of bytes allocated since the last clear(). */
+    size_t nbytes() const {
+	return _nbytes;
+    }
+
+    /** @brief Return the number of chunks held. */
+    size_t nchunks() const {
+	return _nchunks;
+    }
+
+  private:
+
+    struct chunk {
+	chunk *next;
+	size_t size;
+    };
+
+    enum { chunk_header = (sizeof(chunk) + alignment - 1) & ~(alignment - 1) };
+
+    chunk *_chunk;
+    char *_pos;
+    char *_end;
+    size_t _chunk_size;
+    size_t _nbytes;
+    size_t _nchunks;
+
+    void *hard_allocate(size_t size);
+
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+
+};
+
+inline void *
+Arena::allocate(size_t size)
+{
+    size = (size + alignment - 1) & ~(size_t) (alignment - 1);
+    if (size <= (size_t) (_end - _pos)) {
+	void *p = _pos;
+	_pos += size;
+	_nbytes += size;
+	return p;
+    } else
+	return hard_allocate(size);
+}
+
+CLICK_ENDDECLS
+#endif
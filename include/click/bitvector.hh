@@ -2,6 +2,7 @@
 #ifndef CLICK_BITVECTOR_HH
 #define CLICK_BITVECTOR_HH
 #include <click/glue.hh>
+#include <click/integers.hh>
 CLICK_DECLS
 
 /** @file <click/bitvector.hh>
@@ -12,7 +13,17 @@ CLICK_DECLS
 
   The Bitvector class implements a vector of individually addressable bits.
   It supports bitwise operations such as |= and &= as well as the usual
-  assignment and indexing operations. */
+  assignment and indexing operations.
+
+  Bits are stored in machine words (64 bits on most hosts), so bitwise
+  operations handle a word of bits per step.  Bitvectors of up to two words
+  are stored inline, without allocating memory.  To visit the true bits of
+  a sparse bitvector, use find_first() and find_next():
+
+  @code
+  for (int i = bv.find_first(); i >= 0; i = bv.find_next(i))
+      ... bv[i] is true ...
+  @endcode */
 class Bitvector { public:
 
     class Bit;
@@ -53,6 +64,20 @@ class Bitvector { public:
     /** @brief Return true iff the bitvector's bits are all false. */
     bool zero() const;
 
+    /** @brief Return the number of true bits in the bitvector. */
+    int count() const;
+
+    /** @brief Return the position of the first true bit, or -1 if there
+     * is none. */
+    int find_first() const {
+	return find_next(-1);
+    }
+
+    /** @brief Return the position of the first true bit after position
+     * @a i, or -1 if there is none.
+     * @pre -1 <= @a i */
+    int find_next(int i) const;
+
     typedef bool (Bitvector::*unspecified_bool_type)() const;
     /** @brief Return true iff the bitvector's bits are all false.
      * @sa zero() */
@@ -102,9 +127,9 @@ class Bitvector { public:
 	if (_max != x._max)
 	    return false;
 	else if (_max <= MAX_INLINE_BIT)
-	    return memcmp(_data, x._data, 8) == 0;
+	    return memcmp(_data, x._data, 2 * sizeof(data_word_type)) == 0;
 	else
-	    return memcmp(_data, x._data, (max_word() + 1)*4) == 0;
+	    return memcmp(_data, x._data, (max_word() + 1) * sizeof(data_word_type)) == 0;
     }
 
     /** @brief Check bitvectors for inequality. */
@@ -201,16 +226,18 @@ class Bitvector { public:
      *
      * Bitvectors are stored as arrays of data words, each containing
      * data_word_bits bits.  For special purposes it may be faster or easier
-     * to manipulate data words directly. */
-    typedef uint32_t data_word_type;
+     * to manipulate data words directly.  A data word is an unsigned long,
+     * so it has 64 bits on most 64-bit hosts and 32 bits elsewhere. */
+    typedef unsigned long data_word_type;
 
     enum {
-	data_word_bits = 32
+	data_word_bits = 8 * SIZEOF_LONG,
+	data_word_shift = (SIZEOF_LONG == 8 ? 6 : 5)
     };
 
     /** @brief Return the index of the maximum valid data word. */
     int max_word() const {
-	return (_max < 0 ? -1 : _max >> 5);
+	return (_max < 0 ? -1 : _max >> data_word_shift);
     }
 
     /** @brief Return a pointer to this bitvector's data words. */
@@ -225,12 +252,12 @@ class Bitvector { public:
 
   private:
 
-    enum { MAX_INLINE_BIT = 63, MAX_INLINE_WORD = 1 };
+    enum { MAX_INLINE_BIT = 2 * data_word_bits - 1, MAX_INLINE_WORD = 1 };
 
     int _max;
-    uint32_t *_data;
-    uint32_t _f0;
-    uint32_t _f1;
+    data_word_type *_data;
+    data_word_type _f0;
+    data_word_type _f1;
 
     void finish_copy_constructor(const Bitvector &);
     void clear_last();
@@ -248,7 +275,7 @@ class Bitvector::Bit { public:
 
     /** @brief Construct a bit at offset @a bit_offset in data word @a w. */
     Bit(Bitvector::data_word_type &w, int bit_offset)
-	: _p(w), _mask(1U << bit_offset) {
+	: _p(w), _mask((Bitvector::data_word_type) 1 << bit_offset) {
     }
 
     typedef Bitvector::unspecified_bool_type unspecified_bool_type;
@@ -306,8 +333,8 @@ class Bitvector::Bit { public:
 
   private:
 
-    uint32_t &_p;
-    uint32_t _mask;
+    Bitvector::data_word_type &_p;
+    Bitvector::data_word_type _mask;
 
 };
 
@@ -353,14 +380,15 @@ inline Bitvector::Bit
 Bitvector::operator[](int i)
 {
     assert(i >= 0 && i <= _max);
-    return Bit(_data[i>>5], i & 31);
+    return Bit(_data[i >> data_word_shift], i & (data_word_bits - 1));
 }
 
 inline bool
 Bitvector::operator[](int i) const
 {
     assert(i >= 0 && i <= _max);
-    return (_data[i>>5] & (1U << (i & 31))) != 0;
+    return (_data[i >> data_word_shift]
+	    & ((data_word_type) 1 << (i & (data_word_bits - 1)))) != 0;
 }
 
 inline Bitvector::Bit
@@ -369,7 +397,7 @@ Bitvector::force_bit(int i)
     assert(i >= 0);
     if (i > _max)
 	resize(i + 1);
-    return Bit(_data[i>>5], i&31);
+    return Bit(_data[i >> data_word_shift], i & (data_word_bits - 1));
 }
 
 inline Bitvector &
@@ -68,6 +68,29 @@ String cp_shift_spacevec(String &str);
 
 String cp_unspacevec(const String *begin, const String *end);
 inline String cp_unspacevec(const Vector<String> &conf);
+
+/** @class ArgvecIterator
+ * @brief Separates a configuration string into arguments on demand.
+ *
+ * An ArgvecIterator returns the same arguments as cp_argvec(), one at a
+ * time, without building a vector of them.  This lets an element with a
+ * very long argument list process each argument and discard it:
+ * @code
+ * ArgvecIterator it(str);
+ * String arg;
+ * while (it.next(arg))
+ *     process(arg);
+ * @endcode */
+class ArgvecIterator { public:
+    explicit ArgvecIterator(const String &str)
+	: _str(str), _pos(0) {
+    }
+    const String &configuration() const	{ return _str; }
+    bool next(String &arg);
+  private:
+    String _str;
+    int _pos;
+};
 //@}
 
 /// @name Direct Parsing Functions
@@ -5,6 +5,7 @@
 #include <click/vector.hh>
 #include <click/string.hh>
 #include <click/packet.hh>
+#include <click/packetbatch.hh>
 #include <click/handler.hh>
 CLICK_DECLS
 class Router;
@@ -17,6 +18,7 @@ class Element;
 class ErrorHandler;
 class Bitvector;
 class EtherAddress;
+class ArgvecIterator;
 
 /** @file <click/element.hh>
  * @brief Click's Element class.
@@ -26,6 +28,19 @@ class EtherAddress;
 # define CLICK_ELEMENT_DEPRECATED CLICK_DEPRECATED
 #endif
 
+// User-level builds without CLICK_STATS cycle accounting can turn on
+// equivalent accounting at run time; see Element::set_profiling().
+#if CLICK_USERLEVEL && !(CLICK_STATS >= 2) && HAVE_INT64_TYPES
+# define HAVE_ELEMENT_PROFILE 1
+#endif
+
+// Builds whose ports keep no packet counts can collapse chains of
+// simple_action() elements into direct loops; see Router::fused_chains().
+// Finding such elements relies on GCC's bound member function extension.
+#if !(CLICK_STATS >= 1) && defined(__GNUC__) && !defined(__clang__)
+# define HAVE_PUSH_FUSION 1
+#endif
+
 class Element { public:
 
     Element();
@@ -37,16 +52,28 @@ class Element { public:
     virtual Packet *pull(int port) CLICK_WARN_UNUSED_RESULT;
     virtual Packet *simple_action(Packet *p);
 
+    virtual void push_batch(int port, PacketBatch &batch);
+    virtual void pull_batch(int port, PacketBatch &batch, int max);
+    virtual void simple_action_batch(PacketBatch &batch);
+
     virtual bool run_task(Task *task);	// return true iff did useful work
     virtual void run_timer(Timer *timer);
 #if CLICK_USERLEVEL
-    enum { SELECT_READ = 1, SELECT_WRITE = 2 };
+    enum { SELECT_READ = 1, SELECT_WRITE = 2, SELECT_EDGE = 4 };
     virtual void selected(int fd, int mask);
     virtual void selected(int fd);
 #endif
 
     inline void checked_output_push(int port, Packet *p) const;
 
+#if HAVE_DIRECT_PORT_TRANSFER
+    typedef void (*DirectPushFunction)(Element *e, int port, Packet *p);
+    template <typename T> static void direct_push(Element *e, int port, Packet *p);
+    template <typename T> static void direct_simple_action(Element *e, int port, Packet *p);
+    static void add_direct_push(const char *class_name, DirectPushFunction push);
+    static DirectPushFunction find_direct_push(const char *class_name);
+#endif
+
     // ELEMENT CHARACTERISTICS
     virtual const char *class_name() const = 0;
 
@@ -85,6 +112,11 @@ class Element { public:
     virtual int configure_phase() const;
 
     virtual int configure(Vector<String> &conf, ErrorHandler *errh);
+    virtual int configure_stream(ArgvecIterator &args, ErrorHandler *errh);
+    virtual int encap_headroom() const;
+    enum { DATA_SHIFT_UNKNOWN = 0x7FFFFFFF };
+    virtual int data_shift() const;
+    virtual bool input_alignment(int &modulus, int &offset) const;
 
     virtual void add_handlers();
 
@@ -93,6 +125,29 @@ class Element { public:
     virtual void take_state(Element *old_element, ErrorHandler *errh);
     virtual Element *hotswap_element() const;
 
+    // MEMORY ACCOUNTING
+    virtual size_t memory_usage() const;
+    inline size_t memory_limit() const;
+    inline void set_memory_limit(size_t limit);
+    inline bool memory_exceeded(size_t extra = 0) const;
+
+#if HAVE_ELEMENT_PROFILE
+    static inline bool profiling();
+    static void set_profiling(bool profiling);
+    void reset_profile();
+    inline uint64_t profile_calls() const;
+    inline uint64_t profile_packets() const;
+    inline click_cycles_t profile_cycles() const;
+    inline uint64_t profile_events() const;
+    typedef uint64_t (*ProfileCounter)();
+    static void set_profile_counter(ProfileCounter counter, const char *name);
+    static inline const char *profile_counter_name();
+    typedef void (*PacketTracer)(Packet *p, Element *from, int from_port,
+				 Element *to, int to_port);
+    static void set_packet_tracer(PacketTracer tracer);
+    static inline PacketTracer packet_tracer();
+#endif
+
     enum CleanupStage {
 	CLEANUP_NO_ROUTER,
 	CLEANUP_BEFORE_CONFIGURE = CLEANUP_NO_ROUTER,
@@ -202,6 +257,13 @@ class Element { public:
     void add_data_handlers(const char *name, int flags, EtherAddress *data);
     void add_data_handlers(const char *name, int flags, Timestamp *data, bool is_interval = false);
 
+    void add_stat(const char *name, const uint32_t *data);
+    void add_stat(const char *name, const uint64_t *data);
+    void add_stat(const char *name, const atomic_uint32_t *data);
+    void add_stat(const char *name, StatCallback callback, void *user_data = 0);
+
+    void add_memory_limit_handler();
+
     static String read_positional_handler(Element*, void*);
     static String read_keyword_handler(Element*, void*);
     static int reconfigure_positional_handler(const String&, Element*, void*, ErrorHandler*);
@@ -218,6 +280,8 @@ class Element { public:
 
 	inline void push(Packet* p) const;
 	inline Packet* pull() const;
+	inline void push_batch(PacketBatch &batch) const;
+	inline void pull_batch(PacketBatch &batch, int max) const;
 
 #if CLICK_STATS >= 1
 	unsigned npackets() const	{ return _packets; }
@@ -227,6 +291,12 @@ class Element { public:
 
 	Element* _e;
 	int _port;
+#if HAVE_PUSH_FUSION
+	Element* const* _fused;	// Null-terminated fused chain, or null.
+#endif
+#if HAVE_DIRECT_PORT_TRANSFER
+	DirectPushFunction _direct;	// Specialized push for _e, or null.
+#endif
 #if HAVE_BOUND_PORT_TRANSFER
 	union {
 	    void (*push)(Element *e, int port, Packet *p);
@@ -237,14 +307,25 @@ class Element { public:
 #if CLICK_STATS >= 1
 	mutable unsigned _packets;	// How many packets have we moved?
 #endif
-#if CLICK_STATS >= 2
+#if CLICK_STATS >= 2 || HAVE_ELEMENT_PROFILE
 	Element* _owner;		// Whose input or output are we?
 #endif
+#if HAVE_ELEMENT_PROFILE
+	void hooked_push(Packet *p) const;
+	Packet *hooked_pull() const;
+	void hooked_push_batch(PacketBatch &batch) const;
+	void hooked_pull_batch(PacketBatch &batch, int max) const;
+	inline void trace(Packet *p, bool isoutput) const;
+#endif
+#if HAVE_PUSH_FUSION
+	void fused_push(Packet *p) const;
+#endif
 
 	inline Port();
 	inline void assign(Element *owner, Element *e, int port, bool isoutput);
 
 	friend class Element;
+	friend class Router;
 
     };
 
@@ -265,6 +346,7 @@ class Element { public:
 
     Router* _router;
     int _eindex;
+    size_t _memory_limit;
 
 #if CLICK_STATS >= 2
     // STATISTICS
@@ -286,6 +368,33 @@ class Element { public:
     static int write_cycles_handler(const String &, Element *, void *, ErrorHandler *);
 #endif
 
+#if HAVE_ELEMENT_PROFILE
+    // RUN-TIME PROFILE
+    static bool the_profiling;
+    static bool the_port_hooks;	// Profiling or tracing is on.
+    static PacketTracer the_packet_tracer;
+    static ProfileCounter the_profile_counter;
+    static const char *the_profile_counter_name;
+    uint64_t _profile_calls;	// Push, pull and task calls into this element.
+    uint64_t _profile_packets;	// Packets pushed into or pulled from it.
+    click_cycles_t _profile_own_cycles;	// Cycles spent in self.
+    click_cycles_t _profile_child_cycles;	// Cycles spent in children.
+    uint64_t _profile_own_events;	// Counter events in self.
+    uint64_t _profile_child_events;	// Counter events in children.
+
+    struct ProfileSample {
+	click_cycles_t cycles;
+	click_cycles_t child_cycles;
+	ProfileCounter counter;	// the counter at profile_begin(), or null
+	uint64_t events;
+	uint64_t child_events;
+    };
+    inline void profile_begin(ProfileSample &s) const;
+    inline void profile_end(const ProfileSample &s, Element *caller,
+			    uint64_t packets);
+    static String read_profile_handler(Element *, void *);
+#endif
+
     Element(const Element &);
     Element &operator=(const Element &);
 
@@ -304,8 +413,10 @@ class Element { public:
     inline void add_data_handlers(const char *name, int flags, HandlerCallback callback, void *data);
 
     friend class Router;
-#if CLICK_STATS >= 2
+#if CLICK_STATS >= 2 || HAVE_ELEMENT_PROFILE
     friend class Task;
+#endif
+#if CLICK_STATS >= 2
     friend class Master;
     friend class TimerSet;
 # if CLICK_USERLEVEL
@@ -383,6 +494,93 @@ Element::router() const
     return _router;
 }
 
+#if HAVE_ELEMENT_PROFILE
+/** @brief Return whether run-time profiling is on.
+ * @sa set_profiling() */
+inline bool
+Element::profiling()
+{
+    return the_profiling;
+}
+
+/** @brief Return the number of profiled push, pull and task calls into this
+ * element. */
+inline uint64_t
+Element::profile_calls() const
+{
+    return _profile_calls;
+}
+
+/** @brief Return the number of packets pushed into or pulled from this
+ * element while profiling. */
+inline uint64_t
+Element::profile_packets() const
+{
+    return _profile_packets;
+}
+
+/** @brief Return the cycles spent in this element while profiling, not
+ * counting cycles spent in the elements it called. */
+inline click_cycles_t
+Element::profile_cycles() const
+{
+    return _profile_own_cycles;
+}
+
+/** @brief Return the profile counter events in this element while
+ * profiling, not counting events in the elements it called.
+ * @sa set_profile_counter() */
+inline uint64_t
+Element::profile_events() const
+{
+    return _profile_own_events;
+}
+
+/** @brief Return the name of the profile counter, or null if none is set. */
+inline const char *
+Element::profile_counter_name()
+{
+    return the_profile_counter ? the_profile_counter_name : 0;
+}
+
+/** @brief Return the packet tracer, or null if none is set.
+ * @sa set_packet_tracer() */
+inline Element::PacketTracer
+Element::packet_tracer()
+{
+    return the_packet_tracer;
+}
+
+inline void
+Element::profile_begin(ProfileSample &s) const
+{
+    // profile_end() uses the counter saved here, so installing a counter
+    // between the two calls cannot pair a new reading with a stale one.
+    s.counter = the_profile_counter;
+    s.events = s.counter ? s.counter() : 0;
+    s.child_events = _profile_child_events;
+    s.child_cycles = _profile_child_cycles;
+    s.cycles = click_get_cycles();
+}
+
+inline void
+Element::profile_end(const ProfileSample &s, Element *caller, uint64_t packets)
+{
+    click_cycles_t all_delta = click_get_cycles() - s.cycles;
+    _profile_calls += 1;
+    _profile_packets += packets;
+    _profile_own_cycles += all_delta - (_profile_child_cycles - s.child_cycles);
+    if (caller)
+	caller->_profile_child_cycles += all_delta;
+    if (s.counter) {
+	uint64_t all_events = s.counter() - s.events;
+	_profile_own_events += all_events - (_profile_child_events - s.child_events);
+	if (caller)
+	    caller->_profile_child_events += all_events;
+    }
+}
+#endif
+
 /** @brief Return the element's index within its router.
  * @invariant this == router()->element(eindex())
  */
@@ -401,6 +599,36 @@ Element::eindex(Router* r) const
     return (router() == r ? _eindex : -1);
 }
 
+/** @brief Return the element's soft memory limit in bytes, or 0 for none.
+ * @sa memory_exceeded(), add_memory_limit_handler() */
+inline size_t
+Element::memory_limit() const
+{
+    return _memory_limit;
+}
+
+/** @brief Set the element's soft memory limit to @a limit bytes.
+ *
+ * 0 means no limit.  Only elements that check memory_exceeded() honor the
+ * limit. */
+inline void
+Element::set_memory_limit(size_t limit)
+{
+    _memory_limit = limit;
+}
+
+/** @brief Return true iff the element is over its soft memory limit.
+ * @param extra bytes about to be allocated
+ *
+ * Returns true iff a memory limit is set and memory_usage() plus @a extra
+ * exceeds it.  Elements call this before creating new state, and either
+ * evict older state or refuse the new state when it returns true. */
+inline bool
+Element::memory_exceeded(size_t extra) const
+{
+    return _memory_limit && memory_usage() + extra > _memory_limit;
+}
+
 /** @brief Return the number of input or output ports.
  * @param isoutput false for input ports, true for output ports */
 inline int
@@ -514,8 +742,12 @@ Element::input_is_push(int port) const
 
 #if CLICK_STATS >= 2
 # define PORT_ASSIGN(o) _packets = 0; _owner = (o)
+#elif CLICK_STATS >= 1 && HAVE_ELEMENT_PROFILE
+# define PORT_ASSIGN(o) _packets = 0; _owner = (o)
 #elif CLICK_STATS >= 1
 # define PORT_ASSIGN(o) _packets = 0; (void) (o)
+#elif HAVE_ELEMENT_PROFILE
+# define PORT_ASSIGN(o) _owner = (o)
 #else
 # define PORT_ASSIGN(o) (void) (o)
 #endif
@@ -523,6 +755,12 @@ Element::input_is_push(int port) const
 inline
 Element::Port::Port()
     : _e(0), _port(-2)
+#if HAVE_PUSH_FUSION
+    , _fused(0)
+#endif
+#if HAVE_DIRECT_PORT_TRANSFER
+    , _direct(0)
+#endif
 {
     PORT_ASSIGN(0);
 }
@@ -533,6 +771,12 @@ Element::Port::assign(Element *owner, Element *e, int port, bool isoutput)
     PORT_ASSIGN(owner);
     _e = e;
     _port = port;
+#if HAVE_PUSH_FUSION
+    _fused = 0;
+#endif
+#if HAVE_DIRECT_PORT_TRANSFER
+    _direct = 0;
+#endif
     (void) isoutput;
 #if HAVE_BOUND_PORT_TRANSFER
     if (e) {
@@ -618,6 +862,24 @@ Element::Port::push(Packet* p) const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
+# if HAVE_ELEMENT_PROFILE
+    if (unlikely(the_port_hooks)) {
+	hooked_push(p);
+	return;
+    }
+# endif
+# if HAVE_PUSH_FUSION
+    if (_fused) {
+	fused_push(p);
+	return;
+    }
+# endif
+# if HAVE_DIRECT_PORT_TRANSFER
+    if (_direct) {
+	_direct(_e, _port, p);
+	return;
+    }
+# endif
 # if HAVE_BOUND_PORT_TRANSFER
     _bound.push(_e, _port, p);
 # else
@@ -662,7 +924,17 @@ Element::Port::pull() const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
-# if HAVE_BOUND_PORT_TRANSFER
+# if HAVE_ELEMENT_PROFILE
+    Packet *p;
+    if (unlikely(the_port_hooks))
+	p = hooked_pull();
+    else
+#  if HAVE_BOUND_PORT_TRANSFER
+	p = _bound.pull(_e, _port);
+#  else
+	p = _e->pull(_port);
+#  endif
+# elif HAVE_BOUND_PORT_TRANSFER
     Packet *p = _bound.pull(_e, _port);
 # else
     Packet *p = _e->pull(_port);
@@ -675,6 +947,89 @@ Element::Port::pull() const
     return p;
 }
 
+/** @brief Push the packets in @a batch over this port.
+ *
+ * Passes @a batch to the next element's @link Element::push_batch()
+ * push_batch() @endlink function, which accounts for every packet in it.
+ * On return @a batch is empty.  Does nothing if @a batch is empty.
+ *
+ * This port must be an active() push output port.  Statistics are maintained
+ * as if each packet in @a batch had been pushed individually, except that a
+ * batch counts as a single call for CLICK_STATS >= 2 cycle accounting.
+ *
+ * @sa push(), Element::push_batch()
+ */
+inline void
+Element::Port::push_batch(PacketBatch &batch) const
+{
+    assert(_e);
+    if (batch.empty())
+	return;
+#if CLICK_STATS >= 1
+    _packets += batch.count();
+#endif
+#if CLICK_STATS >= 2
+    _e->input(_port)._packets += batch.count();
+    click_cycles_t start_cycles = click_get_cycles(),
+	start_child_cycles = _e->_child_cycles;
+    _e->push_batch(_port, batch);
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+	own_delta = all_delta - (_e->_child_cycles - start_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+# if HAVE_ELEMENT_PROFILE
+    if (unlikely(the_port_hooks))
+	hooked_push_batch(batch);
+    else
+# endif
+	_e->push_batch(_port, batch);
+#endif
+    assert(batch.empty());
+}
+
+/** @brief Pull up to @a max packets over this port, appending them to
+ * @a batch.
+ *
+ * Calls the previous element's @link Element::pull_batch() pull_batch()
+ * @endlink function.  Packets already in @a batch are left in place; new
+ * packets are added at its end.  Fewer than @a max packets, possibly none,
+ * may be added.
+ *
+ * This port must be an active() pull input port.
+ *
+ * @sa pull(), Element::pull_batch()
+ */
+inline void
+Element::Port::pull_batch(PacketBatch &batch, int max) const
+{
+    assert(_e);
+    int old_count = batch.count();
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles(),
+	old_child_cycles = _e->_child_cycles;
+    _e->pull_batch(_port, batch, max);
+    _e->output(_port)._packets += batch.count() - old_count;
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+	own_delta = all_delta - (_e->_child_cycles - old_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+# if HAVE_ELEMENT_PROFILE
+    if (unlikely(the_port_hooks))
+	hooked_pull_batch(batch, max);
+    else
+# endif
+	_e->pull_batch(_port, batch, max);
+#endif
+#if CLICK_STATS >= 1
+    _packets += batch.count() - old_count;
+#endif
+    (void) old_count;
+}
+
 /** @brief Push packet @a p to output @a port, or kill it if @a port is out of
  * range.
  *
@@ -696,6 +1051,32 @@ Element::checked_output_push(int port, Packet* p) const
 	p->kill();
 }
 
+#if HAVE_DIRECT_PORT_TRANSFER
+/** @brief Push @a p to input @a port of @a e, an element of class T.
+ *
+ * The call to T::push() is not virtual, so the compiler can expand it in
+ * place.  Pass direct_push<T> to add_direct_push() in a class's
+ * static_initialize() to speed up ports that push into T.  T must be the
+ * class that defines push() for every element with T's class_name(). */
+template <typename T> void
+Element::direct_push(Element *e, int port, Packet *p)
+{
+    static_cast<T *>(e)->T::push(port, p);
+}
+
+/** @brief Push @a p to input @a port of @a e, an element of class T
+ * that inherits Element::push().
+ *
+ * Runs T::simple_action() without a virtual call and pushes the result to
+ * output @a port, as Element::push() would. */
+template <typename T> void
+Element::direct_simple_action(Element *e, int port, Packet *p)
+{
+    if ((p = static_cast<T *>(e)->T::simple_action(p)))
+	e->_ports[1][port].push(p);
+}
+#endif
+
 #undef PORT_ASSIGN
 CLICK_ENDDECLS
 #endif
@@ -0,0 +1,783 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_FLATHASHTABLE_HH
+#define CLICK_FLATHASHTABLE_HH
+#include <click/glue.hh>
+#include <click/pair.hh>
+#include <click/hashcode.hh>
+#include <click/integers.hh>
+#include <click/algorithm.hh>
+#if CLICK_USERLEVEL && defined(__SSE2__)
+# define CLICK_FLATHASHTABLE_SSE2 1
+# include <emmintrin.h>
+#endif
+CLICK_DECLS
+template <typename K, typename V> class FlatHashTable;
+template <typename K, typename V> class FlatHashTable_const_iterator;
+template <typename K, typename V> class FlatHashTable_iterator;
+
+/** @file <click/flathashtable.hh>
+ * @brief An open-addressing hash table with HashTable's interface.
+ */
+
+/** @class FlatHashGroup
+ * @brief A group of FlatHashTable control bytes, examined at once.
+ *
+ * Each control byte is ctrl_empty, ctrl_deleted, or, for a full slot, seven
+ * bits of the slot's hash.  A group loads 16 consecutive control bytes and
+ * returns bitmasks of the bytes matching a condition; bit i corresponds to
+ * byte i.  With SSE2, each match takes a couple of instructions. */
+class FlatHashGroup { public:
+
+    enum { width = 16 };
+    enum { ctrl_empty = -128, ctrl_deleted = -2 };
+
+    explicit FlatHashGroup(const int8_t *ctrl) {
+#if CLICK_FLATHASHTABLE_SSE2
+	_v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+#else
+	memcpy(_v, ctrl, width);
+#endif
+    }
+
+    /** @brief Return the bytes equal to @a h2. */
+    unsigned match(int8_t h2) const {
+#if CLICK_FLATHASHTABLE_SSE2
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), _v));
+#else
+	unsigned m = 0;
+	for (int i = 0; i < width; ++i)
+	    m |= (unsigned) (_v[i] == h2) << i;
+	return m;
+#endif
+    }
+
+    /** @brief Return the empty bytes. */
+    unsigned match_empty() const {
+	return match(ctrl_empty);
+    }
+
+    /** @brief Return the empty or deleted bytes. */
+    unsigned match_empty_or_deleted() const {
+#if CLICK_FLATHASHTABLE_SSE2
+	return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), _v));
+#else
+	unsigned m = 0;
+	for (int i = 0; i < width; ++i)
+	    m |= (unsigned) (_v[i] < -1) << i;
+	return m;
+#endif
+    }
+
+    /** @brief Return the index of the lowest set bit in nonzero @a m. */
+    static int first(unsigned m) {
+	return ffs_lsb(m) - 1;
+    }
+
+    /** @brief Return the number of clear bits above the highest set bit in
+     * nonzero group mask @a m. */
+    static int last_gap(unsigned m) {
+	return ffs_msb(m) - 1 - (int) (8 * sizeof(unsigned) - width);
+    }
+
+  private:
+
+#if CLICK_FLATHASHTABLE_SSE2
+    __m128i _v;
+#else
+    int8_t _v[width];
+#endif
+
+};
+
+
+/** @class FlatHashTable
+ * @brief Open-addressing hash table template.
+ *
+ * FlatHashTable<K, V> maps keys of type K to values of type V, offering the
+ * same interface as HashTable<K, V>: find(), get(), set(), operator[](),
+ * find_insert(), erase(), and iterators with key() and value().  Code can
+ * usually switch from one to the other by changing the table's type.
+ *
+ * Instead of chaining separately allocated elements, FlatHashTable stores
+ * elements directly in one array, with a parallel array of one-byte control
+ * entries.  A control byte records whether its slot is empty, deleted, or
+ * full; a full slot's byte holds seven bits of its key's hash.  A lookup
+ * compares a group of 16 control bytes against the hash at once, using SSE2
+ * when it is available, and examines only the slots whose bytes match, so
+ * most lookups touch one control group and one slot.  The table grows when
+ * it is 7/8 full.
+ *
+ * Unlike HashTable, FlatHashTable moves elements when it grows, so
+ * insertions invalidate pointers and references to elements as well as
+ * iterators.  Erasing an element invalidates only its own iterator.  Keys
+ * must be equality comparable and have a hashcode(); K and V must be copy
+ * constructible.
+ *
+ * @sa HashTable */
+template <typename K, typename V>
+class FlatHashTable { public:
+
+    /** @brief Key type. */
+    typedef K key_type;
+
+    /** @brief Const reference to key type. */
+    typedef const K &key_const_reference;
+
+    /** @brief Value type. */
+    typedef V mapped_type;
+
+    /** @brief Pair of key type and value type. */
+    typedef Pair<const K, V> value_type;
+
+    /** @brief Type of sizes. */
+    typedef size_t size_type;
+
+    typedef FlatHashTable_const_iterator<K, V> const_iterator;
+    typedef FlatHashTable_iterator<K, V> iterator;
+
+
+    /** @brief Construct an empty hash table with normal default value. */
+    FlatHashTable()
+	: _ctrl(0), _slots(0), _mask(0), _size(0), _growth_left(0),
+	  _default_value() {
+    }
+
+    /** @brief Construct an empty hash table with default value @a d. */
+    explicit FlatHashTable(const mapped_type &d)
+	: _ctrl(0), _slots(0), _mask(0), _size(0), _growth_left(0),
+	  _default_value(d) {
+    }
+
+    /** @brief Construct an empty hash table with room for @a n elements.
+     * @param d default value
+     * @param n number of elements to hold without growing */
+    FlatHashTable(const mapped_type &d, size_type n)
+	: _ctrl(0), _slots(0), _mask(0), _size(0), _growth_left(0),
+	  _default_value(d) {
+	rehash(n);
+    }
+
+    /** @brief Construct a hash table as a copy of @a x. */
+    FlatHashTable(const FlatHashTable<K, V> &x)
+	: _ctrl(0), _slots(0), _mask(0), _size(0), _growth_left(0),
+	  _default_value(x._default_value) {
+	copy_elements(x);
+    }
+
+    /** @brief Destroy this hash table, freeing its memory. */
+    ~FlatHashTable() {
+	clear_elements();
+	deallocate();
+    }
+
+
+    /** @brief Return the number of elements in the hash table. */
+    size_type size() const {
+	return _size;
+    }
+
+    /** @brief Return true iff size() == 0. */
+    bool empty() const {
+	return _size == 0;
+    }
+
+    /** @brief Return the number of slots in the hash table. */
+    size_type bucket_count() const {
+	return _ctrl ? _mask + 1 : 0;
+    }
+
+    /** @brief Return the hash table's default value.
+     *
+     * The default value is returned by operator[]() when a key does not
+     * exist. */
+    const mapped_type &default_value() const {
+	return _default_value;
+    }
+
+
+    /** @brief Return an iterator for the first element in the table.
+     *
+     * @note FlatHashTable iterators return elements in undefined order. */
+    inline iterator begin();
+    /** @overload */
+    inline const_iterator begin() const;
+
+    /** @brief Return an iterator for the end of the table.
+     * @invariant end().live() == false */
+    inline iterator end();
+    /** @overload */
+    inline const_iterator end() const;
+
+
+    /** @brief Return an iterator for the element with key @a key, if any.
+     *
+     * Returns end() if no such element exists. */
+    inline iterator find(key_const_reference key);
+    /** @overload */
+    inline const_iterator find(key_const_reference key) const;
+
+    /** @brief Return an iterator for the element with key @a key, if any.
+     *
+     * Equivalent to find(); provided for compatibility with HashTable. */
+    inline iterator find_prefer(key_const_reference key) {
+	return find(key);
+    }
+
+
+    /** @brief Return the value for @a key.
+     *
+     * If no element for @a key currently exists (find(@a key) == end()),
+     * returns default_value(). */
+    const mapped_type &get(key_const_reference key) const {
+	size_type i = find_index(key);
+	return i != npos ? _slots[i].second : _default_value;
+    }
+
+    /** @brief Return a pointer to the value for @a key.
+     *
+     * If no element for @a key currently exists (find(@a key) == end()),
+     * returns null. */
+    mapped_type *get_pointer(key_const_reference key) {
+	size_type i = find_index(key);
+	return i != npos ? &_slots[i].second : 0;
+    }
+    /** @overload */
+    const mapped_type *get_pointer(key_const_reference key) const {
+	size_type i = find_index(key);
+	return i != npos ? &_slots[i].second : 0;
+    }
+
+    /** @brief Return the value for @a key.
+     *
+     * If no element for @a key currently exists (find(@a key) == end()),
+     * returns default_value(). */
+    const mapped_type &operator[](key_const_reference key) const {
+	return get(key);
+    }
+
+    /** @brief Return a reference to the value for @a key.
+     *
+     * If no element for @a key currently exists, adds a new element with
+     * default_value() and returns a reference to that value.
+     *
+     * @note Inserting an element into a FlatHashTable invalidates all
+     * existing iterators, pointers, and references. */
+    mapped_type &operator[](key_const_reference key) {
+	return _slots[insert_index(key, _default_value)].second;
+    }
+
+
+    /** @brief Ensure an element with key @a key and return its iterator.
+     *
+     * If no element for @a key exists, adds one with value
+     * default_value(). */
+    inline iterator find_insert(key_const_reference key);
+
+    /** @brief Ensure an element for key @a key and return its iterator.
+     *
+     * If no element for @a key exists, adds one with value @a value. */
+    inline iterator find_insert(key_const_reference key, const mapped_type &value);
+
+
+    /** @brief Set the mapping for @a key to @a value.
+     *
+     * Returns true if a new element was added, false if an existing
+     * element's value was assigned. */
+    bool set(key_const_reference key, const mapped_type &value) {
+	size_type old_size = _size;
+	size_type i = insert_index(key, value);
+	if (_size == old_size) {
+	    _slots[i].second = value;
+	    return false;
+	} else
+	    return true;
+    }
+
+
+    /** @brief Remove the element indicated by @a it.
+     * @return A valid iterator pointing at the next element remaining, or
+     * end() if no such element exists. */
+    inline iterator erase(const iterator &it);
+
+    /** @brief Remove any element with @a key.
+     *
+     * Returns the number of elements removed, which is always 0 or 1. */
+    size_type erase(key_const_reference key) {
+	size_type i = find_index(key);
+	if (i == npos)
+	    return 0;
+	erase_index(i);
+	return 1;
+    }
+
+    /** @brief Remove all elements.
+     * @post size() == 0 */
+    void clear() {
+	clear_elements();
+	if (_ctrl) {
+	    memset(_ctrl, FlatHashGroup::ctrl_empty, _mask + 1 + FlatHashGroup::width);
+	    _growth_left = max_load(_mask + 1);
+	}
+    }
+
+
+    /** @brief Swap the contents of this hash table and @a x. */
+    void swap(FlatHashTable<K, V> &x);
+
+    /** @brief Ensure room for at least @a n elements without growing.
+     *
+     * All existing iterators are invalidated.  The table never shrinks
+     * below its size. */
+    void rehash(size_type n) {
+	if (n < _size)
+	    n = _size;
+	size_type cap = FlatHashGroup::width;
+	while (max_load(cap) < n)
+	    cap *= 2;
+	if (cap != bucket_count())
+	    resize(cap);
+    }
+
+
+    /** @brief Assign this hash table's contents to a copy of @a x. */
+    FlatHashTable<K, V> &operator=(const FlatHashTable<K, V> &x) {
+	if (&x != this) {
+	    clear_elements();
+	    deallocate();
+	    _default_value = x._default_value;
+	    copy_elements(x);
+	}
+	return *this;
+    }
+
+  private:
+
+    static const size_type npos = (size_type) -1;
+
+    int8_t *_ctrl;		// _mask + 1 + width bytes; the last width
+				// bytes mirror the first, so any group
+				// load stays in bounds
+    value_type *_slots;
+    size_type _mask;
+    size_type _size;
+    size_type _growth_left;	// empty slots to fill before growing
+    V _default_value;
+
+    static size_type max_load(size_type cap) {
+	return cap - cap / 8;
+    }
+
+    static inline uint64_t hash(key_const_reference key) {
+	uint64_t h = (uint64_t) hashcode(key) * 0x9E3779B97F4A7C15ULL;
+	return h ^ (h >> 32);
+    }
+    static int8_t h2(uint64_t h) {
+	return h & 0x7F;
+    }
+
+    void set_ctrl(size_type i, int8_t c) {
+	_ctrl[i] = c;
+	if (i < (size_type) FlatHashGroup::width)
+	    _ctrl[_mask + 1 + i] = c;
+    }
+
+    inline size_type find_index(key_const_reference key) const;
+    inline size_type find_free(uint64_t h) const;
+    inline size_type insert_index(key_const_reference key, const mapped_type &value);
+    void erase_index(size_type i);
+    void resize(size_type cap);
+    void clear_elements();
+    void deallocate();
+    void copy_elements(const FlatHashTable<K, V> &x);
+
+    friend class FlatHashTable_const_iterator<K, V>;
+    friend class FlatHashTable_iterator<K, V>;
+
+};
+
+
+/** @class FlatHashTable_const_iterator
+ * @brief The const_iterator type for FlatHashTable. */
+template <typename K, typename V>
+class FlatHashTable_const_iterator { public:
+
+    typedef Pair<const K, V> value_type;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashTable_const_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    const value_type *get() const {
+	return live() ? &_t->_slots[_i] : 0;
+    }
+    /** @brief Return a pointer to the element. */
+    const value_type *operator->() const {
+	return &_t->_slots[_i];
+    }
+    /** @brief Return a reference to the element. */
+    const value_type &operator*() const {
+	return _t->_slots[_i];
+    }
+    /** @brief Return the element's key. */
+    const K &key() const {
+	return _t->_slots[_i].first;
+    }
+    /** @brief Return the element's value. */
+    const V &value() const {
+	return _t->_slots[_i].second;
+    }
+
+    /** @brief Return true iff *this != end(). */
+    bool live() const {
+	return _i < _t->bucket_count();
+    }
+
+    typedef bool (FlatHashTable_const_iterator::*unspecified_bool_type)() const;
+    /** @brief Return true iff *this != end(). */
+    operator unspecified_bool_type() const {
+	return live() ? &FlatHashTable_const_iterator::live : 0;
+    }
+
+    /** @brief Advance this iterator to the next element. */
+    void operator++() {
+	size_t n = _t->bucket_count();
+	for (++_i; _i < n && _t->_ctrl[_i] < 0; ++_i)
+	    /* nada */;
+    }
+    /** @brief Advance this iterator to the next element. */
+    void operator++(int) {
+	++*this;
+    }
+
+    /** @brief Return true iff @a x and this iterator point at the same
+     * element. */
+    bool operator==(const FlatHashTable_const_iterator<K, V> &x) const {
+	return _i == x._i && _t == x._t;
+    }
+    /** @brief Return true iff @a x and this iterator point at different
+     * elements. */
+    bool operator!=(const FlatHashTable_const_iterator<K, V> &x) const {
+	return !(*this == x);
+    }
+
+  protected:
+
+    const FlatHashTable<K, V> *_t;
+    size_t _i;
+
+    FlatHashTable_const_iterator(const FlatHashTable<K, V> *t, size_t i)
+	: _t(t), _i(i) {
+    }
+
+    friend class FlatHashTable<K, V>;
+
+};
+
+/** @class FlatHashTable_iterator
+ * @brief The iterator type for FlatHashTable. */
+template <typename K, typename V>
+class FlatHashTable_iterator : public FlatHashTable_const_iterator<K, V> { public:
+
+    typedef FlatHashTable_const_iterator<K, V> inherited;
+    typedef Pair<const K, V> value_type;
+
+    /** @brief Construct an uninitialized iterator. */
+    FlatHashTable_iterator() {
+    }
+
+    /** @brief Return a pointer to the element, null if *this == end(). */
+    value_type *get() const {
+	return const_cast<value_type *>(inherited::get());
+    }
+    /** @brief Return a pointer to the element. */
+    value_type *operator->() const {
+	return const_cast<value_type *>(inherited::operator->());
+    }
+    /** @brief Return a reference to the element. */
+    value_type &operator*() const {
+	return const_cast<value_type &>(inherited::operator*());
+    }
+    /** @brief Return a mutable reference to the element's value. */
+    V &value() const {
+	return const_cast<V &>(inherited::value());
+    }
+
+  private:
+
+    FlatHashTable_iterator(FlatHashTable<K, V> *t, size_t i)
+	: inherited(t, i) {
+    }
+
+    friend class FlatHashTable<K, V>;
+
+};
+
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::size_type
+FlatHashTable<K, V>::find_index(key_const_reference key) const
+{
+    if (!_ctrl)
+	return npos;
+    uint64_t h = hash(key);
+    int8_t tag = h2(h);
+    size_type pos = (h >> 7) & _mask;
+    for (size_type step = FlatHashGroup::width; true; step += FlatHashGroup::width) {
+	FlatHashGroup g(_ctrl + pos);
+	for (unsigned m = g.match(tag); m; m &= m - 1) {
+	    size_type i = (pos + FlatHashGroup::first(m)) & _mask;
+	    if (_slots[i].first == key)
+		return i;
+	}
+	if (g.match_empty())
+	    return npos;
+	// Triangular probing visits every group of a power-of-two table.
+	pos = (pos + step) & _mask;
+    }
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::size_type
+FlatHashTable<K, V>::find_free(uint64_t h) const
+{
+    size_type pos = (h >> 7) & _mask;
+    for (size_type step = FlatHashGroup::width; true; step += FlatHashGroup::width) {
+	FlatHashGroup g(_ctrl + pos);
+	if (unsigned m = g.match_empty_or_deleted())
+	    return (pos + FlatHashGroup::first(m)) & _mask;
+	pos = (pos + step) & _mask;
+    }
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::size_type
+FlatHashTable<K, V>::insert_index(key_const_reference key, const mapped_type &value)
+{
+    size_type i = find_index(key);
+    if (i != npos)
+	return i;
+    uint64_t h = hash(key);
+    if (!_ctrl)
+	resize(FlatHashGroup::width);
+    i = find_free(h);
+    if (_growth_left == 0 && _ctrl[i] == FlatHashGroup::ctrl_empty) {
+	// Grow if the table is mostly live; otherwise just drop tombstones.
+	size_type cap = _mask + 1;
+	resize(_size > max_load(cap) / 2 ? cap * 2 : cap);
+	i = find_free(h);
+    }
+    if (_ctrl[i] == FlatHashGroup::ctrl_empty)
+	--_growth_left;
+    set_ctrl(i, h2(h));
+    new((void *) &_slots[i]) value_type(key, value);
+    ++_size;
+    return i;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::erase_index(size_type i)
+{
+    _slots[i].~value_type();
+    --_size;
+    // A slot can become empty again, rather than deleted, if no probe
+    // sequence could have passed over it: that is, if every group window
+    // containing it also contains an empty slot.
+    size_type before = (i - FlatHashGroup::width) & _mask;
+    unsigned empty_after = FlatHashGroup(_ctrl + i).match_empty();
+    unsigned empty_before = FlatHashGroup(_ctrl + before).match_empty();
+    if (empty_after && empty_before
+	&& FlatHashGroup::first(empty_after) + FlatHashGroup::last_gap(empty_before) < FlatHashGroup::width) {
+	set_ctrl(i, FlatHashGroup::ctrl_empty);
+	++_growth_left;
+    } else
+	set_ctrl(i, FlatHashGroup::ctrl_deleted);
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::resize(size_type cap)
+{
+    int8_t *old_ctrl = _ctrl;
+    value_type *old_slots = _slots;
+    size_type old_cap = bucket_count();
+
+    _ctrl = (int8_t *) CLICK_LALLOC(cap + FlatHashGroup::width);
+    _slots = (value_type *) CLICK_LALLOC(sizeof(value_type) * cap);
+    if (!_ctrl || !_slots) {
+	if (_ctrl)
+	    CLICK_LFREE(_ctrl, cap + FlatHashGroup::width);
+	if (_slots)
+	    CLICK_LFREE(_slots, sizeof(value_type) * cap);
+	_ctrl = old_ctrl;
+	_slots = old_slots;
+	return;
+    }
+    memset(_ctrl, FlatHashGroup::ctrl_empty, cap + FlatHashGroup::width);
+    _mask = cap - 1;
+    _growth_left = max_load(cap) - _size;
+
+    for (size_type i = 0; i < old_cap; ++i)
+	if (old_ctrl[i] >= 0) {
+	    uint64_t h = hash(old_slots[i].first);
+	    size_type j = find_free(h);
+	    set_ctrl(j, h2(h));
+	    new((void *) &_slots[j]) value_type(old_slots[i]);
+	    old_slots[i].~value_type();
+	}
+    if (old_ctrl) {
+	CLICK_LFREE(old_ctrl, old_cap + FlatHashGroup::width);
+	CLICK_LFREE(old_slots, sizeof(value_type) * old_cap);
+    }
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::clear_elements()
+{
+    for (size_type i = 0; _size && i < bucket_count(); ++i)
+	if (_ctrl[i] >= 0) {
+	    _slots[i].~value_type();
+	    --_size;
+	}
+    _size = 0;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::deallocate()
+{
+    if (_ctrl) {
+	CLICK_LFREE(_ctrl, _mask + 1 + FlatHashGroup::width);
+	CLICK_LFREE(_slots, sizeof(value_type) * (_mask + 1));
+    }
+    _ctrl = 0;
+    _slots = 0;
+    _mask = _growth_left = 0;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::copy_elements(const FlatHashTable<K, V> &x)
+{
+    // Copy the control bytes as they are, so the copy keeps the same
+    // layout and needs no rehashing.
+    if (!x._ctrl)
+	return;
+    size_type cap = x._mask + 1;
+    _ctrl = (int8_t *) CLICK_LALLOC(cap + FlatHashGroup::width);
+    _slots = (value_type *) CLICK_LALLOC(sizeof(value_type) * cap);
+    if (!_ctrl || !_slots) {
+	if (_ctrl)
+	    CLICK_LFREE(_ctrl, cap + FlatHashGroup::width);
+	if (_slots)
+	    CLICK_LFREE(_slots, sizeof(value_type) * cap);
+	_ctrl = 0;
+	_slots = 0;
+	return;
+    }
+    memcpy(_ctrl, x._ctrl, cap + FlatHashGroup::width);
+    for (size_type i = 0; i < cap; ++i)
+	if (_ctrl[i] >= 0)
+	    new((void *) &_slots[i]) value_type(x._slots[i]);
+    _mask = x._mask;
+    _size = x._size;
+    _growth_left = x._growth_left;
+}
+
+template <typename K, typename V>
+void
+FlatHashTable<K, V>::swap(FlatHashTable<K, V> &x)
+{
+    click_swap(_ctrl, x._ctrl);
+    click_swap(_slots, x._slots);
+    click_swap(_mask, x._mask);
+    click_swap(_size, x._size);
+    click_swap(_growth_left, x._growth_left);
+    click_swap(_default_value, x._default_value);
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::begin()
+{
+    iterator it(this, (size_type) -1);
+    ++it;
+    return it;
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::const_iterator
+FlatHashTable<K, V>::begin() const
+{
+    const_iterator it(this, (size_type) -1);
+    ++it;
+    return it;
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::end()
+{
+    return iterator(this, bucket_count());
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::const_iterator
+FlatHashTable<K, V>::end() const
+{
+    return const_iterator(this, bucket_count());
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::find(key_const_reference key)
+{
+    size_type i = find_index(key);
+    return iterator(this, i != npos ? i : bucket_count());
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::const_iterator
+FlatHashTable<K, V>::find(key_const_reference key) const
+{
+    size_type i = find_index(key);
+    return const_iterator(this, i != npos ? i : bucket_count());
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::find_insert(key_const_reference key)
+{
+    return iterator(this, insert_index(key, _default_value));
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::find_insert(key_const_reference key, const mapped_type &value)
+{
+    return iterator(this, insert_index(key, value));
+}
+
+template <typename K, typename V>
+inline typename FlatHashTable<K, V>::iterator
+FlatHashTable<K, V>::erase(const iterator &it)
+{
+    iterator next(it);
+    if (it.live()) {
+	erase_index(it._i);
+	++next;
+    }
+    return next;
+}
+
+template <typename K, typename V>
+inline void
+click_swap(FlatHashTable<K, V> &a, FlatHashTable<K, V> &b)
+{
+    a.swap(b);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -3,6 +3,7 @@
 #define CLICK_FROMFILE_HH
 #include <click/string.hh>
 #include <click/vector.hh>
+#include <click/timestamp.hh>
 #include <stdio.h>
 CLICK_DECLS
 class ErrorHandler;
@@ -27,6 +28,7 @@ class FromFile { public:
     void set_lineno(int lineno)		{ _lineno = lineno; }
 
     off_t file_pos() const		{ return _file_offset + _pos; }
+    inline bool prefetching() const;
 
     int configure_keywords(Vector<String> &conf, Element *, ErrorHandler *);
     int initialize(ErrorHandler *, bool allow_nonexistent = false);
@@ -43,6 +45,7 @@ class FromFile { public:
     Packet *get_packet(size_t, uint32_t sec, uint32_t subsec, ErrorHandler *);
     Packet *get_packet_from_data(const void *buf, size_t buf_size, size_t full_size, uint32_t sec, uint32_t subsec, ErrorHandler *);
     void shift_pos(int delta)		{ _pos += delta; }
+    inline const uint8_t *peek(size_t size) const;
 
     int read_line(String &str, ErrorHandler *errh, bool temporary = false);
     int peek_line(String &str, ErrorHandler *errh, bool temporary = false);
@@ -53,6 +56,10 @@ class FromFile { public:
   private:
 
     enum { BUFFER_SIZE = 32768 };
+#if HAVE_USER_MULTITHREAD
+    enum { PREFETCH_UNIT = 262144 };
+    class Prefetcher;
+#endif
 
     int _fd;
     const uint8_t *_buffer;
@@ -71,6 +78,11 @@ class FromFile { public:
     off_t _mmap_off;
 #endif
 
+#if HAVE_USER_MULTITHREAD
+    int _prefetch;
+    Prefetcher *_prefetcher;
+#endif
+
     String _filename;
     FILE *_pipe;
     off_t _file_offset;
@@ -80,6 +92,12 @@ class FromFile { public:
 #ifdef ALLOW_MMAP
     int read_buffer_mmap(ErrorHandler *);
 #endif
+#if HAVE_USER_MULTITHREAD
+    int start_prefetch(bool detect, ErrorHandler *);
+    void stop_prefetch();
+    int read_buffer_prefetch(ErrorHandler *);
+#endif
+    bool inflating() const;
     int read_buffer(ErrorHandler *);
     bool read_packet(ErrorHandler *);
     int skip_ahead(ErrorHandler *);
@@ -91,5 +109,98 @@ class FromFile { public:
 
 };
 
+/** @class TraceIndex
+ * @brief A sidecar index from timestamps to positions in a trace file.
+ *
+ * A trace reader builds a TraceIndex by calling note() for every record it
+ * reads, in order, starting at the first record; if it reaches the end of
+ * the file, it calls save() to write the index next to the trace.  Later
+ * readers load() the index and seek() directly to a start time instead of
+ * decoding every earlier record.
+ *
+ * The index holds one entry about every @a stride bytes.  Each entry
+ * records a record's file position and the latest timestamp of any record
+ * before it, so seek() is correct even if the trace's timestamps are not
+ * sorted.  An index remembers the trace file's size and modification time,
+ * and load() ignores an index that does not match. */
+class TraceIndex { public:
+
+    enum { default_stride = 1048576 };
+
+    TraceIndex()			{ clear(); }
+
+    bool building() const		{ return _building; }
+    bool loaded() const			{ return _loaded; }
+    int size() const			{ return _entries.size(); }
+    const Timestamp &first_timestamp() const { return _first; }
+
+    void clear();
+    void start(uint32_t stride = default_stride);
+    void stop()				{ _building = false; }
+    inline void note(off_t pos, const Timestamp &ts);
+
+    int load(const String &filename, const String &trace_filename,
+	     ErrorHandler *errh);
+    int save(const String &filename, const String &trace_filename,
+	     ErrorHandler *errh);
+
+    off_t seek(const Timestamp &start) const;
+
+  private:
+
+    struct Entry {
+	off_t pos;
+	Timestamp before;
+    };
+
+    Vector<Entry> _entries;
+    Timestamp _first;
+    Timestamp _max;
+    off_t _next_pos;
+    uint32_t _stride;
+    bool _building;
+    bool _loaded;
+    bool _any;
+
+};
+
+inline void
+TraceIndex::note(off_t pos, const Timestamp &ts)
+{
+    if (!_building)
+	return;
+    if (!_any) {
+	_first = _max = ts;
+	_any = true;
+    }
+    if (pos >= _next_pos) {
+	Entry e;
+	e.pos = pos;
+	e.before = _max;
+	_entries.push_back(e);
+	_next_pos = pos + _stride;
+    }
+    if (ts > _max)
+	_max = ts;
+}
+
+/** @brief Return the next @a size bytes without consuming them, or null if
+ * they are not all in the current buffer. */
+inline const uint8_t *
+FromFile::peek(size_t size) const
+{
+    return _pos + size <= _len ? _buffer + _pos : 0;
+}
+
+inline bool
+FromFile::prefetching() const
+{
+#if HAVE_USER_MULTITHREAD
+    return _prefetcher;
+#else
+    return false;
+#endif
+}
+
 CLICK_ENDDECLS
 #endif
@@ -151,7 +151,7 @@ GapRate::set_rate(unsigned r)
     if (_rate != r) {
 	initialize_rate(r);
 	if (_tv_sec >= 0 && r != 0) {
-	    Timestamp now = Timestamp::now();
+	    Timestamp now = Timestamp::now_fast();
 	    _sec_count = (now.usec() << UGAP_SHIFT) / _ugap;
 	}
     }
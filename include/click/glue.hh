@@ -115,7 +115,8 @@ CLICK_DECLS
 
 /** @brief Return a number between 0 and CLICK_RAND_MAX, inclusive.
  *
- * CLICK_RAND_MAX is guaranteed to be at least 2^31 - 1. */
+ * CLICK_RAND_MAX is 2^31 - 1.  Each thread draws from its own generator, so
+ * threads never share generator state. */
 uint32_t click_random();
 
 /** @brief Return a number between @a low and @a high, inclusive.
@@ -123,45 +124,77 @@ uint32_t click_random();
  * Returns @a low if @a low >= @a high. */
 uint32_t click_random(uint32_t low, uint32_t high);
 
-/** @brief Set the click_random() seed to @a seed. */
+/** @brief Store @a n numbers between 0 and CLICK_RAND_MAX in @a x.
+ *
+ * Equivalent to calling click_random() @a n times, but finds the thread's
+ * generator only once; suits per-packet draws for a batch. */
+void click_random_fill(uint32_t *x, int n);
+
+/** @brief Set the click_random() seed to @a seed.
+ *
+ * Every thread's generator is reseeded from @a seed and its thread number
+ * when it next draws, so a given seed yields the same sequence on each
+ * thread from run to run. */
 void click_srandom(uint32_t seed);
 
 /** @brief Set the click_random() seed using a source of true randomness,
  * if available. */
 void click_random_srandom();
 
-#if CLICK_BSDMODULE
-# define CLICK_RAND_MAX 0x7FFFFFFFU
-#elif !CLICK_LINUXMODULE && RAND_MAX >= 0x7FFFFFFFU
-# define CLICK_RAND_MAX RAND_MAX
-#else
-# define CLICK_RAND_MAX 0x7FFFFFFFU
+#define CLICK_RAND_MAX 0x7FFFFFFFU
+
+/** @brief State of one thread's click_random() generator, xoshiro128**.
+ *
+ * The state is reseeded whenever its generation differs from
+ * click_random_generation, which click_srandom() advances. */
+struct click_random_state {
+    uint32_t s[4];
+    uint32_t generation;
+};
+
 extern uint32_t click_random_seed;
-#endif
+extern volatile uint32_t click_random_generation;
+void click_random_reseed(click_random_state *st);
 
-inline uint32_t click_random() {
-#if CLICK_BSDMODULE
-    return random();
-#elif CLICK_LINUXMODULE
-    click_random_seed = click_random_seed * 69069L + 5;
-    return (click_random_seed ^ jiffies) & CLICK_RAND_MAX; // XXX jiffies??
-#elif HAVE_RANDOM && CLICK_RAND_MAX == RAND_MAX
-    return random();
+#if CLICK_LINUXMODULE
+extern click_random_state click_random_states[NR_CPUS];
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+extern __thread click_random_state click_random_thread_state;
 #else
-    return rand();
+extern click_random_state click_random_global_state;
 #endif
-}
 
-inline void click_srandom(uint32_t seed) {
-#if CLICK_BSDMODULE
-    srandom(seed);
-#elif !CLICK_LINUXMODULE && HAVE_RANDOM && CLICK_RAND_MAX == RAND_MAX
-    srandom(seed);
-#elif !CLICK_LINUXMODULE && CLICK_RAND_MAX == RAND_MAX
-    srand(seed);
+/** @brief Return the current thread's click_random() generator. */
+inline click_random_state *click_random_current() {
+#if CLICK_LINUXMODULE
+    click_random_state *st = &click_random_states[smp_processor_id()];
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    click_random_state *st = &click_random_thread_state;
 #else
-    click_random_seed = seed;
+    click_random_state *st = &click_random_global_state;
 #endif
+    if (unlikely(st->generation != click_random_generation))
+	click_random_reseed(st);
+    return st;
+}
+
+/** @brief Return the next 32 random bits from @a st. */
+inline uint32_t click_random_next(click_random_state *st) {
+    uint32_t *s = st->s;
+    uint32_t x = s[1] * 5;
+    uint32_t result = ((x << 7) | (x >> 25)) * 9;
+    uint32_t t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+    return result;
+}
+
+inline uint32_t click_random() {
+    return click_random_next(click_random_current()) >> 1;
 }
 
 CLICK_ENDDECLS
@@ -15,6 +15,7 @@ typedef int (*HandlerCallback)(int operation, String &data, Element *element,
 typedef String (*ReadHandlerCallback)(Element *handler, void *user_data);
 typedef int (*WriteHandlerCallback)(const String &data, Element *element,
 				    void *user_data, ErrorHandler *errh);
+typedef uint64_t (*StatCallback)(const Element *element, void *user_data);
 
 class Handler { public:
 
@@ -42,6 +43,9 @@ class Handler { public:
 	h_button = 0x2000,	///< @brief Write handler ignores data.
 	h_checkbox = 0x4000,	///< @brief Read/write handler is boolean and
 				///  should be rendered as a checkbox.
+	h_concurrent = 0x8000,	///< @brief Read handler may be called on a
+				///  non-router thread, concurrently with
+				///  packet processing and other handlers.
 	h_driver_flag_shift = 20,
 	h_driver_flag_0 = 1 << h_driver_flag_shift,
 				///< @brief First uninterpreted handler flag
@@ -144,6 +148,21 @@ class Handler { public:
 	return !(_flags & h_nonexclusive);
     }
 
+    /** @brief Check if this read handler may be called concurrently.
+     *
+     * A concurrent read handler may be called on a thread other than the
+     * router threads, while packets flow and other handlers run; the element
+     * itself is responsible for returning a consistent snapshot of its
+     * state, for instance by taking a lock that its write handlers also
+     * take.  Drivers use this to run expensive reads, such as routing table
+     * dumps, without stalling a router thread: ControlSocket calls them on a
+     * separate thread, and the linuxmodule driver calls them from the
+     * reading process without first locking the router threads.
+     * Concurrency is set by the h_concurrent flag. */
+    inline bool concurrent() const {
+	return _flags & h_concurrent;
+    }
+
     /** @brief Check if spaces should be preserved when calling this handler.
      *
      * Some Click drivers perform some convenience processing on handler
@@ -242,6 +261,7 @@ class Handler { public:
 	EXPENSIVE = h_expensive,
 	BUTTON = h_button,
 	CHECKBOX = h_checkbox,
+	CONCURRENT = h_concurrent,
 	DRIVER_FLAG_SHIFT = h_driver_flag_shift,
 	DRIVER_FLAG_0 = h_driver_flag_0,
 	USER_FLAG_SHIFT = h_user_flag_shift,
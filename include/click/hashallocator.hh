@@ -21,6 +21,20 @@ class HashAllocator { public:
 
     void swap(HashAllocator &x);
 
+    /** @brief Return the size of each object. */
+    size_t object_size() const {
+	return _size;
+    }
+    /** @brief Return the number of objects allocated and not freed. */
+    size_t nallocated() const {
+	return _nallocated;
+    }
+    /** @brief Return the number of objects carved from buffers, whether
+     * allocated or free. */
+    size_t capacity() const;
+    /** @brief Return the number of bytes held in buffers. */
+    size_t buffer_bytes() const;
+
   private:
 
     struct link {
@@ -46,6 +60,7 @@ class HashAllocator { public:
     link *_free;
     buffer *_buffer;
     size_t _size;
+    size_t _nallocated;
 
     void *hard_allocate();
 
@@ -67,6 +82,7 @@ class SizedHashAllocator : public HashAllocator { public:
 
 inline void *HashAllocator::allocate()
 {
+    ++_nallocated;
     if (link *l = _free) {
 #ifdef VALGRIND_MEMPOOL_ALLOC
 	VALGRIND_MEMPOOL_ALLOC(this, l, _size);
@@ -84,13 +100,18 @@ inline void *HashAllocator::allocate()
 	VALGRIND_MEMPOOL_ALLOC(this, data, _size);
 #endif
 	return data;
-    } else
-	return hard_allocate();
+    } else if (void *data = hard_allocate())
+	return data;
+    else {
+	--_nallocated;
+	return 0;
+    }
 }
 
 inline void HashAllocator::deallocate(void *p)
 {
     if (p) {
+	--_nallocated;
 	reinterpret_cast<link *>(p)->next = _free;
 	_free = reinterpret_cast<link *>(p);
 #ifdef VALGRIND_MEMPOOL_FREE
@@ -99,5 +99,18 @@ inline typename T::key_const_reference hashkey(const T &x) {
     return x.hashkey();
 }
 
+/** @class Hasher
+ * @brief Function object that hashes keys for HashContainer and HashTable.
+ *
+ * The general template calls hashcode().  A key type whose hash function
+ * can be chosen at run time specializes Hasher to hold that choice, so each
+ * table keyed by that type carries its own; see FlowHash. */
+template <typename K>
+class Hasher { public:
+    hashcode_t operator()(const K &key) const {
+	return hashcode(key);
+    }
+};
+
 CLICK_ENDDECLS
 #endif
@@ -2,6 +2,7 @@
 #define CLICK_HASHCONTAINER_HH
 #include <click/glue.hh>
 #include <click/hashcode.hh>
+#include <click/prefetch.hh>
 #if CLICK_DEBUG_HASHMAP
 # define click_hash_assert(x) assert(x)
 #else
@@ -28,9 +29,10 @@ class HashContainer_rep : public A {
 /** @endcond */
 
 template <typename T>
-class HashContainer_adapter { public:
+class HashContainer_adapter : public Hasher<typename T::key_type> { public:
     typedef typename T::key_type key_type;
     typedef typename T::key_const_reference key_const_reference;
+    typedef Hasher<key_type> hasher_type;
     static T *&hashnext(T *e) {
 	return e->_hashnext;
     }
@@ -40,6 +42,12 @@ class HashContainer_adapter { public:
     static bool hashkeyeq(const key_type &a, const key_type &b) {
 	return a == b;
     }
+    hasher_type &hasher() {
+	return *this;
+    }
+    const hasher_type &hasher() const {
+	return *this;
+    }
 };
 
 /** @class HashContainer
@@ -67,6 +75,9 @@ class HashContainer_adapter { public:
   This function must have return type "key_const_reference."</li>
   </ul>
 
+  Keys are hashed by a Hasher<key_type> object stored in the container,
+  which for most key types calls hashcode().  See hasher().
+
   These requirements can be changed by supplying a different A, or adapter,
   type.
 
@@ -136,6 +147,15 @@ class HashContainer { public:
     /** @brief Return the bucket number containing elements with @a key. */
     size_type bucket(const key_type &key) const;
 
+    /** @brief Return the object that hashes keys.
+     *
+     * For key types with a configurable hash function, such as IPFlowID,
+     * this selects the function used by this container.  Change it only
+     * while the container is empty. */
+    inline typename A::hasher_type &hasher() {
+	return _rep.hasher();
+    }
+
     /** @brief Return true if this HashContainer should be rebalanced. */
     inline bool unbalanced() const {
 	return _rep.size > 2 * _rep.nbuckets && _rep.nbuckets < max_bucket_count;
@@ -174,6 +194,14 @@ class HashContainer { public:
     /** @overload */
     inline const_iterator find(const key_type &key) const;
 
+    /** @brief Prefetch the bucket that find(@a key) will search.
+     *
+     * Use in the prefetch stage of a click_prefetch_pipeline().  This is a
+     * hint only, and is safe without the table's lock. */
+    inline void prefetch(const key_type &key) const {
+	click_prefetch(&_rep.buckets[bucket(key)]);
+    }
+
     /** @brief Return an iterator for an element with key @a key, if any.
      *
      * Like find(), but additionally moves any found element to the head of
@@ -458,7 +486,7 @@ template <typename T, typename A>
 inline typename HashContainer<T, A>::size_type
 HashContainer<T, A>::bucket(const key_type &key) const
 {
-    return ((size_type) hashcode(key)) % _rep.nbuckets;
+    return ((size_type) _rep.hasher()(key)) % _rep.nbuckets;
 }
 
 template <typename T, typename A>
@@ -220,6 +220,12 @@ inline void pop_heap(iterator_type begin, iterator_type end,
  * place.  The arity @a n is a template parameter, and must be greater
  * than 2.
  *
+ * The children of position @a i \> 0 are [@a i * @a n, @a i * @a n + @a n),
+ * so if the sequence starts on a cache line and @a n elements fill one,
+ * each node's children share a single line.  Arities 4 and 8 suit 16- and
+ * 8-byte elements, and cut both the tree height and the cache misses per
+ * sift-down compared with a binary heap.
+ *
  * The comparison function @a comp defines the heap order.
  *
  * The placement function @a place is called for each element that
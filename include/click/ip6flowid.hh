@@ -2,6 +2,7 @@
 #ifndef CLICK_IP6FLOWID_HH
 #define CLICK_IP6FLOWID_HH
 #include <click/ip6address.hh>
+#include <click/ipflowid.hh>
 #include <click/hashcode.hh>
 CLICK_DECLS
 class Packet;
@@ -108,5 +109,27 @@ operator==(const IP6FlowID &a, const IP6FlowID &b)
     && a.daddr() == b.daddr() && a.saddr() == b.saddr();
 }
 
+template <>
+class Hasher<IP6FlowID> : public FlowHash { public:
+  hashcode_t operator()(const IP6FlowID &f) const {
+    if (symmetric()) {
+      int cmp = memcmp(f.saddr().data(), f.daddr().data(), 16);
+      if (cmp > 0 || (cmp == 0 && f.sport() > f.dport()))
+	return hash(f.reverse());
+    }
+    return hash(f);
+  }
+ private:
+  hashcode_t hash(const IP6FlowID &f) const {
+    if (method() == m_default)
+      return f.hashcode();
+    uint32_t w[9];
+    memcpy(&w[0], f.saddr().data32(), 16);
+    memcpy(&w[4], f.daddr().data32(), 16);
+    w[8] = f.sport() | ((uint32_t) f.dport() << 16);
+    return hash_words(w, 9);
+  }
+};
+
 CLICK_ENDDECLS
 #endif
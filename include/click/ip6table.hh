@@ -9,6 +9,12 @@ CLICK_DECLS
 // IP6 routing table.
 // Lookup by longest prefix.
 // Each entry contains a gateway and an output index.
+//
+// Routes are stored in a tree bitmap (Eatherton, Varghese, and Dittia) with
+// 8-bit strides, so a lookup visits at most one node per address byte.
+// Routes whose masks are not prefixes are kept in a list that is searched
+// linearly.  The batch lookup() walks up to 16 addresses in lockstep,
+// prefetching each address's next node.
 
 class IP6Table { public:
 
@@ -16,12 +22,17 @@ class IP6Table { public:
   ~IP6Table();
 
   bool lookup(const IP6Address &dst, IP6Address &gw, int &index) const;
+  void lookup(int n, const IP6Address *dst, IP6Address *gw, int *index) const;
 
   void add(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index);
   void del(const IP6Address &dst, const IP6Address &mask);
-  void clear()				{ _v.clear(); }
+  bool find(const IP6Address &dst, const IP6Address &mask, IP6Address &gw, int &index) const;
+  void clear();
   String dump();
 
+  int size() const			{ return _nroutes; }
+  int node_count() const		{ return _nnodes; }
+
  private:
 
   struct Entry {
@@ -32,6 +43,40 @@ class IP6Table { public:
     int _valid;
   };
   Vector<Entry> _v;
+  int _vfree;
+  int _nroutes;
+
+  // A node covers 8 address bits.  Bit (1 << l) - 1 + v of _internal marks
+  // a route for the l-bit prefix v within the node, 0 <= l < 8; _routes
+  // holds their indexes into _v, in bit order.  Bit b of _external marks a
+  // child for next byte b; _children holds them in bit order.
+  struct Node {
+    uint64_t _internal[4];
+    uint64_t _external[4];
+    Node *_children;
+    int *_routes;
+  };
+  Node _root;
+  int _nnodes;
+  Vector<int> _other;		// routes with non-prefix masks
+
+  enum { lanes = 16 };
+
+  static inline bool test(const uint64_t *bits, int i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+  }
+  static inline int rank(const uint64_t *bits, int i);
+  static inline int internal_bit(int plen, const unsigned char *data, int depth);
+  static inline int match_internal(const Node *n, int b);
+  inline bool finish_lookup(const IP6Address &dst, int best, IP6Address &gw, int &index) const;
+  static bool node_empty(const Node &n);
+  static void free_node(Node &n);
+  int new_entry(const IP6Address &dst, const IP6Address &mask, const IP6Address &gw, int index);
+  void free_entry(int i);
+  int *find_slot(const IP6Address &dst, int plen) const;
+
+  IP6Table(const IP6Table &);
+  IP6Table &operator=(const IP6Table &);
 
 };
 
@@ -5,6 +5,8 @@
 #include <click/hashcode.hh>
 CLICK_DECLS
 class Packet;
+class ArgContext;
+extern const ArgContext blank_args;
 
 class IPFlowID { public:
 
@@ -180,6 +182,101 @@ inline bool operator!=(const IPFlowID &a, const IPFlowID &b)
 
 StringAccum &operator<<(StringAccum &, const IPFlowID &);
 
+
+/** @class FlowHash
+ * @brief Run-time choice of hash function for flow IDs.
+ *
+ * Hash tables keyed by IPFlowID or IP6FlowID hash their keys through
+ * Hasher<IPFlowID> or Hasher<IP6FlowID>, which are FlowHash objects, so each
+ * table can choose its function (see HashContainer::hasher()):
+ *
+ * <dl>
+ * <dt>m_default</dt>
+ * <dd>The flow ID's hashcode(), a cheap shift-xor mix.  It clusters when
+ * many flows differ only in nearby port numbers, as behind a NAT.</dd>
+ * <dt>m_crc32c</dt>
+ * <dd>CRC-32C of the flow ID, using the SSE4.2 crc32 instruction at user
+ * level when the processor has it.  Nearby ports spread well.</dd>
+ * <dt>m_seeded</dt>
+ * <dd>SipHash-1-3 keyed with a random 128-bit seed, so that remote hosts
+ * cannot choose flow IDs that collide.  The slowest of the three.</dd>
+ * </dl>
+ *
+ * Any method can also be made symmetric, so that a flow and its reverse
+ * hash to the same value. */
+class FlowHash { public:
+
+    enum Method {
+	m_default = 0, m_crc32c = 1, m_seeded = 2
+    };
+
+    FlowHash()
+	: _method(m_default), _symmetric(false) {
+	_key[0] = _key[1] = 0;
+    }
+
+    Method method() const {
+	return _method;
+    }
+    bool symmetric() const {
+	return _symmetric;
+    }
+
+    void set(Method method, bool symmetric = false);
+    String unparse() const;
+
+    /** @brief Hash @a n words with the m_crc32c or m_seeded method. */
+    inline uint32_t hash_words(const uint32_t *w, int n) const {
+	if (_method == m_crc32c)
+	    return crc32c(0xFFFFFFFFU, w, n);
+	uint64_t h = siphash13(_key, w, n);
+	return h ^ (h >> 32);
+    }
+
+    static uint32_t crc32c(uint32_t crc, const uint32_t *w, int n);
+    static uint64_t crc32c64(uint64_t crc, const unsigned char *data, int len);
+    static uint64_t siphash13(const uint64_t key[2], const uint32_t *w, int n);
+
+  private:
+
+    Method _method;
+    bool _symmetric;
+    uint64_t _key[2];
+
+};
+
+/** @class FlowHashArg
+ * @brief Parser class for FlowHash methods.
+ *
+ * Accepts "default", "crc32c", or "seeded", optionally followed by
+ * "symmetric"; or "symmetric" alone, which means "default symmetric". */
+class FlowHashArg { public:
+    static bool parse(const String &str, FlowHash &result,
+		      const ArgContext &args = blank_args);
+};
+
+template <>
+class Hasher<IPFlowID> : public FlowHash { public:
+    hashcode_t operator()(const IPFlowID &f) const {
+	if (symmetric()
+	    && (f.saddr().addr() > f.daddr().addr()
+		|| (f.saddr() == f.daddr() && f.sport() > f.dport())))
+	    return hash(f.reverse());
+	else
+	    return hash(f);
+    }
+  private:
+    hashcode_t hash(const IPFlowID &f) const {
+	if (method() == m_default)
+	    return f.hashcode();
+	uint32_t w[3] = {
+	    f.saddr().addr(), f.daddr().addr(),
+	    f.sport() | ((uint32_t) f.dport() << 16)
+	};
+	return hash_words(w, 3);
+    }
+};
+
 inline IPFlowID::operator String() const
 {
     return unparse();
@@ -51,13 +51,25 @@ class Lexer { public:
 
     class TunnelEnd;
     class Compound;
+    struct Pattern;
+    struct FlatRouter;
+    class Matcher;
     typedef Router::Port Port;
     typedef Router::Connection Connection;
 
+    class Source { public:
+	Source()			{ }
+	virtual ~Source()		{ }
+	// Read up to len bytes into buf; return the number read, or <= 0
+	// at end of input.
+	virtual int read(char *buf, int len) = 0;
+    };
+
     Lexer();
     virtual ~Lexer();
 
     int begin_parse(const String &data, const String &filename, LexerExtra *, ErrorHandler * = 0);
+    int begin_parse(Source *source, const String &filename, LexerExtra *, ErrorHandler * = 0);
     void end_parse(int);
 
     VariableEnvironment &global_scope()	{ return _global_scope; }
@@ -92,6 +104,7 @@ class Lexer { public:
     int force_element_type(String name, bool report_error = true);
 
     void element_type_names(Vector<String> &) const;
+    Element *create_element(const String &name) const;
 
     int remove_element_type(int t)	{ return remove_element_type(t, 0); }
 
@@ -112,6 +125,11 @@ class Lexer { public:
     bool ystatement(int nested = 0);
 
     Router *create_router(Master *);
+    const Vector<String> &libraries() const	{ return _libraries; }
+
+    int add_patterns(const String &text, const String &filename, ErrorHandler *errh = 0);
+    inline void set_undead(bool undead);
+    String optimizer_signature() const;
 
   private:
 
@@ -122,8 +140,22 @@ class Lexer { public:
 	String _filename;
 	String _original_filename;
 	unsigned _lineno;
+	Source *_source;
+	size_t _base;		// input offset of _big_string.begin()
+	bool _streamed;
+
+	enum { STREAM_CHUNK = 65536 };
 
 	FileState(const String &data, const String &filename);
+	size_t offset() const {
+	    return _base + (_pos - _big_string.begin());
+	}
+	void set_offset(size_t offset) {
+	    _pos = _big_string.begin() + (offset - _base);
+	}
+	bool refill(const char *keep);
+	Lexeme scan_lexeme(Lexer *lexer);
+	String scan_config(Lexer *lexer);
 	const char *skip_line(const char *s);
 	const char *skip_slash_star(const char *s);
 	const char *skip_backslash_angle(const char *s);
@@ -137,12 +169,14 @@ class Lexer { public:
     // lexer
     FileState _file;
     bool _compact_config;
+    HashTable<String, String> _interned;
     LexerExtra *_lextra;
 
     Lexeme next_lexeme() {
 	return _file.next_lexeme(this);
     }
     static String lexeme_string(int);
+    String intern(const String &);
 
     // parser
     enum { UNLEX_SIZE = 2 };
@@ -180,6 +214,11 @@ class Lexer { public:
     Vector<String> _requirements;
     Vector<String> _libraries;
 
+    // load-time optimization
+    Vector<Pattern *> _patterns;
+    String _pattern_texts;
+    bool _undead;
+
     // errors
     ErrorHandler *_errh;
 
@@ -205,12 +244,33 @@ class Lexer { public:
     TunnelEnd *find_tunnel(const Port &p, bool isoutput, bool insert);
     void expand_connection(const Port &p, bool isoutput, Vector<Port> &);
 
+    Element *make_element(int etype, const String &name, const String &landmark, Router *router);
+    void apply_patterns(FlatRouter &fr);
+    void remove_dead(FlatRouter &fr);
+
     friend class Compound;
     friend class TunnelEnd;
+    friend struct Pattern;
+    friend struct FlatRouter;
+    friend class Matcher;
     friend struct FileState;
 
 };
 
+/** @brief Set whether create_router() removes dead elements.
+ *
+ * When @a undead is true, create_router() removes StaticSwitch,
+ * StaticPullSwitch, and Null elements from the flattened configuration,
+ * then removes elements that no packet can reach from a source or that can
+ * reach no sink, hooking up any ports this leaves blank to Idle.  Every
+ * element is assumed to pass packets from each input to each output.  The
+ * default is false. */
+inline void
+Lexer::set_undead(bool undead)
+{
+    _undead = undead;
+}
+
 class LexerExtra { public:
 
     LexerExtra()			{ }
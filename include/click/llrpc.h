@@ -85,6 +85,7 @@ CLICK_CXX_UNPROTECT
 #define CLICK_LLRPC_RAW_HANDLER			_CLICK_IOS(17)
 #define CLICK_LLRPC_ABANDON_HANDLER		_CLICK_IOS(18)
 #define CLICK_LLRPC_CALL_HANDLER		_CLICK_IO(19)
+#define CLICK_LLRPC_GET_STATS			_CLICK_IOS(20)
 
 struct click_llrpc_proxy_st {
     void* proxied_handler;	/* const Router::Handler* */
@@ -99,6 +100,14 @@ struct click_llrpc_counts_st {
     uint32_t values[CLICK_LLRPC_COUNTS_SIZE];
 };
 
+/* Statistic ids are listed by the global "stats" handler.  values[i] gets
+   the value of statistic ids[i]. */
+struct click_llrpc_stats_st {
+    uint32_t n;
+    const uint32_t *ids;
+    uint64_t *values;
+};
+
 #define CLICK_LLRPC_CALL_HANDLER_FLAG_RAW 1
 struct click_llrpc_call_handler_st {
     int flags;
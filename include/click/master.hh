@@ -32,6 +32,22 @@ class Master { public:
     inline RouterThread *thread(int id) const;
     void wake_somebody();
 
+#if HAVE_MULTITHREAD
+    inline bool work_stealing() const;
+    inline void use_work_stealing();
+    inline void unuse_work_stealing();
+
+    /** @brief Return the number of times a thread waited for the master
+     * lock. */
+    uint32_t master_lock_contention() const { return _master_lock_contention; }
+    /** @brief Return the number of times the master lock was acquired. */
+    uint32_t master_lock_acquisitions() const { return _master_lock_acquisitions; }
+    /** @brief Return the total cycles the master lock has been held. */
+    click_cycles_t master_lock_hold_cycles() const { return _master_lock_hold_cycles; }
+    /** @brief Return the longest the master lock has been held, in cycles. */
+    click_cycles_t master_lock_max_hold_cycles() const { return _master_lock_max_hold_cycles; }
+#endif
+
 #if CLICK_USERLEVEL
     int add_signal_handler(int signo, Router *router, String handler);
     int remove_signal_handler(int signo, Router *router, String handler);
@@ -44,6 +60,7 @@ class Master { public:
 #if CLICK_NS
     void initialize_ns(simclick_node_t *simnode);
     simclick_node_t *simnode() const		{ return _simnode; }
+    void ns_schedule(const Timestamp &when);
 #endif
 
 #if CLICK_DEBUG_MASTER || CLICK_DEBUG_SCHEDULING
@@ -62,11 +79,16 @@ class Master { public:
 
     // ROUTERS
     Router *_routers;
-    int _refcount;
+    atomic_uint32_t _refcount;
     void register_router(Router*);
     void prepare_router(Router*);
     void run_router(Router*, bool foreground);
     void unregister_router(Router*);
+    inline bool any_active_router() const;
+
+    // The master lock protects the router list and router state changes.
+    // Timers, selects, and tasks belong to the threads, and pausing is per
+    // router, so the lock is taken only when routers come and go.
 
 #if CLICK_LINUXMODULE
     spinlock_t _master_lock;
@@ -76,13 +98,25 @@ class Master { public:
     Spinlock _master_lock;
 #endif
     atomic_uint32_t _master_paused;
+#if HAVE_MULTITHREAD
+    atomic_uint32_t _work_stealing;
+    atomic_uint32_t _master_lock_contention;
+    uint32_t _master_lock_acquisitions;
+    click_cycles_t _master_lock_start;
+    click_cycles_t _master_lock_hold_cycles;
+    click_cycles_t _master_lock_max_hold_cycles;
+#endif
     inline void lock_master();
     inline void unlock_master();
+    void fence_threads();
+    void pause_router(Router *router);
+    inline void unpause_router(Router *router);
 
     // DRIVERMANAGER
     inline void request_stop();
     inline void request_go();
     bool check_driver();
+    Spinlock _stop_lock;	// serializes Script stop handling
 
 #if CLICK_USERLEVEL
     // SIGNALS
@@ -105,6 +139,7 @@ class Master { public:
 
 #if CLICK_NS
     simclick_node_t *_simnode;
+    Timestamp _ns_scheduled;	// earliest wakeup requested of the simulator
 #endif
 
     Master(const Master&);
@@ -139,6 +174,32 @@ Master::wake_somebody()
     _threads[1]->wake();
 }
 
+#if HAVE_MULTITHREAD
+/** @brief Return true iff idle threads should steal tasks from busy ones.
+ *
+ * Work stealing is on while at least one use_work_stealing() call is
+ * outstanding.  An idle thread asks a busy thread to hand over one of its
+ * stealable tasks; see Task::stealable(). */
+inline bool
+Master::work_stealing() const
+{
+    return _work_stealing != 0;
+}
+
+/** @brief Turn on work stealing until the matching unuse_work_stealing(). */
+inline void
+Master::use_work_stealing()
+{
+    ++_work_stealing;
+}
+
+inline void
+Master::unuse_work_stealing()
+{
+    --_work_stealing;
+}
+#endif
+
 #if CLICK_USERLEVEL
 inline void
 RouterThread::run_signals()
@@ -170,6 +231,23 @@ TimerSet::next_timer_delay(bool more_tasks, Timestamp &t) const
 	return 0;
 # endif
 }
+
+/** @brief Return how long the thread's next select() may block.
+ *
+ * Like TimerSet::next_timer_delay(), but an adaptively idle thread may
+ * block for up to its idle sleep time even though it has scheduled tasks. */
+inline int
+RouterThread::select_delay(Timestamp &t) const
+{
+    if (!_idle_sleeping)
+	return _timers.next_timer_delay(active(), t);
+    int delay_type = _timers.next_timer_delay(false, t);
+    if (delay_type < 0 || (delay_type > 0 && t > _idle_sleep)) {
+	t = _idle_sleep;
+	delay_type = 1;
+    }
+    return delay_type;
+}
 #endif
 
 inline void
@@ -198,7 +276,14 @@ Master::lock_master()
     } else
 	_master_lock_count++;
 #elif HAVE_MULTITHREAD
-    _master_lock.acquire();
+    if (!_master_lock.attempt()) {
+	++_master_lock_contention;
+	_master_lock.acquire();
+    }
+    if (!_master_lock.nested()) {
+	++_master_lock_acquisitions;
+	_master_lock_start = click_get_cycles();
+    }
 #endif
 }
 
@@ -213,6 +298,12 @@ Master::unlock_master()
     } else
 	_master_lock_count--;
 #elif HAVE_MULTITHREAD
+    if (!_master_lock.nested()) {
+	click_cycles_t held = click_get_cycles() - _master_lock_start;
+	_master_lock_hold_cycles += held;
+	if (held > _master_lock_max_hold_cycles)
+	    _master_lock_max_hold_cycles = held;
+    }
     _master_lock.release();
 #endif
 }
@@ -223,6 +314,21 @@ Master::unpause()
     _master_paused--;
 }
 
+inline void
+Master::unpause_router(Router *router)
+{
+    router->_paused--;
+}
+
+inline bool
+Master::any_active_router() const
+{
+    for (Router *r = _routers; r; r = r->_next_router)
+	if (r->_running == Router::RUNNING_ACTIVE)
+	    return true;
+    return false;
+}
+
 inline Master *
 Element::master() const
 {
@@ -3,6 +3,7 @@
 #define CLICK_NAMEINFO_HH
 #include <click/args.hh>
 #include <click/straccum.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 class Element;
 class NameDB;
@@ -123,6 +124,10 @@ class NameInfo { public:
      * element @a context, returning the most specific value matching @a name.
      * The value is stored in @a value_store.  The installed databases must
      * have the given @a value_size.
+     *
+     * Failed queries are remembered per @a context element until a name is
+     * next defined or a database installed, so repeated queries for
+     * literals, such as addresses, skip the database walk.
      */
     static bool query(uint32_t type, const Element *context,
 		      const String &name, void *value_store, size_t value_size);
@@ -232,9 +237,31 @@ class NameInfo { public:
     Vector<NameDB *> _namedb_roots;
     Vector<NameDB *> _namedbs;
 
+    // Failed queries, valid while _miss_generation == _generation, which
+    // advances whenever a name is added or a database is installed.
+    struct Miss {
+	const Element *context;
+	uint32_t type;
+	String name;
+	Miss(const Element *c, uint32_t t, const String &n)
+	    : context(c), type(t), name(n) {
+	}
+	hashcode_t hashcode() const {
+	    return name.hashcode() + type + (uintptr_t) context;
+	}
+	bool operator==(const Miss &x) const {
+	    return context == x.context && type == x.type && name == x.name;
+	}
+    };
+    HashTable<Miss, int> _misses;
+    uint32_t _miss_generation;
+    static uint32_t _generation;
+
     inline NameDB *install_dynamic_sentinel() { return (NameDB *) this; }
     NameDB *namedb(uint32_t type, size_t size, const String &prefix, NameDB *installer);
 
+    friend class DynamicNameDB;
+
 #if CLICK_NAMEDB_CHECK
     uintptr_t _check_generation;
     void checkdb(NameDB *db, NameDB *parent, ErrorHandler *errh);
@@ -448,10 +475,9 @@ class DynamicNameDB : public NameDB { public:
 
     Vector<String> _names;
     StringAccum _values;
-    int _sorted;
+    HashTable<String, int> _index;	// name -> position in _names
 
     void *find(const String &name, bool create);
-    void sort();
 
 };
 
@@ -475,7 +501,7 @@ StaticNameDB::StaticNameDB(uint32_t type, const String &context, const Entry *en
 
 inline
 DynamicNameDB::DynamicNameDB(uint32_t type, const String &context, size_t vsize)
-    : NameDB(type, context, vsize), _sorted(0)
+    : NameDB(type, context, vsize)
 {
 }
 
@@ -3,6 +3,7 @@
 #define CLICK_NOTIFIER_HH
 #include <click/task.hh>
 #include <click/atomic.hh>
+#include <click/integers.hh>
 #if HAVE_CXX_PRAGMA_INTERFACE
 # pragma interface "click/notifier.hh"
 #endif
@@ -172,6 +173,8 @@ class NotifierSignal { public:
     void hard_derive_one(atomic_uint32_t *value, uint32_t mask);
     static bool hard_equals(const vmpair *a, const vmpair *b);
 
+    friend class NotifierSignalSet;
+
 };
 
 class Notifier { public:
@@ -247,6 +250,43 @@ class ActiveNotifier : public Notifier { public:
 
 };
 
+class NotifierSignalSet { public:
+
+    NotifierSignalSet();
+    ~NotifierSignalSet();
+
+    int initialize(const NotifierSignal *signals, int n);
+
+    /** @brief Return the number of words in an active bitmap. */
+    int nwords() const {
+	return (_n + 31) >> 5;
+    }
+
+    void active_bitmap(uint32_t *bits) const;
+
+    static inline int next_bit(const uint32_t *bits, int n, int i);
+
+  private:
+
+    struct word_t {
+	atomic_uint32_t *value;
+	uint32_t mask;
+	int first[32];
+    };
+
+    const NotifierSignal *_signals;
+    int _n;
+    word_t *_words;
+    int _nwords;
+    int *_next;				// (signal, next) pairs per word bit
+    int *_complex;			// signals spanning several words
+    int _ncomplex;
+
+    NotifierSignalSet(const NotifierSignalSet &); // does not exist
+    NotifierSignalSet &operator=(const NotifierSignalSet &); // does not exist
+
+};
+
 
 inline
 NotifierSignal::NotifierSignal()
@@ -582,5 +622,26 @@ ActiveNotifier::sleep()
     set_active(false, true);
 }
 
+/** @brief Return the index of the first set bit at or after @a i.
+ * @param bits bitmap of @a n bits
+ * @param n number of bits
+ * @param i first bit to consider
+ * @return the index of the bit, or -1 if no bit at or after @a i is set */
+inline int
+NotifierSignalSet::next_bit(const uint32_t *bits, int n, int i)
+{
+    if (i >= n)
+	return -1;
+    int w = i >> 5;
+    uint32_t x = bits[w] & (~0U << (i & 31));
+    while (!x) {
+	if (++w >= ((n + 31) >> 5))
+	    return -1;
+	x = bits[w];
+    }
+    i = (w << 5) + ffs_lsb(x) - 1;
+    return i < n ? i : -1;
+}
+
 CLICK_ENDDECLS
 #endif
@@ -60,6 +60,16 @@ class Packet { public:
 #endif
 
     static void static_cleanup();
+#if HAVE_CLICK_PACKET_POOL
+    static int set_pool_parameters(uint32_t size, uint32_t global_count,
+				   bool huge_pages);
+    static String pool_statistics();
+    static size_t pool_memory();
+#endif
+#if !CLICK_LINUXMODULE
+    static String layout_report();
+#endif
+    static String expensive_statistics();
 
     inline void kill();
 
@@ -659,6 +669,9 @@ class Packet { public:
 
   private:
 
+    // The fields that most packet paths touch fit in this many bytes.
+    enum { layout_hot_bytes = 64 };
+
     // Anno must fit in sk_buff's char cb[48].
     /** @cond never */
     union Anno {
@@ -673,17 +686,17 @@ class Packet { public:
     };
 
 #if !CLICK_LINUXMODULE
-    // All packet annotations are stored in AllAnno so that
-    // clear_annotations(true) can memset() the structure to zero.
+    // Most annotations are stored in AllAnno so that clear_annotations(true)
+    // can memset() the structure to zero.  The network header pointer comes
+    // first so that it shares the Packet's first cache line with the data
+    // pointers and the start of the annotation area.
     struct AllAnno {
-	Anno cb;
-	unsigned char *mac;
 	unsigned char *nh;
+	Anno cb;
 	unsigned char *h;
-	PacketType pkt_type;
-	Timestamp timestamp;
+	unsigned char *mac;
 	Packet *next;
-	Packet *prev;
+	Timestamp timestamp;
 	AllAnno()
 	    : timestamp(Timestamp::uninitialized_t()) {
 	}
@@ -692,21 +705,33 @@ class Packet { public:
     /** @endcond never */
 
 #if !CLICK_LINUXMODULE
-    // User-space and BSD kernel module implementations.
-    atomic_uint32_t _use_count;
-    Packet *_data_packet;
+    // User-space and BSD kernel module implementations.  Fields are ordered
+    // by how often packet code touches them: on 64-bit user-level builds,
+    // the data pointers, use count, network header, and the first 24 bytes
+    // of the annotation area (including the destination address and paint
+    // annotations) share the first 64-byte cache line; the rest of the
+    // annotations, the header pointers, next and _data_packet share the
+    // second.  Packet::~Packet checks this layout at compile time and
+    // Packet::layout_report() describes it.
     /* mimic Linux sk_buff */
-    unsigned char *_head; /* start of allocated buffer */
     unsigned char *_data; /* where the packet starts */
     unsigned char *_tail; /* one beyond end of packet */
+    unsigned char *_head; /* start of allocated buffer */
+    atomic_uint32_t _use_count;
+    PacketType _pkt_type;
+    AllAnno _aa;
+    Packet *_data_packet;
+    Packet *_prev;
     unsigned char *_end;  /* one beyond end of allocated buffer */
 # if CLICK_USERLEVEL
     void (*_destructor)(unsigned char *, size_t);
 # endif
+# if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+    void *_pool;	  /* PacketPool that allocated this packet */
+# endif
 # if CLICK_BSDMODULE
     struct mbuf *_m;
 # endif
-    AllAnno _aa;
 # if CLICK_NS
     SimPacketinfoWrapper _sim_packetinfo;
 # endif
@@ -721,6 +746,12 @@ class Packet { public:
     ~Packet();
     Packet &operator=(const Packet &x);
 
+#if CLICK_USERLEVEL
+    // Packet objects start on a cache line, so the layout above holds.
+    static void *operator new(size_t size) throw ();
+    static void operator delete(void *p);
+#endif
+
 #if !CLICK_LINUXMODULE
     bool alloc_data(uint32_t headroom, uint32_t length, uint32_t tailroom);
 #endif
@@ -810,7 +841,14 @@ Packet::clear_annotations(bool all)
 	set_prev(0);
     }
 #else
-    memset(&_aa, 0, all ? sizeof(AllAnno) : sizeof(Anno));
+    memset(xanno(), 0, sizeof(Anno));
+    if (all) {
+	_aa.nh = _aa.h = _aa.mac = 0;
+	_aa.next = 0;
+	_aa.timestamp = Timestamp();
+	_pkt_type = HOST;
+	_prev = 0;
+    }
 #endif
 }
 
@@ -988,7 +1026,7 @@ Packet::prev() const
 #if CLICK_LINUXMODULE
     return (Packet *)(skb()->prev);
 #else
-    return _aa.prev;
+    return _prev;
 #endif
 }
 
@@ -998,7 +1036,7 @@ Packet::prev()
 #if CLICK_LINUXMODULE
     return (Packet *&)(skb()->prev);
 #else
-    return _aa.prev;
+    return _prev;
 #endif
 }
 
@@ -1008,7 +1046,7 @@ Packet::set_prev(Packet *p)
 #if CLICK_LINUXMODULE
     skb()->prev = p->skb();
 #else
-    _aa.prev = p;
+    _prev = p;
 #endif
 }
 
@@ -1279,7 +1317,7 @@ Packet::packet_type_anno() const
 #elif CLICK_LINUXMODULE
     return (PacketType)(skb()->pkt_type);
 #else
-    return _aa.pkt_type;
+    return _pkt_type;
 #endif
 }
 
@@ -1291,7 +1329,7 @@ Packet::set_packet_type_anno(PacketType p)
 #elif CLICK_LINUXMODULE
     skb()->pkt_type = p;
 #else
-    _aa.pkt_type = p;
+    _pkt_type = p;
 #endif
 }
 
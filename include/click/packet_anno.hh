@@ -67,6 +67,29 @@
 #define REV_RATE_ANNO(p)		((p)->anno_s32(REV_RATE_ANNO_OFFSET))
 #define SET_REV_RATE_ANNO(p, v)		((p)->set_anno_s32(REV_RATE_ANNO_OFFSET, (v)))
 
+// bytes 24-27: offload metadata, as in a virtio_net_hdr
+#define GSO_SIZE_ANNO_OFFSET		24
+#define GSO_SIZE_ANNO_SIZE		2
+#define GSO_SIZE_ANNO(p)		((p)->anno_u16(GSO_SIZE_ANNO_OFFSET))
+#define SET_GSO_SIZE_ANNO(p, v)		((p)->set_anno_u16(GSO_SIZE_ANNO_OFFSET, (v)))
+
+#define GSO_TYPE_ANNO_OFFSET		26
+#define GSO_TYPE_ANNO_SIZE		1
+#define GSO_TYPE_ANNO(p)		((p)->anno_u8(GSO_TYPE_ANNO_OFFSET))
+#define SET_GSO_TYPE_ANNO(p, v)		((p)->set_anno_u8(GSO_TYPE_ANNO_OFFSET, (v)))
+#define GSO_TYPE_NONE			0
+#define GSO_TYPE_TCPV4			1
+#define GSO_TYPE_UDP			3
+#define GSO_TYPE_TCPV6			4
+#define GSO_TYPE_ECN			0x80
+
+#define CSUM_FLAGS_ANNO_OFFSET		27
+#define CSUM_FLAGS_ANNO_SIZE		1
+#define CSUM_FLAGS_ANNO(p)		((p)->anno_u8(CSUM_FLAGS_ANNO_OFFSET))
+#define SET_CSUM_FLAGS_ANNO(p, v)	((p)->set_anno_u8(CSUM_FLAGS_ANNO_OFFSET, (v)))
+#define CSUM_FLAG_NEEDED		1	// transport checksum is partial
+#define CSUM_FLAG_VALID			2	// checksum already verified
+
 // byte 26
 #define SEND_ERR_ANNO_OFFSET		26
 #define SEND_ERR_ANNO_SIZE		1
@@ -134,4 +157,10 @@
 # endif
 #endif
 
+// bytes 44-47
+#define TRACE_ANNO_OFFSET		44
+#define TRACE_ANNO_SIZE			4
+#define TRACE_ANNO(p)			((p)->anno_u32(TRACE_ANNO_OFFSET))
+#define SET_TRACE_ANNO(p, v)		((p)->set_anno_u32(TRACE_ANNO_OFFSET, (v)))
+
 #endif
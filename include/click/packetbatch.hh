@@ -0,0 +1,177 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETBATCH_HH
+#define CLICK_PACKETBATCH_HH
+#include <click/packet.hh>
+CLICK_DECLS
+
+/** @file <click/packetbatch.hh>
+ * @brief A list of packets transferred as a unit.
+ */
+
+/** @class PacketBatch
+ * @brief A singly-linked list of packets.
+ *
+ * PacketBatch strings packets together using their next() annotations, so
+ * building and walking a batch never allocates.  Batches are passed between
+ * elements with Element::push_batch() and Element::pull_batch(); an element
+ * that does not override those functions sees the batch's packets one at a
+ * time through push() or pull().
+ *
+ * A batch owns its packets.  Packets in a batch are linked by next(); the
+ * last packet's next() is null.  Code that walks a batch should not modify
+ * next() annotations directly.  To walk a batch:
+ *
+ * @code
+ * for (Packet *p = batch.front(); p; p = p->next())
+ *     ...;
+ * @endcode
+ *
+ * Packets removed from a batch with pop_front() have null next()
+ * annotations, as do packets in the list returned by take() except for the
+ * links between them. */
+class PacketBatch { public:
+
+    /** @brief Construct an empty batch. */
+    PacketBatch()
+	: _head(0), _tail(0), _count(0) {
+    }
+
+    /** @brief Return true iff the batch contains no packets. */
+    bool empty() const {
+	return !_head;
+    }
+    /** @brief Return the number of packets in the batch. */
+    int count() const {
+	return _count;
+    }
+
+    /** @brief Return the first packet in the batch, or null if empty. */
+    Packet *front() const {
+	return _head;
+    }
+    /** @brief Return the last packet in the batch, or null if empty. */
+    Packet *back() const {
+	return _tail;
+    }
+
+    inline void push_back(Packet *p);
+    inline void push_front(Packet *p);
+    inline Packet *pop_front();
+    inline void append(PacketBatch &x);
+    inline void swap(PacketBatch &x);
+
+    inline Packet *take();
+    inline void kill();
+
+  private:
+
+    Packet *_head;
+    Packet *_tail;
+    int _count;
+
+    PacketBatch(const PacketBatch &);
+    PacketBatch &operator=(const PacketBatch &);
+
+};
+
+/** @brief Add @a p to the end of the batch.
+ * @pre @a p is not null and is not part of another batch */
+inline void
+PacketBatch::push_back(Packet *p)
+{
+    assert(p);
+    p->set_next(0);
+    if (_tail)
+	_tail->set_next(p);
+    else
+	_head = p;
+    _tail = p;
+    ++_count;
+}
+
+/** @brief Add @a p to the front of the batch.
+ * @pre @a p is not null and is not part of another batch */
+inline void
+PacketBatch::push_front(Packet *p)
+{
+    assert(p);
+    p->set_next(_head);
+    if (!_head)
+	_tail = p;
+    _head = p;
+    ++_count;
+}
+
+/** @brief Remove and return the first packet in the batch.
+ *
+ * Returns null if the batch is empty.  The returned packet's next()
+ * annotation is null. */
+inline Packet *
+PacketBatch::pop_front()
+{
+    Packet *p = _head;
+    if (p) {
+	_head = p->next();
+	if (!_head)
+	    _tail = 0;
+	p->set_next(0);
+	--_count;
+    }
+    return p;
+}
+
+/** @brief Move all packets in @a x to the end of this batch.
+ *
+ * @a x is left empty. */
+inline void
+PacketBatch::append(PacketBatch &x)
+{
+    if (!x._head)
+	return;
+    if (_tail)
+	_tail->set_next(x._head);
+    else
+	_head = x._head;
+    _tail = x._tail;
+    _count += x._count;
+    x._head = x._tail = 0;
+    x._count = 0;
+}
+
+/** @brief Swap the contents of this batch and @a x. */
+inline void
+PacketBatch::swap(PacketBatch &x)
+{
+    Packet *h = _head, *t = _tail;
+    int c = _count;
+    _head = x._head;
+    _tail = x._tail;
+    _count = x._count;
+    x._head = h;
+    x._tail = t;
+    x._count = c;
+}
+
+/** @brief Remove all packets from the batch and return them as a list.
+ *
+ * The returned packets are linked by their next() annotations; the last
+ * packet's next() is null.  The caller becomes responsible for them. */
+inline Packet *
+PacketBatch::take()
+{
+    Packet *p = _head;
+    _head = _tail = 0;
+    _count = 0;
+    return p;
+}
+
+/** @brief Kill all packets in the batch, leaving it empty. */
+inline void
+PacketBatch::kill()
+{
+    while (Packet *p = pop_front())
+	p->kill();
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,220 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETRING_HH
+#define CLICK_PACKETRING_HH
+#include <click/packet.hh>
+#include <click/packetbatch.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/** @file <click/packetring.hh>
+ * @brief A fixed-capacity FIFO ring of packets.
+ */
+
+/** @class PacketRing
+ * @brief A fixed-capacity FIFO of packets, safe for one producer and one
+ * consumer.
+ *
+ * PacketRing stores packet pointers in an array whose size is a power of two.
+ * Its head and tail positions run freely and are masked into the array, so
+ * no operation divides, compares against the end of the array, or copies the
+ * ring to grow it.  The capacity is fixed by initialize() and need not be a
+ * power of two; a ring of capacity 100 uses 128 slots and holds at most 100
+ * packets.
+ *
+ * One thread may push while another pops, without locks: the producer writes
+ * only the tail, and the consumer writes only the head.  push_back() and
+ * push_batch() are producer operations; front(), pop_front(), pop_batch() and
+ * operator[]() are consumer operations.  Operations that change both ends,
+ * such as clear(), need the ring to be idle.
+ *
+ * A ring owns its packets.  Its destructor and clear() kill them.
+ *
+ * @code
+ * PacketRing ring;
+ * if (!ring.initialize(capacity))
+ *     return errh->error("out of memory!");
+ * ...
+ * if (!ring.push_back(p))   // full
+ *     p->kill();
+ * ...
+ * while (Packet *p = ring.pop_front())
+ *     output(0).push(p);
+ * @endcode */
+class PacketRing { public:
+
+    typedef uint32_t index_type;
+
+    /** @brief Construct an uninitialized ring, of capacity 0. */
+    PacketRing()
+	: _ring(0), _mask(0), _capacity(0), _head(0), _tail(0) {
+    }
+    /** @brief Destroy the ring, killing any packets it holds. */
+    ~PacketRing() {
+	clear();
+	if (_ring)
+	    CLICK_LFREE(_ring, sizeof(Packet *) * (_mask + 1));
+    }
+
+    inline bool initialize(index_type capacity);
+
+    /** @brief Return the maximum number of packets the ring holds. */
+    index_type capacity() const {
+	return _capacity;
+    }
+    /** @brief Return the number of packets in the ring. */
+    index_type size() const {
+	return _tail - _head;
+    }
+    /** @brief Return true iff the ring holds no packets. */
+    bool empty() const {
+	return _head == _tail;
+    }
+    /** @brief Return true iff the ring holds capacity() packets. */
+    bool full() const {
+	return _tail - _head >= _capacity;
+    }
+
+    /** @brief Return the oldest packet, or null if the ring is empty. */
+    Packet *front() const {
+	return empty() ? 0 : _ring[_head & _mask];
+    }
+    /** @brief Return the packet @a i places from the front.
+     * @pre @a i < size() */
+    Packet *operator[](index_type i) const {
+	return _ring[(_head + i) & _mask];
+    }
+
+    inline bool push_back(Packet *p);
+    inline Packet *pop_front();
+    inline int push_batch(PacketBatch &batch);
+    inline int pop_batch(PacketBatch &batch, int max);
+    inline void clear();
+
+  private:
+
+    enum { CACHE_LINE_SIZE = 64 };
+
+    // The consumer writes _head and the producer writes _tail; keep them on
+    // separate cache lines.
+    Packet **_ring;
+    index_type _mask;
+    index_type _capacity;
+    char _head_pad[CACHE_LINE_SIZE - sizeof(Packet **) - 2 * sizeof(index_type)];
+    volatile index_type _head;
+    char _tail_pad[CACHE_LINE_SIZE - sizeof(index_type)];
+    volatile index_type _tail;
+
+    PacketRing(const PacketRing &);
+    PacketRing &operator=(const PacketRing &);
+
+};
+
+/** @brief Allocate room for @a capacity packets.
+ * @return true on success, false if memory is exhausted
+ *
+ * The ring must be empty.  Any previous slots are freed. */
+inline bool
+PacketRing::initialize(index_type capacity)
+{
+    assert(empty());
+    index_type n = 1;
+    while (n < capacity)
+	n <<= 1;
+    if (_ring && n == _mask + 1) {
+	_capacity = capacity;
+	return true;
+    }
+    Packet **ring = (Packet **) CLICK_LALLOC(sizeof(Packet *) * n);
+    if (!ring)
+	return false;
+    if (_ring)
+	CLICK_LFREE(_ring, sizeof(Packet *) * (_mask + 1));
+    _ring = ring;
+    _mask = n - 1;
+    _capacity = capacity;
+    _head = _tail = 0;
+    return true;
+}
+
+/** @brief Add @a p to the back of the ring.
+ * @return true on success, false if the ring is full
+ *
+ * On failure, the caller keeps @a p. */
+inline bool
+PacketRing::push_back(Packet *p)
+{
+    index_type t = _tail;
+    if (t - _head >= _capacity)
+	return false;
+    _ring[t & _mask] = p;
+    click_write_fence();
+    _tail = t + 1;
+    return true;
+}
+
+/** @brief Remove and return the oldest packet, or null if the ring is
+ * empty. */
+inline Packet *
+PacketRing::pop_front()
+{
+    index_type h = _head;
+    if (h == _tail)
+	return 0;
+    click_read_fence();
+    Packet *p = _ring[h & _mask];
+    // finish reading the slot before the producer may reuse it
+    click_write_fence();
+    _head = h + 1;
+    return p;
+}
+
+/** @brief Move packets from the front of @a batch to the back of the ring.
+ * @return the number of packets moved
+ *
+ * Packets that do not fit stay in @a batch.  The ring's tail moves once. */
+inline int
+PacketRing::push_batch(PacketBatch &batch)
+{
+    index_type t = _tail, room = _capacity - (t - _head);
+    int n = 0;
+    for (; (index_type) n < room && !batch.empty(); ++n)
+	_ring[(t + n) & _mask] = batch.pop_front();
+    if (n) {
+	click_write_fence();
+	_tail = t + n;
+    }
+    return n;
+}
+
+/** @brief Move up to @a max packets from the front of the ring to the back
+ * of @a batch.
+ * @return the number of packets moved
+ *
+ * The ring's head moves once. */
+inline int
+PacketRing::pop_batch(PacketBatch &batch, int max)
+{
+    index_type h = _head, avail = _tail - h;
+    if (max <= 0 || !avail)
+	return 0;
+    if ((index_type) max > avail)
+	max = avail;
+    click_read_fence();
+    for (int i = 0; i < max; ++i)
+	batch.push_back(_ring[(h + i) & _mask]);
+    click_write_fence();
+    _head = h + max;
+    return max;
+}
+
+/** @brief Kill all packets in the ring. */
+inline void
+PacketRing::clear()
+{
+    while (Packet *p = pop_front())
+	p->kill();
+    _head = _tail = 0;
+}
+
+CLICK_ENDDECLS
+#endif
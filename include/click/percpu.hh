@@ -0,0 +1,148 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PERCPU_HH
+#define CLICK_PERCPU_HH
+#include <click/glue.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+/** @file <click/percpu.hh>
+ * @brief A set of per-thread values on separate cache lines.
+ */
+
+/** @class PerCPU
+ * @brief An array of values, one per Click thread.
+ *
+ * PerCPU holds one T for each thread that might run an element's code, each
+ * on its own cache line.  A thread updates its own slot, found by get(),
+ * without locks or atomic operations; a reader that wants the total walks
+ * all the slots with operator[].  This suits statistics that are updated on
+ * every packet but read rarely, such as counters.
+ *
+ * At user level, slots are indexed by Click thread ID, so the array has
+ * Master::nthreads() slots.  In the Linux kernel, slots are indexed by
+ * processor ID.  Other drivers have a single slot.
+ *
+ * Readers see each slot's value as of some recent time; they may race with
+ * the slot's writer, so values wider than a machine word may be torn.  T
+ * must be default constructible. */
+template <typename T>
+class PerCPU { public:
+
+    enum { cache_line_size = 64 };
+
+    /** @brief Construct an empty PerCPU.  Call initialize() before use. */
+    PerCPU()
+	: _mem(0), _slots(0), _n(0) {
+    }
+
+    ~PerCPU() {
+	clear();
+    }
+
+    /** @brief Allocate one default-constructed slot per thread of @a m.
+     * @return 0 on success, -ENOMEM on failure */
+    int initialize(Master *m);
+
+    /** @brief Return true iff initialize() has been called. */
+    bool initialized() const {
+	return _slots;
+    }
+
+    /** @brief Return the number of slots. */
+    int size() const {
+	return _n;
+    }
+
+    /** @brief Return slot @a i. */
+    T &operator[](int i) {
+	return slot(i)->value;
+    }
+    /** @overload */
+    const T &operator[](int i) const {
+	return slot(i)->value;
+    }
+
+    /** @brief Return the current thread's slot. */
+    T &get() {
+	unsigned i = current_index();
+	return slot(i < (unsigned) _n ? i : i % _n)->value;
+    }
+
+    /** @brief Return the current thread's index, which may exceed size(). */
+    static inline unsigned current_index();
+
+    /** @brief Free all slots. */
+    void clear();
+
+  private:
+
+    struct Slot {
+	T value;
+	char pad[cache_line_size - sizeof(T) % cache_line_size];
+    };
+
+    char *_mem;
+    Slot *_slots;
+    int _n;
+
+    Slot *slot(int i) const {
+	return _slots + i;
+    }
+
+    PerCPU(const PerCPU<T> &x);
+    PerCPU<T> &operator=(const PerCPU<T> &x);
+
+};
+
+template <typename T>
+inline unsigned
+PerCPU<T>::current_index()
+{
+#if CLICK_LINUXMODULE
+    return smp_processor_id();
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    // threads outside the driver have ID -1; get() still maps them to a slot
+    return click_current_thread_id;
+#else
+    return 0;
+#endif
+}
+
+template <typename T>
+int
+PerCPU<T>::initialize(Master *m)
+{
+    clear();
+#if CLICK_LINUXMODULE
+    (void) m;
+    int n = NR_CPUS;
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    int n = m->nthreads();
+#else
+    (void) m;
+    int n = 1;
+#endif
+    if (!(_mem = new char[n * sizeof(Slot) + cache_line_size]))
+	return -ENOMEM;
+    uintptr_t a = reinterpret_cast<uintptr_t>(_mem) + cache_line_size - 1;
+    _slots = reinterpret_cast<Slot *>(a - a % cache_line_size);
+    for (int i = 0; i < n; ++i)
+	new((void *) &_slots[i].value) T();
+    _n = n;
+    return 0;
+}
+
+template <typename T>
+void
+PerCPU<T>::clear()
+{
+    for (int i = 0; i < _n; ++i)
+	_slots[i].value.~T();
+    delete[] _mem;
+    _mem = 0;
+    _slots = 0;
+    _n = 0;
+}
+
+CLICK_ENDDECLS
+#endif
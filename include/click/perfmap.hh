@@ -0,0 +1,55 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/perfmap.cc" -*-
+#ifndef CLICK_PERFMAP_HH
+#define CLICK_PERFMAP_HH
+#include <click/string.hh>
+CLICK_DECLS
+class ErrorHandler;
+
+/** @file <click/perfmap.hh>
+ *  @brief  Symbols for machine code generated at run time.
+ */
+
+/** @class PerfMap include/click/perfmap.hh <click/perfmap.hh>
+ *  @brief  Describes generated machine code to profilers.
+ *
+ *  Code that Click generates while running, such as compiled Classifier and
+ *  IPFilter programs, has no symbols, so profilers show it as anonymous
+ *  addresses.  Code generators call add() once a region of executable
+ *  memory is ready.  If a driver has called enable(), add() records the
+ *  region under a name that identifies its owner.
+ *
+ *  With F_MAP, each region gets a line in <tt>/tmp/perf-PID.map</tt>.  perf
+ *  report and similar tools read this file.  With F_JITDUMP, each region is
+ *  also written to <tt>/tmp/jit-PID.dump</tt> in the jitdump format,
+ *  together with a copy of its code.  After <tt>perf record -k mono</tt>,
+ *  <tt>perf inject --jit</tt> uses that file to build symbol files, so
+ *  annotation works even for regions freed before the profile is read.
+ *
+ *  PerfMap is only available at user level.  add() is thread safe. */
+class PerfMap { public:
+
+    enum {
+	F_MAP = 1,		///< write /tmp/perf-PID.map
+	F_JITDUMP = 2		///< write /tmp/jit-PID.dump
+    };
+
+    static int enable(int flags, ErrorHandler *errh);
+    static inline bool enabled();
+
+    static void add(const void *code, size_t size, const String &name);
+
+  private:
+
+    static int _flags;
+
+};
+
+/** @brief  Return true iff add() records regions. */
+inline bool
+PerfMap::enabled()
+{
+    return _flags != 0;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,93 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PREFETCH_HH
+#define CLICK_PREFETCH_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/** @file <click/prefetch.hh>
+ * @brief Software prefetching, and prefetch pipelines for batches.
+ *
+ * An element that handles a packet usually takes two cache misses in a row:
+ * one on the packet, and one on the data structure the packet selects, such
+ * as a hash bucket or a routing table entry.  When an element handles a
+ * batch, it can overlap these misses across packets.  It splits its work on
+ * each packet into a prefetch stage, which computes the key and prefetches
+ * what the key selects, and an execute stage, which does the real work on
+ * memory that is, by then, in cache.  click_prefetch_pipeline() runs the
+ * prefetch stage a few packets ahead of the execute stage.
+ *
+ * @code
+ * struct IPStages {		// from ARPQuerier
+ *     ARPQuerier *q;
+ *     Packet **p;
+ *     PacketBatch *out;
+ *     void prefetch(int i) { q->_arpt->prefetch(p[i]->dst_ip_anno()); }
+ *     void execute(int i)  { q->handle_ip(p[i], out); }
+ * };
+ * ...
+ * IPStages stages = { this, p, &out };
+ * click_prefetch_pipeline(stages, n);
+ * @endcode
+ *
+ * Prefetches are hints.  They never fault, even on bad addresses, so a
+ * prefetch stage may read shared structures without locks; the execute
+ * stage must still lock as usual.
+ */
+
+/** @brief Number of items by which prefetches run ahead of their use.
+ *
+ * Four or so outstanding misses cover memory latency on current processors
+ * without evicting lines before they are used. */
+#ifndef CLICK_PREFETCH_DISTANCE
+# define CLICK_PREFETCH_DISTANCE 4
+#endif
+
+/** @brief Prefetch the cache line containing @a p for reading. */
+inline void
+click_prefetch(const void *p)
+{
+#ifdef __GNUC__
+    __builtin_prefetch(p, 0);
+#else
+    (void) p;
+#endif
+}
+
+/** @brief Prefetch the cache line containing @a p for writing. */
+inline void
+click_prefetch_write(const void *p)
+{
+#ifdef __GNUC__
+    __builtin_prefetch(p, 1);
+#else
+    (void) p;
+#endif
+}
+
+/** @brief Run a prefetch pipeline over @a n items.
+ * @param stages object with prefetch(int) and execute(int) methods
+ * @param n number of items
+ * @param distance how many items prefetch runs ahead of execute
+ *
+ * Calls stages.prefetch(@em i) and stages.execute(@em i) once for each
+ * @em i in [0, @a n).  Items execute in order, and item @em i is prefetched
+ * when item @em i - @a distance executes, so up to @a distance prefetches
+ * are in flight while the pipeline works.  An item's prefetch stage always
+ * precedes its execute stage, but execute stages of earlier items may come
+ * between them; a prefetch stage must not depend on their results. */
+template <typename S>
+inline void
+click_prefetch_pipeline(S &stages, int n, int distance = CLICK_PREFETCH_DISTANCE)
+{
+    int j = 0;
+    for (; j < n && j < distance; ++j)
+	stages.prefetch(j);
+    for (int i = 0; i < n; ++i, ++j) {
+	if (j < n)
+	    stages.prefetch(j);
+	stages.execute(i);
+    }
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,346 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_RCUHASHTABLE_HH
+#define CLICK_RCUHASHTABLE_HH
+#include <click/glue.hh>
+#include <click/algorithm.hh>
+#include <click/hashcode.hh>
+#include <click/sync.hh>
+#include <click/timestamp.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/** @file <click/rcuhashtable.hh>
+ * @brief A hash table whose readers take no locks.
+ */
+
+/** @class RCUHashTable
+ * @brief Open-addressing hash table with lock-free, write-free readers.
+ *
+ * find() and slot() neither take locks nor write shared memory, so threads
+ * that look keys up concurrently do not bounce cache lines between them.
+ * Each slot carries a sequence number that a writer makes odd while it
+ * changes the slot; a reader that sees the number change, or sees it odd,
+ * rereads the slot.
+ *
+ * When the table grows, or is rebuilt to drop erased slots, the new slot
+ * array is published with a single pointer store.  Readers that started
+ * earlier may still be probing the old array, so it is retired rather than
+ * freed, and reclaim() frees retired arrays once a grace period of one second
+ * has passed.  Writers call reclaim() themselves; an owner that writes rarely
+ * should also call it from a timer.
+ *
+ * Writers (set(), erase(), clear(), swap() and reclaim()) must be serialized
+ * by the caller, for example with a Spinlock.
+ *
+ * K must provide hashcode() and operator==.  K and V must be default
+ * constructible and assignable.  A reader may copy a value while a writer
+ * changes it; it then discards the copy and tries again, so V should not own
+ * memory. */
+template <typename K, typename V>
+class RCUHashTable { public:
+
+    RCUHashTable()
+	: _array(0), _size(0) {
+    }
+    ~RCUHashTable() {
+	if (_array)
+	    free_array(_array);
+	reclaim(true);
+    }
+
+    /** @brief Return the number of keys. */
+    int size() const {
+	return _size;
+    }
+    /** @brief Return the number of slots, for iteration with slot(). */
+    int slot_count() const {
+	const Array *a = _array;
+	return a ? a->mask + 1 : 0;
+    }
+    /** @brief Return the number of bytes in the slot array. */
+    size_t memory() const {
+	const Array *a = _array;
+	return a ? array_size(a->mask + 1) : 0;
+    }
+
+    inline bool find(const K &key, V &value) const;
+    inline bool slot(int i, K &key, V &value) const;
+
+    void set(const K &key, const V &value);
+    bool erase(const K &key);
+    void clear();
+    void swap(RCUHashTable<K, V> &x);
+    void reclaim(bool all = false);
+
+    enum { grace_msec = 1000 };
+
+  private:
+
+    enum { s_empty = 0, s_live = 1, s_erased = 2 };
+
+    struct Slot {
+	volatile uint32_t seq;
+	uint32_t state;
+	K key;
+	V value;
+	Slot()
+	    : seq(0), state(s_empty) {
+	}
+    };
+
+    struct Array {
+	uint32_t mask;
+	uint32_t used;		// live and erased slots
+	Slot slots[1];
+    };
+
+    struct Retired {
+	Array *array;
+	Timestamp when;
+    };
+
+    Array * volatile _array;
+    int _size;
+    Vector<Retired> _retired;
+
+    static uint32_t bucket(const Array *a, const K &key) {
+	return ((uint32_t) hashcode(key) * 0x9E3779B1U) >> 7 & a->mask;
+    }
+    static size_t array_size(uint32_t nslots) {
+	return sizeof(Array) + (nslots - 1) * sizeof(Slot);
+    }
+    static void write(Slot &s, const K &key, const V &value, uint32_t state);
+    bool rebuild();
+    void retire(Array *a);
+    static void free_array(Array *a);
+
+    RCUHashTable(const RCUHashTable<K, V> &);
+    RCUHashTable<K, V> &operator=(const RCUHashTable<K, V> &);
+
+};
+
+/** @brief Find @a key; if present, copy its value into @a value.
+ * @return true iff @a key was found
+ *
+ * Safe to call from any thread, concurrently with writers. */
+template <typename K, typename V>
+inline bool
+RCUHashTable<K, V>::find(const K &key, V &value) const
+{
+    const Array *a = _array;
+    if (!a)
+	return false;
+    for (uint32_t i = bucket(a, key); ; i = (i + 1) & a->mask) {
+	const Slot &s = a->slots[i];
+	uint32_t seq, state;
+	bool match;
+	do {
+	    seq = s.seq;
+	    click_read_fence();
+	    state = s.state;
+	    match = state == s_live && s.key == key;
+	    if (match)
+		value = s.value;
+	    click_read_fence();
+	} while ((seq & 1) || s.seq != seq);
+	if (match)
+	    return true;
+	else if (state == s_empty)
+	    return false;
+    }
+}
+
+/** @brief Copy slot @a i's key and value, if it holds a live key.
+ * @param i slot index, less than slot_count()
+ * @return true iff the slot holds a key
+ *
+ * Safe to call from any thread, concurrently with writers; a key written
+ * during a walk over the slots may or may not be seen. */
+template <typename K, typename V>
+inline bool
+RCUHashTable<K, V>::slot(int i, K &key, V &value) const
+{
+    const Array *a = _array;
+    if (!a || (uint32_t) i > a->mask)
+	return false;
+    const Slot &s = a->slots[i];
+    uint32_t seq, state;
+    do {
+	seq = s.seq;
+	click_read_fence();
+	state = s.state;
+	if (state == s_live) {
+	    key = s.key;
+	    value = s.value;
+	}
+	click_read_fence();
+    } while ((seq & 1) || s.seq != seq);
+    return state == s_live;
+}
+
+template <typename K, typename V>
+void
+RCUHashTable<K, V>::write(Slot &s, const K &key, const V &value, uint32_t state)
+{
+    s.seq = s.seq + 1;
+    click_fence();
+    s.key = key;
+    s.value = value;
+    s.state = state;
+    click_fence();
+    s.seq = s.seq + 1;
+}
+
+/** @brief Set @a key's value to @a value, inserting it if necessary. */
+template <typename K, typename V>
+void
+RCUHashTable<K, V>::set(const K &key, const V &value)
+{
+    if ((!_array || (_array->used + 1) * 2 > _array->mask + 1)
+	&& !rebuild() && (!_array || _array->used == _array->mask))
+	return;
+    Array *a = _array;
+    Slot *avail = 0;
+    uint32_t i;
+    for (i = bucket(a, key); a->slots[i].state != s_empty; i = (i + 1) & a->mask) {
+	Slot &s = a->slots[i];
+	if (s.key == key) {
+	    // erased slots keep their keys, so this is the key's only slot
+	    if (s.state != s_live)
+		++_size;
+	    write(s, key, value, s_live);
+	    return;
+	} else if (s.state == s_erased && !avail)
+	    avail = &s;
+    }
+    if (!avail) {
+	avail = &a->slots[i];
+	++a->used;
+    }
+    write(*avail, key, value, s_live);
+    ++_size;
+}
+
+/** @brief Remove @a key.
+ * @return true iff @a key was present */
+template <typename K, typename V>
+bool
+RCUHashTable<K, V>::erase(const K &key)
+{
+    Array *a = _array;
+    if (!a)
+	return false;
+    for (uint32_t i = bucket(a, key); a->slots[i].state != s_empty; i = (i + 1) & a->mask) {
+	Slot &s = a->slots[i];
+	if (s.key == key) {
+	    if (s.state != s_live)
+		return false;
+	    write(s, s.key, s.value, s_erased);
+	    --_size;
+	    return true;
+	}
+    }
+    return false;
+}
+
+/** @brief Remove all keys. */
+template <typename K, typename V>
+void
+RCUHashTable<K, V>::clear()
+{
+    if (Array *a = _array) {
+	_array = 0;
+	retire(a);
+    }
+    _size = 0;
+}
+
+/** @brief Swap the contents of this table and @a x.
+ *
+ * Neither table may have concurrent readers. */
+template <typename K, typename V>
+void
+RCUHashTable<K, V>::swap(RCUHashTable<K, V> &x)
+{
+    Array *a = _array;
+    _array = x._array;
+    x._array = a;
+    click_swap(_size, x._size);
+    _retired.swap(x._retired);
+}
+
+template <typename K, typename V>
+bool
+RCUHashTable<K, V>::rebuild()
+{
+    uint32_t nslots = 8;
+    while (nslots < 4 * (uint32_t) (_size + 1))
+	nslots *= 2;
+    Array *n = reinterpret_cast<Array *>(CLICK_LALLOC(array_size(nslots)));
+    if (!n)
+	return false;
+    n->mask = nslots - 1;
+    n->used = 0;
+    for (uint32_t i = 0; i < nslots; ++i)
+	new((void *) &n->slots[i]) Slot();
+
+    // The new array is private until published, so no sequence numbers.
+    if (Array *a = _array)
+	for (uint32_t j = 0; j <= a->mask; ++j)
+	    if (a->slots[j].state == s_live) {
+		uint32_t i = bucket(n, a->slots[j].key);
+		while (n->slots[i].state != s_empty)
+		    i = (i + 1) & n->mask;
+		n->slots[i].key = a->slots[j].key;
+		n->slots[i].value = a->slots[j].value;
+		n->slots[i].state = s_live;
+		++n->used;
+	    }
+
+    click_fence();
+    Array *old = _array;
+    _array = n;
+    if (old)
+	retire(old);
+    return true;
+}
+
+template <typename K, typename V>
+void
+RCUHashTable<K, V>::retire(Array *a)
+{
+    Retired r;
+    r.array = a;
+    r.when = Timestamp::now_steady();
+    _retired.push_back(r);
+    reclaim();
+}
+
+/** @brief Free retired slot arrays.
+ * @param all if true, free all of them, even those retired less than a grace
+ * period ago; only safe when no reader can be running */
+template <typename K, typename V>
+void
+RCUHashTable<K, V>::reclaim(bool all)
+{
+    if (!_retired.size())
+	return;
+    Timestamp limit = Timestamp::now_steady() - Timestamp::make_msec(grace_msec);
+    int i = 0;
+    for (; i < _retired.size() && (all || _retired[i].when <= limit); ++i)
+	free_array(_retired[i].array);
+    _retired.erase(_retired.begin(), _retired.begin() + i);
+}
+
+template <typename K, typename V>
+void
+RCUHashTable<K, V>::free_array(Array *a)
+{
+    uint32_t nslots = a->mask + 1;
+    for (uint32_t i = 0; i < nslots; ++i)
+	a->slots[i].~Slot();
+    CLICK_LFREE(a, array_size(nslots));
+}
+
+CLICK_ENDDECLS
+#endif
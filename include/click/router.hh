@@ -6,6 +6,9 @@
 #include <click/sync.hh>
 #include <click/task.hh>
 #include <click/standard/threadsched.hh>
+#include <click/hashtable.hh>
+#include <click/pair.hh>
+#include <click/bitvector.hh>
 #if CLICK_NS
 # include <click/simclick.h>
 #endif
@@ -15,10 +18,13 @@ class ElementFilter;
 class RouterVisitor;
 class RouterThread;
 class HashMap_ArenaFactory;
+class Arena;
 class NotifierSignal;
 class ThreadSched;
 class Handler;
 class NameInfo;
+class Lexer;
+class LexerExtra;
 
 class Router { public:
 
@@ -31,6 +37,7 @@ class Router { public:
     inline bool initialized() const;
     inline bool handlers_ready() const;
     inline bool running() const;
+    inline bool paused() const;
 
     // RUNCOUNT AND RUNCLASS
     enum { STOP_RUNCOUNT = -2147483647 - 1 };
@@ -39,6 +46,10 @@ class Router { public:
     void set_runcount(int32_t rc);
     inline void please_stop_driver();
 
+    // FORWARDING EPOCH
+    inline uint32_t forwarding_epoch() const;
+    inline void bump_forwarding_epoch();
+
     // ELEMENTS
     inline const Vector<Element*>& elements() const;
     inline int nelements() const;
@@ -76,6 +87,16 @@ class Router { public:
     static int hindex(const Element *e, const String &hname);
     static const Handler *handler(const Router *router, int hindex);
     static void element_hindexes(const Element *e, Vector<int> &result);
+    static unsigned handler_generation();
+
+    // STATISTICS
+    // Fixed-layout counters registered by Element::add_stat(), read in
+    // batches by CLICK_LLRPC_GET_STATS; ids last until handlers are reset
+    enum { STAT_UINT32, STAT_UINT64, STAT_ATOMIC_UINT32, STAT_CALLBACK };
+    void add_stat(const Element *e, const char *name, int type, const void *data, StatCallback callback = 0);
+    inline int nstats() const;
+    String stat_name(int id) const;
+    uint64_t stat_value(int id) const;
 
     // ATTACHMENTS AND REQUIREMENTS
     void* attachment(const String& aname) const;
@@ -84,10 +105,15 @@ class Router { public:
 
     ErrorHandler* chatter_channel(const String& channel_name) const;
     HashMap_ArenaFactory* arena_factory() const;
+    void* arena_allocate(size_t size);
 
     inline ThreadSched* thread_sched() const;
     inline void set_thread_sched(ThreadSched* scheduler);
     inline int home_thread_id(const Element *e) const;
+    inline int headroom_required(const Element *e) const;
+    inline bool timestamp_required(const Element *e) const;
+    inline bool alignment_required(const Element *e, int &modulus, int &offset) const;
+    inline unsigned aligned_headroom(const Element *e, unsigned headroom) const;
 
     /** @cond never */
     // Needs to be public for NameInfo, but not useful outside
@@ -101,6 +127,13 @@ class Router { public:
     void unparse_requirements(StringAccum& sa, const String& indent = String()) const;
     void unparse_declarations(StringAccum& sa, const String& indent = String()) const;
     void unparse_connections(StringAccum& sa, const String& indent = String()) const;
+#if CLICK_USERLEVEL
+    void unparse_cache(StringAccum& sa) const;
+#endif
+#if HAVE_PUSH_FUSION
+    String fused_chains() const;
+#endif
+    inline const String &optimizations() const;
 
     String element_ports_string(const Element *e) const;
     //@}
@@ -118,15 +151,22 @@ class Router { public:
     void unuse();
 
     void add_requirement(const String &type, const String &value);
+    inline void set_optimizations(const String &report);
     int add_element(Element *e, const String &name, const String &conf, const String &filename, unsigned lineno);
     int add_connection(int from_idx, int from_port, int to_idx, int to_port);
+#if CLICK_USERLEVEL
+    int parse_cache(const String& cache, Lexer* lexer, LexerExtra* lextra, ErrorHandler* errh);
+#endif
 #if CLICK_LINUXMODULE
     int add_module_ref(struct module* module);
 #endif
 
     inline Router* hotswap_router() const;
     void set_hotswap_router(Router* router);
+    int hotswap_in_place(const Router* router, ErrorHandler* errh);
 
+    inline void set_configure_threads(int nthreads);
+    inline void set_push_fusion(bool fuse);
     int initialize(ErrorHandler* errh);
     void activate(bool foreground, ErrorHandler* errh);
     inline void activate(ErrorHandler* errh);
@@ -212,6 +252,8 @@ class Router { public:
   private:
 
     class RouterContextErrh;
+    class ConfigureErrh;
+    struct ConcurrentConfigure;
 
     enum {
 	ROUTER_NEW, ROUTER_PRECONFIGURE, ROUTER_PREINITIALIZE,
@@ -225,12 +267,14 @@ class Router { public:
     Master* _master;
 
     atomic_uint32_t _runcount;
+    atomic_uint32_t _forwarding_epoch;
 
     volatile int _state;
     bool _have_connections : 1;
     mutable bool _conn_sorted : 1;
     bool _have_configuration : 1;
     volatile int _running;
+    atomic_uint32_t _paused;
 
     atomic_uint32_t _refcount;
 
@@ -239,6 +283,10 @@ class Router { public:
     Vector<String> _element_configurations;
     Vector<uint32_t> _element_landmarkids;
     mutable Vector<int> _element_home_thread_ids;
+    Vector<int> _element_headroom;
+    Bitvector _element_timestamp;
+    bool _timestamps_analyzed;
+    Vector<int> _element_alignment;	// modulus << 4 | offset, or 0
 
     struct element_landmark_t {
 	uint32_t first_landmarkid;
@@ -247,21 +295,48 @@ class Router { public:
     Vector<element_landmark_t> _element_landmarks;
     uint32_t _last_landmarkid;
 
-    mutable Vector<int> _element_name_sorter;
+    HashTable<String, int> _element_name_map;
     Vector<int> _element_gport_offset[2];
     Vector<int> _element_configure_order;
+    int _configure_threads;
+    bool _push_fusion;
+#if HAVE_PUSH_FUSION
+    Vector<Element*> _fused_chains;
+#endif
 
     mutable Vector<Connection> _conn;
     mutable Vector<int> _conn_output_sorter;
 
+    // Graph index built at initialization.  The connections from global
+    // port g are _conn_first[isoutput][g] up to _conn_first[isoutput][g+1]
+    // (in _conn_output_sorter order for outputs).  The complementary ports
+    // reachable through an element from g are listed in _flow_port, from
+    // _flow_first[isoutput][g] up to _flow_first[isoutput][g+1]; an entry of
+    // -1 stands for every port.
+    bool _have_flow_index;
+    Vector<int> _conn_first[2];
+    Vector<int> _flow_first[2];
+    Vector<int> _flow_port[2];
+
     Vector<String> _requirements;
+    String _optimizations;
 
     Vector<int> _ehandler_first_by_element;
     Vector<int> _ehandler_to_handler;
+    HashTable<Pair<int, String>, int> _ehandler_map;
     Vector<int> _ehandler_next;
 
     Vector<int> _handler_first_by_name;
 
+    struct Stat {
+	int eindex;
+	int type;
+	const char *name;
+	const void *data;
+	StatCallback callback;
+    };
+    Vector<Stat> _stats;
+
     enum { HANDLER_BUFSIZ = 256 };
     Handler** _handler_bufs;
     int _nhandlers_bufs;
@@ -286,6 +361,11 @@ class Router { public:
     };
     notifier_signals_t *_notifier_signals;
     HashMap_ArenaFactory* _arena_factory;
+    Arena* _arena;
+    Spinlock _arena_lock;
+#if HAVE_STRING_ARENA
+    String::Arena* _string_arena;
+#endif
     Router* _hotswap_router;
     ThreadSched* _thread_sched;
     mutable NameInfo* _name_info;
@@ -308,13 +388,29 @@ class Router { public:
     int check_hookup_range(ErrorHandler*);
     int check_hookup_completeness(ErrorHandler*);
 
+    const element_landmark_t &element_landmark(int eindex, unsigned &lineno) const;
+    int configure_element(int eindex, ErrorHandler *errh);
+    int initialize_element(int eindex, ErrorHandler *errh);
+    void configure_concurrently(const Vector<int> &eindexes, bool initialize, Vector<int> &element_stage, ErrorHandler *errh);
+
     const char *hard_flow_code_override(int e) const;
     int processing_error(const Connection &conn, bool, int, ErrorHandler*);
     int check_push_and_pull(ErrorHandler*);
 
     void set_connections();
+    void analyze_headroom();
+    void analyze_timestamps();
+    void analyze_alignment();
+#if HAVE_PUSH_FUSION
+    void fuse_push_chains();
+#endif
+#if HAVE_DIRECT_PORT_TRANSFER
+    void set_direct_pushes();
+#endif
     void sort_connections() const;
     int connindex_lower_bound(bool isoutput, const Port &port) const;
+    void build_flow_index();
+    bool indexed_port_flow(bool isoutput, const Element *e, int port, Bitvector *travels) const;
 
     void make_gports();
     inline int ngports(bool isout) const {
@@ -345,6 +441,7 @@ class Router { public:
     friend class Master;
     friend class Task;
     friend int Element::set_nports(int, int);
+    friend void Element::port_flow(bool, int, Bitvector *) const;
     /** @endcond never */
 
 };
@@ -372,6 +469,17 @@ Router::running() const
     return _running > 0;
 }
 
+/** @brief  Return true iff the router's timers and selects are paused.
+ *
+ *  The Master pauses a router while it is being initialized or killed.
+ *  Threads do not fire a paused router's timers or call its elements'
+ *  selected() methods; other routers in the same process keep running. */
+inline bool
+Router::paused() const
+{
+    return _paused != 0;
+}
+
 /** @brief  Return true iff the router has been successfully initialized. */
 inline bool
 Router::initialized() const
@@ -379,6 +487,16 @@ Router::initialized() const
     return _state == ROUTER_LIVE;
 }
 
+/** @brief  Return the number of registered statistics.
+ *
+ * Statistic ids range from 0 to nstats() - 1.
+ * @sa Element::add_stat, stat_name, stat_value */
+inline int
+Router::nstats() const
+{
+    return _stats.size();
+}
+
 /** @brief  Return true iff the router's handlers have been initialized.
  *
  *  handlers_ready() returns false until each element's
@@ -452,6 +570,74 @@ Router::home_thread_id(const Element *e) const
 	return hard_home_thread_id(e);
 }
 
+/** @brief Return the headroom needed by packets that @a e emits.
+ *
+ * The result is the largest total encapsulation, in bytes, that elements
+ * downstream of @a e might push onto a packet, computed from their
+ * Element::encap_headroom() values.  It is available once every element has
+ * been configured, so packet sources may consult it in initialize() to
+ * allocate packets that never need Packet::expensive_push().  Returns 0
+ * before that point. */
+inline int
+Router::headroom_required(const Element *e) const
+{
+    int i = e->eindex();
+    return i < _element_headroom.size() ? _element_headroom[i] : 0;
+}
+
+/** @brief Return true iff packets that @a e emits need timestamp annotations.
+ *
+ * The result is true if some element downstream of @a e declares the
+ * <tt>T</tt> flag, meaning it reads packets' timestamp annotations (see
+ * Element::flags()).  Like headroom_required(), it is available once every
+ * element has been configured, so packet sources may consult it in
+ * initialize() and skip the clock read for packets nobody will look at.
+ * Returns true before that point. */
+inline bool
+Router::timestamp_required(const Element *e) const
+{
+    return !_timestamps_analyzed || _element_timestamp[e->eindex()];
+}
+
+/** @brief Return the alignment wanted for packets that @a e emits.
+ * @param e element
+ * @param[out] modulus power of two between 2 and 8
+ * @param[out] offset offset from a @a modulus-byte boundary
+ *
+ * Returns true and sets @a modulus and @a offset if elements downstream of
+ * @a e want packet data to start @a offset bytes past a @a modulus-byte
+ * boundary, as computed from their Element::input_alignment() and
+ * Element::data_shift() values.  Paths that want different alignments are
+ * reconciled to the strongest alignment they share.  Like
+ * headroom_required(), it is available once every element has been
+ * configured.  Returns false before that point or if nothing downstream
+ * cares. */
+inline bool
+Router::alignment_required(const Element *e, int &modulus, int &offset) const
+{
+    int i = e->eindex();
+    if (i >= _element_alignment.size() || _element_alignment[i] < (2 << 4))
+	return false;
+    modulus = _element_alignment[i] >> 4;
+    offset = _element_alignment[i] & 15;
+    return true;
+}
+
+/** @brief Return the least headroom, at least @a headroom, at which packets
+ * that @a e emits meet alignment_required().
+ *
+ * Packet buffers start at least 8-byte aligned, so a source that allocates
+ * packets with this much headroom gives downstream elements the alignment
+ * they want without an @e Align copy. */
+inline unsigned
+Router::aligned_headroom(const Element *e, unsigned headroom) const
+{
+    int modulus, offset;
+    if (alignment_required(e, modulus, offset))
+	headroom += (offset - headroom) & (modulus - 1);
+    return headroom;
+}
+
 /** @cond never */
 /** @brief  Return the NameInfo object for this router, if it exists.
  *
@@ -493,6 +679,29 @@ Router::please_stop_driver()
     adjust_runcount(-1);
 }
 
+/** @brief  Return a number that changes whenever forwarding state changes.
+ *
+ *  Elements that memoize forwarding decisions, such as FlowCache, record
+ *  forwarding_epoch() with each decision and ignore decisions whose epoch is
+ *  out of date.  The epoch advances when an element is reconfigured through
+ *  its "config" handler or a keyword handler, and when elements that own
+ *  forwarding state, such as IPRouteTable, call bump_forwarding_epoch(). */
+inline uint32_t
+Router::forwarding_epoch() const
+{
+    return _forwarding_epoch.value();
+}
+
+/** @brief  Advance forwarding_epoch(), invalidating memoized decisions.
+ *
+ *  Call this after changing state that affects where packets go, such as a
+ *  routing table. */
+inline void
+Router::bump_forwarding_epoch()
+{
+    ++_forwarding_epoch;
+}
+
 /** @brief Returns the overriding flow code for element @a e, if any.
  *  @param eindex element index
  *  @return The flow code, or null if none has been set. */
@@ -518,6 +727,59 @@ Router::set_foreground(bool foreground)
     _running = foreground ? RUNNING_ACTIVE : RUNNING_BACKGROUND;
 }
 
+/** @brief Sets the number of threads used to configure elements.
+ *  @param nthreads number of threads
+ *
+ *  When @a nthreads is greater than 1, initialize() configures elements
+ *  that declare the <tt>C</tt> flag, and initializes elements that declare
+ *  the <tt>I</tt> flag, on up to @a nthreads threads at once.  See
+ *  Element::flags().  Has no effect on drivers without multithreading
+ *  support. */
+inline void
+Router::set_configure_threads(int nthreads)
+{
+    _configure_threads = nthreads;
+}
+
+/** @brief  Sets whether initialize() fuses push chains.
+ *  @param fuse true to fuse chains
+ *
+ *  When @a fuse is true, the default, initialize() collapses each chain of
+ *  push elements that pass packets from input 0 to output 0 using only
+ *  simple_action() into a single loop, so that packets entering the chain
+ *  reach its end without one indirect call and stack frame per element.
+ *  The global "fused_chains" handler lists the fused chains.  Packet
+ *  processing is unchanged; profiling and packet tracing, when on, see
+ *  every element as usual.  Builds with CLICK_STATS port statistics, or
+ *  compilers without GCC's bound member function extension, never fuse. */
+inline void
+Router::set_push_fusion(bool fuse)
+{
+    _push_fusion = fuse;
+}
+
+/** @brief  Returns the report of load-time optimizations.
+ *
+ *  The report has one line per change the Lexer made to the flattened
+ *  configuration before creating this router, such as "xform IPInput@1:
+ *  Paint@1 Strip@2 CheckIPHeader@3" for a pattern replacement or "dead x"
+ *  for a removed element.  The global "optimizations" handler returns it.
+ *  Routers read from the configuration cache have an empty report.
+ *  @sa Lexer::add_patterns(), Lexer::set_undead() */
+inline const String &
+Router::optimizations() const
+{
+    return _optimizations;
+}
+
+/** @brief  Sets the report of load-time optimizations.
+ *  @sa optimizations() */
+inline void
+Router::set_optimizations(const String &report)
+{
+    _optimizations = report;
+}
+
 /** @brief  Finds an element named @a name.
  *  @param  name     element name
  *  @param  errh     optional error handler
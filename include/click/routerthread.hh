@@ -52,6 +52,7 @@ class RouterThread : private TaskLink { public:
     inline void schedule_block_tasks();
     inline void block_tasks(bool scheduled);
     inline void unblock_tasks();
+    inline bool current_thread_is_running() const;
 
     inline bool stop_flag() const;
 
@@ -80,6 +81,75 @@ class RouterThread : private TaskLink { public:
     inline void run_signals();
 #endif
 
+#if HAVE_MULTITHREAD
+    /** @brief Return the number of tasks this thread has handed to idle
+     * threads by work stealing. */
+    unsigned task_steals() const	{ return _task_steals; }
+
+    /** @brief Return the number of times this thread was woken to process
+     * newly pending tasks.
+     *
+     * Only the task that makes the pending list nonempty wakes the thread,
+     * so this is often much smaller than the number of cross-thread
+     * reschedules. */
+    uint32_t pending_wakeups() const	{ return _pending_wakeups; }
+    /** @brief Return the number of times another thread waited to lock
+     * this thread's tasks. */
+    uint32_t task_lock_contention() const { return _task_lock_contention; }
+    /** @brief Return the number of times this thread's driver waited for
+     * other threads to release its tasks. */
+    uint32_t driver_lock_contention() const { return _driver_lock_contention; }
+#endif
+
+#if CLICK_USERLEVEL
+    /** @brief Turn on adaptive idle polling.
+     * @param spin empty driver iterations spent spinning
+     * @param pause further empty iterations that each pause the CPU
+     * @param yield further empty iterations that each yield the CPU
+     * @param sleep maximum time of each later sleep; zero means never sleep
+     *
+     * An empty iteration is one in which the thread has scheduled tasks but
+     * none of them does any work, as when polling tasks find no packets.
+     * From then on, the thread backs off in stages until a task does work
+     * again.  A sleeping thread still wakes as soon as one of its file
+     * descriptors is ready, a timer expires, or another thread reschedules
+     * one of its tasks. */
+    void set_idle_poll(unsigned spin, unsigned pause, unsigned yield,
+		       const Timestamp &sleep);
+    /** @brief Turn off adaptive idle polling. */
+    void clear_idle_poll();
+    bool idle_poll() const		{ return _idle_poll; }
+    unsigned idle_spin() const		{ return _idle_spin; }
+    unsigned idle_pause() const		{ return _idle_pause; }
+    unsigned idle_yield() const		{ return _idle_yield; }
+    const Timestamp &idle_sleep() const	{ return _idle_sleep; }
+    /** @brief Return the number of idle iterations that paused, yielded,
+     * or slept, respectively. */
+    unsigned idle_pauses() const	{ return _idle_pauses; }
+    unsigned idle_yields() const	{ return _idle_yields; }
+    unsigned idle_sleeps() const	{ return _idle_sleeps; }
+
+    inline bool idle_sleeping() const	{ return _idle_sleeping; }
+    inline int select_delay(Timestamp &t) const;
+
+    /** @brief Return the CPU this thread is to be pinned to, or -1. */
+    int cpu() const			{ return _cpu; }
+    /** @brief Return the NUMA node of cpu(), or -1 if unknown. */
+    int numa_node() const		{ return _numa_node; }
+    /** @brief Set the CPU this thread is to be pinned to.
+     *
+     * Does not itself pin the thread; the driver does that when the thread
+     * starts.  Also looks up the CPU's NUMA node. */
+    void set_cpu(int cpu);
+    /** @brief Return the NUMA node of @a cpu, or -1 if unknown. */
+    static int cpu_numa_node(int cpu);
+    /** @brief Prefer @a node for the calling thread's new memory.
+     *
+     * If @a node is negative, restores the default policy of allocating
+     * memory on the node of the CPU that first touches it. */
+    static void set_preferred_numa_node(int node);
+#endif
+
     enum { S_PAUSED, S_BLOCKED, S_TIMERWAIT,
 	   S_LOCKSELECT, S_LOCKTASKS,
 	   S_RUNTASK, S_RUNTIMER, S_RUNSIGNAL, S_RUNPENDING, S_RUNSELECT,
@@ -118,12 +188,22 @@ class RouterThread : private TaskLink { public:
 	    : pass(t_->_pass), t(t_) {
 	}
     };
+    // A 4-ary heap: a node's children are 64 adjacent bytes on 64-bit
+    // hosts, and sift-down visits half as many levels as in a binary heap.
+    enum { task_heap_arity = 4 };
     Vector<task_heap_element> _task_heap;
 #endif
 
-    uintptr_t _pending_head;
-    volatile uintptr_t *_pending_tail;
+    // Tasks waiting to be processed by this thread, most recently added
+    // first.  Any thread may push onto the list with compare-and-swap;
+    // _pending_lock serializes only claiming the list and removing tasks.
+    volatile uintptr_t _pending_head;
     SpinlockIRQ _pending_lock;
+#if HAVE_MULTITHREAD
+    atomic_uint32_t _pending_wakeups;
+    atomic_uint32_t _task_lock_contention;
+    uint32_t _driver_lock_contention;
+#endif
 
     Master *_master;
     int _id;
@@ -138,9 +218,31 @@ class RouterThread : private TaskLink { public:
     atomic_uint32_t _task_blocker;
     atomic_uint32_t _task_blocker_waiting;
 
+#if HAVE_MULTITHREAD
+    // work stealing: 1 + ID of an idle thread that wants one of our tasks
+    atomic_uint32_t _steal_request;
+    int _steal_victim;
+    unsigned _task_steals;
+#endif
+
     TimerSet _timers;
 #if CLICK_USERLEVEL
     SelectSet _selects;
+
+    int _cpu;
+    int _numa_node;
+
+    // adaptive idle polling
+    bool _idle_poll;
+    bool _idle_sleeping;		// next select() may block while active
+    unsigned _idle_spin;
+    unsigned _idle_pause;
+    unsigned _idle_yield;
+    Timestamp _idle_sleep;
+    unsigned _empty_runs;		// consecutive empty iterations
+    unsigned _idle_pauses;
+    unsigned _idle_yields;
+    unsigned _idle_sleeps;
 #endif
 
 #if CLICK_LINUXMODULE
@@ -205,9 +307,16 @@ class RouterThread : private TaskLink { public:
     // task running functions
     inline void driver_lock_tasks();
     inline void driver_unlock_tasks();
-    inline void run_tasks(int ntasks);
+    inline bool run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+#if CLICK_USERLEVEL
+    inline void idle_backoff(bool worked);
+#endif
+#if HAVE_MULTITHREAD
+    void request_steal();
+    void donate_task();
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
@@ -215,10 +324,11 @@ class RouterThread : private TaskLink { public:
 #if HAVE_TASK_HEAP
     void task_reheapify_from(int pos, Task*);
 #endif
-    inline bool current_thread_is_running() const;
     void request_stop();
     inline void request_go();
 
+    static inline uintptr_t pending_compare_swap(volatile uintptr_t &x, uintptr_t expected, uintptr_t desired);
+
     friend class Task;
     friend class Master;
 #if CLICK_USERLEVEL
@@ -359,11 +469,15 @@ RouterThread::block_tasks(bool scheduled)
     assert(!current_thread_is_running());
     if (!scheduled)
 	++_task_blocker_waiting;
-    while (1) {
+    for (int tries = 0; ; ++tries) {
 	uint32_t blocker = _task_blocker.value();
 	if ((int32_t) blocker >= 0
 	    && _task_blocker.compare_swap(blocker, blocker + 1) == blocker)
 	    break;
+#if HAVE_MULTITHREAD
+	if (tries == 0)
+	    ++_task_lock_contention;
+#endif
 #if CLICK_LINUXMODULE
 	// 3.Nov.2008: Must allow other threads a chance to run.  Otherwise,
 	// soft lock is possible: the thread in block_tasks() waits for
@@ -424,9 +538,27 @@ RouterThread::wake()
 inline void
 RouterThread::add_pending()
 {
+#if HAVE_MULTITHREAD
+    ++_pending_wakeups;
+#endif
     wake();
 }
 
+inline uintptr_t
+RouterThread::pending_compare_swap(volatile uintptr_t &x, uintptr_t expected, uintptr_t desired)
+{
+#if CLICK_LINUXMODULE
+    return cmpxchg(&x, expected, desired);
+#elif HAVE_MULTITHREAD
+    return __sync_val_compare_and_swap(&x, expected, desired);
+#else
+    uintptr_t actual = x;
+    if (actual == expected)
+	x = desired;
+    return actual;
+#endif
+}
+
 inline bool
 RouterThread::stop_flag() const
 {
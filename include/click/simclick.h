@@ -46,11 +46,31 @@ typedef struct simclick_node {
     struct timeval curtime;
 } simclick_node_t;
 
+/*
+ * Nodes created from the same router_file share one parsed copy of the
+ * configuration: the file is read and lexed once, and the elements'
+ * configuration strings point into shared memory.
+ */
 int simclick_click_create(simclick_node_t *sim, const char *router_file);
 
 int simclick_click_send(simclick_node_t *sim,
 			int ifid,int type,const unsigned char* data,int len,
 			simclick_simpacketinfo* pinfo);
+
+/*
+ * simclick_click_send_batch delivers n packets that arrive at the same
+ * time, then runs the router once, rather than once per packet.
+ */
+typedef struct {
+    int ifid;
+    int type;
+    const unsigned char *data;
+    int len;
+    simclick_simpacketinfo *pinfo;
+} simclick_packet_t;
+
+int simclick_click_send_batch(simclick_node_t *sim,
+			      const simclick_packet_t *packets, int n);
 int simclick_sim_send(simclick_node_t *sim,
 		      int ifid,int type, const unsigned char* data,int len,
 		      simclick_simpacketinfo*);
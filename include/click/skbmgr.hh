@@ -12,5 +12,15 @@ struct sk_buff *skbmgr_allocate_skbs(unsigned headroom, unsigned size, int *want
 /* recycle skb back into pool */
 void skbmgr_recycle_skbs(struct sk_buff *);
 
+struct skbmgr_stats {
+  unsigned long hits;		/* allocations served by recycled skbs */
+  unsigned long misses;		/* allocations from the kernel */
+  unsigned long recycled;	/* skbs kept for reuse */
+  unsigned long freed;		/* skbs returned to the kernel */
+};
+
+/* sum the statistics of every CPU's pool */
+void skbmgr_get_stats(struct skbmgr_stats *);
+
 CLICK_ENDDECLS
 #endif
@@ -0,0 +1,443 @@
+#ifndef CLICK_SMALLVECTOR_HH
+#define CLICK_SMALLVECTOR_HH
+#include <click/vector.hh>
+CLICK_DECLS
+
+/** @file <click/smallvector.hh>
+  @brief Click's vector template with inline storage. */
+
+/** @class SmallVector
+  @brief Vector with room for N elements inside the object.
+
+  SmallVector<T, N> has the same interface as Vector<T>, but its first N
+  elements are stored in the SmallVector object itself. A SmallVector that
+  never grows past N elements never allocates memory, which makes it a good
+  choice for short-lived temporaries on per-packet paths, such as a route or
+  a list of candidate rates built on the stack. When the SmallVector grows
+  past N elements it moves to the heap, like a Vector, and stays there until
+  it is destroyed.
+
+  Iterators are pointers, as with Vector. Unlike Vector, swap() and
+  assignment copy elements when either operand is stored inline, and a
+  SmallVector's elements move when it first grows past N.
+
+  SmallVector interoperates with Vector: a SmallVector can be constructed from
+  or assigned from a Vector, and vector() returns a Vector copy.
+
+  Example code:
+  @code
+  SmallVector<IPAddress, 8> route;  // no allocation
+  for (Host *h = dst; h; h = h->prev)
+      route.push_back(h->ip);       // allocates only on the 9th push_back
+  @endcode
+
+  @sa Vector */
+template <typename T, int N>
+class SmallVector {
+
+    typedef typename array_memory<T>::type array_memory_type;
+    typedef typename array_memory_type::type memory_object;
+
+  public:
+
+    /** @brief Value type. */
+    typedef T value_type;
+
+    /** @brief Reference to value type. */
+    typedef T &reference;
+
+    /** @brief Const reference to value type. */
+    typedef const T &const_reference;
+
+    /** @brief Pointer to value type. */
+    typedef T *pointer;
+
+    /** @brief Pointer to const value type. */
+    typedef const T *const_pointer;
+
+    /** @brief Type used for value arguments (either T or const T &). */
+    typedef typename fast_argument<T>::type value_argument_type;
+
+    typedef const T &const_access_type;
+
+    /** @brief Type of sizes (size()). */
+    typedef int size_type;
+
+    /** @brief Iterator type. */
+    typedef T *iterator;
+
+    /** @brief Const iterator type. */
+    typedef const T *const_iterator;
+
+    /** @brief Number of elements stored inline. */
+    enum { inline_capacity = N };
+
+
+    /** @brief Construct an empty vector. */
+    SmallVector()
+	: l_(inline_data()), n_(0), capacity_(N) {
+    }
+
+    /** @brief Construct a vector containing @a n copies of @a v. */
+    explicit SmallVector(size_type n, value_argument_type v)
+	: l_(inline_data()), n_(0), capacity_(N) {
+	resize(n, v);
+    }
+
+    /** @brief Construct a vector as a copy of @a x. */
+    SmallVector(const SmallVector<T, N> &x)
+	: l_(inline_data()), n_(0), capacity_(N) {
+	assign_range((const memory_object *) x.begin(), x.size());
+    }
+
+    /** @brief Construct a vector as a copy of the Vector @a x. */
+    explicit SmallVector(const Vector<T> &x)
+	: l_(inline_data()), n_(0), capacity_(N) {
+	assign_range((const memory_object *) x.begin(), x.size());
+    }
+
+    /** @brief Destroy the vector, freeing any heap memory. */
+    ~SmallVector() {
+	array_memory_type::destroy(l_, n_);
+	if (l_ != inline_data())
+	    CLICK_LFREE(l_, capacity_ * sizeof(memory_object));
+    }
+
+
+    /** @brief Return the number of elements. */
+    size_type size() const {
+	return n_;
+    }
+
+    /** @brief Test if the vector is empty (size() == 0). */
+    bool empty() const {
+	return n_ == 0;
+    }
+
+    /** @brief Return the vector's capacity.
+
+	The capacity is at least N. */
+    size_type capacity() const {
+	return capacity_;
+    }
+
+    /** @brief Test if the elements are stored inside the SmallVector. */
+    bool is_inline() const {
+	return l_ == inline_data();
+    }
+
+
+    /** @brief Return an iterator for the first element in the vector. */
+    iterator begin() {
+	return (iterator) l_;
+    }
+    /** @overload */
+    const_iterator begin() const	{ return (const_iterator) l_; }
+
+    /** @brief Return an iterator for the end of the vector.
+      @invariant end() == begin() + size() */
+    iterator end() {
+	return (iterator) l_ + n_;
+    }
+    /** @overload */
+    const_iterator end() const		{ return (const_iterator) l_ + n_; }
+
+
+    /** @brief Return a reference to the <em>i</em>th element.
+      @pre 0 <= @a i < size() */
+    T &operator[](size_type i) {
+	assert((unsigned) i < (unsigned) n_);
+	return *(T *) &l_[i];
+    }
+    /** @overload */
+    const T &operator[](size_type i) const {
+	assert((unsigned) i < (unsigned) n_);
+	return *(const T *) &l_[i];
+    }
+    /** @brief Return a reference to the <em>i</em>th element.
+      @pre 0 <= @a i < size()
+      @sa operator[]() */
+    T &at(size_type i) {
+	return operator[](i);
+    }
+    /** @overload */
+    const T &at(size_type i) const	{ return operator[](i); }
+
+    /** @brief Return a reference to the first element.
+      @pre !empty() */
+    T &front() {
+	return operator[](0);
+    }
+    /** @overload */
+    const T &front() const		{ return operator[](0); }
+
+    /** @brief Return a reference to the last element (number size()-1).
+      @pre !empty() */
+    T &back() {
+	return operator[](n_ - 1);
+    }
+    /** @overload */
+    const T &back() const		{ return operator[](n_ - 1); }
+
+    /** @brief Return a reference to the <em>i</em>th element.
+      @pre 0 <= @a i < size()
+
+      Unlike operator[]() and at(), this function does not check bounds,
+      even if assertions are enabled. Use with caution. */
+    T &unchecked_at(size_type i) {
+	return *(T *) &l_[i];
+    }
+    /** @overload */
+    const T &unchecked_at(size_type i) const	{ return *(const T *) &l_[i]; }
+
+
+    /** @brief Resize the vector to contain @a n elements.
+      @param n new size
+      @param v value used to fill new elements */
+    void resize(size_type n, value_argument_type v = T());
+
+    /** @brief Append element @a v.
+
+      A copy of @a v is inserted at position size(). Takes amortized O(1)
+      time. */
+    void push_back(value_argument_type v) {
+	if (n_ < capacity_) {
+	    array_memory_type::mark_undefined(l_ + n_, 1);
+	    array_memory_type::fill(l_ + n_, 1, (const memory_object *) &v);
+	    ++n_;
+	} else
+	    reserve_and_push_back(-1, (const memory_object *) &v);
+    }
+
+    /** @brief Remove the last element.
+
+      Takes O(1) time. */
+    void pop_back() {
+	assert(n_ > 0);
+	--n_;
+	array_memory_type::destroy(l_ + n_, 1);
+	array_memory_type::mark_noaccess(l_ + n_, 1);
+    }
+
+    /** @brief Insert @a v before position @a it.
+      @return An iterator pointing at the new element. */
+    iterator insert(iterator it, value_argument_type v);
+
+    /** @brief Remove the element at position @a it.
+      @return An iterator pointing at the element following @a it. */
+    iterator erase(iterator it) {
+	return (it < end() ? erase(it, it + 1) : it);
+    }
+
+    /** @brief Remove the elements in [@a a, @a b).
+      @return An iterator corresponding to @a b. */
+    iterator erase(iterator a, iterator b);
+
+    /** @brief Remove all elements.
+      @post size() == 0
+
+      Heap memory, if any, is kept for reuse. */
+    void clear() {
+	array_memory_type::destroy(l_, n_);
+	array_memory_type::mark_noaccess(l_, n_);
+	n_ = 0;
+    }
+
+    /** @brief Reserve space for at least @a n elements.
+      @return true iff reserve succeeded. */
+    bool reserve(size_type n) {
+	return reserve_and_push_back(n, 0);
+    }
+
+
+    /** @brief Replace this vector's contents with a copy of @a x. */
+    SmallVector<T, N> &operator=(const SmallVector<T, N> &x) {
+	if (&x != this)
+	    assign_range((const memory_object *) x.begin(), x.size());
+	return *this;
+    }
+
+    /** @brief Replace this vector's contents with a copy of the Vector @a x. */
+    SmallVector<T, N> &operator=(const Vector<T> &x) {
+	assign_range((const memory_object *) x.begin(), x.size());
+	return *this;
+    }
+
+    /** @brief Replace this vector's contents with @a n copies of @a v.
+      @post size() == @a n */
+    SmallVector<T, N> &assign(size_type n, value_argument_type v = T()) {
+	T v_copy(v);
+	clear();
+	resize(n, v_copy);
+	return *this;
+    }
+
+    /** @brief Return a Vector containing a copy of this vector's elements. */
+    Vector<T> vector() const {
+	Vector<T> v;
+	if (v.reserve(n_))
+	    for (size_type i = 0; i != n_; ++i)
+		v.push_back(unchecked_at(i));
+	return v;
+    }
+
+    /** @brief Swap the contents of this vector and @a x.
+
+      Takes O(1) time if both vectors are on the heap; otherwise copies
+      elements. */
+    void swap(SmallVector<T, N> &x);
+
+  private:
+
+    memory_object *l_;
+    size_type n_;
+    size_type capacity_;
+    char inline_[N * sizeof(memory_object)] __attribute__((aligned(__alignof__(memory_object))));
+
+    memory_object *inline_data() {
+	return reinterpret_cast<memory_object *>(inline_);
+    }
+    const memory_object *inline_data() const {
+	return reinterpret_cast<const memory_object *>(inline_);
+    }
+    bool need_argument_copy(const memory_object *argp) const {
+	return fast_argument<T>::is_reference
+	    && (uintptr_t) argp - (uintptr_t) l_ < (size_t) (n_ * sizeof(memory_object));
+    }
+    bool reserve_and_push_back(size_type want, const memory_object *push_vp);
+    void assign_range(const memory_object *x, size_type n);
+
+};
+
+/** @cond never */
+template <typename T, int N>
+bool SmallVector<T, N>::reserve_and_push_back(size_type want, const memory_object *push_vp)
+{
+    if (unlikely(push_vp && need_argument_copy(push_vp))) {
+	memory_object push_v_copy(*push_vp);
+	return reserve_and_push_back(want, &push_v_copy);
+    }
+
+    if (want < 0)
+	want = (capacity_ > 0 ? capacity_ * 2 : 4);
+
+    if (want > capacity_) {
+	memory_object *new_l = (memory_object *) CLICK_LALLOC(want * sizeof(memory_object));
+	if (!new_l)
+	    return false;
+	array_memory_type::mark_noaccess(new_l + n_, want - n_);
+	array_memory_type::move(new_l, l_, n_);
+	if (l_ != inline_data())
+	    CLICK_LFREE(l_, capacity_ * sizeof(memory_object));
+	l_ = new_l;
+	capacity_ = want;
+    }
+
+    if (unlikely(push_vp))
+	push_back(*(const T *) push_vp);
+    return true;
+}
+
+template <typename T, int N>
+void SmallVector<T, N>::assign_range(const memory_object *x, size_type n)
+{
+    clear();
+    if (reserve_and_push_back(n, 0)) {
+	array_memory_type::mark_undefined(l_, n);
+	array_memory_type::copy(l_, x, n);
+	n_ = n;
+    }
+}
+
+template <typename T, int N>
+void SmallVector<T, N>::resize(size_type n, value_argument_type v)
+{
+    const memory_object *vp = (const memory_object *) &v;
+    if (unlikely(need_argument_copy(vp))) {
+	T v_copy(v);
+	return resize(n, v_copy);
+    }
+
+    if (n <= capacity_ || reserve_and_push_back(n, 0)) {
+	assert(n >= 0);
+	if (n < n_) {
+	    array_memory_type::destroy(l_ + n, n_ - n);
+	    array_memory_type::mark_noaccess(l_ + n, n_ - n);
+	}
+	if (n_ < n) {
+	    array_memory_type::mark_undefined(l_ + n_, n - n_);
+	    array_memory_type::fill(l_ + n_, n - n_, vp);
+	}
+	n_ = n;
+    }
+}
+
+template <typename T, int N>
+typename SmallVector<T, N>::iterator SmallVector<T, N>::insert(iterator it, value_argument_type v)
+{
+    assert(it >= begin() && it <= end());
+    const memory_object *vp = (const memory_object *) &v;
+    if (unlikely(need_argument_copy(vp))) {
+	T v_copy(v);
+	return insert(it, v_copy);
+    }
+
+    if (n_ == capacity_) {
+	size_type pos = it - begin();
+	if (!reserve_and_push_back(-1, 0))
+	    return end();
+	it = begin() + pos;
+    }
+    memory_object *mit = (memory_object *) it;
+    array_memory_type::mark_undefined(l_ + n_, 1);
+    array_memory_type::move(mit + 1, mit, l_ + n_ - mit);
+    array_memory_type::mark_undefined(mit, 1);
+    array_memory_type::fill(mit, 1, vp);
+    ++n_;
+    return it;
+}
+
+template <typename T, int N>
+typename SmallVector<T, N>::iterator SmallVector<T, N>::erase(iterator a, iterator b)
+{
+    if (a < b) {
+	assert(a >= begin() && b <= end());
+	memory_object *ma = (memory_object *) a, *mb = (memory_object *) b;
+	array_memory_type::move_onto(ma, mb, l_ + n_ - mb);
+	n_ -= mb - ma;
+	array_memory_type::destroy(l_ + n_, mb - ma);
+	array_memory_type::mark_noaccess(l_ + n_, mb - ma);
+	return a;
+    } else
+	return b;
+}
+
+template <typename T, int N>
+void SmallVector<T, N>::swap(SmallVector<T, N> &x)
+{
+    if (l_ != inline_data() && x.l_ != x.inline_data()) {
+	click_swap(l_, x.l_);
+	click_swap(n_, x.n_);
+	click_swap(capacity_, x.capacity_);
+    } else if (&x != this) {
+	SmallVector<T, N> tmp(*this);
+	*this = x;
+	x = tmp;
+    }
+}
+/** @endcond never */
+
+template <typename T, int N>
+inline void click_swap(SmallVector<T, N> &a, SmallVector<T, N> &b)
+{
+    a.swap(b);
+}
+
+template <typename T, int N>
+inline void assign_consume(SmallVector<T, N> &a, SmallVector<T, N> &b)
+{
+    a.swap(b);
+}
+
+CLICK_ENDDECLS
+#endif
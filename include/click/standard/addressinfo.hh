@@ -7,6 +7,7 @@
 # include <click/ip6address.hh>
 #endif
 CLICK_DECLS
+class NameDB;
 
 /*
 =c
@@ -113,6 +114,7 @@ class AddressInfo : public Element { public:
 
     int configure_phase() const		{ return CONFIGURE_PHASE_FIRST; }
     int configure(Vector<String> &conf, ErrorHandler *errh);
+    int configure_stream(ArgvecIterator &args, ErrorHandler *errh);
 
     static bool query_ip(String s, unsigned char *store, const Element *context);
     static bool query_ip_prefix(String s, unsigned char *store_addr, unsigned char *store_mask, const Element *context);
@@ -124,6 +126,11 @@ class AddressInfo : public Element { public:
 
  private:
 
+  enum { db_eth, db_ip4, db_ip4net, db_ip6, db_ip6net, ndb };
+  NameDB *_dbs[ndb];		// this context's databases, found once
+
+  void add_entry(const String &arg, ErrorHandler *errh);
+  void define(int db, uint32_t type, const String &name, const void *value, size_t value_size);
   static bool query_netdevice(const String &name, unsigned char *store, int type, int len, const Element *context);
 
 };
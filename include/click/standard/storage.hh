@@ -37,8 +37,13 @@ class Storage { public:
 
   protected:
 
+    enum { CACHE_LINE_SIZE = 64 };
+
+    // The consumer writes _head and the producer writes _tail; keep them on
+    // separate cache lines.
     index_type _capacity;
     volatile index_type _head;
+    char _head_pad[CACHE_LINE_SIZE - 2 * sizeof(index_type)];
     volatile index_type _tail;
 
 };
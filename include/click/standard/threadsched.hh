@@ -11,6 +11,7 @@ class ThreadSched { public:
     virtual ~ThreadSched()		{ }
 
     virtual int initial_home_thread_id(const Element *e);
+    virtual bool initial_task_stealable(const Element *e);
 
 };
 
@@ -6,6 +6,9 @@
 #if HAVE_STRING_PROFILING
 # include <click/integers.hh>
 #endif
+#if CLICK_USERLEVEL && (!HAVE_MULTITHREAD || HAVE___THREAD_STORAGE_CLASS)
+# define HAVE_STRING_ARENA 1
+#endif
 CLICK_DECLS
 class StringAccum;
 
@@ -74,12 +77,12 @@ class String { public:
 
     /** @brief Construct a String containing the single character @a c. */
     explicit inline String(char c) {
-	assign(&c, 1, false);
+	assign_memo(char_data + 2 * (unsigned char) c, 1, 0);
     }
 
     /** @overload */
     explicit inline String(unsigned char c) {
-	assign(reinterpret_cast<char *>(&c), 1, false);
+	assign_memo(char_data + 2 * c, 1, 0);
     }
 
     /** @brief Construct a base-10 string representation of @a x. */
@@ -612,6 +615,11 @@ class String { public:
     static void profile_report(StringAccum &sa, int examples = 0);
 #endif
 
+#if HAVE_STRING_ARENA
+    class Arena;
+    class ArenaScope;
+#endif
+
   private:
 
     /** @cond never */
@@ -619,6 +627,7 @@ class String { public:
 	volatile uint32_t refcount;
 	uint32_t capacity;
 	volatile uint32_t dirty;
+	uint32_t arena_offset;	// nonzero: distance back to arena_chunk_t
 #if HAVE_STRING_PROFILING > 1
 	memo_t **pprev;
 	memo_t *next;
@@ -635,6 +644,11 @@ class String { public:
 	int length;
 	memo_t *memo;
     };
+
+    struct arena_chunk_t {
+	volatile uint32_t live;	// live memos, plus one for the owning Arena
+	uint32_t size;
+    };
     /** @endcond never */
 
     mutable rep_t _r;		// mutable for c_str()
@@ -711,6 +725,7 @@ class String { public:
     static const char oom_data;
     static const char bool_data[11];
     static const char int_data[20];
+    static const char char_data[512];
     static const rep_t null_string_rep;
     static const rep_t oom_string_rep;
 
@@ -722,6 +737,112 @@ class String { public:
 };
 
 
+#if HAVE_STRING_ARENA
+/** @class String::Arena
+ * @brief A source of memory for many small, long-lived Strings.
+ *
+ * While an Arena is active (see String::ArenaScope), Strings created on the
+ * activating thread carve their memory out of large chunks owned by the Arena,
+ * rather than making one allocation per String.  This suits the flood of
+ * short strings built while a configuration is parsed and elements are
+ * configured.  Only Strings of up to max_memo_size bytes, including
+ * bookkeeping, use the Arena; longer Strings are allocated as usual.
+ *
+ * Arena Strings behave exactly like other Strings and may outlive the Arena
+ * and be freed on any thread.  A chunk is freed once the Arena has moved past
+ * it and every String in it has been freed, so one long-lived String can keep
+ * a whole chunk alive. */
+class String::Arena { public:
+
+    enum { default_chunk_size = 8192, max_memo_size = 256 };
+
+    /** @brief Construct an Arena that allocates @a chunk_size-byte chunks. */
+    explicit Arena(uint32_t chunk_size = default_chunk_size);
+
+    /** @brief Destroy the Arena.
+     *
+     * Outstanding Strings remain valid. */
+    ~Arena() {
+	release();
+    }
+
+    /** @brief Return the number of chunks allocated so far. */
+    int nchunks() const {
+	return _nchunks;
+    }
+
+    /** @brief Return the number of Strings allocated so far. */
+    uint32_t nmemos() const {
+	return _nmemos;
+    }
+
+    /** @brief Stop allocating from the current chunk.
+     *
+     * The chunk is freed once its Strings are. */
+    void release();
+
+    /** @brief Return the calling thread's active Arena, if any. */
+    static inline Arena *current();
+
+  private:
+
+    arena_chunk_t *_chunk;
+    uint32_t _pos;
+    uint32_t _chunk_size;
+    int _nchunks;
+    uint32_t _nmemos;
+
+#if HAVE_MULTITHREAD
+    static __thread Arena *the_current;
+#else
+    static Arena *the_current;
+#endif
+
+    memo_t *allocate(uint32_t size);
+
+    Arena(const Arena &x);
+    Arena &operator=(const Arena &x);
+
+    friend class String;
+    friend class String::ArenaScope;
+
+};
+
+/** @class String::ArenaScope
+ * @brief Makes an Arena active on the current thread for its lifetime.
+ *
+ * Scopes nest; destroying a scope reactivates the Arena, if any, that was
+ * active when the scope was created. */
+class String::ArenaScope { public:
+
+    /** @brief Activate @a arena on the current thread. */
+    explicit ArenaScope(Arena &arena)
+	: _prev(Arena::the_current) {
+	Arena::the_current = &arena;
+    }
+
+    /** @brief Reactivate the previously active Arena. */
+    ~ArenaScope() {
+	Arena::the_current = _prev;
+    }
+
+  private:
+
+    Arena *_prev;
+
+    ArenaScope(const ArenaScope &x);
+    ArenaScope &operator=(const ArenaScope &x);
+
+};
+
+inline String::Arena *
+String::Arena::current()
+{
+    return the_current;
+}
+#endif
+
+
 /** @relates String
  * @brief Compares two strings for equality.
  *
@@ -585,6 +585,45 @@ click_fence()
 #endif
 }
 
+/** @brief Order earlier loads before later loads.
+ *
+ * This is a read barrier, for readers of data that other threads change
+ * without locks, such as sequence-numbered slots.  On x86, which does not
+ * reorder loads with other loads, it only constrains the compiler. */
+inline void
+click_read_fence()
+{
+#if CLICK_LINUXMODULE
+    smp_rmb();
+#elif HAVE_MULTITHREAD && (defined(__i386__) || defined(__x86_64__))
+    asm volatile("" : : : "memory");
+#elif HAVE_MULTITHREAD && HAVE___SYNC_SYNCHRONIZE
+    __sync_synchronize();
+#else
+    asm volatile("" : : : "memory");
+#endif
+}
+
+/** @brief Order earlier stores before later stores.
+ *
+ * This is a write barrier, for writers that publish data to lock-free
+ * readers, for instance by filling a ring slot before advancing its index.
+ * On x86, which does not reorder stores with other stores, it only
+ * constrains the compiler. */
+inline void
+click_write_fence()
+{
+#if CLICK_LINUXMODULE
+    smp_wmb();
+#elif HAVE_MULTITHREAD && (defined(__i386__) || defined(__x86_64__))
+    asm volatile("" : : : "memory");
+#elif HAVE_MULTITHREAD && HAVE___SYNC_SYNCHRONIZE
+    __sync_synchronize();
+#else
+    asm volatile("" : : : "memory");
+#endif
+}
+
 /** @brief Provide a memory barrier for the compiler. */
 inline void
 click_compiler_fence()
@@ -250,6 +250,25 @@ class Task : private TaskLink { public:
      */
     void move_thread(int new_thread_id);
 
+    /** @brief Return true iff work stealing may move the Task.
+     *
+     * When work stealing is on (see Master::work_stealing()), an idle thread
+     * may take a stealable task from a busy thread.  Tasks are stealable by
+     * default.  Tasks whose elements are explicitly placed by a ThreadSched,
+     * such as StaticThreadSched, are not.  Elements whose tasks depend on
+     * locality -- for example, tasks that poll a device queue bound to one
+     * CPU -- should call set_stealable(false).  move_thread() ignores this
+     * setting. */
+    inline bool stealable() const {
+	return _stealable;
+    }
+
+    /** @brief Set whether work stealing may move the Task.
+     * @sa stealable */
+    inline void set_stealable(bool stealable) {
+	_stealable = stealable;
+    }
+
 
 #if HAVE_STRIDE_SCHED
     inline int tickets() const;
@@ -314,9 +333,14 @@ class Task : private TaskLink { public:
 
     volatile uintptr_t _pending_nextptr;
 
+    bool _stealable;
+
     Task(const Task &x);
     Task &operator=(const Task &x);
     void cleanup();
+#if HAVE_ELEMENT_PROFILE
+    bool profiled_fire();
+#endif
 
 #if CLICK_DEBUG_SCHEDULING
  public:
@@ -329,9 +353,9 @@ class Task : private TaskLink { public:
  private:
 #endif
 
-    inline void add_pending_locked(RouterThread *thread);
+    inline void add_pending_to(RouterThread *thread);
     void add_pending();
-    inline void remove_pending_locked(RouterThread *thread);
+    inline bool remove_pending_locked(RouterThread *thread);
     void remove_pending();
     void process_pending(RouterThread *thread);
 
@@ -375,7 +399,7 @@ Task::Task(TaskCallback f, void *user_data)
 #if HAVE_MULTITHREAD
       _cycle_runs(0),
 #endif
-      _thread(0), _owner(0), _pending_nextptr(0)
+      _thread(0), _owner(0), _pending_nextptr(0), _stealable(true)
 {
     _status.home_thread_id = -1;
     _status.is_scheduled = _status.is_strong_unscheduled = false;
@@ -397,7 +421,7 @@ Task::Task(Element* e)
 #if HAVE_MULTITHREAD
       _cycle_runs(0),
 #endif
-      _thread(0), _owner(0), _pending_nextptr(0)
+      _thread(0), _owner(0), _pending_nextptr(0), _stealable(true)
 {
     _status.home_thread_id = -1;
     _status.is_scheduled = _status.is_strong_unscheduled = false;
@@ -609,6 +633,11 @@ Task::fire()
     _cycle_runs++;
 #endif
     bool work_done;
+#if HAVE_ELEMENT_PROFILE
+    if (unlikely(Element::the_profiling))
+	work_done = profiled_fire();
+    else
+#endif
     if (!_hook)
 	work_done = ((Element*)_thunk)->run_task(this);
     else
@@ -346,6 +346,8 @@ class Timer { public:
     void *_thunk;
     Element *_owner;
     RouterThread *_thread;
+    Timer *_wheel_next;
+    Timer **_wheel_pprev;
 
     Timer &operator=(const Timer &x);
 
@@ -12,6 +12,7 @@ class Timer;
 class TimerSet { public:
 
     TimerSet();
+    ~TimerSet();
 
     Timestamp timer_expiry_steady() const	{ return _timer_expiry; }
     inline Timestamp timer_expiry_steady_adjusted() const;
@@ -25,6 +26,9 @@ class TimerSet { public:
     unsigned timer_stride() const		{ return _timer_stride; }
     void set_max_timer_stride(unsigned timer_stride);
 
+    bool timer_wheel() const			{ return _wheel_slot != 0; }
+    void set_timer_wheel(bool wheel);
+
     void kill_router(Router *router);
 
     void run_timers(RouterThread *thread, Master *master);
@@ -71,7 +75,25 @@ class TimerSet { public:
     Timestamp _timer_check;
     uint32_t _timer_check_reports;
 
+    // Hierarchical timing wheel, used instead of _timer_heap when
+    // _wheel_slot is nonnull.  Level 0 has wheel_slots slots of
+    // 2^wheel_tick_shift microseconds each; a level-L slot spans all of
+    // level L-1.  Timers past the top level wait in the overflow slot.
+    // A scheduled timer's _schedpos1 is its slot position plus 1, and
+    // _timer_expiry is exact for level-0 slots and a lower bound otherwise.
+    enum {
+	wheel_tick_shift = 7, wheel_bits = 8, wheel_levels = 4,
+	wheel_slots = 1 << wheel_bits,
+	wheel_overflow = wheel_levels * wheel_slots
+    };
+    Timer **_wheel_slot;
+    uint64_t _wheel_bits[wheel_overflow / 64 + 1];
+    uint64_t _wheel_cursor;
+    unsigned _wheel_size;
+
     inline void run_one_timer(Timer *);
+    inline void adjust_timer_stride(const Timestamp &expiry);
+    void run_timer_chunk(RouterThread *thread);
 
     void set_timer_expiry() {
 	if (_timer_heap.size())
@@ -81,6 +103,20 @@ class TimerSet { public:
     }
     void check_timer_expiry(Timer *t);
 
+    static uint64_t wheel_tick(const Timestamp &ts) {
+	return (uint64_t) ts.usecval() >> wheel_tick_shift;
+    }
+    void wheel_insert(Timer *t);
+    void wheel_remove(Timer *t);
+    int wheel_find(int from, int end) const;
+    int wheel_first(uint64_t &start) const;
+    void wheel_cascade();
+    void wheel_collect(const Timestamp &now);
+    void wheel_set_expiry();
+    void wheel_schedule(Timer *t, const Timestamp &when);
+    void wheel_unschedule(Timer *t);
+    Timer *wheel_next_timer() const;
+
     inline void lock_timers();
     inline bool attempt_lock_timers();
     inline void unlock_timers();
@@ -153,7 +189,11 @@ inline Timer *
 TimerSet::next_timer()
 {
     lock_timers();
-    Timer *t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
+    Timer *t;
+    if (_wheel_slot)
+	t = wheel_next_timer();
+    else
+	t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
     unlock_timers();
     return t;
 }
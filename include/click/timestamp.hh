@@ -117,6 +117,14 @@ class String;
 #endif
 
 
+// TIMESTAMP_FAST_CLOCK is defined if Timestamp::now_fast() and
+// Timestamp::now_steady_fast() can read the processor's cycle counter.
+
+#if CLICK_USERLEVEL && !CLICK_NS && HAVE_INT64_TYPES && (__i386__ || __x86_64__)
+# define TIMESTAMP_FAST_CLOCK 1
+#endif
+
+
 class Timestamp { public:
 
     /** @brief  Type represents a number of seconds. */
@@ -462,6 +470,56 @@ class Timestamp { public:
     inline void assign_recent_steady();
 
 
+    /** @brief Return the current system time, computed cheaply if possible.
+     *
+     * Like now(), but where the processor has an invariant cycle counter,
+     * computes the time from that counter rather than by asking the system.
+     * The counter's rate is calibrated against the system clocks, and the
+     * result is resynchronized with them every 100ms or so, so it stays
+     * within microseconds of now().  Use it for per-packet timestamps.
+     * @sa now(), fast_clock_enable() */
+    static inline Timestamp now_fast();
+
+    /** @brief Set this timestamp to the current system time, computed
+     * cheaply if possible.
+     *
+     * Like "*this = Timestamp::now_fast()".
+     * @sa now_fast() */
+    inline void assign_now_fast();
+
+    /** @brief Return the current steady-clock time, computed cheaply if
+     * possible.
+     *
+     * Like now_steady(), but computed from the cycle counter where possible;
+     * see now_fast().  Resynchronization is arranged so the result does not
+     * move backwards.
+     * @sa now_steady(), now_fast() */
+    static inline Timestamp now_steady_fast();
+
+    /** @brief Set this timestamp to the current steady-clock time, computed
+     * cheaply if possible.
+     *
+     * Like "*this = Timestamp::now_steady_fast()".
+     * @sa now_steady_fast() */
+    inline void assign_now_steady_fast();
+
+    /** @brief Enable or disable the cycle-counter clock.
+     *
+     * When disabled, now_fast() and now_steady_fast() equal now() and
+     * now_steady().  The clock is enabled by default when the processor
+     * reports an invariant cycle counter.  */
+    static void fast_clock_enable(bool on);
+
+    /** @brief Return true iff the cycle-counter clock is enabled. */
+    static inline bool fast_clock_enabled() {
+#if TIMESTAMP_FAST_CLOCK
+	return _fast_clock.enabled;
+#else
+	return false;
+#endif
+    }
+
+
     /** @brief Unparse this timestamp into a String.
      *
      * Returns a string formatted like "10.000000", with at least six
@@ -688,6 +746,24 @@ class Timestamp { public:
     }
 
     inline void assign_now(bool recent, bool steady, bool unwarped);
+    inline void assign_now_fast(bool steady);
+
+#if TIMESTAMP_FAST_CLOCK
+    struct fast_clock_type {
+	uint32_t seq;		// odd while resynchronizing
+	bool enabled;
+	bool running;		// calibrated
+	uint64_t tsc;		// cycle counter at last resync
+	uint64_t period;	// cycles until next resync
+	uint64_t mult;		// nanoseconds per cycle << 32
+	int64_t nsec[2];	// system/steady nanoseconds at last resync
+	uint64_t cal_tsc;	// cycle counter and steady nanoseconds at
+	int64_t cal_nsec;	// calibration start
+    };
+    static fast_clock_type _fast_clock;
+
+    void assign_now_fast_slow(bool steady);
+#endif
 
 #if TIMESTAMP_WARPABLE
     static warp_class_type _warp_class;
@@ -907,6 +983,60 @@ Timestamp::recent_steady()
     return t;
 }
 
+inline void
+Timestamp::assign_now_fast(bool steady)
+{
+#if TIMESTAMP_FAST_CLOCK
+    const volatile fast_clock_type &fc = _fast_clock;
+    uint32_t seq = fc.seq;
+    __asm__ __volatile__("" : : : "memory");
+    uint64_t delta = click_get_cycles() - fc.tsc;
+    if (likely(fc.running && delta < fc.period && !(seq & 1)
+# if TIMESTAMP_WARPABLE
+	       && !_warp_class
+# endif
+	       )) {
+	int64_t nsec = fc.nsec[steady] + (int64_t) ((delta * fc.mult) >> 32);
+	__asm__ __volatile__("" : : : "memory");
+	if (likely(seq == fc.seq)) {
+	    assign(nsec / 1000000000, nsec_to_subsec(nsec % 1000000000));
+	    return;
+	}
+    }
+    assign_now_fast_slow(steady);
+#else
+    assign_now(false, steady, false);
+#endif
+}
+
+inline void
+Timestamp::assign_now_fast()
+{
+    assign_now_fast(false);
+}
+
+inline Timestamp
+Timestamp::now_fast()
+{
+    Timestamp t = Timestamp::uninitialized_t();
+    t.assign_now_fast(false);
+    return t;
+}
+
+inline void
+Timestamp::assign_now_steady_fast()
+{
+    assign_now_fast(true);
+}
+
+inline Timestamp
+Timestamp::now_steady_fast()
+{
+    Timestamp t = Timestamp::uninitialized_t();
+    t.assign_now_fast(true);
+    return t;
+}
+
 #if TIMESTAMP_WARPABLE
 inline void
 Timestamp::assign_now_unwarped()
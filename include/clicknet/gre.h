@@ -0,0 +1,31 @@
+/* -*- mode: c; c-basic-offset: 4 -*- */
+#ifndef CLICKNET_GRE_H
+#define CLICKNET_GRE_H
+
+/*
+ * <clicknet/gre.h> -- GRE header definitions.
+ *
+ * Relevant RFCs include:
+ *   RFC2784	Generic Routing Encapsulation (GRE)
+ *   RFC2890	Key and Sequence Number Extensions to GRE
+ *
+ * Optional fields follow the fixed header in this order, each 4 bytes:
+ * checksum and reserved (GRE_FLAG_CSUM), key (GRE_FLAG_KEY), sequence
+ * number (GRE_FLAG_SEQ).
+ */
+
+struct click_gre {
+    uint16_t	gre_flags;		/* 0-1   flags and version	     */
+    uint16_t	gre_proto;		/* 2-3   payload protocol	     */
+};
+
+/* gre_flags, host order */
+#define GRE_FLAG_CSUM		0x8000
+#define GRE_FLAG_ROUTING	0x4000
+#define GRE_FLAG_KEY		0x2000
+#define GRE_FLAG_SEQ		0x1000
+#define GRE_VERSION_MASK	0x0007
+
+#define GRE_PROTO_TEB		0x6558	/* transparent Ethernet bridging */
+
+#endif
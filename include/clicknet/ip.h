@@ -129,16 +129,40 @@ struct click_ip {
  *
  * @a x must be two-byte aligned. */
 uint16_t click_in_cksum(const unsigned char *x, int len);
+/** @brief Copy a data range and calculate its Internet checksum.
+ * @param dst destination
+ * @param src data to copy and checksum
+ * @param len number of bytes
+ *
+ * Equivalent to memcpy(@a dst, @a src, @a len) followed by
+ * click_in_cksum(@a dst, @a len), but reads the data only once.  The ranges
+ * must not overlap. */
+uint16_t click_in_cksum_copy(unsigned char *dst, const unsigned char *src, int len);
 uint16_t click_in_cksum_pseudohdr_raw(uint32_t csum, uint32_t src, uint32_t dst, int proto, int packet_len);
 #else
 # define click_in_cksum(addr, len) \
 		ip_compute_csum((unsigned char *)(addr), (len))
+# define click_in_cksum_copy(dst, src, len) \
+		(memcpy((dst), (src), (len)), click_in_cksum((dst), (len)))
 # define click_in_cksum_pseudohdr_raw(csum, src, dst, proto, transport_len) \
 		csum_tcpudp_magic((src), (dst), (transport_len), (proto), ~(csum) & 0xFFFF)
 #endif
 uint16_t click_in_cksum_pseudohdr_hard(uint32_t csum, const struct click_ip *iph, int packet_len);
 void click_update_zero_in_cksum_hard(uint16_t *csum, const unsigned char *addr, int len);
 
+/** @brief Combine the Internet checksums of two adjacent data ranges.
+ * @param a checksum of the first range, which must have even length
+ * @param b checksum of the second range
+ *
+ * Returns the checksum of the concatenated ranges. */
+static inline uint16_t
+click_in_cksum_combine(uint16_t a, uint16_t b)
+{
+    uint32_t sum = (uint16_t) ~a + (uint16_t) ~b;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum & 0xFFFF;
+}
+
 /** @brief Adjust an Internet checksum according to a pseudoheader.
  * @param data_csum initial checksum (may be a 16-bit checksum)
  * @param iph IP header from which to extract pseudoheader information
@@ -182,6 +206,42 @@ click_update_in_cksum(uint16_t *csum, uint16_t old_hw, uint16_t new_hw)
     *csum = ~(sum + (sum >> 16));
 }
 
+/** @brief Incrementally adjust an Internet checksum for a 32-bit field.
+ * @param[in, out] csum points to checksum
+ * @param old_w old word, as stored in the packet
+ * @param new_w new word, as stored in the packet
+ *
+ * Equivalent to calling click_update_in_cksum() on each halfword of a
+ * changed field, such as an IP address or a TCP sequence number. */
+static inline void
+click_update_in_cksum32(uint16_t *csum, uint32_t old_w, uint32_t new_w)
+{
+    uint32_t sum = (~*csum & 0xFFFF) + (~old_w >> 16) + (~old_w & 0xFFFF)
+	+ (new_w >> 16) + (new_w & 0xFFFF);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    *csum = ~(sum + (sum >> 16));
+}
+
+/** @brief Incrementally adjust an Internet checksum for replaced data.
+ * @param[in, out] csum points to checksum
+ * @param old_x old data
+ * @param old_len number of bytes of old data, which must be even
+ * @param new_x new data
+ * @param new_len number of bytes of new data, which must be even
+ *
+ * The checksum stored in *@a csum is updated as if the @a old_len bytes at
+ * @a old_x were replaced by the @a new_len bytes at @a new_x.  Both ranges
+ * must be two-byte aligned.  This moves a transport checksum to a new
+ * pseudoheader, as when translating between IPv4 and IPv6, without summing
+ * the payload.  The result is never ~+0, as with click_update_in_cksum(). */
+static inline void
+click_update_in_cksum_range(uint16_t *csum, const unsigned char *old_x, int old_len,
+			    const unsigned char *new_x, int new_len)
+{
+    click_update_in_cksum(csum, ~click_in_cksum(old_x, old_len),
+			  ~click_in_cksum(new_x, new_len));
+}
+
 /** @brief Potentially fix a zero-valued Internet checksum.
  * @param[in, out] csum points to checksum
  * @param x data to checksum
@@ -76,6 +76,22 @@ struct click_ip6 {
 
 #define IP6_CHECK_V(hdr)	(((hdr).ip6_vfc & htonl(IP6_V_MASK)) == htonl(6 << IP6_V_SHIFT))
 
+/* next header values for extension headers */
+#define IP6_NXT_HOPOPTS		0
+#define IP6_NXT_ROUTING		43
+#define IP6_NXT_FRAGMENT	44
+#define IP6_NXT_DSTOPTS		60
+
+struct click_ip6_fragment {
+    uint8_t ip6f_nxt;			/* 0	 next header		     */
+    uint8_t ip6f_reserved;		/* 1	 reserved		     */
+    uint16_t ip6f_offlg;		/* 2-3	 offset, reserved, M flag    */
+    uint32_t ip6f_ident;		/* 4-7	 identification		     */
+};
+
+#define IP6F_OFF_MASK		0xFFF8	/* offset in bytes, host order	     */
+#define IP6F_MORE_FRAG		0x0001	/* more-fragments flag, host order   */
+
 CLICK_DECLS
 
 uint16_t in6_fast_cksum(const struct click_in6_addr *saddr,
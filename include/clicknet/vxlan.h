@@ -0,0 +1,20 @@
+/* -*- mode: c; c-basic-offset: 4 -*- */
+#ifndef CLICKNET_VXLAN_H
+#define CLICKNET_VXLAN_H
+
+/*
+ * <clicknet/vxlan.h> -- VXLAN header definitions.
+ *
+ * Relevant RFCs include:
+ *   RFC7348	Virtual eXtensible Local Area Network (VXLAN)
+ */
+
+struct click_vxlan {
+    uint32_t	vx_flags;		/* 0-3   flags, reserved	     */
+    uint32_t	vx_vni;			/* 4-7   VNI (high 24 bits)	     */
+};
+
+#define VXLAN_FLAG_VNI		0x08000000	/* vx_flags, host order: VNI valid */
+#define VXLAN_PORT		4789
+
+#endif
@@ -282,6 +282,10 @@ typedef uint8_t *	wifi_mgt_auth_t;
 
 #define WIFI_WEP_HEADERSIZE (WIFI_WEP_IVLEN + WIFI_WEP_KIDLEN)
 
+#define	WIFI_CCMP_HEADERSIZE		8	/* PN, ExtIV, key id */
+#define	WIFI_CCMP_MICLEN		8
+#define	WIFI_CCMP_EXTIV			0x20
+
 
 #define WIFI_WEP_NOSUP	-1
 #define WIFI_WEP_OFF	0
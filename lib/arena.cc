@@ -0,0 +1,69 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/arena.hh" -*-
+/*
+ * arena.{cc,hh} -- bulk allocator for objects with a shared lifetime
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/glue.hh>
+#include <click/arena.hh>
+CLICK_DECLS
+
+Arena::Arena(size_t chunk_size)
+    : _chunk(0), _pos(0), _end(0), _chunk_size(chunk_size),
+      _nbytes(0), _nchunks(0)
+{
+    if (_chunk_size < 4 * chunk_header)
+	_chunk_size = 4 * chunk_header;
+}
+
+void
+Arena::clear()
+{
+    while (chunk *c = _chunk) {
+	_chunk = c->next;
+	CLICK_LFREE(c, c->size);
+    }
+    _pos = _end = 0;
+    _nbytes = _nchunks = 0;
+}
+
+void *
+Arena::hard_allocate(size_t size)
+{
+    // A large allocation gets a chunk of its own, linked behind the current
+    // chunk so the current chunk's free space stays in use.
+    bool own = size > (_chunk_size - chunk_header) / 4;
+    size_t csize = own ? chunk_header + size : _chunk_size;
+    chunk *c = (chunk *) CLICK_LALLOC(csize);
+    if (!c)
+	return 0;
+    c->size = csize;
+    char *p = reinterpret_cast<char *>(c) + chunk_header;
+    if (own && _chunk) {
+	c->next = _chunk->next;
+	_chunk->next = c;
+    } else {
+	c->next = _chunk;
+	_chunk = c;
+	if (!own) {
+	    _pos = p + size;
+	    _end = p + (csize - chunk_header);
+	} else
+	    _pos = _end = 0;
+    }
+    ++_nchunks;
+    _nbytes += size;
+    return p;
+}
+
+CLICK_ENDDECLS
@@ -26,7 +26,7 @@ void
 Bitvector::finish_copy_constructor(const Bitvector &o)
 {
     int nn = max_word();
-    _data = new uint32_t[nn + 1];
+    _data = new data_word_type[nn + 1];
     for (int i = 0; i <= nn; i++)
 	_data[i] = o._data[i];
 }
@@ -49,19 +49,64 @@ Bitvector::zero() const
     return true;
 }
 
+static inline int
+word_count(Bitvector::data_word_type x)
+{
+#if __GNUC__ && !HAVE_NO_INTEGER_BUILTINS
+    return __builtin_popcountl(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1)
+	++n;
+    return n;
+#endif
+}
+
+int
+Bitvector::count() const
+{
+    // Bits past _max may be stale after a shrinking resize(); skip them.
+    int nn = max_word(), n = 0;
+    if (nn < 0)
+	return 0;
+    for (int i = 0; i < nn; i++)
+	n += word_count(_data[i]);
+    data_word_type last = _data[nn];
+    if ((_max & (data_word_bits - 1)) != data_word_bits - 1)
+	last &= ((data_word_type) 1 << ((_max & (data_word_bits - 1)) + 1)) - 1;
+    return n + word_count(last);
+}
+
+int
+Bitvector::find_next(int i) const
+{
+    assert(i >= -1);
+    if (++i > _max)
+	return -1;
+    int w = i >> data_word_shift, nn = max_word();
+    data_word_type bits = _data[w] & (~(data_word_type) 0 << (i & (data_word_bits - 1)));
+    while (!bits) {
+	if (++w > nn)
+	    return -1;
+	bits = _data[w];
+    }
+    i = (w << data_word_shift) + ffs_lsb(bits) - 1;
+    return i <= _max ? i : -1;
+}
+
 void
 Bitvector::resize_to_max(int new_max, bool valid_n)
 {
-    int want_u = (new_max >> 5) + 1;
+    int want_u = (new_max >> data_word_shift) + 1;
     int have_u = (valid_n ? max_word() : MAX_INLINE_WORD) + 1;
     if (have_u < MAX_INLINE_WORD + 1)
 	have_u = MAX_INLINE_WORD + 1;
     if (want_u <= have_u)
 	return;
 
-    uint32_t *new_data = new uint32_t[want_u];
-    memcpy(new_data, _data, have_u * sizeof(uint32_t));
-    memset(new_data + have_u, 0, (want_u - have_u) * sizeof(uint32_t));
+    data_word_type *new_data = new data_word_type[want_u];
+    memcpy(new_data, _data, have_u * sizeof(data_word_type));
+    memset(new_data + have_u, 0, (want_u - have_u) * sizeof(data_word_type));
     if (_data != &_f0)
 	delete[] _data;
     _data = new_data;
@@ -72,9 +117,9 @@ Bitvector::clear_last()
 {
     if (unlikely(_max < 0))
 	_data[0] = 0;
-    else if ((_max&0x1F) != 0x1F) {
-	uint32_t mask = (1U << ((_max&0x1F)+1)) - 1;
-	_data[_max>>5] &= mask;
+    else if ((_max & (data_word_bits - 1)) != data_word_bits - 1) {
+	data_word_type mask = ((data_word_type) 1 << ((_max & (data_word_bits - 1)) + 1)) - 1;
+	_data[_max >> data_word_shift] &= mask;
     }
 }
 
@@ -89,12 +134,12 @@ Bitvector::operator=(const Bitvector &o)
     if (&o == this)
 	/* nada */;
     else if (o.max_word() <= MAX_INLINE_WORD)
-	memcpy(_data, o._data, 8);
+	memcpy(_data, o._data, 2 * sizeof(data_word_type));
     else {
 	if (_data != &_f0)
 	    delete[] _data;
-	_data = new uint32_t[o.max_word() + 1];
-	memcpy(_data, o._data, (o.max_word() + 1) * sizeof(uint32_t));
+	_data = new data_word_type[o.max_word() + 1];
+	memcpy(_data, o._data, (o.max_word() + 1) * sizeof(data_word_type));
     }
     _max = o._max;
     return *this;
@@ -104,10 +149,10 @@ Bitvector &
 Bitvector::assign(int n, bool value)
 {
     resize(n);
-    uint32_t bits = (value ? 0xFFFFFFFFU : 0U);
+    data_word_type bits = (value ? ~(data_word_type) 0 : 0);
     // 24.Jun.2008 -- Even if n <= 0, at least one word must be set to "bits."
     // Otherwise assert(_max >= 0 || _data[0] == 0) will not hold.
-    int copy = (n > 32 ? max_word() : 0);
+    int copy = (n > data_word_bits ? max_word() : 0);
     for (int i = 0; i <= copy; i++)
 	_data[i] = bits;
     if (value)
@@ -119,7 +164,7 @@ void
 Bitvector::negate()
 {
     int nn = max_word();
-    uint32_t *data = _data;
+    data_word_type *data = _data;
     for (int i = 0; i <= nn; i++)
 	data[i] = ~data[i];
     clear_last();
@@ -130,7 +175,7 @@ Bitvector::operator&=(const Bitvector &o)
 {
     assert(o._max == _max);
     int nn = max_word();
-    uint32_t *data = _data, *o_data = o._data;
+    data_word_type *data = _data, *o_data = o._data;
     for (int i = 0; i <= nn; i++)
 	data[i] &= o_data[i];
     return *this;
@@ -142,7 +187,7 @@ Bitvector::operator|=(const Bitvector &o)
     if (o._max > _max)
 	resize(o._max + 1);
     int nn = max_word();
-    uint32_t *data = _data, *o_data = o._data;
+    data_word_type *data = _data, *o_data = o._data;
     for (int i = 0; i <= nn; i++)
 	data[i] |= o_data[i];
     return *this;
@@ -153,7 +198,7 @@ Bitvector::operator^=(const Bitvector &o)
 {
     assert(o._max == _max);
     int nn = max_word();
-    uint32_t *data = _data, *o_data = o._data;
+    data_word_type *data = _data, *o_data = o._data;
     for (int i = 0; i <= nn; i++)
 	data[i] ^= o_data[i];
     return *this;
@@ -163,17 +208,17 @@ void
 Bitvector::offset_or(const Bitvector &o, int offset)
 {
     assert(offset >= 0 && offset + o._max <= _max);
-    uint32_t bits_1st = offset&0x1F;
-    int my_pos = offset>>5;
+    int bits_1st = offset & (data_word_bits - 1);
+    int my_pos = offset >> data_word_shift;
     int o_pos = 0;
     int my_max_word = max_word();
     int o_max_word = o.max_word();
-    uint32_t *data = _data;
-    const uint32_t *o_data = o._data;
-    assert((o._max < 0 && o_data[0] == 0) || (o._max & 0x1F) == 0 || (o_data[o_max_word] & ((1U << ((o._max & 0x1F) + 1)) - 1)) == o_data[o_max_word]);
+    data_word_type *data = _data;
+    const data_word_type *o_data = o._data;
+    assert((o._max < 0 && o_data[0] == 0) || (o._max & (data_word_bits - 1)) == data_word_bits - 1 || (o_data[o_max_word] & (((data_word_type) 1 << ((o._max & (data_word_bits - 1)) + 1)) - 1)) == o_data[o_max_word]);
 
     while (true) {
-	uint32_t val = o_data[o_pos];
+	data_word_type val = o_data[o_pos];
 	data[my_pos] |= (val << bits_1st);
 
 	my_pos++;
@@ -181,7 +226,7 @@ Bitvector::offset_or(const Bitvector &o, int offset)
 	    break;
 
 	if (bits_1st)
-	    data[my_pos] |= (val >> (32 - bits_1st));
+	    data[my_pos] |= (val >> (data_word_bits - bits_1st));
 
 	o_pos++;
 	if (o_pos > o_max_word)
@@ -196,8 +241,8 @@ Bitvector::or_with_difference(const Bitvector &o, Bitvector &diff)
     if (diff._max != _max)
 	diff.resize(_max + 1);
     int nn = max_word();
-    uint32_t *data = _data, *diff_data = diff._data;
-    const uint32_t *o_data = o._data;
+    data_word_type *data = _data, *diff_data = diff._data;
+    const data_word_type *o_data = o._data;
     for (int i = 0; i <= nn; i++) {
 	diff_data[i] = o_data[i] & ~data[i];
 	data[i] |= o_data[i];
@@ -210,7 +255,7 @@ Bitvector::nonzero_intersection(const Bitvector &o) const
     int nn = o.max_word();
     if (nn > max_word())
 	nn = max_word();
-    const uint32_t *data = _data, *o_data = o._data;
+    const data_word_type *data = _data, *o_data = o._data;
     for (int i = 0; i <= nn; i++)
 	if (data[i] & o_data[i])
 	    return true;
@@ -220,7 +265,7 @@ Bitvector::nonzero_intersection(const Bitvector &o) const
 void
 Bitvector::swap(Bitvector &x)
 {
-    uint32_t u = _f0;
+    data_word_type u = _f0;
     _f0 = x._f0;
     x._f0 = u;
 
@@ -232,7 +277,7 @@ Bitvector::swap(Bitvector &x)
     _max = x._max;
     x._max = m;
 
-    uint32_t *d = _data;
+    data_word_type *d = _data;
     _data = (x._data == &x._f0 ? &_f0 : x._data);
     x._data = (d == &_f0 ? &x._f0 : d);
 }
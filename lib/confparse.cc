@@ -709,6 +709,24 @@ cp_argvec(const String &str, Vector<String> &conf)
   }
 }
 
+/// @brief  Set @a arg to the next argument and return true, or return false
+///	    if there are no more arguments.
+///
+/// The sequence of arguments matches cp_argvec().
+bool
+ArgvecIterator::next(String &arg)
+{
+  int len = _str.length();
+  while (_pos < len) {
+    arg = partial_uncomment(_str, _pos, &_pos);
+    bool last = _pos >= len;
+    _pos++;
+    if (arg || !last)
+      return true;
+  }
+  return false;
+}
+
 static const char *
 skip_spacevec_item(const char *s, const char *end)
 {
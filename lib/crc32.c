@@ -40,7 +40,20 @@
 
 #define POLYNOMIAL 0x04c11db7L
 
-static uint32_t crc_table[256];
+#if CLICK_USERLEVEL && defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+# define HAVE_CRC_PCLMUL 1
+# include <cpuid.h>
+# include <immintrin.h>
+#endif
+
+/* crc_table[0] is the classic table; crc_table[k][b] is the remainder of
+   byte b followed by k zero bytes, for slicing-by-8 (Kounavis and Berry) */
+static uint32_t crc_table[8][256];
+static volatile int crc_initialized = 0;
+#if HAVE_CRC_PCLMUL
+static int crc_use_pclmul;
+static uint64_t crc_fold_k[4];
+#endif
 
 static void
 gen_crc_table(void)
@@ -55,28 +68,128 @@ gen_crc_table(void)
                 else
                    crc_accum =
                      ( crc_accum << 1 ); }
-         crc_table[i] = crc_accum; }
+         crc_table[0][i] = crc_accum; }
+   for ( j = 1;  j < 8;  j++ )
+       for ( i = 0;  i < 256;  i++ )
+           crc_table[j][i] = ( crc_table[j-1][i] << 8 )
+               ^ crc_table[0][crc_table[j-1][i] >> 24];
    return; }
 
+static uint32_t
+update_crc_slice8(uint32_t crc_accum, const unsigned char *p, int len)
+{
+  for (; len >= 8; p += 8, len -= 8) {
+    crc_accum ^= ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+      | ((uint32_t) p[2] << 8) | p[3];
+    crc_accum = crc_table[7][crc_accum >> 24]
+      ^ crc_table[6][(crc_accum >> 16) & 0xff]
+      ^ crc_table[5][(crc_accum >> 8) & 0xff]
+      ^ crc_table[4][crc_accum & 0xff]
+      ^ crc_table[3][p[4]] ^ crc_table[2][p[5]]
+      ^ crc_table[1][p[6]] ^ crc_table[0][p[7]];
+  }
+  for (; len > 0; ++p, --len)
+    crc_accum = ( crc_accum << 8 ) ^ crc_table[0][(crc_accum >> 24) ^ *p];
+  return crc_accum;
+}
+
+#if HAVE_CRC_PCLMUL
 /*
- * update the CRC on the data block one byte at a time
+ * Carry-less multiply folding, after Gopal et al., "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).  The
+ * data is read as one long polynomial, first bit highest.  A 128-bit block
+ * A = AH*x^64 + AL that is followed by n more bits can be replaced by
+ * AH*(x^(n+64) mod P) + AL*(x^n mod P), a product of degree less than 96,
+ * XORed into the block n bits later, without changing the CRC.  Four blocks
+ * are folded in parallel 512 bits ahead, then reduced to one block, whose 16
+ * bytes and the leftover tail are finished with slicing-by-8.
  */
-uint32_t
-update_crc(uint32_t crc_accum,
-           const char *data_blk_ptr,
-           int data_blk_size)
+
+static uint64_t
+xpow_mod(int n)
+{
+  /* x^n mod P, for n >= 32 */
+  uint32_t r = POLYNOMIAL;	/* x^32 mod P */
+  for (n -= 32; n > 0; --n)
+    r = (r & 0x80000000 ? (r << 1) ^ POLYNOMIAL : r << 1);
+  return r;
+}
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i
+crc_fold(__m128i a, __m128i k, __m128i b)
 {
-  int i, j;
-  static int initialized = 0;
+  return _mm_xor_si128(b, _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x11),
+					_mm_clmulepi64_si128(a, k, 0x00)));
+}
 
-  if(initialized == 0){
-    initialized = 1;
-    gen_crc_table();
+__attribute__((target("pclmul,ssse3")))
+static uint32_t
+update_crc_pclmul(uint32_t crc_accum, const unsigned char *p, int len)
+{
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+				     8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i k512 = _mm_set_epi64x(crc_fold_k[0], crc_fold_k[1]);
+  const __m128i k128 = _mm_set_epi64x(crc_fold_k[2], crc_fold_k[3]);
+  __m128i x0, x1, x2, x3;
+  unsigned char buf[16];
+
+#define CRC_LOAD(i) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16 * (i))), bswap)
+  x0 = _mm_xor_si128(CRC_LOAD(0), _mm_set_epi32(crc_accum, 0, 0, 0));
+  x1 = CRC_LOAD(1);
+  x2 = CRC_LOAD(2);
+  x3 = CRC_LOAD(3);
+  for (p += 64, len -= 64; len >= 64; p += 64, len -= 64) {
+    x0 = crc_fold(x0, k512, CRC_LOAD(0));
+    x1 = crc_fold(x1, k512, CRC_LOAD(1));
+    x2 = crc_fold(x2, k512, CRC_LOAD(2));
+    x3 = crc_fold(x3, k512, CRC_LOAD(3));
   }
+  x1 = crc_fold(x0, k128, x1);
+  x2 = crc_fold(x1, k128, x2);
+  x3 = crc_fold(x2, k128, x3);
+  for (; len >= 16; p += 16, len -= 16)
+    x3 = crc_fold(x3, k128, CRC_LOAD(0));
+#undef CRC_LOAD
+
+  _mm_storeu_si128((__m128i *) buf, _mm_shuffle_epi8(x3, bswap));
+  return update_crc_slice8(update_crc_slice8(0, buf, 16), p, len);
+}
+#endif
 
-  for ( j = 0;  j < data_blk_size;  j++ ){
-    i = ( (uint32_t) ( crc_accum >> 24) ^ *data_blk_ptr++ ) & 0xff;
-    crc_accum = ( crc_accum << 8 ) ^ crc_table[i];
+static void
+init_crc(void)
+{
+  gen_crc_table();
+#if HAVE_CRC_PCLMUL
+  {
+    unsigned a, b, c, d;
+    crc_fold_k[0] = xpow_mod(512 + 64);
+    crc_fold_k[1] = xpow_mod(512);
+    crc_fold_k[2] = xpow_mod(128 + 64);
+    crc_fold_k[3] = xpow_mod(128);
+    crc_use_pclmul = __get_cpuid(1, &a, &b, &c, &d)
+      && (c & bit_PCLMUL) && (c & bit_SSSE3);
   }
-  return crc_accum;
+#endif
+  crc_initialized = 1;
+}
+
+/*
+ * update the CRC on the data block, using the fastest method available
+ */
+uint32_t
+update_crc(uint32_t crc_accum,
+           const char *data_blk_ptr,
+           int data_blk_size)
+{
+  if (crc_initialized == 0)
+    init_crc();
+#if HAVE_CRC_PCLMUL
+  if (data_blk_size >= 128 && crc_use_pclmul)
+    return update_crc_pclmul(crc_accum, (const unsigned char *) data_blk_ptr,
+			     data_blk_size);
+#endif
+  return update_crc_slice8(crc_accum, (const unsigned char *) data_blk_ptr,
+			   data_blk_size);
 }
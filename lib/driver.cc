@@ -54,6 +54,9 @@
 # include <click/straccum.hh>
 # include <click/nameinfo.hh>
 # include <click/bighashmap_arena.hh>
+# include <click/md5.h>
+# include <click/fromfile.hh>
+# include <sys/stat.h>
 #endif
 
 #if HAVE_DYNAMIC_LINKING && !CLICK_LINUXMODULE && !CLICK_BSDMODULE
@@ -376,6 +379,7 @@ RequireLexerExtra::require(String type, String value, ErrorHandler *errh)
 
 
 static Lexer *_click_lexer;
+static String *config_cache_dir;
 
 Lexer *
 click_lexer()
@@ -460,6 +464,8 @@ click_static_cleanup()
 {
     delete _click_lexer;
     _click_lexer = 0;
+    delete config_cache_dir;
+    config_cache_dir = 0;
 
 #if !(CLICK_LINUXMODULE || CLICK_BSDMODULE)
     delete[] provisions;
@@ -483,6 +489,116 @@ click_static_cleanup()
 # endif /* HAVE_DYNAMIC_LINKING */
 }
 
+/** @brief Cache flattened configurations in directory @a dir.
+ *
+ * After this call, click_read_router() saves each configuration it lexes,
+ * in binary form, under a name derived from a hash of the configuration
+ * text, the file name, the global parameter definitions, CLICKPATH, the
+ * lexer's optimization settings, and the Click version.  Reading the same configuration again creates the
+ * router directly from the saved form, skipping lexing and compound element
+ * expansion.  Configurations that use <tt>require(library ...)</tt> are
+ * not cached, since the library files' contents are not part of the hash.
+ * Pass an empty @a dir to turn caching off. */
+void
+click_set_config_cache(const String &dir)
+{
+    delete config_cache_dir;
+    config_cache_dir = (dir ? new String(dir) : 0);
+}
+
+static String
+config_cache_filename(const String &filename, const String &config_str)
+{
+    StringAccum sa;
+    sa << "click " << CLICK_VERSION << '\0' << filename << '\0';
+    const VariableEnvironment &scope = click_lexer()->global_scope();
+    for (int i = 0; i < scope.size(); ++i)
+	sa << scope.name(i) << '=' << scope.value(i) << '\0';
+    if (const char *path = getenv("CLICKPATH"))
+	sa << path;
+    sa << '\0' << click_lexer()->optimizer_signature() << '\0';
+
+    md5_state_t pms;
+    char buf[MD5_TEXT_DIGEST_MAX_SIZE];
+    md5_init(&pms);
+    md5_append(&pms, (const md5_byte_t *) sa.data(), sa.length());
+    md5_append(&pms, (const md5_byte_t *) config_str.data(), config_str.length());
+    int len = md5_finish_text(&pms, buf, 0);
+    return *config_cache_dir + "/" + String(buf, len) + ".clickcache";
+}
+
+static Router *
+read_config_cache(const String &cache_filename, const String &config_str,
+		  LexerExtra *lextra, Master *master, ErrorHandler *errh)
+{
+    if (access(cache_filename.c_str(), R_OK) != 0)
+	return 0;
+    String cache = file_string(cache_filename, ErrorHandler::silent_handler());
+    Router *router = new Router(config_str, master);
+    if (router->parse_cache(cache, click_lexer(), lextra, errh) < 0) {
+	delete router;
+	return 0;
+    }
+    return router;
+}
+
+static void
+write_config_cache(const String &cache_filename, const Router *router,
+		   ErrorHandler *errh)
+{
+    StringAccum sa;
+    router->unparse_cache(sa);
+    (void) mkdir(config_cache_dir->c_str(), 0777);
+
+    // write a temporary file, then rename, so readers never see partial caches
+    String tmp = cache_filename + ".tmp" + String(getpid());
+    FILE *f = fopen(tmp.c_str(), "wb");
+    bool ok = f && fwrite(sa.data(), 1, sa.length(), f) == (size_t) sa.length();
+    if (f && fclose(f) != 0)
+	ok = false;
+    if (ok && rename(tmp.c_str(), cache_filename.c_str()) == 0)
+	return;
+    int e = errno;
+    unlink(tmp.c_str());
+    errh->warning("%s: %s", cache_filename.c_str(), strerror(e));
+}
+
+namespace {
+
+// Configuration files at least this large are lexed as they are read,
+// rather than read into memory first.
+enum { stream_config_threshold = 16 << 20 };
+
+class FromFileLexerSource : public Lexer::Source { public:
+    FromFileLexerSource(FromFile &ff, ErrorHandler *errh)
+	: _ff(ff), _errh(errh) {
+    }
+    int read(char *buf, int len) {
+	return _ff.read(buf, len, _errh);
+    }
+  private:
+    FromFile &_ff;
+    ErrorHandler *_errh;
+};
+
+}
+
+static bool
+open_config_stream(const String &filename, FromFile &ff, ErrorHandler *errh)
+{
+    struct stat st;
+    if (!filename || filename == "-" || config_cache_dir
+	|| stat(filename.c_str(), &st) < 0 || !S_ISREG(st.st_mode)
+	|| st.st_size < stream_config_threshold)
+	return false;
+    ff.filename() = filename;
+    // archives are read whole
+    String first_line;
+    return ff.initialize(errh) >= 0
+	&& ff.peek_line(first_line, errh, true) > 0
+	&& first_line[0] != '!';
+}
+
 Router *
 click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initialize, Master *master)
 {
@@ -492,16 +608,23 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
 
     // read file
     String config_str;
+    FromFile config_file;
+    bool stream = false;
     if (is_expr) {
 	config_str = filename;
 	filename = "config";
-    } else {
+    } else if (open_config_stream(filename, config_file, errh))
+	stream = true;
+    else {
 	config_str = file_string(filename, errh);
 	if (!filename || filename == "-")
 	    filename = "<stdin>";
     }
     if (errh->nerrors() > before)
 	return 0;
+    String cache_filename;
+    if (config_cache_dir)
+	cache_filename = config_cache_filename(filename, config_str);
 
     // find config string in archive
     Vector<ArchiveElement> archive;
@@ -515,14 +638,29 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
 	}
     }
 
-    // lex
-    Lexer *l = click_lexer();
+    // lex, unless the configuration is cached
     RequireLexerExtra lextra(&archive);
-    int cookie = l->begin_parse(config_str, filename, &lextra, errh);
-    while (l->ystatement())
-	/* do nothing */;
-    Router *router = l->create_router(master ? master : new Master(1));
-    l->end_parse(cookie);
+    if (!master)
+	master = new Master(1);
+    Router *router = 0;
+    if (cache_filename)
+	router = read_config_cache(cache_filename, config_str, &lextra, master, errh);
+    if (!router) {
+	Lexer *l = click_lexer();
+	FromFileLexerSource source(config_file, errh);
+	int cookie;
+	if (stream)
+	    cookie = l->begin_parse(&source, filename, &lextra, errh);
+	else
+	    cookie = l->begin_parse(config_str, filename, &lextra, errh);
+	while (l->ystatement())
+	    /* do nothing */;
+	router = l->create_router(master);
+	if (router && cache_filename && errh->nerrors() == before
+	    && !l->libraries().size())
+	    write_config_cache(cache_filename, router, errh);
+	l->end_parse(cookie);
+    }
 
     // initialize if requested
     if (initialize)
@@ -113,8 +113,9 @@ int Element::nelements_allocated = 0;
   live_reconfigure().</dd>
   <dt>Packet and event processing</dt>
   <dd>These functions are called as the router runs to process packets and
-  other events.  Examples: push(), pull(), simple_action(), run_task(),
-  run_timer(), selected().</dd>
+  other events.  Examples: push(), pull(), simple_action(), push_batch(),
+  pull_batch(), simple_action_batch(), run_task(), run_timer(),
+  selected().</dd>
   </dl>
 
   <h3>Examples</h3>
@@ -417,7 +418,7 @@ void BetterIPCounter3::push(int port, Packet *p) {
 
 /** @brief Construct an Element. */
 Element::Element()
-    : _router(0), _eindex(-1)
+    : _router(0), _eindex(-1), _memory_limit(0)
 {
     nelements_allocated++;
     _ports[0] = _ports[1] = &_inline_ports[0];
@@ -426,6 +427,9 @@ Element::Element()
 #if CLICK_STATS >= 2
     reset_cycles();
 #endif
+#if HAVE_ELEMENT_PROFILE
+    reset_profile();
+#endif
 }
 
 Element::~Element()
@@ -1022,6 +1026,8 @@ Element::port_flow(bool isoutput, int p, Bitvector* travels) const
 {
     // Another version of this function is in tools/lib/processingt.cc.
     // Make sure you keep them in sync.
+    if (_router->indexed_port_flow(isoutput, this, p, travels))
+	return;
     const char *f = _router->flow_code_override(eindex());
     if (!f)
 	f = flow_code();
@@ -1198,6 +1204,28 @@ Element::processing_vector(int* in_v, int* out_v, ErrorHandler* errh) const
  * The click-align tool only generates AlignmentInfo for <tt>A</tt>-flagged
  * elements.</dd>
  *
+ * <dt><tt>C</tt></dt> <dd>This element's configure() method may run at the
+ * same time as other <tt>C</tt>-flagged elements' configure() methods, on
+ * different threads.  It must touch only the element's own state, except
+ * for reporting errors and querying (not defining) NameInfo names.  When
+ * Router::set_configure_threads() allows it, the router configures all
+ * <tt>C</tt>-flagged elements in a configure phase concurrently, after the
+ * phase's other elements.  Large routing tables use this flag.</dd>
+ *
+ * <dt><tt>I</tt></dt> <dd>This element's initialize() method may run at the
+ * same time as other <tt>I</tt>-flagged elements' initialize() methods, on
+ * different threads.  The same restrictions apply as for <tt>C</tt>; in
+ * particular, the method must not schedule tasks or timers, use the shared
+ * random number generator, or set router attachments.  Under the same
+ * conditions as <tt>C</tt>, the router initializes all <tt>I</tt>-flagged
+ * elements in a configure phase concurrently, after the phase's other
+ * elements, and reports their errors in configure order.</dd>
+ *
+ * <dt><tt>T</tt></dt> <dd>This element reads packets' timestamp
+ * annotations.  Packet sources stamp packets only when some element
+ * downstream declares <tt>T</tt>; see Router::timestamp_required().  The
+ * flag may depend on the element's configuration.</dd>
+ *
  * <dt><tt>S0</tt></dt> <dd>This element neither generates nor consumes
  * packets.  In other words, every packet received on its inputs will be
  * emitted on its outputs, and every packet emitted on its outputs must have
@@ -1226,7 +1254,10 @@ int
 Element::flag_value(int flag) const
 {
     assert(flag > 0 && flag < 256);
-    for (const unsigned char *data = reinterpret_cast<const unsigned char *>(flags()); *data; ++data)
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(flags());
+    while (isspace(*data))
+	++data;
+    while (*data)
 	if (*data == flag) {
 	    if (data[1] && isdigit(data[1])) {
 		int value = 0;
@@ -1235,9 +1266,13 @@ Element::flag_value(int flag) const
 		return value;
 	    } else
 		return 1;
-	} else
+	} else {
+	    // skip to the next space-separated setting
+	    while (*data && !isspace(*data))
+		++data;
 	    while (isspace(*data))
 		++data;
+	}
     return -1;
 }
 
@@ -1290,6 +1325,56 @@ Element::configure_phase() const
     return CONFIGURE_PHASE_DEFAULT;
 }
 
+/** @brief Return the number of bytes this element prepends to packets.
+ *
+ * Encapsulation elements, such as @e EtherEncap and @e IPEncap, override
+ * this method to return the length of the header they push onto each packet.
+ * The router calls it after configure() and before initialize(); the result
+ * may depend on the element's configuration.  Router::headroom_required()
+ * sums these values along downstream paths so that packet sources can
+ * allocate enough headroom to avoid Packet::expensive_push().
+ *
+ * The default implementation returns 0. */
+int
+Element::encap_headroom() const
+{
+    return 0;
+}
+
+/** @brief Return how far this element moves packets' data pointer.
+ *
+ * The result is the number of bytes by which data() of a packet leaving the
+ * element's outputs lies past data() of the same packet on its inputs.  The
+ * router uses it to carry alignment requirements upstream; see
+ * Router::alignment_required().  Return DATA_SHIFT_UNKNOWN if the shift
+ * depends on the packet, as for @e StripToNetworkHeader or @e Align.
+ *
+ * The default implementation returns -encap_headroom(). */
+int
+Element::data_shift() const
+{
+    return -encap_headroom();
+}
+
+/** @brief Return the packet alignment this element wants on its inputs.
+ * @param[out] modulus power of two, at most 8
+ * @param[out] offset offset from a @a modulus-byte boundary
+ *
+ * Elements that read packet data with word loads, such as @e CheckIPHeader,
+ * override this method to return true and set @a modulus and @a offset to the
+ * alignment of data() that suits them.  The router combines these values
+ * along paths so that packet sources can place data correctly to start with
+ * (see Router::alignment_required()), leaving @e Align as a fallback.  Like
+ * encap_headroom(), this is called after configure() and before
+ * initialize().
+ *
+ * The default implementation returns false. */
+bool
+Element::input_alignment(int &, int &) const
+{
+    return false;
+}
+
 /** @brief Parse the element's configuration arguments.
  *
  * @param conf configuration arguments
@@ -1354,6 +1439,32 @@ Element::configure(Vector<String> &conf, ErrorHandler *errh)
     return Args(conf, this, errh).complete();
 }
 
+/** @brief Parse the element's configuration arguments one at a time.
+ * @param args configuration arguments
+ * @param errh error handler
+ *
+ * The router configures each element by calling configure_stream().  The
+ * default implementation collects @a args into a vector and calls
+ * configure(), so most elements need not know it exists.  Elements whose
+ * configurations can hold very many arguments, such as address tables,
+ * may override it to process each argument as @a args produces it, which
+ * avoids holding a second, split copy of the configuration in memory.
+ *
+ * The return value and error conventions are those of configure().
+ * Live reconfiguration still calls configure().
+ *
+ * @sa configure, ArgvecIterator
+ */
+int
+Element::configure_stream(ArgvecIterator &args, ErrorHandler *errh)
+{
+    Vector<String> conf;
+    String arg;
+    while (args.next(arg))
+	conf.push_back(arg);
+    return configure(conf, errh);
+}
+
 /** @brief Install the element's handlers.
  *
  * The add_handlers() method should install any handlers the element provides
@@ -1522,6 +1633,27 @@ Element::hotswap_element() const
     return 0;
 }
 
+/** @brief Return the number of bytes of dynamically allocated state the
+ * element holds.
+ *
+ * The result should count hash tables, route tables, flow records, stored
+ * packets (their Packet structures and data buffers), and any other memory
+ * that grows while the router runs.  It need not be exact, but it should be
+ * cheap to compute, ideally in constant time, since memory_exceeded() calls
+ * it before every allocation it guards.  The default implementation returns
+ * 0, which is correct for elements whose state has a fixed size.
+ *
+ * The element's "memory" read handler returns this value, and the global
+ * "memory" handler returns the sum over all elements plus the packet pools.
+ *
+ * @sa memory_limit(), memory_exceeded()
+ */
+size_t
+Element::memory_usage() const
+{
+    return 0;
+}
+
 /** @brief Clean up the element's state.
  *
  * @param stage this element's maximum initialization stage
@@ -1726,6 +1858,14 @@ Element::selected(int fd)
  * Otherwise, Click will constantly poll your element's selected(@a fd, @a
  * mask) method.
  *
+ * @note Include SELECT_EDGE in @a mask to request edge-triggered
+ * notification for @a fd.  Where the epoll() backend is in use, Click will
+ * then call selected() only when @a fd becomes newly ready, rather than on
+ * every pass while it remains ready, so an element that passes SELECT_EDGE
+ * must read (or write) @a fd until it returns EAGAIN before returning from
+ * selected().  The flag applies to all events on @a fd and lasts until every
+ * event on @a fd is removed.  Other backends ignore it.
+ *
  * @sa remove_select, selected
  */
 int
@@ -1996,6 +2136,12 @@ read_ports_handler(Element *e, void *)
     return e->router()->element_ports_string(e);
 }
 
+static String
+read_memory_handler(Element *e, void *)
+{
+    return String(e->memory_usage());
+}
+
 String
 Element::read_handlers_handler(Element *e, void *)
 {
@@ -2083,6 +2229,184 @@ Element::write_cycles_handler(const String &, Element *e, void *, ErrorHandler *
 }
 #endif
 
+#if HAVE_ELEMENT_PROFILE
+bool Element::the_profiling = false;
+bool Element::the_port_hooks = false;
+Element::PacketTracer Element::the_packet_tracer = 0;
+Element::ProfileCounter Element::the_profile_counter = 0;
+const char *Element::the_profile_counter_name = 0;
+
+/** @brief Turn run-time profiling on or off.
+ *
+ * While profiling is on, every push, pull and task call into an element
+ * adds to its profile_calls(), profile_packets() and profile_cycles()
+ * counts.  Cycles are measured with click_get_cycles() and exclude time
+ * spent in downstream or upstream elements the call reached.  While it is
+ * off, each transfer pays only a test of this flag.  Profiling is a
+ * process-wide setting; the global "profile" handler controls it and
+ * reports the counts.
+ *
+ * This is a lighter-weight, run-time alternative to CLICK_STATS >= 2. */
+void
+Element::set_profiling(bool profiling)
+{
+    the_profiling = profiling;
+    the_port_hooks = the_profiling || the_packet_tracer;
+}
+
+/** @brief Set a function called for every packet transfer.
+ * @param tracer tracer function, or null for none
+ *
+ * While a tracer is set, every packet pushed or pulled over a connection
+ * is passed to @a tracer along with the connection's source element and
+ * output port and destination element and input port.  Pushed packets are
+ * passed before the destination sees them; pulled packets, after the
+ * source returns them.  The tracer may read and change the packet's
+ * annotations, but nothing else.  The userlevel FlightRecorder element
+ * uses this to follow sampled packets through the configuration.  Like
+ * profiling, the tracer shares the single flag test each transfer pays
+ * when both are off. */
+void
+Element::set_packet_tracer(PacketTracer tracer)
+{
+    the_packet_tracer = tracer;
+    the_port_hooks = the_profiling || the_packet_tracer;
+}
+
+/** @brief Set an additional event counter for run-time profiling.
+ * @param counter function returning the calling thread's current count,
+ * or null for none
+ * @param name counter name for reports (must outlive the setting)
+ *
+ * While profiling, each call also samples @a counter before and after, and
+ * the differences accumulate in profile_events() just as cycles do.  The
+ * userlevel PerfCountInfo element uses this to attribute hardware events,
+ * such as cache misses, to elements.  Counts collected under a different
+ * counter are meaningless, so set the counter before turning profiling on. */
+void
+Element::set_profile_counter(ProfileCounter counter, const char *name)
+{
+    the_profile_counter = counter;
+    the_profile_counter_name = name;
+}
+
+/** @brief Clear this element's profile counts. */
+void
+Element::reset_profile()
+{
+    _profile_calls = _profile_packets = 0;
+    _profile_own_cycles = _profile_child_cycles = 0;
+    _profile_own_events = _profile_child_events = 0;
+}
+
+inline void
+Element::Port::trace(Packet *p, bool isoutput) const
+{
+    if (isoutput)
+	the_packet_tracer(p, _owner, this - _owner->_ports[1], _e, _port);
+    else
+	the_packet_tracer(p, _e, _port, _owner, this - _owner->_ports[0]);
+}
+
+void
+Element::Port::hooked_push(Packet *p) const
+{
+    if (the_packet_tracer)
+	trace(p, true);
+    if (!the_profiling) {
+# if HAVE_BOUND_PORT_TRANSFER
+	_bound.push(_e, _port, p);
+# else
+	_e->push(_port, p);
+# endif
+	return;
+    }
+    ProfileSample s;
+    _e->profile_begin(s);
+# if HAVE_BOUND_PORT_TRANSFER
+    _bound.push(_e, _port, p);
+# else
+    _e->push(_port, p);
+# endif
+    _e->profile_end(s, _owner, 1);
+}
+
+Packet *
+Element::Port::hooked_pull() const
+{
+    Packet *p;
+    if (!the_profiling) {
+# if HAVE_BOUND_PORT_TRANSFER
+	p = _bound.pull(_e, _port);
+# else
+	p = _e->pull(_port);
+# endif
+    } else {
+	ProfileSample s;
+	_e->profile_begin(s);
+# if HAVE_BOUND_PORT_TRANSFER
+	p = _bound.pull(_e, _port);
+# else
+	p = _e->pull(_port);
+# endif
+	_e->profile_end(s, _owner, p != 0);
+    }
+    if (p && the_packet_tracer)
+	trace(p, false);
+    return p;
+}
+
+void
+Element::Port::hooked_push_batch(PacketBatch &batch) const
+{
+    if (the_packet_tracer)
+	for (Packet *p = batch.front(); p; p = p->next())
+	    trace(p, true);
+    if (!the_profiling) {
+	_e->push_batch(_port, batch);
+	return;
+    }
+    ProfileSample s;
+    int count = batch.count();
+    _e->profile_begin(s);
+    _e->push_batch(_port, batch);
+    _e->profile_end(s, _owner, count);
+}
+
+void
+Element::Port::hooked_pull_batch(PacketBatch &batch, int max) const
+{
+    int old_count = batch.count();
+    Packet *last = batch.back();
+    if (!the_profiling)
+	_e->pull_batch(_port, batch, max);
+    else {
+	ProfileSample s;
+	_e->profile_begin(s);
+	_e->pull_batch(_port, batch, max);
+	_e->profile_end(s, _owner, batch.count() - old_count);
+    }
+    if (the_packet_tracer)
+	for (Packet *p = last ? last->next() : batch.front(); p; p = p->next())
+	    trace(p, false);
+}
+
+String
+Element::read_profile_handler(Element *e, void *thunk)
+{
+    switch ((intptr_t) thunk) {
+    case 0:
+	return String(e->_profile_own_cycles);
+    case 1:
+	return String(e->_profile_calls);
+    case 2:
+	return String(e->_profile_packets);
+    default:
+	return String(e->_profile_own_events);
+    }
+}
+#endif
+
 void
 Element::add_default_handlers(bool allow_write_config)
 {
@@ -2093,6 +2417,7 @@ Element::add_default_handlers(bool allow_write_config)
     add_write_handler("config", write_config_handler, 0);
   add_read_handler("ports", read_ports_handler, 0, Handler::h_calm);
   add_read_handler("handlers", read_handlers_handler, 0, Handler::h_calm);
+  add_read_handler("memory", read_memory_handler, 0);
 #if CLICK_STATS >= 1
   add_read_handler("icounts", read_icounts_handler, 0);
   add_read_handler("ocounts", read_ocounts_handler, 0);
@@ -2101,6 +2426,12 @@ Element::add_default_handlers(bool allow_write_config)
   add_write_handler("cycles", write_cycles_handler, 0);
 # endif
 #endif
+#if HAVE_ELEMENT_PROFILE
+  add_read_handler("cycles", read_profile_handler, 0);
+  add_read_handler("calls", read_profile_handler, 1);
+  add_read_handler("packets", read_profile_handler, 2);
+  add_read_handler("events", read_profile_handler, 3);
+#endif
 }
 
 #if HAVE_STRIDE_SCHED
@@ -2616,6 +2947,84 @@ Element::add_net_order_data_handlers(const char *name, int flags, uint32_t *data
     add_data_handlers(name, flags, uint32_t_net_data_handler, data);
 }
 
+/** @brief Register a statistic named @a name.
+ *
+ * @param name statistic name
+ * @param data pointer to the counter
+ *
+ * Registers the counter at @a *data as a statistic of this element.  The
+ * router's statistics are listed, with their ids, by the global "stats" read
+ * handler, and the CLICK_LLRPC_GET_STATS low-level RPC reads any number of
+ * them, by id, in one call, with no text formatting.  Register statistics
+ * from add_handlers().  @a name and @a data must remain valid for as long
+ * as the router containing this element.
+ *
+ * @sa Router::nstats, Router::stat_value
+ */
+void
+Element::add_stat(const char *name, const uint32_t *data)
+{
+    router()->add_stat(this, name, Router::STAT_UINT32, data);
+}
+
+/** @overload */
+void
+Element::add_stat(const char *name, const uint64_t *data)
+{
+    router()->add_stat(this, name, Router::STAT_UINT64, data);
+}
+
+/** @overload */
+void
+Element::add_stat(const char *name, const atomic_uint32_t *data)
+{
+    router()->add_stat(this, name, Router::STAT_ATOMIC_UINT32, data);
+}
+
+/** @brief Register a statistic named @a name computed by @a callback.
+ *
+ * @param name statistic name
+ * @param callback function returning the statistic's value
+ * @param user_data user data parameter passed to @a callback
+ *
+ * Use this version when the statistic is not a single counter, for example
+ * a sum over per-thread counters.  @a callback(this, @a user_data) must not
+ * block; it may run in parallel with packet processing.
+ */
+void
+Element::add_stat(const char *name, StatCallback callback, void *user_data)
+{
+    router()->add_stat(this, name, Router::STAT_CALLBACK, user_data, callback);
+}
+
+static int
+memory_limit_handler(int op, String &str, Element *e, const Handler *,
+		     ErrorHandler *errh)
+{
+    if (op == Handler::h_read) {
+	str = String(e->memory_limit());
+	return 0;
+    }
+    size_t limit;
+    if (!IntArg().parse(cp_uncomment(str), limit))
+	return errh->error("syntax error");
+    e->set_memory_limit(limit);
+    return 0;
+}
+
+/** @brief Register a read/write "memory_limit" handler.
+ *
+ * The handler reads or sets the element's soft memory limit in bytes, as
+ * returned by memory_limit(); 0, the default, means no limit.  Call this from
+ * add_handlers() in elements that check memory_exceeded() before growing
+ * their state. */
+void
+Element::add_memory_limit_handler()
+{
+    set_handler("memory_limit", Handler::h_read | Handler::h_write,
+		memory_limit_handler);
+}
+
 
 static int
 configuration_handler(int operation, String &str, Element *e,
@@ -2889,6 +3298,71 @@ Element::push(int port, Packet *p)
 	output(port).push(p);
 }
 
+#if HAVE_PUSH_FUSION
+/** @brief Push a packet through this port's fused chain.
+ *
+ * Router::initialize() fuses chains of elements that leave push() to this
+ * class, so that each passes packets from input 0 to output 0 through
+ * simple_action().  Pushing over a port into such a chain calls each
+ * element's simple_action() in turn from one loop, then pushes the result
+ * to the last element's output 0, just as the elements' own push() calls
+ * would, but without their indirect calls and stack frames. */
+void
+Element::Port::fused_push(Packet *p) const
+{
+    Element* const* chain = _fused;
+    Element *e;
+    do {
+	e = *chain;
+	if (!(p = e->simple_action(p)))
+	    return;
+    } while (*++chain);
+    e->_ports[1][0].push(p);
+}
+#endif
+
+#if HAVE_DIRECT_PORT_TRANSFER
+enum { ndirect_push_capacity = 16 };
+static struct {
+    const char *class_name;
+    Element::DirectPushFunction push;
+} direct_pushes[ndirect_push_capacity];
+static int ndirect_pushes;
+
+/** @brief Register a specialized push function for an element class.
+ * @param class_name the class_name() of elements @a push handles
+ * @param push a function, usually direct_push<T> or
+ * direct_simple_action<T>, that behaves like push() on such elements
+ *
+ * Router::initialize() makes every push port into an element whose
+ * class_name() equals @a class_name call @a push directly, instead of
+ * making a virtual push() call.  Element classes register functions from
+ * their static_initialize() methods.  Only a few of the most common
+ * classes are worth registering; registrations after the sixteenth are
+ * ignored.
+ * @sa find_direct_push() */
+void
+Element::add_direct_push(const char *class_name, DirectPushFunction push)
+{
+    if (ndirect_pushes < ndirect_push_capacity) {
+	direct_pushes[ndirect_pushes].class_name = class_name;
+	direct_pushes[ndirect_pushes].push = push;
+	++ndirect_pushes;
+    }
+}
+
+/** @brief Return the specialized push function for @a class_name, or null.
+ * @sa add_direct_push() */
+Element::DirectPushFunction
+Element::find_direct_push(const char *class_name)
+{
+    for (int i = 0; i < ndirect_pushes; ++i)
+	if (strcmp(direct_pushes[i].class_name, class_name) == 0)
+	    return direct_pushes[i].push;
+    return 0;
+}
+#endif
+
 /** @brief Pull a packet from pull output @a port.
  *
  * @param port the output port number receiving the pull request.
@@ -2965,6 +3439,99 @@ Element::simple_action(Packet *p)
     return p;
 }
 
+/** @brief Push the packets in @a batch onto push input @a port.
+ *
+ * @param port the input port number on which the packets arrive
+ * @param batch the packets
+ *
+ * An upstream element transferred several packets at once over a push
+ * connection using Port::push_batch().  Like push(), push_batch() must
+ * account for every packet in @a batch; @a batch must be empty on return.
+ *
+ * The default implementation removes packets from @a batch one at a time and
+ * passes each to push(), so elements that only define push() or
+ * simple_action() work unchanged.  Elements that can amortize work over a
+ * burst should override push_batch().  Elements built on simple_action()
+ * usually just forward the batch through simple_action_batch():
+ *
+ * @code
+ * void MyElement::push_batch(int port, PacketBatch &batch)
+ * {
+ *     simple_action_batch(batch);
+ *     output(port).push_batch(batch);
+ * }
+ * @endcode
+ *
+ * @sa simple_action_batch, pull_batch
+ */
+void
+Element::push_batch(int port, PacketBatch &batch)
+{
+    while (Packet *p = batch.pop_front())
+	push(port, p);
+}
+
+/** @brief Pull up to @a max packets from pull output @a port.
+ *
+ * @param port the output port number receiving the pull request
+ * @param batch batch to which pulled packets are appended
+ * @param max maximum number of packets to append
+ *
+ * A downstream element requested several packets at once using
+ * Port::pull_batch().  pull_batch() should append at most @a max packets to
+ * the end of @a batch, leaving any packets already in @a batch alone.  It may
+ * append fewer packets, or none.
+ *
+ * The default implementation calls pull() until it returns null or @a max
+ * packets have been appended.  Elements built on simple_action() can pull a
+ * whole batch from upstream and process it with simple_action_batch():
+ *
+ * @code
+ * void MyElement::pull_batch(int port, PacketBatch &batch, int max)
+ * {
+ *     PacketBatch b;
+ *     input(port).pull_batch(b, max);
+ *     simple_action_batch(b);
+ *     batch.append(b);
+ * }
+ * @endcode
+ *
+ * @sa simple_action_batch, push_batch
+ */
+void
+Element::pull_batch(int port, PacketBatch &batch, int max)
+{
+    for (int n = 0; n < max; ++n)
+	if (Packet *p = pull(port))
+	    batch.push_back(p);
+	else
+	    break;
+}
+
+/** @brief Process a batch of packets for a simple packet filter.
+ *
+ * @param batch the input packets; on return, the output packets
+ *
+ * This is the batch analogue of simple_action().  It should replace the
+ * contents of @a batch with the packets to forward on the corresponding
+ * output, accounting for every input packet as simple_action() would.
+ *
+ * The default implementation calls simple_action() on each packet in turn,
+ * keeping the non-null results in order.  Elements may override it to
+ * amortize per-packet costs, such as statistics updates, across a batch.
+ *
+ * @sa simple_action, push_batch, pull_batch
+ */
+void
+Element::simple_action_batch(PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if ((p = simple_action(p)))
+	    out.push_back(p);
+    batch.swap(out);
+}
+
 /** @brief Run the element's task.
  *
  * @return true if the task accomplished some meaningful work, false otherwise
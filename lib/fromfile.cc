@@ -31,12 +31,27 @@
 #ifdef ALLOW_MMAP
 # include <sys/mman.h>
 #endif
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+# include <signal.h>
+# include <poll.h>
+# if HAVE_ZLIB
+#  include <zlib.h>
+# endif
+#endif
+#ifdef __SSE2__
+# include <emmintrin.h>
+# include <click/integers.hh>
+#endif
 CLICK_DECLS
 
 FromFile::FromFile()
     : _fd(-1), _buffer(0), _data_packet(0),
 #ifdef ALLOW_MMAP
       _mmap(true),
+#endif
+#if HAVE_USER_MULTITHREAD
+      _prefetch(0), _prefetcher(0),
 #endif
       _filename(), _pipe(0), _landmark_pattern("%f"), _lineno(0)
 {
@@ -50,10 +65,21 @@ FromFile::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *err
 #else
     bool mmap = _mmap;
 #endif
+    unsigned prefetch = 0;
     if (Args(e, errh).bind(conf)
 	.read("MMAP", mmap)
+	.read("PREFETCH", prefetch)
 	.consume() < 0)
 	return -1;
+#if HAVE_USER_MULTITHREAD
+    _prefetch = prefetch;
+    // the prefetch thread reads ahead; mapping the file would defeat it
+    if (prefetch)
+	mmap = false;
+#else
+    if (prefetch)
+	errh->warning("'PREFETCH' requires multithreading support");
+#endif
 #ifdef ALLOW_MMAP
     _mmap = mmap;
 #else
@@ -116,6 +142,352 @@ FromFile::warning(ErrorHandler *errh, const char *format, ...) const
     return r;
 }
 
+#if HAVE_USER_MULTITHREAD
+/* A Prefetcher reads a file on its own thread, staying up to "depth"
+   chunks ahead of the FromFile that consumes them, so the consumer rarely
+   waits for the disk or for a decompressor.  With zlib, gzip data is
+   inflated on the prefetch thread instead of in a zcat child process.
+   Each chunk is a malloc()ed buffer of PREFETCH_UNIT bytes; the consumer
+   takes ownership and wraps it in a Packet.  Every chunk but the last is
+   full. */
+class FromFile::Prefetcher { public:
+
+    Prefetcher(int fd, int depth, bool detect);
+    ~Prefetcher();
+
+    int start();
+    int take(unsigned char *&data, uint32_t &len);
+    const char *error_string() const;
+
+    bool inflating() const {
+	return _inflating;
+    }
+    bool seekable() const {
+	return _regular && !_inflating;
+    }
+
+  private:
+
+    struct Chunk {
+	unsigned char *data;
+	uint32_t len;
+    };
+
+    int _fd;
+    bool _regular;
+    bool _detect;
+    bool _inflating;
+
+    pthread_mutex_t _lock;
+    pthread_cond_t _nonempty;
+    pthread_cond_t _nonfull;
+    pthread_t _thread;
+    bool _running;
+    volatile bool _stop;
+
+    Chunk *_ring;
+    int _depth;
+    int _head;
+    int _count;
+    bool _eof;
+    int _error;
+    const char *_zerror;
+
+#if HAVE_ZLIB
+    z_stream _z;
+    unsigned char *_zin;
+    bool _zin_eof;
+    bool _zend;
+#endif
+
+    static void *thread_hook(void *);
+    void run();
+    ssize_t read_raw(unsigned char *buf, size_t len);
+    int fill(unsigned char *buf, uint32_t &len);
+#if HAVE_ZLIB
+    int inflate_fill(unsigned char *buf, uint32_t &len);
+#endif
+
+};
+
+FromFile::Prefetcher::Prefetcher(int fd, int depth, bool detect)
+    : _fd(fd), _regular(false), _detect(detect), _inflating(false),
+      _running(false), _stop(false), _ring(new Chunk[depth]), _depth(depth),
+      _head(0), _count(0), _eof(false), _error(0), _zerror(0)
+{
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) >= 0 && S_ISREG(statbuf.st_mode))
+	_regular = true;
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_nonempty, 0);
+    pthread_cond_init(&_nonfull, 0);
+#if HAVE_ZLIB
+    _zin = 0;
+    _zin_eof = _zend = false;
+#endif
+}
+
+FromFile::Prefetcher::~Prefetcher()
+{
+    pthread_mutex_lock(&_lock);
+    _stop = true;
+    pthread_cond_signal(&_nonfull);
+    pthread_mutex_unlock(&_lock);
+    if (_running)
+	pthread_join(_thread, 0);
+    for (int i = 0; i < _count; ++i)
+	free(_ring[(_head + i) % _depth].data);
+    delete[] _ring;
+#if HAVE_ZLIB
+    if (_inflating)
+	inflateEnd(&_z);
+    delete[] _zin;
+#endif
+    pthread_cond_destroy(&_nonfull);
+    pthread_cond_destroy(&_nonempty);
+    pthread_mutex_destroy(&_lock);
+}
+
+int
+FromFile::Prefetcher::start()
+{
+    // leave signals to the driver's threads
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&_thread, 0, thread_hook, this);
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    _running = (err == 0);
+    return -err;
+}
+
+void *
+FromFile::Prefetcher::thread_hook(void *thunk)
+{
+    static_cast<Prefetcher *>(thunk)->run();
+    return 0;
+}
+
+void
+FromFile::Prefetcher::run()
+{
+    while (1) {
+	pthread_mutex_lock(&_lock);
+	while (_count == _depth && !_stop)
+	    pthread_cond_wait(&_nonfull, &_lock);
+	pthread_mutex_unlock(&_lock);
+	if (_stop)
+	    return;
+
+	uint32_t len = 0;
+	unsigned char *data = (unsigned char *) malloc(PREFETCH_UNIT);
+	int r = data ? fill(data, len) : -ENOMEM;
+
+	pthread_mutex_lock(&_lock);
+	if (len) {
+	    Chunk &c = _ring[(_head + _count) % _depth];
+	    c.data = data;
+	    c.len = len;
+	    ++_count;
+	} else
+	    free(data);
+	if (r < 0)
+	    _error = -r;
+	else if (len < PREFETCH_UNIT)
+	    _eof = true;
+	bool done = _eof || _error;
+	pthread_cond_signal(&_nonempty);
+	pthread_mutex_unlock(&_lock);
+	if (done)
+	    return;
+    }
+}
+
+ssize_t
+FromFile::Prefetcher::read_raw(unsigned char *buf, size_t len)
+{
+    while (1) {
+	// poll pipes and terminals so that the destructor need not wait for
+	// input that may never come
+	if (!_regular) {
+	    struct pollfd p;
+	    p.fd = _fd;
+	    p.events = POLLIN;
+	    int r = poll(&p, 1, 100);
+	    if (_stop)
+		return -ECANCELED;
+	    else if (r == 0 || (r < 0 && errno == EINTR))
+		continue;
+	}
+	ssize_t got = ::read(_fd, buf, len);
+	if (got >= 0)
+	    return got;
+	else if (errno != EINTR && errno != EAGAIN)
+	    return -errno;
+    }
+}
+
+int
+FromFile::Prefetcher::fill(unsigned char *buf, uint32_t &len)
+{
+#if HAVE_ZLIB
+    if (_inflating)
+	return inflate_fill(buf, len);
+#endif
+    while (len < PREFETCH_UNIT) {
+	ssize_t got = read_raw(buf + len, PREFETCH_UNIT - len);
+	if (got < 0)
+	    return got;
+	else if (got == 0)
+	    break;
+	len += got;
+#if HAVE_ZLIB
+	// check the first bytes for a gzip signature
+	if (_detect && len >= 2) {
+	    _detect = false;
+	    if (buf[0] == 037 && buf[1] == 0213) {
+		memset(&_z, 0, sizeof(_z));
+		if (inflateInit2(&_z, 15 + 16) != Z_OK) {
+		    _zerror = "cannot initialize zlib";
+		    return -EINVAL;
+		}
+		_inflating = true;
+		_zin = new unsigned char[PREFETCH_UNIT];
+		memcpy(_zin, buf, len);
+		_z.next_in = _zin;
+		_z.avail_in = len;
+		len = 0;
+		return inflate_fill(buf, len);
+	    }
+	}
+#endif
+    }
+    return 0;
+}
+
+#if HAVE_ZLIB
+int
+FromFile::Prefetcher::inflate_fill(unsigned char *buf, uint32_t &len)
+{
+    _z.next_out = buf;
+    _z.avail_out = PREFETCH_UNIT;
+    while (_z.avail_out) {
+	if (_z.avail_in == 0 && !_zin_eof) {
+	    ssize_t got = read_raw(_zin, PREFETCH_UNIT);
+	    if (got < 0) {
+		len = PREFETCH_UNIT - _z.avail_out;
+		return got;
+	    }
+	    _z.next_in = _zin;
+	    _z.avail_in = got;
+	    _zin_eof = (got == 0);
+	}
+	if (_z.avail_in == 0)	// end of file, possibly truncated
+	    break;
+	// gzip files may hold several members in a row
+	if (_zend) {
+	    inflateReset(&_z);
+	    _zend = false;
+	}
+	int r = inflate(&_z, Z_NO_FLUSH);
+	if (r == Z_STREAM_END)
+	    _zend = true;
+	else if (r != Z_OK) {
+	    _zerror = (_z.msg ? _z.msg : "corrupt gzip data");
+	    len = PREFETCH_UNIT - _z.avail_out;
+	    return -EINVAL;
+	}
+    }
+    len = PREFETCH_UNIT - _z.avail_out;
+    return 0;
+}
+#endif
+
+int
+FromFile::Prefetcher::take(unsigned char *&data, uint32_t &len)
+{
+    pthread_mutex_lock(&_lock);
+    while (!_count && !_eof && !_error)
+	pthread_cond_wait(&_nonempty, &_lock);
+    int r;
+    if (_count) {
+	data = _ring[_head].data;
+	len = _ring[_head].len;
+	_head = (_head + 1) % _depth;
+	--_count;
+	pthread_cond_signal(&_nonfull);
+	r = 1;
+    } else
+	r = (_error ? -1 : 0);
+    pthread_mutex_unlock(&_lock);
+    return r;
+}
+
+const char *
+FromFile::Prefetcher::error_string() const
+{
+    return _zerror ? _zerror : strerror(_error);
+}
+
+static void
+prefetch_destructor(unsigned char *data, size_t)
+{
+    free(data);
+}
+
+int
+FromFile::start_prefetch(bool detect, ErrorHandler *errh)
+{
+    _prefetcher = new Prefetcher(_fd, _prefetch, detect);
+    if (int err = _prefetcher->start()) {
+	stop_prefetch();
+	return error(errh, "prefetch thread: %s", strerror(-err));
+    }
+    return 0;
+}
+
+void
+FromFile::stop_prefetch()
+{
+    delete _prefetcher;
+    _prefetcher = 0;
+}
+
+bool
+FromFile::inflating() const
+{
+    return _prefetcher && _prefetcher->inflating();
+}
+
+int
+FromFile::read_buffer_prefetch(ErrorHandler *errh)
+{
+    unsigned char *data;
+    uint32_t len;
+    int r = _prefetcher->take(data, len);
+    if (r < 0)
+	return error(errh, "%s", _prefetcher->error_string());
+    else if (r == 0)
+	return 0;
+    _data_packet = Packet::make(data, PREFETCH_UNIT, prefetch_destructor);
+    if (!_data_packet) {
+	free(data);
+	return error(errh, strerror(ENOMEM));
+    }
+    _data_packet->take(PREFETCH_UNIT - len);
+    _buffer = _data_packet->data();
+    _len = len;
+    return _len;
+}
+
+#else
+bool
+FromFile::inflating() const
+{
+    return false;
+}
+#endif
+
 #ifdef ALLOW_MMAP
 static void
 munmap_destructor(unsigned char *data, size_t amount)
@@ -185,6 +557,11 @@ FromFile::read_buffer(ErrorHandler *errh)
     if (_fd < 0)
 	return -EBADF;
 
+#if HAVE_USER_MULTITHREAD
+    if (_prefetcher)
+	return read_buffer_prefetch(errh);
+#endif
+
 #ifdef ALLOW_MMAP
     if (_mmap) {
 	int result = read_buffer_mmap(errh);
@@ -239,14 +616,39 @@ FromFile::read(void *vdata, uint32_t dlen, ErrorHandler *errh)
     return dlen;
 }
 
+/** @brief Return the first '\n' or '\r' in [@a s, @a e), or @a e. */
+static inline const unsigned char *
+find_line_end(const unsigned char *s, const unsigned char *e)
+{
+#ifdef __SSE2__
+    // text trace lines run to 100 bytes or so; check 16 bytes at a time
+    __m128i nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    for (; e - s >= 16; s += 16) {
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+	unsigned m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, nl),
+						    _mm_cmpeq_epi8(x, cr)));
+	if (m)
+	    return s + ffs_lsb(m) - 1;
+    }
+#endif
+    while (s < e && *s != '\n' && *s != '\r')
+	s++;
+    return s;
+}
+
 int
 FromFile::read_line(String &result, ErrorHandler *errh, bool temporary)
 {
+    // a seek may leave _pos past the end of the current buffer
+    while (_pos > _len) {
+	int errcode = read_buffer(errh);
+	if (errcode <= 0)
+	    return errcode;
+    }
+
     // first, try to read a line from the current buffer
-    const unsigned char *s = _buffer + _pos;
+    const unsigned char *s = find_line_end(_buffer + _pos, _buffer + _len);
     const unsigned char *e = _buffer + _len;
-    while (s < e && *s != '\n' && *s != '\r')
-	s++;
     if (s < e && (*s == '\n' || s + 1 < e)) {
 	s += (*s == '\r' && s[1] == '\n' ? 2 : 1);
 	int new_pos = s - _buffer;
@@ -278,9 +680,8 @@ FromFile::read_line(String &result, ErrorHandler *errh, bool temporary)
 	    _pos = _len;
 	    done = true;
 	} else {
-	    s = _buffer, e = _buffer + _len;
-	    while (s < e && *s != '\n' && *s != '\r')
-		s++;
+	    e = _buffer + _len;
+	    s = find_line_end(_buffer, e);
 	    if (s < e && (*s == '\n' || s + 1 < e)) {
 		s += (*s == '\r' && s[1] == '\n' ? 2 : 1);
 		sa.append(_buffer, s - _buffer);
@@ -316,7 +717,7 @@ int
 FromFile::seek(off_t want, ErrorHandler* errh)
 {
     if (want >= _file_offset && want < (off_t) (_file_offset + _len)) {
-	_pos = want;
+	_pos = want - _file_offset;
 	return 0;
     }
 
@@ -332,11 +733,24 @@ FromFile::seek(off_t want, ErrorHandler* errh)
     struct stat statbuf;
     if (fstat(_fd, &statbuf) < 0)
 	return error(errh, "stat: %s", strerror(errno));
-    if (S_ISREG(statbuf.st_mode) && statbuf.st_size && want > statbuf.st_size)
+    if (S_ISREG(statbuf.st_mode) && statbuf.st_size && want > statbuf.st_size
+	&& !inflating())
 	return errh->error("FILEPOS out of range");
 
+#if HAVE_USER_MULTITHREAD
+    // a prefetcher shares the file offset: stop it, seek, and restart it
+    if (_prefetcher && _prefetcher->seekable()) {
+	stop_prefetch();
+	if (lseek(_fd, want, SEEK_SET) == (off_t) -1)
+	    return error(errh, "seek: %s", strerror(errno));
+	_pos = _len;
+	_file_offset = want - _len;
+	return start_prefetch(false, errh);
+    }
+#endif
+
     // try to seek
-    if (lseek(_fd, want, SEEK_SET) != (off_t) -1) {
+    if (!prefetching() && lseek(_fd, want, SEEK_SET) != (off_t) -1) {
 	_pos = _len;
 	_file_offset = want - _len;
 	return 0;
@@ -373,6 +787,10 @@ FromFile::initialize(ErrorHandler *errh, bool allow_nonexistent)
 #endif
     _file_offset = 0;
     _pos = _len = 0;
+#if HAVE_USER_MULTITHREAD
+    if (_prefetch && start_prefetch(true, errh) < 0)
+	return -1;
+#endif
     int result = read_buffer(errh);
     if (result < 0)
 	return -1;
@@ -382,10 +800,14 @@ FromFile::initialize(ErrorHandler *errh, bool allow_nonexistent)
 	return -ENOENT;
     }
 
-    // check for a gziped or bzip2d dump
+    // check for a gziped or bzip2d dump; the prefetcher may have inflated
+    // gzip data already
     if (_fd == STDIN_FILENO || _pipe)
 	/* cannot handle gzip or bzip2 */;
     else if (compressed_data(_buffer, _len)) {
+#if HAVE_USER_MULTITHREAD
+	stop_prefetch();
+#endif
 	close(_fd);
 	_fd = -1;
 	if (!(_pipe = open_uncompress_pipe(_filename, _buffer, _len, errh)))
@@ -412,6 +834,12 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
     _data_packet = o._data_packet;
     o._data_packet = 0;
 
+#if HAVE_USER_MULTITHREAD
+    stop_prefetch();
+    _prefetcher = o._prefetcher;
+    o._prefetcher = 0;
+#endif
+
 #ifdef ALLOW_MMAP
     if (_mmap != o._mmap)
 	errh->warning("different MMAP states");
@@ -428,6 +856,9 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
 void
 FromFile::cleanup()
 {
+#if HAVE_USER_MULTITHREAD
+    stop_prefetch();
+#endif
     if (_pipe)
 	pclose(_pipe);
     else if (_fd >= 0 && _fd != STDIN_FILENO)
@@ -557,7 +988,8 @@ FromFile::filesize_handler(Element *e, void *thunk)
 {
     FromFile *fd = reinterpret_cast<FromFile *>((uint8_t *)e + (intptr_t)thunk);
     struct stat s;
-    if (fd->_fd >= 0 && fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
+    if (fd->_fd >= 0 && !fd->inflating()
+	&& fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
 	return String(s.st_size);
     else
 	return "-";
@@ -591,4 +1023,130 @@ FromFile::add_handlers(Element* e, bool filepos_writable) const
 	e->add_write_handler("filepos", filepos_write_handler, (void *)offset);
 }
 
+void
+TraceIndex::clear()
+{
+    _entries.clear();
+    _first = _max = Timestamp();
+    _next_pos = 0;
+    _stride = default_stride;
+    _building = _loaded = _any = false;
+}
+
+void
+TraceIndex::start(uint32_t stride)
+{
+    clear();
+    _stride = stride;
+    _building = true;
+}
+
+static bool
+trace_file_stat(const String &trace_filename, struct stat &statbuf)
+{
+    return trace_filename && trace_filename != "-"
+	&& stat(trace_filename.c_str(), &statbuf) >= 0
+	&& S_ISREG(statbuf.st_mode);
+}
+
+int
+TraceIndex::load(const String &filename, const String &trace_filename,
+		 ErrorHandler *errh)
+{
+    clear();
+    struct stat statbuf;
+    if (!trace_file_stat(trace_filename, statbuf) || access(filename.c_str(), R_OK) < 0)
+	return -ENOENT;
+    String text = file_string(filename, errh);
+    if (!text)
+	return -EINVAL;
+
+    // header lines, then one "POS BEFORE" line per entry
+    const char *s = text.begin(), *end = text.end();
+    bool matched = false;
+    Vector<Entry> entries;
+    while (s < end) {
+	const char *eol = find(s, end, '\n');
+	String line = text.substring(s, eol);
+	s = eol + 1;
+	if (!line)
+	    continue;
+	else if (line[0] == '!') {
+	    long long size, mtime;
+	    if (sscanf(line.c_str(), "!trace %lld %lld", &size, &mtime) == 2)
+		matched = (size == (long long) statbuf.st_size
+			   && mtime == (long long) statbuf.st_mtime);
+	    else if (line.substring(0, 7) == "!first ")
+		cp_time(line.substring(7), &_first, true);
+	    continue;
+	}
+	const char *sp = find(line.begin(), line.end(), ' ');
+	Entry e;
+	if (!cp_file_offset(line.substring(line.begin(), sp), &e.pos)
+	    || sp == line.end()
+	    || !cp_time(line.substring(sp + 1, line.end()), &e.before, true))
+	    return errh->warning("%s: bad index entry, ignoring index", filename.c_str());
+	entries.push_back(e);
+    }
+    if (!matched) {
+	_first = Timestamp();
+	return -ENOENT;
+    }
+    _entries.swap(entries);
+    _loaded = true;
+    return 0;
+}
+
+int
+TraceIndex::save(const String &filename, const String &trace_filename,
+		 ErrorHandler *errh)
+{
+    struct stat statbuf;
+    if (!trace_file_stat(trace_filename, statbuf))
+	return -ENOENT;
+    StringAccum sa;
+    sa << "!TraceIndex 1\n"
+       << "!trace " << (long long) statbuf.st_size << ' '
+       << (long long) statbuf.st_mtime << '\n'
+       << "!first " << _first << '\n'
+       << "!stride " << _stride << '\n';
+    for (const Entry *e = _entries.begin(); e != _entries.end(); ++e)
+	sa << (long long) e->pos << ' ' << e->before << '\n';
+
+    // write a temporary file and rename it, so that concurrent readers
+    // never see a partial index
+    String tmp = filename + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (!f)
+	return errh->error("%s: %s", tmp.c_str(), strerror(errno));
+    size_t w = fwrite(sa.data(), 1, sa.length(), f);
+    if (fclose(f) != 0 || w != (size_t) sa.length()
+	|| rename(tmp.c_str(), filename.c_str()) < 0) {
+	int e = errno;
+	unlink(tmp.c_str());
+	return errh->error("%s: %s", filename.c_str(), strerror(e));
+    }
+    _building = false;
+    _loaded = true;
+    return 0;
+}
+
+off_t
+TraceIndex::seek(const Timestamp &start) const
+{
+    // every record before the returned position has a timestamp before
+    // start; entries[0] is always safe
+    int l = 0, r = _entries.size();
+    if (!r)
+	return 0;
+    while (r - l > 1) {
+	int m = l + (r - l) / 2;
+	if (_entries[m].before < start)
+	    l = m;
+	else
+	    r = m;
+    }
+    return _entries[l].pos;
+}
+
 CLICK_ENDDECLS
@@ -415,9 +415,59 @@ click_lfree(volatile void *p, size_t size)
 
 CLICK_DECLS
 
-#if CLICK_LINUXMODULE || (!CLICK_BSDMODULE && CLICK_RAND_MAX != RAND_MAX)
 uint32_t click_random_seed = 152;
+volatile uint32_t click_random_generation = 1;
+
+#if CLICK_LINUXMODULE
+click_random_state click_random_states[NR_CPUS];
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+__thread click_random_state click_random_thread_state;
+#else
+click_random_state click_random_global_state;
+#endif
+
+void
+click_random_reseed(click_random_state *st)
+{
+    // Each thread's stream depends only on the seed and its thread number,
+    // so seeded runs repeat.
+    uint32_t generation = click_random_generation;
+#if CLICK_LINUXMODULE
+    uint32_t stream = st - click_random_states;
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    uint32_t stream = click_current_thread_id + 1;
+#else
+    uint32_t stream = 0;
 #endif
+    // splitmix64 spreads the seed over the whole state
+    uint64_t x = ((uint64_t) click_random_seed << 32) | stream;
+    for (int i = 0; i < 4; i += 2) {
+	uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	st->s[i] = (uint32_t) z;
+	st->s[i + 1] = (uint32_t) (z >> 32);
+    }
+    if (!(st->s[0] | st->s[1] | st->s[2] | st->s[3]))
+	st->s[0] = 1;
+    st->generation = generation;
+}
+
+void
+click_srandom(uint32_t seed)
+{
+    click_random_seed = seed;
+    click_random_generation = click_random_generation + 1;
+}
+
+void
+click_random_fill(uint32_t *x, int n)
+{
+    click_random_state *st = click_random_current();
+    for (int i = 0; i < n; ++i)
+	x[i] = click_random_next(st) >> 1;
+}
 
 void
 click_random_srandom()
@@ -479,17 +529,18 @@ click_random(uint32_t low, uint32_t high)
 {
     if (unlikely(low > high))
 	return low;
+    click_random_state *st = click_random_current();
     uint32_t r;
     if (unlikely(high - low > CLICK_RAND_MAX)) {
-	while ((r = (click_random() << 17) ^ (click_random() >> 14)) > high - low)
+	while ((r = click_random_next(st)) > high - low)
 	    /* try again */;
 	return r + low;
     } else if (high == low + 1) { // common case
-	return low + ((click_random() >> 14) & 1);
+	return low + (click_random_next(st) >> 31);
     } else {
 	uint32_t count = ((uint32_t) CLICK_RAND_MAX + 1) / (high - low + 1);
 	uint32_t max = count * (high - low + 1);
-	while ((r = click_random()) > max)
+	while ((r = click_random_next(st) >> 1) >= max)
 	    /* try again */;
 	return (r / count) + low;
     }
@@ -696,7 +747,7 @@ click_gettimeofday(timeval *tvp)
 click_jiffies_t
 click_jiffies()
 {
-    return Timestamp::now().msecval();
+    return Timestamp::now_fast().msecval();
 }
 
 CLICK_ENDDECLS
@@ -23,7 +23,7 @@
 CLICK_DECLS
 
 HashAllocator::HashAllocator(size_t size)
-    : _free(0), _buffer(0), _size(size)
+    : _free(0), _buffer(0), _size(size), _nallocated(0)
 {
 #ifdef VALGRIND_CREATE_MEMPOOL
     VALGRIND_CREATE_MEMPOOL(this, 0, 0);
@@ -86,6 +86,10 @@ void HashAllocator::swap(HashAllocator &x)
     _buffer = x._buffer;
     x._buffer = xbuffer;
 
+    size_t xnallocated = _nallocated;
+    _nallocated = x._nallocated;
+    x._nallocated = xnallocated;
+
 #ifdef VALGRIND_MOVE_MEMPOOL
     VALGRIND_MOVE_MEMPOOL(this, reinterpret_cast<HashAllocator *>(100));
     VALGRIND_MOVE_MEMPOOL(&x, this);
@@ -93,4 +97,20 @@ void HashAllocator::swap(HashAllocator &x)
 #endif
 }
 
+size_t HashAllocator::capacity() const
+{
+    size_t n = 0;
+    for (buffer *b = _buffer; b; b = b->next)
+	n += (b->pos - sizeof(buffer)) / _size;
+    return n;
+}
+
+size_t HashAllocator::buffer_bytes() const
+{
+    size_t n = 0;
+    for (buffer *b = _buffer; b; b = b->next)
+	n += b->maxpos;
+    return n;
+}
+
 CLICK_ENDDECLS
@@ -16,38 +16,222 @@
 # include <string.h>
 #endif
 
+#if CLICK_USERLEVEL && defined(__x86_64__) && defined(__SSE2__)
+# define HAVE_IN_CKSUM_SSE2 1
+# include <emmintrin.h>
+# if defined(__AVX2__) || defined(__clang__) || __GNUC__ >= 5
+#  define HAVE_IN_CKSUM_AVX2 1
+#  include <immintrin.h>
+# endif
+#elif CLICK_USERLEVEL && defined(__ARM_NEON)
+# define HAVE_IN_CKSUM_NEON 1
+# include <arm_neon.h>
+#endif
+
 #if !CLICK_LINUXMODULE
-uint16_t
-click_in_cksum(const unsigned char *addr, int len)
+/*
+ * All checksum kernels return the plain (unfolded, uncomplemented) sum of
+ * the data's 16-bit words in host byte order.  Summing wider words gives the
+ * same result after folding, since 2^16 == 1 mod 0xFFFF.  If dst is nonnull,
+ * the kernels also copy the data there.  The vector kernels handle whole
+ * vectors only and leave the rest for cksum_scalar.
+ */
+
+static uint64_t
+cksum_scalar(const unsigned char *src, unsigned char *dst, int len)
 {
-    int nleft = len;
-    const uint16_t *w = (const uint16_t *)addr;
-    uint32_t sum = 0;
-    uint16_t answer = 0;
-
-    /*
-     * Our algorithm is simple, using a 32 bit accumulator (sum), we add
-     * sequential 16 bit words to it, and at the end, fold back all the
-     * carry bits from the top 16 bits into the lower 16 bits.
-     */
-    while (nleft > 1)  {
-	sum += *w++;
-	nleft -= 2;
+    uint64_t sum = 0;
+    uint32_t a, b;
+    uint16_t w;
+
+    for (; len >= 8; src += 8, len -= 8) {
+	memcpy(&a, src, 4);
+	memcpy(&b, src + 4, 4);
+	if (dst) {
+	    memcpy(dst, src, 8);
+	    dst += 8;
+	}
+	sum += a;
+	sum += b;
+    }
+    for (; len >= 2; src += 2, len -= 2) {
+	memcpy(&w, src, 2);
+	if (dst) {
+	    memcpy(dst, src, 2);
+	    dst += 2;
+	}
+	sum += w;
     }
 
     /* mop up an odd byte, if necessary */
-    if (nleft == 1) {
-	*(unsigned char *)(&answer) = *(const unsigned char *)w ;
-	sum += answer;
+    if (len == 1) {
+	w = 0;
+	*(unsigned char *)(&w) = *src;
+	if (dst)
+	    *dst = *src;
+	sum += w;
+    }
+    return sum;
+}
+
+#if HAVE_IN_CKSUM_SSE2
+/*
+ * The x86 kernels bias each word by 0x8000 so that PMADDWD's signed
+ * pairwise adds can be used, then remove the bias from each chunk's total.
+ * A chunk is short enough that no 32-bit lane can overflow.
+ */
+static uint64_t
+cksum_sse2(const unsigned char *src, unsigned char *dst, int nvec)
+{
+    const __m128i bias = _mm_set1_epi16((short) 0x8000);
+    const __m128i ones = _mm_set1_epi16(1);
+    uint64_t sum = 0;
+    while (nvec > 0) {
+	int n = nvec < 16384 ? nvec : 16384, i;
+	__m128i acc = _mm_setzero_si128();
+	int32_t lanes[4];
+	for (i = 0; i < n; ++i, src += 16) {
+	    __m128i v = _mm_loadu_si128((const __m128i *) src);
+	    if (dst) {
+		_mm_storeu_si128((__m128i *) dst, v);
+		dst += 16;
+	    }
+	    acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_xor_si128(v, bias), ones));
+	}
+	_mm_storeu_si128((__m128i *) lanes, acc);
+	sum += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3]
+	    + (int64_t) n * 8 * 0x8000;
+	nvec -= n;
     }
+    return sum;
+}
+#endif
+
+#if HAVE_IN_CKSUM_AVX2
+# ifndef __AVX2__
+__attribute__((target("avx2")))
+# endif
+static uint64_t
+cksum_avx2(const unsigned char *src, unsigned char *dst, int nvec)
+{
+    const __m256i bias = _mm256_set1_epi16((short) 0x8000);
+    const __m256i ones = _mm256_set1_epi16(1);
+    uint64_t sum = 0;
+    while (nvec > 0) {
+	int n = nvec < 16384 ? nvec : 16384, i;
+	__m256i acc = _mm256_setzero_si256();
+	int32_t lanes[8];
+	for (i = 0; i < n; ++i, src += 32) {
+	    __m256i v = _mm256_loadu_si256((const __m256i *) src);
+	    if (dst) {
+		_mm256_storeu_si256((__m256i *) dst, v);
+		dst += 32;
+	    }
+	    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_xor_si256(v, bias), ones));
+	}
+	_mm256_storeu_si256((__m256i *) lanes, acc);
+	sum += (int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3]
+	    + lanes[4] + lanes[5] + lanes[6] + lanes[7]
+	    + (int64_t) n * 16 * 0x8000;
+	nvec -= n;
+    }
+    return sum;
+}
+#endif
 
-    /* add back carry outs from top 16 bits to low 16 bits */
-    sum = (sum & 0xffff) + (sum >> 16);
+#if HAVE_IN_CKSUM_NEON
+static uint64_t
+cksum_neon(const unsigned char *src, unsigned char *dst, int nvec)
+{
+    uint64x2_t sum = vdupq_n_u64(0);
+    while (nvec > 0) {
+	int n = nvec < 16384 ? nvec : 16384, i;
+	uint32x4_t acc = vdupq_n_u32(0);
+	for (i = 0; i < n; ++i, src += 16) {
+	    uint8x16_t v = vld1q_u8(src);
+	    if (dst) {
+		vst1q_u8(dst, v);
+		dst += 16;
+	    }
+	    acc = vpadalq_u16(acc, vreinterpretq_u16_u8(v));
+	}
+	sum = vpadalq_u32(sum, acc);
+	nvec -= n;
+    }
+    return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+}
+#endif
+
+/* Buffers shorter than this are faster to checksum with cksum_scalar. */
+#define IN_CKSUM_VECTOR_MIN	64
+
+static int cksum_vector_shift;
+static uint64_t (*cksum_vector)(const unsigned char *, unsigned char *, int);
+
+static inline uint64_t
+cksum_any(const unsigned char *src, unsigned char *dst, int len)
+{
+    uint64_t sum = 0;
+#if HAVE_IN_CKSUM_SSE2 || HAVE_IN_CKSUM_NEON
+    if (len >= IN_CKSUM_VECTOR_MIN) {
+	int nvec, done;
+	uint64_t (*vector)(const unsigned char *, unsigned char *, int) =
+	    __atomic_load_n(&cksum_vector, __ATOMIC_ACQUIRE);
+	if (!vector) {
+	    // choose once; racing initializers all pick the same kernel.
+	    // Publish the shift before the kernel, so a thread that sees the
+	    // kernel also sees its shift.
+# if HAVE_IN_CKSUM_AVX2 && defined(__AVX2__)
+	    cksum_vector_shift = 5;
+	    vector = cksum_avx2;
+# elif HAVE_IN_CKSUM_AVX2
+	    __builtin_cpu_init();
+	    cksum_vector_shift = __builtin_cpu_supports("avx2") ? 5 : 4;
+	    vector = cksum_vector_shift == 5 ? cksum_avx2 : cksum_sse2;
+# elif HAVE_IN_CKSUM_SSE2
+	    cksum_vector_shift = 4;
+	    vector = cksum_sse2;
+# else
+	    cksum_vector_shift = 4;
+	    vector = cksum_neon;
+# endif
+	    __atomic_store_n(&cksum_vector, vector, __ATOMIC_RELEASE);
+	}
+	nvec = len >> cksum_vector_shift;
+	done = nvec << cksum_vector_shift;
+	sum = vector(src, dst, nvec);
+	src += done;
+	if (dst)
+	    dst += done;
+	len -= done;
+    }
+#endif
+    return sum + cksum_scalar(src, dst, len);
+}
+
+static inline uint16_t
+cksum_fold(uint64_t sum)
+{
+    /* add back carry outs from the top bits to the low 16 bits */
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
     sum += (sum >> 16);
     /* guaranteed now that the lower 16 bits of sum are correct */
+    return ~sum;		/* truncate to 16 bits */
+}
+
+uint16_t
+click_in_cksum(const unsigned char *addr, int len)
+{
+    return cksum_fold(cksum_any(addr, 0, len));
+}
 
-    answer = ~sum;              /* truncate to 16 bits */
-    return answer;
+uint16_t
+click_in_cksum_copy(unsigned char *dst, const unsigned char *src, int len)
+{
+    return cksum_fold(cksum_any(src, dst, len));
 }
 
 uint16_t
@@ -1,6 +1,6 @@
 // -*- c-basic-offset: 2; related-file-name: "../include/click/ip6table.hh" -*-
 /*
- * ip6table.{cc,hh} -- a stupid IP6 routing table, best for small routing tables
+ * ip6table.{cc,hh} -- IP6 routing table, stored as a tree bitmap
  * Peilei Fan, Robert Morris
  *
  * Copyright (c) 1999-2000 Massachusetts Institute of Technology
@@ -19,26 +19,126 @@
 #include <click/config.h>
 #include <click/ip6table.hh>
 #include <click/straccum.hh>
+#include <click/prefetch.hh>
 CLICK_DECLS
 
+static inline int
+popcount64(uint64_t x)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  int n = 0;
+  for (; x; x &= x - 1)
+    ++n;
+  return n;
+#endif
+}
+
+inline int
+IP6Table::rank(const uint64_t *bits, int i)
+{
+  int r = 0;
+  for (int w = 0; w < (i >> 6); ++w)
+    r += popcount64(bits[w]);
+  if (i & 63)
+    r += popcount64(bits[i >> 6] & ((((uint64_t) 1) << (i & 63)) - 1));
+  return r;
+}
+
+inline int
+IP6Table::internal_bit(int plen, const unsigned char *data, int depth)
+{
+  return (1 << plen) - 1 + (plen ? data[depth] >> (8 - plen) : 0);
+}
+
 IP6Table::IP6Table()
+  : _vfree(-1), _nroutes(0), _nnodes(1)
 {
+  memset(&_root, 0, sizeof(_root));
 }
 
 IP6Table::~IP6Table()
 {
+  clear();
 }
 
 bool
-IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
+IP6Table::node_empty(const Node &n)
 {
-  int best = -1;
+  return !n._children && !n._routes;
+}
 
-  for (int i = 0; i < _v.size(); i++)
-    if (_v[i]._valid && dst.matches_prefix(_v[i]._dst, _v[i]._mask)) {
-      if (best < 0 || _v[i]._mask.mask_as_specific(_v[best]._mask))
-        best = i;
-    }
+void
+IP6Table::free_node(Node &n)
+{
+  int nc = rank(n._external, 256);
+  for (int i = 0; i < nc; ++i)
+    free_node(n._children[i]);
+  delete[] n._children;
+  delete[] n._routes;
+  memset(&n, 0, sizeof(n));
+}
+
+void
+IP6Table::clear()
+{
+  free_node(_root);
+  _nnodes = 1;
+  _v.clear();
+  _vfree = -1;
+  _nroutes = 0;
+  _other.clear();
+}
+
+int
+IP6Table::new_entry(const IP6Address &dst, const IP6Address &mask,
+		    const IP6Address &gw, int index)
+{
+  int i = _vfree;
+  if (i >= 0)
+    _vfree = _v[i]._index;
+  else {
+    i = _v.size();
+    _v.push_back(Entry());
+  }
+  _v[i]._dst = dst;
+  _v[i]._mask = mask;
+  _v[i]._gw = gw;
+  _v[i]._index = index;
+  _v[i]._valid = 1;
+  ++_nroutes;
+  return i;
+}
+
+void
+IP6Table::free_entry(int i)
+{
+  _v[i]._valid = 0;
+  _v[i]._index = _vfree;
+  _vfree = i;
+  --_nroutes;
+}
+
+inline int
+IP6Table::match_internal(const Node *n, int b)
+{
+  for (int plen = 7; plen >= 0; --plen) {
+    int i = (1 << plen) - 1 + (b >> (8 - plen));
+    if (test(n->_internal, i))
+      return n->_routes[rank(n->_internal, i)];
+  }
+  return -1;
+}
+
+inline bool
+IP6Table::finish_lookup(const IP6Address &dst, int best,
+			IP6Address &gw, int &index) const
+{
+  for (const int *o = _other.begin(); o != _other.end(); ++o)
+    if (dst.matches_prefix(_v[*o]._dst, _v[*o]._mask)
+	&& (best < 0 || _v[*o]._mask.mask_as_specific(_v[best]._mask)))
+      best = *o;
 
   if (best < 0)
     return false;
@@ -49,37 +149,225 @@ IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
   }
 }
 
+bool
+IP6Table::lookup(const IP6Address &dst, IP6Address &gw, int &index) const
+{
+  const unsigned char *a = dst.data();
+  const Node *n = &_root;
+  int best = -1;
+
+  for (int depth = 0; ; ++depth) {
+    if (depth == 16) {
+      if (test(n->_internal, 0))
+	best = n->_routes[0];
+      break;
+    }
+    int b = a[depth];
+    int r = match_internal(n, b);
+    if (r >= 0)
+      best = r;
+    if (!test(n->_external, b))
+      break;
+    n = &n->_children[rank(n->_external, b)];
+  }
+
+  return finish_lookup(dst, best, gw, index);
+}
+
+// Look up n addresses, setting index[i] to -1 where no route matches.  The
+// walks advance one trie level per round, and each lane prefetches its next
+// node before any lane reads it, so the lanes' cache misses overlap instead
+// of following one another.
+void
+IP6Table::lookup(int n, const IP6Address *dst, IP6Address *gw, int *index) const
+{
+  for (; n > 0; n -= lanes, dst += lanes, gw += lanes, index += lanes) {
+    int m = n < lanes ? n : lanes;
+    const Node *node[lanes];
+    int best[lanes];
+    for (int i = 0; i < m; ++i) {
+      node[i] = &_root;
+      best[i] = -1;
+    }
+
+    for (int depth = 0, live = m; live; ++depth) {
+      live = 0;
+      for (int i = 0; i < m; ++i) {
+	const Node *x = node[i];
+	if (!x)
+	  continue;
+	if (depth == 16) {
+	  if (test(x->_internal, 0))
+	    best[i] = x->_routes[0];
+	  node[i] = 0;
+	  continue;
+	}
+	int b = dst[i].data()[depth];
+	int r = match_internal(x, b);
+	if (r >= 0)
+	  best[i] = r;
+	if (test(x->_external, b)) {
+	  node[i] = &x->_children[rank(x->_external, b)];
+	  click_prefetch(node[i]);
+	  ++live;
+	} else
+	  node[i] = 0;
+      }
+    }
+
+    for (int i = 0; i < m; ++i)
+      if (!finish_lookup(dst[i], best[i], gw[i], index[i]))
+	index[i] = -1;
+  }
+}
+
+int *
+IP6Table::find_slot(const IP6Address &dst, int plen) const
+{
+  const unsigned char *a = dst.data();
+  const Node *n = &_root;
+  int depth;
+  for (depth = 0; depth < plen / 8; ++depth) {
+    if (!test(n->_external, a[depth]))
+      return 0;
+    n = &n->_children[rank(n->_external, a[depth])];
+  }
+  int i = internal_bit(plen % 8, a, depth);
+  if (!test(n->_internal, i))
+    return 0;
+  return &n->_routes[rank(n->_internal, i)];
+}
+
+bool
+IP6Table::find(const IP6Address &dst, const IP6Address &mask,
+	       IP6Address &gw, int &index) const
+{
+  int plen = mask.mask_to_prefix_len();
+  IP6Address dstnet = dst & mask;
+  int found = -1;
+  if (plen >= 0) {
+    if (int *slot = find_slot(dstnet, plen))
+      found = *slot;
+  } else
+    for (const int *o = _other.begin(); o != _other.end(); ++o)
+      if (_v[*o]._dst == dstnet && _v[*o]._mask == mask)
+	found = *o;
+  if (found < 0)
+    return false;
+  gw = _v[found]._gw;
+  index = _v[found]._index;
+  return true;
+}
+
 void
 IP6Table::add(const IP6Address &dst, const IP6Address &mask,
 	      const IP6Address &gw, int index)
 {
-  struct Entry e;
+  int plen = mask.mask_to_prefix_len();
+  IP6Address dstnet = dst & mask;
 
-  e._dst = dst & mask;
-  e._mask = mask;
-  e._gw = gw;
-  e._index = index;
-  e._valid = 1;
+  // Replace any existing route for the same prefix.
+  int *slot = 0;
+  if (plen >= 0)
+    slot = find_slot(dstnet, plen);
+  else
+    for (int *o = _other.begin(); o != _other.end(); ++o)
+      if (_v[*o]._dst == dstnet && _v[*o]._mask == mask)
+	slot = o;
+  if (slot) {
+    _v[*slot]._gw = gw;
+    _v[*slot]._index = index;
+    return;
+  }
 
-  // Just in case, so we never encounter duplicate routes...
-  del(dst, mask);
+  int e = new_entry(dstnet, mask, gw, index);
+  if (plen < 0) {
+    _other.push_back(e);
+    return;
+  }
 
-  for (int i = 0; i < _v.size(); i++)
-    if (!_v[i]._valid) {
-      _v[i] = e;
-      return;
+  const unsigned char *a = dstnet.data();
+  Node *n = &_root;
+  int depth;
+  for (depth = 0; depth < plen / 8; ++depth) {
+    int b = a[depth], r = rank(n->_external, b);
+    if (!test(n->_external, b)) {
+      int nc = rank(n->_external, 256);
+      Node *c = new Node[nc + 1];
+      memcpy(c, n->_children, r * sizeof(Node));
+      memset(&c[r], 0, sizeof(Node));
+      memcpy(c + r + 1, n->_children + r, (nc - r) * sizeof(Node));
+      delete[] n->_children;
+      n->_children = c;
+      n->_external[b >> 6] |= ((uint64_t) 1) << (b & 63);
+      ++_nnodes;
     }
-  _v.push_back(e);
+    n = &n->_children[r];
+  }
+
+  int i = internal_bit(plen % 8, a, depth);
+  int nr = rank(n->_internal, 256), r = rank(n->_internal, i);
+  int *routes = new int[nr + 1];
+  memcpy(routes, n->_routes, r * sizeof(int));
+  routes[r] = e;
+  memcpy(routes + r + 1, n->_routes + r, (nr - r) * sizeof(int));
+  delete[] n->_routes;
+  n->_routes = routes;
+  n->_internal[i >> 6] |= ((uint64_t) 1) << (i & 63);
 }
 
 void
 IP6Table::del(const IP6Address &dst, const IP6Address &mask)
 {
+  int plen = mask.mask_to_prefix_len();
   IP6Address dstnet = dst & mask;
 
-  for (int i = 0; i < _v.size(); i++)
-    if (_v[i]._valid && (_v[i]._dst == dstnet) && (_v[i]._mask == mask))
-      _v[i]._valid = 0;
+  if (plen < 0) {
+    for (int *o = _other.begin(); o != _other.end(); ++o)
+      if (_v[*o]._dst == dstnet && _v[*o]._mask == mask) {
+	free_entry(*o);
+	_other.erase(o);
+	return;
+      }
+    return;
+  }
+
+  const unsigned char *a = dstnet.data();
+  Node *path[17];
+  int depth;
+  path[0] = &_root;
+  for (depth = 0; depth < plen / 8; ++depth) {
+    if (!test(path[depth]->_external, a[depth]))
+      return;
+    path[depth + 1] = &path[depth]->_children[rank(path[depth]->_external, a[depth])];
+  }
+
+  Node *n = path[depth];
+  int i = internal_bit(plen % 8, a, depth);
+  if (!test(n->_internal, i))
+    return;
+  int nr = rank(n->_internal, 256), r = rank(n->_internal, i);
+  free_entry(n->_routes[r]);
+  memmove(n->_routes + r, n->_routes + r + 1, (nr - r - 1) * sizeof(int));
+  n->_internal[i >> 6] &= ~(((uint64_t) 1) << (i & 63));
+  if (nr == 1) {
+    delete[] n->_routes;
+    n->_routes = 0;
+  }
+
+  // Remove nodes left without routes or children.
+  for (; depth > 0 && node_empty(*path[depth]); --depth) {
+    Node *p = path[depth - 1];
+    int b = a[depth - 1];
+    int nc = rank(p->_external, 256), r = rank(p->_external, b);
+    memmove(p->_children + r, p->_children + r + 1, (nc - r - 1) * sizeof(Node));
+    p->_external[b >> 6] &= ~(((uint64_t) 1) << (b & 63));
+    if (nc == 1) {
+      delete[] p->_children;
+      p->_children = 0;
+    }
+    --_nnodes;
+  }
 }
 
 String
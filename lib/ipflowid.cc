@@ -24,6 +24,12 @@
 #include <click/packet.hh>
 #include <click/confparse.hh>
 #include <click/straccum.hh>
+#include <click/args.hh>
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__ >= 5)
+# define HAVE_FLOWHASH_SSE42 1
+# include <cpuid.h>
+# include <nmmintrin.h>
+#endif
 CLICK_DECLS
 
 IPFlowID::IPFlowID(const Packet *p, bool reverse)
@@ -81,4 +87,210 @@ operator<<(StringAccum &sa, const IPFlowID &flow_id)
     return sa;
 }
 
+/** @brief Select hash method @a method, made symmetric if @a symmetric.
+ *
+ * Selecting m_seeded draws a fresh random seed. */
+void
+FlowHash::set(Method method, bool symmetric)
+{
+    _method = method;
+    _symmetric = symmetric;
+    _key[0] = _key[1] = 0;
+    if (method == m_seeded)
+	for (int i = 0; i < 8; ++i)
+	    _key[i / 4] = (_key[i / 4] << 16) | (click_random() & 0xFFFF);
+}
+
+String
+FlowHash::unparse() const
+{
+    static const char * const names[] = { "default", "crc32c", "seeded" };
+    String s(names[_method]);
+    return _symmetric ? s + " symmetric" : s;
+}
+
+
+// CRC-32C (Castagnoli), reflected, as computed by the SSE4.2 crc32
+// instruction.  The table is built on first use.
+
+static uint32_t crc32c_table[256];
+static volatile int crc32c_mode;	// 0 uninitialized, 1 table, 2 SSE4.2
+
+static void
+crc32c_init()
+{
+    for (uint32_t b = 0; b < 256; ++b) {
+	uint32_t crc = b;
+	for (int k = 0; k < 8; ++k)
+	    crc = (crc >> 1) ^ (crc & 1 ? 0x82F63B78U : 0);
+	crc32c_table[b] = crc;
+    }
+    int mode = 1;
+#if HAVE_FLOWHASH_SSE42
+    unsigned a, b, c, d;
+    if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_2))
+	mode = 2;
+#endif
+    crc32c_mode = mode;
+}
+
+#if HAVE_FLOWHASH_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const uint32_t *w, int n)
+{
+    for (int i = 0; i < n; ++i)
+	crc = _mm_crc32_u32(crc, w[i]);
+    return crc;
+}
+#endif
+
+/** @brief Return the CRC-32C of @a n words at @a w, starting from @a crc.
+ *
+ * Each word is taken in memory order.  No final inversion is applied. */
+uint32_t
+FlowHash::crc32c(uint32_t crc, const uint32_t *w, int n)
+{
+    if (unlikely(!crc32c_mode))
+	crc32c_init();
+#if HAVE_FLOWHASH_SSE42
+    if (crc32c_mode == 2)
+	return crc32c_sse42(crc, w, n);
+#endif
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(w);
+    for (int i = 0; i < 4 * n; ++i)
+	crc = (crc >> 8) ^ crc32c_table[(crc ^ p[i]) & 0xFF];
+    return crc;
+}
+
+#if HAVE_FLOWHASH_SSE42
+__attribute__((target("sse4.2")))
+static uint64_t
+crc32c64_sse42(uint64_t crc, const unsigned char *data, int len)
+{
+    uint32_t a = crc, b = crc >> 32;
+    for (; len >= 16; data += 16, len -= 16) {
+	uint32_t w[4];
+	memcpy(w, data, 16);
+# ifdef __x86_64__
+	a = _mm_crc32_u64(a, w[0] | ((uint64_t) w[1] << 32));
+	b = _mm_crc32_u64(b, w[2] | ((uint64_t) w[3] << 32));
+# else
+	a = _mm_crc32_u32(_mm_crc32_u32(a, w[0]), w[1]);
+	b = _mm_crc32_u32(_mm_crc32_u32(b, w[2]), w[3]);
+# endif
+    }
+    for (; len >= 8; data += 8, len -= 8) {
+	uint32_t w[2];
+	memcpy(w, data, 8);
+	a = _mm_crc32_u32(_mm_crc32_u32(a, w[0]), w[1]);
+    }
+    for (; len > 0; ++data, --len)
+	b = _mm_crc32_u8(b, *data);
+    return a | ((uint64_t) b << 32);
+}
+#endif
+
+/** @brief Return a 64-bit CRC-32C of @a len bytes at @a data.
+ *
+ * Two CRC-32C lanes, started from the low and high halves of @a crc, run
+ * side by side: the low lane takes the even 8-byte blocks, the high lane the
+ * odd ones and any trailing bytes.  The lanes are independent, so the SSE4.2
+ * path runs both in the time of one, and together they give 64 bits for
+ * fingerprints, where one CRC-32C would collide too often. */
+uint64_t
+FlowHash::crc32c64(uint64_t crc, const unsigned char *data, int len)
+{
+    if (unlikely(!crc32c_mode))
+	crc32c_init();
+#if HAVE_FLOWHASH_SSE42
+    if (crc32c_mode == 2)
+	return crc32c64_sse42(crc, data, len);
+#endif
+    uint32_t a = crc, b = crc >> 32;
+    for (; len >= 16; data += 16, len -= 16)
+	for (int i = 0; i < 8; ++i) {
+	    a = (a >> 8) ^ crc32c_table[(a ^ data[i]) & 0xFF];
+	    b = (b >> 8) ^ crc32c_table[(b ^ data[i + 8]) & 0xFF];
+	}
+    for (; len >= 8; data += 8, len -= 8)
+	for (int i = 0; i < 8; ++i)
+	    a = (a >> 8) ^ crc32c_table[(a ^ data[i]) & 0xFF];
+    for (; len > 0; ++data, --len)
+	b = (b >> 8) ^ crc32c_table[(b ^ *data) & 0xFF];
+    return a | ((uint64_t) b << 32);
+}
+
+
+#define SIPROUND(v0, v1, v2, v3) do {					\
+	v0 += v1; v1 = (v1 << 13) | (v1 >> 51); v1 ^= v0;		\
+	v0 = (v0 << 32) | (v0 >> 32);					\
+	v2 += v3; v3 = (v3 << 16) | (v3 >> 48); v3 ^= v2;		\
+	v0 += v3; v3 = (v3 << 21) | (v3 >> 43); v3 ^= v0;		\
+	v2 += v1; v1 = (v1 << 17) | (v1 >> 47); v1 ^= v2;		\
+	v2 = (v2 << 32) | (v2 >> 32);					\
+    } while (0)
+
+/** @brief Return the SipHash-1-3 of @a n words at @a w under @a key.
+ *
+ * Words are combined two at a time in memory order; the result matches
+ * SipHash-1-3 of the same bytes on a little-endian machine. */
+uint64_t
+FlowHash::siphash13(const uint64_t key[2], const uint32_t *w, int n)
+{
+    uint64_t v0 = key[0] ^ 0x736F6D6570736575ULL;
+    uint64_t v1 = key[1] ^ 0x646F72616E646F6DULL;
+    uint64_t v2 = key[0] ^ 0x6C7967656E657261ULL;
+    uint64_t v3 = key[1] ^ 0x7465646279746573ULL;
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+	uint64_t m = w[i] | ((uint64_t) w[i + 1] << 32);
+	v3 ^= m;
+	SIPROUND(v0, v1, v2, v3);
+	v0 ^= m;
+    }
+    uint64_t m = (uint64_t) (4 * n) << 56;
+    if (i < n)
+	m |= w[i];
+    v3 ^= m;
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= m;
+    v2 ^= 0xFF;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+#undef SIPROUND
+
+
+bool
+FlowHashArg::parse(const String &str, FlowHash &result, const ArgContext &args)
+{
+    Vector<String> words;
+    cp_spacevec(str, words);
+    bool symmetric = false;
+    if (words.size() && words.back().equals("symmetric", -1)) {
+	symmetric = true;
+	words.pop_back();
+    }
+    FlowHash::Method method;
+    if (words.size() > 1 || (!words.size() && !symmetric)) {
+	args.error("expected hash method");
+	return false;
+    } else if (!words.size() || words[0].equals("default", -1))
+	method = FlowHash::m_default;
+    else if (words[0].equals("crc32c", -1))
+	method = FlowHash::m_crc32c;
+    else if (words[0].equals("seeded", -1))
+	method = FlowHash::m_seeded;
+    else {
+	args.error("expected %<default%>, %<crc32c%>, or %<seeded%>");
+	return false;
+    }
+    result.set(method, symmetric);
+    return true;
+}
+
 CLICK_ENDDECLS
@@ -418,6 +418,37 @@ Lexer::Compound::expand_into(Lexer *lexer, int which, VariableEnvironment &ve)
 	    lexer->expand_compound_element(eidx_map[i], ve);
 }
 
+/* A pattern is a pair of compound element classes, X and X_Replacement,
+   read from a pattern file like those click-xform uses.  Graph 0 is X's
+   body and graph 1 is X_Replacement's; in both, elements 0 and 1 are the
+   "input" and "output" pseudoelements. */
+struct Lexer::Pattern {
+
+    struct Graph {
+	Vector<String> classes;
+	Vector<String> names;
+	Vector<String> configs;
+	Vector<Connection> conn;
+
+	bool has_connection(const Port &from, const Port &to) const {
+	    for (const Connection *cp = conn.begin(); cp != conn.end(); ++cp)
+		if ((*cp)[1] == from && (*cp)[0] == to)
+		    return true;
+	    return false;
+	}
+    };
+
+    String name;
+    Graph g[2];
+    int uniqueifier;
+
+    Pattern(const String &n)
+	: name(n), uniqueifier(1) {
+    }
+
+};
+
+
 //
 // LEXER
 //
@@ -425,7 +456,8 @@ Lexer::Compound::expand_into(Lexer *lexer, int which, VariableEnvironment &ve)
 Lexer::FileState::FileState(const String &data, const String &filename)
   : _big_string(data), _end(data.end()), _pos(data.begin()),
     _filename(filename ? filename : String::make_stable("config", 6)),
-    _original_filename(_filename), _lineno(1)
+    _original_filename(_filename), _lineno(1), _source(0), _base(0),
+    _streamed(false)
 {
 }
 
@@ -433,7 +465,7 @@ Lexer::Lexer()
   : _file(String(), String()), _lextra(0), _unlex_pos(0),
     _element_type_map(-1),
     _last_element_type(ET_NULL), _free_element_type(-1),
-    _global_scope(0), _element_map(-1), _c(0),
+    _global_scope(0), _element_map(-1), _c(0), _undead(false),
     _errh(ErrorHandler::default_handler())
 {
   end_parse(ET_NULL);		// clear private state
@@ -445,6 +477,8 @@ Lexer::Lexer()
 Lexer::~Lexer()
 {
   end_parse(ET_NULL);
+  for (Pattern **pp = _patterns.begin(); pp != _patterns.end(); ++pp)
+    delete *pp;
 
   // get rid of nonscoped element types
   for (int t = 0; t < _element_types.size(); t++)
@@ -470,6 +504,24 @@ Lexer::begin_parse(const String &data, const String &filename,
   return lexical_scoping_in();
 }
 
+/** @brief Begin parsing a configuration read incrementally from @a source.
+ *
+ * The lexer reads @a source in chunks as it goes, so the whole
+ * configuration text is never held in memory at once.  Identifiers are
+ * interned, and element configurations are copied out of the input
+ * buffers, as if the configuration had said "require(compact_config)".
+ * The caller must keep @a source alive until end_parse(). */
+int
+Lexer::begin_parse(Source *source, const String &filename,
+		   LexerExtra *lextra, ErrorHandler *errh)
+{
+  int cookie = begin_parse(String(), filename, lextra, errh);
+  _file._source = source;
+  _file._streamed = true;
+  _compact_config = true;
+  return cookie;
+}
+
 void
 Lexer::end_parse(int cookie)
 {
@@ -488,6 +540,7 @@ Lexer::end_parse(int cookie)
   _element_map.clear();
   _requirements.clear();
   _libraries.clear();
+  _interned.clear();
 
   _file = FileState(String(), String());
   _lextra = 0;
@@ -519,6 +572,49 @@ Lexer::set_remaining_text(const String &s)
   _file._end = s.end();
 }
 
+String
+Lexer::intern(const String &s)
+{
+  HashTable<String, String>::iterator it = _interned.find(s);
+  if (!it) {
+    String copy = s.compact();
+    it = _interned.find_insert(copy, copy);
+  }
+  return it.value();
+}
+
+/* Replace the input buffer with one holding [keep, _end) plus the next
+   chunk of the source, and return true; or return false if the source has
+   no more input.  One character before keep is kept as context for
+   line-directive detection.  Chunks grow with the kept text, so a single
+   lexeme or configuration string spanning many chunks is rescanned only a
+   logarithmic number of times. */
+bool
+Lexer::FileState::refill(const char *keep)
+{
+  if (!_source)
+    return false;
+  const char *begin = _big_string.begin();
+  const char *keep_from = (keep > begin ? keep - 1 : keep);
+  int nkeep = _end - keep_from;
+  int want = (nkeep > STREAM_CHUNK ? nkeep : STREAM_CHUNK);
+  StringAccum sa(nkeep + want);
+  sa.append(keep_from, nkeep);
+  char *x = sa.reserve(want);
+  int n = (x ? _source->read(x, want) : -1);
+  if (n <= 0) {
+    _source = 0;
+    return false;
+  }
+  sa.adjust_length(n);
+  int pos_offset = _pos - keep_from;
+  _base += keep_from - begin;
+  _big_string = sa.take_string();
+  _pos = _big_string.begin() + pos_offset;
+  _end = _big_string.end();
+  return true;
+}
+
 const char *
 Lexer::FileState::skip_line(const char *s)
 {
@@ -637,6 +733,28 @@ Lexer::FileState::process_line_directive(const char *s, Lexer *lexer)
 
 Lexeme
 Lexer::FileState::next_lexeme(Lexer *lexer)
+{
+  while (true) {
+    if (!_source)
+      return scan_lexeme(lexer);
+    // A lexeme near the end of a streamed buffer might continue into
+    // input not yet read.
+    const char *pos = _pos;
+    unsigned lineno = _lineno;
+    String filename = _filename;
+    Lexeme t = scan_lexeme(lexer);
+    if (_end - _pos >= 3)
+      return t;
+    _pos = pos;
+    _lineno = lineno;
+    _filename = filename;
+    if (!refill(pos))
+      return scan_lexeme(lexer);
+  }
+}
+
+Lexeme
+Lexer::FileState::scan_lexeme(Lexer *lexer)
 {
   const char *s = _pos;
   while (true) {
@@ -660,9 +778,19 @@ Lexer::FileState::next_lexeme(Lexer *lexer)
 	s = skip_slash_star(s + 2);
       else
 	break;
-    } else if (*s == '#' && (s == _big_string.begin() || s[-1] == '\n' || s[-1] == '\r'))
+    } else if (*s == '#' && (s == _big_string.begin() ? _base == 0 : s[-1] == '\n' || s[-1] == '\r')) {
+      if (_source) {
+	// read the whole directive line before processing it
+	const char *eol = s;
+	while (eol < _end && *eol != '\n' && *eol != '\r')
+	  eol++;
+	if (eol + 1 >= _end) {
+	  _pos = _end;
+	  return Lexeme();
+	}
+      }
       s = process_line_directive(s, lexer);
-    else
+    } else
       break;
   }
 
@@ -686,8 +814,10 @@ Lexer::FileState::next_lexeme(Lexer *lexer)
       return Lexeme(lexProvide, word);
     else if (word.equals("define", 6))
       return Lexeme(lexDefine, word);
+    else if (lexer->_compact_config)
+      return Lexeme(lexIdent, lexer->intern(word));
     else
-      return Lexeme(lexIdent, word, lexer->_compact_config);
+      return Lexeme(lexIdent, word);
   }
 
   // check for variable
@@ -697,7 +827,8 @@ Lexer::FileState::next_lexeme(Lexer *lexer)
       s++;
     if (s + 1 > word_pos) {
       _pos = s;
-      return Lexeme(lexVariable, _big_string.substring(word_pos + 1, s), lexer->_compact_config);
+      String word = _big_string.substring(word_pos + 1, s);
+      return Lexeme(lexVariable, lexer->_compact_config ? lexer->intern(word) : word);
     } else
       s--;
   }
@@ -728,6 +859,24 @@ Lexer::FileState::next_lexeme(Lexer *lexer)
 
 String
 Lexer::FileState::lex_config(Lexer *lexer)
+{
+  while (true) {
+    if (!_source)
+      return scan_config(lexer);
+    const char *pos = _pos;
+    unsigned lineno = _lineno;
+    String config = scan_config(lexer);
+    if (_pos < _end)
+      return config;
+    _pos = pos;
+    _lineno = lineno;
+    if (!refill(pos))
+      return scan_config(lexer);
+  }
+}
+
+String
+Lexer::FileState::scan_config(Lexer *lexer)
 {
   const char *config_pos = _pos;
   const char *s = _pos;
@@ -800,12 +949,12 @@ Lexer::expect(int kind, bool no_error)
     // Never adds to _unlex, which requires a nonobvious implementation.
     String old_filename = _file._filename;
     unsigned old_lineno = _file._lineno;
-    const char *old_pos = _file._pos;
+    size_t old_offset = _file.offset();
     if (lex().is(kind))
       return true;
     _file._filename = old_filename;
     _file._lineno = old_lineno;
-    _file._pos = old_pos;
+    _file.set_offset(old_offset);
   }
   if (!no_error)
     lerror("expected %s", lexeme_string(kind).c_str());
@@ -946,6 +1095,17 @@ Lexer::element_type_names(Vector<String> &v) const
       v.push_back(i.key());
 }
 
+Element *
+Lexer::create_element(const String &name) const
+{
+  // only primitive element classes: no tunnels or compounds
+  int t = element_type(name);
+  if (t <= TUNNEL_TYPE || !_element_types[t].factory
+      || _element_types[t].factory == compound_element_factory)
+    return 0;
+  return (*_element_types[t].factory)(_element_types[t].thunk);
+}
+
 
 // PORT TUNNELS
 
@@ -1845,6 +2005,747 @@ Lexer::ystatement(int nested)
 }
 
 
+// LOAD-TIME OPTIMIZATION
+
+/* The flattened configuration create_router() passes to the router, kept
+   in a form the optimizer can change.  Removed elements have null
+   elements[] entries; removed connections have negative indexes. */
+struct Lexer::FlatRouter {
+
+    Lexer *lexer;
+    Router *router;
+    Vector<int> types;
+    Vector<Element *> elements;
+    Vector<String> names;
+    Vector<String> configs;
+    Vector<String> filenames;
+    Vector<unsigned> linenos;
+    Vector<int> patids;		// pattern that created the element, or -1
+    Vector<Connection> conn;
+    HashTable<String, int> name_map;
+    StringAccum report;
+
+    FlatRouter(Lexer *l, Router *r)
+	: lexer(l), router(r), name_map(-1) {
+    }
+    ~FlatRouter() {
+	for (Element **ep = elements.begin(); ep != elements.end(); ++ep)
+	    delete *ep;
+    }
+
+    int size() const {
+	return types.size();
+    }
+    int add(int type, Element *e, const String &name, const String &config,
+	    const String &filename, unsigned lineno, int patid) {
+	types.push_back(type);
+	elements.push_back(e);
+	names.push_back(name);
+	configs.push_back(config);
+	filenames.push_back(filename);
+	linenos.push_back(lineno);
+	patids.push_back(patid);
+	name_map.set(name, types.size() - 1);
+	return types.size() - 1;
+    }
+    void remove(int i) {
+	delete elements[i];
+	elements[i] = 0;
+	if (name_map.get(names[i]) == i)
+	    name_map.erase(names[i]);
+	for (Connection *cp = conn.begin(); cp != conn.end(); ++cp)
+	    if ((*cp)[0].idx == i || (*cp)[1].idx == i)
+		(*cp)[0].idx = (*cp)[1].idx = -1;
+    }
+    void connect(const Port &from, const Port &to) {
+	conn.push_back(Connection(from.idx, from.port, to.idx, to.port));
+    }
+    String unique_name(const String &base) const {
+	String name = base;
+	for (int n = 1; name_map.get(name) >= 0; ++n)
+	    name = base + "@" + String(n);
+	return name;
+    }
+    bool is(int i, const char *class_name) const {
+	return elements[i] && strcmp(elements[i]->class_name(), class_name) == 0;
+    }
+    int add_idle(const String &base, const String &landmark);
+    void remove_switch(int i, bool pull, int &idle);
+    void remove_null(int i);
+
+};
+
+Element *
+Lexer::make_element(int etype, const String &name, const String &landmark,
+		    Router *router)
+{
+  (void) router;
+#if CLICK_LINUXMODULE
+  if (_element_types[etype].module && router->add_module_ref(_element_types[etype].module) < 0) {
+    _errh->lerror(landmark, "module for element type %<%s%> unloaded", _element_types[etype].name.c_str());
+    return 0;
+  }
+#endif
+  Element *e = (*_element_types[etype].factory)(_element_types[etype].thunk);
+  if (!e)
+    _errh->lerror(landmark, "failed to create element %<%s%>", name.c_str());
+  return e;
+}
+
+int
+Lexer::FlatRouter::add_idle(const String &base, const String &landmark)
+{
+  int t = lexer->element_type("Idle");
+  if (t <= ERROR_TYPE || lexer->_element_types[t].factory == compound_element_factory)
+    return -1;
+  String name = unique_name(base);
+  if (Element *e = lexer->make_element(t, name, landmark, router))
+    return add(t, e, name, String(), landmark, 0, -1);
+  return -1;
+}
+
+/* Remove StaticSwitch (or, if pull, StaticPullSwitch) element i, connecting
+   its single side directly to the ports on its chosen output (input).  The
+   ports it leaves blank are hooked up to an Idle. */
+void
+Lexer::FlatRouter::remove_switch(int i, bool pull, int &idle)
+{
+  int k;
+  if (!IntArg().parse(cp_uncomment(configs[i]), k))
+    return;			// leave errors to configure()
+
+  int s = pull ? 0 : 1;		// connection end where the switch fans out
+  Vector<Port> chosen;
+  bool blank = false;
+  for (const Connection *cp = conn.begin(); cp != conn.end(); ++cp)
+    if ((*cp)[s].idx == i) {
+      if ((*cp)[s].port == k)
+	chosen.push_back((*cp)[!s]);
+      else
+	blank = true;
+    }
+  if ((blank || chosen.empty()) && idle < 0
+      && (idle = add_idle(names[i] + "/Idle", "<undead>")) < 0)
+    return;
+
+  int next_port[2] = {0, 0};
+  for (int c = 0; c < conn.size(); ++c)
+    if (conn[c][!s].idx == i) {
+      if (chosen.empty())
+	conn[c][!s] = Port(idle, next_port[!s]++);
+      else {
+	for (int j = 1; j < chosen.size(); ++j) {
+	  Connection nc = conn[c];
+	  nc[!s] = chosen[j];
+	  conn.push_back(nc);
+	}
+	conn[c][!s] = chosen[0];
+      }
+    } else if (conn[c][s].idx == i && conn[c][s].port != k)
+      conn[c][s] = Port(idle, next_port[s]++);
+
+  report << "static-switch " << names[i] << '\n';
+  remove(i);
+}
+
+/* Remove Null element i, connecting its inputs directly to its outputs. */
+void
+Lexer::FlatRouter::remove_null(int i)
+{
+  Vector<Port> from, to;
+  for (const Connection *cp = conn.begin(); cp != conn.end(); ++cp)
+    for (int s = 0; s < 2; ++s)
+      if ((*cp)[s].idx == i) {
+	if ((*cp)[s].port != 0)
+	  return;
+	(s ? to : from).push_back((*cp)[!s]);
+      }
+  if (from.empty() || to.empty())
+    return;
+  for (int f = 0; f < from.size(); ++f)
+    for (int t = 0; t < to.size(); ++t)
+      connect(from[f], to[t]);
+  report << "null " << names[i] << '\n';
+  remove(i);
+}
+
+class Lexer::Matcher { public:
+
+  Matcher(Lexer *lexer, Pattern &pat, int patid, FlatRouter &fr);
+
+  bool ok() const			{ return _ok; }
+  bool next_match();
+  void replace();
+
+ private:
+
+  Lexer *_lexer;
+  Pattern &_pat;
+  const Pattern::Graph &_g;
+  int _patid;
+  FlatRouter &_fr;
+  bool _ok;
+
+  Vector<int> _types[2];		// pattern element types
+  Vector<int> _order;			// pattern elements in match order
+  Vector<int> _anchor;			// connection to an earlier element
+  Vector<int> _match;			// pattern element -> router element
+  Vector<int> _back_match;		// router element -> pattern element
+  Vector<Vector<int> > _conn_from;	// router element -> connections
+  Vector<Vector<int> > _conn_to;
+  HashTable<String, String> _defs;
+
+  Vector<Port> _to_pp_from;		// ports feeding the pattern...
+  Vector<int> _to_pp_to;		// ...and the pattern inputs they feed
+  Vector<int> _from_pp_from;		// pattern outputs...
+  Vector<Port> _from_pp_to;		// ...and the ports they feed
+
+  bool has_connection(int from, int from_port, int to, int to_port) const;
+  bool extend(int k);
+  bool try_match(int k, int f);
+  bool check_into(const Port &outside, const Port &inside);
+  bool check_out_of(const Port &inside, const Port &outside);
+  bool check_match();
+  String replace_config(const String &conf) const;
+
+};
+
+static bool
+contains(const Vector<int> &v, int x)
+{
+  for (const int *it = v.begin(); it != v.end(); ++it)
+    if (*it == x)
+      return true;
+  return false;
+}
+
+static bool
+match_config(const String &pat, const String &conf,
+	     HashTable<String, String> &defs)
+{
+  Vector<String> patvec, confvec;
+  HashTable<String, String> my_defs;
+  cp_argvec(pat, patvec);
+  cp_argvec(conf, confvec);
+  if (patvec.size() != confvec.size())
+    return false;
+
+  // compare arguments, binding $variables
+  for (int i = 0; i < patvec.size(); i++) {
+    if (patvec[i] == confvec[i])
+      continue;
+    const String &p = patvec[i];
+    if (p.length() <= 1 || p[0] != '$')
+      return false;
+    for (int j = 1; j < p.length(); j++)
+      if (!isalnum((unsigned char) p[j]) && p[j] != '_')
+	return false;
+    if (HashTable<String, String>::iterator it = defs.find(p)) {
+      if (it.value() != confvec[i])
+	return false;
+    } else if (HashTable<String, String>::iterator it = my_defs.find(p)) {
+      if (it.value() != confvec[i])
+	return false;
+    } else
+      my_defs.set(p, confvec[i]);
+  }
+
+  for (HashTable<String, String>::iterator it = my_defs.begin(); it.live(); it++)
+    defs.set(it.key(), it.value());
+  return true;
+}
+
+Lexer::Matcher::Matcher(Lexer *lexer, Pattern &pat, int patid, FlatRouter &fr)
+  : _lexer(lexer), _pat(pat), _g(pat.g[0]), _patid(patid), _fr(fr),
+    _ok(_g.classes.size() > 2)
+{
+  // all classes must be primitive
+  for (int w = 0; w < 2; ++w)
+    for (int i = 2; i < pat.g[w].classes.size(); ++i) {
+      int t = lexer->element_type(pat.g[w].classes[i]);
+      if (t <= ERROR_TYPE || lexer->_element_types[t].factory == compound_element_factory)
+	_ok = false;
+      _types[w].push_back(t);
+    }
+
+  // match elements in breadth-first order, so most candidates come from
+  // connections to elements already matched
+  Vector<int> placed(_g.classes.size(), -1);
+  for (int seed = 2; seed < _g.classes.size(); ++seed)
+    if (placed[seed] < 0) {
+      placed[seed] = _order.size();
+      _order.push_back(seed);
+      _anchor.push_back(-1);
+      for (int k = _order.size() - 1; k < _order.size(); ++k)
+	for (int c = 0; c < _g.conn.size(); ++c)
+	  for (int s = 0; s < 2; ++s) {
+	    int a = _g.conn[c][s].idx, b = _g.conn[c][!s].idx;
+	    if (a == _order[k] && b >= 2 && placed[b] < 0) {
+	      placed[b] = _order.size();
+	      _order.push_back(b);
+	      _anchor.push_back(c);
+	    }
+	  }
+    }
+}
+
+bool
+Lexer::Matcher::has_connection(int from, int from_port, int to, int to_port) const
+{
+  if (from < 0 || to < 0)
+    return false;
+  for (const int *cp = _conn_from[from].begin(); cp != _conn_from[from].end(); ++cp) {
+    const Connection &c = _fr.conn[*cp];
+    if (c[1].port == from_port && c[0] == Port(to, to_port))
+      return true;
+  }
+  return false;
+}
+
+bool
+Lexer::Matcher::next_match()
+{
+  _conn_from.assign(_fr.size(), Vector<int>());
+  Vector<Vector<int> > conn_to(_fr.size(), Vector<int>());
+  for (int c = 0; c < _fr.conn.size(); ++c)
+    if (_fr.conn[c][1].idx >= 0) {
+      _conn_from[_fr.conn[c][1].idx].push_back(c);
+      conn_to[_fr.conn[c][0].idx].push_back(c);
+    }
+  _match.assign(_g.classes.size(), -1);
+  _back_match.assign(_fr.size(), -1);
+  _conn_to.swap(conn_to);
+  return extend(0);
+}
+
+bool
+Lexer::Matcher::extend(int k)
+{
+  if (k == _order.size())
+    return check_match();
+
+  if (_anchor[k] < 0) {
+    for (int f = 0; f < _fr.size(); ++f)
+      if (try_match(k, f))
+	return true;
+    return false;
+  }
+
+  // candidates lie across the anchor connection
+  const Connection &pc = _g.conn[_anchor[k]];
+  int s = (pc[0].idx == _order[k] ? 0 : 1);
+  int other = _match[pc[!s].idx];
+  const Vector<int> &cv = (s ? _conn_to[other] : _conn_from[other]);
+  for (const int *cp = cv.begin(); cp != cv.end(); ++cp) {
+    const Connection &c = _fr.conn[*cp];
+    if (c[0].port == pc[0].port && c[1].port == pc[1].port
+	&& try_match(k, c[s].idx))
+      return true;
+  }
+  return false;
+}
+
+bool
+Lexer::Matcher::try_match(int k, int f)
+{
+  int pe = _order[k];
+  if (!_fr.elements[f] || _fr.types[f] != _types[0][pe - 2] || _back_match[f] >= 0)
+    return false;
+
+  // the router must have every pattern connection among matched elements
+  for (const Connection *pc = _g.conn.begin(); pc != _g.conn.end(); ++pc) {
+    int pf = (*pc)[1].idx, pt = (*pc)[0].idx;
+    if ((pf == pe || pt == pe) && pf >= 2 && pt >= 2) {
+      int mf = (pf == pe ? f : _match[pf]), mt = (pt == pe ? f : _match[pt]);
+      if (mf >= 0 && mt >= 0
+	  && !has_connection(mf, (*pc)[1].port, mt, (*pc)[0].port))
+	return false;
+    }
+  }
+
+  _match[pe] = f;
+  _back_match[f] = pe;
+  if (extend(k + 1))
+    return true;
+  _match[pe] = -1;
+  _back_match[f] = -1;
+  return false;
+}
+
+bool
+Lexer::Matcher::check_into(const Port &outside, const Port &inside)
+{
+  // find the lowest pattern input that feeds 'inside', all of whose
+  // connections 'outside' also has
+  int best = -1;
+  for (const Connection *pc = _g.conn.begin(); pc != _g.conn.end(); ++pc)
+    if ((*pc)[0] == inside && (*pc)[1].idx == 0
+	&& (best < 0 || (*pc)[1].port < best)) {
+      int p = (*pc)[1].port;
+      for (const Connection *pc2 = _g.conn.begin(); pc2 != _g.conn.end(); ++pc2)
+	if ((*pc2)[1] == Port(0, p)
+	    && !has_connection(outside.idx, outside.port, _match[(*pc2)[0].idx], (*pc2)[0].port))
+	  goto no_match;
+      best = p;
+    no_match: ;
+    }
+  if (best < 0)
+    return false;
+  _to_pp_from.push_back(outside);
+  _to_pp_to.push_back(best);
+  return true;
+}
+
+bool
+Lexer::Matcher::check_out_of(const Port &inside, const Port &outside)
+{
+  int best = -1;
+  for (const Connection *pc = _g.conn.begin(); pc != _g.conn.end(); ++pc)
+    if ((*pc)[1] == inside && (*pc)[0].idx == 1
+	&& (best < 0 || (*pc)[0].port < best)) {
+      int p = (*pc)[0].port;
+      for (const Connection *pc2 = _g.conn.begin(); pc2 != _g.conn.end(); ++pc2)
+	if ((*pc2)[0] == Port(1, p)
+	    && !has_connection(_match[(*pc2)[1].idx], (*pc2)[1].port, outside.idx, outside.port))
+	  goto no_match;
+      best = p;
+    no_match: ;
+    }
+  if (best < 0)
+    return false;
+  _from_pp_from.push_back(best);
+  _from_pp_to.push_back(outside);
+  return true;
+}
+
+bool
+Lexer::Matcher::check_match()
+{
+  _to_pp_from.clear();
+  _to_pp_to.clear();
+  _from_pp_from.clear();
+  _from_pp_to.clear();
+  _defs.clear();
+
+  bool all_previous_match = true;
+  for (int i = 2; i < _match.size(); ++i) {
+    if (!match_config(_g.configs[i], _fr.configs[_match[i]], _defs))
+      return false;
+    if (_fr.patids[_match[i]] != _patid)
+      all_previous_match = false;
+  }
+  // don't rematch the result of a previous replacement by this pattern
+  if (all_previous_match)
+    return false;
+
+  // connections across the pattern boundary must go through its tunnels
+  for (const Connection *cp = _fr.conn.begin(); cp != _fr.conn.end(); ++cp)
+    if ((*cp)[1].idx >= 0) {
+      int pf = _back_match[(*cp)[1].idx], pt = _back_match[(*cp)[0].idx];
+      if (pf >= 0 && pt >= 0) {
+	if (!_g.has_connection(Port(pf, (*cp)[1].port), Port(pt, (*cp)[0].port)))
+	  return false;
+      } else if (pt >= 0) {
+	if (!check_into((*cp)[1], Port(pt, (*cp)[0].port)))
+	  return false;
+      } else if (pf >= 0) {
+	if (!check_out_of(Port(pf, (*cp)[1].port), (*cp)[0]))
+	  return false;
+      }
+    }
+
+  // and every tunnel must be used
+  for (const Connection *pc = _g.conn.begin(); pc != _g.conn.end(); ++pc) {
+    if ((*pc)[1].idx == 0 && !contains(_to_pp_to, (*pc)[1].port))
+      return false;
+    if ((*pc)[0].idx == 1 && !contains(_from_pp_from, (*pc)[0].port))
+      return false;
+  }
+  return true;
+}
+
+String
+Lexer::Matcher::replace_config(const String &conf) const
+{
+  Vector<String> confvec;
+  cp_argvec(conf, confvec);
+  bool changed = false;
+  for (int i = 0; i < confvec.size(); i++)
+    if (confvec[i].length() > 1 && confvec[i][0] == '$')
+      if (HashTable<String, String>::const_iterator it = _defs.find(confvec[i])) {
+	confvec[i] = it.value();
+	changed = true;
+      }
+  return changed ? cp_unargvec(confvec) : conf;
+}
+
+void
+Lexer::Matcher::replace()
+{
+  const Pattern::Graph &r = _pat.g[1];
+  String prefix;
+  while (1) {
+    prefix = _pat.name + "@" + String(_pat.uniqueifier++);
+    int i = 2;
+    if (_fr.name_map.get(prefix) < 0)
+      for (; i < r.names.size(); ++i)
+	if (_fr.name_map.get(prefix + "/" + r.names[i]) >= 0)
+	  break;
+    if (i == r.names.size())
+      break;
+  }
+
+  // remove the matched elements
+  StringAccum sa;
+  sa << "xform " << prefix << ':';
+  Vector<String> old_names, old_filenames;
+  Vector<unsigned> old_linenos;
+  for (int i = 0; i < _match.size(); ++i) {
+    int f = (i >= 2 ? _match[i] : _match[2]);
+    old_names.push_back(_fr.names[f]);
+    old_filenames.push_back(_fr.filenames[f]);
+    old_linenos.push_back(_fr.linenos[f]);
+    if (i >= 2)
+      sa << ' ' << _fr.names[f];
+  }
+  for (int i = 2; i < _match.size(); ++i)
+    _fr.remove(_match[i]);
+  _fr.report << sa << '\n';
+
+  // add the replacement; replacement elements named like a pattern element
+  // keep the matched element's name
+  Vector<int> new_id(r.classes.size(), -1);
+  for (int i = 2; i < r.classes.size(); ++i) {
+    int old = 0;
+    for (int j = 2; j < _g.names.size() && !old; ++j)
+      if (_g.names[j] == r.names[i])
+	old = j;
+    String name = (old ? old_names[old] : prefix + "/" + r.names[i]);
+    const String &filename = old_filenames[old];
+    unsigned lineno = old_linenos[old];
+    int t = _types[1][i - 2];
+    if (Element *e = _lexer->make_element(t, name, Compound::landmark_string(filename, lineno), _fr.router))
+      new_id[i] = _fr.add(t, e, name, replace_config(r.configs[i]), filename, lineno, _patid);
+  }
+
+  for (const Connection *rc = r.conn.begin(); rc != r.conn.end(); ++rc) {
+    Vector<Port> from, to;
+    if ((*rc)[1].idx == 0) {
+      for (int j = 0; j < _to_pp_to.size(); ++j)
+	if (_to_pp_to[j] == (*rc)[1].port)
+	  from.push_back(_to_pp_from[j]);
+    } else if ((*rc)[1].idx >= 2 && new_id[(*rc)[1].idx] >= 0)
+      from.push_back(Port(new_id[(*rc)[1].idx], (*rc)[1].port));
+    if ((*rc)[0].idx == 1) {
+      for (int j = 0; j < _from_pp_from.size(); ++j)
+	if (_from_pp_from[j] == (*rc)[0].port)
+	  to.push_back(_from_pp_to[j]);
+    } else if ((*rc)[0].idx >= 2 && new_id[(*rc)[0].idx] >= 0)
+      to.push_back(Port(new_id[(*rc)[0].idx], (*rc)[0].port));
+    for (int f = 0; f < from.size(); ++f)
+      for (int t = 0; t < to.size(); ++t)
+	_fr.connect(from[f], to[t]);
+  }
+}
+
+/** @brief Add optimization patterns from a pattern file.
+ * @param text pattern file contents
+ * @param filename pattern file name, for error messages
+ * @param errh error handler
+ * @return 0 on success, -1 on parse errors
+ *
+ * A pattern file, like those click-xform reads, defines pairs of compound
+ * element classes X and X_Replacement.  After adding patterns, each
+ * create_router() replaces every subgraph of the flattened configuration
+ * that matches some X with the corresponding X_Replacement, in the order
+ * the patterns were defined, until no pattern matches.  Patterns must not
+ * be added while a configuration is being parsed. */
+int
+Lexer::add_patterns(const String &text, const String &filename, ErrorHandler *errh)
+{
+  assert(!_c);
+  if (!errh)
+    errh = ErrorHandler::default_handler();
+  int before = errh->nerrors();
+  int cookie = begin_parse(text, filename, 0, errh);
+  while (ystatement())
+    /* nada */;
+
+  // collect the compounds this file defined, in definition order
+  Vector<int> types;
+  for (int t = _last_element_type; t != cookie && t != ET_NULL;
+       t = _element_types[t].next & ET_TMASK)
+    if (_element_types[t].factory == compound_element_factory)
+      types.push_back(t);
+
+  for (int *tp = types.end(); tp != types.begin(); ) {
+    --tp;
+    const String &name = _element_types[*tp].name;
+    int rt = element_type(name + "_Replacement");
+    if (!name || element_type(name) != *tp || rt < 0
+	|| _element_types[rt].factory != compound_element_factory)
+      continue;
+
+    Pattern *pat = new Pattern(name);
+    for (int w = 0; w < 2; ++w) {
+      Compound *c = (Compound *) _element_types[w ? rt : *tp].thunk;
+      Pattern::Graph &g = pat->g[w];
+      for (int i = 0; i < c->_elements.size(); ++i) {
+	int etype = c->_elements[i];
+	if ((etype == TUNNEL_TYPE) != (i < 2)
+	    || _element_types[etype].factory == compound_element_factory) {
+	  errh->lerror(c->element_landmark(i), "pattern %<%s%> may contain only primitive elements", name.c_str());
+	  delete pat;
+	  pat = 0;
+	  goto next_pattern;
+	}
+	g.classes.push_back(i < 2 ? String() : _element_types[etype].name);
+	g.names.push_back(c->_element_names[i]);
+	g.configs.push_back(c->_element_configurations[i]);
+      }
+      g.conn = c->_conn;
+    }
+    _patterns.push_back(pat);
+  next_pattern: ;
+  }
+
+  end_parse(cookie);
+  _pattern_texts += filename + String('\0') + text + String('\0');
+  return errh->nerrors() == before ? 0 : -1;
+}
+
+/** @brief Return a string that changes with the optimizations create_router()
+ * applies, for use in configuration cache keys. */
+String
+Lexer::optimizer_signature() const
+{
+  return _pattern_texts + (_undead ? "undead" : "");
+}
+
+void
+Lexer::apply_patterns(FlatRouter &fr)
+{
+  // bound the work done by patterns that keep matching their own output
+  int limit = 16 * (fr.size() + 1);
+  for (int p = 0; p < _patterns.size(); ++p)
+    _patterns[p]->uniqueifier = 1;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int p = 0; p < _patterns.size(); ++p) {
+      Matcher m(this, *_patterns[p], p, fr);
+      if (!m.ok())
+	continue;
+      while (m.next_match()) {
+	m.replace();
+	changed = true;
+	if (--limit == 0) {
+	  _errh->warning("too many pattern replacements, stopping");
+	  return;
+	}
+      }
+    }
+  }
+}
+
+void
+Lexer::remove_dead(FlatRouter &fr)
+{
+  // remove static switches and Nulls
+  int idle = -1;
+  for (int i = 0; i < fr.size(); ++i)
+    if (fr.is(i, "StaticSwitch") || fr.is(i, "StaticPullSwitch")) {
+      int switch_idle = -1;
+      fr.remove_switch(i, fr.is(i, "StaticPullSwitch"), switch_idle);
+    } else if (fr.is(i, "Null") || fr.is(i, "PushNull") || fr.is(i, "PullNull"))
+      fr.remove_null(i);
+
+  // find sources and sinks, assuming packets can flow from every input to
+  // every output
+  int n = fr.size();
+  Vector<int> nports[2];
+  nports[0].assign(n, 0);
+  nports[1].assign(n, 0);
+  for (const Connection *cp = fr.conn.begin(); cp != fr.conn.end(); ++cp)
+    if ((*cp)[1].idx >= 0)
+      for (int s = 0; s < 2; ++s)
+	if (nports[s][(*cp)[s].idx] <= (*cp)[s].port)
+	  nports[s][(*cp)[s].idx] = (*cp)[s].port + 1;
+
+  Bitvector reached[2];		// [1]: reached from a source; [0]: from a sink
+  reached[0].resize(n);
+  reached[1].resize(n);
+  Vector<int> work[2];
+  for (int i = 0; i < n; ++i)
+    if (fr.elements[i]) {
+      int source_flag = fr.elements[i]->flag_value('S');
+      if (source_flag < 0 || source_flag > 3)
+	source_flag = (nports[0][i] ? 0 : 1) | (nports[1][i] ? 0 : 2);
+      for (int s = 0; s < 2; ++s)
+	if (source_flag & (s ? 1 : 2)) {
+	  reached[s][i] = true;
+	  work[s].push_back(i);
+	}
+    }
+  for (int s = 0; s < 2; ++s)
+    while (work[s].size()) {
+      int i = work[s].back();
+      work[s].pop_back();
+      for (const Connection *cp = fr.conn.begin(); cp != fr.conn.end(); ++cp)
+	if ((*cp)[s].idx == i) {
+	  int j = (*cp)[!s].idx;
+	  if (!reached[s][j] && !fr.is(j, "Idle")) {
+	    reached[s][j] = true;
+	    work[s].push_back(j);
+	  }
+	}
+    }
+
+  // remove dead elements, remembering the live ports they leave blank;
+  // Idles go only once all their neighbors have
+  Vector<Port> blank[2];
+  for (int i = 0; i < n; ++i)
+    if (fr.elements[i] && !(reached[0][i] && reached[1][i])
+	&& !fr.is(i, "Idle")) {
+      int live_flag = fr.elements[i]->flag_value('L');
+      if (live_flag == 1
+	  || (live_flag != 0 && !nports[0][i] && !nports[1][i]))
+	continue;
+      for (const Connection *cp = fr.conn.begin(); cp != fr.conn.end(); ++cp)
+	for (int s = 0; s < 2; ++s)
+	  if ((*cp)[s].idx == i && (*cp)[!s].idx != i)
+	    blank[!s].push_back((*cp)[!s]);
+      fr.report << "dead " << fr.names[i] << '\n';
+      fr.remove(i);
+    }
+
+  for (int i = 0; i < n; ++i)
+    if (fr.is(i, "Idle") && (nports[0][i] || nports[1][i])) {
+      const Connection *cp = fr.conn.begin();
+      while (cp != fr.conn.end() && (*cp)[0].idx != i && (*cp)[1].idx != i)
+	++cp;
+      if (cp == fr.conn.end()) {
+	fr.report << "dead " << fr.names[i] << '\n';
+	fr.remove(i);
+      }
+    }
+
+  int next_port[2] = {0, 0};
+  for (int s = 0; s < 2; ++s)
+    for (const Port *pp = blank[s].begin(); pp != blank[s].end(); ++pp) {
+      if (!fr.elements[pp->idx] || fr.is(pp->idx, "Idle"))
+	continue;
+      const Connection *cp = fr.conn.begin();
+      while (cp != fr.conn.end() && (*cp)[s] != *pp)
+	++cp;
+      if (cp != fr.conn.end()
+	  || (idle < 0 && (idle = fr.add_idle("Idle@undead", "<undead>")) < 0))
+	continue;
+      Port ip(idle, next_port[!s]++);
+      fr.connect(s ? *pp : ip, s ? ip : *pp);
+    }
+}
+
 // COMPLETION
 
 void
@@ -1917,7 +2818,7 @@ Lexer::expand_compound_element(int which, VariableEnvironment &ve)
 Router *
 Lexer::create_router(Master *master)
 {
-  Router *router = new Router(_file._big_string, master);
+  Router *router = new Router(_file._streamed ? String() : _file._big_string, master);
   if (!router)
     return 0;
 
@@ -1928,25 +2829,18 @@ Lexer::create_router(Master *master)
   for (int i = 0; i < initial_elements_size; i++)
     expand_compound_element(i, _c->scope());
 
-  // add elements to router
+  // number elements, leaving out tunnels
+  FlatRouter fr(this, router);
   Vector<int> router_id;
   for (int i = 0; i < _c->_elements.size(); i++) {
     int etype = _c->_elements[i];
-    if (etype == TUNNEL_TYPE)
-      router_id.push_back(-1);
-#if CLICK_LINUXMODULE
-    else if (_element_types[etype].module && router->add_module_ref(_element_types[etype].module) < 0) {
-      _errh->lerror(_c->element_landmark(i), "module for element type %<%s%> unloaded", _element_types[etype].name.c_str());
-      router_id.push_back(-1);
-    }
-#endif
-    else if (Element *e = (*_element_types[etype].factory)(_element_types[etype].thunk)) {
-      int ei = router->add_element(e, _c->_element_names[i], _c->_element_configurations[i], _c->_element_filenames[i], _c->_element_linenos[i]);
-      router_id.push_back(ei);
-    } else {
-      _errh->lerror(_c->element_landmark(i), "failed to create element %<%s%>", _c->_element_names[i].c_str());
+    Element *e = 0;
+    if (etype != TUNNEL_TYPE)
+      e = make_element(etype, _c->_element_names[i], _c->element_landmark(i), router);
+    if (e)
+      router_id.push_back(fr.add(etype, e, _c->_element_names[i], _c->_element_configurations[i], _c->_element_filenames[i], _c->_element_linenos[i], -1));
+    else
       router_id.push_back(-1);
-    }
   }
 
   // first-level connection expansion
@@ -1968,20 +2862,45 @@ Lexer::create_router(Master *master)
   }
 
   // use router element numbers
-  for (Connection *cp = _c->_conn.begin(); cp != _c->_conn.end(); ++cp) {
-    (*cp)[0].idx = router_id[(*cp)[0].idx];
-    (*cp)[1].idx = router_id[(*cp)[1].idx];
+  for (const Connection *cp = _c->_conn.begin(); cp != _c->_conn.end(); ++cp) {
+    int fromi = router_id[(*cp)[1].idx], toi = router_id[(*cp)[0].idx];
+    if (fromi >= 0 && toi >= 0)
+      fr.connect(Port(fromi, (*cp)[1].port), Port(toi, (*cp)[0].port));
   }
 
+  // optimize
+  if (_patterns.size())
+    apply_patterns(fr);
+  if (_undead)
+    remove_dead(fr);
+
+  // add elements to router
+  Vector<int> final_id(fr.size(), -1);
+  for (int i = 0; i < fr.size(); i++)
+    if (Element *e = fr.elements[i]) {
+      final_id[i] = router->add_element(e, fr.names[i], fr.configs[i], fr.filenames[i], fr.linenos[i]);
+      fr.elements[i] = 0;
+    }
+  router->set_optimizations(fr.report.take_string());
+
   // sort and add connections to router
-  click_qsort(_c->_conn.begin(), _c->_conn.size());
-  for (Connection *cp = _c->_conn.begin(); cp != _c->_conn.end(); ++cp)
+  Vector<Connection> conn;
+  for (const Connection *cp = fr.conn.begin(); cp != fr.conn.end(); ++cp)
     if ((*cp)[0].idx >= 0 && (*cp)[1].idx >= 0)
-      router->add_connection((*cp)[1].idx, (*cp)[1].port, (*cp)[0].idx, (*cp)[0].port);
+      conn.push_back(Connection(final_id[(*cp)[1].idx], (*cp)[1].port, final_id[(*cp)[0].idx], (*cp)[0].port));
+  click_qsort(conn.begin(), conn.size());
+  for (const Connection *cp = conn.begin(); cp != conn.end(); ++cp)
+    router->add_connection((*cp)[1].idx, (*cp)[1].port, (*cp)[0].idx, (*cp)[0].port);
 
   // add requirements to router
-  for (int i = 0; i < _requirements.size(); i += 2)
+  bool compact = false;
+  for (int i = 0; i < _requirements.size(); i += 2) {
       router->add_requirement(_requirements[i], _requirements[i+1]);
+      compact = compact || _requirements[i].equals("compact_config", 14);
+  }
+  // a streamed configuration's text was never kept
+  if (_file._streamed && !compact)
+      router->add_requirement(String::make_stable("compact_config", 14), String());
 
   return router;
 }
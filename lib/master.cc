@@ -43,6 +43,12 @@ Master::Master(int nthreads)
 {
     _refcount = 0;
     _master_paused = 0;
+#if HAVE_MULTITHREAD
+    _work_stealing = 0;
+    _master_lock_contention = 0;
+    _master_lock_acquisitions = 0;
+    _master_lock_start = _master_lock_hold_cycles = _master_lock_max_hold_cycles = 0;
+#endif
 
     _nthreads = nthreads + 1;
     _threads = new RouterThread *[_nthreads];
@@ -83,8 +89,8 @@ Master::~Master()
     _refcount--;
     unlock_master();
 
-    if (_refcount > 0)
-	click_chatter("deleting master while ref count = %d", _refcount);
+    if (_refcount != 0)
+	click_chatter("deleting master while ref count = %d", _refcount.value());
 
 #if CLICK_USERLEVEL
     signal_thread = 0;
@@ -97,26 +103,20 @@ Master::~Master()
 void
 Master::use()
 {
-    lock_master();
     _refcount++;
-    unlock_master();
 }
 
 void
 Master::unuse()
 {
-    lock_master();
-    _refcount--;
-    bool del = (_refcount <= 0);
-    unlock_master();
-    if (del)
+    if (_refcount.dec_and_test())
 	delete this;
 }
 
 void
-Master::pause()
+Master::fence_threads()
 {
-    _master_paused++;
+    // wait for any thread running timers or selects to finish
     for (int i = 1; i < _nthreads; ++i) {
 	_threads[i]->timer_set().fence();
 #if CLICK_USERLEVEL
@@ -125,6 +125,22 @@ Master::pause()
     }
 }
 
+void
+Master::pause()
+{
+    _master_paused++;
+    fence_threads();
+}
+
+/* Pause only @a router: threads hold its timers and skip its selects, but
+   keep running every other router's. */
+void
+Master::pause_router(Router *router)
+{
+    router->_paused++;
+    fence_threads();
+}
+
 void
 Master::block_all()
 {
@@ -161,13 +177,13 @@ Master::register_router(Router *router)
 void
 Master::prepare_router(Router *router)
 {
-    // increments _master_paused; should quickly call run_router() or
+    // pauses the router; should quickly call run_router() or
     // kill_router()
     lock_master();
     assert(router && router->_master == this && router->_running == Router::RUNNING_INACTIVE);
     router->_running = Router::RUNNING_PREPARING;
     unlock_master();
-    pause();
+    pause_router(router);
 }
 
 void
@@ -177,7 +193,7 @@ Master::run_router(Router *router, bool foreground)
     assert(router && router->_master == this && router->_running == Router::RUNNING_PREPARING);
     router->_running = (foreground ? Router::RUNNING_ACTIVE : Router::RUNNING_BACKGROUND);
     unlock_master();
-    unpause();
+    unpause_router(router);
 }
 
 void
@@ -192,7 +208,7 @@ Master::kill_router(Router *router)
     int was_running = router->_running;
     router->_running = Router::RUNNING_DEAD;
     if (was_running >= Router::RUNNING_BACKGROUND)
-	pause();
+	pause_router(router);
     else if (was_running == Router::RUNNING_PREPARING)
 	/* nada */;
     else {
@@ -202,8 +218,9 @@ Master::kill_router(Router *router)
 	return;
     }
 
-    // Fix stopper
-    request_stop();
+    // Fix stopper: only if no active router remains to keep threads going
+    if (!any_active_router())
+	request_stop();
 #if CLICK_LINUXMODULE && HAVE_LINUXMODULE_2_6
     preempt_disable();
 #endif
@@ -232,7 +249,7 @@ Master::kill_router(Router *router)
     }
 #endif
 
-    unpause();
+    unpause_router(router);
 #if CLICK_LINUXMODULE && HAVE_LINUXMODULE_2_6
     preempt_enable_no_resched();
 #endif
@@ -275,31 +292,38 @@ Master::check_driver()
     assert(!in_interrupt());
 #endif
 
+    // Collect stopped routers under the master lock, but run their Scripts
+    // and kill them without it, so one router's stop handling does not hold
+    // up the others.  _stop_lock keeps two threads from stepping the same
+    // Script at once.
+    _stop_lock.acquire();
     lock_master();
     request_go();
-
-    for (Router *r = _routers; r; ) {
-	Router *next_router = r->_next_router;
+    Vector<Router *> stopped;
+    for (Router *r = _routers; r; r = r->_next_router)
 	if (r->runcount() <= 0 && r->_running >= Router::RUNNING_BACKGROUND) {
-	    Element *dm = (Element *)(r->attachment("Script"));
-	    if (dm) {
-		int max = 1000;
-		while (HandlerCall::call_write(dm, "step", "router", ErrorHandler::default_handler()) == 0
-		       && r->runcount() <= 0 && --max >= 0)
-		    /* do nothing */;
-	    }
-	    if (r->runcount() <= 0 && r->_running >= Router::RUNNING_BACKGROUND)
-		kill_router(r);
+	    r->use();
+	    stopped.push_back(r);
 	}
-	r = next_router;
-    }
+    unlock_master();
 
-    bool any_active = false;
-    for (Router *r = _routers; r; r = r->_next_router)
-	if (r->_running == Router::RUNNING_ACTIVE) {
-	    any_active = true;
-	    break;
+    for (Router **rp = stopped.begin(); rp != stopped.end(); ++rp) {
+	Router *r = *rp;
+	Element *dm = (Element *)(r->attachment("Script"));
+	if (dm) {
+	    int max = 1000;
+	    while (HandlerCall::call_write(dm, "step", "router", ErrorHandler::default_handler()) == 0
+		   && r->runcount() <= 0 && --max >= 0)
+		/* do nothing */;
 	}
+	if (r->runcount() <= 0 && r->_running >= Router::RUNNING_BACKGROUND)
+	    kill_router(r);
+	r->unuse();
+    }
+    _stop_lock.release();
+
+    lock_master();
+    bool any_active = any_active_router();
     if (!any_active)
 	request_stop();
     unlock_master();
@@ -460,6 +484,22 @@ Master::initialize_ns(simclick_node_t *simnode)
     _simnode = simnode;
 }
 
+/** @brief Ask the simulator to run this node at @a when.
+ *
+ * The driver asks after every run, usually for the same next timer
+ * expiry.  A request at or after a wakeup that is still pending is
+ * dropped, since that wakeup will ask again; this saves the simulator an
+ * event per packet delivered. */
+void
+Master::ns_schedule(const Timestamp &when)
+{
+    if (_ns_scheduled > Timestamp::now() && when >= _ns_scheduled)
+	return;
+    _ns_scheduled = when;
+    struct timeval tv = when.timeval();
+    simclick_sim_command(_simnode, SIMCLICK_SCHEDULE, &tv);
+}
+
 #endif
 
 
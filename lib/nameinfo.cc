@@ -24,6 +24,7 @@
 #include <click/router.hh>
 #include <click/error.hh>
 #include <click/packet_anno.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 
 /** @file nameinfo.hh
@@ -97,7 +98,9 @@ CLICK_DECLS
  *
  * DynamicNameDB is a NameDB database that maps names to arbitrary values.
  * The database is initially empty.  DynamicNameDB supports define()
- * operations; that's how information is added to it.
+ * operations; that's how information is added to it.  Names are hashed, so
+ * queries and definitions take constant time however large the database
+ * grows.
  *
  * DynamicNameDB objects are automatically created by NameInfo::getdb().
  *
@@ -105,11 +108,17 @@ CLICK_DECLS
  */
 
 static NameInfo *the_name_info;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+// Queries remember their misses, so even queries must be serialized when
+// elements are configured concurrently.
+static Spinlock query_lock;
+#endif
 
 #define MKAI(n) MAKE_ANNOTATIONINFO(n ## _ANNO_OFFSET, n ## _ANNO_SIZE)
 
 static const StaticNameDB::Entry annotation_entries[] = {
     { "AGGREGATE", MKAI(AGGREGATE) },
+    { "CSUM_FLAGS", MKAI(CSUM_FLAGS) },
     { "DST_IP", MKAI(DST_IP) },
     { "DST_IP6", MKAI(DST_IP6) },
     { "EXTRA_LENGTH", MKAI(EXTRA_LENGTH) },
@@ -118,6 +127,8 @@ static const StaticNameDB::Entry annotation_entries[] = {
     { "FIX_IP_SRC", MKAI(FIX_IP_SRC) },
     { "FWD_RATE", MKAI(FWD_RATE) },
     { "GRID_ROUTE_CB", MKAI(GRID_ROUTE_CB) },
+    { "GSO_SIZE", MKAI(GSO_SIZE) },
+    { "GSO_TYPE", MKAI(GSO_TYPE) },
     { "ICMP_PARAMPROB", MKAI(ICMP_PARAMPROB) },
     { "IPREASSEMBLER", MKAI(IPREASSEMBLER) },
 #ifdef IPSEC_SA_DATA_REFERENCE_ANNO_OFFSET
@@ -188,72 +199,18 @@ StaticNameDB::revquery(const void *value, size_t vsize)
 void *
 DynamicNameDB::find(const String &name, bool create)
 {
-    if (_sorted > 20)
-	sort();
-
-    if (_sorted == 100) {
-	size_t l = 0, r = _names.size();
-	while (l < r) {
-	    size_t m = l + (r - l) / 2;
-	    int cmp = String::compare(name, _names[m]);
-	    if (cmp == 0)
-		return _values.data() + value_size() * m;
-	    else if (cmp < 0)
-		r = m;
-	    else
-		l = m + 1;
-	}
-    } else {
-	_sorted++;
-	for (int i = 0; i < _names.size(); i++)
-	    if (name == _names[i])
-		return _values.data() + value_size() * i;
-    }
-
-    if (create && name) {
-	_sorted = 0;
+    if (int *x = _index.get_pointer(name))
+	return _values.data() + value_size() * *x;
+    else if (create && name) {
+	_index.set(name, _names.size());
 	_names.push_back(name);
 	_values.extend(value_size());
+	NameInfo::_generation++;
 	return _values.data() + _values.length() - value_size();
     } else
 	return 0;
 }
 
-static int
-namelist_sort_compar(const void *athunk, const void *bthunk, void *othunk)
-{
-    const int *a = (const int *) athunk, *b = (const int *) bthunk;
-    const String *o = (const String *) othunk;
-    return String::compare(o[*a], o[*b]);
-}
-
-void
-DynamicNameDB::sort()
-{
-    if (_sorted == 100 || _names.size() == 0)
-	return;
-
-    Vector<int> permutation(_names.size(), 0);
-    for (int i = 0; i < _names.size(); i++)
-	permutation[i] = i;
-    click_qsort(permutation.begin(), permutation.size(), sizeof(int), namelist_sort_compar, _names.begin());
-
-    Vector<String> new_names(_names.size(), String());
-    StringAccum new_values(_values.length());
-    new_values.extend(_values.length());
-
-    String *nn = new_names.begin();
-    char *nv = new_values.data();
-    for (int i = 0; i < _names.size(); i++, nn++, nv += value_size()) {
-	*nn = _names[permutation[i]];
-	memcpy(nv, _values.data() + value_size() * permutation[i], value_size());
-    }
-
-    _names.swap(new_names);
-    _values.swap(new_values);
-    _sorted = 100;
-}
-
 bool
 DynamicNameDB::query(const String& name, void* value, size_t vsize)
 {
@@ -288,7 +245,10 @@ DynamicNameDB::revquery(const void *value, size_t vsize)
 }
 
 
+uint32_t NameInfo::_generation;
+
 NameInfo::NameInfo()
+    : _miss_generation(0)
 {
 #if CLICK_NAMEDB_CHECK
     _check_generation = (uintptr_t) this;
@@ -432,6 +392,7 @@ void
 NameInfo::installdb(NameDB *db, const Element *prefix)
 {
     NameInfo *ni = (prefix ? prefix->router()->force_name_info() : the_name_info);
+    _generation++;
     NameDB *curdb = ni->namedb(db->type(), db->value_size(), db->context(), db);
     if (curdb && curdb != db) {
 	assert(!curdb->_context_child || curdb->_context_child->context().length() > db->context().length());
@@ -457,6 +418,7 @@ NameInfo::uninstalldb(NameDB *db)
 
     // This is an uncommon operation, so don't worry about its performance.
     NameInfo *ni = db->_installed;
+    _generation++;
     int m;
     for (m = 0; m < ni->_namedb_roots.size(); m++)
 	if (ni->_namedb_roots[m]->_type == db->_type)
@@ -496,17 +458,38 @@ NameInfo::uninstalldb(NameDB *db)
 bool
 NameInfo::query(uint32_t type, const Element *e, const String &name, void *value, size_t vsize)
 {
-    while (1) {
-	NameDB *db = getdb(type, e, vsize, false);
-	while (db) {
-	    if (db->query(name, value, vsize))
-		return true;
-	    db = db->context_parent();
-	}
-	if (!e)
-	    return false;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    query_lock.acquire();
+#endif
+    // Without router databases, only the global ones answer, whatever the
+    // context.
+    NameInfo *ni = (e ? e->router()->name_info() : 0);
+    if (!ni) {
+	ni = the_name_info;
 	e = 0;
     }
+    if (ni->_miss_generation != _generation || ni->_misses.size() > 4096) {
+	ni->_misses.clear();
+	ni->_miss_generation = _generation;
+    }
+    Miss miss(e, type, name);
+    bool found = false;
+    if (!ni->_misses.get_pointer(miss)) {
+	while (!found) {
+	    NameDB *db = getdb(type, e, vsize, false);
+	    for (; db && !found; db = db->context_parent())
+		found = db->query(name, value, vsize);
+	    if (!e)
+		break;
+	    e = 0;
+	}
+	if (!found)
+	    ni->_misses.set(miss, 1);
+    }
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    query_lock.release();
+#endif
+    return found;
 }
 
 bool
@@ -524,17 +507,22 @@ NameInfo::query_int(uint32_t type, const Element *e, const String &name, uint32_
 String
 NameInfo::revquery(uint32_t type, const Element *e, const void *value, size_t vsize)
 {
-    while (1) {
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    query_lock.acquire();
+#endif
+    String s;
+    while (!s) {
 	NameDB *db = getdb(type, e, vsize, false);
-	while (db) {
-	    if (String s = db->revquery(value, vsize))
-		return s;
-	    db = db->context_parent();
-	}
+	for (; db && !s; db = db->context_parent())
+	    s = db->revquery(value, vsize);
 	if (!e)
-	    return String();
+	    break;
 	e = 0;
     }
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    query_lock.release();
+#endif
+    return s;
 }
 
 
@@ -636,10 +624,9 @@ StaticNameDB::check(ErrorHandler *errh)
 void
 DynamicNameDB::check(ErrorHandler *errh)
 {
-    if (_sorted == 100)
-	for (int i = 0; i < _names.size() - 1; i++)
-	    if (String::compare(_names[i], _names[i+1]) >=0)
-		errh->error("entries %d/%d (%s/%s) out of order", i, i+1, _names[i].c_str(), _names[i+1].c_str());
+    for (int i = 0; i < _names.size(); i++)
+	if (_index.get(_names[i]) != i)
+	    errh->error("entry %d (%s) misindexed", i, _names[i].c_str());
     if ((size_t) _values.length() != _names.size() * value_size())
 	errh->error("odd value length %d (should be %d)", _values.length(), _names.size() * value_size());
 }
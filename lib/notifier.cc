@@ -616,4 +616,103 @@ Notifier::downstream_full_signal(Element* e, int port, Task* task, Notifier* dep
     return signal;
 }
 
+
+/** @class NotifierSignalSet
+ * @brief Finds the active members of a set of signals in bulk.
+ *
+ * Basic signals live as bits in shared words, so the activity of many
+ * signals can be read a word at a time.  A NotifierSignalSet groups an
+ * array of signals by word.  Its active_bitmap() function reports which
+ * signals are active at a cost proportional to the number of distinct
+ * words plus the number of active signals, rather than to the number of
+ * signals.  Schedulers with many inputs use it to skip empty inputs.
+ */
+
+NotifierSignalSet::NotifierSignalSet()
+    : _signals(0), _n(0), _words(0), _nwords(0), _next(0), _complex(0),
+      _ncomplex(0)
+{
+}
+
+NotifierSignalSet::~NotifierSignalSet()
+{
+    delete[] _words;
+    delete[] _next;
+    delete[] _complex;
+}
+
+/** @brief Initialize the set from an array of signals.
+ * @param signals array of @a n signals
+ * @param n number of signals
+ * @return 0 on success, -ENOMEM on out of memory
+ *
+ * The set refers to @a signals, which must outlive it and must not change
+ * while the set is in use. */
+int
+NotifierSignalSet::initialize(const NotifierSignal *signals, int n)
+{
+    delete[] _words;
+    delete[] _next;
+    delete[] _complex;
+    _signals = signals;
+    _n = n;
+    _nwords = _ncomplex = 0;
+    int nentries = 0;
+    for (int i = 0; i < n; ++i)
+	for (uint32_t m = signals[i]._mask; m; m &= m - 1)
+	    ++nentries;
+    _words = new word_t[n ? n : 1];
+    _next = new int[2 * (nentries ? nentries : 1)];
+    _complex = new int[n ? n : 1];
+    if (!_words || !_next || !_complex)
+	return -ENOMEM;
+
+    int nnext = 0;
+    for (int i = 0; i < n; ++i) {
+	const NotifierSignal &s = signals[i];
+	if (!s._mask) {
+	    _complex[_ncomplex++] = i;
+	    continue;
+	}
+	int w;
+	for (w = 0; w < _nwords && _words[w].value != s._v.v1; ++w)
+	    /* nada */;
+	if (w == _nwords) {
+	    _words[w].value = s._v.v1;
+	    _words[w].mask = 0;
+	    for (int b = 0; b < 32; ++b)
+		_words[w].first[b] = -1;
+	    ++_nwords;
+	}
+	_words[w].mask |= s._mask;
+	// one list entry per bit of the signal's mask
+	for (uint32_t m = s._mask; m; m &= m - 1) {
+	    int b = ffs_lsb(m) - 1;
+	    _next[2 * nnext] = i;
+	    _next[2 * nnext + 1] = _words[w].first[b];
+	    _words[w].first[b] = nnext++;
+	}
+    }
+    return 0;
+}
+
+/** @brief Compute the active signals.
+ * @param[out] bits bitmap of nwords() words
+ *
+ * Sets bit @e i of @a bits iff signal @e i is active. */
+void
+NotifierSignalSet::active_bitmap(uint32_t *bits) const
+{
+    memset(bits, 0, nwords() * sizeof(uint32_t));
+    for (const word_t *w = _words; w != _words + _nwords; ++w)
+	for (uint32_t x = *w->value & w->mask; x; x &= x - 1)
+	    for (int e = w->first[ffs_lsb(x) - 1]; e >= 0; e = _next[2 * e + 1]) {
+		int i = _next[2 * e];
+		bits[i >> 5] |= 1U << (i & 31);
+	    }
+    for (const int *c = _complex; c != _complex + _ncomplex; ++c)
+	if (_signals[*c])
+	    bits[*c >> 5] |= 1U << (*c & 31);
+}
+
 CLICK_ENDDECLS
@@ -23,8 +23,11 @@
 #include <click/packet_anno.hh>
 #include <click/glue.hh>
 #include <click/sync.hh>
+#include <click/straccum.hh>
 #if CLICK_USERLEVEL
 # include <unistd.h>
+# include <sys/mman.h>
+# include <errno.h>
 #endif
 CLICK_DECLS
 
@@ -179,6 +182,10 @@ CLICK_DECLS
  * Avoid writing buggy code like this!  Use WritablePacket selectively, and
  * try to avoid calling WritablePacket::clone() when possible. */
 
+#if CLICK_USERLEVEL
+static void free_packet_head(unsigned char *head, size_t size);
+#endif
+
 Packet::~Packet()
 {
     // This is a convenient place to put static assertions.
@@ -202,6 +209,17 @@ Packet::~Packet()
 #if CLICK_LINUXMODULE
     static_assert(sizeof(Anno) <= sizeof(((struct sk_buff *)0)->cb),
 		  "Anno structure too big for Linux packet annotation area.");
+#else
+    static_assert(offsetof(Packet, _aa.cb) % 8 == 0,
+		  "Annotation area must be 8-byte aligned.");
+    static_assert(offsetof(Packet, _data) + sizeof(_data) <= layout_hot_bytes
+		  && offsetof(Packet, _tail) + sizeof(_tail) <= layout_hot_bytes
+		  && offsetof(Packet, _head) + sizeof(_head) <= layout_hot_bytes
+		  && offsetof(Packet, _use_count) + sizeof(_use_count) <= layout_hot_bytes
+		  && offsetof(Packet, _aa.nh) + sizeof(_aa.nh) <= layout_hot_bytes
+		  && offsetof(Packet, _aa.cb) + DST_IP_ANNO_OFFSET + DST_IP_ANNO_SIZE <= layout_hot_bytes
+		  && offsetof(Packet, _aa.cb) + PAINT_ANNO_OFFSET + PAINT_ANNO_SIZE <= layout_hot_bytes,
+		  "Hot Packet fields must share the first cache line.");
 #endif
 
 #if CLICK_LINUXMODULE
@@ -212,8 +230,8 @@ Packet::~Packet()
 # if CLICK_USERLEVEL
     else if (_head && _destructor)
 	_destructor(_head, _end - _head);
-    else
-	delete[] _head;
+    else if (_head)
+	free_packet_head(_head, _end - _head);
 # elif CLICK_BSDMODULE
     if (_m)
 	m_freem(_m);
@@ -228,6 +246,11 @@ Packet::~Packet()
 #  define CLICK_PACKET_POOL_BUFSIZ		2048
 #  define CLICK_PACKET_POOL_SIZE		1000 // see LIMIT in packetpool-01.testie
 #  define CLICK_GLOBAL_PACKET_POOL_COUNT	16
+#  define CLICK_PACKET_POOL_BATCH		32
+#  if CLICK_USERLEVEL && defined(MAP_HUGETLB)
+#   define HAVE_CLICK_PACKET_POOL_HUGE		1
+#   define CLICK_PACKET_POOL_HUGE_SIZE		(2 << 20)
+#  endif
 namespace {
 struct PacketData {
     PacketData *next;
@@ -240,11 +263,32 @@ struct PacketPool {
     unsigned pcount;
     PacketData *pd;
     unsigned pdcount;
+    uint64_t phits;
+    uint64_t pmisses;
+    uint64_t pdhits;
+    uint64_t pdmisses;
 #  if HAVE_MULTITHREAD
     PacketPool *chain;
+    // Packets this thread freed on behalf of bin_owner, not yet returned.
+    PacketPool *bin_owner;
+    WritablePacket *bin_p;
+    WritablePacket *bin_p_last;
+    unsigned bin_pcount;
+    PacketData *bin_pd;
+    PacketData *bin_pd_last;
+    unsigned bin_pdcount;
+    uint64_t remote_returns;
+    // Other threads write the rest; keep it off the owner's cache line.
+    char pad[64];
+    WritablePacket * volatile remote_p;
+    PacketData * volatile remote_pd;
+    atomic_uint32_t remote_pcount;
+    atomic_uint32_t remote_pdcount;
 #  endif
 };
 }
+static unsigned packet_pool_size = CLICK_PACKET_POOL_SIZE;
+static unsigned global_packet_pool_count = CLICK_GLOBAL_PACKET_POOL_COUNT;
 #  if HAVE_MULTITHREAD
 static __thread PacketPool *thread_packet_pool;
 static PacketPool *all_thread_packet_pools;
@@ -271,22 +315,245 @@ get_packet_pool()
 static PacketPool packet_pool;
 #  endif
 
+static inline void
+lock_global_packet_pool()
+{
+#  if HAVE_MULTITHREAD
+    while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
+	/* do nothing */;
+#  endif
+}
+
+static inline void
+unlock_global_packet_pool()
+{
+#  if HAVE_MULTITHREAD
+    click_compiler_fence();
+    global_packet_pool_lock = 0;
+#  endif
+}
+
+#  if HAVE_CLICK_PACKET_POOL_HUGE
+// Huge-page data buffers are carved from CLICK_PACKET_POOL_HUGE_SIZE slabs
+// and never returned to the heap.  The first buffer of each slab links the
+// slabs together.  All of this state is protected by the global pool lock.
+static bool packet_pool_huge;
+static bool packet_pool_huge_failed;
+static PacketData *huge_slabs;
+static PacketData *huge_pd;
+
+static bool
+huge_packet_data_grow()
+{
+    void *m = mmap(0, CLICK_PACKET_POOL_HUGE_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (m == MAP_FAILED) {
+	click_chatter("packet pool: huge pages unavailable (%s), using heap", strerror(errno));
+	packet_pool_huge_failed = true;
+	return false;
+    }
+    unsigned char *slab = reinterpret_cast<unsigned char *>(m);
+    PacketData *header = reinterpret_cast<PacketData *>(slab);
+    header->next = huge_slabs;
+    huge_slabs = header;
+    for (unsigned off = CLICK_PACKET_POOL_HUGE_SIZE - CLICK_PACKET_POOL_BUFSIZ;
+	 off >= CLICK_PACKET_POOL_BUFSIZ; off -= CLICK_PACKET_POOL_BUFSIZ) {
+	PacketData *pd = reinterpret_cast<PacketData *>(slab + off);
+	pd->next = huge_pd;
+	huge_pd = pd;
+    }
+    return true;
+}
+
+static bool
+is_huge_packet_data(const PacketData *pd)
+{
+    const unsigned char *x = reinterpret_cast<const unsigned char *>(pd);
+    for (PacketData *s = huge_slabs; s; s = s->next) {
+	const unsigned char *slab = reinterpret_cast<const unsigned char *>(s);
+	if (x >= slab && x < slab + CLICK_PACKET_POOL_HUGE_SIZE)
+	    return true;
+    }
+    return false;
+}
+
+static void
+huge_packet_data_refill(PacketPool &pp)
+{
+    if (!huge_pd && (packet_pool_huge_failed || !huge_packet_data_grow()))
+	return;
+    while (huge_pd && pp.pdcount < packet_pool_size) {
+	PacketData *pd = huge_pd;
+	huge_pd = pd->next;
+	pd->next = pp.pd;
+	pp.pd = pd;
+	++pp.pdcount;
+    }
+}
+#  endif
+
+// Call with the global pool lock held.
+static inline void
+free_packet_data(PacketData *pd)
+{
+#  if HAVE_CLICK_PACKET_POOL_HUGE
+    if (huge_slabs && is_huge_packet_data(pd)) {
+	pd->next = huge_pd;
+	huge_pd = pd;
+	return;
+    }
+#  endif
+    delete[] reinterpret_cast<unsigned char *>(pd);
+}
+
+// Frees a pooled packet whose destructor has already run.
+static inline void
+free_pool_packet(WritablePacket *p)
+{
+#  if CLICK_USERLEVEL
+    free((void *) p);		// matches Packet::operator new
+#  else
+    ::operator delete((void *) p);
+#  endif
+}
+
+#  if HAVE_MULTITHREAD
+// Packets freed on a thread other than the one that allocated them collect
+// in the freeing thread's bin, and return to the allocating pool's remote
+// lists CLICK_PACKET_POOL_BATCH at a time with one compare-and-swap.  The
+// owner adopts its remote lists when its local lists run dry.  Neither side
+// takes global_packet_pool_lock.
+
+static void
+flush_packet_bin(PacketPool &pp)
+{
+    PacketPool *owner = pp.bin_owner;
+    if (pp.bin_p) {
+	WritablePacket *old;
+	do {
+	    old = owner->remote_p;
+	    pp.bin_p_last->set_next(old);
+	} while (!__sync_bool_compare_and_swap(&owner->remote_p, old, pp.bin_p));
+	owner->remote_pcount += pp.bin_pcount;
+	pp.remote_returns += pp.bin_pcount;
+	pp.bin_p = 0;
+	pp.bin_pcount = 0;
+    }
+    if (pp.bin_pd) {
+	PacketData *old;
+	do {
+	    old = owner->remote_pd;
+	    pp.bin_pd_last->next = old;
+	} while (!__sync_bool_compare_and_swap(&owner->remote_pd, old, pp.bin_pd));
+	owner->remote_pdcount += pp.bin_pdcount;
+	pp.bin_pd = 0;
+	pp.bin_pdcount = 0;
+    }
+}
+
+static inline bool
+recycle_remote(PacketPool &pp, PacketPool *owner, WritablePacket *p,
+	       unsigned char *data)
+{
+    if (owner != pp.bin_owner) {
+	flush_packet_bin(pp);
+	pp.bin_owner = owner;
+    }
+    // Don't pile up packets for a thread that has stopped allocating.
+    if (owner->remote_pcount + pp.bin_pcount >= packet_pool_size
+	|| (data && owner->remote_pdcount + pp.bin_pdcount >= packet_pool_size))
+	return false;
+    if (!pp.bin_p)
+	pp.bin_p_last = p;
+    p->set_next(pp.bin_p);
+    pp.bin_p = p;
+    ++pp.bin_pcount;
+    if (data) {
+	PacketData *pd = reinterpret_cast<PacketData *>(data);
+	if (!pp.bin_pd)
+	    pp.bin_pd_last = pd;
+	pd->next = pp.bin_pd;
+	pp.bin_pd = pd;
+	++pp.bin_pdcount;
+    }
+    if (pp.bin_pcount >= CLICK_PACKET_POOL_BATCH)
+	flush_packet_bin(pp);
+    return true;
+}
+
+static void
+adopt_remote_packets(PacketPool &pp)
+{
+    WritablePacket *p = __sync_lock_test_and_set(&pp.remote_p, (WritablePacket *) 0);
+    unsigned n = 0;
+    for (; p && pp.pcount < packet_pool_size; ++n) {
+	WritablePacket *next = static_cast<WritablePacket *>(p->next());
+	p->set_next(pp.p);
+	pp.p = p;
+	++pp.pcount;
+	p = next;
+    }
+    for (; p; ++n) {
+	WritablePacket *next = static_cast<WritablePacket *>(p->next());
+	free_pool_packet(p);
+	p = next;
+    }
+    pp.remote_pcount -= n;
+}
+
+static void
+adopt_remote_packet_data(PacketPool &pp)
+{
+    PacketData *pd = __sync_lock_test_and_set(&pp.remote_pd, (PacketData *) 0);
+    unsigned n = 0;
+    for (; pd && pp.pdcount < packet_pool_size; ++n) {
+	PacketData *next = pd->next;
+	pd->next = pp.pd;
+	pp.pd = pd;
+	++pp.pdcount;
+	pd = next;
+    }
+    if (pd) {
+	lock_global_packet_pool();
+	for (; pd; ++n) {
+	    PacketData *next = pd->next;
+	    free_packet_data(pd);
+	    pd = next;
+	}
+	unlock_global_packet_pool();
+    }
+    pp.remote_pdcount -= n;
+}
+#  endif
+
 WritablePacket *
 WritablePacket::pool_allocate(bool with_data)
 {
 #  if HAVE_MULTITHREAD
     PacketPool &packet_pool = *get_packet_pool();
+    if (!packet_pool.p && packet_pool.remote_p)
+	adopt_remote_packets(packet_pool);
+    if (with_data && !packet_pool.pd && packet_pool.remote_pd)
+	adopt_remote_packet_data(packet_pool);
+#   if HAVE_CLICK_PACKET_POOL_HUGE
+    // Unlocked hint: after a failed mmap, only freed slab buffers are left.
+    bool want_huge = with_data && !packet_pool.pd && packet_pool_huge
+	&& (!__atomic_load_n(&packet_pool_huge_failed, __ATOMIC_RELAXED)
+	    || __atomic_load_n(&huge_pd, __ATOMIC_RELAXED));
+#   else
+    bool want_huge = false;
+#   endif
     if ((!packet_pool.p && global_packet_pool.p)
-	|| (with_data && !packet_pool.pd && global_packet_pool.pd)) {
-	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
-	    /* do nothing */;
+	|| (with_data && !packet_pool.pd && global_packet_pool.pd)
+	|| want_huge) {
+	lock_global_packet_pool();
 
 	WritablePacket *pp;
 	if (!packet_pool.p && (pp = global_packet_pool.p)) {
 	    global_packet_pool.p = static_cast<WritablePacket *>(pp->prev());
 	    --global_packet_pool.pcount;
 	    packet_pool.p = pp;
-	    packet_pool.pcount = CLICK_PACKET_POOL_SIZE;
+	    packet_pool.pcount = packet_pool_size;
 	}
 
 	PacketData *pd;
@@ -294,13 +561,21 @@ WritablePacket::pool_allocate(bool with_data)
 	    global_packet_pool.pd = pd->pool_next;
 	    --global_packet_pool.pdcount;
 	    packet_pool.pd = pd;
-	    packet_pool.pdcount = CLICK_PACKET_POOL_SIZE;
+	    packet_pool.pdcount = packet_pool_size;
 	}
 
-	click_compiler_fence();
-	global_packet_pool_lock = 0;
+#   if HAVE_CLICK_PACKET_POOL_HUGE
+	if (with_data && !packet_pool.pd && packet_pool_huge)
+	    huge_packet_data_refill(packet_pool);
+#   endif
+
+	unlock_global_packet_pool();
     }
 #  else
+#   if HAVE_CLICK_PACKET_POOL_HUGE
+    if (with_data && !packet_pool.pd && packet_pool_huge)
+	huge_packet_data_refill(packet_pool);
+#   endif
     (void) with_data;
 #  endif
 
@@ -308,8 +583,15 @@ WritablePacket::pool_allocate(bool with_data)
     if (p) {
 	packet_pool.p = static_cast<WritablePacket *>(p->next());
 	--packet_pool.pcount;
-    } else
+	++packet_pool.phits;
+    } else {
 	p = new WritablePacket;
+	++packet_pool.pmisses;
+    }
+#  if HAVE_MULTITHREAD
+    if (p)
+	p->_pool = &packet_pool;
+#  endif
     return p;
 }
 
@@ -330,10 +612,12 @@ WritablePacket::pool_allocate(uint32_t headroom, uint32_t length,
 	if (n == CLICK_PACKET_POOL_BUFSIZ && (pd = packet_pool.pd)) {
 	    packet_pool.pd = pd->next;
 	    --packet_pool.pdcount;
+	    ++packet_pool.pdhits;
 	    p->_head = reinterpret_cast<unsigned char *>(pd);
-	} else if ((p->_head = new unsigned char[n]))
-	    /* OK */;
-	else {
+	} else if ((p->_head = new unsigned char[n])) {
+	    if (n == CLICK_PACKET_POOL_BUFSIZ)
+		++packet_pool.pdmisses;
+	} else {
 	    delete p;
 	    return 0;
 	}
@@ -353,20 +637,26 @@ WritablePacket::recycle(WritablePacket *p)
 	data = p->_head;
 	p->_head = 0;
     }
+#  if HAVE_MULTITHREAD
+    PacketPool *owner = static_cast<PacketPool *>(p->_pool);
+#  endif
     p->~WritablePacket();
 
 #  if HAVE_MULTITHREAD
     PacketPool &packet_pool = *get_packet_pool();
-    if ((packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE)
-	|| (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE)) {
-	while (atomic_uint32_t::swap(global_packet_pool_lock, 1) == 1)
-	    /* do nothing */;
+    if (owner && owner != &packet_pool
+	&& recycle_remote(packet_pool, owner, p, data))
+	return;
+
+    if ((packet_pool.p && packet_pool.pcount == packet_pool_size)
+	|| (data && packet_pool.pd && packet_pool.pdcount == packet_pool_size)) {
+	lock_global_packet_pool();
 
-	if (packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	if (packet_pool.p && packet_pool.pcount == packet_pool_size) {
+	    if (global_packet_pool.pcount == global_packet_pool_count) {
 		while (WritablePacket *p = packet_pool.p) {
 		    packet_pool.p = static_cast<WritablePacket *>(p->next());
-		    ::operator delete((void *) p);
+		    free_pool_packet(p);
 		}
 	    } else {
 		packet_pool.p->set_prev(global_packet_pool.p);
@@ -377,11 +667,11 @@ WritablePacket::recycle(WritablePacket *p)
 	    packet_pool.pcount = 0;
 	}
 
-	if (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pdcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
+	if (data && packet_pool.pd && packet_pool.pdcount == packet_pool_size) {
+	    if (global_packet_pool.pdcount == global_packet_pool_count) {
 		while (PacketData *pd = packet_pool.pd) {
 		    packet_pool.pd = pd->next;
-		    delete[] reinterpret_cast<unsigned char *>(pd);
+		    free_packet_data(pd);
 		}
 	    } else {
 		packet_pool.pd->pool_next = global_packet_pool.pd;
@@ -392,16 +682,15 @@ WritablePacket::recycle(WritablePacket *p)
 	    packet_pool.pdcount = 0;
 	}
 
-	click_compiler_fence();
-	global_packet_pool_lock = 0;
+	unlock_global_packet_pool();
     }
 #  else
-    if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	::operator delete((void *) p);
+    if (packet_pool.pcount == packet_pool_size) {
+	free_pool_packet(p);
 	p = 0;
     }
-    if (data && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	delete[] data;
+    if (data && packet_pool.pdcount == packet_pool_size) {
+	free_packet_data(reinterpret_cast<PacketData *>(data));
 	data = 0;
     }
 #  endif
@@ -410,17 +699,221 @@ WritablePacket::recycle(WritablePacket *p)
 	++packet_pool.pcount;
 	p->set_next(packet_pool.p);
 	packet_pool.p = p;
-	assert(packet_pool.pcount <= CLICK_PACKET_POOL_SIZE);
+	assert(packet_pool.pcount <= packet_pool_size);
     }
     if (data) {
 	++packet_pool.pdcount;
 	PacketData *pd = reinterpret_cast<PacketData *>(data);
 	pd->next = packet_pool.pd;
 	packet_pool.pd = pd;
-	assert(packet_pool.pdcount <= CLICK_PACKET_POOL_SIZE);
+	assert(packet_pool.pdcount <= packet_pool_size);
     }
 }
 
+/** @brief Configure the packet pool.
+ * @param size maximum number of packets, and of data buffers, each thread
+ *   keeps for reuse (default 1000)
+ * @param global_count maximum number of full per-thread pools kept in the
+ *   global overflow pool (default 16; unused in single-threaded drivers)
+ * @param huge_pages if true, allocate pooled data buffers from 2MB huge pages
+ * @return 0 on success, -EBUSY if packets have already been allocated,
+ *   -EINVAL if @a size is zero, or -EOPNOTSUPP if @a huge_pages is true
+ *   but huge pages are not supported
+ *
+ * Huge-page data buffers reduce TLB misses when many packets are in flight.
+ * If huge pages turn out to be unavailable at run time, the pool falls back
+ * to heap buffers. */
+int
+Packet::set_pool_parameters(uint32_t size, uint32_t global_count,
+			    bool huge_pages)
+{
+#  if HAVE_MULTITHREAD
+    if (all_thread_packet_pools)
+	return -EBUSY;
+#  else
+    if (packet_pool.phits || packet_pool.pmisses)
+	return -EBUSY;
+#  endif
+    if (size == 0)
+	return -EINVAL;
+#  if HAVE_CLICK_PACKET_POOL_HUGE
+    packet_pool_huge = huge_pages;
+#  else
+    if (huge_pages)
+	return -EOPNOTSUPP;
+#  endif
+    packet_pool_size = size;
+    global_packet_pool_count = global_count;
+    return 0;
+}
+
+/** @brief Return a description of packet pool activity.
+ *
+ * The result has one "name value" pair per line: the pool parameters
+ * followed by hit and miss counts summed over all threads.  A hit is an
+ * allocation satisfied from the pool; a miss required the heap.
+ * "remote_returns" counts packets returned in batches to the pool of the
+ * thread that allocated them. */
+String
+Packet::pool_statistics()
+{
+    uint64_t phits = 0, pmisses = 0, pdhits = 0, pdmisses = 0;
+    unsigned npools = 0;
+#  if HAVE_MULTITHREAD
+    uint64_t remote_returns = 0;
+    lock_global_packet_pool();
+    for (PacketPool *pp = all_thread_packet_pools; pp; pp = pp->chain) {
+	phits += pp->phits;
+	pmisses += pp->pmisses;
+	pdhits += pp->pdhits;
+	pdmisses += pp->pdmisses;
+	remote_returns += pp->remote_returns;
+	++npools;
+    }
+    unsigned global_pcount = global_packet_pool.pcount,
+	global_pdcount = global_packet_pool.pdcount;
+    unlock_global_packet_pool();
+#  else
+    phits = packet_pool.phits;
+    pmisses = packet_pool.pmisses;
+    pdhits = packet_pool.pdhits;
+    pdmisses = packet_pool.pdmisses;
+    npools = 1;
+#  endif
+    StringAccum sa;
+    sa << "size " << packet_pool_size << '\n';
+#  if HAVE_MULTITHREAD
+    sa << "global_count " << global_packet_pool_count << '\n';
+#  endif
+#  if HAVE_CLICK_PACKET_POOL_HUGE
+    sa << "huge_pages " << (packet_pool_huge && !packet_pool_huge_failed ? "true" : "false") << '\n';
+#  else
+    sa << "huge_pages false\n";
+#  endif
+    sa << "pools " << npools << '\n'
+       << "packet_hits " << phits << '\n'
+       << "packet_misses " << pmisses << '\n'
+       << "data_hits " << pdhits << '\n'
+       << "data_misses " << pdmisses << '\n';
+#  if HAVE_MULTITHREAD
+    sa << "remote_returns " << remote_returns << '\n'
+       << "global_packet_pools " << global_pcount << '\n'
+       << "global_data_pools " << global_pdcount << '\n';
+#  endif
+    return sa.take_string();
+}
+
+/** @brief Return the number of bytes held by the packet pools.
+ *
+ * Counts the free packets and free packet data buffers kept for reuse in
+ * every thread's pool, including those freed by other threads and not yet
+ * adopted, and in the global overflow pool. */
+size_t
+Packet::pool_memory()
+{
+    size_t npackets = 0, ndata = 0;
+#  if HAVE_MULTITHREAD
+    lock_global_packet_pool();
+    for (PacketPool *pp = all_thread_packet_pools; pp; pp = pp->chain) {
+	npackets += pp->pcount + pp->bin_pcount + pp->remote_pcount;
+	ndata += pp->pdcount + pp->bin_pdcount + pp->remote_pdcount;
+    }
+    npackets += (size_t) global_packet_pool.pcount * packet_pool_size;
+    ndata += (size_t) global_packet_pool.pdcount * packet_pool_size;
+    unlock_global_packet_pool();
+#  else
+    npackets = packet_pool.pcount;
+    ndata = packet_pool.pdcount;
+#  endif
+    return npackets * sizeof(WritablePacket) + ndata * CLICK_PACKET_POOL_BUFSIZ;
+}
+
+#endif
+
+#if CLICK_USERLEVEL
+// Frees a data buffer that did not go back to the pool through recycle().
+// With huge pages, a pool-sized buffer may belong to a slab.
+static void
+free_packet_head(unsigned char *head, size_t size)
+{
+# if HAVE_CLICK_PACKET_POOL_HUGE
+    if (packet_pool_huge && size == CLICK_PACKET_POOL_BUFSIZ) {
+	lock_global_packet_pool();
+	free_packet_data(reinterpret_cast<PacketData *>(head));
+	unlock_global_packet_pool();
+	return;
+    }
+# endif
+    (void) size;
+    delete[] head;
+}
+
+void *
+Packet::operator new(size_t size) throw ()
+{
+    void *p;
+    if (posix_memalign(&p, layout_hot_bytes, size) != 0)
+	return 0;
+    return p;
+}
+
+void
+Packet::operator delete(void *p)
+{
+    free(p);
+}
+#endif
+
+#if !CLICK_LINUXMODULE
+/** @brief Return a description of the Packet object's memory layout.
+ *
+ * The result has one line per Packet field: the field's name, its byte
+ * offset and size within the Packet, and the index of the 64-byte cache line
+ * it starts in.  For example, "dst_ip_anno 40 4 0".  The last line gives
+ * the Packet's total size and the number of cache lines it spans.  User-level
+ * Packets are allocated on cache-line boundaries, so the line indexes are
+ * exact there. */
+String
+Packet::layout_report()
+{
+    struct field {
+	const char *name;
+	size_t offset;
+	size_t size;
+    };
+    const field fields[] = {
+	{ "data", offsetof(Packet, _data), sizeof(unsigned char *) },
+	{ "tail", offsetof(Packet, _tail), sizeof(unsigned char *) },
+	{ "head", offsetof(Packet, _head), sizeof(unsigned char *) },
+	{ "use_count", offsetof(Packet, _use_count), sizeof(atomic_uint32_t) },
+	{ "packet_type", offsetof(Packet, _pkt_type), sizeof(PacketType) },
+	{ "network_header", offsetof(Packet, _aa.nh), sizeof(unsigned char *) },
+	{ "anno", offsetof(Packet, _aa.cb), sizeof(Anno) },
+	{ "dst_ip_anno", offsetof(Packet, _aa.cb) + DST_IP_ANNO_OFFSET, DST_IP_ANNO_SIZE },
+	{ "paint_anno", offsetof(Packet, _aa.cb) + PAINT_ANNO_OFFSET, PAINT_ANNO_SIZE },
+	{ "transport_header", offsetof(Packet, _aa.h), sizeof(unsigned char *) },
+	{ "mac_header", offsetof(Packet, _aa.mac), sizeof(unsigned char *) },
+	{ "next", offsetof(Packet, _aa.next), sizeof(Packet *) },
+	{ "timestamp_anno", offsetof(Packet, _aa.timestamp), sizeof(Timestamp) },
+	{ "data_packet", offsetof(Packet, _data_packet), sizeof(Packet *) },
+	{ "prev", offsetof(Packet, _prev), sizeof(Packet *) },
+	{ "end", offsetof(Packet, _end), sizeof(unsigned char *) },
+# if CLICK_USERLEVEL
+	{ "destructor", offsetof(Packet, _destructor), sizeof(void *) },
+# endif
+# if HAVE_CLICK_PACKET_POOL && HAVE_MULTITHREAD
+	{ "pool", offsetof(Packet, _pool), sizeof(void *) },
+# endif
+    };
+    StringAccum sa;
+    for (size_t i = 0; i != sizeof(fields) / sizeof(fields[0]); ++i)
+	sa << fields[i].name << ' ' << fields[i].offset << ' '
+	   << fields[i].size << ' ' << (fields[i].offset / layout_hot_bytes)
+	   << '\n';
+    sa << "size " << sizeof(Packet) << ' '
+       << ((sizeof(Packet) + layout_hot_bytes - 1) / layout_hot_bytes) << '\n';
+    return sa.take_string();
+}
 #endif
 
 bool
@@ -613,9 +1106,19 @@ Packet::clone()
 # endif
     if (!p)
 	return 0;
-    memcpy(p, this, sizeof(Packet));
+    // copy fields one by one; p->_pool must keep naming p's own pool
+    p->_data = _data;
+    p->_tail = _tail;
+    p->_head = _head;
+    p->_end = _end;
     p->_use_count = 1;
+    p->_pkt_type = _pkt_type;
+    p->_aa = _aa;
+    p->_prev = _prev;
     p->_data_packet = this;
+# if CLICK_NS
+    p->_sim_packetinfo = _sim_packetinfo;
+# endif
 # if CLICK_USERLEVEL
     p->_destructor = 0;
 # else
@@ -708,7 +1211,7 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
 	return q;
     }
 
-    uint8_t *old_head = _head, *old_end = _end;
+    uint8_t *old_head = _head, *old_end = _end, *old_tail = _tail;
 # if CLICK_BSDMODULE
     struct mbuf *old_m = _m;
 # endif
@@ -719,8 +1222,12 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
 	return 0;
     }
 
+    // Tailroom contents are undefined (put() returns uninitialized space),
+    // so copy only through the old tail.  Packets trimmed from large receive
+    // buffers often have far more tailroom than data.  Headroom is kept,
+    // since elements like Unstrip rely on bytes just before data().
     unsigned char *start_copy = old_head + (extra_headroom >= 0 ? 0 : -extra_headroom);
-    unsigned char *end_copy = old_end + (extra_tailroom >= 0 ? 0 : extra_tailroom);
+    unsigned char *end_copy = old_tail;
     memcpy(_head + (extra_headroom >= 0 ? extra_headroom : 0), start_copy, end_copy - start_copy);
 
     // free old data
@@ -730,7 +1237,7 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
     else if (_destructor)
 	_destructor(old_head, old_end - old_head);
     else
-	delete[] old_head;
+	free_packet_head(old_head, old_end - old_head);
     _destructor = 0;
 # elif CLICK_BSDMODULE
     m_freem(old_m); // alloc_data() created a new mbuf, so free the old one
@@ -805,6 +1312,33 @@ Packet::dup_jumbo_m(struct mbuf *m)
 // EXPENSIVE_PUSH, EXPENSIVE_PUT
 //
 
+namespace {
+enum { ec_push_headroom, ec_push_shared, ec_push_bytes,
+       ec_put_tailroom, ec_put_shared, ec_put_bytes, ec_n };
+atomic_uint32_t expensive_counts[ec_n];
+}
+
+/** @brief Return a description of expensive push and put activity.
+ *
+ * The result has one "name value" pair per line.  "push_headroom" counts
+ * push() calls that reallocated because the packet lacked headroom, and
+ * "push_shared" those that reallocated because the packet's data was
+ * shared; "push_bytes" totals the bytes requested by both.  The "put"
+ * lines describe put() in the same way.  Router::headroom_required() helps
+ * sources avoid the headroom case. */
+String
+Packet::expensive_statistics()
+{
+    StringAccum sa;
+    sa << "push_headroom " << expensive_counts[ec_push_headroom].value() << '\n'
+       << "push_shared " << expensive_counts[ec_push_shared].value() << '\n'
+       << "push_bytes " << expensive_counts[ec_push_bytes].value() << '\n'
+       << "put_tailroom " << expensive_counts[ec_put_tailroom].value() << '\n'
+       << "put_shared " << expensive_counts[ec_put_shared].value() << '\n'
+       << "put_bytes " << expensive_counts[ec_put_bytes].value() << '\n';
+    return sa.take_string();
+}
+
 /*
  * Prepend some empty space before a packet.
  * May kill this packet and return a new one.
@@ -813,11 +1347,16 @@ WritablePacket *
 Packet::expensive_push(uint32_t nbytes)
 {
   static int chatter = 0;
-  if (headroom() < nbytes && chatter < 5) {
-    click_chatter("expensive Packet::push; have %d wanted %d",
-                  headroom(), nbytes);
-    chatter++;
-  }
+  if (headroom() < nbytes) {
+    expensive_counts[ec_push_headroom]++;
+    if (chatter < 5) {
+      click_chatter("expensive Packet::push; have %d wanted %d",
+		    headroom(), nbytes);
+      chatter++;
+    }
+  } else
+    expensive_counts[ec_push_shared]++;
+  expensive_counts[ec_push_bytes] += nbytes;
   if (WritablePacket *q = expensive_uniqueify((nbytes + 128) & ~3, 0, true)) {
 #ifdef CLICK_LINUXMODULE	/* Linux kernel module */
     __skb_push(q->skb(), nbytes);
@@ -838,11 +1377,16 @@ WritablePacket *
 Packet::expensive_put(uint32_t nbytes)
 {
   static int chatter = 0;
-  if (tailroom() < nbytes && chatter < 5) {
-    click_chatter("expensive Packet::put; have %d wanted %d",
-                  tailroom(), nbytes);
-    chatter++;
-  }
+  if (tailroom() < nbytes) {
+    expensive_counts[ec_put_tailroom]++;
+    if (chatter < 5) {
+      click_chatter("expensive Packet::put; have %d wanted %d",
+		    tailroom(), nbytes);
+      chatter++;
+    }
+  } else
+    expensive_counts[ec_put_shared]++;
+  expensive_counts[ec_put_bytes] += nbytes;
   if (WritablePacket *q = expensive_uniqueify(0, nbytes + 128, true)) {
 #ifdef CLICK_LINUXMODULE	/* Linux kernel module */
     __skb_put(q->skb(), nbytes);
@@ -906,23 +1450,49 @@ Packet::shift_data(int offset, bool free_on_failure)
 
 
 #if HAVE_CLICK_PACKET_POOL
-static void
-cleanup_pool(PacketPool *pp, int global)
+static unsigned
+cleanup_packets(WritablePacket *p)
 {
-    unsigned pcount = 0, pdcount = 0;
-    while (WritablePacket *p = pp->p) {
-	++pcount;
-	pp->p = static_cast<WritablePacket *>(p->next());
-	::operator delete((void *) p);
+    unsigned n = 0;
+    for (; p; ++n) {
+	WritablePacket *next = static_cast<WritablePacket *>(p->next());
+	free_pool_packet(p);
+	p = next;
     }
-    while (PacketData *pd = pp->pd) {
-	++pdcount;
-	pp->pd = pd->next;
-	delete[] reinterpret_cast<unsigned char *>(pd);
+    return n;
+}
+
+static unsigned
+cleanup_packet_data(PacketData *pd)
+{
+    unsigned n = 0;
+    for (; pd; ++n) {
+	PacketData *next = pd->next;
+	free_packet_data(pd);
+	pd = next;
     }
-    assert(pcount <= CLICK_PACKET_POOL_SIZE);
-    assert(pdcount <= CLICK_PACKET_POOL_SIZE);
+    return n;
+}
+
+static void
+cleanup_pool(PacketPool *pp, int global)
+{
+    unsigned pcount = cleanup_packets(pp->p);
+    unsigned pdcount = cleanup_packet_data(pp->pd);
+    pp->p = 0;
+    pp->pd = 0;
+    assert(pcount <= packet_pool_size);
+    assert(pdcount <= packet_pool_size);
     assert(global || (pcount == pp->pcount && pdcount == pp->pdcount));
+# if HAVE_MULTITHREAD
+    if (!global) {
+	cleanup_packets(pp->bin_p);
+	cleanup_packet_data(pp->bin_pd);
+	cleanup_packets(pp->remote_p);
+	cleanup_packet_data(pp->remote_pd);
+    }
+# endif
+    (void) pcount, (void) pdcount;
 }
 #endif
 
@@ -937,7 +1507,7 @@ Packet::static_cleanup()
 	delete pp;
     }
     unsigned rounds = (global_packet_pool.pcount > global_packet_pool.pdcount ? global_packet_pool.pcount : global_packet_pool.pdcount);
-    assert(rounds <= CLICK_GLOBAL_PACKET_POOL_COUNT);
+    assert(rounds <= global_packet_pool_count);
     while (global_packet_pool.p || global_packet_pool.pd) {
 	WritablePacket *next_p = global_packet_pool.p;
 	next_p = (next_p ? static_cast<WritablePacket *>(next_p->prev()) : 0);
@@ -949,8 +1519,17 @@ Packet::static_cleanup()
 	--rounds;
     }
     assert(rounds == 0);
+    global_packet_pool.pcount = global_packet_pool.pdcount = 0;
 # else
     cleanup_pool(&packet_pool, 0);
+    packet_pool.pcount = packet_pool.pdcount = 0;
+# endif
+# if HAVE_CLICK_PACKET_POOL_HUGE
+    while (PacketData *slab = huge_slabs) {
+	huge_slabs = slab->next;
+	munmap(slab, CLICK_PACKET_POOL_HUGE_SIZE);
+    }
+    huge_pd = 0;
 # endif
 #endif
 }
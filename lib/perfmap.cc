@@ -0,0 +1,205 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/perfmap.hh" -*-
+/*
+ * perfmap.{cc,hh} -- describe generated code to profilers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include <click/perfmap.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/atomic.hh>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
+CLICK_DECLS
+
+int PerfMap::_flags;
+
+namespace {
+
+FILE *perf_map_file;
+FILE *jitdump_file;
+atomic_uint32_t jitdump_index;
+
+// jitdump format: see tools/perf/Documentation/jitdump-specification.txt
+// in the Linux source
+enum { jitdump_magic = 0x4A695444, jitdump_version = 1, jit_code_load = 0 };
+
+struct jitdump_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct jitdump_code_load {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+};
+
+uint64_t
+jitdump_timestamp()
+{
+    // perf record -k mono matches these timestamps to samples
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+	return 0;
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint32_t
+jitdump_elf_mach()
+{
+#if defined(__x86_64__)
+    return 62;			// EM_X86_64
+#elif defined(__i386__)
+    return 3;			// EM_386
+#elif defined(__aarch64__)
+    return 183;			// EM_AARCH64
+#elif defined(__arm__)
+    return 40;			// EM_ARM
+#else
+    return 0;
+#endif
+}
+
+FILE *
+open_jitdump(const String &filename, ErrorHandler *errh)
+{
+    int fd = open(filename.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd < 0) {
+	errh->error("%s: %s", filename.c_str(), strerror(errno));
+	return 0;
+    }
+
+    jitdump_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = jitdump_magic;
+    h.version = jitdump_version;
+    h.total_size = sizeof(h);
+    h.elf_mach = jitdump_elf_mach();
+    h.pid = getpid();
+    h.timestamp = jitdump_timestamp();
+    if (write(fd, &h, sizeof(h)) != (ssize_t) sizeof(h)) {
+	errh->error("%s: %s", filename.c_str(), strerror(errno));
+	close(fd);
+	return 0;
+    }
+
+    // perf finds the file through an executable mapping of it, which is
+    // otherwise unused
+    long pagesize = sysconf(_SC_PAGESIZE);
+    if (mmap(0, pagesize, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0) == MAP_FAILED)
+	errh->warning("%s: %s", filename.c_str(), strerror(errno));
+
+    FILE *f = fdopen(fd, "ab");
+    if (!f)
+	close(fd);
+    return f;
+}
+
+}
+
+/** @brief  Start recording generated code regions.
+ *  @param  flags  F_MAP, F_JITDUMP, or both
+ *  @param  errh   error handler
+ *  @return 0 on success, -1 if a file could not be opened
+ *
+ *  Regions added before enable() are not recorded.  Calling enable() again
+ *  with new flags opens any further files needed. */
+int
+PerfMap::enable(int flags, ErrorHandler *errh)
+{
+    if (!errh)
+	errh = ErrorHandler::default_handler();
+    int pid = getpid();
+    if ((flags & F_MAP) && !perf_map_file) {
+	String filename = "/tmp/perf-" + String(pid) + ".map";
+	if (!(perf_map_file = fopen(filename.c_str(), "w")))
+	    return errh->error("%s: %s", filename.c_str(), strerror(errno));
+	_flags |= F_MAP;
+    }
+    if ((flags & F_JITDUMP) && !jitdump_file) {
+	String filename = "/tmp/jit-" + String(pid) + ".dump";
+	if (!(jitdump_file = open_jitdump(filename, errh)))
+	    return -1;
+	_flags |= F_JITDUMP;
+    }
+    return 0;
+}
+
+/** @brief  Record the generated code region [@a code, @a code + @a size).
+ *  @param  code  start of the region
+ *  @param  size  size of the region in bytes
+ *  @param  name  symbol name, such as the owning element's declaration
+ *
+ *  Does nothing unless enable() has been called.  The region's code must be
+ *  complete, since F_JITDUMP copies it. */
+void
+PerfMap::add(const void *code, size_t size, const String &name)
+{
+    if (!_flags || !size)
+	return;
+    String symbol = "click:" + name;
+
+    if (perf_map_file) {
+	StringAccum sa;
+	sa.snprintf(40, "%lx %lx ", (unsigned long) code, (unsigned long) size);
+	sa << symbol << '\n';
+	fwrite(sa.data(), 1, sa.length(), perf_map_file);
+	fflush(perf_map_file);
+    }
+
+    if (jitdump_file) {
+	jitdump_code_load r;
+	r.id = jit_code_load;
+	r.total_size = sizeof(r) + symbol.length() + 1 + size;
+	r.timestamp = jitdump_timestamp();
+	r.pid = getpid();
+#if defined(__linux__) && defined(SYS_gettid)
+	r.tid = syscall(SYS_gettid);
+#else
+	r.tid = r.pid;
+#endif
+	r.vma = r.code_addr = (uintptr_t) code;
+	r.code_size = size;
+	r.code_index = jitdump_index.fetch_and_add(1);
+	// write each record with one call so concurrent records don't mix
+	StringAccum sa(r.total_size);
+	sa.append(reinterpret_cast<const char *>(&r), sizeof(r));
+	sa.append(symbol.c_str(), symbol.length() + 1);
+	sa.append(reinterpret_cast<const char *>(code), size);
+	fwrite(sa.data(), 1, sa.length(), jitdump_file);
+	fflush(jitdump_file);
+    }
+}
+
+CLICK_ENDDECLS
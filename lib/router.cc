@@ -34,6 +34,8 @@
 #include <click/notifier.hh>
 #include <click/nameinfo.hh>
 #include <click/bighashmap_arena.hh>
+#include <click/arena.hh>
+#include <click/pair.hh>
 #if CLICK_STATS >= 2
 # include <click/hashtable.hh>
 #endif
@@ -45,6 +47,7 @@
 # include <stdarg.h>
 #endif
 #if CLICK_USERLEVEL
+# include <click/lexer.hh>
 # include <unistd.h>
 #endif
 #if CLICK_NS
@@ -65,6 +68,7 @@ const Handler* Handler::the_blank_handler;
 static Handler* globalh;
 static int nglobalh;
 static int globalh_cap;
+static unsigned handler_generation_counter;
 
 /** @brief  Create a router.
  *  @param  configuration  router configuration
@@ -77,16 +81,23 @@ static int globalh_cap;
 Router::Router(const String &configuration, Master *master)
     : _master(0), _state(ROUTER_NEW),
       _have_connections(false), _conn_sorted(true), _have_configuration(true),
-      _running(RUNNING_INACTIVE), _last_landmarkid(0),
-      _handler_bufs(0), _nhandlers_bufs(0), _free_handler(-1),
+      _running(RUNNING_INACTIVE), _timestamps_analyzed(false),
+      _last_landmarkid(0),
+      _element_name_map(-1), _configure_threads(1), _push_fusion(true),
+      _have_flow_index(false), _ehandler_map(-1), _handler_bufs(0), _nhandlers_bufs(0), _free_handler(-1),
       _root_element(0),
       _configuration(configuration),
       _notifier_signals(0),
-      _arena_factory(new HashMap_ArenaFactory),
+      _arena_factory(new HashMap_ArenaFactory), _arena(new Arena),
+#if HAVE_STRING_ARENA
+      _string_arena(new String::Arena),
+#endif
       _hotswap_router(0), _thread_sched(0), _name_info(0), _next_router(0)
 {
+    _paused = 0;
     _refcount = 0;
     _runcount = 0;
+    _forwarding_epoch = 0;
     _root_element = new ErrorElement;
     _root_element->attach_router(this, -1);
     master->register_router(this);
@@ -108,6 +119,10 @@ Router::~Router()
 
     // Delete the ArenaFactory, which detaches the Arenas
     delete _arena_factory;
+#if HAVE_STRING_ARENA
+    // Outstanding arena Strings keep their chunks alive
+    delete _string_arena;
+#endif
 
     // Clean up elements in reverse configuration order
     if (_state == ROUTER_LIVE) {
@@ -151,6 +166,8 @@ Router::~Router()
 	delete ns;
     }
     delete _name_info;
+    // Elements are gone, so nothing refers to arena memory
+    delete _arena;
     if (_master)
 	_master->unregister_router(this);
 }
@@ -168,15 +185,6 @@ Router::unuse()
 
 // ACCESS
 
-static int
-element_name_sorter_compar(const void *ap, const void *bp, void *user_data)
-{
-    int a = *reinterpret_cast<const int *>(ap);
-    int b = *reinterpret_cast<const int *>(bp);
-    const Vector<String> &element_names = *reinterpret_cast<Vector<String> *>(user_data);
-    return String::compare(element_names[a], element_names[b]);
-}
-
 /** @brief  Finds an element named @a name.
  *  @param  name     element name
  *  @param  context  compound element context
@@ -196,28 +204,10 @@ element_name_sorter_compar(const void *ap, const void *bp, void *user_data)
 Element *
 Router::find(const String &name, String context, ErrorHandler *errh) const
 {
-    if (_element_name_sorter.size() != _element_names.size()) {
-	while (_element_name_sorter.size() != _element_names.size())
-	    _element_name_sorter.push_back(_element_name_sorter.size());
-	click_qsort(_element_name_sorter.begin(), _element_name_sorter.size(),
-		    sizeof(_element_name_sorter[0]),
-		    element_name_sorter_compar, (void *) &_element_names);
-    }
-
     while (1) {
-	String n = context + name;
-	int *l = _element_name_sorter.begin();
-	int *r = _element_name_sorter.end();
-	while (l < r) {
-	    int *m = l + (r - l) / 2;
-	    int cmp = String::compare(n, _element_names[*m]);
-	    if (cmp < 0)
-		r = m;
-	    else if (cmp > 0)
-		l = m + 1;
-	    else
-		return _elements[*m];
-	}
+	int i = _element_name_map.get(context + name);
+	if (i >= 0)
+	    return _elements[i];
 
 	if (!context)
 	    break;
@@ -307,12 +297,15 @@ Router::econfiguration(int eindex) const
  *  @param  eindex  element index
  *  @param  conf    configuration string
  *
- *  Does nothing if @a eindex is out of range. */
+ *  Does nothing if @a eindex is out of range.  Since handlers call this after
+ *  reconfiguring an element, it also advances forwarding_epoch(). */
 void
 Router::set_econfiguration(int eindex, const String &conf)
 {
-    if (eindex >= 0 && eindex < nelements())
+    if (eindex >= 0 && eindex < nelements()) {
 	_element_configurations[eindex] = conf;
+	bump_forwarding_epoch();
+    }
 }
 
 /** @brief  Returns element index @a eindex's landmark.
@@ -328,6 +321,20 @@ Router::elandmark(int eindex) const
     if (eindex < 0 || eindex >= nelements())
 	return String::make_empty();
 
+    unsigned lineno;
+    const String &filename = element_landmark(eindex, lineno).filename;
+
+    if (!lineno)
+	return filename;
+    else if (filename && (filename.back() == ':' || isspace((unsigned char) filename.back())))
+	return filename + String(lineno);
+    else
+	return filename + String(':') + String(lineno);
+}
+
+const Router::element_landmark_t &
+Router::element_landmark(int eindex, unsigned &lineno) const
+{
     // binary search over landmarks
     uint32_t x = _element_landmarkids[eindex];
     uint32_t l = 0, r = _element_landmarks.size();
@@ -340,15 +347,8 @@ Router::elandmark(int eindex) const
 	    l = m + 1;
     }
 
-    const String &filename = _element_landmarks[r - 1].filename;
-    unsigned lineno = x - _element_landmarks[r - 1].first_landmarkid;
-
-    if (!lineno)
-	return filename;
-    else if (filename && (filename.back() == ':' || isspace((unsigned char) filename.back())))
-	return filename + String(lineno);
-    else
-	return filename + String(':') + String(lineno);
+    lineno = x - _element_landmarks[r - 1].first_landmarkid;
+    return _element_landmarks[r - 1];
 }
 
 int
@@ -395,6 +395,7 @@ Router::add_element(Element *e, const String &ename, const String &conf,
     _elements.push_back(e);
     _element_names.push_back(ename);
     _element_configurations.push_back(conf);
+    _element_name_map.find_insert(ename, _elements.size() - 1);
 
     uint32_t lmid;
     if (_element_landmarks.size()
@@ -696,8 +697,8 @@ Router::check_push_and_pull(ErrorHandler *errh)
 	    if (*inputp == Element::VAGNOSTIC) {
 		_elements[ei]->port_flow(false, port, &bv);
 		int og = gport(true, Port(ei, 0));
-		for (int j = 0; j < bv.size(); ++j)
-		    if (bv[j] && output_pers[og + j] == Element::VAGNOSTIC)
+		for (int j = bv.find_first(); j >= 0; j = bv.find_next(j))
+		    if (output_pers[og + j] == Element::VAGNOSTIC)
 			conn.push_back(Connection(ei, j, ei, port));
 	    }
     }
@@ -848,7 +849,317 @@ Router::set_flow_code_override(int eindex, const String &flow_code)
 {
     _flow_code_override_eindex.push_back(eindex);
     _flow_code_override.push_back(flow_code);
+    _have_flow_index = false;
+}
+
+/** @brief Index connections and internal packet flow by port.
+ *
+ * Traversals such as visit_base() and Notifier initialization otherwise
+ * binary-search the connection list and reparse each element's flow code
+ * at every step.  The index is built once, when elements are configured
+ * and connections can no longer change. */
+void
+Router::build_flow_index()
+{
+    sort_connections();
+    _have_flow_index = false;
+    Bitvector flow;
+    for (int isoutput = 0; isoutput < 2; ++isoutput) {
+	// connections are sorted by port on this side, so counting them
+	// per port gives each port's first connection index
+	_conn_first[isoutput].assign(ngports(isoutput) + 1, 0);
+	for (int ci = 0; ci < _conn.size(); ++ci)
+	    ++_conn_first[isoutput][gport(isoutput, _conn[ci][isoutput]) + 1];
+	for (int g = 1; g < _conn_first[isoutput].size(); ++g)
+	    _conn_first[isoutput][g] += _conn_first[isoutput][g - 1];
+
+	_flow_first[isoutput].clear();
+	_flow_port[isoutput].clear();
+	for (int i = 0; i < nelements(); ++i)
+	    for (int port = 0; port < _elements[i]->nports(isoutput); ++port) {
+		_flow_first[isoutput].push_back(_flow_port[isoutput].size());
+		_elements[i]->port_flow(isoutput, port, &flow);
+		int n = flow.count();
+		if (n && n == flow.size())
+		    _flow_port[isoutput].push_back(-1);
+		else
+		    for (int p = flow.find_first(); p >= 0; p = flow.find_next(p))
+			_flow_port[isoutput].push_back(p);
+	    }
+	_flow_first[isoutput].push_back(_flow_port[isoutput].size());
+    }
+    _have_flow_index = true;
+}
+
+bool
+Router::indexed_port_flow(bool isoutput, const Element *e, int port,
+			  Bitvector *travels) const
+{
+    if (!_have_flow_index || port < 0 || port >= e->nports(isoutput))
+	return false;
+    int g = gport(isoutput, Port(e->eindex(), port));
+    const int *fp = _flow_port[isoutput].begin() + _flow_first[isoutput][g];
+    const int *fend = _flow_port[isoutput].begin() + _flow_first[isoutput][g + 1];
+    int nother = e->nports(!isoutput);
+    if (fp != fend && *fp < 0)
+	travels->assign(nother, true);
+    else {
+	travels->assign(nother, false);
+	for (; fp != fend; ++fp)
+	    (*travels)[*fp] = true;
+    }
+    return true;
+}
+
+/** @brief Compute headroom_required() for every element.
+ *
+ * Each element needs the headroom pushed by its downstream neighbors plus
+ * whatever they need in turn.  Relaxing over the connection list converges
+ * after at most nelements() passes on an acyclic graph; on cycles the total
+ * is capped at max_headroom, the largest headroom a Packet can carry. */
+void
+Router::analyze_headroom()
+{
+    enum { max_headroom = 8190 };
+    int n = nelements();
+    Vector<int> encap(n, 0);
+    bool any = false;
+    for (int i = 0; i < n; ++i)
+	if ((encap[i] = _elements[i]->encap_headroom()) > 0)
+	    any = true;
+	else
+	    encap[i] = 0;
+    _element_headroom.assign(n, 0);
+    if (!any)
+	return;
+
+    for (int pass = 0; pass < n; ++pass) {
+	bool changed = false;
+	for (Connection *cp = _conn.begin(); cp != _conn.end(); ++cp) {
+	    int from = (*cp)[1].idx, to = (*cp)[0].idx;
+	    int need = encap[to] + _element_headroom[to];
+	    if (need > max_headroom)
+		need = max_headroom;
+	    if (need > _element_headroom[from]) {
+		_element_headroom[from] = need;
+		changed = true;
+	    }
+	}
+	if (!changed)
+	    break;
+    }
+}
+
+/** @brief Compute timestamp_required() for every element.
+ *
+ * An element needs timestamps if a downstream neighbor reads them (has the
+ * T flag) or needs them in turn.  Like analyze_headroom(), this follows
+ * every connection regardless of flow codes, so it errs toward stamping. */
+void
+Router::analyze_timestamps()
+{
+    int n = nelements();
+    Bitvector reads(n);
+    bool any = false;
+    for (int i = 0; i < n; ++i)
+	if (_elements[i]->flag_value('T') > 0)
+	    reads[i] = any = true;
+    _element_timestamp.assign(n, false);
+    _timestamps_analyzed = true;
+    if (!any)
+	return;
+
+    for (int pass = 0; pass < n; ++pass) {
+	bool changed = false;
+	for (Connection *cp = _conn.begin(); cp != _conn.end(); ++cp) {
+	    int from = (*cp)[1].idx, to = (*cp)[0].idx;
+	    if (!_element_timestamp[from]
+		&& (reads[to] || _element_timestamp[to])) {
+		_element_timestamp[from] = true;
+		changed = true;
+	    }
+	}
+	if (!changed)
+	    break;
+    }
+}
+
+// Alignments are encoded as modulus << 4 | offset; 0 means no preference.
+// The meet of two alignments is the strongest alignment both satisfy.
+static int
+alignment_meet(int a, int b)
+{
+    if (a == 0 || a == b)
+	return b;
+    if (b == 0)
+	return a;
+    int m = (a >> 4) < (b >> 4) ? a >> 4 : b >> 4;
+    while (m > 1 && ((a ^ b) & 15 & (m - 1)))
+	m >>= 1;
+    return m << 4 | (a & (m - 1));
+}
+
+/** @brief Compute alignment_required() for every element.
+ *
+ * An element's input wants the alignment it declares with
+ * Element::input_alignment(), met with its outputs' wanted alignment moved
+ * back by its Element::data_shift().  An element's outputs want the meet of
+ * what every downstream input wants.  Alignments only weaken as the passes
+ * go on, so the loop ends after a few passes. */
+void
+Router::analyze_alignment()
+{
+    int n = nelements();
+    Vector<int> own(n, 0), shift(n, 0);
+    bool any = false;
+    for (int i = 0; i < n; ++i) {
+	int modulus, offset;
+	if (_elements[i]->input_alignment(modulus, offset)
+	    && modulus >= 2 && modulus <= 8 && !(modulus & (modulus - 1))) {
+	    own[i] = modulus << 4 | (offset & (modulus - 1));
+	    any = true;
+	}
+	shift[i] = _elements[i]->data_shift();
+    }
+    _element_alignment.assign(n, 0);
+    if (!any)
+	return;
+
+    for (int pass = 0; pass < 4 * n; ++pass) {
+	bool changed = false;
+	for (Connection *cp = _conn.begin(); cp != _conn.end(); ++cp) {
+	    int from = (*cp)[1].idx, to = (*cp)[0].idx;
+	    int want = own[to], out = _element_alignment[to];
+	    if (out && shift[to] != Element::DATA_SHIFT_UNKNOWN) {
+		int m = out >> 4;
+		want = alignment_meet(want, m << 4 | (((out & 15) - shift[to]) & (m - 1)));
+	    }
+	    if (!want)
+		continue;
+	    int a = alignment_meet(_element_alignment[from], want);
+	    if (a != _element_alignment[from]) {
+		_element_alignment[from] = a;
+		changed = true;
+	    }
+	}
+	if (!changed)
+	    break;
+    }
+}
+
+#if HAVE_PUSH_FUSION
+// Returns true iff e passes packets from push input 0 to push output 0
+// with the default Element::push(), and so through simple_action().
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wpmf-conversions"
+static bool
+push_fusible(Element *e)
+{
+    if (e->ninputs() < 1 || !e->input_is_push(0)
+	|| e->noutputs() < 1 || !e->output_is_push(0))
+	return false;
+    typedef void (*pusher_type)(Element *, int, Packet *);
+    void (Element::*pusher)(int, Packet *) = &Element::push;
+    return (pusher_type) (e->*pusher) == (pusher_type) &Element::push;
+}
+# pragma GCC diagnostic pop
+
+/** @brief Fuse chains of simple_action() elements.
+ *
+ * A chain is two or more push_fusible() elements, each connected from
+ * output 0 to the next's input 0.  Ports pushing into a chain from outside
+ * it call Port::fused_push(), which runs the chain's elements in a loop.
+ * Chains are stored consecutively in _fused_chains, each followed by a
+ * null pointer; a chain that several chains flow into is stored once for
+ * each. */
+void
+Router::fuse_push_chains()
+{
+    int n = nelements();
+    Vector<int> fusible(n, 0), chain_offset(n, -1), mark(n, -1);
+    for (int i = 0; i < n; ++i)
+	fusible[i] = push_fusible(_elements[i]);
+
+    // Ports from outside a chain into its first element get the chain.
+    Vector<Element::Port *> heads;
+    for (int i = 0; i < n; ++i)
+	for (int o = 0; o < _elements[i]->noutputs(); ++o) {
+	    Element::Port &port = _elements[i]->_ports[1][o];
+	    if (port.active() && port.port() == 0
+		&& fusible[port.element()->eindex()]
+		&& !(o == 0 && fusible[i]))
+		heads.push_back(&port);
+	}
+
+    _fused_chains.clear();
+    int stamp = 0;
+    for (Element::Port **pp = heads.begin(); pp != heads.end(); ++pp, ++stamp) {
+	Element *e = (*pp)->element();
+	if (chain_offset[e->eindex()] >= 0)
+	    continue;
+	int offset = _fused_chains.size();
+	while (1) {
+	    mark[e->eindex()] = stamp;
+	    _fused_chains.push_back(e);
+	    const Element::Port &out = e->_ports[1][0];
+	    e = out.element();
+	    if (out.port() != 0 || !fusible[e->eindex()]
+		|| mark[e->eindex()] == stamp)
+		break;
+	}
+	if (_fused_chains.size() - offset < 2)
+	    _fused_chains.resize(offset);
+	else {
+	    _fused_chains.push_back(0);
+	    chain_offset[(*pp)->element()->eindex()] = offset;
+	}
+    }
+
+    // Assign after building, since _fused_chains may have moved.
+    for (Element::Port **pp = heads.begin(); pp != heads.end(); ++pp) {
+	int offset = chain_offset[(*pp)->element()->eindex()];
+	if (offset >= 0)
+	    (*pp)->_fused = &_fused_chains[offset];
+    }
+}
+
+/** @brief Return a description of the fused push chains.
+ *
+ * Each line lists one chain's elements in order, separated by " -> ".
+ * Returns the empty string if no chains were fused.
+ * @sa set_push_fusion() */
+String
+Router::fused_chains() const
+{
+    StringAccum sa;
+    for (Element * const *ep = _fused_chains.begin(); ep != _fused_chains.end(); ++ep)
+	if (*ep) {
+	    if (ep != _fused_chains.begin() && ep[-1])
+		sa << " -> ";
+	    sa << (*ep)->name();
+	} else
+	    sa << '\n';
+    return sa.take_string();
+}
+#endif
+
+#if HAVE_DIRECT_PORT_TRANSFER
+/** @brief Point push ports at specialized push functions.
+ *
+ * Each push port into an element whose class registered a function with
+ * Element::add_direct_push() calls that function, rather than the
+ * element's virtual push().  Fused ports still run their chains. */
+void
+Router::set_direct_pushes()
+{
+    for (int i = 0; i < nelements(); ++i)
+	for (int o = 0; o < _elements[i]->noutputs(); ++o) {
+	    Element::Port &port = _elements[i]->_ports[1][o];
+	    if (port.active())
+		port._direct = Element::find_direct_push(port.element()->class_name());
+	}
 }
+#endif
 
 int
 Router::visit_base(bool forward, Element *first_element, int first_port,
@@ -871,6 +1182,41 @@ Router::visit_base(bool forward, Element *first_element, int first_port,
     Vector<Port> next_sources;
     int distance = 1;
 
+    if (_have_flow_index) {
+	while (sources.size()) {
+	    next_sources.clear();
+
+	    for (Port *sp = sources.begin(); sp != sources.end(); ++sp) {
+		int g = gport(forward, *sp);
+		for (int cix = _conn_first[forward][g];
+		     cix < _conn_first[forward][g + 1]; ++cix) {
+		    int ci = (forward ? _conn_output_sorter[cix] : cix);
+		    Port connpt = _conn[ci][!forward];
+		    int conng = gport(!forward, connpt);
+		    if (result_bv[conng])
+			continue;
+		    result_bv[conng] = true;
+		    if (!visitor->visit(_elements[connpt.idx], !forward, connpt.port,
+					_elements[sp->idx], sp->port, distance))
+			continue;
+		    const int *fp = _flow_port[!forward].begin() + _flow_first[!forward][conng];
+		    const int *fend = _flow_port[!forward].begin() + _flow_first[!forward][conng + 1];
+		    if (fp != fend && *fp < 0) {
+			int n = _elements[connpt.idx]->nports(forward);
+			for (int port = 0; port < n; ++port)
+			    next_sources.push_back(Port(connpt.idx, port));
+		    } else
+			for (; fp != fend; ++fp)
+			    next_sources.push_back(Port(connpt.idx, *fp));
+		}
+	    }
+
+	    sources.swap(next_sources);
+	    ++distance;
+	}
+	return 0;
+    }
+
     while (sources.size()) {
 	next_sources.clear();
 
@@ -1011,6 +1357,159 @@ class Router::RouterContextErrh : public ContextErrorHandler { public:
 
 };
 
+int
+Router::configure_element(int i, ErrorHandler *errh)
+{
+    RouterContextErrh cerrh(errh, "While configuring", element(i));
+    assert(!cerrh.nerrors());
+    ArgvecIterator args(_element_configurations[i]);
+    int r = _elements[i]->configure_stream(args, &cerrh);
+    if (r >= 0)
+	return Element::CLEANUP_CONFIGURED;
+    if (!cerrh.nerrors()) {
+	if (r == -ENOMEM)
+	    cerrh.error("out of memory");
+	else
+	    cerrh.error("unspecified error");
+    }
+    return Element::CLEANUP_CONFIGURE_FAILED;
+}
+
+int
+Router::initialize_element(int i, ErrorHandler *errh)
+{
+    RouterContextErrh cerrh(errh, "While initializing", element(i));
+    assert(!cerrh.nerrors());
+    if (_elements[i]->initialize(&cerrh) >= 0)
+	return Element::CLEANUP_INITIALIZED;
+    // don't report 'unspecified error' for ErrorElements:
+    // keep error messages clean
+    if (!cerrh.nerrors() && !_elements[i]->cast("Error"))
+	cerrh.error("unspecified error");
+    return Element::CLEANUP_INITIALIZE_FAILED;
+}
+
+/* Concurrently configured or initialized elements report errors to a
+   ConfigureErrh, which saves the messages.  They are passed on in configure
+   order once every element is done, so the output does not depend on thread
+   timing. */
+class Router::ConfigureErrh : public ErrorHandler { public:
+
+    ConfigureErrh(ErrorHandler *errh)
+	: _errh(errh) {
+    }
+
+    String vformat(const char *fmt, va_list val) {
+	return _errh->vformat(fmt, val);
+    }
+    void *emit(const String &str, void *user_data, bool) {
+	_lines.push_back(str);
+	return user_data;
+    }
+    void account(int level) {
+	ErrorHandler::account(level);
+	_message_ends.push_back(_lines.size());
+	_message_levels.push_back(level);
+    }
+
+    void flush() {
+	int l = 0;
+	for (int m = 0; m < _message_ends.size(); ++m) {
+	    void *user_data = 0;
+	    for (; l < _message_ends[m]; ++l)
+		user_data = _errh->emit(_lines[l], user_data, l + 1 < _message_ends[m]);
+	    _errh->account(_message_levels[m]);
+	}
+    }
+
+  private:
+
+    ErrorHandler *_errh;
+    Vector<String> _lines;
+    Vector<int> _message_ends;
+    Vector<int> _message_levels;
+
+};
+
+struct Router::ConcurrentConfigure {
+    Router *router;
+    const Vector<int> *eindexes;
+    bool initialize;
+    Vector<int> stage;
+    Vector<int> numa_nodes;
+    Vector<ConfigureErrh *> errhs;
+    atomic_uint32_t next;
+
+    void run() {
+	uint32_t n;
+#if CLICK_USERLEVEL
+	int numa_node = -1;
+#endif
+	while ((n = next.fetch_and_add(1)) < (uint32_t) eindexes->size()) {
+	    int i = (*eindexes)[n];
+	    if (!initialize) {
+		stage[n] = router->configure_element(i, errhs[n]);
+		continue;
+	    }
+#if CLICK_USERLEVEL
+	    if (numa_nodes[n] != numa_node)
+		RouterThread::set_preferred_numa_node(numa_node = numa_nodes[n]);
+#endif
+	    stage[n] = router->initialize_element(i, errhs[n]);
+	}
+#if CLICK_USERLEVEL
+	if (numa_node >= 0)
+	    RouterThread::set_preferred_numa_node(-1);
+#endif
+    }
+    static void *run_thread(void *thunk) {
+	static_cast<ConcurrentConfigure *>(thunk)->run();
+	return 0;
+    }
+};
+
+void
+Router::configure_concurrently(const Vector<int> &eindexes, bool initialize,
+			       Vector<int> &element_stage, ErrorHandler *errh)
+{
+    ConcurrentConfigure cc;
+    cc.router = this;
+    cc.eindexes = &eindexes;
+    cc.initialize = initialize;
+    cc.stage.assign(eindexes.size(), initialize ? Element::CLEANUP_INITIALIZE_FAILED : Element::CLEANUP_CONFIGURE_FAILED);
+    for (int n = 0; n < eindexes.size(); ++n) {
+	cc.errhs.push_back(new ConfigureErrh(errh));
+#if CLICK_USERLEVEL
+	// worker threads set their own memory policy, so look up each
+	// element's node here
+	if (initialize)
+	    cc.numa_nodes.push_back(_master->thread(hard_home_thread_id(_elements[eindexes[n]]))->numa_node());
+#endif
+    }
+    cc.next = 0;
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    Vector<pthread_t> threads;
+    for (int t = 1; t < _configure_threads && t < eindexes.size(); ++t) {
+	pthread_t p;
+	if (pthread_create(&p, 0, ConcurrentConfigure::run_thread, &cc) != 0)
+	    break;
+	threads.push_back(p);
+    }
+    cc.run();
+    for (pthread_t *p = threads.begin(); p != threads.end(); ++p)
+	pthread_join(*p, 0);
+#else
+    cc.run();
+#endif
+
+    for (int n = 0; n < eindexes.size(); ++n) {
+	cc.errhs[n]->flush();
+	delete cc.errhs[n];
+	element_stage[eindexes[n]] = cc.stage[n];
+    }
+}
+
 static int
 configure_order_compar(const void *athunk, const void *bthunk, void *copthunk)
 {
@@ -1019,6 +1518,18 @@ configure_order_compar(const void *athunk, const void *bthunk, void *copthunk)
     return configure_order_phase[*a] - configure_order_phase[*b];
 }
 
+#if HAVE_ELEMENT_PROFILE
+static int
+profile_order_compar(const void *athunk, const void *bthunk, void *rthunk)
+{
+    const int* a = (const int*) athunk, *b = (const int*) bthunk;
+    const Router* r = (const Router*) rthunk;
+    click_cycles_t ac = r->element(*a)->profile_cycles(),
+	bc = r->element(*b)->profile_cycles();
+    return (ac > bc ? -1 : ac < bc ? 1 : *a - *b);
+}
+#endif
+
 inline Handler*
 Router::xhandler(int hi) const
 {
@@ -1030,9 +1541,12 @@ Router::initialize_handlers(bool defaults, bool specifics)
 {
     _ehandler_first_by_element.assign(nelements(), -1);
     _ehandler_to_handler.clear();
+    _ehandler_map.clear();
     _ehandler_next.clear();
+    ++handler_generation_counter;
 
     _handler_first_by_name.clear();
+    _stats.clear();
 
     for (int i = 0; i < _nhandlers_bufs; i += HANDLER_BUFSIZ)
 	delete[] _handler_bufs[i / HANDLER_BUFSIZ];
@@ -1055,6 +1569,12 @@ Router::initialize(ErrorHandler *errh)
 	return errh->error("second attempt to initialize router");
     _state = ROUTER_PRECONFIGURE;
 
+#if HAVE_STRING_ARENA
+    // Most Strings made while configuring are short and live as long as the
+    // router; take them from the router's arena.
+    String::ArenaScope string_arena_scope(*_string_arena);
+#endif
+
     // initialize handlers to empty
     initialize_handlers(false, false);
 
@@ -1070,8 +1590,8 @@ Router::initialize(ErrorHandler *errh)
 
     // set up configuration order
     _element_configure_order.assign(nelements(), 0);
+    Vector<int> configure_phase(nelements(), 0);
     if (_element_configure_order.size()) {
-	Vector<int> configure_phase(nelements(), 0);
 	for (int i = 0; i < _elements.size(); i++) {
 	    configure_phase[i] = _elements[i]->configure_phase();
 	    _element_configure_order[i] = i;
@@ -1102,31 +1622,31 @@ Router::initialize(ErrorHandler *errh)
 
     // Configure all elements in configure order. Remember the ones that failed
     if (all_ok) {
-	Vector<String> conf;
 	// Set the random seed to a "truly random" value by default.
 	click_random_srandom();
+	Vector<int> concurrent;
 	for (int ord = 0; ord < _elements.size(); ord++) {
-	    int i = _element_configure_order[ord], r;
+	    int i = _element_configure_order[ord];
+	    // Elements flagged C run together, after the rest of their phase.
+	    if (_configure_threads > 1 && _elements[i]->flag_value('C') > 0)
+		concurrent.push_back(i);
+	    else {
 #if CLICK_DMALLOC
-	    sprintf(dmalloc_buf, "c%d  ", i);
-	    CLICK_DMALLOC_REG(dmalloc_buf);
+		sprintf(dmalloc_buf, "c%d  ", i);
+		CLICK_DMALLOC_REG(dmalloc_buf);
 #endif
-	    RouterContextErrh cerrh(errh, "While configuring", element(i));
-	    assert(!cerrh.nerrors());
-	    conf.clear();
-	    cp_argvec(_element_configurations[i], conf);
-	    if ((r = _elements[i]->configure(conf, &cerrh)) < 0) {
-		element_stage[i] = Element::CLEANUP_CONFIGURE_FAILED;
-		all_ok = false;
-		if (!cerrh.nerrors()) {
-		    if (r == -ENOMEM)
-			cerrh.error("out of memory");
-		    else
-			cerrh.error("unspecified error");
-		}
-	    } else
-		element_stage[i] = Element::CLEANUP_CONFIGURED;
+		element_stage[i] = configure_element(i, errh);
+	    }
+	    if (concurrent.size()
+		&& (ord + 1 == _elements.size()
+		    || configure_phase[_element_configure_order[ord + 1]] != configure_phase[i])) {
+		configure_concurrently(concurrent, false, element_stage, errh);
+		concurrent.clear();
+	    }
 	}
+	for (int i = 0; i < _elements.size(); i++)
+	    if (element_stage[i] == Element::CLEANUP_CONFIGURE_FAILED)
+		all_ok = false;
     }
 
 #if CLICK_DMALLOC
@@ -1136,27 +1656,52 @@ Router::initialize(ErrorHandler *errh)
     // Initialize elements if OK so far.
     if (all_ok) {
 	_state = ROUTER_PREINITIALIZE;
+	build_flow_index();
+	analyze_headroom();
+	analyze_timestamps();
+	analyze_alignment();
 	initialize_handlers(true, true);
+#if CLICK_USERLEVEL
+	int numa_node = -1;
+#endif
+	Vector<int> concurrent;
 	for (int ord = 0; all_ok && ord < _elements.size(); ord++) {
 	    int i = _element_configure_order[ord];
 	    assert(element_stage[i] == Element::CLEANUP_CONFIGURED);
+	    // Elements flagged I run together, after the rest of their phase.
+	    if (_configure_threads > 1 && _elements[i]->flag_value('I') > 0)
+		concurrent.push_back(i);
+	    else {
+#if CLICK_USERLEVEL
+		// Place the memory an element allocates and touches while
+		// initializing, such as queue rings and hash tables, on its
+		// home thread's NUMA node.
+		int node = _master->thread(hard_home_thread_id(_elements[i]))->numa_node();
+		if (node != numa_node)
+		    RouterThread::set_preferred_numa_node(numa_node = node);
+#endif
 #if CLICK_DMALLOC
-	    sprintf(dmalloc_buf, "i%d  ", i);
-	    CLICK_DMALLOC_REG(dmalloc_buf);
+		sprintf(dmalloc_buf, "i%d  ", i);
+		CLICK_DMALLOC_REG(dmalloc_buf);
 #endif
-	    RouterContextErrh cerrh(errh, "While initializing", element(i));
-	    assert(!cerrh.nerrors());
-	    if (_elements[i]->initialize(&cerrh) >= 0)
-		element_stage[i] = Element::CLEANUP_INITIALIZED;
-	    else {
-		// don't report 'unspecified error' for ErrorElements:
-		// keep error messages clean
-		if (!cerrh.nerrors() && !_elements[i]->cast("Error"))
-		    cerrh.error("unspecified error");
-		element_stage[i] = Element::CLEANUP_INITIALIZE_FAILED;
-		all_ok = false;
+		element_stage[i] = initialize_element(i, errh);
+		if (element_stage[i] == Element::CLEANUP_INITIALIZE_FAILED)
+		    all_ok = false;
+	    }
+	    if (concurrent.size()
+		&& (!all_ok || ord + 1 == _elements.size()
+		    || configure_phase[_element_configure_order[ord + 1]] != configure_phase[i])) {
+		configure_concurrently(concurrent, true, element_stage, errh);
+		for (int *ip = concurrent.begin(); ip != concurrent.end(); ++ip)
+		    if (element_stage[*ip] == Element::CLEANUP_INITIALIZE_FAILED)
+			all_ok = false;
+		concurrent.clear();
 	    }
 	}
+#if CLICK_USERLEVEL
+	if (numa_node >= 0)
+	    RouterThread::set_preferred_numa_node(-1);
+#endif
     }
 
 #if CLICK_DMALLOC
@@ -1174,6 +1719,14 @@ Router::initialize(ErrorHandler *errh)
 		x = hard_home_thread_id(i ? _elements[i - 1] : _root_element);
 	}
 
+#if HAVE_PUSH_FUSION
+	if (_push_fusion)
+	    fuse_push_chains();
+#endif
+#if HAVE_DIRECT_PORT_TRANSFER
+	set_direct_pushes();
+#endif
+
 	_state = ROUTER_LIVE;
 #ifdef CLICK_NAMEDB_CHECK
 	NameInfo::check(_root_element, errh);
@@ -1241,6 +1794,95 @@ Router::set_hotswap_router(Router *r)
 	_hotswap_router->use();
 }
 
+/** @brief Reconfigure this live router in place to match @a r.
+ *  @param r new router, not yet initialized
+ *  @param errh error handler
+ *  @return 1 if this router now matches @a r, 0 if @a r cannot be swapped
+ *  in place, or -1 on error
+ *
+ *  An incremental alternative to set_hotswap_router().  It applies when @a
+ *  r has the same requirements and connections as this router, and its
+ *  elements have the same names and classes as this router's first
+ *  r->nelements() elements.  Any further elements in this router are
+ *  ignored; since connections match, they are unconnected.  Then only
+ *  configuration strings can differ, and each element with a changed
+ *  configuration must support live reconfiguration (see
+ *  Element::can_live_reconfigure()).  In that case the changed elements
+ *  are live-reconfigured, with tasks on all other router threads
+ *  blocked, and every other element keeps running undisturbed: no element
+ *  is re-created, no queue is drained, and no state needs to move.  The router's
+ *  configuration string is set to @a r's.
+ *
+ *  If any live reconfiguration fails, the elements already changed are
+ *  reset to their old configurations and -1 is returned.  If this function
+ *  returns 0, nothing has changed, and the caller should hotswap @a r in
+ *  the usual way.  Either way @a r itself is not modified. */
+int
+Router::hotswap_in_place(const Router *r, ErrorHandler *errh)
+{
+    if (_state != ROUTER_LIVE || r->_state != ROUTER_NEW
+	|| r->nelements() > nelements()
+	|| r->_requirements.size() != _requirements.size()
+	|| r->_conn.size() != _conn.size())
+	return 0;
+    for (int i = 0; i < _requirements.size(); ++i)
+	if (r->_requirements[i] != _requirements[i])
+	    return 0;
+
+    Vector<int> changed;
+    for (int i = 0; i < r->nelements(); ++i) {
+	if (r->_element_names[i] != _element_names[i]
+	    || strcmp(r->_elements[i]->class_name(), _elements[i]->class_name()) != 0)
+	    return 0;
+	if (r->_element_configurations[i] != _element_configurations[i]) {
+	    if (!_elements[i]->can_live_reconfigure()
+		|| !handler(_elements[i], "config"))
+		return 0;
+	    changed.push_back(i);
+	}
+    }
+
+    Vector<Connection> conn(_conn), rconn(r->_conn);
+    click_qsort(conn.begin(), conn.size());
+    click_qsort(rconn.begin(), rconn.size());
+    for (int i = 0; i < conn.size(); ++i)
+	if (!(conn[i] == rconn[i]))
+	    return 0;
+
+    // The caller is usually a handler running on one of the router
+    // threads, so block tasks on the others only.
+    Vector<RouterThread *> blocked;
+    for (int t = 0; t < _master->nthreads(); ++t) {
+	RouterThread *thread = _master->thread(t);
+	if (!thread->current_thread_is_running()) {
+	    thread->block_tasks(false);
+	    blocked.push_back(thread);
+	}
+    }
+
+    Vector<String> old_conf;
+    int n;
+    for (n = 0; n < changed.size(); ++n) {
+	Element *e = _elements[changed[n]];
+	old_conf.push_back(_element_configurations[changed[n]]);
+	RouterContextErrh cerrh(errh, "While reconfiguring", e);
+	if (handler(e, "config")->call_write(r->_element_configurations[changed[n]], e, &cerrh) < 0)
+	    break;
+    }
+    bool ok = (n == changed.size());
+    // on error, leave the router as it was
+    while (!ok && --n >= 0)
+	handler(_elements[changed[n]], "config")->call_write(old_conf[n], _elements[changed[n]], ErrorHandler::silent_handler());
+    for (int t = 0; t < blocked.size(); ++t)
+	blocked[t]->unblock_tasks();
+
+    if (!ok)
+	return -1;
+    _configuration = r->_configuration;
+    _have_configuration = r->_have_configuration;
+    return 1;
+}
+
 
 // HANDLERS
 
@@ -1365,23 +2007,17 @@ Handler::unparse_name(Element *e) const
 int
 Router::find_ehandler(int eindex, const String &hname, bool allow_star) const
 {
-    int eh = _ehandler_first_by_element[eindex];
-    int star_h = -1;
-    while (eh >= 0) {
-	int h = _ehandler_to_handler[eh];
-	const String &hn = xhandler(h)->name();
-	if (hn == hname)
-	    return eh;
-	else if (hn.length() == 1 && hn[0] == '*')
-	    star_h = h;
-	eh = _ehandler_next[eh];
-    }
-    if (allow_star && star_h >= 0 && xhandler(star_h)->writable()) {
-	// BEWARE: hname might be a fake string pointing to mutable data, so
-	// make a copy of the string before it might escape.
-	String real_hname(hname.data(), hname.length());
-	if (xhandler(star_h)->call_write(real_hname, element(eindex), ErrorHandler::default_handler()) >= 0)
-	    eh = find_ehandler(eindex, real_hname, false);
+    int eh = _ehandler_map.get(Pair<int, String>(eindex, hname));
+    if (eh < 0 && allow_star) {
+	int star_eh = _ehandler_map.get(Pair<int, String>(eindex, String::make_stable("*", 1)));
+	Handler *star_h = (star_eh >= 0 ? xhandler(_ehandler_to_handler[star_eh]) : 0);
+	if (star_h && star_h->writable()) {
+	    // BEWARE: hname might be a fake string pointing to mutable data, so
+	    // make a copy of the string before it might escape.
+	    String real_hname(hname.data(), hname.length());
+	    if (star_h->call_write(real_hname, element(eindex), ErrorHandler::default_handler()) >= 0)
+		eh = find_ehandler(eindex, real_hname, false);
+	}
     }
     return eh;
 }
@@ -1490,7 +2126,9 @@ Router::store_local_handler(int eindex, Handler &to_store)
 	_ehandler_to_handler.push_back(stored_h);
 	_ehandler_next.push_back(_ehandler_first_by_element[eindex]);
 	_ehandler_first_by_element[eindex] = new_eh;
+	_ehandler_map.set(Pair<int, String>(eindex, xhandler(stored_h)->_name), new_eh);
     }
+    ++handler_generation_counter;
 
     // increment use count
     xhandler(stored_h)->_use_count++;
@@ -1506,6 +2144,7 @@ Router::store_local_handler(int eindex, Handler &to_store)
 void
 Router::store_global_handler(Handler &h)
 {
+    ++handler_generation_counter;
     for (int i = 0; i < nglobalh; i++)
 	if (globalh[i]._name == h._name) {
 	    h.combine(globalh[i]);
@@ -1629,6 +2268,18 @@ Router::hindex(const Element *e, const String &hname)
     return -1;
 }
 
+/** @brief Return a number that changes whenever any handler changes.
+ *
+ * Handler pointers and indexes remain valid until the handlers they name
+ * change.  Callers that cache them, such as ControlSocket, can compare
+ * handler_generation() with the value they saw when caching, and resolve
+ * handlers again if it has changed. */
+unsigned
+Router::handler_generation()
+{
+    return handler_generation_counter;
+}
+
 /** @brief Return the handler indexes for element @a e's handlers.
  * @param e element, if any
  * @param result collector for handler indexes
@@ -1805,6 +2456,60 @@ Router::set_handler_flags(const Element *e, const String &hname,
 }
 
 
+// STATISTICS
+
+/** @brief Register statistic @a e.@a name.
+ * @param e element
+ * @param name statistic name
+ * @param type STAT_UINT32, STAT_UINT64, STAT_ATOMIC_UINT32, or STAT_CALLBACK
+ * @param data pointer to the counter, or user data for @a callback
+ * @param callback value function, for STAT_CALLBACK
+ *
+ * The new statistic's id is the old value of nstats().  Elements should
+ * call Element::add_stat() instead. */
+void
+Router::add_stat(const Element *e, const char *name, int type,
+		 const void *data, StatCallback callback)
+{
+    Stat s;
+    s.eindex = e->eindex();
+    s.type = type;
+    s.name = name;
+    s.data = data;
+    s.callback = callback;
+    _stats.push_back(s);
+}
+
+/** @brief Return the name of statistic @a id, such as "c.count". */
+String
+Router::stat_name(int id) const
+{
+    const Stat &s = _stats[id];
+    return ename(s.eindex) + "." + s.name;
+}
+
+/** @brief Return the current value of statistic @a id.
+ *
+ * Each value is read with a single load when the counter's width allows, so
+ * it is never torn on 64-bit platforms, but values read one after another
+ * do not form an atomic snapshot. */
+uint64_t
+Router::stat_value(int id) const
+{
+    const Stat &s = _stats[id];
+    switch (s.type) {
+    case STAT_UINT32:
+	return *static_cast<const volatile uint32_t *>(s.data);
+    case STAT_UINT64:
+	return *static_cast<const volatile uint64_t *>(s.data);
+    case STAT_ATOMIC_UINT32:
+	return static_cast<const atomic_uint32_t *>(s.data)->value();
+    default:
+	return s.callback(element(s.eindex), const_cast<void *>(s.data));
+    }
+}
+
+
 // ATTACHMENTS
 
 void*
@@ -1841,6 +2546,23 @@ Router::set_attachment(const String &name, void *value)
     return 0;
 }
 
+/** @brief Allocate @a size bytes that live as long as the router.
+ * @return the memory, aligned to 16 bytes, or null if out of memory
+ *
+ * Memory comes from a per-router Arena and is freed in bulk, without running
+ * destructors, after the router's elements are deleted.  It cannot be freed
+ * earlier.  Elements can use it for many small objects that are kept until
+ * the router dies, such as route table nodes, making both allocation and
+ * router teardown cheaper.  This function may be called from any thread. */
+void *
+Router::arena_allocate(size_t size)
+{
+    _arena_lock.acquire();
+    void *p = _arena->allocate(size);
+    _arena_lock.release();
+    return p;
+}
+
 ErrorHandler *
 Router::chatter_channel(const String &name) const
 {
@@ -1909,6 +2631,12 @@ ThreadSched::initial_home_thread_id(const Element *)
     return 0;
 }
 
+bool
+ThreadSched::initial_task_stealable(const Element *)
+{
+    return true;
+}
+
 /** @cond never */
 /** @brief  Create (if necessary) and return the NameInfo object for this router.
  *
@@ -2040,6 +2768,160 @@ Router::unparse(StringAccum &sa, const String &indent) const
     unparse_connections(sa, indent);
 }
 
+#if CLICK_USERLEVEL
+static const char cache_magic[] = "click-cache 1\n";
+
+static void
+cache_put(StringAccum &sa, uint32_t x)
+{
+    sa.append(reinterpret_cast<const char *>(&x), sizeof(x));
+}
+
+static void
+cache_put(StringAccum &sa, const String &str)
+{
+    cache_put(sa, (uint32_t) str.length());
+    sa << str;
+}
+
+namespace {
+struct CacheReader {
+    const String &_str;
+    int _pos;
+    bool _ok;
+    CacheReader(const String &str, int pos)
+	: _str(str), _pos(pos), _ok(true) {
+    }
+    uint32_t get() {
+	uint32_t x = 0;
+	if (_ok && _str.length() - _pos >= (int) sizeof(x)) {
+	    memcpy(&x, _str.data() + _pos, sizeof(x));
+	    _pos += sizeof(x);
+	} else
+	    _ok = false;
+	return x;
+    }
+    String get_string() {
+	uint32_t len = get();
+	if (!_ok || len > (uint32_t) (_str.length() - _pos)) {
+	    _ok = false;
+	    return String();
+	}
+	_pos += len;
+	return _str.substring(_pos - len, len);
+    }
+};
+}
+
+/** @brief Unparse this router's flattened configuration into @a sa in
+ * binary form.
+ *
+ * The result records the requirements, elements, and connections added to
+ * this router, and can be read back by parse_cache().  It is not portable
+ * between machines or Click versions.  Call this function before
+ * initialize(), which may change the connections. */
+void
+Router::unparse_cache(StringAccum &sa) const
+{
+    sa << cache_magic;
+    cache_put(sa, _requirements.size() / 2);
+    for (const String *it = _requirements.begin(); it != _requirements.end(); ++it)
+	cache_put(sa, *it);
+    cache_put(sa, _elements.size());
+    for (int i = 0; i < _elements.size(); ++i) {
+	unsigned lineno;
+	const element_landmark_t &lm = element_landmark(i, lineno);
+	cache_put(sa, String(_elements[i]->class_name()));
+	cache_put(sa, _element_names[i]);
+	cache_put(sa, _element_configurations[i]);
+	cache_put(sa, lm.filename);
+	cache_put(sa, lineno);
+    }
+    cache_put(sa, _conn.size());
+    for (const Connection *cp = _conn.begin(); cp != _conn.end(); ++cp) {
+	cache_put(sa, (*cp)[1].idx);
+	cache_put(sa, (*cp)[1].port);
+	cache_put(sa, (*cp)[0].idx);
+	cache_put(sa, (*cp)[0].port);
+    }
+}
+
+/** @brief Add the flattened configuration in @a cache to this router.
+ * @param cache result of a previous unparse_cache()
+ * @param lexer lexer used to create elements
+ * @param lextra lexer extra called for each requirement, or null
+ * @param errh error handler
+ * @return 0 on success, -1 if @a cache is malformed or names an element
+ * class @a lexer does not know
+ *
+ * This function skips lexing, compound element expansion, and tunnel
+ * resolution for a configuration that was lexed before.  The router must
+ * be new and empty.  Requirements are added, and passed to @a lextra,
+ * before any element is created, so that cached configurations can load
+ * packages.  On failure the router may hold some elements; the caller
+ * should delete it and lex the original configuration instead. */
+int
+Router::parse_cache(const String &cache, Lexer *lexer, LexerExtra *lextra,
+		    ErrorHandler *errh)
+{
+    int magic_len = sizeof(cache_magic) - 1;
+    if (_state != ROUTER_NEW || _elements.size()
+	|| cache.length() < magic_len
+	|| memcmp(cache.data(), cache_magic, magic_len) != 0)
+	return -1;
+
+    // validate everything before acting on the cache
+    CacheReader r(cache, magic_len);
+    Vector<String> requirements;
+    for (uint32_t n = r.get(); r._ok && n; --n) {
+	requirements.push_back(r.get_string());
+	requirements.push_back(r.get_string());
+    }
+    int elements_pos = r._pos;
+    uint32_t nelements = r.get();
+    for (uint32_t n = nelements; r._ok && n; --n) {
+	for (int j = 0; j < 4; ++j)
+	    (void) r.get_string();
+	(void) r.get();
+    }
+    for (uint32_t n = r.get(); r._ok && n; --n)
+	for (int j = 0; j < 4; ++j)
+	    if (r.get() >= (j & 1 ? 0x7FFFFFFFU : nelements))
+		r._ok = false;
+    if (!r._ok || r._pos != cache.length())
+	return -1;
+
+    for (int i = 0; i < requirements.size(); i += 2) {
+	if (lextra)
+	    lextra->require(requirements[i], requirements[i + 1], errh);
+	add_requirement(requirements[i], requirements[i + 1]);
+    }
+
+    r._pos = elements_pos;
+    for (uint32_t n = r.get(); n; --n) {
+	String class_name = r.get_string();
+	String name = r.get_string();
+	String conf = r.get_string();
+	String filename = r.get_string();
+	unsigned lineno = r.get();
+	Element *e = lexer->create_element(class_name);
+	if (e && class_name != e->class_name()) {
+	    delete e;
+	    e = 0;
+	}
+	if (!e)
+	    return -1;
+	add_element(e, name, conf, filename, lineno);
+    }
+    for (uint32_t n = r.get(); n; --n) {
+	int from_idx = r.get(), from_port = r.get();
+	int to_idx = r.get(), to_port = r.get();
+	add_connection(from_idx, from_port, to_idx, to_port);
+    }
+    return 0;
+}
+#endif
+
 /** @brief Return a string representing @a e's ports.
  * @param e element
  *
@@ -2151,7 +3033,10 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES, GH_PACKET_POOL,
+       GH_PACKET_LAYOUT, GH_PACKET_EXPENSIVE, GH_PROFILE, GH_LOCK_CONTENTION,
+       GH_FUSED_CHAINS, GH_OPTIMIZATIONS, GH_STATS, GH_MEMORY,
+       GH_MEMORY_ELEMENTS };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2160,6 +3045,16 @@ struct stats_info {
 };
 #endif
 
+static int
+memory_usage_compar(const void *a, const void *b, void *)
+{
+    const Pair<size_t, int> *pa = static_cast<const Pair<size_t, int> *>(a);
+    const Pair<size_t, int> *pb = static_cast<const Pair<size_t, int> *>(b);
+    if (pa->first != pb->first)
+	return pa->first > pb->first ? -1 : 1;
+    return pa->second - pb->second;
+}
+
 String
 Router::router_read_handler(Element *e, void *thunk)
 {
@@ -2194,6 +3089,37 @@ Router::router_read_handler(Element *e, void *thunk)
 		sa << r->_requirements[i] << "\n";
 	break;
 
+      case GH_STATS:
+	if (r)
+	    for (int i = 0; i < r->nstats(); i++)
+		sa << i << ' ' << r->stat_name(i) << ' ' << r->stat_value(i) << '\n';
+	break;
+
+      case GH_MEMORY: {
+	  uint64_t total = 0;
+	  if (r)
+	      for (int i = 0; i < r->nelements(); i++)
+		  total += r->_elements[i]->memory_usage();
+#if HAVE_CLICK_PACKET_POOL
+	  total += Packet::pool_memory();
+#endif
+	  return String(total);
+      }
+
+      case GH_MEMORY_ELEMENTS:
+	if (r) {
+	    Vector<Pair<size_t, int> > usage;
+	    for (int i = 0; i < r->nelements(); i++)
+		if (size_t m = r->_elements[i]->memory_usage())
+		    usage.push_back(make_pair(m, i));
+	    click_qsort(usage.begin(), usage.size(), sizeof(usage[0]),
+			memory_usage_compar);
+	    for (int i = 0; i < usage.size(); i++)
+		sa << r->_element_names[usage[i].second] << ' '
+		   << usage[i].first << '\n';
+	}
+	break;
+
       case GH_DRIVER:
 #if CLICK_NS
 	return String::make_stable("ns", 2);
@@ -2245,6 +3171,88 @@ Router::router_read_handler(Element *e, void *thunk)
 	break;
 #endif
 
+#if HAVE_CLICK_PACKET_POOL
+    case GH_PACKET_POOL:
+	return Packet::pool_statistics();
+#endif
+
+#if !CLICK_LINUXMODULE
+    case GH_PACKET_LAYOUT:
+	return Packet::layout_report();
+#endif
+
+    case GH_PACKET_EXPENSIVE:
+	return Packet::expensive_statistics();
+
+#if HAVE_ELEMENT_PROFILE
+    case GH_PROFILE: {
+	if (!r)
+	    break;
+	Vector<int> order;
+	click_cycles_t total = 0;
+	for (int ei = 0; ei < r->nelements(); ++ei)
+	    if (r->element(ei)->profile_calls()) {
+		order.push_back(ei);
+		total += r->element(ei)->profile_cycles();
+	    }
+	if (order.size())
+	    click_qsort(order.begin(), order.size(), sizeof(int), profile_order_compar, r);
+	const char *counter = Element::profile_counter_name();
+	sa << "# " << (Element::profiling() ? "profiling" : "not profiling")
+	   << ", " << total << " cycles\n"
+	   << "#       cycles    pct        calls      packets  cyc/pkt  ";
+	if (counter)
+	    sa.snprintf(32, "%12s  ", counter);
+	sa << "element\n";
+	for (int *it = order.begin(); it != order.end(); ++it) {
+	    Element *e = r->element(*it);
+	    uint64_t packets = e->profile_packets();
+	    sa.snprintf(80, "%14llu %5.1f%% %12llu %12llu %8llu  ",
+			(unsigned long long) e->profile_cycles(),
+			total ? 100. * e->profile_cycles() / total : 0.,
+			(unsigned long long) e->profile_calls(),
+			(unsigned long long) packets,
+			(unsigned long long) (packets ? e->profile_cycles() / packets : 0));
+	    if (counter)
+		sa.snprintf(32, "%12llu  ", (unsigned long long) e->profile_events());
+	    sa << e->name() << " :: " << e->class_name() << '\n';
+	}
+	break;
+    }
+#endif
+
+#if HAVE_MULTITHREAD
+    case GH_LOCK_CONTENTION: {
+	Master *m = r ? r->master() : 0;
+	if (!m)
+	    break;
+	sa << "master_lock " << m->master_lock_contention()
+	   << " acquired " << m->master_lock_acquisitions()
+	   << " hold_cycles " << m->master_lock_hold_cycles()
+	   << " max_hold_cycles " << m->master_lock_max_hold_cycles() << '\n';
+	for (int tid = 0; tid < m->nthreads(); ++tid) {
+	    RouterThread *t = m->thread(tid);
+	    sa << "thread " << tid
+	       << " task_lock " << t->task_lock_contention()
+	       << " driver_lock " << t->driver_lock_contention()
+	       << " pending_wakeups " << t->pending_wakeups() << '\n';
+	}
+	break;
+    }
+#endif
+
+    case GH_OPTIMIZATIONS:
+	if (r)
+	    return r->optimizations();
+	break;
+
+#if HAVE_PUSH_FUSION
+    case GH_FUSED_CHAINS:
+	if (r)
+	    return r->fused_chains();
+	break;
+#endif
+
 #if CLICK_DEBUG_MASTER || CLICK_DEBUG_SCHEDULING
     case GH_SCHEDULING_PROFILE:
 	if (r)
@@ -2361,6 +3369,24 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
 	for (int i = 0; i < (r ? r->nelements() : 0); i++)
 	    r->_elements[i]->reset_cycles();
 	break;
+#endif
+#if HAVE_ELEMENT_PROFILE
+    case GH_PROFILE: {
+	// "reset", or turning profiling on, starts the counts over.
+	String str = cp_uncomment(s);
+	bool on = Element::profiling(), reset;
+	if (str == "reset")
+	    reset = true;
+	else if (BoolArg().parse(str, on))
+	    reset = on && !Element::profiling();
+	else
+	    return errh->error("syntax error");
+	if (reset)
+	    for (int i = 0; i < r->nelements(); i++)
+		r->_elements[i]->reset_profile();
+	Element::set_profiling(on);
+	break;
+    }
 #endif
     default:
 	break;
@@ -2380,6 +3406,9 @@ Router::static_initialize()
 	add_read_handler(0, "requirements", router_read_handler, (void *)GH_REQUIREMENTS);
 	add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
 	add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
+	add_read_handler(0, "stats", router_read_handler, (void *)GH_STATS);
+	add_read_handler(0, "memory", router_read_handler, (void *)GH_MEMORY);
+	add_read_handler(0, "memory_elements", router_read_handler, (void *)GH_MEMORY_ELEMENTS);
 	add_write_handler(0, "stop", router_write_handler, (void *)GH_STOP);
 #if CLICK_STATS >= 1
 	add_read_handler(0, "active_ports", router_read_handler, (void *)GH_ACTIVE_PORTS);
@@ -2391,6 +3420,24 @@ Router::static_initialize()
 	add_read_handler(0, "string_profile_long", router_read_handler, (void *) GH_STRING_PROFILE_LONG);
 # endif
 #endif
+#if HAVE_CLICK_PACKET_POOL
+	add_read_handler(0, "packet_pool", router_read_handler, (void *) GH_PACKET_POOL);
+#endif
+#if !CLICK_LINUXMODULE
+	add_read_handler(0, "packet_layout", router_read_handler, (void *) GH_PACKET_LAYOUT);
+#endif
+	add_read_handler(0, "packet_expensive", router_read_handler, (void *) GH_PACKET_EXPENSIVE);
+#if HAVE_ELEMENT_PROFILE
+	add_read_handler(0, "profile", router_read_handler, (void *) GH_PROFILE);
+	add_write_handler(0, "profile", router_write_handler, (void *) GH_PROFILE);
+#endif
+#if HAVE_MULTITHREAD
+	add_read_handler(0, "lock_contention", router_read_handler, (void *) GH_LOCK_CONTENTION);
+#endif
+	add_read_handler(0, "optimizations", router_read_handler, (void *) GH_OPTIMIZATIONS);
+#if HAVE_PUSH_FUSION
+	add_read_handler(0, "fused_chains", router_read_handler, (void *) GH_FUSED_CHAINS);
+#endif
 #if CLICK_DEBUG_MASTER || CLICK_DEBUG_SCHEDULING
 	add_read_handler(0, "scheduling_profile", router_read_handler, (void *) GH_SCHEDULING_PROFILE);
 #endif
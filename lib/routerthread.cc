@@ -39,6 +39,12 @@ CLICK_CXX_UNPROTECT
 # include <click/cxxunprotect.h>
 #elif CLICK_USERLEVEL
 # include <fcntl.h>
+# include <sched.h>
+# include <dirent.h>
+# include <unistd.h>
+# if defined(__linux__)
+#  include <sys/syscall.h>
+# endif
 #endif
 CLICK_DECLS
 
@@ -66,8 +72,7 @@ static unsigned long greedy_schedule_jiffies;
  */
 
 RouterThread::RouterThread(Master *m, int id)
-    : _stop_flag(0), _pending_head(0), _pending_tail(&_pending_head),
-      _master(m), _id(id)
+    : _stop_flag(0), _pending_head(0), _master(m), _id(id)
 {
 #if !HAVE_TASK_HEAP
     _prev = _next = this;
@@ -80,6 +85,20 @@ RouterThread::RouterThread(Master *m, int id)
 
     _task_blocker = 0;
     _task_blocker_waiting = 0;
+#if HAVE_MULTITHREAD
+    _pending_wakeups = 0;
+    _task_lock_contention = 0;
+    _driver_lock_contention = 0;
+    _steal_request = 0;
+    _steal_victim = id;
+    _task_steals = 0;
+#endif
+#if CLICK_USERLEVEL
+    _cpu = _numa_node = -1;
+    _idle_poll = _idle_sleeping = false;
+    _idle_spin = _idle_pause = _idle_yield = 0;
+    _empty_runs = _idle_pauses = _idle_yields = _idle_sleeps = 0;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _max_click_share = 80 * Task::MAX_UTILIZATION / 100;
     _min_click_share = Task::MAX_UTILIZATION / 200;
@@ -145,10 +164,15 @@ RouterThread::driver_lock_tasks()
     }
 #endif
 
-    while (_task_blocker.compare_swap(0, (uint32_t) -1) != 0) {
+    if (_task_blocker.compare_swap(0, (uint32_t) -1) != 0) {
+#if HAVE_MULTITHREAD
+	++_driver_lock_contention;
+#endif
+	while (_task_blocker.compare_swap(0, (uint32_t) -1) != 0) {
 #if CLICK_LINUXMODULE
-	schedule();
+	    schedule();
 #endif
+	}
     }
 }
 
@@ -327,8 +351,12 @@ RouterThread::task_reheapify_from(int pos, Task* t)
     task_heap_element *tend = _task_heap.end();
     int npos;
 
+    // The heap is task_heap_arity-ary, indexed like heap.hh's d-ary heaps:
+    // the children of position p > 0 are [p*arity, p*arity + arity), so
+    // each sift-down step compares one run of adjacent elements.
     while (pos > 0
-	   && (npos = (pos-1) >> 1, PASS_GT(tbegin[npos].pass, t->_pass))) {
+	   && (npos = pos / task_heap_arity,
+	       PASS_GT(tbegin[npos].pass, t->_pass))) {
 	tbegin[pos] = tbegin[npos];
 	tbegin[npos].t->_schedpos = pos;
 	pos = npos;
@@ -336,11 +364,15 @@ RouterThread::task_reheapify_from(int pos, Task* t)
 
     while (1) {
 	Task *smallest = t;
-	task_heap_element *tp = tbegin + 2*pos + 1;
-	if (tp < tend && PASS_GE(smallest->_pass, tp[0].pass))
-	    smallest = tp[0].t;
-	if (tp + 1 < tend && PASS_GE(smallest->_pass, tp[1].pass))
-	    smallest = tp[1].t, ++tp;
+	task_heap_element *tsmallest = 0;
+	task_heap_element *tp = tbegin + (pos ? pos * task_heap_arity : 1);
+	task_heap_element *tpend = tbegin + (pos ? pos * task_heap_arity : 0)
+	    + task_heap_arity;
+	if (tpend > tend)
+	    tpend = tend;
+	for (; tp < tpend; ++tp)
+	    if (PASS_GE(smallest->_pass, tp->pass))
+		smallest = tp->t, tsmallest = tp;
 
 	smallest->_schedpos = pos;
 	tbegin[pos].t = smallest;
@@ -349,13 +381,13 @@ RouterThread::task_reheapify_from(int pos, Task* t)
 	if (smallest == t)
 	    return;
 
-	pos = tp - tbegin;
+	pos = tsmallest - tbegin;
     }
 }
 #endif
 
 /* Run at most 'ntasks' tasks. */
-inline void
+inline bool
 RouterThread::run_tasks(int ntasks)
 {
     set_thread_state(S_RUNTASK);
@@ -390,7 +422,7 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_MULTITHREAD
     int runs;
 #endif
-    bool work_done;
+    bool work_done, any_work = false;
 
     for (; ntasks >= 0; --ntasks) {
 	t = task_begin();
@@ -412,6 +444,7 @@ RouterThread::run_tasks(int ntasks)
 
 	t->_status.is_scheduled = false;
 	work_done = t->fire();
+	any_work |= work_done;
 
 #if HAVE_MULTITHREAD
 	if (runs > PROFILE_ELEMENT) {
@@ -441,8 +474,11 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_STRIDE_SCHED
 # if HAVE_TASK_HEAP
 		unsigned p1 = _task_heap.unchecked_at(1).pass;
-		if (_task_heap.size() > 2 && PASS_GT(p1, _task_heap.unchecked_at(2).pass))
-		    p1 = _task_heap.unchecked_at(2).pass;
+		int nchild = _task_heap.size() < task_heap_arity
+		    ? _task_heap.size() : task_heap_arity;
+		for (int i = 2; i < nchild; ++i)
+		    if (PASS_GT(p1, _task_heap.unchecked_at(i).pass))
+			p1 = _task_heap.unchecked_at(i).pass;
 # else
 		unsigned p1 = t->_next->_pass;
 # endif
@@ -480,6 +516,7 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_CLICK, t_before);
 #endif
+    return any_work;
 }
 
 inline void
@@ -496,6 +533,7 @@ RouterThread::run_os()
 
 #if CLICK_USERLEVEL
     select_set().run_selects(this);
+    _idle_sleeping = false;
 #elif CLICK_LINUXMODULE		/* Linux kernel module */
     if (_greedy) {
 	if (time_after(jiffies, greedy_schedule_jiffies + 5 * CLICK_HZ)) {
@@ -544,6 +582,151 @@ RouterThread::run_os()
     driver_lock_tasks();
 }
 
+#if CLICK_USERLEVEL
+void
+RouterThread::set_idle_poll(unsigned spin, unsigned pause, unsigned yield,
+			    const Timestamp &sleep)
+{
+    _idle_spin = spin;
+    _idle_pause = pause;
+    _idle_yield = yield;
+    _idle_sleep = sleep > Timestamp() ? sleep : Timestamp();
+    _idle_poll = true;
+}
+
+void
+RouterThread::clear_idle_poll()
+{
+    _idle_poll = false;
+}
+
+void
+RouterThread::set_cpu(int cpu)
+{
+    _cpu = cpu;
+    _numa_node = cpu >= 0 ? cpu_numa_node(cpu) : -1;
+}
+
+int
+RouterThread::cpu_numa_node(int cpu)
+{
+    // Linux lists a CPU's node as a "nodeN" link in its sysfs directory.
+    char buf[64];
+    sprintf(buf, "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(buf);
+    if (!dir)
+	return -1;
+    int node = -1;
+    while (struct dirent *d = readdir(dir))
+	if (strncmp(d->d_name, "node", 4) == 0 && isdigit((unsigned char) d->d_name[4])) {
+	    node = atoi(d->d_name + 4);
+	    break;
+	}
+    closedir(dir);
+    return node;
+}
+
+void
+RouterThread::set_preferred_numa_node(int node)
+{
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    enum { MPOL_DEFAULT_ = 0, MPOL_PREFERRED_ = 1, LONG_BITS = 8 * sizeof(unsigned long) };
+    unsigned long mask[256 / LONG_BITS];
+    if (node < 0 || node >= 256)
+	(void) syscall(SYS_set_mempolicy, MPOL_DEFAULT_, (unsigned long *) 0, 0UL);
+    else {
+	memset(mask, 0, sizeof(mask));
+	mask[node / LONG_BITS] = 1UL << (node % LONG_BITS);
+	(void) syscall(SYS_set_mempolicy, MPOL_PREFERRED_, mask, 256UL);
+    }
+#else
+    (void) node;
+#endif
+}
+
+static inline void
+relax_cpu()
+{
+# if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" : : : "memory");
+# else
+    click_compiler_fence();
+# endif
+}
+
+// Backs off after a driver iteration in which scheduled tasks did no work:
+// first spin, then pause, then yield, then let the next select() sleep.
+inline void
+RouterThread::idle_backoff(bool worked)
+{
+    if (worked || !active()) {
+	_empty_runs = 0;
+	return;
+    }
+    unsigned n = _empty_runs;
+    if (n != ~0U)
+	_empty_runs = n + 1;
+    if (n < _idle_spin)
+	return;
+    n -= _idle_spin;
+    if (n < _idle_pause) {
+	++_idle_pauses;
+	relax_cpu();
+	return;
+    }
+    n -= _idle_pause;
+    if (n < _idle_yield || !_idle_sleep) {
+	++_idle_yields;
+	set_thread_state(S_PAUSED);
+	sched_yield();
+	return;
+    }
+    ++_idle_sleeps;
+    _idle_sleeping = true;
+}
+#endif
+
+#if HAVE_MULTITHREAD
+void
+RouterThread::request_steal()
+{
+    // Ask a busy thread to hand us one of its tasks.  Requests rotate among
+    // the other threads so that no one thread is always the victim.  The
+    // victim moves the task with Task::move_thread(), which wakes us up.
+    int n = _master->nthreads();
+    for (int i = 1; i < n; ++i) {
+	_steal_victim = (_steal_victim + 1) % n;
+	RouterThread *victim = _master->thread(_steal_victim);
+	if (victim == this || !victim->active())
+	    continue;
+	victim->_steal_request.compare_swap(0, _id + 1);
+	return;
+    }
+}
+
+void
+RouterThread::donate_task()
+{
+    // must be called with thread's lock acquired
+    int thief = (int) _steal_request.swap(0) - 1;
+
+    // Donate the stealable task that would run last, but only if we have an
+    // other task to run ourselves.
+    int ntasks = 0;
+    Task *donation = 0;
+    for (Task *t = task_begin(); t != task_end(); t = task_next(t))
+	if (t->scheduled() && t->home_thread_id() == _id) {
+	    ++ntasks;
+	    if (t->stealable())
+		donation = t;
+	}
+    if (ntasks >= 2 && donation && thief >= 0 && thief != _id) {
+	donation->move_thread(thief);
+	++_task_steals;
+    }
+}
+#endif
+
 void
 RouterThread::process_pending()
 {
@@ -552,17 +735,30 @@ RouterThread::process_pending()
     // claim the current pending list
     set_thread_state(RouterThread::S_RUNPENDING);
     SpinlockIRQ::flags_t flags = _pending_lock.acquire();
-    uintptr_t my_pending = _pending_head;
-    _pending_head = 0;
-    _pending_tail = &_pending_head;
+    uintptr_t head;
+    do {
+	head = _pending_head;
+    } while (pending_compare_swap(_pending_head, head, 0) != head);
     _pending_lock.release(flags);
 
+    // reverse it, so tasks are processed in the order they were added
+    uintptr_t my_pending = 1;
+    while (Task *t = Task::pending_to_task(head)) {
+	head = t->_pending_nextptr;
+	t->_pending_nextptr = my_pending;
+	my_pending = reinterpret_cast<uintptr_t>(t);
+    }
+
     // process the list
     while (Task *t = Task::pending_to_task(my_pending)) {
 	my_pending = t->_pending_nextptr;
 	t->_pending_nextptr = 0;
 	click_fence();
-	t->process_pending(this);
+	if (t->_thread == this)
+	    t->process_pending(this);
+	else
+	    // added here just before moving to another thread
+	    t->add_pending();
     }
 }
 
@@ -621,10 +817,24 @@ RouterThread::driver()
 #if HAVE_ADAPTIVE_SCHEDULER
 	    if (PASS_GT(_clients[C_CLICK].pass, _clients[C_KERNEL].pass))
 		break;
+#endif
+#if CLICK_USERLEVEL
+	    if (_idle_poll) {
+		idle_backoff(run_tasks(_tasks_per_iter));
+		break;
+	    }
 #endif
 	    run_tasks(_tasks_per_iter);
 	} while (0);
 
+#if HAVE_MULTITHREAD
+	// balance load by work stealing
+	if (_steal_request.value())
+	    donate_task();
+	else if (!active() && _master->work_stealing())
+	    request_steal();
+#endif
+
 #if CLICK_USERLEVEL
 	// run signals
 	run_signals();
@@ -646,7 +856,11 @@ RouterThread::driver()
 	// run operating system
 	do {
 #if !HAVE_ADAPTIVE_SCHEDULER && !BSD_NETISRSCHED
-	    if (iter % _iters_per_os)
+	    if (iter % _iters_per_os
+# if CLICK_USERLEVEL
+		&& !_idle_sleeping
+# endif
+		)
 		break;
 #elif HAVE_ADAPTIVE_SCHEDULER
 	    if (!PASS_GT(_clients[C_CLICK].pass, _clients[C_KERNEL].pass))
@@ -679,13 +893,10 @@ RouterThread::driver()
 # endif
 #endif
 #if CLICK_NS
-    if (active()) {
-	struct timeval nexttime = (Timestamp::now() + Timestamp::make_usec(1)).timeval();
-	simclick_sim_command(_master->simnode(), SIMCLICK_SCHEDULE, &nexttime);
-    } else if (Timestamp next_expiry = timer_set().timer_expiry_steady()) {
-	struct timeval nexttime = next_expiry.timeval();
-	simclick_sim_command(_master->simnode(), SIMCLICK_SCHEDULE, &nexttime);
-    }
+    if (active())
+	_master->ns_schedule(Timestamp::now() + Timestamp::make_usec(1));
+    else if (Timestamp next_expiry = timer_set().timer_expiry_steady())
+	_master->ns_schedule(next_expiry);
 #endif
 }
 
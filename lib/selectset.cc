@@ -33,10 +33,14 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if HAVE_ALLOW_EPOLL
+# include <sys/epoll.h>
+#endif
 CLICK_DECLS
 
 namespace {
-enum { SELECT_READ = Element::SELECT_READ, SELECT_WRITE = Element::SELECT_WRITE };
+enum { SELECT_READ = Element::SELECT_READ, SELECT_WRITE = Element::SELECT_WRITE,
+       SELECT_EDGE = Element::SELECT_EDGE };
 #if !HAVE_ALLOW_POLL
 enum { POLLIN = Element::SELECT_READ, POLLOUT = Element::SELECT_WRITE };
 #endif
@@ -58,6 +62,12 @@ SelectSet::SelectSet()
 # endif
 #endif
 
+#if HAVE_ALLOW_EPOLL
+    _epoll = epoll_create(256);
+    if (_epoll >= 0)
+	fcntl(_epoll, F_SETFD, FD_CLOEXEC);
+#endif
+
 #if !HAVE_ALLOW_POLL
     FD_ZERO(&_read_select_fd_set);
     FD_ZERO(&_write_select_fd_set);
@@ -85,6 +95,10 @@ SelectSet::~SelectSet()
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0)
 	close(_kqueue);
+#endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	close(_epoll);
 #endif
     if (_wake_pipe[0] >= 0) {
 	close(_wake_pipe[0]);
@@ -126,7 +140,7 @@ SelectSet::kill_router(Router *router)
 }
 
 void
-SelectSet::register_select(int fd, bool add_read, bool add_write)
+SelectSet::register_select(int fd, bool add_read, bool add_write, bool edge)
 {
     // add the pollfd
     if (fd >= _selinfo.size())
@@ -138,12 +152,24 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
 	_pollfds.back().events = 0;
     }
     int pi = _selinfo[fd].pollfd;
+    int old_events = _pollfds[pi].events;
+    bool old_edge = _selinfo[fd].edge;
 
     // add the elements
     if (add_read)
 	_pollfds[pi].events |= POLLIN;
     if (add_write)
 	_pollfds[pi].events |= POLLOUT;
+    if (edge)
+	_selinfo[fd].edge = true;
+
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0
+	&& (_pollfds[pi].events != old_events || _selinfo[fd].edge != old_edge))
+	update_epoll(pi, old_events);
+#else
+    (void) old_events, (void) old_edge;
+#endif
 
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0) {
@@ -199,9 +225,9 @@ SelectSet::add_select(int fd, Element *element, int mask)
 {
     if (fd < 0)
 	return -1;
-    if (mask == 0)
+    if ((mask & (SELECT_READ | SELECT_WRITE)) == 0)
 	return 0;
-    assert(element && (mask & ~(SELECT_READ | SELECT_WRITE)) == 0);
+    assert(element && (mask & ~(SELECT_READ | SELECT_WRITE | SELECT_EDGE)) == 0);
     lock();
 
     // check whether to add readability, writability, or both; it is an error
@@ -222,13 +248,15 @@ SelectSet::add_select(int fd, Element *element, int mask)
 	else if (_selinfo[fd].write != element)
 	    goto unlock_and_return_error;
     }
-    if (!add_read && !add_write) {
+    bool add_edge = (mask & SELECT_EDGE)
+	&& (fd >= _selinfo.size() || !_selinfo[fd].edge);
+    if (!add_read && !add_write && !add_edge) {
 	unlock();
 	return 0;
     }
 
     // add the pollfd
-    register_select(fd, add_read, add_write);
+    register_select(fd, add_read, add_write, add_edge);
 
     // add the elements
     if (add_read)
@@ -252,6 +280,7 @@ SelectSet::remove_pollfd(int pi, int event)
 
     // remove event
     int fd = _pollfds[pi].fd;
+    int old_events = _pollfds[pi].events;
     _pollfds[pi].events &= ~event;
     if (event == POLLIN)
 	_selinfo[fd].read = 0;
@@ -268,6 +297,13 @@ SelectSet::remove_pollfd(int pi, int event)
 	    click_chatter("SelectSet::remove_pollfd(fd %d): kevent: %s", _pollfds[pi].fd, strerror(errno));
     }
 #endif
+#if HAVE_ALLOW_EPOLL
+    // remove event from epoll
+    if (_epoll >= 0 && _pollfds[pi].events != old_events)
+	update_epoll(pi, old_events);
+#else
+    (void) old_events;
+#endif
 #if !HAVE_ALLOW_POLL
     // remove event from select list
     if (fd < FD_SETSIZE) {
@@ -284,6 +320,7 @@ SelectSet::remove_pollfd(int pi, int event)
     _pollfds[pi] = _pollfds.back();
     _pollfds.pop_back();
     _selinfo[fd].pollfd = -1;
+    _selinfo[fd].edge = false;
     if (pi < _pollfds.size())
 	_selinfo[_pollfds[pi].fd].pollfd = pi;
 #if !HAVE_ALLOW_POLL
@@ -302,7 +339,7 @@ SelectSet::remove_select(int fd, Element *element, int mask)
 {
     if (fd < 0)
 	return -1;
-    assert(element && (mask & ~(SELECT_READ | SELECT_WRITE)) == 0);
+    assert(element && (mask & ~(SELECT_READ | SELECT_WRITE | SELECT_EDGE)) == 0);
     lock();
 
     bool remove_read = false, remove_write = false;
@@ -363,9 +400,10 @@ SelectSet::call_selected(int fd, int mask) const
 	if (mask & Element::SELECT_WRITE)
 	    write = es.write;
     }
-    if (read)
+    // skip elements whose router is paused (being initialized or killed)
+    if (read && !read->router()->paused())
 	read->selected(fd, write == read ? mask : Element::SELECT_READ);
-    if (write && write != read)
+    if (write && write != read && !write->router()->paused())
 	write->selected(fd, Element::SELECT_WRITE);
 }
 
@@ -390,7 +428,7 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
     // Decide how long to wait.
     struct timespec wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->select_delay(t);
     if (delay_type == 0)
 	wait.tv_sec = wait.tv_nsec = 0;
     else if (delay_type > 0)
@@ -424,6 +462,82 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
 }
 #endif /* HAVE_ALLOW_KQUEUE */
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::update_epoll(int pi, int old_events)
+{
+    int fd = _pollfds[pi].fd, events = _pollfds[pi].events;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (events & POLLIN ? (uint32_t) EPOLLIN : 0U)
+	| (events & POLLOUT ? (uint32_t) EPOLLOUT : 0U)
+	| (_selinfo[fd].edge ? (uint32_t) EPOLLET : 0U);
+    ev.data.fd = fd;
+
+    int op = (!events ? EPOLL_CTL_DEL : old_events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD);
+    int r = epoll_ctl(_epoll, op, fd, &ev);
+    if (r < 0 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+	// The fd was closed, and so dropped from the epoll set, but the
+	// element never called remove_select().  Register it afresh.
+	op = EPOLL_CTL_ADD;
+	r = epoll_ctl(_epoll, op, fd, &ev);
+    }
+    if (r >= 0)
+	return;
+    if (op == EPOLL_CTL_DEL) {
+	// Closed fds leave the epoll set automatically.
+	if (errno != EBADF && errno != ENOENT)
+	    click_chatter("SelectSet::remove_pollfd(fd %d): epoll_ctl: %s", fd, strerror(errno));
+    } else {
+	// Not all file descriptors are epollable (regular files, for
+	// example).  So if we encounter a problem, fall back to poll() or
+	// select().
+	close(_epoll);
+	_epoll = -1;
+    }
+}
+
+void
+SelectSet::run_selects_epoll(RouterThread *thread)
+{
+# if HAVE_MULTITHREAD
+    click_fence();
+    _select_lock.release();
+# endif
+
+    // Decide how long to wait.
+    int timeout;
+    Timestamp t;
+    int delay_type = thread->select_delay(t);
+    if (delay_type == 0)
+	timeout = 0;
+    else if (delay_type > 0)
+	timeout = (t.sec() >= INT_MAX / 1000 ? INT_MAX - 1000 : t.msecval());
+    else
+	timeout = -1;
+    thread->set_thread_state_for_blocking(delay_type);
+
+    struct epoll_event ev[256];
+    int n = epoll_wait(_epoll, &ev[0], 256, timeout);
+    int was_errno = errno;
+
+    if (post_select(thread, true))
+	return;
+
+    thread->set_thread_state(RouterThread::S_RUNSELECT);
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else if (n > 0)
+	// Each fd appears at most once, so selected() may freely call
+	// add_select() or remove_select().
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; ++p) {
+	    int mask = (p->events & ~EPOLLOUT ? Element::SELECT_READ : 0)
+		+ (p->events & ~EPOLLIN ? Element::SELECT_WRITE : 0);
+	    call_selected(p->data.fd, mask);
+	}
+}
+#endif /* HAVE_ALLOW_EPOLL */
+
 #if HAVE_ALLOW_POLL
 void
 SelectSet::run_selects_poll(RouterThread *thread)
@@ -441,7 +555,7 @@ SelectSet::run_selects_poll(RouterThread *thread)
     // Decide how long to wait.
     int timeout;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->select_delay(t);
     if (delay_type == 0)
 	timeout = 0;
     else if (delay_type > 0)
@@ -497,7 +611,7 @@ SelectSet::run_selects_select(RouterThread *thread)
     // Decide how long to wait.
     struct timeval wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = thread->select_delay(t);
     if (delay_type == 0)
 	timerclear(&wait);
     else if (delay_type > 0)
@@ -559,9 +673,9 @@ SelectSet::run_selects(RouterThread *thread)
     }
 
     // Return early (just run signals) if there are no selectors and there are
-    // tasks to run.  NB there will always be at least one _pollfd (the
-    // _wake_pipe).
-    if (_pollfds.size() < 2 && thread->active()) {
+    // tasks to run, unless the thread's tasks are idle and it should sleep.
+    // NB there will always be at least one _pollfd (the _wake_pipe).
+    if (_pollfds.size() < 2 && thread->active() && !thread->idle_sleeping()) {
 #if HAVE_MULTITHREAD
 	_select_lock.release();
 #endif
@@ -577,6 +691,12 @@ SelectSet::run_selects(RouterThread *thread)
 	    break;
 	}
 #endif
+#if HAVE_ALLOW_EPOLL
+	if (_epoll >= 0) {
+	    run_selects_epoll(thread);
+	    break;
+	}
+#endif
 #if HAVE_ALLOW_POLL
 	run_selects_poll(thread);
 #else
@@ -62,6 +62,20 @@ const char String::oom_data = '\0';
 const char String::bool_data[] = "true\0false";
 const char String::int_data[] = "0\0001\0002\0003\0004\0005\0006\0007\0008\0009";
 
+// Every single-character string, each followed by a null character.
+#define CHAR_DATA_4(c)	(char) (c), 0, (char) ((c) + 1), 0, \
+			(char) ((c) + 2), 0, (char) ((c) + 3), 0
+#define CHAR_DATA_16(c)	CHAR_DATA_4(c), CHAR_DATA_4((c) + 4), \
+			CHAR_DATA_4((c) + 8), CHAR_DATA_4((c) + 12)
+#define CHAR_DATA_64(c)	CHAR_DATA_16(c), CHAR_DATA_16((c) + 16), \
+			CHAR_DATA_16((c) + 32), CHAR_DATA_16((c) + 48)
+const char String::char_data[] = {
+    CHAR_DATA_64(0), CHAR_DATA_64(64), CHAR_DATA_64(128), CHAR_DATA_64(192)
+};
+#undef CHAR_DATA_4
+#undef CHAR_DATA_16
+#undef CHAR_DATA_64
+
 #if HAVE_STRING_PROFILING > 1
 # define MEMO_INITIALIZER_TAIL , 0, 0
 #else
@@ -91,14 +105,26 @@ String::create_memo(char *space, int dirty, int capacity)
 {
     assert(capacity > 0 && capacity >= dirty);
     memo_t *memo;
+    uint32_t arena_offset = 0;
     if (space)
 	memo = reinterpret_cast<memo_t *>(space);
+#if HAVE_STRING_ARENA
+    else if (Arena *arena = Arena::the_current) {
+	if (MEMO_SPACE + capacity > Arena::max_memo_size
+	    || !(memo = arena->allocate(MEMO_SPACE + capacity)))
+	    memo = (memo_t *) CLICK_LALLOC(MEMO_SPACE + capacity);
+	else
+	    arena_offset = reinterpret_cast<char *>(memo)
+		- reinterpret_cast<char *>(arena->_chunk);
+    }
+#endif
     else
 	memo = (memo_t *) CLICK_LALLOC(MEMO_SPACE + capacity);
     if (memo) {
 	memo->capacity = capacity;
 	memo->dirty = dirty;
 	memo->refcount = (space ? 0 : 1);
+	memo->arena_offset = arena_offset;
 #if HAVE_STRING_PROFILING
 	int bucket = profile_memo_size_bucket(dirty, capacity);
 	++memo_sizes[bucket];
@@ -132,6 +158,15 @@ String::delete_memo(memo_t *memo)
     if ((*memo->pprev = memo->next))
 	memo->next->pprev = memo->pprev;
 # endif
+#endif
+#if HAVE_STRING_ARENA
+    if (memo->arena_offset) {
+	arena_chunk_t *chunk = reinterpret_cast<arena_chunk_t *>
+	    (reinterpret_cast<char *>(memo) - memo->arena_offset);
+	if (atomic_uint32_t::dec_and_test(chunk->live))
+	    CLICK_LFREE(chunk, chunk->size);
+	return;
+    }
 #endif
     CLICK_LFREE(memo, MEMO_SPACE + memo->capacity);
 }
@@ -184,6 +219,50 @@ String::profile_report(StringAccum &sa, int examples)
 }
 #endif
 
+#if HAVE_STRING_ARENA
+# if HAVE_MULTITHREAD
+__thread String::Arena *String::Arena::the_current;
+# else
+String::Arena *String::Arena::the_current;
+# endif
+
+String::Arena::Arena(uint32_t chunk_size)
+    : _chunk(0), _pos(0), _chunk_size(chunk_size), _nchunks(0), _nmemos(0)
+{
+    if (_chunk_size < 4 * max_memo_size)
+	_chunk_size = 4 * max_memo_size;
+}
+
+void
+String::Arena::release()
+{
+    if (_chunk && atomic_uint32_t::dec_and_test(_chunk->live))
+	CLICK_LFREE(_chunk, _chunk->size);
+    _chunk = 0;
+}
+
+String::memo_t *
+String::Arena::allocate(uint32_t size)
+{
+    // Keep memos 16-byte aligned, as CLICK_LALLOC would.
+    size = (size + 15) & ~15U;
+    if (!_chunk || _pos + size > _chunk_size) {
+	release();
+	if (!(_chunk = (arena_chunk_t *) CLICK_LALLOC(_chunk_size)))
+	    return 0;
+	_chunk->live = 1;
+	_chunk->size = _chunk_size;
+	_pos = (sizeof(arena_chunk_t) + 15) & ~15U;
+	++_nchunks;
+    }
+    memo_t *memo = reinterpret_cast<memo_t *>(reinterpret_cast<char *>(_chunk) + _pos);
+    _pos += size;
+    ++_nmemos;
+    atomic_uint32_t::inc(_chunk->live);
+    return memo;
+}
+#endif
+
 /** @endcond never */
 
 
@@ -24,6 +24,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/standard/threadsched.hh>
 CLICK_DECLS
 
 /** @file task.hh
@@ -98,8 +99,12 @@ CLICK_DECLS
 //   Furthermore, only _thread itself may change _thread
 //   (except that if _thread is quiescent, anyone may change _thread).
 //   To arrange for _thread to change, set _home_thread_id and add_pending().
-// - _pending_nextptr is protected by _thread->_pending_lock.
-//   But after acquiring this lock, verify that _thread has not changed.
+// - _pending_nextptr goes from 0 to nonzero only by compare-and-swap, in
+//   add_pending_to(), which then pushes the task onto a pending list
+//   without locking.  Removing a task from an unclaimed pending list is
+//   protected by _thread->_pending_lock; after acquiring this lock, verify
+//   that _thread has not changed.  A task may sit on a thread other than
+//   _thread; that thread forwards it.
 
 bool
 Task::error_hook(Task *, void *)
@@ -108,6 +113,22 @@ Task::error_hook(Task *, void *)
     return false;
 }
 
+#if HAVE_ELEMENT_PROFILE
+bool
+Task::profiled_fire()
+{
+    Element::ProfileSample s;
+    _owner->profile_begin(s);
+    bool work_done;
+    if (!_hook)
+	work_done = ((Element*)_thunk)->run_task(this);
+    else
+	work_done = _hook(this, _thunk);
+    _owner->profile_end(s, 0, 0);
+    return work_done;
+}
+#endif
+
 Task::~Task()
 {
     if (scheduled() || _pending_nextptr)
@@ -122,50 +143,57 @@ Task::master() const
 }
 
 
+// Adds this task to thread's pending list unless it is already pending.
+// Takes no locks: marking the task pending and pushing it each take one
+// compare-and-swap.  Only the push that makes the list nonempty wakes the
+// thread, since the thread claims the whole list at once.
 inline void
-Task::add_pending_locked(RouterThread *thread)
+Task::add_pending_to(RouterThread *thread)
 {
-    if (!_pending_nextptr) {
-	_pending_nextptr = 1;
-	*thread->_pending_tail = reinterpret_cast<uintptr_t>(this);
-	thread->_pending_tail = &_pending_nextptr;
+    if (RouterThread::pending_compare_swap(_pending_nextptr, 0, 1) != 0)
+	return;
+    uintptr_t head;
+    do {
+	head = thread->_pending_head;
+	_pending_nextptr = head ? head : 1;
+    } while (RouterThread::pending_compare_swap(thread->_pending_head, head, reinterpret_cast<uintptr_t>(this)) != head);
+    if (!head)
 	thread->add_pending();
-    }
 }
 
 void
 Task::add_pending()
 {
-    bool thread_match;
-    do {
-	RouterThread *thread = _thread;
-	SpinlockIRQ::flags_t flags = thread->_pending_lock.acquire();
-	thread_match = thread == _thread;
-	if (thread_match && thread->thread_id() >= 0)
-	    add_pending_locked(thread);
-	thread->_pending_lock.release(flags);
-    } while (!thread_match);
+    // If _thread changes underneath us, the task may land on its old
+    // thread's list; RouterThread::process_pending() forwards it.
+    RouterThread *thread = _thread;
+    if (thread->thread_id() >= 0)
+	add_pending_to(thread);
 }
 
-inline void
+// Removes this task from thread's unclaimed pending list, returning true
+// if it was there.  Concurrent add_pending_to() calls only change the head.
+inline bool
 Task::remove_pending_locked(RouterThread *thread)
 {
-    if (_pending_nextptr) {
-	volatile uintptr_t *thead = &thread->_pending_head, *tptr = thead;
-	while (Task *t = pending_to_task(*tptr))
-	    if (t == this) {
-		Task *next = pending_to_task(_pending_nextptr);
-		if (tptr != thead)
-		    *tptr = _pending_nextptr;
-		else
-		    *tptr = reinterpret_cast<uintptr_t>(next);
-		if (!next)
-		    thread->_pending_tail = tptr;
-		_pending_nextptr = 0;
-		break;
-	    } else
-		tptr = &t->_pending_nextptr;
+    uintptr_t me = reinterpret_cast<uintptr_t>(this);
+  retry:
+    if (!_pending_nextptr)
+	return false;
+    uintptr_t next = reinterpret_cast<uintptr_t>(pending_to_task(_pending_nextptr));
+    if (thread->_pending_head == me) {
+	if (RouterThread::pending_compare_swap(thread->_pending_head, me, next) != me)
+	    goto retry;
+	_pending_nextptr = 0;
+	return true;
     }
+    for (Task *t = pending_to_task(thread->_pending_head); t; t = t->pending_to_task())
+	if (t->pending_to_task() == this) {
+	    t->_pending_nextptr = _pending_nextptr;
+	    _pending_nextptr = 0;
+	    return true;
+	}
+    return false;
 }
 
 void
@@ -190,6 +218,9 @@ Task::initialize(Element *owner, bool schedule)
 
     Router *router = owner->router();
     int tid = router->home_thread_id(owner);
+    if (ThreadSched *ts = router->thread_sched())
+	if (!ts->initial_task_stealable(owner))
+	    _stealable = false;
     // Master::thread() returns the quiescent thread if its argument is out of
     // range
     _thread = router->master()->thread(tid);
@@ -229,20 +260,16 @@ Task::cleanup()
 
 	// Perhaps the task is enqueued on the current pending
 	// collection.  If so, remove it.
-	if (_pending_nextptr) {
+	// If not on the current pending list, perhaps this task is on
+	// some list currently being processed by
+	// RouterThread::process_pending(), or is being added by another
+	// thread.  Wait until that is done.  It is safe to simply spin
+	// because pending list processing is so simple: processing a
+	// pending list will NEVER cause a task to get deleted, so ~Task is
+	// never called from RouterThread::process_pending().
+	while (_pending_nextptr)
 	    remove_pending();
 
-	    // If not on the current pending list, perhaps this task
-	    // is on some list currently being processed by
-	    // RouterThread::process_pending().  Wait until that
-	    // processing is done.  It is safe to simply spin because
-	    // pending list processing is so simple: processing a
-	    // pending list will NEVER cause a task to get deleted, so
-	    // ~Task is never called from RouterThread::process_pending().
-	    while (_pending_nextptr)
-		/* do nothing */;
-	}
-
 	_owner = 0;
 	_thread = 0;
     }
@@ -297,8 +324,8 @@ Task::move_thread_second_half()
 	if (_status.is_scheduled)
 	    add_pending();
     } else {
-	add_pending_locked(old_thread);
 	old_thread->_pending_lock.release(flags);
+	add_pending_to(old_thread);
     }
 }
 
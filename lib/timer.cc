@@ -262,6 +262,11 @@ Timer::schedule_at_steady(const Timestamp &when)
     assert(_owner && initialized());
     TimerSet &ts = _thread->timer_set();
     ts.lock_timers();
+    if (ts.timer_wheel()) {
+	ts.wheel_schedule(this, when);
+	ts.unlock_timers();
+	return;
+    }
 
     // set expiration timer (ensure nonzero)
     _expiry_s = when ? when : Timestamp::epsilon();
@@ -306,7 +311,9 @@ Timer::unschedule()
     TimerSet &ts = _thread->timer_set();
     ts.lock_timers();
     int old_schedpos1 = _schedpos1;
-    if (_schedpos1 > 0) {
+    if (_schedpos1 > 0 && ts.timer_wheel())
+	ts.wheel_unschedule(this);
+    else if (_schedpos1 > 0) {
 	remove_heap<4>(ts._timer_heap.begin(), ts._timer_heap.end(),
 		       ts._timer_heap.begin() + _schedpos1 - 1,
 		       TimerSet::heap_less(), TimerSet::heap_place());
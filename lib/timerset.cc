@@ -48,6 +48,15 @@ TimerSet::TimerSet()
 #endif
     _timer_check = Timestamp::now_steady();
     _timer_check_reports = 0;
+
+    _wheel_slot = 0;
+    _wheel_cursor = 0;
+    _wheel_size = 0;
+}
+
+TimerSet::~TimerSet()
+{
+    delete[] _wheel_slot;
 }
 
 void
@@ -55,6 +64,19 @@ TimerSet::kill_router(Router *router)
 {
     lock_timers();
     assert(!_timer_runchunk.size());
+    if (_wheel_slot) {
+	for (int pos = 0; pos <= wheel_overflow; ++pos)
+	    for (Timer *t = _wheel_slot[pos], *next; t; t = next) {
+		next = t->_wheel_next;
+		if (t->router() == router) {
+		    wheel_remove(t);
+		    t->_owner = 0;
+		}
+	    }
+	wheel_set_expiry();
+	unlock_timers();
+	return;
+    }
     for (heap_element *thp = _timer_heap.end();
 	 thp > _timer_heap.begin(); ) {
 	--thp;
@@ -70,6 +92,49 @@ TimerSet::kill_router(Router *router)
     unlock_timers();
 }
 
+void
+TimerSet::set_timer_wheel(bool wheel)
+{
+    lock_timers();
+    assert(!_timer_runchunk.size());
+    if (wheel != timer_wheel()) {
+	Vector<Timer *> timers;
+	if (_wheel_slot) {
+	    for (int pos = 0; pos <= wheel_overflow; ++pos)
+		while (Timer *t = _wheel_slot[pos]) {
+		    wheel_remove(t);
+		    timers.push_back(t);
+		}
+	    delete[] _wheel_slot;
+	    _wheel_slot = 0;
+	} else {
+	    for (heap_element *thp = _timer_heap.begin(); thp != _timer_heap.end(); ++thp) {
+		thp->t->_schedpos1 = 0;
+		timers.push_back(thp->t);
+	    }
+	    _timer_heap.clear();
+	}
+
+	if (wheel) {
+	    _wheel_slot = new Timer *[wheel_overflow + 1];
+	    memset(_wheel_slot, 0, sizeof(Timer *) * (wheel_overflow + 1));
+	    memset(_wheel_bits, 0, sizeof(_wheel_bits));
+	    _wheel_cursor = wheel_tick(Timestamp::now_steady());
+	    _wheel_size = 0;
+	    for (Timer **tp = timers.begin(); tp != timers.end(); ++tp)
+		wheel_insert(*tp);
+	    wheel_set_expiry();
+	} else {
+	    for (Timer **tp = timers.begin(); tp != timers.end(); ++tp) {
+		_timer_heap.push_back(heap_element(*tp));
+		push_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
+	    }
+	    set_timer_expiry();
+	}
+    }
+    unlock_timers();
+}
+
 void
 TimerSet::set_max_timer_stride(unsigned timer_stride)
 {
@@ -94,6 +159,13 @@ TimerSet::check_timer_expiry(Timer *t)
 inline void
 TimerSet::run_one_timer(Timer *t)
 {
+    // A router being initialized or killed is paused; try its timers again
+    // shortly rather than stopping every other router's timers too.
+    if (unlikely(t->router()->paused())) {
+	t->schedule_at_steady(_timer_check + Timestamp::make_msec(1));
+	return;
+    }
+
 #if CLICK_STATS >= 2
     Element *owner = t->_owner;
     click_cycles_t start_cycles = click_get_cycles(),
@@ -110,12 +182,55 @@ TimerSet::run_one_timer(Timer *t)
 #endif
 }
 
+inline void
+TimerSet::adjust_timer_stride(const Timestamp &expiry)
+{
+    Timestamp adj_expiry = expiry + Timer::adjustment();
+    if (adj_expiry <= _timer_check) {
+	_timer_count = 0;
+	if (_timer_stride > 1)
+	    _timer_stride = (_timer_stride * 4) / 5;
+    } else if (++_timer_count >= 12) {
+	_timer_count = 0;
+	if (++_timer_stride >= _max_timer_stride)
+	    _timer_stride = _max_timer_stride;
+    }
+}
+
+void
+TimerSet::run_timer_chunk(RouterThread *thread)
+{
+    Vector<Timer*>::iterator i = _timer_runchunk.begin();
+    for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    run_one_timer(*i);
+	}
+
+    // reschedule unrun timers if stopped early
+    for (; i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    (*i)->schedule_at_steady((*i)->_expiry_s);
+	}
+    _timer_runchunk.clear();
+}
+
+static int
+timer_expiry_compar(const void *a, const void *b, void *)
+{
+    const Timestamp &ea = (*static_cast<Timer * const *>(a))->expiry_steady();
+    const Timestamp &eb = (*static_cast<Timer * const *>(b))->expiry_steady();
+    return ea < eb ? -1 : (eb < ea ? 1 : 0);
+}
+
 void
 TimerSet::run_timers(RouterThread *thread, Master *master)
 {
     if (!_timer_lock.attempt())
 	return;
-    if (!master->paused() && _timer_heap.size() > 0 && !thread->stop_flag()) {
+    if (!master->paused() && (_wheel_slot ? _wheel_size : _timer_heap.size()) > 0
+	&& !thread->stop_flag()) {
 	thread->set_thread_state(RouterThread::S_RUNTIMER);
 #if CLICK_LINUXMODULE
 	_timer_task = current;
@@ -123,20 +238,25 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 	_timer_processor = click_current_processor();
 #endif
 	_timer_check = Timestamp::now_steady();
-	heap_element *th = _timer_heap.begin();
 
-	if (th->expiry_s <= _timer_check) {
-	    // potentially adjust timer stride
-	    Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
-	    if (adj_expiry <= _timer_check) {
-		_timer_count = 0;
-		if (_timer_stride > 1)
-		    _timer_stride = (_timer_stride * 4) / 5;
-	    } else if (++_timer_count >= 12) {
-		_timer_count = 0;
-		if (++_timer_stride >= _max_timer_stride)
-		    _timer_stride = _max_timer_stride;
+	if (_wheel_slot) {
+	    // _timer_expiry may be a lower bound; wheel_collect cascades
+	    // the wheel and finds out for sure
+	    if (_timer_expiry <= _timer_check) {
+		adjust_timer_stride(_timer_expiry);
+		wheel_collect(_timer_check);
+		click_qsort(_timer_runchunk.begin(), _timer_runchunk.size(),
+			    sizeof(Timer *), timer_expiry_compar);
+		for (int i = 0; i < _timer_runchunk.size(); ++i)
+		    _timer_runchunk[i]->_schedpos1 = -i - 1;
+		wheel_set_expiry();
+		run_timer_chunk(thread);
 	    }
+	} else if (_timer_heap.begin()->expiry_s <= _timer_check) {
+	    heap_element *th = _timer_heap.begin();
+
+	    // potentially adjust timer stride
+	    adjust_timer_stride(th->expiry_s);
 
 	    // actually run timers
 	    int max_timers = 64;
@@ -170,21 +290,7 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 		} while (_timer_heap.size() > 0
 			 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
 		set_timer_expiry();
-
-		Vector<Timer*>::iterator i = _timer_runchunk.begin();
-		for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			run_one_timer(*i);
-		    }
-
-		// reschedule unrun timers if stopped early
-		for (; i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			(*i)->schedule_at_steady((*i)->_expiry_s);
-		    }
-		_timer_runchunk.clear();
+		run_timer_chunk(thread);
 	    }
 	}
 
@@ -197,4 +303,206 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
     _timer_lock.release();
 }
 
+
+// timing wheel
+
+void
+TimerSet::wheel_insert(Timer *t)
+{
+    uint64_t tick = wheel_tick(t->_expiry_s);
+    if (tick < _wheel_cursor)
+	tick = _wheel_cursor;
+
+    // a timer goes in the lowest level whose wheel contains both it and
+    // the cursor
+    uint64_t diff = tick ^ _wheel_cursor;
+    int level = 0;
+    while (level < wheel_levels && (diff >> (wheel_bits * (level + 1))))
+	++level;
+    int pos;
+    if (level == wheel_levels)
+	pos = wheel_overflow;
+    else
+	pos = level * wheel_slots
+	    + ((tick >> (wheel_bits * level)) & (wheel_slots - 1));
+
+    Timer **pprev = &_wheel_slot[pos];
+    if ((t->_wheel_next = *pprev))
+	t->_wheel_next->_wheel_pprev = &t->_wheel_next;
+    *pprev = t;
+    t->_wheel_pprev = pprev;
+    _wheel_bits[pos >> 6] |= (uint64_t) 1 << (pos & 63);
+    t->_schedpos1 = pos + 1;
+    ++_wheel_size;
+}
+
+void
+TimerSet::wheel_remove(Timer *t)
+{
+    int pos = t->_schedpos1 - 1;
+    if ((*t->_wheel_pprev = t->_wheel_next))
+	t->_wheel_next->_wheel_pprev = t->_wheel_pprev;
+    if (!_wheel_slot[pos])
+	_wheel_bits[pos >> 6] &= ~((uint64_t) 1 << (pos & 63));
+    t->_schedpos1 = 0;
+    --_wheel_size;
+}
+
+int
+TimerSet::wheel_find(int from, int end) const
+{
+    while (from < end) {
+	if (uint64_t w = _wheel_bits[from >> 6] >> (from & 63)) {
+	    int pos = from + ffs_lsb(w) - 1;
+	    return pos < end ? pos : -1;
+	}
+	from = (from | 63) + 1;
+    }
+    return -1;
+}
+
+int
+TimerSet::wheel_first(uint64_t &start) const
+{
+    // At levels above 0, the cursor's own slot is always empty: its timers
+    // were cascaded when the cursor entered it.
+    for (int level = 0; level < wheel_levels; ++level) {
+	int shift = wheel_bits * level;
+	int from = level * wheel_slots
+	    + ((_wheel_cursor >> shift) & (wheel_slots - 1)) + (level > 0);
+	int pos = wheel_find(from, (level + 1) * wheel_slots);
+	if (pos >= 0) {
+	    start = ((_wheel_cursor >> (shift + wheel_bits)) << (shift + wheel_bits))
+		+ ((uint64_t) (pos - level * wheel_slots) << shift);
+	    return pos;
+	}
+    }
+    if (_wheel_slot[wheel_overflow]) {
+	int shift = wheel_bits * wheel_levels;
+	start = ((_wheel_cursor >> shift) + 1) << shift;
+	return wheel_overflow;
+    }
+    return -1;
+}
+
+void
+TimerSet::wheel_cascade()
+{
+    // The cursor has just entered a new level-0 wheel.  Redistribute the
+    // higher-level slots it entered, highest level first.
+    int top = 0;
+    while (top < wheel_levels
+	   && !(_wheel_cursor & (((uint64_t) 1 << (wheel_bits * (top + 1))) - 1)))
+	++top;
+    for (int level = top; level > 0; --level) {
+	int pos;
+	if (level == wheel_levels)
+	    pos = wheel_overflow;
+	else
+	    pos = level * wheel_slots
+		+ ((_wheel_cursor >> (wheel_bits * level)) & (wheel_slots - 1));
+	Timer *t = _wheel_slot[pos];
+	_wheel_slot[pos] = 0;
+	_wheel_bits[pos >> 6] &= ~((uint64_t) 1 << (pos & 63));
+	while (t) {
+	    Timer *next = t->_wheel_next;
+	    --_wheel_size;
+	    wheel_insert(t);
+	    t = next;
+	}
+    }
+}
+
+void
+TimerSet::wheel_collect(const Timestamp &now)
+{
+    // Move expired timers to _timer_runchunk, advancing the cursor to now.
+    uint64_t now_tick = wheel_tick(now), start;
+    int pos;
+    while ((pos = wheel_first(start)) >= 0 && start <= now_tick) {
+	_wheel_cursor = start;
+	if (pos < wheel_slots) {
+	    for (Timer *t = _wheel_slot[pos], *next; t; t = next) {
+		next = t->_wheel_next;
+		if (t->_expiry_s <= now) {
+		    wheel_remove(t);
+		    _timer_runchunk.push_back(t);
+		}
+	    }
+	    if (start == now_tick)
+		break;
+	    ++_wheel_cursor;
+	    if (_wheel_cursor & (wheel_slots - 1))
+		continue;
+	}
+	wheel_cascade();
+    }
+    // every occupied slot starts after now_tick, so no cascades are missed
+    if (_wheel_cursor < now_tick)
+	_wheel_cursor = now_tick;
+}
+
+void
+TimerSet::wheel_set_expiry()
+{
+    uint64_t start;
+    int pos = wheel_first(start);
+    if (pos < 0)
+	_timer_expiry = Timestamp();
+    else if (pos < wheel_slots) {
+	Timer *t = _wheel_slot[pos];
+	_timer_expiry = t->_expiry_s;
+	for (t = t->_wheel_next; t; t = t->_wheel_next)
+	    if (t->_expiry_s < _timer_expiry)
+		_timer_expiry = t->_expiry_s;
+    } else
+	_timer_expiry = Timestamp::make_usec((Timestamp::value_type) (start << wheel_tick_shift));
+}
+
+void
+TimerSet::wheel_schedule(Timer *t, const Timestamp &when)
+{
+    bool was_first = t->_schedpos1 > 0 && t->_expiry_s == _timer_expiry;
+    if (t->_schedpos1 > 0)
+	wheel_remove(t);
+    else if (t->_schedpos1 < 0)
+	_timer_runchunk[-t->_schedpos1 - 1] = 0;
+
+    t->_expiry_s = when ? when : Timestamp::epsilon();
+    check_timer_expiry(t);
+    wheel_insert(t);
+
+    if (!_timer_expiry || t->_expiry_s < _timer_expiry) {
+	_timer_expiry = t->_expiry_s;
+	t->_thread->wake();
+    } else if (was_first)
+	wheel_set_expiry();
+}
+
+void
+TimerSet::wheel_unschedule(Timer *t)
+{
+    bool was_first = t->_expiry_s == _timer_expiry;
+    wheel_remove(t);
+    if (was_first)
+	wheel_set_expiry();
+}
+
+Timer *
+TimerSet::wheel_next_timer() const
+{
+    // Exact for level-0 slots.  Otherwise returns some timer from the
+    // earliest occupied slot, which is cheaper than searching it.
+    uint64_t start;
+    int pos = wheel_first(start);
+    if (pos < 0)
+	return 0;
+    Timer *best = _wheel_slot[pos];
+    if (pos < wheel_slots)
+	for (Timer *t = best->_wheel_next; t; t = t->_wheel_next)
+	    if (t->_expiry_s < best->_expiry_s)
+		best = t;
+    return best;
+}
+
 CLICK_ENDDECLS
@@ -24,6 +24,9 @@
 # include <unistd.h>
 # include <sys/ioctl.h>
 #endif
+#if TIMESTAMP_FAST_CLOCK && __GNUC__
+# include <cpuid.h>
+#endif
 CLICK_DECLS
 
 /** @file timestamp.hh
@@ -146,6 +149,110 @@ Timestamp::warp_jump_steady(const Timestamp &expiry)
 }
 #endif
 
+#if TIMESTAMP_FAST_CLOCK
+static bool
+invariant_tsc()
+{
+# if __GNUC__
+    unsigned a, b, c, d;
+    if (__get_cpuid(0x80000000U, &a, &b, &c, &d) && a >= 0x80000007U
+	&& __get_cpuid(0x80000007U, &a, &b, &c, &d))
+	return d & (1U << 8);
+# endif
+    return false;
+}
+
+Timestamp::fast_clock_type Timestamp::_fast_clock = {
+    0, invariant_tsc(), false, 0, 0, 0, { 0, 0 }, 0, 0
+};
+
+void
+Timestamp::assign_now_fast_slow(bool steady)
+{
+    fast_clock_type &fc = _fast_clock;
+    volatile uint32_t *seqp = reinterpret_cast<volatile uint32_t *>(&fc.seq);
+    uint32_t seq = *seqp;
+    if (fc.enabled && fc.running && (seq & 1)) {
+	// Another thread is resynchronizing; wait for its result, so the
+	// steady clock doesn't appear to jump.
+	while (*seqp == seq)
+	    __asm__ __volatile__("pause" : : : "memory");
+	assign_now_fast(steady);
+	return;
+    }
+    if (!fc.enabled || (seq & 1)
+# if TIMESTAMP_WARPABLE
+	|| _warp_class
+# endif
+	) {
+	assign_now(false, steady, false);
+	return;
+    }
+    if (!__sync_bool_compare_and_swap(&fc.seq, seq, seq + 1)) {
+	// Another thread just started resynchronizing.  Once running, the
+	// system clocks may lag values already handed out, so wait for it.
+	if (fc.running)
+	    assign_now_fast(steady);
+	else
+	    assign_now(false, steady, false);
+	return;
+    }
+
+    // We hold the clock; readers retry or take this slow path until we
+    // release it.
+    Timestamp ts[2];
+    ts[1] = Timestamp::now_steady_unwarped();
+    uint64_t tsc = click_get_cycles();
+    ts[0] = Timestamp::now_unwarped();
+    int64_t nsec[2] = { ts[0].nsecval(), ts[1].nsecval() };
+    int64_t steady_nsec = nsec[1];
+
+    if (fc.running) {
+	// Never move the steady clock backwards: readers may have been handed
+	// any value up to the end of the current resynchronization period.
+	uint64_t delta = tsc - fc.tsc;
+	if (delta > fc.period)
+	    delta = fc.period;
+	int64_t handed_out = fc.nsec[1] + (int64_t) ((delta * fc.mult) >> 32);
+	if (nsec[1] < handed_out) {
+	    nsec[1] = handed_out;
+	    ts[1] = Timestamp::make_nsec(nsec[1] / 1000000000, nsec[1] % 1000000000);
+	}
+    }
+
+    if (!fc.cal_tsc) {
+	fc.cal_tsc = tsc;
+	fc.cal_nsec = steady_nsec;
+    } else if (steady_nsec - fc.cal_nsec >= 10000000 && tsc > fc.cal_tsc) {
+	// Measure the rate over the whole time since calibration began; the
+	// estimate improves as the router runs.
+	double mult = (steady_nsec - fc.cal_nsec) * 4294967296.0 / (tsc - fc.cal_tsc);
+	fc.mult = (uint64_t) mult;
+	fc.tsc = tsc;
+	fc.period = (uint64_t) (100000000.0 * 4294967296.0 / mult);
+	fc.nsec[0] = nsec[0];
+	fc.nsec[1] = nsec[1];
+	fc.running = true;
+    }
+
+    __asm__ __volatile__("" : : : "memory");
+    *seqp = seq + 2;
+    *this = ts[steady];
+}
+#endif
+
+void
+Timestamp::fast_clock_enable(bool on)
+{
+#if TIMESTAMP_FAST_CLOCK
+    _fast_clock.running = false;
+    _fast_clock.cal_tsc = 0;
+    _fast_clock.enabled = on;
+#else
+    (void) on;
+#endif
+}
+
 #if !CLICK_LINUXMODULE && !CLICK_BSDMODULE
 /** @brief Set this timestamp to a timeval obtained by calling ioctl.
     @param fd file descriptor
@@ -617,7 +617,7 @@ handler_read(struct file *filp, char *buffer, size_t count, loff_t *store_f_pos)
 		(void) h->__call_read(e, &hdi);
 		count = hdi.count;
 		retval = hdi.retval;
-	    } else if (h->exclusive()) {
+	    } else if (h->exclusive() && !h->concurrent()) {
 		lock_threads();
 		handler_strings[stringno] = h->call_read(e);
 		unlock_threads();
@@ -822,6 +822,34 @@ handler_release(struct inode *, struct file *filp)
     return 0;
 }
 
+// Read a batch of statistics by id (CLICK_LLRPC_GET_STATS).  The values
+// are copied out in chunks, so the batch may be arbitrarily large.
+static int
+handler_get_stats(void *address_ptr)
+{
+    click_llrpc_stats_st st;
+    if (CLICK_LLRPC_GET(st, address_ptr) < 0)
+	return -EFAULT;
+
+    enum { CHUNK = 32 };
+    uint32_t ids[CHUNK];
+    uint64_t values[CHUNK];
+    int nstats = click_router->nstats();
+    for (uint32_t i = 0; i < st.n; i += CHUNK) {
+	uint32_t n = (st.n - i < CHUNK ? st.n - i : CHUNK);
+	if (CLICK_LLRPC_GET_DATA(ids, st.ids + i, n * sizeof(uint32_t)) < 0)
+	    return -EFAULT;
+	for (uint32_t j = 0; j < n; ++j) {
+	    if (ids[j] >= (uint32_t) nstats)
+		return -EINVAL;
+	    values[j] = click_router->stat_value(ids[j]);
+	}
+	if (CLICK_LLRPC_PUT_DATA(st.values + i, values, n * sizeof(uint64_t)) < 0)
+	    return -EFAULT;
+    }
+    return 0;
+}
+
 static inline int
 do_handler_ioctl(struct inode *inode, struct file *filp,
 		 unsigned command, unsigned long address)
@@ -849,7 +877,9 @@ do_handler_ioctl(struct inode *inode, struct file *filp,
 	int stringno = FILP_STRINGNO(filp);
 	handler_strings_info[stringno].flags |= HANDLER_RAW;
 	retval = 0;
-    } else if (INO_ELEMENTNO(inode->i_ino) < 0
+    } else if (command == CLICK_LLRPC_GET_STATS)
+	retval = handler_get_stats(reinterpret_cast<void *>(address));
+    else if (INO_ELEMENTNO(inode->i_ino) < 0
 	     || !(e = click_router->element(INO_ELEMENTNO(inode->i_ino))))
 	retval = -EIO;
     else {
@@ -46,7 +46,7 @@ static int chatterlevel_ceiling = ErrorHandler::el_error;
 /***************************** Global handlers *******************************/
 
 enum {
-    h_cycles, h_meminfo, h_packages, h_assert_stop
+    h_cycles, h_meminfo, h_packages, h_assert_stop, h_skbmgr
 };
 
 #ifdef HAVE_LINUX_READ_NET_SKBCOUNT
@@ -77,6 +77,15 @@ read_global(Element *, void *user_data)
 #endif
 	break;
     }
+    case h_skbmgr: {
+	struct skbmgr_stats stats;
+	skbmgr_get_stats(&stats);
+	sa << "hits " << stats.hits << "\n"
+	   << "misses " << stats.misses << "\n"
+	   << "recycled " << stats.recycled << "\n"
+	   << "freed " << stats.freed << "\n";
+	break;
+    }
     case h_packages: {
 	Vector<String> v;
 	click_public_packages(v);
@@ -301,6 +310,7 @@ init_module()
     // global handlers
     Router::add_read_handler(0, "packages", read_global, (void *) (intptr_t) h_packages);
     Router::add_read_handler(0, "meminfo", read_global, (void *) (intptr_t) h_meminfo);
+    Router::add_read_handler(0, "skbmgr", read_global, (void *) (intptr_t) h_skbmgr);
 #if HAVE_INT64_TYPES
     Router::add_read_handler(0, "cycles", read_global, (void *) (intptr_t) h_cycles);
 #endif
@@ -29,12 +29,17 @@ CLICK_CXX_PROTECT
 #include <asm/atomic.h>
 #include <linux/netdevice.h>
 #include <net/dst.h>
+#include <net/xfrm.h>
 #include <linux/if_packet.h>
 CLICK_CXX_UNPROTECT
 #include <click/cxxunprotect.h>
 
 #define DEBUG_SKBMGR 1
 
+#if !HAVE_SKB_RECYCLE && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+# define CLICK_SKBMGR_RESET 1
+#endif
+
 class RecycledSkbBucket { public:
   static const int SIZE = 62;
 
@@ -58,6 +63,14 @@ class RecycledSkbBucket { public:
 
 };
 
+// A CPU's private stack of recycled skbs for one bucket.  Only its CPU
+// uses it, so it needs no lock.
+struct RecycledSkbCache {
+  static const int SIZE = 32;
+  int _n;
+  struct sk_buff *_skbs[SIZE];
+};
+
 class RecycledSkbPool { public:
 
   static const int NBUCKETS = 2;
@@ -80,21 +93,23 @@ class RecycledSkbPool { public:
 #else
   int _pad2[2];
 #endif
-#if DEBUG_SKBMGR
-  int _allocated;
-  int _freed;
-  int _recycle_freed;
-  int _recycle_allocated;
-  int _pad[1];
-#else
-  int _pad[5];
-#endif
+
+  // owned by this pool's CPU: the caches in front of _buckets, which move
+  // skbs to and from _buckets in bulk, and statistics
+  RecycledSkbCache _caches[NBUCKETS];
+  unsigned long _hits;		// allocations served by recycled skbs
+  unsigned long _misses;	// allocations from the kernel
+  unsigned long _recycled;	// skbs kept for reuse
+  unsigned long _freed;		// skbs returned to the kernel
 
   inline void lock();
   inline void unlock();
 
-  struct sk_buff *allocate(unsigned headroom, unsigned size, int, int *);
+  struct sk_buff *allocate(unsigned headroom, unsigned size, int, int *,
+			   RecycledSkbPool &producer);
   void recycle(struct sk_buff *);
+  void refill(int bucket, RecycledSkbCache &cache);
+  struct sk_buff *flush(int bucket, struct sk_buff *to_free);
 
 #if __MTCLICK__
   static int find_producer(int, int);
@@ -102,6 +117,7 @@ class RecycledSkbPool { public:
 
   friend struct sk_buff *skbmgr_allocate_skbs(unsigned, unsigned, int *);
   friend void skbmgr_recycle_skbs(struct sk_buff *);
+  friend void skbmgr_get_stats(struct skbmgr_stats *);
 
 };
 
@@ -169,34 +185,34 @@ void
 RecycledSkbPool::initialize()
 {
   _lock = 0;
-  for (int i = 0; i < NBUCKETS; i++)
+  for (int i = 0; i < NBUCKETS; i++) {
     _buckets[i].initialize();
+    _caches[i]._n = 0;
+  }
 #if __MTCLICK__
   _last_producer = -1;
   _consumers = 0;
 #endif
-#if DEBUG_SKBMGR
-  _recycle_freed = 0;
-  _freed = 0;
-  _recycle_allocated = 0;
-  _allocated = 0;
-#endif
+  _hits = _misses = _recycled = _freed = 0;
 }
 
 void
 RecycledSkbPool::cleanup()
 {
   lock();
-  for (int i = 0; i < NBUCKETS; i++)
+  for (int i = 0; i < NBUCKETS; i++) {
     _buckets[i].cleanup();
+    while (_caches[i]._n > 0)
+      kfree_skb(_caches[i]._skbs[--_caches[i]._n]);
+  }
 #if __MTCLICK__
   _last_producer = -1;
   _consumers = 0;
 #endif
 #if DEBUG_SKBMGR
-  if (_freed > 0 || _allocated > 0)
-    printk ("poll %p: %d/%d freed, %d/%d allocated\n", this,
-	    _freed, _recycle_freed, _allocated, _recycle_allocated);
+  if (_hits > 0 || _misses > 0)
+    printk ("pool %p: %lu/%lu recycled/freed, %lu/%lu hits/misses\n", this,
+	    _recycled, _freed, _hits, _misses);
 #endif
   unlock();
 }
@@ -274,14 +290,94 @@ RecycledSkbPool::find_producer(int cpu, int bucket)
 #endif
 
 
+#if CLICK_SKBMGR_RESET
+// Prepare skb for reuse, like the kernel's old skb_recycle: drop the state
+// it picked up and make it look freshly allocated.  Returns false if skb
+// can't be reused; then the caller must free it.
+static bool
+skbmgr_reset(struct sk_buff *skb)
+{
+  if (skb_shared(skb) || skb_cloned(skb) || skb_is_nonlinear(skb)
+      || skb_has_frag_list(skb) || skb_zcopy(skb)
+      || skb->fclone != SKB_FCLONE_UNAVAILABLE || skb->head_frag
+      || skb->pfmemalloc || skb->destructor || skb->sk)
+    return false;
+# if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 14, 0)
+  if (skb->pp_recycle)
+    return false;
+# endif
+
+  skb_dst_drop(skb);
+  nf_reset_ct(skb);
+  secpath_reset(skb);
+  skb_ext_reset(skb);
+
+  struct skb_shared_info *shinfo = skb_shinfo(skb);
+  memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+  atomic_set(&shinfo->dataref, 1);
+
+  memset(skb, 0, offsetof(struct sk_buff, tail));
+  skb->data = skb->head;
+  skb_reset_tail_pointer(skb);
+  skb->mac_header = (typeof(skb->mac_header)) ~0U;
+  skb->transport_header = (typeof(skb->transport_header)) ~0U;
+  return true;
+}
+#endif
+
+static inline void
+skbmgr_free_list(struct sk_buff *skbs)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 14, 0)
+  kfree_skb_list(skbs);
+#else
+  while (struct sk_buff *skb = skbs) {
+    skbs = skb->next;
+    kfree_skb(skb);
+  }
+#endif
+}
+
+// Make room in this CPU's cache by moving half of it to the shared bucket,
+// under one lock.  Skbs that don't fit are prepended to to_free.
+struct sk_buff *
+RecycledSkbPool::flush(int bucket, struct sk_buff *to_free)
+{
+  RecycledSkbCache &cache = _caches[bucket];
+  lock();
+  while (cache._n > RecycledSkbCache::SIZE / 2) {
+    struct sk_buff *skb = cache._skbs[--cache._n];
+    if (_buckets[bucket].enq(skb) < 0) {
+      skb->next = to_free;
+      to_free = skb;
+      _freed++;
+    }
+  }
+  unlock();
+  return to_free;
+}
+
+// Fill cache from the shared bucket, under one lock.
+void
+RecycledSkbPool::refill(int bucket, RecycledSkbCache &cache)
+{
+  lock();
+  RecycledSkbBucket &buck = _buckets[bucket];
+  while (cache._n < RecycledSkbCache::SIZE && !buck.empty())
+    cache._skbs[cache._n++] = buck.deq();
+  unlock();
+}
+
 void
 RecycledSkbPool::recycle(struct sk_buff *skbs)
 {
+  struct sk_buff *to_free = 0;
+
   while (skbs) {
     struct sk_buff *skb = skbs;
     skbs = skbs->next;
 
-#if HAVE_SKB_RECYCLE
+#if HAVE_SKB_RECYCLE || CLICK_SKBMGR_RESET
     // where should sk_buff go?
 # if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24)
     unsigned char *skb_end = skb_end_pointer(skb);
@@ -290,38 +386,41 @@ RecycledSkbPool::recycle(struct sk_buff *skbs)
 # endif
     int bucket = size_to_lower_bucket(skb_end - skb->head);
 
-    // try to put in that bucket
-    if (bucket >= 0) {
-      lock();
-      int tail = _buckets[bucket]._tail;
-      int next = _buckets[bucket].next_i(tail);
-      if (next != _buckets[bucket]._head) {
-	// Note: skb_recycle_fast will free the skb if it cannot recycle it
-	if ((skb = skb_recycle(skb))) {
-	  _buckets[bucket]._skbs[tail] = skb;
-	  _buckets[bucket]._tail = next;
-	  skb = 0;
-	}
-# if DEBUG_SKBMGR
-        _recycle_freed++;
+# if HAVE_SKB_RECYCLE
+    // Note: skb_recycle will free the skb if it cannot recycle it
+    if (bucket >= 0 && !(skb = skb_recycle(skb))) {
+      _freed++;
+      continue;
+    }
+# else
+    if (bucket >= 0 && !skbmgr_reset(skb))
+      bucket = -1;
 # endif
-      }
-      unlock();
+
+    // put it in this CPU's cache
+    if (bucket >= 0) {
+      RecycledSkbCache &cache = _caches[bucket];
+      if (cache._n == RecycledSkbCache::SIZE)
+	to_free = flush(bucket, to_free);
+      cache._skbs[cache._n++] = skb;
+      _recycled++;
+      continue;
     }
 #endif
 
     // if not taken care of, then free it
-    if (skb) {
-#if DEBUG_SKBMGR
-      _freed++;
-#endif
-      kfree_skb(skb);
-    }
+    skb->next = to_free;
+    to_free = skb;
+    _freed++;
   }
+
+  if (to_free)
+    skbmgr_free_list(to_free);
 }
 
 struct sk_buff *
-RecycledSkbPool::allocate(unsigned headroom, unsigned size, int want, int *store_got)
+RecycledSkbPool::allocate(unsigned headroom, unsigned size, int want, int *store_got,
+			  RecycledSkbPool &producer)
 {
   int bucket = size_to_higher_bucket(headroom + size);
 
@@ -330,31 +429,27 @@ RecycledSkbPool::allocate(unsigned headroom, unsigned size, int want, int *store
   int got = 0;
 
   if (bucket >= 0) {
-    lock();
-    RecycledSkbBucket &buck = _buckets[bucket];
-    while (got < want && !buck.empty()) {
-      struct sk_buff *skb = _buckets[bucket].deq();
-#if DEBUG_SKBMGR
-      _recycle_allocated++;
-#endif
+    RecycledSkbCache &cache = _caches[bucket];
+    if (cache._n < want)
+      producer.refill(bucket, cache);
+    while (got < want && cache._n > 0) {
+      struct sk_buff *skb = cache._skbs[--cache._n];
       skb_reserve(skb, headroom);
       *prev = skb;
       prev = &skb->next;
       got++;
     }
-    unlock();
+    _hits += got;
   }
 
   size = size_to_higher_bucket_size(headroom + size);
   while (got < want) {
     struct sk_buff *skb = alloc_skb(size, GFP_ATOMIC);
-#if DEBUG_SKBMGR
-    _allocated++;
-#endif
     if (!skb) {
       printk("<1>oops, kernel could not allocate memory for skbuff\n");
       break;
     }
+    _misses++;
     skb_reserve(skb, headroom);
     *prev = skb;
     prev = &skb->next;
@@ -401,18 +496,19 @@ skbmgr_allocate_skbs(unsigned headroom, unsigned size, int *want)
   int bucket = RecycledSkbPool::size_to_higher_bucket(headroom + size);
 
   int w = *want;
-  if (pool[producer].bucket(bucket).size() < w) {
+  if (bucket >= 0 && pool[cpu]._caches[bucket]._n < w
+      && pool[producer].bucket(bucket).size() < w) {
     if (pool[cpu]._last_producer < 0 ||
 	pool[pool[cpu]._last_producer].bucket(bucket).size() < w)
       RecycledSkbPool::find_producer(cpu, bucket);
     if (pool[cpu]._last_producer >= 0)
       producer = pool[cpu]._last_producer;
   }
-  sk_buff *skb = pool[producer].allocate(headroom, size, w, want);
+  sk_buff *skb = pool[cpu].allocate(headroom, size, w, want, pool[producer]);
   click_put_processor();
   return skb;
 #else
-  return pool.allocate(headroom, size, *want, want);
+  return pool.allocate(headroom, size, *want, want, pool);
 #endif
 }
 
@@ -427,3 +523,21 @@ skbmgr_recycle_skbs(struct sk_buff *skbs)
   pool.recycle(skbs);
 #endif
 }
+
+void
+skbmgr_get_stats(struct skbmgr_stats *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+#if __MTCLICK__
+  for (int i = 0; i < NR_CPUS; i++) {
+    RecycledSkbPool &p = pool[i];
+#else
+  {
+    RecycledSkbPool &p = pool;
+#endif
+    stats->hits += p._hits;
+    stats->misses += p._misses;
+    stats->recycled += p._recycled;
+    stats->freed += p._freed;
+  }
+}
@@ -46,6 +46,7 @@
 #include <click/master.hh>
 #include <click/simclick.h>
 #include <click/handlercall.hh>
+#include <click/hashtable.hh>
 #include "elements/standard/quitwatcher.hh"
 #include "elements/userlevel/controlsocket.hh"
 
@@ -79,6 +80,40 @@ static void setsimstate(simclick_node_t *newstate) {
     cursimnode = newstate;
 }
 
+// Configurations already read, by file name, so that nodes running the same
+// configuration share one lexed copy.  The cache holds the router's
+// flattened binary form (Router::unparse_cache); elements' configuration
+// strings are substrings of it.
+struct SharedConfig {
+    String config;
+    String cache;
+};
+static HashTable<String, SharedConfig> *shared_configs;
+
+static Router *
+read_shared_router(const char *router_file, ErrorHandler *errh)
+{
+    if (!shared_configs)
+	shared_configs = new HashTable<String, SharedConfig>;
+    int before = errh->nerrors();
+    if (SharedConfig *sc = shared_configs->get_pointer(router_file)) {
+	Router *r = new Router(sc->config, new Master(1));
+	if (r->parse_cache(sc->cache, click_lexer(), 0, errh) >= 0)
+	    return r;
+	delete r;
+    }
+
+    Router *r = click_read_router(router_file, false, errh, false);
+    if (r && errh->nerrors() == before) {
+	StringAccum sa;
+	r->unparse_cache(sa);
+	SharedConfig &sc = (*shared_configs)[router_file];
+	sc.config = r->configuration_string();
+	sc.cache = sa.take_string();
+    }
+    return r;
+}
+
 // functions for packages
 
 
@@ -100,7 +135,7 @@ int simclick_click_create(simclick_node_t *simnode, const char* router_file) {
     ErrorHandler *errh = ErrorHandler::default_handler();
     int before = errh->nerrors();
 
-    Router *r = click_read_router(router_file, false, errh, false);
+    Router *r = read_shared_router(router_file, errh);
     simnode->clickinfo = r;
     if (!r)
 	return errh->fatal("%s: not a valid router", router_file);
@@ -170,6 +205,21 @@ int simclick_click_send(simclick_node_t *simnode,
   return result;
 }
 
+int simclick_click_send_batch(simclick_node_t *simnode,
+			      const simclick_packet_t *packets, int n) {
+    setsimstate(simnode);
+    Router *r = (Router *) simnode->clickinfo;
+    if (!r) {
+	click_chatter("simclick_click_send_batch: called with null router");
+	return -1;
+    }
+    for (int i = 0; i < n; ++i)
+	r->sim_incoming_packet(packets[i].ifid, packets[i].type, packets[i].data,
+			       packets[i].len, packets[i].pinfo);
+    r->master()->thread(0)->driver();
+    return 0;
+}
+
 char* simclick_click_read_handler(simclick_node_t *simnode,
 				  const char* elementname,
 				  const char* handlername,
@@ -24,6 +24,7 @@
 #include <click/error.hh>
 #include <click/confparse.hh>
 #include <click/straccum.hh>
+#include <click/args.hh>
 #include <click/driver.hh>
 #include "lexert.hh"
 #include "routert.hh"
@@ -49,6 +50,7 @@
 #define CHECK_OPT		313
 #define VERBOSE_OPT		314
 #define EXTRAS_OPT		315
+#define EMBED_OPT		316
 
 static const Clp_Option options[] = {
   { "align", 'A', ALIGN_OPT, 0, 0 },
@@ -56,6 +58,7 @@ static const Clp_Option options[] = {
   { "check", 0, CHECK_OPT, 0, Clp_Negate },
   { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
   { "directory", 'd', DIRECTORY_OPT, Clp_ValString, 0 },
+  { "embed", 0, EMBED_OPT, 0, Clp_Negate },
   { "elements", 'E', ELEMENT_OPT, Clp_ValString, 0 },
   { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
   { "extras", 0, EXTRAS_OPT, 0, Clp_Negate },
@@ -73,6 +76,8 @@ static const char *program_name;
 static int driver = -1;
 static HashTable<String, int> initial_requirements(-1);
 static bool verbose = false;
+static bool embed = false;
+static RouterT *embed_router;
 
 void
 short_usage()
@@ -93,6 +98,11 @@ directory and supply a package name with the '-p PKG' option. Running\n\
 'make MINDRIVER=PKG' will build a 'PKGclick' user-level driver or 'PKGclick.ko'\n\
 kernel module.\n\
 \n\
+With '--embed', the driver is specialized to a single configuration: the\n\
+configuration is compiled in, already parsed, and the driver is linked\n\
+statically with link-time optimization. Give it a configuration archive\n\
+from 'click-devirtualize' to compile the devirtualized classes in as well.\n\
+\n\
 Usage: %s -p PKG [-lu] [OPTION]... [ROUTERFILE]...\n\
 \n\
 Options:\n\
@@ -106,6 +116,8 @@ Options:\n\
   -d, --directory DIR      Put files in DIR. DIR must contain a 'Makefile'\n\
                            for the relevant driver. Default is '.'.\n\
   -E, --elements ELTS      Include element classes ELTS.\n\
+      --embed              Compile the configuration into the driver\n\
+                           (user-level only, one configuration).\n\
       --no-extras          Do include useful non-required element classes.\n\
   -V, --verbose            Print progress information.\n\
   -C, --clickpath PATH     Use PATH for CLICKPATH.\n\
@@ -123,6 +135,7 @@ class Mindriver { public:
     void provide(const String&, ErrorHandler*);
     void require(const String&, ErrorHandler*);
     void add_source_file(const String&, ErrorHandler*);
+    void add_archive_source(RouterT*, const Traits&, ErrorHandler*);
 
     void add_router_requirements(RouterT*, const ElementMap&, ErrorHandler*);
     bool add_traits(const Traits&, const ElementMap&, ErrorHandler*);
@@ -132,6 +145,7 @@ class Mindriver { public:
     HashTable<String, int> _provisions;
     HashTable<String, int> _requirements;
     HashTable<String, int> _source_files;
+    HashTable<String, String> _archive_sources;
     int _nrequirements;
 
 };
@@ -168,12 +182,40 @@ Mindriver::add_source_file(const String& fn, ErrorHandler* errh)
     _source_files[fn] = 1;
 }
 
+// An embedded driver cannot load packages, so package element classes whose
+// source came with the configuration, such as click-devirtualize's output,
+// are compiled in.
+void
+Mindriver::add_archive_source(RouterT *router, const Traits &t, ErrorHandler *errh)
+{
+    if (!t.source_file || !t.header_file || !t.cxx
+	|| router->archive_index(t.source_file) < 0
+	|| router->archive_index(t.header_file) < 0) {
+	errh->error("element class %<%s%> is in a package whose source is not in the configuration", t.name.c_str());
+	return;
+    }
+    if (verbose && !_archive_sources.get(t.source_file))
+	errh->message("adding archive source file %<%s%>", t.source_file.c_str());
+    String &classes = _archive_sources[t.source_file];
+    if (!classes)
+	classes = t.header_file;
+    classes += (classes.find_left('\t') < 0 ? "\t" : " ") + t.cxx + "-" + t.name;
+    if (t.requirements) {
+	Vector<String> args;
+	cp_spacevec(t.requirements, args);
+	for (String *s = args.begin(); s < args.end(); s++)
+	    require(*s, errh);
+    }
+}
+
 void
 Mindriver::add_router_requirements(RouterT* router, const ElementMap& default_map, ErrorHandler* errh)
 {
     // find and parse elementmap
     ElementMap emap(default_map);
     emap.parse_requirement_files(router, CLICK_DATADIR, errh);
+    if (embed && router->archive_index("elementmap-devirtualize.xml") >= 0)
+	emap.parse(router->archive("elementmap-devirtualize.xml").data, "devirtualize");
 
     // check whether suitable for driver
     if (!emap.driver_compatible(router, driver)) {
@@ -193,9 +235,11 @@ Mindriver::add_router_requirements(RouterT* router, const ElementMap& default_ma
 	String tname = i.key()->name();
 	if (!emap.has_traits(tname))
 	    missing_sa << (nmissing++ ? ", " : "") << tname;
-	else if (emap.package(tname))
-	    /* do nothing; element was defined in a package */;
-	else
+	else if (emap.package(tname)) {
+	    // element was defined in a package
+	    if (embed)
+		add_archive_source(router, emap.traits(tname), errh);
+	} else
 	    require(tname, errh);
     }
 
@@ -225,7 +269,10 @@ handle_router(Mindriver& md, String filename_in, const ElementMap &default_map,
 	router->flatten(&lerrh);
     if (router && errh->nerrors() == before)
 	md.add_router_requirements(router, default_map, &lerrh);
-    delete router;
+    if (embed && router && errh->nerrors() == before)
+	embed_router = router;
+    else
+	delete router;
 }
 
 bool
@@ -358,6 +405,96 @@ Mindriver::print_elements_conf(FILE *f, String package, const ElementMap &emap,
 	    else
 		fprintf(f, "%s%s\t%s\t%s\n", top_srcdir.c_str(), sourcevec[i].c_str(), headervec[i].c_str(), classstr.c_str());
 	}
+    for (HashTable<String, String>::iterator it = _archive_sources.begin(); it.live(); ++it) {
+	int tab = it.value().find_left('\t');
+	fprintf(f, "./%s\t\"%s\"\t%s\n", it.key().c_str(), it.value().substring(0, tab).c_str(), it.value().substring(tab + 1).c_str());
+    }
+}
+
+static String
+c_string(const String &str)
+{
+    StringAccum sa;
+    sa << '\"';
+    for (const char *x = str.begin(); x != str.end(); ++x)
+	if (*x == '\"' || *x == '\\')
+	    sa << '\\' << *x;
+	else if (*x == '\n' && x + 1 != str.end())
+	    sa << "\\n\"\n\t\"";
+	else if (*x == '\n')
+	    sa << "\\n";
+	else if ((unsigned char) *x < 32 || (unsigned char) *x >= 127)
+	    sa.snprintf(5, "\\%03o", (unsigned char) *x);
+	else
+	    sa << *x;
+    sa << '\"';
+    return sa.take_string();
+}
+
+// Write C++ source that builds the flattened configuration in @a router
+// directly, with the same Router calls the lexer would make.
+static void
+print_embedded_graph(FILE *f, String package, RouterT *router,
+		     const ElementMap &emap, const String &top_srcdir,
+		     ErrorHandler *errh)
+{
+    StringAccum headers, body;
+    HashTable<String, int> header_seen(0);
+    Vector<int> eindex(router->nelements(), -1);
+    int nelements = 0;
+
+    const Vector<String> &requirements = router->requirements();
+    for (int i = 0; i < requirements.size(); i += 2)
+	// packages are compiled in, not loaded
+	if (!requirements[i].equals("package", 7))
+	    body << "    r->add_requirement(" << c_string(requirements[i])
+		 << ", " << c_string(requirements[i+1]) << ");\n";
+
+    for (int i = 0; i < router->nelements(); ++i) {
+	if (!router->elive(i))
+	    continue;
+	const ElementT *e = router->element(i);
+	const Traits &t = emap.traits(e->type_name());
+	if (!t.cxx || !t.header_file) {
+	    errh->error("%s: element class %<%s%> has no C++ class", e->landmark().c_str(), e->type_name().c_str());
+	    continue;
+	}
+	String header = t.header_file;
+	if (header[0] != '\"' && header[0] != '<')
+	    header = "\"" + (emap.package(t) ? String() : top_srcdir) + header + "\"";
+	if (!header_seen[header]) {
+	    header_seen[header] = 1;
+	    headers << "#include " << header << "\n";
+	}
+
+	String landmark = e->landmark(), filename = landmark;
+	unsigned lineno = 0;
+	int colon = landmark.find_right(':');
+	if (colon >= 0 && IntArg().parse(landmark.substring(colon + 1), lineno))
+	    filename = landmark.substring(0, colon);
+	body << "    r->add_element(new " << t.cxx << ", " << c_string(e->name())
+	     << ", " << c_string(e->configuration()) << ", "
+	     << c_string(filename) << ", " << lineno << ");\n";
+	eindex[i] = nelements++;
+    }
+
+    for (RouterT::conn_iterator it = router->begin_connections();
+	 it != router->end_connections(); ++it)
+	body << "    r->add_connection(" << eindex[it->from_eindex()] << ", "
+	     << it->from_port() << ", " << eindex[it->to_eindex()] << ", "
+	     << it->to_port() << ");\n";
+
+    StringAccum config;
+    router->unparse(config);
+
+    time_t now = time(0);
+    const char *date_str = ctime(&now);
+    fprintf(f, "// Generated by 'click-mkmindriver -p %s --embed' on %s", package.c_str(), date_str);
+    fprintf(f, "#include <click/config.h>\n#include <click/router.hh>\n%s", headers.c_str());
+    fprintf(f, "CLICK_DECLS\n\nstatic const char embedded_config[] =\n\t%s;\n\n", c_string(config.take_string()).c_str());
+    fprintf(f, "Router *\nclick_embedded_router(Master *master)\n{\n\
+    Router *r = new Router(String::make_stable(embedded_config, sizeof(embedded_config) - 1), master);\n\
+%s    return r;\n}\n\nCLICK_ENDDECLS\n", body.c_str());
 }
 
 static String
@@ -476,6 +613,10 @@ particular purpose.\n");
 	    extras = !clp->negated;
 	    break;
 
+	  case EMBED_OPT:
+	    embed = !clp->negated;
+	    break;
+
 	  case VERBOSE_OPT:
 	    verbose = !clp->negated;
 	    break;
@@ -510,6 +651,10 @@ particular purpose.\n");
 	driver = Driver::USERLEVEL;
     if (!package_name)
 	errh->fatal("fatal error: no package name specified\nPlease supply the %<-p PKG%> option.");
+    if (embed && driver != Driver::USERLEVEL)
+	errh->fatal("%<--embed%> requires the user-level driver");
+    if (embed && router_filenames.size() != 1)
+	errh->fatal("%<--embed%> requires exactly one configuration");
     if (extras) {
 	md.require("Align", errh);
 	md.require("IPNameInfo", errh);
@@ -572,6 +717,37 @@ particular purpose.\n");
 	fclose(f);
     }
 
+    // Print elements_PKG_graph.cc and the package sources it needs
+    if (embed && embed_router && errh->nerrors() == 0) {
+	for (HashTable<String, String>::iterator it = md._archive_sources.begin(); it.live(); ++it) {
+	    String header = it.value().substring(0, it.value().find_left('\t'));
+	    for (int i = 0; i < 2; ++i) {
+		const String &name = (i ? header : it.key());
+		String fn = directory + name;
+		if (FILE *af = fopen(fn.c_str(), "w")) {
+		    const String &data = embed_router->archive(name).data;
+		    ignore_result(fwrite(data.data(), 1, data.length(), af));
+		    fclose(af);
+		} else
+		    errh->error("%s: %s", fn.c_str(), strerror(errno));
+	    }
+	}
+
+	ElementMap emap(default_emap);
+	emap.parse_requirement_files(embed_router, CLICK_DATADIR, errh);
+	if (embed_router->archive_index("elementmap-devirtualize.xml") >= 0)
+	    emap.parse(embed_router->archive("elementmap-devirtualize.xml").data, "devirtualize");
+	emap.set_driver(driver);
+
+	String fn = directory + String("elements_") + package_name + "_graph.cc";
+	errh->message("Creating %s...", fn.c_str());
+	FILE *f = fopen(fn.c_str(), "w");
+	if (!f)
+	    errh->fatal("%s: %s", fn.c_str(), strerror(errno));
+	print_embedded_graph(f, package_name, embed_router, emap, top_srcdir, errh);
+	fclose(f);
+    }
+
     // Final message
     if (errh->nerrors() == 0) {
 	if (driver == Driver::USERLEVEL)
@@ -787,19 +787,12 @@ ProcessingT::follow_flow(const Bitvector &source, bool source_isoutput,
     assert(source.size() == npidx(source_isoutput)
 	   && sink.size() == npidx(!source_isoutput));
     Bitvector bv;
-    // for speed with sparse Bitvectors, look into the Bitvector implementation
-    const uint32_t *source_words = source.data_words();
-    const int wb = Bitvector::data_word_bits;
-    for (int w = 0; w <= source.max_word(); ++w)
-	if (source_words[w]) {
-	    int m = std::min(source.size(), (w + 1) * wb);
-	    for (int pidx = w * wb; pidx < m; ++pidx)
-		if (source[pidx]) {
-		    PortT p = port(pidx, source_isoutput);
-		    (void) port_flow(p, source_isoutput, &bv, errh);
-		    sink.offset_or(bv, _pidx[!source_isoutput][p.eindex()]);
-		}
-	}
+    for (int pidx = source.find_first(); pidx >= 0;
+	 pidx = source.find_next(pidx)) {
+	PortT p = port(pidx, source_isoutput);
+	(void) port_flow(p, source_isoutput, &bv, errh);
+	sink.offset_or(bv, _pidx[!source_isoutput][p.eindex()]);
+    }
 }
 
 void
@@ -34,6 +34,9 @@
 #include <sys/stat.h>
 #include <sys/resource.h>
 #include <fcntl.h>
+#if HAVE_MULTITHREAD && defined(__linux__)
+# include <sched.h>
+#endif
 #if HAVE_EXECINFO_H
 # include <execinfo.h>
 #endif
@@ -52,6 +55,7 @@
 #include <click/userutils.hh>
 #include <click/args.hh>
 #include <click/handlercall.hh>
+#include <click/perfmap.hh>
 #include "elements/standard/quitwatcher.hh"
 #include "elements/userlevel/controlsocket.hh"
 CLICK_USING_DECLS
@@ -74,22 +78,50 @@ CLICK_USING_DECLS
 #define THREADS_OPT		316
 #define SIMTIME_OPT		317
 #define SOCKET_OPT		318
+#define PACKET_POOL_OPT		319
+#define PACKET_POOL_GLOBAL_OPT	320
+#define HUGE_PAGES_OPT		321
+#define TIMER_WHEEL_OPT		322
+#define CONFIG_CACHE_OPT	323
+#define CONFIGURE_THREADS_OPT	324
+#define PROFILE_OPT		325
+#define TSC_CLOCK_OPT		326
+#define AFFINITY_OPT		327
+#define PUSH_FUSION_OPT		328
+#define PATTERNS_OPT		329
+#define UNDEAD_OPT		330
+#define PERF_MAP_OPT		331
+#define JITDUMP_OPT		332
 
 static const Clp_Option options[] = {
+    { "affinity", 'a', AFFINITY_OPT, Clp_ValString, Clp_Optional },
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
     { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
+    { "config-cache", 0, CONFIG_CACHE_OPT, Clp_ValString, 0 },
+    { "configure-threads", 0, CONFIGURE_THREADS_OPT, Clp_ValInt, 0 },
     { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
     { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
     { "handler", 'h', HANDLER_OPT, Clp_ValString, 0 },
     { "help", 0, HELP_OPT, 0, 0 },
+    { "huge-pages", 0, HUGE_PAGES_OPT, 0, Clp_Negate },
+    { "jitdump", 0, JITDUMP_OPT, 0, Clp_Negate },
     { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
+    { "packet-pool", 0, PACKET_POOL_OPT, Clp_ValUnsigned, 0 },
+    { "packet-pool-global", 0, PACKET_POOL_GLOBAL_OPT, Clp_ValUnsigned, 0 },
     { "socket", 0, SOCKET_OPT, Clp_ValInt, 0 },
+    { "patterns", 0, PATTERNS_OPT, Clp_ValString, 0 },
+    { "perf-map", 0, PERF_MAP_OPT, 0, Clp_Negate },
     { "port", 'p', PORT_OPT, Clp_ValString, 0 },
+    { "profile", 0, PROFILE_OPT, 0, Clp_Negate },
+    { "push-fusion", 0, PUSH_FUSION_OPT, 0, Clp_Negate },
     { "quit", 'q', QUIT_OPT, 0, 0 },
     { "simtime", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
     { "simulation-time", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
     { "threads", 'j', THREADS_OPT, Clp_ValInt, 0 },
     { "time", 't', TIME_OPT, 0, 0 },
+    { "timer-wheel", 0, TIMER_WHEEL_OPT, 0, Clp_Negate },
+    { "tsc-clock", 0, TSC_CLOCK_OPT, 0, Clp_Negate },
+    { "undead", 0, UNDEAD_OPT, 0, Clp_Negate },
     { "unix-socket", 'u', UNIX_SOCKET_OPT, Clp_ValString, 0 },
     { "version", 'v', VERSION_OPT, 0, 0 },
     { "warnings", 0, WARNINGS_OPT, 0, Clp_Negate },
@@ -121,6 +153,9 @@ Options:\n\
   -f, --file FILE               Read router configuration from FILE.\n\
   -e, --expression EXPR         Use EXPR as router configuration.\n\
   -j, --threads N               Start N threads (default 1).\n\
+  -a, --affinity[=CPUS]         Pin thread I to processor CPUS+I (default 0),\n\
+                                or, if CPUS is a list like 0-3,8-11, to the\n\
+                                list's Ith processor.\n\
   -p, --port PORT               Listen for control connections on TCP port.\n\
   -u, --unix-socket FILE        Listen for control connections on Unix socket.\n\
       --socket FD               Add a file descriptor control connection.\n\
@@ -133,6 +168,25 @@ Options:\n\
   -t, --time                    Print information on how long driver took.\n\
   -w, --no-warnings             Do not print warnings.\n\
       --simtime                 Run in simulation time.\n\
+      --packet-pool N           Keep up to N free packets per thread (1000).\n\
+      --packet-pool-global N    Keep up to N spare thread pools (16).\n\
+      --huge-pages              Allocate pooled packet data from huge pages.\n\
+      --timer-wheel             Keep timers in a hierarchical timing wheel.\n\
+      --config-cache DIR        Cache flattened configurations in DIR.\n\
+      --configure-threads N     Configure and initialize large elements on N\n\
+                                threads (1).\n\
+      --profile                 Count cycles, calls and packets per element;\n\
+                                see the 'profile' handler.\n\
+      --perf-map                Name generated code in /tmp/perf-PID.map.\n\
+      --jitdump                 Also write generated code to /tmp/jit-PID.dump\n\
+                                for 'perf inject --jit'.\n\
+      --no-push-fusion          Don't fuse chains of simple push elements.\n\
+      --patterns FILE           Replace subgraphs matching click-xform\n\
+                                patterns in FILE; see 'optimizations'.\n\
+      --undead                  Remove static switches, Nulls, and dead\n\
+                                elements from the configuration.\n\
+      --no-tsc-clock            Don't compute packet timestamps from the\n\
+                                cycle counter.\n\
   -C, --clickpath PATH          Use PATH for CLICKPATH.\n\
       --help                    Print this message and exit.\n\
   -v, --version                 Print version number and exit.\n\
@@ -276,6 +330,9 @@ static Router *hotswap_router;
 static Router *hotswap_thunk_router;
 static bool hotswap_hook(Task *, void *);
 static Task hotswap_task(hotswap_hook, 0);
+static Timestamp hotswap_start;
+static Timestamp hotswap_latency;
+static bool hotswap_incremental;
 
 static bool
 hotswap_hook(Task *, void *)
@@ -286,6 +343,8 @@ hotswap_hook(Task *, void *)
     router = hotswap_router;
     router->use();
     hotswap_router = 0;
+    hotswap_latency = Timestamp::now_steady() - hotswap_start;
+    hotswap_incremental = false;
     return true;
 }
 
@@ -296,6 +355,9 @@ static Vector<String> cs_ports;
 static Vector<String> cs_sockets;
 static bool warnings = true;
 static int nthreads = 1;
+static int configure_threads = 1;
+static bool push_fusion = true;
+static bool timer_wheel = false;
 
 static String
 click_driver_control_socket_name(int number)
@@ -306,6 +368,55 @@ click_driver_control_socket_name(int number)
 	return "click_driver@@ControlSocket@" + String(number);
 }
 
+static int affinity_cpu = -1;
+static Vector<int> affinity_cpus;
+
+static int
+parse_affinity(const String &str, ErrorHandler *errh)
+{
+    if (!str) {
+	affinity_cpu = 0;
+	return 0;
+    } else if (IntArg().parse(str, affinity_cpu) && affinity_cpu >= 0)
+	return 0;
+
+    // a list of CPUs and CPU ranges, like "0-3,8-11"
+    affinity_cpu = -1;
+    affinity_cpus.clear();
+    const char *s = str.begin(), *end = str.end();
+    while (s != end) {
+	const char *comma = find(s, end, ',');
+	const char *dash = find(s, comma, '-');
+	int first, last;
+	if (!IntArg().parse(str.substring(s, dash), first) || first < 0
+	    || (dash == comma ? (last = first, false)
+		: !IntArg().parse(str.substring(dash + 1, comma), last))
+	    || last < first)
+	    return errh->error("--affinity: bad CPU list %<%s%>", str.c_str());
+	for (int cpu = first; cpu <= last; ++cpu)
+	    affinity_cpus.push_back(cpu);
+	s = comma == end ? end : comma + 1;
+    }
+    return 0;
+}
+
+// Record each thread's CPU, so that configuration can place elements and
+// their memory by NUMA node before the threads start.
+static void
+assign_thread_cpus(Master *master)
+{
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int tid = 0; tid < master->nthreads(); ++tid)
+	if (affinity_cpus.size())
+	    master->thread(tid)->set_cpu(affinity_cpus[tid % affinity_cpus.size()]);
+	else if (affinity_cpu >= 0)
+	    master->thread(tid)->set_cpu((affinity_cpu + tid) % (ncpus > 0 ? ncpus : 1));
+}
+
+// Defined by drivers built with 'click-mkmindriver --embed', which compile
+// their configuration in rather than parsing it at startup.
+extern Router *click_embedded_router(Master *master) __attribute__((weak));
+
 static Router *
 parse_configuration(const String &text, bool text_is_expr, bool hotswap,
 		    ErrorHandler *errh)
@@ -315,16 +426,37 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
 	master = router->master();
     else
 	master = new_master = new Master(nthreads);
-
-    Router *r = click_read_router(text, text_is_expr, errh, false, master);
+    if (new_master)
+	assign_thread_cpus(new_master);
+    if (new_master && timer_wheel)
+	for (int i = -1; i < new_master->nthreads(); ++i)
+	    new_master->thread(i)->timer_set().set_timer_wheel(true);
+
+    Router *r;
+    if (!text && !text_is_expr && click_embedded_router)
+	r = click_embedded_router(master);
+    else
+	r = click_read_router(text, text_is_expr, errh, false, master);
     if (!r) {
 	delete new_master;
 	return 0;
     }
 
+    // if only live-reconfigurable settings changed, update the running
+    // router instead; the new router's elements are never initialized
+    int ncs = cs_ports.size() + cs_unix_sockets.size() + cs_sockets.size();
+    if (hotswap && router && router->initialized()
+	&& router->nelements() == r->nelements() + ncs) {
+	int result = router->hotswap_in_place(r, errh);
+	if (result != 0) {
+	    delete r;
+	    return (result > 0 ? router : 0);
+	}
+    }
+
     // add new ControlSockets
     String retries = (hotswap ? ", RETRIES 1, RETRY_WARNINGS false" : "");
-    int ncs = 0;
+    ncs = 0;
     for (String *it = cs_ports.begin(); it != cs_ports.end(); ++it, ++ncs)
 	r->add_element(new ControlSocket, click_driver_control_socket_name(ncs), "TCP, " + *it + retries, "click", 0);
     for (String *it = cs_unix_sockets.begin(); it != cs_unix_sockets.end(); ++it, ++ncs)
@@ -357,6 +489,8 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
   // register hotswap router on new router
   if (hotswap && router && router->initialized())
     r->set_hotswap_router(router);
+  r->set_configure_threads(configure_threads);
+  r->set_push_fusion(push_fusion);
 
   if (errh->nerrors() > 0 || r->initialize(errh) < 0) {
     delete r;
@@ -369,7 +503,14 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
 static int
 hotconfig_handler(const String &text, Element *, void *, ErrorHandler *errh)
 {
+  Timestamp start = Timestamp::now_steady();
   if (Router *q = parse_configuration(text, true, true, errh)) {
+    if (q == router) {
+      hotswap_latency = Timestamp::now_steady() - start;
+      hotswap_incremental = true;
+      return 0;
+    }
+    hotswap_start = start;
     if (hotswap_router)
       hotswap_router->unuse();
     hotswap_router = q;
@@ -381,6 +522,15 @@ hotconfig_handler(const String &text, Element *, void *, ErrorHandler *errh)
 }
 
 
+static String
+hotconfig_read_handler(Element *, void *thunk)
+{
+    if (thunk)
+	return String(hotswap_incremental);
+    else
+	return hotswap_latency.unparse();
+}
+
 // timewarping
 
 static String
@@ -423,11 +573,30 @@ round_timeval(struct timeval *tv, int usec_divider)
     }
 }
 
+static void
+set_thread_affinity(RouterThread *thread, ErrorHandler *errh)
+{
+#if HAVE_MULTITHREAD && defined(__linux__) && defined(CPU_SET)
+    int cpu = thread->cpu();
+    if (cpu < 0)
+	return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	errh->warning("thread %d: cannot pin to CPU %d: %s", thread->thread_id(), cpu, strerror(errno));
+#else
+    if (thread->cpu() >= 0 && thread->thread_id() == 0)
+	errh->warning("--affinity is not supported on this platform");
+#endif
+}
+
 #if HAVE_MULTITHREAD
 extern "C" {
 static void *thread_driver(void *user_data)
 {
     RouterThread *thread = static_cast<RouterThread *>(user_data);
+    set_thread_affinity(thread, ErrorHandler::default_handler());
     thread->driver();
     return 0;
 }
@@ -461,6 +630,10 @@ main(int argc, char **argv)
   bool allow_reconfigure = false;
   Vector<String> handlers;
   String exit_handler;
+  unsigned packet_pool_size = 1000;
+  unsigned packet_pool_global = 16;
+  bool huge_pages = false;
+  Vector<String> pattern_files;
 
   while (1) {
     int opt = Clp_Next(clp);
@@ -571,6 +744,78 @@ main(int argc, char **argv)
 	break;
     }
 
+    case PACKET_POOL_OPT:
+      packet_pool_size = clp->val.u;
+      break;
+
+    case PACKET_POOL_GLOBAL_OPT:
+      packet_pool_global = clp->val.u;
+      break;
+
+    case HUGE_PAGES_OPT:
+      huge_pages = !clp->negated;
+      break;
+
+    case TIMER_WHEEL_OPT:
+      timer_wheel = !clp->negated;
+      break;
+
+    case PROFILE_OPT:
+#if HAVE_ELEMENT_PROFILE
+      Element::set_profiling(!clp->negated);
+#else
+      if (!clp->negated)
+	errh->warning("--profile requires a build without CLICK_STATS >= 2");
+#endif
+      break;
+
+    case PERF_MAP_OPT:
+      if (!clp->negated)
+	PerfMap::enable(PerfMap::F_MAP, errh);
+      break;
+
+    case JITDUMP_OPT:
+      if (!clp->negated)
+	PerfMap::enable(PerfMap::F_MAP | PerfMap::F_JITDUMP, errh);
+      break;
+
+    case PUSH_FUSION_OPT:
+      push_fusion = !clp->negated;
+      break;
+
+    case PATTERNS_OPT:
+      pattern_files.push_back(clp->vstr);
+      break;
+
+    case UNDEAD_OPT:
+      click_lexer()->set_undead(!clp->negated);
+      break;
+
+    case AFFINITY_OPT:
+      if (parse_affinity(clp->have_val ? String(clp->vstr) : String(), errh) < 0)
+	  goto bad_option;
+      break;
+
+    case TSC_CLOCK_OPT:
+      Timestamp::fast_clock_enable(!clp->negated);
+      break;
+
+    case CONFIG_CACHE_OPT:
+      click_set_config_cache(clp->vstr);
+      break;
+
+    case CONFIGURE_THREADS_OPT:
+      configure_threads = clp->val.i;
+      if (configure_threads <= 1)
+	  configure_threads = 1;
+#if !HAVE_MULTITHREAD
+      if (configure_threads > 1) {
+	  errh->warning("Click was built without multithread support, configuring single threaded");
+	  configure_threads = 1;
+      }
+#endif
+      break;
+
      case CLICKPATH_OPT:
       set_clickpath(clp->vstr);
       break;
@@ -603,13 +848,39 @@ particular purpose.\n");
   }
 
  done:
+#if HAVE_CLICK_PACKET_POOL
+  if (int r = Packet::set_pool_parameters(packet_pool_size, packet_pool_global, huge_pages)) {
+    errh->error("cannot configure packet pool: %s", strerror(-r));
+    return cleanup(clp, 1);
+  }
+#else
+  if (huge_pages || packet_pool_size != 1000 || packet_pool_global != 16)
+    errh->warning("Click was built without a packet pool, ignoring packet pool options");
+#endif
+
   // provide hotconfig handler if asked
-  if (allow_reconfigure)
+  if (allow_reconfigure) {
       Router::add_write_handler(0, "hotconfig", hotconfig_handler, 0, Handler::RAW | Handler::NONEXCLUSIVE);
+      Router::add_read_handler(0, "hotconfig_latency", hotconfig_read_handler, 0);
+      Router::add_read_handler(0, "hotconfig_incremental", hotconfig_read_handler, (void *) 1);
+  }
   Router::add_read_handler(0, "timewarp", timewarp_read_handler, 0);
   if (Timestamp::warp_class() != Timestamp::warp_simulation)
       Router::add_write_handler(0, "timewarp", timewarp_write_handler, 0);
 
+  // read optimization patterns, looking in CLICKPATH/conf too
+  for (String *it = pattern_files.begin(); it != pattern_files.end(); ++it) {
+      String fn = *it;
+      if (access(fn.c_str(), R_OK) != 0)
+	  if (String found = clickpath_find_file(fn, "conf", String()))
+	      fn = found;
+      int before = errh->nerrors();
+      String text = file_string(fn, errh);
+      if (errh->nerrors() > before
+	  || click_lexer()->add_patterns(text, fn, errh) < 0)
+	  return cleanup(clp, 1);
+  }
+
   // parse configuration
   router = parse_configuration(router_file, file_is_expr, false, errh);
   if (!router)
@@ -664,6 +935,7 @@ particular purpose.\n");
 	other_threads.push_back(p);
     }
 #endif
+    set_thread_affinity(router->master()->thread(0), errh);
     router->master()->thread(0)->driver();
   } else if (!quit_immediately && warnings)
     errh->warning("%s: configuration has no elements, exiting", filename_landmark(router_file, file_is_expr));